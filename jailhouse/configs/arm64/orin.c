@@ -18,13 +18,19 @@ struct {
 			.phys_start = 0xc0000000, 
 			.size = 0x00200000, 
 		},
+		/* grows the page pool for cells with many or colored regions */
+		.hypervisor_pool = {
+			.phys_start = 0xc0400000,
+			.size = 0x00400000,
+		},
 		.debug_console = {
 			/* uarti */
 			.address = 0x031d0000, 
 			.size = 0x00010000,
 			.type = JAILHOUSE_CON_TYPE_PL011,
 			.flags = JAILHOUSE_CON_ACCESS_MMIO |
-				 JAILHOUSE_CON_REGDIST_4,
+				 JAILHOUSE_CON_REGDIST_4 |
+				 JAILHOUSE_CON_DRAIN,
 		},
 		.platform_info = {
 			.pci_mmconfig_base = 0x0f800000, 
@@ -46,6 +52,23 @@ struct {
 					23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 
 				},
 			},
+			/* device IRQs stay on CPUs 0-1, off the demo cells */
+			.num_irq_policies = 3,
+			.irq_policies = {
+				{
+					.name = "eth0.",
+					.cpus = 0b000000000011,
+				},
+				{
+					.name = "nvgpu",
+					.rt_priority = 50,
+					.cpus = 0b000000000011,
+				},
+				{
+					.flags = JAILHOUSE_IRQ_POLICY_VPCI,
+					.cpus = 0b000000000011,
+				},
+			},
 		},
 		.root_cell = {
 			.name = "Jetson-AGX-Orin-Root", 
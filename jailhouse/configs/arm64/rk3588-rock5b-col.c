@@ -89,6 +89,7 @@ struct {
 		},
 		.root_cell = {
 			.name = "RADXA ROCK5B",
+			.flags = JAILHOUSE_CELL_SDEI_IRQS,
 
 			.cpu_set_size = sizeof(config.cpus),
 			.num_memory_regions = ARRAY_SIZE(config.mem_regions),
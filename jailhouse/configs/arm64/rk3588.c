@@ -81,6 +81,7 @@ struct {
 		},
 		.root_cell = {
 			.name = "rk3588",
+			.flags = JAILHOUSE_CELL_SDEI_IRQS,
 			.num_pci_devices = ARRAY_SIZE(config.pci_devices),
 			.cpu_set_size = sizeof(config.cpus),
 			.num_memory_regions = ARRAY_SIZE(config.mem_regions),
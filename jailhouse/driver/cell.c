@@ -15,11 +15,18 @@
 
 #include <linux/cpu.h>
 #include <linux/mm.h>
+#include <linux/rcupdate.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0)
+#include <linux/sched/signal.h>
+#endif
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include <asm/cacheflush.h>
 
 #include "cell.h"
+#include "emc.h"
+#include "irqpolicy.h"
 #include "main.h"
 #include "pci.h"
 #include "sysfs.h"
@@ -36,10 +43,48 @@ struct cell *root_cell;
 static LIST_HEAD(cells);
 static cpumask_t offlined_cpus;
 
+/*
+ * The kernel offers no batched CPU hotplug outside of boot and suspend, and
+ * the rounds are serialized by cpu_add_remove_lock anyway. Most of a round is spent in RCU
+ * grace periods, so expedite those for the whole batch, and claim the PCI
+ * devices of a new cell in parallel to it.
+ */
+struct pci_claim_work {
+	struct work_struct work;
+	struct cell *cell;
+};
+
+static void pci_claim_work_fn(struct work_struct *work)
+{
+	struct pci_claim_work *claim =
+		container_of(work, struct pci_claim_work, work);
+
+	jailhouse_pci_do_all_devices(claim->cell, JAILHOUSE_PCI_TYPE_DEVICE,
+				     JAILHOUSE_PCI_ACTION_CLAIM);
+}
+
+static void cpu_offline_batch_begin(struct pci_claim_work *claim,
+				    struct cell *cell)
+{
+	claim->cell = cell;
+	INIT_WORK(&claim->work, pci_claim_work_fn);
+	if (cell->num_pci_devices)
+		queue_work(system_unbound_wq, &claim->work);
+
+	rcu_expedite_gp();
+}
+
+static void cpu_offline_batch_end(struct pci_claim_work *claim)
+{
+	rcu_unexpedite_gp();
+	flush_work(&claim->work);
+}
+
 void jailhouse_cell_kobj_release(struct kobject *kobj)
 {
 	struct cell *cell = container_of(kobj, struct cell, kobj);
 
+	jailhouse_emc_cell_cleanup(cell);
 	jailhouse_pci_cell_cleanup(cell);
 	vfree(cell->memory_regions);
 	kfree(cell);
@@ -106,6 +151,18 @@ retry:
 	return cell;
 }
 
+/* True if a non-root cell other than the given one runs on the CPU. */
+static bool cpu_time_shared(unsigned int cpu, struct cell *cell)
+{
+	struct cell *iter;
+
+	list_for_each_entry(iter, &cells, entry)
+		if (iter != cell && iter != root_cell &&
+		    cpumask_test_cpu(cpu, &iter->cpus_assigned))
+			return true;
+	return false;
+}
+
 static void cell_register(struct cell *cell)
 {
 	list_add_tail(&cell->entry, &cells);
@@ -156,6 +213,7 @@ int jailhouse_cmd_cell_create(struct jailhouse_cell_create __user *arg)
 	struct jailhouse_cell_create cell_params;
 	struct jailhouse_cell_desc *config;
 	struct jailhouse_cell_id cell_id;
+	struct pci_claim_work claim;
 	void __user *user_config;
 	struct cell *cell;
 	unsigned int cpu;
@@ -222,14 +280,24 @@ int jailhouse_cmd_cell_create(struct jailhouse_cell_create __user *arg)
 
 	config->id = cell->id;
 
-	if (!cpumask_subset(&cell->cpus_assigned, &root_cell->cpus_assigned)) {
-		err = -EBUSY;
-		goto error_cell_delete;
-	}
+	/*
+	 * CPUs of other non-root cells can only be time-shared, the hypervisor
+	 * checks that both cells permit it.
+	 */
+	for_each_cpu(cpu, &cell->cpus_assigned)
+		if (!cpumask_test_cpu(cpu, &root_cell->cpus_assigned) &&
+		    (!(config->flags & JAILHOUSE_CELL_CPU_SHARED) ||
+		     !cpu_time_shared(cpu, cell))) {
+			err = -EBUSY;
+			goto error_cell_delete;
+		}
 
 	/* Off-line each CPU assigned to the new cell and remove it from the
 	 * root cell's set. */
+	cpu_offline_batch_begin(&claim, cell);
 	for_each_cpu(cpu, &cell->cpus_assigned) {
+		if (cpu_time_shared(cpu, cell))
+			continue;
 #ifdef CONFIG_X86
 		if (cpu == 0) {
 			/*
@@ -240,26 +308,28 @@ int jailhouse_cmd_cell_create(struct jailhouse_cell_create __user *arg)
 			 */
 			pr_err("Cannot assign CPU 0 to other cells\n");
 			err = -EINVAL;
-			goto error_cpu_online;
+			break;
 		}
 #endif
 		if (cpu_online(cpu)) {
 			err = remove_cpu(cpu);
 			if (err)
-				goto error_cpu_online;
+				break;
 			cpumask_set_cpu(cpu, &offlined_cpus);
 		}
 		cpumask_clear_cpu(cpu, &root_cell->cpus_assigned);
 	}
-
-	jailhouse_pci_do_all_devices(cell, JAILHOUSE_PCI_TYPE_DEVICE,
-	                             JAILHOUSE_PCI_ACTION_CLAIM);
+	cpu_offline_batch_end(&claim);
+	if (err)
+		goto error_cpu_online;
 
 	err = jailhouse_call_arg1(JAILHOUSE_HC_CELL_CREATE, __pa(config));
 	if (err < 0)
 		goto error_cpu_online;
 
 	cell_register(cell);
+	jailhouse_emc_cell_setup(cell);
+	jailhouse_irq_policy_apply();
 
 	pr_info("Created Jailhouse cell \"%s\"\n", config->name);
 
@@ -272,11 +342,18 @@ kfree_config_out:
 	return err;
 
 error_cpu_online:
+	rcu_expedite_gp();
 	for_each_cpu(cpu, &cell->cpus_assigned) {
+		if (cpu_time_shared(cpu, cell))
+			continue;
 		if (!cpu_online(cpu) && add_cpu(cpu) == 0)
 			cpumask_clear_cpu(cpu, &offlined_cpus);
 		cpumask_set_cpu(cpu, &root_cell->cpus_assigned);
 	}
+	rcu_unexpedite_gp();
+
+	jailhouse_pci_do_all_devices(cell, JAILHOUSE_PCI_TYPE_DEVICE,
+				     JAILHOUSE_PCI_ACTION_RELEASE);
 
 error_cell_delete:
 	cell_delete(cell);
@@ -305,29 +382,25 @@ static int cell_management_prologue(struct jailhouse_cell_id *cell_id,
 }
 
 #define MEM_REQ_FLAGS	(JAILHOUSE_MEM_WRITE | JAILHOUSE_MEM_LOADABLE)
+#define LOAD_CHUNK_SIZE	(4UL << 20)
 
-static int load_image(struct cell *cell,
-		      struct jailhouse_preload_image __user *uimage)
+/*
+ * Checks that the image range lies within one loadable region of the cell
+ * and returns the physical address of its start as reachable by the root
+ * cell.
+ */
+static int image_phys(struct cell *cell, u64 target_address, u64 size,
+		      u64 *phys)
 {
-	struct jailhouse_preload_image image;
-	const struct jailhouse_memory *mem;
-	unsigned int regions, page_offs;
-	u64 image_offset, phys_start;
-	void *image_mem;
-	int err = 0;
-
-	if (copy_from_user(&image, uimage, sizeof(image)))
-		return -EFAULT;
+	const struct jailhouse_memory *mem = cell->memory_regions;
+	unsigned int regions;
+	u64 image_offset;
 
-	if (image.size == 0)
-		return 0;
-
-	mem = cell->memory_regions;
 	for (regions = cell->num_memory_regions; regions > 0; regions--) {
-		image_offset = image.target_address - mem->virt_start;
-		if (image.target_address >= mem->virt_start &&
+		image_offset = target_address - mem->virt_start;
+		if (target_address >= mem->virt_start &&
 		    image_offset < mem->size) {
-			if (image.size > mem->size - image_offset ||
+			if (size > mem->size - image_offset ||
 			    (mem->flags & MEM_REQ_FLAGS) != MEM_REQ_FLAGS)
 				return -EINVAL;
 			break;
@@ -337,42 +410,83 @@ static int load_image(struct cell *cell,
 	if (regions == 0)
 		return -EINVAL;
 
-	if (mem->flags & JAILHOUSE_MEM_COLORED) {
+	if (mem->flags & JAILHOUSE_MEM_COLORED)
 		/* Tweak the base address to request remapping of
 		 * a reserved, high memory region.
 		 */
-		phys_start = (mem->virt_start + image_offset +
-			      root_cell->color_root_map_offset) & PAGE_MASK;
-	} else {
-		phys_start = (mem->phys_start + image_offset) & PAGE_MASK;
-	}
-	page_offs = offset_in_page(image_offset);
-	image_mem = jailhouse_ioremap(phys_start, 0,
-				      PAGE_ALIGN(image.size + page_offs));
-	if (!image_mem) {
-		pr_err("jailhouse: Unable to map cell RAM at %08llx "
-		       "for image loading\n",
-		       (unsigned long long)(mem->phys_start + image_offset));
-		return -EBUSY;
-	}
+		*phys = mem->virt_start + image_offset +
+			root_cell->color_root_map_offset;
+	else
+		*phys = mem->phys_start + image_offset;
 
-	if (copy_from_user(image_mem + page_offs,
-			   (void __user *)(unsigned long)image.source_address,
-			   image.size))
-		err = -EFAULT;
+	return 0;
+}
+
+static void flush_image(void *image_mem, unsigned long size)
+{
 	/*
 	 * ARMv7 and ARMv8 require to clean D-cache and invalidate I-cache for
 	 * memory containing new instructions. On x86 this is a NOP.
 	 */
-	flush_icache_range((unsigned long)(image_mem + page_offs),
-			   (unsigned long)(image_mem + page_offs) + image.size);
+	flush_icache_range((unsigned long)image_mem,
+			   (unsigned long)image_mem + size);
 #ifdef CONFIG_ARM
 	/*
 	 * ARMv7 requires to flush the written code and data out of D-cache to
 	 * allow the guest starting off with caches disabled.
 	 */
-	__cpuc_flush_dcache_area(image_mem + page_offs, image.size);
+	__cpuc_flush_dcache_area(image_mem, size);
 #endif
+}
+
+static int load_image(struct cell *cell,
+		      struct jailhouse_preload_image __user *uimage)
+{
+	struct jailhouse_preload_image image;
+	unsigned int page_offs;
+	u64 phys, offs, chunk;
+	void *image_mem;
+	int err;
+
+	if (copy_from_user(&image, uimage, sizeof(image)))
+		return -EFAULT;
+
+	if (image.size == 0)
+		return 0;
+
+	err = image_phys(cell, image.target_address, image.size, &phys);
+	if (err)
+		return err;
+
+	page_offs = offset_in_page(phys);
+	image_mem = jailhouse_ioremap(phys & PAGE_MASK, 0,
+				      PAGE_ALIGN(image.size + page_offs));
+	if (!image_mem) {
+		pr_err("jailhouse: Unable to map cell RAM at %08llx "
+		       "for image loading\n", (unsigned long long)phys);
+		return -EBUSY;
+	}
+
+	/*
+	 * Copy in chunks so that the caches are maintained while the data is
+	 * still hot and a large image can be interrupted.
+	 */
+	for (offs = 0; offs < image.size; offs += chunk) {
+		chunk = min_t(u64, image.size - offs, LOAD_CHUNK_SIZE);
+		if (copy_from_user(image_mem + page_offs + offs,
+				   (void __user *)(unsigned long)
+				   (image.source_address + offs), chunk)) {
+			err = -EFAULT;
+			break;
+		}
+		flush_image(image_mem + page_offs + offs, chunk);
+
+		if (fatal_signal_pending(current)) {
+			err = -EINTR;
+			break;
+		}
+		cond_resched();
+	}
 
 	vunmap(image_mem);
 
@@ -410,6 +524,116 @@ unlock_out:
 	return err;
 }
 
+int jailhouse_cmd_cell_map_image(struct jailhouse_cell_id __user *arg)
+{
+	struct jailhouse_cell_id cell_id;
+	struct cell *cell;
+	int err;
+
+	if (copy_from_user(&cell_id, arg, sizeof(cell_id)))
+		return -EFAULT;
+
+	err = cell_management_prologue(&cell_id, &cell);
+	if (err)
+		return err;
+
+	/* on success, the id is returned for the caller to remember */
+	err = cell == root_cell ? -EINVAL : cell->id;
+
+	mutex_unlock(&jailhouse_lock);
+
+	return err;
+}
+
+static void cell_image_vm_open(struct vm_area_struct *vma)
+{
+	struct cell *cell = vma->vm_private_data;
+
+	atomic_inc(&cell->image_mappings);
+}
+
+static void cell_image_vm_close(struct vm_area_struct *vma)
+{
+	unsigned long size = vma->vm_end - vma->vm_start;
+	struct cell *cell = vma->vm_private_data;
+	void *image_mem;
+	u64 phys;
+
+	/*
+	 * The cell can neither be started nor destroyed while mapped, so the
+	 * range is still valid. Clean the caches for what the user wrote.
+	 */
+	if (image_phys(cell, (u64)vma->vm_pgoff << PAGE_SHIFT, size,
+		       &phys) == 0) {
+		image_mem = jailhouse_ioremap(phys, 0, size);
+		if (image_mem) {
+			flush_image(image_mem, size);
+			vunmap(image_mem);
+		} else {
+			pr_err("jailhouse: Unable to map cell RAM at %08llx "
+			       "for cache maintenance\n",
+			       (unsigned long long)phys);
+		}
+	}
+
+	atomic_dec(&cell->image_mappings);
+}
+
+static const struct vm_operations_struct cell_image_vm_ops = {
+	.open = cell_image_vm_open,
+	.close = cell_image_vm_close,
+};
+
+/*
+ * Maps the loadable memory of a cell at the address given by the mmap
+ * offset into the caller, so that images can be read into it directly.
+ * Like JAILHOUSE_CELL_LOAD, this puts the cell into loadable state.
+ */
+int jailhouse_cell_mmap(unsigned int cell_id, struct vm_area_struct *vma)
+{
+	unsigned long size = vma->vm_end - vma->vm_start;
+	struct jailhouse_cell_id id = {
+		.id = cell_id,
+	};
+	struct cell *cell;
+	u64 phys;
+	int err;
+
+	if (!(vma->vm_flags & VM_SHARED))
+		return -EINVAL;
+
+	err = cell_management_prologue(&id, &cell);
+	if (err)
+		return err;
+
+	err = image_phys(cell, (u64)vma->vm_pgoff << PAGE_SHIFT, size, &phys);
+	if (err)
+		goto unlock_out;
+
+	err = jailhouse_call_arg1(JAILHOUSE_HC_CELL_SET_LOADABLE, cell->id);
+	if (err)
+		goto unlock_out;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,3,0)
+	vma->vm_flags |= VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP;
+#else
+	vm_flags_set(vma, VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP);
+#endif
+	err = remap_pfn_range(vma, vma->vm_start, phys >> PAGE_SHIFT, size,
+			      vma->vm_page_prot);
+	if (err)
+		goto unlock_out;
+
+	vma->vm_private_data = cell;
+	vma->vm_ops = &cell_image_vm_ops;
+	cell_image_vm_open(vma);
+
+unlock_out:
+	mutex_unlock(&jailhouse_lock);
+
+	return err;
+}
+
 int jailhouse_cmd_cell_start(const char __user *arg)
 {
 	struct jailhouse_cell_id cell_id;
@@ -423,23 +647,263 @@ int jailhouse_cmd_cell_start(const char __user *arg)
 	if (err)
 		return err;
 
-	err = jailhouse_call_arg1(JAILHOUSE_HC_CELL_START, cell->id);
+	if (atomic_read(&cell->image_mappings))
+		err = -EBUSY;
+	else
+		err = jailhouse_call_arg1(JAILHOUSE_HC_CELL_START, cell->id);
+
+	mutex_unlock(&jailhouse_lock);
+
+	return err;
+}
+
+int jailhouse_cmd_cell_memguard(struct jailhouse_cell_memguard __user *arg)
+{
+	struct jailhouse_cell_memguard *mg;
+	struct cell *cell;
+	int err;
+
+	mg = kmalloc(sizeof(struct jailhouse_cell_memguard),
+		     GFP_USER | __GFP_NOWARN);
+	if (!mg)
+		return -ENOMEM;
+
+	if (copy_from_user(mg, arg, sizeof(struct jailhouse_cell_memguard))) {
+		err = -EFAULT;
+		goto out_free;
+	}
+
+	err = cell_management_prologue(&mg->cell_id, &cell);
+	if (err)
+		goto out_free;
+
+	err = jailhouse_call_arg2(JAILHOUSE_HC_MEMGUARD_CELL_SET, cell->id,
+				  __pa(&mg->params));
+	if (err)
+		pr_err("Jailhouse: unable to set memguard parameters "
+		       "for cell \"%s\"\n", cell->name);
+	else
+		jailhouse_emc_cell_memguard(cell, &mg->params);
+
+	mutex_unlock(&jailhouse_lock);
+
+out_free:
+	kfree(mg);
+
+	return err;
+}
+
+int jailhouse_cmd_cell_recolor(struct jailhouse_cell_recolor __user *arg)
+{
+	struct jailhouse_cell_recolor recolor;
+	struct cell *cell;
+	int err;
+
+	if (copy_from_user(&recolor, arg, sizeof(recolor)))
+		return -EFAULT;
+
+	err = cell_management_prologue(&recolor.cell_id, &cell);
+	if (err)
+		return err;
+
+	if (atomic_read(&cell->image_mappings))
+		err = -EBUSY;
+	else
+		err = jailhouse_call_arg2(JAILHOUSE_HC_CELL_RECOLOR, cell->id,
+					  recolor.colors);
+	if (err)
+		pr_err("Jailhouse: unable to recolor cell \"%s\"\n",
+		       cell->name);
+	else
+		pr_info("Recolored Jailhouse cell \"%s\"\n", cell->name);
 
 	mutex_unlock(&jailhouse_lock);
 
 	return err;
 }
 
+int jailhouse_cmd_cell_cpu_move(struct jailhouse_cell_cpu_move __user *arg)
+{
+	struct jailhouse_cell_cpu_move cpu_move;
+	struct cell *cell, *iter, *owner = NULL;
+	unsigned int cpu;
+	int err;
+
+	if (copy_from_user(&cpu_move, arg, sizeof(cpu_move)))
+		return -EFAULT;
+
+	err = cell_management_prologue(&cpu_move.cell_id, &cell);
+	if (err)
+		return err;
+
+	cpu = cpu_move.cpu;
+	if (cpu < nr_cpu_ids)
+		list_for_each_entry(iter, &cells, entry)
+			if (cpumask_test_cpu(cpu, &iter->cpus_assigned))
+				owner = iter;
+	if (owner == NULL || owner == cell) {
+		err = -EINVAL;
+		goto unlock_out;
+	}
+
+	/* A root cell CPU has to be off-line in Linux before it is lent. */
+	if (owner == root_cell && cpu_online(cpu)) {
+		err = remove_cpu(cpu);
+		if (err)
+			goto unlock_out;
+		cpumask_set_cpu(cpu, &offlined_cpus);
+	}
+
+	err = jailhouse_call_arg2(JAILHOUSE_HC_CELL_CPU_MOVE, cell->id, cpu);
+	if (err) {
+		if (cpumask_test_cpu(cpu, &offlined_cpus) &&
+		    owner == root_cell && add_cpu(cpu) == 0)
+			cpumask_clear_cpu(cpu, &offlined_cpus);
+		pr_err("Jailhouse: unable to move CPU %d to cell \"%s\"\n",
+		       cpu, cell->name);
+		goto unlock_out;
+	}
+
+	cpumask_clear_cpu(cpu, &owner->cpus_assigned);
+	cpumask_set_cpu(cpu, &cell->cpus_assigned);
+
+	if (cell == root_cell && cpumask_test_cpu(cpu, &offlined_cpus)) {
+		if (add_cpu(cpu) != 0)
+			pr_err("Jailhouse: failed to bring CPU %d back online\n",
+			       cpu);
+		cpumask_clear_cpu(cpu, &offlined_cpus);
+	}
+
+	pr_info("Moved CPU %d to Jailhouse cell \"%s\"\n", cpu, cell->name);
+
+unlock_out:
+	mutex_unlock(&jailhouse_lock);
+
+	return err;
+}
+
+int jailhouse_cmd_cell_mem_resize(
+	struct jailhouse_cell_mem_resize __user *arg)
+{
+	struct jailhouse_cell_mem_resize resize;
+	struct cell *cell;
+	int err;
+
+	if (copy_from_user(&resize, arg, sizeof(resize)))
+		return -EFAULT;
+
+	if (resize.size > ULONG_MAX)
+		return -EINVAL;
+
+	err = cell_management_prologue(&resize.cell_id, &cell);
+	if (err)
+		return err;
+
+	if (cell == root_cell)
+		err = -EINVAL;
+	else
+		err = jailhouse_call_arg2(JAILHOUSE_HC_CELL_MEM_RESIZE,
+					  cell->id, resize.size);
+	if (err)
+		pr_err("Jailhouse: unable to resize memory of cell \"%s\"\n",
+		       cell->name);
+	else
+		pr_info("Resized memory of Jailhouse cell \"%s\" to %llu "
+			"MiB\n", cell->name, resize.size >> 20);
+
+	mutex_unlock(&jailhouse_lock);
+
+	return err;
+}
+
+/* bounded by the temporary mappings of the hypervisor */
+#define SNAPSHOT_MAX_SIZE	(16 * PAGE_SIZE)
+
+static int cell_transfer_state(struct jailhouse_cell_snapshot_args __user *arg,
+			       bool restore)
+{
+	struct jailhouse_cell_snapshot_args args;
+	struct jailhouse_cell_snapshot *snapshot;
+	void __user *buffer;
+	struct cell *cell;
+	int err;
+
+	if (copy_from_user(&args, arg, sizeof(args)))
+		return -EFAULT;
+
+	if (args.size < sizeof(*snapshot) || args.size > SNAPSHOT_MAX_SIZE)
+		return -EINVAL;
+	buffer = (void __user *)(unsigned long)args.buffer;
+
+	snapshot = kzalloc(args.size, GFP_USER | __GFP_NOWARN);
+	if (!snapshot)
+		return -ENOMEM;
+
+	if (restore && copy_from_user(snapshot, buffer, args.size)) {
+		err = -EFAULT;
+		goto out_free;
+	}
+	snapshot->size = args.size;
+
+	err = cell_management_prologue(&args.cell_id, &cell);
+	if (err)
+		goto out_free;
+
+	if (cell == root_cell)
+		err = -EINVAL;
+	else if (atomic_read(&cell->image_mappings))
+		err = -EBUSY;
+	else
+		err = jailhouse_call_arg2(restore ? JAILHOUSE_HC_CELL_RESTORE :
+					  JAILHOUSE_HC_CELL_SNAPSHOT,
+					  cell->id, __pa(snapshot));
+	if (err)
+		pr_err("Jailhouse: unable to %s cell \"%s\"\n",
+		       restore ? "restore" : "save", cell->name);
+	else
+		pr_info("%s Jailhouse cell \"%s\"\n",
+			restore ? "Restored" : "Saved", cell->name);
+
+	mutex_unlock(&jailhouse_lock);
+
+	if (!err && !restore && copy_to_user(buffer, snapshot, args.size))
+		err = -EFAULT;
+
+out_free:
+	kfree(snapshot);
+
+	return err;
+}
+
+int jailhouse_cmd_cell_snapshot(
+	struct jailhouse_cell_snapshot_args __user *arg)
+{
+	return cell_transfer_state(arg, false);
+}
+
+int jailhouse_cmd_cell_restore(
+	struct jailhouse_cell_snapshot_args __user *arg)
+{
+	return cell_transfer_state(arg, true);
+}
+
 static int cell_destroy(struct cell *cell)
 {
 	unsigned int cpu;
 	int err;
 
+	if (atomic_read(&cell->image_mappings))
+		return -EBUSY;
+
 	err = jailhouse_call_arg1(JAILHOUSE_HC_CELL_DESTROY, cell->id);
 	if (err)
 		return err;
 
+	rcu_expedite_gp();
 	for_each_cpu(cpu, &cell->cpus_assigned) {
+		/* a time-shared CPU stays with the other cell */
+		if (cpu_time_shared(cpu, cell))
+			continue;
 		if (cpumask_test_cpu(cpu, &offlined_cpus)) {
 			if (add_cpu(cpu) != 0)
 				pr_err("Jailhouse: failed to bring CPU %d "
@@ -448,7 +912,12 @@ static int cell_destroy(struct cell *cell)
 		}
 		cpumask_set_cpu(cpu, &root_cell->cpus_assigned);
 	}
+	rcu_unexpedite_gp();
 
+	/*
+	 * Only now that the CPUs are back, so that the root cell drivers size
+	 * their queues and vectors for all of them.
+	 */
 	jailhouse_pci_do_all_devices(cell, JAILHOUSE_PCI_TYPE_DEVICE,
 	                             JAILHOUSE_PCI_ACTION_RELEASE);
 
@@ -33,10 +33,17 @@ struct cell {
 	u32 num_memory_regions;
 	struct jailhouse_memory *memory_regions;
 	u64 color_root_map_offset;
+	/** Root mappings of the cell's memory, see jailhouse_cell_mmap() */
+	atomic_t image_mappings;
 #ifdef CONFIG_PCI
 	u32 num_pci_devices;
 	struct jailhouse_pci_device *pci_devices;
 #endif /* CONFIG_PCI */
+#if defined(CONFIG_ARCH_TEGRA) && defined(CONFIG_INTERCONNECT)
+	/** EMC vote on behalf of the cell, see jailhouse_emc_cell_setup() */
+	struct icc_path *emc_path;
+	u32 emc_floor_kbps;
+#endif
 };
 
 extern struct cell *root_cell;
@@ -51,7 +58,17 @@ int jailhouse_cmd_cell_create(struct jailhouse_cell_create __user *arg);
 int jailhouse_cmd_cell_load(struct jailhouse_cell_load __user *arg);
 int jailhouse_cmd_cell_start(const char __user *arg);
 int jailhouse_cmd_cell_destroy(const char __user *arg);
-int jailhouse_cmd_cell_memguard(struct jailhouse_memguard __user *arg);
+int jailhouse_cmd_cell_memguard(struct jailhouse_cell_memguard __user *arg);
+int jailhouse_cmd_cell_recolor(struct jailhouse_cell_recolor __user *arg);
+int jailhouse_cmd_cell_map_image(struct jailhouse_cell_id __user *arg);
+int jailhouse_cmd_cell_cpu_move(struct jailhouse_cell_cpu_move __user *arg);
+int jailhouse_cmd_cell_mem_resize(
+	struct jailhouse_cell_mem_resize __user *arg);
+int jailhouse_cmd_cell_snapshot(
+	struct jailhouse_cell_snapshot_args __user *arg);
+int jailhouse_cmd_cell_restore(
+	struct jailhouse_cell_snapshot_args __user *arg);
+int jailhouse_cell_mmap(unsigned int cell_id, struct vm_area_struct *vma);
 
 int jailhouse_cmd_cell_destroy_non_root(void);
 
@@ -0,0 +1,104 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * EMC votes of the root cell on behalf of the non-root cells: inmates
+ * cannot reach the Tegra interconnect provider, so nothing keeps the EMC
+ * from running too slow for a cell's memory guarantee while the root cell
+ * is idle. Each non-root cell gets its own interconnect path from the CPU
+ * cluster it runs on, and the root cell turns the cell-wide memguard
+ * budget into a bandwidth floor on that path.
+ */
+
+#include <linux/interconnect.h>
+#include <linux/math64.h>
+#include <asm/smp_plat.h>
+#include <dt-bindings/interconnect/tegra_icc_id.h>
+
+#include "emc.h"
+
+/* Memory traffic charged to one memguard event: one cache line */
+#define EMC_BYTES_PER_EVENT	64
+
+static const int emc_cluster_icc_id[] = {
+	TEGRA_ICC_CPU_CLUSTER0,
+	TEGRA_ICC_CPU_CLUSTER1,
+	TEGRA_ICC_CPU_CLUSTER2,
+};
+
+void jailhouse_emc_cell_setup(struct cell *cell)
+{
+	unsigned int cpu = cpumask_first(&cell->cpus_assigned);
+	unsigned int cluster;
+	struct icc_path *path;
+
+	if (cpu >= nr_cpu_ids)
+		return;
+
+	cluster = MPIDR_AFFINITY_LEVEL(cpu_logical_map(cpu), 2);
+	if (cluster >= ARRAY_SIZE(emc_cluster_icc_id))
+		return;
+
+	path = icc_get(NULL, emc_cluster_icc_id[cluster], TEGRA_ICC_MASTER);
+	if (IS_ERR_OR_NULL(path)) {
+		pr_warn("jailhouse: no EMC vote for cell \"%s\" (%ld)\n",
+			cell->name, PTR_ERR_OR_ZERO(path));
+		return;
+	}
+
+	cell->emc_path = path;
+}
+
+void jailhouse_emc_cell_cleanup(struct cell *cell)
+{
+	/* drops the vote of the cell */
+	icc_put(cell->emc_path);
+	cell->emc_path = NULL;
+	cell->emc_floor_kbps = 0;
+}
+
+/*
+ * Cell-wide budgets are shared by all the CPUs of the cell, so the budget
+ * of one period is what the whole cell may move. Without a budget the cell
+ * is not regulated and has no guarantee to back.
+ */
+static u32 emc_budget_kbps(const struct memguard_params *params)
+{
+	unsigned int budget = params->budget_memory;
+	u64 kbps;
+
+	if (params->num_events > 0)
+		budget = params->events[0].budget_memory;
+	if (budget == 0 || params->budget_time == 0)
+		return 0;
+
+	/* events per us to kB/s */
+	kbps = div64_u64((u64)budget * EMC_BYTES_PER_EVENT * 1000,
+			 params->budget_time);
+
+	return min_t(u64, kbps, U32_MAX);
+}
+
+void jailhouse_emc_cell_memguard(struct cell *cell,
+				 const struct memguard_params *params)
+{
+	u32 kbps = emc_budget_kbps(params);
+	int err;
+
+	if (!cell->emc_path || kbps == cell->emc_floor_kbps)
+		return;
+
+	/* peak bandwidth of a CPU cluster request is a floor on the EMC */
+	err = icc_set_bw(cell->emc_path, 0, kbps);
+	if (err) {
+		pr_warn("jailhouse: failed to set EMC floor of cell \"%s\" "
+			"(%d)\n", cell->name, err);
+		return;
+	}
+
+	cell->emc_floor_kbps = kbps;
+}
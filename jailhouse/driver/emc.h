@@ -0,0 +1,40 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_DRIVER_EMC_H
+#define _JAILHOUSE_DRIVER_EMC_H
+
+#include "cell.h"
+
+#if defined(CONFIG_ARCH_TEGRA) && defined(CONFIG_INTERCONNECT)
+
+void jailhouse_emc_cell_setup(struct cell *cell);
+void jailhouse_emc_cell_cleanup(struct cell *cell);
+void jailhouse_emc_cell_memguard(struct cell *cell,
+				 const struct memguard_params *params);
+
+#else /* !CONFIG_ARCH_TEGRA || !CONFIG_INTERCONNECT */
+
+static inline void jailhouse_emc_cell_setup(struct cell *cell)
+{
+}
+
+static inline void jailhouse_emc_cell_cleanup(struct cell *cell)
+{
+}
+
+static inline void
+jailhouse_emc_cell_memguard(struct cell *cell,
+			    const struct memguard_params *params)
+{
+}
+
+#endif /* !CONFIG_ARCH_TEGRA || !CONFIG_INTERCONNECT */
+
+#endif /* !_JAILHOUSE_DRIVER_EMC_H */
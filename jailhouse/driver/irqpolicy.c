@@ -0,0 +1,158 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Placement of the root cell's device interrupts: the irq_policies of the
+ * system config steer IRQs by handler name, or the INTx lines of the virtual
+ * PCI devices, to housekeeping CPUs and give their threaded handlers a
+ * real-time priority. This keeps interrupt load, and the NAPI polling that
+ * follows it, away from the CPUs next to the non-root cells. Rules are
+ * applied on enable and again after each cell creation, catching handlers
+ * that were requested in between.
+ */
+
+#include <linux/cpumask.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/irqdesc.h>
+#include <linux/pci.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/sched/task.h>
+#include <uapi/linux/sched/types.h>
+
+#include "irqpolicy.h"
+
+/* Threaded handlers sharing one line that get a priority */
+#define IRQ_POLICY_MAX_THREADS	4
+
+static struct jailhouse_irq_policy irq_policies[JAILHOUSE_MAX_IRQ_POLICIES];
+static unsigned int num_irq_policies;
+static int vpci_domain = -1;
+
+void jailhouse_irq_policy_init(const struct jailhouse_system *config)
+{
+	unsigned int n;
+
+	num_irq_policies = min_t(unsigned int,
+				 config->platform_info.num_irq_policies,
+				 JAILHOUSE_MAX_IRQ_POLICIES);
+	memcpy(irq_policies, config->platform_info.irq_policies,
+	       sizeof(irq_policies[0]) * num_irq_policies);
+	for (n = 0; n < num_irq_policies; n++)
+		irq_policies[n].name[JAILHOUSE_IRQ_POLICY_NAMELEN] = 0;
+
+	vpci_domain = config->platform_info.pci_is_virtual ?
+		config->platform_info.pci_domain : -1;
+}
+
+/*
+ * Returns the number of threads of the line stored in threads, with a
+ * reference held, or -1 if no handler of the line matches the policy.
+ */
+static int irq_policy_match(unsigned int irq,
+			    const struct jailhouse_irq_policy *policy,
+			    struct task_struct **threads)
+{
+	size_t len = strlen(policy->name);
+	struct irqaction *action;
+	struct irq_desc *desc;
+	unsigned long flags;
+	bool match = !len;
+	int n = 0;
+
+	rcu_read_lock();
+	desc = irq_to_desc(irq);
+	if (!desc) {
+		rcu_read_unlock();
+		return -1;
+	}
+
+	raw_spin_lock_irqsave(&desc->lock, flags);
+	for (action = desc->action; action; action = action->next)
+		if (action->name && strncmp(action->name, policy->name,
+					    len) == 0)
+			match = true;
+	for (action = desc->action; match && action; action = action->next)
+		if (action->thread && n < IRQ_POLICY_MAX_THREADS)
+			threads[n++] = get_task_struct(action->thread);
+	raw_spin_unlock_irqrestore(&desc->lock, flags);
+	rcu_read_unlock();
+
+	return match ? n : -1;
+}
+
+static void irq_policy_set(unsigned int irq,
+			   const struct jailhouse_irq_policy *policy)
+{
+	struct task_struct *threads[IRQ_POLICY_MAX_THREADS];
+	struct sched_attr attr = {
+		.size = sizeof(attr),
+		.sched_policy = SCHED_FIFO,
+		.sched_priority = policy->rt_priority,
+	};
+	struct cpumask mask;
+	unsigned int cpu;
+	int n, err;
+
+	n = irq_policy_match(irq, policy, threads);
+	if (n < 0)
+		return;
+
+	if (policy->cpus) {
+		cpumask_clear(&mask);
+		for_each_online_cpu(cpu)
+			if (cpu < 64 && policy->cpus & (1ULL << cpu))
+				cpumask_set_cpu(cpu, &mask);
+		err = cpumask_empty(&mask) ? -EINVAL :
+			irq_set_affinity(irq, &mask);
+		if (err)
+			pr_warn("jailhouse: cannot steer IRQ %u: %d\n", irq,
+				err);
+	}
+
+	while (n-- > 0) {
+		if (policy->rt_priority) {
+			err = sched_setattr_nocheck(threads[n], &attr);
+			if (err)
+				pr_warn("jailhouse: cannot set priority of "
+					"%s: %d\n", threads[n]->comm, err);
+		}
+		put_task_struct(threads[n]);
+	}
+}
+
+static void irq_policy_apply_vpci(const struct jailhouse_irq_policy *policy)
+{
+	struct jailhouse_irq_policy any = *policy;
+	struct pci_dev *dev = NULL;
+
+	if (vpci_domain < 0)
+		return;
+
+	/* the line is selected by device, not by handler name */
+	any.name[0] = 0;
+	for_each_pci_dev(dev)
+		if (pci_domain_nr(dev->bus) == vpci_domain && dev->irq)
+			irq_policy_set(dev->irq, &any);
+}
+
+void jailhouse_irq_policy_apply(void)
+{
+	const struct jailhouse_irq_policy *policy;
+	unsigned int n, irq;
+
+	for (n = 0; n < num_irq_policies; n++) {
+		policy = &irq_policies[n];
+		if (policy->flags & JAILHOUSE_IRQ_POLICY_VPCI)
+			irq_policy_apply_vpci(policy);
+		if (!policy->name[0])
+			continue;
+		for (irq = 1; irq < nr_irqs; irq++)
+			irq_policy_set(irq, policy);
+	}
+}
@@ -0,0 +1,18 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_DRIVER_IRQPOLICY_H
+#define _JAILHOUSE_DRIVER_IRQPOLICY_H
+
+#include <jailhouse/cell-config.h>
+
+void jailhouse_irq_policy_init(const struct jailhouse_system *config);
+void jailhouse_irq_policy_apply(void);
+
+#endif /* !_JAILHOUSE_DRIVER_IRQPOLICY_H */
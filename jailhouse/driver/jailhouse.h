@@ -43,6 +43,9 @@
 #include <linux/types.h>
 #include <jailhouse/qos-common.h>
 #include <jailhouse/memguard-common.h>
+#include <jailhouse/perf.h>
+#include <jailhouse/trace.h>
+#include <jailhouse/hypercall.h>
 
 #define JAILHOUSE_CELL_ID_NAMELEN	31
 
@@ -77,11 +80,77 @@ struct jailhouse_memguard {
 	struct memguard_params params;
 };
 
+struct jailhouse_cell_memguard {
+	struct jailhouse_cell_id cell_id;
+	struct memguard_params params;
+};
+
+struct jailhouse_cell_recolor {
+	struct jailhouse_cell_id cell_id;
+	__u64 colors;
+};
+
+struct jailhouse_cell_snapshot_args {
+	struct jailhouse_cell_id cell_id;
+	/** User buffer holding a struct jailhouse_cell_snapshot. */
+	__u64 buffer;
+	__u32 size;
+	__u32 padding;
+};
+
+struct jailhouse_cell_cpu_move {
+	/** Destination cell, the root cell to return the CPU. */
+	struct jailhouse_cell_id cell_id;
+	__u32 cpu;
+	__u32 padding;
+};
+
+struct jailhouse_cell_mem_resize {
+	struct jailhouse_cell_id cell_id;
+	/** New size of the JAILHOUSE_MEM_RESIZABLE region. */
+	__u64 size;
+};
+
+struct jailhouse_memguard_batch {
+	__u32 num_cpus;
+	__u32 padding;
+	struct memguard_cpu_params cpus[];
+};
+
 struct jailhouse_qos_args {
 	__u32 num_settings;
 	struct qos_setting settings[];
 };
 
+struct jailhouse_enable_cached {
+	/** User buffer holding the system configuration. */
+	__u64 config;
+	/** User buffer of the root cell page-table image, see
+	 * jailhouse/pt-cache.h. */
+	__u64 cache;
+	/** Size of the image in the buffer, 0 if there is none. Returns the
+	 * size of the image exported after the hypervisor built the tables,
+	 * 0 if it installed the given image or could not export one. */
+	__u32 cache_size;
+	/** Size of the buffer. */
+	__u32 buffer_size;
+};
+
+struct jailhouse_cpu_schedule_args {
+	/** Time-shared CPU, see JAILHOUSE_CELL_CPU_SHARED. */
+	__u32 cpu;
+	__u32 padding;
+	struct jailhouse_cpu_schedule schedule;
+};
+
+struct jailhouse_shmem_args {
+	/** JAILHOUSE_SHMEM_GET or JAILHOUSE_SHMEM_PUT. */
+	__u32 op;
+	__u32 padding;
+	/** Segment of the root cell, updated on return. */
+	struct jailhouse_shmem_segment segment;
+};
+
 #define JAILHOUSE_CELL_ID_UNUSED	(-1)
 
 #define JAILHOUSE_ENABLE		_IOW(0, 0, void *)
@@ -92,5 +161,34 @@ struct jailhouse_qos_args {
 #define JAILHOUSE_CELL_DESTROY		_IOW(0, 5, struct jailhouse_cell_id)
 #define JAILHOUSE_MEMGUARD		_IOW(0, 6, struct jailhouse_memguard)
 #define JAILHOUSE_QOS			_IOW(0, 7, struct jailhouse_qos_args)
+#define JAILHOUSE_CELL_MEMGUARD		_IOW(0, 8, struct jailhouse_cell_memguard)
+#define JAILHOUSE_MEMGUARD_BATCH	_IOW(0, 9, struct jailhouse_memguard_batch)
+#define JAILHOUSE_CELL_RECOLOR		_IOW(0, 10, struct jailhouse_cell_recolor)
+/*
+ * Selects the cell whose loadable memory a subsequent mmap of the device
+ * exposes, the mmap offset being the cell's (guest) address.
+ */
+#define JAILHOUSE_CELL_MAP_IMAGE	_IOW(0, 11, struct jailhouse_cell_id)
+#define JAILHOUSE_CELL_SNAPSHOT		\
+	_IOW(0, 12, struct jailhouse_cell_snapshot_args)
+#define JAILHOUSE_CELL_RESTORE		\
+	_IOW(0, 13, struct jailhouse_cell_snapshot_args)
+#define JAILHOUSE_CELL_CPU_MOVE		\
+	_IOW(0, 14, struct jailhouse_cell_cpu_move)
+#define JAILHOUSE_CELL_MEM_RESIZE	\
+	_IOW(0, 15, struct jailhouse_cell_mem_resize)
+#define JAILHOUSE_QOS_PROFILE_SET	_IOW(0, 16, struct qos_profile_args)
+/* The argument is the profile ID itself */
+#define JAILHOUSE_QOS_PROFILE_APPLY	_IO(0, 17)
+#define JAILHOUSE_MODE_SWITCH		_IOW(0, 18, struct mode_switch_args)
+#define JAILHOUSE_PERF			_IOW(0, 19, struct perf_args)
+/* The argument is the mask of the TRACE_* events to enable */
+#define JAILHOUSE_TRACE			_IO(0, 20)
+#define JAILHOUSE_ENABLE_CACHED		\
+	_IOWR(0, 21, struct jailhouse_enable_cached)
+#define JAILHOUSE_CPU_SCHEDULE		\
+	_IOW(0, 22, struct jailhouse_cpu_schedule_args)
+#define JAILHOUSE_SHMEM_SEGMENT		\
+	_IOWR(0, 23, struct jailhouse_shmem_args)
 
 #endif /* !_JAILHOUSE_DRIVER_H */
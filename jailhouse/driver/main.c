@@ -31,8 +31,10 @@
 #include <linux/uaccess.h>
 #include <linux/reboot.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include <linux/io.h>
 #include <linux/ioport.h>
+#include <linux/spinlock.h>
 #include <asm/barrier.h>
 #include <asm/smp.h>
 #include <asm/cacheflush.h>
@@ -50,13 +52,16 @@
 #endif
 
 #include "cell.h"
+#include "irqpolicy.h"
 #include "jailhouse.h"
 #include "main.h"
 #include "pci.h"
 #include "sysfs.h"
 
+#include <jailhouse/cpu_stats.h>
 #include <jailhouse/header.h>
 #include <jailhouse/hypercall.h>
+#include <jailhouse/pt-cache.h>
 #include <generated/version.h>
 
 #ifdef CONFIG_X86_32
@@ -95,6 +100,8 @@ extern char __hyp_stub_vectors[];
 struct console_state {
 	unsigned int head;
 	unsigned int last_console_id;
+	/* cell selected by JAILHOUSE_CELL_MAP_IMAGE, or -1 */
+	int map_cell_id;
 };
 
 DEFINE_MUTEX(jailhouse_lock);
@@ -106,8 +113,18 @@ static unsigned long hv_core_and_percpu_size;
 static atomic_t call_done;
 static int error_code;
 static struct jailhouse_virt_console* volatile console_page;
+struct memguard_telemetry *memguard_telemetry;
+struct irq_latency *irq_latency;
+struct perf_ring *perf_rings;
+/* keeps perf_rings and cpu_stats mapped for the exported readers */
+static DEFINE_SPINLOCK(hv_pages_lock);
+struct trace_ring *trace_rings;
+struct jailhouse_cpu_stats *cpu_stats;
+phys_addr_t cpu_stats_phys;
 static bool console_available;
 static struct resource *hypervisor_mem_res;
+static struct resource *hypervisor_pool_res;
+static struct resource *shmem_pool_res;
 
 static typeof(ioremap_page_range) *ioremap_page_range_sym;
 #ifdef CONFIG_X86
@@ -333,10 +350,129 @@ static void jailhouse_firmware_free(void)
 				   resource_size(hypervisor_mem_res));
 		hypervisor_mem_res = NULL;
 	}
+	if (hypervisor_pool_res) {
+		release_mem_region(hypervisor_pool_res->start,
+				   resource_size(hypervisor_pool_res));
+		hypervisor_pool_res = NULL;
+	}
+	if (shmem_pool_res) {
+		release_mem_region(shmem_pool_res->start,
+				   resource_size(shmem_pool_res));
+		shmem_pool_res = NULL;
+	}
+	memguard_telemetry = NULL;
+	irq_latency = NULL;
+	spin_lock_irq(&hv_pages_lock);
+	perf_rings = NULL;
+	cpu_stats = NULL;
+	spin_unlock_irq(&hv_pages_lock);
+	trace_rings = NULL;
 	vunmap(hypervisor_mem);
 	hypervisor_mem = NULL;
 }
 
+/**
+ * jailhouse_perf_read() - copy new PMU samples of one CPU
+ * @cpu:	CPU whose ring to read
+ * @pos:	ring position of the caller, advanced past the copied samples
+ * @samples:	buffer of at least @max samples
+ * @max:	size of @samples
+ *
+ * For in-kernel profilers that merge the inmate samples into their own
+ * stream. Samples the hypervisor overwrote before the caller came back are
+ * skipped. May be called from atomic context.
+ *
+ * Return: number of samples copied, -ENODEV if the hypervisor does not
+ * sample, -EINVAL for a CPU without a ring.
+ */
+int jailhouse_perf_read(unsigned int cpu, unsigned int *pos,
+			struct perf_sample *samples, unsigned int max)
+{
+	unsigned int head, tail, first, start, n = 0;
+	struct perf_ring *ring;
+	unsigned long flags;
+	int drop;
+
+	if (cpu >= PERF_CPUS)
+		return -EINVAL;
+
+	spin_lock_irqsave(&hv_pages_lock, flags);
+	if (!perf_rings) {
+		spin_unlock_irqrestore(&hv_pages_lock, flags);
+		return -ENODEV;
+	}
+	ring = &perf_rings[cpu];
+
+	/* the hypervisor may write while we copy, see sysfs memguard_periods */
+	head = READ_ONCE(ring->head);
+	smp_rmb();
+
+	first = *pos;
+	if ((int)(head - first) > PERF_ENTRIES - 1 || (int)(head - first) < 0)
+		first = head - (PERF_ENTRIES - 1);
+	start = first;
+
+	for (; n < max && (int)(head - first) > 0; first++, n++)
+		samples[n] = ring->samples[first % PERF_ENTRIES];
+
+	smp_rmb();
+	tail = READ_ONCE(ring->head);
+	spin_unlock_irqrestore(&hv_pages_lock, flags);
+
+	/* drop the samples overwritten during the copy */
+	drop = min_t(int, (int)(tail - PERF_ENTRIES + 1 - start), n);
+	if (drop > 0) {
+		n -= drop;
+		memmove(samples, samples + drop, n * sizeof(*samples));
+	}
+
+	*pos = first;
+
+	return n;
+}
+EXPORT_SYMBOL_GPL(jailhouse_perf_read);
+
+/**
+ * jailhouse_dsu_read() - copy the DSU counter partition of a cluster
+ * @cluster:	DSU cluster
+ * @stats:	consistent copy of the published block
+ *
+ * For DSU PMU drivers: they must leave the counters from
+ * @stats->first_hyp_cnt on to the hypervisor and may report @stats->count
+ * as read-only events. May be called from atomic context.
+ *
+ * Return: 0 on success, -ENODEV if the hypervisor does not regulate the
+ * DSU, -EINVAL for an invalid cluster.
+ */
+int jailhouse_dsu_read(unsigned int cluster, struct jailhouse_dsu_stats *stats)
+{
+	struct jailhouse_dsu_stats *page;
+	unsigned long flags;
+	unsigned int seq;
+
+	if (cluster >= JAILHOUSE_DSU_STATS_CLUSTERS)
+		return -EINVAL;
+
+	spin_lock_irqsave(&hv_pages_lock, flags);
+	if (!cpu_stats) {
+		spin_unlock_irqrestore(&hv_pages_lock, flags);
+		return -ENODEV;
+	}
+	page = &((struct jailhouse_stats_page *)cpu_stats)->dsu[cluster];
+
+	/* retry while the hypervisor updates the block, see cpu_stats.h */
+	do {
+		seq = READ_ONCE(page->seq);
+		smp_rmb();
+		*stats = *page;
+		smp_rmb();
+	} while ((seq & 1) || READ_ONCE(page->seq) != seq);
+	spin_unlock_irqrestore(&hv_pages_lock, flags);
+
+	return stats->num_cnt ? 0 : -ENODEV;
+}
+EXPORT_SYMBOL_GPL(jailhouse_dsu_read);
+
 int jailhouse_console_dump_delta(char *dst, unsigned int head,
 				 unsigned int *miss)
 {
@@ -367,7 +503,73 @@ console_free_out:
 }
 
 /* See Documentation/bootstrap-interface.txt */
-static int jailhouse_cmd_enable(struct jailhouse_system __user *arg)
+/* Period of the flush of the deferred hypervisor messages */
+#define CONSOLE_FLUSH_INTERVAL	msecs_to_jiffies(100)
+
+static void jailhouse_console_flush(struct work_struct *work);
+static DECLARE_DELAYED_WORK(console_flush_work, jailhouse_console_flush);
+
+/*
+ * Let the hypervisor write out the messages the CPUs queued with
+ * printk_deferred. This moves the UART output of debug messages onto a root
+ * cell CPU in the background, away from the timing-sensitive paths.
+ */
+static void jailhouse_console_flush(struct work_struct *work)
+{
+	/* never wait for management calls, just try again next period */
+	if (mutex_trylock(&jailhouse_lock)) {
+		if (!jailhouse_enabled) {
+			mutex_unlock(&jailhouse_lock);
+			return;
+		}
+		jailhouse_call(JAILHOUSE_HC_CONSOLE_FLUSH);
+		mutex_unlock(&jailhouse_lock);
+	}
+
+	queue_delayed_work(system_unbound_wq, &console_flush_work,
+			   CONSOLE_FLUSH_INTERVAL);
+}
+
+/*
+ * Hand the page-table image of the root cell to the caller of
+ * JAILHOUSE_ENABLE_CACHED, unless the hypervisor installed the given one.
+ * Failing to export only costs the next enable the time to build the tables.
+ */
+static void jailhouse_export_pt_cache(struct jailhouse_header *header,
+				      struct jailhouse_enable_cached *cache)
+{
+	struct jailhouse_pt_cache *image;
+	unsigned long size;
+	long offset;
+
+	if (header->pt_cache_pages) {
+		cache->cache_size = 0;
+		return;
+	}
+
+	cache->cache_size = 0;
+	offset = (long)jailhouse_call_arg1(JAILHOUSE_HC_PT_CACHE,
+					   JAILHOUSE_PT_CACHE_EXPORT);
+	if (offset < 0) {
+		pr_warn("jailhouse: Exporting page tables failed (%ld)\n",
+			offset);
+		return;
+	}
+
+	image = (struct jailhouse_pt_cache *)(hypervisor_mem + offset);
+	size = (image->num_tables + 1) * JAILHOUSE_PT_CACHE_PAGE_SIZE;
+	if (size <= cache->buffer_size &&
+	    copy_to_user(u64_to_user_ptr(cache->cache), image, size) == 0)
+		cache->cache_size = size;
+	else
+		pr_warn("jailhouse: Page-table image of %lu bytes not "
+			"exported\n", size);
+
+	jailhouse_call_arg1(JAILHOUSE_HC_PT_CACHE, JAILHOUSE_PT_CACHE_RELEASE);
+}
+
+static int jailhouse_cmd_enable(struct jailhouse_system __user *arg,
+				struct jailhouse_enable_cached *cache)
 {
 	const struct firmware *hypervisor;
 	struct jailhouse_system config_header;
@@ -376,7 +578,7 @@ static int jailhouse_cmd_enable(struct jailhouse_system __user *arg)
 	struct jailhouse_header *header;
 	unsigned long remap_addr = 0;
 	void __iomem *console = NULL, *clock_reg = NULL;
-	unsigned long config_size;
+	unsigned long config_size, cache_offset = 0;
 	unsigned int clock_gates;
 	const char *fw_name;
 	long max_cpus;
@@ -464,6 +666,16 @@ static int jailhouse_cmd_enable(struct jailhouse_system __user *arg)
 	    config_size >= hv_mem->size - hv_core_and_percpu_size)
 		goto error_release_fw;
 
+	if (cache && cache->cache_size) {
+		/* the image follows the configuration, page-aligned */
+		cache_offset = hv_core_and_percpu_size +
+			ALIGN(config_size, JAILHOUSE_PT_CACHE_PAGE_SIZE);
+		if (cache->cache_size % JAILHOUSE_PT_CACHE_PAGE_SIZE != 0 ||
+		    cache_offset >= hv_mem->size ||
+		    cache->cache_size >= hv_mem->size - cache_offset)
+			goto error_release_fw;
+	}
+
 #ifdef JAILHOUSE_BORROW_ROOT_PT
 	remap_addr = JAILHOUSE_BASE;
 #endif
@@ -482,6 +694,32 @@ static int jailhouse_cmd_enable(struct jailhouse_system __user *arg)
 		goto error_release_fw;
 	}
 
+	/* the hypervisor maps and clears its pool reserve itself */
+	if (config_header.hypervisor_pool.size) {
+		hypervisor_pool_res =
+			request_mem_region(config_header.hypervisor_pool.phys_start,
+					   config_header.hypervisor_pool.size,
+					   "Jailhouse hypervisor pool");
+		if (!hypervisor_pool_res) {
+			pr_err("jailhouse: request_mem_region failed for "
+			       "hypervisor pool reserve.\n");
+			goto error_release_memreg;
+		}
+	}
+
+	/* segments of the pool are mapped on JAILHOUSE_SHMEM_SEGMENT */
+	if (config_header.shmem_pool.size) {
+		shmem_pool_res =
+			request_mem_region(config_header.shmem_pool.phys_start,
+					   config_header.shmem_pool.size,
+					   "Jailhouse shared memory pool");
+		if (!shmem_pool_res) {
+			pr_err("jailhouse: request_mem_region failed for "
+			       "shared memory pool.\n");
+			goto error_release_memreg;
+		}
+	}
+
 	/* Map physical memory region reserved for Jailhouse. */
 	hypervisor_mem = jailhouse_ioremap(hv_mem->phys_start, remap_addr,
 					   hv_mem->size);
@@ -493,6 +731,22 @@ static int jailhouse_cmd_enable(struct jailhouse_system __user *arg)
 
 	console_page = (struct jailhouse_virt_console*)
 		(hypervisor_mem + header->console_page);
+#ifdef CONFIG_ARM64
+	memguard_telemetry = (struct memguard_telemetry *)
+		(hypervisor_mem + header->memguard_telemetry_page);
+	cpu_stats = (struct jailhouse_cpu_stats *)
+		(hypervisor_mem + header->cpu_stats_page);
+	cpu_stats_phys = hv_mem->phys_start + header->cpu_stats_page;
+#endif
+	if (header->irq_latency_page)
+		irq_latency = (struct irq_latency *)
+			(hypervisor_mem + header->irq_latency_page);
+	if (header->perf_page)
+		perf_rings = (struct perf_ring *)
+			(hypervisor_mem + header->perf_page);
+	if (header->trace_page)
+		trace_rings = (struct trace_ring *)
+			(hypervisor_mem + header->trace_page);
 	last_console.valid = false;
 
 	/* Copy hypervisor's binary image at beginning of the memory region
@@ -535,6 +789,17 @@ static int jailhouse_cmd_enable(struct jailhouse_system __user *arg)
 		goto error_unmap;
 	}
 
+	if (cache_offset) {
+		if (copy_from_user(hypervisor_mem + cache_offset,
+				   u64_to_user_ptr(cache->cache),
+				   cache->cache_size)) {
+			err = -EFAULT;
+			goto error_unmap;
+		}
+		header->pt_cache_pages =
+			cache->cache_size / JAILHOUSE_PT_CACHE_PAGE_SIZE;
+	}
+
 	if (config->debug_console.clock_reg) {
 		clock_reg = ioremap(config->debug_console.clock_reg,
 				    sizeof(clock_gates));
@@ -627,6 +892,14 @@ static int jailhouse_cmd_enable(struct jailhouse_system __user *arg)
 #endif
 
 	jailhouse_enabled = true;
+	queue_delayed_work(system_unbound_wq, &console_flush_work,
+			   CONSOLE_FLUSH_INTERVAL);
+
+	if (cache)
+		jailhouse_export_pt_cache(header, cache);
+
+	jailhouse_irq_policy_init(&config_header);
+	jailhouse_irq_policy_apply();
 
 	mutex_unlock(&jailhouse_lock);
 
@@ -650,6 +923,14 @@ error_release_memreg:
 		release_mem_region(hypervisor_mem_res->start,
 				resource_size(hypervisor_mem_res));
 	hypervisor_mem_res = NULL;
+	if (hypervisor_pool_res)
+		release_mem_region(hypervisor_pool_res->start,
+				resource_size(hypervisor_pool_res));
+	hypervisor_pool_res = NULL;
+	if (shmem_pool_res)
+		release_mem_region(shmem_pool_res->start,
+				resource_size(shmem_pool_res));
+	shmem_pool_res = NULL;
 
 error_release_fw:
 	release_firmware(hypervisor);
@@ -662,6 +943,26 @@ error_unlock:
 	return err;
 }
 
+static int jailhouse_cmd_enable_cached(
+		struct jailhouse_enable_cached __user *arg)
+{
+	struct jailhouse_enable_cached cache;
+	int err;
+
+	if (copy_from_user(&cache, arg, sizeof(cache)))
+		return -EFAULT;
+
+	err = jailhouse_cmd_enable(
+		(struct jailhouse_system __user *)u64_to_user_ptr(cache.config),
+		&cache);
+	if (err)
+		return err;
+
+	if (put_user(cache.cache_size, &arg->cache_size))
+		return -EFAULT;
+	return 0;
+}
+
 static void leave_hypervisor(void *info)
 {
 	void *page;
@@ -771,6 +1072,39 @@ static int memguard_call_one_cpu(void *par)
 	return jailhouse_call_arg1(JAILHOUSE_HC_MEMGUARD_SET, __pa(params));
 }
 
+static int memguard_call_batch(struct memguard_cpu_params *cpus,
+			       unsigned int count)
+{
+	return jailhouse_call_arg2(JAILHOUSE_HC_MEMGUARD_BATCH_SET, count,
+				   __pa(cpus));
+}
+
+/* Same parameters on all online CPUs, with a single hypercall */
+static int memguard_call_online_cpus(struct memguard_params *params)
+{
+	struct memguard_cpu_params *cpus;
+	unsigned int count = 0, cpu;
+	int err;
+
+	cpus = kcalloc(num_online_cpus(), sizeof(struct memguard_cpu_params),
+		       GFP_KERNEL);
+	if (!cpus)
+		return -ENOMEM;
+
+	for_each_online_cpu(cpu) {
+		if (count == num_online_cpus())
+			break;
+		cpus[count].cpu = cpu;
+		cpus[count].params = *params;
+		count++;
+	}
+
+	err = memguard_call_batch(cpus, count);
+	kfree(cpus);
+
+	return err;
+}
+
 static int jailhouse_cmd_memguard(struct jailhouse_memguard __user *arg)
 {
 	struct jailhouse_memguard *mg;
@@ -801,13 +1135,7 @@ static int jailhouse_cmd_memguard(struct jailhouse_memguard __user *arg)
 		/* process all online CPUs:
 		 * implicitly, all CPUs visible by this cell.
 		 */
-		unsigned int i;
-		for_each_online_cpu(i) {
-			pr_info("[MG] Setup CPU %u\n", i);
-			mg->cpu = i;
-			err = smp_call_on_cpu(mg->cpu, memguard_call_one_cpu,
-					      &mg->params, true);
-		}
+		err = memguard_call_online_cpus(&mg->params);
 	} else {
 		err = smp_call_on_cpu(mg->cpu, memguard_call_one_cpu,
 				      &mg->params, true);
@@ -825,6 +1153,53 @@ out_free:
 	return err;
 }
 
+static int jailhouse_cmd_memguard_batch(
+		struct jailhouse_memguard_batch __user *arg)
+{
+	struct jailhouse_memguard_batch batch;
+	struct memguard_cpu_params *cpus;
+	int err;
+
+	if (copy_from_user(&batch, arg, sizeof(batch)))
+		return -EFAULT;
+
+	if (batch.num_cpus == 0 || batch.num_cpus > nr_cpu_ids)
+		return -EINVAL;
+
+	cpus = kmalloc_array(batch.num_cpus, sizeof(struct memguard_cpu_params),
+			     GFP_USER | __GFP_NOWARN);
+	if (!cpus)
+		return -ENOMEM;
+
+	if (copy_from_user(cpus, &arg->cpus[0],
+			   batch.num_cpus * sizeof(struct memguard_cpu_params))) {
+		err = -EFAULT;
+		goto out_free;
+	}
+
+	if (mutex_lock_interruptible(&jailhouse_lock) != 0) {
+		err = -EINTR;
+		goto out_free;
+	}
+
+	if (!jailhouse_enabled) {
+		err = -EINVAL;
+		goto out_unlock;
+	}
+
+	err = memguard_call_batch(cpus, batch.num_cpus);
+	if (err)
+		pr_err("Jailhouse: unable to set memguard parameters "
+				"of %u cpus\n", batch.num_cpus);
+
+out_unlock:
+	mutex_unlock(&jailhouse_lock);
+out_free:
+	kfree(cpus);
+
+	return err;
+}
+
 static int jailhouse_cmd_qos(struct jailhouse_qos_args __user *arg)
 {
 	struct jailhouse_qos_args qos_args;
@@ -867,15 +1242,261 @@ static int jailhouse_cmd_qos(struct jailhouse_qos_args __user *arg)
 	return err;
 }
 
+static int jailhouse_cmd_qos_profile_set(struct qos_profile_args __user *arg)
+{
+	struct qos_profile_args header, *args;
+	size_t size;
+	int err;
+
+	if (copy_from_user(&header, arg, sizeof(header)))
+		return -EFAULT;
+
+	if (header.id >= QOS_MAX_PROFILES ||
+	    header.num_settings > QOS_PROFILE_MAX_SETTINGS)
+		return -EINVAL;
+
+	size = sizeof(header) + header.num_settings * sizeof(struct qos_setting);
+	args = kmalloc(size, GFP_USER | __GFP_NOWARN);
+	if (!args)
+		return -ENOMEM;
+
+	if (copy_from_user(args, arg, size)) {
+		err = -EFAULT;
+		goto out_free;
+	}
+	/* the header may have changed in the meantime */
+	*args = header;
+
+	if (mutex_lock_interruptible(&jailhouse_lock) != 0) {
+		err = -EINTR;
+		goto out_free;
+	}
+
+	if (!jailhouse_enabled) {
+		err = -EINVAL;
+		goto out_unlock;
+	}
+
+	err = jailhouse_call_arg1(JAILHOUSE_HC_QOS_PROFILE_SET, __pa(args));
+	if (err)
+		pr_err("Jailhouse: unable to set QoS profile %u\n", header.id);
+
+out_unlock:
+	mutex_unlock(&jailhouse_lock);
+out_free:
+	kfree(args);
+
+	return err;
+}
+
+static int jailhouse_cmd_qos_profile_apply(unsigned long id)
+{
+	int err;
+
+	if (mutex_lock_interruptible(&jailhouse_lock) != 0)
+		return -EINTR;
+
+	if (jailhouse_enabled)
+		err = jailhouse_call_arg1(JAILHOUSE_HC_QOS_PROFILE_APPLY, id);
+	else
+		err = -EINVAL;
+
+	mutex_unlock(&jailhouse_lock);
+
+	return err;
+}
+
+static int jailhouse_cmd_trace(unsigned long mask)
+{
+	int err;
+
+	if (mutex_lock_interruptible(&jailhouse_lock) != 0)
+		return -EINTR;
+
+	if (jailhouse_enabled)
+		err = jailhouse_call_arg1(JAILHOUSE_HC_TRACE_SET, mask);
+	else
+		err = -EINVAL;
+
+	mutex_unlock(&jailhouse_lock);
+
+	return err;
+}
+
+static int jailhouse_cmd_mode_switch(struct mode_switch_args __user *arg)
+{
+	struct mode_switch_args header, *args;
+	size_t size;
+	int err;
+
+	if (copy_from_user(&header, arg, sizeof(header)))
+		return -EFAULT;
+
+	if (header.num_cpus > nr_cpu_ids ||
+	    header.num_cells > MODE_SWITCH_MAX_CELLS)
+		return -EINVAL;
+
+	size = sizeof(header) +
+		header.num_cpus * sizeof(struct memguard_cpu_params) +
+		header.num_cells * sizeof(struct mode_switch_cell);
+	args = kmalloc(size, GFP_USER | __GFP_NOWARN);
+	if (!args)
+		return -ENOMEM;
+
+	if (copy_from_user(args, arg, size)) {
+		err = -EFAULT;
+		goto out_free;
+	}
+	/* the header may have changed in the meantime */
+	*args = header;
+
+	if (mutex_lock_interruptible(&jailhouse_lock) != 0) {
+		err = -EINTR;
+		goto out_free;
+	}
+
+	if (!jailhouse_enabled) {
+		err = -EINVAL;
+		goto out_unlock;
+	}
+
+	err = jailhouse_call_arg1(JAILHOUSE_HC_MODE_SWITCH, __pa(args));
+	if (err)
+		pr_err("Jailhouse: mode switch failed (%d)\n", err);
+
+out_unlock:
+	mutex_unlock(&jailhouse_lock);
+out_free:
+	kfree(args);
+
+	return err;
+}
+
+static int jailhouse_cmd_perf(struct perf_args __user *arg)
+{
+	struct perf_args *args;
+	int err;
+
+	args = kmalloc(sizeof(*args), GFP_KERNEL);
+	if (!args)
+		return -ENOMEM;
+
+	if (copy_from_user(args, arg, sizeof(*args))) {
+		err = -EFAULT;
+		goto out_free;
+	}
+
+	if (mutex_lock_interruptible(&jailhouse_lock) != 0) {
+		err = -EINTR;
+		goto out_free;
+	}
+
+	if (jailhouse_enabled)
+		err = jailhouse_call_arg1(JAILHOUSE_HC_PERF_SET, __pa(args));
+	else
+		err = -EINVAL;
+
+	mutex_unlock(&jailhouse_lock);
+out_free:
+	kfree(args);
+
+	return err;
+}
+
+static int jailhouse_cmd_cpu_schedule(
+	struct jailhouse_cpu_schedule_args __user *arg)
+{
+	struct jailhouse_cpu_schedule_args *args;
+	int err;
+
+	args = kmalloc(sizeof(*args), GFP_KERNEL);
+	if (!args)
+		return -ENOMEM;
+
+	if (copy_from_user(args, arg, sizeof(*args))) {
+		err = -EFAULT;
+		goto out_free;
+	}
+
+	if (mutex_lock_interruptible(&jailhouse_lock) != 0) {
+		err = -EINTR;
+		goto out_free;
+	}
+
+	if (!jailhouse_enabled) {
+		err = -EINVAL;
+		goto out_unlock;
+	}
+
+	err = jailhouse_call_arg2(JAILHOUSE_HC_CPU_SCHEDULE, args->cpu,
+				  __pa(&args->schedule));
+	if (err)
+		pr_err("Jailhouse: unable to set schedule of CPU %d (%d)\n",
+		       args->cpu, err);
+
+out_unlock:
+	mutex_unlock(&jailhouse_lock);
+out_free:
+	kfree(args);
+
+	return err;
+}
+
+static int jailhouse_cmd_shmem_segment(struct jailhouse_shmem_args __user *arg)
+{
+	struct jailhouse_shmem_args *args;
+	int err;
+
+	args = kmalloc(sizeof(*args), GFP_KERNEL);
+	if (!args)
+		return -ENOMEM;
+
+	if (copy_from_user(args, arg, sizeof(*args))) {
+		err = -EFAULT;
+		goto out_free;
+	}
+
+	if (mutex_lock_interruptible(&jailhouse_lock) != 0) {
+		err = -EINTR;
+		goto out_free;
+	}
+
+	if (!jailhouse_enabled) {
+		err = -EINVAL;
+		goto out_unlock;
+	}
+
+	err = jailhouse_call_arg2(JAILHOUSE_HC_SHMEM_SEGMENT, args->op,
+				  __pa(&args->segment));
+	if (err)
+		pr_err("Jailhouse: shared memory segment \"%.*s\" failed "
+		       "(%d)\n", JAILHOUSE_SHMEM_NAME_MAXLEN,
+		       args->segment.name, err);
+	else if (copy_to_user(arg, args, sizeof(*args)))
+		err = -EFAULT;
+
+out_unlock:
+	mutex_unlock(&jailhouse_lock);
+out_free:
+	kfree(args);
+
+	return err;
+}
+
 static long jailhouse_ioctl(struct file *file, unsigned int ioctl,
 			    unsigned long arg)
 {
+	struct console_state *user = file->private_data;
 	long err;
 
 	switch (ioctl) {
 	case JAILHOUSE_ENABLE:
 		err = jailhouse_cmd_enable(
-			(struct jailhouse_system __user *)arg);
+			(struct jailhouse_system __user *)arg, NULL);
+		break;
+	case JAILHOUSE_ENABLE_CACHED:
+		err = jailhouse_cmd_enable_cached(
+			(struct jailhouse_enable_cached __user *)arg);
 		break;
 	case JAILHOUSE_DISABLE:
 		err = jailhouse_cmd_disable();
@@ -902,6 +1523,67 @@ static long jailhouse_ioctl(struct file *file, unsigned int ioctl,
 		err = jailhouse_cmd_qos(
 				(struct jailhouse_qos_args __user *)arg);
 	    break;
+	case JAILHOUSE_CELL_MEMGUARD:
+		err = jailhouse_cmd_cell_memguard(
+				(struct jailhouse_cell_memguard __user *)arg);
+		break;
+	case JAILHOUSE_MEMGUARD_BATCH:
+		err = jailhouse_cmd_memguard_batch(
+				(struct jailhouse_memguard_batch __user *)arg);
+		break;
+	case JAILHOUSE_CELL_RECOLOR:
+		err = jailhouse_cmd_cell_recolor(
+				(struct jailhouse_cell_recolor __user *)arg);
+		break;
+	case JAILHOUSE_CELL_SNAPSHOT:
+		err = jailhouse_cmd_cell_snapshot(
+			(struct jailhouse_cell_snapshot_args __user *)arg);
+		break;
+	case JAILHOUSE_CELL_RESTORE:
+		err = jailhouse_cmd_cell_restore(
+			(struct jailhouse_cell_snapshot_args __user *)arg);
+		break;
+	case JAILHOUSE_CELL_CPU_MOVE:
+		err = jailhouse_cmd_cell_cpu_move(
+			(struct jailhouse_cell_cpu_move __user *)arg);
+		break;
+	case JAILHOUSE_CELL_MEM_RESIZE:
+		err = jailhouse_cmd_cell_mem_resize(
+			(struct jailhouse_cell_mem_resize __user *)arg);
+		break;
+	case JAILHOUSE_QOS_PROFILE_SET:
+		err = jailhouse_cmd_qos_profile_set(
+			(struct qos_profile_args __user *)arg);
+		break;
+	case JAILHOUSE_QOS_PROFILE_APPLY:
+		err = jailhouse_cmd_qos_profile_apply(arg);
+		break;
+	case JAILHOUSE_MODE_SWITCH:
+		err = jailhouse_cmd_mode_switch(
+			(struct mode_switch_args __user *)arg);
+		break;
+	case JAILHOUSE_PERF:
+		err = jailhouse_cmd_perf((struct perf_args __user *)arg);
+		break;
+	case JAILHOUSE_TRACE:
+		err = jailhouse_cmd_trace(arg);
+		break;
+	case JAILHOUSE_CPU_SCHEDULE:
+		err = jailhouse_cmd_cpu_schedule(
+			(struct jailhouse_cpu_schedule_args __user *)arg);
+		break;
+	case JAILHOUSE_SHMEM_SEGMENT:
+		err = jailhouse_cmd_shmem_segment(
+			(struct jailhouse_shmem_args __user *)arg);
+		break;
+	case JAILHOUSE_CELL_MAP_IMAGE:
+		err = jailhouse_cmd_cell_map_image(
+				(struct jailhouse_cell_id __user *)arg);
+		if (err >= 0) {
+			user->map_cell_id = err;
+			err = 0;
+		}
+		break;
 	default:
 		err = -EINVAL;
 		break;
@@ -918,6 +1600,7 @@ static int jailhouse_console_open(struct inode *inode, struct file *file)
 	if (!user)
 		return -ENOMEM;
 
+	user->map_cell_id = JAILHOUSE_CELL_ID_UNUSED;
 	file->private_data = user;
 
 	return 0;
@@ -1012,6 +1695,16 @@ console_free_out:
 }
 
 
+static int jailhouse_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct console_state *user = file->private_data;
+
+	if (user->map_cell_id < 0)
+		return -EINVAL;
+
+	return jailhouse_cell_mmap(user->map_cell_id, vma);
+}
+
 static const struct file_operations jailhouse_fops = {
 	.owner = THIS_MODULE,
 	.unlocked_ioctl = jailhouse_ioctl,
@@ -1020,6 +1713,7 @@ static const struct file_operations jailhouse_fops = {
 	.open = jailhouse_console_open,
 	.release = jailhouse_console_release,
 	.read = jailhouse_console_read,
+	.mmap = jailhouse_mmap,
 };
 
 static struct miscdevice jailhouse_misc_dev = {
@@ -1106,6 +1800,7 @@ static void __exit jailhouse_exit(void)
 {
 	unregister_reboot_notifier(&jailhouse_shutdown_nb);
 	misc_deregister(&jailhouse_misc_dev);
+	cancel_delayed_work_sync(&console_flush_work);
 	jailhouse_sysfs_exit(jailhouse_dev);
 	jailhouse_firmware_free();
 	jailhouse_pci_unregister();
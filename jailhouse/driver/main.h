@@ -28,10 +28,21 @@
 extern struct mutex jailhouse_lock;
 extern bool jailhouse_enabled;
 extern void *hypervisor_mem;
+extern struct memguard_telemetry *memguard_telemetry;
+extern struct irq_latency *irq_latency;
+extern struct perf_ring *perf_rings;
+extern struct trace_ring *trace_rings;
+extern struct jailhouse_cpu_stats *cpu_stats;
+extern phys_addr_t cpu_stats_phys;
 
 void *jailhouse_ioremap(phys_addr_t phys, unsigned long virt,
 			unsigned long size);
 int jailhouse_console_dump_delta(char *dst, unsigned int head,
 				 unsigned int *miss);
+int jailhouse_perf_read(unsigned int cpu, unsigned int *pos,
+			struct perf_sample *samples, unsigned int max);
+struct jailhouse_dsu_stats;
+int jailhouse_dsu_read(unsigned int cluster,
+		       struct jailhouse_dsu_stats *stats);
 
 #endif /* !_JAILHOUSE_DRIVER_MAIN_H */
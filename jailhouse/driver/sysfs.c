@@ -15,13 +15,25 @@
 #include "main.h"
 #include "sysfs.h"
 
+#include <jailhouse/cpu_stats.h>
 #include <jailhouse/hypercall.h>
+#include <jailhouse/irq-latency.h>
+#include <jailhouse/perf.h>
+#include <jailhouse/trace.h>
 
 /* For compatibility with older kernel versions */
 #include <linux/version.h>
 #include <linux/gfp.h>
+#include <linux/mm.h>
 #include <linux/stat.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/timex.h>
+#ifdef CONFIG_ARM64
+#include <asm/arch_timer.h>
+#elif defined(CONFIG_X86)
+#include <asm/tsc.h>
+#endif
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,11,0)
 #define DEVICE_ATTR_RO(_name) \
@@ -82,21 +94,45 @@ struct jailhouse_cpu_stats_attr {
 	unsigned int code;
 };
 
+/*
+ * Read a counter from the shared statistics page, falling back to a
+ * hypercall for CPUs not published there. Values are truncated to 31 bits
+ * like those of JAILHOUSE_HC_CPU_GET_INFO.
+ */
+static int cpu_stat_read(unsigned int cpu, unsigned int code)
+{
+	struct jailhouse_cpu_stats *page;
+	unsigned int seq, value;
+
+	if (!cpu_stats || cpu >= JAILHOUSE_CPU_STATS_CPUS ||
+	    code >= READ_ONCE(cpu_stats[cpu].num_stats))
+		return jailhouse_call_arg2(JAILHOUSE_HC_CPU_GET_INFO, cpu,
+					   JAILHOUSE_CPU_INFO_STAT_BASE + code);
+
+	page = &cpu_stats[cpu];
+	do {
+		seq = READ_ONCE(page->seq);
+		smp_rmb();
+		value = READ_ONCE(page->stats[code]);
+		smp_rmb();
+	} while ((seq & 1) || seq != READ_ONCE(page->seq));
+
+	return value & 0x7fffffff;
+}
+
 static ssize_t cell_stats_show(struct kobject *kobj,
 			       struct kobj_attribute *attr,
 			       char *buffer)
 {
 	struct jailhouse_cpu_stats_attr *stats_attr =
 		container_of(attr, struct jailhouse_cpu_stats_attr, kattr);
-	unsigned int code = JAILHOUSE_CPU_INFO_STAT_BASE + stats_attr->code;
 	struct cell *cell = container_of(kobj, struct cell, stats_kobj);
 	unsigned long sum = 0;
 	unsigned int cpu;
 	int value;
 
 	for_each_cpu(cpu, &cell->cpus_assigned) {
-		value = jailhouse_call_arg2(JAILHOUSE_HC_CPU_GET_INFO, cpu,
-					    code);
+		value = cpu_stat_read(cpu, stats_attr->code);
 		if (value > 0)
 			sum += value;
 	}
@@ -110,18 +146,110 @@ static ssize_t cpu_stats_show(struct kobject *kobj,
 {
 	struct jailhouse_cpu_stats_attr *stats_attr =
 		container_of(attr, struct jailhouse_cpu_stats_attr, kattr);
-	unsigned int code = JAILHOUSE_CPU_INFO_STAT_BASE + stats_attr->code;
 	struct cell_cpu *cell_cpu = container_of(kobj, struct cell_cpu, kobj);
 	int value;
 
-	value = jailhouse_call_arg2(JAILHOUSE_HC_CPU_GET_INFO, cell_cpu->cpu,
-				    code);
+	value = cpu_stat_read(cell_cpu->cpu, stats_attr->code);
 	if (value < 0)
 		value = 0;
 
 	return sprintf(buffer, "%d\n", value);
 }
 
+#ifdef CONFIG_ARM64
+/* Number of most recent regulation periods shown by memguard_periods */
+#define MEMGUARD_SYSFS_PERIODS	32
+
+static ssize_t memguard_periods_show(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     char *buffer)
+{
+	struct cell_cpu *cell_cpu = container_of(kobj, struct cell_cpu, kobj);
+	struct memguard_telemetry_entry *entries, *entry;
+	struct memguard_telemetry *ring;
+	unsigned int head, tail, first;
+	ssize_t len = 0;
+
+	if (!memguard_telemetry || cell_cpu->cpu >= MEMGUARD_TELEMETRY_CPUS)
+		return 0;
+	ring = &memguard_telemetry[cell_cpu->cpu];
+
+	entries = kmalloc(sizeof(ring->entries), GFP_KERNEL);
+	if (!entries)
+		return -ENOMEM;
+
+	/* the hypervisor may write while we copy, see memguard-common.h */
+	head = READ_ONCE(ring->head);
+	smp_rmb();
+	memcpy(entries, ring->entries, sizeof(ring->entries));
+	smp_rmb();
+	tail = READ_ONCE(ring->head);
+
+	first = head - min(head, (unsigned int)MEMGUARD_SYSFS_PERIODS);
+	/* skip the records overwritten during the copy */
+	if ((int)(tail - MEMGUARD_TELEMETRY_ENTRIES + 1 - first) > 0)
+		first = tail - MEMGUARD_TELEMETRY_ENTRIES + 1;
+
+	for (; (int)(head - first) > 0; first++) {
+		entry = &entries[first % MEMGUARD_TELEMETRY_ENTRIES];
+		len += scnprintf(buffer + len, PAGE_SIZE - len,
+				 "%llu %u %u %u %u\n", entry->timestamp,
+				 entry->consumed[0], entry->consumed[1],
+				 entry->consumed[2], entry->blocked_ticks);
+	}
+
+	kfree(entries);
+
+	return len;
+}
+
+static struct kobj_attribute memguard_periods_attr =
+	__ATTR(memguard_periods, S_IRUGO, memguard_periods_show, NULL);
+#endif
+
+#if defined(CONFIG_ARM) || defined(CONFIG_ARM64)
+static const char *irq_latency_stages[IRQ_LATENCY_STAGES] = {
+	[IRQ_LATENCY_INJECT] = "inject",
+	[IRQ_LATENCY_EOI] = "eoi",
+};
+
+/* One line per stage: the prefix, the stage name and its buckets */
+static ssize_t irq_latency_print(char *buffer, ssize_t len,
+				 const char *prefix,
+				 struct irq_latency_hist *hists)
+{
+	unsigned int stage, n;
+
+	for (stage = 0; stage < IRQ_LATENCY_STAGES; stage++) {
+		len += scnprintf(buffer + len, PAGE_SIZE - len, "%s%s",
+				 prefix, irq_latency_stages[stage]);
+		for (n = 0; n < IRQ_LATENCY_BUCKETS; n++)
+			len += scnprintf(buffer + len, PAGE_SIZE - len, " %u",
+					 READ_ONCE(hists[stage].buckets[n]));
+		len += scnprintf(buffer + len, PAGE_SIZE - len, "\n");
+	}
+
+	return len;
+}
+
+static ssize_t irq_latency_cpu_show(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    char *buffer)
+{
+	struct cell_cpu *cell_cpu = container_of(kobj, struct cell_cpu, kobj);
+
+	if (!irq_latency || !READ_ONCE(irq_latency->freq) ||
+	    cell_cpu->cpu >= IRQ_LATENCY_CPUS)
+		return 0;
+
+	return irq_latency_print(buffer, 0, "",
+				 irq_latency->cpu[cell_cpu->cpu]);
+}
+
+static struct kobj_attribute irq_latency_cpu_attr =
+	__ATTR(irq_latency, S_IRUGO, irq_latency_cpu_show, NULL);
+#endif
+
 #define JAILHOUSE_CPU_STATS_ATTR(_name, _code) \
 	static struct jailhouse_cpu_stats_attr _name##_cell_attr = { \
 		.kattr = __ATTR(_name, S_IRUGO, cell_stats_show, NULL), \
@@ -157,11 +285,81 @@ JAILHOUSE_CPU_STATS_ATTR(vmexits_virt_irq, JAILHOUSE_CPU_STAT_VMEXITS_VIRQ);
 JAILHOUSE_CPU_STATS_ATTR(vmexits_virt_sgi, JAILHOUSE_CPU_STAT_VMEXITS_VSGI);
 JAILHOUSE_CPU_STATS_ATTR(vmexits_psci, JAILHOUSE_CPU_STAT_VMEXITS_PSCI);
 JAILHOUSE_CPU_STATS_ATTR(vmexits_smccc, JAILHOUSE_CPU_STAT_VMEXITS_SMCCC);
+JAILHOUSE_CPU_STATS_ATTR(virq_dropped, JAILHOUSE_CPU_STAT_VIRQ_DROPPED);
+JAILHOUSE_CPU_STATS_ATTR(virq_sdei, JAILHOUSE_CPU_STAT_VIRQ_SDEI);
+JAILHOUSE_CPU_STATS_ATTR(virq_lr, JAILHOUSE_CPU_STAT_VIRQ_LR);
+JAILHOUSE_CPU_STATS_ATTR(irq_steered, JAILHOUSE_CPU_STAT_IRQ_STEERED);
 #ifdef CONFIG_ARM
 JAILHOUSE_CPU_STATS_ATTR(vmexits_cp15, JAILHOUSE_CPU_STAT_VMEXITS_CP15);
 #endif
+#ifdef CONFIG_ARM64
+JAILHOUSE_CPU_STATS_ATTR(memguard_throttled,
+			 JAILHOUSE_CPU_STAT_MEMGUARD_THROTTLED);
+JAILHOUSE_CPU_STATS_ATTR(memguard_blocked_us,
+			 JAILHOUSE_CPU_STAT_MEMGUARD_BLOCKED_US);
+JAILHOUSE_CPU_STATS_ATTR(trap_us_hvc, JAILHOUSE_CPU_STAT_TRAP_US_HVC);
+JAILHOUSE_CPU_STATS_ATTR(trap_us_smc, JAILHOUSE_CPU_STAT_TRAP_US_SMC);
+JAILHOUSE_CPU_STATS_ATTR(trap_us_sysreg, JAILHOUSE_CPU_STAT_TRAP_US_SYSREG);
+JAILHOUSE_CPU_STATS_ATTR(trap_us_dabt, JAILHOUSE_CPU_STAT_TRAP_US_DABT);
+JAILHOUSE_CPU_STATS_ATTR(trap_us_iabt, JAILHOUSE_CPU_STAT_TRAP_US_IABT);
+JAILHOUSE_CPU_STATS_ATTR(irq_us_maintenance,
+			 JAILHOUSE_CPU_STAT_IRQ_US_MAINTENANCE);
+JAILHOUSE_CPU_STATS_ATTR(irq_us_timer, JAILHOUSE_CPU_STAT_IRQ_US_TIMER);
+JAILHOUSE_CPU_STATS_ATTR(irq_us_pmu, JAILHOUSE_CPU_STAT_IRQ_US_PMU);
+JAILHOUSE_CPU_STATS_ATTR(irq_us_sgi, JAILHOUSE_CPU_STAT_IRQ_US_SGI);
+JAILHOUSE_CPU_STATS_ATTR(irq_us_other, JAILHOUSE_CPU_STAT_IRQ_US_OTHER);
+#endif
 #endif
 
+static int mmio_stat_cmp(const void *a, const void *b)
+{
+	const struct jailhouse_mmio_stat *stat_a = a, *stat_b = b;
+
+	if (stat_a->ticks == stat_b->ticks)
+		return 0;
+	return stat_a->ticks < stat_b->ticks ? 1 : -1;
+}
+
+/* One line per region, sorted by handler time so that truncation drops the
+ * least used ones. */
+static ssize_t cell_mmio_stats_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buffer)
+{
+	struct cell *cell = container_of(kobj, struct cell, stats_kobj);
+	struct jailhouse_mmio_stats *stats;
+	struct jailhouse_mmio_stat *entry;
+	ssize_t written = 0;
+	int entries, n;
+
+	stats = (struct jailhouse_mmio_stats *)__get_free_page(GFP_KERNEL);
+	if (!stats)
+		return -ENOMEM;
+
+	stats->max_entries = (PAGE_SIZE - sizeof(*stats)) / sizeof(*entry);
+	entries = jailhouse_call_arg2(JAILHOUSE_HC_CELL_GET_MMIO_STATS,
+				      cell->id, __pa(stats));
+	if (entries < 0) {
+		free_page((unsigned long)stats);
+		return entries;
+	}
+
+	sort(stats->entries, entries, sizeof(*entry), mmio_stat_cmp, NULL);
+
+	for (n = 0; n < entries; n++) {
+		entry = &stats->entries[n];
+		written += scnprintf(buffer + written, PAGE_SIZE - written,
+				     "0x%llx 0x%llx %llu %llu\n",
+				     entry->start, entry->size, entry->count,
+				     entry->ticks);
+	}
+
+	free_page((unsigned long)stats);
+	return written;
+}
+
+static struct kobj_attribute cell_mmio_stats_attr =
+	__ATTR(mmio, S_IRUGO, cell_mmio_stats_show, NULL);
+
 static struct attribute *cell_stats_attrs[] = {
 	&vmexits_total_cell_attr.kattr.attr,
 	&vmexits_mmio_cell_attr.kattr.attr,
@@ -182,10 +380,29 @@ static struct attribute *cell_stats_attrs[] = {
 	&vmexits_virt_sgi_cell_attr.kattr.attr,
 	&vmexits_psci_cell_attr.kattr.attr,
 	&vmexits_smccc_cell_attr.kattr.attr,
+	&virq_dropped_cell_attr.kattr.attr,
+	&virq_sdei_cell_attr.kattr.attr,
+	&virq_lr_cell_attr.kattr.attr,
+	&irq_steered_cell_attr.kattr.attr,
 #ifdef CONFIG_ARM
 	&vmexits_cp15_cell_attr.kattr.attr,
 #endif
+#ifdef CONFIG_ARM64
+	&memguard_throttled_cell_attr.kattr.attr,
+	&memguard_blocked_us_cell_attr.kattr.attr,
+	&trap_us_hvc_cell_attr.kattr.attr,
+	&trap_us_smc_cell_attr.kattr.attr,
+	&trap_us_sysreg_cell_attr.kattr.attr,
+	&trap_us_dabt_cell_attr.kattr.attr,
+	&trap_us_iabt_cell_attr.kattr.attr,
+	&irq_us_maintenance_cell_attr.kattr.attr,
+	&irq_us_timer_cell_attr.kattr.attr,
+	&irq_us_pmu_cell_attr.kattr.attr,
+	&irq_us_sgi_cell_attr.kattr.attr,
+	&irq_us_other_cell_attr.kattr.attr,
+#endif
 #endif
+	&cell_mmio_stats_attr.attr,
 	NULL
 };
 COMPAT_ATTRIBUTE_GROUPS(cell_stats);
@@ -215,9 +432,29 @@ static struct attribute *cpu_stats_attrs[] = {
 	&vmexits_virt_sgi_cpu_attr.kattr.attr,
 	&vmexits_psci_cpu_attr.kattr.attr,
 	&vmexits_smccc_cpu_attr.kattr.attr,
+	&virq_dropped_cpu_attr.kattr.attr,
+	&virq_sdei_cpu_attr.kattr.attr,
+	&virq_lr_cpu_attr.kattr.attr,
+	&irq_steered_cpu_attr.kattr.attr,
+	&irq_latency_cpu_attr.attr,
 #ifdef CONFIG_ARM
 	&vmexits_cp15_cpu_attr.kattr.attr,
 #endif
+#ifdef CONFIG_ARM64
+	&memguard_throttled_cpu_attr.kattr.attr,
+	&memguard_blocked_us_cpu_attr.kattr.attr,
+	&trap_us_hvc_cpu_attr.kattr.attr,
+	&trap_us_smc_cpu_attr.kattr.attr,
+	&trap_us_sysreg_cpu_attr.kattr.attr,
+	&trap_us_dabt_cpu_attr.kattr.attr,
+	&trap_us_iabt_cpu_attr.kattr.attr,
+	&irq_us_maintenance_cpu_attr.kattr.attr,
+	&irq_us_timer_cpu_attr.kattr.attr,
+	&irq_us_pmu_cpu_attr.kattr.attr,
+	&irq_us_sgi_cpu_attr.kattr.attr,
+	&irq_us_other_cpu_attr.kattr.attr,
+	&memguard_periods_attr.attr,
+#endif
 #endif
 	NULL
 };
@@ -521,6 +758,19 @@ static ssize_t mem_pool_used_show(struct device *dev,
 	return info_show(dev, buffer, JAILHOUSE_INFO_MEM_POOL_USED);
 }
 
+static ssize_t mem_pool_peak_show(struct device *dev,
+				  struct device_attribute *attr, char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_MEM_POOL_PEAK);
+}
+
+static ssize_t mem_pool_reserve_show(struct device *dev,
+				     struct device_attribute *attr,
+				     char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_MEM_POOL_RESERVE);
+}
+
 static ssize_t remap_pool_size_show(struct device *dev,
 				    struct device_attribute *attr,
 				    char *buffer)
@@ -535,6 +785,110 @@ static ssize_t remap_pool_used_show(struct device *dev,
 	return info_show(dev, buffer, JAILHOUSE_INFO_REMAP_POOL_USED);
 }
 
+static ssize_t llc_size_show(struct device *dev, struct device_attribute *attr,
+			     char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_LLC_SIZE);
+}
+
+static ssize_t llc_way_size_show(struct device *dev,
+				 struct device_attribute *attr, char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_LLC_WAY_SIZE);
+}
+
+static ssize_t color_way_size_show(struct device *dev,
+				   struct device_attribute *attr, char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_COLOR_WAY_SIZE);
+}
+
+#if defined(CONFIG_ARM) || defined(CONFIG_ARM64)
+static ssize_t irq_latency_show(struct device *dev,
+				struct device_attribute *attr, char *buffer)
+{
+	char prefix[16];
+	unsigned int n, irq;
+	ssize_t len;
+
+	if (!irq_latency || !READ_ONCE(irq_latency->freq))
+		return 0;
+
+	len = sprintf(buffer, "freq %u\n", irq_latency->freq);
+	for (n = 0; n < IRQ_LATENCY_IRQS; n++) {
+		irq = READ_ONCE(irq_latency->irqs[n]);
+		if (!irq)
+			continue;
+		snprintf(prefix, sizeof(prefix), "%u ", irq);
+		len = irq_latency_print(buffer, len, prefix,
+					irq_latency->irq[n]);
+	}
+
+	return len;
+}
+#endif
+
+#ifdef CONFIG_ARM64
+/* Per-stream SMMU fault counters, one line per faulting stream */
+static ssize_t iommu_faults_show(struct device *dev,
+				 struct device_attribute *attr, char *buffer)
+{
+	struct jailhouse_iommu_faults *faults;
+	struct jailhouse_iommu_fault *entry;
+	ssize_t written;
+	int entries, n;
+
+	faults = (struct jailhouse_iommu_faults *)__get_free_page(GFP_KERNEL);
+	if (!faults)
+		return -ENOMEM;
+
+	faults->max_entries = (PAGE_SIZE - sizeof(*faults)) / sizeof(*entry);
+	entries = jailhouse_call_arg1(JAILHOUSE_HC_IOMMU_GET_FAULTS,
+				      __pa(faults));
+	if (entries < 0) {
+		free_page((unsigned long)faults);
+		return entries;
+	}
+
+	written = scnprintf(buffer, PAGE_SIZE,
+			    "untracked %llu\noverflows %llu\n",
+			    faults->untracked, faults->overflows);
+	for (n = 0; n < entries; n++) {
+		entry = &faults->entries[n];
+		written += scnprintf(buffer + written, PAGE_SIZE - written,
+				     "%u 0x%x %llu 0x%x 0x%llx\n",
+				     entry->unit, entry->sid, entry->count,
+				     entry->last_event, entry->last_addr);
+	}
+
+	free_page((unsigned long)faults);
+	return written;
+}
+#endif
+
+/* "<code> <name>" of each counter, the index into jailhouse_cpu_stats */
+static ssize_t cpu_stats_layout_show(struct device *dev,
+				     struct device_attribute *attr,
+				     char *buffer)
+{
+	struct jailhouse_cpu_stats_attr *stats_attr;
+	struct kobj_attribute *kattr;
+	struct attribute **entry;
+	ssize_t len = 0;
+
+	for (entry = cpu_stats_attrs; *entry; entry++) {
+		kattr = container_of(*entry, struct kobj_attribute, attr);
+		if (kattr->show != cpu_stats_show)
+			continue;
+		stats_attr = container_of(kattr, struct jailhouse_cpu_stats_attr,
+					  kattr);
+		len += scnprintf(buffer + len, PAGE_SIZE - len, "%u %s\n",
+				 stats_attr->code, (*entry)->name);
+	}
+
+	return len;
+}
+
 static ssize_t core_show(struct file *filp, struct kobject *kobj,
 			 struct bin_attribute *attr, char *buf, loff_t off,
 			 size_t count)
@@ -547,16 +901,40 @@ static DEVICE_ATTR_RO(console);
 static DEVICE_ATTR_RO(enabled);
 static DEVICE_ATTR_RO(mem_pool_size);
 static DEVICE_ATTR_RO(mem_pool_used);
+static DEVICE_ATTR_RO(mem_pool_peak);
+static DEVICE_ATTR_RO(mem_pool_reserve);
 static DEVICE_ATTR_RO(remap_pool_size);
 static DEVICE_ATTR_RO(remap_pool_used);
+static DEVICE_ATTR_RO(llc_size);
+static DEVICE_ATTR_RO(llc_way_size);
+static DEVICE_ATTR_RO(color_way_size);
+static DEVICE_ATTR_RO(cpu_stats_layout);
+#if defined(CONFIG_ARM) || defined(CONFIG_ARM64)
+static DEVICE_ATTR_RO(irq_latency);
+#endif
+#ifdef CONFIG_ARM64
+static DEVICE_ATTR_RO(iommu_faults);
+#endif
 
 static struct attribute *jailhouse_sysfs_entries[] = {
 	&dev_attr_console.attr,
 	&dev_attr_enabled.attr,
 	&dev_attr_mem_pool_size.attr,
 	&dev_attr_mem_pool_used.attr,
+	&dev_attr_mem_pool_peak.attr,
+	&dev_attr_mem_pool_reserve.attr,
 	&dev_attr_remap_pool_size.attr,
 	&dev_attr_remap_pool_used.attr,
+	&dev_attr_llc_size.attr,
+	&dev_attr_llc_way_size.attr,
+	&dev_attr_color_way_size.attr,
+	&dev_attr_cpu_stats_layout.attr,
+#if defined(CONFIG_ARM) || defined(CONFIG_ARM64)
+	&dev_attr_irq_latency.attr,
+#endif
+#ifdef CONFIG_ARM64
+	&dev_attr_iommu_faults.attr,
+#endif
 	NULL
 };
 
@@ -565,20 +943,166 @@ static struct attribute_group jailhouse_attribute_group = {
 	.attrs = jailhouse_sysfs_entries,
 };
 
+/* The raw PMU sample rings, see jailhouse/perf.h */
+static ssize_t perf_samples_show(struct file *filp, struct kobject *kobj,
+				 struct bin_attribute *attr, char *buf,
+				 loff_t off, size_t count)
+{
+	return memory_read_from_buffer(buf, count, &off, perf_rings,
+				       attr->size);
+}
+
+/*
+ * The shared statistics page, see jailhouse/cpu_stats.h. Can be mapped
+ * read-only so that monitors poll the counters without any system call.
+ */
+static ssize_t cpu_stats_show_bin(struct file *filp, struct kobject *kobj,
+				  struct bin_attribute *attr, char *buf,
+				  loff_t off, size_t count)
+{
+	return memory_read_from_buffer(buf, count, &off, cpu_stats,
+				       attr->size);
+}
+
+static int cpu_stats_mmap(struct file *filp, struct kobject *kobj,
+			  struct bin_attribute *attr,
+			  struct vm_area_struct *vma)
+{
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_pgoff != 0 || size > PAGE_ALIGN(attr->size))
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,3,0)
+	vma->vm_flags &= ~VM_MAYWRITE;
+#else
+	vm_flags_clear(vma, VM_MAYWRITE);
+#endif
+
+	return remap_pfn_range(vma, vma->vm_start,
+			       cpu_stats_phys >> PAGE_SHIFT, size,
+			       vma->vm_page_prot);
+}
+
+/* The raw tracepoint rings, see jailhouse/trace.h */
+static ssize_t trace_show(struct file *filp, struct kobject *kobj,
+			  struct bin_attribute *attr, char *buf, loff_t off,
+			  size_t count)
+{
+	return memory_read_from_buffer(buf, count, &off, trace_rings,
+				       attr->size);
+}
+
+/*
+ * The counter the trace records are stamped with, read together with
+ * CLOCK_MONOTONIC, and its frequency. Lets tools put the records on the
+ * time line of ftrace events recorded with trace_clock "mono".
+ */
+static ssize_t trace_clock_show(struct device *dev,
+				struct device_attribute *attr, char *buffer)
+{
+	unsigned long flags, freq = 0;
+	u64 counter, mono;
+
+#ifdef CONFIG_ARM64
+	freq = arch_timer_get_cntfrq();
+#elif defined(CONFIG_X86)
+	freq = tsc_khz * 1000UL;
+#endif
+	local_irq_save(flags);
+	counter = get_cycles();
+	mono = ktime_get_ns();
+	local_irq_restore(flags);
+
+	return sprintf(buffer, "%llu %llu %lu\n", counter, mono, freq);
+}
+
+static DEVICE_ATTR_RO(trace_clock);
+
 static struct bin_attribute bin_attr_core = {
 	.attr.name = "core",
 	.attr.mode = S_IRUSR,
 	.read = core_show,
 };
 
+static struct bin_attribute bin_attr_perf_samples = {
+	.attr.name = "perf_samples",
+	.attr.mode = S_IRUSR,
+	.read = perf_samples_show,
+	.size = sizeof(struct perf_ring) * PERF_CPUS,
+};
+
+static struct bin_attribute bin_attr_trace = {
+	.attr.name = "trace",
+	.attr.mode = S_IRUSR,
+	.read = trace_show,
+	.size = sizeof(struct trace_ring) * TRACE_CPUS,
+};
+
+static struct bin_attribute bin_attr_cpu_stats = {
+	.attr.name = "cpu_stats",
+	.attr.mode = S_IRUGO,
+	.read = cpu_stats_show_bin,
+	.mmap = cpu_stats_mmap,
+	.size = sizeof(struct jailhouse_stats_page),
+};
+
 int jailhouse_sysfs_core_init(struct device *dev, size_t hypervisor_size)
 {
+	int err;
+
 	bin_attr_core.size = hypervisor_size;
-	return sysfs_create_bin_file(&dev->kobj, &bin_attr_core);
+	err = sysfs_create_bin_file(&dev->kobj, &bin_attr_core);
+	if (err)
+		return err;
+
+	if (perf_rings) {
+		err = sysfs_create_bin_file(&dev->kobj, &bin_attr_perf_samples);
+		if (err)
+			goto remove_core;
+	}
+
+	if (cpu_stats) {
+		err = sysfs_create_bin_file(&dev->kobj, &bin_attr_cpu_stats);
+		if (err)
+			goto remove_perf_samples;
+	}
+
+	if (trace_rings) {
+		err = sysfs_create_bin_file(&dev->kobj, &bin_attr_trace);
+		if (err)
+			goto remove_cpu_stats;
+		err = device_create_file(dev, &dev_attr_trace_clock);
+		if (err)
+			goto remove_trace;
+	}
+
+	return 0;
+
+remove_trace:
+	sysfs_remove_bin_file(&dev->kobj, &bin_attr_trace);
+remove_cpu_stats:
+	if (cpu_stats)
+		sysfs_remove_bin_file(&dev->kobj, &bin_attr_cpu_stats);
+remove_perf_samples:
+	if (perf_rings)
+		sysfs_remove_bin_file(&dev->kobj, &bin_attr_perf_samples);
+remove_core:
+	sysfs_remove_bin_file(&dev->kobj, &bin_attr_core);
+	return err;
 }
 
 void jailhouse_sysfs_core_exit(struct device *dev)
 {
+	if (trace_rings) {
+		device_remove_file(dev, &dev_attr_trace_clock);
+		sysfs_remove_bin_file(&dev->kobj, &bin_attr_trace);
+	}
+	if (cpu_stats)
+		sysfs_remove_bin_file(&dev->kobj, &bin_attr_cpu_stats);
+	if (perf_rings)
+		sysfs_remove_bin_file(&dev->kobj, &bin_attr_perf_samples);
 	sysfs_remove_bin_file(&dev->kobj, &bin_attr_core);
 }
 
@@ -16,12 +16,16 @@
 #include <jailhouse/printk.h>
 #include <jailhouse/panic.h>
 #include <jailhouse/memguard.h>
+#include <asm/coloring.h>
 #include <asm/control.h>
 #include <asm/iommu.h>
 #include <asm/psci.h>
+#include <asm/sched.h>
 #include <asm/smc.h>
 #include <asm/smccc.h>
+#include <asm/snapshot.h>
 #include <asm/memguard.h>
+#include <asm/perf.h>
 #include <asm/timer.h>
 #include <asm/pmu.h>
 
@@ -88,13 +92,17 @@ static void check_events(struct public_per_cpu *cpu_public)
 
 		spin_unlock(&cpu_public->control_lock);
 
-		while (cpu_public->suspend_cpu)
+		while (cpu_public->suspend_cpu) {
+			color_dcache_setway_help();
+			snapshot_cpu_save_help();
 			cpu_relax();
+		}
 
 		spin_lock(&cpu_public->control_lock);
 	}
 
 	cpu_public->cpu_suspended = false;
+	sched_take_requests(cpu_public);
 
 	if (cpu_public->park) {
 		enter_cpu_off(cpu_public);
@@ -113,6 +121,11 @@ static void check_events(struct public_per_cpu *cpu_public)
 		arm_paging_vcpu_flush_tlbs();
 	}
 
+	if (cpu_public->memguard.update || cpu_public->memguard.switch_arm)
+		memguard_cpu_update();
+	perf_cpu_update();
+	sched_cpu_update();
+
 	spin_unlock(&cpu_public->control_lock);
 
 	/*
@@ -121,10 +134,18 @@ static void check_events(struct public_per_cpu *cpu_public)
 	 */
 	if (cpu_public->wait_for_poweron)
 		arm_cpu_park();
-	else if (reset)
+	else if (reset) {
 		arm_cpu_reset(cpu_public->cpu_on_entry,
 			      !!(this_cell()->config->flags &
 			         JAILHOUSE_CELL_AARCH32));
+		snapshot_cpu_restore();
+	}
+}
+
+/* Applies the control requests of a vCPU switched in, see sched.c. */
+void arm_cpu_check_events(void)
+{
+	check_events(this_cpu_public());
 }
 
 void arch_handle_sgi(u32 irqn, unsigned int count_event)
@@ -171,6 +192,13 @@ bool arch_handle_phys_irq(u32 irqn, unsigned int count_event)
 		return pmu_isr_handler();
 	}
 
+	if (irq_is_dsu(irqn)) {
+		return dsu_isr_handler();
+	}
+
+	if (iommu_handle_irq(irqn))
+		return true;
+
 	cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_VIRQ] += count_event;
 	irqchip_set_pending(cpu_public, irqn);
 
@@ -179,6 +207,12 @@ bool arch_handle_phys_irq(u32 irqn, unsigned int count_event)
 
 int arch_cell_create(struct cell *cell)
 {
+	if ((cell->config->flags & JAILHOUSE_CELL_SDEI_IRQS) &&
+	    !sdei_available) {
+		printk("SDEI interrupt delivery not active\n");
+		return trace_error(-EINVAL);
+	}
+
 	return arm_paging_cell_init(cell);
 }
 
@@ -200,13 +234,23 @@ void arch_cell_reset(struct cell *cell)
 	 * All CPUs but the first are initially suspended.  The first CPU
 	 * starts at cpu_reset_address, defined in the cell configuration.
 	 */
-	public_per_cpu(first)->cpu_on_entry = cell->config->cpu_reset_address;
+	sched_set_cpu_on_entry(cell, first, cell->config->cpu_reset_address);
 	for_each_cpu_except(cpu, cell->cpu_set, first)
-		public_per_cpu(cpu)->cpu_on_entry = PSCI_INVALID_ADDRESS;
+		sched_set_cpu_on_entry(cell, cpu, PSCI_INVALID_ADDRESS);
 
 	arm_cell_dcaches_flush(cell, DCACHE_INVALIDATE);
 
 	irqchip_cell_reset(cell);
+
+	snapshot_cell_restore(cell);
+}
+
+unsigned long arch_timestamp_khz(void)
+{
+	u32 freq;
+
+	arm_read_sysreg(CNTFRQ_EL0, freq);
+	return freq / 1000;
 }
 
 void arch_cell_destroy(struct cell *cell)
@@ -219,23 +263,72 @@ void arch_cell_destroy(struct cell *cell)
 	for_each_cpu(cpu, cell->cpu_set)
 		public_per_cpu(cpu)->cpu_on_entry = PSCI_INVALID_ADDRESS;
 
+	color_cell_exit(cell);
 	arm_paging_cell_destroy(cell);
 }
 
-/* Note: only supports synchronous flushing as triggered by config_commit! */
+/*
+ * Note: only supports synchronous flushing as triggered by config_commit!
+ *
+ * Only the TLB entries of the ranges the cell lost since the last call are
+ * dropped, the other cells and the untouched mappings of the cell are kept.
+ */
 void arch_flush_cell_vcpu_caches(struct cell *cell)
 {
 	unsigned int cpu;
 
+	/*
+	 * Entries of a destroyed cell are dropped when its VMID is used again,
+	 * see arm_paging_vcpu_init.
+	 */
+	if (!cell->arch.mm.root_table) {
+		cell->arch.num_tlb_ranges = 0;
+		cell->arch.tlb_flush_all = false;
+		return;
+	}
+	if (cell->arch.num_tlb_ranges == 0 && !cell->arch.tlb_flush_all)
+		return;
+
+	if (cell == this_cell()) {
+		/* broadcast with the VMID of the cell, reaching all its CPUs */
+		arm_paging_cell_flush_tlbs(cell);
+		return;
+	}
+
 	for_each_cpu(cpu, cell->cpu_set)
-		if (cpu == this_cpu_id())
-			arm_paging_vcpu_flush_tlbs();
-		else
-			public_per_cpu(cpu)->flush_vcpu_caches = true;
+		sched_flush_vcpu_caches(cell, cpu);
+	cell->arch.num_tlb_ranges = 0;
+	cell->arch.tlb_flush_all = false;
+}
+
+int arch_cpu_move_check(unsigned int cpu_id)
+{
+	/* the vCPU of the other cell would have to move as well */
+	if (sched_cpu_shared(cpu_id))
+		return trace_error(-EBUSY);
+
+	/* only switched on the suspended CPU itself */
+	return public_per_cpu(cpu_id)->wait_for_poweron ? 0 : -EBUSY;
+}
+
+void arch_cell_cpus_changed(struct cell *cell)
+{
+	/* route the interrupts away from CPUs that left their cell */
+	irqchip_config_commit(cell);
 }
 
 void arch_config_commit(struct cell *cell_added_removed)
 {
+	root_cell.arch.s2_prebuilt = false;
+
+	/*
+	 * A new cell before it first runs. The SMMUs already walk the tables
+	 * of the root cell, and those of a destroyed cell are released.
+	 */
+	if (cell_added_removed && cell_added_removed != &root_cell &&
+	    cell_added_removed->arch.mm.root_table)
+		arm_paging_cell_consolidate(cell_added_removed);
+
 	irqchip_config_commit(cell_added_removed);
 	iommu_config_commit(cell_added_removed);
 }
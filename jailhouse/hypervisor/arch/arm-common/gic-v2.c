@@ -283,6 +283,18 @@ static void gicv2_adjust_irq_target(struct cell *cell, u16 irq_id)
 	mmio_write32(itargetsr, targets);
 }
 
+static void gicv2_set_irq_target(u16 irq_id, unsigned int cpu_id)
+{
+	void *itargetsr = gicd_base + GICD_ITARGETSR + (irq_id & ~0x3);
+	unsigned int shift = (irq_id % 4) * 8;
+	u32 targets = mmio_read32(itargetsr);
+
+	targets &= ~(0xff << shift);
+	targets |= gicv2_target_cpu_map[cpu_id] << shift;
+
+	mmio_write32(itargetsr, targets);
+}
+
 static void gicv2_send_sgi(struct sgi *sgi)
 {
 	u32 val;
@@ -527,6 +539,7 @@ const struct irqchip gicv2_irqchip = {
 	.cell_init = gicv2_cell_init,
 	.cell_exit = gicv2_cell_exit,
 	.adjust_irq_target = gicv2_adjust_irq_target,
+	.set_irq_target = gicv2_set_irq_target,
 
 	.send_sgi = gicv2_send_sgi,
 	.inject_irq = gicv2_inject_irq,
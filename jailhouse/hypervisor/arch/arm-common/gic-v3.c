@@ -10,15 +10,19 @@
  * the COPYING file in the top-level directory.
  */
 
+#include <jailhouse/bitops.h>
 #include <jailhouse/control.h>
 #include <jailhouse/mmio.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/processor.h>
+#include <jailhouse/string.h>
+#include <jailhouse/tracepoint.h>
 #include <jailhouse/types.h>
 #include <asm/control.h>
 #include <asm/gic.h>
 #include <asm/gic_v3.h>
 #include <asm/irqchip.h>
+#include <asm/irq_latency.h>
 #include <asm/smccc.h>
 #include <asm/sysregs.h>
 #include <asm/traps.h>
@@ -172,6 +176,9 @@ static void gicv3_clear_pending_irqs(void)
 	/* Clear list registers. */
 	for (n = 0; n < gic_num_lr; n++)
 		gicv3_write_lr(n, 0);
+	this_cpu_data()->lr_shadow = 0;
+	memset(this_cpu_data()->lr_irq_bitmap, 0,
+	       sizeof(this_cpu_data()->lr_irq_bitmap));
 
 	/* Clear active priority bits */
 	if (gic_num_priority_bits >= 5)
@@ -253,6 +260,15 @@ static int gicv3_cpu_init(struct per_cpu *cpu_data)
 		return -ENODEV;
 	}
 
+	/*
+	 * GICv4 could inject vLPIs (and v4.1 vSGIs) without exiting, but this
+	 * takes an ITS with vPE tables that the hypervisor does not manage.
+	 * Interrupts keep going through the list registers.
+	 */
+	if (cpu_data->public.cpu_id == 0 && (typer & GICR_TYPER_VLPIS))
+		printk("GIC: direct %s injection not supported, using LRs\n",
+		       (typer & GICR_TYPER_RVPEID) ? "vLPI/vSGI" : "vLPI");
+
 	/* Make sure we can handle Aff0 with the TargetList of ICC_SGI1R_EL1. */
 	if ((cpu_data->public.mpidr & MPIDR_AFF0_MASK) >= 16)
 		return trace_error(-EIO);
@@ -355,6 +371,76 @@ static int gicv3_cpu_shutdown(struct public_per_cpu *cpu_public)
 	return 0;
 }
 
+static void gicv3_cpu_save(struct irqchip_cpu_state *state)
+{
+	void *gicr = this_cpu_public()->gicr.base + GICR_SGI_BASE;
+	unsigned int n;
+
+	arm_read_sysreg(ICC_SRE_EL2, state->sre_el2);
+	arm_read_sysreg(ICC_CTLR_EL1, state->ctlr);
+	arm_read_sysreg(ICC_PMR_EL1, state->pmr);
+	arm_read_sysreg(ICC_BPR1_EL1, state->bpr1);
+	arm_read_sysreg(ICC_IGRPEN1_EL1, state->igrpen1);
+
+	arm_read_sysreg(ICH_HCR_EL2, state->ich_hcr);
+	arm_read_sysreg(ICH_VMCR_EL2, state->ich_vmcr);
+	for (n = 0; n < gic_num_lr; n++)
+		state->lr[n] = gicv3_read_lr(n);
+	if (gic_num_priority_bits >= 5)
+		arm_read_sysreg(ICH_AP1R0_EL2, state->ap1r[0]);
+	if (gic_num_priority_bits >= 6)
+		arm_read_sysreg(ICH_AP1R1_EL2, state->ap1r[1]);
+	if (gic_num_priority_bits > 6) {
+		arm_read_sysreg(ICH_AP1R2_EL2, state->ap1r[2]);
+		arm_read_sysreg(ICH_AP1R3_EL2, state->ap1r[3]);
+	}
+
+	/* Groups are left to the firmware, it owns the secure interrupts. */
+	state->isenabler = mmio_read32(gicr + GICR_ISENABLER);
+	state->isactiver = mmio_read32(gicr + GICR_ISACTIVER);
+	for (n = 0; n < ARRAY_SIZE(state->ipriorityr); n++)
+		state->ipriorityr[n] = mmio_read32(gicr + GICR_IPRIORITYR +
+						   n * 4);
+	state->icfgr1 = mmio_read32(gicr + GICR_ICFGR + 4);
+}
+
+static void gicv3_cpu_restore(const struct irqchip_cpu_state *state)
+{
+	void *gicr = this_cpu_public()->gicr.base + GICR_SGI_BASE;
+	unsigned int n;
+
+	arm_write_sysreg(ICC_SRE_EL2, state->sre_el2);
+	isb();
+	arm_write_sysreg(ICC_CTLR_EL1, state->ctlr);
+	arm_write_sysreg(ICC_PMR_EL1, state->pmr);
+	arm_write_sysreg(ICC_BPR1_EL1, state->bpr1);
+
+	for (n = 0; n < ARRAY_SIZE(state->ipriorityr); n++)
+		mmio_write32(gicr + GICR_IPRIORITYR + n * 4,
+			     state->ipriorityr[n]);
+	mmio_write32(gicr + GICR_ICFGR + 4, state->icfgr1);
+	mmio_write32(gicr + GICR_ICACTIVER, ~state->isactiver);
+	mmio_write32(gicr + GICR_ISACTIVER, state->isactiver);
+	mmio_write32(gicr + GICR_ICENABLER, ~state->isenabler);
+	mmio_write32(gicr + GICR_ISENABLER, state->isenabler);
+
+	if (gic_num_priority_bits >= 5)
+		arm_write_sysreg(ICH_AP1R0_EL2, state->ap1r[0]);
+	if (gic_num_priority_bits >= 6)
+		arm_write_sysreg(ICH_AP1R1_EL2, state->ap1r[1]);
+	if (gic_num_priority_bits > 6) {
+		arm_write_sysreg(ICH_AP1R2_EL2, state->ap1r[2]);
+		arm_write_sysreg(ICH_AP1R3_EL2, state->ap1r[3]);
+	}
+	for (n = 0; n < gic_num_lr; n++)
+		gicv3_write_lr(n, state->lr[n]);
+	arm_write_sysreg(ICH_VMCR_EL2, state->ich_vmcr);
+	arm_write_sysreg(ICH_HCR_EL2, state->ich_hcr);
+
+	arm_write_sysreg(ICC_IGRPEN1_EL1, state->igrpen1);
+	isb();
+}
+
 static void gicv3_adjust_irq_target(struct cell *cell, u16 irq_id)
 {
 	void *irouter = gicd_base + GICD_IROUTER + 8 * irq_id;
@@ -366,6 +452,11 @@ static void gicv3_adjust_irq_target(struct cell *cell, u16 irq_id)
 		mmio_write64(irouter, mpidr);
 }
 
+static void gicv3_set_irq_target(u16 irq_id, unsigned int cpu_id)
+{
+	gicv3_spi_route(irq_id, public_per_cpu(cpu_id)->mpidr);
+}
+
 static enum mmio_result gicv3_handle_redist_access(void *arg,
 						   struct mmio_access *mmio)
 {
@@ -523,9 +614,19 @@ static enum mmio_result gicv3_handle_irq_route(struct mmio_access *mmio,
 
 	if (mmio->is_write) {
 		/*
-		 * Validate that the target CPU is part of the cell.
-		 * Note that we do not support Interrupt Routing Mode = 1.
+		 * Interrupt Routing Mode = 1 is emulated by irqchip_steer_irq
+		 * if the cell asked for it, starting at its first CPU.
 		 */
+		if ((cell->config->flags & JAILHOUSE_CELL_IRQ_BALANCE) &&
+		    !sdei_available && (mmio->value & GICD_IROUTER_IRM)) {
+			set_bit(irq, cell->arch.irq_balance_bitmap);
+			gicv3_spi_route(irq, public_per_cpu(
+				first_cpu(cell->cpu_set))->mpidr);
+			return MMIO_HANDLED;
+		}
+		clear_bit(irq, cell->arch.irq_balance_bitmap);
+
+		/* Validate that the target CPU is part of the cell. */
 		for_each_cpu(cpu, cell->cpu_set)
 			if ((public_per_cpu(cpu)->mpidr & MPIDR_CPUID_MASK) ==
 			    mmio->value) {
@@ -537,6 +638,8 @@ static enum mmio_result gicv3_handle_irq_route(struct mmio_access *mmio,
 		return MMIO_ERROR;
 	} else {
 		mmio->value = mmio_read64(gicd_base + GICD_IROUTER + 8 * irq);
+		if (test_bit(irq, cell->arch.irq_balance_bitmap))
+			mmio->value |= GICD_IROUTER_IRM;
 		return MMIO_HANDLED;
 	}
 }
@@ -556,39 +659,46 @@ static void gicv3_eoi_irq(u32 irq_id, bool deactivate)
 		arm_write_sysreg(ICC_DIR_EL1, irq_id);
 }
 
+/*
+ * Drop the shadow of list registers the cell has retired since the last
+ * injection. ICH_ELSR_EL2 is the reference, so EOIs by the guest need no exit
+ * to keep the shadow in sync.
+ */
+static void gicv3_sync_lr_shadow(struct per_cpu *cpu_data, unsigned long elsr)
+{
+	unsigned long retired = elsr & cpu_data->lr_shadow;
+	unsigned int n;
+
+	for (; retired; retired &= ~(1UL << n)) {
+		n = ffsl(retired);
+		clear_bit(cpu_data->lr_irq[n], cpu_data->lr_irq_bitmap);
+		irq_latency_retired(cpu_data->lr_irq[n], n);
+	}
+	cpu_data->lr_shadow &= ~elsr;
+}
+
 static int gicv3_inject_irq(u16 irq_id, u16 sender)
 {
+	struct per_cpu *cpu_data = this_cpu_data();
+	unsigned long elsr;
 	unsigned int n;
-	int free_lr = -1;
-	u32 elsr;
 	u64 lr;
 
 	arm_read_sysreg(ICH_ELSR_EL2, elsr);
-	for (n = 0; n < gic_num_lr; n++) {
-		if ((elsr >> n) & 1) {
-			/* Entry is invalid, candidate for injection */
-			if (free_lr == -1)
-				free_lr = n;
-			continue;
-		}
-
-		/*
-		 * Entry is in use, check that it doesn't match the one we want
-		 * to inject.
-		 */
-		lr = gicv3_read_lr(n);
+	elsr &= (1UL << gic_num_lr) - 1;
+	gicv3_sync_lr_shadow(cpu_data, elsr);
 
-		/*
-		 * A strict phys->virt id mapping is used for SPIs, so this test
-		 * should be sufficient.
-		 */
-		if ((u32)lr == irq_id)
-			return -EEXIST;
-	}
+	/*
+	 * A strict phys->virt id mapping is used for SPIs, so this test
+	 * should be sufficient.
+	 */
+	if (test_bit(irq_id, cpu_data->lr_irq_bitmap))
+		return -EEXIST;
 
-	if (free_lr == -1)
+	if (!elsr)
 		/* All list registers are in use */
 		return -EBUSY;
+	n = ffsl(elsr);
 
 	lr = irq_id;
 	/* Only group 1 interrupts */
@@ -600,7 +710,13 @@ static int gicv3_inject_irq(u16 irq_id, u16 sender)
 	}
 	/* GICv3 doesn't support the injection of the calling CPU ID */
 
-	gicv3_write_lr(free_lr, lr);
+	gicv3_write_lr(n, lr);
+
+	cpu_data->lr_irq[n] = irq_id;
+	cpu_data->lr_shadow |= 1UL << n;
+	set_bit(irq_id, cpu_data->lr_irq_bitmap);
+	irq_latency_injected(irq_id, n);
+	tracepoint(TRACE_VIRQ_INJECT, irq_id, sender, n);
 
 	return 0;
 }
@@ -712,8 +828,11 @@ const struct irqchip gicv3_irqchip = {
 	.cpu_init = gicv3_cpu_init,
 	.cpu_reset = gicv3_cpu_reset,
 	.cpu_shutdown = gicv3_cpu_shutdown,
+	.cpu_save = gicv3_cpu_save,
+	.cpu_restore = gicv3_cpu_restore,
 	.cell_init = gicv3_cell_init,
 	.adjust_irq_target = gicv3_adjust_irq_target,
+	.set_irq_target = gicv3_set_irq_target,
 	.send_sgi = gicv3_send_sgi,
 	.inject_irq = gicv3_inject_irq,
 	.enable_maint_irq = gicv3_enable_maint_irq,
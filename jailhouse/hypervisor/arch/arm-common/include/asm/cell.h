@@ -14,6 +14,13 @@
 #define _JAILHOUSE_ASM_CELL_H
 
 #include <jailhouse/paging.h>
+#include <asm/spinlock.h>
+
+/* Unmapped IPA ranges tracked for the next TLB flush of a cell */
+#define ARM_TLB_FLUSH_RANGES	8
+
+/* Clusters a cell with JAILHOUSE_CELL_DIRECT_SGI may span */
+#define ARM_SGI_CLUSTERS	8
 
 struct pvu_tlb_entry;
 
@@ -21,11 +28,50 @@ struct arch_cell {
 	struct paging_structures mm;
 
 	u32 irq_bitmap[(1024+32)/32];
+	/** SPIs the guest routed 1-of-N, for JAILHOUSE_CELL_IRQ_BALANCE */
+	unsigned long irq_balance_bitmap[1024 / BITS_PER_LONG];
+	/** Coalescing window for cross-CPU virtual IRQs, in counter ticks */
+	u64 irq_coalesce_ticks;
 
 	struct {
 		u8 ent_count;
 		struct pvu_tlb_entry *entries;
 	} iommu_pvu; /**< ARM PVU specific fields. */
+
+	/** Reserved extent of the colored regions, set on first recoloring */
+	unsigned long *color_spans;
+
+	/** True while the stage-2 tables are the prebuilt ones of the root
+	 * cell, i.e. until the first configuration commit */
+	bool s2_prebuilt;
+
+	/** IPA ranges unmapped since the last TLB flush of the cell */
+	struct {
+		unsigned long start, size;
+	} tlb_ranges[ARM_TLB_FLUSH_RANGES];
+	unsigned int num_tlb_ranges;
+	/** True if the unmapped ranges did not fit into tlb_ranges */
+	bool tlb_flush_all;
+
+	/** True if the cell has JAILHOUSE_MEM_LAZY regions */
+	bool lazy_regions;
+	/** Serializes populating the lazy regions from the cell's CPUs */
+	spinlock_t lazy_lock;
+
+	/** Per cluster of the cell's CPUs, for JAILHOUSE_CELL_DIRECT_SGI */
+	struct arm_sgi_cluster {
+		/** Cluster as returned by irqchip_get_cluster_target */
+		u64 id;
+		/** Target list bits of the cell's CPUs in the cluster */
+		u16 targets;
+		/** CPU IDs by target list bit */
+		u16 cpus[16];
+	} sgi_clusters[ARM_SGI_CLUSTERS];
+	/** Number of valid sgi_clusters, 0 if SGIs take the generic path */
+	unsigned int num_sgi_clusters;
+
+	/** Interrupt state staged by arch_cell_prepare_restore(), or NULL */
+	struct jailhouse_irq_state *restore_irqs;
 };
 
 #endif /* !_JAILHOUSE_ASM_CELL_H */
@@ -25,6 +25,35 @@ static inline int color_copy_root(struct cell *root, bool init)
 	return -EINVAL;
 }
 
+static inline int color_cell_recolor(struct cell *cell, u64 colors)
+{
+	return -EINVAL;
+}
+
+static inline void color_cell_exit(struct cell *cell)
+{
+	return;
+}
+
+static inline long color_get_info(unsigned long type)
+{
+	return -EINVAL;
+}
+
+static inline void color_dcache_setway_help(void)
+{
+	return;
+}
+
+static inline int
+color_paging_create_part(const struct paging_structures *pg_structs,
+			 const struct jailhouse_memory *mem,
+			 unsigned long offs, unsigned long size,
+			 unsigned long access_flags, unsigned long paging_flags)
+{
+	return -EINVAL;
+}
+
 static inline void arm_color_dcache_flush_memory_region(
 	unsigned long phys,
 	unsigned long size,
@@ -32,7 +32,10 @@ unsigned int arm_cpu_by_mpidr(struct cell *cell, unsigned long mpidr);
 
 void arm_cpu_reset(unsigned long pc, bool aarch32);
 void arm_cpu_park(void);
+void arm_cpu_check_events(void);
 void arm_cpu_passthru_suspend(void);
+bool arm_cpu_idle(const struct jailhouse_idle_state *state,
+		  unsigned long entry, unsigned long context, long *result);
 
 #endif /* !__ASSEMBLY__ */
 
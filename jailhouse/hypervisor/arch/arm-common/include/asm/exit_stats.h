@@ -0,0 +1,63 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#ifndef _JAILHOUSE_ASM_EXIT_STATS_H
+#define _JAILHOUSE_ASM_EXIT_STATS_H
+
+#include <jailhouse/types.h>
+
+#if defined(__aarch64__)
+
+#include <asm/timer.h>
+
+/** Timestamp of the begin of a handler, pass to exit_stats_*() when done */
+static inline u64 exit_stats_start(void)
+{
+	return timer_get_ticks();
+}
+
+/** Account the time since \a start to the trap class of \a esr */
+void exit_stats_trap(u64 esr, u64 start);
+/** Account the time since \a start to the type of interrupt \a irqn */
+void exit_stats_irq(u32 irqn, u64 start);
+/** Copy the statistics of this CPU into the shared page, see cpu_stats.h */
+void exit_stats_publish(void);
+
+struct jailhouse_dsu_stats;
+/** Copy the DSU partition and counts of \a cluster into the shared page */
+void exit_stats_dsu_publish(unsigned int cluster,
+			    const struct jailhouse_dsu_stats *dsu);
+
+#else
+
+static inline u64 exit_stats_start(void)
+{
+	return 0;
+}
+
+static inline void exit_stats_trap(u64 esr, u64 start)
+{
+}
+
+static inline void exit_stats_irq(u32 irqn, u64 start)
+{
+}
+
+static inline void exit_stats_publish(void)
+{
+}
+
+struct jailhouse_dsu_stats;
+static inline void exit_stats_dsu_publish(unsigned int cluster,
+					  const struct jailhouse_dsu_stats *dsu)
+{
+}
+
+#endif
+
+#endif /* !_JAILHOUSE_ASM_EXIT_STATS_H */
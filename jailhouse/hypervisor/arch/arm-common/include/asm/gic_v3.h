@@ -41,9 +41,13 @@
 #define GICR_IPRIORITYR		GICD_IPRIORITYR
 #define GICR_ICFGR		GICD_ICFGR
 
+#define GICR_TYPER_VLPIS	(1 << 1)
 #define GICR_TYPER_Last		(1 << 4)
+#define GICR_TYPER_RVPEID	(1 << 7)
 #define GICR_PIDR2_ARCH		GICD_PIDR2_ARCH
 
+#define GICD_IROUTER_IRM	(1 << 31)
+
 #define ICC_IAR1_EL1		SYSREG_32(0, c12, c12, 0)
 #define ICC_EOIR1_EL1		SYSREG_32(0, c12, c12, 1)
 #define ICC_HPPIR1_EL1		SYSREG_32(0, c12, c12, 2)
@@ -144,4 +148,23 @@ static inline void gicv3_disable_irq(unsigned int irq)
 {
 	gicv3_set_bit(GICR_ICENABLER, irq);
 }
+
+/* SPIs are enabled and routed at the distributor */
+static inline void gicv3_spi_enable(unsigned int irq)
+{
+	mmio_write32(gicd_base + GICD_ISENABLER + IRQ_BIT_REG_OFF(irq),
+		     (1 << IRQ_BIT_POS(irq)));
+}
+
+static inline void gicv3_spi_disable(unsigned int irq)
+{
+	mmio_write32(gicd_base + GICD_ICENABLER + IRQ_BIT_REG_OFF(irq),
+		     (1 << IRQ_BIT_POS(irq)));
+}
+
+static inline void gicv3_spi_route(unsigned int irq, u64 mpidr)
+{
+	mmio_write64(gicd_base + GICD_IROUTER + 8 * irq,
+		     mpidr & MPIDR_CPUID_MASK);
+}
 #endif /* _JAILHOUSE_ASM_GIC_V3_H */
@@ -28,4 +28,8 @@ int iommu_map_memory_region(struct cell *cell,
 int iommu_unmap_memory_region(struct cell *cell,
 			      const struct jailhouse_memory *mem);
 void iommu_config_commit(struct cell *cell);
+void iommu_flush_cell_tlbs(struct cell *cell);
+void iommu_flush_cell_tlb_range(struct cell *cell, unsigned long addr,
+				unsigned long size);
+bool iommu_handle_irq(u32 irqn);
 #endif
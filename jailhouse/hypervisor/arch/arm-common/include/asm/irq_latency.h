@@ -0,0 +1,45 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#ifndef _JAILHOUSE_ASM_IRQ_LATENCY_H
+#define _JAILHOUSE_ASM_IRQ_LATENCY_H
+
+#include <jailhouse/types.h>
+
+#ifdef CONFIG_IRQ_LATENCY_STATS
+
+/** Publish the counter frequency, histograms are valid from now on */
+void irq_latency_init(void);
+/** Timestamp the arrival of physical interrupt \a irq_id on this CPU */
+void irq_latency_arrival(u32 irq_id);
+/** Account the injection of \a irq_id into list register \a lr */
+void irq_latency_injected(u16 irq_id, unsigned int lr);
+/** Account the retirement of \a irq_id from list register \a lr */
+void irq_latency_retired(u16 irq_id, unsigned int lr);
+
+#else
+
+static inline void irq_latency_init(void)
+{
+}
+
+static inline void irq_latency_arrival(u32 irq_id)
+{
+}
+
+static inline void irq_latency_injected(u16 irq_id, unsigned int lr)
+{
+}
+
+static inline void irq_latency_retired(u16 irq_id, unsigned int lr)
+{
+}
+
+#endif /* CONFIG_IRQ_LATENCY_STATS */
+
+#endif /* !_JAILHOUSE_ASM_IRQ_LATENCY_H */
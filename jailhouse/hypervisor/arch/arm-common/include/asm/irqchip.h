@@ -37,14 +37,37 @@ struct sgi {
 	u16	id;
 };
 
+/**
+ * State of the CPU interface and of the SGI/PPI frame of the redistributor
+ * that a power-down idle state loses (only GICv3).
+ */
+struct irqchip_cpu_state {
+	u64 lr[16];
+	u32 ap1r[4];
+	u32 sre_el2;
+	u32 ctlr;
+	u32 pmr;
+	u32 bpr1;
+	u32 igrpen1;
+	u32 ich_hcr;
+	u32 ich_vmcr;
+	u32 isenabler;
+	u32 isactiver;
+	u32 ipriorityr[8];
+	u32 icfgr1;
+};
+
 struct irqchip {
 	int	(*init)(void);
 	int	(*cpu_init)(struct per_cpu *cpu_data);
 	void	(*cpu_reset)(struct per_cpu *cpu_data);
 	int	(*cpu_shutdown)(struct public_per_cpu *cpu_public);
+	void	(*cpu_save)(struct irqchip_cpu_state *state);
+	void	(*cpu_restore)(const struct irqchip_cpu_state *state);
 	int	(*cell_init)(struct cell *cell);
 	void	(*cell_exit)(struct cell *cell);
 	void	(*adjust_irq_target)(struct cell *cell, u16 irq_id);
+	void	(*set_irq_target)(u16 irq_id, unsigned int cpu_id);
 
 	void	(*send_sgi)(struct sgi *sgi);
 	u32	(*read_iar_irqn)(void);
@@ -67,15 +90,31 @@ struct irqchip {
 	unsigned long gicd_size;
 };
 
+/* Marks a filled slot of the pending ring */
+#define PENDING_IRQ_VALID	(1U << 31)
+#define PENDING_IRQ_SENDER_SHIFT	16
+
 struct pending_irqs {
-	/* synchronizes parallel insertions of SGIs into the pending ring */
-	spinlock_t lock;
-	u16 irqs[MAX_PENDING_IRQS];
-	/* contains the calling CPU ID in case of a SGI */
-	u16 sender[MAX_PENDING_IRQS];
-	unsigned int head;
-	/* removal from the ring happens lockless, thus tail is volatile */
-	volatile unsigned int tail;
+	/*
+	 * PENDING_IRQ_VALID | sender << PENDING_IRQ_SENDER_SHIFT | irq_id,
+	 * with the calling CPU ID as sender in case of a SGI. A slot is
+	 * zero while its producer is still writing it, or after consumption.
+	 */
+	volatile u32 slots[MAX_PENDING_IRQS];
+	/* removal from the ring happens lockless, only by the owning CPU */
+	volatile unsigned int head __cacheline_aligned;
+	/* counter value that ends the coalescing window, 0 if none is open */
+	volatile u64 window_end;
+	/*
+	 * Insertions reserve their slot by advancing tail via atomic_cas. On
+	 * its own line so that producers do not bounce the one of head.
+	 */
+	volatile unsigned int tail __cacheline_aligned;
+	/*
+	 * Set while SGI_INJECT is outstanding or a coalescing window is open:
+	 * insertions then only queue.
+	 */
+	volatile u32 kick_pending;
 };
 
 int irqchip_cpu_init(struct per_cpu *cpu_data);
@@ -85,6 +124,9 @@ void irqchip_cpu_reset(struct per_cpu *cpu_data);
 
 void irqchip_cpu_shutdown(struct public_per_cpu *cpu_public);
 
+bool irqchip_cpu_save(struct irqchip_cpu_state *state);
+void irqchip_cpu_restore(const struct irqchip_cpu_state *state);
+
 void irqchip_cell_reset(struct cell *cell);
 
 void irqchip_config_commit(struct cell *cell_added_removed);
@@ -96,8 +138,12 @@ bool irqchip_has_pending_irqs(void);
 
 void irqchip_inject_pending(void);
 void irqchip_set_pending(struct public_per_cpu *cpu_public, u16 irq_id);
+/* irqchip_set_pending for the running vCPU of a time-shared CPU */
+void irqchip_queue_irq(struct public_per_cpu *cpu_public, u16 irq_id);
+void irqchip_drain_pending(unsigned long *bitmap);
 
 void irqchip_trigger_external_irq(u16 irq_id);
+void irqchip_set_irq_target(u16 irq_id, unsigned int cpu_id);
 
 bool irqchip_irq_in_cell(struct cell *cell, unsigned int irq_id);
 
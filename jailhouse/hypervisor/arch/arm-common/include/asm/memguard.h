@@ -24,21 +24,24 @@
  * in the gicv2. init and shutdown functions could then be moved in the
  * unit.init, and in the irqchip.
  */
-/** Register hv_timer handler, initialize SPI prio */
+/** Register hv_timer IRQ, initialize SPI prio */
 extern int memguard_init(void);
 /** Initialize SGI/PPI prio, unmask timer, enable hv_timer IRQ */
 extern void memguard_cpu_init(void);
-/** Mask and disable timer, deregister handler, disable hv_timer IRQ */
+/** Mask and disable timer, drop its events, disable hv_timer IRQ */
 extern void memguard_cpu_shutdown(void);
 extern void memguard_cpu_reset(void);
 
-/** ISR for timer and PMU irq events */
-extern bool memguard_isr_timer(void);
+/** ISR for PMU and DSU irq events */
 extern bool memguard_isr_pmu(void);
+extern bool memguard_isr_dsu(void);
 
 /** Block CPU if needed */
 extern void memguard_cpu_block(void);
 
+/** Apply a pending cell-wide configuration, called with control_lock held */
+extern void memguard_cpu_update(void);
+
 #else
 
 /* ARMv7 stubs */
@@ -66,6 +69,11 @@ static inline void memguard_cpu_block(void)
 {
 	return;
 }
+
+static inline void memguard_cpu_update(void)
+{
+	return;
+}
 #endif
 
 #endif
@@ -17,9 +17,16 @@
 
 #define ARM_PERCPU_FIELDS						\
 	int smccc_feat_workaround_1;					\
-	int smccc_feat_workaround_2;
+	int smccc_feat_workaround_2;					\
+									\
+	/** GICv3: virtual IRQ written to each list register. */	\
+	u16 lr_irq[16];							\
+	/** GICv3: list registers whose IRQ is recorded in lr_irq. */	\
+	unsigned long lr_shadow;					\
+	/** GICv3: virtual IRQs recorded in lr_irq. */			\
+	unsigned long lr_irq_bitmap[1024 / BITS_PER_LONG];
 
-#define ARCH_PUBLIC_PERCPU_FIELDS					\
+#define ARM_PUBLIC_PERCPU_FIELDS						\
 	unsigned long mpidr;						\
 									\
 	union {								\
@@ -35,7 +42,8 @@
 		} gicr;							\
 	};								\
 									\
-	struct pending_irqs pending_irqs;				\
+	/** Filled by other CPUs, see irqchip_set_pending. */		\
+	struct pending_irqs pending_irqs __cacheline_aligned;		\
 									\
 	/**								\
 	 * Lock protecting CPU state changes done for control tasks.	\
@@ -51,7 +59,7 @@
 	 * @li public_per_cpu::reset					\
 	 * @li public_per_cpu::park					\
 	 */								\
-	spinlock_t control_lock;					\
+	spinlock_t control_lock __cacheline_aligned;			\
 									\
 	/** True if CPU is waiting for power-on. */			\
 	volatile bool wait_for_poweron;					\
@@ -59,6 +67,8 @@
 	bool reset;							\
 	/** Set to true for pending park. */				\
 	bool park;							\
+	/** Set while a set/way flush of the caches is pending. */	\
+	volatile bool flush_dcache_setway;				\
 									\
 	unsigned long cpu_on_entry;					\
 	unsigned long cpu_on_context;
@@ -0,0 +1,43 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#ifndef _JAILHOUSE_ASM_PERF_H
+#define _JAILHOUSE_ASM_PERF_H
+
+#include <jailhouse/entry.h>
+
+struct per_cpu;
+
+#if defined(__aarch64__) && defined(CONFIG_PMU_SAMPLING)
+
+/** Reserve the sampling counter, after memguard got its counters */
+void perf_init(void);
+/** Apply a configuration queued by perf_set, called with control_lock held */
+void perf_cpu_update(void);
+/** Configure sampling on a set of CPUs, see struct perf_args */
+int perf_set(struct per_cpu *cpu_data, unsigned long args_address);
+
+#else
+
+static inline void perf_init(void)
+{
+}
+
+static inline void perf_cpu_update(void)
+{
+}
+
+static inline int perf_set(struct per_cpu *cpu_data,
+			   unsigned long args_address)
+{
+	return -ENOSYS;
+}
+
+#endif
+
+#endif /* !_JAILHOUSE_ASM_PERF_H */
@@ -13,6 +13,7 @@
 
 #if defined(__aarch64__)
 #include <asm/pmu64.h>
+#include <asm/dsu_pmu.h>
 #else
 static inline bool irq_is_pmu(u32 irqno)
 {
@@ -25,6 +26,16 @@ static inline bool pmu_isr_handler(void)
 	/* and if we end up here, just pretend all's good */
 	return true;
 }
+
+static inline bool irq_is_dsu(u32 irqno)
+{
+	return false;
+}
+
+static inline bool dsu_isr_handler(void)
+{
+	return true;
+}
 #endif
 
 #endif
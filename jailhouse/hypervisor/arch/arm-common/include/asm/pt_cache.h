@@ -0,0 +1,20 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor - Stubs for ARMv7
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_ASM_PT_CACHE_H
+#define _JAILHOUSE_ASM_PT_CACHE_H
+
+#include <jailhouse/paging.h>
+
+static inline int pt_cache_install(struct paging_structures *pg_structs)
+{
+	return -ENOENT;
+}
+
+#endif /* !_JAILHOUSE_ASM_PT_CACHE_H */
@@ -0,0 +1,59 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor - Stubs for ARMv7
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#ifndef _JAILHOUSE_ASM_SCHED_H
+#define _JAILHOUSE_ASM_SCHED_H
+
+#include <jailhouse/percpu.h>
+
+static inline void sched_cpu_update(void)
+{
+}
+
+static inline void sched_take_requests(struct public_per_cpu *cpu_public)
+{
+}
+
+static inline bool sched_cpu_shared(unsigned int cpu_id)
+{
+	return false;
+}
+
+static inline bool sched_wait_for_poweron(struct cell *cell,
+					  unsigned int cpu_id)
+{
+	return public_per_cpu(cpu_id)->wait_for_poweron;
+}
+
+static inline void sched_set_cpu_on_entry(struct cell *cell,
+					  unsigned int cpu_id,
+					  unsigned long entry)
+{
+	public_per_cpu(cpu_id)->cpu_on_entry = entry;
+}
+
+static inline void sched_flush_vcpu_caches(struct cell *cell,
+					   unsigned int cpu_id)
+{
+	public_per_cpu(cpu_id)->flush_vcpu_caches = true;
+}
+
+static inline bool sched_cpu_on(struct cell *cell, unsigned int cpu_id,
+				unsigned long entry, unsigned long context,
+				long *result)
+{
+	return false;
+}
+
+static inline bool sched_set_pending(struct public_per_cpu *cpu_public,
+				     u16 irq_id)
+{
+	return false;
+}
+
+#endif /* !_JAILHOUSE_ASM_SCHED_H */
@@ -0,0 +1,29 @@
+/*
+ * Jailhouse Cell Snapshot Support - Stubs for ARMv7
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#ifndef _JAILHOUSE_ASM_SNAPSHOT_H
+#define _JAILHOUSE_ASM_SNAPSHOT_H
+
+#include <jailhouse/cell.h>
+
+static inline void snapshot_cpu_save_help(void)
+{
+	return;
+}
+
+static inline void snapshot_cell_restore(struct cell *cell)
+{
+	return;
+}
+
+static inline void snapshot_cpu_restore(void)
+{
+	return;
+}
+
+#endif /* _JAILHOUSE_ASM_SNAPSHOT_H */
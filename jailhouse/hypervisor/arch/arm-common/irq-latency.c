@@ -0,0 +1,133 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * IRQ latency histograms: physical arrival -> list register write -> guest
+ * EOI. A retirement is only noticed on the next injection on the CPU, which
+ * makes the second stage an upper bound.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/control.h>
+#include <jailhouse/irq-latency.h>
+#include <jailhouse/percpu.h>
+#include <asm/irq_latency.h>
+#include <asm/spinlock.h>
+#include <asm/sysregs.h>
+
+/* Maximum number of list registers, see ICH_VTR_EL2.ListRegs */
+#define MAX_LRS		16
+
+struct irq_latency irq_latency __attribute__((section(".irqstats")));
+
+static struct {
+	/** Last physical interrupt taken by the CPU and its arrival */
+	u32 arrival_irq;
+	u64 arrival;
+	/** Injection time of the interrupt in each list register */
+	u64 injected[MAX_LRS];
+} irq_latency_cpu[IRQ_LATENCY_CPUS];
+
+/* Per-IRQ histogram slot + 1 of each interrupt, assigned on first use */
+static u8 irq_slot[1024];
+static spinlock_t slot_lock;
+
+static inline u64 irq_latency_now(void)
+{
+	u64 now;
+
+	arm_read_sysreg(CNTPCT_EL0, now);
+	return now;
+}
+
+static unsigned int irq_latency_bucket(u64 delta)
+{
+	if (delta >> (IRQ_LATENCY_BUCKETS - 1))
+		return IRQ_LATENCY_BUCKETS - 1;
+	if (!delta)
+		return 0;
+	return BITS_PER_LONG - 1 - clz((unsigned long)delta);
+}
+
+static int irq_latency_slot(u16 irq_id)
+{
+	unsigned int n;
+	int slot;
+
+	if (irq_id >= ARRAY_SIZE(irq_slot))
+		return -1;
+	if (irq_slot[irq_id])
+		return irq_slot[irq_id] - 1;
+
+	spin_lock(&slot_lock);
+	slot = irq_slot[irq_id] - 1;
+	for (n = 0; slot < 0 && n < IRQ_LATENCY_IRQS; n++)
+		if (irq_latency.irqs[n] == 0) {
+			irq_latency.irqs[n] = irq_id;
+			irq_slot[irq_id] = n + 1;
+			slot = n;
+		}
+	spin_unlock(&slot_lock);
+
+	return slot;
+}
+
+static void irq_latency_account(u16 irq_id, unsigned int stage, u64 delta)
+{
+	unsigned int bucket = irq_latency_bucket(delta);
+	int slot = irq_latency_slot(irq_id);
+
+	irq_latency.cpu[this_cpu_id()][stage].buckets[bucket]++;
+	if (slot >= 0)
+		irq_latency.irq[slot][stage].buckets[bucket]++;
+}
+
+void irq_latency_init(void)
+{
+	u32 freq;
+
+	arm_read_sysreg(CNTFRQ_EL0, freq);
+	irq_latency.freq = freq;
+}
+
+void irq_latency_arrival(u32 irq_id)
+{
+	if (this_cpu_id() >= IRQ_LATENCY_CPUS)
+		return;
+
+	irq_latency_cpu[this_cpu_id()].arrival_irq = irq_id;
+	irq_latency_cpu[this_cpu_id()].arrival = irq_latency_now();
+}
+
+void irq_latency_injected(u16 irq_id, unsigned int lr)
+{
+	unsigned int cpu = this_cpu_id();
+	u64 now;
+
+	if (cpu >= IRQ_LATENCY_CPUS || lr >= MAX_LRS)
+		return;
+
+	now = irq_latency_now();
+	irq_latency_cpu[cpu].injected[lr] = now;
+
+	/* Queued or virtual interrupts have no arrival on this CPU */
+	if (irq_latency_cpu[cpu].arrival_irq == irq_id) {
+		irq_latency_account(irq_id, IRQ_LATENCY_INJECT,
+				    now - irq_latency_cpu[cpu].arrival);
+		irq_latency_cpu[cpu].arrival_irq = ~0;
+	}
+}
+
+void irq_latency_retired(u16 irq_id, unsigned int lr)
+{
+	unsigned int cpu = this_cpu_id();
+
+	if (cpu >= IRQ_LATENCY_CPUS || lr >= MAX_LRS)
+		return;
+
+	irq_latency_account(irq_id, IRQ_LATENCY_EOI,
+			    irq_latency_now() - irq_latency_cpu[cpu].injected[lr]);
+}
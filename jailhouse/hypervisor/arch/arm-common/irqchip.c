@@ -12,19 +12,26 @@
  * the COPYING file in the top-level directory.
  */
 
+#include <jailhouse/bitops.h>
 #include <jailhouse/control.h>
 #include <jailhouse/entry.h>
 #include <jailhouse/mmio.h>
 #include <jailhouse/paging.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/string.h>
+#include <jailhouse/tracepoint.h>
 #include <jailhouse/unit.h>
+#include <jailhouse/utils.h>
 #include <jailhouse/assert.h>
 #include <asm/control.h>
+#include <asm/exit_stats.h>
 #include <asm/gic.h>
 #include <asm/irqchip.h>
+#include <asm/irq_latency.h>
+#include <asm/sched.h>
 #include <asm/smccc.h>
 #include <asm/sysregs.h>
+#include <asm/timer.h>
 #include <asm/memguard.h>
 
 #define for_each_irqchip(chip, config, counter)				\
@@ -50,7 +57,9 @@ static struct irqchip irqchip;
  * Such registers can be handled by setting the `is_poke' boolean, which allows
  * to simply restrict the mmio->value with the cell configuration mask.
  * Others, such as the priority registers, will need to be read and written back
- * with a restricted value, by using the distributor lock.
+ * with a restricted value, by using the distributor lock. That is not needed if
+ * all the IRQs of the accessed register belong to the cell: no one else writes
+ * to it then, and the value can be stored directly.
  */
 static enum mmio_result
 restrict_bitmask_access(struct mmio_access *mmio, unsigned int reg_index,
@@ -58,7 +67,7 @@ restrict_bitmask_access(struct mmio_access *mmio, unsigned int reg_index,
 {
 	struct cell *cell = this_cell();
 	unsigned int irq;
-	unsigned long access_mask = 0;
+	unsigned long access_mask = 0, access_bits, in_cell;
 	/*
 	 * In order to avoid division, the number of bits per irq is limited
 	 * to powers of 2 for the moment.
@@ -68,9 +77,19 @@ restrict_bitmask_access(struct mmio_access *mmio, unsigned int reg_index,
 	/* First, extract the first interrupt affected by this access */
 	unsigned int first_irq = reg_index * irqs_per_reg;
 
-	for (irq = 0; irq < irqs_per_reg; irq++)
-		if (irqchip_irq_in_cell(cell, first_irq + irq))
-			access_mask |= irq_bits << (irq * bits_per_irq);
+	/* The IRQs of a register never span two words of the bitmap */
+	in_cell = cell->arch.irq_bitmap[first_irq / 32] >> (first_irq % 32);
+	if (bits_per_irq == 1)
+		access_mask = in_cell;
+	else
+		for (irq = 0; irq < irqs_per_reg; irq++)
+			if (in_cell & (1 << irq))
+				access_mask |= irq_bits << (irq * bits_per_irq);
+
+	/* Byte accesses, e.g. to a single priority, only cover their part */
+	access_bits = mmio->size < 4 ? (1UL << (mmio->size * 8)) - 1 :
+		0xffffffffUL;
+	access_mask = (access_mask >> ((mmio->address & 3) * 8)) & access_bits;
 
 	if (!mmio->is_write) {
 		/* Restrict the read value */
@@ -79,7 +98,14 @@ restrict_bitmask_access(struct mmio_access *mmio, unsigned int reg_index,
 		return MMIO_HANDLED;
 	}
 
-	if (!is_poke) {
+	/*
+	 * Nothing to change. Do not write back the current value either: it
+	 * could overwrite a concurrent direct store of the owning cell.
+	 */
+	if (access_mask == 0)
+		return MMIO_HANDLED;
+
+	if (!is_poke && access_mask != access_bits) {
 		/*
 		 * Modify the existing value of this register by first reading
 		 * it into mmio->value
@@ -105,15 +131,30 @@ restrict_bitmask_access(struct mmio_access *mmio, unsigned int reg_index,
 	return MMIO_HANDLED;
 }
 
+static void gic_handle_direct_sgi(struct cell *cell, const struct sgi *sgi);
+
 void gic_handle_sgir_write(struct sgi *sgi)
 {
 	struct public_per_cpu *cpu_public = this_cpu_public();
 	unsigned int cpu, target;
+	unsigned long remaining = sgi->targets;
 	u64 cluster;
 
+	/*
+	 * Fast path for SGIs the caller sends to itself via its own target
+	 * bit, e.g. Linux irq_work: no need to walk the cell CPUs.
+	 */
+	if (sgi->routing_mode == 0 &&
+	    sgi->targets == irqchip_get_cpu_target(cpu_public->cpu_id) &&
+	    sgi->cluster_id == irqchip_get_cluster_target(cpu_public->cpu_id))
+		sgi->routing_mode = 2;
+
 	if (sgi->routing_mode == 2)
 		/* Route to the caller itself */
 		irqchip_set_pending(cpu_public, sgi->id);
+	else if (sgi->routing_mode == 0 &&
+		 this_cell()->arch.num_sgi_clusters > 0)
+		gic_handle_direct_sgi(this_cell(), sgi);
 	else
 		for_each_cpu(cpu, this_cell()->cpu_set) {
 			if (sgi->routing_mode == 1) {
@@ -121,61 +162,135 @@ void gic_handle_sgir_write(struct sgi *sgi)
 				if (cpu == cpu_public->cpu_id)
 					continue;
 			} else {
+				/* All targets served */
+				if (!remaining)
+					break;
+
 				target = irqchip_get_cpu_target(cpu);
 				cluster = irqchip_get_cluster_target(cpu);
 
 				/* Route to target CPUs in cell */
 				if ((sgi->cluster_id != cluster) ||
-				    !(sgi->targets & target))
+				    !(remaining & target))
 					continue;
+				remaining &= ~target;
 			}
 
 			irqchip_set_pending(public_per_cpu(cpu), sgi->id);
 		}
 }
 
+/* Distributor register classes, see dist_reg_classes */
+enum {
+	DIST_REG_OTHER = 0,
+	DIST_REG_POKE,
+	DIST_REG_GROUP,
+	DIST_REG_CFG,
+	DIST_REG_PRIORITY,
+	DIST_REG_TARGET,
+	DIST_REG_ROUTE,
+};
+
+/* The register arrays handled here are aligned to 128 bytes */
+#define DIST_BLOCK(reg)		((reg) >> 7)
+
+/*
+ * Class of each 128 byte block of the distributor, so that the dispatch of
+ * an access costs a table lookup and a jump instead of a compare chain.
+ */
+static const u8 dist_reg_classes[DIST_BLOCK(GICD_IROUTER + 1024 * 8)] = {
+	[DIST_BLOCK(GICD_IGROUPR)] = DIST_REG_GROUP,
+	[DIST_BLOCK(GICD_ISENABLER) ... DIST_BLOCK(GICD_IPRIORITYR) - 1] =
+		DIST_REG_POKE,
+	[DIST_BLOCK(GICD_IPRIORITYR) ... DIST_BLOCK(GICD_ITARGETSR) - 1] =
+		DIST_REG_PRIORITY,
+	[DIST_BLOCK(GICD_ITARGETSR) ... DIST_BLOCK(GICD_ICFGR) - 1] =
+		DIST_REG_TARGET,
+	[DIST_BLOCK(GICD_ICFGR) ... DIST_BLOCK(GICD_ICFGR + 64 * 4) - 1] =
+		DIST_REG_CFG,
+	[DIST_BLOCK(GICD_IROUTER) ... DIST_BLOCK(GICD_IROUTER + 1024 * 8) - 1] =
+		DIST_REG_ROUTE,
+};
+
 static enum mmio_result gic_handle_dist_access(void *arg,
 					       struct mmio_access *mmio)
 {
 	unsigned long reg = mmio->address;
-	enum mmio_result ret;
-
-	switch (reg) {
-	case REG_RANGE(GICD_IROUTER, 1024, 8):
-		ret = irqchip.handle_irq_route(mmio, (reg - GICD_IROUTER) / 8);
-		break;
-
-	case REG_RANGE(GICD_ITARGETSR, 1024, 1):
-		ret = irqchip.handle_irq_target(mmio, reg - GICD_ITARGETSR);
-		break;
-
-	case REG_RANGE(GICD_ICENABLER, 32, 4):
-	case REG_RANGE(GICD_ISENABLER, 32, 4):
-	case REG_RANGE(GICD_ICPENDR, 32, 4):
-	case REG_RANGE(GICD_ISPENDR, 32, 4):
-	case REG_RANGE(GICD_ICACTIVER, 32, 4):
-	case REG_RANGE(GICD_ISACTIVER, 32, 4):
-		ret = restrict_bitmask_access(mmio, (reg & 0x7f) / 4, 1, true);
-		break;
-
-	case REG_RANGE(GICD_IGROUPR, 32, 4):
-		ret = restrict_bitmask_access(mmio, (reg & 0x7f) / 4, 1, false);
-		break;
-
-	case REG_RANGE(GICD_ICFGR, 64, 4):
-		ret = restrict_bitmask_access(mmio, (reg & 0xff) / 4, 2, false);
-		break;
-
-	case REG_RANGE(GICD_IPRIORITYR, 255, 4):
-		ret = restrict_bitmask_access(mmio, (reg & 0x3ff) / 4, 8,
-					      false);
-		break;
-
+	unsigned int class = DIST_REG_OTHER;
+
+	if (DIST_BLOCK(reg) < ARRAY_SIZE(dist_reg_classes))
+		class = dist_reg_classes[DIST_BLOCK(reg)];
+
+	switch (class) {
+	case DIST_REG_ROUTE:
+		return irqchip.handle_irq_route(mmio, (reg - GICD_IROUTER) / 8);
+	case DIST_REG_TARGET:
+		return irqchip.handle_irq_target(mmio, reg - GICD_ITARGETSR);
+	case DIST_REG_POKE:
+		return restrict_bitmask_access(mmio, (reg & 0x7f) / 4, 1, true);
+	case DIST_REG_GROUP:
+		return restrict_bitmask_access(mmio, (reg & 0x7f) / 4, 1, false);
+	case DIST_REG_CFG:
+		return restrict_bitmask_access(mmio, (reg & 0xff) / 4, 2, false);
+	case DIST_REG_PRIORITY:
+		return restrict_bitmask_access(mmio, (reg & 0x3ff) / 4, 8,
+					       false);
 	default:
-		ret = irqchip.handle_dist_access(mmio);
+		return irqchip.handle_dist_access(mmio);
 	}
+}
 
-	return ret;
+/*
+ * Close an expired coalescing window. Insertions made while it was open are
+ * injected now, which opens a new window.
+ */
+static void irqchip_close_window(void)
+{
+	struct pending_irqs *pending = &this_cpu_public()->pending_irqs;
+	u64 now;
+
+	if (!pending->window_end)
+		return;
+
+	arm_read_sysreg(CNTPCT_EL0, now);
+	if (now < pending->window_end)
+		return;
+
+	if (pending->head == pending->tail) {
+		pending->window_end = 0;
+		pending->kick_pending = 0;
+		memory_barrier();
+		/* Catch insertions that still saw the window open */
+		if (pending->head == pending->tail)
+			return;
+	}
+	irqchip_inject_pending();
+}
+
+/*
+ * Emulation of the 1-of-N routing mode: after delivering an SPI the guest
+ * routed that way, move it to the CPU of the cell with the fewest virtual
+ * IRQs so far. This only costs a GICD write when the target changes.
+ */
+static void irqchip_steer_irq(struct cell *cell, u16 irq_id)
+{
+	struct public_per_cpu *self = this_cpu_public();
+	unsigned int cpu, target = self->cpu_id;
+	u32 load, min_load = self->stats[JAILHOUSE_CPU_STAT_VMEXITS_VIRQ];
+
+	for_each_cpu(cpu, cell->cpu_set) {
+		load = public_per_cpu(cpu)->
+			stats[JAILHOUSE_CPU_STAT_VMEXITS_VIRQ];
+		if (load < min_load) {
+			min_load = load;
+			target = cpu;
+		}
+	}
+
+	if (target != self->cpu_id) {
+		irqchip.set_irq_target(irq_id, target);
+		self->stats[JAILHOUSE_CPU_STAT_IRQ_STEERED]++;
+	}
 }
 
 void irqchip_handle_irq(void)
@@ -183,21 +298,31 @@ void irqchip_handle_irq(void)
 	unsigned int count_event = 1;
 	bool handled = false;
 	u32 irq_id;
+	u64 start;
 
 	while (1) {
+		start = exit_stats_start();
+
 		/* Read IAR1: set 'active' state */
 		irq_id = irqchip.read_iar_irqn();
 
 		if (irq_id == 0x3ff) /* Spurious IRQ */
 			break;
 
+		tracepoint(TRACE_IRQ, irq_id, 0, 0);
+
 		/* Handle IRQ */
 		if (is_sgi(irq_id)) {
 			arch_handle_sgi(irq_id, count_event);
 			handled = true;
 		} else {
+			irq_latency_arrival(irq_id);
 			isb();
 			handled = arch_handle_phys_irq(irq_id, count_event);
+			if (is_spi(irq_id) &&
+			    test_bit(irq_id,
+				     this_cell()->arch.irq_balance_bitmap))
+				irqchip_steer_irq(this_cell(), irq_id);
 		}
 		count_event = 0;
 
@@ -208,10 +333,14 @@ void irqchip_handle_irq(void)
 		 * interrupt that needs handling in the guest (e.g. timer)
 		 */
 		irqchip.eoi_irq(irq_id, handled);
+		exit_stats_irq(irq_id, start);
 
 		/* check possible memguard blocking */
 		memguard_cpu_block();
 	}
+
+	irqchip_close_window();
+	exit_stats_publish();
 }
 
 bool irqchip_irq_in_cell(struct cell *cell, unsigned int irq_id)
@@ -227,42 +356,120 @@ bool irqchip_has_pending_irqs(void)
 	return irqchip.has_pending_irqs();
 }
 
-void irqchip_set_pending(struct public_per_cpu *cpu_public, u16 irq_id)
+/*
+ * Queue insertion is lock-free so that several CPUs can target the same CPU
+ * without serializing: producers reserve a slot by advancing the tail and
+ * then fill it. The owning CPU consumes in order and stops at a reserved but
+ * not yet filled slot. Its producer kicks it again afterwards.
+ */
+static bool pending_irq_enqueue(struct pending_irqs *pending, u16 irq_id,
+				u16 sender)
 {
-	struct pending_irqs *pending = &cpu_public->pending_irqs;
-	bool local_injection = (this_cpu_public() == cpu_public);
-	const u16 sender = this_cpu_id();
-	unsigned int new_tail;
+	unsigned int tail, new_tail;
+
+	do {
+		tail = pending->tail;
+		new_tail = (tail + 1) % MAX_PENDING_IRQS;
+
+		/* Queue space available? */
+		if (new_tail == pending->head)
+			return false;
+	} while (atomic_cas((u32 *)&pending->tail, tail, new_tail) != tail);
+
+	pending->slots[tail] = PENDING_IRQ_VALID |
+		(u32)sender << PENDING_IRQ_SENDER_SHIFT | irq_id;
+	/*
+	 * Make the entry visible before sending SGI_INJECT or enabling the
+	 * maintenance interrupt.
+	 */
+	memory_barrier();
 
+	return true;
+}
+
+/*
+ * Only the first insertion since the last drain has to kick the target CPU.
+ * An expired coalescing window no longer holds back the kick.
+ */
+static bool pending_irq_kick(struct pending_irqs *pending)
+{
+	u64 now;
+
+	if (atomic_cas((u32 *)&pending->kick_pending, 0, 1) == 0)
+		return true;
+	if (!pending->window_end)
+		return false;
+
+	arm_read_sysreg(CNTPCT_EL0, now);
+	return now >= pending->window_end;
+}
+
+static bool pending_irq_peek(struct pending_irqs *pending, u16 *irq_id,
+			     u16 *sender)
+{
+	u32 entry;
+
+	if (pending->head == pending->tail)
+		return false;
+
+	entry = pending->slots[pending->head];
+	if (!(entry & PENDING_IRQ_VALID))
+		return false;
+
+	*irq_id = entry & 0xffff;
+	*sender = (entry & ~PENDING_IRQ_VALID) >> PENDING_IRQ_SENDER_SHIFT;
+	return true;
+}
+
+static void pending_irq_consume(struct pending_irqs *pending)
+{
+	pending->slots[pending->head] = 0;
+	/*
+	 * Ensure that the entry was read and released before updating the
+	 * head index.
+	 */
+	memory_barrier();
+	pending->head = (pending->head + 1) % MAX_PENDING_IRQS;
+}
+
+/* Inject via a list register of this CPU, counted as such if it succeeds */
+static int irqchip_inject_lr(u16 irq_id, u16 sender)
+{
+	int err = irqchip.inject_irq(irq_id, sender);
+
+	if (!err)
+		this_cpu_public()->stats[JAILHOUSE_CPU_STAT_VIRQ_LR]++;
+	return err;
+}
+
+void irqchip_set_pending(struct public_per_cpu *cpu_public, u16 irq_id)
+{
 	if (sdei_available) {
+		/* The cells own the physical GIC, no virtual injection */
+		this_cpu_public()->stats[JAILHOUSE_CPU_STAT_VIRQ_SDEI]++;
 		irqchip_send_sgi(cpu_public->cpu_id, irq_id);
 		return;
 	}
 
-	if (local_injection && irqchip.inject_irq(irq_id, sender) != -EBUSY)
+	/* a time-shared CPU may have to hold it for its other cell */
+	if (sched_set_pending(cpu_public, irq_id))
 		return;
 
-	spin_lock(&pending->lock);
+	irqchip_queue_irq(cpu_public, irq_id);
+}
 
-	new_tail = (pending->tail + 1) % MAX_PENDING_IRQS;
+void irqchip_queue_irq(struct public_per_cpu *cpu_public, u16 irq_id)
+{
+	struct pending_irqs *pending = &cpu_public->pending_irqs;
+	bool local_injection = (this_cpu_public() == cpu_public);
+	const u16 sender = this_cpu_id();
 
-	/* Queue space available? */
-	if (new_tail != pending->head) {
-		pending->irqs[pending->tail] = irq_id;
-		pending->sender[pending->tail] = sender;
-		/*
-		 * Make the entry content is visible before updating the tail
-		 * index.
-		 */
-		memory_barrier();
-		pending->tail = new_tail;
-	}
+	if (local_injection && irqchip_inject_lr(irq_id, sender) != -EBUSY)
+		return;
 
-	/*
-	 * The unlock has memory barrier semantic on ARM v7 and v8. Therefore
-	 * the change to tail will be visible when sending SGI_INJECT later on.
-	 */
-	spin_unlock(&pending->lock);
+	/* Count overflows so that lost interrupts show up in the stats. */
+	if (!pending_irq_enqueue(pending, irq_id, sender))
+		this_cpu_public()->stats[JAILHOUSE_CPU_STAT_VIRQ_DROPPED]++;
 
 	/*
 	 * The list registers are full, trigger maintenance interrupt if we are
@@ -271,20 +478,90 @@ void irqchip_set_pending(struct public_per_cpu *cpu_public, u16 irq_id)
 	 */
 	if (local_injection)
 		irqchip.enable_maint_irq(true);
-	else
+	else if (pending_irq_kick(pending))
 		irqchip_send_sgi(cpu_public->cpu_id, SGI_INJECT);
 }
 
+/*
+ * Fast path of JAILHOUSE_CELL_DIRECT_SGI: the targets are validated against
+ * the cluster table of the cell and kicked with a single SGI_INJECT.
+ */
+static void gic_handle_direct_sgi(struct cell *cell, const struct sgi *sgi)
+{
+	struct public_per_cpu *cpu_public, *self = this_cpu_public();
+	const u16 sender = this_cpu_id();
+	const struct arm_sgi_cluster *cluster;
+	struct sgi kick = {
+		.routing_mode = 0,
+		.cluster_id = sgi->cluster_id,
+		.targets = 0,
+		.id = SGI_INJECT,
+	};
+	unsigned long targets;
+	unsigned int n, bit;
+
+	for (n = 0; n < cell->arch.num_sgi_clusters; n++)
+		if (cell->arch.sgi_clusters[n].id == sgi->cluster_id)
+			break;
+	/* no CPU of the cell in that cluster */
+	if (n == cell->arch.num_sgi_clusters)
+		return;
+
+	cluster = &cell->arch.sgi_clusters[n];
+	targets = sgi->targets & cluster->targets;
+	while (targets) {
+		bit = ffsl(targets);
+		targets &= ~(1UL << bit);
+		cpu_public = public_per_cpu(cluster->cpus[bit]);
+
+		/* a time-shared target may have to defer the SGI */
+		if (cpu_public == self ||
+		    sched_cpu_shared(cluster->cpus[bit])) {
+			irqchip_set_pending(cpu_public, sgi->id);
+			continue;
+		}
+		if (!pending_irq_enqueue(&cpu_public->pending_irqs, sgi->id,
+					 sender))
+			self->stats[JAILHOUSE_CPU_STAT_VIRQ_DROPPED]++;
+		if (pending_irq_kick(&cpu_public->pending_irqs))
+			kick.targets |= 1 << bit;
+	}
+
+	if (kick.targets)
+		irqchip.send_sgi(&kick);
+}
+
 void irqchip_inject_pending(void)
 {
 	struct pending_irqs *pending = &this_cpu_public()->pending_irqs;
+	u64 window = this_cell()->arch.irq_coalesce_ticks;
 	u16 irq_id, sender;
+	u64 now;
 
-	while (pending->head != pending->tail) {
-		irq_id = pending->irqs[pending->head];
-		sender = pending->sender[pending->head];
+	if (window) {
+		/*
+		 * Keep kick_pending set: until the window ends, insertions are
+		 * collected and injected together.
+		 */
+		arm_read_sysreg(CNTPCT_EL0, now);
+		pending->window_end = now + window;
+		pending->kick_pending = 1;
+#ifdef __aarch64__
+		/*
+		 * Bound the window by the hypervisor timer, otherwise only the
+		 * next exit of this CPU closes it.
+		 */
+		timer_event_arm(&this_cpu_data()->coalesce_timer,
+				pending->window_end);
+#endif
+	} else {
+		/* Insertions from now on have to kick again. */
+		pending->kick_pending = 0;
+	}
+	memory_barrier();
 
-		if (irqchip.inject_irq(irq_id, sender) == -EBUSY) {
+	while (pending_irq_peek(pending, &irq_id, &sender)) {
+		if (irqchip_inject_lr(irq_id, sender) == -EBUSY) {
 			/*
 			 * The list registers are full, trigger maintenance
 			 * interrupt and leave.
@@ -293,12 +570,7 @@ void irqchip_inject_pending(void)
 			return;
 		}
 
-		/*
-		 * Ensure that the entry was read before updating the head
-		 * index.
-		 */
-		memory_barrier();
-		pending->head = (pending->head + 1) % MAX_PENDING_IRQS;
+		pending_irq_consume(pending);
 	}
 
 	/*
@@ -308,6 +580,22 @@ void irqchip_inject_pending(void)
 	irqchip.enable_maint_irq(false);
 }
 
+/*
+ * Empties the interrupt queue of this CPU into a bitmap, used when its vCPU
+ * is switched out, see sched.c. The caller holds the control_lock.
+ */
+void irqchip_drain_pending(unsigned long *bitmap)
+{
+	struct pending_irqs *pending = &this_cpu_public()->pending_irqs;
+	u16 irq_id, sender;
+
+	while (pending_irq_peek(pending, &irq_id, &sender)) {
+		set_bit(irq_id, bitmap);
+		pending_irq_consume(pending);
+	}
+	pending->kick_pending = 0;
+}
+
 void irqchip_trigger_external_irq(u16 irq_id)
 {
 	/* Injection via GICD */
@@ -315,6 +603,12 @@ void irqchip_trigger_external_irq(u16 irq_id)
 		     1 << (irq_id % 32));
 }
 
+/* Route the SPI to a single CPU, the caller has to validate ownership. */
+void irqchip_set_irq_target(u16 irq_id, unsigned int cpu_id)
+{
+	irqchip.set_irq_target(irq_id, cpu_id);
+}
+
 void irqchip_send_sgi(unsigned int cpu_id, u16 sgi_id)
 {
 	struct sgi sgi;
@@ -369,12 +663,31 @@ u64 irqchip_get_cluster_target(unsigned int cpu_id)
 	return irqchip.get_cluster_target(cpu_id);
 }
 
+/* Returns false if the irqchip cannot restore the CPU after a power-down */
+bool irqchip_cpu_save(struct irqchip_cpu_state *state)
+{
+	if (!irqchip.cpu_save)
+		return false;
+
+	irqchip.cpu_save(state);
+	return true;
+}
+
+void irqchip_cpu_restore(const struct irqchip_cpu_state *state)
+{
+	irqchip.cpu_restore(state);
+}
+
 void irqchip_cpu_reset(struct per_cpu *cpu_data)
 {
 	assert(cpu_data == this_cpu_data());
 
 	cpu_data->public.pending_irqs.head = 0;
 	cpu_data->public.pending_irqs.tail = 0;
+	memset((void *)cpu_data->public.pending_irqs.slots, 0,
+	       sizeof(cpu_data->public.pending_irqs.slots));
+	cpu_data->public.pending_irqs.kick_pending = 0;
+	cpu_data->public.pending_irqs.window_end = 0;
 
 	irqchip.cpu_reset(cpu_data);
 }
@@ -382,6 +695,7 @@ void irqchip_cpu_reset(struct per_cpu *cpu_data)
 void irqchip_cpu_shutdown(struct public_per_cpu *cpu_public)
 {
 	struct pending_irqs *pending = &cpu_public->pending_irqs;
+	u16 pending_irq, sender;
 	int irq_id;
 
 	/*
@@ -405,18 +719,49 @@ void irqchip_cpu_shutdown(struct public_per_cpu *cpu_public)
 	} while (irq_id >= 0);
 
 	/* Migrate interrupts queued in software. */
-	while (pending->head != pending->tail) {
-		irq_id = pending->irqs[pending->head];
+	while (pending_irq_peek(pending, &pending_irq, &sender)) {
+		irqchip.inject_phys_irq(pending_irq);
+		pending_irq_consume(pending);
+	}
+}
 
-		irqchip.inject_phys_irq(irq_id);
+/*
+ * Rebuild the SGI cluster table of a cell with JAILHOUSE_CELL_DIRECT_SGI after
+ * its CPU set changed. Returns false if the CPUs span too many clusters, the
+ * cell then uses the generic path.
+ */
+static bool irqchip_update_sgi_clusters(struct cell *cell)
+{
+	struct arch_cell *arch = &cell->arch;
+	unsigned int cpu, n, bit;
+	u64 cluster;
 
-		/*
-		 * Ensure that the entry was read before updating the head
-		 * index.
-		 */
-		memory_barrier();
-		pending->head = (pending->head + 1) % MAX_PENDING_IRQS;
+	arch->num_sgi_clusters = 0;
+	if (!(cell->config->flags & JAILHOUSE_CELL_DIRECT_SGI) ||
+	    sdei_available)
+		return true;
+
+	for_each_cpu(cpu, cell->cpu_set) {
+		cluster = irqchip_get_cluster_target(cpu);
+		for (n = 0; n < arch->num_sgi_clusters; n++)
+			if (arch->sgi_clusters[n].id == cluster)
+				break;
+		if (n == arch->num_sgi_clusters) {
+			if (n == ARM_SGI_CLUSTERS)
+				goto too_many;
+			arch->sgi_clusters[n].id = cluster;
+			arch->sgi_clusters[n].targets = 0;
+			arch->num_sgi_clusters++;
+		}
+		bit = ffsl(irqchip_get_cpu_target(cpu));
+		arch->sgi_clusters[n].targets |= 1 << bit;
+		arch->sgi_clusters[n].cpus[bit] = cpu;
 	}
+	return true;
+
+too_many:
+	arch->num_sgi_clusters = 0;
+	return false;
 }
 
 static int irqchip_cell_init(struct cell *cell)
@@ -427,10 +772,18 @@ static int irqchip_cell_init(struct cell *cell)
 	 * irqs than those we need to.
 	 */
 	unsigned int hv_timer = system_config->platform_info.memguard.hv_timer;
+	const struct jailhouse_memguard_config *mconf =
+		&system_config->platform_info.memguard;
 	const struct jailhouse_irqchip *chip;
 	unsigned int n, pos;
+	u32 freq;
 	int err;
 
+	/* Whole ticks per microsecond, avoids a 64-bit division on ARMv7 */
+	arm_read_sysreg(CNTFRQ_EL0, freq);
+	cell->arch.irq_coalesce_ticks =
+		(u64)cell->config->irq_coalesce_us * (freq / 1000000);
+
 	for_each_irqchip(chip, cell->config, n) {
 		if (chip->address != system_config->platform_info.arm.gicd_base)
 			continue;
@@ -449,6 +802,17 @@ static int irqchip_cell_init(struct cell *cell)
 	 */
 	cell->arch.irq_bitmap[0] = ~((1 << SGI_INJECT) | (1 << SGI_EVENT) |
 				     (1 << mnt_irq) | (1 << hv_timer));
+	/* DSU cluster PMU interrupts belong to memguard */
+	for (n = 0; n < mconf->num_dsu_irq; n++) {
+		pos = mconf->dsu_cluster_irq[n];
+		if (pos < sizeof(cell->arch.irq_bitmap) * 8)
+			cell->arch.irq_bitmap[pos / 32] &= ~(1 << (pos % 32));
+	}
+
+	if (!irqchip_update_sgi_clusters(cell)) {
+		printk("Too many clusters for direct SGIs\n");
+		return trace_error(-E2BIG);
+	}
 
 	err = irqchip.cell_init(cell);
 	if (err)
@@ -526,6 +890,10 @@ void irqchip_config_commit(struct cell *cell_added_removed)
 	if (!cell_added_removed)
 		return;
 
+	irqchip_update_sgi_clusters(cell_added_removed);
+	if (cell_added_removed != &root_cell)
+		irqchip_update_sgi_clusters(&root_cell);
+
 	for (n = 32; n < sizeof(cell_added_removed->arch.irq_bitmap) * 8; n++) {
 		if (irqchip_irq_in_cell(cell_added_removed, n) &&
 			(cell_added_removed != &root_cell))
@@ -552,6 +920,8 @@ static int irqchip_init(void)
 	if (sdei_available)
 		printk("Using SDEI-based management interrupt\n");
 
+	irq_latency_init();
+
 	/* Setup the SPI bitmap */
 	return irqchip_cell_init(&root_cell);
 }
@@ -10,9 +10,13 @@
  * the COPYING file in the top-level directory.
  */
 
+#include <jailhouse/control.h>
 #include <jailhouse/ivshmem.h>
 #include <asm/irqchip.h>
 
+/* INTx pins A-D occupy the first SPIs at vpci_irq_base */
+#define IVSHMEM_INTX_SPIS	4
+
 void arch_ivshmem_trigger_interrupt(struct ivshmem_endpoint *ive,
 				    unsigned int vector)
 {
@@ -29,6 +33,41 @@ void arch_ivshmem_trigger_interrupt(struct ivshmem_endpoint *ive,
 	}
 }
 
+/*
+ * SPI of the vector if the guest leaves the MSI-X data at 0: the vectors of
+ * all ivshmem devices of a cell are allocated in a row after the INTx pins,
+ * in the order of the devices in the cell configuration.
+ */
+static unsigned int ivshmem_msix_spi(struct pci_device *device,
+				     unsigned int vector)
+{
+	const struct jailhouse_pci_device *dev_info =
+		jailhouse_cell_pci_devices(device->cell->config);
+	unsigned int irq_id = 32 + device->cell->config->vpci_irq_base +
+		IVSHMEM_INTX_SPIS + vector;
+
+	for (; dev_info != device->info; dev_info++)
+		if (dev_info->type == JAILHOUSE_PCI_TYPE_IVSHMEM)
+			irq_id += dev_info->num_msix_vectors;
+
+	return irq_id;
+}
+
+/* Spread the vectors round-robin over the CPUs of the receiving cell. */
+static unsigned int ivshmem_msix_target(struct cell *cell, unsigned int vector)
+{
+	unsigned int cpu, n, num_cpus = 0;
+
+	for_each_cpu(cpu, cell->cpu_set)
+		num_cpus++;
+
+	n = vector % num_cpus;
+	for_each_cpu(cpu, cell->cpu_set)
+		if (n-- == 0)
+			break;
+	return cpu;
+}
+
 int arch_ivshmem_update_msix(struct ivshmem_endpoint *ive, unsigned int vector,
 			     bool enabled)
 {
@@ -38,8 +77,20 @@ int arch_ivshmem_update_msix(struct ivshmem_endpoint *ive, unsigned int vector,
 	if (enabled) {
 		/* FIXME: validate MSI-X target address */
 		irq_id = device->msix_vectors[vector].data;
-		if (irq_id < 32 || !irqchip_irq_in_cell(device->cell, irq_id))
+		if (irq_id == 0) {
+			irq_id = ivshmem_msix_spi(device, vector);
+			if (!irqchip_irq_in_cell(device->cell, irq_id))
+				return -EPERM;
+			/*
+			 * Guest-provided SPIs keep the routing of the guest,
+			 * allocated ones are owned by us.
+			 */
+			irqchip_set_irq_target(irq_id,
+				ivshmem_msix_target(device->cell, vector));
+		} else if (irq_id < 32 ||
+			   !irqchip_irq_in_cell(device->cell, irq_id)) {
 			return -EPERM;
+		}
 	}
 
 	/*
@@ -17,14 +17,17 @@
 #include <asm/control.h>
 #include <asm/iommu.h>
 #include <asm/coloring.h>
+#include <asm/pt_cache.h>
 
-int arch_map_memory_region(struct cell *cell,
-			   const struct jailhouse_memory *mem)
+/* Lazily mapped regions are populated in blocks of this size */
+#define LAZY_BLOCK_SIZE		(2UL * 1024 * 1024)
+
+/* Above this many pages, flush all TLB entries of the VMID instead */
+#define S2_TLB_FLUSH_PAGES	64
+
+static unsigned long s2_access_flags(const struct jailhouse_memory *mem)
 {
-	u64 phys_start = mem->phys_start;
 	unsigned long access_flags = PTE_FLAG_VALID | PTE_ACCESS_FLAG;
-	unsigned long paging_flags = PAGING_COHERENT | PAGING_HUGE;
-	int err = 0;
 
 	if (mem->flags & JAILHOUSE_MEM_READ)
 		access_flags |= S2_PTE_ACCESS_RO;
@@ -32,21 +35,55 @@ int arch_map_memory_region(struct cell *cell,
 		access_flags |= S2_PTE_ACCESS_WO;
 	if (mem->flags & JAILHOUSE_MEM_IO)
 		access_flags |= S2_PTE_FLAG_DEVICE;
+	else if (mem->flags & JAILHOUSE_MEM_NONCACHED)
+		access_flags |= S2_PTE_FLAG_NONCACHED;
 	else
 		access_flags |= S2_PTE_FLAG_NORMAL;
-	if (mem->flags & JAILHOUSE_MEM_COMM_REGION)
-		phys_start = paging_hvirt2phys(&cell->comm_page);
 	/*
 	if (!(mem->flags & JAILHOUSE_MEM_EXECUTE))
 		flags |= S2_PAGE_ACCESS_XN;
 	*/
+	return access_flags;
+}
+
+static unsigned long s2_paging_flags(const struct jailhouse_memory *mem)
+{
+	unsigned long paging_flags = PAGING_COHERENT | PAGING_HUGE;
+
 	if (mem->flags & JAILHOUSE_MEM_NO_HUGEPAGES)
 		paging_flags &= ~PAGING_HUGE;
+	return paging_flags;
+}
+
+int arch_map_memory_region(struct cell *cell,
+			   const struct jailhouse_memory *mem)
+{
+	u64 phys_start = mem->phys_start;
+	unsigned long access_flags = s2_access_flags(mem);
+	unsigned long paging_flags = s2_paging_flags(mem);
+	int err = 0;
+
+	if (mem->flags & JAILHOUSE_MEM_COMM_REGION)
+		phys_start = paging_hvirt2phys(&cell->comm_page);
+
+	/* populated by arm_paging_cell_lazy_fault, the root cell is running */
+	if (mem->flags & JAILHOUSE_MEM_LAZY && cell != &root_cell) {
+		if (mem->flags & (JAILHOUSE_MEM_DMA | JAILHOUSE_MEM_IO |
+				  JAILHOUSE_MEM_COMM_REGION |
+				  JAILHOUSE_MEM_ROOTSHARED))
+			return trace_error(-EINVAL);
+		cell->arch.lazy_regions = true;
+		return 0;
+	}
 
 	err = iommu_map_memory_region(cell, mem);
 	if (err)
 		return err;
 
+	/* already mapped by the prebuilt tables */
+	if (cell->arch.s2_prebuilt)
+		return 0;
+
 	if (mem->flags & JAILHOUSE_MEM_COLORED)
 		err = color_paging_create(&cell->arch.mm, phys_start,
 				mem->size, mem->virt_start, access_flags,
@@ -65,17 +102,188 @@ int arch_unmap_memory_region(struct cell *cell,
 {
 	int err = 0;
 
-	err = iommu_unmap_memory_region(cell, mem);
-	if (err)
-		return err;
+	/* lazy regions never entered the IOMMU */
+	if (!(mem->flags & JAILHOUSE_MEM_LAZY) || cell == &root_cell) {
+		err = iommu_unmap_memory_region(cell, mem);
+		if (err)
+			return err;
+	}
 
 	if (mem->flags & JAILHOUSE_MEM_COLORED)
-		return color_paging_destroy(&cell->arch.mm,
+		err = color_paging_destroy(&cell->arch.mm,
 				mem->phys_start, mem->size, mem->virt_start,
 				PAGING_COHERENT, mem->colors, mem->flags);
+	else
+		err = paging_destroy(&cell->arch.mm, mem->virt_start,
+				     mem->size, PAGING_COHERENT);
+	if (err)
+		return err;
+
+	arm_paging_cell_unmapped(cell, mem->virt_start, mem->size);
+
+	/* the SMMUs walk the same stage 2 tables */
+	iommu_flush_cell_tlb_range(cell, mem->virt_start, mem->size);
+
+	return 0;
+}
+
+/**
+ * Record an IPA range whose stage-2 mappings were removed or changed, to be
+ * invalidated by the next arch_flush_cell_vcpu_caches of the cell.
+ */
+void arm_paging_cell_unmapped(struct cell *cell, unsigned long start,
+			      unsigned long size)
+{
+	struct arch_cell *arch = &cell->arch;
+	unsigned int n = arch->num_tlb_ranges;
+
+	if (arch->tlb_flush_all)
+		return;
+
+	if (n > 0 && arch->tlb_ranges[n - 1].start +
+	    arch->tlb_ranges[n - 1].size == start) {
+		arch->tlb_ranges[n - 1].size += size;
+	} else if (n < ARM_TLB_FLUSH_RANGES) {
+		arch->tlb_ranges[n].start = start;
+		arch->tlb_ranges[n].size = size;
+		arch->num_tlb_ranges++;
+	} else {
+		arch->tlb_flush_all = true;
+	}
+}
 
-	return paging_destroy(&cell->arch.mm, mem->virt_start, mem->size,
-			      PAGING_COHERENT);
+/**
+ * Invalidate the recorded ranges of the cell on all CPUs. Must be called on a
+ * CPU of the cell, the invalidation uses the loaded VMID.
+ */
+void arm_paging_cell_flush_tlbs(struct cell *cell)
+{
+	struct arch_cell *arch = &cell->arch;
+	unsigned long pages = 0, addr;
+	unsigned int n;
+
+	for (n = 0; n < arch->num_tlb_ranges; n++)
+		pages += PAGE_ALIGN(arch->tlb_ranges[n].size) / PAGE_SIZE;
+
+	/* the updated entries must be visible to the table walkers */
+	dsb(ishst);
+
+	if (arch->tlb_flush_all || pages > S2_TLB_FLUSH_PAGES) {
+		arm_paging_vcpu_flush_tlbs();
+		dsb(ish);
+		isb();
+	} else {
+		for (n = 0; n < arch->num_tlb_ranges; n++)
+			for (addr = 0; addr < arch->tlb_ranges[n].size;
+			     addr += PAGE_SIZE)
+				arm_paging_vcpu_flush_ipa_tlb(
+					arch->tlb_ranges[n].start + addr);
+		arm_paging_vcpu_flush_s1_tlbs();
+	}
+
+	arch->num_tlb_ranges = 0;
+	arch->tlb_flush_all = false;
+}
+
+static bool consolidation_ok(struct cell *cell,
+			     const struct jailhouse_memory *mem)
+{
+	if (mem->flags & (JAILHOUSE_MEM_NO_HUGEPAGES |
+			  JAILHOUSE_MEM_COMM_REGION | JAILHOUSE_MEM_COLORED))
+		return false;
+	/* populated later, under the lock of arm_paging_cell_lazy_fault */
+	return !(mem->flags & JAILHOUSE_MEM_LAZY) || cell == &root_cell;
+}
+
+/**
+ * Merge the stage-2 mappings of adjacent regions of a cell into blocks.
+ *
+ * Each region is mapped on its own, so a block that spans two of them ends up
+ * as a table of pages. The tables of runs of regions that follow each other in
+ * the configuration and in the IPA space are replaced by blocks where the
+ * physical layout permits.
+ *
+ * Replacing a table by a block is not done break-before-make, so the tables
+ * must not be in use by the CPUs or the SMMU streams of the cell yet.
+ */
+void arm_paging_cell_consolidate(struct cell *cell)
+{
+	const struct jailhouse_memory *mem;
+	unsigned long start = 0, end = 0;
+	unsigned int n;
+	bool ok;
+
+	for_each_mem_region(mem, cell->config, n) {
+		ok = consolidation_ok(cell, mem);
+		if (start != end && (!ok || mem->virt_start != end)) {
+			paging_consolidate(&cell->arch.mm, start, end - start,
+					   PAGING_COHERENT);
+			start = end = 0;
+		}
+		if (!ok)
+			continue;
+		if (start == end)
+			start = end = mem->virt_start;
+		end += mem->size;
+	}
+	if (start != end)
+		paging_consolidate(&cell->arch.mm, start, end - start,
+				   PAGING_COHERENT);
+
+	/* the SMMUs walk the same stage 2 tables */
+	iommu_flush_cell_tlbs(cell);
+}
+
+/**
+ * Populate the block of a lazily mapped region of the current cell that
+ * contains the faulting \a ipa.
+ *
+ * @return true if \a ipa is mapped now and the access can be retried.
+ */
+bool arm_paging_cell_lazy_fault(unsigned long ipa)
+{
+	struct cell *cell = this_cell();
+	const struct jailhouse_memory *mem;
+	unsigned long start, end;
+	unsigned int n;
+	int err;
+
+	if (!cell->arch.lazy_regions)
+		return false;
+
+	for_each_mem_region(mem, cell->config, n) {
+		if (!(mem->flags & JAILHOUSE_MEM_LAZY) ||
+		    ipa < mem->virt_start ||
+		    ipa - mem->virt_start >= mem->size)
+			continue;
+
+		start = MAX(ipa & ~(LAZY_BLOCK_SIZE - 1), mem->virt_start);
+		end = MIN((ipa & ~(LAZY_BLOCK_SIZE - 1)) + LAZY_BLOCK_SIZE,
+			  mem->virt_start + mem->size);
+
+		spin_lock(&cell->arch.lazy_lock);
+		/* another CPU of the cell may have been faster */
+		if (paging_virt2phys(&cell->arch.mm, ipa, PAGE_PRESENT_FLAGS) !=
+		    INVALID_PHYS_ADDR)
+			err = 0;
+		else if (mem->flags & JAILHOUSE_MEM_COLORED)
+			err = color_paging_create_part(&cell->arch.mm, mem,
+					start - mem->virt_start, end - start,
+					s2_access_flags(mem),
+					s2_paging_flags(mem));
+		else
+			err = paging_create(&cell->arch.mm,
+					mem->phys_start + (start - mem->virt_start),
+					end - start, start, s2_access_flags(mem),
+					s2_paging_flags(mem));
+		spin_unlock(&cell->arch.lazy_lock);
+
+		if (err)
+			printk("Lazy mapping of 0x%lx failed: %d\n", ipa, err);
+		return err == 0;
+	}
+
+	return false;
 }
 
 unsigned long arch_paging_gphys2phys(unsigned long gphys, unsigned long flags)
@@ -84,6 +292,11 @@ unsigned long arch_paging_gphys2phys(unsigned long gphys, unsigned long flags)
 	return paging_virt2phys(&this_cell()->arch.mm, gphys, flags);
 }
 
+const struct paging_structures *arch_cell_paging_structs(struct cell *cell)
+{
+	return &cell->arch.mm;
+}
+
 void arm_dcache_flush_memory_region(
 		unsigned long region_addr,
 		unsigned long region_size,
@@ -148,12 +361,17 @@ int arm_paging_cell_init(struct cell *cell)
 	if (!cell->arch.mm.root_table)
 		return -ENOMEM;
 
+	if (cell == &root_cell)
+		cell->arch.s2_prebuilt =
+			pt_cache_install(&cell->arch.mm) == 0;
+
 	return 0;
 }
 
 void arm_paging_cell_destroy(struct cell *cell)
 {
 	page_free(&mem_pool, cell->arch.mm.root_table, CELL_ROOT_PT_PAGES);
+	cell->arch.mm.root_table = NULL;
 }
 
 void arm_paging_vcpu_init(struct paging_structures *pg_structs)
@@ -169,9 +387,13 @@ void arm_paging_vcpu_init(struct paging_structures *pg_structs)
 	/* Ensure that the new VMID is present before flushing the caches */
 	isb();
 	/*
-	 * At initialisation, arch_config_commit does not act on other CPUs,
-	 * since they register themselves to the root cpu_set afterwards. It
-	 * means that this unconditionnal flush is redundant on master CPU.
+	 * Entries of the root cell on the other CPUs are kept coherent by
+	 * arch_flush_cell_vcpu_caches, only stale ones of this CPU, e.g. from
+	 * parking, have to go. Other cells may reuse the VMID of a destroyed
+	 * cell, whose entries are still held by its former CPUs.
 	 */
-	arm_paging_vcpu_flush_tlbs();
+	if (this_cell() == &root_cell)
+		arm_paging_vcpu_flush_local_tlbs();
+	else
+		arm_paging_vcpu_flush_tlbs();
 }
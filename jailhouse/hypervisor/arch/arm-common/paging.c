@@ -26,8 +26,41 @@ static unsigned long arm_get_entry_flags(pt_entry_t entry)
 	return *entry & 0xfff;
 }
 
+#ifdef PTE_FLAG_CONT
+/*
+ * All the entries of a contiguous block must agree, so drop the hint from the
+ * whole block before one of them is changed. Changing the hint requires
+ * break-before-make: the block is invalidated and flushed from the TLBs before
+ * the entries are written back without it. Only cell stage-2 mappings carry
+ * the hint.
+ */
+static void arm_break_cont(pt_entry_t entry)
+{
+	u64 saved[PTE_CONT_ENTRIES];
+	pt_entry_t first;
+	unsigned int n;
+
+	first = (pt_entry_t)((unsigned long)entry &
+			     ~(PTE_CONT_ENTRIES * sizeof(*entry) - 1));
+	for (n = 0; n < PTE_CONT_ENTRIES; n++) {
+		saved[n] = first[n] & ~PTE_FLAG_CONT;
+		first[n] = 0;
+	}
+	arch_paging_flush_cpu_caches(first, PTE_CONT_ENTRIES * sizeof(*entry));
+	arch_paging_flush_guest_tlbs();
+
+	for (n = 0; n < PTE_CONT_ENTRIES; n++)
+		first[n] = saved[n];
+	arch_paging_flush_cpu_caches(first, PTE_CONT_ENTRIES * sizeof(*entry));
+}
+#endif
+
 static void arm_clear_entry(pt_entry_t entry)
 {
+#ifdef PTE_FLAG_CONT
+	if (*entry & PTE_FLAG_CONT)
+		arm_break_cont(entry);
+#endif
 	*entry = 0;
 }
 
@@ -64,7 +97,9 @@ static pt_entry_t arm_get_l1_entry(page_table_t page_table, unsigned long virt)
 
 static void arm_set_l1_block(pt_entry_t pte, unsigned long phys, unsigned long flags)
 {
-	*pte = ((u64)phys & PTE_L1_BLOCK_ADDR_MASK) | flags;
+	/* flags may be taken from a page entry by paging_consolidate */
+	*pte = ((u64)phys & PTE_L1_BLOCK_ADDR_MASK) |
+		(flags & ~PTE_FLAG_TERMINAL);
 }
 
 static unsigned long arm_get_l1_phys(pt_entry_t pte, unsigned long virt)
@@ -99,11 +134,17 @@ static pt_entry_t arm_get_l3_entry(page_table_t page_table, unsigned long virt)
 
 static void arm_set_l2_block(pt_entry_t pte, unsigned long phys, unsigned long flags)
 {
-	*pte = ((u64)phys & PTE_L2_BLOCK_ADDR_MASK) | flags;
+	/* flags may be taken from a page entry by paging_consolidate */
+	*pte = ((u64)phys & PTE_L2_BLOCK_ADDR_MASK) |
+		(flags & ~PTE_FLAG_TERMINAL);
 }
 
 static void arm_set_l3_page(pt_entry_t pte, unsigned long phys, unsigned long flags)
 {
+#ifdef PTE_FLAG_CONT
+	if ((*pte & PTE_FLAG_CONT) && !(flags & PTE_FLAG_CONT))
+		arm_break_cont(pte);
+#endif
 	*pte = ((u64)phys & PTE_PAGE_ADDR_MASK) | flags | PTE_FLAG_TERMINAL;
 }
 
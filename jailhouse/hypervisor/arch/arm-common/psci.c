@@ -15,6 +15,7 @@
 #include <jailhouse/control.h>
 #include <asm/control.h>
 #include <asm/psci.h>
+#include <asm/sched.h>
 #include <asm/smccc.h>
 #include <asm/traps.h>
 
@@ -35,7 +36,10 @@ static long psci_emulate_cpu_on(struct trap_context *ctx)
 
 	spin_lock(&target_data->control_lock);
 
-	if (target_data->wait_for_poweron) {
+	if (sched_cpu_on(this_cell(), cpu, ctx->regs[2] & mask,
+			 ctx->regs[3] & mask, &result)) {
+		/* switched out, the vCPU starts in its next window */
+	} else if (target_data->wait_for_poweron) {
 		target_data->cpu_on_entry = ctx->regs[2] & mask;
 		target_data->cpu_on_context = ctx->regs[3] & mask;
 		target_data->reset = true;
@@ -59,6 +63,56 @@ static long psci_emulate_cpu_on(struct trap_context *ctx)
 	return result;
 }
 
+/*
+ * Returns the idle state of the platform that replaces the requested one: the
+ * state itself if its exit latency is within the limit of the cell, otherwise
+ * the deepest shallower state that is, NULL if there is none.
+ */
+static const struct jailhouse_idle_state *psci_idle_state(u32 power_state)
+{
+	const struct jailhouse_idle_state *state, *permitted = NULL;
+	u32 max_latency = this_cell()->config->idle_exit_latency_us;
+	unsigned int n;
+
+	if (max_latency == 0)
+		return NULL;
+
+	for (n = 0; n < system_config->platform_info.num_idle_states &&
+	     n < JAILHOUSE_MAX_IDLE_STATES; n++) {
+		state = &system_config->platform_info.idle_states[n];
+		if (state->power_state == power_state)
+			return state->exit_latency_us <= max_latency ?
+				state : permitted;
+		if (state->exit_latency_us <= max_latency)
+			permitted = state;
+	}
+	return NULL;
+}
+
+static long psci_emulate_cpu_suspend(struct trap_context *ctx)
+{
+	u64 mask = SMCCC_IS_CONV_64(ctx->regs[0]) ? (u64)-1L : (u32)-1;
+	const struct jailhouse_idle_state *state;
+	long result = PSCI_SUCCESS;
+
+	/*
+	 * Unknown states and states deeper than the cell may enter are
+	 * replaced by a shallower one, or by a context-preserving suspend
+	 * in the hypervisor. This is legal according to PSCI.
+	 */
+	state = psci_idle_state(ctx->regs[1] & mask);
+	if (state && arm_cpu_idle(state, ctx->regs[2] & mask,
+				  ctx->regs[3] & mask, &result)) {
+		irqchip_handle_irq();
+	} else if (sdei_available) {
+		arm_cpu_passthru_suspend();
+	} else if (!irqchip_has_pending_irqs()) {
+		asm volatile("wfi" : : : "memory");
+		irqchip_handle_irq();
+	}
+	return result;
+}
+
 static long psci_emulate_affinity_info(struct trap_context *ctx)
 {
 	unsigned int cpu = arm_cpu_by_mpidr(this_cell(), ctx->regs[1]);
@@ -67,7 +121,7 @@ static long psci_emulate_affinity_info(struct trap_context *ctx)
 		/* Virtual id not in set */
 		return PSCI_DENIED;
 
-	return public_per_cpu(cpu)->wait_for_poweron ?
+	return sched_wait_for_poweron(this_cell(), cpu) ?
 		PSCI_CPU_IS_OFF : PSCI_CPU_IS_ON;
 }
 
@@ -101,18 +155,7 @@ long psci_dispatch(struct trap_context *ctx)
 
 	case PSCI_0_2_FN_CPU_SUSPEND:
 	case PSCI_0_2_FN64_CPU_SUSPEND:
-		/*
-		 * Note: We ignore the power_state parameter and always perform
-		 * a context-preserving suspend. This is legal according to
-		 * PSCI.
-		 */
-		if (sdei_available) {
-			arm_cpu_passthru_suspend();
-		} else if (!irqchip_has_pending_irqs()) {
-			asm volatile("wfi" : : : "memory");
-			irqchip_handle_irq();
-		}
-		return PSCI_SUCCESS;
+		return psci_emulate_cpu_suspend(ctx);
 
 	case PSCI_0_2_FN_CPU_OFF:
 	case PSCI_CPU_OFF_V0_1_UBOOT:
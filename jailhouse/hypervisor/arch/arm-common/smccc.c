@@ -49,19 +49,19 @@ int smccc_discover(void)
 	if (ret != ARM_SMCCC_SUCCESS)
 		return sdei_available ? trace_error(-EIO) : 0;
 
-#ifndef CONFIG_MACH_RK3588
-	sdei_available = false;
-#else
 #ifdef __aarch64__
-	/* Check if we have SDEI (ARMv8 only) */
-	ret = smc(SDEI_VERSION);
-	if (ret >= ARM_SMCCC_VERSION_1_0) {
-		if (sdei_probed && !sdei_available)
-			return trace_error(-EIO);
-		sdei_available = true;
+	/* Check if we have SDEI (ARMv8 only), if the root cell asks for it */
+	if (system_config->root_cell.flags & JAILHOUSE_CELL_SDEI_IRQS) {
+		ret = smc(SDEI_VERSION);
+		if (ret >= ARM_SMCCC_VERSION_1_0) {
+			if (sdei_probed && !sdei_available)
+				return trace_error(-EIO);
+			sdei_available = true;
+		} else if (!sdei_probed) {
+			printk("SDEI not available, using virtual IRQs\n");
+		}
+		sdei_probed = true;
 	}
-	sdei_probed = true;
-#endif
 #endif
 
 	/* We need to have at least SMCCC v1.1 */
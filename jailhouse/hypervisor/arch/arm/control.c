@@ -107,3 +107,46 @@ void arm_cpu_passthru_suspend(void)
 {
 	/* never called */
 }
+
+bool arm_cpu_idle(const struct jailhouse_idle_state *state,
+		  unsigned long entry, unsigned long context, long *result)
+{
+	/* no idle states of the firmware are used, the caller waits */
+	return false;
+}
+
+int arch_cell_snapshot(struct cell *cell,
+		       struct jailhouse_cell_snapshot *snapshot)
+{
+	return trace_error(-ENOSYS);
+}
+
+int arch_cell_prepare_restore(struct cell *cell,
+			      const struct jailhouse_cell_snapshot *snapshot)
+{
+	return trace_error(-ENOSYS);
+}
+
+int arch_cpu_share_check(struct cell *cell, unsigned int cpu_id)
+{
+	return trace_error(-ENOSYS);
+}
+
+void arch_cpu_share(struct cell *cell, unsigned int cpu_id)
+{
+}
+
+bool arch_cpu_unshare(struct cell *cell, unsigned int cpu_id)
+{
+	return false;
+}
+
+void arch_cell_suspend_cpu(struct cell *cell, unsigned int cpu_id)
+{
+}
+
+int arch_cpu_schedule(unsigned int cpu_id,
+		      const struct jailhouse_cpu_schedule *schedule)
+{
+	return trace_error(-ENOSYS);
+}
@@ -14,6 +14,7 @@
 
 /* also include from arm-common */
 #include_next <asm/bitops.h>
+#include <asm/processor.h>
 
 static inline int atomic_test_and_set_bit(int nr, volatile unsigned long *addr)
 {
@@ -42,3 +43,32 @@ static inline int atomic_test_and_set_bit(int nr, volatile unsigned long *addr)
 
 	return !!(test);
 }
+
+/*
+ * Usage: if (atomic_cas(addr, old, new) != old): failure.
+ * tmp = *addr;
+ * if (tmp == old) *addr = new;
+ * return tmp;
+ *
+ * acquire + release semantic, no spurious returns
+ */
+static inline u32 atomic_cas(u32 *addr, u32 old, u32 new)
+{
+	u32 tmp, oldval;
+
+	dmb(ish);
+	asm volatile (
+		"1: ldrex	%1, [%2]\n\t"
+		"subs		%0, %1, %3\n\t"
+		"bne		2f\n\t"
+		"strex		%0, %4, [%2]\n\t" /* 1 on failure */
+		"teq		%0, #0\n\t"
+		"bne		1b\n\t"
+		"2:\n\t"
+		: "=&r"(tmp), "=&r"(oldval)
+		: "r"(addr), "r"(old), "r"(new)
+		: "memory", "cc");
+	dmb(ish);
+
+	return oldval;
+}
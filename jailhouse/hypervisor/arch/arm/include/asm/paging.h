@@ -140,6 +140,7 @@
 /* Stage 2 memory attributes (MemAttr[3:0]) */
 #define S2_MEMATTR_OWBIWB	0xf
 #define S2_MEMATTR_DEV		0x1
+#define S2_MEMATTR_NC		0x5
 
 #define S1_PTE_FLAG_NORMAL	PTE_MEMATTR(HMAIR_IDX_WBRAWA)
 #define S1_PTE_FLAG_DEVICE	PTE_MEMATTR(HMAIR_IDX_DEV)
@@ -147,6 +148,7 @@
 
 #define S2_PTE_FLAG_NORMAL	PTE_MEMATTR(S2_MEMATTR_OWBIWB)
 #define S2_PTE_FLAG_DEVICE	PTE_MEMATTR(S2_MEMATTR_DEV)
+#define S2_PTE_FLAG_NONCACHED	PTE_MEMATTR(S2_MEMATTR_NC)
 
 #define S1_DEFAULT_FLAGS	(PTE_FLAG_VALID | PTE_ACCESS_FLAG	\
 				| S1_PTE_FLAG_NORMAL | PTE_INNER_SHAREABLE\
@@ -183,6 +185,11 @@ extern unsigned int cache_line_size;
 
 int arm_paging_cell_init(struct cell *cell);
 void arm_paging_cell_destroy(struct cell *cell);
+bool arm_paging_cell_lazy_fault(unsigned long ipa);
+void arm_paging_cell_consolidate(struct cell *cell);
+void arm_paging_cell_unmapped(struct cell *cell, unsigned long start,
+			      unsigned long size);
+void arm_paging_cell_flush_tlbs(struct cell *cell);
 
 void arm_paging_vcpu_init(struct paging_structures *pg_structs);
 
@@ -194,9 +201,33 @@ static inline void arm_paging_vcpu_flush_tlbs(void)
 	 * Invalidate all stage-1 and 2 TLB entries for the current VMID
 	 * ERET will ensure completion of these ops
 	 */
+	arm_write_sysreg(TLBIALLIS, 0);
+}
+
+/* Same as arm_paging_vcpu_flush_tlbs, limited to the calling CPU */
+static inline void arm_paging_vcpu_flush_local_tlbs(void)
+{
 	arm_write_sysreg(TLBIALL, 0);
 }
 
+/*
+ * Invalidate the stage-2 entries for an IPA of the current VMID on all CPUs.
+ * Entries combining both stages are only dropped by
+ * arm_paging_vcpu_flush_s1_tlbs.
+ */
+static inline void arm_paging_vcpu_flush_ipa_tlb(unsigned long ipa)
+{
+	arm_write_sysreg(TLBIIPAS2IS, ipa >> 12);
+}
+
+static inline void arm_paging_vcpu_flush_s1_tlbs(void)
+{
+	dsb(ish);
+	arm_write_sysreg(TLBIALLIS, 0);
+	dsb(ish);
+	isb();
+}
+
 /* return the bits supported for the physical address range for this
  * machine; in arch_paging_init this value will be kept in
  * cpu_parange for later reference */
@@ -221,6 +252,28 @@ static inline void arch_paging_flush_page_tlbs(unsigned long page_addr)
 	}
 }
 
+/* Only executed on hypervisor paging struct changes spanning many pages */
+static inline void arch_paging_flush_all_tlbs(void)
+{
+	if (is_el2()) {
+		dsb();
+		arm_write_sysreg(TLBIALLH, 0);
+		dsb();
+		isb();
+	}
+}
+
+/* Executed before releasing page tables of cell paging structures */
+static inline void arch_paging_flush_guest_tlbs(void)
+{
+	if (is_el2()) {
+		dsb();
+		arm_write_sysreg(TLBIALLNSNHIS, 0);
+		dsb();
+		isb();
+	}
+}
+
 /* Used to clean the PAGING_COHERENT page table changes */
 static inline void arch_paging_flush_cpu_caches(void *addr, long size)
 {
@@ -21,3 +21,6 @@
 	unsigned long linux_reg[NUM_ENTRY_REGS];			\
 									\
 	bool initialized;
+
+#define ARCH_PUBLIC_PERCPU_FIELDS					\
+	ARM_PUBLIC_PERCPU_FIELDS
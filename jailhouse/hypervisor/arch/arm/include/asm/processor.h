@@ -52,6 +52,21 @@ static inline bool is_el2(void)
 	return (psr & PSR_MODE_MASK) == PSR_HYP_MODE;
 }
 
+/** Free-running timestamp for profiling, in generic timer ticks */
+static inline u64 cpu_timestamp(void)
+{
+	u64 pct;
+
+	arm_read_sysreg(CNTPCT_EL0, pct);
+	return pct;
+}
+
+/** Waits while *addr may still hold old. Callers have to recheck *addr. */
+static inline void cpu_wait_for_change(volatile void *addr, u32 old)
+{
+	cpu_relax();
+}
+
 #endif /* !__ASSEMBLY__ */
 
 #endif /* !_JAILHOUSE_ASM_PROCESSOR_H */
@@ -32,3 +32,17 @@ int iommu_unmap_memory_region(struct cell *cell,
 void iommu_config_commit(struct cell *cell)
 {
 }
+
+void iommu_flush_cell_tlbs(struct cell *cell)
+{
+}
+
+void iommu_flush_cell_tlb_range(struct cell *cell, unsigned long addr,
+				unsigned long size)
+{
+}
+
+bool iommu_handle_irq(u32 irqn)
+{
+	return false;
+}
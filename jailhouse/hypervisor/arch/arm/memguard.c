@@ -9,6 +9,7 @@
  * This work is licensed under the terms of the GNU GPL, version 2.  See
  * the COPYING file in the top-level directory.
  */
+#include <jailhouse/entry.h>
 #include <jailhouse/memguard.h>
 
 int memguard_set(
@@ -18,3 +19,45 @@ int memguard_set(
 	mg_print("Memguard not implemented on this architecture\n");
 	return 0;
 }
+
+int memguard_cell_set(
+	struct per_cpu *cpu_data __attribute__((unused)),
+	unsigned long id __attribute__((unused)),
+	unsigned long params_address __attribute__((unused)))
+{
+	mg_print("Memguard not implemented on this architecture\n");
+	return -ENOSYS;
+}
+
+int memguard_batch_set(
+	struct per_cpu *cpu_data __attribute__((unused)),
+	unsigned long count __attribute__((unused)),
+	unsigned long params_address __attribute__((unused)))
+{
+	mg_print("Memguard not implemented on this architecture\n");
+	return -ENOSYS;
+}
+
+int memguard_switch_begin(
+	const struct memguard_cpu_params *entries __attribute__((unused)),
+	unsigned int count __attribute__((unused)),
+	unsigned long long period_us __attribute__((unused)),
+	unsigned int qos_profile __attribute__((unused)))
+{
+	mg_print("Memguard not implemented on this architecture\n");
+	return -ENOSYS;
+}
+
+void memguard_switch_abort(void)
+{
+}
+
+void memguard_switch_commit(
+	const struct memguard_cpu_params *entries __attribute__((unused)),
+	unsigned int count __attribute__((unused)))
+{
+}
+
+void memguard_cpu_release(unsigned int cpu __attribute__((unused)))
+{
+}
@@ -30,6 +30,22 @@ void common(void)
 	       hypervisor_memory.phys_start);
 	OFFSET(PERCPU_ID_AA64MMFR0, per_cpu, id_aa64mmfr0);
 	OFFSET(PERCPU_SDEI_EVENT, per_cpu, sdei_event);
+	OFFSET(IDLE_CONTEXT_TTBR0, idle_context, ttbr0);
+	OFFSET(IDLE_CONTEXT_SELF, idle_context, self);
+	BLANK();
+
+	COMMENT("public per-CPU layout, see struct public_per_cpu");
+	OFFSET(PERCPU_LAYOUT_PUBLIC, per_cpu, public);
+	OFFSET(PERCPU_LAYOUT_LOCAL_HOT, public_per_cpu, cpu_id);
+	OFFSET(PERCPU_LAYOUT_REMOTE, public_per_cpu, suspend_cpu);
+	OFFSET(PERCPU_LAYOUT_STATS, public_per_cpu, stats);
+	OFFSET(PERCPU_LAYOUT_MEMGUARD, public_per_cpu, memguard);
+	OFFSET(PERCPU_LAYOUT_MEMGUARD_REMOTE, public_per_cpu, memguard.block);
+	OFFSET(PERCPU_LAYOUT_PRINTK, public_per_cpu, printk_ring);
+	OFFSET(PERCPU_LAYOUT_CONTROL, public_per_cpu, control_lock);
+	OFFSET(PERCPU_LAYOUT_PENDING_IRQS, public_per_cpu, pending_irqs);
+	OFFSET(PERCPU_LAYOUT_PENDING_TAIL, public_per_cpu, pending_irqs.tail);
+	DEFINE(PERCPU_LAYOUT_SIZE, sizeof(struct public_per_cpu));
 	BLANK();
 
 	DEFINE(PERCPU_STACK_END,
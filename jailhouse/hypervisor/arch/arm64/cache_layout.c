@@ -42,6 +42,7 @@ enum clidr_ctype {
 const char * cache_types[] = {"Not present", "Instr. Only", "Data Only", "I+D Split", "Unified"};
 
 cache_t cache[MAX_CACHE_LEVEL];
+const cache_t *cache_llc;
 
 /** Autodetect cache(s) geometry.
  *  Return the size of a way or 0 if no cache was detected.
@@ -54,7 +55,7 @@ u64 arm_cache_layout_detect(void)
 	unsigned int max_cache_level;
 
 	unsigned int n;
-	unsigned llc = 0;
+	int llc = -1;
 	u64 type, assoc, ls, sets;
 
 	arm_read_sysreg(clidr_el1, reg);
@@ -126,20 +127,25 @@ u64 arm_cache_layout_detect(void)
 
 	}
 
+	if (llc < 0)
+		return 0;
+
 	verb_print("\tNOTE: L%d Cache selected for coloring.\n",
 		   cache[llc].level + 1);
 
+	cache_llc = &cache[llc];
 	return cache[llc].way_size;
 }
 
-/** Perform a per-way clean + invalidate (flush) on the x-cache level. */
-void arm_flush_dcache_lx_per_way(unsigned int level)
+void arm_dcache_setway_range(unsigned int level, u32 first, u32 num,
+			     bool clean)
 {
 	/* index the cache level */
 	unsigned int i = level - 1;
 
-	/* Assume way and line size are power of 2 */
-	unsigned int wshift = 32 - ffsl(cache[i].assoc);
+	/* The way index is left-aligned, the line size is a power of 2 */
+	unsigned int wshift = cache[i].assoc > 1 ?
+		31 - msbl(cache[i].assoc - 1) : 0;
 	unsigned int sshift = ffsl(cache[i].line_size);
 	u32 s;
 	u32 w;
@@ -147,10 +153,21 @@ void arm_flush_dcache_lx_per_way(unsigned int level)
 
 	dsb(ish);
 	for (w = 0; w < cache[i].assoc; w++) {
-		for (s = 0; s < cache[i].sets; s++) {
-			sw = (u64)((w << wshift) | (s << sshift) | level);
-			asm volatile("dc cisw, %0\n" : : "r" (sw) : "memory");
+		for (s = first; s < first + num; s++) {
+			sw = ((u64)w << wshift) | ((u64)s << sshift) | (i << 1);
+			if (clean)
+				asm volatile("dc csw, %0\n"
+					     : : "r" (sw) : "memory");
+			else
+				asm volatile("dc cisw, %0\n"
+					     : : "r" (sw) : "memory");
 		}
 	}
 	dsb(ish);
 }
+
+/** Perform a per-way clean + invalidate (flush) on the x-cache level. */
+void arm_flush_dcache_lx_per_way(unsigned int level)
+{
+	arm_dcache_setway_range(level, 0, cache[level - 1].sets, false);
+}
@@ -15,11 +15,13 @@
  */
 #include <jailhouse/control.h>
 #include <jailhouse/paging.h>
+#include <jailhouse/parallel.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/unit.h>
 #include <jailhouse/cell.h>
 #include <jailhouse/coloring.h>
 #include <asm/coloring.h>
+#include <asm/iommu.h>
 
 /**
  *  Only parameter needed to determine the coloring.
@@ -29,6 +31,46 @@ u64 coloring_way_size = 0;
 /** Temporary load-mapping parameter */
 u64 coloring_root_map_offset = 0;
 
+/*
+ * Map a color-range, setting the contiguous hint on its naturally aligned
+ * blocks of PTE_CONT_ENTRIES pages. This is only possible if the range is
+ * equally aligned in VA and PA, and not when huge pages are refused.
+ */
+static int color_map_range(struct color_op *op, unsigned long phys,
+			   unsigned long virt, unsigned long size)
+{
+	const unsigned long cont_size = PTE_CONT_ENTRIES * PAGE_SIZE;
+	unsigned long flags, len;
+	int err;
+
+	if (!(op->paging_flags & PAGING_HUGE) ||
+	    ((phys ^ virt) & (cont_size - 1)) != 0)
+		return paging_create(op->pg_structs, phys, size, virt,
+				     op->access_flags, op->paging_flags);
+
+	while (size > 0) {
+		if ((virt & (cont_size - 1)) == 0 && size >= cont_size) {
+			len = size & ~(cont_size - 1);
+			flags = op->access_flags | PTE_FLAG_CONT;
+		} else {
+			len = MIN(size, cont_size - (virt & (cont_size - 1)));
+			flags = op->access_flags;
+		}
+
+		/* no block entries: the hint would apply to 16 of them */
+		err = paging_create(op->pg_structs, phys, len, virt, flags,
+				    op->paging_flags & ~PAGING_HUGE);
+		if (err)
+			return err;
+
+		phys += len;
+		virt += len;
+		size -= len;
+	}
+
+	return 0;
+}
+
 static int dispatch_op(
 	struct color_op *op,
 	unsigned long bphys,
@@ -40,8 +82,7 @@ static int dispatch_op(
 			/* Fix addr to match the driver's IPA ioremap */
 			bvirt += coloring_root_map_offset;
 		}
-		return paging_create(op->pg_structs, bphys, bsize, bvirt,
-				     op->access_flags, op->paging_flags);
+		return color_map_range(op, bphys, bvirt, bsize);
 	}
 
 	if (op->op & (COL_OP_DESTROY | COL_OP_START)) {
@@ -123,110 +164,251 @@ int color_do_op(struct color_op *op)
 	return err;
 }
 
-static void do_copy_root(const struct jailhouse_memory *mr)
+/** Number of colors (pages per way) in \a colors */
+static unsigned int color_count(u64 colors)
 {
-	unsigned long phys_addr;
-	unsigned long virt_addr;
-	unsigned long tot_size;
-	unsigned long size;
-	unsigned long dst;
-	unsigned long src;
+	unsigned int bit, num = 0;
 
-	tot_size = mr->size;
+	for (bit = 0; bit < 64; bit++)
+		if (colors & (1ULL << bit))
+			num++;
+	return num;
+}
 
-	/* Find the first page that does not belong to the non-colored
-	 * mapping */
-	phys_addr = mr->phys_start + tot_size;
-	assert((phys_addr & PAGE_OFFS_MASK) == 0);
+/** Offset of the page \a page of a region colored with \a colors */
+static unsigned long color_page_offs(u64 colors, unsigned int num_colors,
+				     unsigned long page)
+{
+	unsigned int bit, color = page % num_colors;
 
-	while (tot_size > 0) {
-		size = MIN(tot_size, NUM_TEMPORARY_PAGES * PAGE_SIZE);
-		phys_addr -= size;
+	/* the color-th set bit of the mask */
+	for (bit = 0; bit < 64; bit++)
+		if ((colors & (1ULL << bit)) && color-- == 0)
+			break;
 
-		/* If we have reached the beginning (end of copy),
-		 * make sure we do not exceed the boundary of the
-		 * region */
-		if (phys_addr < mr->phys_start) {
-			size -= (mr->phys_start - phys_addr);
-			assert((size & PAGE_OFFS_MASK) == 0);
-			phys_addr = mr->phys_start;
-		}
+	return (page / num_colors) * coloring_way_size + bit * PAGE_SIZE;
+}
 
-		/* cannot fail, mapping area is preallocated */
-		paging_create(&this_cpu_data()->pg_structs, phys_addr,
-				size, TEMPORARY_MAPPING_BASE,
-				PAGE_DEFAULT_FLAGS,
-				PAGING_NON_COHERENT | PAGING_NO_HUGE);
-
-		/* Destination: end of colored mapping created via ROOT_MAP */
-		/* NOTE: the colored mapping created via ROOT_MAP has
-		 * an offset that depends on the virtual_address of
-		 * the target mapping. Make sure that the copy is
-		 * correct even if phys_addr and virt_addr differ */
-		virt_addr = mr->virt_start + (phys_addr - mr->phys_start);
-		dst = coloring_root_map_offset + virt_addr + size;
-		/* Source: end of non-colored mapping defined above */
-		src = TEMPORARY_MAPPING_BASE + size;
-		tot_size -= size;
-
-		/* Actual data copy operation */
-		while (size > 0) {
-			size -= PAGE_SIZE;
-			dst -= PAGE_SIZE;
-			src -= PAGE_SIZE;
-			memcpy((void*)dst, (void*)src, PAGE_SIZE);
-		}
+/**
+ * Page of a region colored with \a colors that is stored at offset \a offs,
+ * or -1 if the offset has none of the colors.
+ */
+static long color_page_index(u64 colors, unsigned int num_colors,
+			     unsigned long offs)
+{
+	unsigned int bit = (offs % coloring_way_size) / PAGE_SIZE;
+
+	if (bit >= 64 || !(colors & (1ULL << bit)))
+		return -1;
+
+	return (offs / coloring_way_size) * num_colors +
+		color_count(colors & ((1ULL << bit) - 1));
+}
+
+int color_paging_create_part(const struct paging_structures *pg_structs,
+			     const struct jailhouse_memory *mem,
+			     unsigned long offs, unsigned long size,
+			     unsigned long access_flags,
+			     unsigned long paging_flags)
+{
+	unsigned int num_colors = color_count(mem->colors);
+	unsigned long page, end, run, page_offs;
+	struct color_op op;
+	int err;
+
+	if (coloring_way_size == 0 || num_colors == 0)
+		return -EINVAL;
+
+	op.pg_structs = pg_structs;
+	op.access_flags = access_flags;
+	op.paging_flags = paging_flags;
+
+	end = (offs + size) / PAGE_SIZE;
+	for (page = offs / PAGE_SIZE; page < end; page += run) {
+		page_offs = color_page_offs(mem->colors, num_colors, page);
+
+		/* extend over the pages that follow in both IPA and PA */
+		for (run = 1; page + run < end; run++)
+			if (color_page_offs(mem->colors, num_colors,
+					    page + run) !=
+			    page_offs + run * PAGE_SIZE)
+				break;
+
+		err = color_map_range(&op, mem->phys_start + page_offs,
+				      mem->virt_start + page * PAGE_SIZE,
+				      run * PAGE_SIZE);
+		if (err)
+			return err;
 	}
+
+	return 0;
 }
 
-static void do_uncopy_root(const struct jailhouse_memory *mr)
+/* Pages of the temporary window used for the linear side of a copy, the
+ * other half maps the colored side.
+ */
+#define COPY_CHUNK_PAGES	(NUM_TEMPORARY_PAGES / 2)
+
+/**
+ * Root cell (un)copy shared by all the root cell CPUs. The master CPU
+ * splits each region into waves of pages that can be copied in any order,
+ * the chunks of the current wave are then copied with parallel_run, each
+ * CPU through its own temporary mapping window.
+ */
+static struct {
+	/** Region being copied */
+	const struct jailhouse_memory *mr;
+	bool init;
+	/** Number of colors (pages per way) of the region */
+	unsigned int num_colors;
+	/** Offsets of the current wave */
+	unsigned long lo, hi;
+} root_copy;
+
+/** Physical address of the page at offset \a offs of the colored range */
+static unsigned long root_copy_colored_phys(unsigned long offs)
 {
-	unsigned long phys_addr;
-	unsigned long tot_size;
-	unsigned long size;
-	unsigned long dst;
-	unsigned long src;
+	return root_copy.mr->phys_start +
+		color_page_offs(root_copy.mr->colors, root_copy.num_colors,
+				offs / PAGE_SIZE);
+}
 
-	tot_size = mr->size;
+/** Lowest page offset in [lo, hi] whose colored copy is at \a phys or above */
+static unsigned long root_copy_search(unsigned long lo, unsigned long hi,
+				      unsigned long phys)
+{
+	unsigned long mid;
+
+	while (lo < hi) {
+		mid = lo + ((hi - lo) / PAGE_SIZE / 2) * PAGE_SIZE;
+		if (root_copy_colored_phys(mid) >= phys)
+			hi = mid;
+		else
+			lo = mid + PAGE_SIZE;
+	}
 
-	/* Find the first page that does not belong to the non-colored
-	 * mapping */
-	phys_addr = mr->phys_start;
-	assert((phys_addr & PAGE_OFFS_MASK) == 0);
-	assert((tot_size & PAGE_OFFS_MASK) == 0);
+	return lo;
+}
 
-	while (tot_size > 0) {
-		size = MIN(tot_size, NUM_TEMPORARY_PAGES * PAGE_SIZE);
+/** Copy \a pages pages at offset \a offs, in the current direction */
+static void root_copy_chunk(unsigned long offs, unsigned int pages)
+{
+	const struct jailhouse_memory *mr = root_copy.mr;
+	unsigned long linear = TEMPORARY_MAPPING_BASE;
+	unsigned long colored = linear + COPY_CHUNK_PAGES * PAGE_SIZE;
+	unsigned int n;
 
-		/* cannot fail, mapping area is preallocated */
-		paging_create(&this_cpu_data()->pg_structs, phys_addr,
-				size, TEMPORARY_MAPPING_BASE,
-				PAGE_DEFAULT_FLAGS,
-				PAGING_NON_COHERENT | PAGING_NO_HUGE);
+	/* cannot fail, mapping area is preallocated */
+	paging_create(&this_cpu_data()->pg_structs, mr->phys_start + offs,
+		      pages * PAGE_SIZE, linear, PAGE_DEFAULT_FLAGS,
+		      PAGING_NON_COHERENT | PAGING_NO_HUGE);
+	for (n = 0; n < pages; n++)
+		paging_create(&this_cpu_data()->pg_structs,
+			      root_copy_colored_phys(offs + n * PAGE_SIZE),
+			      PAGE_SIZE, colored + n * PAGE_SIZE,
+			      PAGE_DEFAULT_FLAGS,
+			      PAGING_NON_COHERENT | PAGING_NO_HUGE);
+
+	for (n = 0; n < pages; n++) {
+		if (root_copy.init)
+			copy_page((void *)colored, (void *)linear);
+		else
+			copy_page((void *)linear, (void *)colored);
+		linear += PAGE_SIZE;
+		colored += PAGE_SIZE;
+	}
+}
 
-		/* Destination: non-colored mapping */
-		dst = TEMPORARY_MAPPING_BASE;
-		/* Source: colored mapping created via ROOT_MAP */
-		src = coloring_root_map_offset + phys_addr;
+/** Copy chunk \a item of the current wave */
+static int root_copy_item(unsigned long item)
+{
+	unsigned long offs = root_copy.lo + item * COPY_CHUNK_PAGES * PAGE_SIZE;
 
-		tot_size -= size;
-		phys_addr += size;
+	root_copy_chunk(offs, MIN(COPY_CHUNK_PAGES,
+				  (root_copy.hi - offs) / PAGE_SIZE));
+	return 0;
+}
 
-		while (size > 0) {
-			memcpy((void*)dst, (void*)src, PAGE_SIZE);
-			dst += PAGE_SIZE;
-			src += PAGE_SIZE;
-			size -= PAGE_SIZE;
-		}
+/** Copy the wave [lo, hi) with the help of the waiting CPUs */
+static void root_copy_wave(unsigned long lo, unsigned long hi)
+{
+	unsigned long pages = (hi - lo) / PAGE_SIZE;
+
+	root_copy.lo = lo;
+	root_copy.hi = hi;
+	parallel_run(root_copy_item,
+		     (pages + COPY_CHUNK_PAGES - 1) / COPY_CHUNK_PAGES);
+}
+
+/*
+ * The colored copy of page x is never below x, and the distance between
+ * the two never shrinks along the region. Pages that are their own copy
+ * (\a identity) form a prefix of the region and need no copy.
+ *
+ * At init time, copy backward: the wave [lo, hi) can be copied in any
+ * order if all its colored pages are at or above hi, i.e. they do not
+ * overlay the part of the region still to be read.
+ */
+static void do_copy_root(const struct jailhouse_memory *mr,
+			 unsigned long identity)
+{
+	unsigned long lo, hi = mr->size;
+
+	while (hi > identity) {
+		lo = root_copy_search(identity, hi - PAGE_SIZE,
+				      mr->phys_start + hi);
+		root_copy_wave(lo, hi);
+		hi = lo;
 	}
 }
 
+/*
+ * At shutdown, copy forward: the wave [lo, hi) can be copied in any order
+ * if all the colored pages it reads are at or above hi, i.e. they are not
+ * overwritten by the wave itself.
+ */
+static void do_uncopy_root(const struct jailhouse_memory *mr,
+			   unsigned long identity)
+{
+	unsigned long lo = identity, hi;
+
+	while (lo < mr->size) {
+		hi = MIN(mr->size, root_copy_colored_phys(lo) - mr->phys_start);
+		root_copy_wave(lo, hi);
+		lo = hi;
+	}
+}
+
+/** (Un)copy the colored region \a mr with the help of all root CPUs */
+static void root_copy_region(const struct jailhouse_memory *mr, bool init)
+{
+	unsigned long identity = 0;
+	unsigned int bit;
+
+	root_copy.init = init;
+	root_copy.num_colors = color_count(mr->colors);
+	root_copy.mr = mr;
+
+	if (root_copy.num_colors == 0)
+		return;
+
+	/* colors 0..n-1 of the first way stay in place */
+	for (bit = 0; bit < 64 && (mr->colors & (1ULL << bit)); bit++)
+		identity += PAGE_SIZE;
+	if (identity >= coloring_way_size)
+		identity = mr->size;
+	identity = MIN(identity, mr->size);
+
+	if (init)
+		do_copy_root(mr, identity);
+	else
+		do_uncopy_root(mr, identity);
+}
+
 int color_copy_root(struct cell *root, bool init)
 {
 	const struct jailhouse_memory *mr;
-	struct color_op op;
 	unsigned int n;
-	int err;
 
 	assert(root == &root_cell);
 	if (coloring_way_size == 0) {
@@ -250,38 +432,466 @@ int color_copy_root(struct cell *root, bool init)
 			continue;
 		}
 
-		op.pg_structs = &this_cpu_data()->pg_structs;
-		op.phys = mr->phys_start;
-		op.virt = mr->virt_start;
-		op.size = mr->size;
-		op.access_flags = PAGE_DEFAULT_FLAGS;
-		op.color_mask = mr->colors;
-		op.flush_type = 0;
-
-		/* temporary color map */
-		op.op = COL_OP_ROOT_MAP;
-		op.paging_flags = PAGING_NON_COHERENT | PAGING_NO_HUGE;
-		err = color_do_op(&op);
-		if (err) {
-			return err;
+		root_copy_region(mr, init);
+	}
+
+	return 0;
+}
+
+/** State of the recoloring of one memory region */
+struct recolor {
+	const struct jailhouse_memory *mem;
+	u64 old_colors, new_colors;
+	unsigned int old_num, new_num;
+	unsigned long pages;
+	/** Pages already at their new location */
+	unsigned long *moved;
+	/** Page saving the start of a cycle */
+	void *bounce;
+};
+
+/** Map \a phys in the slot \a slot of the temporary mapping window */
+static void *recolor_map(unsigned long phys, unsigned int slot)
+{
+	unsigned long virt = TEMPORARY_MAPPING_BASE + slot * PAGE_SIZE;
+
+	/* cannot fail, mapping area is preallocated */
+	paging_create(&this_cpu_data()->pg_structs, phys, PAGE_SIZE, virt,
+		      PAGE_DEFAULT_FLAGS, PAGING_NON_COHERENT | PAGING_NO_HUGE);
+	return (void *)virt;
+}
+
+static unsigned long recolor_old(struct recolor *rc, unsigned long page)
+{
+	return rc->mem->phys_start +
+		color_page_offs(rc->old_colors, rc->old_num, page);
+}
+
+static unsigned long recolor_new(struct recolor *rc, unsigned long page)
+{
+	return rc->mem->phys_start +
+		color_page_offs(rc->new_colors, rc->new_num, page);
+}
+
+/** Page still stored where \a page has to go, -1 if that place is free */
+static long recolor_blocker(struct recolor *rc, unsigned long page)
+{
+	long blocker = color_page_index(rc->old_colors, rc->old_num,
+			recolor_new(rc, page) - rc->mem->phys_start);
+
+	if (blocker < 0 || (unsigned long)blocker >= rc->pages ||
+	    test_bit(blocker, rc->moved))
+		return -1;
+	return blocker;
+}
+
+/** Page that has to go where \a page is stored now */
+static unsigned long recolor_pred(struct recolor *rc, unsigned long page)
+{
+	return color_page_index(rc->new_colors, rc->new_num,
+				recolor_old(rc, page) - rc->mem->phys_start);
+}
+
+static void recolor_move(struct recolor *rc, unsigned long page, void *src)
+{
+	if (!src)
+		src = recolor_map(recolor_old(rc, page), 0);
+	copy_page(recolor_map(recolor_new(rc, page), 1), src);
+	set_bit(page, rc->moved);
+}
+
+/*
+ * Each color mask maps the pages of the region to distinct locations, so
+ * every page is blocked by at most one other page still at its new location
+ * and blocks at most one. These blocking relations form chains, moved from
+ * their end, and cycles, which need one page to be saved first.
+ */
+static void recolor_region(struct recolor *rc)
+{
+	unsigned long page, last;
+	bool cycle;
+	long next;
+
+	for (page = 0; page < rc->pages; page++) {
+		if (test_bit(page, rc->moved))
+			continue;
+		if (recolor_old(rc, page) == recolor_new(rc, page)) {
+			set_bit(page, rc->moved);
+			continue;
 		}
 
-		if (init) {
-			/* copy root memory into colored ranges */
-			do_copy_root(mr);
-		} else {
-			/* copy root into non-colored regions */
-			do_uncopy_root(mr);
+		last = page;
+		cycle = false;
+		while ((next = recolor_blocker(rc, last)) >= 0) {
+			if ((unsigned long)next == page) {
+				cycle = true;
+				break;
+			}
+			last = next;
+		}
+
+		if (cycle)
+			copy_page(rc->bounce,
+				  recolor_map(recolor_old(rc, page), 0));
+		while (last != page) {
+			recolor_move(rc, last, NULL);
+			last = recolor_pred(rc, last);
+		}
+		recolor_move(rc, page, cycle ? rc->bounce : NULL);
+	}
+}
+
+/** Physical extent of a region of \a size bytes colored with \a colors */
+static unsigned long color_span(u64 colors, unsigned long size)
+{
+	return color_page_offs(colors, color_count(colors),
+			       size / PAGE_SIZE - 1) + PAGE_SIZE;
+}
+
+/** Whether the frame at \a phys belongs to the region \a mem */
+static bool region_has_frame(const struct jailhouse_memory *mem,
+			     unsigned long phys)
+{
+	long page;
+
+	if (phys < mem->phys_start)
+		return false;
+	if (!(mem->flags & JAILHOUSE_MEM_COLORED))
+		return phys - mem->phys_start < mem->size;
+
+	page = color_page_index(mem->colors, color_count(mem->colors),
+				phys - mem->phys_start);
+	return page >= 0 && (unsigned long)page < mem->size / PAGE_SIZE;
+}
+
+/** Whether a region of a non-root cell, except \a skip, uses \a phys */
+static bool recolor_frame_taken(const struct jailhouse_memory *skip,
+				unsigned long phys)
+{
+	const struct jailhouse_memory *mem;
+	struct cell *cell;
+	unsigned int n;
+
+	for_each_non_root_cell(cell)
+		for_each_mem_region(mem, cell->config, n)
+			if (mem != skip &&
+			    !(mem->flags & JAILHOUSE_MEM_COMM_REGION) &&
+			    region_has_frame(mem, phys))
+				return true;
+	return false;
+}
+
+/**
+ * Frame of \a page under the old or the new colors, returns whether the
+ * region does not also use that frame under the other colors.
+ */
+static bool recolor_frame(struct recolor *rc, unsigned long page, bool old,
+			  unsigned long *phys)
+{
+	u64 keep = old ? rc->new_colors : rc->old_colors;
+	unsigned int keep_num = old ? rc->new_num : rc->old_num;
+	long keep_page;
+
+	*phys = old ? recolor_old(rc, page) : recolor_new(rc, page);
+	keep_page = color_page_index(keep, keep_num,
+				     *phys - rc->mem->phys_start);
+	return keep_page < 0 || (unsigned long)keep_page >= rc->pages;
+}
+
+/* Frames of the new colors must not belong to any other cell */
+static int recolor_check(struct recolor *rc)
+{
+	unsigned long page, phys;
+
+	for (page = 0; page < rc->pages; page++)
+		if (recolor_frame(rc, page, false, &phys) &&
+		    recolor_frame_taken(rc->mem, phys))
+			return trace_error(-EBUSY);
+	return 0;
+}
+
+/** (Un)map a run of frames 1:1 in the root cell, if they are its RAM */
+static int recolor_root_run(unsigned long phys, unsigned long size, bool map)
+{
+	const struct jailhouse_memory *root_mem;
+	struct jailhouse_memory run;
+	unsigned int n;
+
+	for_each_mem_region(root_mem, root_cell.config, n) {
+		if (phys < root_mem->phys_start ||
+		    phys + size > root_mem->phys_start + root_mem->size ||
+		    root_mem->flags & JAILHOUSE_MEM_COLORED)
+			continue;
+
+		run.phys_start = phys;
+		run.virt_start = root_mem->virt_start + phys -
+			root_mem->phys_start;
+		run.size = size;
+		run.flags = root_mem->flags;
+		return map ? arch_map_memory_region(&root_cell, &run) :
+			arch_unmap_memory_region(&root_cell, &run);
+	}
+	return 0;
+}
+
+/*
+ * Takes the frames that only the new colors use from the root cell, or
+ * hands those only the old colors used back to it, in runs of contiguous
+ * frames.
+ */
+static int recolor_root_update(struct recolor *rc, bool to_root)
+{
+	unsigned long page, phys, start = 0, size = 0;
+	bool give;
+	int err;
+
+	for (page = 0; page <= rc->pages; page++) {
+		give = page < rc->pages &&
+			recolor_frame(rc, page, to_root, &phys);
+		if (give && size && phys == start + size) {
+			size += PAGE_SIZE;
+			continue;
+		}
+		if (size) {
+			err = recolor_root_run(start, size, to_root);
+			if (err)
+				return err;
 		}
+		start = phys;
+		size = give ? PAGE_SIZE : 0;
+	}
+	return 0;
+}
+
+int color_cell_recolor(struct cell *cell, u64 colors)
+{
+	const struct jailhouse_memory *mem;
+	struct jailhouse_memory *region;
+	unsigned int n, bitmap_pages;
+	unsigned long max_pages = 0;
+	struct recolor rc;
+	int err = 0;
+
+	if (coloring_way_size == 0 || colors == 0 ||
+	    (coloring_way_size / PAGE_SIZE < 64 &&
+	     (colors >> (coloring_way_size / PAGE_SIZE)) != 0))
+		return trace_error(-EINVAL);
+
+	if (cell->config->num_memory_regions >
+	    PAGE_SIZE / sizeof(*cell->arch.color_spans))
+		return trace_error(-E2BIG);
+
+	/*
+	 * The extent of the regions as created is the memory reserved for
+	 * them, so record it before the first change.
+	 */
+	if (!cell->arch.color_spans) {
+		cell->arch.color_spans = page_alloc(&mem_pool, 1);
+		if (!cell->arch.color_spans)
+			return -ENOMEM;
+		for_each_mem_region(mem, cell->config, n)
+			if (mem->flags & JAILHOUSE_MEM_COLORED)
+				cell->arch.color_spans[n] =
+					color_span(mem->colors, mem->size);
+	}
+
+	for_each_mem_region(mem, cell->config, n) {
+		if (!(mem->flags & JAILHOUSE_MEM_COLORED))
+			continue;
+		if (mem->flags & (JAILHOUSE_MEM_IO | JAILHOUSE_MEM_COMM_REGION |
+				  JAILHOUSE_MEM_ROOTSHARED))
+			return trace_error(-EINVAL);
+		if (color_span(colors, mem->size) > cell->arch.color_spans[n])
+			return trace_error(-E2BIG);
+		max_pages = MAX(max_pages, mem->size / PAGE_SIZE);
+	}
+	if (max_pages == 0)
+		return trace_error(-EINVAL);
+
+	/* allocate everything before unmapping: remapping can't run short */
+	bitmap_pages = PAGES((max_pages + 7) / 8);
+	rc.moved = page_alloc(&mem_pool, bitmap_pages);
+	if (!rc.moved)
+		return -ENOMEM;
+	rc.bounce = page_alloc(&mem_pool, 1);
+	if (!rc.bounce) {
+		err = -ENOMEM;
+		goto out_free_bitmap;
+	}
+
+	rc.new_colors = colors;
+	rc.new_num = color_count(colors);
+
+	for_each_mem_region(mem, cell->config, n) {
+		if (!(mem->flags & JAILHOUSE_MEM_COLORED) ||
+		    mem->colors == colors)
+			continue;
+		rc.mem = mem;
+		rc.old_colors = mem->colors;
+		rc.old_num = color_count(rc.old_colors);
+		rc.pages = mem->size / PAGE_SIZE;
+		err = recolor_check(&rc);
+		if (err)
+			goto out_free_bounce;
+	}
+
+	for (n = 0; n < cell->config->num_memory_regions; n++) {
+		/* the hypervisor owns this copy of the configuration */
+		region = (struct jailhouse_memory *)
+			&jailhouse_cell_mem_regions(cell->config)[n];
+		if (!(region->flags & JAILHOUSE_MEM_COLORED) ||
+		    region->colors == colors)
+			continue;
 
-		/* remove mapping */
-		op.op = COL_OP_ROOT_UNMAP;
-		op.paging_flags = PAGING_NON_COHERENT;
-		err = color_do_op(&op);
+		rc.mem = region;
+		rc.old_colors = region->colors;
+		rc.old_num = color_count(rc.old_colors);
+		rc.pages = region->size / PAGE_SIZE;
+		memset(rc.moved, 0, bitmap_pages * PAGE_SIZE);
+
+		err = arch_unmap_memory_region(cell, region);
+		if (err)
+			break;
+
+		/*
+		 * The root cell is suspended, neither its CPUs nor, after the
+		 * flush, its DMA reach the destination frames during the copy.
+		 */
+		err = recolor_root_update(&rc, false);
+		if (err)
+			break;
+		arch_flush_cell_vcpu_caches(&root_cell);
+		iommu_flush_cell_tlbs(&root_cell);
+
+		arm_color_dcache_flush_memory_region(region->phys_start,
+				region->size, region->virt_start, rc.old_colors,
+				DCACHE_CLEAN_AND_INVALIDATE);
+		recolor_region(&rc);
+		region->colors = colors;
+		arm_color_dcache_flush_memory_region(region->phys_start,
+				region->size, region->virt_start, colors,
+				DCACHE_CLEAN_AND_INVALIDATE);
+
+		err = arch_map_memory_region(cell, region);
 		if (err) {
-			return err;
+			printk("FATAL: cannot remap recolored region\n");
+			break;
 		}
+
+		if (recolor_root_update(&rc, true))
+			printk("WARNING: Failed to re-assign memory region "
+			       "to root cell\n");
 	}
 
+	arch_flush_cell_vcpu_caches(cell);
+	iommu_flush_cell_tlbs(cell);
+	arch_flush_cell_vcpu_caches(&root_cell);
+	iommu_flush_cell_tlbs(&root_cell);
+
+out_free_bounce:
+	page_free(&mem_pool, rc.bounce, 1);
+out_free_bitmap:
+	page_free(&mem_pool, rc.moved, bitmap_pages);
+
 	return err;
 }
+
+void color_cell_exit(struct cell *cell)
+{
+	if (cell->arch.color_spans)
+		page_free(&mem_pool, cell->arch.color_spans, 1);
+	cell->arch.color_spans = NULL;
+}
+
+long color_get_info(unsigned long type)
+{
+	switch (type) {
+	case JAILHOUSE_INFO_LLC_SIZE:
+		return cache_llc ? cache_llc->size : 0;
+	case JAILHOUSE_INFO_LLC_WAY_SIZE:
+		return cache_llc ? cache_llc->way_size : 0;
+	case JAILHOUSE_INFO_COLOR_WAY_SIZE:
+		return coloring_way_size;
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * A walk by VA costs one operation per line of the region, a set/way flush
+ * the lines of the private caches and of the colors in the LLC, which every
+ * suspended CPU does in parallel. Switch over at this multiple of the LLC.
+ */
+#define SETWAY_FLUSH_LLC_FACTOR		4
+
+static struct {
+	u64 colors;
+	bool clean;
+} setway;
+
+static void setway_flush_local(void)
+{
+	unsigned int level = cache_llc->level;
+	u32 sets = PAGE_SIZE / cache_llc->line_size;
+	u64 colors = setway.colors;
+	unsigned int n, c;
+
+	/* Invalidation by set/way may drop other dirty lines: always clean */
+	for (n = 0; n < level; n++)
+		if (cache[n].level >= 0)
+			arm_dcache_setway_range(n + 1, 0, cache[n].sets,
+						setway.clean);
+
+	for (c = 0; colors != 0; c++, colors >>= 1)
+		if (colors & 1)
+			arm_dcache_setway_range(level + 1, c * sets, sets,
+						setway.clean);
+}
+
+void color_dcache_setway_help(void)
+{
+	struct public_per_cpu *cpu_public = this_cpu_public();
+
+	if (!cpu_public->flush_dcache_setway)
+		return;
+
+	memory_barrier();
+	setway_flush_local();
+	memory_barrier();
+	cpu_public->flush_dcache_setway = false;
+}
+
+bool color_dcache_flush_setway(unsigned long size, u64 color_mask,
+			       enum dcache_flush flush_type)
+{
+	struct cell *cell;
+	unsigned int cpu;
+
+	/* The colors must map to sets of the LLC */
+	if (!cache_llc || cache_llc->way_size != coloring_way_size ||
+	    size < SETWAY_FLUSH_LLC_FACTOR * cache_llc->size)
+		return false;
+
+	setway.colors = color_mask;
+	setway.clean = (flush_type == DCACHE_CLEAN);
+	memory_barrier();
+
+	/*
+	 * Of the CPUs that can hold lines of the region, the running ones are
+	 * not touching it, the suspended ones flush their private caches.
+	 */
+	for_each_cell(cell)
+		for_each_cpu_except(cpu, cell->cpu_set, this_cpu_id())
+			if (public_per_cpu(cpu)->cpu_suspended)
+				public_per_cpu(cpu)->flush_dcache_setway = true;
+
+	setway_flush_local();
+
+	for_each_cell(cell)
+		for_each_cpu(cpu, cell->cpu_set)
+			while (public_per_cpu(cpu)->flush_dcache_setway)
+				cpu_relax();
+	memory_barrier();
+
+	return true;
+}
@@ -0,0 +1,130 @@
+/*
+ * DSU (cluster) PMU support for Memguard for Jailhouse ARM64
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#include <jailhouse/control.h>
+#include <jailhouse/assert.h>
+#include <jailhouse/cpu_stats.h>
+#include <jailhouse/panic.h>
+#include <asm/exit_stats.h>
+#include <asm/gic_v2.h>
+#include <asm/gic_v3.h>
+#include <asm/dsu_pmu.h>
+#include <asm/spinlock.h>
+
+#if JAILHOUSE_MAX_DSU_CLUSTERS > JAILHOUSE_DSU_STATS_CLUSTERS
+#error JAILHOUSE_DSU_STATS_CLUSTERS too small
+#endif
+
+static bool (*_dsu_isr_handler)(void) = NULL;
+
+/* Partition and counts of each cluster, published to the root cell */
+static struct {
+	spinlock_t lock;
+	struct jailhouse_dsu_stats stats;
+} dsu_clusters[JAILHOUSE_MAX_DSU_CLUSTERS];
+
+static inline const struct jailhouse_memguard_config *dsu_config(void)
+{
+	return &system_config->platform_info.memguard;
+}
+
+bool irq_is_dsu(u32 irqno)
+{
+	const struct jailhouse_memguard_config *mconf = dsu_config();
+	u32 n;
+
+	for (n = 0; n < mconf->num_dsu_irq; n++)
+		if (irqno == mconf->dsu_cluster_irq[n])
+			return true;
+
+	return false;
+}
+
+bool dsu_isr_handler(void)
+{
+	if (_dsu_isr_handler != NULL)
+		return (*_dsu_isr_handler)();
+	else
+		return true;
+}
+
+/**
+ * The DSU PMU has no EL2 partitioning like MDCR_EL2.HPMN: the counters
+ * reserved here are announced to the root cell in the shared statistics
+ * page, see struct jailhouse_dsu_stats.
+ */
+int dsu_register(bool (*handler)(void))
+{
+	const struct jailhouse_memguard_config *mconf = dsu_config();
+	u32 arch_cnt, n;
+
+	if (mconf->num_dsu_irq == 0)
+		return -ENODEV;
+	if (mconf->num_dsu_irq > JAILHOUSE_MAX_DSU_CLUSTERS) {
+		printk("DSU: Invalid num clusters: %u\n", mconf->num_dsu_irq);
+		panic_stop();
+	}
+
+	arch_cnt = dsu_get_num_cnt();
+	if (arch_cnt < JAILHOUSE_DSU_HYP_COUNTERS) {
+		printk("DSU: no cluster counters available\n");
+		return -ENODEV;
+	}
+
+	assert(_dsu_isr_handler == NULL);
+	_dsu_isr_handler = handler;
+
+	/* all the clusters are alike, keep the topmost counters */
+	for (n = 0; n < mconf->num_dsu_irq; n++) {
+		dsu_clusters[n].stats.num_cnt = arch_cnt;
+		dsu_clusters[n].stats.first_hyp_cnt =
+			arch_cnt - JAILHOUSE_DSU_HYP_COUNTERS;
+		exit_stats_dsu_publish(n, &dsu_clusters[n].stats);
+	}
+
+	return arch_cnt - JAILHOUSE_DSU_HYP_COUNTERS;
+}
+
+void dsu_count(unsigned int cluster, unsigned int cnt, u32 event, u32 delta)
+{
+	struct jailhouse_dsu_stats *stats = &dsu_clusters[cluster].stats;
+	unsigned int idx = cnt - stats->first_hyp_cnt;
+
+	if (idx >= JAILHOUSE_DSU_HYP_COUNTERS)
+		return;
+
+	spin_lock(&dsu_clusters[cluster].lock);
+	stats->count[idx] += delta;
+	stats->event_type[idx] = event;
+	exit_stats_dsu_publish(cluster, stats);
+	spin_unlock(&dsu_clusters[cluster].lock);
+}
+
+void dsu_claim(unsigned int cluster)
+{
+	u32 irq = dsu_config()->dsu_cluster_irq[cluster];
+
+	if (system_config->platform_info.arm.gic_version == 3) {
+		gicv3_spi_route(irq, this_cpu_public()->mpidr);
+		gicv3_spi_enable(irq);
+	} else {
+		gicv2_set_targets(irq, (1U << this_cpu_id()));
+		gicv2_enable_irq(irq);
+	}
+	dsu_print("irq %u, cluster %u, cpu %u\n", irq, cluster, this_cpu_id());
+}
+
+void dsu_release(unsigned int cluster)
+{
+	u32 irq = dsu_config()->dsu_cluster_irq[cluster];
+
+	if (system_config->platform_info.arm.gic_version == 3)
+		gicv3_spi_disable(irq);
+	else
+		gicv2_disable_irq(irq);
+}
@@ -0,0 +1,130 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#include <jailhouse/control.h>
+#include <jailhouse/cpu_stats.h>
+#include <jailhouse/percpu.h>
+#include <jailhouse/string.h>
+#include <asm/exit_stats.h>
+#include <asm/gic.h>
+#include <asm/gic_v2.h>
+#include <asm/gic_v3.h>
+#include <asm/pmu.h>
+#include <asm/sysregs.h>
+#include <asm/timer.h>
+
+/*
+ * Time spent in the hypervisor on behalf of the cell, split by trap class
+ * and by interrupt type. The per-CPU tick sums are exported in microseconds
+ * as JAILHOUSE_CPU_STAT_TRAP_US_* and JAILHOUSE_CPU_STAT_IRQ_US_*. Measured
+ * with the generic timer: PMCCNTR belongs to the guest or is stopped while
+ * it sleeps.
+ *
+ * All counters of a CPU are also copied into a shared page after each exit,
+ * so that the root cell can read them without a hypercall per counter.
+ * Exits handled in the entry.S fast path show up with the next full exit.
+ */
+
+#if JAILHOUSE_NUM_CPU_STATS > JAILHOUSE_CPU_STATS_MAX
+#error JAILHOUSE_CPU_STATS_MAX too small
+#endif
+
+/* Mapped read-only to the root cell */
+static struct jailhouse_stats_page stats_page
+	__attribute__((section(".cpustats")));
+
+static void exit_stats_account(unsigned int stat, u64 start)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	u64 *ticks = &cpu_data->exit_ticks[stat - (JAILHOUSE_CPU_STAT_TRAP_US_HVC)];
+
+	*ticks += timer_get_ticks() - start;
+	cpu_data->public.stats[stat] = timer_ticks_to_us(*ticks);
+}
+
+void exit_stats_trap(u64 esr, u64 start)
+{
+	unsigned int stat;
+
+	switch (ESR_EC(esr)) {
+	case ESR_EC_HVC64:
+		stat = JAILHOUSE_CPU_STAT_TRAP_US_HVC;
+		break;
+	case ESR_EC_SMC64:
+		stat = JAILHOUSE_CPU_STAT_TRAP_US_SMC;
+		break;
+	case ESR_EC_SYS64:
+		stat = JAILHOUSE_CPU_STAT_TRAP_US_SYSREG;
+		break;
+	case ESR_EC_DABT_LOW:
+		stat = JAILHOUSE_CPU_STAT_TRAP_US_DABT;
+		break;
+	case ESR_EC_IABT_LOW:
+		stat = JAILHOUSE_CPU_STAT_TRAP_US_IABT;
+		break;
+	default:
+		/* all other classes are fatal */
+		return;
+	}
+
+	exit_stats_account(stat, start);
+}
+
+void exit_stats_irq(u32 irqn, u64 start)
+{
+	unsigned int stat;
+
+	if (is_sgi(irqn))
+		stat = JAILHOUSE_CPU_STAT_IRQ_US_SGI;
+	else if (irqn == system_config->platform_info.arm.maintenance_irq)
+		stat = JAILHOUSE_CPU_STAT_IRQ_US_MAINTENANCE;
+	else if (irqn == system_config->platform_info.memguard.hv_timer)
+		stat = JAILHOUSE_CPU_STAT_IRQ_US_TIMER;
+	else if (irq_is_pmu(irqn))
+		stat = JAILHOUSE_CPU_STAT_IRQ_US_PMU;
+	else
+		stat = JAILHOUSE_CPU_STAT_IRQ_US_OTHER;
+
+	exit_stats_account(stat, start);
+}
+
+void exit_stats_publish(void)
+{
+	struct jailhouse_cpu_stats *page;
+
+	if (this_cpu_id() >= JAILHOUSE_CPU_STATS_CPUS)
+		return;
+
+	page = &stats_page.cpu[this_cpu_id()];
+	page->seq++;
+	dmb(ishst);
+	page->num_stats = JAILHOUSE_NUM_CPU_STATS;
+	memcpy(page->stats, this_cpu_public()->stats,
+	       sizeof(this_cpu_public()->stats));
+	dmb(ishst);
+	page->seq++;
+}
+
+void exit_stats_dsu_publish(unsigned int cluster,
+			    const struct jailhouse_dsu_stats *dsu)
+{
+	struct jailhouse_dsu_stats *page;
+
+	if (cluster >= JAILHOUSE_DSU_STATS_CLUSTERS)
+		return;
+
+	page = &stats_page.dsu[cluster];
+	page->seq++;
+	dmb(ishst);
+	page->num_cnt = dsu->num_cnt;
+	page->first_hyp_cnt = dsu->first_hyp_cnt;
+	memcpy(page->event_type, dsu->event_type, sizeof(page->event_type));
+	memcpy(page->count, dsu->count, sizeof(page->count));
+	dmb(ishst);
+	page->seq++;
+}
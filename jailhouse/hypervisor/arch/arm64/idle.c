@@ -0,0 +1,136 @@
+/*
+ * Idle states of the firmware for Jailhouse ARM64
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * PSCI CPU_SUSPEND of a cell is passed to the firmware once psci.c validated
+ * the requested state. Power-down states lose the EL2 context of the CPU: it
+ * is saved in the per-CPU data and restored when the firmware resumes at
+ * arm_idle_resume, before the cell continues at its entry point.
+ */
+
+#include <jailhouse/control.h>
+#include <jailhouse/paging.h>
+#include <asm/control.h>
+#include <asm/entry.h>
+#include <asm/gic_v2.h>
+#include <asm/gic_v3.h>
+#include <asm/idle.h>
+#include <asm/irqchip.h>
+#include <asm/pmu.h>
+#include <asm/psci.h>
+#include <asm/smc.h>
+#include <asm/smccc.h>
+#include <asm/sysregs.h>
+#include <asm/timer64.h>
+
+/*
+ * The next event of the hypervisor timer, e.g. a memguard period, must not
+ * come before the state paid off. The target residency covers entry and exit.
+ */
+static bool idle_state_fits(const struct jailhouse_idle_state *state)
+{
+	struct timer_event *next = this_cpu_data()->timer_queue;
+
+	return !next || next->deadline > timer_get_ticks() +
+		timer_us_to_ticks(state->target_residency_us);
+}
+
+static void idle_save(struct idle_context *ctx)
+{
+	arm_read_sysreg(VBAR_EL2, ctx->vbar_el2);
+	arm_read_sysreg(HCR_EL2, ctx->hcr_el2);
+	arm_read_sysreg(VTCR_EL2, ctx->vtcr_el2);
+	arm_read_sysreg(VTTBR_EL2, ctx->vttbr_el2);
+	arm_read_sysreg(VMPIDR_EL2, ctx->vmpidr_el2);
+	arm_read_sysreg(VPIDR_EL2, ctx->vpidr_el2);
+	arm_read_sysreg(CPTR_EL2, ctx->cptr_el2);
+	arm_read_sysreg(MDCR_EL2, ctx->mdcr_el2);
+	arm_read_sysreg(CNTHCTL_EL2, ctx->cnthctl_el2);
+	arm_read_sysreg(CNTVOFF_EL2, ctx->cntvoff_el2);
+	arm_read_sysreg(CNTHP_CTL_EL2, ctx->cnthp_ctl_el2);
+	arm_read_sysreg(CNTHP_CVAL_EL2, ctx->cnthp_cval_el2);
+
+	pmu_cpu_save(&ctx->pmu);
+}
+
+static void idle_restore(const struct idle_context *ctx)
+{
+	/* vectors first, anything else may fault */
+	arm_write_sysreg(VBAR_EL2, ctx->vbar_el2);
+	arm_write_sysreg(HCR_EL2, ctx->hcr_el2);
+	arm_write_sysreg(VTCR_EL2, ctx->vtcr_el2);
+	arm_write_sysreg(VTTBR_EL2, ctx->vttbr_el2);
+	arm_write_sysreg(VMPIDR_EL2, ctx->vmpidr_el2);
+	arm_write_sysreg(VPIDR_EL2, ctx->vpidr_el2);
+	arm_write_sysreg(CPTR_EL2, ctx->cptr_el2);
+	arm_write_sysreg(MDCR_EL2, ctx->mdcr_el2);
+	arm_write_sysreg(CNTHCTL_EL2, ctx->cnthctl_el2);
+	arm_write_sysreg(CNTVOFF_EL2, ctx->cntvoff_el2);
+	isb();
+
+	irqchip_cpu_restore(&ctx->gic);
+	pmu_cpu_restore(&ctx->pmu);
+
+	arm_write_sysreg(CNTHP_CVAL_EL2, ctx->cnthp_cval_el2);
+	arm_write_sysreg(CNTHP_CTL_EL2, ctx->cnthp_ctl_el2);
+	isb();
+}
+
+bool arm_cpu_idle(const struct jailhouse_idle_state *state,
+		  unsigned long entry, unsigned long context, long *result)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	struct idle_context *ctx = &cpu_data->idle_context;
+	long ret;
+
+	/* with SDEI, the firmware owns the interrupts while the CPU waits */
+	if (sdei_available || !idle_state_fits(state))
+		return false;
+
+	if (!(state->flags & JAILHOUSE_IDLE_POWERDOWN)) {
+		ret = smc_arg1(PSCI_0_2_FN64_CPU_SUSPEND, state->power_state);
+		/* a rejected state is waited for in the hypervisor instead */
+		return ret == PSCI_SUCCESS;
+	}
+
+	/*
+	 * The DSU counters of cluster regulation are not saved, the cluster
+	 * may power down with its last CPU.
+	 */
+	if (cpu_data->public.memguard.cluster || !irqchip_cpu_save(&ctx->gic))
+		return false;
+
+	idle_save(ctx);
+	ctx->ttbr0 = paging_hvirt2phys(cpu_data->pg_structs.root_table);
+	ctx->self = ctx;
+
+	if (arm_idle_save_context(ctx)) {
+		/* arm_idle_resume reads the context with the MMU off */
+		arch_paging_flush_cpu_caches(ctx, sizeof(*ctx));
+
+		ret = smc_arg4(PSCI_0_2_FN64_CPU_SUSPEND, state->power_state,
+			       paging_hvirt2phys(arm_idle_resume),
+			       paging_hvirt2phys(&per_cpu(this_cpu_id())->
+						 idle_context), 0);
+		/*
+		 * Back without a power-down, e.g. on a pending wake-up event:
+		 * the context of the CPU and of the cell is intact.
+		 */
+		return ret == PSCI_SUCCESS;
+	}
+
+	/* resumed from the power-down via arm_idle_resume */
+	idle_restore(ctx);
+
+	/* enter the cell with its MMU off, handle_smc skips the SMC */
+	arm_write_sysreg(SCTLR_EL1, SCTLR_EL1_RES1);
+	arm_write_sysreg(SPSR_EL2, RESET_PSR_AARCH64);
+	arm_write_sysreg(ELR_EL2, entry - 4);
+	*result = context;
+
+	return true;
+}
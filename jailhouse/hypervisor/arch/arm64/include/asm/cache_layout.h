@@ -36,6 +36,9 @@ static inline void arm_inval_icache(void)
 #ifdef CONFIG_DEBUG
 #define verb_print(fmt, ...)			\
 	printk("[COL] " fmt, ##__VA_ARGS__)
+#else
+#define verb_print(fmt, ...) do { } while (0)
+#endif
 
 #define MAX_CACHE_LEVEL		7
 
@@ -63,8 +66,20 @@ extern u64 arm_cache_layout_detect(void);
 
 extern cache_t cache[];
 
+/** Last level cache found by arm_cache_layout_detect, NULL if none */
+extern const cache_t *cache_llc;
+
+/**
+ * Clean + invalidate (or only clean if \a clean) the sets [first,
+ * first + num) in all the ways of the x-cache level.
+ *
+ * Set/way maintenance only reaches the caches of the executing CPU and the
+ * ones it shares, not the private caches of the others.
+ */
+void arm_dcache_setway_range(unsigned int level, u32 first, u32 num,
+			     bool clean);
+
 /** Perform a per-way clean + invalidate (flush) on the x-cache level. */
 void arm_flush_dcache_lx_per_way(unsigned int level);
-#endif
 
 #endif
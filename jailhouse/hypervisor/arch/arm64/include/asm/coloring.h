@@ -25,7 +25,7 @@
 
 #ifdef CONFIG_DEBUG
 #define col_print(fmt, ...)			\
-	printk("[COL] " fmt, ##__VA_ARGS__)
+	printk_deferred("[COL] " fmt, ##__VA_ARGS__)
 #else
 #define col_print(fmt, ...) do { } while (0)
 #endif
@@ -78,13 +78,54 @@ extern int color_do_op(struct color_op *op);
  * colored range. During shutdown (\a init == false) the memory is copied
  * back into a non-colored (contiguous) PA range.
  *
- * This is done by first establishing a VA-contiguous PA-colored mapping
- * via the COL_OP_ROOT_MAP operation.
- * The copy is performed backward at init time, and forward at destroy time.
- * The temporary mapping is destroyed via the COL_OP_ROOT_UNMAP operation.
+ * The copy is performed backward at init time, and forward at destroy time,
+ * in waves of pages that do not overlap their copies. All the root cell
+ * CPUs copy chunks of the current wave through their temporary mapping
+ * window, see parallel_run.
  */
 extern int color_copy_root(struct cell *root, bool init);
 
+/**
+ * Move the colored memory regions of the suspended \a cell to the colors
+ * \a colors and remap them.
+ *
+ * The pages of each region keep their order and are moved in place within
+ * the memory the region occupied when the cell was created, so the new colors
+ * must not extend past it.
+ */
+extern int color_cell_recolor(struct cell *cell, u64 colors);
+
+/** Release the recoloring state of \a cell */
+extern void color_cell_exit(struct cell *cell);
+
+/**
+ * Detected last level cache geometry and coloring way size for
+ * JAILHOUSE_HC_HYPERVISOR_GET_INFO, -EINVAL for other info types.
+ */
+extern long color_get_info(unsigned long type);
+
+/**
+ * Flush the colors \a color_mask by set/way instead of a walk over the \a size
+ * bytes they hold, if that is cheaper. The other suspended CPUs flush their
+ * private caches via color_dcache_setway_help.
+ *
+ * @return true if the flush was done.
+ */
+extern bool color_dcache_flush_setway(unsigned long size, u64 color_mask,
+				      enum dcache_flush flush_type);
+
+/** Serve a set/way flush requested while this CPU is suspended */
+extern void color_dcache_setway_help(void);
+
+/**
+ * Map the part [offs, offs + size) of the colored region \a mem, as seen by
+ * the cell, i.e. from the virtual start of the region.
+ */
+extern int color_paging_create_part(const struct paging_structures *pg_structs,
+				    const struct jailhouse_memory *mem,
+				    unsigned long offs, unsigned long size,
+				    unsigned long access_flags,
+				    unsigned long paging_flags);
 
 static inline void arm_color_dcache_flush_memory_region(
 	unsigned long phys,
@@ -97,6 +138,9 @@ static inline void arm_color_dcache_flush_memory_region(
 
 	assert(coloring_way_size != 0);
 
+	if (color_dcache_flush_setway(size, color_mask, flush_type))
+		return;
+
 	op.phys = phys;
 	op.size = size;
 	op.virt = virt;
@@ -112,17 +156,27 @@ static inline void arm_color_dcache_flush_memory_region(
  */
 static inline void arm_color_init(void)
 {
+	/* the geometry is also published via JAILHOUSE_HC_HYPERVISOR_GET_INFO */
+	u64 llc_way_size __attribute__((unused)) = arm_cache_layout_detect();
+
 	coloring_way_size = system_config->platform_info.color.way_size;
 #ifdef CONFIG_DEBUG
 	if (coloring_way_size == 0) {
-		coloring_way_size = arm_cache_layout_detect();
+		coloring_way_size = llc_way_size;
 	}
 #endif
 	coloring_root_map_offset =
 		system_config->platform_info.color.root_map_offset;
 
-	printk("Init Coloring: Way size: 0x%llx, TMP load addr: 0x%llx\n",
-	       coloring_way_size, coloring_root_map_offset);
+	/* from now on, the hypervisor allocates from its own colors */
+	if (coloring_way_size != 0) {
+		mem_pool.way_pages = coloring_way_size / PAGE_SIZE;
+		mem_pool.colors = system_config->platform_info.color.hv_colors;
+	}
+
+	printk("Init Coloring: Way size: 0x%llx, TMP load addr: 0x%llx, "
+	       "HV colors: 0x%llx\n", coloring_way_size,
+	       coloring_root_map_offset, mem_pool.colors);
 }
 
 /**
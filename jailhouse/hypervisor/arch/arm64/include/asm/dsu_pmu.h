@@ -0,0 +1,161 @@
+/*
+ * DSU (cluster) PMU support for Memguard for Jailhouse ARM64
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * Register layout as in arch/arm64/include/asm/arm_dsu_pmu.h in Linux.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#ifndef _ARM64_DSU_PMU_H
+#define _ARM64_DSU_PMU_H
+
+#include <jailhouse/types.h>
+#include <jailhouse/printk.h>
+#include <asm/sysregs.h>
+#include <asm/processor.h>
+
+/*
+ * Cluster PMU registers, shared by all the cores of a DSU cluster.
+ * EL2 access requires ACTLR_EL3.CLUSTERPMUEN set by the firmware.
+ */
+#define CLUSTERPMCR_EL1		SYSREG_32(0, c15, c5, 0)
+#define CLUSTERPMCNTENSET_EL1	SYSREG_32(0, c15, c5, 1)
+#define CLUSTERPMCNTENCLR_EL1	SYSREG_32(0, c15, c5, 2)
+#define CLUSTERPMOVSSET_EL1	SYSREG_32(0, c15, c5, 3)
+#define CLUSTERPMOVSCLR_EL1	SYSREG_32(0, c15, c5, 4)
+#define CLUSTERPMSELR_EL1	SYSREG_32(0, c15, c5, 5)
+#define CLUSTERPMINTENSET_EL1	SYSREG_32(0, c15, c5, 6)
+#define CLUSTERPMINTENCLR_EL1	SYSREG_32(0, c15, c5, 7)
+#define CLUSTERPMXEVTYPER_EL1	SYSREG_32(0, c15, c6, 1)
+#define CLUSTERPMXEVCNTR_EL1	SYSREG_32(0, c15, c6, 2)
+
+#define CLUSTERPMCR_E		(1 << 0) /* Enable all counters */
+#define CLUSTERPMCR_N_SHIFT	11	 /* Number of counters supported */
+#define CLUSTERPMCR_N_MASK	0x1f
+
+/*
+ * DSU events (same numbering as the PMUv3 common events)
+ */
+#define DSU_PMU_EVT_BUS_ACCESS		0x19
+#define DSU_PMU_EVT_L3D_CACHE		0x2b
+#define DSU_PMU_EVT_L3D_CACHE_REFILL	0x2a
+#define DSU_PMU_EVT_MEMORY_ERROR	0x1a
+
+/* Cores are identified by Aff1 when MT is set, the cluster by the next level */
+#define MPIDR_MT_BIT		(1 << 24)
+
+#ifdef CONFIG_DEBUG
+#define dsu_print(fmt, ...)			\
+	printk("[DSU] " fmt, ##__VA_ARGS__)
+#else
+#define dsu_print(fmt, ...) do { } while (0)
+#endif
+
+static inline u32 dsu_get_num_cnt(void)
+{
+	u32 pmcr;
+	arm_read_sysreg(CLUSTERPMCR_EL1, pmcr);
+	return (pmcr >> CLUSTERPMCR_N_SHIFT) & CLUSTERPMCR_N_MASK;
+}
+
+static inline void dsu_enable_all(void)
+{
+	u32 pmcr;
+	arm_read_sysreg(CLUSTERPMCR_EL1, pmcr);
+	arm_write_sysreg(CLUSTERPMCR_EL1, pmcr | CLUSTERPMCR_E);
+}
+
+static inline void dsu_disable(u32 idx)
+{
+	arm_write_sysreg(CLUSTERPMCNTENCLR_EL1, (1 << idx));
+}
+
+static inline void dsu_enable(u32 idx)
+{
+	arm_write_sysreg(CLUSTERPMCNTENSET_EL1, (1 << idx));
+}
+
+static inline void dsu_int_disable(u32 idx)
+{
+	arm_write_sysreg(CLUSTERPMINTENCLR_EL1, (1 << idx));
+}
+
+static inline void dsu_int_enable(u32 idx)
+{
+	arm_write_sysreg(CLUSTERPMINTENSET_EL1, (1 << idx));
+}
+
+static inline void dsu_clear_overflow(u32 idx)
+{
+	arm_write_sysreg(CLUSTERPMOVSCLR_EL1, (1 << idx));
+}
+
+/** Get the overflow status bitmap of all cluster counters */
+static inline u32 dsu_get_overflow(void)
+{
+	u32 ovs;
+	arm_read_sysreg(CLUSTERPMOVSCLR_EL1, ovs);
+	return ovs;
+}
+
+static inline u32 dsu_get_val(u32 idx)
+{
+	u32 val;
+	arm_write_sysreg(CLUSTERPMSELR_EL1, idx);
+	isb();
+	arm_read_sysreg(CLUSTERPMXEVCNTR_EL1, val);
+	return val;
+}
+
+static inline void dsu_set_val(u32 idx, u32 val)
+{
+	arm_write_sysreg(CLUSTERPMSELR_EL1, idx);
+	isb();
+	arm_write_sysreg(CLUSTERPMXEVCNTR_EL1, val);
+}
+
+static inline void dsu_set_type(u32 idx, u32 type)
+{
+	arm_write_sysreg(CLUSTERPMSELR_EL1, idx);
+	isb();
+	arm_write_sysreg(CLUSTERPMXEVTYPER_EL1, type);
+}
+
+/** DSU cluster of a CPU, derived from its MPIDR */
+static inline unsigned int dsu_cluster_of(unsigned long mpidr)
+{
+	return MPIDR_AFFINITY_LEVEL(mpidr, (mpidr & MPIDR_MT_BIT) ? 2 : 1);
+}
+
+/* ----------------------- FUNCTION DECLARATION ---------------------------- */
+/** Check if \a irqno is the overflow interrupt of a DSU cluster */
+extern bool irq_is_dsu(u32 irqno);
+
+/** ISR handler */
+extern bool dsu_isr_handler(void);
+
+/**
+ * Register the handler to be called upon DSU overflow IRQ and reserve
+ * the topmost JAILHOUSE_DSU_HYP_COUNTERS cluster counters.
+ *
+ * @returns
+ *	- the first counter to be used by the caller
+ *	- -ENODEV if no DSU interrupt is configured
+ */
+extern int dsu_register(bool (*handler)(void));
+
+/**
+ * Add \a delta events to the published count of the hypervisor counter
+ * \a cnt of \a cluster, which now counts \a event (0: stopped).
+ */
+extern void dsu_count(unsigned int cluster, unsigned int cnt, u32 event,
+		      u32 delta);
+
+/** Route the overflow IRQ of \a cluster to this CPU and enable it */
+extern void dsu_claim(unsigned int cluster);
+/** Disable the overflow IRQ of \a cluster */
+extern void dsu_release(unsigned int cluster);
+
+#endif
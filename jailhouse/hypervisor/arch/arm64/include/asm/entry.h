@@ -22,3 +22,9 @@ void __attribute__((noreturn)) shutdown_el2(struct per_cpu *cpu_data);
 void __attribute__((noreturn)) vmreturn(union registers *guest_regs);
 
 void sdei_handler(void *param);
+
+struct idle_context;
+
+int __attribute__((returns_twice))
+arm_idle_save_context(struct idle_context *ctx);
+void arm_idle_resume(void);
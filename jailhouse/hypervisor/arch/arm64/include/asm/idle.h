@@ -0,0 +1,56 @@
+/*
+ * Idle states of the firmware for Jailhouse ARM64
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#ifndef _ARM64_IDLE_H
+#define _ARM64_IDLE_H
+
+#include <jailhouse/types.h>
+#include <asm/irqchip.h>
+
+/* Event counters of the PMU, without the cycle counter */
+#define IDLE_PMU_MAX_COUNTERS	31
+
+/** PMU state of the hypervisor, see pmu_cpu_save() */
+struct pmu_cpu_state {
+	u32 pmcr;
+	u32 cntenset;
+	u32 intenset;
+	u32 type[IDLE_PMU_MAX_COUNTERS];
+	u32 val[IDLE_PMU_MAX_COUNTERS];
+};
+
+/**
+ * CPU state lost in a power-down idle state, see arm_cpu_idle(). entry.S
+ * accesses the registers at fixed offsets, they come first.
+ */
+struct idle_context {
+	/** x19-x30 and sp of arm_idle_save_context() */
+	unsigned long regs[13];
+	/** Physical address of the page tables of the CPU */
+	unsigned long ttbr0;
+	/** Virtual address of this context */
+	struct idle_context *self;
+
+	u64 vbar_el2;
+	u64 hcr_el2;
+	u64 vtcr_el2;
+	u64 vttbr_el2;
+	u64 vmpidr_el2;
+	u64 vpidr_el2;
+	u64 cptr_el2;
+	u64 mdcr_el2;
+	u64 cnthctl_el2;
+	u64 cntvoff_el2;
+	u64 cnthp_ctl_el2;
+	u64 cnthp_cval_el2;
+
+	struct irqchip_cpu_state gic;
+	struct pmu_cpu_state pmu;
+};
+
+#endif
@@ -58,6 +58,10 @@
 #define PTE_FLAG_TERMINAL	(0x1 << 1)
 #define PTE_FLAG_VALID		(0x1 << 0)
 
+/* Upper attributes: contiguous hint, valid for naturally aligned blocks */
+#define PTE_FLAG_CONT		(1UL << 52)
+#define PTE_CONT_ENTRIES	16
+
 /* These bits differ in stage 1 and 2 translations */
 #define S1_PTE_NG		(0x1 << 11)
 #define S1_PTE_ACCESS_RW	(0x0 << 7)
@@ -132,6 +136,7 @@
 /* Stage 2 memory attributes (MemAttr[3:0]) */
 #define S2_MEMATTR_OWBIWB	0xf
 #define S2_MEMATTR_DEV		0x1
+#define S2_MEMATTR_NC		0x5
 
 #define S1_PTE_FLAG_NORMAL	PTE_MEMATTR(MAIR_IDX_WBRAWA)
 #define S1_PTE_FLAG_DEVICE	PTE_MEMATTR(MAIR_IDX_DEV)
@@ -139,6 +144,7 @@
 
 #define S2_PTE_FLAG_NORMAL	PTE_MEMATTR(S2_MEMATTR_OWBIWB)
 #define S2_PTE_FLAG_DEVICE	PTE_MEMATTR(S2_MEMATTR_DEV)
+#define S2_PTE_FLAG_NONCACHED	PTE_MEMATTR(S2_MEMATTR_NC)
 
 #define S1_DEFAULT_FLAGS	(PTE_FLAG_VALID | PTE_ACCESS_FLAG	\
 				| S1_PTE_FLAG_NORMAL | PTE_INNER_SHAREABLE\
@@ -200,9 +206,17 @@ unsigned int get_cpu_parange(void);
 
 int arm_paging_cell_init(struct cell *cell);
 void arm_paging_cell_destroy(struct cell *cell);
+bool arm_paging_cell_lazy_fault(unsigned long ipa);
+void arm_paging_cell_consolidate(struct cell *cell);
+void arm_paging_cell_unmapped(struct cell *cell, unsigned long start,
+			      unsigned long size);
+void arm_paging_cell_flush_tlbs(struct cell *cell);
 
 void arm_paging_vcpu_init(struct paging_structures *pg_structs);
 
+/* Page copy with non-temporal stores, see copy_page.S */
+void copy_page(void *dst, const void *src);
+
 static inline void arm_paging_vcpu_flush_tlbs(void)
 {
 	/*
@@ -212,6 +226,32 @@ static inline void arm_paging_vcpu_flush_tlbs(void)
 	asm volatile("tlbi vmalls12e1is");
 }
 
+/* Same as arm_paging_vcpu_flush_tlbs, limited to the calling CPU */
+static inline void arm_paging_vcpu_flush_local_tlbs(void)
+{
+	asm volatile("tlbi vmalls12e1");
+}
+
+/*
+ * Invalidate the stage-2 entries for an IPA of the current VMID on all CPUs.
+ * Entries combining both stages are only dropped by
+ * arm_paging_vcpu_flush_s1_tlbs.
+ */
+static inline void arm_paging_vcpu_flush_ipa_tlb(unsigned long ipa)
+{
+	asm volatile("tlbi ipas2e1is, %0" : : "r" (ipa >> 12));
+}
+
+static inline void arm_paging_vcpu_flush_s1_tlbs(void)
+{
+	asm volatile(
+		"dsb ish\n\t"
+		"tlbi vmalle1is\n\t"
+		"dsb ish\n\t"
+		"isb\n\t"
+		: : : "memory");
+}
+
 /* Only executed on hypervisor paging struct changes */
 static inline void arch_paging_flush_page_tlbs(unsigned long page_addr)
 {
@@ -223,6 +263,28 @@ static inline void arch_paging_flush_page_tlbs(unsigned long page_addr)
 		: : "r" (page_addr >> PAGE_SHIFT));
 }
 
+/* Only executed on hypervisor paging struct changes spanning many pages */
+static inline void arch_paging_flush_all_tlbs(void)
+{
+	asm volatile(
+		"dsb ish\n\t"
+		"tlbi alle2\n\t"
+		"dsb ish\n\t"
+		"isb\n\t"
+		: : : "memory");
+}
+
+/* Executed before releasing page tables of cell paging structures */
+static inline void arch_paging_flush_guest_tlbs(void)
+{
+	asm volatile(
+		"dsb ish\n\t"
+		"tlbi alle1is\n\t"
+		"dsb ish\n\t"
+		"isb\n\t"
+		: : : "memory");
+}
+
 /* Used to clean the PAGE_MAP_COHERENT page table changes */
 static inline void arch_paging_flush_cpu_caches(void *addr, long size)
 {
@@ -10,7 +10,57 @@
  * the COPYING file in the top-level directory.
  */
 
+#include <jailhouse/hypercall.h>
+#include <asm/idle.h>
+#include <asm/sched.h>
+#include <asm/timer_event.h>
+
 #define ARCH_PERCPU_FIELDS						\
 	ARM_PERCPU_FIELDS						\
 	unsigned long id_aa64mmfr0;					\
-	bool sdei_event;
+	bool sdei_event;						\
+									\
+	/** Armed hypervisor timer events, earliest first. */		\
+	struct timer_event *timer_queue;				\
+	/** Memguard regulation period. */				\
+	struct timer_event memguard_timer;				\
+	/** End of the IRQ coalescing window. */			\
+	struct timer_event coalesce_timer;				\
+	/** Period boundary of a coordinated mode switch. */		\
+	struct timer_event mode_switch_timer;				\
+	/** End of the window of a time-shared CPU. */			\
+	struct timer_event sched_timer;					\
+	/** Background drain of the virtual console to the UART. */	\
+	struct timer_event console_drain_timer;				\
+									\
+	/** Saved across power-down idle states, see idle.c. */	\
+	struct idle_context idle_context;				\
+									\
+	/** Events per sample in use, 0 while sampling is off. */	\
+	u32 perf_sample_period;						\
+									\
+	/** Ticks in the hypervisor per trap class and IRQ type. */	\
+	u64 exit_ticks[(JAILHOUSE_NUM_CPU_STATS) -			\
+		       (JAILHOUSE_CPU_STAT_TRAP_US_HVC)];
+
+#define ARCH_PUBLIC_PERCPU_FIELDS					\
+	ARM_PUBLIC_PERCPU_FIELDS					\
+									\
+	/*								\
+	 * vCPU state of cell snapshots, see snapshot.c. Public as the	\
+	 * management CPU accesses it.					\
+	 */								\
+	struct jailhouse_vcpu_state vcpu_state;				\
+	/** Set by the management CPU to request saving vcpu_state. */ \
+	volatile bool save_vcpu_state;					\
+	/** Load vcpu_state instead of the reset state on next reset. */ \
+	bool restore_vcpu_state;					\
+									\
+	/** PMU sampling configuration queued by perf_set. */		\
+	u32 perf_event;							\
+	u32 perf_period;						\
+	/** Set (under control_lock) when perf_* has to be applied. */ \
+	volatile bool perf_update;					\
+									\
+	/** vCPUs of a time-shared CPU, see sched.c. */		\
+	struct sched_cpu sched;
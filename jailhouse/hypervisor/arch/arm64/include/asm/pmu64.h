@@ -34,6 +34,15 @@
 #define	PMCR_N_MASK	0x1f
 #define	PMCR_MASK	0xff	 /* Mask for writable bits */
 
+/*
+ * PMEVTYPER<n>_EL0: event filtering
+ */
+#define PMEVTYPER_P		(1U << 31) /* Don't count at EL1 */
+#define PMEVTYPER_U		(1 << 30) /* Don't count at EL0 */
+#define PMEVTYPER_NSK		(1 << 29) /* Non-secure EL1 inverts P */
+#define PMEVTYPER_NSU		(1 << 28) /* Non-secure EL0 inverts U */
+#define PMEVTYPER_NSH		(1 << 27) /* Count at EL2 */
+
 /* Reg def copied from kvm_arm.h */
 /* Hyp Debug Configuration Register bits */
 #define MDCR_EL2_TDRA		(1 << 11)
@@ -47,7 +56,7 @@
 
 #ifdef CONFIG_DEBUG
 #define pmu_print(fmt, ...)			\
-	printk("[PMU] " fmt, ##__VA_ARGS__)
+	printk_deferred("[PMU] " fmt, ##__VA_ARGS__)
 #else
 #define pmu_print(fmt, ...) do { } while (0)
 #endif
@@ -87,6 +96,14 @@ static inline void pmu_clear_overflow(u32 idx)
 	arm_write_sysreg(PMOVSCLR_EL0, (1 << idx));
 }
 
+/** Get the overflow status bitmap of all counters */
+static inline u32 pmu_get_overflow(void)
+{
+	u32 ovs;
+	arm_read_sysreg(PMOVSCLR_EL0, ovs);
+	return ovs;
+}
+
 /** Get counter value for PMCNT[idx] */
 static inline u32 pmu_get_val(u32 idx)
 {
@@ -158,17 +175,23 @@ static inline void pmu_cpu_reset(void)
 extern void pmu_cpu_init(void);
 extern void pmu_cpu_shutdown(void);
 
+/** State of the EL2 counters across power-down idle states */
+struct pmu_cpu_state;
+extern void pmu_cpu_save(struct pmu_cpu_state *state);
+extern void pmu_cpu_restore(const struct pmu_cpu_state *state);
+
 /** ISR handler */
 extern bool pmu_isr_handler(void);
 
 /**
  * Register the handler to be called upon PMU overflow iRQ.
  * Check availability for requested counters \a req_cnt and
- * store the fist counter that will be (currently) used
- * by default.
+ * reserve them to EL2. The handler is only called when one of these
+ * counters overflowed.
  *
  * @returns
- * 	- first (and currently only) counter to be used by the caller
+ * 	- first counter to be used by the caller, the \a req_cnt counters
+ * 	  are contiguous starting from it
  */
 extern int pmu_register(u32 req_cnt, bool (*handler)(void));
 
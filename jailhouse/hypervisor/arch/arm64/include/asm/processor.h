@@ -14,6 +14,7 @@
 #define _JAILHOUSE_ASM_PROCESSOR_H
 
 #include <jailhouse/types.h>
+#include <asm/sysregs.h>
 
 /* also include from arm-common */
 #include_next <asm/processor.h>
@@ -74,6 +75,50 @@ static inline void arm_irq_restore(unsigned long flags)
 	asm volatile("msr daif, %0" : : "r"(flags) : "memory");
 }
 
+/** Free-running timestamp for profiling, in generic timer ticks */
+static inline u64 cpu_timestamp(void)
+{
+	u64 pct;
+
+	arm_read_sysreg(CNTPCT_EL0, pct);
+	return pct;
+}
+
+/* event stream while waiting: bit 9 of the counter, 32 us at 31.25 MHz */
+#define CPU_WAIT_EVNTI		9
+
+/**
+ * Waits while the aligned 32-bit word at addr may still hold old, without
+ * spinning. Stores of other CPUs to the location clear the exclusive monitor
+ * and wake the WFE, the timer event stream bounds the sleep. Callers have to
+ * recheck the word.
+ */
+static inline void cpu_wait_for_change(volatile void *addr, u32 old)
+{
+	unsigned long cnthctl;
+	u32 tmp;
+
+	arm_read_sysreg(CNTHCTL_EL2, cnthctl);
+	arm_write_sysreg(CNTHCTL_EL2, (cnthctl & ~CNTHCTL_EVNTI_MASK) |
+			 CNTHCTL_EVNTEN |
+			 (CPU_WAIT_EVNTI << CNTHCTL_EVNTI_SHIFT));
+	isb();
+
+	asm volatile(
+		"	sevl\n"
+		"	wfe\n"
+		"	ldxr	%w[tmp], %[v]\n"
+		"	eor	%w[tmp], %w[tmp], %w[old]\n"
+		"	cbnz	%w[tmp], 1f\n"
+		"	wfe\n"
+		"1:"
+		: [tmp] "=&r" (tmp), [v] "+Q" (*(volatile u32 *)addr)
+		: [old] "r" (old)
+		: "memory");
+
+	arm_write_sysreg(CNTHCTL_EL2, cnthctl);
+}
+
 #endif /* !__ASSEMBLY__ */
 
 #endif /* !_JAILHOUSE_ASM_PROCESSOR_H */
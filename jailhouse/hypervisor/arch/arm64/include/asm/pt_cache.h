@@ -0,0 +1,39 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_ASM_PT_CACHE_H
+#define _JAILHOUSE_ASM_PT_CACHE_H
+
+#include <jailhouse/paging.h>
+
+struct per_cpu;
+
+/**
+ * Install the page-table image handed over by the driver as stage-2 tables
+ * of the root cell, see jailhouse/pt-cache.h. An image that does not match
+ * the hypervisor and the system configuration is discarded.
+ *
+ * @param pg_structs	Paging structures of the root cell, with an empty
+ *			root table.
+ *
+ * @return 0 if the tables were installed, -ENOENT if there was no image,
+ *	   another negative error code if the image was discarded.
+ */
+int pt_cache_install(struct paging_structures *pg_structs);
+
+/**
+ * Handle JAILHOUSE_HC_PT_CACHE: export the stage-2 tables of the root cell
+ * into the hypervisor memory, or release the exported image.
+ *
+ * @return Offset of the image in the hypervisor memory on export, 0 on
+ *	   release, negative error code otherwise.
+ */
+long pt_cache_call(struct per_cpu *cpu_data, unsigned long op);
+
+#endif /* !_JAILHOUSE_ASM_PT_CACHE_H */
@@ -0,0 +1,58 @@
+/*
+ * ARM QoS Support for Jailhouse. Definitions for the Tegra234 memory
+ * controller.
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ * See the COPYING file in the top-level directory.
+ */
+#ifndef _JAILHOUSE_ARM64_QOS_TEGRA234_H
+#define _JAILHOUSE_ARM64_QOS_TEGRA234_H
+
+/*
+ * With JAILHOUSE_QOS_TEGRA234_MC, platform_info.qos.nic_base/nic_size
+ * describe the MC register block (broadcast aperture) and every QoS device
+ * of the root cell config is one of the following, selected by its flags:
+ *
+ * MC_QOS_LA:   memory client pair, base = its MC_LATENCY_ALLOWANCE_* register
+ *              la_read     = [10:0]
+ *              la_write    = [26:16]
+ * MC_QOS_PTSA: PTSA group, base = its MC_*_PTSA_RATE register
+ *              ptsa_rate   = base        [11:0]
+ *              ptsa_min    = base + 0x04 [6:0]
+ *              ptsa_max    = base + 0x08 [6:0]
+ * MC_QOS_RING: arbitration ring, base = its MC_EMEM_ARB_RING*_THROTTLE
+ *              register
+ *              throttle_low  = [4:0]
+ *              throttle_high = [20:16]
+ *
+ * Names are free, e.g. "gpu", "dla0" or "eqos" for the clients of a cell.
+ * Arbitration registers are shadowed and only take effect after an update
+ * through MC_TIMING_CONTROL, which the backend triggers once per call.
+ */
+
+#define MC_QOS_LA		(1 << 0)
+#define MC_QOS_PTSA		(1 << 1)
+#define MC_QOS_RING		(1 << 2)
+
+#define MC_TIMING_CONTROL	0xfc
+#define  MC_TIMING_UPDATE	(1 << 0)
+
+#define MC_LA_READ_SHIFT	(0)
+#define MC_LA_WRITE_SHIFT	(16)
+#define MC_LA_MASK		(0x7ff)
+
+#define MC_PTSA_RATE		0x00
+#define MC_PTSA_MIN		0x04
+#define MC_PTSA_MAX		0x08
+#define MC_PTSA_RATE_MASK	(0xfff)
+#define MC_PTSA_MINMAX_MASK	(0x7f)
+/* Registers of a PTSA group saved for "qos disable" */
+#define MC_PTSA_REGS		3
+
+#define MC_RING_LOW_SHIFT	(0)
+#define MC_RING_HIGH_SHIFT	(16)
+#define MC_RING_MASK		(0x1f)
+
+#endif
@@ -16,16 +16,55 @@
 #include <jailhouse/string.h>
 #include <jailhouse/qos-common.h>
 
+struct jailhouse_qos_device;
+
 /* QOS parameter declarations */
 struct qos_param {
 	char name [QOS_PARAM_NAMELEN];
 	__u16 reg;
+	/* QoS-400: QOS_CNTL enable bit, Tegra MC: required device flag */
 	__u8 enable;
 	__u8 shift;
 	__u32 mask;
 };
 
+/* Read-modify-write of one backend register, see qos_add_write() */
+struct qos_reg_write {
+	/* From the start of the backend register block */
+	u32 offset;
+	/* Bits replaced by value, ~0 writes without reading first */
+	u32 mask;
+	u32 value;
+};
+
+/* QoS register backend, selected by platform_info.qos.type */
+struct qos_backend {
+	/* Map the registers, called once before the first request */
+	int (*init)(void);
+	/* Validate all settings and translate them into at most max
+	 * register writes, returns their number or a negative error */
+	int (*compile)(const struct qos_setting *settings, unsigned long count,
+		       struct qos_reg_write *writes, unsigned int max);
+	/* Perform compiled writes, must not fail */
+	void (*write)(const struct qos_reg_write *writes, unsigned int num);
+	/* Return all regulators to their state before Jailhouse */
+	int (*disable)(void);
+};
+
+extern const struct qos_backend qos400_backend;
+extern const struct qos_backend tegra234_mc_backend;
+
+const struct jailhouse_qos_device *qos_dev_find_by_name(const char *name);
+int qos_add_write(struct qos_reg_write *writes, unsigned int *num,
+		  unsigned int max, u32 offset, u32 mask, u32 value);
+const struct qos_param *qos_param_find_by_name(const struct qos_param *table,
+					       unsigned int num,
+					       const char *name);
+
 /* Main entry point for QoS management call */
 extern int qos_call(unsigned long count, unsigned long settings_ptr);
+int qos_profile_set(unsigned long args_ptr);
+int qos_profile_apply(unsigned long id);
+int qos_profile_check(unsigned long id);
 
 #endif /* _JAILHOUSE_ASM_QOS_H  */
@@ -0,0 +1,126 @@
+/*
+ * Time-shared CPUs for Jailhouse ARM64
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#ifndef _ARM64_SCHED_H
+#define _ARM64_SCHED_H
+
+#include <jailhouse/hypercall.h>
+#include <asm/irqchip.h>
+
+struct cell;
+struct public_per_cpu;
+
+/**
+ * Context of a cell on a time-shared CPU. The control fields mirror those of
+ * public_per_cpu, which hold the state of the running vCPU.
+ */
+struct sched_vcpu {
+	/** Cell of the vCPU, NULL if the slot is unused. */
+	struct cell *cell;
+
+	bool wait_for_poweron;
+	bool reset;
+	bool park;
+	bool flush_vcpu_caches;
+	unsigned long cpu_on_entry;
+	unsigned long cpu_on_context;
+
+	/** True once regs and gic hold the state of a switched-out vCPU. */
+	bool saved;
+	struct jailhouse_vcpu_state regs;
+	struct irqchip_cpu_state gic;
+	u16 lr_irq[16];
+	unsigned long lr_shadow;
+	unsigned long lr_irq_bitmap[1024 / BITS_PER_LONG];
+	/** Interrupts raised while the vCPU was switched out. */
+	unsigned long deferred[1024 / BITS_PER_LONG];
+};
+
+/** Windows of a schedule, as vCPU index and length in counter ticks. */
+struct sched_table {
+	unsigned int num_slots;
+	u8 vcpu[JAILHOUSE_SCHED_MAX_SLOTS];
+	u64 ticks[JAILHOUSE_SCHED_MAX_SLOTS];
+};
+
+/**
+ * Schedule of a CPU running two cells, protected by the control_lock of the
+ * CPU. Only the CPU itself switches its vCPUs, at the end of an exit.
+ */
+struct sched_cpu {
+	struct sched_vcpu vcpu[2];
+	/** Both vCPUs are in use. */
+	volatile bool shared;
+	/** vCPU loaded into the CPU, with its control fields in public. */
+	unsigned int running;
+	/** vCPU to run after the next switch point. */
+	unsigned int next;
+	/** Set when next differs from running. */
+	volatile bool switch_pending;
+	/** Cell whose pending control requests the CPU processes next. */
+	struct cell *selected;
+
+	/** Schedule in use, only accessed by the CPU itself. */
+	struct sched_table table;
+	unsigned int slot;
+	/** End of the current window in counter ticks. */
+	u64 slot_end;
+	/** Schedule to apply by the CPU when update is set. */
+	struct sched_table staged;
+	volatile bool update;
+};
+
+/** Switches the vCPU if pending. Called right before returning to a cell. */
+void sched_cpu_switch(void);
+
+static inline void sched_switch_point(struct sched_cpu *sched)
+{
+	if (sched->switch_pending)
+		sched_cpu_switch();
+}
+
+/** Applies schedule changes, called by the CPU under its control_lock. */
+void sched_cpu_update(void);
+
+/**
+ * Moves the control requests made for a switched-out vCPU while the CPU was
+ * suspended to its context. Called under the control_lock.
+ */
+void sched_take_requests(struct public_per_cpu *cpu_public);
+
+/** True if the CPU runs two cells. */
+#define sched_cpu_shared(cpu_id)	(public_per_cpu(cpu_id)->sched.shared)
+
+/** True if one of the CPUs of the cell is time-shared. */
+bool sched_cell_shared(struct cell *cell);
+
+/*
+ * Accessors of the control fields of a cell's vCPU, whether it runs or
+ * not. The caller holds the control_lock of the CPU or has it suspended.
+ */
+bool sched_wait_for_poweron(struct cell *cell, unsigned int cpu_id);
+void sched_set_cpu_on_entry(struct cell *cell, unsigned int cpu_id,
+			    unsigned long entry);
+void sched_flush_vcpu_caches(struct cell *cell, unsigned int cpu_id);
+/**
+ * Starts a switched-out vCPU on its next window, see PSCI CPU_ON. Returns
+ * false if the vCPU of the cell is the running one.
+ */
+bool sched_cpu_on(struct cell *cell, unsigned int cpu_id, unsigned long entry,
+		  unsigned long context, long *result);
+
+/**
+ * Queues an interrupt for a time-shared CPU, deferring it if it is for the
+ * switched-out vCPU. False if the CPU is not shared.
+ */
+#define sched_set_pending(cpu_public, irq_id)				\
+	((cpu_public)->sched.shared && __sched_set_pending(cpu_public, irq_id))
+
+bool __sched_set_pending(struct public_per_cpu *cpu_public, u16 irq_id);
+
+#endif
@@ -8,5 +8,15 @@
  */
 
 #include <jailhouse/cell.h>
+#include <jailhouse/hypercall.h>
 
 void arm_smmu_config_commit(struct cell *cell);
+void arm_smmu_flush_cell_tlbs(struct cell *cell);
+void arm_smmuv3_flush_cell_tlbs(struct cell *cell);
+void arm_smmu_flush_cell_tlb_range(struct cell *cell, unsigned long addr,
+				   unsigned long size);
+void arm_smmuv3_flush_cell_tlb_range(struct cell *cell, unsigned long addr,
+				     unsigned long size);
+bool arm_smmuv3_handle_irq(u32 irqn);
+int arm_smmuv3_get_faults(struct jailhouse_iommu_faults *faults,
+			  unsigned int max_entries);
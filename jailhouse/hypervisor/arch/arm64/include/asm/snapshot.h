@@ -0,0 +1,40 @@
+/*
+ * Jailhouse Cell Snapshot Support
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#ifndef _JAILHOUSE_ASM_SNAPSHOT_H
+#define _JAILHOUSE_ASM_SNAPSHOT_H
+
+#include <jailhouse/cell.h>
+
+/**
+ * Saves the vCPU state if requested by arch_cell_snapshot(). Called by
+ * suspended CPUs while they wait to be resumed.
+ */
+void snapshot_cpu_save_help(void);
+
+/**
+ * Applies the interrupt state staged by arch_cell_prepare_restore() and
+ * selects the CPUs to be started. Called at the end of arch_cell_reset().
+ */
+void snapshot_cell_restore(struct cell *cell);
+
+/** Loads the staged vCPU state, if any, after arm_cpu_reset(). */
+void snapshot_cpu_restore(void);
+
+/*
+ * General-purpose, EL1, timer and FP/SIMD registers of the running vCPU, also
+ * switched on time-shared CPUs, see sched.c.
+ */
+void vcpu_state_save(struct jailhouse_vcpu_state *state);
+void vcpu_state_load(const struct jailhouse_vcpu_state *state);
+
+/* FPSR, FPCR, then q0..q31, 66 words in total */
+void fpsimd_save(u64 *regs);
+void fpsimd_restore(const u64 *regs);
+
+#endif /* _JAILHOUSE_ASM_SNAPSHOT_H */
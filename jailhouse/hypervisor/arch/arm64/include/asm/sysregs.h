@@ -110,6 +110,10 @@
 #define HCR_SWIO_BIT	(1u << 1)
 #define HCR_VM_BIT	(1u << 0)
 
+#define CNTHCTL_EVNTEN		(1 << 2)
+#define CNTHCTL_EVNTI_SHIFT	4
+#define CNTHCTL_EVNTI_MASK	(0xf << CNTHCTL_EVNTI_SHIFT)
+
 /* exception class */
 #define ESR_EC_SHIFT		(26)
 #define ESR_EC(esr)		GET_FIELD((esr), 31, ESR_EC_SHIFT)
@@ -117,6 +121,8 @@
 #define ESR_IL(esr)		GET_FIELD((esr), 25, 25)
 /* Instruction specific syndrome */
 #define ESR_ISS(esr)		GET_FIELD((esr), 24, 0)
+/* Abort fault status code is a translation fault (any level) */
+#define ESR_FSC_TRANSLATION(esr)	(((esr) & 0x3c) == 0x04)
 /* Exception classes values */
 #define ESR_EC_UNKNOWN		0x00
 #define ESR_EC_WFx		0x01
@@ -23,11 +23,23 @@
 #include <asm/sysregs.h>
 #include <asm/gic_v2.h>
 #include <asm/gic_v3.h>
+#include <asm/timer_event.h>
 
 #define CNTHP_CTL_EL2_ENABLE	(1<<0)
 #define CNTHP_CTL_EL2_IMASK	(1<<1)
 #define CNTHP_CTL_EL2_ISTATUS	(1<<2)
 
+/* Priority of the hv_timer, above anything programmed by the cells */
+#define TIMER_IRQ_PRIO		0x00
+/* CPU priority mask while parked: only the hv_timer is signaled */
+#define TIMER_PARK_PMR		0x10
+
+/** GIC state changed while a CPU is parked, see timer_park_begin() */
+struct timer_park_state {
+	u32 pmr;
+	u8 prio;
+};
+
 extern bool timer_isr_handler(void);
 extern unsigned int hv_timer_irq;
 
@@ -114,16 +126,74 @@ static inline void timer_cpu_reset(void)
 		gicv2_enable_irq(hv_timer_irq);
 }
 
+/**
+ * Prepare the CPU interface to wait for the hv_timer only.
+ * Raise the hv_timer priority (cells may have changed it) and mask
+ * all the lower priority interrupts, so that a WFI is only woken up
+ * by the timer.
+ *
+ * @param state	Receives the previous timer priority and CPU priority
+ * 		mask, see timer_park_end()
+ */
+static inline void timer_park_begin(struct timer_park_state *state)
+{
+	void *gicr;
+
+	if (system_config->platform_info.arm.gic_version == 3) {
+		gicr = this_cpu_public()->gicr.base + GICR_SGI_BASE;
+		state->prio = mmio_read8(gicr + GICR_IPRIORITYR +
+					 hv_timer_irq);
+		mmio_write8(gicr + GICR_IPRIORITYR + hv_timer_irq,
+			    TIMER_IRQ_PRIO);
+		arm_read_sysreg(ICC_PMR_EL1, state->pmr);
+		arm_write_sysreg(ICC_PMR_EL1, TIMER_PARK_PMR);
+	} else {
+		state->prio = gicv2_get_prio(hv_timer_irq);
+		gicv2_set_prio(hv_timer_irq, TIMER_IRQ_PRIO);
+		state->pmr = gicv2_get_cpu_prio_mask();
+		mmio_write32(gicc_base + GICC_PMR, TIMER_PARK_PMR);
+	}
+	isb();
+}
+
+/**
+ * Restore the hv_timer priority and the CPU priority mask saved by
+ * timer_park_begin().
+ */
+static inline void timer_park_end(const struct timer_park_state *state)
+{
+	void *gicr;
+
+	if (system_config->platform_info.arm.gic_version == 3) {
+		arm_write_sysreg(ICC_PMR_EL1, state->pmr);
+		gicr = this_cpu_public()->gicr.base + GICR_SGI_BASE;
+		mmio_write8(gicr + GICR_IPRIORITYR + hv_timer_irq,
+			    state->prio);
+	} else {
+		mmio_write32(gicc_base + GICC_PMR, state->pmr);
+		gicv2_set_prio(hv_timer_irq, state->prio);
+	}
+	isb();
+}
+
 /* -------------------------- FUNCTION DECLARATION ------------------------- */
 
 extern u64 timer_us_to_ticks(u64 us);
+extern u64 timer_ticks_to_us(u64 ticks);
 
-/** Register timer irq and handler */
-extern int timer_register(unsigned int irq, bool (*handler)(void));
-/** Init of timer interrupt. After initialization, setting compare
- * and issuing a timer_enable() will let the timer fire upon expiration.
+/** Register the timer irq */
+extern int timer_init(unsigned int irq);
+/** Init of timer interrupt. After initialization, armed events fire upon
+ * expiration.
  */
 extern void timer_cpu_init(void);
+/**
+ * Queue \a event on this CPU to expire at \a deadline (counter ticks), or
+ * move it if it is already queued. Requires IRQs off.
+ */
+extern void timer_event_arm(struct timer_event *event, u64 deadline);
+/** Dequeue \a event from this CPU if queued. Requires IRQs off. */
+extern void timer_event_cancel(struct timer_event *event);
 /** Cleanup */
 extern void timer_cpu_shutdown(void);
 
@@ -0,0 +1,30 @@
+/*
+ * Hypervisor timer events for Jailhouse ARM64
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#ifndef _ARM64_TIMER_EVENT_H
+#define _ARM64_TIMER_EVENT_H
+
+#include <jailhouse/types.h>
+
+/**
+ * Client of the per-CPU hypervisor timer, see timer_event_arm(). Events are
+ * only armed and cancelled by their own CPU.
+ */
+struct timer_event {
+	/** Absolute expiration in counter ticks, 0 if not queued */
+	u64 deadline;
+	/**
+	 * Called with IRQs off once the deadline has passed, may re-arm the
+	 * event. NULL if the interrupt exit alone is what the client needs.
+	 */
+	void (*handler)(struct timer_event *event);
+	/** Next queued event, in deadline order */
+	struct timer_event *next;
+};
+
+#endif
@@ -42,3 +42,24 @@ void iommu_config_commit(struct cell *cell)
 	arm_smmu_config_commit(cell);
 	pvu_iommu_config_commit(cell);
 }
+
+/* Drop the cached translations of a cell whose mappings changed */
+void iommu_flush_cell_tlbs(struct cell *cell)
+{
+	arm_smmu_flush_cell_tlbs(cell);
+	arm_smmuv3_flush_cell_tlbs(cell);
+}
+
+/* Drop the cached translations of an unmapped range of a cell */
+void iommu_flush_cell_tlb_range(struct cell *cell, unsigned long addr,
+				unsigned long size)
+{
+	arm_smmu_flush_cell_tlb_range(cell, addr, size);
+	arm_smmuv3_flush_cell_tlb_range(cell, addr, size);
+}
+
+/* Returns true if irqn was an IOMMU interrupt, handled by the hypervisor */
+bool iommu_handle_irq(u32 irqn)
+{
+	return arm_smmuv3_handle_irq(irqn);
+}
@@ -22,13 +22,19 @@
 #include <jailhouse/control.h>
 #include <jailhouse/cell-config.h>
 #include <jailhouse/assert.h>
+#include <jailhouse/bitops.h>
 #include <jailhouse/memguard-common.h>
 #include <jailhouse/memguard.h>
+#include <jailhouse/tracepoint.h>
 #include <asm/memguard.h>
 #include <asm/gic_v2.h>
 #include <asm/timer.h>
 #include <asm/pmu_events.h>
 #include <asm/pmu.h>
+#include <asm/dsu_pmu.h>
+#include <asm/bitops.h>
+#include <asm/qos.h>
+#include <asm/perf.h>
 
 //#define MG_VERBOSE_DEBUG
 
@@ -41,12 +47,63 @@
  *   as part of the init/deinit phases.
  */
 
-/* Memguard PMU Counter. We currently use only one counter, this is equivalent
- * to the pmu_first_cnt in pmu.c.
- * TODO: (needed?) extend to use more PMU counters at once.
+/* First memguard PMU counter, equivalent to the pmu_first_cnt in pmu.c.
+ * Event i of a memguard configuration is counted by memguard_pmu_cnt + i.
  */
 static u32 memguard_pmu_cnt = 0;
 
+/** Bitmap of all the PMU counters owned by memguard */
+#define MG_PMU_CNT_MASK	\
+	(((1U << MEMGUARD_MAX_EVENTS) - 1) << memguard_pmu_cnt)
+
+/* Reclaim: borrow 1/2^MG_RECLAIM_SHIFT of the own budget at a time */
+#define MG_RECLAIM_SHIFT	3
+
+/* DSU counter used for cluster regulation, negative if not available */
+static int memguard_dsu_cnt = -1;
+
+#define MG_NO_OWNER	((unsigned int)-1)
+
+/** Cluster-wide (DSU) regulation */
+struct memguard_cluster {
+	spinlock_t lock;
+	/** CPU recharging the DSU counter and taking its overflow IRQ */
+	unsigned int owner;
+	u32 budget;
+	/** DSU event counted for the regulation */
+	u32 event_type;
+	/** All the CPUs of the cluster are throttled until then (ticks) */
+	volatile u64 blocked_until;
+};
+
+static struct memguard_cluster memguard_clusters[JAILHOUSE_MAX_DSU_CLUSTERS];
+
+/* Adaptive mode: EWMA weight of the last period is 1/2^MG_ADAPT_EWMA_SHIFT */
+#define MG_ADAPT_EWMA_SHIFT	2
+/* Adaptive mode: budget is the EWMA plus 1/2^MG_ADAPT_HEADROOM_SHIFT */
+#define MG_ADAPT_HEADROOM_SHIFT	2
+
+/* Mode switch: time left to the targets to arm their switch timers */
+#define MG_SWITCH_LEAD_US	200
+
+static int memguard_apply(struct memguard *memguard,
+			  const struct memguard_params *params);
+
+/** Coordinated mode switch in flight, see memguard_switch_begin */
+static struct {
+	spinlock_t lock;
+	bool busy;
+	/** Period boundary of the switch (ticks) */
+	u64 deadline;
+	/** Period of the switch, a stale switch is dropped after it */
+	u64 period;
+	/** CPUs that did not pass the boundary yet */
+	unsigned int pending;
+	/** Profile applied at the boundary by \a qos_cpu */
+	unsigned int qos_profile;
+	unsigned int qos_cpu;
+} mode_switch;
+
 #ifdef CONFIG_DEBUG
 static inline void memguard_print_priorities(void)
 {
@@ -97,23 +154,325 @@ static void memguard_isr_debug_print(const char* name)
 #endif
 }
 
+/* Per-CPU telemetry rings, mapped read-only to the root cell */
+static struct memguard_telemetry memguard_telemetry[MEMGUARD_TELEMETRY_CPUS]
+	__attribute__((section(".memguard")));
+
+/** Account the events counted by event \a idx since its last (re)charge */
+static inline void memguard_update_consumed(struct memguard *memguard,
+					    u32 idx)
+{
+	u32 cur = pmu_get_val(memguard_pmu_cnt + idx);
+
+	/* wrap-around safe, also across an overflow */
+	memguard->consumed[idx] += cur - memguard->cnt_base[idx];
+	memguard->cnt_base[idx] = cur;
+}
+
 /**
- * Single counter, memory budget case: transform budget
+ * Memory budget of event \a idx: transform budget
  * to generate overflow upon expiration.
  */
-static inline void memguard_set_pmu_budget(u32 budget)
+static inline void memguard_set_pmu_budget(struct memguard *memguard,
+					   u32 idx, u32 budget)
 {
 	/* UINT32_MAX */
 	u32 val = 0xffffffff;
 	val -= budget;
 
-	pmu_set_val(memguard_pmu_cnt, val);
+	memguard_update_consumed(memguard, idx);
+	pmu_set_val(memguard_pmu_cnt + idx, val);
+	memguard->cnt_base[idx] = val;
+}
+
+/** Recharge the budgets of all active events */
+static inline void memguard_set_pmu_budgets(struct memguard *memguard)
+{
+	u32 i;
+
+	for (i = 0; i < memguard->num_events; i++)
+		memguard_set_pmu_budget(memguard, i,
+					memguard->budget_memory[i]);
+}
+
+/** Put \a spare events back into \a pool, never exceeding \a cap */
+static void memguard_pool_donate(u32 *pool, u32 spare, u32 cap)
+{
+	u32 old, new;
+
+	do {
+		old = ACCESS_ONCE(*pool);
+		if (old >= cap)
+			return;
+		new = (spare > cap - old) ? cap : old + spare;
+	} while (atomic_cas(pool, old, new) != old);
+}
+
+/** Take up to \a want events out of \a pool. Returns what was taken. */
+static u32 memguard_pool_borrow(u32 *pool, u32 want)
+{
+	u32 old, got;
+
+	do {
+		old = ACCESS_ONCE(*pool);
+		if (old == 0)
+			return 0;
+		got = MIN(old, want);
+	} while (atomic_cas(pool, old, old - got) != old);
+
+	return got;
+}
+
+/**
+ * End of period: donate the budget not consumed by the events that did
+ * not overflow. Must be called before recharging the counters.
+ */
+static void memguard_reclaim_donate(struct memguard *memguard)
+{
+	u32 *pool = this_cell()->memguard_pool;
+	u32 i, spare;
+
+	for (i = 0; i < memguard->num_events; i++) {
+		if (memguard->exhausted & (1U << i))
+			continue;
+		/* distance to overflow is the unused budget */
+		spare = 0xffffffff - pmu_get_val(memguard_pmu_cnt + i);
+		if (spare > 0)
+			memguard_pool_donate(&pool[i], spare,
+					     memguard->pool_cap[i]);
+	}
+	memguard->exhausted = 0;
+}
+
+/**
+ * Overflow of event \a idx: try to extend its budget from the cell pool.
+ * Returns true if the CPU can keep running.
+ */
+static bool memguard_reclaim_borrow(struct memguard *memguard, u32 idx)
+{
+	u32 *pool = this_cell()->memguard_pool;
+	u32 want, got, cur;
+
+	/* in cell-wide mode the own budget is already a quantum */
+	if (memguard->flags & MEMGUARD_FLAG_CELL)
+		want = memguard->budget_memory[idx];
+	else
+		want = MAX(memguard->budget_memory[idx] >> MG_RECLAIM_SHIFT, 1);
+	got = memguard_pool_borrow(&pool[idx], want);
+
+	/* events counted after the overflow are already consumed */
+	cur = pmu_get_val(memguard_pmu_cnt + idx);
+	if (got <= cur) {
+		memguard->exhausted |= 1U << idx;
+		return false;
+	}
+
+	memguard_set_pmu_budget(memguard, idx, got - cur);
+	return true;
+}
+
+/**
+ * Start of period: recharge the budgets of all active events. In
+ * cell-wide mode, refill the cell pool (first CPU only) and draw the
+ * initial quantum from it.
+ */
+static void memguard_recharge(struct memguard *memguard)
+{
+	u32 *pool = this_cell()->memguard_pool;
+	u32 i;
+
+	if (!(memguard->flags & MEMGUARD_FLAG_CELL)) {
+		memguard_set_pmu_budgets(memguard);
+		return;
+	}
+
+	memguard->exhausted = 0;
+	for (i = 0; i < memguard->num_events; i++) {
+		if (memguard->cell_leader)
+			ACCESS_ONCE(pool[i]) = memguard->pool_cap[i];
+		/* an empty pool overflows on the first event */
+		memguard_set_pmu_budget(memguard, i,
+					memguard_pool_borrow(&pool[i],
+						memguard->budget_memory[i]));
+	}
+}
+
+/**
+ * End of period: append the consumed events and the blocked time to the
+ * telemetry ring of this CPU. Lock-free, this CPU is the only writer.
+ */
+static void memguard_telemetry_record(struct memguard *memguard)
+{
+	struct memguard_telemetry_entry *entry;
+	struct memguard_telemetry *ring;
+	unsigned int i;
+
+	for (i = 0; i < memguard->num_events; i++)
+		memguard_update_consumed(memguard, i);
+
+	if (this_cpu_id() < MEMGUARD_TELEMETRY_CPUS) {
+		ring = &memguard_telemetry[this_cpu_id()];
+		entry = &ring->entries[ring->head %
+				       MEMGUARD_TELEMETRY_ENTRIES];
+
+		entry->timestamp = timer_get_ticks();
+		for (i = 0; i < MEMGUARD_MAX_EVENTS; i++)
+			entry->consumed[i] = (i < memguard->num_events) ?
+				memguard->consumed[i] : 0;
+		entry->blocked_ticks = memguard->period_blocked;
+
+		/* publish the entry before moving the head */
+		dmb(ish);
+		ring->head++;
+	}
+}
+
+/**
+ * End of period, adaptive mode: follow the EWMA of the consumed events,
+ * plus some headroom, within the configured bounds. A saturated budget
+ * hides the real demand, so it is raised instead.
+ */
+static void memguard_adapt(struct memguard *memguard)
+{
+	u32 i, sample, avg, target;
+
+	for (i = 0; i < memguard->num_events; i++) {
+		sample = memguard->consumed[i];
+		avg = memguard->ewma[i];
+		if (sample > avg)
+			avg += (sample - avg) >> MG_ADAPT_EWMA_SHIFT;
+		else
+			avg -= (avg - sample) >> MG_ADAPT_EWMA_SHIFT;
+		memguard->ewma[i] = avg;
+
+		if (sample >= memguard->budget_memory[i])
+			avg = MAX(avg, memguard->budget_memory[i]);
+		target = avg + MAX(avg >> MG_ADAPT_HEADROOM_SHIFT, 1);
+
+		memguard->budget_memory[i] =
+			MIN(MAX(target, memguard->budget_min[i]),
+			    memguard->budget_max[i]);
+	}
+}
+
+/** End of period: start accounting the next one */
+static void memguard_period_reset(struct memguard *memguard)
+{
+	unsigned int i;
+
+	for (i = 0; i < memguard->num_events; i++)
+		memguard->consumed[i] = 0;
+	memguard->period_blocked = 0;
+}
+
+/**
+ * Publish the events counted since the last recharge of the DSU counter,
+ * which counts \a event from now on (0: stopped).
+ */
+static void memguard_cluster_count(struct memguard_cluster *cluster,
+				   u32 event)
+{
+	u32 delta = dsu_get_val(memguard_dsu_cnt) -
+		(0xffffffff - cluster->budget);
+
+	dsu_count(cluster - memguard_clusters, memguard_dsu_cnt, event, delta);
+}
+
+/** Stop the cluster regulation if this CPU owns it */
+static void memguard_cluster_release(struct memguard *memguard)
+{
+	struct memguard_cluster *cluster = memguard->cluster;
+
+	if (!cluster)
+		return;
+
+	spin_lock(&cluster->lock);
+	if (cluster->owner == this_cpu_id()) {
+		memguard_cluster_count(cluster, 0);
+		dsu_int_disable(memguard_dsu_cnt);
+		dsu_disable(memguard_dsu_cnt);
+		dsu_clear_overflow(memguard_dsu_cnt);
+		dsu_release(cluster - memguard_clusters);
+		cluster->owner = MG_NO_OWNER;
+		cluster->blocked_until = 0;
+	}
+	spin_unlock(&cluster->lock);
+}
+
+/**
+ * Regulate the whole cluster of this CPU, which takes over the DSU
+ * counter and its interrupt. Periods must be synchronized as the other
+ * CPUs are released at the period boundary of the owner.
+ */
+static void memguard_cluster_apply(struct memguard *memguard,
+				   const struct memguard_params *params)
+{
+	struct memguard_cluster *cluster = memguard->cluster;
+	u32 event_type;
+
+	if (params->cluster_budget == 0) {
+		memguard_cluster_release(memguard);
+		return;
+	}
+
+	spin_lock(&cluster->lock);
+	event_type = params->cluster_event_type ?
+		params->cluster_event_type : DSU_PMU_EVT_L3D_CACHE_REFILL;
+	if (cluster->owner != MG_NO_OWNER)
+		memguard_cluster_count(cluster, event_type);
+	else
+		dsu_count(cluster - memguard_clusters, memguard_dsu_cnt,
+			  event_type, 0);
+	dsu_int_disable(memguard_dsu_cnt);
+	dsu_disable(memguard_dsu_cnt);
+	dsu_clear_overflow(memguard_dsu_cnt);
+
+	cluster->owner = this_cpu_id();
+	cluster->budget = params->cluster_budget;
+	cluster->event_type = event_type;
+	cluster->blocked_until = 0;
+	dsu_claim(cluster - memguard_clusters);
+
+	dsu_set_type(memguard_dsu_cnt, event_type);
+	dsu_set_val(memguard_dsu_cnt, 0xffffffff - cluster->budget);
+	dsu_int_enable(memguard_dsu_cnt);
+	dsu_enable(memguard_dsu_cnt);
+	dsu_enable_all();
+	spin_unlock(&cluster->lock);
+
+	mg_print("(CPU %d) cluster %ld budget %u\n", this_cpu_id(),
+		 (long)(cluster - memguard_clusters), cluster->budget);
+}
+
+/** Start of period, cluster owner only: recharge the DSU counter */
+static void memguard_cluster_recharge(struct memguard *memguard)
+{
+	struct memguard_cluster *cluster = memguard->cluster;
+
+	if (!cluster || ACCESS_ONCE(cluster->owner) != this_cpu_id())
+		return;
+
+	memguard_cluster_count(cluster, cluster->event_type);
+	dsu_set_val(memguard_dsu_cnt, 0xffffffff - cluster->budget);
+	dsu_clear_overflow(memguard_dsu_cnt);
+	/* the other CPUs stop by themselves at the period boundary */
+	cluster->blocked_until = 0;
 }
 
 /**
- * Memguard timer interrupt: reset budgets and unblock CPUs
+ * Synchronized mode: first period boundary after \a now. Boundaries are
+ * the multiples of the period on the system counter, thus common to all
+ * CPUs regulated with the same period.
  */
-bool memguard_isr_timer(void)
+static inline u64 memguard_epoch_next(u64 now, u64 period)
+{
+	return now - (now % period) + period;
+}
+
+/**
+ * Memguard period timer: reset budgets and unblock CPUs
+ */
+static void memguard_isr_timer(struct timer_event *event)
 {
 	struct memguard *memguard = &this_cpu_public()->memguard;
 
@@ -121,10 +480,23 @@ bool memguard_isr_timer(void)
 	memguard_isr_debug_print("time");
 
 	memguard->last_time += memguard->budget_time;
-	/* Recharge budget */
-	memguard_set_pmu_budget(memguard->budget_memory);
+	/* never drift from the epoch, skip the periods that were missed */
+	if ((memguard->flags & MEMGUARD_FLAG_SYNC) &&
+	    memguard->last_time <= timer_get_ticks())
+		memguard->last_time = memguard_epoch_next(timer_get_ticks(),
+							  memguard->budget_time);
+	memguard_telemetry_record(memguard);
+	if (memguard->flags & MEMGUARD_FLAG_ADAPTIVE)
+		memguard_adapt(memguard);
+	memguard_period_reset(memguard);
+	if (memguard->flags & MEMGUARD_FLAG_RECLAIM)
+		memguard_reclaim_donate(memguard);
+	/* Recharge budgets */
+	memguard_recharge(memguard);
+	memguard_cluster_recharge(memguard);
 	/* Set next regulation period expiration */
-	timer_set_cmpval(memguard->last_time);
+	timer_event_arm(event, memguard->last_time);
+	tracepoint(TRACE_MEMGUARD_TIMER, 0, memguard->last_time, 0);
 
 	/* If we hit after a reset, remove the sticky reset flag */
 #ifdef MG_VERBOSE_DEBUG
@@ -139,8 +511,38 @@ bool memguard_isr_timer(void)
 	memguard->block &= ~MG_RESET;
 	/* Disable blocking */
 	memguard->block &= ~MG_BLOCK;
+}
 
-	return true;
+/**
+ * Mode switch boundary: take over the new budgets, the calling CPU also
+ * applies the QoS profile.
+ */
+static void memguard_switch_isr(struct timer_event *event)
+{
+	struct public_per_cpu *cpu_public = this_cpu_public();
+	struct memguard_params params;
+	bool apply;
+
+	spin_lock(&cpu_public->control_lock);
+	apply = cpu_public->memguard.switch_apply;
+	if (apply)
+		params = cpu_public->memguard.switch_params;
+	cpu_public->memguard.switch_apply = false;
+	spin_unlock(&cpu_public->control_lock);
+
+	if (apply && memguard_apply(&cpu_public->memguard, &params) != 0)
+		printk("[MG] CPU %u: invalid budget\n", this_cpu_id());
+
+	if (this_cpu_id() == mode_switch.qos_cpu &&
+	    mode_switch.qos_profile != MODE_SWITCH_NO_QOS &&
+	    qos_profile_apply(mode_switch.qos_profile) != 0)
+		printk("[MG] mode switch: QoS profile %u lost\n",
+		       mode_switch.qos_profile);
+
+	spin_lock(&mode_switch.lock);
+	if (--mode_switch.pending == 0)
+		mode_switch.busy = false;
+	spin_unlock(&mode_switch.lock);
 }
 
 /**
@@ -149,13 +551,30 @@ bool memguard_isr_timer(void)
 bool memguard_isr_pmu(void)
 {
 	struct memguard *memguard = &this_cpu_public()->memguard;
+	bool block = true;
+	u32 ovs, i;
 
 	/* NOTE: both IRQ and FIQ are off here */
 	assert(arm_is_irq_off());
 	memguard_isr_debug_print("pmu");
 
-	/* clear overflow, let the counter run */
-	pmu_clear_overflow(memguard_pmu_cnt);
+	/* clear overflow of any exhausted budget, let the counters run */
+	ovs = pmu_get_overflow() & MG_PMU_CNT_MASK;
+	arm_write_sysreg(PMOVSCLR_EL0, ovs);
+
+	if (memguard->flags & (MEMGUARD_FLAG_RECLAIM | MEMGUARD_FLAG_CELL)) {
+		/* block if any of the exhausted budgets cannot be extended */
+		block = false;
+		for (i = 0; i < memguard->num_events; i++)
+			if ((ovs & (1U << (memguard_pmu_cnt + i))) &&
+			    !memguard_reclaim_borrow(memguard, i))
+				block = true;
+	}
+
+	tracepoint(TRACE_MEMGUARD_PMU, ovs, block, 0);
+	if (!block)
+		return true;
+
 	/* Lazily signal that the CPU should block.
 	 * Will be shortly enacted in the same IRQ-off block.
 	 */
@@ -164,13 +583,85 @@ bool memguard_isr_pmu(void)
 	return true;
 }
 
+/**
+ * DSU overflow interrupt, routed to the cluster owner: throttle all the
+ * CPUs of the cluster till the end of the period.
+ */
+bool memguard_isr_dsu(void)
+{
+	struct memguard *memguard = &this_cpu_public()->memguard;
+	struct memguard_cluster *cluster = memguard->cluster;
+	unsigned int cpu;
+
+	assert(arm_is_irq_off());
+	memguard_isr_debug_print("dsu");
+
+	if (!(dsu_get_overflow() & (1U << memguard_dsu_cnt)))
+		return true;
+	dsu_clear_overflow(memguard_dsu_cnt);
+
+	if (!cluster || ACCESS_ONCE(cluster->owner) != this_cpu_id())
+		return true;
+
+	cluster->blocked_until = memguard->last_time;
+	/* publish the deadline before kicking the other CPUs */
+	dmb(ish);
+	for (cpu = 0; cpu < system_config->root_cell.cpu_set_size * 8; cpu++) {
+		if (cpu == this_cpu_id() || !cpu_id_valid(cpu) ||
+		    public_per_cpu(cpu)->memguard.cluster != cluster)
+			continue;
+		/* enacted by memguard_cpu_block when the event is handled */
+		arch_send_event(public_per_cpu(cpu));
+	}
+
+	return true;
+}
+
+/** Account \a ticks of blocking to the statistics of this CPU */
+static inline void memguard_account_blocked(struct memguard *memguard,
+					    u64 ticks)
+{
+	u32 *stats = this_cpu_public()->stats;
+
+	memguard->blocked_ticks += ticks;
+	memguard->period_blocked += ticks;
+	stats[JAILHOUSE_CPU_STAT_MEMGUARD_THROTTLED]++;
+	stats[JAILHOUSE_CPU_STAT_MEMGUARD_BLOCKED_US] =
+		timer_ticks_to_us(memguard->blocked_ticks);
+}
+
+/**
+ * Wait while the budget of the cluster is exhausted. The own period may
+ * not be synchronized with the owner, so poll the deadline.
+ */
+static void memguard_cluster_block(struct memguard *memguard)
+{
+	u64 until = memguard->cluster->blocked_until;
+	u64 start;
+
+	if (until == 0)
+		return;
+
+	start = timer_get_ticks();
+	if (start >= until)
+		return;
+
+	while (timer_get_ticks() < until)
+		isb();
+	memguard_account_blocked(memguard, timer_get_ticks() - start);
+}
+
 void memguard_cpu_block(void)
 {
 	/* block is volatile and never set cross-CPU */
 	struct memguard *memguard = &this_cpu_public()->memguard;
+	u64 start;
+	struct timer_park_state park;
 
 	/* Not a regulation IRQ */
 	if (!(memguard->block & MG_BLOCK)) {
+		if (memguard->cluster)
+			memguard_cluster_block(memguard);
 		return;
 	}
 
@@ -183,10 +674,24 @@ void memguard_cpu_block(void)
 #ifdef MG_VERBOSE_DEBUG
 	printk("%uB\n", this_cpu_id());
 #endif
-	/* poll till the next interrupt, then recheck what happened */
-	while (!timer_fired()) {
-		isb();
+	start = timer_get_ticks();
+	if (memguard->flags & MEMGUARD_FLAG_PARK) {
+		/* sleep till the next regulation period. IRQs are off:
+		 * a pending (unmasked) timer IRQ only wakes us up. An earlier
+		 * event of another timer client ends the wait as well, but
+		 * MG_BLOCK stays set and we block again once it is handled.
+		 */
+		timer_park_begin(&park);
+		while (!timer_fired())
+			asm volatile("wfi" : : : "memory");
+		timer_park_end(&park);
+	} else {
+		/* poll till the next interrupt, then recheck what happened */
+		while (!timer_fired()) {
+			isb();
+		}
 	}
+	memguard_account_blocked(memguard, timer_get_ticks() - start);
 
 	return;
 }
@@ -194,33 +699,56 @@ void memguard_cpu_block(void)
 int memguard_init(void)
 {
 	u32 irq = system_config->platform_info.memguard.hv_timer;
-	u32 num_cnt;
+	u32 num_cnt, i;
 	int err;
 
-	/* register both irq line and interrupt handler */
-	err = timer_register(irq, memguard_isr_timer);
+	/* register the irq line, memguard arms its period timer per CPU */
+	err = timer_init(irq);
 	if (err < 0)
 		return err;
 
-	/* Currently register one single counter */
-	num_cnt = 1;
+	/* One counter for each (event, budget) pair */
+	num_cnt = MEMGUARD_MAX_EVENTS;
 	memguard_pmu_cnt = pmu_register(num_cnt, memguard_isr_pmu);
 
-	mg_print("Using PMU counter: %u\n", memguard_pmu_cnt);
+	mg_print("Using PMU counters: %u-%u\n", memguard_pmu_cnt,
+		 memguard_pmu_cnt + num_cnt - 1);
+
+	/* the sampling counter goes below the memguard ones */
+	perf_init();
+
+	/* Cluster regulation is optional */
+	memguard_dsu_cnt = dsu_register(memguard_isr_dsu);
+	if (memguard_dsu_cnt >= 0) {
+		for (i = 0; i < JAILHOUSE_MAX_DSU_CLUSTERS; i++)
+			memguard_clusters[i].owner = MG_NO_OWNER;
+		mg_print("Using DSU counter: %d\n", memguard_dsu_cnt);
+	}
 
 	return err;
 }
 
 void memguard_cpu_init(void)
 {
-	memset(&this_cpu_public()->memguard, 0, sizeof(struct memguard));
+	struct memguard *memguard = &this_cpu_public()->memguard;
+	unsigned int cluster;
+
+	memset(memguard, 0, sizeof(struct memguard));
+
+	cluster = dsu_cluster_of(this_cpu_public()->mpidr);
+	if (memguard_dsu_cnt >= 0 &&
+	    cluster < system_config->platform_info.memguard.num_dsu_irq)
+		memguard->cluster = &memguard_clusters[cluster];
 
+	this_cpu_data()->memguard_timer.handler = memguard_isr_timer;
+	this_cpu_data()->mode_switch_timer.handler = memguard_switch_isr;
 	timer_cpu_init();
 	pmu_cpu_init();
 }
 
 void memguard_cpu_shutdown(void)
 {
+	memguard_cluster_release(&this_cpu_public()->memguard);
 	timer_cpu_shutdown();
 	pmu_cpu_shutdown();
 }
@@ -238,16 +766,281 @@ void memguard_cpu_reset(void)
 	pmu_cpu_reset();
 }
 
+/** Validate \a params before touching the state of any CPU */
+static int memguard_params_check(const struct memguard_params *params)
+{
+	unsigned int i;
+
+	if (params->num_events > MEMGUARD_MAX_EVENTS)
+		return -EINVAL;
+	if ((params->flags & MEMGUARD_FLAG_SYNC || params->cluster_budget) &&
+	    timer_us_to_ticks(params->budget_time) == 0)
+		return -EINVAL;
+	for (i = 0; i < params->num_events; i++)
+		if (params->events[i].budget_max != 0 &&
+		    params->events[i].budget_min > params->events[i].budget_max)
+			return -EINVAL;
+
+	return 0;
+}
+
+/** Program the budgets in \a params on this CPU. */
+static int memguard_apply(struct memguard *memguard,
+			  const struct memguard_params *params)
+{
+	unsigned int event_type[MEMGUARD_MAX_EVENTS];
+	unsigned int filter[MEMGUARD_MAX_EVENTS];
+	unsigned int num_cpus = 0, cpu;
+	struct cell *cell = this_cell();
+	unsigned int i;
+	int err;
+
+	assert(arm_is_irq_off());
+
+	err = memguard_params_check(params);
+	if (err)
+		return err;
+	if (params->cluster_budget && !memguard->cluster)
+		return -ENODEV;
+
+	if (params->num_events == 0) {
+		/* Single event, legacy interface */
+		memguard->num_events = 1;
+		memguard->budget_memory[0] = params->budget_memory;
+		memguard->budget_min[0] = 0;
+		memguard->budget_max[0] = 0;
+		event_type[0] = params->event_type;
+		filter[0] = 0;
+	} else {
+		memguard->num_events = params->num_events;
+		for (i = 0; i < memguard->num_events; i++) {
+			memguard->budget_memory[i] =
+				params->events[i].budget_memory;
+			memguard->budget_min[i] = params->events[i].budget_min;
+			memguard->budget_max[i] = params->events[i].budget_max;
+			event_type[i] = params->events[i].event_type;
+			filter[i] = params->events[i].filter;
+		}
+	}
+
+	for (i = 0; i < memguard->num_events; i++) {
+		/* a zero upper bound keeps the budget at most the target */
+		if (memguard->budget_max[i] == 0)
+			memguard->budget_max[i] = memguard->budget_memory[i];
+		memguard->budget_min[i] = MIN(MAX(memguard->budget_min[i], 1),
+					      memguard->budget_max[i]);
+		memguard->ewma[i] = memguard->budget_memory[i];
+	}
+
+	for (i = 0; i < memguard->num_events; i++) {
+		if (event_type[i] == 0) {
+			/* Use default event type */
+			event_type[i] = PMUV3_PERFCTR_L2D_CACHE_REFILL;
+		}
+		/* EL2 is only counted on request, the rest is left as is */
+		event_type[i] &= ~PMEVTYPER_NSH;
+		if (filter[i] & MEMGUARD_EVENT_EL2)
+			event_type[i] |= PMEVTYPER_NSH;
+	}
+
+	memguard->start_time = timer_get_ticks();
+	memguard->budget_time = timer_us_to_ticks(params->budget_time);
+	memguard->flags = params->flags;
+	if (params->cluster_budget)
+		memguard->flags |= MEMGUARD_FLAG_SYNC;
+	/* last_time is the end of the current period */
+	if (memguard->flags & MEMGUARD_FLAG_SYNC)
+		memguard->last_time = memguard_epoch_next(memguard->start_time,
+							  memguard->budget_time);
+	else
+		memguard->last_time = memguard->start_time +
+			memguard->budget_time;
+	memguard->blocked_ticks = 0;
+
+	memguard->exhausted = 0;
+	for_each_cpu(cpu, cell->cpu_set)
+		num_cpus++;
+
+	if (memguard->flags & MEMGUARD_FLAG_CELL) {
+		/* Budgets are for the whole cell: the pool is refilled by
+		 * the first CPU, each CPU draws quanta out of it.
+		 */
+		memguard->cell_leader =
+			(this_cpu_id() == first_cpu(cell->cpu_set));
+		for (i = 0; i < memguard->num_events; i++) {
+			memguard->pool_cap[i] = memguard->budget_memory[i];
+			memguard->budget_memory[i] =
+				MAX(memguard->budget_memory[i] /
+				    (num_cpus << MG_RECLAIM_SHIFT), 1);
+			if (memguard->cell_leader)
+				cell->memguard_pool[i] = memguard->pool_cap[i];
+		}
+	} else {
+		/* The cell pool holds at most one period worth of budget
+		 * for each of the cell's CPUs (assuming they share the same
+		 * budgets).
+		 */
+		memguard->cell_leader = false;
+		for (i = 0; i < memguard->num_events; i++)
+			memguard->pool_cap[i] =
+				(u32)MIN((u64)memguard->budget_memory[i] *
+					 num_cpus, 0xffffffffULL);
+	}
+
+	/* NOTE: this function is called on each affected CPU.
+	 * Serialization via IRQ off. Reset the overflow indicator anyway.
+	 */
+	memguard->block = 0;
+	for (i = 0; i < MEMGUARD_MAX_EVENTS; i++) {
+		pmu_disable(memguard_pmu_cnt + i);
+		pmu_clear_overflow(memguard_pmu_cnt + i);
+	}
+
+	/* Init timer and PMU budgets. Here also set the pmu types */
+	memguard->period_blocked = 0;
+	for (i = 0; i < memguard->num_events; i++) {
+		pmu_set_type(memguard_pmu_cnt + i, event_type[i]);
+		memguard->consumed[i] = 0;
+		memguard->cnt_base[i] = pmu_get_val(memguard_pmu_cnt + i);
+	}
+	timer_event_arm(&this_cpu_data()->memguard_timer, memguard->last_time);
+	memguard_recharge(memguard);
+	memguard_cluster_apply(memguard, params);
+
+	/* Enable PMU counters of the active events only */
+	for (i = 0; i < memguard->num_events; i++)
+		pmu_enable(memguard_pmu_cnt + i);
+
+	for (i = 0; i < memguard->num_events; i++)
+		mg_print("(CPU %d) mg_set %llu %u (0x%x) [freq: %ld]%s%s\n",
+			 this_cpu_id(), memguard->budget_time,
+			 memguard->budget_memory[i], event_type[i],
+			 timer_get_frequency(),
+			 (memguard->flags & MEMGUARD_FLAG_PARK) ? " park" : "",
+			 (memguard->flags & MEMGUARD_FLAG_ADAPTIVE) ?
+				" adaptive" : "");
+
+	return 0;
+}
+
 /** Setup budget time + memory for this CPU. */
 int memguard_set(struct memguard *memguard, unsigned long params_address)
 {
 	unsigned long params_page_offs = params_address & PAGE_OFFS_MASK;
+	struct memguard_params params;
 	unsigned int params_pages;
 	void *params_mapping;
-	struct memguard_params *params;
-	unsigned int event_type;
 
-	assert(arm_is_irq_off());
+	params_pages = PAGES(params_page_offs + sizeof(struct memguard_params));
+	params_mapping = paging_get_guest_pages(NULL, params_address,
+						params_pages,
+						PAGE_READONLY_FLAGS);
+	if (!params_mapping)
+		return -ENOMEM;
+
+	memcpy(&params, params_mapping + params_page_offs, sizeof(params));
+	/* cell-wide budgets are only set via memguard_cell_set */
+	params.flags &= ~MEMGUARD_FLAG_CELL;
+
+	return memguard_apply(memguard, &params);
+}
+
+/** Stop counting and periods on this CPU, and forget the budgets. */
+static void memguard_stop(struct memguard *memguard)
+{
+	struct memguard_cluster *cluster = memguard->cluster;
+	unsigned int i;
+
+	memguard_cluster_release(memguard);
+	timer_event_cancel(&this_cpu_data()->memguard_timer);
+	for (i = 0; i < MEMGUARD_MAX_EVENTS; i++) {
+		pmu_disable(memguard_pmu_cnt + i);
+		pmu_clear_overflow(memguard_pmu_cnt + i);
+	}
+
+	memset(memguard, 0, sizeof(struct memguard));
+	memguard->cluster = cluster;
+}
+
+/**
+ * Apply the configuration queued by memguard_cell_set on this CPU, or stop
+ * the regulation as requested by memguard_cpu_release. Also arms the timer
+ * of a mode switch queued by memguard_switch_commit.
+ */
+void memguard_cpu_update(void)
+{
+	struct memguard *memguard = &this_cpu_public()->memguard;
+
+	if (memguard->switch_arm) {
+		memguard->switch_arm = false;
+		timer_event_arm(&this_cpu_data()->mode_switch_timer,
+				mode_switch.deadline);
+	}
+	if (!memguard->update)
+		return;
+
+	memguard->update = false;
+	if (memguard->release) {
+		memguard_stop(memguard);
+		return;
+	}
+	if (memguard_apply(memguard, &memguard->pending) != 0)
+		printk("[MG] CPU %u: invalid budget\n", this_cpu_id());
+}
+
+/**
+ * Queue \a params on \a cpu and kick it. The local CPU applies them
+ * right away.
+ */
+static void memguard_queue(unsigned int cpu,
+			   const struct memguard_params *params)
+{
+	struct public_per_cpu *target = public_per_cpu(cpu);
+
+	spin_lock(&target->control_lock);
+	target->memguard.pending = *params;
+	target->memguard.update = true;
+	spin_unlock(&target->control_lock);
+
+	if (cpu == this_cpu_id())
+		memguard_cpu_update();
+	else
+		arch_send_event(target);
+}
+
+/**
+ * Budgets are set up for the cell of the CPU, e.g. draw from its pool. The
+ * target stops them on its next management event, i.e. its park request.
+ */
+void memguard_cpu_release(unsigned int cpu)
+{
+	struct public_per_cpu *target = public_per_cpu(cpu);
+
+	spin_lock(&target->control_lock);
+	target->memguard.release = true;
+	target->memguard.update = true;
+	spin_unlock(&target->control_lock);
+}
+
+/**
+ * Set the memguard_params at the root cell address \a params_address as
+ * the bandwidth domain of cell \a id. The budgets become a pool shared by
+ * all the CPUs of the cell, with aligned periods, and replace their per-CPU
+ * budgets. They are queued on each of these CPUs, which program them in
+ * memguard_cpu_update on their next management event.
+ */
+int memguard_cell_set(struct per_cpu *cpu_data, unsigned long id,
+		      unsigned long params_address)
+{
+	unsigned long params_page_offs = params_address & PAGE_OFFS_MASK;
+	struct memguard_params params;
+	unsigned int params_pages, cpu;
+	void *params_mapping;
+	struct cell *cell;
+	int err;
+
+	if (cpu_data->public.cell != &root_cell)
+		return -EPERM;
 
 	params_pages = PAGES(params_page_offs + sizeof(struct memguard_params));
 	params_mapping = paging_get_guest_pages(NULL, params_address,
@@ -256,38 +1049,188 @@ int memguard_set(struct memguard *memguard, unsigned long params_address)
 	if (!params_mapping)
 		return -ENOMEM;
 
-	params = (struct memguard_params *)(params_mapping + params_page_offs);
+	memcpy(&params, params_mapping + params_page_offs, sizeof(params));
+	/* the leader refills the pool for everyone: align the periods */
+	params.flags |= MEMGUARD_FLAG_CELL | MEMGUARD_FLAG_SYNC;
+	params.flags &= ~(MEMGUARD_FLAG_RECLAIM | MEMGUARD_FLAG_ADAPTIVE);
+	err = memguard_params_check(&params);
+	if (err)
+		return err;
 
-	memguard->start_time = timer_get_ticks();
-	memguard->last_time = memguard->start_time;
+	/*
+	 * The cell list cannot change meanwhile: cell_create/destroy only
+	 * proceed once their cell_suspend(&root_cell) has seen the caller
+	 * leave this hypercall.
+	 */
+	for_each_cell(cell) {
+		if (cell->config->id != id)
+			continue;
 
-	memguard->budget_time = timer_us_to_ticks(params->budget_time);
-	memguard->budget_memory = params->budget_memory;
-	event_type = params->event_type;
-	if (event_type == 0) {
-		/* Use default event type */
-		event_type = PMUV3_PERFCTR_L2D_CACHE_REFILL;
+		for_each_cpu(cpu, cell->cpu_set)
+			memguard_queue(cpu, &params);
+		return 0;
 	}
 
-	/* NOTE: this function is called on each affected CPU.
-	 * Serialization via IRQ off. Reset the overflow indicator anyway.
+	return -ENOENT;
+}
+
+/**
+ * Configure \a count CPUs with one call: validate all the entries, then
+ * queue them and signal every target CPU. The targets apply their
+ * parameters concurrently, on their next management event.
+ */
+int memguard_batch_set(struct per_cpu *cpu_data, unsigned long count,
+		       unsigned long params_address)
+{
+	unsigned long params_page_offs = params_address & PAGE_OFFS_MASK;
+	struct memguard_cpu_params *entries, *entry;
+	struct memguard_params params;
+	unsigned int params_pages, n, cpu;
+	int err;
+
+	if (cpu_data->public.cell != &root_cell)
+		return -EPERM;
+
+	if (count == 0 || count > MAX_CPUS)
+		return -EINVAL;
+
+	params_pages = PAGES(params_page_offs +
+			     sizeof(struct memguard_cpu_params) * count);
+	entries = paging_get_guest_pages(NULL, params_address, params_pages,
+					 PAGE_READONLY_FLAGS);
+	if (!entries)
+		return -ENOMEM;
+	entries = (void *)entries + params_page_offs;
+
+	for (n = 0; n < count; n++) {
+		entry = &entries[n];
+		if (!cpu_id_valid(entry->cpu))
+			return -EINVAL;
+		err = memguard_params_check(&entry->params);
+		if (err)
+			return err;
+	}
+
+	/*
+	 * Other root cell CPUs can still write to the buffer: only use
+	 * what is copied here. memguard_apply checks the params again.
 	 */
-	memguard->block = 0;
-	pmu_disable(memguard_pmu_cnt);
-	pmu_clear_overflow(memguard_pmu_cnt);
+	for (n = 0; n < count; n++) {
+		cpu = entries[n].cpu;
+		params = entries[n].params;
+		if (!cpu_id_valid(cpu))
+			continue;
+		/* per-CPU budgets, as with memguard_set */
+		params.flags &= ~MEMGUARD_FLAG_CELL;
+		memguard_queue(cpu, &params);
+	}
 
-	/* Init timer and PMU budgets. Here also set the pmu type */
-	pmu_set_type(memguard_pmu_cnt, event_type);
-	timer_set_cmpval(memguard->last_time + memguard->budget_time);
-	memguard_set_pmu_budget(memguard->budget_memory);
+	return 0;
+}
 
-	/* Enable timer and PMU */
-	pmu_enable(memguard_pmu_cnt);
-	timer_enable();
+/**
+ * A mode switch is validated completely before the caller changes anything
+ * else, e.g. cell colors. Only one switch can be in flight: it ends when the
+ * last CPU passed the boundary, or one period after it when a target was
+ * reset meanwhile and lost its timer.
+ */
+int memguard_switch_begin(const struct memguard_cpu_params *entries,
+			  unsigned int count, unsigned long long period_us,
+			  unsigned int qos_profile)
+{
+	unsigned long seen[MAX_CPUS / BITS_PER_LONG + 1] = { 0 };
+	const struct memguard_cpu_params *entry;
+	u64 period = timer_us_to_ticks(period_us);
+	unsigned int n;
+	int err;
 
-	mg_print("(CPU %d) mg_set %llu %u (0x%x) [freq: %ld]\n", this_cpu_id(),
-		 memguard->budget_time, memguard->budget_memory,
-		 event_type, timer_get_frequency());
+	if (period == 0 || count > MAX_CPUS)
+		return -EINVAL;
+
+	for (entry = entries; entry < entries + count; entry++) {
+		if (!cpu_id_valid(entry->cpu) || entry->cpu >= MAX_CPUS ||
+		    test_bit(entry->cpu, seen))
+			return -EINVAL;
+		set_bit(entry->cpu, seen);
+		err = memguard_params_check(&entry->params);
+		if (err)
+			return err;
+		if (entry->params.cluster_budget &&
+		    !public_per_cpu(entry->cpu)->memguard.cluster)
+			return -ENODEV;
+	}
+
+	if (qos_profile != MODE_SWITCH_NO_QOS) {
+		err = qos_profile_check(qos_profile);
+		if (err)
+			return err;
+	}
+
+	spin_lock(&mode_switch.lock);
+	if (mode_switch.busy &&
+	    timer_get_ticks() < mode_switch.deadline + mode_switch.period) {
+		spin_unlock(&mode_switch.lock);
+		return -EBUSY;
+	}
+	mode_switch.busy = true;
+	mode_switch.period = period;
+	mode_switch.qos_profile = qos_profile;
+	spin_unlock(&mode_switch.lock);
+
+	for (n = 0; n < count; n++)
+		mg_print("mode switch: CPU %u %llu us\n", entries[n].cpu,
+			 entries[n].params.budget_time);
 
 	return 0;
 }
+
+void memguard_switch_abort(void)
+{
+	spin_lock(&mode_switch.lock);
+	mode_switch.busy = false;
+	spin_unlock(&mode_switch.lock);
+}
+
+/**
+ * Every target, and the calling CPU for the QoS profile, arms its switch
+ * timer at the first boundary of the period that leaves time for the
+ * signals to arrive.
+ */
+void memguard_switch_commit(const struct memguard_cpu_params *entries,
+			    unsigned int count)
+{
+	unsigned int caller = this_cpu_id();
+	struct public_per_cpu *target;
+	bool caller_listed = false;
+	unsigned int n;
+
+	for (n = 0; n < count; n++)
+		if (entries[n].cpu == caller)
+			caller_listed = true;
+
+	spin_lock(&mode_switch.lock);
+	mode_switch.deadline = memguard_epoch_next(timer_get_ticks() +
+		timer_us_to_ticks(MG_SWITCH_LEAD_US), mode_switch.period);
+	mode_switch.qos_cpu = caller;
+	mode_switch.pending = count + (caller_listed ? 0 : 1);
+	spin_unlock(&mode_switch.lock);
+
+	for (n = 0; n < count; n++) {
+		target = public_per_cpu(entries[n].cpu);
+
+		spin_lock(&target->control_lock);
+		target->memguard.switch_params = entries[n].params;
+		/* per-CPU budgets, as with memguard_batch_set */
+		target->memguard.switch_params.flags &= ~MEMGUARD_FLAG_CELL;
+		target->memguard.switch_apply = true;
+		if (entries[n].cpu != caller)
+			target->memguard.switch_arm = true;
+		spin_unlock(&target->control_lock);
+
+		if (entries[n].cpu != caller)
+			arch_send_event(target);
+	}
+
+	timer_event_arm(&this_cpu_data()->mode_switch_timer,
+			mode_switch.deadline);
+}
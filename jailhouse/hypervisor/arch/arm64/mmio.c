@@ -62,6 +62,11 @@ enum trap_return arch_handle_dabt(struct trap_context *ctx)
 	mmio.address = hpfar << 8;
 	mmio.address |= hdfar & 0xfff;
 
+	/* First access to lazily mapped RAM, also from stage-1 walks */
+	if (ESR_FSC_TRANSLATION(ctx->esr) &&
+	    arm_paging_cell_lazy_fault(mmio.address))
+		return TRAP_HANDLED;
+
 	this_cpu_public()->stats[JAILHOUSE_CPU_STAT_VMEXITS_MMIO]++;
 
 	/*
@@ -0,0 +1,160 @@
+/*
+ * PMU sampling profiler for Jailhouse ARM64
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#include <jailhouse/control.h>
+#include <jailhouse/paging.h>
+#include <jailhouse/percpu.h>
+#include <jailhouse/perf.h>
+#include <jailhouse/printk.h>
+#include <asm/gic_v2.h>
+#include <asm/gic_v3.h>
+#include <asm/perf.h>
+#include <asm/pmu.h>
+#include <asm/pmu_events.h>
+#include <asm/sysregs.h>
+#include <asm/timer.h>
+
+/*
+ * One EL2 counter counts the configured event of the guest. Each overflow
+ * records the interrupted guest PC into the ring of the CPU and reloads the
+ * counter, so a sample is taken every perf_period events. The overflow IRQ
+ * is taken from the guest, ELR_EL2 and SPSR_EL2 thus still describe it.
+ */
+
+/* Per-CPU sample rings, mapped read-only to the root cell */
+static struct perf_ring perf_rings[PERF_CPUS]
+	__attribute__((section(".perf")));
+
+static u32 perf_cnt;
+
+static void perf_record(void)
+{
+	struct perf_sample *sample;
+	struct perf_ring *ring;
+	unsigned long spsr;
+
+	if (this_cpu_id() >= PERF_CPUS)
+		return;
+
+	ring = &perf_rings[this_cpu_id()];
+	sample = &ring->samples[ring->head % PERF_ENTRIES];
+
+	sample->timestamp = timer_get_ticks();
+	arm_read_sysreg(ELR_EL2, sample->pc);
+	arm_read_sysreg(SPSR_EL2, spsr);
+	sample->cell_id = this_cell()->config->id;
+	/* EL0t and the AArch32 user mode share the zero mode field */
+	sample->flags = ((spsr & PSR_MODE_MASK) == 0 ? PERF_SAMPLE_USER : 0) |
+		((spsr & PSR_32_BIT) ? PERF_SAMPLE_AARCH32 : 0);
+
+	/* publish the sample before moving the head */
+	dmb(ish);
+	ring->head++;
+}
+
+static bool perf_isr_pmu(void)
+{
+	u32 period = this_cpu_data()->perf_sample_period;
+
+	pmu_clear_overflow(perf_cnt);
+	if (period == 0)
+		return true;
+
+	pmu_set_val(perf_cnt, -period);
+	perf_record();
+
+	return true;
+}
+
+void perf_init(void)
+{
+	perf_cnt = pmu_register(1, perf_isr_pmu);
+	pmu_print("Using PMU counter %u for sampling\n", perf_cnt);
+}
+
+void perf_cpu_update(void)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	struct perf_ring *ring = NULL;
+	u32 type;
+
+	if (!cpu_data->public.perf_update)
+		return;
+	cpu_data->public.perf_update = false;
+
+	pmu_disable(perf_cnt);
+	pmu_clear_overflow(perf_cnt);
+
+	cpu_data->perf_sample_period = cpu_data->public.perf_period;
+	if (this_cpu_id() < PERF_CPUS) {
+		ring = &perf_rings[this_cpu_id()];
+		ring->event_type = cpu_data->public.perf_event;
+		ring->period = cpu_data->public.perf_period;
+	}
+	if (cpu_data->public.perf_period == 0)
+		return;
+
+	type = cpu_data->public.perf_event;
+	if (type == 0)
+		type = PMUV3_PERFCTR_CPU_CYCLES;
+	/* only the guest is profiled */
+	type &= ~PMEVTYPER_NSH;
+
+	pmu_set_type(perf_cnt, type);
+	pmu_set_val(perf_cnt, -cpu_data->public.perf_period);
+	pmu_enable(perf_cnt);
+}
+
+/**
+ * Queue the configuration on every CPU of the bitmap and kick them, the
+ * local CPU applies it right away.
+ */
+int perf_set(struct per_cpu *cpu_data, unsigned long args_address)
+{
+	unsigned long offs = args_address & PAGE_OFFS_MASK;
+	struct public_per_cpu *target;
+	struct perf_args args;
+	unsigned int cpu;
+	void *mapping;
+
+	if (cpu_data->public.cell != &root_cell)
+		return -EPERM;
+
+	mapping = paging_get_guest_pages(NULL, args_address,
+					 PAGES(offs + sizeof(args)),
+					 PAGE_READONLY_FLAGS);
+	if (!mapping)
+		return -ENOMEM;
+	memcpy(&args, mapping + offs, sizeof(args));
+
+	if (args.cpus == 0 || (args.cpus >> PERF_CPUS) != 0 ||
+	    (args.period != 0 && args.period < PERF_MIN_PERIOD))
+		return -EINVAL;
+	for (cpu = 0; cpu < PERF_CPUS; cpu++)
+		if ((args.cpus & (1ULL << cpu)) && !cpu_id_valid(cpu))
+			return -EINVAL;
+
+	for (cpu = 0; cpu < PERF_CPUS; cpu++) {
+		if (!(args.cpus & (1ULL << cpu)))
+			continue;
+
+		target = public_per_cpu(cpu);
+		spin_lock(&target->control_lock);
+		target->perf_event = args.event_type;
+		target->perf_period = args.period;
+		target->perf_update = true;
+		if (cpu == this_cpu_id())
+			perf_cpu_update();
+		spin_unlock(&target->control_lock);
+
+		if (cpu != this_cpu_id())
+			arch_send_event(target);
+	}
+
+	return 0;
+}
@@ -20,16 +20,31 @@
 #include <jailhouse/panic.h>
 #include <asm/gic_v2.h>
 #include <asm/gic_v3.h>
+#include <asm/idle.h>
 #include <asm/pmu.h>
 
+/* memguard and the sampling profiler */
+#define PMU_MAX_CLIENTS	2
+
 static u32 pmu_first_cnt = 0;
-static bool (*_pmu_isr_handler)(void) = NULL;
+static u32 pmu_num_cnt = 0;
+
+/** Owner of a group of EL2 counters */
+struct pmu_client {
+	/** Bitmap of the counters of the client */
+	u32 mask;
+	bool (*handler)(void);
+};
+
+static struct pmu_client pmu_clients[PMU_MAX_CLIENTS];
+static unsigned int pmu_num_clients;
 
 void pmu_cpu_init(void)
 {
 	const struct jailhouse_memguard_config *mconf;
 	u32 mdcr;
 	u32 irq;
+	u32 cnt;
 
 	assert(pmu_first_cnt != 0);
 	arm_read_sysreg(MDCR_EL2, mdcr);
@@ -39,10 +54,12 @@ void pmu_cpu_init(void)
 	mdcr |= (MDCR_EL2_HPME | pmu_first_cnt);
 	arm_write_sysreg(MDCR_EL2, mdcr);
 
-	/* disable counter and reset overflow */
-	pmu_disable(pmu_first_cnt);
-	pmu_int_disable(pmu_first_cnt);
-	pmu_clear_overflow(pmu_first_cnt);
+	/* disable counters and reset overflow */
+	for (cnt = pmu_first_cnt; cnt < pmu_first_cnt + pmu_num_cnt; cnt++) {
+		pmu_disable(cnt);
+		pmu_int_disable(cnt);
+		pmu_clear_overflow(cnt);
+	}
 
 	/* Enable PMU IRQs for this CPU */
 	mconf = &system_config->platform_info.memguard;
@@ -58,7 +75,8 @@ void pmu_cpu_init(void)
 		pmu_print("irq %u, cpu %u, t 0x%x\n", irq, this_cpu_id(), gicv2_get_targets(irq));
 		gicv2_enable_irq(irq);
 	}
-	pmu_int_enable(pmu_first_cnt);
+	for (cnt = pmu_first_cnt; cnt < pmu_first_cnt + pmu_num_cnt; cnt++)
+		pmu_int_enable(cnt);
 
 	/* Enable PMCCNTR_EL0 */
 	pmu_enable(31);
@@ -69,56 +87,97 @@ void pmu_cpu_init(void)
 void pmu_cpu_shutdown(void)
 {
 	const struct jailhouse_memguard_config *mconf;
+	u32 cnt;
+
 	mconf = &system_config->platform_info.memguard;
 
 	pmu_disable_all();
-	pmu_disable(pmu_first_cnt);
-	pmu_int_disable(pmu_first_cnt);
+	for (cnt = pmu_first_cnt; cnt < pmu_first_cnt + pmu_num_cnt; cnt++) {
+		pmu_disable(cnt);
+		pmu_int_disable(cnt);
+	}
 	if (system_config->platform_info.arm.gic_version == 3)
 		gicv3_disable_irq(mconf->pmu_cpu_irq[this_cpu_id()]);
 	else
 		gicv2_disable_irq(mconf->pmu_cpu_irq[this_cpu_id()]);
 
-	if (ACCESS_ONCE(_pmu_isr_handler) != NULL) {
-		_pmu_isr_handler = NULL;
+	pmu_num_clients = 0;
+}
+
+void pmu_cpu_save(struct pmu_cpu_state *state)
+{
+	u32 cnt;
+
+	arm_read_sysreg(PMCR_EL0, state->pmcr);
+	arm_read_sysreg(PMCNTENSET_EL0, state->cntenset);
+	arm_read_sysreg(PMINTENSET_EL1, state->intenset);
+	for (cnt = pmu_first_cnt; cnt < pmu_first_cnt + pmu_num_cnt; cnt++) {
+		state->type[cnt] = pmu_get_type(cnt);
+		state->val[cnt] = pmu_get_val(cnt);
+	}
+}
+
+/* MDCR_EL2 has to be restored before, it assigns the counters to EL2 */
+void pmu_cpu_restore(const struct pmu_cpu_state *state)
+{
+	u32 cnt;
+
+	pmu_disable_all();
+	for (cnt = pmu_first_cnt; cnt < pmu_first_cnt + pmu_num_cnt; cnt++) {
+		pmu_set_type(cnt, state->type[cnt]);
+		pmu_set_val(cnt, state->val[cnt]);
+		pmu_clear_overflow(cnt);
 	}
+	arm_write_sysreg(PMINTENSET_EL1, state->intenset);
+	arm_write_sysreg(PMCNTENSET_EL0, state->cntenset);
+	/* no counter reset on the way back */
+	arm_write_sysreg(PMCR_EL0, state->pmcr & ~(PMCR_P | PMCR_C));
+	isb();
 }
 
 /**
  * Register the handler to be called upon PMU overflow iRQ.
- * Check availability for requested counters and
- * store the fist counter that will be (currently) used
- * by default.
- *
- * TODO: allow usage of more than one counter? Needed?
+ * Check availability for requested counters and reserve the
+ * last \a req_cnt counters to EL2, below those of earlier clients.
+ * The caller gets the first one, the remaining are contiguous.
  */
 int pmu_register(u32 req_cnt, bool (*handler)(void))
 {
+	struct pmu_client *client;
 	u32 arch_cnt;
 
 	/* Do the consistency checks at boot time on a CPU */
 	arm_read_sysreg(PMCR_EL0, arch_cnt);
 	arch_cnt = (arch_cnt >> PMCR_N_SHIFT) & PMCR_N_MASK;
 	/* one PMU should be always left to the OS */
-	if (req_cnt >= arch_cnt) {
+	if (pmu_num_cnt + req_cnt >= arch_cnt) {
 		printk("PMU: Invalid num PMUs: requested: %u, available %u\n",
-			req_cnt, arch_cnt - 1);
+			req_cnt, arch_cnt - pmu_num_cnt - 1);
 		panic_stop();
 	}
 
+	assert(pmu_num_clients < PMU_MAX_CLIENTS);
+
 	/* Save the first EL2+ reserved counter for later */
-	pmu_first_cnt = arch_cnt - req_cnt;
+	pmu_first_cnt = arch_cnt - pmu_num_cnt - req_cnt;
+	pmu_num_cnt += req_cnt;
 
-	assert(_pmu_isr_handler == NULL);
-	_pmu_isr_handler = handler;
+	client = &pmu_clients[pmu_num_clients++];
+	client->mask = ((1U << req_cnt) - 1) << pmu_first_cnt;
+	client->handler = handler;
 
 	return pmu_first_cnt;
 }
 
+/* Each client is called when one of its counters overflowed */
 bool pmu_isr_handler(void)
 {
-	if (_pmu_isr_handler != NULL)
-		return (*_pmu_isr_handler)();
-	else
-		return true;
+	u32 ovs = pmu_get_overflow();
+	unsigned int n;
+
+	for (n = 0; n < pmu_num_clients; n++)
+		if (ovs & pmu_clients[n].mask)
+			pmu_clients[n].handler();
+
+	return true;
 }
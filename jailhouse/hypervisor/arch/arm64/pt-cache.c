@@ -0,0 +1,267 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Prebuilt stage-2 tables of the root cell, see jailhouse/pt-cache.h. The
+ * driver places the image between the system configuration and the
+ * allocation bitmap of the memory pool, so its pages are pool pages marked
+ * used by paging_init. Non-root tables are installed where they are, the
+ * root table is copied to its aligned allocation.
+ *
+ * The image is trusted like the configuration it comes with. It is only
+ * checked against corruption and against being stale: the tables must form
+ * a tree in the order of the export, and the hashes must match.
+ */
+
+#include <jailhouse/control.h>
+#include <jailhouse/paging.h>
+#include <jailhouse/printk.h>
+#include <jailhouse/pt-cache.h>
+#include <jailhouse/string.h>
+#include <asm/pt_cache.h>
+#include <asm/spinlock.h>
+#include <generated/version.h>
+
+#define FNV_OFFSET_BASIS	0xcbf29ce484222325ULL
+#define FNV_PRIME		0x100000001b3ULL
+
+#define TABLE_ENTRIES		(PAGE_SIZE / sizeof(u64))
+
+struct export_state {
+	u8 *tables;
+	unsigned int next, max;
+};
+
+/** Hash of the configuration activating the hypervisor */
+static u64 config_hash;
+
+static spinlock_t export_lock;
+static struct jailhouse_pt_cache *exported;
+static unsigned int exported_pages;
+
+static u64 hash_bytes(u64 hash, const void *data, unsigned long size)
+{
+	const u8 *byte = data;
+
+	while (size-- > 0) {
+		hash ^= *byte++;
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+static bool is_table(const struct paging *paging, pt_entry_t pte)
+{
+	return paging->entry_valid(pte, PAGE_PRESENT_FLAGS) &&
+		paging->get_phys(pte, 0) == INVALID_PHYS_ADDR;
+}
+
+static unsigned int count_tables(const struct paging *paging,
+				 page_table_t pt, unsigned int pages)
+{
+	unsigned int n, count = pages;
+
+	for (n = 0; n < pages * TABLE_ENTRIES; n++)
+		if (is_table(paging, pt + n))
+			count += count_tables(paging + 1,
+				paging_phys2hvirt(paging->get_next_pt(pt + n)),
+				1);
+	return count;
+}
+
+/* depth-first, children numbered in the order of their entries */
+static int export_table(const struct paging *paging, page_table_t pt,
+			unsigned int pages, struct export_state *state)
+{
+	page_table_t copy;
+	unsigned int n, child;
+	int err;
+
+	if (state->next + pages > state->max)
+		return -ENOMEM;
+	copy = (page_table_t)(state->tables + state->next * PAGE_SIZE);
+	state->next += pages;
+	memcpy(copy, pt, pages * PAGE_SIZE);
+
+	for (n = 0; n < pages * TABLE_ENTRIES; n++) {
+		if (!is_table(paging, pt + n))
+			continue;
+		child = state->next;
+		err = export_table(paging + 1,
+			paging_phys2hvirt(paging->get_next_pt(pt + n)), 1,
+			state);
+		if (err)
+			return err;
+		paging->set_next_pt(copy + n, child * PAGE_SIZE);
+	}
+	return 0;
+}
+
+/* relocates pt in place, expecting the children in the order of export */
+static int install_table(const struct paging *paging, page_table_t pt,
+			 unsigned int pages, u8 *tables,
+			 unsigned int num_tables, unsigned int *next)
+{
+	unsigned long index;
+	page_table_t child;
+	pt_entry_t pte;
+	unsigned int n;
+	int err;
+
+	for (n = 0; n < pages * TABLE_ENTRIES; n++) {
+		pte = pt + n;
+		if (!paging->entry_valid(pte, PAGE_PRESENT_FLAGS))
+			continue;
+		if (paging->get_phys(pte, 0) != INVALID_PHYS_ADDR) {
+			/* no block mappings at this level */
+			if (paging->page_size == 0)
+				return -EINVAL;
+			continue;
+		}
+		if (paging->page_size == PAGE_SIZE)
+			return -EINVAL;
+
+		index = paging->get_next_pt(pte) / PAGE_SIZE;
+		if (index != *next || index >= num_tables)
+			return -EINVAL;
+		(*next)++;
+
+		child = (page_table_t)(tables + index * PAGE_SIZE);
+		paging->set_next_pt(pte, paging_hvirt2phys(child));
+		err = install_table(paging + 1, child, 1, tables, num_tables,
+				    next);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
+int pt_cache_install(struct paging_structures *pg_structs)
+{
+	unsigned long config_size = jailhouse_system_config_size(system_config);
+	unsigned int pages = hypervisor_header.pt_cache_pages;
+	unsigned int root_pages = CELL_ROOT_PT_PAGES;
+	struct jailhouse_pt_cache *image;
+	unsigned int next = root_pages;
+	u8 *tables;
+	int err;
+
+	config_hash = hash_bytes(FNV_OFFSET_BASIS, JAILHOUSE_VERSION,
+				 sizeof(JAILHOUSE_VERSION));
+	config_hash = hash_bytes(config_hash, &cpu_parange,
+				 sizeof(cpu_parange));
+	config_hash = hash_bytes(config_hash, system_config, config_size);
+
+	if (pages == 0)
+		return -ENOENT;
+
+	image = (void *)system_config + PAGE_ALIGN(config_size);
+	tables = (u8 *)image + PAGE_SIZE;
+
+	err = -EINVAL;
+	if (strncmp(image->signature, JAILHOUSE_PT_CACHE_SIGNATURE,
+		    sizeof(image->signature)) != 0 ||
+	    image->revision != JAILHOUSE_PT_CACHE_REVISION ||
+	    image->root_tables != root_pages ||
+	    image->num_tables + 1 != pages ||
+	    image->config_hash != config_hash ||
+	    image->tables_hash != hash_bytes(FNV_OFFSET_BASIS, tables,
+					     image->num_tables * PAGE_SIZE))
+		goto discard;
+
+	err = install_table(pg_structs->root_paging, (page_table_t)tables,
+			    root_pages, tables, image->num_tables, &next);
+	if (!err && next != image->num_tables)
+		err = -EINVAL;
+	if (err)
+		goto discard;
+
+	memcpy(pg_structs->root_table, tables, root_pages * PAGE_SIZE);
+	printk("Installed %d cached page tables of the root cell\n",
+	       image->num_tables);
+
+	/* the header and the root table are not needed anymore */
+	page_free(&mem_pool, image, 1 + root_pages);
+	return 0;
+
+discard:
+	printk("Discarding cached page tables of the root cell\n");
+	page_free(&mem_pool, image, pages);
+	hypervisor_header.pt_cache_pages = 0;
+	return err;
+}
+
+static long pt_cache_export(void)
+{
+	const struct paging_structures *pg_structs = &root_cell.arch.mm;
+	unsigned int root_pages = CELL_ROOT_PT_PAGES;
+	struct export_state state;
+	int err;
+
+	/* only the tables of the configuration can be handed back */
+	if (root_cell.next)
+		return -EBUSY;
+	if (exported)
+		return -EBUSY;
+
+	state.max = count_tables(pg_structs->root_paging,
+				 pg_structs->root_table, root_pages);
+	state.next = 0;
+	exported = page_alloc(&mem_pool, 1 + state.max);
+	if (!exported)
+		return -ENOMEM;
+	state.tables = (u8 *)exported + PAGE_SIZE;
+
+	err = export_table(pg_structs->root_paging, pg_structs->root_table,
+			   root_pages, &state);
+	if (err) {
+		page_free(&mem_pool, exported, 1 + state.max);
+		exported = NULL;
+		return err;
+	}
+
+	memcpy(exported->signature, JAILHOUSE_PT_CACHE_SIGNATURE,
+	       sizeof(exported->signature));
+	exported->revision = JAILHOUSE_PT_CACHE_REVISION;
+	exported->root_tables = root_pages;
+	exported->num_tables = state.next;
+	exported->config_hash = config_hash;
+	exported->tables_hash = hash_bytes(FNV_OFFSET_BASIS, state.tables,
+					   state.next * PAGE_SIZE);
+	exported_pages = 1 + state.max;
+
+	return paging_hvirt2phys(exported) -
+		system_config->hypervisor_memory.phys_start;
+}
+
+long pt_cache_call(struct per_cpu *cpu_data, unsigned long op)
+{
+	long ret;
+
+	if (cpu_data->public.cell != &root_cell)
+		return -EPERM;
+
+	spin_lock(&export_lock);
+	switch (op) {
+	case JAILHOUSE_PT_CACHE_EXPORT:
+		ret = pt_cache_export();
+		break;
+	case JAILHOUSE_PT_CACHE_RELEASE:
+		ret = -EINVAL;
+		if (exported) {
+			page_free(&mem_pool, exported, exported_pages);
+			exported = NULL;
+			ret = 0;
+		}
+		break;
+	default:
+		ret = -EINVAL;
+	}
+	spin_unlock(&export_lock);
+
+	return ret;
+}
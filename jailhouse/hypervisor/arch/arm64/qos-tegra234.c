@@ -0,0 +1,218 @@
+/*
+ * ARM QoS Support for Jailhouse. Tegra234 memory controller backend.
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/printk.h>
+#include <jailhouse/mmio.h>
+#include <jailhouse/cell.h>
+#include <jailhouse/paging.h>
+#include <jailhouse/control.h>
+#include <jailhouse/qos-common.h>
+#include <asm/qos-tegra234.h>
+#include <asm/qos.h>
+
+/*
+ * Orin has no QoS-400 regulators in front of its DMA masters. Bandwidth
+ * shares are instead controlled in the MC arbiter: the latency allowance of
+ * each client, the rates of the PTSA groups and the throttling of the
+ * arbitration rings. See asm/qos-tegra234.h for how devices map onto them.
+ */
+
+#ifdef CONFIG_DEBUG
+#define mc_print(fmt, ...)			\
+	printk_deferred("[QoS] " fmt, ##__VA_ARGS__)
+#else
+#define mc_print(fmt, ...) do { } while (0)
+#endif
+
+static void *mc_base;
+/* Register values before the first change, MC_PTSA_REGS per device */
+static u32 *mc_saved;
+
+static const struct qos_param mc_params[] = {
+	{
+		.name = "la_read",
+		.reg = 0,
+		.enable = MC_QOS_LA,
+		.shift = MC_LA_READ_SHIFT,
+		.mask = MC_LA_MASK,
+	},
+	{
+		.name = "la_write",
+		.reg = 0,
+		.enable = MC_QOS_LA,
+		.shift = MC_LA_WRITE_SHIFT,
+		.mask = MC_LA_MASK,
+	},
+	{
+		.name = "ptsa_rate",
+		.reg = MC_PTSA_RATE,
+		.enable = MC_QOS_PTSA,
+		.shift = 0,
+		.mask = MC_PTSA_RATE_MASK,
+	},
+	{
+		.name = "ptsa_min",
+		.reg = MC_PTSA_MIN,
+		.enable = MC_QOS_PTSA,
+		.shift = 0,
+		.mask = MC_PTSA_MINMAX_MASK,
+	},
+	{
+		.name = "ptsa_max",
+		.reg = MC_PTSA_MAX,
+		.enable = MC_QOS_PTSA,
+		.shift = 0,
+		.mask = MC_PTSA_MINMAX_MASK,
+	},
+	{
+		.name = "throttle_low",
+		.reg = 0,
+		.enable = MC_QOS_RING,
+		.shift = MC_RING_LOW_SHIFT,
+		.mask = MC_RING_MASK,
+	},
+	{
+		.name = "throttle_high",
+		.reg = 0,
+		.enable = MC_QOS_RING,
+		.shift = MC_RING_HIGH_SHIFT,
+		.mask = MC_RING_MASK,
+	},
+};
+
+static unsigned int mc_dev_regs(const struct jailhouse_qos_device *dev)
+{
+	return (dev->flags & MC_QOS_PTSA) ? MC_PTSA_REGS : 1;
+}
+
+static int tegra234_mc_init(void)
+{
+	const struct jailhouse_qos_device *devices =
+		jailhouse_cell_qos_devices(root_cell.config);
+	unsigned long base = system_config->platform_info.qos.nic_base;
+	unsigned long size = system_config->platform_info.qos.nic_size;
+	unsigned int num = root_cell.config->num_qos_devices;
+	unsigned int n, r;
+
+	if (num == 0)
+		return -ENOSYS;
+	if (size < MC_TIMING_CONTROL + 4)
+		return trace_error(-EINVAL);
+
+	/* only one kind of register block per device */
+	for (n = 0; n < num; n++) {
+		if (devices[n].flags != MC_QOS_LA &&
+		    devices[n].flags != MC_QOS_PTSA &&
+		    devices[n].flags != MC_QOS_RING)
+			return trace_error(-EINVAL);
+		if (devices[n].base > size - mc_dev_regs(&devices[n]) * 4)
+			return trace_error(-EINVAL);
+	}
+
+	mc_base = paging_map_device(base, size);
+	if (!mc_base)
+		return -ENOMEM;
+
+	mc_saved = page_alloc(&mem_pool,
+			      PAGES(num * MC_PTSA_REGS * sizeof(u32)));
+	if (!mc_saved) {
+		paging_unmap_device(base, mc_base, size);
+		mc_base = NULL;
+		return -ENOMEM;
+	}
+
+	for (n = 0; n < num; n++)
+		for (r = 0; r < mc_dev_regs(&devices[n]); r++)
+			mc_saved[n * MC_PTSA_REGS + r] =
+				mmio_read32(mc_base + devices[n].base + r * 4);
+
+	return 0;
+}
+
+static int tegra234_mc_compile(const struct qos_setting *settings,
+			       unsigned long count,
+			       struct qos_reg_write *writes, unsigned int max)
+{
+	const struct jailhouse_qos_device *dev = NULL;
+	const struct qos_param *param;
+	unsigned int num = 0;
+	unsigned long i;
+	int err;
+
+	for (i = 0; i < count; i++) {
+		if (settings[i].dev_name[0])
+			dev = qos_dev_find_by_name(settings[i].dev_name);
+		if (!dev)
+			return -ENODEV;
+
+		param = qos_param_find_by_name(mc_params,
+					       ARRAY_SIZE(mc_params),
+					       settings[i].param_name);
+		if (!param)
+			return -EINVAL;
+		if (!(dev->flags & param->enable))
+			return -ENOSYS;
+		if (settings[i].value > param->mask)
+			return -ERANGE;
+
+		mc_print("MC: Dev [%s], Param [%s] = 0x%08x (reg off: "
+			 "+0x%08x)\n", dev->name, param->name,
+			 settings[i].value, dev->base + param->reg);
+
+		err = qos_add_write(writes, &num, max, dev->base + param->reg,
+				    param->mask << param->shift,
+				    settings[i].value << param->shift);
+		if (err)
+			return err;
+	}
+
+	return num;
+}
+
+static void tegra234_mc_write(const struct qos_reg_write *writes,
+			      unsigned int num)
+{
+	const struct qos_reg_write *w;
+	void *reg;
+	u32 val;
+
+	for (w = writes; w < writes + num; w++) {
+		reg = mc_base + w->offset;
+		val = w->value;
+		if (w->mask != ~0U)
+			val |= mmio_read32(reg) & ~w->mask;
+		mmio_write32(reg, val);
+	}
+
+	/* the arbiter takes over all shadowed values at once */
+	mmio_write32(mc_base + MC_TIMING_CONTROL, MC_TIMING_UPDATE);
+}
+
+static int tegra234_mc_disable(void)
+{
+	const struct jailhouse_qos_device *devices =
+		jailhouse_cell_qos_devices(root_cell.config);
+	unsigned int n, r;
+
+	for (n = 0; n < root_cell.config->num_qos_devices; n++)
+		for (r = 0; r < mc_dev_regs(&devices[n]); r++)
+			mmio_write32(mc_base + devices[n].base + r * 4,
+				     mc_saved[n * MC_PTSA_REGS + r]);
+
+	mmio_write32(mc_base + MC_TIMING_CONTROL, MC_TIMING_UPDATE);
+
+	return 0;
+}
+
+const struct qos_backend tegra234_mc_backend = {
+	.init = tegra234_mc_init,
+	.compile = tegra234_mc_compile,
+	.write = tegra234_mc_write,
+	.disable = tegra234_mc_disable,
+};
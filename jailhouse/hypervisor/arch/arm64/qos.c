@@ -26,7 +26,7 @@
 
 #ifdef CONFIG_DEBUG
 #define qos_print(fmt, ...)			\
-	printk("[QoS] " fmt, ##__VA_ARGS__)
+	printk_deferred("[QoS] " fmt, ##__VA_ARGS__)
 #else
 #define qos_print(fmt, ...) do { } while (0)
 #endif
@@ -191,16 +191,6 @@ static const struct qos_param params[QOS_PARAMS] = {
 	},
 };
 
-/* Return the address of the configuration register to be used to set
- * the desired paramter for the selected device */
-static inline void* reg_qos_par(
-		const struct jailhouse_qos_device *dev,
-		const struct qos_param *param)
-{
-	assert(nic_base != NULL);
-	return (void *)(nic_base + (__u64)dev->base + (__u64)param->reg);
-}
-
 static inline void* reg_qos_off(
 		const struct jailhouse_qos_device *dev,
 		__u64 off)
@@ -210,7 +200,7 @@ static inline void* reg_qos_off(
 }
 
 /* Find QoS-enabled device by name */
-static inline const struct jailhouse_qos_device* qos_dev_find_by_name(char *name)
+const struct jailhouse_qos_device *qos_dev_find_by_name(const char *name)
 {
 	const struct jailhouse_qos_device *devices;
 	devices = jailhouse_cell_qos_devices(root_cell.config);
@@ -225,39 +215,42 @@ static inline const struct jailhouse_qos_device* qos_dev_find_by_name(char *name
 }
 
 
-/* Find QoS parameter by name */
-static inline const struct qos_param *qos_param_find_by_name(char *name)
+/* Find QoS parameter of a backend by name */
+const struct qos_param *qos_param_find_by_name(const struct qos_param *table,
+					       unsigned int num,
+					       const char *name)
 {
-	for (unsigned i = 0; i < QOS_PARAMS; ++i) {
-		if (strncmp(name, params[i].name, QOS_PARAM_NAMELEN) == 0) {
-			return &params[i];
+	for (unsigned i = 0; i < num; ++i) {
+		if (strncmp(name, table[i].name, QOS_PARAM_NAMELEN) == 0) {
+			return &table[i];
 		}
 	}
 
 	return NULL;
 }
 
-/* Low-level functions to configure different aspects of the QoS
- * infrastructure */
-
-/* This function sets a given parameter to the desired value. It does
- * not enable the corresponding interface */
-static inline int qos_set_param(
-	const struct jailhouse_qos_device *dev,
-	const struct qos_param *param,
-	unsigned long value)
+/* Queue a change of the bits in mask to value at offset, merging it into an
+ * earlier write of the same register. Returns -E2BIG when max is reached. */
+int qos_add_write(struct qos_reg_write *writes, unsigned int *num,
+		  unsigned int max, u32 offset, u32 mask, u32 value)
 {
-	void *reg = reg_qos_par(dev, param);
-	__u32 regval;
-
-	/* TODO check that device supports this parameter */
-	qos_print("QoS: Dev [%s], Param [%s] = 0x%08lx (reg off: +0x%08llx)\n",
-	       dev->name, param->name, value, (__u64)(reg - nic_base));
+	struct qos_reg_write *w;
+
+	for (w = writes; w < writes + *num; w++)
+		if (w->offset == offset)
+			break;
+
+	if (w == writes + *num) {
+		if (*num == max)
+			return -E2BIG;
+		w->offset = offset;
+		w->mask = 0;
+		w->value = 0;
+		(*num)++;
+	}
 
-	regval = qos_read32(reg);
-	regval &= ~(param->mask << param->shift);
-	regval |= ((value & param->mask) << param->shift);
-	qos_write32(reg, regval);
+	w->mask |= mask;
+	w->value = (w->value & ~mask) | (value & mask);
 
 	return 0;
 }
@@ -285,22 +278,31 @@ static inline void qos_set_enable(
 	qos_write32(reg, value);
 }
 
-/* Main function to apply a set of QoS paramters passed via the array
- * settings. The length of the array is specified in the second
- * parameter. */
-static int qos_apply_settings(struct qos_setting *settings, int count)
+/* Translate a set of QoS paramters passed via the array settings into
+ * register writes. Each consecutive group of settings of a device ends
+ * with a write of its QOS_CNTL register enabling the affected
+ * interfaces. */
+static int qos400_compile(const struct qos_setting *settings,
+			  unsigned long count, struct qos_reg_write *writes,
+			  unsigned int max)
 {
 	const struct jailhouse_qos_device *cur_dev = NULL;
 	const struct qos_param *param;
+	unsigned int num = 0;
 	__u32 enable_val = 0;
+	int err;
 
-	for (int i = 0; i < count; ++i) {
-		char *dev_name = settings[i].dev_name;
+	for (unsigned long i = 0; i < count; ++i) {
+		const char *dev_name = settings[i].dev_name;
 
 		/* We are about to change device. Set the enable
 		 * register for the current device */
 		if (dev_name[0] && cur_dev) {
-			qos_set_enable(cur_dev, enable_val);
+			err = qos_add_write(writes, &num, max,
+					    cur_dev->base + QOS_CNTL, ~0U,
+					    enable_val & ~(1 << EN_NO_ENABLE));
+			if (err)
+				return err;
 			enable_val = 0;
 		}
 
@@ -311,7 +313,8 @@ static int qos_apply_settings(struct qos_setting *settings, int count)
 		if(cur_dev == NULL)
 			return -ENODEV;
 
-		param = qos_param_find_by_name(settings[i].param_name);
+		param = qos_param_find_by_name(params, QOS_PARAMS,
+					       settings[i].param_name);
 		if(param == NULL)
 			return -EINVAL;
 
@@ -319,18 +322,46 @@ static int qos_apply_settings(struct qos_setting *settings, int count)
 		if(!qos_dev_is_capable(cur_dev, param))
 			return -ENOSYS;
 
+		qos_print("QoS: Dev [%s], Param [%s] = 0x%08x (reg off: "
+			  "+0x%08x)\n", cur_dev->name, param->name,
+			  settings[i].value, cur_dev->base + param->reg);
+
 		enable_val |= 1 << param->enable;
-		qos_set_param(cur_dev, param, settings[i].value);
+		err = qos_add_write(writes, &num, max,
+				    cur_dev->base + param->reg,
+				    param->mask << param->shift,
+				    settings[i].value << param->shift);
+		if (err)
+			return err;
 	}
 
+	if (!cur_dev)
+		return -EINVAL;
+
 	/* Apply settings for the last device */
-	qos_set_enable(cur_dev, enable_val);
+	err = qos_add_write(writes, &num, max, cur_dev->base + QOS_CNTL, ~0U,
+			    enable_val & ~(1 << EN_NO_ENABLE));
 
-	return 0;
+	return err ? err : (int)num;
+}
+
+static void qos400_write(const struct qos_reg_write *writes, unsigned int num)
+{
+	const struct qos_reg_write *w;
+	void *reg;
+	u32 val;
+
+	for (w = writes; w < writes + num; w++) {
+		reg = nic_base + w->offset;
+		val = w->value;
+		if (w->mask != ~0U)
+			val |= qos_read32(reg) & ~w->mask;
+		qos_write32(reg, val);
+	}
 }
 
 /* Clear the QOS_CNTL register for all the devices */
-static int qos_disable_all(void)
+static int qos400_disable(void)
 {
 	const struct jailhouse_qos_device *devices;
 	devices = jailhouse_cell_qos_devices(root_cell.config);
@@ -343,22 +374,82 @@ static int qos_disable_all(void)
 	return 0;
 }
 
-/* Main entry point for QoS management call */
-int qos_call(unsigned long count, unsigned long settings_ptr)
+static int qos400_init(void)
+{
+	nic_base = qos_map_device(
+		(unsigned long)system_config->platform_info.qos.nic_base,
+		(unsigned long)system_config->platform_info.qos.nic_size);
+
+	return nic_base ? 0 : -ENOSYS;
+}
+
+const struct qos_backend qos400_backend = {
+	.init = qos400_init,
+	.compile = qos400_compile,
+	.write = qos400_write,
+	.disable = qos400_disable,
+};
+
+#define QOS_MAX_WRITES		(PAGE_SIZE / sizeof(struct qos_reg_write))
+
+struct qos_profile {
+	struct qos_reg_write *writes;
+	unsigned int num_writes;
+};
+
+/* Backend of the platform, NULL until the first call */
+static const struct qos_backend *backend;
+static spinlock_t qos_lock;
+/* Output of backend->compile, one page */
+static struct qos_reg_write *qos_scratch;
+static struct qos_profile profiles[QOS_MAX_PROFILES];
+
+static int qos_backend_init(void)
+{
+	const struct qos_backend *new_backend;
+	int err;
+
+	if (backend)
+		return 0;
+
+	switch (system_config->platform_info.qos.type) {
+	case JAILHOUSE_QOS_NIC400:
+		new_backend = &qos400_backend;
+		break;
+	case JAILHOUSE_QOS_TEGRA234_MC:
+		new_backend = &tegra234_mc_backend;
+		break;
+	default:
+		return -ENOSYS;
+	}
+
+	qos_scratch = page_alloc(&mem_pool, 1);
+	if (!qos_scratch)
+		return -ENOMEM;
+
+	err = new_backend->init();
+	if (err) {
+		page_free(&mem_pool, qos_scratch, 1);
+		qos_scratch = NULL;
+		return err;
+	}
+	backend = new_backend;
+
+	return 0;
+}
+
+static int qos_locked_call(unsigned long count, unsigned long settings_ptr)
 {
 	unsigned long sett_page_offs = settings_ptr & ~PAGE_MASK;
 	unsigned int sett_pages;
 	void *sett_mapping;
 	struct qos_setting *settings;
+	int num;
 
-	/* Check if the NIC needs to be mapped */
-	if (nic_base == NULL) {
-		nic_base = qos_map_device(
-			(unsigned long)system_config->platform_info.qos.nic_base,
-			(unsigned long)system_config->platform_info.qos.nic_size);
-		if (nic_base == NULL)
-			return -ENOSYS;
-	}
+	/* Check if the QoS registers need to be mapped */
+	num = qos_backend_init();
+	if (num)
+		return num;
 
 	/* The settings currently reside in kernel memory. Use
 	 * temporary mapping to make the settings readable by the
@@ -375,9 +466,148 @@ int qos_call(unsigned long count, unsigned long settings_ptr)
 	settings = (struct qos_setting *)(sett_mapping + sett_page_offs);
 	/* Check if the user has requestes QoS control to be disabled */
 	if ((count > 0) && (strncmp("disable", settings[0].dev_name, 8) == 0)) {
-		return qos_disable_all();
+		return backend->disable();
 	}
 
 	/* Otherwise, just apply the parameters */
-	return qos_apply_settings(settings, count);
+	num = backend->compile(settings, count, qos_scratch, QOS_MAX_WRITES);
+	if (num < 0)
+		return num;
+	backend->write(qos_scratch, num);
+
+	return 0;
+}
+
+/* Main entry point for QoS management call */
+int qos_call(unsigned long count, unsigned long settings_ptr)
+{
+	int err;
+
+	/* regulators may throttle other cells, leave them to the root cell */
+	if (this_cell() != &root_cell)
+		return -EPERM;
+
+	spin_lock(&qos_lock);
+	err = qos_locked_call(count, settings_ptr);
+	spin_unlock(&qos_lock);
+
+	return err;
+}
+
+static void qos_profile_release(struct qos_profile *profile)
+{
+	page_free(&mem_pool, profile->writes,
+		  PAGES(profile->num_writes * sizeof(struct qos_reg_write)));
+	profile->writes = NULL;
+	profile->num_writes = 0;
+}
+
+static int qos_locked_profile_set(unsigned long args_ptr)
+{
+	unsigned long offs = args_ptr & ~PAGE_MASK;
+	const struct qos_profile_args *args;
+	struct qos_reg_write *writes;
+	struct qos_profile *profile;
+	unsigned int id, count;
+	int num;
+
+	num = qos_backend_init();
+	if (num)
+		return num;
+
+	args = paging_get_guest_pages(NULL, args_ptr,
+				      PAGES(offs + sizeof(*args)),
+				      PAGE_READONLY_FLAGS);
+	if (!args)
+		return -ENOMEM;
+	args = (void *)args + offs;
+
+	id = args->id;
+	count = args->num_settings;
+	if (id >= QOS_MAX_PROFILES)
+		return -EINVAL;
+	if (count > QOS_PROFILE_MAX_SETTINGS)
+		return -E2BIG;
+
+	profile = &profiles[id];
+	if (count == 0) {
+		qos_profile_release(profile);
+		return 0;
+	}
+
+	args = paging_get_guest_pages(NULL, args_ptr,
+				      PAGES(offs + sizeof(*args) +
+					    count * sizeof(struct qos_setting)),
+				      PAGE_READONLY_FLAGS);
+	if (!args)
+		return -ENOMEM;
+	args = (void *)args + offs;
+
+	num = backend->compile(args->settings, count, qos_scratch,
+			       QOS_MAX_WRITES);
+	if (num < 0)
+		return num;
+
+	writes = page_alloc(&mem_pool,
+			    PAGES(num * sizeof(struct qos_reg_write)));
+	if (!writes)
+		return -ENOMEM;
+	memcpy(writes, qos_scratch, num * sizeof(struct qos_reg_write));
+
+	qos_profile_release(profile);
+	profile->writes = writes;
+	profile->num_writes = num;
+
+	return 0;
+}
+
+/* Compile and store the settings of a profile, replacing an older one */
+int qos_profile_set(unsigned long args_ptr)
+{
+	int err;
+
+	if (this_cell() != &root_cell)
+		return -EPERM;
+
+	spin_lock(&qos_lock);
+	err = qos_locked_profile_set(args_ptr);
+	spin_unlock(&qos_lock);
+
+	return err;
+}
+
+/* Check that profile id is registered, without applying it */
+int qos_profile_check(unsigned long id)
+{
+	int err = 0;
+
+	if (id >= QOS_MAX_PROFILES)
+		return -EINVAL;
+
+	spin_lock(&qos_lock);
+	if (!profiles[id].writes)
+		err = -ENOENT;
+	spin_unlock(&qos_lock);
+
+	return err;
+}
+
+/* Apply a registered profile: only its register writes are left to do */
+int qos_profile_apply(unsigned long id)
+{
+	int err = 0;
+
+	if (this_cell() != &root_cell)
+		return -EPERM;
+	if (id >= QOS_MAX_PROFILES)
+		return -EINVAL;
+
+	spin_lock(&qos_lock);
+	if (profiles[id].writes)
+		backend->write(profiles[id].writes, profiles[id].num_writes);
+	else
+		err = -ENOENT;
+	spin_unlock(&qos_lock);
+
+	return err;
 }
@@ -0,0 +1,511 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Time-shared CPUs: a CPU listed by two cells with JAILHOUSE_CELL_CPU_SHARED
+ * keeps one vCPU context per cell and runs them in turn, following a cyclic
+ * table of windows set by the root cell (JAILHOUSE_HC_CPU_SCHEDULE). Windows
+ * are timed by the hypervisor timer with absolute deadlines, the frame does
+ * not drift. A window of a powered-off vCPU is left to the other one.
+ *
+ * The switch happens at the end of a trap or interrupt exit of the CPU
+ * itself, where no handler holds registers of the outgoing vCPU.
+ * public_per_cpu holds the control fields of the running vCPU as on any CPU,
+ * the context of the other one keeps its own, plus the interrupts raised for
+ * it meanwhile. They are injected when it runs again, so its latency is
+ * bounded by the window length of the other cell.
+ *
+ * Only AArch64 cells on GICv3 without SDEI, and two cells per CPU. Memguard,
+ * the statistics and the failed state stay per physical CPU, the PMU and
+ * debug state are not switched. Cells sharing CPUs cannot be saved and their
+ * shared CPUs not moved.
+ */
+
+#include <jailhouse/control.h>
+#include <jailhouse/paging.h>
+#include <jailhouse/printk.h>
+#include <jailhouse/string.h>
+#include <asm/control.h>
+#include <asm/irqchip.h>
+#include <asm/psci.h>
+#include <asm/sched.h>
+#include <asm/smccc.h>
+#include <asm/snapshot.h>
+#include <asm/sysregs.h>
+#include <asm/timer64.h>
+
+/* the other vCPU if it belongs to cell, NULL if cell runs or is not there */
+static struct sched_vcpu *switched_out(struct sched_cpu *sched,
+				       struct cell *cell)
+{
+	struct sched_vcpu *vcpu = &sched->vcpu[!sched->running];
+
+	return sched->shared && cell && vcpu->cell == cell ? vcpu : NULL;
+}
+
+static bool vcpu_off(const struct sched_vcpu *vcpu)
+{
+	return vcpu->wait_for_poweron && !vcpu->reset;
+}
+
+/*
+ * Selects the vCPU of the current window, or the other one if it is powered
+ * off. Called by the CPU under its control_lock.
+ */
+static void sched_select_slot(struct public_per_cpu *cpu_public)
+{
+	struct sched_cpu *sched = &cpu_public->sched;
+	unsigned int vcpu = sched->table.vcpu[sched->slot];
+	bool off;
+
+	if (vcpu == sched->running)
+		off = cpu_public->wait_for_poweron && !cpu_public->reset;
+	else
+		off = vcpu_off(&sched->vcpu[vcpu]);
+	if (off)
+		vcpu = !vcpu;
+
+	sched->next = vcpu;
+	sched->switch_pending = vcpu != sched->running;
+}
+
+static void sched_timer_expired(struct timer_event *event)
+{
+	struct public_per_cpu *cpu_public = this_cpu_public();
+	struct sched_cpu *sched = &cpu_public->sched;
+	u64 now = timer_get_ticks();
+
+	if (!sched->shared)
+		return;
+
+	sched->slot = (sched->slot + 1) % sched->table.num_slots;
+	sched->slot_end += sched->table.ticks[sched->slot];
+	/* held up for longer than a window, restart the frame from now */
+	if (sched->slot_end <= now)
+		sched->slot_end = now + sched->table.ticks[sched->slot];
+	timer_event_arm(event, sched->slot_end);
+
+	spin_lock(&cpu_public->control_lock);
+	sched_select_slot(cpu_public);
+	spin_unlock(&cpu_public->control_lock);
+}
+
+void sched_cpu_update(void)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	struct sched_cpu *sched = &cpu_data->public.sched;
+
+	if (!sched->update)
+		return;
+	sched->update = false;
+
+	if (!sched->shared) {
+		timer_event_cancel(&cpu_data->sched_timer);
+		return;
+	}
+
+	sched->table = sched->staged;
+	sched->slot = 0;
+	sched->slot_end = timer_get_ticks() + sched->table.ticks[0];
+	cpu_data->sched_timer.handler = sched_timer_expired;
+	timer_event_arm(&cpu_data->sched_timer, sched->slot_end);
+
+	sched_select_slot(&cpu_data->public);
+}
+
+void sched_take_requests(struct public_per_cpu *cpu_public)
+{
+	struct sched_cpu *sched = &cpu_public->sched;
+	struct sched_vcpu *vcpu;
+
+	if (!sched->selected)
+		return;
+
+	vcpu = switched_out(sched, sched->selected);
+	sched->selected = NULL;
+	if (!vcpu)
+		return;
+
+	vcpu->park |= cpu_public->park;
+	vcpu->reset |= cpu_public->reset;
+	cpu_public->park = false;
+	cpu_public->reset = false;
+}
+
+static void vcpu_save_hw(struct per_cpu *cpu_data, struct sched_vcpu *vcpu)
+{
+	vcpu_state_save(&vcpu->regs);
+	irqchip_cpu_save(&vcpu->gic);
+	memcpy(vcpu->lr_irq, cpu_data->lr_irq, sizeof(vcpu->lr_irq));
+	vcpu->lr_shadow = cpu_data->lr_shadow;
+	memcpy(vcpu->lr_irq_bitmap, cpu_data->lr_irq_bitmap,
+	       sizeof(vcpu->lr_irq_bitmap));
+	vcpu->saved = true;
+}
+
+static void vcpu_load_hw(struct per_cpu *cpu_data, struct sched_vcpu *vcpu)
+{
+	struct cell *cell = vcpu->cell;
+
+	/* the TLB entries of both VMIDs stay, stale ones go on request */
+	arm_write_sysreg(VTTBR_EL2,
+			 ((u64)cell->config->id << VTTBR_VMID_SHIFT) |
+			 (paging_hvirt2phys(cell->arch.mm.root_table) &
+			  TTBR_MASK));
+	isb();
+
+	if (!vcpu->saved)
+		return;
+
+	vcpu_state_load(&vcpu->regs);
+	irqchip_cpu_restore(&vcpu->gic);
+	memcpy(cpu_data->lr_irq, vcpu->lr_irq, sizeof(cpu_data->lr_irq));
+	cpu_data->lr_shadow = vcpu->lr_shadow;
+	memcpy(cpu_data->lr_irq_bitmap, vcpu->lr_irq_bitmap,
+	       sizeof(cpu_data->lr_irq_bitmap));
+}
+
+void sched_cpu_switch(void)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	struct public_per_cpu *cpu_public = &cpu_data->public;
+	struct sched_cpu *sched = &cpu_public->sched;
+	struct sched_vcpu *out, *in;
+	unsigned int word, bit;
+	unsigned long bits;
+
+	spin_lock(&cpu_public->control_lock);
+	sched->switch_pending = false;
+	if (sched->next == sched->running) {
+		spin_unlock(&cpu_public->control_lock);
+		return;
+	}
+	out = &sched->vcpu[sched->running];
+	in = &sched->vcpu[sched->next];
+
+	/* what is still queued belongs to the outgoing vCPU */
+	irqchip_drain_pending(out->deferred);
+
+	if (out->cell) {
+		out->wait_for_poweron = cpu_public->wait_for_poweron;
+		out->reset = cpu_public->reset;
+		out->park = cpu_public->park;
+		out->flush_vcpu_caches = cpu_public->flush_vcpu_caches;
+		out->cpu_on_entry = cpu_public->cpu_on_entry;
+		out->cpu_on_context = cpu_public->cpu_on_context;
+	} else {
+		/* left by a destroyed cell, see arch_cpu_unshare */
+		memset(out->deferred, 0, sizeof(out->deferred));
+		sched->shared = false;
+		timer_event_cancel(&cpu_data->sched_timer);
+	}
+
+	cpu_public->cell = in->cell;
+	cpu_public->wait_for_poweron = in->wait_for_poweron;
+	cpu_public->reset = in->reset;
+	/* a vCPU without a context can only start via reset */
+	cpu_public->park = in->park || (!in->saved && !in->reset);
+	cpu_public->flush_vcpu_caches = in->flush_vcpu_caches;
+	cpu_public->cpu_on_entry = in->cpu_on_entry;
+	cpu_public->cpu_on_context = in->cpu_on_context;
+	in->reset = false;
+	in->park = false;
+	in->flush_vcpu_caches = false;
+
+	sched->running = sched->next;
+	spin_unlock(&cpu_public->control_lock);
+
+	/*
+	 * Requests for the vCPUs now go to the right context, only the
+	 * hardware state remains to be exchanged.
+	 */
+	if (out->cell)
+		vcpu_save_hw(cpu_data, out);
+	vcpu_load_hw(cpu_data, in);
+
+	for (word = 0; word < ARRAY_SIZE(in->deferred); word++) {
+		bits = in->deferred[word];
+		if (!bits)
+			continue;
+		in->deferred[word] = 0;
+		while (bits) {
+			bit = ffsl(bits);
+			bits &= ~(1UL << bit);
+			irqchip_set_pending(cpu_public,
+					    word * BITS_PER_LONG + bit);
+		}
+	}
+
+	/* park, reset or flush as requested while the vCPU was out */
+	arm_cpu_check_events();
+}
+
+bool __sched_set_pending(struct public_per_cpu *cpu_public, u16 irq_id)
+{
+	struct sched_cpu *sched = &cpu_public->sched;
+	struct sched_vcpu *running, *other;
+	struct cell *cell;
+
+	spin_lock(&cpu_public->control_lock);
+	if (!sched->shared) {
+		spin_unlock(&cpu_public->control_lock);
+		return false;
+	}
+
+	running = &sched->vcpu[sched->running];
+	other = &sched->vcpu[!sched->running];
+
+	/* SGIs come from the sender's cell, PPIs from the CPU's running one */
+	if (irq_id < 32)
+		cell = this_cell();
+	else
+		cell = irqchip_irq_in_cell(other->cell, irq_id) ?
+			other->cell : running->cell;
+
+	if (cell == other->cell)
+		set_bit(irq_id, other->deferred);
+	else
+		/* under the lock, the vCPU cannot be switched meanwhile */
+		irqchip_queue_irq(cpu_public, irq_id);
+
+	spin_unlock(&cpu_public->control_lock);
+	return true;
+}
+
+bool sched_cell_shared(struct cell *cell)
+{
+	unsigned int cpu;
+
+	for_each_cpu(cpu, cell->cpu_set)
+		if (sched_cpu_shared(cpu))
+			return true;
+	return false;
+}
+
+bool sched_wait_for_poweron(struct cell *cell, unsigned int cpu_id)
+{
+	struct public_per_cpu *cpu_public = public_per_cpu(cpu_id);
+	struct sched_vcpu *vcpu = switched_out(&cpu_public->sched, cell);
+
+	return vcpu ? vcpu->wait_for_poweron : cpu_public->wait_for_poweron;
+}
+
+void sched_set_cpu_on_entry(struct cell *cell, unsigned int cpu_id,
+			    unsigned long entry)
+{
+	struct public_per_cpu *cpu_public = public_per_cpu(cpu_id);
+	struct sched_vcpu *vcpu;
+
+	spin_lock(&cpu_public->control_lock);
+	vcpu = switched_out(&cpu_public->sched, cell);
+	if (vcpu)
+		vcpu->cpu_on_entry = entry;
+	else
+		cpu_public->cpu_on_entry = entry;
+	spin_unlock(&cpu_public->control_lock);
+}
+
+void sched_flush_vcpu_caches(struct cell *cell, unsigned int cpu_id)
+{
+	struct public_per_cpu *cpu_public = public_per_cpu(cpu_id);
+	struct sched_vcpu *vcpu;
+
+	spin_lock(&cpu_public->control_lock);
+	vcpu = switched_out(&cpu_public->sched, cell);
+	if (vcpu)
+		vcpu->flush_vcpu_caches = true;
+	else
+		cpu_public->flush_vcpu_caches = true;
+	spin_unlock(&cpu_public->control_lock);
+}
+
+bool sched_cpu_on(struct cell *cell, unsigned int cpu_id, unsigned long entry,
+		  unsigned long context, long *result)
+{
+	struct sched_vcpu *vcpu =
+		switched_out(&public_per_cpu(cpu_id)->sched, cell);
+
+	if (!vcpu)
+		return false;
+
+	if (vcpu->wait_for_poweron) {
+		vcpu->cpu_on_entry = entry;
+		vcpu->cpu_on_context = context;
+		vcpu->reset = true;
+		*result = PSCI_SUCCESS;
+	} else {
+		*result = PSCI_ALREADY_ON;
+	}
+	return true;
+}
+
+int arch_cpu_share_check(struct cell *cell, unsigned int cpu_id)
+{
+	struct public_per_cpu *cpu_public = public_per_cpu(cpu_id);
+	struct cell *owner = cpu_public->cell;
+
+	if (system_config->platform_info.arm.gic_version != 3 ||
+	    sdei_available)
+		return trace_error(-ENOSYS);
+
+	if ((cell->config->flags | owner->config->flags) &
+	    (JAILHOUSE_CELL_AARCH32 | JAILHOUSE_CELL_SDEI_IRQS))
+		return trace_error(-EINVAL);
+
+	/* two cells per CPU at most */
+	if (cpu_public->sched.shared)
+		return trace_error(-EBUSY);
+
+	return 0;
+}
+
+static void sched_default_table(struct sched_table *table)
+{
+	u64 ticks = timer_us_to_ticks(JAILHOUSE_SCHED_DEFAULT_SLOT_US);
+
+	table->num_slots = 2;
+	table->vcpu[0] = 0;
+	table->vcpu[1] = 1;
+	table->ticks[0] = ticks;
+	table->ticks[1] = ticks;
+}
+
+void arch_cpu_share(struct cell *cell, unsigned int cpu_id)
+{
+	struct public_per_cpu *cpu_public = public_per_cpu(cpu_id);
+	struct sched_cpu *sched = &cpu_public->sched;
+
+	spin_lock(&cpu_public->control_lock);
+	memset(sched, 0, sizeof(*sched));
+
+	/* the owner keeps running, its context is the live one */
+	sched->vcpu[0].cell = cpu_public->cell;
+
+	sched->vcpu[1].cell = cell;
+	sched->vcpu[1].wait_for_poweron = true;
+	sched->vcpu[1].cpu_on_entry = PSCI_INVALID_ADDRESS;
+
+	sched_default_table(&sched->staged);
+	sched->shared = true;
+	sched->update = true;
+	spin_unlock(&cpu_public->control_lock);
+
+	arch_send_event(cpu_public);
+}
+
+bool arch_cpu_unshare(struct cell *cell, unsigned int cpu_id)
+{
+	struct public_per_cpu *cpu_public = public_per_cpu(cpu_id);
+	struct sched_cpu *sched = &cpu_public->sched;
+	struct sched_vcpu *running;
+	bool kick = false;
+
+	spin_lock(&cpu_public->control_lock);
+	if (!sched->shared) {
+		spin_unlock(&cpu_public->control_lock);
+		return false;
+	}
+
+	running = &sched->vcpu[sched->running];
+	if (running->cell == cell) {
+		/*
+		 * The suspended CPU still holds the state of the cell. Hand it
+		 * to the other one now and let the switch drop that state.
+		 */
+		running->cell = NULL;
+		sched->next = !sched->running;
+		sched->switch_pending = true;
+		cpu_public->cell = sched->vcpu[sched->next].cell;
+		cpu_public->wait_for_poweron = false;
+		cpu_public->reset = false;
+		cpu_public->park = false;
+	} else {
+		sched->vcpu[!sched->running].cell = NULL;
+		sched->next = sched->running;
+		sched->switch_pending = false;
+		sched->shared = false;
+		sched->update = true;
+		kick = true;
+	}
+	spin_unlock(&cpu_public->control_lock);
+
+	if (kick)
+		arch_send_event(cpu_public);
+
+	return true;
+}
+
+void arch_cell_suspend_cpu(struct cell *cell, unsigned int cpu_id)
+{
+	struct public_per_cpu *cpu_public = public_per_cpu(cpu_id);
+
+	spin_lock(&cpu_public->control_lock);
+	if (cpu_public->sched.shared)
+		cpu_public->sched.selected = cell;
+	spin_unlock(&cpu_public->control_lock);
+}
+
+int arch_cpu_schedule(unsigned int cpu_id,
+		      const struct jailhouse_cpu_schedule *schedule)
+{
+	struct public_per_cpu *cpu_public = public_per_cpu(cpu_id);
+	struct sched_cpu *sched = &cpu_public->sched;
+	struct jailhouse_sched_slot slot;
+	struct sched_table table;
+	unsigned int n, vcpu, used = 0;
+	int err = 0;
+
+	/* read once, the root cell may change its copy meanwhile */
+	table.num_slots = schedule->num_slots;
+	if (table.num_slots == 0 ||
+	    table.num_slots > JAILHOUSE_SCHED_MAX_SLOTS)
+		return trace_error(-EINVAL);
+
+	spin_lock(&cpu_public->control_lock);
+	if (!sched->shared || !sched->vcpu[0].cell || !sched->vcpu[1].cell) {
+		err = trace_error(-EINVAL);
+		goto out;
+	}
+
+	for (n = 0; n < table.num_slots; n++) {
+		slot = schedule->slots[n];
+		if (slot.duration_us < JAILHOUSE_SCHED_MIN_SLOT_US) {
+			err = trace_error(-EINVAL);
+			goto out;
+		}
+		for (vcpu = 0; vcpu < 2; vcpu++)
+			if (sched->vcpu[vcpu].cell->config->id == slot.cell_id)
+				break;
+		if (vcpu == 2) {
+			err = trace_error(-ENOENT);
+			goto out;
+		}
+		table.vcpu[n] = vcpu;
+		table.ticks[n] = timer_us_to_ticks(slot.duration_us);
+		used |= 1 << vcpu;
+	}
+
+	/* each cell needs a window, or it would never run again */
+	if (used != 3) {
+		err = trace_error(-EINVAL);
+		goto out;
+	}
+
+	sched->staged = table;
+	sched->update = true;
+
+out:
+	spin_unlock(&cpu_public->control_lock);
+
+	if (!err) {
+		arch_send_event(cpu_public);
+		printk("Set schedule of CPU %d, %d windows\n", cpu_id,
+		       table.num_slots);
+	}
+
+	return err;
+}
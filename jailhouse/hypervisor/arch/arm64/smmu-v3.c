@@ -26,11 +26,16 @@
 
 #include <jailhouse/control.h>
 #include <jailhouse/paging.h>
+#include <jailhouse/parallel.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/string.h>
+#include <jailhouse/tracepoint.h>
 #include <asm/control.h>
 #include <jailhouse/unit.h>
+#include <asm/gic_v2.h>
+#include <asm/gic_v3.h>
 #include <asm/iommu.h>
+#include <asm/smmu.h>
 #include <jailhouse/cell.h>
 #include <jailhouse/mmio.h>
 
@@ -75,6 +80,7 @@
 
 #define ARM_SMMU_IDR2			0x8
 #define ARM_SMMU_IDR3			0xC
+#define IDR3_RIL			(1 << 10)
 #define ARM_SMMU_IDR4			0x10
 #define ARM_SMMU_IDR5			0x14
 
@@ -130,6 +136,7 @@
 
 #define ARM_SMMU_GERRORN		0x64
 #define ARM_SMMU_IRQ_CTRL		0x50
+#define IRQ_CTRL_EVTQ_IRQEN		(1 << 2)
 #define ARM_SMMU_IRQ_CTRLACK		0x54
 #define ARM_SMMU_GERROR_IRQ_CFG0	0x68
 #define ARM_SMMU_EVTQ_IRQ_CFG0		0xb0
@@ -211,6 +218,8 @@
 #define CMDQ_ENT_DWORDS			2
 #define CMDQ_ENT_SIZE			(CMDQ_ENT_DWORDS << 3)
 #define CMDQ_MAX_SZ_SHIFT		8
+/* Commands collected before they are written to the queue in one go */
+#define CMDQ_BATCH_ENTRIES		16
 
 #define CMDQ_CONS_ERR			BIT_MASK(30, 24)
 #define CMDQ_ERR_CERROR_NONE_IDX	0
@@ -229,9 +238,17 @@
 #define CMDQ_CFGI_1_LEAF		(1UL << 0)
 #define CMDQ_CFGI_1_RANGE		BIT_MASK(4, 0)
 
+#define CMDQ_TLBI_0_NUM			BIT_MASK(16, 12)
+#define CMDQ_TLBI_0_SCALE		BIT_MASK(24, 20)
 #define CMDQ_TLBI_0_VMID		BIT_MASK(47, 32)
 #define CMDQ_TLBI_0_ASID		BIT_MASK(63, 48)
 #define CMDQ_TLBI_1_LEAF		(1UL << 0)
+#define CMDQ_TLBI_1_TG			BIT_MASK(11, 10)
+/* Range invalidation: NUM + 1 times 2^SCALE granules, TG 1 for 4K */
+#define CMDQ_TLBI_RANGE_NUM_MAX		31
+#define CMDQ_TLBI_TG_4K			1
+/* Page-wise invalidations beyond which a VMID-wide one is issued instead */
+#define CMDQ_MAX_TLBI_OPS		128
 #define CMDQ_TLBI_1_VA_MASK		BIT_MASK(63, 12)
 #define CMDQ_TLBI_1_IPA_MASK		BIT_MASK(51, 12)
 
@@ -254,6 +271,11 @@
 #define EVTQ_MAX_SZ_SHIFT		7
 
 #define EVTQ_0_ID			BIT_MASK(7, 0)
+#define EVTQ_0_SID			BIT_MASK(63, 32)
+#define EVTQ_2_ADDR			BIT_MASK(63, 0)
+
+/* Streams with their own fault counters, first come first served */
+#define SMMU_FAULT_STREAMS		64
 
 #define ARM_SMMU_SYNC_TIMEOUT		1000000
 
@@ -276,6 +298,7 @@
 #define CMDQ_OP_TLBI_NSNH_ALL	0x30
 #define CMDQ_OP_CMD_SYNC	0x46
 #define ARM_SMMU_FEAT_2_LVL_STRTAB	(1 << 0)
+#define ARM_SMMU_FEAT_RANGE_INV		(1 << 2)
 
 /* High-level queue structures */
 struct arm_smmu_cmdq_ent {
@@ -303,6 +326,9 @@ struct arm_smmu_cmdq_ent {
 			u16			asid;
 			u16			vmid;
 			bool			leaf;
+			u8			num;
+			u8			scale;
+			u8			tg;
 			u64			addr;
 		} tlbi;
 
@@ -331,6 +357,12 @@ struct arm_smmu_cmdq {
 	spinlock_t			lock;
 };
 
+struct arm_smmu_cmdq_batch {
+	u64				cmds[CMDQ_BATCH_ENTRIES *
+					     CMDQ_ENT_DWORDS];
+	unsigned int			num;
+};
+
 struct arm_smmu_evtq {
 	struct arm_smmu_queue		q;
 };
@@ -360,9 +392,20 @@ struct arm_smmu_device {
 	struct arm_smmu_evtq		evtq;
 	unsigned int			sid_bits;
 	struct arm_smmu_strtab_cfg	strtab_cfg;
+	u32				evtq_irq;
 };
 
 static struct arm_smmu_device smmu_devices[JAILHOUSE_MAX_IOMMU_UNITS];
+static unsigned int num_evtq_irqs;
+
+/* Fault events of all SMMUs, drained from their event queues */
+static struct {
+	spinlock_t			lock;
+	unsigned int			num_streams;
+	u64				untracked;
+	u64				overflows;
+	struct jailhouse_iommu_fault	streams[SMMU_FAULT_STREAMS];
+} smmu_faults;
 
 /* Low-level queue manipulation functions */
 static bool queue_full(struct arm_smmu_queue *q)
@@ -403,6 +446,15 @@ static void queue_inc_prod(struct arm_smmu_queue *q)
 	mmio_write32(q->prod_reg, q->prod);
 }
 
+/* Consumer side of the event queue, published by writing cons_reg */
+static void queue_inc_cons(struct arm_smmu_queue *q)
+{
+	u32 shift = q->max_n_shift;
+	u32 cons = (Q_WRP(q->cons, shift) | Q_IDX(q->cons, shift)) + 1;
+
+	q->cons = Q_OVF(q->cons) | Q_WRP(cons, shift) | Q_IDX(cons, shift);
+}
+
 static void queue_write(u64 *dst, u64 *src, u32 n_dwords)
 {
 	u32 n;
@@ -449,8 +501,11 @@ static int arm_smmu_cmdq_build_cmd(u64 *cmd, struct arm_smmu_cmdq_ent *ent)
 		cmd[1] |= ent->tlbi.addr & CMDQ_TLBI_1_VA_MASK;
 		break;
 	case CMDQ_OP_TLBI_S2_IPA:
+		cmd[0] |= FIELD_PREP(CMDQ_TLBI_0_NUM, ent->tlbi.num);
+		cmd[0] |= FIELD_PREP(CMDQ_TLBI_0_SCALE, ent->tlbi.scale);
 		cmd[0] |= FIELD_PREP(CMDQ_TLBI_0_VMID, ent->tlbi.vmid);
 		cmd[1] |= FIELD_PREP(CMDQ_TLBI_1_LEAF, ent->tlbi.leaf);
+		cmd[1] |= FIELD_PREP(CMDQ_TLBI_1_TG, ent->tlbi.tg);
 		cmd[1] |= ent->tlbi.addr & CMDQ_TLBI_1_IPA_MASK;
 		break;
 	case CMDQ_OP_TLBI_NH_ASID:
@@ -500,20 +555,50 @@ static void arm_smmu_cmdq_skip_err(struct arm_smmu_device *smmu)
 	mmio_write32(smmu->base + ARM_SMMU_GERRORN, gerrorn);
 }
 
-static void arm_smmu_cmdq_insert_cmd(struct arm_smmu_device *smmu, u64 *cmd)
+static void arm_smmu_cmdq_poll(struct arm_smmu_device *smmu)
 {
 	struct arm_smmu_queue *q = &smmu->cmdq.q;
 
-	while (queue_full(q))
-		queue_sync_cons(q);
+	queue_sync_cons(q);
+	if (queue_error(smmu, q))
+		arm_smmu_cmdq_skip_err(smmu);
+}
 
-	queue_write(queue_entry(q, q->prod), cmd, q->ent_dwords);
-	queue_inc_prod(q);
-	while (!queue_empty(q)) {
-		queue_sync_cons(q);
-		if (queue_error(smmu, q))
-			arm_smmu_cmdq_skip_err(smmu);
+/*
+ * Write n commands to the queue, optionally followed by a CMD_SYNC. Only in
+ * the latter case, the caller waits, and only once, for the SMMU to consume
+ * all of them. Without sync, completion is left to a later CMD_SYNC.
+ */
+static void arm_smmu_cmdq_issue_cmdlist(struct arm_smmu_device *smmu,
+					u64 *cmds, unsigned int n, bool sync)
+{
+	struct arm_smmu_cmdq_ent ent = { .opcode = CMDQ_OP_CMD_SYNC };
+	struct arm_smmu_queue *q = &smmu->cmdq.q;
+	u64 cmd_sync[CMDQ_ENT_DWORDS];
+	unsigned int i;
+	u64 *cmd;
+
+	if (sync)
+		arm_smmu_cmdq_build_cmd(cmd_sync, &ent);
+
+	spin_lock(&smmu->cmdq.lock);
+
+	for (i = 0; i < n + sync; i++) {
+		while (queue_full(q))
+			arm_smmu_cmdq_poll(smmu);
+
+		cmd = i < n ? &cmds[i * CMDQ_ENT_DWORDS] : cmd_sync;
+		queue_write(queue_entry(q, q->prod), cmd, q->ent_dwords);
+		queue_inc_prod(q);
+		tracepoint(TRACE_SMMU_CMD, FIELD_GET(CMDQ_0_OP, cmd[0]),
+			   cmd[0], cmd[1]);
 	}
+
+	if (sync)
+		while (!queue_empty(q))
+			arm_smmu_cmdq_poll(smmu);
+
+	spin_unlock(&smmu->cmdq.lock);
 }
 
 static void arm_smmu_cmdq_issue_cmd(struct arm_smmu_device *smmu,
@@ -525,21 +610,37 @@ static void arm_smmu_cmdq_issue_cmd(struct arm_smmu_device *smmu,
 		/* Ignore any unknown command */
 		return;
 
-	spin_lock(&smmu->cmdq.lock);
-	arm_smmu_cmdq_insert_cmd(smmu, cmd);
-	spin_unlock(&smmu->cmdq.lock);
+	arm_smmu_cmdq_issue_cmdlist(smmu, cmd, 1, false);
 }
 
 static void arm_smmu_cmdq_issue_sync(struct arm_smmu_device *smmu)
 {
-	struct arm_smmu_cmdq_ent ent = { .opcode = CMDQ_OP_CMD_SYNC };
-	u64 cmd[CMDQ_ENT_DWORDS];
+	arm_smmu_cmdq_issue_cmdlist(smmu, NULL, 0, true);
+}
 
-	arm_smmu_cmdq_build_cmd(cmd, &ent);
+static void arm_smmu_cmdq_batch_add(struct arm_smmu_device *smmu,
+				    struct arm_smmu_cmdq_batch *batch,
+				    struct arm_smmu_cmdq_ent *ent)
+{
+	if (batch->num == CMDQ_BATCH_ENTRIES) {
+		arm_smmu_cmdq_issue_cmdlist(smmu, batch->cmds, batch->num,
+					    false);
+		batch->num = 0;
+	}
 
-	spin_lock(&smmu->cmdq.lock);
-	arm_smmu_cmdq_insert_cmd(smmu, cmd);
-	spin_unlock(&smmu->cmdq.lock);
+	if (arm_smmu_cmdq_build_cmd(&batch->cmds[batch->num * CMDQ_ENT_DWORDS],
+				    ent))
+		/* Ignore any unknown command */
+		return;
+	batch->num++;
+}
+
+/* Issue the collected commands with a single CMD_SYNC and wait for them */
+static void arm_smmu_cmdq_batch_submit(struct arm_smmu_device *smmu,
+				       struct arm_smmu_cmdq_batch *batch)
+{
+	arm_smmu_cmdq_issue_cmdlist(smmu, batch->cmds, batch->num, true);
+	batch->num = 0;
 }
 
 /* Stream table manipulation functions */
@@ -556,7 +657,9 @@ arm_smmu_write_strtab_l1_desc(u64 *dst, struct arm_smmu_strtab_l1_desc *desc)
 	dsb(ishst);
 }
 
-static void arm_smmu_sync_ste_for_sid(struct arm_smmu_device *smmu, u32 sid)
+static void arm_smmu_sync_ste_for_sid(struct arm_smmu_device *smmu,
+				      struct arm_smmu_cmdq_batch *batch,
+				      u32 sid)
 {
 	struct arm_smmu_cmdq_ent cmd = {
 		.opcode	= CMDQ_OP_CFGI_STE,
@@ -566,32 +669,26 @@ static void arm_smmu_sync_ste_for_sid(struct arm_smmu_device *smmu, u32 sid)
 		},
 	};
 
-	arm_smmu_cmdq_issue_cmd(smmu, &cmd);
-	arm_smmu_cmdq_issue_sync(smmu);
+	arm_smmu_cmdq_batch_add(smmu, batch, &cmd);
+}
+
+static void arm_smmu_write_bypass_ste(u64 *dst, u32 vmid)
+{
+	dst[1] = FIELD_PREP(STRTAB_STE_1_SHCFG, STRTAB_STE_1_SHCFG_INCOMING);
+	dst[2] = FIELD_PREP(STRTAB_STE_2_S2VMID, vmid);
+	dst[0] = STRTAB_STE_0_V |
+		 FIELD_PREP(STRTAB_STE_0_CFG, STRTAB_STE_0_CFG_BYPASS);
+	dsb(ishst);
 }
 
-static void arm_smmu_write_strtab_ent(struct arm_smmu_device *smmu, u32 sid,
-				      u64 *guest_ste, u64 *dst, bool bypass,
-				      u32 vmid)
+/*
+ * Stage 2 STEs are written in two steps: first the translation fields, then,
+ * once the SMMU has dropped the old entry, dword 0 switching to translation.
+ */
+static void arm_smmu_write_s2_ste(u64 *dst, u32 vmid)
 {
 	struct paging_structures *pg_structs = &this_cell()->arch.mm;
-	u64 val, vttbr;
-
-	val = 0;
-
-	/* Bypass */
-	if (bypass) {
-		val = STRTAB_STE_0_V;
-		val |= FIELD_PREP(STRTAB_STE_0_CFG, STRTAB_STE_0_CFG_BYPASS);
-		dst[1] = FIELD_PREP(STRTAB_STE_1_SHCFG,
-				    STRTAB_STE_1_SHCFG_INCOMING);
-		dst[2] = FIELD_PREP(STRTAB_STE_2_S2VMID, vmid);
-		dst[0] = val;
-		dsb(ishst);
-		if (smmu)
-			arm_smmu_sync_ste_for_sid(smmu, sid);
-		return;
-	}
+	u64 vttbr;
 
 	dst[2] = FIELD_PREP(STRTAB_STE_2_S2VMID, vmid) |
 		 FIELD_PREP(STRTAB_STE_2_VTCR, VTCR_CELL) |
@@ -600,14 +697,14 @@ static void arm_smmu_write_strtab_ent(struct arm_smmu_device *smmu, u32 sid,
 
 	vttbr = paging_hvirt2phys(pg_structs->root_table);
 	dst[3] = vttbr & STRTAB_STE_3_S2TTB_MASK;
+	dsb(ishst);
+}
 
-	val |= FIELD_PREP(STRTAB_STE_0_CFG, STRTAB_STE_0_CFG_S2_TRANS);
-	val |= STRTAB_STE_0_V;
-
-	arm_smmu_sync_ste_for_sid(smmu, sid);
-	dst[0] = val;
+static void arm_smmu_enable_s2_ste(u64 *dst)
+{
+	dst[0] = STRTAB_STE_0_V |
+		 FIELD_PREP(STRTAB_STE_0_CFG, STRTAB_STE_0_CFG_S2_TRANS);
 	dsb(ishst);
-	arm_smmu_sync_ste_for_sid(smmu, sid);
 }
 
 static void arm_smmu_init_bypass_stes(u64 *strtab, unsigned int nent)
@@ -615,12 +712,35 @@ static void arm_smmu_init_bypass_stes(u64 *strtab, unsigned int nent)
 	unsigned int n;
 
 	for (n = 0; n < nent; ++n) {
-		arm_smmu_write_strtab_ent(NULL, -1, NULL, strtab, true,
+		arm_smmu_write_bypass_ste(strtab,
 					  (u32)this_cell()->config->id);
 		strtab += STRTAB_STE_DWORDS;
 	}
 }
 
+/* STEs per item of the parallel init of a linear stream table */
+#define BYPASS_ITEM_STES	1024
+
+/*
+ * A linear table covers up to 2^sid_bits STEs and is filled at setup,
+ * spread over the CPUs waiting for the master.
+ */
+static struct {
+	u64 *strtab;
+	unsigned int nent;
+} bypass_init;
+
+static int arm_smmu_init_bypass_item(unsigned long item)
+{
+	unsigned int first = item * BYPASS_ITEM_STES;
+
+	arm_smmu_init_bypass_stes(bypass_init.strtab +
+				  first * STRTAB_STE_DWORDS,
+				  MIN(BYPASS_ITEM_STES,
+				      bypass_init.nent - first));
+	return 0;
+}
+
 static int arm_smmu_init_strtab_linear(struct arm_smmu_device *smmu)
 {
 	void *strtab;
@@ -642,8 +762,11 @@ static int arm_smmu_init_strtab_linear(struct arm_smmu_device *smmu)
 	reg |= FIELD_PREP(STRTAB_BASE_CFG_LOG2SIZE, smmu->sid_bits);
 	cfg->strtab_base_cfg = reg;
 
-	arm_smmu_init_bypass_stes(strtab, cfg->num_l1_ents);
-	return 0;
+	bypass_init.strtab = strtab;
+	bypass_init.nent = cfg->num_l1_ents;
+	return parallel_run(arm_smmu_init_bypass_item,
+			    (cfg->num_l1_ents + BYPASS_ITEM_STES - 1) /
+			    BYPASS_ITEM_STES);
 }
 
 static int arm_smmu_init_l1_strtab(struct arm_smmu_device *smmu)
@@ -867,7 +990,17 @@ static int arm_smmu_device_reset(struct arm_smmu_device *smmu)
 	if (ret)
 		return ret;
 
-	/* ToDo: Add support for PRI queue and IRQs  */
+	if (smmu->evtq_irq) {
+		/* Wired interrupt: no MSI address */
+		mmio_write64(smmu->base + ARM_SMMU_EVTQ_IRQ_CFG0, 0);
+		ret = arm_smmu_write_reg_sync(smmu, IRQ_CTRL_EVTQ_IRQEN,
+					      ARM_SMMU_IRQ_CTRL,
+					      ARM_SMMU_IRQ_CTRLACK);
+		if (ret)
+			return ret;
+	}
+
+	/* ToDo: Add support for PRI queue */
 
 	enables |= CR0_SMMUEN;
 	ret = arm_smmu_write_reg_sync(smmu, enables, ARM_SMMU_CR0,
@@ -914,6 +1047,11 @@ static int arm_smmu_device_init_features(struct arm_smmu_device *smmu)
 	/* SID sizes */
 	smmu->sid_bits = FIELD_GET(IDR1_SIDSIZE, reg);
 
+	/* IDR3 */
+	reg = mmio_read32(smmu->base + ARM_SMMU_IDR3);
+	if (reg & IDR3_RIL)
+		smmu->features |= ARM_SMMU_FEAT_RANGE_INV;
+
 	/*
 	 * If the SMMU supports fewer bits than would fill a single L2 stream
 	 * table, use a linear table instead.
@@ -924,7 +1062,8 @@ static int arm_smmu_device_init_features(struct arm_smmu_device *smmu)
 	return 0;
 }
 
-static int arm_smmu_init_l2_strtab(struct arm_smmu_device *smmu, u32 sid)
+static int arm_smmu_init_l2_strtab(struct arm_smmu_device *smmu,
+				   struct arm_smmu_cmdq_batch *batch, u32 sid)
 {
 	struct arm_smmu_strtab_cfg *cfg = &smmu->strtab_cfg;
 	struct arm_smmu_strtab_l1_desc *desc;
@@ -955,12 +1094,14 @@ static int arm_smmu_init_l2_strtab(struct arm_smmu_device *smmu, u32 sid)
 	cmd.opcode = CMDQ_OP_CFGI_STE;
 	cmd.cfgi.sid = sid;
 	cmd.cfgi.leaf = false;
-	arm_smmu_cmdq_issue_cmd(smmu, &cmd);
+	arm_smmu_cmdq_batch_add(smmu, batch, &cmd);
 
 	return 0;
 }
 
-static void arm_smmu_uninit_l2_strtab(struct arm_smmu_device *smmu, u32 sid)
+static void arm_smmu_uninit_l2_strtab(struct arm_smmu_device *smmu,
+				      struct arm_smmu_cmdq_batch *batch,
+				      u32 sid)
 {
 	struct arm_smmu_strtab_cfg *cfg = &smmu->strtab_cfg;
 	struct arm_smmu_strtab_l1_desc *desc;
@@ -984,7 +1125,10 @@ static void arm_smmu_uninit_l2_strtab(struct arm_smmu_device *smmu, u32 sid)
 	cmd.opcode = CMDQ_OP_CFGI_STE;
 	cmd.cfgi.sid = sid;
 	cmd.cfgi.leaf = false;
-	arm_smmu_cmdq_issue_cmd(smmu, &cmd);
+	arm_smmu_cmdq_batch_add(smmu, batch, &cmd);
+
+	/* The SMMU must be done with the table before it can be freed. */
+	arm_smmu_cmdq_batch_submit(smmu, batch);
 
 	size = 1 << (STRTAB_SPLIT + STRTAB_STE_DWORDS_BITS + 3);
 	page_free(&mem_pool, desc->l2ptr, PAGES(size));
@@ -1012,41 +1156,49 @@ static u64 *arm_smmu_get_step_for_sid(struct arm_smmu_device *smmu, u32 sid)
 	return step;
 }
 
-static int arm_smmu_init_ste(struct arm_smmu_device *smmu, u32 sid, u32 vmid)
+static int arm_smmu_init_ste(struct arm_smmu_device *smmu,
+			     struct arm_smmu_cmdq_batch *batch, u32 sid,
+			     u32 vmid)
 {
 	int ret = 0;
-	u64 *step;
 
 	if (smmu->features & ARM_SMMU_FEAT_2_LVL_STRTAB) {
-		ret = arm_smmu_init_l2_strtab(smmu, sid);
+		ret = arm_smmu_init_l2_strtab(smmu, batch, sid);
 		if (ret)
 			return ret;
 	}
 
-	step = arm_smmu_get_step_for_sid(smmu, sid);
-	arm_smmu_write_strtab_ent(smmu, sid, NULL, step, false, vmid);
+	arm_smmu_write_s2_ste(arm_smmu_get_step_for_sid(smmu, sid), vmid);
+	arm_smmu_sync_ste_for_sid(smmu, batch, sid);
 
 	return 0;
 }
 
-static void arm_smmu_uninit_ste(struct arm_smmu_device *smmu, u32 sid, u32 vmid)
+static void arm_smmu_uninit_ste(struct arm_smmu_device *smmu,
+				struct arm_smmu_cmdq_batch *batch, u32 sid,
+				u32 vmid)
 {
-	u64 *step;
-
-	step = arm_smmu_get_step_for_sid(smmu, sid);
-	arm_smmu_write_strtab_ent(smmu, sid, NULL, step, true, vmid);
+	arm_smmu_write_bypass_ste(arm_smmu_get_step_for_sid(smmu, sid), vmid);
+	arm_smmu_sync_ste_for_sid(smmu, batch, sid);
 
 	if (smmu->features & ARM_SMMU_FEAT_2_LVL_STRTAB)
-		arm_smmu_uninit_l2_strtab(smmu, sid);
+		arm_smmu_uninit_l2_strtab(smmu, batch, sid);
 }
 
+/*
+ * All stream IDs of a cell are switched with two CMD_SYNCs, not two per stream
+ * ID: one after the translation fields of all STEs are written, one after
+ * they are enabled, the latter also covering the TLB invalidation.
+ */
 static int arm_smmuv3_cell_init(struct cell *cell)
 {
 	struct arm_smmu_device *smmu = &smmu_devices[0];
+	struct arm_smmu_cmdq_batch batch = { .num = 0 };
 	struct jailhouse_iommu *iommu;
 	struct arm_smmu_cmdq_ent cmd;
 	union jailhouse_stream_id sid;
 	unsigned int n, s;
+	u64 *step;
 	int ret;
 
 	if (!iommu_count_units())
@@ -1058,15 +1210,25 @@ static int arm_smmuv3_cell_init(struct cell *cell)
 			continue;
 
 		for_each_stream_id(sid, cell->config, s) {
-			ret = arm_smmu_init_ste(smmu, sid.id, cell->config->id);
-			if (ret)
+			ret = arm_smmu_init_ste(smmu, &batch, sid.id,
+						cell->config->id);
+			if (ret) {
+				arm_smmu_cmdq_batch_submit(smmu, &batch);
 				return ret;
+			}
+		}
+		arm_smmu_cmdq_batch_submit(smmu, &batch);
+
+		for_each_stream_id(sid, cell->config, s) {
+			step = arm_smmu_get_step_for_sid(smmu, sid.id);
+			arm_smmu_enable_s2_ste(step);
+			arm_smmu_sync_ste_for_sid(smmu, &batch, sid.id);
 		}
 
 		cmd.opcode	= CMDQ_OP_TLBI_S12_VMALL;
 		cmd.tlbi.vmid	= cell->config->id;
-		arm_smmu_cmdq_issue_cmd(smmu, &cmd);
-		arm_smmu_cmdq_issue_sync(smmu);
+		arm_smmu_cmdq_batch_add(smmu, &batch, &cmd);
+		arm_smmu_cmdq_batch_submit(smmu, &batch);
 	}
 
 	return 0;
@@ -1075,6 +1237,7 @@ static int arm_smmuv3_cell_init(struct cell *cell)
 static void arm_smmuv3_cell_exit(struct cell *cell)
 {
 	struct arm_smmu_device *smmu = &smmu_devices[0];
+	struct arm_smmu_cmdq_batch batch = { .num = 0 };
 	struct jailhouse_iommu *iommu;
 	struct arm_smmu_cmdq_ent cmd;
 	union jailhouse_stream_id sid;
@@ -1089,9 +1252,32 @@ static void arm_smmuv3_cell_exit(struct cell *cell)
 			continue;
 
 		for_each_stream_id(sid, cell->config, s) {
-			arm_smmu_uninit_ste(smmu, sid.id, cell->config->id);
+			arm_smmu_uninit_ste(smmu, &batch, sid.id,
+					    cell->config->id);
 		}
 
+		cmd.opcode	= CMDQ_OP_TLBI_S12_VMALL;
+		cmd.tlbi.vmid	= cell->config->id;
+		arm_smmu_cmdq_batch_add(smmu, &batch, &cmd);
+		arm_smmu_cmdq_batch_submit(smmu, &batch);
+	}
+}
+
+void arm_smmuv3_flush_cell_tlbs(struct cell *cell)
+{
+	struct arm_smmu_device *smmu = &smmu_devices[0];
+	struct jailhouse_iommu *iommu;
+	struct arm_smmu_cmdq_ent cmd;
+	unsigned int n;
+
+	if (!iommu_count_units() || !cell->config->num_stream_ids)
+		return;
+
+	iommu = &system_config->platform_info.iommu_units[0];
+	for (n = 0; n < iommu_count_units(); iommu++, smmu++, n++) {
+		if (iommu->type != JAILHOUSE_IOMMU_SMMUV3)
+			continue;
+
 		cmd.opcode	= CMDQ_OP_TLBI_S12_VMALL;
 		cmd.tlbi.vmid	= cell->config->id;
 		arm_smmu_cmdq_issue_cmd(smmu, &cmd);
@@ -1099,6 +1285,188 @@ static void arm_smmuv3_cell_exit(struct cell *cell)
 	}
 }
 
+/*
+ * Invalidate the stage 2 translations of [addr, addr + size), including
+ * walk caches as the tables may have been freed. With SMMUv3.2 range
+ * invalidation, each command covers up to 31 times a power of two pages.
+ */
+void arm_smmuv3_flush_cell_tlb_range(struct cell *cell, unsigned long addr,
+				     unsigned long size)
+{
+	struct arm_smmu_device *smmu = &smmu_devices[0];
+	struct arm_smmu_cmdq_batch batch = { .num = 0 };
+	unsigned long num_pages, iova, inv_range;
+	struct jailhouse_iommu *iommu;
+	struct arm_smmu_cmdq_ent cmd;
+	unsigned int n, num, scale;
+
+	if (!iommu_count_units() || !cell->config->num_stream_ids)
+		return;
+
+	iommu = &system_config->platform_info.iommu_units[0];
+	for (n = 0; n < iommu_count_units(); iommu++, smmu++, n++) {
+		if (iommu->type != JAILHOUSE_IOMMU_SMMUV3)
+			continue;
+
+		num_pages = PAGES(size);
+		if (!(smmu->features & ARM_SMMU_FEAT_RANGE_INV) &&
+		    num_pages > CMDQ_MAX_TLBI_OPS) {
+			cmd.opcode	= CMDQ_OP_TLBI_S12_VMALL;
+			cmd.tlbi.vmid	= cell->config->id;
+			arm_smmu_cmdq_batch_add(smmu, &batch, &cmd);
+			arm_smmu_cmdq_batch_submit(smmu, &batch);
+			continue;
+		}
+
+		memset(&cmd, 0, sizeof(cmd));
+		cmd.opcode	= CMDQ_OP_TLBI_S2_IPA;
+		cmd.tlbi.vmid	= cell->config->id;
+		cmd.tlbi.leaf	= false;
+
+		for (iova = addr; num_pages > 0; iova += inv_range) {
+			if (smmu->features & ARM_SMMU_FEAT_RANGE_INV) {
+				/* largest power of two dividing the rest */
+				scale = ffsl(num_pages);
+				num = (num_pages >> scale) &
+					CMDQ_TLBI_RANGE_NUM_MAX;
+				cmd.tlbi.tg = CMDQ_TLBI_TG_4K;
+				cmd.tlbi.scale = scale;
+				cmd.tlbi.num = num - 1;
+				inv_range = (unsigned long)num <<
+					(scale + PAGE_SHIFT);
+				num_pages -= (unsigned long)num << scale;
+			} else {
+				inv_range = PAGE_SIZE;
+				num_pages--;
+			}
+			cmd.tlbi.addr = iova;
+			arm_smmu_cmdq_batch_add(smmu, &batch, &cmd);
+		}
+		arm_smmu_cmdq_batch_submit(smmu, &batch);
+	}
+}
+
+static void arm_smmu_record_fault(unsigned int unit, u64 *evt)
+{
+	u32 sid = FIELD_GET(EVTQ_0_SID, evt[0]);
+	struct jailhouse_iommu_fault *fault;
+	unsigned int n;
+
+	for (n = 0; n < smmu_faults.num_streams; n++)
+		if (smmu_faults.streams[n].unit == unit &&
+		    smmu_faults.streams[n].sid == sid)
+			break;
+
+	if (n == smmu_faults.num_streams) {
+		if (n == SMMU_FAULT_STREAMS) {
+			smmu_faults.untracked++;
+			return;
+		}
+		smmu_faults.num_streams++;
+		smmu_faults.streams[n].unit = unit;
+		smmu_faults.streams[n].sid = sid;
+		printk("SMMUv3 %u: fault from SID 0x%x, event 0x%llx, "
+		       "address 0x%llx\n", unit, sid,
+		       FIELD_GET(EVTQ_0_ID, evt[0]),
+		       FIELD_GET(EVTQ_2_ADDR, evt[2]));
+	}
+
+	fault = &smmu_faults.streams[n];
+	fault->count++;
+	fault->last_event = FIELD_GET(EVTQ_0_ID, evt[0]);
+	fault->last_addr = FIELD_GET(EVTQ_2_ADDR, evt[2]);
+}
+
+/*
+ * Consume all events the SMMU has produced so far, releasing them with a
+ * single write of the consumer index per batch.
+ */
+static void arm_smmu_evtq_drain(struct arm_smmu_device *smmu,
+				unsigned int unit)
+{
+	struct arm_smmu_queue *q = &smmu->evtq.q;
+	u32 shift = q->max_n_shift;
+
+	spin_lock(&smmu_faults.lock);
+
+	q->prod = mmio_read32(q->prod_reg);
+	while (!queue_empty(q)) {
+		/* Read the entries only after their producer index */
+		dmb(osh);
+		do {
+			arm_smmu_record_fault(unit, queue_entry(q, q->cons));
+			queue_inc_cons(q);
+		} while (!queue_empty(q));
+
+		/* Acknowledge an overflow by mirroring its flag */
+		if (Q_OVF(q->prod) != Q_OVF(q->cons))
+			smmu_faults.overflows++;
+		q->cons = Q_OVF(q->prod) | Q_WRP(q->cons, shift) |
+			  Q_IDX(q->cons, shift);
+
+		dmb(osh);
+		mmio_write32(q->cons_reg, q->cons);
+		q->prod = mmio_read32(q->prod_reg);
+	}
+
+	spin_unlock(&smmu_faults.lock);
+}
+
+bool arm_smmuv3_handle_irq(u32 irqn)
+{
+	struct arm_smmu_device *smmu = &smmu_devices[0];
+	unsigned int n;
+
+	if (!num_evtq_irqs)
+		return false;
+
+	for (n = 0; n < JAILHOUSE_MAX_IOMMU_UNITS; smmu++, n++)
+		if (smmu->evtq_irq && smmu->evtq_irq == irqn) {
+			arm_smmu_evtq_drain(smmu, n);
+			return true;
+		}
+
+	return false;
+}
+
+int arm_smmuv3_get_faults(struct jailhouse_iommu_faults *faults,
+			  unsigned int max_entries)
+{
+	unsigned int n;
+
+	spin_lock(&smmu_faults.lock);
+
+	faults->num_entries = smmu_faults.num_streams;
+	faults->untracked = smmu_faults.untracked;
+	faults->overflows = smmu_faults.overflows;
+	max_entries = MIN(max_entries, smmu_faults.num_streams);
+	for (n = 0; n < max_entries; n++)
+		faults->entries[n] = smmu_faults.streams[n];
+
+	spin_unlock(&smmu_faults.lock);
+
+	return max_entries;
+}
+
+static void arm_smmu_claim_irq(u32 irq)
+{
+	if (system_config->platform_info.arm.gic_version == 3) {
+		gicv3_spi_route(irq, this_cpu_public()->mpidr);
+		gicv3_spi_enable(irq);
+	} else {
+		gicv2_set_targets(irq, (1U << this_cpu_id()));
+		gicv2_enable_irq(irq);
+	}
+}
+
+static void arm_smmu_release_irq(u32 irq)
+{
+	if (system_config->platform_info.arm.gic_version == 3)
+		gicv3_spi_disable(irq);
+	else
+		gicv2_disable_irq(irq);
+}
+
 static int arm_smmuv3_init(void)
 {
 	struct arm_smmu_device *smmu = &smmu_devices[0];
@@ -1112,8 +1480,7 @@ static int arm_smmuv3_init(void)
 			continue;
 
 		smmu->base = paging_map_device(iommu->base, iommu->size);
-
-		/* ToDo: irq allocation*/
+		smmu->evtq_irq = iommu->smmuv3.evtq_irq;
 
 		ret = arm_smmu_device_init_features(smmu);
 		if (ret)
@@ -1127,11 +1494,27 @@ static int arm_smmuv3_init(void)
 		ret = arm_smmu_device_reset(smmu);
 		if (ret)
 			return ret;
+
+		if (smmu->evtq_irq) {
+			arm_smmu_claim_irq(smmu->evtq_irq);
+			num_evtq_irqs++;
+		}
 	}
 
 	return arm_smmuv3_cell_init(&root_cell);
 }
 
+static void arm_smmuv3_shutdown(void)
+{
+	struct arm_smmu_device *smmu = &smmu_devices[0];
+	unsigned int n;
+
+	for (n = 0; n < JAILHOUSE_MAX_IOMMU_UNITS; smmu++, n++)
+		if (smmu->evtq_irq) {
+			mmio_write32(smmu->base + ARM_SMMU_IRQ_CTRL, 0);
+			arm_smmu_release_irq(smmu->evtq_irq);
+		}
+}
+
 DEFINE_UNIT_MMIO_COUNT_REGIONS_STUB(arm_smmuv3);
-DEFINE_UNIT_SHUTDOWN_STUB(arm_smmuv3);
 DEFINE_UNIT(arm_smmuv3, "ARM SMMU v3");
@@ -20,6 +20,9 @@
 
 #define TLB_LOOP_TIMEOUT		1000000
 
+/* Identical instances programmed as one, see jailhouse_iommu.mmu500 */
+#define ARM_SMMU_MAX_INSTANCES		3
+
 /* SMMU global address space */
 #define ARM_SMMU_GR0(smmu)		((smmu)->base)
 #define ARM_SMMU_GR1(smmu)		((smmu)->base + (1 << (smmu)->pgshift))
@@ -108,6 +111,13 @@
 #define ARM_SMMU_CB_TTBR0		0x20
 #define ARM_SMMU_CB_TCR			0x30
 #define ARM_SMMU_CB_FSR			0x58
+#define ARM_SMMU_CB_S2_TLBIIPAS2	0x630
+#define ARM_SMMU_CB_TLBSYNC		0x7f0
+#define ARM_SMMU_CB_TLBSTATUS		0x7f4
+#define TLBSTATUS_SACTIVE		(1 << 0)
+
+/* Page-wise invalidations beyond which a VMID-wide one is issued instead */
+#define MAX_TLBI_OPS			128
 
 #define SCTLR_CFIE			(1 << 6)
 #define SCTLR_CFRE			(1 << 5)
@@ -153,6 +163,8 @@ struct arm_smmu_smr {
 struct arm_smmu_device {
 	void				*base;
 	void				*cb_base;
+	void				*instance[ARM_SMMU_MAX_INSTANCES];
+	unsigned int			num_instances;
 	unsigned long			pgshift;
 	u32				num_context_banks;
 	u32				num_mapping_groups;
@@ -167,13 +179,40 @@ static unsigned int num_smmu_devices;
 	     (counter) < num_smmu_devices;			\
 	     (smmu)++, (counter)++)
 
+#define for_each_instance(smmu, n)				\
+	for ((n) = 0; (n) < (smmu)->num_instances; (n)++)
+
+/* Address of reg, given for the first instance, in instance n */
+#define ARM_SMMU_INSTANCE(smmu, n, reg)				\
+	((smmu)->instance[n] + ((reg) - (smmu)->base))
+
+/*
+ * Registers are written to all instances so that they stay identical, reads
+ * are served by the first one.
+ */
+static void arm_smmu_write32(struct arm_smmu_device *smmu, void *reg, u32 val)
+{
+	unsigned int n;
+
+	for_each_instance(smmu, n)
+		mmio_write32(ARM_SMMU_INSTANCE(smmu, n, reg), val);
+}
+
+static void arm_smmu_write64(struct arm_smmu_device *smmu, void *reg, u64 val)
+{
+	unsigned int n;
+
+	for_each_instance(smmu, n)
+		mmio_write64(ARM_SMMU_INSTANCE(smmu, n, reg), val);
+}
+
 static void arm_smmu_write_smr(struct arm_smmu_device *smmu, int idx)
 {
 	struct arm_smmu_smr *smr = smmu->smrs + idx;
 	u32 reg = (smr->id << SMR_ID_SHIFT) | (smr->mask << SMR_MASK_SHIFT) |
 		(smr->valid ? SMR_VALID : 0);
 
-	mmio_write32(ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_SMR(idx), reg);
+	arm_smmu_write32(smmu, ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_SMR(idx), reg);
 }
 
 static void arm_smmu_write_s2cr(struct arm_smmu_device *smmu, int idx,
@@ -182,26 +221,59 @@ static void arm_smmu_write_s2cr(struct arm_smmu_device *smmu, int idx,
 	u32 reg = S2CR_TYPE(type) | S2CR_CBNDX(cbndx) |
 		  S2CR_PRIVCFG(S2CR_PRIVCFG_DEFAULT);
 
-	mmio_write32(ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_S2CR(idx), reg);
+	arm_smmu_write32(smmu, ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_S2CR(idx),
+			 reg);
+}
+
+/*
+ * Start the sync on all instances before waiting for any of them, so that
+ * they drain their invalidations in parallel.
+ */
+static int arm_smmu_tlb_sync(struct arm_smmu_device *smmu, void *sync_reg,
+			     void *status_reg, u32 active)
+{
+	unsigned int inst, loop, n;
+	void *status;
+
+	arm_smmu_write32(smmu, sync_reg, 0);
+	for_each_instance(smmu, inst) {
+		status = ARM_SMMU_INSTANCE(smmu, inst, status_reg);
+		for (loop = 0; loop < TLB_LOOP_TIMEOUT; loop++) {
+			if (!(mmio_read32(status) & active))
+				break;
+			for (n = 0; n < 1000; n++)
+				cpu_relax();
+		}
+		if (loop == TLB_LOOP_TIMEOUT)
+			goto timeout;
+	}
+
+	return 0;
+
+timeout:
+	printk("TLB sync timed out -- SMMU may be deadlocked\n");
+	return trace_error(-EINVAL);
 }
 
 /* Wait for any pending TLB invalidations to complete */
 static int arm_smmu_tlb_sync_global(struct arm_smmu_device *smmu)
 {
 	void *base = ARM_SMMU_GR0(smmu);
-	unsigned int loop, n;
-
-	mmio_write32(base + ARM_SMMU_GR0_sTLBGSYNC, 0);
-	for (loop = 0; loop < TLB_LOOP_TIMEOUT; loop++) {
-		if (!(mmio_read32(base + ARM_SMMU_GR0_sTLBGSTATUS) &
-		      sTLBGSTATUS_GSACTIVE))
-			return 0;
-		for (n = 0; n < 1000; n++)
-			cpu_relax();
-	}
-	printk("TLB sync timed out -- SMMU may be deadlocked\n");
 
-	return trace_error(-EINVAL);
+	return arm_smmu_tlb_sync(smmu, base + ARM_SMMU_GR0_sTLBGSYNC,
+				 base + ARM_SMMU_GR0_sTLBGSTATUS,
+				 sTLBGSTATUS_GSACTIVE);
+}
+
+/* Wait for the TLB invalidations of one context bank to complete */
+static int arm_smmu_tlb_sync_context(struct arm_smmu_device *smmu,
+				     unsigned int cbndx)
+{
+	void *base = ARM_SMMU_CB(smmu, cbndx);
+
+	return arm_smmu_tlb_sync(smmu, base + ARM_SMMU_CB_TLBSYNC,
+				 base + ARM_SMMU_CB_TLBSTATUS,
+				 TLBSTATUS_SACTIVE);
 }
 
 static void arm_smmu_setup_context_bank(struct arm_smmu_device *smmu,
@@ -214,38 +286,44 @@ static void arm_smmu_setup_context_bank(struct arm_smmu_device *smmu,
 	void *gr1_base = ARM_SMMU_GR1(smmu);
 
 	/* CBA2R */
-	mmio_write32(gr1_base + ARM_SMMU_GR1_CBA2R(vmid), CBA2R_RW64_64BIT);
+	arm_smmu_write32(smmu, gr1_base + ARM_SMMU_GR1_CBA2R(vmid),
+			 CBA2R_RW64_64BIT);
 
 	/* CBAR */
-	mmio_write32(gr1_base + ARM_SMMU_GR1_CBAR(vmid),
-		     CBAR_TYPE_S2_TRANS | (vmid << CBAR_VMID_SHIFT));
+	arm_smmu_write32(smmu, gr1_base + ARM_SMMU_GR1_CBAR(vmid),
+			 CBAR_TYPE_S2_TRANS | (vmid << CBAR_VMID_SHIFT));
 
 	/* TCR */
-	mmio_write32(cb_base + ARM_SMMU_CB_TCR, VTCR_CELL & ~TCR_RES0);
+	arm_smmu_write32(smmu, cb_base + ARM_SMMU_CB_TCR,
+			 VTCR_CELL & ~TCR_RES0);
 
 	/* TTBR0 */
-	mmio_write64(cb_base + ARM_SMMU_CB_TTBR0,
-		     paging_hvirt2phys(cell->arch.mm.root_table) & TTBR_MASK);
+	arm_smmu_write64(smmu, cb_base + ARM_SMMU_CB_TTBR0,
+			 paging_hvirt2phys(cell->arch.mm.root_table) &
+			 TTBR_MASK);
 
 	/* SCTLR */
-	mmio_write32(cb_base + ARM_SMMU_CB_SCTLR,
-		     SCTLR_CFIE | SCTLR_CFRE | SCTLR_AFE | SCTLR_TRE | SCTLR_M);
+	arm_smmu_write32(smmu, cb_base + ARM_SMMU_CB_SCTLR,
+			 SCTLR_CFIE | SCTLR_CFRE | SCTLR_AFE | SCTLR_TRE |
+			 SCTLR_M);
 }
 
 static void arm_smmu_disable_context_bank(struct arm_smmu_device *smmu, int idx)
 {
-	mmio_write32(ARM_SMMU_CB(smmu, idx) + ARM_SMMU_CB_SCTLR, 0);
+	arm_smmu_write32(smmu, ARM_SMMU_CB(smmu, idx) + ARM_SMMU_CB_SCTLR, 0);
 }
 
 static int arm_smmu_device_reset(struct arm_smmu_device *smmu)
 {
 	void *gr0_base = ARM_SMMU_GR0(smmu);
-	unsigned int idx;
+	unsigned int idx, n;
 	u32 reg;
 
-	/* Clear global FSR */
-	reg = mmio_read32(ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_sGFSR);
-	mmio_write32(ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_sGFSR, reg);
+	/* Clear global FSR, each instance records its own faults */
+	for_each_instance(smmu, n) {
+		reg = mmio_read32(smmu->instance[n] + ARM_SMMU_GR0_sGFSR);
+		mmio_write32(smmu->instance[n] + ARM_SMMU_GR0_sGFSR, reg);
+	}
 
 	/*
 	 * Reset stream mapping groups: Initial values mark all SMRn as
@@ -270,26 +348,26 @@ static int arm_smmu_device_reset(struct arm_smmu_device *smmu)
 	 * TLB entries for reduced latency.
 	 */
 	reg |= ARM_MMU500_ACR_SMTNMB_TLBEN | ARM_MMU500_ACR_S2CRB_TLBEN;
-	mmio_write32(gr0_base + ARM_SMMU_GR0_sACR, reg);
+	arm_smmu_write32(smmu, gr0_base + ARM_SMMU_GR0_sACR, reg);
 
 	/* Make sure all context banks are disabled and clear CB_FSR */
 	for (idx = 0; idx < smmu->num_context_banks; ++idx) {
 		void *cb_base = ARM_SMMU_CB(smmu, idx);
 
 		arm_smmu_disable_context_bank(smmu, idx);
-		mmio_write32(cb_base + ARM_SMMU_CB_FSR, FSR_FAULT);
+		arm_smmu_write32(smmu, cb_base + ARM_SMMU_CB_FSR, FSR_FAULT);
 		/*
 		 * Disable MMU-500's not-particularly-beneficial next-page
 		 * prefetcher for the sake of errata #841119 and #826419.
 		 */
 		reg = mmio_read32(cb_base + ARM_SMMU_CB_ACTLR);
 		reg &= ~ARM_MMU500_ACTLR_CPRE;
-		mmio_write32(cb_base + ARM_SMMU_CB_ACTLR, reg);
+		arm_smmu_write32(smmu, cb_base + ARM_SMMU_CB_ACTLR, reg);
 	}
 
 	/* Invalidate the TLB, just in case */
-	mmio_write32(gr0_base + ARM_SMMU_GR0_TLBIALLH, 0);
-	mmio_write32(gr0_base + ARM_SMMU_GR0_TLBIALLNSNH, 0);
+	arm_smmu_write32(smmu, gr0_base + ARM_SMMU_GR0_TLBIALLH, 0);
+	arm_smmu_write32(smmu, gr0_base + ARM_SMMU_GR0_TLBIALLNSNH, 0);
 	return arm_smmu_tlb_sync_global(smmu);
 }
 
@@ -297,15 +375,23 @@ static int arm_smmu_device_cfg_probe(struct arm_smmu_device *smmu)
 {
 	void *gr0_base = ARM_SMMU_GR0(smmu);
 	u32 id, num_s2_context_banks;
+	unsigned int n, reg;
 	unsigned long size;
 
 	/* We only support version 2 */
 	if (ID7_MAJOR(mmio_read32(gr0_base + ARM_SMMU_GR0_ID7)) != 2)
 		return trace_error(-EIO);
 
-	/* Make sure the SMMU is not in use */
-	if (!(mmio_read32(gr0_base + ARM_SMMU_GR0_sCR0) & sCR0_CLIENTPD))
-		return trace_error(-EBUSY);
+	/* Make sure the SMMU is not in use and its instances are identical */
+	for_each_instance(smmu, n) {
+		if (!(mmio_read32(smmu->instance[n] + ARM_SMMU_GR0_sCR0) &
+		      sCR0_CLIENTPD))
+			return trace_error(-EBUSY);
+		for (reg = ARM_SMMU_GR0_ID0; reg <= ARM_SMMU_GR0_ID2; reg += 4)
+			if (mmio_read32(smmu->instance[n] + reg) !=
+			    mmio_read32(gr0_base + reg))
+				return trace_error(-EIO);
+	}
 
 	/* ID0 */
 	id = mmio_read32(gr0_base + ARM_SMMU_GR0_ID0);
@@ -447,7 +533,9 @@ static int arm_smmu_cell_init(struct cell *cell)
 			arm_smmu_write_smr(smmu, idx);
 		}
 
-		mmio_write32(ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_TLBIVMID, vmid);
+		arm_smmu_write32(smmu,
+				 ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_TLBIVMID,
+				 vmid);
 		ret = arm_smmu_tlb_sync_global(smmu);
 		if (ret < 0)
 			return ret;
@@ -517,7 +605,9 @@ static void arm_smmu_cell_exit(struct cell *cell)
 
 		arm_smmu_disable_context_bank(smmu, id);
 
-		mmio_write32(ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_TLBIVMID, id);
+		arm_smmu_write32(smmu,
+				 ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_TLBIVMID,
+				 id);
 		arm_smmu_tlb_sync_global(smmu);
 	}
 }
@@ -536,20 +626,67 @@ void arm_smmu_config_commit(struct cell *cell)
 		 * private VMIDS, disable TLB broadcasting,
 		 * fault unmatched streams
 		 */
-		mmio_write32(ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_sCR0,
+		arm_smmu_write32(smmu, ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_sCR0,
 			sCR0_GFRE | sCR0_GFIE | sCR0_GCFGFRE | sCR0_GCFGFIE |
 			sCR0_VMIDPNE | sCR0_PTM | sCR0_USFCFG);
 	}
 }
 
+void arm_smmu_flush_cell_tlbs(struct cell *cell)
+{
+	struct arm_smmu_device *smmu;
+	unsigned int dev;
+
+	if (!cell->config->num_stream_ids)
+		return;
+
+	for_each_smmu(smmu, dev) {
+		arm_smmu_write32(smmu,
+				 ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_TLBIVMID,
+				 cell->config->id);
+		arm_smmu_tlb_sync_global(smmu);
+	}
+}
+
+/*
+ * Invalidate the stage 2 translations of [addr, addr + size) in the context
+ * bank of the cell, falling back to a VMID-wide flush for large ranges.
+ */
+void arm_smmu_flush_cell_tlb_range(struct cell *cell, unsigned long addr,
+				   unsigned long size)
+{
+	unsigned int cbndx = cell->config->id;
+	struct arm_smmu_device *smmu;
+	unsigned long iova;
+	unsigned int dev;
+
+	if (!cell->config->num_stream_ids)
+		return;
+
+	for_each_smmu(smmu, dev) {
+		if (PAGES(size) > MAX_TLBI_OPS) {
+			arm_smmu_write32(smmu, ARM_SMMU_GR0(smmu) +
+					 ARM_SMMU_GR0_TLBIVMID,
+					 cell->config->id);
+			arm_smmu_tlb_sync_global(smmu);
+			continue;
+		}
+
+		for (iova = addr; iova < addr + size; iova += PAGE_SIZE)
+			arm_smmu_write64(smmu, ARM_SMMU_CB(smmu, cbndx) +
+					 ARM_SMMU_CB_S2_TLBIIPAS2, iova >> 12);
+		arm_smmu_tlb_sync_context(smmu, cbndx);
+	}
+}
+
 static void arm_smmu_shutdown(void)
 {
 	struct arm_smmu_device *smmu;
 	unsigned int dev;
 
 	for_each_smmu(smmu, dev) {
-		mmio_write32(ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_sCR0,
-			     sCR0_CLIENTPD);
+		arm_smmu_write32(smmu, ARM_SMMU_GR0(smmu) + ARM_SMMU_GR0_sCR0,
+				 sCR0_CLIENTPD);
 	}
 }
 
@@ -557,7 +694,7 @@ static int arm_smmu_init(void)
 {
 	struct jailhouse_iommu *iommu;
 	struct arm_smmu_device *smmu;
-	unsigned int n;
+	unsigned int n, inst;
 	int err;
 
 	for (n = 0; n < iommu_count_units(); n++) {
@@ -566,14 +703,26 @@ static int arm_smmu_init(void)
 			continue;
 
 		smmu = &smmu_device[num_smmu_devices];
-		smmu->base = paging_map_device(iommu->base, iommu->size);
+		smmu->num_instances = iommu->mmu500.instances ?: 1;
+		if (smmu->num_instances > ARM_SMMU_MAX_INSTANCES) {
+			err = trace_error(-EINVAL);
+			goto error;
+		}
+
+		smmu->base = paging_map_device(iommu->base,
+					       iommu->size *
+					       smmu->num_instances);
 		if (!smmu->base) {
 			err = -ENOMEM;
 			goto error;
 		}
 
-		printk("ARM MMU500 at 0x%llx with:\n", iommu->base);
+		printk("ARM MMU500 at 0x%llx (%u instance%s) with:\n",
+		       iommu->base, smmu->num_instances,
+		       smmu->num_instances > 1 ? "s" : "");
 
+		for_each_instance(smmu, inst)
+			smmu->instance[inst] = smmu->base + inst * iommu->size;
 		smmu->cb_base = smmu->base + iommu->size / 2;
 
 		err = arm_smmu_device_cfg_probe(smmu);
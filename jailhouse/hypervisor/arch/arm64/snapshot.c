@@ -0,0 +1,362 @@
+/*
+ * Jailhouse Cell Snapshot Support
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Saves and restores the interrupt and vCPU state of a non-root AArch64
+ * cell. The memory is transferred by the root cell, this part only covers
+ * what the cell cannot access: EL1 and EL2 registers, the virtual CPU
+ * interface and the cell's share of the GICv3 distributor and
+ * redistributors.
+ *
+ * Pending and active interrupts are not preserved, neither is the debug and
+ * PMU state. The counter keeps running while the cell is stopped, armed
+ * timers therefore fire right after the restore.
+ */
+
+#include <jailhouse/control.h>
+#include <jailhouse/mmio.h>
+#include <jailhouse/paging.h>
+#include <jailhouse/printk.h>
+#include <jailhouse/string.h>
+#include <asm/control.h>
+#include <asm/gic.h>
+#include <asm/gic_v3.h>
+#include <asm/irqchip.h>
+#include <asm/psci.h>
+#include <asm/sched.h>
+#include <asm/snapshot.h>
+#include <asm/sysregs.h>
+
+#define IRQ_STATE_PAGES		PAGES(sizeof(struct jailhouse_irq_state))
+
+static struct jailhouse_irq_state *
+snapshot_irqs(const struct jailhouse_cell_snapshot *snapshot)
+{
+	return (struct jailhouse_irq_state *)snapshot->data;
+}
+
+static struct jailhouse_vcpu_state *
+snapshot_vcpus(const struct jailhouse_cell_snapshot *snapshot)
+{
+	return (struct jailhouse_vcpu_state *)
+		(snapshot->data + sizeof(struct jailhouse_irq_state));
+}
+
+static unsigned int cell_num_cpus(struct cell *cell)
+{
+	unsigned int cpu, num = 0;
+
+	for_each_cpu(cpu, cell->cpu_set)
+		num++;
+	return num;
+}
+
+static int snapshot_check(struct cell *cell,
+			  const struct jailhouse_cell_snapshot *snapshot)
+{
+	if (system_config->platform_info.arm.gic_version != 3 ||
+	    cell->config->flags & JAILHOUSE_CELL_AARCH32)
+		return trace_error(-ENOSYS);
+
+	/* a time-shared CPU also holds the state of the other cell */
+	if (sched_cell_shared(cell))
+		return trace_error(-EBUSY);
+
+	if (snapshot->size < sizeof(*snapshot) +
+	    sizeof(struct jailhouse_irq_state) +
+	    cell_num_cpus(cell) * sizeof(struct jailhouse_vcpu_state))
+		return trace_error(-EINVAL);
+
+	return 0;
+}
+
+/* AArch64 EL0 or EL1 only, a snapshot must not be a way into EL2 */
+static bool pstate_valid(u64 pstate)
+{
+	switch (pstate & (PSR_32_BIT | PSR_MODE_MASK)) {
+	case PSR_MODE_EL0t:
+	case PSR_MODE_EL1t:
+	case PSR_MODE_EL1h:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void vcpu_state_save(struct jailhouse_vcpu_state *state)
+{
+	memcpy(state->x, this_cpu_data()->guest_regs.usr, sizeof(state->x));
+	arm_read_sysreg(ELR_EL2, state->pc);
+	arm_read_sysreg(SPSR_EL2, state->pstate);
+
+	arm_read_sysreg(SP_EL0, state->sp_el0);
+	arm_read_sysreg(SP_EL1, state->sp_el1);
+	arm_read_sysreg(ELR_EL1, state->elr_el1);
+	arm_read_sysreg(SPSR_EL1, state->spsr_el1);
+	arm_read_sysreg(SCTLR_EL1, state->sctlr_el1);
+	arm_read_sysreg(CPACR_EL1, state->cpacr_el1);
+	arm_read_sysreg(TTBR0_EL1, state->ttbr0_el1);
+	arm_read_sysreg(TTBR1_EL1, state->ttbr1_el1);
+	arm_read_sysreg(TCR_EL1, state->tcr_el1);
+	arm_read_sysreg(MAIR_EL1, state->mair_el1);
+	arm_read_sysreg(AMAIR_EL1, state->amair_el1);
+	arm_read_sysreg(VBAR_EL1, state->vbar_el1);
+	arm_read_sysreg(CONTEXTIDR_EL1, state->contextidr_el1);
+	arm_read_sysreg(TPIDR_EL0, state->tpidr_el0);
+	arm_read_sysreg(TPIDRRO_EL0, state->tpidrro_el0);
+	arm_read_sysreg(TPIDR_EL1, state->tpidr_el1);
+	arm_read_sysreg(CNTKCTL_EL1, state->cntkctl_el1);
+	arm_read_sysreg(ESR_EL1, state->esr_el1);
+	arm_read_sysreg(FAR_EL1, state->far_el1);
+	arm_read_sysreg(PAR_EL1, state->par_el1);
+	arm_read_sysreg(AFSR0_EL1, state->afsr0_el1);
+	arm_read_sysreg(AFSR1_EL1, state->afsr1_el1);
+	arm_read_sysreg(CSSELR_EL1, state->csselr_el1);
+
+	arm_read_sysreg(CNTV_CTL_EL0, state->cntv_ctl);
+	arm_read_sysreg(CNTV_CVAL_EL0, state->cntv_cval);
+	arm_read_sysreg(CNTP_CTL_EL0, state->cntp_ctl);
+	arm_read_sysreg(CNTP_CVAL_EL0, state->cntp_cval);
+
+	fpsimd_save(&state->fpsr);
+}
+
+void vcpu_state_load(const struct jailhouse_vcpu_state *state)
+{
+	memcpy(this_cpu_data()->guest_regs.usr, state->x, sizeof(state->x));
+	arm_write_sysreg(ELR_EL2, state->pc);
+	arm_write_sysreg(SPSR_EL2, state->pstate);
+
+	arm_write_sysreg(SP_EL0, state->sp_el0);
+	arm_write_sysreg(SP_EL1, state->sp_el1);
+	arm_write_sysreg(ELR_EL1, state->elr_el1);
+	arm_write_sysreg(SPSR_EL1, state->spsr_el1);
+	arm_write_sysreg(CPACR_EL1, state->cpacr_el1);
+	arm_write_sysreg(TTBR0_EL1, state->ttbr0_el1);
+	arm_write_sysreg(TTBR1_EL1, state->ttbr1_el1);
+	arm_write_sysreg(TCR_EL1, state->tcr_el1);
+	arm_write_sysreg(MAIR_EL1, state->mair_el1);
+	arm_write_sysreg(AMAIR_EL1, state->amair_el1);
+	arm_write_sysreg(VBAR_EL1, state->vbar_el1);
+	arm_write_sysreg(CONTEXTIDR_EL1, state->contextidr_el1);
+	arm_write_sysreg(TPIDR_EL0, state->tpidr_el0);
+	arm_write_sysreg(TPIDRRO_EL0, state->tpidrro_el0);
+	arm_write_sysreg(TPIDR_EL1, state->tpidr_el1);
+	arm_write_sysreg(CNTKCTL_EL1, state->cntkctl_el1);
+	arm_write_sysreg(ESR_EL1, state->esr_el1);
+	arm_write_sysreg(FAR_EL1, state->far_el1);
+	arm_write_sysreg(PAR_EL1, state->par_el1);
+	arm_write_sysreg(AFSR0_EL1, state->afsr0_el1);
+	arm_write_sysreg(AFSR1_EL1, state->afsr1_el1);
+	arm_write_sysreg(CSSELR_EL1, state->csselr_el1);
+	/* enable the MMU only with the translation regime complete */
+	arm_write_sysreg(SCTLR_EL1, state->sctlr_el1);
+
+	arm_write_sysreg(CNTV_CVAL_EL0, state->cntv_cval);
+	arm_write_sysreg(CNTV_CTL_EL0, state->cntv_ctl);
+	arm_write_sysreg(CNTP_CVAL_EL0, state->cntp_cval);
+	arm_write_sysreg(CNTP_CTL_EL0, state->cntp_ctl);
+
+	fpsimd_restore(&state->fpsr);
+}
+
+void snapshot_cpu_save_help(void)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	struct jailhouse_vcpu_state *state = &cpu_data->public.vcpu_state;
+	void *gicr = cpu_data->public.gicr.base + GICR_SGI_BASE;
+	u32 mask = this_cell()->arch.irq_bitmap[0];
+	unsigned int n;
+
+	if (!cpu_data->public.save_vcpu_state)
+		return;
+
+	state->online = !cpu_data->public.wait_for_poweron;
+	vcpu_state_save(state);
+
+	arm_read_sysreg(ICH_VMCR_EL2, state->ich_vmcr);
+	state->sgi_ppi_enabled = mmio_read32(gicr + GICR_ISENABLER) & mask;
+	for (n = 0; n < 32; n++)
+		state->sgi_ppi_priority[n] = (mask & (1 << n)) ?
+			mmio_read8(gicr + GICR_IPRIORITYR + n) : 0;
+
+	/* the management CPU reads the state once the flag is cleared */
+	memory_barrier();
+	cpu_data->public.save_vcpu_state = false;
+}
+
+int arch_cell_snapshot(struct cell *cell,
+		       struct jailhouse_cell_snapshot *snapshot)
+{
+	struct jailhouse_irq_state *irqs = snapshot_irqs(snapshot);
+	struct jailhouse_vcpu_state *state = snapshot_vcpus(snapshot);
+	unsigned int cpu, irq, word, shift;
+	int err;
+
+	err = snapshot_check(cell, snapshot);
+	if (err)
+		return err;
+
+	snapshot->num_cpus = 0;
+	snapshot->irq_state_size = sizeof(*irqs);
+	snapshot->cpu_state_size = sizeof(*state);
+
+	/* the CPUs of the cell are suspended and save their own state */
+	for_each_cpu(cpu, cell->cpu_set) {
+		public_per_cpu(cpu)->save_vcpu_state = true;
+		while (public_per_cpu(cpu)->save_vcpu_state)
+			cpu_relax();
+		memory_barrier();
+
+		memcpy(state++, &public_per_cpu(cpu)->vcpu_state,
+		       sizeof(*state));
+		snapshot->num_cpus++;
+	}
+
+	memset(irqs, 0, sizeof(*irqs));
+	for (irq = 32; irq < ARRAY_SIZE(irqs->priority); irq++) {
+		if (!irqchip_irq_in_cell(cell, irq))
+			continue;
+
+		word = irq / 32;
+		if (mmio_read32(gicd_base + GICD_ISENABLER + word * 4) &
+		    (1 << (irq % 32)))
+			irqs->enabled[word] |= 1 << (irq % 32);
+
+		word = irq / 16;
+		shift = (irq % 16) * 2;
+		irqs->config[word] |= mmio_read32(gicd_base + GICD_ICFGR +
+						  word * 4) & (3 << shift);
+
+		irqs->priority[irq] =
+			mmio_read8(gicd_base + GICD_IPRIORITYR + irq);
+		irqs->route[irq] =
+			mmio_read64(gicd_base + GICD_IROUTER + 8 * irq);
+	}
+
+	return 0;
+}
+
+int arch_cell_prepare_restore(struct cell *cell,
+			      const struct jailhouse_cell_snapshot *snapshot)
+{
+	const struct jailhouse_vcpu_state *state;
+	struct jailhouse_irq_state *irqs;
+	unsigned int cpu, n;
+	int err;
+
+	if (!snapshot) {
+		for_each_cpu(cpu, cell->cpu_set)
+			public_per_cpu(cpu)->restore_vcpu_state = false;
+		page_free(&mem_pool, cell->arch.restore_irqs, IRQ_STATE_PAGES);
+		cell->arch.restore_irqs = NULL;
+		return 0;
+	}
+
+	err = snapshot_check(cell, snapshot);
+	if (err)
+		return err;
+
+	if (snapshot->num_cpus != cell_num_cpus(cell) ||
+	    snapshot->irq_state_size != sizeof(*irqs) ||
+	    snapshot->cpu_state_size != sizeof(*state))
+		return trace_error(-EINVAL);
+
+	state = snapshot_vcpus(snapshot);
+	for (n = 0; n < snapshot->num_cpus; n++)
+		if (state[n].online && !pstate_valid(state[n].pstate))
+			return trace_error(-EINVAL);
+
+	if (!cell->arch.restore_irqs) {
+		cell->arch.restore_irqs = page_alloc(&mem_pool,
+						     IRQ_STATE_PAGES);
+		if (!cell->arch.restore_irqs)
+			return -ENOMEM;
+	}
+	memcpy(cell->arch.restore_irqs, snapshot_irqs(snapshot),
+	       sizeof(*irqs));
+
+	for_each_cpu(cpu, cell->cpu_set) {
+		memcpy(&public_per_cpu(cpu)->vcpu_state, state++,
+		       sizeof(*state));
+		public_per_cpu(cpu)->restore_vcpu_state = true;
+	}
+
+	return 0;
+}
+
+void snapshot_cell_restore(struct cell *cell)
+{
+	struct jailhouse_irq_state *irqs = cell->arch.restore_irqs;
+	unsigned int cpu, irq, word, shift;
+	void *icfgr;
+	u32 cfg;
+
+	if (!irqs)
+		return;
+
+	for_each_cpu(cpu, cell->cpu_set)
+		if (public_per_cpu(cpu)->vcpu_state.online) {
+			public_per_cpu(cpu)->cpu_on_entry =
+				public_per_cpu(cpu)->vcpu_state.pc;
+		} else {
+			public_per_cpu(cpu)->cpu_on_entry =
+				PSCI_INVALID_ADDRESS;
+			public_per_cpu(cpu)->restore_vcpu_state = false;
+		}
+
+	/* SPIs are masked by irqchip_cell_reset, configure before enabling */
+	spin_lock(&dist_lock);
+	for (irq = 32; irq < ARRAY_SIZE(irqs->priority); irq++) {
+		if (!irqchip_irq_in_cell(cell, irq))
+			continue;
+
+		word = irq / 16;
+		shift = (irq % 16) * 2;
+		icfgr = gicd_base + GICD_ICFGR + word * 4;
+		cfg = mmio_read32(icfgr) & ~(3 << shift);
+		mmio_write32(icfgr, cfg | (irqs->config[word] & (3 << shift)));
+
+		mmio_write8(gicd_base + GICD_IPRIORITYR + irq,
+			    irqs->priority[irq]);
+
+		cpu = arm_cpu_by_mpidr(cell,
+				       irqs->route[irq] & MPIDR_CPUID_MASK);
+		if (cell_owns_cpu(cell, cpu))
+			mmio_write64(gicd_base + GICD_IROUTER + 8 * irq,
+				     irqs->route[irq]);
+	}
+	for (word = 1; word < ARRAY_SIZE(irqs->enabled); word++)
+		mmio_write32(gicd_base + GICD_ISENABLER + word * 4,
+			     irqs->enabled[word] & cell->arch.irq_bitmap[word]);
+	spin_unlock(&dist_lock);
+
+	page_free(&mem_pool, irqs, IRQ_STATE_PAGES);
+	cell->arch.restore_irqs = NULL;
+}
+
+void snapshot_cpu_restore(void)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	struct jailhouse_vcpu_state *state = &cpu_data->public.vcpu_state;
+	void *gicr = cpu_data->public.gicr.base + GICR_SGI_BASE;
+	u32 mask = this_cell()->arch.irq_bitmap[0];
+	unsigned int n;
+
+	if (!cpu_data->public.restore_vcpu_state)
+		return;
+	cpu_data->public.restore_vcpu_state = false;
+
+	vcpu_state_load(state);
+
+	arm_write_sysreg(ICH_VMCR_EL2, state->ich_vmcr);
+	for (n = 0; n < 32; n++)
+		if (mask & (1 << n))
+			mmio_write8(gicr + GICR_IPRIORITYR + n,
+				    state->sgi_ppi_priority[n]);
+	mmio_write32(gicr + GICR_ISENABLER, state->sgi_ppi_enabled & mask);
+}
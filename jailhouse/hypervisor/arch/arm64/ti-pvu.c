@@ -30,6 +30,7 @@
 #include <jailhouse/printk.h>
 #include <jailhouse/unit.h>
 #include <asm/iommu.h>
+#include <asm/spinlock.h>
 #include <asm/ti-pvu.h>
 
 #define MAX_PVU_ENTRIES		(PAGE_SIZE / sizeof (struct pvu_tlb_entry))
@@ -38,6 +39,9 @@
 static struct pvu_dev pvu_units[JAILHOUSE_MAX_IOMMU_UNITS];
 static unsigned int pvu_count;
 
+/* the root cell regions are mapped in parallel at setup */
+static spinlock_t pvu_entries_lock;
+
 static const u64 pvu_page_size_bytes[] = {
 	4 * 1024,
 	16 * 1024,
@@ -382,9 +386,6 @@ int pvu_iommu_map_memory(struct cell *cell,
 	if (pvu_count == 0 || (mem->flags & JAILHOUSE_MEM_DMA) == 0)
 		return 0;
 
-	if (cell->arch.iommu_pvu.ent_count == MAX_PVU_ENTRIES)
-		return -ENOMEM;
-
 	if (mem->flags & JAILHOUSE_MEM_READ)
 		flags |= (LPAE_PAGE_PERM_UR | LPAE_PAGE_PERM_SR);
 	if (mem->flags & JAILHOUSE_MEM_WRITE)
@@ -395,13 +396,20 @@ int pvu_iommu_map_memory(struct cell *cell,
 	flags |= (LPAE_PAGE_MEM_WRITETHROUGH | LPAE_PAGE_OUTER_SHARABLE |
 		  LPAE_PAGE_IS_NOALLOC | LPAE_PAGE_OS_NOALLOC);
 
+	spin_lock(&pvu_entries_lock);
+
+	if (cell->arch.iommu_pvu.ent_count == MAX_PVU_ENTRIES) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
 	ent = &cell->arch.iommu_pvu.entries[cell->arch.iommu_pvu.ent_count];
 	size = MAX_PVU_ENTRIES - cell->arch.iommu_pvu.ent_count;
 
 	ret = pvu_entrylist_create(mem->virt_start, mem->phys_start, mem->size,
 				   flags, ent, size);
 	if (ret < 0)
-		return ret;
+		goto out;
 
 	/*
 	 * Check if there are enough TLBs left for *chaining* to ensure that
@@ -413,11 +421,16 @@ int pvu_iommu_map_memory(struct cell *cell,
 
 	if (tlb_count > dev->free_tlb_count) {
 		printk("ERROR: PVU: Mapping this memory needs more TLBs than that are available\n");
-		return -EINVAL;
+		ret = -EINVAL;
+		goto out;
 	}
 
 	cell->arch.iommu_pvu.ent_count += ret;
-	return 0;
+	ret = 0;
+
+out:
+	spin_unlock(&pvu_entries_lock);
+	return ret;
 }
 
 int pvu_iommu_unmap_memory(struct cell *cell,
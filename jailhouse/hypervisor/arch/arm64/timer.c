@@ -33,12 +33,11 @@
  * 	enable delivery of timer interrupt to CPU at init
  *
  * Timer (CNTHP_CTL_EL2) management:
- * 	only install one timer interrupt handler
  * 	programming and unmasking on all CPUs
+ * 	clients queue timer_events per CPU, sorted by deadline
+ * 	CNTHP_CVAL_EL2 always holds the earliest deadline
  */
 
-/* Private timer ISR handler */
-static bool (*_timer_isr_handler)(void) = NULL;
 /* Timer interrupt */
 unsigned int hv_timer_irq = 0;
 
@@ -50,20 +49,81 @@ u64 timer_us_to_ticks(u64 us)
 	return (us * timer_get_frequency()) / 1000000;
 }
 
-int timer_register(unsigned int irq, bool (*handler)(void))
+u64 timer_ticks_to_us(u64 ticks)
+{
+	unsigned long freq = timer_get_frequency();
+
+	/* split to avoid overflowing on long intervals */
+	return (ticks / freq) * 1000000 + ((ticks % freq) * 1000000) / freq;
+}
+
+int timer_init(unsigned int irq)
 {
 	if (!is_ppi(irq)) {
 		printk("Expected PPI interrupt, got %u\n", irq);
 		return -ENODEV;
 	}
 
-	assert(_timer_isr_handler == NULL);
-	_timer_isr_handler = handler;
 	hv_timer_irq = irq;
 
 	return 0;
 }
 
+static void timer_program_next(struct per_cpu *cpu_data)
+{
+	struct timer_event *next = cpu_data->timer_queue;
+
+	timer_set_cmpval(next ? next->deadline : 0xffffffffffffffffULL);
+}
+
+static bool timer_event_unlink(struct per_cpu *cpu_data,
+			       struct timer_event *event)
+{
+	struct timer_event **link;
+
+	for (link = &cpu_data->timer_queue; *link; link = &(*link)->next)
+		if (*link == event) {
+			*link = event->next;
+			event->deadline = 0;
+			return true;
+		}
+	return false;
+}
+
+void timer_event_arm(struct timer_event *event, u64 deadline)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	struct timer_event **link;
+	bool was_first = cpu_data->timer_queue == event;
+
+	assert(arm_is_irq_off());
+
+	timer_event_unlink(cpu_data, event);
+
+	/* 0 means not queued, such a deadline has passed anyway */
+	event->deadline = deadline ? deadline : 1;
+	for (link = &cpu_data->timer_queue; *link; link = &(*link)->next)
+		if ((*link)->deadline > event->deadline)
+			break;
+	event->next = *link;
+	*link = event;
+
+	/* Only touch the hardware if the earliest deadline changed */
+	if (was_first || cpu_data->timer_queue == event)
+		timer_program_next(cpu_data);
+}
+
+void timer_event_cancel(struct timer_event *event)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	bool was_first = cpu_data->timer_queue == event;
+
+	assert(arm_is_irq_off());
+
+	if (timer_event_unlink(cpu_data, event) && was_first)
+		timer_program_next(cpu_data);
+}
+
 /** CPU shutdown, invoked when jailhouse is disabled */
 void timer_cpu_shutdown(void)
 {
@@ -72,9 +132,7 @@ void timer_cpu_shutdown(void)
 	timer_mask();
 	timer_disable();
 
-	if (ACCESS_ONCE(_timer_isr_handler) != NULL) {
-		_timer_isr_handler = NULL;
-	}
+	this_cpu_data()->timer_queue = NULL;
 
 	/* Disable distributor IRQ */
 	if (system_config->platform_info.arm.gic_version == 3)
@@ -83,9 +141,33 @@ void timer_cpu_shutdown(void)
 		gicv2_disable_irq(hv_timer_irq);
 }
 
+/* Re-arm periods of the virtual console drain, in us */
+#define CONSOLE_DRAIN_BUSY_US	500
+#define CONSOLE_DRAIN_IDLE_US	10000
+
+/*
+ * Drain the virtual console to the UART from the first root cell CPU, in
+ * small steps that never wait for the UART. Stops once the CPU has been
+ * handed to a non-root cell.
+ */
+static void console_drain_isr(struct timer_event *event)
+{
+	bool pending;
+
+	if (this_cell() != &root_cell)
+		return;
+
+	pending = console_drain();
+	timer_event_arm(event, timer_get_ticks() +
+			timer_us_to_ticks(pending ? CONSOLE_DRAIN_BUSY_US :
+					  CONSOLE_DRAIN_IDLE_US));
+}
+
 /** Initialize the CNTHP_CTL_EL2 timer */
 void timer_cpu_init(void)
 {
+	this_cpu_data()->timer_queue = NULL;
+
 	/* Approx 200 years from 0: UINT64_MAX */
 	timer_set_cmpval(0xffffffffffffffffULL);
 	timer_unmask();
@@ -96,15 +178,34 @@ void timer_cpu_init(void)
 	else
 		gicv2_enable_irq(hv_timer_irq);
 
-	/* NOTE: init completed, timer_enable() will
-	 * trigger an interrupt if counter > timer
-	 */
+	/* Nothing is armed yet, the timer only fires on timer_event_arm() */
+	timer_enable();
+
+	if (virtual_console &&
+	    CON_HAS_DRAIN(system_config->debug_console.flags) &&
+	    this_cpu_id() == first_cpu(root_cell.cpu_set)) {
+		this_cpu_data()->console_drain_timer.handler =
+			console_drain_isr;
+		timer_event_arm(&this_cpu_data()->console_drain_timer,
+				timer_get_ticks() +
+				timer_us_to_ticks(CONSOLE_DRAIN_BUSY_US));
+	}
 }
 
+/** Run the handlers of all expired events, then wait for the next one */
 bool timer_isr_handler(void)
 {
-	if (_timer_isr_handler != NULL)
-		return (*_timer_isr_handler)();
-	else
-		return true;
+	struct per_cpu *cpu_data = this_cpu_data();
+	struct timer_event *event;
+	u64 now = timer_get_ticks();
+
+	while ((event = cpu_data->timer_queue) && event->deadline <= now) {
+		cpu_data->timer_queue = event->next;
+		event->deadline = 0;
+		if (event->handler)
+			event->handler(event);
+	}
+	timer_program_next(cpu_data);
+
+	return true;
 }
@@ -16,9 +16,11 @@
 #include <jailhouse/panic.h>
 #include <asm/control.h>
 #include <asm/entry.h>
+#include <asm/exit_stats.h>
 #include <asm/gic.h>
 #include <asm/mmio.h>
 #include <asm/psci.h>
+#include <asm/sched.h>
 #include <asm/smccc.h>
 #include <asm/sysregs.h>
 #include <asm/traps.h>
@@ -52,6 +54,41 @@ static enum trap_return handle_hvc(struct trap_context *ctx)
 	return TRAP_HANDLED;
 }
 
+/**
+ * Handle a hypercall from the entry.S fast path, which only saved the
+ * registers a C function may clobber: x0 to x18 and x30 of @c guest_regs are
+ * valid. Hypercalls that may reset, park or inspect the calling CPU are left
+ * to the full trap path.
+ *
+ * @return true if the hypercall was handled, its result is in x0.
+ */
+bool arch_handle_hvc_fast(union registers *guest_regs)
+{
+	unsigned long *regs = guest_regs->usr;
+	u64 start = exit_stats_start();
+	u64 esr;
+
+	switch (regs[0]) {
+	case JAILHOUSE_HC_HYPERVISOR_GET_INFO:
+	case JAILHOUSE_HC_CELL_GET_STATE:
+	case JAILHOUSE_HC_CPU_GET_INFO:
+	case JAILHOUSE_HC_DEBUG_CONSOLE_PUTC:
+	case JAILHOUSE_HC_DEBUG_CONSOLE_PUTS:
+	case JAILHOUSE_HC_MEMGUARD_SET:
+		break;
+	default:
+		return false;
+	}
+
+	regs[0] = hypercall(regs[0], regs[1], regs[2]);
+
+	/* published with the next full exit */
+	arm_read_sysreg(ESR_EL2, esr);
+	exit_stats_trap(esr, start);
+
+	return true;
+}
+
 static enum trap_return handle_sysreg(struct trap_context *ctx)
 {
 	u32 esr = ctx->esr;
@@ -87,6 +124,10 @@ static enum trap_return handle_iabt(struct trap_context *ctx)
 	arm_read_sysreg(HPFAR_EL2, hpfar);
 	arm_read_sysreg(FAR_EL2, hdfar);
 
+	if (ESR_FSC_TRANSLATION(ctx->esr) &&
+	    arm_paging_cell_lazy_fault(hpfar << 8))
+		return TRAP_HANDLED;
+
 	panic_printk("FATAL: instruction abort at 0x%lx\n",
 		     (hpfar << 8) | (hdfar & 0xfff));
 	return TRAP_FORBIDDEN;
@@ -173,6 +214,7 @@ static const trap_handler trap_handlers[0x40] =
 
 void arch_handle_trap(union registers *guest_regs)
 {
+	u64 start = exit_stats_start();
 	struct trap_context ctx;
 	trap_handler handler;
 	int ret = TRAP_UNHANDLED;
@@ -192,6 +234,23 @@ void arch_handle_trap(union registers *guest_regs)
 		dump_regs(&ctx);
 		panic_park();
 	}
+
+	exit_stats_trap(ctx.esr, start);
+	exit_stats_publish();
+
+	sched_switch_point(&this_cpu_public()->sched);
+}
+
+/*
+ * Interrupt exit. Like the end of arch_handle_trap, this is where a
+ * time-shared CPU switches its vCPU: no handler keeps registers of the
+ * interrupted one.
+ */
+void arch_handle_irq(void)
+{
+	irqchip_handle_irq();
+
+	sched_switch_point(&this_cpu_public()->sched);
 }
 
 void arch_el2_abt(union registers *regs)
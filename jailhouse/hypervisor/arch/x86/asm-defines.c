@@ -25,6 +25,18 @@ void common(void)
 	OFFSET(PERCPU_VMCB_RAX, per_cpu, vmcb.rax);
 	BLANK();
 
+	COMMENT("public per-CPU layout, see struct public_per_cpu");
+	OFFSET(PERCPU_LAYOUT_PUBLIC, per_cpu, public);
+	OFFSET(PERCPU_LAYOUT_LOCAL_HOT, public_per_cpu, cpu_id);
+	OFFSET(PERCPU_LAYOUT_REMOTE, public_per_cpu, suspend_cpu);
+	OFFSET(PERCPU_LAYOUT_STATS, public_per_cpu, stats);
+	OFFSET(PERCPU_LAYOUT_MEMGUARD, public_per_cpu, memguard);
+	OFFSET(PERCPU_LAYOUT_MEMGUARD_REMOTE, public_per_cpu, memguard.block);
+	OFFSET(PERCPU_LAYOUT_PRINTK, public_per_cpu, printk_ring);
+	OFFSET(PERCPU_LAYOUT_CONTROL, public_per_cpu, control_lock);
+	DEFINE(PERCPU_LAYOUT_SIZE, sizeof(struct public_per_cpu));
+	BLANK();
+
 	/* GCC evaluates constant expressions involving built-ins
 	 * at compilation time, so this yields computed value.
 	 */
@@ -103,6 +103,57 @@ void arch_cell_reset(struct cell *cell)
 	ioapic_cell_reset(cell);
 }
 
+unsigned long arch_timestamp_khz(void)
+{
+	return system_config->platform_info.x86.tsc_khz;
+}
+
+int arch_cell_snapshot(struct cell *cell,
+		       struct jailhouse_cell_snapshot *snapshot)
+{
+	return trace_error(-ENOSYS);
+}
+
+int arch_cell_prepare_restore(struct cell *cell,
+			      const struct jailhouse_cell_snapshot *snapshot)
+{
+	return trace_error(-ENOSYS);
+}
+
+int arch_cpu_move_check(unsigned int cpu_id)
+{
+	/* the comm region and the interrupt routing are not updated */
+	return trace_error(-ENOSYS);
+}
+
+void arch_cell_cpus_changed(struct cell *cell)
+{
+}
+
+int arch_cpu_share_check(struct cell *cell, unsigned int cpu_id)
+{
+	return trace_error(-ENOSYS);
+}
+
+void arch_cpu_share(struct cell *cell, unsigned int cpu_id)
+{
+}
+
+bool arch_cpu_unshare(struct cell *cell, unsigned int cpu_id)
+{
+	return false;
+}
+
+void arch_cell_suspend_cpu(struct cell *cell, unsigned int cpu_id)
+{
+}
+
+int arch_cpu_schedule(unsigned int cpu_id,
+		      const struct jailhouse_cpu_schedule *schedule)
+{
+	return trace_error(-ENOSYS);
+}
+
 void arch_config_commit(struct cell *cell_added_removed)
 {
 	iommu_config_commit(cell_added_removed);
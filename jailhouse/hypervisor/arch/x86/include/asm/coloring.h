@@ -22,6 +22,21 @@ static inline int color_copy_root(struct cell *root, bool init)
 	return -EINVAL;
 }
 
+static inline int color_cell_recolor(struct cell *cell, u64 colors)
+{
+	return -EINVAL;
+}
+
+static inline void color_cell_exit(struct cell *cell)
+{
+	return;
+}
+
+static inline long color_get_info(unsigned long type)
+{
+	return -EINVAL;
+}
+
 static inline int
 color_paging_create(const struct paging_structures *pg_structs,
 		    unsigned long phys, unsigned long size, unsigned long virt,
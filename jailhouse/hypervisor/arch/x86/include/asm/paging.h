@@ -59,6 +59,17 @@ static inline void arch_paging_flush_page_tlbs(unsigned long page_addr)
 	asm volatile("invlpg (%0)" : : "r" (page_addr));
 }
 
+static inline void arch_paging_flush_all_tlbs(void)
+{
+	/* the hypervisor does not use global pages */
+	write_cr3(read_cr3());
+}
+
+static inline void arch_paging_flush_guest_tlbs(void)
+{
+	/* cell CPUs flush EPT/NPT on config commit, see vcpu_tlb_flush */
+}
+
 extern unsigned long cache_line_size;
 
 static inline void arch_paging_flush_cpu_caches(void *addr, long size)
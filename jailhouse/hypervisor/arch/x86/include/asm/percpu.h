@@ -38,7 +38,7 @@
 	 * @li public_per_cpu::flush_vcpu_caches			\
 	 * @li public_per_cpu::update_cat				\
 	 */								\
-	spinlock_t control_lock;					\
+	spinlock_t control_lock __cacheline_aligned;			\
 									\
 	/** True if CPU is waiting for SIPI. */				\
 	volatile bool wait_for_sipi;					\
@@ -309,6 +309,21 @@ static inline void write_cr4(unsigned long val)
 	asm volatile("mov %0,%%cr4" : : "r" (val), "m" (__force_order));
 }
 
+/** Free-running timestamp for profiling, in TSC cycles */
+static inline u64 cpu_timestamp(void)
+{
+	u32 low, high;
+
+	asm volatile("rdtsc" : "=a" (low), "=d" (high));
+	return low | ((u64)high << 32);
+}
+
+/** Waits while *addr may still hold old. Callers have to recheck *addr. */
+static inline void cpu_wait_for_change(volatile void *addr, u32 old)
+{
+	cpu_relax();
+}
+
 static inline unsigned long read_msr(unsigned int msr)
 {
 	u32 low, high;
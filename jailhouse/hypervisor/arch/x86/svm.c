@@ -234,6 +234,11 @@ unsigned long arch_paging_gphys2phys(unsigned long gphys,
 				gphys, flags);
 }
 
+const struct paging_structures *arch_cell_paging_structs(struct cell *cell)
+{
+	return &cell->arch.svm.npt_iommu_structs;
+}
+
 static void npt_iommu_set_next_pt_l4(pt_entry_t pte, unsigned long next_pt)
 {
 	/*
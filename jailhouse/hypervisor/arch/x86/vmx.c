@@ -336,6 +336,11 @@ unsigned long arch_paging_gphys2phys(unsigned long gphys, unsigned long flags)
 				flags);
 }
 
+const struct paging_structures *arch_cell_paging_structs(struct cell *cell)
+{
+	return &cell->arch.vmx.ept_structs;
+}
+
 int vcpu_vendor_cell_init(struct cell *cell)
 {
 	/* build root EPT of cell */
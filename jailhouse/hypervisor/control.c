@@ -15,8 +15,11 @@
 #include <jailhouse/mmio.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/paging.h>
+#include <jailhouse/parallel.h>
 #include <jailhouse/processor.h>
+#include <jailhouse/shmem.h>
 #include <jailhouse/string.h>
+#include <jailhouse/tracepoint.h>
 #include <jailhouse/unit.h>
 #include <jailhouse/utils.h>
 #include <jailhouse/memguard.h>
@@ -26,11 +29,18 @@
 #ifdef __aarch64__
 /* QoS Support only provided on arm64 */
 #include <asm/qos.h>
+/* So is IOMMU fault reporting */
+#include <asm/smmu.h>
+/* and PMU sampling */
+#include <asm/perf.h>
+/* and the page-table cache */
+#include <asm/pt_cache.h>
 #endif
 
 enum msg_type {MSG_REQUEST, MSG_INFORMATION};
 enum failure_mode {ABORT_ON_ERROR, WARN_ON_ERROR};
-enum management_task {CELL_START, CELL_SET_LOADABLE, CELL_DESTROY};
+enum management_task {CELL_START, CELL_SET_LOADABLE, CELL_DESTROY,
+		      CELL_RECOLOR, CELL_SNAPSHOT, CELL_MEM_RESIZE};
 
 /** System configuration as used while activating the hypervisor. */
 struct jailhouse_system *system_config;
@@ -161,8 +171,11 @@ static void cell_suspend(struct cell *cell)
 {
 	unsigned int cpu;
 
-	for_each_cpu_except(cpu, cell->cpu_set, this_cpu_id())
+	tracepoint(TRACE_CELL_SUSPEND, cell->config->id, 0, 0);
+	for_each_cpu_except(cpu, cell->cpu_set, this_cpu_id()) {
 		suspend_cpu(cpu);
+		arch_cell_suspend_cpu(cell, cpu);
+	}
 }
 
 static void cell_resume(struct cell *cell)
@@ -171,6 +184,7 @@ static void cell_resume(struct cell *cell)
 
 	for_each_cpu_except(cpu, cell->cpu_set, this_cpu_id())
 		resume_cpu(cpu);
+	tracepoint(TRACE_CELL_RESUME, cell->config->id, 0, 0);
 }
 
 /**
@@ -190,16 +204,24 @@ static void cell_resume(struct cell *cell)
 static bool cell_exchange_message(struct cell *cell, u32 message,
 				  enum msg_type type)
 {
+	struct jailhouse_comm_region *comm_region =
+		&cell->comm_page.comm_region;
 	u64 timeout = cell->config->msg_reply_timeout;
+	unsigned long khz = arch_timestamp_khz();
+	u64 start;
 
 	if (cell->config->flags & JAILHOUSE_CELL_PASSIVE_COMMREG)
 		return true;
 
-	jailhouse_send_msg_to_cell(&cell->comm_page.comm_region, message);
+	/* microseconds to timestamp ticks, without overflowing */
+	timeout = timeout / 1000 * khz + timeout % 1000 * khz / 1000;
+
+	jailhouse_send_msg_to_cell(comm_region, message);
+	start = cpu_timestamp();
 
 	while (1) {
-		u32 reply = cell->comm_page.comm_region.reply_from_cell;
-		u32 cell_state = cell->comm_page.comm_region.cell_state;
+		u32 reply = comm_region->reply_from_cell;
+		u32 cell_state = comm_region->cell_state;
 
 		if (cell_state == JAILHOUSE_CELL_SHUT_DOWN ||
 		    cell_state == JAILHOUSE_CELL_FAILED)
@@ -214,16 +236,17 @@ static bool cell_exchange_message(struct cell *cell, u32 message,
 		if (reply != JAILHOUSE_MSG_NONE)
 			return false;
 
-		if (cell->config->msg_reply_timeout > 0 && --timeout == 0) {
+		if (cell->config->msg_reply_timeout > 0 &&
+		    cpu_timestamp() - start >= timeout) {
 			printk("Timeout expired while waiting for reply from "
 			       "target cell\n");
 			cell_suspend(cell);
-			cell->comm_page.comm_region.cell_state =
-				JAILHOUSE_CELL_FAILED;
+			comm_region->cell_state = JAILHOUSE_CELL_FAILED;
 			return true;
 		}
 
-		cpu_relax();
+		/* the reply shares its cache line with cell_state */
+		cpu_wait_for_change(&comm_region->reply_from_cell, reply);
 	}
 }
 
@@ -396,15 +419,121 @@ static int remap_to_root_cell(const struct jailhouse_memory *mem,
 	return err;
 }
 
+/*
+ * A resizable region is plain RAM, so that its tail can be handed over in
+ * steps with a 1:1 relation between guest and physical addresses.
+ */
+static bool resizable_region_ok(struct cell *cell,
+				const struct jailhouse_memory *mem)
+{
+	const unsigned long unsupported = JAILHOUSE_MEM_IO |
+		JAILHOUSE_MEM_COMM_REGION | JAILHOUSE_MEM_ROOTSHARED |
+		JAILHOUSE_MEM_COLORED | JAILHOUSE_MEM_LAZY;
+
+	/* only one per cell */
+	if (cell->resizable_size != 0)
+		return false;
+
+	return !(mem->flags & unsupported) &&
+		((mem->phys_start | mem->virt_start | mem->size) &
+		 (JAILHOUSE_MEM_RESIZE_STEP - 1)) == 0;
+}
+
+static const struct jailhouse_memory *resizable_region(struct cell *cell)
+{
+	const struct jailhouse_memory *mem;
+	unsigned int n;
+
+	for_each_mem_region(mem, cell->config, n)
+		if (mem->flags & JAILHOUSE_MEM_RESIZABLE)
+			return mem;
+	return NULL;
+}
+
+/*
+ * Moves the tail of the resizable region between the cell and the root cell
+ * so that the cell keeps the first size bytes. Both cells are suspended.
+ */
+static int resize_region(struct cell *cell, unsigned long long size)
+{
+	const struct jailhouse_memory *mem = resizable_region(cell);
+	const struct jailhouse_memory *other_mem;
+	struct jailhouse_memory tail = *mem;
+	struct cell *other;
+	unsigned int n;
+	int err;
+
+	if (size == cell->resizable_size)
+		return 0;
+
+	tail.phys_start += MIN(size, cell->resizable_size);
+	tail.virt_start += MIN(size, cell->resizable_size);
+	tail.size = MAX(size, cell->resizable_size) -
+		MIN(size, cell->resizable_size);
+
+	if (size < cell->resizable_size) {
+		err = arch_unmap_memory_region(cell, &tail);
+		if (err)
+			return err;
+
+		err = remap_to_root_cell(&tail, ABORT_ON_ERROR);
+		if (err) {
+			/* the tail was mapped as a whole before */
+			arch_map_memory_region(cell, &tail);
+			return err;
+		}
+	} else {
+		/* the root cell may have passed the memory on meanwhile */
+		for_each_non_root_cell(other) {
+			if (other == cell)
+				continue;
+			for_each_mem_region(other_mem, other->config, n)
+				if (!(other_mem->flags &
+				      JAILHOUSE_MEM_ROOTSHARED) &&
+				    other_mem->phys_start <
+					tail.phys_start + tail.size &&
+				    tail.phys_start <
+					other_mem->phys_start + other_mem->size)
+					return -EBUSY;
+		}
+
+		err = unmap_from_root_cell(&tail, true);
+		if (err)
+			return err;
+
+		err = arch_map_memory_region(cell, &tail);
+		if (err) {
+			remap_to_root_cell(&tail, WARN_ON_ERROR);
+			return err;
+		}
+	}
+
+	config_commit(NULL);
+	arch_flush_cell_vcpu_caches(cell);
+
+	cell->resizable_size = size;
+
+	return 0;
+}
+
 static void cell_destroy_internal(struct cell *cell)
 {
 	const struct jailhouse_memory *mem;
 	unsigned int cpu, n;
 	struct unit *unit;
 
+	printk_cell_flush(cell);
+
 	cell->comm_page.comm_region.cell_state = JAILHOUSE_CELL_SHUT_DOWN;
 
 	for_each_cpu(cpu, cell->cpu_set) {
+		/* a time-shared CPU stays with the other cell */
+		if (arch_cpu_unshare(cell, cpu)) {
+			clear_bit(cpu, cell->cpu_set->bitmap);
+			resume_cpu(cpu);
+			continue;
+		}
+
 		arch_park_cpu(cpu);
 
 		set_bit(cpu, root_cell.cpu_set->bitmap);
@@ -437,6 +566,21 @@ static void cell_destroy_internal(struct cell *cell)
 	cell_exit(cell);
 }
 
+/*
+ * A CPU of another non-root cell can only be added to a new cell if both
+ * cells permit time-sharing, see JAILHOUSE_CELL_CPU_SHARED.
+ */
+static int cpu_share_check(struct cell *cell, unsigned int cpu)
+{
+	struct cell *owner = public_per_cpu(cpu)->cell;
+
+	if (!(cell->config->flags & JAILHOUSE_CELL_CPU_SHARED) ||
+	    !(owner->config->flags & JAILHOUSE_CELL_CPU_SHARED))
+		return trace_error(-EBUSY);
+
+	return arch_cpu_share_check(cell, cpu);
+}
+
 static int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 {
 	unsigned long cfg_page_offs = config_address & PAGE_OFFS_MASK;
@@ -453,59 +597,43 @@ static int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 	if (cpu_data->public.cell != &root_cell)
 		return -EPERM;
 
-	cell_suspend(&root_cell);
-
-	if (!cell_reconfig_ok(NULL)) {
-		err = -EPERM;
-		goto err_resume;
-	}
-
+	/*
+	 * Until the new cell takes resources from the root cell, only
+	 * hypervisor-private state is set up. The root cell keeps running
+	 * meanwhile.
+	 */
 	cfg_pages = PAGES(cfg_page_offs + sizeof(struct jailhouse_cell_desc));
 	cfg_mapping = paging_get_guest_pages(NULL, config_address, cfg_pages,
 					     PAGE_READONLY_FLAGS);
-	if (!cfg_mapping) {
-		err = -ENOMEM;
-		goto err_resume;
-	}
+	if (!cfg_mapping)
+		return -ENOMEM;
 
 	cfg = (struct jailhouse_cell_desc *)(cfg_mapping + cfg_page_offs);
 
-	for_each_cell(cell)
-		/*
-		 * No bound checking needed, thus strcmp is safe here because
-		 * sizeof(cell->config->name) == sizeof(cfg->name) and
-		 * cell->config->name is guaranteed to be null-terminated.
-		 */
-		if (strcmp(cell->config->name, cfg->name) == 0 ||
-		    cell->config->id == cfg->id) {
-			err = -EEXIST;
-			goto err_resume;
-		}
-
 	cfg_total_size = jailhouse_cell_config_size(cfg);
 	cfg_pages = PAGES(cfg_page_offs + cfg_total_size);
-	if (cfg_pages > NUM_TEMPORARY_PAGES) {
-		err = trace_error(-E2BIG);
-		goto err_resume;
-	}
+	if (cfg_pages > NUM_TEMPORARY_PAGES)
+		return trace_error(-E2BIG);
 
 	if (!paging_get_guest_pages(NULL, config_address, cfg_pages,
-				    PAGE_READONLY_FLAGS)) {
-		err = -ENOMEM;
-		goto err_resume;
-	}
+				    PAGE_READONLY_FLAGS))
+		return -ENOMEM;
 
 	cell_pages = PAGES(sizeof(*cell) + cfg_total_size);
 	cell = page_alloc(&mem_pool, cell_pages);
-	if (!cell) {
-		err = -ENOMEM;
-		goto err_resume;
-	}
+	if (!cell)
+		return -ENOMEM;
 
 	cell->data_pages = cell_pages;
 	cell->config = ((void *)cell) + sizeof(*cell);
 	memcpy(cell->config, cfg, cfg_total_size);
 
+	/* the root cell may have changed the config while it was copied */
+	if (jailhouse_cell_config_size(cell->config) != cfg_total_size) {
+		err = trace_error(-EINVAL);
+		goto err_free_cell;
+	}
+
 	err = cell_init(cell);
 	if (err)
 		goto err_free_cell;
@@ -516,17 +644,41 @@ static int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 		goto err_cell_exit;
 	}
 
-	/* the root cell's cpu set must be super-set of new cell's set */
+	/*
+	 * The root cell's cpu set must be super-set of new cell's set, except
+	 * for CPUs the new cell time-shares with another one.
+	 */
 	for_each_cpu(cpu, cell->cpu_set)
 		if (!cell_owns_cpu(&root_cell, cpu)) {
-			err = trace_error(-EBUSY);
-			goto err_cell_exit;
+			err = cpu_share_check(cell, cpu);
+			if (err)
+				goto err_cell_exit;
 		}
 
 	err = arch_cell_create(cell);
 	if (err)
 		goto err_cell_exit;
 
+	/* From here on, the root cell is changed and has to be stopped. */
+	cell_suspend(&root_cell);
+
+	if (!cell_reconfig_ok(NULL)) {
+		err = -EPERM;
+		goto err_arch_destroy;
+	}
+
+	for_each_cell(last)
+		/*
+		 * No bound checking needed, thus strcmp is safe here because
+		 * sizeof(last->config->name) == sizeof(cell->config->name) and
+		 * last->config->name is guaranteed to be null-terminated.
+		 */
+		if (strcmp(last->config->name, cell->config->name) == 0 ||
+		    last->config->id == cell->config->id) {
+			err = -EEXIST;
+			goto err_arch_destroy;
+		}
+
 	for_each_unit(unit) {
 		err = unit->cell_init(cell);
 		if (err) {
@@ -538,9 +690,15 @@ static int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 
 	/*
 	 * Shrinking: the new cell's CPUs are parked, then removed from the root
-	 * cell, assigned to the new cell and get their stats cleared.
+	 * cell, assigned to the new cell and get their stats cleared. Shared
+	 * CPUs keep running their cell and only gain a vCPU of the new one.
 	 */
 	for_each_cpu(cpu, cell->cpu_set) {
+		if (!cell_owns_cpu(&root_cell, cpu)) {
+			arch_cpu_share(cell, cpu);
+			continue;
+		}
+
 		arch_park_cpu(cpu);
 
 		clear_bit(cpu, root_cell.cpu_set->bitmap);
@@ -572,6 +730,14 @@ static int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 			err = arch_map_memory_region(cell, mem);
 		if (err)
 			goto err_destroy_cell;
+
+		if (mem->flags & JAILHOUSE_MEM_RESIZABLE) {
+			if (!resizable_region_ok(cell, mem)) {
+				err = trace_error(-EINVAL);
+				goto err_destroy_cell;
+			}
+			cell->resizable_size = mem->size;
+		}
 	}
 
 	config_commit(cell);
@@ -584,28 +750,29 @@ static int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 	last->next = cell;
 	num_cells++;
 
+	cell_resume(&root_cell);
+
+	/* the other cells may take their time to acknowledge */
 	cell_reconfig_completed();
 
 	printk("Created cell \"%s\"\n", cell->config->name);
 
 	paging_dump_stats("after cell creation");
 
-	cell_resume(&root_cell);
-
 	return 0;
 
 err_destroy_cell:
 	cell_destroy_internal(cell);
+	cell_resume(&root_cell);
 	/* cell_destroy_internal already calls arch_cell_destroy & cell_exit */
 	goto err_free_cell;
 err_arch_destroy:
 	arch_cell_destroy(cell);
+	cell_resume(&root_cell);
 err_cell_exit:
 	cell_exit(cell);
 err_free_cell:
 	page_free(&mem_pool, cell, cell_pages);
-err_resume:
-	cell_resume(&root_cell);
 
 	return err;
 }
@@ -624,53 +791,76 @@ static int cell_management_prologue(enum management_task task,
 	if (cpu_data->public.cell != &root_cell)
 		return -EPERM;
 
-	cell_suspend(&root_cell);
-
+	/*
+	 * Cells are only added and removed by management calls of the root
+	 * cell, and these do not run concurrently. Lookup and the message
+	 * exchange with the target cell, which may take until the reply
+	 * timeout, are therefore done while the root cell keeps running.
+	 */
 	for_each_cell(*cell_ptr)
 		if ((*cell_ptr)->config->id == id)
 			break;
 
-	if (!*cell_ptr) {
-		cell_resume(&root_cell);
+	if (!*cell_ptr)
 		return -ENOENT;
-	}
 
 	/* root cell cannot be managed */
-	if (*cell_ptr == &root_cell) {
-		cell_resume(&root_cell);
+	if (*cell_ptr == &root_cell)
 		return -EINVAL;
-	}
 
+	/*
+	 * Recoloring only pauses the cell, but it must not be locked against
+	 * reconfigurations.
+	 */
 	if ((task == CELL_DESTROY && !cell_reconfig_ok(*cell_ptr)) ||
-	    !cell_shutdown_ok(*cell_ptr)) {
-		cell_resume(&root_cell);
+	    ((task == CELL_RECOLOR || task == CELL_MEM_RESIZE) &&
+	     (*cell_ptr)->comm_page.comm_region.cell_state ==
+			JAILHOUSE_CELL_RUNNING_LOCKED) ||
+	    (task != CELL_RECOLOR && task != CELL_MEM_RESIZE &&
+	     !cell_shutdown_ok(*cell_ptr)))
 		return -EPERM;
-	}
 
+	cell_suspend(&root_cell);
 	cell_suspend(*cell_ptr);
 
 	return 0;
 }
 
-static int cell_start(struct per_cpu *cpu_data, unsigned long id)
+/*
+ * Starts the suspended cell, or restarts it in place if it was not set
+ * loadable. With restore, the vCPUs resume from the states staged by
+ * arch_cell_prepare_restore() instead.
+ */
+static int start_cell(struct cell *cell, bool restore)
 {
 	struct jailhouse_comm_region *comm_region;
 	const struct jailhouse_memory *mem;
 	unsigned int cpu, n;
-	struct cell *cell;
+	bool restart;
 	int err;
 
-	err = cell_management_prologue(CELL_START, cpu_data, id, &cell);
-	if (err)
-		return err;
-
+	/*
+	 * Starting a cell that was not set loadable restarts it in place: the
+	 * memory stays mapped as it is, only CPUs and devices are reset.
+	 */
+	restart = !cell->loadable &&
+		cell->comm_page.comm_region.cell_state !=
+			JAILHOUSE_CELL_SHUT_DOWN;
 	if (cell->loadable) {
+		/* a freshly loaded image expects all of its memory */
+		mem = resizable_region(cell);
+		if (mem) {
+			err = resize_region(cell, mem->size);
+			if (err)
+				return err;
+		}
+
 		/* unmap all loadable memory regions from the root cell */
 		for_each_mem_region(mem, cell->config, n)
 			if (mem->flags & JAILHOUSE_MEM_LOADABLE) {
 				err = unmap_from_root_cell(mem, false);
 				if (err)
-					goto out_resume;
+					return err;
 			}
 
 		config_commit(NULL);
@@ -707,7 +897,132 @@ static int cell_start(struct per_cpu *cpu_data, unsigned long id)
 		arch_reset_cpu(cpu);
 	}
 
-	printk("Started cell \"%s\"\n", cell->config->name);
+	printk("%s cell \"%s\"\n",
+	       restore ? "Restored" : restart ? "Restarted" : "Started",
+	       cell->config->name);
+
+	return 0;
+}
+
+static int cell_start(struct per_cpu *cpu_data, unsigned long id)
+{
+	struct cell *cell;
+	int err;
+
+	err = cell_management_prologue(CELL_START, cpu_data, id, &cell);
+	if (err)
+		return err;
+
+	err = start_cell(cell, false);
+
+	cell_resume(&root_cell);
+
+	return err;
+}
+
+/*
+ * Maps the snapshot buffer of the root cell at address, including the
+ * payload announced in its header.
+ */
+static struct jailhouse_cell_snapshot *map_snapshot(unsigned long address)
+{
+	unsigned long page_offs = address & PAGE_OFFS_MASK;
+	struct jailhouse_cell_snapshot *snapshot;
+	unsigned int pages;
+	void *mapping;
+
+	mapping = paging_get_guest_pages(NULL, address,
+					 PAGES(page_offs + sizeof(*snapshot)),
+					 PAGE_READONLY_FLAGS);
+	if (!mapping)
+		return NULL;
+	snapshot = mapping + page_offs;
+
+	if (snapshot->size < sizeof(*snapshot))
+		return NULL;
+	pages = PAGES(page_offs + snapshot->size);
+	if (pages > NUM_TEMPORARY_PAGES)
+		return NULL;
+
+	mapping = paging_get_guest_pages(NULL, address, pages,
+					 PAGE_DEFAULT_FLAGS);
+	if (!mapping)
+		return NULL;
+
+	return mapping + page_offs;
+}
+
+static int cell_snapshot(struct per_cpu *cpu_data, unsigned long id,
+			 unsigned long buffer_address)
+{
+	struct jailhouse_cell_snapshot *snapshot;
+	struct cell *cell;
+	unsigned int cpu;
+	int err;
+
+	err = cell_management_prologue(CELL_SNAPSHOT, cpu_data, id, &cell);
+	if (err)
+		return err;
+
+	if (cell->comm_page.comm_region.cell_state != JAILHOUSE_CELL_RUNNING) {
+		err = trace_error(-EINVAL);
+		goto out_resume;
+	}
+
+	snapshot = map_snapshot(buffer_address);
+	if (!snapshot) {
+		err = trace_error(-EINVAL);
+		goto out_resume;
+	}
+
+	err = arch_cell_snapshot(cell, snapshot);
+	if (err)
+		goto out_resume;
+
+	/*
+	 * Keep the cell stopped so that its memory matches the saved state
+	 * when the root cell reads it after setting the cell loadable.
+	 */
+	cell->comm_page.comm_region.cell_state = JAILHOUSE_CELL_SHUT_DOWN;
+	for_each_cpu(cpu, cell->cpu_set)
+		arch_park_cpu(cpu);
+
+	printk("Saved state of cell \"%s\"\n", cell->config->name);
+
+	cell_resume(&root_cell);
+	return 0;
+
+out_resume:
+	cell_resume(cell);
+	cell_resume(&root_cell);
+
+	return err;
+}
+
+static int cell_restore(struct per_cpu *cpu_data, unsigned long id,
+			unsigned long buffer_address)
+{
+	const struct jailhouse_cell_snapshot *snapshot;
+	struct cell *cell;
+	int err;
+
+	err = cell_management_prologue(CELL_START, cpu_data, id, &cell);
+	if (err)
+		return err;
+
+	snapshot = map_snapshot(buffer_address);
+	if (!snapshot) {
+		err = trace_error(-EINVAL);
+		goto out_resume;
+	}
+
+	err = arch_cell_prepare_restore(cell, snapshot);
+	if (err)
+		goto out_resume;
+
+	err = start_cell(cell, true);
+	if (err)
+		arch_cell_prepare_restore(cell, NULL);
 
 out_resume:
 	cell_resume(&root_cell);
@@ -761,6 +1076,272 @@ out_resume:
 	return err;
 }
 
+static int cell_recolor(struct per_cpu *cpu_data, unsigned long id,
+			unsigned long colors)
+{
+	struct cell *cell;
+	int err;
+
+	err = cell_management_prologue(CELL_RECOLOR, cpu_data, id, &cell);
+	if (err)
+		return err;
+
+	/* loadable regions are also mapped into the root cell */
+	if (cell->loadable) {
+		cell_resume(cell);
+		cell_resume(&root_cell);
+		return -EBUSY;
+	}
+
+	/* the root cell stays suspended, it maps the destination frames */
+	err = color_cell_recolor(cell, colors);
+	if (!err)
+		printk("Recolored cell \"%s\" to colors 0x%lx\n",
+		       cell->config->name, colors);
+
+	cell_resume(cell);
+	cell_resume(&root_cell);
+
+	return err;
+}
+
+/*
+ * Moves a CPU between the root cell and a non-root cell. The CPU has to be
+ * powered off in its current cell. It is parked in the destination cell and
+ * comes up there via PSCI CPU_ON, or when that cell is (re)started.
+ */
+static int cell_cpu_move(struct per_cpu *cpu_data, unsigned long id,
+			 unsigned long cpu_id)
+{
+	unsigned int cpu, num_cpus = 0;
+	struct cell *cell, *from, *to;
+	int err;
+
+	if (cpu_data->public.cell != &root_cell)
+		return -EPERM;
+
+	/* serialized against cell_create/destroy like the other calls */
+	for_each_cell(to)
+		if (to->config->id == id)
+			break;
+
+	if (!to)
+		return -ENOENT;
+
+	if (!cpu_id_valid(cpu_id))
+		return -EINVAL;
+	if (cpu_id == cpu_data->public.cpu_id)
+		return -EBUSY;
+
+	from = public_per_cpu(cpu_id)->cell;
+	if (from == to || (from != &root_cell && to != &root_cell))
+		return -EINVAL;
+	if (cpu_id > to->cpu_set->max_cpu_id)
+		return -ERANGE;
+
+	/* a cell cannot give up its last CPU */
+	for_each_cpu(cpu, from->cpu_set)
+		num_cpus++;
+	if (num_cpus == 1)
+		return -EBUSY;
+
+	cell = from == &root_cell ? to : from;
+
+	cell_suspend(&root_cell);
+	cell_suspend(cell);
+
+	if (!cell_reconfig_ok(NULL)) {
+		err = -EPERM;
+		goto out_resume;
+	}
+
+	err = arch_cpu_move_check(cpu_id);
+	if (err)
+		goto out_resume;
+
+	clear_bit(cpu_id, from->cpu_set->bitmap);
+	set_bit(cpu_id, to->cpu_set->bitmap);
+	public_per_cpu(cpu_id)->cell = to;
+	public_per_cpu(cpu_id)->failed = false;
+	memset(public_per_cpu(cpu_id)->stats, 0,
+	       sizeof(public_per_cpu(cpu_id)->stats));
+
+	/*
+	 * Stale TLB entries, the memguard budgets of the old cell and its
+	 * interrupt routing must not follow the CPU. The park request makes it
+	 * apply the first two.
+	 */
+	arch_flush_cell_vcpu_caches(to);
+	memguard_cpu_release(cpu_id);
+	arch_park_cpu(cpu_id);
+
+	arch_cell_cpus_changed(cell);
+
+	printk("Moved CPU %lu from cell \"%s\" to \"%s\"\n", cpu_id,
+	       from->config->name, to->config->name);
+
+out_resume:
+	cell_resume(cell);
+	cell_resume(&root_cell);
+
+	if (!err)
+		cell_reconfig_completed();
+
+	return err;
+}
+
+/*
+ * Shrinks or grows the resizable memory region of a cell in steps of
+ * JAILHOUSE_MEM_RESIZE_STEP, giving the tail back to the root cell or taking
+ * it from there. A running cell has to stop using the tail before it shrinks,
+ * see jailhouse/balloon.h.
+ */
+static int cell_mem_resize(struct per_cpu *cpu_data, unsigned long id,
+			   unsigned long size)
+{
+	const struct jailhouse_memory *mem;
+	struct cell *cell;
+	int err;
+
+	err = cell_management_prologue(CELL_MEM_RESIZE, cpu_data, id, &cell);
+	if (err)
+		return err;
+
+	mem = resizable_region(cell);
+	if (!mem || size == 0 || size > mem->size ||
+	    (size & (JAILHOUSE_MEM_RESIZE_STEP - 1)) != 0) {
+		err = -EINVAL;
+		goto out_resume;
+	}
+
+	/* loadable regions are also mapped into the root cell */
+	if (cell->loadable) {
+		err = -EBUSY;
+		goto out_resume;
+	}
+
+	err = resize_region(cell, size);
+	if (!err)
+		printk("Resized memory of cell \"%s\" to 0x%lx bytes\n",
+		       cell->config->name, size);
+
+out_resume:
+	cell_resume(cell);
+	cell_resume(&root_cell);
+
+	return err;
+}
+
+/* Colors of the first colored region of cell id */
+static int cell_colors(unsigned long id, u64 *colors)
+{
+	const struct jailhouse_memory *mem;
+	struct cell *cell;
+	unsigned int n;
+
+	for_each_cell(cell) {
+		if (cell->config->id != id)
+			continue;
+
+		for_each_mem_region(mem, cell->config, n)
+			if (mem->flags & JAILHOUSE_MEM_COLORED) {
+				*colors = mem->colors;
+				return 0;
+			}
+		return -EINVAL;
+	}
+
+	return -ENOENT;
+}
+
+/*
+ * Applies a struct mode_switch_args bundle as a whole: the cells are
+ * recolored one after the other, with the already recolored ones restored if
+ * one fails, and only then the memguard budgets and the QoS profile are
+ * queued for the common period boundary. Everything is validated before the
+ * first change, so the boundary part can no longer fail.
+ */
+static int mode_switch(struct per_cpu *cpu_data, unsigned long args_address)
+{
+	unsigned long offs = args_address & PAGE_OFFS_MASK;
+	const struct memguard_cpu_params *entries;
+	const struct mode_switch_cell *cells;
+	struct mode_switch_args args;
+	u64 old_colors[MODE_SWITCH_MAX_CELLS];
+	unsigned int n, m, pages;
+	void *mapping, *bundle;
+	unsigned long size;
+	int err;
+
+	if (cpu_data->public.cell != &root_cell)
+		return -EPERM;
+
+	mapping = paging_get_guest_pages(NULL, args_address,
+					 PAGES(offs + sizeof(args)),
+					 PAGE_READONLY_FLAGS);
+	if (!mapping)
+		return -ENOMEM;
+	memcpy(&args, mapping + offs, sizeof(args));
+
+	if (args.num_cpus > hypervisor_header.max_cpus ||
+	    args.num_cells > MODE_SWITCH_MAX_CELLS)
+		return -E2BIG;
+
+	/* other root cell CPUs can still write to the bundle: copy it */
+	size = sizeof(args) +
+		args.num_cpus * sizeof(struct memguard_cpu_params) +
+		args.num_cells * sizeof(struct mode_switch_cell);
+	pages = PAGES(size);
+	mapping = paging_get_guest_pages(NULL, args_address,
+					 PAGES(offs + size),
+					 PAGE_READONLY_FLAGS);
+	if (!mapping)
+		return -ENOMEM;
+	bundle = page_alloc(&mem_pool, pages);
+	if (!bundle)
+		return -ENOMEM;
+	memcpy(bundle, mapping + offs, size);
+	entries = bundle + sizeof(args);
+	cells = (void *)(entries + args.num_cpus);
+
+	err = memguard_switch_begin(entries, args.num_cpus, args.period_us,
+				    args.qos_profile);
+	if (err)
+		goto out_free;
+
+	for (n = 0; n < args.num_cells; n++) {
+		for (m = 0; m < n; m++)
+			if (cells[m].cell_id == cells[n].cell_id) {
+				err = -EINVAL;
+				goto out_abort;
+			}
+		err = cell_colors(cells[n].cell_id, &old_colors[n]);
+		if (err)
+			goto out_abort;
+	}
+
+	for (n = 0; n < args.num_cells; n++) {
+		err = cell_recolor(cpu_data, cells[n].cell_id,
+				   cells[n].colors);
+		if (err) {
+			while (n-- > 0)
+				cell_recolor(cpu_data, cells[n].cell_id,
+					     old_colors[n]);
+			goto out_abort;
+		}
+	}
+
+	memguard_switch_commit(entries, args.num_cpus);
+	goto out_free;
+
+out_abort:
+	memguard_switch_abort();
+out_free:
+	page_free(&mem_pool, bundle, pages);
+
+	return err;
+}
+
 static int cell_destroy(struct per_cpu *cpu_data, unsigned long id)
 {
 	struct cell *cell, *previous;
@@ -781,11 +1362,13 @@ static int cell_destroy(struct per_cpu *cpu_data, unsigned long id)
 	num_cells--;
 
 	page_free(&mem_pool, cell, cell->data_pages);
-	paging_dump_stats("after cell destruction");
 
+	cell_resume(&root_cell);
+
+	/* the other cells may take their time to acknowledge */
 	cell_reconfig_completed();
 
-	cell_resume(&root_cell);
+	paging_dump_stats("after cell destruction");
 
 	return 0;
 }
@@ -820,6 +1403,102 @@ static int cell_get_state(struct per_cpu *cpu_data, unsigned long id)
 	return -ENOENT;
 }
 
+static int cell_get_mmio_stats(struct per_cpu *cpu_data, unsigned long id,
+			       unsigned long buffer_address)
+{
+	unsigned long page_offs = buffer_address & PAGE_OFFS_MASK;
+	struct jailhouse_mmio_stats *buffer;
+	unsigned int max_entries, pages;
+	struct cell *cell;
+	void *mapping;
+
+	if (cpu_data->public.cell != &root_cell)
+		return -EPERM;
+
+	/* see cell_get_state for the synchronization with cell_destroy */
+	for_each_cell(cell)
+		if (cell->config->id == id)
+			break;
+	if (!cell)
+		return -ENOENT;
+
+	mapping = paging_get_guest_pages(NULL, buffer_address,
+					 PAGES(page_offs + sizeof(*buffer)),
+					 PAGE_READONLY_FLAGS);
+	if (!mapping)
+		return -ENOMEM;
+	buffer = mapping + page_offs;
+	max_entries = MIN(buffer->max_entries, cell->max_mmio_regions);
+
+	pages = PAGES(page_offs + sizeof(*buffer) +
+		      max_entries * sizeof(struct jailhouse_mmio_stat));
+	if (pages > NUM_TEMPORARY_PAGES)
+		return trace_error(-EINVAL);
+
+	mapping = paging_get_guest_pages(NULL, buffer_address, pages,
+					 PAGE_DEFAULT_FLAGS);
+	if (!mapping)
+		return -ENOMEM;
+
+	return mmio_get_stats(cell, mapping + page_offs, max_entries);
+}
+
+#ifdef __aarch64__
+static int iommu_get_faults(struct per_cpu *cpu_data,
+			    unsigned long buffer_address)
+{
+	unsigned long page_offs = buffer_address & PAGE_OFFS_MASK;
+	struct jailhouse_iommu_faults *buffer;
+	unsigned int max_entries, pages;
+	void *mapping;
+
+	if (cpu_data->public.cell != &root_cell)
+		return -EPERM;
+
+	mapping = paging_get_guest_pages(NULL, buffer_address,
+					 PAGES(page_offs + sizeof(*buffer)),
+					 PAGE_READONLY_FLAGS);
+	if (!mapping)
+		return -ENOMEM;
+	buffer = mapping + page_offs;
+	max_entries = buffer->max_entries;
+
+	pages = PAGES(page_offs + sizeof(*buffer) +
+		      max_entries * sizeof(struct jailhouse_iommu_fault));
+	if (pages > NUM_TEMPORARY_PAGES)
+		return trace_error(-EINVAL);
+
+	mapping = paging_get_guest_pages(NULL, buffer_address, pages,
+					 PAGE_DEFAULT_FLAGS);
+	if (!mapping)
+		return -ENOMEM;
+
+	return arm_smmuv3_get_faults(mapping + page_offs, max_entries);
+}
+#endif
+
+static int debug_console_puts(struct per_cpu *cpu_data, unsigned long address,
+			      unsigned long len)
+{
+	unsigned long page_offs = address & PAGE_OFFS_MASK;
+	struct cell *cell = cpu_data->public.cell;
+	const char *buffer;
+
+	if (!CELL_FLAGS_VIRTUAL_CONSOLE_PERMITTED(cell->config->flags))
+		return trace_error(-EPERM);
+	if (len > JAILHOUSE_CONSOLE_PUTS_MAX)
+		return trace_error(-EINVAL);
+
+	buffer = paging_get_guest_pages(NULL, address,
+					PAGES(page_offs + len),
+					PAGE_READONLY_FLAGS);
+	if (!buffer)
+		return -ENOMEM;
+
+	printk_cell_write(cell, buffer + page_offs, len);
+	return 0;
+}
+
 /**
  * Perform all CPU-unrelated hypervisor shutdown steps.
  */
@@ -829,6 +1508,9 @@ void shutdown(void)
 	unsigned int n;
 	struct unit *unit;
 
+	/* the rings go away with the hypervisor */
+	printk_flush();
+
 	pci_prepare_handover();
 	arch_prepare_shutdown();
 
@@ -856,8 +1538,10 @@ static int hypervisor_disable(struct per_cpu *cpu_data)
 {
 	static volatile unsigned int waiting_cpus;
 	static bool do_common_shutdown;
+	static volatile bool shutdown_done;
 	unsigned int this_cpu = cpu_data->public.cpu_id;
 	unsigned int cpu;
+	bool leader;
 	int state, ret;
 
 	/* We do not support shutdown over non-root cells. */
@@ -920,15 +1604,27 @@ static int hypervisor_disable(struct per_cpu *cpu_data)
 		cpu_relax();
 
 	spin_lock(&shutdown_lock);
+	leader = do_common_shutdown;
+	do_common_shutdown = false;
+	spin_unlock(&shutdown_lock);
 
-	if (do_common_shutdown) {
+	if (leader) {
 		/*
 		 * The first CPU to get here changes common settings to native.
 		 */
 		printk("Shutting down hypervisor\n");
 		shutdown();
-		do_common_shutdown = false;
+		memory_barrier();
+		shutdown_done = true;
+	} else {
+		/* The others help copying the root cell back meanwhile. */
+		while (!shutdown_done) {
+			parallel_help();
+			cpu_relax();
+		}
 	}
+
+	spin_lock(&shutdown_lock);
 	printk(" Releasing CPU %d\n", this_cpu);
 
 	/* If memory was copied back to non-colored ranges, flush stale
@@ -945,9 +1641,13 @@ static long hypervisor_get_info(struct per_cpu *cpu_data, unsigned long type)
 {
 	switch (type) {
 	case JAILHOUSE_INFO_MEM_POOL_SIZE:
-		return mem_pool.pages;
+		return mem_pool.pages - mem_pool.hidden_pages;
 	case JAILHOUSE_INFO_MEM_POOL_USED:
 		return mem_pool.used_pages;
+	case JAILHOUSE_INFO_MEM_POOL_PEAK:
+		return mem_pool.peak_pages;
+	case JAILHOUSE_INFO_MEM_POOL_RESERVE:
+		return mem_pool.reserve_pages;
 	case JAILHOUSE_INFO_REMAP_POOL_SIZE:
 		return remap_pool.pages;
 	case JAILHOUSE_INFO_REMAP_POOL_USED:
@@ -955,7 +1655,7 @@ static long hypervisor_get_info(struct per_cpu *cpu_data, unsigned long type)
 	case JAILHOUSE_INFO_NUM_CELLS:
 		return num_cells;
 	default:
-		return -EINVAL;
+		return color_get_info(type);
 	}
 }
 
@@ -985,6 +1685,28 @@ static int cpu_get_info(struct per_cpu *cpu_data, unsigned long cpu_id,
 		return -EINVAL;
 }
 
+static int cpu_schedule(struct per_cpu *cpu_data, unsigned long cpu_id,
+			unsigned long address)
+{
+	unsigned long page_offs = address & PAGE_OFFS_MASK;
+	const struct jailhouse_cpu_schedule *schedule;
+	void *mapping;
+
+	if (cpu_data->public.cell != &root_cell)
+		return -EPERM;
+	if (!cpu_id_valid(cpu_id))
+		return -EINVAL;
+
+	mapping = paging_get_guest_pages(NULL, address,
+					 PAGES(page_offs + sizeof(*schedule)),
+					 PAGE_READONLY_FLAGS);
+	if (!mapping)
+		return -ENOMEM;
+	schedule = mapping + page_offs;
+
+	return arch_cpu_schedule(cpu_id, schedule);
+}
+
 /**
  * Handle hypercall invoked by a cell.
  * @param code		Hypercall code.
@@ -998,6 +1720,7 @@ static int cpu_get_info(struct per_cpu *cpu_data, unsigned long cpu_id,
 long hypercall(unsigned long code, unsigned long arg1, unsigned long arg2)
 {
 	struct per_cpu *cpu_data = this_cpu_data();
+	char c;
 
 	cpu_data->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_HYPERCALL]++;
 
@@ -1012,24 +1735,66 @@ long hypercall(unsigned long code, unsigned long arg1, unsigned long arg2)
 		return cell_set_loadable(cpu_data, arg1);
 	case JAILHOUSE_HC_CELL_DESTROY:
 		return cell_destroy(cpu_data, arg1);
+	case JAILHOUSE_HC_CELL_RECOLOR:
+		return cell_recolor(cpu_data, arg1, arg2);
+	case JAILHOUSE_HC_CELL_SNAPSHOT:
+		return cell_snapshot(cpu_data, arg1, arg2);
+	case JAILHOUSE_HC_CELL_RESTORE:
+		return cell_restore(cpu_data, arg1, arg2);
+	case JAILHOUSE_HC_CELL_CPU_MOVE:
+		return cell_cpu_move(cpu_data, arg1, arg2);
+	case JAILHOUSE_HC_CELL_MEM_RESIZE:
+		return cell_mem_resize(cpu_data, arg1, arg2);
 	case JAILHOUSE_HC_HYPERVISOR_GET_INFO:
 		return hypervisor_get_info(cpu_data, arg1);
 	case JAILHOUSE_HC_CELL_GET_STATE:
 		return cell_get_state(cpu_data, arg1);
+	case JAILHOUSE_HC_CELL_GET_MMIO_STATS:
+		return cell_get_mmio_stats(cpu_data, arg1, arg2);
 	case JAILHOUSE_HC_CPU_GET_INFO:
 		return cpu_get_info(cpu_data, arg1, arg2);
 	case JAILHOUSE_HC_DEBUG_CONSOLE_PUTC:
 		if (!CELL_FLAGS_VIRTUAL_CONSOLE_PERMITTED(
 			cpu_data->public.cell->config->flags))
 			return trace_error(-EPERM);
-		printk("%c", (char)arg1);
+		c = arg1;
+		printk_cell_write(cpu_data->public.cell, &c, 1);
+		return 0;
+	case JAILHOUSE_HC_DEBUG_CONSOLE_PUTS:
+		return debug_console_puts(cpu_data, arg1, arg2);
+	case JAILHOUSE_HC_CONSOLE_FLUSH:
+		if (cpu_data->public.cell != &root_cell)
+			return -EPERM;
+		printk_flush();
 		return 0;
+	case JAILHOUSE_HC_TRACE_SET:
+		return trace_set(cpu_data, arg1);
 	case JAILHOUSE_HC_MEMGUARD_SET:
 		return memguard_set(&cpu_data->public.memguard, arg1);
+	case JAILHOUSE_HC_MEMGUARD_CELL_SET:
+		return memguard_cell_set(cpu_data, arg1, arg2);
+	case JAILHOUSE_HC_MEMGUARD_BATCH_SET:
+		return memguard_batch_set(cpu_data, arg1, arg2);
+	case JAILHOUSE_HC_MODE_SWITCH:
+		return mode_switch(cpu_data, arg1);
+	case JAILHOUSE_HC_CPU_SCHEDULE:
+		return cpu_schedule(cpu_data, arg1, arg2);
+	case JAILHOUSE_HC_SHMEM_SEGMENT:
+		return shmem_segment(cpu_data, arg1, arg2);
 #ifdef __aarch64__
 	/* QoS only available on arm64 */
 	case JAILHOUSE_HC_QOS:
 		return qos_call(arg1, arg2);
+	case JAILHOUSE_HC_QOS_PROFILE_SET:
+		return qos_profile_set(arg1);
+	case JAILHOUSE_HC_QOS_PROFILE_APPLY:
+		return qos_profile_apply(arg1);
+	case JAILHOUSE_HC_IOMMU_GET_FAULTS:
+		return iommu_get_faults(cpu_data, arg1);
+	case JAILHOUSE_HC_PERF_SET:
+		return perf_set(cpu_data, arg1);
+	case JAILHOUSE_HC_PT_CACHE:
+		return pt_cache_call(cpu_data, arg1);
 #endif
 	default:
 		return -ENOSYS;
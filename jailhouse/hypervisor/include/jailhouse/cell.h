@@ -21,6 +21,10 @@
 
 #include <jailhouse/cell-config.h>
 #include <jailhouse/hypercall.h>
+#include <jailhouse/memguard-common.h>
+
+/** Longest line of the debug console output of a cell */
+#define CELL_CONSOLE_LINE	128
 
 /** Cell-related states. */
 struct cell {
@@ -48,6 +52,8 @@ struct cell {
 
 	/** True while the cell can be loaded by the root cell. */
 	bool loadable;
+	/** Mapped part of the JAILHOUSE_MEM_RESIZABLE region, 0 if none. */
+	unsigned long long resizable_size;
 
 	/** Pointer to next cell in the system. */
 	struct cell *next;
@@ -55,20 +61,42 @@ struct cell {
 	/** List of PCI devices assigned to this cell. */
 	struct pci_device *pci_devices;
 
-	/** Lock protecting changes to mmio_locations, mmio_handlers, and
-	 * num_mmio_regions. */
+	/** Lock protecting changes to mmio_locations, mmio_handlers,
+	 * mmio_stats, and num_mmio_regions. */
 	spinlock_t mmio_region_lock;
-	/** Generation counter of mmio_locations, mmio_handlers, and
-	 * num_mmio_regions. */
+	/** Generation counter of mmio_locations, mmio_handlers, mmio_stats,
+	 * and num_mmio_regions. */
 	volatile unsigned long mmio_generation;
 	/** MMIO region description table. */
 	struct mmio_region_location *mmio_locations;
 	/** MMIO region handler table. */
 	struct mmio_region_handler *mmio_handlers;
+	/** MMIO region access statistics, updated without locking. */
+	struct mmio_region_stats *mmio_stats;
 	/** Number of MMIO regions in use. */
 	unsigned int num_mmio_regions;
 	/** Maximum number of MMIO regions. */
 	unsigned int max_mmio_regions;
+
+	/** Memguard budget donated by the cell's CPUs and not yet borrowed,
+	 * one pool for each event. Only modified via atomic_cas. */
+	u32 memguard_pool[MEMGUARD_MAX_EVENTS];
+
+	/** Debug console output of the cell, see printk_cell_write. */
+	struct {
+		/** Serializes the writes of the cell's CPUs. */
+		spinlock_t lock;
+		/** Pending part of the current line, NUL-terminated when
+		 * written out. */
+		char line[CELL_CONSOLE_LINE + 1];
+		unsigned int len;
+		/** Start of the rate-limit period, see cpu_timestamp(). */
+		u64 period_start;
+		/** Bytes accepted in the current period. */
+		unsigned int written;
+		/** Bytes dropped since the last report. */
+		unsigned int dropped;
+	} console;
 };
 
 extern struct cell root_cell;
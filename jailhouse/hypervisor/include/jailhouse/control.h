@@ -252,6 +252,98 @@ void arch_cell_destroy(struct cell *cell);
  */
 void arch_cell_reset(struct cell *cell);
 
+/**
+ * Saves the interrupt and vCPU states of a suspended cell.
+ * @param cell		Cell to be saved.
+ * @param snapshot	Buffer to fill, its size field gives the capacity.
+ *
+ * @return 0 on success, negative error code otherwise.
+ *
+ * @see arch_cell_prepare_restore
+ */
+int arch_cell_snapshot(struct cell *cell,
+		       struct jailhouse_cell_snapshot *snapshot);
+
+/**
+ * Validates a snapshot and stages it so that the next reset of the cell and
+ * its CPUs resumes from it instead of from the reset state.
+ * @param cell		Cell to be restored.
+ * @param snapshot	State saved by arch_cell_snapshot(), or NULL to drop a
+ *			staged state after the start failed.
+ *
+ * @return 0 on success, negative error code otherwise.
+ */
+int arch_cell_prepare_restore(struct cell *cell,
+			      const struct jailhouse_cell_snapshot *snapshot);
+
+/**
+ * Checks if a suspended CPU can be moved to another cell.
+ * @param cpu_id	ID of the CPU.
+ *
+ * @return 0 if the CPU is powered off, negative error code otherwise.
+ *
+ * @see arch_cell_cpus_changed
+ */
+int arch_cpu_move_check(unsigned int cpu_id);
+
+/**
+ * Performs the architecture-specific steps after a CPU was moved between the
+ * root cell and a non-root cell, both still suspended.
+ * @param cell		Non-root cell that gained or lost the CPU.
+ */
+void arch_cell_cpus_changed(struct cell *cell);
+
+/**
+ * Checks if a CPU of a non-root cell can be time-shared with a new cell.
+ * @param cell		Cell being created.
+ * @param cpu_id	ID of the CPU, listed by the cell and owned by another
+ * 			non-root cell.
+ *
+ * @return 0 if the CPU can run both cells, negative error code otherwise.
+ *
+ * @see arch_cpu_share
+ */
+int arch_cpu_share_check(struct cell *cell, unsigned int cpu_id);
+
+/**
+ * Adds a powered-off vCPU of a new cell to a CPU that keeps running the cell
+ * owning it.
+ * @param cell		Cell being created.
+ * @param cpu_id	ID of the CPU, accepted by arch_cpu_share_check().
+ *
+ * @see arch_cpu_unshare
+ */
+void arch_cpu_share(struct cell *cell, unsigned int cpu_id);
+
+/**
+ * Removes the vCPU of a cell being destroyed from a time-shared CPU, leaving
+ * the CPU to the other cell.
+ * @param cell		Cell being destroyed, its CPUs are suspended.
+ * @param cpu_id	ID of the CPU.
+ *
+ * @return True if the CPU was shared and stays with the other cell, false if
+ * 	   it is returned to the root cell.
+ */
+bool arch_cpu_unshare(struct cell *cell, unsigned int cpu_id);
+
+/**
+ * Directs the park and reset requests for a suspended CPU to the vCPU of the
+ * cell that suspended it, which may be switched out on a time-shared CPU.
+ * @param cell		Cell being suspended.
+ * @param cpu_id	ID of the suspended CPU.
+ */
+void arch_cell_suspend_cpu(struct cell *cell, unsigned int cpu_id);
+
+/**
+ * Sets the cyclic schedule of a time-shared CPU.
+ * @param cpu_id	ID of the CPU.
+ * @param schedule	Schedule in root cell memory.
+ *
+ * @return 0 on success, negative error code otherwise.
+ */
+int arch_cpu_schedule(unsigned int cpu_id,
+		      const struct jailhouse_cpu_schedule *schedule);
+
 /**
  * Performs the architecture-specific steps for applying configuration changes.
  * @param cell_added_removed	Cell that was added or removed to/from the
@@ -267,6 +359,13 @@ void arch_config_commit(struct cell *cell_added_removed);
  */
 void arch_prepare_shutdown(void);
 
+/**
+ * Returns the rate of cpu_timestamp().
+ *
+ * @return Rate in kHz.
+ */
+unsigned long arch_timestamp_khz(void);
+
 /** @} */
 
 #endif
@@ -10,7 +10,7 @@
  * the COPYING file in the top-level directory.
  */
 
-#ifdef CONFIG_JAILHOUSE_GCOV
+#if defined(CONFIG_JAILHOUSE_GCOV) || defined(CONFIG_JAILHOUSE_PROFILE)
 void gcov_init(void);
 #else
 static inline void gcov_init(void) {}
@@ -91,6 +91,33 @@ struct jailhouse_header {
 	/** Denotes hyp-stub ABI for arm and arm64:
 	 * @note Filled by Linux loader driver before entry. */
 	unsigned int arm_linux_hyp_abi;
+
+	/** Offset of the memguard telemetry rings inside the hypervisor
+	 * memory. The section is empty if memguard is not supported.
+	 * @note Filled at build time. */
+	unsigned long memguard_telemetry_page;
+	/** Offset of the IRQ latency histograms inside the hypervisor memory,
+	 * 0 if the instrumentation is not built in.
+	 * @note Filled at build time. */
+	unsigned long irq_latency_page;
+	/** Offset of the PMU sample rings inside the hypervisor memory, 0 if
+	 * sampling is not built in.
+	 * @note Filled at build time. */
+	unsigned long perf_page;
+	/** Offset of the shared per-CPU statistics inside the hypervisor
+	 * memory. The section is empty if the architecture does not publish
+	 * them.
+	 * @note Filled at build time. */
+	unsigned long cpu_stats_page;
+	/** Offset of the tracepoint rings inside the hypervisor memory, 0 if
+	 * tracepoints are not built in.
+	 * @note Filled at build time. */
+	unsigned long trace_page;
+	/** Pages of the root cell page-table image following the system
+	 * configuration, see jailhouse/pt-cache.h, 0 if there is none. Reset
+	 * to 0 by the hypervisor if it did not install the image.
+	 * @note Filled by Linux loader driver before entry. */
+	unsigned int pt_cache_pages;
 };
 
 #endif /* !__ASSEMBLY__ */
@@ -17,7 +17,11 @@
 #include <jailhouse/pci.h>
 #include <asm/spinlock.h>
 
-#define IVSHMEM_MSIX_VECTORS	PCI_EMBEDDED_MSIX_VECTS
+/*
+ * Multi-queue protocols use one vector per queue and peer. Devices with more
+ * than PCI_EMBEDDED_MSIX_VECTS vectors get their shadow table allocated.
+ */
+#define IVSHMEM_MSIX_VECTORS	32
 
 #include <asm/ivshmem.h>
 
@@ -34,7 +38,7 @@ struct ivshmem_link;
 
 struct ivshmem_endpoint {
 	u32 cspace[IVSHMEM_CFG_SIZE / sizeof(u32)];
-	/** Lock protecting accesses to irq_cache and int_ctrl_reg, also
+	/** Lock protecting accesses to irq_cache, int_ctrl_reg and poll, also
 	 * synchronizing interrupt submissions with device shutdown. */
 	spinlock_t irq_lock;
 	u32 int_ctrl_reg;
@@ -44,11 +48,14 @@ struct ivshmem_endpoint {
 	const struct jailhouse_memory *shmem;
 	u32 ioregion[2];
 	u32 state;
+	/** Polling mode of this peer, mirrored into the poll mailbox. */
+	u32 poll;
 };
 
 int ivshmem_init(struct cell *cell, struct pci_device *device);
 void ivshmem_reset(struct pci_device *device);
 void ivshmem_exit(struct pci_device *device);
+void ivshmem_notify_peer(struct cell *cell, unsigned int peer_id);
 int ivshmem_update_msix_vector(struct pci_device *device, unsigned int vector);
 int ivshmem_update_msix(struct pci_device *device);
 enum pci_access ivshmem_pci_cfg_write(struct pci_device *device,
@@ -19,6 +19,10 @@
 #define _JAILHOUSE_MEMGUARD_DATA_H
 
 #include <jailhouse/types.h>
+#include <jailhouse/utils.h>
+#include <jailhouse/memguard-common.h>
+
+struct memguard_cluster;
 
 /** Per-CPU memguard parameter structure */
 struct memguard {
@@ -26,10 +30,50 @@ struct memguard {
 	u64 start_time;
 	u64 last_time;
 	u64 budget_time;
-	/** Memory budget */
-	u32 budget_memory;
+	/** Memory budgets, one for each regulated PMU event */
+	u32 budget_memory[MEMGUARD_MAX_EVENTS];
+	/** Number of active events (and PMU counters) */
+	u32 num_events;
+	/** MEMGUARD_FLAG_* as passed by memguard_set */
+	u32 flags;
+	/** Timer ticks spent blocked since the last memguard_set */
+	u64 blocked_ticks;
+	/** Reclaim: max budget the cell pool may hold, for each event */
+	u32 pool_cap[MEMGUARD_MAX_EVENTS];
+	/** Reclaim: bitmap of the events that ran out of budget this period */
+	u32 exhausted;
+	/** Adaptive mode: bounds of \a budget_memory, for each event */
+	u32 budget_min[MEMGUARD_MAX_EVENTS];
+	u32 budget_max[MEMGUARD_MAX_EVENTS];
+	/** Adaptive mode: moving average of the consumed events */
+	u32 ewma[MEMGUARD_MAX_EVENTS];
+	/** Cell-wide mode: this CPU refills the cell pool every period */
+	bool cell_leader;
+	/** Mode switch: parameters taking effect at the switch boundary */
+	struct memguard_params switch_params;
+	/** Mode switch: \a switch_params have to be applied at the boundary */
+	bool switch_apply;
+	/** Telemetry: counter values after the last (re)charge */
+	u32 cnt_base[MEMGUARD_MAX_EVENTS];
+	/** Telemetry: events consumed in the current period */
+	u32 consumed[MEMGUARD_MAX_EVENTS];
+	/** Telemetry: ticks spent blocked in the current period */
+	u32 period_blocked;
+	/** DSU cluster of this CPU, NULL without cluster regulation */
+	struct memguard_cluster *cluster;
+
+	/* written by other CPUs, kept off the lines used on every exit */
+
 	/** Blocking state machine */
-	volatile u32 block;
+	volatile u32 block __cacheline_aligned;
+	/** Set (under control_lock) when \a pending has to be applied */
+	volatile bool update;
+	/** Set (under control_lock) when the regulation has to be stopped */
+	volatile bool release;
+	/** Mode switch: set (under control_lock) to arm the switch timer */
+	volatile bool switch_arm;
+	/** Cell-wide configuration queued by memguard_cell_set */
+	struct memguard_params pending;
 };
 
 #endif
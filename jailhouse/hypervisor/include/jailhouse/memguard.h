@@ -26,12 +26,48 @@
 
 #ifdef CONFIG_DEBUG
 #define mg_print(fmt, ...)			\
-	printk("[MG] " fmt, ##__VA_ARGS__)
+	printk_deferred("[MG] " fmt, ##__VA_ARGS__)
 #else
 #define mg_print(fmt, ...) do { } while (0)
 #endif
 
+struct per_cpu;
+
 /** Set memguard parameters for the current CPU */
 int memguard_set(struct memguard *memguard, unsigned long params_address);
 
+/** Set memguard parameters shared by all the CPUs of cell \a id */
+int memguard_cell_set(struct per_cpu *cpu_data, unsigned long id,
+		      unsigned long params_address);
+
+/** Set the memguard parameters of \a count CPUs at once */
+int memguard_batch_set(struct per_cpu *cpu_data, unsigned long count,
+		       unsigned long params_address);
+
+/**
+ * Validate the memguard part of a mode switch and reserve the switch
+ * machinery: \a count entries, to be applied at the next boundary of
+ * \a period_us together with QoS profile \a qos_profile (or
+ * MODE_SWITCH_NO_QOS). Nothing changes until memguard_switch_commit.
+ */
+int memguard_switch_begin(const struct memguard_cpu_params *entries,
+			  unsigned int count, unsigned long long period_us,
+			  unsigned int qos_profile);
+
+/** Release the reservation of memguard_switch_begin, nothing was queued */
+void memguard_switch_abort(void);
+
+/**
+ * Queue the entries validated by memguard_switch_begin on their CPUs,
+ * which all apply them at the same period boundary.
+ */
+void memguard_switch_commit(const struct memguard_cpu_params *entries,
+			    unsigned int count);
+
+/**
+ * Stop the regulation of the suspended CPU \a cpu, which then runs
+ * unregulated until it is configured again. Used before a CPU changes cells.
+ */
+void memguard_cpu_release(unsigned int cpu);
+
 #endif
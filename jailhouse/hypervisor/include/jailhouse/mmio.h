@@ -18,6 +18,7 @@
 #include <jailhouse/cell-config.h>
 
 struct cell;
+struct jailhouse_mmio_stats;
 
 /**
  * @defgroup IO I/O Access Subsystem
@@ -174,6 +175,14 @@ struct mmio_region_handler {
 	void *arg;
 };
 
+/** MMIO region access statistics. */
+struct mmio_region_stats {
+	/** Number of handled accesses. */
+	u64 count;
+	/** Time spent in the handler, see cpu_timestamp(). */
+	u64 ticks;
+};
+
 int mmio_cell_init(struct cell *cell);
 
 void mmio_region_register(struct cell *cell, unsigned long start,
@@ -185,6 +194,9 @@ enum mmio_result mmio_handle_access(struct mmio_access *mmio);
 
 void mmio_cell_exit(struct cell *cell);
 
+int mmio_get_stats(struct cell *cell, struct jailhouse_mmio_stats *buffer,
+		   unsigned int max_entries);
+
 void mmio_perform_access(void *base, struct mmio_access *mmio);
 
 int mmio_subpage_register(struct cell *cell,
@@ -48,6 +48,8 @@
 #include <jailhouse/entry.h>
 #include <jailhouse/types.h>
 
+struct cell;
+
 /**
  * @ingroup Paging
  * @{
@@ -64,10 +66,27 @@ struct page_pool {
 	unsigned long pages;
 	/** Number of currently used pages. */
 	unsigned long used_pages;
+	/** Highest number of used pages so far. */
+	unsigned long peak_pages;
+	/**
+	 * Pages marked used that are not available (yet), not included in
+	 * @c used_pages. The reserve the pool grows into on demand is at the
+	 * end of them.
+	 */
+	unsigned long hidden_pages;
+	/** Number of pages left in the reserve. */
+	unsigned long reserve_pages;
 	/** Base address for bitmap of used pages. */
 	unsigned long *used_bitmap;
+	/** Bitmap of the @c used_bitmap words without any free page. */
+	unsigned long *full_bitmap;
 	/** Set @c PAGE_SCRUB_ON_FREE to zero-out pages on release. */
 	unsigned long flags;
+	/** Cache colors to allocate from when possible, 0 for any. Only for
+	 * pools backed by hypervisor memory. */
+	u64 colors;
+	/** Number of colors (pages per cache way) if @c colors is set. */
+	unsigned long way_pages;
 };
 
 /**
@@ -269,6 +288,11 @@ int paging_create(const struct paging_structures *pg_structs,
 int paging_destroy(const struct paging_structures *pg_structs,
 		   unsigned long virt, unsigned long size,
 		   unsigned long paging_flags);
+void paging_consolidate(const struct paging_structures *pg_structs,
+			unsigned long virt, unsigned long size,
+			unsigned long paging_flags);
+void paging_count_entries(const struct paging_structures *pg_structs,
+			  unsigned long *count);
 
 void *paging_map_device(unsigned long phys, unsigned long size);
 void paging_unmap_device(unsigned long phys, void *virt, unsigned long size);
@@ -290,6 +314,14 @@ int paging_init(void);
  */
 void arch_paging_init(void);
 
+/**
+ * Get the paging structures that translate guest-physical addresses of a cell.
+ * @param cell		Cell to look up.
+ *
+ * @return Paging structures of the cell, NULL if there are none.
+ */
+const struct paging_structures *arch_cell_paging_structs(struct cell *cell);
+
 void paging_dump_stats(const char *when);
 
 /* --- To be provided by asm/paging.h --- */
@@ -0,0 +1,32 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_PARALLEL_H
+#define _JAILHOUSE_PARALLEL_H
+
+/**
+ * Run @c fn on the items 0 to @c count - 1, spread over the calling CPU and
+ * the CPUs waiting in parallel_help(). Returns once all handed out items are
+ * done. Items are not handed out anymore after the first error.
+ *
+ * Only used by the CPU that performs the system-wide steps of setup and
+ * shutdown while the others wait for it. Items run in any order and on any
+ * of these CPUs, they must be independent.
+ *
+ * @return 0 on success, the first error returned by @c fn otherwise.
+ */
+int parallel_run(int (*fn)(unsigned long item), unsigned long count);
+
+/**
+ * Take items of a parallel_run() started by another CPU, if any, until none
+ * is left. Called by the CPUs waiting for the system-wide steps.
+ */
+void parallel_help(void);
+
+#endif /* !_JAILHOUSE_PARALLEL_H */
@@ -29,6 +29,7 @@
 #define PCI_CFG_INT		0x3c
 
 #define PCI_CONFIG_HEADER_SIZE	0x40
+#define PCI_STD_CONFIG_SIZE	0x100
 
 #define PCI_NUM_BARS		6
 
@@ -127,6 +128,15 @@ struct pci_device {
 	struct cell *cell;
 	/** Shadow BAR */
 	u32 bar[PCI_NUM_BARS];
+	/** Header dwords that are served from cfg_shadow, one bit each. */
+	u16 cfg_shadowed;
+	/** Shadow of the read-only header dwords of a physical device. */
+	u32 cfg_shadow[PCI_CONFIG_HEADER_SIZE / 4];
+	/**
+	 * Index plus one of the first capability covering each dword of the
+	 * standard config space, 0 if there is none.
+	 */
+	u16 cap_map[PCI_STD_CONFIG_SIZE / 4];
 
 	/** Shadow state of MSI config space registers. */
 	union pci_msi_registers msi_registers;
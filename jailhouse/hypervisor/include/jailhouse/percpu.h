@@ -22,6 +22,7 @@
 #include <jailhouse/paging.h>
 #include <jailhouse/cell.h>
 #include <jailhouse/memguard-data.h>
+#include <jailhouse/printk.h>
 #include <asm/percpu.h>
 
 /**
@@ -29,20 +30,25 @@
  * @{
  */
 
-/** Per-CPU states accessible across all CPUs. */
+/**
+ * Per-CPU states accessible across all CPUs.
+ *
+ * The fields are grouped by their writers, each group starting on its own
+ * cache line: what the owning CPU reads on every exit, the requests other
+ * CPUs write, and the statistics the driver polls. See the PERCPU_LAYOUT_*
+ * entries of the generated asm-defines.h for the resulting offsets.
+ */
 struct public_per_cpu {
 	/** Per-CPU root page table. Public because it has to be accessible for
 	 *  page walks at any time. */
 	u8 root_table_page[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
 
+	/* local-hot: read on every exit, only written by the owning CPU */
+
 	/** Logical CPU ID (same as Linux). */
 	unsigned int cpu_id;
 	/** Owning cell. */
 	struct cell *cell;
-
-	/** Statistic counters. */
-	u32 stats[JAILHOUSE_NUM_CPU_STATS];
-
 	/** State of the shutdown process. Possible values:
 	 * @li SHUTDOWN_NONE: no shutdown in progress
 	 * @li SHUTDOWN_STARTED: shutdown in progress
@@ -53,8 +59,10 @@ struct public_per_cpu {
 	 *  guest mode. */
 	bool failed;
 
+	/* remote-written: requests of other CPUs */
+
 	/** Set to true for instructing the CPU to suspend. */
-	volatile bool suspend_cpu;
+	volatile bool suspend_cpu __cacheline_aligned;
 	/** Set to true if the CPU was hit in the wrong moment for suspension */
 	volatile bool suspend_cpu_retry;
 	/** True if CPU is suspended. */
@@ -63,7 +71,15 @@ struct public_per_cpu {
 	 *  host physical <-> guest physical memory mappings. */
 	bool flush_vcpu_caches;
 
-	struct memguard memguard;
+	/** Statistic counters. Updated on every exit, read by the driver. */
+	u32 stats[JAILHOUSE_NUM_CPU_STATS] __cacheline_aligned;
+
+	/** Split internally into local and remote-written fields. */
+	struct memguard memguard __cacheline_aligned;
+
+	/** Deferred messages, see printk_deferred. Public so that any CPU
+	 *  can flush them. */
+	struct printk_ring printk_ring __cacheline_aligned;
 
 	ARCH_PUBLIC_PERCPU_FIELDS;
 } __attribute__((aligned(PAGE_SIZE)));
@@ -83,6 +99,9 @@ struct per_cpu {
 
 	/** Per-CPU paging structures. */
 	struct paging_structures pg_structs;
+	/** Index of the MMIO region last found by this CPU, only a hint for
+	 *  the next lookup. */
+	unsigned int mmio_last_region;
 
 	ARCH_PERCPU_FIELDS;
 
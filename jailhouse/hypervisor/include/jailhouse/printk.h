@@ -13,11 +13,83 @@
 #define _JAILHOUSE_PRINTK_H
 
 #include <jailhouse/types.h>
+#include <jailhouse/utils.h>
+
+/** Number of arguments a deferred record can hold */
+#define PRINTK_RECORD_ARGS	7
+/** Records per CPU (power of two) */
+#define PRINTK_RING_ENTRIES	64
+
+/**
+ * A deferred message: the format string and its arguments, formatted only
+ * when the record is flushed. \a fmt and the strings passed for %s must
+ * therefore be static or outlive the flush.
+ */
+struct printk_record {
+	const char *fmt;
+	unsigned long long args[PRINTK_RECORD_ARGS];
+};
+
+/**
+ * Per-CPU ring of deferred messages. Only the owning CPU writes records and
+ * \a head, only flushes (serialized by the printk lock) move \a tail.
+ */
+struct printk_ring {
+	struct printk_record records[PRINTK_RING_ENTRIES];
+	unsigned int head;
+	unsigned int tail;
+	/** Records lost because the ring was full */
+	unsigned int dropped;
+	unsigned int dropped_reported;
+};
 
 void __attribute__((format(printf, 1, 2))) printk(const char *fmt, ...);
 
 void __attribute__((format(printf, 1, 2))) panic_printk(const char *fmt, ...);
 
+/**
+ * Queue a message in the ring of the calling CPU instead of writing it out.
+ * Does not take any lock and does not touch the UART, so it can be used in
+ * timing-sensitive paths. The message shows up with the next flush, see
+ * printk_flush. Before the hypervisor is activated, this is printk.
+ */
+void __attribute__((format(printf, 1, 2)))
+printk_deferred(const char *fmt, ...);
+
+void __printk_trace(const char *fmt, const unsigned long long *args,
+		    unsigned int num_args);
+
+/**
+ * printk_deferred for hot paths: stores the arguments as they are, without
+ * even parsing \a fmt. Only integer arguments are supported.
+ */
+#define printk_trace(fmt, ...)						\
+	do {								\
+		const unsigned long long __args[] = { __VA_ARGS__ };	\
+									\
+		if (0)							\
+			printk(fmt, ##__VA_ARGS__);			\
+		__printk_trace(fmt, __args, ARRAY_SIZE(__args));	\
+	} while (0)
+
+/** Write out the deferred messages of all CPUs. */
+void printk_flush(void);
+
+struct cell;
+
+/**
+ * Debug console output of a cell: collected per line and written out with
+ * the cell name as prefix, so that the printk lock is taken once per line
+ * and the lines of different cells do not mix. The output of a cell is
+ * limited to a budget per period, the excess is dropped and reported.
+ */
+void printk_cell_write(struct cell *cell, const char *buf, unsigned int len);
+
+/** Write out the pending partial line of a cell. */
+void printk_cell_flush(struct cell *cell);
+
+extern bool printk_deferred_active;
+
 #ifdef CONFIG_TRACE_ERROR
 #define trace_error(code) ({						  \
 	printk("%s:%d: returning error %s\n", __FILE__, __LINE__, #code); \
@@ -31,6 +103,12 @@ void arch_dbg_write_init(void);
 extern void (*arch_dbg_write)(const char *msg);
 
 extern bool virtual_console;
+
+/**
+ * Feed the virtual console to the UART for as long as it accepts characters
+ * without waiting. Returns true if output is still pending.
+ */
+bool console_drain(void);
 extern volatile struct jailhouse_virt_console console;
 
 #endif
@@ -0,0 +1,17 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#ifndef _JAILHOUSE_SHMEM_H
+#define _JAILHOUSE_SHMEM_H
+
+struct per_cpu;
+
+long shmem_segment(struct per_cpu *cpu_data, unsigned long op,
+		   unsigned long address);
+
+#endif /* !_JAILHOUSE_SHMEM_H */
@@ -0,0 +1,52 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+#ifndef _JAILHOUSE_TRACEPOINT_H
+#define _JAILHOUSE_TRACEPOINT_H
+
+#include <jailhouse/entry.h>
+#include <jailhouse/trace.h>
+
+struct per_cpu;
+
+#ifdef CONFIG_TRACEPOINTS
+
+/** Mask of the enabled TRACE_* events, see trace_set */
+extern volatile u32 trace_events;
+
+void __trace_record(unsigned int event, u32 arg0, u64 arg1, u64 arg2);
+
+/**
+ * Record event TRACE_* with its arguments into the ring of the calling CPU.
+ * A disabled tracepoint costs one load and a not-taken branch, without
+ * CONFIG_TRACEPOINTS the tracepoints are not built at all.
+ */
+#define tracepoint(event, arg0, arg1, arg2)				\
+	do {								\
+		if (__builtin_expect(trace_events & (1U << (event)), 0))\
+			__trace_record(event, arg0, arg1, arg2);	\
+	} while (0)
+
+/** Enable the tracepoints of mask, 0 stops tracing, root cell only */
+int trace_set(struct per_cpu *cpu_data, unsigned long mask);
+
+#else
+
+static inline void tracepoint(unsigned int event, u32 arg0, u64 arg1,
+			      u64 arg2)
+{
+}
+
+static inline int trace_set(struct per_cpu *cpu_data, unsigned long mask)
+{
+	return -ENOSYS;
+}
+
+#endif
+
+#endif /* !_JAILHOUSE_TRACEPOINT_H */
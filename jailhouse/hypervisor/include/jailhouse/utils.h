@@ -23,6 +23,13 @@
 
 #define BUG()			*(int *)0 = 0xdead
 
+/*
+ * Largest data cache line of the supported CPUs, for separating data written
+ * by different CPUs. Not used for cache maintenance, see cache_line_size.
+ */
+#define CACHE_LINE_SIZE		64
+#define __cacheline_aligned	__attribute__((aligned(CACHE_LINE_SIZE)))
+
 /* sizeof() for a structure/union field */
 #define FIELD_SIZEOF(type, fld)	(sizeof(((type *)0)->fld))
 
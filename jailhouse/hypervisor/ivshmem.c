@@ -45,6 +45,9 @@
 #define IVSHMEM_CFG_VNDR_LEN		0x20
 
 #define IVSHMEM_CFG_ONESHOT_INT		(1 << 24)
+#define IVSHMEM_CFG_POLL_MAILBOX	(1 << 25)
+/* R/W and output sections are JAILHOUSE_MEM_NONCACHED, map them alike */
+#define IVSHMEM_CFG_NONCACHED		(1 << 26)
 
 /*
  * Make the region two times as large as the MSI-X table to guarantee a
@@ -57,6 +60,20 @@
 #define IVSHMEM_REG_INT_CTRL		0x08
 #define IVSHMEM_REG_DOORBELL		0x0c
 #define IVSHMEM_REG_STATE		0x10
+#define IVSHMEM_REG_POLL		0x14
+
+/*
+ * Polling peer mailbox: one u32 per peer in the read-only state table region,
+ * mirroring the IVSHMEM_REG_POLL value of that peer. Senders only need to
+ * ring the doorbell if the mailbox entry of the target is not
+ * IVSHMEM_POLL_ACTIVE. A sleeping peer is switched back to active polling on
+ * the next interrupt it receives, so that a burst of messages costs a single
+ * doorbell exit.
+ */
+#define IVSHMEM_POLL_MAILBOX		0x800
+#define IVSHMEM_POLL_OFF		0
+#define IVSHMEM_POLL_ACTIVE		1
+#define IVSHMEM_POLL_SLEEPING		2
 
 struct ivshmem_link {
 	struct ivshmem_endpoint eps[IVSHMEM_MAX_PEERS];
@@ -80,25 +97,40 @@ static const u32 default_cspace[IVSHMEM_CFG_SIZE / sizeof(u32)] = {
 	[(IVSHMEM_CFG_MSIX_CAP + 0x8)/4] = 0x10 * IVSHMEM_MSIX_VECTORS | 1,
 };
 
-static void ivshmem_trigger_interrupt(struct ivshmem_endpoint *ive,
-				      unsigned int vector)
+static unsigned int ivshmem_msix_pages(struct pci_device *device)
 {
-	/*
-	 * Hold the IRQ lock while sending the interrupt so that ivshmem_exit
-	 * and ivshmem_register_mmio can synchronize on the completion of the
-	 * delivery.
-	 */
-	spin_lock(&ive->irq_lock);
+	return PAGES(sizeof(union pci_msix_vector) *
+		     device->info->num_msix_vectors);
+}
 
-	if (ive->int_ctrl_reg & IVSHMEM_INT_ENABLE) {
-		if (ive->cspace[IVSHMEM_CFG_VNDR_CAP/4] &
-		    IVSHMEM_CFG_ONESHOT_INT)
-			ive->int_ctrl_reg = 0;
+/*
+ * The state table is written by the hypervisor through its cacheable mapping
+ * and has to stay cacheable. The R/W and output sections all have to carry
+ * the same JAILHOUSE_MEM_NONCACHED setting, in this and in any peer cell, as
+ * the guests map all of them according to the single IVSHMEM_CFG_NONCACHED
+ * bit.
+ */
+static int ivshmem_check_attributes(const struct jailhouse_memory *shmem,
+				    unsigned int peers,
+				    const struct ivshmem_endpoint *peer_ive)
+{
+	u32 noncached = shmem[2].flags & JAILHOUSE_MEM_NONCACHED;
+	unsigned int n;
 
-		arch_ivshmem_trigger_interrupt(ive, vector);
+	if (shmem[0].flags & JAILHOUSE_MEM_NONCACHED)
+		return trace_error(-EINVAL);
+	for (n = 1; n < 2 + peers; n++) {
+		if (n == 1 && shmem[1].size == 0)
+			continue;
+		if ((shmem[n].flags & JAILHOUSE_MEM_NONCACHED) != noncached)
+			return trace_error(-EINVAL);
 	}
-
-	spin_unlock(&ive->irq_lock);
+	if (peer_ive &&
+	    (peer_ive->shmem[2].flags & JAILHOUSE_MEM_NONCACHED) != noncached) {
+		printk("ERROR: ivshmem peers differ in cacheability\n");
+		return trace_error(-EINVAL);
+	}
+	return 0;
 }
 
 static u32 *ivshmem_map_state_table(struct ivshmem_endpoint *ive)
@@ -116,6 +148,51 @@ static u32 *ivshmem_map_state_table(struct ivshmem_endpoint *ive)
 	return (u32 *)TEMPORARY_MAPPING_BASE;
 }
 
+static bool ivshmem_has_poll_mailbox(struct ivshmem_endpoint *ive)
+{
+	return ive->shmem[0].size >=
+		IVSHMEM_POLL_MAILBOX + IVSHMEM_MAX_PEERS * sizeof(u32);
+}
+
+/* Caller must hold ive->irq_lock. */
+static void ivshmem_write_poll(struct ivshmem_endpoint *ive, u32 poll)
+{
+	u32 *mailbox;
+
+	ive->poll = poll;
+	if (!ivshmem_has_poll_mailbox(ive))
+		return;
+
+	mailbox = ivshmem_map_state_table(ive) +
+		IVSHMEM_POLL_MAILBOX / sizeof(u32);
+	mailbox[ive->device->info->shmem_dev_id] = poll;
+	memory_barrier();
+}
+
+static void ivshmem_trigger_interrupt(struct ivshmem_endpoint *ive,
+				      unsigned int vector)
+{
+	/*
+	 * Hold the IRQ lock while sending the interrupt so that ivshmem_exit
+	 * and ivshmem_register_mmio can synchronize on the completion of the
+	 * delivery.
+	 */
+	spin_lock(&ive->irq_lock);
+
+	if (ive->int_ctrl_reg & IVSHMEM_INT_ENABLE) {
+		if (ive->cspace[IVSHMEM_CFG_VNDR_CAP/4] &
+		    IVSHMEM_CFG_ONESHOT_INT)
+			ive->int_ctrl_reg = 0;
+
+		/* the woken up peer will poll until it goes to sleep again */
+		if (ive->poll == IVSHMEM_POLL_SLEEPING)
+			ivshmem_write_poll(ive, IVSHMEM_POLL_ACTIVE);
+
+		arch_ivshmem_trigger_interrupt(ive, vector);
+	}
+
+	spin_unlock(&ive->irq_lock);
+}
 
 static void ivshmem_write_state(struct ivshmem_endpoint *ive, u32 new_state)
 {
@@ -224,6 +301,15 @@ static enum mmio_result ivshmem_register_mmio(void *arg,
 
 			target_ive = &ive->link->eps[target];
 
+			/*
+			 * An actively polling peer will find the message
+			 * without an interrupt. Races with the peer going to
+			 * sleep are resolved by the peer re-checking its
+			 * queues after writing IVSHMEM_REG_POLL.
+			 */
+			if (target_ive->poll == IVSHMEM_POLL_ACTIVE)
+				break;
+
 			ivshmem_trigger_interrupt(target_ive, vector);
 		} else {
 			mmio->value = 0;
@@ -235,6 +321,23 @@ static enum mmio_result ivshmem_register_mmio(void *arg,
 		else
 			mmio->value = ive->state;
 		break;
+	case IVSHMEM_REG_POLL:
+		if (mmio->is_write) {
+			if (!ivshmem_has_poll_mailbox(ive) ||
+			    mmio->value > IVSHMEM_POLL_SLEEPING)
+				break;
+
+			/*
+			 * The spinlock acts as barrier, ensuring that the
+			 * mailbox is updated on return.
+			 */
+			spin_lock(&ive->irq_lock);
+			ivshmem_write_poll(ive, mmio->value);
+			spin_unlock(&ive->irq_lock);
+		} else {
+			mmio->value = ive->poll;
+		}
+		break;
 	default:
 		/* ignore any other access */
 		mmio->value = 0;
@@ -389,6 +492,35 @@ enum pci_access ivshmem_pci_cfg_read(struct pci_device *device, u16 address,
 	return PCI_ACCESS_DONE;
 }
 
+/**
+ * Raise vector 0 at the endpoints of a peer cell on all ivshmem links it
+ * shares with the calling cell.
+ * @param cell		Calling cell, keeping its links alive.
+ * @param peer_id	ID of the cell to signal.
+ */
+void ivshmem_notify_peer(struct cell *cell, unsigned int peer_id)
+{
+	struct ivshmem_endpoint *ive, *target_ive;
+	struct pci_device *device, *target;
+	unsigned int ndev, id;
+
+	for (ndev = 0; ndev < cell->config->num_pci_devices; ndev++) {
+		device = &cell->pci_devices[ndev];
+		if (device->info->type != JAILHOUSE_PCI_TYPE_IVSHMEM ||
+		    !device->cell)
+			continue;
+		ive = device->ivshmem_endpoint;
+
+		for (id = 0; id < IVSHMEM_MAX_PEERS; id++) {
+			target_ive = &ive->link->eps[id];
+			target = target_ive->device;
+			if (target_ive != ive && target &&
+			    target->cell->config->id == peer_id)
+				ivshmem_trigger_interrupt(target_ive, 0);
+		}
+	}
+}
+
 /**
  * Register a new ivshmem device.
  * @param cell		The cell the device should be attached to.
@@ -399,10 +531,11 @@ enum pci_access ivshmem_pci_cfg_read(struct pci_device *device, u16 address,
 int ivshmem_init(struct cell *cell, struct pci_device *device)
 {
 	const struct jailhouse_pci_device *dev_info = device->info;
-	struct ivshmem_endpoint *ive;
+	struct ivshmem_endpoint *ive, *peer_ive = NULL;
 	struct ivshmem_link *link;
 	unsigned int peer_id, id;
 	struct pci_device *peer;
+	int err;
 
 	printk("Adding virtual PCI device %02x:%02x.%x to cell \"%s\"\n",
 	       PCI_BDF_PARAMS(dev_info->bdf), cell->config->name);
@@ -420,9 +553,28 @@ int ivshmem_init(struct cell *cell, struct pci_device *device)
 	if (id >= IVSHMEM_MAX_PEERS)
 		return trace_error(-EINVAL);
 
+	if (link && link->eps[id].device)
+		return trace_error(-EBUSY);
+
+	for (peer_id = 0; link && peer_id < IVSHMEM_MAX_PEERS; peer_id++)
+		if (link->eps[peer_id].device) {
+			peer_ive = &link->eps[peer_id];
+			break;
+		}
+	err = ivshmem_check_attributes(jailhouse_cell_mem_regions(cell->config) +
+				       dev_info->shmem_regions_start,
+				       dev_info->shmem_peers, peer_ive);
+	if (err)
+		return err;
+
+	if (dev_info->num_msix_vectors > PCI_EMBEDDED_MSIX_VECTS) {
+		device->msix_vectors = page_alloc(&mem_pool,
+						  ivshmem_msix_pages(device));
+		if (!device->msix_vectors)
+			return -ENOMEM;
+	}
+
 	if (link) {
-		if (link->eps[id].device)
-			return trace_error(-EBUSY);
 
 		printk("Shared memory connection established, peer cells:\n");
 		for (peer_id = 0; peer_id < IVSHMEM_MAX_PEERS; peer_id++) {
@@ -432,8 +584,13 @@ int ivshmem_init(struct cell *cell, struct pci_device *device)
 		}
 	} else {
 		link = page_alloc(&mem_pool, PAGES(sizeof(*link)));
-		if (!link)
+		if (!link) {
+			if (device->msix_vectors != device->msix_vector_array)
+				page_free(&mem_pool, device->msix_vectors,
+					  ivshmem_msix_pages(device));
+			device->msix_vectors = device->msix_vector_array;
 			return -ENOMEM;
+		}
 
 		link->bdf = dev_info->bdf;
 		link->next = ivshmem_links;
@@ -447,9 +604,14 @@ int ivshmem_init(struct cell *cell, struct pci_device *device)
 	ive->link = link;
 	ive->shmem = jailhouse_cell_mem_regions(cell->config) +
 		dev_info->shmem_regions_start;
-	if (link->peers == 1)
+	if (link->peers == 1) {
 		memset(ivshmem_map_state_table(ive), 0,
 		       dev_info->shmem_peers * sizeof(u32));
+		if (ivshmem_has_poll_mailbox(ive))
+			memset(ivshmem_map_state_table(ive) +
+			       IVSHMEM_POLL_MAILBOX / sizeof(u32), 0,
+			       IVSHMEM_MAX_PEERS * sizeof(u32));
+	}
 	device->ivshmem_endpoint = ive;
 
 	device->cell = cell;
@@ -470,6 +632,7 @@ void ivshmem_reset(struct pci_device *device)
 	spin_lock(&ive->irq_lock);
 	ive->int_ctrl_reg = 0;
 	memset(&ive->irq_cache, 0, sizeof(ive->irq_cache));
+	ivshmem_write_poll(ive, IVSHMEM_POLL_OFF);
 	spin_unlock(&ive->irq_lock);
 
 	if (ive->cspace[PCI_CFG_COMMAND/4] & PCI_CMD_MEM) {
@@ -497,6 +660,11 @@ void ivshmem_reset(struct pci_device *device)
 			device->msix_vectors[n].masked = 1;
 	}
 
+	if (ivshmem_has_poll_mailbox(ive))
+		ive->cspace[IVSHMEM_CFG_VNDR_CAP/4] |= IVSHMEM_CFG_POLL_MAILBOX;
+	if (ive->shmem[2].flags & JAILHOUSE_MEM_NONCACHED)
+		ive->cspace[IVSHMEM_CFG_VNDR_CAP/4] |= IVSHMEM_CFG_NONCACHED;
+
 	ive->cspace[IVSHMEM_CFG_SHMEM_STATE_TAB_SZ/4] = (u32)ive->shmem[0].size;
 
 	ive->cspace[IVSHMEM_CFG_SHMEM_RW_SZ/4] = (u32)ive->shmem[1].size;
@@ -530,10 +698,15 @@ void ivshmem_exit(struct pci_device *device)
 	 */
 	spin_lock(&ive->irq_lock);
 	memset(&ive->irq_cache, 0, sizeof(ive->irq_cache));
+	ivshmem_write_poll(ive, IVSHMEM_POLL_OFF);
 	spin_unlock(&ive->irq_lock);
 
 	ivshmem_write_state(ive, 0);
 
+	if (device->msix_vectors != device->msix_vector_array)
+		page_free(&mem_pool, device->msix_vectors,
+			  ivshmem_msix_pages(device));
+
 	ive->device = NULL;
 
 	if (--ive->link->peers > 0)
@@ -12,12 +12,22 @@
 
 #include <jailhouse/cell.h>
 #include <jailhouse/control.h>
+#include <jailhouse/hypercall.h>
 #include <jailhouse/mmio.h>
 #include <jailhouse/paging.h>
 #include <jailhouse/printk.h>
+#include <jailhouse/tracepoint.h>
 #include <jailhouse/unit.h>
 #include <jailhouse/percpu.h>
 
+static unsigned int mmio_table_pages(struct cell *cell)
+{
+	return PAGES(cell->max_mmio_regions *
+		     (sizeof(struct mmio_region_location) +
+		      sizeof(struct mmio_region_handler) +
+		      sizeof(struct mmio_region_stats)));
+}
+
 /**
  * Perform MMIO-specific initialization for a new cell.
  * @param cell		Cell to be initialized.
@@ -41,16 +51,15 @@ int mmio_cell_init(struct cell *cell)
 		if (JAILHOUSE_MEMORY_IS_SUBPAGE(mem))
 			cell->max_mmio_regions++;
 
-	pages = page_alloc(&mem_pool,
-			   PAGES(cell->max_mmio_regions *
-				 (sizeof(struct mmio_region_location) +
-				  sizeof(struct mmio_region_handler))));
+	pages = page_alloc(&mem_pool, mmio_table_pages(cell));
 	if (!pages)
 		return -ENOMEM;
 
 	cell->mmio_locations = pages;
-	cell->mmio_handlers = pages +
-		cell->max_mmio_regions * sizeof(struct mmio_region_location);
+	pages += cell->max_mmio_regions * sizeof(struct mmio_region_location);
+	cell->mmio_handlers = pages;
+	pages += cell->max_mmio_regions * sizeof(struct mmio_region_handler);
+	cell->mmio_stats = pages;
 
 	return 0;
 }
@@ -59,6 +68,7 @@ static void copy_region(struct cell *cell, unsigned int src, unsigned dst)
 {
 	cell->mmio_locations[dst] = cell->mmio_locations[src];
 	cell->mmio_handlers[dst] = cell->mmio_handlers[src];
+	cell->mmio_stats[dst] = cell->mmio_stats[src];
 }
 
 /**
@@ -105,6 +115,8 @@ void mmio_region_register(struct cell *cell, unsigned long start,
 	cell->mmio_locations[index].size = size;
 	cell->mmio_handlers[index].function = handler;
 	cell->mmio_handlers[index].arg = handler_arg;
+	cell->mmio_stats[index].count = 0;
+	cell->mmio_stats[index].ticks = 0;
 
 	cell->num_mmio_regions++;
 
@@ -115,6 +127,13 @@ void mmio_region_register(struct cell *cell, unsigned long start,
 	spin_unlock(&cell->mmio_region_lock);
 }
 
+static inline bool region_contains(const struct mmio_region_location *region,
+				   unsigned long address, unsigned int size)
+{
+	return address >= region->start &&
+		address + size <= region->start + region->size;
+}
+
 static int find_region(struct cell *cell, unsigned long address,
 		       unsigned int size, unsigned long *region_base,
 		       struct mmio_region_handler *handler)
@@ -138,6 +157,18 @@ restart:
 		goto restart;
 	}
 
+	/*
+	 * Guests tend to access the same region repeatedly: try the last hit
+	 * of this CPU first. Like any other field, it is validated by the
+	 * generation check below.
+	 */
+	index = this_cpu_data()->mmio_last_region;
+	if (index < cell->num_mmio_regions) {
+		region = cell->mmio_locations[index];
+		if (region_contains(&region, address, size))
+			goto found;
+	}
+
 	range_start = 0;
 	range_size = cell->num_mmio_regions;
 
@@ -164,25 +195,29 @@ restart:
 			range_size -= index + 1 - range_start;
 			range_start = index + 1;
 		} else {
-			if (region_base != NULL) {
-				*region_base = region.start;
-				*handler = cell->mmio_handlers[index];
-			}
-
-			/*
-			 * Ensure everything was read prior to checking the
-			 * generation for the last time.
-			 */
-			memory_load_barrier();
-
-			/* final check of consistency */
-			if (cell->mmio_generation != generation)
-				goto restart;
-
-			return index;
+			goto found;
 		}
 	}
 	return -1;
+
+found:
+	if (region_base != NULL) {
+		*region_base = region.start;
+		*handler = cell->mmio_handlers[index];
+	}
+
+	/*
+	 * Ensure everything was read prior to checking the generation for the
+	 * last time.
+	 */
+	memory_load_barrier();
+
+	/* final check of consistency */
+	if (cell->mmio_generation != generation)
+		goto restart;
+
+	this_cpu_data()->mmio_last_region = index;
+	return index;
 }
 
 /**
@@ -239,15 +274,45 @@ void mmio_region_unregister(struct cell *cell, unsigned long start)
  */
 enum mmio_result mmio_handle_access(struct mmio_access *mmio)
 {
+	struct cell *cell = this_cell();
 	struct mmio_region_handler handler;
-	unsigned long region_base;
+	struct mmio_region_stats *stats;
+	unsigned long region_base, generation;
+	enum mmio_result result;
+	u64 start;
+	int index;
 
-	if (find_region(this_cell(), mmio->address, mmio->size, &region_base,
-			&handler) < 0)
+	generation = cell->mmio_generation;
+	index = find_region(cell, mmio->address, mmio->size, &region_base,
+			    &handler);
+	if (index < 0) {
+		tracepoint(TRACE_MMIO, mmio->size | TRACE_MMIO_UNHANDLED |
+			   (mmio->is_write ? TRACE_MMIO_WRITE : 0),
+			   mmio->address, mmio->value);
 		return MMIO_UNHANDLED;
+	}
 
+	start = cpu_timestamp();
 	mmio->address -= region_base;
-	return handler.function(handler.arg, mmio);
+	result = handler.function(handler.arg, mmio);
+
+	/*
+	 * Only account if the region table was not modified since the lookup,
+	 * otherwise index may refer to a different region by now. The
+	 * counters are not atomic: concurrent accesses of several cell CPUs
+	 * may lose updates, which is fine for statistics.
+	 */
+	if (cell->mmio_generation == generation) {
+		stats = &cell->mmio_stats[index];
+		stats->count++;
+		stats->ticks += cpu_timestamp() - start;
+	}
+
+	tracepoint(TRACE_MMIO,
+		   mmio->size | (mmio->is_write ? TRACE_MMIO_WRITE : 0),
+		   region_base + mmio->address, mmio->value);
+
+	return result;
 }
 
 /**
@@ -258,10 +323,38 @@ enum mmio_result mmio_handle_access(struct mmio_access *mmio)
  */
 void mmio_cell_exit(struct cell *cell)
 {
-	page_free(&mem_pool, cell->mmio_locations,
-		  PAGES(cell->max_mmio_regions *
-			(sizeof(struct mmio_region_location) +
-			 sizeof(struct mmio_region_handler))));
+	page_free(&mem_pool, cell->mmio_locations, mmio_table_pages(cell));
+}
+
+/**
+ * Copy the per-region access statistics of a cell.
+ * @param cell		Cell to report on.
+ * @param buffer	Destination, receives up to @c max_entries regions in
+ * 			address order and the total number of regions.
+ * @param max_entries	Capacity of @c buffer.
+ *
+ * @return Number of regions copied.
+ */
+int mmio_get_stats(struct cell *cell, struct jailhouse_mmio_stats *buffer,
+		   unsigned int max_entries)
+{
+	struct jailhouse_mmio_stat *entry;
+	unsigned int n;
+
+	spin_lock(&cell->mmio_region_lock);
+
+	buffer->num_entries = cell->num_mmio_regions;
+	for (n = 0; n < cell->num_mmio_regions && n < max_entries; n++) {
+		entry = &buffer->entries[n];
+		entry->start = cell->mmio_locations[n].start;
+		entry->size = cell->mmio_locations[n].size;
+		entry->count = cell->mmio_stats[n].count;
+		entry->ticks = cell->mmio_stats[n].ticks;
+	}
+
+	spin_unlock(&cell->mmio_region_lock);
+
+	return n;
 }
 
 void mmio_perform_access(void *base, struct mmio_access *mmio)
@@ -355,8 +448,49 @@ invalid_access:
 	return MMIO_ERROR;
 }
 
+/*
+ * The pages touched by a sub-page region, provided no full-page region of the
+ * cell shares them: they are not mapped otherwise, so changing their
+ * read-only mapping cannot affect another region.
+ */
+static bool subpage_pages(struct cell *cell,
+			  const struct jailhouse_memory *mem,
+			  struct jailhouse_memory *pages)
+{
+	const struct jailhouse_memory *other;
+	unsigned int n;
+
+	if ((mem->phys_start ^ mem->virt_start) & PAGE_OFFS_MASK)
+		return false;
+
+	pages->phys_start = mem->phys_start & PAGE_MASK;
+	pages->virt_start = mem->virt_start & PAGE_MASK;
+	pages->size = PAGE_ALIGN(mem->virt_start + mem->size) -
+		pages->virt_start;
+	pages->flags = JAILHOUSE_MEM_READ | JAILHOUSE_MEM_IO;
+
+	for_each_mem_region(other, cell->config, n)
+		if (!JAILHOUSE_MEMORY_IS_SUBPAGE(other) &&
+		    other->virt_start < pages->virt_start + pages->size &&
+		    other->virt_start + other->size > pages->virt_start)
+			return false;
+	return true;
+}
+
 int mmio_subpage_register(struct cell *cell, const struct jailhouse_memory *mem)
 {
+	struct jailhouse_memory pages;
+	int err;
+
+	/* read-mostly registers: let reads through, trap only the writes */
+	if ((mem->flags & (JAILHOUSE_MEM_IO_PAGE_READ | JAILHOUSE_MEM_READ)) ==
+	    (JAILHOUSE_MEM_IO_PAGE_READ | JAILHOUSE_MEM_READ) &&
+	    subpage_pages(cell, mem, &pages)) {
+		err = arch_map_memory_region(cell, &pages);
+		if (err)
+			return err;
+	}
+
 	mmio_region_register(cell, mem->virt_start, mem->size,
 			     mmio_handle_subpage, (void *)mem);
 	return 0;
@@ -365,5 +499,14 @@ int mmio_subpage_register(struct cell *cell, const struct jailhouse_memory *mem)
 void mmio_subpage_unregister(struct cell *cell,
 			     const struct jailhouse_memory *mem)
 {
+	struct jailhouse_memory pages;
+
 	mmio_region_unregister(cell, mem->virt_start);
+
+	/*
+	 * Other sub-page regions of the cell in the same pages may have mapped
+	 * them. Those fall back to trapping reads as well.
+	 */
+	if (subpage_pages(cell, mem, &pages))
+		arch_unmap_memory_region(cell, &pages);
 }
@@ -14,13 +14,40 @@
 #include <jailhouse/printk.h>
 #include <jailhouse/string.h>
 #include <jailhouse/control.h>
+#include <asm/spinlock.h>
 
 #define BITS_PER_PAGE		(PAGE_SIZE * 8)
+#define BITMAP_LONGS(bits)	(((bits) + BITS_PER_LONG - 1) / BITS_PER_LONG)
 
 #define INVALID_PAGE_NR		(~0UL)
 
 #define PAGE_SCRUB_ON_FREE	0x1
 
+/* Above this many pages, flush all hypervisor TLB entries instead */
+#define HV_TLB_FLUSH_PAGES	32
+
+/* Page tables a batch holds back before it is committed early */
+#define PT_FREE_BATCH		16
+
+/**
+ * Deferred maintenance of a paging_create or paging_destroy call. The cache
+ * lines of adjacent PTEs are cleaned together and the hypervisor TLBs are
+ * flushed once, at the end of the call. Page tables that became unused are
+ * only released after that flush, so no walk can still reach them.
+ */
+struct paging_batch {
+	unsigned long paging_flags;
+	bool hv_paging;
+	/** PTEs still to be cleaned, [pte_start, pte_end). */
+	pt_entry_t pte_start, pte_end;
+	/** Hypervisor pages still to be flushed, none if !tlb_pending. */
+	bool tlb_pending;
+	unsigned long tlb_start, tlb_last;
+	/** Unlinked page tables, released by paging_batch_commit. */
+	unsigned int pt_free_count;
+	page_table_t pt_free[PT_FREE_BATCH];
+};
+
 /**
  * Offset between virtual and physical hypervisor addresses.
  *
@@ -32,12 +59,28 @@ unsigned long page_offset;
 
 /** Page pool containing physical pages for use by the hypervisor. */
 struct page_pool mem_pool;
+static unsigned long remap_full_bitmap[
+	BITMAP_LONGS(BITS_PER_PAGE * NUM_REMAP_BITMAP_PAGES / BITS_PER_LONG)];
+
 /** Page pool containing virtual pages for remappings by the hypervisor. */
 struct page_pool remap_pool = {
 	.base_address = (void *)REMAP_BASE,
 	.pages = BITS_PER_PAGE * NUM_REMAP_BITMAP_PAGES,
+	.full_bitmap = remap_full_bitmap,
 };
 
+/*
+ * Pages are mostly allocated by management tasks, but also by cell CPUs
+ * populating lazily mapped regions.
+ */
+static spinlock_t pool_lock;
+
+/*
+ * Disjoint regions of the same paging structures may be created in parallel,
+ * see parallel_run. They may meet at a shared intermediate table.
+ */
+static spinlock_t pt_install_lock;
+
 /** Descriptor of the hypervisor paging structures. */
 struct paging_structures hv_paging_structs;
 
@@ -61,7 +104,8 @@ unsigned long paging_get_phys_invalid(pt_entry_t pte, unsigned long virt)
 static unsigned long find_next_free_page(struct page_pool *pool,
 					 unsigned long start)
 {
-	unsigned long bmp_pos, bmp_val, page_nr;
+	unsigned long bmp_pos, bmp_val, page_nr, full, next;
+	unsigned long words = pool->pages / BITS_PER_LONG;
 	unsigned long start_mask = 0;
 
 	if (start >= pool->pages)
@@ -74,8 +118,26 @@ static unsigned long find_next_free_page(struct page_pool *pool,
 	if (start % BITS_PER_LONG > 0)
 		start_mask = ~0UL >> (BITS_PER_LONG - (start % BITS_PER_LONG));
 
-	for (bmp_pos = start / BITS_PER_LONG;
-	     bmp_pos < pool->pages / BITS_PER_LONG; bmp_pos++) {
+	for (bmp_pos = start / BITS_PER_LONG; bmp_pos < words; bmp_pos++) {
+		/*
+		 * Skip the words without free pages, BITS_PER_LONG of them at
+		 * once, so that the search does not depend on the pool size.
+		 */
+		full = pool->full_bitmap[bmp_pos / BITS_PER_LONG] |
+			~(~0UL << (bmp_pos % BITS_PER_LONG));
+		if (full == ~0UL) {
+			bmp_pos |= BITS_PER_LONG - 1;
+			start_mask = 0;
+			continue;
+		}
+		next = (bmp_pos & ~(BITS_PER_LONG - 1)) + ffzl(full);
+		if (next != bmp_pos) {
+			bmp_pos = next;
+			start_mask = 0;
+			if (bmp_pos >= words)
+				break;
+		}
+
 		bmp_val = pool->used_bitmap[bmp_pos] | start_mask;
 		start_mask = 0;
 		if (bmp_val != ~0UL) {
@@ -89,18 +151,74 @@ static unsigned long find_next_free_page(struct page_pool *pool,
 	return INVALID_PAGE_NR;
 }
 
+static void mark_pages_used(struct page_pool *pool, unsigned long start,
+			    unsigned long num)
+{
+	unsigned long page_nr, bmp_pos;
+
+	for (page_nr = start; page_nr < start + num; page_nr++)
+		set_bit(page_nr, pool->used_bitmap);
+
+	for (bmp_pos = start / BITS_PER_LONG;
+	     bmp_pos <= (start + num - 1) / BITS_PER_LONG; bmp_pos++)
+		if (pool->used_bitmap[bmp_pos] == ~0UL)
+			set_bit(bmp_pos, pool->full_bitmap);
+
+	pool->used_pages += num;
+	if (pool->used_pages > pool->peak_pages)
+		pool->peak_pages = pool->used_pages;
+}
+
+/** Pages the memory pool grows by once exhausted. */
+#define MEM_POOL_GROW_PAGES	(0x200000 / PAGE_SIZE)
+
+/*
+ * Make the next chunk of the reserve available, called with pool_lock held.
+ * The reserve is not cleared by the driver, so do that here.
+ */
+static bool mem_pool_grow(struct page_pool *pool)
+{
+	unsigned long start, num, page_nr;
+
+	if (pool != &mem_pool || pool->reserve_pages == 0)
+		return false;
+
+	num = MIN(pool->reserve_pages, MEM_POOL_GROW_PAGES);
+	start = pool->pages - pool->reserve_pages;
+	memset(pool->base_address + start * PAGE_SIZE, 0, num * PAGE_SIZE);
+
+	for (page_nr = start; page_nr < start + num; page_nr++) {
+		clear_bit(page_nr, pool->used_bitmap);
+		clear_bit(page_nr / BITS_PER_LONG, pool->full_bitmap);
+	}
+	pool->reserve_pages -= num;
+	pool->hidden_pages -= num;
+
+	return true;
+}
+
+static bool page_color_ok(struct page_pool *pool, unsigned long page_nr)
+{
+	unsigned long color;
+
+	color = ((paging_hvirt2phys(pool->base_address) >> PAGE_SHIFT) +
+		 page_nr) % pool->way_pages;
+	return color < 64 && (pool->colors & (1ULL << color));
+}
+
 /**
  * Allocate consecutive pages from the specified pool.
  * @param pool		Page pool to allocate from.
  * @param num		Number of pages.
  * @param align_mask	Choose start so that start_page_no & align_mask == 0.
+ * @param colored	Only use pages of the colors of the pool.
  *
  * @return Pointer to first page or NULL if allocation failed.
  *
  * @see page_free
  */
 static void *page_alloc_internal(struct page_pool *pool, unsigned int num,
-				 unsigned long align_mask)
+				 unsigned long align_mask, bool colored)
 {
 	unsigned long aligned_start, pool_start, next, start, last;
 	unsigned int allocated;
@@ -111,6 +229,7 @@ static void *page_alloc_internal(struct page_pool *pool, unsigned int num,
 	aligned_start = ((pool_start + align_mask) & ~align_mask) - pool_start;
 	next = aligned_start;
 
+	spin_lock(&pool_lock);
 restart:
 	/* Forward the search start to the next aligned page. */
 	if ((next - aligned_start) & align_mask)
@@ -118,27 +237,43 @@ restart:
 
 	start = next = find_next_free_page(pool, next);
 	if (start == INVALID_PAGE_NR || num == 0)
-		return NULL;
+		goto out_fail;
 
 	/* Enforce alignment (none of align_mask is 0). */
 	if ((start - aligned_start) & align_mask)
 		goto restart;
 
+	if (colored && !page_color_ok(pool, start)) {
+		next = start + 1;
+		goto restart;
+	}
+
 	for (allocated = 1, last = start; allocated < num;
 	     allocated++, last = next) {
 		next = find_next_free_page(pool, last + 1);
 		if (next == INVALID_PAGE_NR)
-			return NULL;
+			goto out_fail;
 		if (next != last + 1)
 			goto restart;	/* not consecutive */
+		if (colored && !page_color_ok(pool, next)) {
+			next++;
+			goto restart;
+		}
 	}
 
-	for (allocated = 0; allocated < num; allocated++)
-		set_bit(start + allocated, pool->used_bitmap);
-
-	pool->used_pages += num;
+	mark_pages_used(pool, start, num);
+	spin_unlock(&pool_lock);
 
 	return pool->base_address + start * PAGE_SIZE;
+
+out_fail:
+	/* a colored attempt is retried with any color before growing */
+	if (num > 0 && !colored && mem_pool_grow(pool)) {
+		next = aligned_start;
+		goto restart;
+	}
+	spin_unlock(&pool_lock);
+	return NULL;
 }
 
 /**
@@ -152,7 +287,12 @@ restart:
  */
 void *page_alloc(struct page_pool *pool, unsigned int num)
 {
-	return page_alloc_internal(pool, num, 0);
+	void *pages = NULL;
+
+	/* fall back to any color rather than failing */
+	if (pool->colors)
+		pages = page_alloc_internal(pool, num, 0, true);
+	return pages ? pages : page_alloc_internal(pool, num, 0, false);
 }
 
 /**
@@ -166,7 +306,11 @@ void *page_alloc(struct page_pool *pool, unsigned int num)
  */
 void *page_alloc_aligned(struct page_pool *pool, unsigned int num)
 {
-	return page_alloc_internal(pool, num, num - 1);
+	void *pages = NULL;
+
+	if (pool->colors)
+		pages = page_alloc_internal(pool, num, num - 1, true);
+	return pages ? pages : page_alloc_internal(pool, num, num - 1, false);
 }
 
 /**
@@ -184,14 +328,17 @@ void page_free(struct page_pool *pool, void *page, unsigned int num)
 	if (!page)
 		return;
 
+	spin_lock(&pool_lock);
 	while (num-- > 0) {
 		if (pool->flags & PAGE_SCRUB_ON_FREE)
 			memset(page, 0, PAGE_SIZE);
 		page_nr = (page - pool->base_address) / PAGE_SIZE;
 		clear_bit(page_nr, pool->used_bitmap);
+		clear_bit(page_nr / BITS_PER_LONG, pool->full_bitmap);
 		pool->used_pages--;
 		page += PAGE_SIZE;
 	}
+	spin_unlock(&pool_lock);
 }
 
 /**
@@ -229,15 +376,98 @@ unsigned long paging_virt2phys(const struct paging_structures *pg_structs,
 	}
 }
 
-static void flush_pt_entry(pt_entry_t pte, unsigned long paging_flags)
+static void flush_pt_entries(struct paging_batch *batch)
+{
+	if (batch->pte_end != batch->pte_start)
+		arch_paging_flush_cpu_caches(batch->pte_start,
+			(batch->pte_end - batch->pte_start) *
+			sizeof(*batch->pte_start));
+	batch->pte_start = batch->pte_end;
+}
+
+static void flush_pt_entry(struct paging_batch *batch, pt_entry_t pte)
+{
+	if (!(batch->paging_flags & PAGING_COHERENT))
+		return;
+
+	if (pte == batch->pte_end) {
+		batch->pte_end++;
+		return;
+	}
+	flush_pt_entries(batch);
+	batch->pte_start = pte;
+	batch->pte_end = pte + 1;
+}
+
+static void flush_hv_tlbs(struct paging_batch *batch, unsigned long virt,
+			  unsigned long size)
 {
-	if (paging_flags & PAGING_COHERENT)
-		arch_paging_flush_cpu_caches(pte, sizeof(*pte));
+	unsigned long last = virt + (size - 1);
+
+	if (!batch->hv_paging)
+		return;
+
+	if (!batch->tlb_pending) {
+		batch->tlb_pending = true;
+		batch->tlb_start = virt;
+		batch->tlb_last = last;
+		return;
+	}
+	batch->tlb_start = MIN(batch->tlb_start, virt);
+	batch->tlb_last = MAX(batch->tlb_last, last);
 }
 
+static void paging_batch_commit(struct paging_batch *batch)
+{
+	unsigned long addr;
+	unsigned int n;
+
+	flush_pt_entries(batch);
+
+	if (batch->tlb_pending) {
+		if ((batch->tlb_last - batch->tlb_start) / PAGE_SIZE >=
+		    HV_TLB_FLUSH_PAGES) {
+			arch_paging_flush_all_tlbs();
+		} else {
+			addr = batch->tlb_start & PAGE_MASK;
+			do {
+				arch_paging_flush_page_tlbs(addr);
+				addr += PAGE_SIZE;
+			} while (addr - 1 < batch->tlb_last);
+		}
+		batch->tlb_pending = false;
+	} else if (!batch->hv_paging && batch->pt_free_count > 0) {
+		/*
+		 * Leaf changes of cell structures are flushed on config
+		 * commit, but tables about to be reused must not stay
+		 * reachable through any cached walk before that.
+		 */
+		arch_paging_flush_guest_tlbs();
+	}
+
+	for (n = 0; n < batch->pt_free_count; n++)
+		page_free(&mem_pool, batch->pt_free[n], 1);
+	batch->pt_free_count = 0;
+}
+
+static void free_pt(struct paging_batch *batch, page_table_t pt)
+{
+	if (batch->pt_free_count == PT_FREE_BATCH)
+		paging_batch_commit(batch);
+	batch->pt_free[batch->pt_free_count++] = pt;
+}
+
+static int create_batched(const struct paging_structures *pg_structs,
+			  unsigned long phys, unsigned long size,
+			  unsigned long virt, unsigned long access_flags,
+			  struct paging_batch *batch);
+static int destroy_batched(const struct paging_structures *pg_structs,
+			   unsigned long virt, unsigned long size,
+			   struct paging_batch *batch);
+
 static int split_hugepage(bool hv_paging, const struct paging *paging,
 			  pt_entry_t pte, unsigned long virt,
-			  unsigned long paging_flags)
+			  struct paging_batch *batch)
 {
 	unsigned long phys = paging->get_phys(pte, virt);
 	struct paging_structures sub_structs;
@@ -258,10 +488,10 @@ static int split_hugepage(bool hv_paging, const struct paging *paging,
 	if (!sub_structs.root_table)
 		return -ENOMEM;
 	paging->set_next_pt(pte, paging_hvirt2phys(sub_structs.root_table));
-	flush_pt_entry(pte, paging_flags);
+	flush_pt_entry(batch, pte);
 
-	return paging_create(&sub_structs, phys, paging->page_size, virt,
-			     flags, paging_flags);
+	return create_batched(&sub_structs, phys, paging->page_size, virt,
+			      flags, batch);
 }
 
 /**
@@ -277,7 +507,8 @@ static int split_hugepage(bool hv_paging, const struct paging *paging,
  * @return 0 on success, negative error code otherwise.
  *
  * @note The function aims at using the largest possible page size for the
- * mapping but does not consolidate with neighboring mappings.
+ * mapping but does not consolidate with neighboring mappings, see
+ * paging_consolidate.
  *
  * @see paging_destroy
  * @see paging_get_guest_pages
@@ -286,6 +517,26 @@ int paging_create(const struct paging_structures *pg_structs,
 		  unsigned long phys, unsigned long size, unsigned long virt,
 		  unsigned long access_flags, unsigned long paging_flags)
 {
+	struct paging_batch batch = {
+		.paging_flags = paging_flags,
+		.hv_paging = pg_structs->hv_paging,
+	};
+	int err;
+
+	err = create_batched(pg_structs, phys, size, virt, access_flags,
+			     &batch);
+	paging_batch_commit(&batch);
+
+	return err;
+}
+
+static int create_batched(const struct paging_structures *pg_structs,
+			  unsigned long phys, unsigned long size,
+			  unsigned long virt, unsigned long access_flags,
+			  struct paging_batch *batch)
+{
+	unsigned long paging_flags = batch->paging_flags;
+
 	phys &= PAGE_MASK;
 	virt &= PAGE_MASK;
 	size = PAGE_ALIGN(size);
@@ -315,18 +566,17 @@ int paging_create(const struct paging_structures *pg_structs,
 					sub_structs.root_table = pt;
 					sub_structs.hv_paging =
 						pg_structs->hv_paging;
-					paging_destroy(&sub_structs, virt,
-						       paging->page_size,
-						       paging_flags);
+					destroy_batched(&sub_structs, virt,
+							paging->page_size,
+							batch);
 				}
 				paging->set_terminal(pte, phys, access_flags);
-				flush_pt_entry(pte, paging_flags);
+				flush_pt_entry(batch, pte);
 				break;
 			}
 			if (paging->entry_valid(pte, PAGE_PRESENT_FLAGS)) {
 				err = split_hugepage(pg_structs->hv_paging,
-						     paging, pte, virt,
-						     paging_flags);
+						     paging, pte, virt, batch);
 				if (err)
 					return err;
 				pt = paging_phys2hvirt(
@@ -335,14 +585,22 @@ int paging_create(const struct paging_structures *pg_structs,
 				pt = page_alloc(&mem_pool, 1);
 				if (!pt)
 					return -ENOMEM;
+				spin_lock(&pt_install_lock);
+				if (paging->entry_valid(pte,
+							PAGE_PRESENT_FLAGS)) {
+					/* lost the race, retry with theirs */
+					spin_unlock(&pt_install_lock);
+					page_free(&mem_pool, pt, 1);
+					continue;
+				}
 				paging->set_next_pt(pte,
 						    paging_hvirt2phys(pt));
-				flush_pt_entry(pte, paging_flags);
+				flush_pt_entry(batch, pte);
+				spin_unlock(&pt_install_lock);
 			}
 			paging++;
 		}
-		if (pg_structs->hv_paging)
-			arch_paging_flush_page_tlbs(virt);
+		flush_hv_tlbs(batch, virt, paging->page_size);
 
 		phys += paging->page_size;
 		virt += paging->page_size;
@@ -370,6 +628,22 @@ int paging_create(const struct paging_structures *pg_structs,
 int paging_destroy(const struct paging_structures *pg_structs,
 		   unsigned long virt, unsigned long size,
 		   unsigned long paging_flags)
+{
+	struct paging_batch batch = {
+		.paging_flags = paging_flags,
+		.hv_paging = pg_structs->hv_paging,
+	};
+	int err;
+
+	err = destroy_batched(pg_structs, virt, size, &batch);
+	paging_batch_commit(&batch);
+
+	return err;
+}
+
+static int destroy_batched(const struct paging_structures *pg_structs,
+			   unsigned long virt, unsigned long size,
+			   struct paging_batch *batch)
 {
 	size = PAGE_ALIGN(size);
 
@@ -417,8 +691,7 @@ int paging_destroy(const struct paging_structures *pg_structs,
 					break;
 
 				err = split_hugepage(pg_structs->hv_paging,
-						     paging, pte, virt,
-						     paging_flags);
+						     paging, pte, virt, batch);
 				if (err)
 					return err;
 			}
@@ -431,15 +704,14 @@ int paging_destroy(const struct paging_structures *pg_structs,
 		/* walk up again, clearing entries, releasing empty tables */
 		while (1) {
 			paging->clear_entry(pte);
-			flush_pt_entry(pte, paging_flags);
+			flush_pt_entry(batch, pte);
 			if (n == 0 || !paging->page_table_empty(pt[n]))
 				break;
-			page_free(&mem_pool, pt[n], 1);
+			free_pt(batch, pt[n]);
 			paging--;
 			pte = paging->get_entry(pt[--n], virt);
 		}
-		if (pg_structs->hv_paging)
-			arch_paging_flush_page_tlbs(virt);
+		flush_hv_tlbs(batch, virt, page_size);
 
 		if (page_size > size)
 			break;
@@ -449,6 +721,112 @@ int paging_destroy(const struct paging_structures *pg_structs,
 	return 0;
 }
 
+/*
+ * Replace the table below pte by a terminal entry if its entries map one
+ * aligned range with the same flags.
+ */
+static void consolidate_table(const struct paging *paging, pt_entry_t pte,
+			      unsigned long virt, struct paging_batch *batch)
+{
+	const struct paging *sub = paging + 1;
+	unsigned long phys, flags, addr;
+	page_table_t table;
+	pt_entry_t sub_pte;
+
+	table = paging_phys2hvirt(paging->get_next_pt(pte));
+
+	sub_pte = sub->get_entry(table, virt);
+	if (!sub->entry_valid(sub_pte, PAGE_PRESENT_FLAGS))
+		return;
+	phys = sub->get_phys(sub_pte, virt);
+	if (phys == INVALID_PHYS_ADDR || phys & (paging->page_size - 1))
+		return;
+	flags = sub->get_flags(sub_pte);
+
+	for (addr = virt + sub->page_size; addr - virt < paging->page_size;
+	     addr += sub->page_size) {
+		sub_pte = sub->get_entry(table, addr);
+		if (!sub->entry_valid(sub_pte, PAGE_PRESENT_FLAGS) ||
+		    sub->get_phys(sub_pte, addr) != phys + (addr - virt) ||
+		    sub->get_flags(sub_pte) != flags)
+			return;
+	}
+
+	paging->set_terminal(pte, phys, flags);
+	flush_pt_entry(batch, pte);
+	flush_hv_tlbs(batch, virt, paging->page_size);
+	free_pt(batch, table);
+}
+
+/**
+ * Merge mappings into hugepages where possible.
+ * @param pg_structs	Descriptor of paging structures to be used.
+ * @param virt		Start address of the range to consolidate.
+ * @param size		Size of the range.
+ * @param paging_flags	Flags describing the paging mode, see @ref PAGING_FLAGS.
+ *
+ * Tables that lie completely inside the range and map a contiguous, suitably
+ * aligned physical range with identical flags are replaced by a single
+ * hugepage entry. Smaller tables are merged first, so that the results can be
+ * merged again at the next level. This collects mappings that paging_create
+ * had to split, e.g. because they were created by multiple calls for
+ * adjacent regions.
+ *
+ * @note The caller has to flush the TLBs of the users of the paging structures
+ * unless they are hypervisor structures.
+ *
+ * @see paging_create
+ */
+void paging_consolidate(const struct paging_structures *pg_structs,
+			unsigned long virt, unsigned long size,
+			unsigned long paging_flags)
+{
+	struct paging_batch batch = {
+		.paging_flags = paging_flags,
+		.hv_paging = pg_structs->hv_paging,
+	};
+	const struct paging *paging, *walk;
+	unsigned long addr, page_size;
+	unsigned int levels, level;
+	page_table_t pt;
+	pt_entry_t pte;
+
+	for (levels = 1; pg_structs->root_paging[levels - 1].page_size !=
+	     PAGE_SIZE; levels++)
+		;
+
+	/* the last level only holds pages */
+	for (level = levels - 1; level-- > 0; ) {
+		paging = &pg_structs->root_paging[level];
+		page_size = paging->page_size;
+		if (page_size == 0)
+			continue;
+
+		for (addr = (virt + page_size - 1) & ~(page_size - 1);
+		     addr - virt < size && size - (addr - virt) >= page_size;
+		     addr += page_size) {
+			pt = pg_structs->root_table;
+			walk = pg_structs->root_paging;
+			while (1) {
+				pte = walk->get_entry(pt, addr);
+				if (!walk->entry_valid(pte,
+						       PAGE_PRESENT_FLAGS) ||
+				    walk->get_phys(pte, addr) !=
+				    INVALID_PHYS_ADDR)
+					break;
+				if (walk == paging) {
+					consolidate_table(paging, pte, addr,
+							  &batch);
+					break;
+				}
+				pt = paging_phys2hvirt(walk->get_next_pt(pte));
+				walk++;
+			}
+		}
+	}
+	paging_batch_commit(&batch);
+}
+
 static unsigned long
 paging_gvirt2gphys(const struct guest_paging_structures *pg_structs,
 		   unsigned long gvirt, unsigned long tmp_page,
@@ -633,21 +1011,42 @@ int paging_map_all_per_cpu(unsigned int cpu, bool enable)
  */
 int paging_init(void)
 {
-	unsigned long n, per_cpu_pages, config_pages, bitmap_pages;
-	unsigned long vaddr, flags;
+	const struct jailhouse_memory *reserve = &system_config->hypervisor_pool;
+	unsigned long n, per_cpu_pages, config_pages, bitmap_pages, used_longs;
+	unsigned long vaddr, flags, hv_pages, hv_end;
 	int err;
 
 	per_cpu_pages = hypervisor_header.max_cpus *
 		sizeof(struct per_cpu) / PAGE_SIZE;
 
-	config_pages = PAGES(jailhouse_system_config_size(system_config));
+	/* the page-table image of the root cell, if any, follows */
+	config_pages = PAGES(jailhouse_system_config_size(system_config)) +
+		hypervisor_header.pt_cache_pages;
 
 	page_offset = JAILHOUSE_BASE -
 		system_config->hypervisor_memory.phys_start;
 
-	mem_pool.pages = (system_config->hypervisor_memory.size -
+	hv_pages = (system_config->hypervisor_memory.size -
 		(__page_pool - (u8 *)&hypervisor_header)) / PAGE_SIZE;
-	bitmap_pages = (mem_pool.pages + BITS_PER_PAGE - 1) / BITS_PER_PAGE;
+	mem_pool.pages = hv_pages;
+
+	/*
+	 * The reserve is mapped behind the hypervisor memory at the same
+	 * offset, so that paging_hvirt2phys() covers it. The pages in between
+	 * stay marked as used.
+	 */
+	hv_end = system_config->hypervisor_memory.phys_start +
+		system_config->hypervisor_memory.size;
+	if (reserve->size > 0) {
+		if (reserve->phys_start < hv_end ||
+		    (reserve->phys_start | reserve->size) & PAGE_OFFS_MASK)
+			return trace_error(-EINVAL);
+		mem_pool.pages += (reserve->phys_start + reserve->size -
+				   hv_end) / PAGE_SIZE;
+	}
+	used_longs = BITMAP_LONGS(mem_pool.pages);
+	bitmap_pages = PAGES((used_longs + BITMAP_LONGS(used_longs)) *
+			     sizeof(unsigned long));
 
 	if (mem_pool.pages <= per_cpu_pages + config_pages + bitmap_pages)
 		return -ENOMEM;
@@ -656,9 +1055,17 @@ int paging_init(void)
 	mem_pool.used_bitmap =
 		(unsigned long *)(__page_pool + per_cpu_pages * PAGE_SIZE +
 				  config_pages * PAGE_SIZE);
-	mem_pool.used_pages = per_cpu_pages + config_pages + bitmap_pages;
-	for (n = 0; n < mem_pool.used_pages; n++)
-		set_bit(n, mem_pool.used_bitmap);
+	mem_pool.full_bitmap = mem_pool.used_bitmap + used_longs;
+	mark_pages_used(&mem_pool, 0,
+			per_cpu_pages + config_pages + bitmap_pages);
+	if (mem_pool.pages > hv_pages) {
+		mark_pages_used(&mem_pool, hv_pages,
+				mem_pool.pages - hv_pages);
+		mem_pool.hidden_pages = mem_pool.pages - hv_pages;
+		mem_pool.reserve_pages = reserve->size / PAGE_SIZE;
+		mem_pool.used_pages -= mem_pool.hidden_pages;
+		mem_pool.peak_pages = mem_pool.used_pages;
+	}
 	mem_pool.flags = PAGE_SCRUB_ON_FREE;
 
 	remap_pool.used_bitmap = page_alloc(&mem_pool, NUM_REMAP_BITMAP_PAGES);
@@ -684,6 +1091,17 @@ int paging_init(void)
 	if (err)
 		return err;
 
+	if (reserve->size > 0) {
+		err = paging_create(&hv_paging_structs, reserve->phys_start,
+				    reserve->size,
+				    (unsigned long)paging_phys2hvirt(
+					reserve->phys_start),
+				    PAGE_DEFAULT_FLAGS,
+				    PAGING_NON_COHERENT | PAGING_HUGE);
+		if (err)
+			return err;
+	}
+
 	/*
 	 * Make sure any permission changes on the per_cpu region can be
 	 * performed without allocations of page table pages.
@@ -716,13 +1134,78 @@ int paging_init(void)
 	return 0;
 }
 
+static void count_entries(const struct paging *paging, page_table_t pt,
+			  unsigned long entries, unsigned long *count)
+{
+	unsigned long n;
+	pt_entry_t pte;
+
+	for (n = 0, pte = pt; n < entries; n++, pte++) {
+		if (!paging->entry_valid(pte, PAGE_PRESENT_FLAGS))
+			continue;
+		if (paging->get_phys(pte, 0) != INVALID_PHYS_ADDR)
+			count[0]++;
+		else
+			count_entries(paging + 1,
+				paging_phys2hvirt(paging->get_next_pt(pte)),
+				PAGE_SIZE / sizeof(*pte), count + 1);
+	}
+}
+
 /**
- * Dump usage statistic of the page pools.
+ * Count the terminal entries of cell paging structures.
+ * @param pg_structs	Descriptor of the paging structures of a cell, with
+ * 			CELL_ROOT_PT_PAGES root table pages.
+ * @param count		Array of MAX_PAGE_TABLE_LEVELS counters, one per
+ * 			paging level, that are incremented.
+ */
+void paging_count_entries(const struct paging_structures *pg_structs,
+			  unsigned long *count)
+{
+	count_entries(pg_structs->root_paging, pg_structs->root_table,
+		      CELL_ROOT_PT_PAGES * PAGE_SIZE /
+		      sizeof(*pg_structs->root_table), count);
+}
+
+static void dump_cell_stats(struct cell *cell)
+{
+	const struct paging_structures *pg_structs =
+		arch_cell_paging_structs(cell);
+	unsigned long count[MAX_PAGE_TABLE_LEVELS] = { 0 };
+	unsigned long blocks_1g = 0, blocks_2m = 0, pages;
+	const struct paging *paging;
+	unsigned int level;
+
+	if (!pg_structs || !pg_structs->root_table)
+		return;
+
+	paging_count_entries(pg_structs, count);
+	for (level = 0, paging = pg_structs->root_paging;
+	     paging->page_size != PAGE_SIZE; level++, paging++)
+		if (paging->page_size == 1024 * 1024 * 1024)
+			blocks_1g = count[level];
+		else if (paging->page_size == 2 * 1024 * 1024)
+			blocks_2m = count[level];
+	pages = count[level];
+
+	printk("  cell \"%s\": %ld 4K pages, %ld 2M blocks, %ld 1G blocks\n",
+	       cell->config->name, pages, blocks_2m, blocks_1g);
+}
+
+/**
+ * Dump usage statistic of the page pools and of the cell mappings.
  * @param when String that characterizes the associated event.
  */
 void paging_dump_stats(const char *when)
 {
-	printk("Page pool usage %s: mem %ld/%ld, remap %ld/%ld\n", when,
-	       mem_pool.used_pages, mem_pool.pages,
-	       remap_pool.used_pages, remap_pool.pages);
+	struct cell *cell;
+
+	printk("Page pool usage %s: mem %ld/%ld (peak %ld, reserve %ld), "
+	       "remap %ld/%ld (peak %ld)\n", when,
+	       mem_pool.used_pages, mem_pool.pages - mem_pool.hidden_pages,
+	       mem_pool.peak_pages, mem_pool.reserve_pages,
+	       remap_pool.used_pages, remap_pool.pages, remap_pool.peak_pages);
+
+	for_each_cell(cell)
+		dump_cell_stats(cell);
 }
@@ -0,0 +1,85 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/parallel.h>
+#include <jailhouse/processor.h>
+#include <jailhouse/utils.h>
+#include <asm/spinlock.h>
+
+static struct {
+	spinlock_t lock;
+	/** Function of the current run, NULL if there is none */
+	int (*fn)(unsigned long item);
+	/** Items [next, count) are not handed out yet */
+	unsigned long next, count;
+	/** Items handed out and not completed yet */
+	unsigned int busy;
+	/** First error of the current run */
+	int error;
+} work;
+
+/** Run items of the current run until none is left */
+static void parallel_work(void)
+{
+	int (*fn)(unsigned long item);
+	unsigned long item;
+	int err;
+
+	while (1) {
+		spin_lock(&work.lock);
+		fn = work.fn;
+		if (!fn || work.next >= work.count || work.error) {
+			spin_unlock(&work.lock);
+			return;
+		}
+		item = work.next++;
+		work.busy++;
+		spin_unlock(&work.lock);
+
+		err = fn(item);
+
+		spin_lock(&work.lock);
+		if (err && !work.error)
+			work.error = err;
+		work.busy--;
+		spin_unlock(&work.lock);
+	}
+}
+
+void parallel_help(void)
+{
+	if (ACCESS_ONCE(work.fn))
+		parallel_work();
+}
+
+int parallel_run(int (*fn)(unsigned long item), unsigned long count)
+{
+	int err;
+
+	spin_lock(&work.lock);
+	work.next = 0;
+	work.count = count;
+	work.error = 0;
+	work.fn = fn;
+	spin_unlock(&work.lock);
+
+	parallel_work();
+	while (ACCESS_ONCE(work.busy) != 0)
+		cpu_relax();
+
+	spin_lock(&work.lock);
+	work.fn = NULL;
+	err = work.error;
+	spin_unlock(&work.lock);
+
+	/* the work of the other CPUs is visible past this point */
+	memory_barrier();
+
+	return err;
+}
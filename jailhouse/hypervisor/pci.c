@@ -68,6 +68,13 @@ static const struct pci_cfg_control bridge_write[PCI_CONFIG_HEADER_SIZE] = {
 	[0x3c/4] = {PCI_CONFIG_ALLOW,  0xffff00ff}, /* Int Line, Bridge Ctrl */
 };
 
+/* Header dwords that cannot be changed by cells: IDs, class, subsystem IDs,
+ * capability pointer. Bridges use offset 0x2c for the prefetch window. */
+#define ENDPOINT_CFG_SHADOWED	((1 << 0x00/4) | (1 << 0x08/4) | \
+				 (1 << 0x2c/4) | (1 << 0x34/4))
+#define BRIDGE_CFG_SHADOWED	((1 << 0x00/4) | (1 << 0x08/4) | \
+				 (1 << 0x34/4))
+
 static void *pci_space;
 static u64 mmcfg_start, mmcfg_size;
 static u8 end_bus;
@@ -184,6 +191,16 @@ pci_find_capability(struct pci_device *device, u16 address)
 		device->info->caps_start;
 	u32 n;
 
+	if (address < PCI_STD_CONFIG_SIZE) {
+		n = device->cap_map[address / 4];
+		if (n == 0)
+			return NULL;
+		if (cap[n - 1].start <= address &&
+		    cap[n - 1].start + cap[n - 1].len > address)
+			return &cap[n - 1];
+		/* capabilities sharing the dword, fall back to the walk */
+	}
+
 	for (n = 0; n < device->info->num_caps; n++, cap++)
 		if (cap->start <= address && cap->start + cap->len > address)
 			return cap;
@@ -234,8 +251,14 @@ enum pci_access pci_cfg_read_moderate(struct pci_device *device, u16 address,
 	if (device->info->type == JAILHOUSE_PCI_TYPE_IVSHMEM)
 		return ivshmem_pci_cfg_read(device, address, value);
 
-	if (address < PCI_CONFIG_HEADER_SIZE)
+	if (address < PCI_CONFIG_HEADER_SIZE) {
+		if (device->cfg_shadowed & (1 << (address / 4))) {
+			*value = device->cfg_shadow[address / 4] >>
+				((address % 4) * 8);
+			return PCI_ACCESS_DONE;
+		}
 		return PCI_ACCESS_PERFORM;
+	}
 
 	cap = pci_find_capability(device, address);
 	if (!cap)
@@ -576,6 +599,38 @@ void pci_reset_device(struct pci_device *device)
 			 PCI_CMD_INTX_OFF, 2);
 }
 
+/*
+ * Prepare the config space fast path of a physical device: read-only header
+ * dwords are read once, and each dword of the standard config space gets the
+ * capability covering it.
+ */
+static void pci_init_cfg_shadow(struct cell *cell, struct pci_device *device)
+{
+	const struct jailhouse_pci_capability *cap =
+		jailhouse_cell_pci_caps(cell->config) +
+		device->info->caps_start;
+	unsigned int n, dword, end;
+
+	device->cfg_shadowed =
+		device->info->type == JAILHOUSE_PCI_TYPE_BRIDGE ?
+		BRIDGE_CFG_SHADOWED : ENDPOINT_CFG_SHADOWED;
+	for (n = 0; n < PCI_CONFIG_HEADER_SIZE / 4; n++)
+		if (device->cfg_shadowed & (1 << n))
+			device->cfg_shadow[n] =
+				pci_read_config(device->info->bdf, n * 4, 4);
+
+	memset(device->cap_map, 0, sizeof(device->cap_map));
+	/* fill backwards so that the first capability wins, as in the walk */
+	for (n = device->info->num_caps; n > 0; n--) {
+		if (cap[n - 1].start >= PCI_STD_CONFIG_SIZE)
+			continue;
+		end = MIN(cap[n - 1].start + cap[n - 1].len,
+			  PCI_STD_CONFIG_SIZE);
+		for (dword = cap[n - 1].start / 4; dword * 4 < end; dword++)
+			device->cap_map[dword] = n;
+	}
+}
+
 static int pci_add_physical_device(struct cell *cell, struct pci_device *device)
 {
 	unsigned int n, pages, size = device->info->msix_region_size;
@@ -587,6 +642,7 @@ static int pci_add_physical_device(struct cell *cell, struct pci_device *device)
 	for (n = 0; n < PCI_NUM_BARS; n ++)
 		device->bar[n] = pci_read_config(device->info->bdf,
 						 PCI_CFG_BAR + n * 4, 4);
+	pci_init_cfg_shadow(cell, device);
 
 	err = arch_pci_add_physical_device(cell, device);
 	if (err)
@@ -13,23 +13,49 @@
 #include <jailhouse/control.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/panic.h>
+#include <jailhouse/percpu.h>
 #include <jailhouse/processor.h>
 #include <jailhouse/stdarg.h>
 #include <jailhouse/string.h>
+#include <jailhouse/uart.h>
 #include <asm/spinlock.h>
 
 bool virtual_console = false;
+bool printk_deferred_active;
 volatile struct jailhouse_virt_console console
 	__attribute__((section(".console")));
 
 static spinlock_t printk_lock;
 
+/* Position in the virtual console up to which the UART has been fed. */
+static unsigned int console_drained;
+static bool console_drain_cr;
+
+enum printk_length {SZ_NORMAL, SZ_LONG, SZ_LONGLONG};
+
+/*
+ * Source of the conversion arguments: a va_list for printk, the values
+ * recorded by printk_deferred and printk_trace when flushing their records.
+ */
+struct printk_args {
+	va_list *ap;
+	const unsigned long long *values;
+	unsigned int num_values;
+	unsigned int next;
+};
+
 static void console_write(const char *msg)
 {
-	arch_dbg_write(msg);
-
-	if (!virtual_console)
-		return;
+	/*
+	 * With the virtual console, the UART is only written out in the
+	 * background by console_drain(), so that no CPU polls the UART while
+	 * holding the printk lock. A panic still goes out synchronously.
+	 */
+	if (!virtual_console || panic_in_progress) {
+		arch_dbg_write(msg);
+		if (!virtual_console)
+			return;
+	}
 
 	console.busy = true;
 	/* ensure the busy flag is visible prior to updates of the content */
@@ -51,6 +77,48 @@ static void dbg_write_stub(const char *msg)
 {
 }
 
+bool console_drain(void)
+{
+	unsigned int tail;
+	bool pending;
+	char c;
+
+	if (!uart || panic_in_progress)
+		return false;
+
+	spin_lock(&printk_lock);
+
+	tail = console.tail;
+	/* the writers overtook us, skip what is no longer in the ring */
+	if (tail - console_drained > sizeof(console.content)) {
+		console_drained = tail - sizeof(console.content);
+		console_drain_cr = false;
+	}
+
+	if (uart->hyp_mode_enter)
+		uart->hyp_mode_enter(uart);
+
+	while (console_drained != tail && !uart->is_busy(uart)) {
+		c = console.content[console_drained % sizeof(console.content)];
+		if (c == '\n' && !console_drain_cr) {
+			uart->write_char(uart, '\r');
+			console_drain_cr = true;
+			continue;
+		}
+		uart->write_char(uart, c);
+		console_drain_cr = false;
+		console_drained++;
+	}
+
+	if (uart->hyp_mode_leave)
+		uart->hyp_mode_leave(uart);
+
+	pending = console_drained != console.tail;
+	spin_unlock(&printk_lock);
+
+	return pending;
+}
+
 void (*arch_dbg_write)(const char *msg) = dbg_write_stub;
 
 #if BITS_PER_LONG < 64
@@ -148,14 +216,51 @@ static char *align(char *p1, char *p0, unsigned int width, char fill)
 	return p0 + width;
 }
 
-static void __vprintk(const char *fmt, va_list ap)
+/* Next argument, sign-extended for the signed conversions */
+static unsigned long long fetch_arg(struct printk_args *args, char conv,
+				    enum printk_length length)
+{
+	bool is_signed = (conv == 'd' || conv == 'c');
+	unsigned long long v;
+
+	if (args->ap) {
+		if (conv == 'p' || conv == 's')
+			return va_arg(*args->ap, unsigned long);
+		if (length == SZ_LONGLONG)
+			return va_arg(*args->ap, unsigned long long);
+		if (length == SZ_LONG) {
+			if (is_signed)
+				return va_arg(*args->ap, long);
+			return va_arg(*args->ap, unsigned long);
+		}
+		if (is_signed)
+			return va_arg(*args->ap, int);
+		return va_arg(*args->ap, unsigned int);
+	}
+
+	v = args->next < args->num_values ? args->values[args->next++] : 0;
+	if (conv == 'p' || conv == 's')
+		return (unsigned long)v;
+	if (length == SZ_LONGLONG)
+		return v;
+	if (length == SZ_LONG) {
+		if (is_signed)
+			return (long)v;
+		return (unsigned long)v;
+	}
+	if (is_signed)
+		return (int)v;
+	return (unsigned int)v;
+}
+
+static void __vprintk(const char *fmt, struct printk_args *args)
 {
 	char buf[128];
 	char *p, *p0;
 	char c, fill;
 	unsigned long long v;
 	unsigned int width;
-	enum {SZ_NORMAL, SZ_LONG, SZ_LONGLONG} length;
+	enum printk_length length;
 
 	p = buf;
 
@@ -192,35 +297,26 @@ static void __vprintk(const char *fmt, va_list ap)
 
 			switch (c) {
 			case 'c':
-				*p++ = (unsigned char)va_arg(ap, int);
+				*p++ = (unsigned char)fetch_arg(args, c, length);
 				break;
 			case 'd':
-				if (length == SZ_LONGLONG)
-					v = va_arg(ap, long long);
-				else if (length == SZ_LONG)
-					v = va_arg(ap, long);
-				else
-					v = va_arg(ap, int);
+				v = fetch_arg(args, c, length);
 				p = int2str(v, p);
 				p = align(p, p0, width, fill);
 				break;
 			case 'p':
 				*p++ = '0';
 				*p++ = 'x';
-				v = va_arg(ap, unsigned long);
+				v = fetch_arg(args, c, length);
 				p = hex2str(v, p, (unsigned long)-1);
 				break;
 			case 's':
-				console_write(va_arg(ap, const char *));
+				console_write((const char *)(unsigned long)
+					      fetch_arg(args, c, length));
 				break;
 			case 'u':
 			case 'x':
-				if (length == SZ_LONGLONG)
-					v = va_arg(ap, unsigned long long);
-				else if (length == SZ_LONG)
-					v = va_arg(ap, unsigned long);
-				else
-					v = va_arg(ap, unsigned int);
+				v = fetch_arg(args, c, length);
 				if (c == 'u')
 					p = uint2str(v, p);
 				else
@@ -248,12 +344,14 @@ static void __vprintk(const char *fmt, va_list ap)
 
 void printk(const char *fmt, ...)
 {
+	struct printk_args args = { 0 };
 	va_list ap;
 
 	va_start(ap, fmt);
+	args.ap = &ap;
 
 	spin_lock(&printk_lock);
-	__vprintk(fmt, ap);
+	__vprintk(fmt, &args);
 	spin_unlock(&printk_lock);
 
 	va_end(ap);
@@ -262,6 +360,7 @@ void printk(const char *fmt, ...)
 void panic_printk(const char *fmt, ...)
 {
 	unsigned long cpu_id = phys_processor_id();
+	struct printk_args args = { 0 };
 	va_list ap;
 
 	if (atomic_test_and_set_bit(0, &panic_in_progress) &&
@@ -270,8 +369,223 @@ void panic_printk(const char *fmt, ...)
 	panic_cpu = cpu_id;
 
 	va_start(ap, fmt);
+	args.ap = &ap;
 
-	__vprintk(fmt, ap);
+	__vprintk(fmt, &args);
 
 	va_end(ap);
 }
+
+static struct printk_record *printk_record_get(struct printk_ring *ring)
+{
+	if (ring->head - ring->tail >= PRINTK_RING_ENTRIES) {
+		ring->dropped++;
+		return NULL;
+	}
+	return &ring->records[ring->head % PRINTK_RING_ENTRIES];
+}
+
+static void printk_record_commit(struct printk_ring *ring)
+{
+	/* publish the record before moving the head */
+	memory_barrier();
+	ring->head++;
+}
+
+void __printk_trace(const char *fmt, const unsigned long long *args,
+		    unsigned int num_args)
+{
+	struct printk_ring *ring;
+	struct printk_record *record;
+	unsigned int n;
+
+	if (!printk_deferred_active)
+		return;
+
+	ring = &this_cpu_public()->printk_ring;
+	record = printk_record_get(ring);
+	if (!record)
+		return;
+
+	record->fmt = fmt;
+	for (n = 0; n < PRINTK_RECORD_ARGS; n++)
+		record->args[n] = n < num_args ? args[n] : 0;
+	printk_record_commit(ring);
+}
+
+void printk_deferred(const char *fmt, ...)
+{
+	struct printk_args args = { 0 };
+	struct printk_record *record;
+	struct printk_ring *ring;
+	enum printk_length length;
+	const char *p = fmt;
+	unsigned int n = 0;
+	va_list ap;
+	char c;
+
+	va_start(ap, fmt);
+	args.ap = &ap;
+
+	if (!printk_deferred_active) {
+		spin_lock(&printk_lock);
+		__vprintk(fmt, &args);
+		spin_unlock(&printk_lock);
+		va_end(ap);
+		return;
+	}
+
+	ring = &this_cpu_public()->printk_ring;
+	record = printk_record_get(ring);
+	if (!record) {
+		va_end(ap);
+		return;
+	}
+
+	/* collect the arguments the way __vprintk will consume them */
+	while (n < PRINTK_RECORD_ARGS && (c = *p++) != 0) {
+		if (c != '%')
+			continue;
+		c = *p++;
+		while (c >= '0' && c <= '9')
+			c = *p++;
+		length = SZ_NORMAL;
+		if (c == 'l') {
+			length = SZ_LONG;
+			c = *p++;
+			if (c == 'l') {
+				length = SZ_LONGLONG;
+				c = *p++;
+			}
+		}
+		if (c == 0)
+			break;
+		switch (c) {
+		case 'c':
+		case 'd':
+		case 'p':
+		case 's':
+		case 'u':
+		case 'x':
+			record->args[n++] = fetch_arg(&args, c, length);
+			break;
+		}
+	}
+	va_end(ap);
+
+	record->fmt = fmt;
+	while (n < PRINTK_RECORD_ARGS)
+		record->args[n++] = 0;
+	printk_record_commit(ring);
+}
+
+/* Write out the records of one CPU, called with printk_lock held. */
+static void printk_ring_flush(struct printk_ring *ring)
+{
+	struct printk_args args = { 0 };
+	struct printk_record record;
+	unsigned int head = ring->head;
+	unsigned long long lost;
+	unsigned int dropped;
+
+	/* read the records only after the head announcing them */
+	memory_barrier();
+	while (ring->tail != head) {
+		record = ring->records[ring->tail % PRINTK_RING_ENTRIES];
+		/* release the slot only after the record has been copied */
+		memory_barrier();
+		ring->tail++;
+
+		args.values = record.args;
+		args.num_values = PRINTK_RECORD_ARGS;
+		args.next = 0;
+		__vprintk(record.fmt, &args);
+	}
+
+	dropped = ring->dropped;
+	if (dropped != ring->dropped_reported) {
+		lost = dropped - ring->dropped_reported;
+		args.values = &lost;
+		args.num_values = 1;
+		args.next = 0;
+		__vprintk("printk: %u deferred messages dropped\n", &args);
+		ring->dropped_reported = dropped;
+	}
+}
+
+void printk_flush(void)
+{
+	unsigned int cpu;
+
+	spin_lock(&printk_lock);
+	for (cpu = 0; cpu < hypervisor_header.max_cpus; cpu++)
+		if (cpu_id_valid(cpu))
+			printk_ring_flush(&public_per_cpu(cpu)->printk_ring);
+	spin_unlock(&printk_lock);
+}
+
+/* Output budget of the debug console of a cell */
+#define CELL_CONSOLE_PERIOD_MS	100
+#define CELL_CONSOLE_BUDGET	2048
+
+/* Called with the console lock of the cell held. */
+static void cell_console_emit(struct cell *cell)
+{
+	if (cell->console.len == 0)
+		return;
+
+	cell->console.line[cell->console.len] = 0;
+	printk("[%s] %s", cell->config->name, cell->console.line);
+	cell->console.len = 0;
+}
+
+void printk_cell_write(struct cell *cell, const char *buf, unsigned int len)
+{
+	u64 now = cpu_timestamp();
+	unsigned int n;
+	char c;
+
+	spin_lock(&cell->console.lock);
+
+	if (now - cell->console.period_start >=
+	    (u64)arch_timestamp_khz() * CELL_CONSOLE_PERIOD_MS) {
+		cell->console.period_start = now;
+		cell->console.written = 0;
+		if (cell->console.dropped) {
+			printk("[%s] console: %u bytes dropped\n",
+			       cell->config->name, cell->console.dropped);
+			cell->console.dropped = 0;
+		}
+	}
+
+	for (n = 0; n < len; n++) {
+		if (cell->console.written >= CELL_CONSOLE_BUDGET) {
+			cell->console.dropped += len - n;
+			break;
+		}
+		cell->console.written++;
+
+		c = buf[n];
+		if (c == 0)
+			continue;
+		cell->console.line[cell->console.len++] = c;
+
+		/* break overlong lines, keeping room for the newline */
+		if (c != '\n' && cell->console.len == CELL_CONSOLE_LINE - 1)
+			cell->console.line[cell->console.len++] = c = '\n';
+		if (c == '\n')
+			cell_console_emit(cell);
+	}
+
+	spin_unlock(&cell->console.lock);
+}
+
+void printk_cell_flush(struct cell *cell)
+{
+	spin_lock(&cell->console.lock);
+	if (cell->console.len > 0) {
+		cell->console.line[cell->console.len++] = '\n';
+		cell_console_emit(cell);
+	}
+	spin_unlock(&cell->console.lock);
+}
@@ -17,6 +17,7 @@
 #include <jailhouse/mmio.h>
 #include <jailhouse/paging.h>
 #include <jailhouse/control.h>
+#include <jailhouse/parallel.h>
 #include <jailhouse/string.h>
 #include <jailhouse/unit.h>
 #include <generated/version.h>
@@ -24,6 +25,11 @@
 #include <asm/coloring.h>
 
 extern u8 __text_start[];
+extern u8 __memguard_start[], __memguard_end[];
+extern u8 __irqstats_start[], __irqstats_end[];
+extern u8 __perf_start[], __perf_end[];
+extern u8 __cpustats_start[], __cpustats_end[];
+extern u8 __trace_start[], __trace_end[];
 
 static const __attribute__((aligned(PAGE_SIZE))) u8 empty_page[PAGE_SIZE];
 
@@ -74,7 +80,8 @@ static void init_early(unsigned int cpu_id)
 	 * Linux' page table before shutdown without triggering violations.
 	 *
 	 * Allow read access to the console page, if the hypervisor has the
-	 * debug console flag JAILHOUSE_SYS_VIRTUAL_DEBUG_CONSOLE set.
+	 * debug console flag JAILHOUSE_SYS_VIRTUAL_DEBUG_CONSOLE set, and to
+	 * the memguard telemetry, IRQ latency, PMU sample and statistics pages.
 	 */
 	hyp_phys_start = system_config->hypervisor_memory.phys_start;
 	hyp_phys_end = hyp_phys_start + system_config->hypervisor_memory.size;
@@ -86,6 +93,26 @@ static void init_early(unsigned int cpu_id)
 		if (virtual_console &&
 		    hv_page.virt_start == paging_hvirt2phys(&console))
 			hv_page.phys_start = paging_hvirt2phys(&console);
+		else if (hv_page.virt_start >=
+			 paging_hvirt2phys(__memguard_start) &&
+			 hv_page.virt_start < paging_hvirt2phys(__memguard_end))
+			hv_page.phys_start = hv_page.virt_start;
+		else if (hv_page.virt_start >=
+			 paging_hvirt2phys(__irqstats_start) &&
+			 hv_page.virt_start < paging_hvirt2phys(__irqstats_end))
+			hv_page.phys_start = hv_page.virt_start;
+		else if (hv_page.virt_start >=
+			 paging_hvirt2phys(__perf_start) &&
+			 hv_page.virt_start < paging_hvirt2phys(__perf_end))
+			hv_page.phys_start = hv_page.virt_start;
+		else if (hv_page.virt_start >=
+			 paging_hvirt2phys(__cpustats_start) &&
+			 hv_page.virt_start < paging_hvirt2phys(__cpustats_end))
+			hv_page.phys_start = hv_page.virt_start;
+		else if (hv_page.virt_start >=
+			 paging_hvirt2phys(__trace_start) &&
+			 hv_page.virt_start < paging_hvirt2phys(__trace_end))
+			hv_page.phys_start = hv_page.virt_start;
 		else
 			hv_page.phys_start = paging_hvirt2phys(empty_page);
 		error = arch_map_memory_region(&root_cell, &hv_page);
@@ -98,12 +125,15 @@ static void init_early(unsigned int cpu_id)
 	printk("Initializing processors:\n");
 }
 
+/*
+ * Runs on all CPUs in parallel. The per-CPU page tables only take pages from
+ * the locked pool, arch_cpu_init may set up shared state on the first CPU
+ * and is serialized.
+ */
 static void cpu_init(struct per_cpu *cpu_data)
 {
 	int err = -EINVAL;
 
-	printk(" CPU %d... ", cpu_data->public.cpu_id);
-
 	if (!cpu_id_valid(cpu_data->public.cpu_id))
 		goto failed;
 
@@ -134,7 +164,9 @@ static void cpu_init(struct per_cpu *cpu_data)
 	if (err)
 		goto failed;
 
+	spin_lock(&init_lock);
 	err = arch_cpu_init(cpu_data);
+	spin_unlock(&init_lock);
 	if (err)
 		goto failed;
 
@@ -147,7 +179,7 @@ static void cpu_init(struct per_cpu *cpu_data)
 	if (err)
 		goto failed;
 
-	printk("OK\n");
+	printk(" CPU %d... OK\n", cpu_data->public.cpu_id);
 
 	/*
 	 * If this CPU is last, make sure everything was committed before we
@@ -155,14 +187,27 @@ static void cpu_init(struct per_cpu *cpu_data)
 	 * continue.
 	 */
 	memory_barrier();
+	spin_lock(&init_lock);
 	initialized_cpus++;
+	spin_unlock(&init_lock);
 	return;
 
 failed:
-	printk("FAILED\n");
+	printk(" CPU %d... FAILED\n", cpu_data->public.cpu_id);
 	error = err;
 }
 
+/* Stage-2 (and IOMMU) mappings of distinct regions can be built in parallel */
+static int map_root_region(unsigned long n)
+{
+	const struct jailhouse_memory *mem =
+		jailhouse_cell_mem_regions(root_cell.config) + n;
+
+	if (JAILHOUSE_MEMORY_IS_SUBPAGE(mem))
+		return 0;
+	return arch_map_memory_region(&root_cell, mem);
+}
+
 static void init_late(void)
 {
 	unsigned int n, cpu, expected_cpus = 0;
@@ -182,14 +227,18 @@ static void init_late(void)
 		return;
 
 	for_each_mem_region(mem, root_cell.config, n) {
-		if (JAILHOUSE_MEMORY_IS_SUBPAGE(mem))
+		if (JAILHOUSE_MEMORY_IS_SUBPAGE(mem)) {
 			error = mmio_subpage_register(&root_cell, mem);
-		else
-			error = arch_map_memory_region(&root_cell, mem);
-		if (error)
-			return;
+			if (error)
+				return;
+		}
 	}
 
+	error = parallel_run(map_root_region,
+			     root_cell.config->num_memory_regions);
+	if (error)
+		return;
+
 	for_each_unit(unit) {
 		printk("Initializing unit: %s\n", unit->name);
 		error = unit->init();
@@ -237,11 +286,11 @@ int entry(unsigned int cpu_id, struct per_cpu *cpu_data)
 		init_early(cpu_id);
 	}
 
+	spin_unlock(&init_lock);
+
 	if (!error)
 		cpu_init(cpu_data);
 
-	spin_unlock(&init_lock);
-
 	while (!error && initialized_cpus < hypervisor_header.online_cpus)
 		cpu_relax();
 
@@ -256,8 +305,11 @@ int entry(unsigned int cpu_id, struct per_cpu *cpu_data)
 			activate = true;
 		}
 	} else {
-		while (!error && !activate)
+		while (!error && !activate) {
+			/* lend a hand to the system-wide steps */
+			parallel_help();
 			cpu_relax();
+		}
 	}
 
 	if (error) {
@@ -272,8 +324,11 @@ int entry(unsigned int cpu_id, struct per_cpu *cpu_data)
 	 */
 	arch_color_dyncolor_flush();
 
-	if (master)
+	if (master) {
 		printk("Activating hypervisor\n");
+		/* every CPU can reach its own ring from here on */
+		printk_deferred_active = true;
+	}
 
 	/* point of no return */
 	arch_cpu_activate_vmm();
@@ -287,4 +342,16 @@ hypervisor_header = {
 	.percpu_size = sizeof(struct per_cpu),
 	.entry = arch_entry - JAILHOUSE_BASE,
 	.console_page = (unsigned long)&console - JAILHOUSE_BASE,
+	.memguard_telemetry_page =
+		(unsigned long)__memguard_start - JAILHOUSE_BASE,
+#ifdef CONFIG_IRQ_LATENCY_STATS
+	.irq_latency_page = (unsigned long)__irqstats_start - JAILHOUSE_BASE,
+#endif
+#ifdef CONFIG_PMU_SAMPLING
+	.perf_page = (unsigned long)__perf_start - JAILHOUSE_BASE,
+#endif
+	.cpu_stats_page = (unsigned long)__cpustats_start - JAILHOUSE_BASE,
+#ifdef CONFIG_TRACEPOINTS
+	.trace_page = (unsigned long)__trace_start - JAILHOUSE_BASE,
+#endif
 };
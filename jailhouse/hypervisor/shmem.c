@@ -0,0 +1,423 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/control.h>
+#include <jailhouse/ivshmem.h>
+#include <jailhouse/paging.h>
+#include <jailhouse/printk.h>
+#include <jailhouse/shmem.h>
+#include <jailhouse/string.h>
+#include <jailhouse/unit.h>
+#include <jailhouse/utils.h>
+#include <jailhouse/hypercall.h>
+#include <asm/spinlock.h>
+
+/*
+ * Segments are carved first-fit from the pool of the system config. Each one
+ * belongs to two cells, and each cell maps it into its stage 2 with its own
+ * JAILHOUSE_HC_SHMEM_SEGMENT call. The tables of a running cell are thus only
+ * changed by the cell itself, like the lazy regions.
+ */
+struct shmem_segment {
+	char name[JAILHOUSE_SHMEM_NAME_MAXLEN + 1];
+	/** IDs of the two cells, the allocating one first. */
+	unsigned int cell_id[2];
+	/** Mapping of each cell, size 0 while it does not map the segment. */
+	struct jailhouse_memory mapping[2];
+	unsigned long phys_start;
+	/** Pool space of the segment, 0 for a free slot. */
+	unsigned long span;
+	unsigned long size;
+	u64 colors;
+};
+
+static struct shmem_segment segments[JAILHOUSE_SHMEM_MAX_SEGMENTS];
+static spinlock_t shmem_lock;
+
+static bool ranges_overlap(unsigned long start1, unsigned long size1,
+			   unsigned long start2, unsigned long size2)
+{
+	return start1 < start2 + size2 && start2 < start1 + size1;
+}
+
+static struct shmem_segment *segment_lookup(const char *name)
+{
+	unsigned int n;
+
+	for (n = 0; n < ARRAY_SIZE(segments); n++)
+		if (segments[n].span &&
+		    strncmp(segments[n].name, name,
+			    sizeof(segments[n].name)) == 0)
+			return &segments[n];
+	return NULL;
+}
+
+static int segment_side(const struct shmem_segment *seg, unsigned int id)
+{
+	if (seg->cell_id[0] == id)
+		return 0;
+	if (seg->cell_id[1] == id)
+		return 1;
+	return -1;
+}
+
+/*
+ * Pool space of a segment of size bytes. A colored segment takes the same
+ * pages of consecutive ways, see color_paging_create, and all of the pages in
+ * between remain reserved with it.
+ */
+static unsigned long segment_span(unsigned long size, u64 colors)
+{
+	unsigned int bit, num_colors = 0;
+
+	if (size == 0 || (size & PAGE_OFFS_MASK) != 0)
+		return 0;
+	if (colors == 0)
+		return size;
+
+	if (mem_pool.way_pages == 0 ||
+	    (mem_pool.way_pages < 64 && (colors >> mem_pool.way_pages) != 0))
+		return 0;
+
+	for (bit = 0; bit < 64; bit++)
+		if (colors & (1ULL << bit))
+			num_colors++;
+
+	/* the mapping covers whole ways */
+	if (size % (num_colors * PAGE_SIZE) != 0)
+		return 0;
+
+	return size / (num_colors * PAGE_SIZE) * mem_pool.way_pages *
+		PAGE_SIZE;
+}
+
+static bool pool_alloc(unsigned long span, unsigned long align,
+		       unsigned long *phys)
+{
+	const struct jailhouse_memory *pool = &system_config->shmem_pool;
+	const struct shmem_segment *seg;
+	unsigned int n;
+	bool moved;
+
+	*phys = (pool->phys_start + align - 1) & ~(align - 1);
+	do {
+		moved = false;
+		for (n = 0; n < ARRAY_SIZE(segments); n++) {
+			seg = &segments[n];
+			if (seg->span &&
+			    ranges_overlap(seg->phys_start, seg->span,
+					   *phys, span)) {
+				*phys = (seg->phys_start + seg->span +
+					 align - 1) & ~(align - 1);
+				moved = true;
+			}
+		}
+	} while (moved);
+
+	return *phys + span <= pool->phys_start + pool->size;
+}
+
+/* Segments must not leak data between their owners. */
+static void segment_clear(unsigned long phys, unsigned long size)
+{
+	unsigned long chunk;
+
+	while (size > 0) {
+		chunk = MIN(size, NUM_TEMPORARY_PAGES * PAGE_SIZE);
+
+		/* cannot fail, mapping area is preallocated */
+		paging_create(&this_cpu_data()->pg_structs, phys, chunk,
+			      TEMPORARY_MAPPING_BASE, PAGE_DEFAULT_FLAGS,
+			      PAGING_NON_COHERENT | PAGING_NO_HUGE);
+		memset((void *)TEMPORARY_MAPPING_BASE, 0, chunk);
+
+		phys += chunk;
+		size -= chunk;
+	}
+}
+
+static int segment_alloc(struct shmem_segment *seg, unsigned int id,
+			 const struct jailhouse_shmem_segment *args)
+{
+	unsigned long span = segment_span(args->size, args->colors);
+	unsigned long align = PAGE_SIZE;
+
+	if (span == 0 || args->peer_id == id)
+		return -EINVAL;
+
+	/* the color of a page is its offset in the way */
+	if (args->colors)
+		align = mem_pool.way_pages * PAGE_SIZE;
+
+	if (!pool_alloc(span, align, &seg->phys_start))
+		return -ENOMEM;
+
+	memcpy(seg->name, args->name, sizeof(seg->name));
+	seg->cell_id[0] = id;
+	seg->cell_id[1] = args->peer_id;
+	seg->mapping[0].size = seg->mapping[1].size = 0;
+	seg->size = args->size;
+	seg->colors = args->colors;
+	seg->span = span;
+
+	segment_clear(seg->phys_start, span);
+
+	return 0;
+}
+
+/* The guest range must not hide memory or devices of the cell. */
+static bool segment_fits(struct cell *cell, const struct jailhouse_memory *map)
+{
+	const struct shmem_segment *seg;
+	const struct jailhouse_memory *mem;
+	unsigned int n;
+	int side;
+
+	for_each_mem_region(mem, cell->config, n)
+		if (ranges_overlap(mem->virt_start, mem->size,
+				   map->virt_start, map->size))
+			return false;
+
+	for (n = 0; n < ARRAY_SIZE(segments); n++) {
+		seg = &segments[n];
+		side = segment_side(seg, cell->config->id);
+		if (seg->span && side >= 0 && seg->mapping[side].size &&
+		    ranges_overlap(seg->mapping[side].virt_start,
+				   seg->mapping[side].size,
+				   map->virt_start, map->size))
+			return false;
+	}
+
+	return true;
+}
+
+static int segment_get(struct cell *cell,
+		       struct jailhouse_shmem_segment *args)
+{
+	const unsigned long allowed = JAILHOUSE_MEM_READ | JAILHOUSE_MEM_WRITE;
+	unsigned int n, id = cell->config->id;
+	struct jailhouse_memory map;
+	struct shmem_segment *seg;
+	bool allocated = false;
+	int side, err;
+
+	if (!(args->flags & JAILHOUSE_MEM_READ) || (args->flags & ~allowed) ||
+	    (args->virt_start & PAGE_OFFS_MASK) != 0)
+		return -EINVAL;
+
+	seg = segment_lookup(args->name);
+	if (!seg) {
+		if (args->size == 0)
+			return -ENOENT;
+
+		for (n = 0; n < ARRAY_SIZE(segments); n++)
+			if (!segments[n].span)
+				break;
+		if (n == ARRAY_SIZE(segments))
+			return -ENOMEM;
+
+		seg = &segments[n];
+		err = segment_alloc(seg, id, args);
+		if (err)
+			return err;
+		allocated = true;
+	}
+
+	side = segment_side(seg, id);
+	if (side < 0)
+		return -EPERM;
+	if (seg->mapping[side].size)
+		return -EEXIST;
+	if (args->size != 0 && args->size != seg->size)
+		return -EINVAL;
+
+	map.phys_start = seg->phys_start;
+	map.virt_start = args->virt_start ? args->virt_start : seg->phys_start;
+	map.size = seg->size;
+	map.flags = args->flags;
+	map.colors = seg->colors;
+	if (seg->colors)
+		map.flags |= JAILHOUSE_MEM_COLORED;
+
+	err = segment_fits(cell, &map) ? arch_map_memory_region(cell, &map) :
+		-EINVAL;
+	if (err) {
+		if (allocated)
+			seg->span = 0;
+		return err;
+	}
+	seg->mapping[side] = map;
+
+	args->peer_id = seg->cell_id[!side];
+	args->size = seg->size;
+	args->virt_start = map.virt_start;
+	args->colors = seg->colors;
+	args->phys_start = seg->phys_start;
+
+	return 0;
+}
+
+static void segment_unmap(struct cell *cell, struct shmem_segment *seg,
+			  int side)
+{
+	/*
+	 * This cannot fail. The segment was mapped as a whole before, thus
+	 * no hugepages need to be broken up to unmap it.
+	 */
+	arch_unmap_memory_region(cell, &seg->mapping[side]);
+	seg->mapping[side].size = 0;
+
+	if (!seg->mapping[!side].size)
+		seg->span = 0;
+}
+
+static int segment_put(struct cell *cell,
+		       struct jailhouse_shmem_segment *args)
+{
+	struct shmem_segment *seg = segment_lookup(args->name);
+	int side;
+
+	if (!seg)
+		return -ENOENT;
+
+	side = segment_side(seg, cell->config->id);
+	if (side < 0)
+		return -EPERM;
+	if (!seg->mapping[side].size)
+		return -ENOENT;
+
+	args->peer_id = seg->cell_id[!side];
+	segment_unmap(cell, seg, side);
+
+	/* the other CPUs of the cell may still hold translations */
+	arch_flush_cell_vcpu_caches(cell);
+
+	return 0;
+}
+
+/**
+ * Get or put a segment of the shared-memory pool for the calling cell.
+ * @param cpu_data	Data structure of the calling CPU.
+ * @param op		JAILHOUSE_SHMEM_GET or JAILHOUSE_SHMEM_PUT.
+ * @param address	Guest address of the struct jailhouse_shmem_segment.
+ *
+ * @return 0 on success, negative error code otherwise.
+ */
+long shmem_segment(struct per_cpu *cpu_data, unsigned long op,
+		   unsigned long address)
+{
+	unsigned long page_offs = address & PAGE_OFFS_MASK;
+	struct cell *cell = cpu_data->public.cell;
+	struct jailhouse_shmem_segment args;
+	void *mapping;
+	int err;
+
+	if (system_config->shmem_pool.size == 0)
+		return -ENODEV;
+	if (op != JAILHOUSE_SHMEM_GET && op != JAILHOUSE_SHMEM_PUT)
+		return -EINVAL;
+
+	mapping = paging_get_guest_pages(NULL, address,
+					 PAGES(page_offs + sizeof(args)),
+					 PAGE_READONLY_FLAGS);
+	if (!mapping)
+		return -ENOMEM;
+	memcpy(&args, mapping + page_offs, sizeof(args));
+
+	args.name[JAILHOUSE_SHMEM_NAME_MAXLEN] = 0;
+	if (args.name[0] == 0)
+		return -EINVAL;
+
+	spin_lock(&shmem_lock);
+	if (op == JAILHOUSE_SHMEM_GET)
+		err = segment_get(cell, &args);
+	else
+		err = segment_put(cell, &args);
+	spin_unlock(&shmem_lock);
+
+	if (err)
+		return err;
+
+	if (op == JAILHOUSE_SHMEM_GET) {
+		/* segment_clear reused the temporary mapping */
+		mapping = paging_get_guest_pages(NULL, address,
+						 PAGES(page_offs +
+						       sizeof(args)),
+						 PAGE_DEFAULT_FLAGS);
+		if (mapping)
+			memcpy(mapping + page_offs, &args, sizeof(args));
+	}
+
+	ivshmem_notify_peer(cell, args.peer_id);
+
+	return 0;
+}
+
+static bool pool_overlaps(const struct jailhouse_memory *mem)
+{
+	const struct jailhouse_memory *pool = &system_config->shmem_pool;
+
+	return ranges_overlap(mem->phys_start, mem->size,
+			      pool->phys_start, pool->size);
+}
+
+static int shmem_cell_init(struct cell *cell)
+{
+	const struct jailhouse_memory *mem;
+	unsigned int n;
+
+	if (system_config->shmem_pool.size == 0)
+		return 0;
+
+	for_each_mem_region(mem, cell->config, n)
+		if (pool_overlaps(mem))
+			return trace_error(-EINVAL);
+
+	return 0;
+}
+
+static void shmem_cell_exit(struct cell *cell)
+{
+	struct shmem_segment *seg;
+	unsigned int n;
+	int side;
+
+	spin_lock(&shmem_lock);
+	for (n = 0; n < ARRAY_SIZE(segments); n++) {
+		seg = &segments[n];
+		side = segment_side(seg, cell->config->id);
+		/* flushed by the config_commit of the cell destruction */
+		if (seg->span && side >= 0 && seg->mapping[side].size)
+			segment_unmap(cell, seg, side);
+	}
+	spin_unlock(&shmem_lock);
+}
+
+static int shmem_init(void)
+{
+	const struct jailhouse_memory *pool = &system_config->shmem_pool;
+
+	if (pool->size == 0)
+		return 0;
+
+	if (((pool->phys_start | pool->size) & PAGE_OFFS_MASK) != 0 ||
+	    pool_overlaps(&system_config->hypervisor_memory) ||
+	    (system_config->hypervisor_pool.size != 0 &&
+	     pool_overlaps(&system_config->hypervisor_pool)))
+		return trace_error(-EINVAL);
+
+	printk("Shared memory pool: 0x%llx-0x%llx\n", pool->phys_start,
+	       pool->phys_start + pool->size - 1);
+
+	return shmem_cell_init(&root_cell);
+}
+
+DEFINE_UNIT_SHUTDOWN_STUB(shmem);
+DEFINE_UNIT_MMIO_COUNT_REGIONS_STUB(shmem);
+DEFINE_UNIT(shmem, "Shared memory");
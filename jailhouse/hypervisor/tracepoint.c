@@ -0,0 +1,60 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/control.h>
+#include <jailhouse/percpu.h>
+#include <jailhouse/processor.h>
+#include <jailhouse/tracepoint.h>
+
+/*
+ * Each CPU only writes its own ring, and it does so with interrupts off in
+ * the hypervisor, so no lock is needed. Full rings are overwritten, the
+ * reader detects the loss by the distance of the heads it sampled.
+ */
+
+/* Per-CPU trace rings, mapped read-only to the root cell */
+static struct trace_ring trace_rings[TRACE_CPUS]
+	__attribute__((section(".trace")));
+
+volatile u32 trace_events;
+
+void __trace_record(unsigned int event, u32 arg0, u64 arg1, u64 arg2)
+{
+	struct trace_record *record;
+	struct trace_ring *ring;
+
+	if (this_cpu_id() >= TRACE_CPUS)
+		return;
+
+	ring = &trace_rings[this_cpu_id()];
+	record = &ring->records[ring->head % TRACE_ENTRIES];
+
+	record->timestamp = cpu_timestamp();
+	record->event = event;
+	record->cell_id = this_cell()->config->id;
+	record->arg0 = arg0;
+	record->arg1 = arg1;
+	record->arg2 = arg2;
+
+	/* publish the record before moving the head */
+	memory_barrier();
+	ring->head++;
+}
+
+int trace_set(struct per_cpu *cpu_data, unsigned long mask)
+{
+	if (cpu_data->public.cell != &root_cell)
+		return -EPERM;
+	if (mask >> TRACE_NUM_EVENTS)
+		return -EINVAL;
+
+	trace_events = mask;
+
+	return 0;
+}
@@ -45,7 +45,11 @@
 
 /* CPU statistics, arm-specific part */
 #define JAILHOUSE_CPU_STAT_VMEXITS_CP15		JAILHOUSE_GENERIC_CPU_STATS + 5
-#define JAILHOUSE_NUM_CPU_STATS			JAILHOUSE_GENERIC_CPU_STATS + 6
+#define JAILHOUSE_CPU_STAT_VIRQ_DROPPED		JAILHOUSE_GENERIC_CPU_STATS + 6
+#define JAILHOUSE_CPU_STAT_VIRQ_SDEI		JAILHOUSE_GENERIC_CPU_STATS + 7
+#define JAILHOUSE_CPU_STAT_VIRQ_LR		JAILHOUSE_GENERIC_CPU_STATS + 8
+#define JAILHOUSE_CPU_STAT_IRQ_STEERED		JAILHOUSE_GENERIC_CPU_STATS + 9
+#define JAILHOUSE_NUM_CPU_STATS			JAILHOUSE_GENERIC_CPU_STATS + 10
 
 #ifndef __ASSEMBLY__
 typedef __u32 __jh_arg;
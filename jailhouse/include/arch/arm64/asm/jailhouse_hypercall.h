@@ -43,10 +43,87 @@
 #define JAILHOUSE_CALL_CLOBBERED	"x3"
 
 /* CPU statistics, arm64-specific part */
-#define JAILHOUSE_NUM_CPU_STATS			JAILHOUSE_GENERIC_CPU_STATS + 5
+#define JAILHOUSE_CPU_STAT_MEMGUARD_THROTTLED	JAILHOUSE_GENERIC_CPU_STATS + 5
+#define JAILHOUSE_CPU_STAT_MEMGUARD_BLOCKED_US	JAILHOUSE_GENERIC_CPU_STATS + 6
+#define JAILHOUSE_CPU_STAT_VIRQ_DROPPED		JAILHOUSE_GENERIC_CPU_STATS + 7
+#define JAILHOUSE_CPU_STAT_VIRQ_SDEI		JAILHOUSE_GENERIC_CPU_STATS + 8
+#define JAILHOUSE_CPU_STAT_VIRQ_LR		JAILHOUSE_GENERIC_CPU_STATS + 9
+/* Microseconds spent in the hypervisor per trap class and IRQ type */
+#define JAILHOUSE_CPU_STAT_TRAP_US_HVC		JAILHOUSE_GENERIC_CPU_STATS + 10
+#define JAILHOUSE_CPU_STAT_TRAP_US_SMC		JAILHOUSE_GENERIC_CPU_STATS + 11
+#define JAILHOUSE_CPU_STAT_TRAP_US_SYSREG	JAILHOUSE_GENERIC_CPU_STATS + 12
+#define JAILHOUSE_CPU_STAT_TRAP_US_DABT		JAILHOUSE_GENERIC_CPU_STATS + 13
+#define JAILHOUSE_CPU_STAT_TRAP_US_IABT		JAILHOUSE_GENERIC_CPU_STATS + 14
+#define JAILHOUSE_CPU_STAT_IRQ_US_MAINTENANCE	JAILHOUSE_GENERIC_CPU_STATS + 15
+#define JAILHOUSE_CPU_STAT_IRQ_US_TIMER		JAILHOUSE_GENERIC_CPU_STATS + 16
+#define JAILHOUSE_CPU_STAT_IRQ_US_PMU		JAILHOUSE_GENERIC_CPU_STATS + 17
+#define JAILHOUSE_CPU_STAT_IRQ_US_SGI		JAILHOUSE_GENERIC_CPU_STATS + 18
+#define JAILHOUSE_CPU_STAT_IRQ_US_OTHER		JAILHOUSE_GENERIC_CPU_STATS + 19
+/* SPIs in 1-of-N mode moved away from this CPU after their delivery */
+#define JAILHOUSE_CPU_STAT_IRQ_STEERED		JAILHOUSE_GENERIC_CPU_STATS + 20
+#define JAILHOUSE_NUM_CPU_STATS			JAILHOUSE_GENERIC_CPU_STATS + 21
 
 #ifndef __ASSEMBLY__
 typedef __u64 __jh_arg;
+
+/** Cell-wide part of struct jailhouse_cell_snapshot, GICv3 only */
+struct jailhouse_irq_state {
+	/** SPI affinity routing, GICD_IROUTER values. */
+	__u64 route[1024];
+	/** Enabled SPIs of the cell, indexed by interrupt number. */
+	__u32 enabled[1024 / 32];
+	/** SPI trigger configuration, GICD_ICFGR layout. */
+	__u32 config[1024 / 16];
+	/** SPI priorities. */
+	__u8 priority[1024];
+};
+
+/** Per-vCPU part of struct jailhouse_cell_snapshot */
+struct jailhouse_vcpu_state {
+	/** 0 if the vCPU was waiting for PSCI CPU_ON. */
+	__u64 online;
+	__u64 x[31];
+	/** ELR_EL2 and SPSR_EL2, i.e. where the vCPU resumes. */
+	__u64 pc;
+	__u64 pstate;
+	__u64 sp_el0;
+	__u64 sp_el1;
+	__u64 elr_el1;
+	__u64 spsr_el1;
+	__u64 sctlr_el1;
+	__u64 cpacr_el1;
+	__u64 ttbr0_el1;
+	__u64 ttbr1_el1;
+	__u64 tcr_el1;
+	__u64 mair_el1;
+	__u64 amair_el1;
+	__u64 vbar_el1;
+	__u64 contextidr_el1;
+	__u64 tpidr_el0;
+	__u64 tpidrro_el0;
+	__u64 tpidr_el1;
+	__u64 cntkctl_el1;
+	__u64 esr_el1;
+	__u64 far_el1;
+	__u64 par_el1;
+	__u64 afsr0_el1;
+	__u64 afsr1_el1;
+	__u64 csselr_el1;
+	__u64 cntv_ctl;
+	__u64 cntv_cval;
+	__u64 cntp_ctl;
+	__u64 cntp_cval;
+	__u64 fpsr;
+	__u64 fpcr;
+	/** q0..q31 */
+	__u64 v[64];
+	/** Virtual CPU interface: priority mask, group enables. */
+	__u64 ich_vmcr;
+	/** Enabled SGIs and PPIs of the cell. */
+	__u32 sgi_ppi_enabled;
+	__u32 padding;
+	__u8 sgi_ppi_priority[32];
+};
 #endif
 
 #include "../arm-common/asm/jailhouse_hypercall.h"
@@ -0,0 +1,73 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Balloon protocol for JAILHOUSE_MEM_RESIZABLE regions, over an ivshmem link
+ * between the root cell and a non-root cell (JAILHOUSE_SHMEM_PROTO_BALLOON).
+ *
+ * The hypervisor only moves the tail of the region between the cells, see
+ * JAILHOUSE_HC_CELL_MEM_RESIZE. The guest has to stop using memory before it
+ * is taken away, and it must not use memory before it was given back. Each
+ * peer publishes a struct jailhouse_balloon at the start of its output
+ * section:
+ *
+ * Shrinking: the root cell sets size to the new target and increments seq.
+ * The guest takes memory above the target off-line, then sets its size to
+ * the lowest size it could reach and its seq to that of the request. The
+ * root cell resizes the region to the size reported by the guest.
+ *
+ * Growing: the root cell resizes the region first, then requests the new
+ * size. The guest adds the memory and acknowledges it the same way.
+ *
+ * Sizes are offsets from the region start and multiples of
+ * JAILHOUSE_MEM_RESIZE_STEP.
+ */
+
+#ifndef _JAILHOUSE_BALLOON_H
+#define _JAILHOUSE_BALLOON_H
+
+#define JAILHOUSE_BALLOON_REVISION	1
+
+struct jailhouse_balloon {
+	/** JAILHOUSE_BALLOON_REVISION, 0 while the peer is not ready */
+	__u32 revision;
+	/** Request number, the guest echoes the last one it handled */
+	__u32 seq;
+	/** Root cell: requested size, guest: size in use */
+	__u64 size;
+};
+
+#endif /* !_JAILHOUSE_BALLOON_H */
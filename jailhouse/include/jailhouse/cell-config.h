@@ -60,13 +60,44 @@
  * Incremented on any layout or semantic change of system or cell config.
  * Also update formats and HEADER_REVISION in pyjailhouse/config_parser.py.
  */
-#define JAILHOUSE_CONFIG_REVISION	14
+#define JAILHOUSE_CONFIG_REVISION	22
 
 #define JAILHOUSE_CELL_NAME_MAXLEN	31
 
 #define JAILHOUSE_CELL_PASSIVE_COMMREG	0x00000001
 #define JAILHOUSE_CELL_TEST_DEVICE	0x00000002
 #define JAILHOUSE_CELL_AARCH32		0x00000004
+/*
+ * ARM64: deliver interrupts via SDEI, giving the cells direct access to the
+ * physical GIC CPU interface instead of injecting virtual IRQs. This is a
+ * system-wide mode selected by the root cell. A non-root cell setting the
+ * flag is only accepted if the mode is active.
+ */
+#define JAILHOUSE_CELL_SDEI_IRQS	0x00000008
+/*
+ * ARM: deliver the SGIs a cell sends to its own CPUs through a precomputed
+ * per-cluster table: one SGI_INJECT for all targets of a cluster instead of
+ * checking every CPU of the cell. The CPUs of the cell may span at most 8
+ * clusters. Guest SGI writes still trap: with HCR_EL2.IMO set, the
+ * architecture traps every ICC_SGI1R_EL1 write.
+ */
+#define JAILHOUSE_CELL_DIRECT_SGI	0x00000010
+/*
+ * ARM GICv3: accept the 1-of-N Interrupt Routing Mode for the cell's SPIs.
+ * The hypervisor emulates it by moving such an SPI, after each delivery, to
+ * the CPU of the cell that received the fewest interrupts so far. Not
+ * available with JAILHOUSE_CELL_SDEI_IRQS, there the hypervisor does not see
+ * the interrupts.
+ */
+#define JAILHOUSE_CELL_IRQ_BALANCE	0x00000020
+/*
+ * ARM64 GICv3: the cell may time-share CPUs with one other cell having this
+ * flag. A CPU the cell lists that already belongs to such a cell is not taken
+ * from the root cell but runs both cells, switching between them according to
+ * the cyclic schedule set by JAILHOUSE_HC_CPU_SCHEDULE. Cells without the flag
+ * keep their CPUs exclusive.
+ */
+#define JAILHOUSE_CELL_CPU_SHARED	0x00000040
 
 /*
  * The flag JAILHOUSE_CELL_VIRTUAL_CONSOLE_PERMITTED allows inmates to invoke
@@ -113,7 +144,15 @@ struct jailhouse_cell_desc {
 	__u32 vpci_irq_base;
 
 	__u64 cpu_reset_address;
+	/* reply timeout of messages to the cell in microseconds, 0 for none */
 	__u64 msg_reply_timeout;
+	/* ARM: coalescing window for cross-CPU virtual IRQs, 0 to disable */
+	__u32 irq_coalesce_us;
+	/*
+	 * ARM: longest exit latency of the platform idle states the cell may
+	 * enter via PSCI CPU_SUSPEND, 0 to only wait for interrupts
+	 */
+	__u32 idle_exit_latency_us;
 
 	struct jailhouse_console console;
 } __attribute__((packed));
@@ -131,12 +170,34 @@ struct jailhouse_cell_desc {
 #define JAILHOUSE_MEM_COLORED_NO_COPY	0x0400
 /* Set internally for remap_to/unmap_from root ops */
 #define JAILHOUSE_MEM_TMP_ROOT_REMAP	0x0800
+/* Non-root cell RAM mapped in 2 MiB blocks on first access, no DMA */
+#define JAILHOUSE_MEM_LAZY		0x1000
+/* Non-root cell RAM whose tail can be given back, see jailhouse/balloon.h */
+#define JAILHOUSE_MEM_RESIZABLE		0x2000
+/* Alignment and granularity of JAILHOUSE_MEM_RESIZABLE regions */
+#define JAILHOUSE_MEM_RESIZE_STEP	0x200000
+/*
+ * Sub-page I/O region whose surrounding pages may be read as a whole: they
+ * are mapped read-only, only writes trap and are checked against the region.
+ */
+#define JAILHOUSE_MEM_IO_PAGE_READ	0x4000
 #define JAILHOUSE_MEM_IO_UNALIGNED	0x8000
 #define JAILHOUSE_MEM_IO_WIDTH_SHIFT	16 /* uses bits 16..19 */
 #define JAILHOUSE_MEM_IO_8		(1 << JAILHOUSE_MEM_IO_WIDTH_SHIFT)
 #define JAILHOUSE_MEM_IO_16		(2 << JAILHOUSE_MEM_IO_WIDTH_SHIFT)
 #define JAILHOUSE_MEM_IO_32		(4 << JAILHOUSE_MEM_IO_WIDTH_SHIFT)
 #define JAILHOUSE_MEM_IO_64		(8 << JAILHOUSE_MEM_IO_WIDTH_SHIFT)
+/*
+ * RAM mapped Normal non-cacheable at stage 2. Stage 2 can only lower the
+ * cacheability chosen by the guest, so this makes the region non-cacheable
+ * in every cell regardless of its own page tables. Without the flag, RAM is
+ * write-back at stage 2 and shared regions are only coherent if all cells
+ * map them Normal, inner-shareable, write-back at stage 1 as well (Linux
+ * memremap(MEMREMAP_WB), inmate map_range(MAP_CACHED)). Set on the R/W and
+ * output sections of an ivshmem device, the flag is advertised to the guests
+ * and must then be used by all peers alike.
+ */
+#define JAILHOUSE_MEM_NONCACHED		0x00100000
 
 struct jailhouse_memory {
 	__u64 phys_start;
@@ -152,6 +213,9 @@ struct jailhouse_coloring {
 	__u64 way_size;
 	/* Temp offset in the root cell to simplify loading of colored cells */
 	__u64 root_map_offset;
+	/* Preferred colors of the hypervisor memory pool, 0 for any. Cells
+	 * should not be assigned these colors. */
+	__u64 hv_colors;
 } __attribute__((packed));
 
 #define JAILHOUSE_SHMEM_NET_REGIONS(start, dev_id)			\
@@ -177,6 +241,35 @@ struct jailhouse_coloring {
 			((dev_id == 1) ? JAILHOUSE_MEM_WRITE : 0),	\
 	}
 
+/*
+ * ivshmem-net layout for large buffers: the output sections start at the
+ * 2 MiB aligned start and take size bytes each, a multiple of 2 MiB, so that
+ * stage 2 and the memremap of the Linux driver map them with blocks. The
+ * state table takes the page below start.
+ */
+#define JAILHOUSE_SHMEM_NET_REGIONS_2M(start, dev_id, size)		\
+	{								\
+		.phys_start = (start) - 0x1000,				\
+		.virt_start = (start) - 0x1000,				\
+		.size = 0x1000,						\
+		.flags = JAILHOUSE_MEM_READ | JAILHOUSE_MEM_ROOTSHARED,	\
+	},								\
+	{ 0 },								\
+	{								\
+		.phys_start = (start),					\
+		.virt_start = (start),					\
+		.size = (size),						\
+		.flags = JAILHOUSE_MEM_READ | JAILHOUSE_MEM_ROOTSHARED | \
+			((dev_id == 0) ? JAILHOUSE_MEM_WRITE : 0),	\
+	},								\
+	{								\
+		.phys_start = (start) + (size),				\
+		.virt_start = (start) + (size),				\
+		.size = (size),						\
+		.flags = JAILHOUSE_MEM_READ | JAILHOUSE_MEM_ROOTSHARED | \
+			((dev_id == 1) ? JAILHOUSE_MEM_WRITE : 0),	\
+	}
+
 #define JAILHOUSE_MEMORY_IS_SUBPAGE(mem)	\
 	((mem)->virt_start & PAGE_OFFS_MASK || (mem)->size & PAGE_OFFS_MASK)
 
@@ -208,6 +301,8 @@ struct jailhouse_irqchip {
 
 #define JAILHOUSE_SHMEM_PROTO_UNDEFINED		0x0000
 #define JAILHOUSE_SHMEM_PROTO_VETH		0x0001
+#define JAILHOUSE_SHMEM_PROTO_BALLOON		0x0002
+#define JAILHOUSE_SHMEM_PROTO_LATENCY		0x0003
 #define JAILHOUSE_SHMEM_PROTO_CUSTOM		0x4000	/* 0x4000..0x7fff */
 #define JAILHOUSE_SHMEM_PROTO_VIRTIO_FRONT	0x8000	/* 0x8000..0xbfff */
 #define JAILHOUSE_SHMEM_PROTO_VIRTIO_BACK	0xc000	/* 0xc000..0xffff */
@@ -304,6 +399,24 @@ struct jailhouse_iommu {
 			__u64 tlb_base;
 			__u32 tlb_size;
 		} __attribute__((packed)) tipvu;
+
+		struct {
+			/*
+			 * Number of identical instances, size bytes each and
+			 * back to back from base, that are programmed as one,
+			 * like the interleaved MMU-500s of Tegra234. 0 for a
+			 * single instance.
+			 */
+			__u32 instances;
+		} __attribute__((packed)) mmu500;
+
+		struct {
+			/*
+			 * Wired event queue interrupt, 0 if unused. Taken
+			 * by the hypervisor, must not be assigned to a cell.
+			 */
+			__u32 evtq_irq;
+		} __attribute__((packed)) smmuv3;
 	};
 } __attribute__((packed));
 
@@ -346,6 +459,11 @@ struct jailhouse_pio {
  */
 #define JAILHOUSE_MAX_PMU2CPU_IRQ	12
 
+/**
+ * Memguard maximum number of DSU clusters (one PMU interrupt each).
+ */
+#define JAILHOUSE_MAX_DSU_CLUSTERS	4
+
 /**
  * Memguard platform support.
  * Currently only for ARMv8 and GICv2.
@@ -370,11 +488,72 @@ struct jailhouse_memguard_config {
 	__u32 num_pmu_irq;
 	/** PMU 2 CPU interrupt mapping */
 	__u32 pmu_cpu_irq[JAILHOUSE_MAX_PMU2CPU_IRQ];
+	/** Number of DSU clusters with an overflow interrupt.
+	 *  Zero disables cluster-wide regulation.
+	 */
+	__u32 num_dsu_irq;
+	/** DSU PMU (nCLUSTERPMUIRQ) interrupt of each cluster, SPIs */
+	__u32 dsu_cluster_irq[JAILHOUSE_MAX_DSU_CLUSTERS];
 } __attribute__((packed));
 
+#define JAILHOUSE_QOS_NIC400		0
+#define JAILHOUSE_QOS_TEGRA234_MC	1
+
 struct jailhouse_qos {
+	/** Register block of the QoS backend: NIC-400 GPV or Tegra MC */
 	__u64 nic_base;
 	__u64 nic_size;
+	/** Backend, see JAILHOUSE_QOS_*. */
+	__u32 type;
+} __attribute__((packed));
+
+/**
+ * Maximum number of platform idle states.
+ */
+#define JAILHOUSE_MAX_IDLE_STATES	4
+
+/** The CPU loses its context, CPU_SUSPEND resumes at the entry point. */
+#define JAILHOUSE_IDLE_POWERDOWN	0x0001
+
+/**
+ * ARM: idle state of the firmware, as listed by the idle-states node of the
+ * device tree. States are ordered from the shallowest to the deepest.
+ */
+struct jailhouse_idle_state {
+	/** power_state parameter of PSCI CPU_SUSPEND */
+	__u32 power_state;
+	/** JAILHOUSE_IDLE_* */
+	__u32 flags;
+	/** Worst-case delay from the wake-up event to the resumed caller */
+	__u32 exit_latency_us;
+	/** Minimum time in the state for it to pay off */
+	__u32 target_residency_us;
+} __attribute__((packed));
+
+/**
+ * Maximum number of root-cell IRQ placement rules.
+ */
+#define JAILHOUSE_MAX_IRQ_POLICIES	8
+#define JAILHOUSE_IRQ_POLICY_NAMELEN	23
+
+/** Match the INTx lines of the virtual PCI devices of the root cell. */
+#define JAILHOUSE_IRQ_POLICY_VPCI	0x0001
+
+/**
+ * Placement of Linux interrupts of the root cell, applied by the driver on
+ * enable and after each cell creation. A rule matches every IRQ with a
+ * handler whose name starts with name, e.g. "eth0." for the nvethernet
+ * channels or "nvgpu" for the GPU stall and nonstall lines. NAPI polling
+ * follows the IRQ to its CPU.
+ */
+struct jailhouse_irq_policy {
+	char name[JAILHOUSE_IRQ_POLICY_NAMELEN + 1];
+	/** JAILHOUSE_IRQ_POLICY_* */
+	__u32 flags;
+	/** SCHED_FIFO priority of threaded handlers, 0 to keep theirs */
+	__u32 rt_priority;
+	/** Root-cell CPUs the IRQs are steered to, 0 to keep the affinity */
+	__u64 cpus;
 } __attribute__((packed));
 
 struct jailhouse_qos_device {
@@ -396,6 +575,16 @@ struct jailhouse_system {
 
 	/** Jailhouse's location in memory */
 	struct jailhouse_memory hypervisor_memory;
+	/**
+	 * Reserve the page pool of the hypervisor grows into on demand, size
+	 * 0 for none. Located above hypervisor_memory, outside of all cells.
+	 */
+	struct jailhouse_memory hypervisor_pool;
+	/**
+	 * Pool of the segments cells share at runtime, see
+	 * JAILHOUSE_HC_SHMEM_SEGMENT, size 0 for none. Outside of all cells.
+	 */
+	struct jailhouse_memory shmem_pool;
 	struct jailhouse_console debug_console;
 	struct {
 		__u64 pci_mmconfig_base;
@@ -408,6 +597,12 @@ struct jailhouse_system {
 		struct jailhouse_coloring color;
 		struct jailhouse_memguard_config memguard;
 		struct jailhouse_qos qos;
+		__u32 num_idle_states;
+		struct jailhouse_idle_state
+			idle_states[JAILHOUSE_MAX_IDLE_STATES];
+		__u32 num_irq_policies;
+		struct jailhouse_irq_policy
+			irq_policies[JAILHOUSE_MAX_IRQ_POLICIES];
 		union {
 			struct {
 				__u16 pm_timer_address;
@@ -418,14 +613,14 @@ struct jailhouse_system {
 				__u32 apic_khz;
 			} __attribute__((packed)) x86;
 			struct {
-				u8 maintenance_irq;
-				u8 gic_version;
-				u8 padding[2];
-				u64 gicd_base;
-				u64 gicc_base;
-				u64 gich_base;
-				u64 gicv_base;
-				u64 gicr_base;
+				__u8 maintenance_irq;
+				__u8 gic_version;
+				__u8 padding[2];
+				__u64 gicd_base;
+				__u64 gicc_base;
+				__u64 gich_base;
+				__u64 gicv_base;
+				__u64 gicr_base;
 			} __attribute__((packed)) arm;
 		} __attribute__((packed));
 	} __attribute__((packed)) platform_info;
@@ -86,7 +86,16 @@
 
 #define CON_HAS_MDR_QUIRK(flags)	!!((flags) & JAILHOUSE_CON_MDR_QUIRK)
 
-/* Bits 14-15: Reserved */
+/*
+ * Bit 14 lets the hypervisor drain its virtual console to the UART from a
+ * root cell CPU in the background rather than writing each message out
+ * synchronously. Only effective with JAILHOUSE_SYS_VIRTUAL_DEBUG_CONSOLE.
+ */
+#define JAILHOUSE_CON_DRAIN		0x4000
+
+#define CON_HAS_DRAIN(flags)		!!((flags) & JAILHOUSE_CON_DRAIN)
+
+/* Bit 15: Reserved */
 
 struct jailhouse_console {
 	__u64 address;
@@ -0,0 +1,63 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_CPU_STATS_H
+#define _JAILHOUSE_CPU_STATS_H
+
+/** Number of CPUs in the shared statistics page, see PERF_CPUS */
+#define JAILHOUSE_CPU_STATS_CPUS	12
+/** Capacity of a per-CPU block, JAILHOUSE_NUM_CPU_STATS must fit */
+#define JAILHOUSE_CPU_STATS_MAX		30
+
+/**
+ * Copy of the JAILHOUSE_CPU_STAT_* counters of one CPU, updated by the
+ * hypervisor at the end of each exit and mapped read-only to the root cell.
+ * \a seq is odd while the copy is in progress: readers sample it before and
+ * after reading the counters and retry if it was odd or changed. Unlike
+ * JAILHOUSE_CPU_INFO_STAT_BASE, the counters are 32 bits wide. A block with
+ * \a num_stats 0 has not been published yet.
+ */
+struct jailhouse_cpu_stats {
+	unsigned int seq;
+	/** Valid entries of \a stats, JAILHOUSE_NUM_CPU_STATS */
+	unsigned int num_stats;
+	unsigned int stats[JAILHOUSE_CPU_STATS_MAX];
+};
+
+/** Number of DSU clusters in the shared page, see JAILHOUSE_MAX_DSU_CLUSTERS */
+#define JAILHOUSE_DSU_STATS_CLUSTERS	4
+/** DSU counters kept by the hypervisor, the topmost ones of each cluster */
+#define JAILHOUSE_DSU_HYP_COUNTERS	1
+
+/**
+ * Partition of the DSU PMU counters of one cluster. The DSU has no
+ * equivalent of MDCR_EL2.HPMN: the root cell must only program the counters
+ * below \a first_hyp_cnt and reads the hypervisor ones through \a count.
+ * The counts are accumulated at each memguard period boundary of the
+ * cluster, and while the counter is reconfigured. Same \a seq protocol as
+ * struct jailhouse_cpu_stats, \a num_cnt is 0 without DSU regulation.
+ */
+struct jailhouse_dsu_stats {
+	unsigned int seq;
+	/** Counters of the cluster, CLUSTERPMCR_EL1.N */
+	unsigned int num_cnt;
+	unsigned int first_hyp_cnt;
+	/** DSU event of each hypervisor counter, 0 while it is stopped */
+	unsigned int event_type[JAILHOUSE_DSU_HYP_COUNTERS];
+	/** Events counted so far, never reset */
+	unsigned long long count[JAILHOUSE_DSU_HYP_COUNTERS];
+};
+
+/** Layout of the shared statistics page */
+struct jailhouse_stats_page {
+	struct jailhouse_cpu_stats cpu[JAILHOUSE_CPU_STATS_CPUS];
+	struct jailhouse_dsu_stats dsu[JAILHOUSE_DSU_STATS_CLUSTERS];
+};
+
+#endif /* !_JAILHOUSE_CPU_STATS_H */
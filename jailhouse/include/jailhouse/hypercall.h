@@ -52,6 +52,28 @@
 #define JAILHOUSE_HC_DEBUG_CONSOLE_PUTC		8
 #define JAILHOUSE_HC_MEMGUARD_SET		9
 #define JAILHOUSE_HC_QOS			10
+#define JAILHOUSE_HC_MEMGUARD_CELL_SET		11
+#define JAILHOUSE_HC_MEMGUARD_BATCH_SET		12
+#define JAILHOUSE_HC_CELL_RECOLOR		13
+#define JAILHOUSE_HC_CELL_GET_MMIO_STATS	14
+#define JAILHOUSE_HC_IOMMU_GET_FAULTS		15
+#define JAILHOUSE_HC_CELL_SNAPSHOT		16
+#define JAILHOUSE_HC_CELL_RESTORE		17
+#define JAILHOUSE_HC_CELL_CPU_MOVE		18
+#define JAILHOUSE_HC_CELL_MEM_RESIZE		19
+#define JAILHOUSE_HC_QOS_PROFILE_SET		20
+#define JAILHOUSE_HC_QOS_PROFILE_APPLY		21
+#define JAILHOUSE_HC_MODE_SWITCH		22
+#define JAILHOUSE_HC_PERF_SET			23
+#define JAILHOUSE_HC_CONSOLE_FLUSH		24
+#define JAILHOUSE_HC_TRACE_SET			25
+#define JAILHOUSE_HC_PT_CACHE			26
+#define JAILHOUSE_HC_DEBUG_CONSOLE_PUTS		27
+#define JAILHOUSE_HC_CPU_SCHEDULE		28
+#define JAILHOUSE_HC_SHMEM_SEGMENT		29
+
+/** Longest buffer accepted by JAILHOUSE_HC_DEBUG_CONSOLE_PUTS */
+#define JAILHOUSE_CONSOLE_PUTS_MAX		1024
 
 /* Hypervisor information type */
 #define JAILHOUSE_INFO_MEM_POOL_SIZE		0
@@ -59,6 +81,11 @@
 #define JAILHOUSE_INFO_REMAP_POOL_SIZE		2
 #define JAILHOUSE_INFO_REMAP_POOL_USED		3
 #define JAILHOUSE_INFO_NUM_CELLS		4
+#define JAILHOUSE_INFO_LLC_SIZE			5
+#define JAILHOUSE_INFO_LLC_WAY_SIZE		6
+#define JAILHOUSE_INFO_COLOR_WAY_SIZE		7
+#define JAILHOUSE_INFO_MEM_POOL_PEAK		8
+#define JAILHOUSE_INFO_MEM_POOL_RESERVE		9
 
 /* Hypervisor information type */
 #define JAILHOUSE_CPU_INFO_STATE		0
@@ -75,6 +102,136 @@
 #define JAILHOUSE_CPU_STAT_VMEXITS_HYPERCALL	3
 #define JAILHOUSE_GENERIC_CPU_STATS		4
 
+/** Exit statistics of one MMIO region, see JAILHOUSE_HC_CELL_GET_MMIO_STATS */
+struct jailhouse_mmio_stat {
+	/** Region start in the cell address space. */
+	__u64 start;
+	/** Region size. */
+	__u64 size;
+	/** Number of handled accesses. */
+	__u64 count;
+	/** Time spent in the region handler, in timestamp ticks. */
+	__u64 ticks;
+};
+
+/** Buffer of JAILHOUSE_HC_CELL_GET_MMIO_STATS, in root cell memory */
+struct jailhouse_mmio_stats {
+	/** Capacity of the entries array, set by the caller. */
+	__u32 max_entries;
+	/** Number of registered regions, set by the hypervisor. */
+	__u32 num_entries;
+	struct jailhouse_mmio_stat entries[];
+};
+
+/** Fault counters of one stream, see JAILHOUSE_HC_IOMMU_GET_FAULTS */
+struct jailhouse_iommu_fault {
+	/** Index of the IOMMU in the platform configuration. */
+	__u32 unit;
+	/** Stream ID of the faulting master. */
+	__u32 sid;
+	/** Number of reported fault events. */
+	__u64 count;
+	/** Type of the last event. */
+	__u32 last_event;
+	__u32 padding;
+	/** Input address of the last event. */
+	__u64 last_addr;
+};
+
+/** Buffer of JAILHOUSE_HC_IOMMU_GET_FAULTS, in root cell memory */
+struct jailhouse_iommu_faults {
+	/** Capacity of the entries array, set by the caller. */
+	__u32 max_entries;
+	/** Number of faulting streams, set by the hypervisor. */
+	__u32 num_entries;
+	/** Events of streams beyond the capacity of the hypervisor. */
+	__u64 untracked;
+	/** Event queue overflows, each losing an unknown number of events. */
+	__u64 overflows;
+	struct jailhouse_iommu_fault entries[];
+};
+
+/**
+ * Buffer of JAILHOUSE_HC_CELL_SNAPSHOT and JAILHOUSE_HC_CELL_RESTORE, in root
+ * cell memory. The content of data is architecture-specific and opaque to
+ * the caller: the cell-wide interrupt state, followed by the state of each
+ * vCPU in the order of the cell's CPU set.
+ */
+struct jailhouse_cell_snapshot {
+	/** Size of the buffer including this header, set by the caller. */
+	__u32 size;
+	/** Number of saved vCPUs. */
+	__u32 num_cpus;
+	/** Size of the interrupt state. */
+	__u32 irq_state_size;
+	/** Size of each vCPU state. */
+	__u32 cpu_state_size;
+	__u8 data[];
+};
+
+/** Windows of a CPU schedule, see JAILHOUSE_HC_CPU_SCHEDULE */
+#define JAILHOUSE_SCHED_MAX_SLOTS		16
+/** Shortest window, bounding the switch overhead to a few percent */
+#define JAILHOUSE_SCHED_MIN_SLOT_US		1000
+/** Window of each cell until the root cell sets a schedule */
+#define JAILHOUSE_SCHED_DEFAULT_SLOT_US		10000
+
+/** One window of a CPU schedule */
+struct jailhouse_sched_slot {
+	/** Cell running in the window, one of the two sharing the CPU. */
+	__u32 cell_id;
+	/** Length of the window in microseconds. */
+	__u32 duration_us;
+};
+
+/**
+ * Cyclic schedule of a time-shared CPU, argument of JAILHOUSE_HC_CPU_SCHEDULE
+ * in root cell memory. The windows repeat in order, their sum is the major
+ * frame.
+ */
+struct jailhouse_cpu_schedule {
+	__u32 num_slots;
+	__u32 padding;
+	struct jailhouse_sched_slot slots[JAILHOUSE_SCHED_MAX_SLOTS];
+};
+
+/* Operations of JAILHOUSE_HC_SHMEM_SEGMENT */
+#define JAILHOUSE_SHMEM_GET			0
+#define JAILHOUSE_SHMEM_PUT			1
+
+#define JAILHOUSE_SHMEM_NAME_MAXLEN		15
+/** Segments the hypervisor manages at the same time */
+#define JAILHOUSE_SHMEM_MAX_SEGMENTS		16
+
+/**
+ * Named segment of the shared-memory pool, argument of
+ * JAILHOUSE_HC_SHMEM_SEGMENT in the memory of the calling cell.
+ *
+ * JAILHOUSE_SHMEM_GET allocates the segment for the caller and the peer cell,
+ * or maps an existing one if the caller is one of its two cells. The segment
+ * is zeroed on allocation and mapped into the stage 2 of the caller, the
+ * other cell is signaled through the ivshmem devices both share and maps it
+ * with its own JAILHOUSE_SHMEM_GET. JAILHOUSE_SHMEM_PUT unmaps the segment
+ * from the caller, it is released when neither cell maps it anymore.
+ */
+struct jailhouse_shmem_segment {
+	char name[JAILHOUSE_SHMEM_NAME_MAXLEN + 1];
+	/** Other cell of a new segment, ignored for existing ones. */
+	__u32 peer_id;
+	/** JAILHOUSE_MEM_READ, optionally JAILHOUSE_MEM_WRITE. */
+	__u32 flags;
+	/** Size of a new segment, 0 to only map an existing one. Returns the
+	 * size of the segment. */
+	__u64 size;
+	/** Guest address of the mapping, 0 for the physical address. Returns
+	 * the address used. */
+	__u64 virt_start;
+	/** Cache colors of a new segment, 0 for contiguous memory. */
+	__u64 colors;
+	/** Returns the physical start of the segment. */
+	__u64 phys_start;
+};
+
 #define JAILHOUSE_MSG_NONE			0
 
 /* messages to cell */
@@ -0,0 +1,48 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_IRQ_LATENCY_H
+#define _JAILHOUSE_IRQ_LATENCY_H
+
+/** Number of CPUs with latency histograms, see MEMGUARD_TELEMETRY_CPUS */
+#define IRQ_LATENCY_CPUS	12
+/** Number of interrupts with their own histograms, first come first served */
+#define IRQ_LATENCY_IRQS	32
+/**
+ * Bucket n counts latencies of [2^n, 2^(n+1)) counter ticks, the last bucket
+ * all longer ones.
+ */
+#define IRQ_LATENCY_BUCKETS	24
+
+/** From the physical arrival to the write of the list register */
+#define IRQ_LATENCY_INJECT	0
+/** From the write of the list register to its retirement by the guest */
+#define IRQ_LATENCY_EOI		1
+#define IRQ_LATENCY_STAGES	2
+
+struct irq_latency_hist {
+	unsigned int buckets[IRQ_LATENCY_BUCKETS];
+};
+
+/**
+ * Interrupt latency histograms. Written by the hypervisor only, mapped
+ * read-only to the root cell. Buckets are plain counters, readers may see
+ * a histogram while it is being updated.
+ */
+struct irq_latency {
+	/** Counter frequency in Hz, set once the hypervisor is initialized */
+	volatile unsigned int freq;
+	unsigned int padding[7];
+	/** Interrupt of each per-IRQ histogram, 0 while unassigned */
+	unsigned int irqs[IRQ_LATENCY_IRQS];
+	struct irq_latency_hist cpu[IRQ_LATENCY_CPUS][IRQ_LATENCY_STAGES];
+	struct irq_latency_hist irq[IRQ_LATENCY_IRQS][IRQ_LATENCY_STAGES];
+};
+
+#endif /* _JAILHOUSE_IRQ_LATENCY_H */
@@ -0,0 +1,254 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Lock-free ring of fixed-size slots over ivshmem, for a single consumer and
+ * either a single or multiple producers in the same cell.
+ *
+ * ivshmem peers may only write their own output section. The ring is
+ * therefore split: the producer part (indexes and slots) lives in the output
+ * section of the producing peer, the consumer part (read index) in that of
+ * the consuming peer. Each part starts on its own cache line, so producers
+ * and consumer never write to the same line.
+ *
+ * Indexes are free-running 32-bit counters, the number of entries must be a
+ * power of two. The header only relies on GCC atomic builtins and can be used
+ * from inmates, the Linux kernel and user space (e.g. via uio_ivshmem).
+ */
+
+#ifndef _JAILHOUSE_IVSHMEM_RING_H
+#define _JAILHOUSE_IVSHMEM_RING_H
+
+#define IVSHMEM_RING_CACHELINE		64
+
+#define IVSHMEM_RING_LOAD_ACQUIRE(p)	__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define IVSHMEM_RING_STORE_RELEASE(p, v) \
+	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+/** Producer part, at the start of the producer's memory, followed by slots */
+struct ivshmem_ring_prod {
+	/** Next index to reserve, only differs from tail with MP producers */
+	__u32 head;
+	/** Next index to be published to the consumer */
+	__u32 tail;
+	__u32 padding[IVSHMEM_RING_CACHELINE / 4 - 2];
+} __attribute__((aligned(IVSHMEM_RING_CACHELINE)));
+
+/** Consumer part, in the consumer's memory */
+struct ivshmem_ring_cons {
+	/** Next index to consume */
+	__u32 tail;
+	__u32 padding[IVSHMEM_RING_CACHELINE / 4 - 1];
+} __attribute__((aligned(IVSHMEM_RING_CACHELINE)));
+
+/** Local handle of one side, not shared */
+struct ivshmem_ring {
+	struct ivshmem_ring_prod *prod;
+	struct ivshmem_ring_cons *cons;
+	unsigned char *slots;
+	__u32 mask;
+	__u32 entry_size;
+	/** Last seen index of the other side, avoids touching its line */
+	__u32 cached;
+};
+
+/**
+ * Size of the producer part for the given geometry, including the slots.
+ * The consumer part is always sizeof(struct ivshmem_ring_cons).
+ */
+static inline unsigned long ivshmem_ring_prod_size(__u32 entries,
+						   __u32 entry_size)
+{
+	return sizeof(struct ivshmem_ring_prod) +
+		(unsigned long)entries * entry_size;
+}
+
+/**
+ * Set up the local handle. Both sides must pass the same geometry. The side
+ * owning a part has to clear it first, see ivshmem_ring_reset_prod() and
+ * ivshmem_ring_reset_cons().
+ */
+static inline void ivshmem_ring_init(struct ivshmem_ring *ring,
+				     void *prod_mem, void *cons_mem,
+				     __u32 entries, __u32 entry_size)
+{
+	ring->prod = (struct ivshmem_ring_prod *)prod_mem;
+	ring->cons = (struct ivshmem_ring_cons *)cons_mem;
+	ring->slots = (unsigned char *)prod_mem +
+		sizeof(struct ivshmem_ring_prod);
+	ring->mask = entries - 1;
+	ring->entry_size = entry_size;
+	ring->cached = 0;
+}
+
+static inline void ivshmem_ring_reset_prod(struct ivshmem_ring *ring)
+{
+	ring->prod->head = 0;
+	IVSHMEM_RING_STORE_RELEASE(&ring->prod->tail, 0);
+}
+
+static inline void ivshmem_ring_reset_cons(struct ivshmem_ring *ring)
+{
+	IVSHMEM_RING_STORE_RELEASE(&ring->cons->tail, 0);
+}
+
+static inline void ivshmem_ring_copy_in(struct ivshmem_ring *ring, __u32 idx,
+					const void *objs, __u32 n)
+{
+	__u32 pos = idx & ring->mask;
+	__u32 first = ring->mask + 1 - pos;
+
+	if (first > n)
+		first = n;
+	__builtin_memcpy(ring->slots + pos * ring->entry_size, objs,
+			 first * ring->entry_size);
+	__builtin_memcpy(ring->slots,
+			 (const unsigned char *)objs + first * ring->entry_size,
+			 (n - first) * ring->entry_size);
+}
+
+static inline void ivshmem_ring_copy_out(struct ivshmem_ring *ring, __u32 idx,
+					 void *objs, __u32 n)
+{
+	__u32 pos = idx & ring->mask;
+	__u32 first = ring->mask + 1 - pos;
+
+	if (first > n)
+		first = n;
+	__builtin_memcpy(objs, ring->slots + pos * ring->entry_size,
+			 first * ring->entry_size);
+	__builtin_memcpy((unsigned char *)objs + first * ring->entry_size,
+			 ring->slots, (n - first) * ring->entry_size);
+}
+
+/**
+ * Enqueue up to n entries, single producer.
+ *
+ * @return Number of entries enqueued.
+ */
+static inline __u32 ivshmem_ring_produce(struct ivshmem_ring *ring,
+					 const void *objs, __u32 n)
+{
+	__u32 head = ring->prod->tail;
+	__u32 space = ring->mask + 1 - (head - ring->cached);
+
+	if (space < n) {
+		ring->cached = IVSHMEM_RING_LOAD_ACQUIRE(&ring->cons->tail);
+		space = ring->mask + 1 - (head - ring->cached);
+		if (space < n)
+			n = space;
+	}
+	if (n == 0)
+		return 0;
+
+	ivshmem_ring_copy_in(ring, head, objs, n);
+
+	ring->prod->head = head + n;
+	IVSHMEM_RING_STORE_RELEASE(&ring->prod->tail, head + n);
+
+	return n;
+}
+
+/**
+ * Enqueue up to n entries, safe against concurrent producers of the same
+ * cell. Entries become visible in reservation order, so a producer may have
+ * to wait for an earlier one to finish its copy.
+ *
+ * @return Number of entries enqueued.
+ */
+static inline __u32 ivshmem_ring_produce_mp(struct ivshmem_ring *ring,
+					    const void *objs, __u32 n)
+{
+	__u32 head, space, cons_tail;
+
+	head = __atomic_load_n(&ring->prod->head, __ATOMIC_RELAXED);
+	do {
+		/* the cache is shared by the producers, so do not use it */
+		cons_tail = IVSHMEM_RING_LOAD_ACQUIRE(&ring->cons->tail);
+		space = ring->mask + 1 - (head - cons_tail);
+		if (space < n)
+			n = space;
+		if (n == 0)
+			return 0;
+	} while (!__atomic_compare_exchange_n(&ring->prod->head, &head,
+					      head + n, 1,
+					      __ATOMIC_RELAXED,
+					      __ATOMIC_RELAXED));
+
+	ivshmem_ring_copy_in(ring, head, objs, n);
+
+	while (__atomic_load_n(&ring->prod->tail, __ATOMIC_RELAXED) != head)
+		;
+	IVSHMEM_RING_STORE_RELEASE(&ring->prod->tail, head + n);
+
+	return n;
+}
+
+/**
+ * Dequeue up to n entries, single consumer.
+ *
+ * @return Number of entries dequeued.
+ */
+static inline __u32 ivshmem_ring_consume(struct ivshmem_ring *ring,
+					 void *objs, __u32 n)
+{
+	__u32 tail = ring->cons->tail;
+	__u32 avail = ring->cached - tail;
+
+	if (avail < n) {
+		ring->cached = IVSHMEM_RING_LOAD_ACQUIRE(&ring->prod->tail);
+		avail = ring->cached - tail;
+		if (avail < n)
+			n = avail;
+	}
+	if (n == 0)
+		return 0;
+
+	ivshmem_ring_copy_out(ring, tail, objs, n);
+
+	/* slots must be read before the producer may reuse them */
+	IVSHMEM_RING_STORE_RELEASE(&ring->cons->tail, tail + n);
+
+	return n;
+}
+
+/** Number of entries ready for the consumer. */
+static inline __u32 ivshmem_ring_count(struct ivshmem_ring *ring)
+{
+	return IVSHMEM_RING_LOAD_ACQUIRE(&ring->prod->tail) -
+		IVSHMEM_RING_LOAD_ACQUIRE(&ring->cons->tail);
+}
+
+#endif /* !_JAILHOUSE_IVSHMEM_RING_H */
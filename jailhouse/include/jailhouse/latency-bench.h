@@ -0,0 +1,60 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+/*
+ * Results of the latency-bench inmate over an ivshmem device
+ * (JAILHOUSE_SHMEM_PROTO_LATENCY). The root cell is peer 0 and publishes a
+ * struct latency_bench_control at the start of its output section, each
+ * benchmark cell a struct latency_bench_results at the start of its own.
+ *
+ * Results are updated with every sample: seq is odd while an update is in
+ * progress, readers retry until they read the same even seq before and after
+ * copying the results. Incrementing the reset counter of the control block
+ * clears the results of all peers, each peer echoes the counter once it did.
+ */
+
+#ifndef _JAILHOUSE_LATENCY_BENCH_H
+#define _JAILHOUSE_LATENCY_BENCH_H
+
+#define LATENCY_BENCH_REVISION		1
+
+/**
+ * Bucket n counts wakeup latencies of [2^n, 2^(n+1)) ns, bucket 0 also the
+ * ones below 1 ns, the last bucket all longer ones.
+ */
+#define LATENCY_BENCH_BUCKETS		32
+
+struct latency_bench_control {
+	/** LATENCY_BENCH_REVISION */
+	__u32 revision;
+	/** Incremented by the root cell to clear the results */
+	__u32 reset;
+};
+
+struct latency_bench_results {
+	/** LATENCY_BENCH_REVISION, 0 while the peer is not running */
+	__u32 revision;
+	/** Odd while the results are updated */
+	__u32 seq;
+	/** Last reset counter of the control block handled */
+	__u32 reset;
+	/** Timer period in us */
+	__u32 period_us;
+	/** MPIDR_EL1 of the measuring CPU */
+	__u64 mpidr;
+	__u64 samples;
+	/** Periods skipped since the interrupt came after the next deadline */
+	__u64 missed;
+	__u64 min_ns;
+	__u64 max_ns;
+	__u64 sum_ns;
+	__u64 buckets[LATENCY_BENCH_BUCKETS];
+};
+
+#endif /* !_JAILHOUSE_LATENCY_BENCH_H */
@@ -24,6 +24,9 @@
  * via CONFIG-based definitions. The CONFIG is specified in
  * `include/jailhouse/config.h`. Update this to autogenerate the
  * config file and the per-board addresses.
+ * Only the cell configs need them: membomb and utilstress take the base of
+ * the control pages with -a, and jailhouse-membench reads the control page
+ * of each bomb from its cell config.
  *
  * FIXME: The same CONFIG also controls settings for SDEI, SMCC, QoS.
  */
@@ -16,6 +16,45 @@
  * the COPYING file in the top-level directory.
  */
 
+#ifndef _JAILHOUSE_MEMGUARD_COMMON_H
+#define _JAILHOUSE_MEMGUARD_COMMON_H
+
+/** Throttled CPUs wait in WFI instead of busy-polling the timer */
+#define MEMGUARD_FLAG_PARK	0x1
+/** Donate unused budget to, and borrow from, the cell reclaim pool */
+#define MEMGUARD_FLAG_RECLAIM	0x2
+/** Budgets are shared by all the CPUs of a cell (set by the hypervisor) */
+#define MEMGUARD_FLAG_CELL	0x4
+/** Budgets follow the observed utilization within the event bounds */
+#define MEMGUARD_FLAG_ADAPTIVE	0x8
+/** Periods start at the multiples of the period on the system counter */
+#define MEMGUARD_FLAG_SYNC	0x10
+
+/** Also count the event while the hypervisor (EL2) runs on the CPU */
+#define MEMGUARD_EVENT_EL2	0x1
+
+/** Maximum number of PMU events (and counters) regulated at once */
+#define MEMGUARD_MAX_EVENTS	3
+
+/** Single (event, budget) pair regulated by its own PMU counter */
+struct memguard_event {
+	/** ARMv8 PMUv3 event type */
+	unsigned int event_type;
+	/** Number of events allowed per regulation period. Adaptive mode:
+	 *  initial budget and target share of the CPU.
+	 */
+	unsigned int budget_memory;
+	/** Adaptive mode: lower bound of the budget (0: no bound) */
+	unsigned int budget_min;
+	/** Adaptive mode: upper bound of the budget (0: \a budget_memory) */
+	unsigned int budget_max;
+	/** Exception level filtering: see MEMGUARD_EVENT_*. By default the
+	 *  hypervisor's own activity (IRQ handling, MMIO emulation, ...) is
+	 *  not charged to the budget.
+	 */
+	unsigned int filter;
+};
+
 /** Memguard parameters.
  * Used from hypervisor, linux driver and userspace.
  * Do not use implicit includes for u64, u32.
@@ -27,6 +66,89 @@ struct memguard_params {
 	unsigned int budget_memory;
 	/** ARMv8 PMUv3 event type to be used for memory budget */
 	unsigned int event_type;
-	/** Flags: ignored and currently always set to periodic enforcing */
+	/** Flags: see MEMGUARD_FLAG_*. Enforcing is always periodic. */
 	unsigned int flags;
+	/** Number of valid entries in \a events. If zero, only
+	 *  \a budget_memory and \a event_type are used (single event).
+	 *  Otherwise \a budget_memory and \a event_type are ignored.
+	 */
+	unsigned int num_events;
+	/** Independent budgets: the CPU is throttled as soon as any of them
+	 *  is exhausted.
+	 */
+	struct memguard_event events[MEMGUARD_MAX_EVENTS];
+	/** DSU event counted for the whole cluster of the CPU */
+	unsigned int cluster_event_type;
+	/** Events allowed per period to the cluster as a whole, shared by
+	 *  all its CPUs. Zero disables cluster regulation if this CPU
+	 *  owned it. Implies synchronized periods.
+	 */
+	unsigned int cluster_budget;
+};
+
+/** Entry of a batched configuration, see JAILHOUSE_HC_MEMGUARD_BATCH_SET */
+struct memguard_cpu_params {
+	/** Target CPU ID */
+	unsigned int cpu;
+	unsigned int padding;
+	struct memguard_params params;
 };
+
+/** Number of cells one mode switch may recolor */
+#define MODE_SWITCH_MAX_CELLS		8
+/** qos_profile of a mode switch that leaves QoS alone */
+#define MODE_SWITCH_NO_QOS		0xffffffff
+
+/** New colors of a cell, see struct mode_switch_args */
+struct mode_switch_cell {
+	unsigned long long colors;
+	unsigned int cell_id;
+	unsigned int padding;
+};
+
+/**
+ * Bundle of JAILHOUSE_HC_MODE_SWITCH, followed by \a num_cpus
+ * struct memguard_cpu_params and then \a num_cells struct mode_switch_cell.
+ * Cells are recolored first. The memguard budgets of all CPUs and the QoS
+ * profile then change at the same boundary of \a period_us on the system
+ * counter, i.e. at the start of a common period of synchronized CPUs using
+ * a divisor of \a period_us.
+ */
+struct mode_switch_args {
+	unsigned long long period_us;
+	unsigned int num_cpus;
+	unsigned int num_cells;
+	/** Set with JAILHOUSE_HC_QOS_PROFILE_SET, or MODE_SWITCH_NO_QOS */
+	unsigned int qos_profile;
+	unsigned int padding;
+};
+
+/** Number of CPUs with a telemetry ring, see JAILHOUSE_MAX_PMU2CPU_IRQ */
+#define MEMGUARD_TELEMETRY_CPUS		12
+/** Number of regulation periods kept by each ring (power of two) */
+#define MEMGUARD_TELEMETRY_ENTRIES	64
+
+/** Record of one regulation period */
+struct memguard_telemetry_entry {
+	/** CNTPCT at the end of the period */
+	unsigned long long timestamp;
+	/** PMU events consumed, one for each regulated event */
+	unsigned int consumed[MEMGUARD_MAX_EVENTS];
+	/** Timer ticks spent blocked, non-zero if the CPU was throttled */
+	unsigned int blocked_ticks;
+};
+
+/**
+ * Per-CPU ring of regulation periods. Written by the hypervisor only,
+ * mapped read-only to the root cell.
+ * The entry of period n is stored in entries[n % MEMGUARD_TELEMETRY_ENTRIES]
+ * before \a head is incremented to n + 1. Readers sample \a head before and
+ * after copying the entries to detect overwritten records.
+ */
+struct memguard_telemetry {
+	volatile unsigned int head;
+	unsigned int padding[7];
+	struct memguard_telemetry_entry entries[MEMGUARD_TELEMETRY_ENTRIES];
+};
+
+#endif /* _JAILHOUSE_MEMGUARD_COMMON_H */
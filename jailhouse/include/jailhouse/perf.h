@@ -0,0 +1,63 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_PERF_H
+#define _JAILHOUSE_PERF_H
+
+/** Number of CPUs with a sample ring, see MEMGUARD_TELEMETRY_CPUS */
+#define PERF_CPUS		12
+/** Number of samples kept by each ring (power of two) */
+#define PERF_ENTRIES		512
+/** Smallest sample period, in events, against interrupt storms */
+#define PERF_MIN_PERIOD		1000
+
+/** The sampled code ran at EL0 */
+#define PERF_SAMPLE_USER	(1 << 0)
+/** The sampled code ran in AArch32 state */
+#define PERF_SAMPLE_AARCH32	(1 << 1)
+
+/** Guest state at one overflow of the sampling counter */
+struct perf_sample {
+	/** CNTPCT when the sample was taken */
+	unsigned long long timestamp;
+	/** Guest PC, i.e. ELR_EL2 */
+	unsigned long long pc;
+	unsigned int cell_id;
+	/** PERF_SAMPLE_* */
+	unsigned int flags;
+};
+
+/**
+ * Per-CPU ring of samples. Written by the hypervisor only, mapped read-only
+ * to the root cell.
+ * Sample n is stored in samples[n % PERF_ENTRIES] before \a head is
+ * incremented to n + 1. Readers sample \a head before and after copying the
+ * samples to detect overwritten records, like with struct
+ * memguard_telemetry.
+ */
+struct perf_ring {
+	volatile unsigned int head;
+	/** Event and period of the samples, period 0 while sampling is off */
+	volatile unsigned int event_type;
+	volatile unsigned int period;
+	unsigned int padding[5];
+	struct perf_sample samples[PERF_ENTRIES];
+};
+
+/** Argument of JAILHOUSE_HC_PERF_SET */
+struct perf_args {
+	/** Bitmap of the CPUs to configure */
+	unsigned long long cpus;
+	/** PMU event, 0 for CPU cycles */
+	unsigned int event_type;
+	/** Events per sample, 0 to stop sampling */
+	unsigned int period;
+};
+
+#endif /* _JAILHOUSE_PERF_H */
@@ -0,0 +1,48 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+/*
+ * Image of the stage-2 page tables of the root cell, exported by the
+ * hypervisor after it built them and handed back on the next enable with the
+ * same system configuration, see JAILHOUSE_HC_PT_CACHE.
+ *
+ * The image is a header page followed by num_tables table pages in
+ * depth-first order, the root table first. Next-level entries refer to their
+ * table by its index in the image instead of a physical address. The
+ * hypervisor relocates the tables in place and installs them only if the
+ * image was made by the same hypervisor build for the same configuration.
+ */
+
+#ifndef _JAILHOUSE_PT_CACHE_H
+#define _JAILHOUSE_PT_CACHE_H
+
+#define JAILHOUSE_PT_CACHE_SIGNATURE	"JHPTC"
+#define JAILHOUSE_PT_CACHE_REVISION	1
+
+/** Page size of the hypervisor, independent of the one of Linux */
+#define JAILHOUSE_PT_CACHE_PAGE_SIZE	0x1000
+
+/* operations of JAILHOUSE_HC_PT_CACHE */
+#define JAILHOUSE_PT_CACHE_EXPORT	0
+#define JAILHOUSE_PT_CACHE_RELEASE	1
+
+struct jailhouse_pt_cache {
+	char signature[5];
+	__u8 revision;
+	__u16 root_tables;
+	/** Table pages following the header page */
+	__u32 num_tables;
+	__u32 padding;
+	/** Hash of the hypervisor version and the system configuration */
+	__u64 config_hash;
+	/** Hash of the table pages */
+	__u64 tables_hash;
+} __attribute__((packed));
+
+#endif /* !_JAILHOUSE_PT_CACHE_H */
@@ -22,4 +22,16 @@ struct qos_setting {
 	__u32 value;
 };
 
+/* Number of profile slots, see JAILHOUSE_HC_QOS_PROFILE_SET */
+#define QOS_MAX_PROFILES		16
+#define QOS_PROFILE_MAX_SETTINGS	256
+
+/* Settings compiled by the hypervisor once and applied by ID later on.
+ * Zero settings release the profile. */
+struct qos_profile_args {
+	__u32 id;
+	__u32 num_settings;
+	struct qos_setting settings[];
+};
+
 #endif /* _JAILHOUSE_QOS_COMMON_H */
@@ -0,0 +1,71 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_TRACE_H
+#define _JAILHOUSE_TRACE_H
+
+/** Number of CPUs with a trace ring, see PERF_CPUS */
+#define TRACE_CPUS		12
+/** Number of records kept by each ring (power of two) */
+#define TRACE_ENTRIES		512
+
+/*
+ * Tracepoints, the bit of each one in the mask of JAILHOUSE_HC_TRACE_SET.
+ * Arguments of the records, do not renumber.
+ */
+/**
+ * MMIO access: arg0 size | TRACE_MMIO_WRITE | TRACE_MMIO_UNHANDLED, arg1
+ * address, arg2 value (not meaningful if unhandled)
+ */
+#define TRACE_MMIO		0
+/** Physical IRQ taken: arg0 IRQ number */
+#define TRACE_IRQ		1
+/** Memguard budget overflow: arg0 overflowed counters, arg1 1 if blocking */
+#define TRACE_MEMGUARD_PMU	2
+/** Memguard period timer: arg1 end of the new period */
+#define TRACE_MEMGUARD_TIMER	3
+/** Virtual IRQ injected: arg0 IRQ number, arg1 sender, arg2 list register */
+#define TRACE_VIRQ_INJECT	4
+/** CPUs of a cell suspended: arg0 cell ID */
+#define TRACE_CELL_SUSPEND	5
+/** CPUs of a cell resumed: arg0 cell ID */
+#define TRACE_CELL_RESUME	6
+/** SMMU command queued: arg0 opcode, arg1 and arg2 first command words */
+#define TRACE_SMMU_CMD		7
+#define TRACE_NUM_EVENTS	8
+
+#define TRACE_MMIO_WRITE	(1U << 31)
+/** No region is registered for the access */
+#define TRACE_MMIO_UNHANDLED	(1U << 30)
+
+/** One tracepoint hit */
+struct trace_record {
+	/** cpu_timestamp() when the tracepoint was hit */
+	unsigned long long timestamp;
+	/** TRACE_* */
+	unsigned short event;
+	/** Cell running on the CPU */
+	unsigned short cell_id;
+	unsigned int arg0;
+	unsigned long long arg1;
+	unsigned long long arg2;
+};
+
+/**
+ * Per-CPU ring of records. Written by the hypervisor only, mapped read-only
+ * to the root cell, ordered like struct perf_ring: record n is stored in
+ * records[n % TRACE_ENTRIES] before \a head is incremented to n + 1.
+ */
+struct trace_ring {
+	volatile unsigned int head;
+	unsigned int padding[7];
+	struct trace_record records[TRACE_ENTRIES];
+};
+
+#endif /* _JAILHOUSE_TRACE_H */
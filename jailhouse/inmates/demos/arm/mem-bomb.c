@@ -60,8 +60,29 @@ struct control {
 	u32 type;
 	u32 dram_col;
 	u32 dram_row;
+	/* Results, written by the bomb for the benchmark tools */
+	u32 seq;
+	u32 freq;
+	u64 passes;
+	u64 ticks;
+	u64 bandwidth;
 };
 
+/*
+ * Publish the progress of the access loop: passes over the buffer and the
+ * ticks they took in total. Readers retry while seq is odd or changed, like
+ * with a seqlock.
+ */
+static void publish(volatile struct control *ctrl, u64 passes, u64 ticks)
+{
+	ctrl->seq++;
+	memory_barrier();
+	ctrl->passes = passes;
+	ctrl->ticks = ticks;
+	memory_barrier();
+	ctrl->seq++;
+}
+
 /* Perform write-only iterations over the memory buffer */
 void do_reads(volatile struct control * ctrl);
 
@@ -86,6 +107,7 @@ void do_reads(volatile struct control * ctrl)
 		print("Started READ accesses with size %d.\n", size);
 
 	total = 0;
+	publish(ctrl, 0, 0);
 	while (ctrl->command & CMD_ENABLE) {
 		start = timer_get_ticks();
 		for (i = 0; i < size; i += LINE_SIZE) {
@@ -94,6 +116,7 @@ void do_reads(volatile struct control * ctrl)
 		end = timer_get_ticks();
 		count++;
 		total += end - start;
+		publish(ctrl, count, total);
 	}
 
 	if (ctrl->command & CMD_VERBOSE) {
@@ -117,6 +140,7 @@ void do_writes(volatile struct control * ctrl)
 		print("Started WRITE accesses with size %d.\n", size);
 
 	total = 0;
+	publish(ctrl, 0, 0);
 	while (ctrl->command & CMD_ENABLE) {
 		start = timer_get_ticks();
 		for (i = 0; i < size; i += LINE_SIZE) {
@@ -125,6 +149,7 @@ void do_writes(volatile struct control * ctrl)
 		end = timer_get_ticks();
 		count++;
 		total += end - start;
+		publish(ctrl, count, total);
 	}
 
 	if (ctrl->command & CMD_VERBOSE) {
@@ -151,6 +176,7 @@ void do_reads_writes(volatile struct control * ctrl)
 	size = size / 2;
 
 	total = 0;
+	publish(ctrl, 0, 0);
 	while (ctrl->command & CMD_ENABLE) {
 		start = timer_get_ticks();
 		for (i = 0; i < size; i += LINE_SIZE) {
@@ -159,6 +185,7 @@ void do_reads_writes(volatile struct control * ctrl)
 		end = timer_get_ticks();
 		count++;
 		total += end - start;
+		publish(ctrl, count, total);
 	}
 
 	if (ctrl->command & CMD_VERBOSE) {
@@ -251,6 +278,7 @@ static void do_util_stress(volatile struct control * ctrl)
 	for (unsigned int col = minc; col < maxc; col++) {
 		for (unsigned row = minr; row < maxr; row++) {
 			avg_bw = avg_bw_single(iter, col, LOG2_LINE_SIZE, row);
+			ctrl->bandwidth = avg_bw;
 			// TODO: integrate into hypervised and use a spinlock
 			printk("%u,%u,%u,%llu\n", ctrl->cpu, col, row, avg_bw);
 		}
@@ -341,6 +369,7 @@ void inmate_main(void)
 	buffer = (volatile unsigned char*)((unsigned long)MEM_VIRT_START);
 	ctrl = (volatile struct control *)((unsigned long)COMM_VIRT_ADDR);
 	memset((void*)ctrl, 0, sizeof(*ctrl));
+	ctrl->freq = timer_get_frequency();
 
 	printk("Memory Bomb Started.\n");
 	print_mem_info();
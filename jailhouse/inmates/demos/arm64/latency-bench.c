@@ -0,0 +1,230 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Wakeup latency benchmark in the style of cyclictest: a periodic virtual
+ * timer interrupt with absolute deadlines, the latency being the delay from
+ * the deadline to the entry of the handler. Results are log2 histograms of
+ * the latencies, published over an ivshmem device with
+ * JAILHOUSE_SHMEM_PROTO_LATENCY (see jailhouse/latency-bench.h) and collected
+ * by tools/jailhouse-latency-bench in the root cell.
+ *
+ * The inmate library runs on a single CPU, so each measured core gets a cell
+ * of its own, all of them peers of the same ivshmem device.
+ *
+ * Command line: period-us (default 1000), bar-base (guest-physical address
+ * of the ivshmem registers, default right after the PCI config space).
+ */
+
+#include <inmate.h>
+#include <dma.h>
+#include <gic.h>
+#include <asm/sysregs.h>
+#include <jailhouse/cell-config.h>
+#include <jailhouse/latency-bench.h>
+
+#define PCI_VENDOR_ID_SIEMENS		0x110a
+#define IVSHMEM_DEVICE_ID		0x4106
+
+#define IVSHMEM_CFG_PRIV_CNTL		0x03
+#define IVSHMEM_PRIV_CNTL_NONCACHED	(1 << 2)
+#define IVSHMEM_CFG_STATE_TAB_SZ	0x04
+#define IVSHMEM_CFG_RW_SECTION_SZ	0x08
+#define IVSHMEM_CFG_OUT_SECTION_SZ	0x10
+#define IVSHMEM_CFG_ADDRESS		0x18
+
+#define IVSHMEM_REG_ID			0x00
+#define IVSHMEM_REG_STATE		0x10
+
+#define IVSHMEM_STATE_RUNNING		1
+
+#define NSEC_PER_SEC			1000000000ULL
+
+static volatile struct latency_bench_control *control;
+static volatile struct latency_bench_results *results;
+
+static u64 freq, period_ticks, deadline;
+
+static u64 ticks_to_ns(u64 ticks)
+{
+	/* latencies are short, no overflow before the division */
+	return ticks * NSEC_PER_SEC / freq;
+}
+
+static u64 pci_read_config64(u16 bdf, unsigned int addr)
+{
+	return pci_read_config(bdf, addr, 4) |
+		((u64)pci_read_config(bdf, addr + 4, 4) << 32);
+}
+
+static int find_device(void)
+{
+	u32 class_rev;
+	int bdf = 0;
+
+	while ((bdf = pci_find_device(PCI_VENDOR_ID_SIEMENS, IVSHMEM_DEVICE_ID,
+				      bdf)) >= 0) {
+		class_rev = pci_read_config(bdf, 0x8, 4);
+		if (class_rev >> 8 == (PCI_DEV_CLASS_OTHER << 16 |
+				       JAILHOUSE_SHMEM_PROTO_LATENCY))
+			return bdf;
+		bdf++;
+	}
+	return -1;
+}
+
+static bool ivshmem_setup(void)
+{
+	u64 state_sz, rw_sz, out_sz, shmem;
+	enum map_attr attr;
+	u32 *registers;
+	int bdf, vndr_cap;
+	u32 id;
+
+	pci_init();
+	bdf = find_device();
+	if (bdf < 0) {
+		printk("IVSHMEM: no latency-bench device found\n");
+		return false;
+	}
+	vndr_cap = pci_find_cap(bdf, PCI_CAP_ID_VNDR);
+	if (vndr_cap < 0) {
+		printk("IVSHMEM: no vendor capability\n");
+		return false;
+	}
+
+	registers = (u32 *)(unsigned long)cmdline_parse_int("bar-base",
+			comm_region->pci_mmconfig_base + 0x100000);
+	map_range(registers, PAGE_SIZE, MAP_UNCACHED);
+	pci_write_config(bdf, PCI_CFG_BAR, (unsigned long)registers, 4);
+	pci_write_config(bdf, PCI_CFG_BAR + 4,
+			 (unsigned long)registers >> 32, 4);
+	pci_write_config(bdf, PCI_CFG_COMMAND, PCI_CMD_MEM, 2);
+
+	state_sz = pci_read_config(bdf, vndr_cap + IVSHMEM_CFG_STATE_TAB_SZ, 4);
+	rw_sz = pci_read_config64(bdf, vndr_cap + IVSHMEM_CFG_RW_SECTION_SZ);
+	out_sz = pci_read_config64(bdf, vndr_cap + IVSHMEM_CFG_OUT_SECTION_SZ);
+	shmem = pci_read_config64(bdf, vndr_cap + IVSHMEM_CFG_ADDRESS);
+	id = mmio_read32(&registers[IVSHMEM_REG_ID / 4]);
+
+	if (id == 0 || out_sz < sizeof(struct latency_bench_results)) {
+		printk("IVSHMEM: peer %d with output sections of %ld bytes "
+		       "cannot report\n", id, (long)out_sz);
+		return false;
+	}
+
+	/* the output sections of all peers follow the read-write section */
+	shmem += state_sz + rw_sz;
+	/* match the stage-2 attributes of JAILHOUSE_MEM_NONCACHED sections */
+	attr = MAP_ATTR_CACHED;
+	if (pci_read_config(bdf, vndr_cap + IVSHMEM_CFG_PRIV_CNTL, 1) &
+	    IVSHMEM_PRIV_CNTL_NONCACHED)
+		attr = MAP_ATTR_NONCACHED;
+	map_range_attr((void *)(unsigned long)shmem, out_sz * (id + 1), attr);
+	control = (void *)(unsigned long)shmem;
+	results = (void *)(unsigned long)(shmem + id * out_sz);
+
+	mmio_write32(&registers[IVSHMEM_REG_STATE / 4],
+		     IVSHMEM_STATE_RUNNING);
+	printk("IVSHMEM: peer %d at %p\n", id, results);
+
+	return true;
+}
+
+static void clear_results(unsigned int reset)
+{
+	unsigned int n;
+
+	results->samples = 0;
+	results->missed = 0;
+	results->min_ns = ~0ULL;
+	results->max_ns = 0;
+	results->sum_ns = 0;
+	for (n = 0; n < LATENCY_BENCH_BUCKETS; n++)
+		results->buckets[n] = 0;
+	results->reset = reset;
+}
+
+static void handle_IRQ(unsigned int irqn)
+{
+	u64 now, ns, skipped = 0;
+	unsigned int bucket;
+
+	if (irqn != TIMER_IRQ)
+		return;
+
+	instruction_barrier();
+	arm_read_sysreg(CNTVCT_EL0, now);
+	ns = ticks_to_ns(now - deadline);
+
+	deadline += period_ticks;
+	if (deadline <= now) {
+		skipped = (now - deadline) / period_ticks + 1;
+		deadline += skipped * period_ticks;
+	}
+	arm_write_sysreg(CNTV_CVAL_EL0, deadline);
+
+	bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+	if (bucket >= LATENCY_BENCH_BUCKETS)
+		bucket = LATENCY_BENCH_BUCKETS - 1;
+
+	results->seq++;
+	memory_barrier();
+
+	if (control->revision == LATENCY_BENCH_REVISION &&
+	    control->reset != results->reset)
+		clear_results(control->reset);
+
+	results->samples++;
+	results->missed += skipped;
+	results->sum_ns += ns;
+	if (ns < results->min_ns)
+		results->min_ns = ns;
+	if (ns > results->max_ns)
+		results->max_ns = ns;
+	results->buckets[bucket]++;
+
+	memory_barrier();
+	results->seq++;
+}
+
+void inmate_main(void)
+{
+	unsigned int period_us = cmdline_parse_int("period-us", 1000);
+	u64 mpidr;
+
+	if (!ivshmem_setup())
+		halt();
+
+	freq = timer_get_frequency();
+	period_ticks = freq * period_us / 1000000;
+	if (period_ticks == 0) {
+		printk("Period of %d us too short\n", period_us);
+		halt();
+	}
+
+	arm_read_sysreg(MPIDR, mpidr);
+	results->mpidr = mpidr;
+	results->period_us = period_us;
+	clear_results(control->reset);
+	memory_barrier();
+	results->revision = LATENCY_BENCH_REVISION;
+
+	irq_init(handle_IRQ);
+	irq_enable(TIMER_IRQ);
+
+	printk("Measuring wakeup latency with a period of %d us...\n",
+	       period_us);
+
+	instruction_barrier();
+	arm_read_sysreg(CNTVCT_EL0, deadline);
+	deadline += period_ticks;
+	arm_write_sysreg(CNTV_CVAL_EL0, deadline);
+	arm_write_sysreg(CNTV_CTL_EL0, 1);
+
+	halt();
+}
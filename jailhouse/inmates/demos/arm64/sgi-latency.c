@@ -0,0 +1,78 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Measures the delivery latency of an SGI the cell sends to itself, from the
+ * write of ICC_SGI1R_EL1 to the entry of the handler. Run it once with and
+ * once without JAILHOUSE_CELL_SDEI_IRQS in the root cell to compare injection
+ * via list registers against SDEI delivery. GICv3 only.
+ */
+
+#include <inmate.h>
+#include <gic.h>
+
+#define SGI_ID			1
+#define ROUNDS			1000
+
+#define MPIDR_AFF(mpidr, n)	(((mpidr) >> ((n) == 3 ? 32 : (n) * 8)) & 0xff)
+
+static volatile u64 sent_ticks;
+static volatile bool received;
+
+static void self_sgi(void)
+{
+	unsigned long mpidr, sgi1r;
+
+	asm volatile("mrs %0, mpidr_el1" : "=r" (mpidr));
+	sgi1r = (1UL << (MPIDR_AFF(mpidr, 0) & 0xf)) |
+		(MPIDR_AFF(mpidr, 1) << 16) | ((unsigned long)SGI_ID << 24) |
+		(MPIDR_AFF(mpidr, 2) << 32) | (MPIDR_AFF(mpidr, 3) << 48);
+
+	sent_ticks = timer_get_ticks();
+	/* ICC_SGI1R_EL1 */
+	asm volatile("msr s3_0_c12_c11_5, %0; isb" : : "r" (sgi1r));
+}
+
+static void handle_IRQ(unsigned int irqn)
+{
+	static u64 min_delta = ~0ULL, max_delta, sum_delta, rounds;
+	u64 delta = timer_get_ticks() - sent_ticks;
+
+	if (irqn != SGI_ID)
+		return;
+
+	if (delta < min_delta)
+		min_delta = delta;
+	if (delta > max_delta)
+		max_delta = delta;
+	sum_delta += delta;
+
+	if (++rounds == ROUNDS) {
+		printk("SGI latency: min: %6ld ns, avg: %6ld ns, max: %6ld ns\n",
+		       (long)timer_ticks_to_ns(min_delta),
+		       (long)timer_ticks_to_ns(sum_delta / ROUNDS),
+		       (long)timer_ticks_to_ns(max_delta));
+		min_delta = ~0ULL;
+		max_delta = sum_delta = rounds = 0;
+	}
+	received = true;
+}
+
+void inmate_main(void)
+{
+	printk("Initializing the GIC...\n");
+	irq_init(handle_IRQ);
+	irq_enable(SGI_ID);
+
+	printk("Measuring SGI latency over %d rounds...\n", ROUNDS);
+	while (1) {
+		received = false;
+		self_sgi();
+		while (!received)
+			cpu_relax();
+	}
+}
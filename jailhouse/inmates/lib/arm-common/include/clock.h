@@ -0,0 +1,127 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Fast time keeping of ARM inmates on the virtual counter CNTVCT.
+ *
+ * Ticks are converted to nanoseconds and back with a multiplication and a
+ * shift, the factors are precomputed from CNTFRQ by clock_init, as in the
+ * Linux clocksource. now_ns() counts from the reset of the system counter,
+ * which all cells share. clock_ptp_ns() converts the counter to the PTP time
+ * that the root cell publishes through shared memory, see struct
+ * clock_ptp_shm.
+ */
+
+#ifndef _INMATE_CLOCK_H
+#define _INMATE_CLOCK_H
+
+#include <asm/sysregs.h>
+
+#define NSEC_PER_SEC		1000000000UL
+
+struct clock_scale {
+	u32 mult;
+	u32 shift;
+};
+
+extern struct clock_scale clock_ticks_to_ns, clock_ns_to_ticks;
+
+/*
+ * PTP time published by the root cell (struct ether_ptp_shm of nvethernet):
+ * PTP time = ptp_ns + (((CNTVCT - cntvct) * rate) >> 32), valid while magic
+ * is CLOCK_PTP_SHM_MAGIC and seq is even and unchanged across the read.
+ */
+#define CLOCK_PTP_SHM_MAGIC	0x50545053
+
+struct clock_ptp_shm {
+	u32 magic;
+	u32 seq;
+	u64 ptp_ns;
+	u64 cntvct;
+	/* nanoseconds per tick in 32.32 fixed point */
+	u64 rate;
+};
+
+/* (val * mult) >> shift without overflowing the product, shift <= 32 */
+static inline u64 clock_mul_shift(u64 val, u32 mult, u32 shift)
+{
+	u64 ret = ((val & 0xffffffff) * mult) >> shift;
+
+	if (val >> 32)
+		ret += ((val >> 32) * mult) << (32 - shift);
+	return ret;
+}
+
+static inline u64 clock_ticks(void)
+{
+	u64 ticks;
+
+	asm volatile("isb" : : : "memory");
+	arm_read_sysreg(CNTVCT_EL0, ticks);
+	return ticks;
+}
+
+static inline u64 ticks_to_ns(u64 ticks)
+{
+	return clock_mul_shift(ticks, clock_ticks_to_ns.mult,
+			       clock_ticks_to_ns.shift);
+}
+
+static inline u64 ns_to_ticks(u64 ns)
+{
+	return clock_mul_shift(ns, clock_ns_to_ticks.mult,
+			       clock_ns_to_ticks.shift);
+}
+
+static inline u64 now_ns(void)
+{
+	return ticks_to_ns(clock_ticks());
+}
+
+void clock_init(void);
+
+/* PTP time now, 0 while the root cell does not publish it */
+u64 clock_ptp_ns(const volatile struct clock_ptp_shm *shm);
+
+/*
+ * Fire the virtual timer at the absolute deadline, in now_ns() time. The
+ * deadline is rounded up to the next tick. The timer stays armed until
+ * timer_stop or the next deadline.
+ */
+void timer_start_deadline(u64 deadline_ns);
+void timer_stop(void);
+
+#endif /* !_INMATE_CLOCK_H */
@@ -0,0 +1,68 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Memory types for buffers shared with DMA masters, in addition to the
+ * coarse map_type of map_range, and cache maintenance for buffers that are
+ * mapped cacheable while the master does not snoop the caches:
+ *
+ *  - clean a buffer before the master reads it,
+ *  - invalidate it before the CPU reads what the master wrote.
+ *
+ * Maintenance is done to the point of coherency and completes before the
+ * helpers return.
+ */
+
+#ifndef _INMATE_DMA_H
+#define _INMATE_DMA_H
+
+enum map_attr {
+	/* normal memory, inner/outer write-back, as MAP_CACHED */
+	MAP_ATTR_CACHED,
+	/* device-nGnRnE memory, as MAP_UNCACHED */
+	MAP_ATTR_DEVICE,
+	/* normal memory, inner/outer non-cacheable */
+	MAP_ATTR_NONCACHED,
+	/* normal non-cacheable memory gathers and merges writes */
+	MAP_ATTR_WRITE_COMBINE = MAP_ATTR_NONCACHED,
+};
+
+void map_range_attr(void *start, unsigned long size, enum map_attr attr);
+
+void dcache_clean_range(const void *start, unsigned long size);
+void dcache_inval_range(void *start, unsigned long size);
+void dcache_flush_range(const void *start, unsigned long size);
+
+#endif /* !_INMATE_DMA_H */
@@ -0,0 +1,94 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Secondary CPUs of ARM inmates, started via PSCI CPU_ON, and a minimal
+ * task queue to spread work over them.
+ *
+ * Each CPU owns a work-stealing deque: it queues and takes tasks at the
+ * bottom, idle CPUs steal from the top of the others. Only the owner may call
+ * smp_queue_task, any CPU may call smp_run_task. Secondary CPUs run with the
+ * MMU and caches set up like the boot CPU, but without a GIC CPU interface.
+ */
+
+#ifndef _INMATE_SMP_H
+#define _INMATE_SMP_H
+
+#define SMP_MAX_CPUS		8
+#define SMP_STACK_SIZE		PAGE_SIZE
+
+/* must be a power of two */
+#define SMP_QUEUE_SIZE		64
+
+struct smp_barrier {
+	unsigned int count;
+	unsigned int sense;
+};
+
+/**
+ * Start a CPU of the cell, it calls entry with its logical ID and powers
+ * off when entry returns. CPUs are started by one CPU at a time.
+ *
+ * @return Logical ID of the CPU (1 ... SMP_MAX_CPUS - 1), the boot CPU has
+ *	   the ID 0. Negative on error.
+ */
+int smp_start_cpu(unsigned long mpidr, void (*entry)(unsigned int cpu));
+
+/** Logical ID of the calling CPU. */
+unsigned int smp_cpu_id(void);
+
+/** Number of online CPUs, including the boot CPU. */
+unsigned int smp_num_cpus(void);
+
+/**
+ * Queue a task on the calling CPU.
+ *
+ * @return False if the queue of the CPU is full.
+ */
+bool smp_queue_task(void (*fn)(void *arg), void *arg);
+
+/**
+ * Run a task of the calling CPU, or one stolen from another CPU.
+ *
+ * @return False if no task was found.
+ */
+bool smp_run_task(void);
+
+/** Wait until cpus CPUs arrived at the barrier. It can be reused directly. */
+void smp_barrier_wait(struct smp_barrier *barrier, unsigned int cpus);
+
+void arm_mmu_enable_cpu(void);
+
+#endif /* !_INMATE_SMP_H */
@@ -37,13 +37,23 @@
  */
 
 #include <inmate.h>
+#include <dma.h>
+#include <smp.h>
 #include <asm/sysregs.h>
 #include <jailhouse/mem-bomb.h>
 
+/* MAIR indexes of enum map_attr */
+#define MAIR_IDX_CACHED		0
+#define MAIR_IDX_DEVICE		1
+#define MAIR_IDX_NONCACHED	2
+
+/* inner/outer non-cacheable normal memory */
+#define MAIR_ATTR_NC		0x44
+
 static u64 __attribute__((aligned(4096)))
 	page_directory[JAILHOUSE_INMATE_MEM_PAGE_DIR_LEN];
 
-void map_range(void *start, unsigned long size, enum map_type map_type)
+void map_range_attr(void *start, unsigned long size, enum map_attr attr)
 {
 	u64 vaddr, pmd_entry;
 	unsigned pgd_index;
@@ -71,10 +81,17 @@ void map_range(void *start, unsigned long size, enum map_type map_type)
 		pmd_entry = vaddr & HUGE_PAGE_MASK;
 		pmd_entry |= LATTR_AF | LATTR_INNER_SHAREABLE | \
 			     LATTR_AP_RW_EL1 | LONG_DESC_BLOCK;
-		if (map_type == MAP_CACHED)
-			pmd_entry |= LATTR_MAIR(0);
-		else
-			pmd_entry |= LATTR_MAIR(1);
+		switch (attr) {
+		case MAP_ATTR_CACHED:
+			pmd_entry |= LATTR_MAIR(MAIR_IDX_CACHED);
+			break;
+		case MAP_ATTR_NONCACHED:
+			pmd_entry |= LATTR_MAIR(MAIR_IDX_NONCACHED);
+			break;
+		default:
+			pmd_entry |= LATTR_MAIR(MAIR_IDX_DEVICE);
+			break;
+		}
 
 		pmd[PMD_INDEX(vaddr)] = pmd_entry;
 
@@ -90,22 +107,88 @@ void map_range(void *start, unsigned long size, enum map_type map_type)
 	synchronization_barrier();
 }
 
-void arch_mmu_enable(void)
+void map_range(void *start, unsigned long size, enum map_type map_type)
 {
-	unsigned long mair, sctlr;
+	map_range_attr(start, size, map_type == MAP_CACHED ?
+		       MAP_ATTR_CACHED : MAP_ATTR_DEVICE);
+}
 
-	map_range((void*)CONFIG_INMATE_BASE, 0x10000, MAP_CACHED);
-	map_range((void*)COMM_REGION_BASE, PAGE_SIZE, MAP_CACHED);
+static unsigned long dcache_line_size(void)
+{
+	unsigned long ctr;
+
+	/* DminLine: log2 of the words in the smallest data cache line */
+	arm_read_sysreg(CTR, ctr);
+	return 4UL << ((ctr >> 16) & 0xf);
+}
+
+void dcache_clean_range(const void *start, unsigned long size)
+{
+	unsigned long line = dcache_line_size();
+	unsigned long addr = (unsigned long)start & ~(line - 1);
+	unsigned long end = (unsigned long)start + size;
+
+	for (; addr < end; addr += line)
+		dcache_clean_line(addr);
+	synchronization_barrier();
+}
+
+void dcache_flush_range(const void *start, unsigned long size)
+{
+	unsigned long line = dcache_line_size();
+	unsigned long addr = (unsigned long)start & ~(line - 1);
+	unsigned long end = (unsigned long)start + size;
+
+	for (; addr < end; addr += line)
+		dcache_flush_line(addr);
+	synchronization_barrier();
+}
+
+void dcache_inval_range(void *start, unsigned long size)
+{
+	unsigned long line = dcache_line_size();
+	unsigned long addr = (unsigned long)start;
+	unsigned long end = addr + size;
+
+	if (size == 0)
+		return;
+
+	/*
+	 * Lines only partially covered by the buffer may hold dirty data of
+	 * its neighbours, write them back instead of discarding them.
+	 */
+	if (addr & (line - 1)) {
+		addr &= ~(line - 1);
+		dcache_flush_line(addr);
+		addr += line;
+	}
+	if (end & (line - 1) && addr < end) {
+		end &= ~(line - 1);
+		dcache_flush_line(end);
+	}
+
+	for (; addr < end; addr += line)
+		dcache_inval_line(addr);
+	synchronization_barrier();
+}
+
+/* also called by secondary CPUs, with the tables of the boot CPU */
+void arm_mmu_enable_cpu(void)
+{
+	unsigned long mair, sctlr;
 
 	/*
-	 * ARMv7: Use attributes 0 and 1 in MAIR0
-	 * ARMv8: Use attributes 0 and 1 in MAIR
+	 * ARMv7: Use attributes 0 to 2 in MAIR0
+	 * ARMv8: Use attributes 0 to 2 in MAIR
 	 *
 	 * Attributes 0: inner/outer: normal memory, outer write-back
 	 *		 non-transient
 	 * Attributes 1: device memory
+	 * Attributes 2: inner/outer: normal memory, non-cacheable
 	 */
-	mair = MAIR_ATTR(1, MAIR_ATTR_DEVICE) | MAIR_ATTR(0, MAIR_ATTR_WBRWA);
+	mair = MAIR_ATTR(MAIR_IDX_NONCACHED, MAIR_ATTR_NC) |
+		MAIR_ATTR(MAIR_IDX_DEVICE, MAIR_ATTR_DEVICE) |
+		MAIR_ATTR(MAIR_IDX_CACHED, MAIR_ATTR_WBRWA);
 	arm_write_sysreg(MAIR, mair);
 
 	arm_write_sysreg(TRANSL_CONT_REG, TRANSL_CONT_REG_SETTINGS);
@@ -121,3 +204,11 @@ void arch_mmu_enable(void)
 	instruction_barrier();
 	/* MMU is enabled from now on */
 }
+
+void arch_mmu_enable(void)
+{
+	map_range((void*)CONFIG_INMATE_BASE, 0x10000, MAP_CACHED);
+	map_range((void*)COMM_REGION_BASE, PAGE_SIZE, MAP_CACHED);
+
+	arm_mmu_enable_cpu();
+}
@@ -37,8 +37,10 @@
  */
 
 #include <inmate.h>
+#include <clock.h>
 
 void arch_init_early(void)
 {
 	arch_mmu_enable();
+	clock_init();
 }
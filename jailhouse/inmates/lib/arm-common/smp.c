@@ -0,0 +1,249 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <inmate.h>
+#include <dma.h>
+#include <smp.h>
+#include <asm/psci.h>
+#include <asm/sysregs.h>
+
+#define QUEUE_MASK	(SMP_QUEUE_SIZE - 1)
+
+struct smp_task {
+	void (*fn)(void *arg);
+	void *arg;
+};
+
+/*
+ * Chase-Lev deque. top and bottom only grow, their difference is the number
+ * of queued tasks.
+ */
+struct smp_queue {
+	long top;
+	long bottom;
+	struct smp_task tasks[SMP_QUEUE_SIZE];
+};
+
+struct smp_cpu {
+	/* read by smp_secondary_entry and smp_secondary_main, MMU off */
+	unsigned long stack_top;
+	unsigned long vbar;
+	void (*entry)(unsigned int cpu);
+	unsigned int id;
+
+	unsigned long mpidr;
+	bool online;
+	struct smp_queue queue;
+};
+
+void smp_secondary_entry(void);
+void __attribute__((noreturn)) smp_secondary_main(struct smp_cpu *cpu);
+
+static struct smp_cpu smp_cpus[SMP_MAX_CPUS];
+static unsigned int num_cpus = 1;
+
+static unsigned long this_mpidr(void)
+{
+	unsigned long mpidr;
+
+	arm_read_sysreg(MPIDR, mpidr);
+	return mpidr & MPIDR_CPUID_MASK;
+}
+
+void smp_secondary_main(struct smp_cpu *cpu)
+{
+	arm_write_sysreg(VBAR, cpu->vbar);
+	arm_mmu_enable_cpu();
+
+	__atomic_store_n(&cpu->online, true, __ATOMIC_RELEASE);
+
+	cpu->entry(cpu->id);
+
+	psci_call(PSCI_FN_CPU_OFF, 0, 0, 0);
+	halt();
+}
+
+int smp_start_cpu(unsigned long mpidr, void (*entry)(unsigned int cpu))
+{
+	struct smp_cpu *cpu;
+	void *stack;
+	long err;
+
+	if (num_cpus == SMP_MAX_CPUS)
+		return -1;
+
+	stack = zalloc(SMP_STACK_SIZE, 16);
+	smp_cpus[0].mpidr = this_mpidr();
+
+	cpu = &smp_cpus[num_cpus];
+	cpu->stack_top = (unsigned long)stack + SMP_STACK_SIZE;
+	cpu->entry = entry;
+	cpu->id = num_cpus;
+	cpu->mpidr = mpidr & MPIDR_CPUID_MASK;
+	arm_read_sysreg(VBAR, cpu->vbar);
+
+	/*
+	 * The CPU reads its smp_cpu and uses its stack before it enables the
+	 * caches. No line of the stack may be written back over that.
+	 */
+	dcache_clean_range(cpu, sizeof(*cpu));
+	dcache_flush_range(stack, SMP_STACK_SIZE);
+
+	err = psci_call(PSCI_FN_CPU_ON, mpidr,
+			(unsigned long)smp_secondary_entry, (unsigned long)cpu);
+	if (err != PSCI_SUCCESS)
+		return -1;
+
+	while (!__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE))
+		cpu_relax();
+
+	/* smp_run_task only walks over online CPUs */
+	__atomic_store_n(&num_cpus, num_cpus + 1, __ATOMIC_RELEASE);
+
+	return cpu->id;
+}
+
+unsigned int smp_cpu_id(void)
+{
+	unsigned int n, cpus = smp_num_cpus();
+	unsigned long mpidr = this_mpidr();
+
+	for (n = 1; n < cpus; n++)
+		if (smp_cpus[n].mpidr == mpidr)
+			return n;
+	return 0;
+}
+
+unsigned int smp_num_cpus(void)
+{
+	return __atomic_load_n(&num_cpus, __ATOMIC_ACQUIRE);
+}
+
+bool smp_queue_task(void (*fn)(void *arg), void *arg)
+{
+	struct smp_queue *queue = &smp_cpus[smp_cpu_id()].queue;
+	long bottom = __atomic_load_n(&queue->bottom, __ATOMIC_RELAXED);
+	long top = __atomic_load_n(&queue->top, __ATOMIC_ACQUIRE);
+	struct smp_task *task;
+
+	if (bottom - top >= SMP_QUEUE_SIZE)
+		return false;
+
+	task = &queue->tasks[bottom & QUEUE_MASK];
+	task->fn = fn;
+	task->arg = arg;
+
+	/* publish the task before it can be stolen */
+	__atomic_store_n(&queue->bottom, bottom + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+static bool queue_take(struct smp_queue *queue, struct smp_task *task)
+{
+	long bottom = __atomic_load_n(&queue->bottom, __ATOMIC_RELAXED) - 1;
+	long top;
+	bool found = true;
+
+	__atomic_store_n(&queue->bottom, bottom, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	top = __atomic_load_n(&queue->top, __ATOMIC_RELAXED);
+
+	if (top > bottom) {
+		/* empty */
+		__atomic_store_n(&queue->bottom, bottom + 1, __ATOMIC_RELAXED);
+		return false;
+	}
+
+	*task = queue->tasks[bottom & QUEUE_MASK];
+	if (top == bottom) {
+		/* last task, race against thieves */
+		found = __atomic_compare_exchange_n(&queue->top, &top, top + 1,
+						    false, __ATOMIC_SEQ_CST,
+						    __ATOMIC_RELAXED);
+		__atomic_store_n(&queue->bottom, bottom + 1, __ATOMIC_RELAXED);
+	}
+	return found;
+}
+
+static bool queue_steal(struct smp_queue *queue, struct smp_task *task)
+{
+	long top = __atomic_load_n(&queue->top, __ATOMIC_ACQUIRE);
+	long bottom;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	bottom = __atomic_load_n(&queue->bottom, __ATOMIC_ACQUIRE);
+	if (top >= bottom)
+		return false;
+
+	/* only valid if no one else took it meanwhile */
+	*task = queue->tasks[top & QUEUE_MASK];
+	return __atomic_compare_exchange_n(&queue->top, &top, top + 1, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+bool smp_run_task(void)
+{
+	unsigned int cpus = smp_num_cpus();
+	unsigned int id = smp_cpu_id();
+	struct smp_task task;
+	unsigned int n;
+
+	if (!queue_take(&smp_cpus[id].queue, &task)) {
+		for (n = 1; n < cpus; n++)
+			if (queue_steal(&smp_cpus[(id + n) % cpus].queue,
+					&task))
+				break;
+		if (n == cpus)
+			return false;
+	}
+
+	task.fn(task.arg);
+	return true;
+}
+
+void smp_barrier_wait(struct smp_barrier *barrier, unsigned int cpus)
+{
+	/* the last CPU of the previous round flipped it before we got here */
+	unsigned int sense = __atomic_load_n(&barrier->sense, __ATOMIC_RELAXED);
+
+	if (__atomic_add_fetch(&barrier->count, 1, __ATOMIC_ACQ_REL) == cpus) {
+		__atomic_store_n(&barrier->count, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&barrier->sense, !sense, __ATOMIC_RELEASE);
+	} else {
+		while (__atomic_load_n(&barrier->sense, __ATOMIC_ACQUIRE) ==
+		       sense)
+			cpu_relax();
+	}
+}
@@ -40,6 +40,9 @@
 
 #include <asm/sysregs.h>
 #include <inmate.h>
+#include <clock.h>
+
+struct clock_scale clock_ticks_to_ns, clock_ns_to_ticks;
 
 unsigned long timer_get_frequency(void)
 {
@@ -57,21 +60,71 @@ u64 timer_get_ticks(void)
 	return pct64;
 }
 
-static unsigned long emul_division(u64 val, u64 div)
+/* the library has no 64-bit division helpers, binary long division */
+static u64 div_u64_u32(u64 val, u32 div)
+{
+	u64 quot = 0, rem = 0;
+	int bit;
+
+	for (bit = 63; bit >= 0; bit--) {
+		rem = (rem << 1) | ((val >> bit) & 1);
+		if (rem >= div) {
+			rem -= div;
+			quot |= 1ULL << bit;
+		}
+	}
+	return quot;
+}
+
+/* largest shift that keeps mult = (to << shift) / from in 32 bits */
+static void clock_calc_scale(struct clock_scale *scale, u32 from, u32 to)
 {
-	unsigned long cnt = 0;
+	u64 mult = 0;
+	u32 shift;
 
-	while (val > div) {
-		val -= div;
-		cnt++;
+	for (shift = 32; shift > 0; shift--) {
+		mult = div_u64_u32((u64)to << shift, from);
+		if (mult <= 0xffffffff)
+			break;
 	}
-	return cnt;
+	scale->mult = mult;
+	scale->shift = shift;
+}
+
+void clock_init(void)
+{
+	unsigned long freq = timer_get_frequency();
+
+	if (freq == 0)
+		return;
+	clock_calc_scale(&clock_ticks_to_ns, freq, NSEC_PER_SEC);
+	clock_calc_scale(&clock_ns_to_ticks, NSEC_PER_SEC, freq);
 }
 
 u64 timer_ticks_to_ns(u64 ticks)
 {
-	return emul_division(ticks * 1000,
-			     timer_get_frequency() / 1000 / 1000);
+	return ticks_to_ns(ticks);
+}
+
+u64 clock_ptp_ns(const volatile struct clock_ptp_shm *shm)
+{
+	u64 ptp_ns, cntvct, rate, delta;
+	u32 seq;
+
+	do {
+		seq = shm->seq;
+		memory_barrier();
+		if (shm->magic != CLOCK_PTP_SHM_MAGIC)
+			return 0;
+		ptp_ns = shm->ptp_ns;
+		cntvct = shm->cntvct;
+		rate = shm->rate;
+		memory_barrier();
+	} while ((seq & 1) || shm->seq != seq);
+
+	delta = clock_ticks() - cntvct;
+	return ptp_ns + delta * (rate >> 32) +
+		clock_mul_shift(delta, (u32)rate, 32);
 }
 
 void timer_start(u64 timeout)
@@ -80,11 +133,25 @@ void timer_start(u64 timeout)
 	arm_write_sysreg(CNTV_CTL_EL0, 1);
 }
 
+void timer_start_deadline(u64 deadline_ns)
+{
+	u64 ticks = ns_to_ticks(deadline_ns);
+
+	if (ticks_to_ns(ticks) < deadline_ns)
+		ticks++;
+	arm_write_sysreg(CNTV_CVAL_EL0, ticks);
+	arm_write_sysreg(CNTV_CTL_EL0, 1);
+}
+
+void timer_stop(void)
+{
+	arm_write_sysreg(CNTV_CTL_EL0, 0);
+}
+
 void delay_us(unsigned long microsecs)
 {
-	unsigned long long timeout = timer_get_ticks() +
-		microsecs * (timer_get_frequency() / 1000 / 1000);
+	u64 timeout = clock_ticks() + ns_to_ticks(microsecs * 1000ULL);
 
-	while ((long long)(timeout - timer_get_ticks()) > 0)
+	while ((long long)(timeout - clock_ticks()) > 0)
 		cpu_relax();
 }
@@ -44,6 +44,8 @@
 #define CNTV_TVAL_EL0	SYSREG_32(0, c14, c3, 0)
 #define CNTV_CTL_EL0	SYSREG_32(0, c14, c3, 1)
 #define CNTPCT_EL0	SYSREG_64(0, c14)
+#define CNTVCT_EL0	SYSREG_64(1, c14)
+#define CNTV_CVAL_EL0	SYSREG_64(3, c14)
 
 #define SCTLR		SYSREG_32(0, c1, c0, 0)
 #define  SCTLR_RR	(1 << 14)
@@ -75,6 +77,17 @@
 
 #define MAIR MAIR0
 
+#define CTR		SYSREG_32(0, c0, c0, 1)
+
+/* data cache maintenance by VA to the point of coherency */
+#define DCIMVAC		SYSREG_32(0, c7, c6, 1)
+#define DCCMVAC		SYSREG_32(0, c7, c10, 1)
+#define DCCIMVAC	SYSREG_32(0, c7, c14, 1)
+
+#define dcache_clean_line(addr)	arm_write_sysreg(DCCMVAC, addr)
+#define dcache_inval_line(addr)	arm_write_sysreg(DCIMVAC, addr)
+#define dcache_flush_line(addr)	arm_write_sysreg(DCCIMVAC, addr)
+
 #define MPIDR		SYSREG_32(0, c0, c0, 5)
 
 #define  MPIDR_CPUID_MASK	0x00ffffff
@@ -110,6 +123,9 @@ asm(".arch_extension virt\n");
 #define arm_read_sysreg_64(op1, crm, val) \
 	asm volatile ("mrrc	p15, "#op1", %Q0, %R0, "#crm"\n" \
 			: "=r" ((u64)(val)))
+#define arm_write_sysreg_64(op1, crm, val) \
+	asm volatile ("mcrr	p15, "#op1", %Q0, %R0, "#crm"\n" \
+			: : "r" ((u64)(val)))
 
 #else /* __ASSEMBLY__ */
 
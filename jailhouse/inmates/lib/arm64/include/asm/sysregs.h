@@ -75,6 +75,10 @@
 
 #define TTBR0	TTBR0_EL1
 
+#define CTR	CTR_EL0
+
+#define VBAR	VBAR_EL1
+
 #define MPIDR	MPIDR_EL1
 
 #define MPIDR_CPUID_MASK	0xff00ffffffUL
@@ -98,6 +102,14 @@
 #define arm_read_sysreg(sysreg, val) \
 	asm volatile ("mrs	%0,  "__stringify(sysreg)"\n" : "=r" ((val)))
 
+/* data cache maintenance by VA to the point of coherency */
+#define dcache_clean_line(addr) \
+	asm volatile ("dc	cvac, %0\n" : : "r" (addr) : "memory")
+#define dcache_inval_line(addr) \
+	asm volatile ("dc	ivac, %0\n" : : "r" (addr) : "memory")
+#define dcache_flush_line(addr) \
+	asm volatile ("dc	civac, %0\n" : : "r" (addr) : "memory")
+
 #include <asm/sysregs_common.h>
 
 #endif /* __ASSEMBLY__ */
@@ -0,0 +1,77 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Throughput and latency of the ivshmem ring (jailhouse/ivshmem-ring.h) on
+ * a single CPU, for different batch sizes. This measures the cost of the
+ * ring operations themselves. For the cross-cell numbers, run the same loop
+ * against a peer over an ivshmem device.
+ */
+
+#include <inmate.h>
+#include <jailhouse/ivshmem-ring.h>
+
+#define ENTRIES			256
+#define ENTRY_SIZE		64
+#define ROUNDS			100000
+
+static unsigned char prod_mem[sizeof(struct ivshmem_ring_prod) +
+			      ENTRIES * ENTRY_SIZE]
+	__attribute__((aligned(IVSHMEM_RING_CACHELINE)));
+static struct ivshmem_ring_cons cons_mem;
+
+static unsigned char buf[32 * ENTRY_SIZE];
+
+static void bench(struct ivshmem_ring *prod, struct ivshmem_ring *cons,
+		  unsigned int batch, bool mp)
+{
+	u64 start, delta, min_lat = ~0ULL, max_lat = 0, sum = 0;
+	unsigned int n;
+
+	for (n = 0; n < ROUNDS; n++) {
+		start = timer_get_ticks();
+		if (mp)
+			ivshmem_ring_produce_mp(prod, buf, batch);
+		else
+			ivshmem_ring_produce(prod, buf, batch);
+		ivshmem_ring_consume(cons, buf, batch);
+		delta = timer_get_ticks() - start;
+
+		if (delta < min_lat)
+			min_lat = delta;
+		if (delta > max_lat)
+			max_lat = delta;
+		sum += delta;
+	}
+
+	printk("%s batch %2d: %6ld ns/entry, round trip min: %6ld ns, "
+	       "max: %6ld ns\n", mp ? "MPSC" : "SPSC", batch,
+	       (long)(timer_ticks_to_ns(sum) / ((u64)ROUNDS * batch)),
+	       (long)timer_ticks_to_ns(min_lat),
+	       (long)timer_ticks_to_ns(max_lat));
+}
+
+void inmate_main(void)
+{
+	static const unsigned int batches[] = { 1, 4, 8, 16, 32 };
+	struct ivshmem_ring prod, cons;
+	unsigned int n;
+
+	ivshmem_ring_init(&prod, prod_mem, &cons_mem, ENTRIES, ENTRY_SIZE);
+	ivshmem_ring_init(&cons, prod_mem, &cons_mem, ENTRIES, ENTRY_SIZE);
+	ivshmem_ring_reset_prod(&prod);
+	ivshmem_ring_reset_cons(&cons);
+
+	printk("ivshmem ring: %d entries of %d bytes, %d rounds\n",
+	       ENTRIES, ENTRY_SIZE, ROUNDS);
+	for (n = 0; n < ARRAY_SIZE(batches); n++) {
+		bench(&prod, &cons, batches[n], false);
+		bench(&prod, &cons, batches[n], true);
+	}
+
+	printk("Done.\n");
+}
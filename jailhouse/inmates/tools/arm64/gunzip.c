@@ -0,0 +1,415 @@
+/*
+ * Jailhouse AArch64 support
+ *
+ * Copyright (c) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Inflate (RFC 1951) of gzip (RFC 1952) images into a buffer that holds the
+ * complete output, so that back-references can be copied from the output
+ * itself and no window is needed. Codes of up to FAST_BITS bits are decoded
+ * with a lookup table, longer ones bit by bit.
+ */
+
+#include <inmate.h>
+#include "gunzip.h"
+
+#define MAX_BITS	15
+#define MAX_LCODES	286
+#define MAX_DCODES	30
+#define FIX_LCODES	288
+#define FAST_BITS	9
+
+#define GZIP_FHCRC	0x02
+#define GZIP_FEXTRA	0x04
+#define GZIP_FNAME	0x08
+#define GZIP_FCOMMENT	0x10
+
+struct huffman {
+	u16 count[MAX_BITS + 1];
+	u16 symbol[FIX_LCODES];
+	/* symbol << 4 | length for codes of up to FAST_BITS, 0 otherwise */
+	u16 fast[1 << FAST_BITS];
+};
+
+struct inflate_state {
+	const u8 *in;
+	unsigned long in_len, in_pos;
+	u8 *out;
+	unsigned long out_len, out_pos;
+	u64 bitbuf;
+	unsigned int bitcnt;
+};
+
+static const u16 length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const u8 length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const u16 dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577
+};
+static const u8 dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const u8 codelen_order[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static struct huffman lencode, distcode;
+
+static void refill(struct inflate_state *s)
+{
+	while (s->bitcnt <= 56 && s->in_pos < s->in_len) {
+		s->bitbuf |= (u64)s->in[s->in_pos++] << s->bitcnt;
+		s->bitcnt += 8;
+	}
+}
+
+static int bits(struct inflate_state *s, unsigned int need)
+{
+	int val;
+
+	if (s->bitcnt < need) {
+		refill(s);
+		if (s->bitcnt < need)
+			return -1;
+	}
+	val = s->bitbuf & ((1UL << need) - 1);
+	s->bitbuf >>= need;
+	s->bitcnt -= need;
+	return val;
+}
+
+static unsigned int reverse(unsigned int code, unsigned int len)
+{
+	unsigned int rev = 0;
+
+	while (len-- > 0) {
+		rev = (rev << 1) | (code & 1);
+		code >>= 1;
+	}
+	return rev;
+}
+
+/* returns a negative value for an over-subscribed code */
+static int construct(struct huffman *h, const u8 *length, unsigned int n)
+{
+	u16 offs[MAX_BITS + 1], next[MAX_BITS + 1];
+	unsigned int sym, len, code, idx;
+	int left = 1;
+
+	for (len = 0; len <= MAX_BITS; len++)
+		h->count[len] = 0;
+	for (sym = 0; sym < n; sym++)
+		h->count[length[sym]]++;
+	for (idx = 0; idx < ARRAY_SIZE(h->fast); idx++)
+		h->fast[idx] = 0;
+
+	for (len = 1; len <= MAX_BITS; len++) {
+		left <<= 1;
+		left -= h->count[len];
+		if (left < 0)
+			return left;
+	}
+
+	offs[1] = 0;
+	next[1] = 0;
+	for (len = 1; len < MAX_BITS; len++) {
+		offs[len + 1] = offs[len] + h->count[len];
+		next[len + 1] = (next[len] + h->count[len]) << 1;
+	}
+
+	for (sym = 0; sym < n; sym++) {
+		len = length[sym];
+		if (len == 0)
+			continue;
+		h->symbol[offs[len]++] = sym;
+
+		code = next[len]++;
+		if (len > FAST_BITS)
+			continue;
+		for (idx = reverse(code, len); idx < ARRAY_SIZE(h->fast);
+		     idx += 1 << len)
+			h->fast[idx] = sym << 4 | len;
+	}
+	return left;
+}
+
+static int decode(struct inflate_state *s, const struct huffman *h)
+{
+	int code = 0, first = 0, index = 0, count, bit;
+	unsigned int entry, len;
+
+	if (s->bitcnt < MAX_BITS)
+		refill(s);
+
+	entry = h->fast[s->bitbuf & ((1 << FAST_BITS) - 1)];
+	len = entry & 0xf;
+	if (entry && len <= s->bitcnt) {
+		s->bitbuf >>= len;
+		s->bitcnt -= len;
+		return entry >> 4;
+	}
+
+	for (len = 1; len <= MAX_BITS; len++) {
+		bit = bits(s, 1);
+		if (bit < 0)
+			return bit;
+		code |= bit;
+		count = h->count[len];
+		if (code - count < first)
+			return h->symbol[index + (code - first)];
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+static int stored(struct inflate_state *s)
+{
+	unsigned int len;
+	int val;
+
+	/* discard the rest of the current byte */
+	bits(s, s->bitcnt & 7);
+
+	len = bits(s, 16);
+	val = bits(s, 16);
+	if (val < 0 || len != (~val & 0xffff))
+		return -1;
+	if (s->out_pos + len > s->out_len)
+		return -1;
+
+	/* bytes already in the bit buffer first */
+	while (len > 0 && s->bitcnt >= 8) {
+		s->out[s->out_pos++] = bits(s, 8);
+		len--;
+	}
+	if (s->in_pos + len > s->in_len)
+		return -1;
+	memcpy(s->out + s->out_pos, s->in + s->in_pos, len);
+	s->out_pos += len;
+	s->in_pos += len;
+	return 0;
+}
+
+static int codes(struct inflate_state *s, const struct huffman *lcode,
+		 const struct huffman *dcode)
+{
+	unsigned long len, dist;
+	int sym, extra;
+	u8 *dst;
+
+	while (1) {
+		sym = decode(s, lcode);
+		if (sym < 0)
+			return sym;
+		if (sym < 256) {
+			if (s->out_pos == s->out_len)
+				return -1;
+			s->out[s->out_pos++] = sym;
+			continue;
+		}
+		if (sym == 256)
+			return 0;
+
+		sym -= 257;
+		if (sym >= 29)
+			return -1;
+		extra = bits(s, length_extra[sym]);
+		if (extra < 0)
+			return -1;
+		len = length_base[sym] + extra;
+
+		sym = decode(s, dcode);
+		if (sym < 0 || sym >= 30)
+			return -1;
+		extra = bits(s, dist_extra[sym]);
+		if (extra < 0)
+			return -1;
+		dist = dist_base[sym] + extra;
+
+		if (dist > s->out_pos || len > s->out_len - s->out_pos)
+			return -1;
+		/* may overlap, copy byte-wise */
+		dst = s->out + s->out_pos;
+		s->out_pos += len;
+		while (len-- > 0) {
+			*dst = *(dst - dist);
+			dst++;
+		}
+	}
+}
+
+static int fixed(struct inflate_state *s)
+{
+	u8 length[FIX_LCODES];
+	unsigned int sym;
+
+	/* the tables are shared with dynamic blocks, build them each time */
+	for (sym = 0; sym < 144; sym++)
+		length[sym] = 8;
+	for (; sym < 256; sym++)
+		length[sym] = 9;
+	for (; sym < 280; sym++)
+		length[sym] = 7;
+	for (; sym < FIX_LCODES; sym++)
+		length[sym] = 8;
+	construct(&lencode, length, FIX_LCODES);
+
+	for (sym = 0; sym < MAX_DCODES; sym++)
+		length[sym] = 5;
+	construct(&distcode, length, MAX_DCODES);
+
+	return codes(s, &lencode, &distcode);
+}
+
+static int dynamic(struct inflate_state *s)
+{
+	u8 length[MAX_LCODES + MAX_DCODES];
+	int nlen, ndist, ncode, sym, len, extra;
+	int index;
+
+	nlen = bits(s, 5) + 257;
+	ndist = bits(s, 5) + 1;
+	ncode = bits(s, 4) + 4;
+	if (nlen < 257 || ndist < 1 || ncode < 4 || nlen > MAX_LCODES ||
+	    ndist > MAX_DCODES)
+		return -1;
+
+	for (index = 0; index < ncode; index++) {
+		len = bits(s, 3);
+		if (len < 0)
+			return -1;
+		length[codelen_order[index]] = len;
+	}
+	for (; index < 19; index++)
+		length[codelen_order[index]] = 0;
+	if (construct(&lencode, length, 19) != 0)
+		return -1;
+
+	index = 0;
+	while (index < nlen + ndist) {
+		sym = decode(s, &lencode);
+		if (sym < 0)
+			return -1;
+		if (sym < 16) {
+			length[index++] = sym;
+			continue;
+		}
+
+		len = 0;
+		if (sym == 16) {
+			if (index == 0)
+				return -1;
+			len = length[index - 1];
+			extra = bits(s, 2);
+			sym = 3 + extra;
+		} else if (sym == 17) {
+			extra = bits(s, 3);
+			sym = 3 + extra;
+		} else {
+			extra = bits(s, 7);
+			sym = 11 + extra;
+		}
+		if (extra < 0 || index + sym > nlen + ndist)
+			return -1;
+		while (sym-- > 0)
+			length[index++] = len;
+	}
+
+	/* an end-of-block code is required */
+	if (length[256] == 0)
+		return -1;
+
+	if (construct(&lencode, length, nlen) < 0 ||
+	    construct(&distcode, length + nlen, ndist) < 0)
+		return -1;
+
+	return codes(s, &lencode, &distcode);
+}
+
+static int inflate(struct inflate_state *s)
+{
+	int last, type, err;
+
+	do {
+		last = bits(s, 1);
+		type = bits(s, 2);
+		if (last < 0 || type < 0)
+			return -1;
+
+		switch (type) {
+		case 0:
+			err = stored(s);
+			break;
+		case 1:
+			err = fixed(s);
+			break;
+		case 2:
+			err = dynamic(s);
+			break;
+		default:
+			err = -1;
+		}
+		if (err)
+			return err;
+	} while (!last);
+
+	return 0;
+}
+
+long gunzip(void *dst, unsigned long dst_size, const void *src,
+	    unsigned long src_size)
+{
+	struct inflate_state s = {
+		.in = src,
+		.in_len = src_size,
+		.out = dst,
+		.out_len = dst_size,
+	};
+	const u8 *in = src;
+	unsigned long pos = 10;
+	u32 isize;
+	u8 flags;
+
+	if (src_size < 18 || in[0] != 0x1f || in[1] != 0x8b || in[2] != 8)
+		return -1;
+	flags = in[3];
+
+	if (flags & GZIP_FEXTRA)
+		pos += 2 + (in[pos] | in[pos + 1] << 8);
+	if (flags & GZIP_FNAME)
+		while (pos < src_size && in[pos++] != 0)
+			;
+	if (flags & GZIP_FCOMMENT)
+		while (pos < src_size && in[pos++] != 0)
+			;
+	if (flags & GZIP_FHCRC)
+		pos += 2;
+	if (pos + 8 > src_size)
+		return -1;
+
+	/* the CRC is not checked, ISIZE has to match */
+	s.in_pos = pos;
+	s.in_len = src_size - 8;
+	if (inflate(&s) != 0)
+		return -1;
+
+	isize = in[src_size - 4] | in[src_size - 3] << 8 |
+		in[src_size - 2] << 16 | (u32)in[src_size - 1] << 24;
+	if (isize != (u32)s.out_pos)
+		return -1;
+
+	return s.out_pos;
+}
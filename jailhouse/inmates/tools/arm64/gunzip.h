@@ -0,0 +1,17 @@
+/*
+ * Jailhouse AArch64 support
+ *
+ * Copyright (c) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+/**
+ * Inflate a gzip image.
+ *
+ * @return Size of the output, negative on corrupted input or if the output
+ *	   does not fit into dst_size.
+ */
+long gunzip(void *dst, unsigned long dst_size, const void *src,
+	    unsigned long src_size);
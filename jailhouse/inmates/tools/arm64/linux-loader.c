@@ -12,19 +12,49 @@
 
 #include <asm/sysregs.h>
 #include <inmate.h>
+#include <dma.h>
+#include "gunzip.h"
+
+/*
+ * The kernel was loaded gzip-compressed at zimage, inflate it to its load
+ * address. It is run with the MMU off, so it has to reach the point of
+ * coherency, and no stale instructions may remain.
+ */
+static void inflate_kernel(void *kernel, unsigned long zimage)
+{
+	unsigned long zsize = cmdline_parse_int("zimage-size", 0);
+	unsigned long ksize = cmdline_parse_int("kernel-size", 0);
+	long size;
+
+	map_range((void *)zimage, zsize, MAP_CACHED);
+	map_range(kernel, ksize, MAP_CACHED);
+
+	size = gunzip(kernel, ksize, (void *)zimage, zsize);
+	if (size < 0) {
+		printk("Failed to inflate kernel image\n");
+		halt();
+	}
+
+	dcache_clean_range(kernel, size);
+	asm volatile("ic iallu; dsb nsh; isb" : : : "memory");
+}
 
 void inmate_main(void)
 {
-	unsigned long dtb, sctlr;
+	unsigned long dtb, sctlr, zimage;
 	void (*entry)(u64 dtb, u64 x1, u64 x2, u64 x3);
 
 	entry = (void *)cmdline_parse_int("kernel", 0);
 	dtb = cmdline_parse_int("dtb", 0);
+	zimage = cmdline_parse_int("zimage", 0);
+
+	if (zimage)
+		inflate_kernel(entry, zimage);
 
 	/*
 	 * Linux wants the MMU to be disabled
-	 * As we didn't write anything relevant to the caches so far, we can
-	 * get away without flushing.
+	 * Apart from the inflated kernel, we didn't write anything relevant
+	 * to the caches so far, so we can get away without flushing.
 	 */
 	arm_read_sysreg(SCTLR_EL1, sctlr);
 	sctlr &= ~SCTLR_EL1_M;
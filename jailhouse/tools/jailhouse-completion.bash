@@ -171,7 +171,17 @@ function _jailhouse_cell() {
 
 		_filedir "cell"
 		;;
-	load)
+	snapshot|restore)
+		# cell config, then the snapshot file
+		[ "${COMP_CWORD}" -gt 4 ] && return 1
+
+		if [ "${COMP_CWORD}" -eq 3 ]; then
+			_filedir "cell"
+		else
+			_filedir
+		fi
+		;;
+	load|restart)
 		# first, select the id/name of the cell we want to load a image
 		# for
 		_jailhouse_get_id "${cur}" "${prev}" no_root && return 0
@@ -230,6 +240,15 @@ function _jailhouse_cell() {
 		# takes only one argument (id/name)
 		_jailhouse_get_id "${cur}" "${prev}" no_root || return 1
 		;;
+	cpu-move)
+		# destination id/name, the root cell to return a CPU, then the
+		# CPU number
+		_jailhouse_get_id "${cur}" "${prev}" with_root && return 0
+		;;
+	mem-resize)
+		# takes the id/name, then the size
+		_jailhouse_get_id "${cur}" "${prev}" no_root && return 0
+		;;
 	linux)
 		_jailhouse_cell_linux || return 1
 		;;
@@ -319,11 +338,11 @@ function _jailhouse() {
 	local command command_cell command_config cur prev subcommand
 
 	# first level
-	command="enable disable console cell config hardware --help"
+	command="enable disable console batch mode-switch perf shmem cell config hardware stats --help"
 
 	# second level
-	command_cell="create load start shutdown destroy linux list stats"
-	command_config="create collect check"
+	command_cell="create load start restart shutdown destroy cpu-move mem-resize snapshot restore linux list stats"
+	command_config="create collect check colors mmio"
 
 	# ${COMP_WORDS} array containing the words on the current command line
 	# ${COMP_CWORD} index into COMP_WORDS, pointing at the current position
@@ -350,6 +369,10 @@ function _jailhouse() {
 			# a root-cell configuration
 			_filedir "cell"
 			;;
+		batch)
+			# a file of memguard and qos lines
+			_filedir
+			;;
 		console)
 			if [[ "$cur" == -* ]]; then
 				COMPREPLY=( $( compgen -W "-f --follow" -- \
@@ -366,9 +389,15 @@ function _jailhouse() {
 			COMPREPLY=( $( compgen -W "${command_config}" -- \
 					"${cur}") )
 			;;
+		shmem)
+			COMPREPLY=( $( compgen -W "get put" -- "${cur}") )
+			;;
 		hardware)
 			COMPREPLY="check"
 			;;
+		stats)
+			COMPREPLY="exporter"
+			;;
 		--help|disable)
 			# these first level commands have no further subcommand
 			# or option OR we don't even know it
@@ -383,6 +412,17 @@ function _jailhouse() {
 		subcommand="${COMP_WORDS[2]}"
 
 		case "${command}" in
+		enable)
+			# the page-table cache file
+			if [ "${COMP_CWORD}" -eq 3 ]; then
+				COMPREPLY=( $( compgen -W "--cache" -- \
+					"${cur}") )
+			elif [ "${COMP_CWORD}" -eq 4 ]; then
+				_filedir
+			else
+				return 1
+			fi
+			;;
 		cell)
 			# handle cell-commands
 			_jailhouse_cell "${subcommand}" || return 1
@@ -403,6 +443,18 @@ function _jailhouse() {
 			check)
 				_jailhouse_config_check || return 1
 				;;
+			colors)
+				# cell shares and options, nothing to complete
+				return 1;;
+			mmio)
+				if [[ "$cur" == -* ]]; then
+					COMPREPLY=( $( compgen -W "-h --help -t
+						--trace -d --duration -n --top
+						--json" -- "${cur}") )
+				else
+					_filedir
+				fi
+				;;
 			*)
 				return 1;;
 			esac
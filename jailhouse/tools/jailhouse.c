@@ -20,17 +20,28 @@
 #include <errno.h>
 #include <limits.h>
 #include <libgen.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 #include <jailhouse.h>
+#include <jailhouse/cell-config.h>
+#include <jailhouse/hypercall.h>
+
+#include "libjailhouse.h"
 
 #define JAILHOUSE_EXEC_DIR	LIBEXECDIR "/jailhouse"
 #define JAILHOUSE_DEVICE	"/dev/jailhouse"
 #define JAILHOUSE_CELLS		"/sys/devices/jailhouse/cells/"
+#define MEMGUARD_BATCH_MAX_CPUS	255
+#define BATCH_MAX_ARGS		64
+#define LOAD_CHUNK_SIZE		(4UL << 20)
+#define LOAD_MAX_THREADS	8
+#define PT_CACHE_MAX_SIZE	(16UL << 20)
 
-enum shutdown_load_mode {LOAD, SHUTDOWN};
+enum shutdown_load_mode {LOAD, SHUTDOWN, RESTART};
 
 struct extension {
 	char *cmd, *subcmd, *help;
@@ -48,13 +59,22 @@ static const struct extension extensions[] = {
 	  " [-w PARAMS_FILE]\n"
 	  "              [-a ARCH] [-k FACTOR]\n"
 	  "              CELLCONFIG KERNEL" },
-	{ "cell", "stats", "{ ID | [--name] NAME }" },
+	{ "cell", "stats", "[--mmio[=N] | --json [--interval-ms=MS]]"
+	  " { ID | [--name] NAME }" },
+	{ "stats", "exporter", "[-a ADDRESS] [-p PORT] [--once]" },
+	{ "trace", "record", "[-d SECONDS] [-e EVENT[,EVENT...]]"
+	  " [-f { json | ftrace }] [-o FILE]" },
 	{ "config", "create", "[-h] [-g] [-r ROOT] [-t TEMPLATE_DIR]"
 	  " [-c CONSOLE]\n"
 	  "                 [--mem-inmates MEM_INMATES] [--mem-hv MEM_HV]\n"
 	  "                 FILE" },
 	{ "config", "collect", "FILE.TAR" },
 	{ "config", "check", "[-h] SYSCONFIG [CELLCONFIG [CELLCONFIG ...]]" },
+	{ "config", "colors", "[-h] [-n COLORS] [-w WAY_SIZE]"
+	  " [--hv-colors MASK]\n"
+	  "                 [-b BANK_BITS] NAME:PERCENT [NAME:PERCENT ...]" },
+	{ "config", "mmio", "[-h] [-t TRACE] [-d SECONDS] [-n TOP] [--json]"
+	  " CELLCONFIG" },
 	{ "hardware", "check", "" },
 	{ NULL }
 };
@@ -65,18 +85,60 @@ static void __attribute__((noreturn)) help(char *prog, int exit_status)
 
 	printf("Usage: %s { COMMAND | --help | --version }\n"
 	       "\nAvailable commands:\n"
-	       "   enable SYSCONFIG\n"
+	       "   enable SYSCONFIG [--cache FILE]\n"
 	       "   disable\n"
 	       "   console [-f | --follow]\n"
-	       "   memguard { CPU ID } period_us budget_mem event_type\n"
+	       "   memguard [--park] [--reclaim] [--adaptive] [--sync]\n"
+	       "            [--cluster=budget_mem[:event_type]] "
+				"{ CPU ID | CPU LIST }\n"
+	       "            period_us budget_mem event_type "
+				"[budget_mem event_type] ...\n"
+	       "            (--adaptive: budget_mem is "
+				"target[:min[:max]],\n"
+	       "             event_type:el2 also counts hypervisor "
+				"activity)\n"
+	       "   qos { disable | DEVICE:PARAM=VALUE[,PARAM=VALUE] ... }\n"
+	       "   qos profile ID { clear | DEVICE:PARAM=VALUE[,PARAM=VALUE] "
+				"... }\n"
+	       "   qos apply ID\n"
+	       "   batch [FILE]\n"
+	       "         (memguard and qos lines from FILE or stdin)\n"
+	       "   mode-switch PERIOD_US [FILE]\n"
+	       "         (memguard, \"recolor CELL_ID COLORS\" and "
+				"\"qos apply ID\" lines,\n"
+	       "          applied at once)\n"
+	       "   perf CPU_LIST PERIOD [EVENT_TYPE]\n"
+	       "         (sample the guest PC every PERIOD events, 0 stops, "
+				"see jailhouse-perf)\n"
+	       "   cpu schedule CPU CELL_ID:US [CELL_ID:US ...]\n"
+	       "         (cyclic windows of a CPU time-shared by two cells)\n"
+	       "   shmem get NAME [PEER_ID SIZE[K | M]] [-c | --colors COLORS]\n"
+	       "             [-r | --read-only] [-a | --address ADDRESS]\n"
+	       "   shmem put NAME\n"
+	       "         (segments of the shared memory pool, without SIZE only "
+				"map an existing one)\n"
+	       "   trace { off | all | EVENT[,EVENT...] }\n"
+	       "         (EVENT: mmio, irq, memguard_pmu, memguard_timer, "
+				"virq_inject,\n"
+	       "          cell_suspend, cell_resume, smmu_cmd)\n"
 	       "   cell create CELLCONFIG\n"
 	       "   cell list\n"
-	       "   cell load { ID | [--name] NAME } "
-				"{ IMAGE | { -s | --string } \"STRING\" }\n"
+	       "   cell load { ID | [--name] NAME } [-m | --mmap]\n"
+	       "             [-p | --progress] [-j | --jobs N]\n"
+	       "             { IMAGE | { -s | --string } \"STRING\" }\n"
 	       "             [-a | --address ADDRESS] ...\n"
 	       "   cell start { ID | [--name] NAME }\n"
+	       "   cell restart { ID | [--name] NAME } [LOAD OPTIONS AND IMAGES]\n"
 	       "   cell shutdown { ID | [--name] NAME }\n"
-	       "   cell destroy { ID | [--name] NAME }\n",
+	       "   cell destroy { ID | [--name] NAME }\n"
+	       "   cell memguard { ID | [--name] NAME } [--park] period_us "
+				"budget_mem event_type\n"
+	       "             [budget_mem event_type] ...\n"
+	       "   cell recolor { ID | [--name] NAME } COLORS\n"
+	       "   cell cpu-move { ID | [--name] NAME } CPU\n"
+	       "   cell mem-resize { ID | [--name] NAME } SIZE[M | G]\n"
+	       "   cell snapshot CELLCONFIG FILE\n"
+	       "   cell restore CELLCONFIG FILE\n",
 	       basename(prog));
 	for (ext = extensions; ext->cmd; ext++)
 		printf("   %s %s %s\n", ext->cmd, ext->subcmd, ext->help);
@@ -177,6 +239,189 @@ static void *read_file(const char *name, size_t *size)
 	return buffer;
 }
 
+/*
+ * An image file that is read straight into cell memory mapped via the
+ * jailhouse device, see JAILHOUSE_CELL_MAP_IMAGE.
+ */
+struct map_job {
+	const char *name;
+	int fd;
+	char *map;
+	size_t map_size;
+	unsigned long long address;
+	size_t size;
+};
+
+struct map_queue {
+	struct map_job *jobs;
+	unsigned int num_jobs;
+	unsigned long next_chunk;
+	size_t total, done;
+	unsigned int running;
+	bool failed;
+};
+
+static void map_open(struct map_job *job, int dev_fd, const char *name,
+		     unsigned long long address)
+{
+	unsigned long long page_offs = address & (sysconf(_SC_PAGESIZE) - 1);
+	struct stat stat;
+
+	job->name = name;
+	job->address = address;
+	job->fd = open(name, O_RDONLY);
+	if (job->fd < 0) {
+		fprintf(stderr, "opening %s: %s\n", name, strerror(errno));
+		exit(1);
+	}
+
+	if (fstat(job->fd, &stat) < 0) {
+		perror("fstat");
+		exit(1);
+	}
+
+	job->size = stat.st_size;
+	job->map = NULL;
+	if (job->size == 0)
+		return;
+
+	job->map_size = page_offs + job->size;
+	job->map = mmap(NULL, job->map_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, dev_fd, address - page_offs);
+	if (job->map == MAP_FAILED) {
+		fprintf(stderr, "mapping cell memory at 0x%llx: %s\n",
+			address, strerror(errno));
+		exit(1);
+	}
+	job->map += page_offs;
+}
+
+static void map_close(struct map_job *job)
+{
+	/* unmapping cleans the caches for the written range */
+	if (job->map)
+		munmap(job->map - (job->map_size - job->size), job->map_size);
+	close(job->fd);
+}
+
+static bool map_jobs_overlap(const struct map_job *jobs, unsigned int num)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < num; i++)
+		for (j = i + 1; j < num; j++)
+			if (jobs[i].address < jobs[j].address + jobs[j].size &&
+			    jobs[j].address < jobs[i].address + jobs[i].size)
+				return true;
+	return false;
+}
+
+static bool map_read_chunk(struct map_queue *queue, struct map_job *job,
+			   size_t offs)
+{
+	size_t len = job->size - offs;
+	ssize_t result;
+
+	if (len > LOAD_CHUNK_SIZE)
+		len = LOAD_CHUNK_SIZE;
+
+	while (len > 0) {
+		result = pread(job->fd, job->map + offs, len, offs);
+		if (result <= 0) {
+			fprintf(stderr, "reading %s: %s\n", job->name,
+				result < 0 ? strerror(errno) : "file shrunk");
+			return false;
+		}
+		__atomic_add_fetch(&queue->done, result, __ATOMIC_RELAXED);
+		offs += result;
+		len -= result;
+	}
+	return true;
+}
+
+/*
+ * Workers pick chunks in global order. With a single worker, this
+ * preserves the override semantics of overlapping images.
+ */
+static void *map_worker(void *arg)
+{
+	struct map_queue *queue = arg;
+	unsigned long chunk, chunks;
+	unsigned int n;
+
+	while (!__atomic_load_n(&queue->failed, __ATOMIC_RELAXED)) {
+		chunk = __atomic_fetch_add(&queue->next_chunk, 1,
+					   __ATOMIC_RELAXED);
+		for (n = 0; n < queue->num_jobs; n++) {
+			chunks = (queue->jobs[n].size + LOAD_CHUNK_SIZE - 1) /
+				LOAD_CHUNK_SIZE;
+			if (chunk < chunks)
+				break;
+			chunk -= chunks;
+		}
+		if (n == queue->num_jobs)
+			break;
+
+		if (!map_read_chunk(queue, &queue->jobs[n],
+				    chunk * LOAD_CHUNK_SIZE))
+			__atomic_store_n(&queue->failed, true,
+					 __ATOMIC_RELAXED);
+	}
+
+	__atomic_sub_fetch(&queue->running, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static void print_progress(const struct map_queue *queue, size_t done)
+{
+	fprintf(stderr, "\rloading: %3u%% (%zu of %zu MiB)",
+		queue->total ? (unsigned int)(done * 100 / queue->total) : 100,
+		done >> 20, queue->total >> 20);
+}
+
+static bool map_load(struct map_job *jobs, unsigned int num_jobs,
+		     unsigned int threads, bool progress)
+{
+	pthread_t tids[LOAD_MAX_THREADS];
+	struct map_queue queue = {
+		.jobs = jobs,
+		.num_jobs = num_jobs,
+	};
+	unsigned int n;
+
+	for (n = 0; n < num_jobs; n++)
+		queue.total += jobs[n].size;
+
+	if (map_jobs_overlap(jobs, num_jobs))
+		threads = 1;
+	if (threads > queue.total / LOAD_CHUNK_SIZE + 1)
+		threads = queue.total / LOAD_CHUNK_SIZE + 1;
+
+	queue.running = threads;
+	for (n = 0; n < threads; n++)
+		if (pthread_create(&tids[n], NULL, map_worker, &queue) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+
+	while (progress &&
+	       __atomic_load_n(&queue.running, __ATOMIC_ACQUIRE) > 0) {
+		print_progress(&queue,
+			       __atomic_load_n(&queue.done, __ATOMIC_RELAXED));
+		usleep(100000);
+	}
+
+	for (n = 0; n < threads; n++)
+		pthread_join(tids[n], NULL);
+
+	if (progress) {
+		print_progress(&queue, queue.done);
+		fprintf(stderr, "\n");
+	}
+
+	return !queue.failed;
+}
+
 static char *read_sysfs_cell_string(const unsigned int id, const char *entry)
 {
 	char *ret, buffer[128];
@@ -207,21 +452,87 @@ static char *read_sysfs_cell_string(const unsigned int id, const char *entry)
 	return ret;
 }
 
+/*
+ * The page-table image of the root cell is kept in the cache file across
+ * enables. A missing or stale image is replaced by the one exported after the
+ * hypervisor built the tables.
+ */
+static int enable_cached(int fd, void *config, const char *name)
+{
+	struct jailhouse_enable_cached args;
+	ssize_t result;
+	void *cache;
+	int err, cache_fd;
+
+	cache = malloc(PT_CACHE_MAX_SIZE);
+	if (!cache) {
+		fprintf(stderr, "insufficient memory\n");
+		exit(1);
+	}
+
+	memset(&args, 0, sizeof(args));
+	args.config = (unsigned long)config;
+	args.cache = (unsigned long)cache;
+	args.buffer_size = PT_CACHE_MAX_SIZE;
+
+	cache_fd = open(name, O_RDONLY);
+	if (cache_fd >= 0) {
+		result = read(cache_fd, cache, PT_CACHE_MAX_SIZE);
+		if (result < 0) {
+			fprintf(stderr, "reading %s: %s\n", name,
+				strerror(errno));
+			exit(1);
+		}
+		args.cache_size = result;
+		close(cache_fd);
+	} else if (errno != ENOENT) {
+		fprintf(stderr, "opening %s: %s\n", name, strerror(errno));
+		exit(1);
+	}
+
+	err = ioctl(fd, JAILHOUSE_ENABLE_CACHED, &args);
+	if (err) {
+		perror("JAILHOUSE_ENABLE_CACHED");
+		goto out;
+	}
+
+	if (args.cache_size == 0)
+		goto out;
+
+	cache_fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (cache_fd < 0 ||
+	    write(cache_fd, cache, args.cache_size) != args.cache_size)
+		fprintf(stderr, "writing %s: %s\n", name, strerror(errno));
+	if (cache_fd >= 0)
+		close(cache_fd);
+
+out:
+	free(cache);
+	return err;
+}
+
 static int enable(int argc, char *argv[])
 {
+	const char *cache = NULL;
 	void *config;
 	int err, fd;
 
-	if (argc != 3)
+	if (argc == 5 && strcmp(argv[3], "--cache") == 0)
+		cache = argv[4];
+	else if (argc != 3)
 		help(argv[0], 1);
 
 	config = read_file(argv[2], NULL);
 
 	fd = open_dev();
 
-	err = ioctl(fd, JAILHOUSE_ENABLE, config);
-	if (err)
-		perror("JAILHOUSE_ENABLE");
+	if (cache) {
+		err = enable_cached(fd, config, cache);
+	} else {
+		err = ioctl(fd, JAILHOUSE_ENABLE, config);
+		if (err)
+			perror("JAILHOUSE_ENABLE");
+	}
 
 	close(fd);
 	free(config);
@@ -385,13 +696,43 @@ static int cell_shutdown_load(int argc, char *argv[],
 	struct jailhouse_preload_image *image;
 	struct jailhouse_cell_load *cell_load;
 	struct jailhouse_cell_id cell_id;
-	int err, fd, id_args, arg_num;
-	unsigned int images, n;
+	int err, fd, id_args, arg_num, first_image;
+	unsigned int images, n, num_jobs, threads;
+	bool use_mmap = false, progress = false;
+	struct map_job *jobs;
+	const char *name;
+	bool is_string;
 	size_t size;
 	char *endp;
+	long cpus;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	threads = cpus < 1 ? 1 : cpus > LOAD_MAX_THREADS ?
+		LOAD_MAX_THREADS : cpus;
 
 	id_args = parse_cell_id(&cell_id, argc - 3, &argv[3]);
 	arg_num = 3 + id_args;
+	while (id_args != 0 && mode != SHUTDOWN && arg_num < argc) {
+		if (match_opt(argv[arg_num], "-m", "--mmap")) {
+			use_mmap = true;
+			arg_num++;
+		} else if (match_opt(argv[arg_num], "-p", "--progress")) {
+			use_mmap = progress = true;
+			arg_num++;
+		} else if (match_opt(argv[arg_num], "-j", "--jobs")) {
+			if (arg_num + 1 >= argc)
+				help(argv[0], 1);
+			threads = strtoul(argv[arg_num + 1], &endp, 0);
+			if (*endp != 0 || threads == 0 ||
+			    threads > LOAD_MAX_THREADS)
+				help(argv[0], 1);
+			use_mmap = true;
+			arg_num += 2;
+		} else {
+			break;
+		}
+	}
+	first_image = arg_num;
 	if (id_args == 0 || (mode == SHUTDOWN && arg_num != argc) ||
 	    (mode == LOAD && arg_num == argc))
 		help(argv[0], 1);
@@ -423,22 +764,29 @@ static int cell_shutdown_load(int argc, char *argv[],
 	cell_load->cell_id = cell_id;
 	cell_load->num_preload_images = images;
 
-	arg_num = 3 + id_args;
+	jobs = malloc(sizeof(*jobs) * images);
+	if (!jobs) {
+		fprintf(stderr, "insufficient memory\n");
+		exit(1);
+	}
+	num_jobs = 0;
+
+	fd = open_dev();
+
+	if (use_mmap && ioctl(fd, JAILHOUSE_CELL_MAP_IMAGE, &cell_id) < 0) {
+		perror("JAILHOUSE_CELL_MAP_IMAGE");
+		exit(1);
+	}
+
+	arg_num = first_image;
 
 	for (n = 0, image = cell_load->image; n < images; n++, image++) {
-		if (match_opt(argv[arg_num], "-s", "--string")) {
+		is_string = match_opt(argv[arg_num], "-s", "--string");
+		if (is_string)
 			arg_num++;
-			image->source_address =
-				(unsigned long)read_string(argv[arg_num++],
-							   &size);
-		} else {
-			image->source_address =
-				(unsigned long)read_file(argv[arg_num++],
-							 &size);
-		}
-		image->size = size;
-		image->target_address = 0;
+		name = argv[arg_num++];
 
+		image->target_address = 0;
 		if (arg_num < argc &&
 		    match_opt(argv[arg_num], "-a", "--address")) {
 			errno = 0;
@@ -448,18 +796,50 @@ static int cell_shutdown_load(int argc, char *argv[],
 				help(argv[0], 1);
 			arg_num += 2;
 		}
+
+		if (is_string) {
+			image->source_address =
+				(unsigned long)read_string(name, &size);
+		} else if (use_mmap) {
+			/* loaded below, leave an empty image for the ioctl */
+			map_open(&jobs[num_jobs++], fd, name,
+				 image->target_address);
+			image->source_address = 0;
+			size = 0;
+		} else {
+			image->source_address =
+				(unsigned long)read_file(name, &size);
+		}
+		image->size = size;
 	}
 
-	fd = open_dev();
+	if (!map_load(jobs, num_jobs, threads, progress))
+		exit(1);
+	for (n = 0; n < num_jobs; n++)
+		map_close(&jobs[n]);
 
-	err = ioctl(fd, JAILHOUSE_CELL_LOAD, cell_load);
-	if (err)
-		perror("JAILHOUSE_CELL_LOAD");
+	/*
+	 * Restarting without images keeps the memory in place, only CPUs and
+	 * devices are reset.
+	 */
+	err = 0;
+	if (mode != RESTART || images > 0) {
+		err = ioctl(fd, JAILHOUSE_CELL_LOAD, cell_load);
+		if (err)
+			perror("JAILHOUSE_CELL_LOAD");
+	}
+
+	if (mode == RESTART && !err) {
+		err = ioctl(fd, JAILHOUSE_CELL_START, &cell_id);
+		if (err)
+			perror("JAILHOUSE_CELL_START");
+	}
 
 	close(fd);
 	for (n = 0, image = cell_load->image; n < images; n++, image++)
 		free((void *)(unsigned long)image->source_address);
 	free(cell_load);
+	free(jobs);
 
 	return err;
 }
@@ -488,129 +868,545 @@ static int cell_simple_cmd(int argc, char *argv[], unsigned int command)
 	return err;
 }
 
-static int qos_cmd(int argc, char *argv[], unsigned int command)
+/**
+ * Queue "dev1:param1=value,param2=value dev2:param1=value ..." into \a batch,
+ * device names and parameter names are defined in qos.c
+ */
+static int parse_qos_settings(struct jailhouse_batch *batch, int argc,
+			      char *argv[])
+{
+	char *dev, *param, *value, *end;
+	int i, count;
+
+	if (argc == 0)
+		return -EINVAL;
+
+	for (i = 0; i < argc; i++) {
+		dev = argv[i];
+		param = strchr(dev, ':');
+		if (!param)
+			return -EINVAL;
+		*param++ = '\0';
+
+		count = 0;
+		for (param = strtok(param, ","); param;
+		     param = strtok(NULL, ",")) {
+			value = strchr(param, '=');
+			if (!value)
+				return -EINVAL;
+			*value++ = '\0';
+
+			if (jailhouse_batch_add_qos(batch, dev, param,
+						    strtoul(value, &end, 0)))
+				return -errno;
+			if (*end != '\0')
+				return -EINVAL;
+			count++;
+		}
+		if (count == 0)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+/** "profile ID { clear | SETTINGS }" or "apply ID" */
+static int qos_profile_cmd(int argc, char *argv[])
+{
+	struct jailhouse_batch batch;
+	unsigned long id;
+	int err = 0, fd;
+	char *end;
+
+	if (argc < 4)
+		help(argv[0], 1);
+
+	id = strtoul(argv[3], &end, 0);
+	if (*end != '\0' || id >= QOS_MAX_PROFILES) {
+		fprintf(stderr, "QoS: Invalid profile ID.\n");
+		return -EINVAL;
+	}
+
+	if (strcmp(argv[2], "apply") == 0) {
+		if (argc != 4)
+			help(argv[0], 1);
+
+		fd = open_dev();
+		err = jailhouse_qos_profile_apply(fd, id);
+		if (err)
+			perror("JAILHOUSE_QOS_PROFILE_APPLY");
+		close(fd);
+
+		return err;
+	}
+
+	if (argc < 5)
+		help(argv[0], 1);
+
+	jailhouse_batch_init(&batch);
+
+	if (argc != 5 || strcmp(argv[4], "clear") != 0)
+		err = parse_qos_settings(&batch, argc - 4, &argv[4]);
+	if (err) {
+		fprintf(stderr, "QoS: Invalid list of parameters.\n");
+		goto out;
+	}
+
+	fd = open_dev();
+
+	err = jailhouse_qos_profile_set(fd, id, &batch);
+	if (err)
+		perror("JAILHOUSE_QOS_PROFILE_SET");
+
+	close(fd);
+out:
+	jailhouse_batch_free(&batch);
+
+	return err;
+}
+
+static int qos_cmd(int argc, char *argv[])
 {
 	/* The format of a command to set qos parameters is the
 	 * following:
 	 *
 	 * jailhouse qos dev1:param1=value,param2=value dev2:param1=value,param2=value ...
 	 *
-	 * device names and parameter names are defined in qos.c
+	 * or "jailhouse qos disable" to turn QoS control off.
 	 */
 
-	struct jailhouse_qos_args *qos_args;
-	unsigned int count = 0;
-	int i, fd, err;
+	struct jailhouse_batch batch;
+	int err, fd;
 
 	if (argc <= 2)
 		return -EINVAL;
 
-	/* First off, let's understand how many parameters need to be
-	 * passed */
-	for (i = 2; i < argc; ++i) {
-		char * cmdarg = argv[i] - 1;
-		do {
-			++count;
-		} while ((cmdarg = strchr(cmdarg+1, ',')) != NULL);
+	if (strcmp(argv[2], "profile") == 0 || strcmp(argv[2], "apply") == 0)
+		return qos_profile_cmd(argc, argv);
+
+	jailhouse_batch_init(&batch);
+
+	if (strcmp(argv[2], "disable") == 0)
+		err = jailhouse_batch_add_qos(&batch, "disable", "", 0) ?
+			-errno : 0;
+	else
+		err = parse_qos_settings(&batch, argc - 2, &argv[2]);
+	if (err) {
+		fprintf(stderr, "QoS: Invalid list of parameters.\n");
+		goto out;
 	}
 
-	if (count == 0)
-		goto exit_noalloc;
+	fd = open_dev();
 
-	/* Allocate all the memory we need */
-	qos_args = (struct jailhouse_qos_args *)malloc(sizeof(struct jailhouse_qos_args)
-						       + count * sizeof(struct qos_setting));
+	err = jailhouse_batch_apply(fd, &batch);
+	if (err)
+		perror("JAILHOUSE_QOS");
 
-	qos_args->num_settings = count;
+	close(fd);
+out:
+	jailhouse_batch_free(&batch);
 
-	struct qos_setting *cur_set = &qos_args->settings[0];
+	return err;
+}
 
-	/* Is this a disable command? */
-	if (strncmp("disable", argv[2], 8) == 0) {
-		strcpy(cur_set->dev_name, "disable");
-		cur_set->param_name[0] = '\0';
-		cur_set->value = 0;
-		qos_args->num_settings = 1;
-		goto apply_settings;
+/** Parse "[--park] [--reclaim]", returns the number of arguments used */
+static int parse_memguard_flags(struct memguard_params *params, int argc,
+				char *argv[], char *prog)
+{
+	unsigned int *flags = &params->flags;
+	int arg_num = 0;
+	char *end;
+
+	*flags = 0;
+	while (arg_num < argc && strncmp(argv[arg_num], "--", 2) == 0) {
+		if (strncmp(argv[arg_num], "--cluster=", 10) == 0) {
+			/* --cluster=budget[:event_type] */
+			params->cluster_budget =
+				strtoul(argv[arg_num] + 10, &end, 0);
+			if (*end == ':')
+				params->cluster_event_type =
+					strtoul(end + 1, &end, 0);
+			if (*end != '\0')
+				help(prog, 1);
+		} else if (strcmp(argv[arg_num], "--park") == 0)
+			*flags |= MEMGUARD_FLAG_PARK;
+		else if (strcmp(argv[arg_num], "--reclaim") == 0)
+			*flags |= MEMGUARD_FLAG_RECLAIM;
+		else if (strcmp(argv[arg_num], "--adaptive") == 0)
+			*flags |= MEMGUARD_FLAG_ADAPTIVE;
+		else if (strcmp(argv[arg_num], "--sync") == 0)
+			*flags |= MEMGUARD_FLAG_SYNC;
+		else
+			help(prog, 1);
+		arg_num++;
 	}
 
-	/* Build list of parameters */
-	for (i = 2; i < argc; ++i) {
-		char *start = argv[i];
-		char *end;
+	return arg_num;
+}
+
+/** Parse "target[:min[:max]]" into \a event */
+static void parse_memguard_budget(struct memguard_event *event, char *arg,
+				  char *prog)
+{
+	char *end;
+
+	event->budget_memory = strtoul(arg, &end, 0);
+	if (*end == ':')
+		event->budget_min = strtoul(end + 1, &end, 0);
+	if (*end == ':')
+		event->budget_max = strtoul(end + 1, &end, 0);
+	if (*end != '\0')
+		help(prog, 1);
+}
+
+/** Parse "event_type[:el2]" into \a event */
+static void parse_memguard_event_type(struct memguard_event *event,
+				      char *arg, char *prog)
+{
+	char *end;
+
+	event->event_type = strtoul(arg, &end, 0);
+	if (strcmp(end, ":el2") == 0)
+		event->filter |= MEMGUARD_EVENT_EL2;
+	else if (*end != '\0')
+		help(prog, 1);
+}
 
-		/* Indicate that this is the first parameter for this
-		 * device */
-		int first = 1;
+/** Parse "period_us budget_mem event_type [budget_mem event_type] ..." */
+static void parse_memguard_params(struct memguard_params *params, int argc,
+				  char *argv[], char *prog)
+{
+	unsigned int i, num_events;
 
-		end = strchr(start, ':');
-		if (!end)
-			goto exit_err;
+	/* period and one or more (budget_mem, event_type) pairs */
+	if (argc < 3 || (argc - 1) % 2 != 0)
+		help(prog, 1);
 
-		/* Zero-terminate device name */
-		*end = '\0';
+	num_events = (argc - 1) / 2;
+	if (num_events > MEMGUARD_MAX_EVENTS) {
+		fprintf(stderr, "memguard: at most %u events supported\n",
+			MEMGUARD_MAX_EVENTS);
+		exit(1);
+	}
 
-		/* Set device name */
-		strncpy(cur_set->dev_name, start, QOS_DEV_NAMELEN - 1);
-		start = end + 1;
+	params->budget_time = strtoul(argv[0], NULL, 0);
+	params->budget_memory = strtoul(argv[1], NULL, 0);
+	params->event_type = strtoul(argv[2], NULL, 0);
 
-		do {
-			/* Find where parameter ends and value starts */
-			end = strchr(start, '=');
-			if (!end)
-				goto exit_err;
+	params->num_events = num_events;
+	for (i = 0; i < num_events; i++) {
+		parse_memguard_budget(&params->events[i], argv[1 + 2 * i],
+				      prog);
+		parse_memguard_event_type(&params->events[i],
+					  argv[2 + 2 * i], prog);
+	}
+}
 
-			*end = '\0';
+static int cell_memguard(int argc, char *argv[])
+{
+	struct jailhouse_cell_memguard mg;
+	int arg_num, err, fd;
 
-			/* Store parameters name */
-			strncpy(cur_set->param_name, start, QOS_PARAM_NAMELEN-1);
-			start = end+1;
+	memset(&mg, 0, sizeof(mg));
 
-			end = strchr(start, ',');
+	arg_num = parse_cell_id(&mg.cell_id, argc - 3, &argv[3]);
+	if (arg_num == 0)
+		help(argv[0], 1);
+	arg_num += 3;
 
-			/* If this is not the last parameter, set terminator */
-			if (end)
-				*end = '\0';
+	arg_num += parse_memguard_flags(&mg.params, argc - arg_num,
+					&argv[arg_num], argv[0]);
+	parse_memguard_params(&mg.params, argc - arg_num, &argv[arg_num],
+			      argv[0]);
 
-			cur_set->value = strtoul(start, NULL, 0);
-			start = end + 1;
+	fd = open_dev();
 
-			/* Set the device name to empty if this is not
-			 * the first paramter for this device */
-			if (first) {
-				first = 0;
-			} else {
-				cur_set->dev_name[0] = '\0';
-			}
+	err = ioctl(fd, JAILHOUSE_CELL_MEMGUARD, &mg);
+	if (err)
+		perror("JAILHOUSE_CELL_MEMGUARD");
 
-			++cur_set;
+	close(fd);
 
-			/* If no more commas are found, we are done
-			 * with this device */
-			if (!end)
-				break;
+	return err;
+}
+
+static int cell_recolor(int argc, char *argv[])
+{
+	struct jailhouse_cell_recolor recolor;
+	int arg_num, err, fd;
+	char *endp;
+
+	memset(&recolor, 0, sizeof(recolor));
+
+	arg_num = parse_cell_id(&recolor.cell_id, argc - 3, &argv[3]);
+	if (arg_num == 0 || 3 + arg_num + 1 != argc)
+		help(argv[0], 1);
+
+	errno = 0;
+	recolor.colors = strtoull(argv[3 + arg_num], &endp, 0);
+	if (errno != 0 || *endp != 0 || recolor.colors == 0)
+		help(argv[0], 1);
+
+	fd = open_dev();
+
+	err = ioctl(fd, JAILHOUSE_CELL_RECOLOR, &recolor);
+	if (err)
+		perror("JAILHOUSE_CELL_RECOLOR");
+
+	close(fd);
+
+	return err;
+}
+
+static int cell_cpu_move(int argc, char *argv[])
+{
+	struct jailhouse_cell_cpu_move cpu_move;
+	int arg_num, err, fd;
+	unsigned long cpu;
+	char *endp;
+
+	memset(&cpu_move, 0, sizeof(cpu_move));
+
+	arg_num = parse_cell_id(&cpu_move.cell_id, argc - 3, &argv[3]);
+	if (arg_num == 0 || 3 + arg_num + 1 != argc)
+		help(argv[0], 1);
+
+	errno = 0;
+	cpu = strtoul(argv[3 + arg_num], &endp, 0);
+	if (errno != 0 || *endp != 0 || cpu > UINT_MAX)
+		help(argv[0], 1);
+	cpu_move.cpu = cpu;
+
+	fd = open_dev();
+
+	err = ioctl(fd, JAILHOUSE_CELL_CPU_MOVE, &cpu_move);
+	if (err)
+		perror("JAILHOUSE_CELL_CPU_MOVE");
 
-		} while (1);
+	close(fd);
+
+	return err;
+}
+
+static int cell_mem_resize(int argc, char *argv[])
+{
+	struct jailhouse_cell_mem_resize resize;
+	int arg_num, err, fd;
+	char *endp;
+
+	memset(&resize, 0, sizeof(resize));
+
+	arg_num = parse_cell_id(&resize.cell_id, argc - 3, &argv[3]);
+	if (arg_num == 0 || 3 + arg_num + 1 != argc)
+		help(argv[0], 1);
+
+	errno = 0;
+	resize.size = strtoull(argv[3 + arg_num], &endp, 0);
+	if (errno != 0 || endp == argv[3 + arg_num])
+		help(argv[0], 1);
+	if (strcmp(endp, "M") == 0)
+		resize.size <<= 20;
+	else if (strcmp(endp, "G") == 0)
+		resize.size <<= 30;
+	else if (*endp != 0)
+		help(argv[0], 1);
+
+	if (resize.size == 0 ||
+	    resize.size % JAILHOUSE_MEM_RESIZE_STEP != 0) {
+		fprintf(stderr, "Size must be a multiple of %u MiB\n",
+			JAILHOUSE_MEM_RESIZE_STEP >> 20);
+		return -EINVAL;
 	}
 
-apply_settings:
-	/* Read to send parameters to kernel driver */
 	fd = open_dev();
 
-	err = ioctl(fd, command, qos_args);
+	err = ioctl(fd, JAILHOUSE_CELL_MEM_RESIZE, &resize);
 	if (err)
-		perror("JAILHOUSE_QOS");
+		perror("JAILHOUSE_CELL_MEM_RESIZE");
 
 	close(fd);
-	free(qos_args);
 
 	return err;
+}
+
+/*
+ * Snapshot file: header, region table, the opaque state of
+ * JAILHOUSE_CELL_SNAPSHOT, then the content of each region.
+ */
+#define SNAPSHOT_SIGNATURE	"JHSNAP"
+#define SNAPSHOT_REVISION	1
+#define SNAPSHOT_STATE_MAX	(64UL << 10)
+
+struct snapshot_header {
+	char signature[6];
+	__u16 revision;
+	__u32 num_regions;
+	__u32 state_size;
+};
+
+struct snapshot_region {
+	__u64 address;
+	__u64 size;
+};
 
-exit_err:
-	free(qos_args);
-exit_noalloc:
-	fprintf(stderr, "QoS: Invalid list of parameters.\n");
-	return -EINVAL;
+static void snapshot_io(int fd, void *data, size_t len, bool save,
+			const char *name)
+{
+	char *buf = data;
+	ssize_t result;
+
+	while (len > 0) {
+		result = save ? write(fd, buf, len) : read(fd, buf, len);
+		if (result <= 0) {
+			fprintf(stderr, "%s %s: %s\n",
+				save ? "writing" : "reading", name,
+				result < 0 ? strerror(errno) : "file truncated");
+			exit(1);
+		}
+		buf += result;
+		len -= result;
+	}
+}
+
+/* Transfers the loadable regions between the file and cell memory. */
+static void snapshot_memory(int dev_fd, int fd, const char *name,
+			    const struct snapshot_region *regions,
+			    unsigned int num_regions, bool save)
+{
+	unsigned int n;
+	void *map;
+
+	for (n = 0; n < num_regions; n++) {
+		map = mmap(NULL, regions[n].size,
+			   save ? PROT_READ : PROT_READ | PROT_WRITE,
+			   MAP_SHARED, dev_fd, regions[n].address);
+		if (map == MAP_FAILED) {
+			fprintf(stderr, "mapping cell memory at 0x%llx: %s\n",
+				(unsigned long long)regions[n].address,
+				strerror(errno));
+			exit(1);
+		}
+		snapshot_io(fd, map, regions[n].size, save, name);
+		/* unmapping cleans the caches for what was restored */
+		munmap(map, regions[n].size);
+	}
+}
+
+static int cell_snapshot_restore(int argc, char *argv[], bool save)
+{
+	struct jailhouse_cell_snapshot_args args;
+	const struct jailhouse_memory *mem;
+	struct jailhouse_cell_snapshot *state;
+	struct jailhouse_cell_desc *config;
+	struct snapshot_region *regions;
+	struct snapshot_header header;
+	unsigned int n, num_regions;
+	int dev_fd, fd, err;
+
+	if (argc != 5)
+		help(argv[0], 1);
+
+	config = read_file(argv[3], NULL);
+	if (memcmp(config->signature, JAILHOUSE_CELL_DESC_SIGNATURE,
+		   sizeof(config->signature)) != 0) {
+		fprintf(stderr, "%s: not a cell configuration\n", argv[3]);
+		exit(1);
+	}
+
+	memset(&args, 0, sizeof(args));
+	args.cell_id.id = JAILHOUSE_CELL_ID_UNUSED;
+	memcpy(args.cell_id.name, config->name,
+	       sizeof(args.cell_id.name) - 1);
+	args.cell_id.name[sizeof(args.cell_id.name) - 1] = 0;
+
+	fd = open(argv[4], save ? O_WRONLY | O_CREAT | O_TRUNC : O_RDONLY,
+		  0600);
+	if (fd < 0) {
+		fprintf(stderr, "opening %s: %s\n", argv[4], strerror(errno));
+		exit(1);
+	}
+
+	regions = calloc(config->num_memory_regions, sizeof(*regions));
+	state = calloc(1, SNAPSHOT_STATE_MAX);
+	if (!regions || !state) {
+		fprintf(stderr, "insufficient memory\n");
+		exit(1);
+	}
+
+	dev_fd = open_dev();
+
+	if (save) {
+		mem = jailhouse_cell_mem_regions(config);
+		for (n = 0, num_regions = 0;
+		     n < config->num_memory_regions; n++, mem++) {
+			if (!(mem->flags & JAILHOUSE_MEM_LOADABLE))
+				continue;
+			regions[num_regions].address = mem->virt_start;
+			regions[num_regions].size = mem->size;
+			num_regions++;
+		}
+
+		args.buffer = (unsigned long)state;
+		args.size = SNAPSHOT_STATE_MAX;
+		err = ioctl(dev_fd, JAILHOUSE_CELL_SNAPSHOT, &args);
+		if (err) {
+			perror("JAILHOUSE_CELL_SNAPSHOT");
+			goto out;
+		}
+
+		memcpy(header.signature, SNAPSHOT_SIGNATURE,
+		       sizeof(header.signature));
+		header.revision = SNAPSHOT_REVISION;
+		header.num_regions = num_regions;
+		header.state_size = sizeof(*state) + state->irq_state_size +
+			state->num_cpus * state->cpu_state_size;
+		snapshot_io(fd, &header, sizeof(header), true, argv[4]);
+		snapshot_io(fd, regions, num_regions * sizeof(*regions), true,
+			    argv[4]);
+		snapshot_io(fd, state, header.state_size, true, argv[4]);
+	} else {
+		snapshot_io(fd, &header, sizeof(header), false, argv[4]);
+		if (memcmp(header.signature, SNAPSHOT_SIGNATURE,
+			   sizeof(header.signature)) != 0 ||
+		    header.revision != SNAPSHOT_REVISION ||
+		    header.num_regions > config->num_memory_regions ||
+		    header.state_size > SNAPSHOT_STATE_MAX) {
+			fprintf(stderr, "%s: not a snapshot of this cell\n",
+				argv[4]);
+			exit(1);
+		}
+		num_regions = header.num_regions;
+		snapshot_io(fd, regions, num_regions * sizeof(*regions), false,
+			    argv[4]);
+		snapshot_io(fd, state, header.state_size, false, argv[4]);
+	}
+
+	/* mapping the memory sets the cell loadable */
+	err = ioctl(dev_fd, JAILHOUSE_CELL_MAP_IMAGE, &args.cell_id);
+	if (err < 0) {
+		perror("JAILHOUSE_CELL_MAP_IMAGE");
+		goto out;
+	}
+	snapshot_memory(dev_fd, fd, argv[4], regions, num_regions, save);
+
+	if (!save) {
+		args.buffer = (unsigned long)state;
+		args.size = header.state_size;
+		err = ioctl(dev_fd, JAILHOUSE_CELL_RESTORE, &args);
+		if (err)
+			perror("JAILHOUSE_CELL_RESTORE");
+	} else {
+		err = 0;
+	}
+
+out:
+	close(dev_fd);
+	close(fd);
+	free(state);
+	free(regions);
+	free(config);
+
+	return err;
 }
 
 static int cell_management(int argc, char *argv[])
@@ -630,8 +1426,22 @@ static int cell_management(int argc, char *argv[])
 		err = cell_simple_cmd(argc, argv, JAILHOUSE_CELL_START);
 	} else if (strcmp(argv[2], "shutdown") == 0) {
 		err = cell_shutdown_load(argc, argv, SHUTDOWN);
+	} else if (strcmp(argv[2], "restart") == 0) {
+		err = cell_shutdown_load(argc, argv, RESTART);
 	} else if (strcmp(argv[2], "destroy") == 0) {
 		err = cell_simple_cmd(argc, argv, JAILHOUSE_CELL_DESTROY);
+	} else if (strcmp(argv[2], "memguard") == 0) {
+		err = cell_memguard(argc, argv);
+	} else if (strcmp(argv[2], "recolor") == 0) {
+		err = cell_recolor(argc, argv);
+	} else if (strcmp(argv[2], "cpu-move") == 0) {
+		err = cell_cpu_move(argc, argv);
+	} else if (strcmp(argv[2], "mem-resize") == 0) {
+		err = cell_mem_resize(argc, argv);
+	} else if (strcmp(argv[2], "snapshot") == 0) {
+		err = cell_snapshot_restore(argc, argv, true);
+	} else if (strcmp(argv[2], "restore") == 0) {
+		err = cell_snapshot_restore(argc, argv, false);
 	} else {
 		call_extension_script("cell", argc, argv);
 		help(argv[0], 1);
@@ -640,26 +1450,87 @@ static int cell_management(int argc, char *argv[])
 	return err;
 }
 
+/** Queue \a params for each CPU of the list "0,2-5" */
+static void parse_memguard_cpus(struct jailhouse_batch *batch, char *cpus,
+				const struct memguard_params *params,
+				char *prog)
+{
+	unsigned int first, last, count = 0;
+	char *range, *end;
+
+	for (range = strtok(cpus, ","); range; range = strtok(NULL, ",")) {
+		first = strtoul(range, &end, 0);
+		last = first;
+		if (*end == '-')
+			last = strtoul(end + 1, &end, 0);
+		if (*range == '-' || *end != '\0' || last < first)
+			help(prog, 1);
+
+		for (; first <= last; first++) {
+			if (count++ == MEMGUARD_BATCH_MAX_CPUS) {
+				fprintf(stderr, "memguard: too many CPUs\n");
+				exit(1);
+			}
+			if (jailhouse_batch_add_memguard(batch, first,
+							 params)) {
+				fprintf(stderr, "insufficient memory\n");
+				exit(1);
+			}
+		}
+	}
+}
+
+static int memguard_batch(char *cpus, struct memguard_params *params,
+			  char *prog)
+{
+	struct jailhouse_batch batch;
+	int err, fd;
+
+	jailhouse_batch_init(&batch);
+	parse_memguard_cpus(&batch, cpus, params, prog);
+
+	fd = open_dev();
+
+	err = jailhouse_batch_apply(fd, &batch);
+	if (err)
+		perror("JAILHOUSE_MEMGUARD_BATCH");
+
+	close(fd);
+	jailhouse_batch_free(&batch);
+
+	return err;
+}
+
 static int memguard_cmd(int argc, char *argv[], unsigned int command)
 {
 	struct jailhouse_memguard *mg;
+	int arg_num = 2;
 	int err, fd;
+	char *cpus;
 
-	if (argc != 6)
-		help(argv[0], 1);
-
-	mg = malloc(sizeof(struct jailhouse_memguard));
+	mg = calloc(1, sizeof(struct jailhouse_memguard));
 	if (!mg) {
 		fprintf(stderr, "insufficient memory\n");
 		exit(1);
 	}
 
-	mg->cpu = (unsigned int)strtoul(argv[2], NULL, 0);
-	mg->params.budget_time = strtoul(argv[3], NULL, 0);
-	mg->params.budget_memory = strtoul(argv[4], NULL, 0);
-	mg->params.event_type = strtoul(argv[5], NULL, 0);
-	/* Ignore mg->params.flags */
-	mg->params.flags = 0;
+	arg_num += parse_memguard_flags(&mg->params, argc - arg_num,
+					&argv[arg_num], argv[0]);
+	if (arg_num >= argc)
+		help(argv[0], 1);
+
+	cpus = argv[arg_num];
+	mg->cpu = (unsigned int)strtoul(cpus, NULL, 0);
+	arg_num++;
+	parse_memguard_params(&mg->params, argc - arg_num, &argv[arg_num],
+			      argv[0]);
+
+	/* "0,2-5": configure all the listed CPUs with a single call */
+	if (strchr(cpus, ',') || strchr(cpus + 1, '-')) {
+		err = memguard_batch(cpus, &mg->params, argv[0]);
+		free(mg);
+		return err;
+	}
 
 	fd = open_dev();
 
@@ -668,10 +1539,378 @@ static int memguard_cmd(int argc, char *argv[], unsigned int command)
 		perror("JAILHOUSE_MEMGUARD SET");
 
 	close(fd);
+	free(mg);
+
+	return err;
+}
+
+
+/**
+ * Apply a file of "memguard ..." and "qos ..." lines, taking the arguments of
+ * the respective commands, with one ioctl per kind of setting. Memguard lines
+ * require explicit CPU lists, '#' starts a comment.
+ */
+/** "recolor CELL_ID COLORS" line of a mode switch */
+static int parse_switch_recolor(struct mode_switch_cell *cells,
+				unsigned int *num_cells, int argc,
+				char *argv[])
+{
+	struct mode_switch_cell *cell = &cells[*num_cells];
+	char *end;
+
+	if (argc != 2 || *num_cells == MODE_SWITCH_MAX_CELLS)
+		return -EINVAL;
+
+	errno = 0;
+	cell->cell_id = strtoul(argv[0], &end, 0);
+	if (errno != 0 || *end != '\0')
+		return -EINVAL;
+	cell->colors = strtoull(argv[1], &end, 0);
+	if (errno != 0 || *end != '\0' || cell->colors == 0)
+		return -EINVAL;
+	cell->padding = 0;
+	(*num_cells)++;
+
+	return 0;
+}
+
+/**
+ * "batch [FILE]" applies memguard and qos lines one kind after the other.
+ * "mode-switch PERIOD_US [FILE]" takes memguard, "recolor CELL_ID COLORS"
+ * and "qos apply ID" lines and applies them as one switch.
+ */
+static int batch_cmd(int argc, char *argv[], bool mode_switch)
+{
+	char *args[BATCH_MAX_ARGS], *line = NULL, *arg, *cpus, *end;
+	struct mode_switch_cell cells[MODE_SWITCH_MAX_CELLS];
+	unsigned int qos_profile = MODE_SWITCH_NO_QOS;
+	unsigned long long period_us = 0;
+	unsigned int num_cells = 0;
+	struct memguard_params params;
+	struct jailhouse_batch batch;
+	unsigned int line_no = 0;
+	int nargs, arg_num, fd;
+	int file_arg = 2;
+	size_t line_size = 0;
+	FILE *file = stdin;
+	int err = 0;
+
+	if (mode_switch) {
+		if (argc < 3)
+			help(argv[0], 1);
+		errno = 0;
+		period_us = strtoull(argv[2], &end, 0);
+		if (errno != 0 || *end != '\0' || period_us == 0)
+			help(argv[0], 1);
+		file_arg = 3;
+	}
+
+	if (argc > file_arg + 1)
+		help(argv[0], 1);
+
+	if (argc == file_arg + 1 && strcmp(argv[file_arg], "-") != 0) {
+		file = fopen(argv[file_arg], "r");
+		if (!file) {
+			fprintf(stderr, "opening %s: %s\n", argv[file_arg],
+				strerror(errno));
+			exit(1);
+		}
+	}
+
+	jailhouse_batch_init(&batch);
+
+	while (getline(&line, &line_size, file) > 0) {
+		line_no++;
+
+		arg = strchr(line, '#');
+		if (arg)
+			*arg = '\0';
+
+		nargs = 0;
+		for (arg = strtok(line, " \t\n"); arg;
+		     arg = strtok(NULL, " \t\n")) {
+			if (nargs == BATCH_MAX_ARGS) {
+				err = -E2BIG;
+				break;
+			}
+			args[nargs++] = arg;
+		}
+
+		if (err || nargs == 0) {
+			/* empty or comment line */
+		} else if (strcmp(args[0], "memguard") == 0) {
+			memset(&params, 0, sizeof(params));
+			arg_num = 1 + parse_memguard_flags(&params, nargs - 1,
+							   &args[1], argv[0]);
+			if (arg_num >= nargs)
+				help(argv[0], 1);
+			cpus = args[arg_num++];
+			parse_memguard_params(&params, nargs - arg_num,
+					      &args[arg_num], argv[0]);
+			parse_memguard_cpus(&batch, cpus, &params, argv[0]);
+		} else if (mode_switch && strcmp(args[0], "recolor") == 0) {
+			err = parse_switch_recolor(cells, &num_cells,
+						   nargs - 1, &args[1]);
+		} else if (mode_switch && strcmp(args[0], "qos") == 0) {
+			/* only registered profiles can be part of a switch */
+			if (nargs != 3 || strcmp(args[1], "apply") != 0 ||
+			    qos_profile != MODE_SWITCH_NO_QOS)
+				err = -EINVAL;
+			else
+				qos_profile = strtoul(args[2], &end, 0);
+			if (!err && (*end != '\0' ||
+				     qos_profile >= QOS_MAX_PROFILES))
+				err = -EINVAL;
+		} else if (strcmp(args[0], "qos") == 0) {
+			err = parse_qos_settings(&batch, nargs - 1, &args[1]);
+		} else {
+			err = -EINVAL;
+		}
+		if (err) {
+			fprintf(stderr, "%s: invalid line %u\n", argv[1],
+				line_no);
+			goto out;
+		}
+	}
+	if (ferror(file)) {
+		err = -errno;
+		perror("reading batch");
+		goto out;
+	}
+
+	fd = open_dev();
+
+	if (mode_switch) {
+		err = jailhouse_mode_switch(fd, &batch, period_us, qos_profile,
+					    cells, num_cells);
+		if (err)
+			perror("JAILHOUSE_MODE_SWITCH");
+	} else {
+		err = jailhouse_batch_apply(fd, &batch);
+		if (err)
+			perror("JAILHOUSE_MEMGUARD_BATCH / JAILHOUSE_QOS");
+	}
+
+	close(fd);
+out:
+	jailhouse_batch_free(&batch);
+	free(line);
+	if (file != stdin)
+		fclose(file);
 
 	return err;
 }
 
+/** "perf CPU_LIST PERIOD [EVENT_TYPE]", a period of 0 stops sampling */
+static int perf_cmd(int argc, char *argv[])
+{
+	unsigned int first, last, period, event_type = 0;
+	unsigned long long cpus = 0;
+	char *range, *end;
+	int err, fd;
+
+	if (argc < 4 || argc > 5)
+		help(argv[0], 1);
+
+	for (range = strtok(argv[2], ","); range; range = strtok(NULL, ",")) {
+		first = strtoul(range, &end, 0);
+		last = first;
+		if (*end == '-')
+			last = strtoul(end + 1, &end, 0);
+		if (*range == '-' || *end != '\0' || last < first ||
+		    last >= PERF_CPUS)
+			help(argv[0], 1);
+		for (; first <= last; first++)
+			cpus |= 1ULL << first;
+	}
+
+	period = strtoul(argv[3], &end, 0);
+	if (*end != '\0')
+		help(argv[0], 1);
+	if (argc == 5) {
+		event_type = strtoul(argv[4], &end, 0);
+		if (*end != '\0')
+			help(argv[0], 1);
+	}
+
+	fd = open_dev();
+
+	err = jailhouse_perf_set(fd, cpus, event_type, period);
+	if (err)
+		perror("JAILHOUSE_PERF");
+
+	close(fd);
+
+	return err;
+}
+
+static int cpu_schedule_cmd(int argc, char *argv[])
+{
+	struct jailhouse_cpu_schedule_args args;
+	struct jailhouse_sched_slot *slot;
+	char *end;
+	int arg_num, err, fd;
+
+	if (argc < 5 || strcmp(argv[2], "schedule") != 0 ||
+	    argc - 4 > JAILHOUSE_SCHED_MAX_SLOTS)
+		help(argv[0], 1);
+
+	memset(&args, 0, sizeof(args));
+	args.cpu = strtoul(argv[3], &end, 0);
+	if (*end != '\0')
+		help(argv[0], 1);
+
+	/* one CELL_ID:US window per argument, repeated in order */
+	for (arg_num = 4; arg_num < argc; arg_num++) {
+		slot = &args.schedule.slots[args.schedule.num_slots++];
+		slot->cell_id = strtoul(argv[arg_num], &end, 0);
+		if (*end != ':')
+			help(argv[0], 1);
+		slot->duration_us = strtoul(end + 1, &end, 0);
+		if (*end != '\0')
+			help(argv[0], 1);
+	}
+
+	fd = open_dev();
+
+	err = ioctl(fd, JAILHOUSE_CPU_SCHEDULE, &args);
+	if (err)
+		perror("JAILHOUSE_CPU_SCHEDULE");
+
+	close(fd);
+
+	return err;
+}
+
+static int shmem_cmd(int argc, char *argv[])
+{
+	struct jailhouse_shmem_segment *seg;
+	struct jailhouse_shmem_args args;
+	int arg_num = 4, err, fd;
+	char *end;
+
+	if (argc < 4)
+		help(argv[0], 1);
+
+	memset(&args, 0, sizeof(args));
+	seg = &args.segment;
+	if (strlen(argv[3]) > JAILHOUSE_SHMEM_NAME_MAXLEN) {
+		fprintf(stderr, "Segment name longer than %u characters\n",
+			JAILHOUSE_SHMEM_NAME_MAXLEN);
+		return -EINVAL;
+	}
+	strncpy(seg->name, argv[3], sizeof(seg->name) - 1);
+
+	if (strcmp(argv[2], "put") == 0) {
+		if (argc != 4)
+			help(argv[0], 1);
+		args.op = JAILHOUSE_SHMEM_PUT;
+	} else if (strcmp(argv[2], "get") == 0) {
+		args.op = JAILHOUSE_SHMEM_GET;
+		seg->flags = JAILHOUSE_MEM_READ | JAILHOUSE_MEM_WRITE;
+
+		if (argc >= 6 && argv[4][0] != '-') {
+			seg->peer_id = strtoul(argv[4], &end, 0);
+			if (*end != '\0')
+				help(argv[0], 1);
+			seg->size = strtoull(argv[5], &end, 0);
+			if (strcmp(end, "K") == 0)
+				seg->size <<= 10;
+			else if (strcmp(end, "M") == 0)
+				seg->size <<= 20;
+			else if (*end != '\0')
+				help(argv[0], 1);
+			if (seg->size == 0)
+				help(argv[0], 1);
+			arg_num = 6;
+		}
+
+		for (; arg_num < argc; arg_num++) {
+			if (match_opt(argv[arg_num], "-r", "--read-only")) {
+				seg->flags = JAILHOUSE_MEM_READ;
+			} else if (arg_num + 1 < argc &&
+				   match_opt(argv[arg_num], "-c",
+					     "--colors")) {
+				seg->colors = strtoull(argv[++arg_num], &end,
+						       0);
+				if (*end != '\0')
+					help(argv[0], 1);
+			} else if (arg_num + 1 < argc &&
+				   match_opt(argv[arg_num], "-a",
+					     "--address")) {
+				seg->virt_start = strtoull(argv[++arg_num],
+							   &end, 0);
+				if (*end != '\0')
+					help(argv[0], 1);
+			} else {
+				help(argv[0], 1);
+			}
+		}
+	} else {
+		help(argv[0], 1);
+	}
+
+	fd = open_dev();
+
+	err = ioctl(fd, JAILHOUSE_SHMEM_SEGMENT, &args);
+	if (err)
+		perror("JAILHOUSE_SHMEM_SEGMENT");
+	else if (args.op == JAILHOUSE_SHMEM_GET)
+		printf("%s: 0x%llx bytes at 0x%llx (physical 0x%llx), peer "
+		       "cell %u\n", seg->name, (unsigned long long)seg->size,
+		       (unsigned long long)seg->virt_start,
+		       (unsigned long long)seg->phys_start, seg->peer_id);
+
+	close(fd);
+
+	return err;
+}
+
+static const char *const trace_event_names[TRACE_NUM_EVENTS] = {
+	[TRACE_MMIO] = "mmio",
+	[TRACE_IRQ] = "irq",
+	[TRACE_MEMGUARD_PMU] = "memguard_pmu",
+	[TRACE_MEMGUARD_TIMER] = "memguard_timer",
+	[TRACE_VIRQ_INJECT] = "virq_inject",
+	[TRACE_CELL_SUSPEND] = "cell_suspend",
+	[TRACE_CELL_RESUME] = "cell_resume",
+	[TRACE_SMMU_CMD] = "smmu_cmd",
+};
+
+/** "trace { off | all | EVENT[,EVENT...] }" */
+static int trace_cmd(int argc, char *argv[])
+{
+	unsigned int events = 0, n;
+	char *name;
+	int err, fd;
+
+	if (argc != 3)
+		help(argv[0], 1);
+
+	if (strcmp(argv[2], "all") == 0) {
+		events = (1U << TRACE_NUM_EVENTS) - 1;
+	} else if (strcmp(argv[2], "off") != 0) {
+		for (name = strtok(argv[2], ","); name;
+		     name = strtok(NULL, ",")) {
+			for (n = 0; n < TRACE_NUM_EVENTS; n++)
+				if (strcmp(name, trace_event_names[n]) == 0)
+					break;
+			if (n == TRACE_NUM_EVENTS)
+				help(argv[0], 1);
+			events |= 1U << n;
+		}
+	}
+
+	fd = open_dev();
+
+	err = jailhouse_trace_set(fd, events);
+	if (err)
+		perror("JAILHOUSE_TRACE");
+
+	close(fd);
+
+	return err;
+}
 
 static int console(int argc, char *argv[])
 {
@@ -730,16 +1969,30 @@ int main(int argc, char *argv[])
 		close(fd);
 	} else if (strcmp(argv[1], "memguard") == 0) {
 	    err = memguard_cmd(argc, argv, JAILHOUSE_MEMGUARD);
+	} else if (strcmp(argv[1], "batch") == 0) {
+		err = batch_cmd(argc, argv, false);
+	} else if (strcmp(argv[1], "mode-switch") == 0) {
+		err = batch_cmd(argc, argv, true);
+	} else if (strcmp(argv[1], "perf") == 0) {
+		err = perf_cmd(argc, argv);
+	} else if (strcmp(argv[1], "cpu") == 0) {
+		err = cpu_schedule_cmd(argc, argv);
+	} else if (strcmp(argv[1], "shmem") == 0) {
+		err = shmem_cmd(argc, argv);
+	} else if (strcmp(argv[1], "trace") == 0) {
+		call_extension_script(argv[1], argc, argv);
+		err = trace_cmd(argc, argv);
 	} else if (strcmp(argv[1], "cell") == 0) {
 		err = cell_management(argc, argv);
 	} else if (strcmp(argv[1], "console") == 0) {
 		err = console(argc, argv);
 	} else if (strcmp(argv[1], "config") == 0 ||
-		   strcmp(argv[1], "hardware") == 0) {
+		   strcmp(argv[1], "hardware") == 0 ||
+		   strcmp(argv[1], "stats") == 0) {
 		call_extension_script(argv[1], argc, argv);
 		help(argv[0], 1);
 	} else if (strcmp(argv[1], "qos") == 0) {
-		err = qos_cmd(argc, argv, JAILHOUSE_QOS);
+		err = qos_cmd(argc, argv);
 	} else if (strcmp(argv[1], "--version") == 0) {
 		printf("Jailhouse management tool %s\n", JAILHOUSE_VERSION);
 		return 0;
@@ -0,0 +1,220 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+#include "libjailhouse.h"
+
+#define JAILHOUSE_DEVICE	"/dev/jailhouse"
+#define BATCH_INITIAL_SIZE	16
+
+int jailhouse_open(void)
+{
+	return open(JAILHOUSE_DEVICE, O_RDWR);
+}
+
+void jailhouse_batch_init(struct jailhouse_batch *batch)
+{
+	memset(batch, 0, sizeof(*batch));
+}
+
+void jailhouse_batch_free(struct jailhouse_batch *batch)
+{
+	free(batch->memguard);
+	free(batch->qos);
+	jailhouse_batch_init(batch);
+}
+
+void jailhouse_batch_reset(struct jailhouse_batch *batch)
+{
+	if (batch->memguard)
+		batch->memguard->num_cpus = 0;
+	if (batch->qos)
+		batch->qos->num_settings = 0;
+	batch->qos_dev[0] = '\0';
+}
+
+/** Make room for one more entry, the buffers grow by doubling. */
+static void *batch_grow(void *buf, unsigned int *size, unsigned int count,
+			size_t header, size_t entry)
+{
+	unsigned int new_size;
+	void *new_buf;
+
+	if (buf && count < *size)
+		return buf;
+
+	new_size = *size ? *size * 2 : BATCH_INITIAL_SIZE;
+	new_buf = realloc(buf, header + new_size * entry);
+	if (!new_buf)
+		return NULL;
+	if (!buf)
+		memset(new_buf, 0, header);
+	*size = new_size;
+
+	return new_buf;
+}
+
+int jailhouse_batch_add_memguard(struct jailhouse_batch *batch,
+				 unsigned int cpu,
+				 const struct memguard_params *params)
+{
+	struct jailhouse_memguard_batch *mg;
+	struct memguard_cpu_params *entry;
+
+	mg = batch_grow(batch->memguard, &batch->memguard_size,
+			batch->memguard ? batch->memguard->num_cpus : 0,
+			sizeof(*mg), sizeof(struct memguard_cpu_params));
+	if (!mg)
+		return -1;
+	batch->memguard = mg;
+
+	entry = &mg->cpus[mg->num_cpus++];
+	memset(entry, 0, sizeof(*entry));
+	entry->cpu = cpu;
+	entry->params = *params;
+
+	return 0;
+}
+
+int jailhouse_batch_add_qos(struct jailhouse_batch *batch, const char *dev,
+			    const char *param, unsigned int value)
+{
+	struct jailhouse_qos_args *qos;
+	struct qos_setting *entry;
+
+	if (strlen(dev) >= QOS_DEV_NAMELEN ||
+	    strlen(param) >= QOS_PARAM_NAMELEN) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	qos = batch_grow(batch->qos, &batch->qos_size,
+			 batch->qos ? batch->qos->num_settings : 0,
+			 sizeof(*qos), sizeof(struct qos_setting));
+	if (!qos)
+		return -1;
+	batch->qos = qos;
+
+	entry = &qos->settings[qos->num_settings++];
+	memset(entry, 0, sizeof(*entry));
+	/* an empty device name continues the group of the previous entry */
+	if (strcmp(dev, batch->qos_dev) != 0) {
+		strcpy(entry->dev_name, dev);
+		strcpy(batch->qos_dev, dev);
+	}
+	strcpy(entry->param_name, param);
+	entry->value = value;
+
+	return 0;
+}
+
+int jailhouse_batch_apply(int fd, const struct jailhouse_batch *batch)
+{
+	if (batch->memguard && batch->memguard->num_cpus > 0 &&
+	    ioctl(fd, JAILHOUSE_MEMGUARD_BATCH, batch->memguard) < 0)
+		return -1;
+
+	if (batch->qos && batch->qos->num_settings > 0 &&
+	    ioctl(fd, JAILHOUSE_QOS, batch->qos) < 0)
+		return -1;
+
+	return 0;
+}
+
+int jailhouse_qos_profile_set(int fd, unsigned int id,
+			      const struct jailhouse_batch *batch)
+{
+	unsigned int count = batch->qos ? batch->qos->num_settings : 0;
+	struct qos_profile_args *args;
+	int err;
+
+	args = malloc(sizeof(*args) + count * sizeof(struct qos_setting));
+	if (!args)
+		return -1;
+
+	args->id = id;
+	args->num_settings = count;
+	if (count > 0)
+		memcpy(args->settings, batch->qos->settings,
+		       count * sizeof(struct qos_setting));
+
+	err = ioctl(fd, JAILHOUSE_QOS_PROFILE_SET, args);
+	free(args);
+
+	return err < 0 ? -1 : 0;
+}
+
+int jailhouse_qos_profile_apply(int fd, unsigned int id)
+{
+	return ioctl(fd, JAILHOUSE_QOS_PROFILE_APPLY, id) < 0 ? -1 : 0;
+}
+
+int jailhouse_mode_switch(int fd, const struct jailhouse_batch *batch,
+			  unsigned long long period_us,
+			  unsigned int qos_profile,
+			  const struct mode_switch_cell *cells,
+			  unsigned int num_cells)
+{
+	unsigned int num_cpus = batch->memguard ? batch->memguard->num_cpus : 0;
+	struct memguard_cpu_params *entries;
+	struct mode_switch_args *args;
+	int err;
+
+	if ((batch->qos && batch->qos->num_settings > 0) ||
+	    num_cells > MODE_SWITCH_MAX_CELLS) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	args = malloc(sizeof(*args) +
+		      num_cpus * sizeof(struct memguard_cpu_params) +
+		      num_cells * sizeof(struct mode_switch_cell));
+	if (!args)
+		return -1;
+
+	memset(args, 0, sizeof(*args));
+	args->period_us = period_us;
+	args->num_cpus = num_cpus;
+	args->num_cells = num_cells;
+	args->qos_profile = qos_profile;
+	entries = (struct memguard_cpu_params *)(args + 1);
+	if (num_cpus > 0)
+		memcpy(entries, batch->memguard->cpus,
+		       num_cpus * sizeof(struct memguard_cpu_params));
+	if (num_cells > 0)
+		memcpy(entries + num_cpus, cells,
+		       num_cells * sizeof(struct mode_switch_cell));
+
+	err = ioctl(fd, JAILHOUSE_MODE_SWITCH, args);
+	free(args);
+
+	return err < 0 ? -1 : 0;
+}
+
+int jailhouse_perf_set(int fd, unsigned long long cpus,
+		       unsigned int event_type, unsigned int period)
+{
+	struct perf_args args = {
+		.cpus = cpus,
+		.event_type = event_type,
+		.period = period,
+	};
+
+	return ioctl(fd, JAILHOUSE_PERF, &args) < 0 ? -1 : 0;
+}
+
+int jailhouse_trace_set(int fd, unsigned int events)
+{
+	return ioctl(fd, JAILHOUSE_TRACE, events) < 0 ? -1 : 0;
+}
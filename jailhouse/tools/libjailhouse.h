@@ -0,0 +1,93 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (C) Minerva Systems, 2024
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+/*
+ * Small management library around /dev/jailhouse, for daemons that need to
+ * reconfigure memguard and QoS without spawning the jailhouse tool.
+ *
+ * Settings are collected in a struct jailhouse_batch and then applied with a
+ * single ioctl per kind: JAILHOUSE_MEMGUARD_BATCH for all memguard entries,
+ * JAILHOUSE_QOS for all QoS entries. Functions return 0 on success, -1 with
+ * errno set on errors, like the system calls they wrap.
+ */
+
+#ifndef _LIBJAILHOUSE_H
+#define _LIBJAILHOUSE_H
+
+#include <jailhouse.h>
+
+struct jailhouse_batch {
+	struct jailhouse_memguard_batch *memguard;
+	unsigned int memguard_size;
+	struct jailhouse_qos_args *qos;
+	unsigned int qos_size;
+	/** Device of the last QoS entry */
+	char qos_dev[QOS_DEV_NAMELEN];
+};
+
+/** Open the Jailhouse device, returns its file descriptor or -1. */
+int jailhouse_open(void);
+
+void jailhouse_batch_init(struct jailhouse_batch *batch);
+void jailhouse_batch_free(struct jailhouse_batch *batch);
+/** Drop all entries, keeping the buffers for the next round of settings. */
+void jailhouse_batch_reset(struct jailhouse_batch *batch);
+
+/** Queue the memguard parameters of one CPU. */
+int jailhouse_batch_add_memguard(struct jailhouse_batch *batch,
+				 unsigned int cpu,
+				 const struct memguard_params *params);
+/**
+ * Queue one QoS parameter of a device. The hypervisor programs the enable
+ * register of a device once per consecutive group of its parameters, so
+ * all parameters of a device have to be added in a row.
+ */
+int jailhouse_batch_add_qos(struct jailhouse_batch *batch, const char *dev,
+			    const char *param, unsigned int value);
+
+/** Apply all queued memguard entries, then all queued QoS entries. */
+int jailhouse_batch_apply(int fd, const struct jailhouse_batch *batch);
+
+/**
+ * Register the queued QoS entries as profile id, replacing an older
+ * profile of that id. Without QoS entries, the profile is released.
+ */
+int jailhouse_qos_profile_set(int fd, unsigned int id,
+			      const struct jailhouse_batch *batch);
+/** Apply a registered QoS profile. */
+int jailhouse_qos_profile_apply(int fd, unsigned int id);
+
+/**
+ * Switch modes with one call: recolor \a num_cells cells, then change the
+ * queued memguard entries and QoS profile \a qos_profile (or
+ * MODE_SWITCH_NO_QOS) at the same boundary of \a period_us. Nothing is
+ * changed if any part fails. QoS entries of \a batch are not supported,
+ * they have to be registered as a profile first.
+ */
+int jailhouse_mode_switch(int fd, const struct jailhouse_batch *batch,
+			  unsigned long long period_us,
+			  unsigned int qos_profile,
+			  const struct mode_switch_cell *cells,
+			  unsigned int num_cells);
+
+/**
+ * Sample the guest every \a period PMU events \a event_type (0 for CPU
+ * cycles) on the CPUs of bitmap \a cpus, a period of 0 stops sampling.
+ * The samples are read from /sys/devices/jailhouse/perf_samples.
+ */
+int jailhouse_perf_set(int fd, unsigned long long cpus,
+		       unsigned int event_type, unsigned int period);
+
+/**
+ * Enable the tracepoints of mask \a events (bits TRACE_*), 0 stops tracing.
+ * The records are read from /sys/devices/jailhouse/trace.
+ */
+int jailhouse_trace_set(int fd, unsigned int events);
+
+#endif /* !_LIBJAILHOUSE_H */
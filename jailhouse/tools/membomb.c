@@ -21,6 +21,11 @@
 
 #include <jailhouse/mem-bomb.h>
 
+/* Boards without a compile-time layout need -a */
+#ifndef COMM_PHYS_BASE
+#define COMM_PHYS_BASE		0
+#endif
+
 struct control {
 	unsigned int cmd;
 	unsigned int size;
@@ -57,8 +62,9 @@ static unsigned int get_mem_size(char * mem_str)
 
 static void usage(char *name)
 {
-	printf("Usage: %s -v [-c cpu] [-s size] [-t -m time, memory] [-r] [-w] [-e]\n"
+	printf("Usage: %s -v [-a address] [-c cpu] [-s size] [-t -m time, memory] [-r] [-w] [-e]\n"
 			"\t-v\t verbose\n"
+			"\t-a\t physical base of the control pages (default: board of the build)\n"
 			"\t-c\t cpu (from 1, CPU0 is for root cell)\n"
 			"\t-r\t only read\n"
 			"\t-w\t only writes\n"
@@ -74,6 +80,7 @@ int main(int argc, char **argv)
 	int cpu;
 	unsigned int size, time, memory;
 	unsigned int cmd;
+	unsigned long comm_base = COMM_PHYS_BASE;
 	unsigned long off;
 	int sleep_sec = 0;
 	int mfd;
@@ -84,12 +91,15 @@ int main(int argc, char **argv)
 	time = memory = 0;
 	cpu = -1;
 	cmd = CMD_DO_READS | CMD_DO_WRITES;
-	while ((opt = getopt(argc, argv, "vrwc:s:t:m:e")) != -1) {
+	while ((opt = getopt(argc, argv, "va:rwc:s:t:m:e")) != -1) {
 		switch (opt) {
 			case 'v':
 				cmd |= CMD_VERBOSE;
 				sleep_sec = 1;
 				break;
+			case 'a':
+				comm_base = strtoul(optarg, NULL, 0);
+				break;
 			case 'r':
 				cmd &= ~CMD_DO_WRITES;
 				break;
@@ -121,6 +131,12 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (comm_base == 0) {
+		fprintf(stderr, "Unknown board, provide -a\n");
+		usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
 	mfd = open("/dev/mem", O_RDWR);
 
 	if(mfd < 0) {
@@ -129,7 +145,7 @@ int main(int argc, char **argv)
 	}
 
 	mem = mmap(0, COMM_TOTAL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
-			mfd, COMM_PHYS_BASE);
+			mfd, comm_base);
 
 	if (mem == MAP_FAILED) {
 		perror("Cannot map.");
@@ -19,6 +19,11 @@
 
 #include <jailhouse/mem-bomb.h>
 
+/* Boards without a compile-time layout need -a */
+#ifndef COMM_PHYS_BASE
+#define COMM_PHYS_BASE		0
+#endif
+
 #define DEFAULT_ITER	1000
 
 struct control {
@@ -35,8 +40,9 @@ struct control {
 
 static void usage(char *name)
 {
-	printf("Usage: %s -v [-i iterations] [-n num_cpu] -c col -r row [-t] [-e]\n"
+	printf("Usage: %s -v [-a address] [-i iterations] [-n num_cpu] -c col -r row [-t] [-e]\n"
 			"\t-v\t verbose\n"
+			"\t-a\t physical base of the control pages (default: board of the build)\n"
 			"\t-n\t num_cpu: generate WC load from num_cpu (from CPU1), default all\n"
 			"\t-i\t iterations (default 1000)\n"
 			"\t-c\t col id\n"
@@ -46,7 +52,7 @@ static void usage(char *name)
 			name);
 }
 
-#define OPT_ARGS "vn:i:l:c:r:et"
+#define OPT_ARGS "va:n:i:l:c:r:et"
 int main(int argc, char **argv)
 {
 	int opt;
@@ -55,6 +61,7 @@ int main(int argc, char **argv)
 	int iter;
 	int num_cpu, cpu;
 	unsigned int cmd;
+	unsigned long comm_base = COMM_PHYS_BASE;
 	unsigned long off;
 	int sleep_sec = 0;
 	int mfd;
@@ -71,6 +78,9 @@ int main(int argc, char **argv)
 				cmd |= CMD_VERBOSE;
 				sleep_sec = 1;
 				break;
+			case 'a':
+				comm_base = strtoul(optarg, NULL, 0);
+				break;
 			case 'n':
 				num_cpu = atoi(optarg);
 				if (num_cpu < 0) {
@@ -117,6 +127,12 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	if (comm_base == 0) {
+		fprintf(stderr, "Unknown board, provide -a\n");
+		usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
 	mfd = open("/dev/mem", O_RDWR);
 
 	if(mfd < 0) {
@@ -125,7 +141,7 @@ int main(int argc, char **argv)
 	}
 
 	mem = mmap(0, COMM_TOTAL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
-			mfd, COMM_PHYS_BASE);
+			mfd, comm_base);
 
 	if (mem == MAP_FAILED) {
 		perror("Cannot map.");
@@ -22,11 +22,17 @@
 #include <linux/pci.h>
 #include <linux/io.h>
 #include <linux/bitops.h>
+#include <linux/bpf.h>
+#include <linux/bpf_trace.h>
+#include <linux/filter.h>
 #include <linux/interrupt.h>
 #include <linux/netdevice.h>
 #include <linux/etherdevice.h>
+#include <linux/if_vlan.h>
 #include <linux/rtnetlink.h>
+#include <linux/virtio_net.h>
 #include <linux/virtio_ring.h>
+#include <net/xdp.h>
 
 #define DRV_NAME "ivshmem-net"
 
@@ -50,7 +56,34 @@
 #define IVSHM_NET_MSIX_STATE		0
 #define IVSHM_NET_MSIX_TX_RX		1
 
-#define IVSHM_NET_NUM_VECTORS		2
+#define IVSHM_NET_MAX_QUEUES		8
+
+#define IVSHM_NET_RX_COPYBREAK		256
+
+/* XDP runs on a page-sized copy of the frame, see ivshm_net_rx_xdp */
+#define IVSHM_NET_XDP_MAX_LEN					\
+	(PAGE_SIZE - XDP_PACKET_HEADROOM -			\
+	 SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+#define IVSHM_NET_XDP_MAX_MTU		(IVSHM_NET_XDP_MAX_LEN - VLAN_ETH_HLEN)
+
+#define IVSHM_NET_XDP_TX		BIT(0)
+#define IVSHM_NET_XDP_REDIR		BIT(1)
+
+/*
+ * Features a peer accepts on receive, published in a block at the end of its
+ * output section before it leaves RESET. Any negotiated feature prefixes each
+ * frame with a struct virtio_net_hdr.
+ */
+#define IVSHM_NET_F_CSUM		BIT(0)	/* partial checksums */
+#define IVSHM_NET_F_GSO			BIT(1)	/* TCP segmentation offload */
+
+#define IVSHM_NET_FEATURES_MAGIC	0x5446484e
+#define IVSHM_NET_FEATURES_SIZE		64
+
+struct ivshm_net_features {
+	u32 magic;
+	u32 features;
+};
 
 struct ivshm_net_queue {
 	struct vring vr;
@@ -76,18 +109,46 @@ struct ivshm_net_stats {
 	u32 rx_notify;
 	u32 napi_poll;
 	u32 napi_complete;
+	u32 rx_paged;
+	u32 xdp_drop;
+	u32 xdp_tx;
+	u32 xdp_redirect;
 	u32 napi_poll_n[10];
 };
 
-struct ivshm_net {
+/*
+ * Queue pair i lives in the i-th slice of both output sections and is
+ * signaled via MSI-X vector IVSHM_NET_MSIX_TX_RX + i.
+ */
+struct ivshm_net_qp {
 	struct ivshm_net_queue rx;
 	struct ivshm_net_queue tx;
 
+	struct napi_struct napi;
+	struct xdp_rxq_info xdp_rxq;
+
+	struct ivshm_net_stats stats;
+
+	unsigned int index;
+	u32 tx_rx_vector;
+};
+
+struct ivshm_net {
+	struct ivshm_net_qp qp[IVSHM_NET_MAX_QUEUES];
+	unsigned int num_queues;
+
 	u32 vrsize;
 	u32 qlen;
 	u32 qsize;
 
-	struct napi_struct napi;
+	u32 rx_copybreak;
+
+	/* negotiated with the peer on the way to READY */
+	u32 features;
+	u32 vnet_hdr_len;
+	u32 tx_max_len;
+
+	struct bpf_prog __rcu *xdp_prog;
 
 	struct mutex state_lock;
 	u32 state;
@@ -99,15 +160,11 @@ struct ivshm_net {
 	struct workqueue_struct *state_wq;
 	struct work_struct state_work;
 
-	struct ivshm_net_stats stats;
-
 	struct ivshm_regs __iomem *ivshm_regs;
 	void *shm[2];
 	resource_size_t shmlen;
 	u32 peer_id;
 
-	u32 tx_rx_vector;
-
 	struct pci_dev *pdev;
 };
 
@@ -156,6 +213,9 @@ static void ivshm_net_init_queue(struct ivshm_net *in,
 static void ivshm_net_init_queues(struct net_device *ndev)
 {
 	struct ivshm_net *in = netdev_priv(ndev);
+	u32 slice = in->vrsize + in->qsize;
+	struct ivshm_net_qp *qp;
+	unsigned int q;
 	void *tx;
 	void *rx;
 	int i;
@@ -163,17 +223,22 @@ static void ivshm_net_init_queues(struct net_device *ndev)
 	tx = in->shm[IVSHM_NET_SECTION_TX];
 	rx = in->shm[IVSHM_NET_SECTION_RX];
 
-	memset(tx, 0, in->shmlen);
+	/* keep the feature block the peer may still read */
+	memset(tx, 0, in->shmlen - IVSHM_NET_FEATURES_SIZE);
 
-	ivshm_net_init_queue(in, &in->tx, tx, in->qlen);
-	ivshm_net_init_queue(in, &in->rx, rx, in->qlen);
+	for (q = 0; q < in->num_queues; q++) {
+		qp = &in->qp[q];
 
-	swap(in->rx.vr.used, in->tx.vr.used);
+		ivshm_net_init_queue(in, &qp->tx, tx + q * slice, in->qlen);
+		ivshm_net_init_queue(in, &qp->rx, rx + q * slice, in->qlen);
 
-	in->tx.num_free = in->tx.vr.num;
+		swap(qp->rx.vr.used, qp->tx.vr.used);
 
-	for (i = 0; i < in->tx.vr.num - 1; i++)
-		in->tx.vr.desc[i].next = i + 1;
+		qp->tx.num_free = qp->tx.vr.num;
+
+		for (i = 0; i < qp->tx.vr.num - 1; i++)
+			qp->tx.vr.desc[i].next = i + 1;
+	}
 }
 
 static int ivshm_net_calc_qsize(struct net_device *ndev)
@@ -182,18 +247,26 @@ static int ivshm_net_calc_qsize(struct net_device *ndev)
 	unsigned int vrsize;
 	unsigned int qsize;
 	unsigned int qlen;
+	u32 slice;
+
+	/*
+	 * Each queue pair gets an equal, aligned slice of the sections, minus
+	 * the feature block at their end.
+	 */
+	slice = ALIGN_DOWN((in->shmlen - IVSHM_NET_FEATURES_SIZE) /
+			   in->num_queues, IVSHM_NET_VQ_ALIGN);
 
 	for (qlen = 4096; qlen > 32; qlen >>= 1) {
 		vrsize = vring_size(qlen, IVSHM_NET_VQ_ALIGN);
 		vrsize = ALIGN(vrsize, IVSHM_NET_VQ_ALIGN);
-		if (vrsize < in->shmlen / 8)
+		if (vrsize < slice / 8)
 			break;
 	}
 
-	if (vrsize > in->shmlen)
+	if (vrsize > slice)
 		return -EINVAL;
 
-	qsize = in->shmlen - vrsize;
+	qsize = slice - vrsize;
 
 	if (qsize < 4 * ETH_MIN_MTU)
 		return -EINVAL;
@@ -205,61 +278,120 @@ static int ivshm_net_calc_qsize(struct net_device *ndev)
 	return 0;
 }
 
-static void ivshm_net_notify_tx(struct ivshm_net *in, unsigned int num)
+static struct ivshm_net_features *
+ivshm_net_features_block(struct ivshm_net *in, unsigned int section)
+{
+	return in->shm[section] + in->shmlen - IVSHM_NET_FEATURES_SIZE;
+}
+
+static void ivshm_net_update_tx_max_len(struct net_device *ndev)
+{
+	struct ivshm_net *in = netdev_priv(ndev);
+	u32 len = ndev->mtu;
+
+	if (in->features & IVSHM_NET_F_GSO)
+		len = max(len, ndev->gso_max_size);
+
+	in->tx_max_len = in->vnet_hdr_len + len;
+}
+
+static void ivshm_net_publish_features(struct net_device *ndev)
+{
+	struct ivshm_net *in = netdev_priv(ndev);
+	struct ivshm_net_features *own =
+		ivshm_net_features_block(in, IVSHM_NET_SECTION_TX);
+	u32 features = 0;
+
+	/* XDP programs must see plain frames, without offload hints. */
+	if (ndev->features & NETIF_F_RXCSUM &&
+	    !rcu_access_pointer(in->xdp_prog))
+		features = IVSHM_NET_F_CSUM | IVSHM_NET_F_GSO;
+
+	WRITE_ONCE(own->features, features);
+	virt_wmb();
+	WRITE_ONCE(own->magic, IVSHM_NET_FEATURES_MAGIC);
+}
+
+/* Called once the peer left RESET, i.e. published its features. */
+static void ivshm_net_negotiate_features(struct net_device *ndev)
+{
+	struct ivshm_net *in = netdev_priv(ndev);
+	struct ivshm_net_features *own =
+		ivshm_net_features_block(in, IVSHM_NET_SECTION_TX);
+	struct ivshm_net_features *peer =
+		ivshm_net_features_block(in, IVSHM_NET_SECTION_RX);
+	u32 features = 0;
+
+	virt_rmb();
+	if (READ_ONCE(peer->magic) == IVSHM_NET_FEATURES_MAGIC)
+		features = READ_ONCE(peer->features) & own->features;
+
+	/* segmentation offload implies checksum offload */
+	if (!(features & IVSHM_NET_F_CSUM))
+		features = 0;
+
+	WRITE_ONCE(in->features, features);
+	in->vnet_hdr_len = features ? sizeof(struct virtio_net_hdr) : 0;
+	ivshm_net_update_tx_max_len(ndev);
+}
+
+static void ivshm_net_notify_tx(struct ivshm_net *in, struct ivshm_net_qp *qp,
+				unsigned int num)
 {
 	u16 evt, old, new;
 
 	virt_mb();
 
-	evt = READ_ONCE(vring_avail_event(&in->tx.vr));
-	old = in->tx.last_avail_idx - num;
-	new = in->tx.last_avail_idx;
+	evt = READ_ONCE(vring_avail_event(&qp->tx.vr));
+	old = qp->tx.last_avail_idx - num;
+	new = qp->tx.last_avail_idx;
 
 	if (vring_need_event(evt, new, old)) {
-		writel(in->tx_rx_vector | (in->peer_id << 16),
+		writel(qp->tx_rx_vector | (in->peer_id << 16),
 		       &in->ivshm_regs->doorbell);
-		in->stats.tx_notify++;
+		qp->stats.tx_notify++;
 	}
 }
 
-static void ivshm_net_enable_rx_irq(struct ivshm_net *in)
+static void ivshm_net_enable_rx_irq(struct ivshm_net_qp *qp)
 {
-	vring_avail_event(&in->rx.vr) = in->rx.last_avail_idx;
+	vring_avail_event(&qp->rx.vr) = qp->rx.last_avail_idx;
 	virt_wmb();
 }
 
-static void ivshm_net_notify_rx(struct ivshm_net *in, unsigned int num)
+static void ivshm_net_notify_rx(struct ivshm_net *in, struct ivshm_net_qp *qp,
+				unsigned int num)
 {
 	u16 evt, old, new;
 
 	virt_mb();
 
-	evt = READ_ONCE(vring_used_event(&in->rx.vr));
-	old = in->rx.last_used_idx - num;
-	new = in->rx.last_used_idx;
+	evt = READ_ONCE(vring_used_event(&qp->rx.vr));
+	old = qp->rx.last_used_idx - num;
+	new = qp->rx.last_used_idx;
 
 	if (vring_need_event(evt, new, old)) {
-		writel(in->tx_rx_vector | (in->peer_id << 16),
+		writel(qp->tx_rx_vector | (in->peer_id << 16),
 		       &in->ivshm_regs->doorbell);
-		in->stats.rx_notify++;
+		qp->stats.rx_notify++;
 	}
 }
 
-static void ivshm_net_enable_tx_irq(struct ivshm_net *in)
+static void ivshm_net_enable_tx_irq(struct ivshm_net_qp *qp)
 {
-	vring_used_event(&in->tx.vr) = in->tx.last_used_idx;
+	vring_used_event(&qp->tx.vr) = qp->tx.last_used_idx;
 	virt_wmb();
 }
 
-static bool ivshm_net_rx_avail(struct ivshm_net *in)
+static bool ivshm_net_rx_avail(struct ivshm_net_qp *qp)
 {
 	virt_mb();
-	return READ_ONCE(in->rx.vr.avail->idx) != in->rx.last_avail_idx;
+	return READ_ONCE(qp->rx.vr.avail->idx) != qp->rx.last_avail_idx;
 }
 
-static size_t ivshm_net_tx_space(struct ivshm_net *in)
+static size_t ivshm_net_tx_space(struct ivshm_net_qp *qp)
 {
-	struct ivshm_net_queue *tx = &in->tx;
+	struct ivshm_net_queue *tx = &qp->tx;
 	u32 tail = tx->tail;
 	u32 head = tx->head;
 	u32 space;
@@ -272,12 +404,13 @@ static size_t ivshm_net_tx_space(struct ivshm_net *in)
 	return space;
 }
 
-static bool ivshm_net_tx_ok(struct net_device *ndev)
+static bool ivshm_net_tx_ok(struct net_device *ndev, struct ivshm_net_qp *qp)
 {
 	struct ivshm_net *in = netdev_priv(ndev);
 
-	return in->tx.num_free >= 2 &&
-		ivshm_net_tx_space(in) >= 2 * IVSHM_NET_FRAME_SIZE(ndev->mtu);
+	return qp->tx.num_free >= 2 &&
+		ivshm_net_tx_space(qp) >=
+			2 * IVSHM_NET_FRAME_SIZE(in->tx_max_len);
 }
 
 static u32 ivshm_net_tx_advance(struct ivshm_net_queue *q, u32 *pos, u32 len)
@@ -293,10 +426,11 @@ static u32 ivshm_net_tx_advance(struct ivshm_net_queue *q, u32 *pos, u32 len)
 	return p;
 }
 
-static bool ivshm_net_tx_clean(struct net_device *ndev)
+static bool ivshm_net_tx_clean(struct net_device *ndev,
+			       struct ivshm_net_qp *qp)
 {
 	struct ivshm_net *in = netdev_priv(ndev);
-	struct ivshm_net_queue *tx = &in->tx;
+	struct ivshm_net_queue *tx = &qp->tx;
 	struct vring_used_elem *used;
 	struct vring *vr = &tx->vr;
 	struct vring_desc *desc;
@@ -324,7 +458,7 @@ static bool ivshm_net_tx_clean(struct net_device *ndev)
 
 		desc = &vr->desc[used->id];
 
-		data = ivshm_net_desc_data(in, &in->tx, IVSHM_NET_SECTION_TX,
+		data = ivshm_net_desc_data(in, tx, IVSHM_NET_SECTION_TX,
 					   desc, &len);
 		if (!data) {
 			netdev_err(ndev, "bad tx descriptor, data == NULL\n");
@@ -349,38 +483,38 @@ static bool ivshm_net_tx_clean(struct net_device *ndev)
 		tx->num_free++;
 		BUG_ON(tx->num_free > vr->num);
 
-		tx_ok = ivshm_net_tx_ok(ndev);
+		tx_ok = ivshm_net_tx_ok(ndev, qp);
 		if (!tx_ok)
-			ivshm_net_enable_tx_irq(in);
+			ivshm_net_enable_tx_irq(qp);
 	}
 
 	if (num) {
 		fdesc->next = tx->free_head;
 		tx->free_head = fhead;
 	} else {
-		tx_ok = ivshm_net_tx_ok(ndev);
+		tx_ok = ivshm_net_tx_ok(ndev, qp);
 	}
 
 	return tx_ok;
 }
 
-static void ivshm_net_tx_poll(struct net_device *ndev)
+static void ivshm_net_tx_poll(struct net_device *ndev, struct ivshm_net_qp *qp)
 {
-	struct netdev_queue *txq = netdev_get_tx_queue(ndev, 0);
+	struct netdev_queue *txq = netdev_get_tx_queue(ndev, qp->index);
 
 	if (!__netif_tx_trylock(txq))
 		return;
 
-	if (ivshm_net_tx_clean(ndev) && netif_queue_stopped(ndev))
-		netif_wake_queue(ndev);
+	if (ivshm_net_tx_clean(ndev, qp) && netif_tx_queue_stopped(txq))
+		netif_tx_wake_queue(txq);
 
 	__netif_tx_unlock(txq);
 }
 
-static struct vring_desc *ivshm_net_rx_desc(struct net_device *ndev)
+static struct vring_desc *ivshm_net_rx_desc(struct net_device *ndev,
+					    struct ivshm_net_qp *qp)
 {
-	struct ivshm_net *in = netdev_priv(ndev);
-	struct ivshm_net_queue *rx = &in->rx;
+	struct ivshm_net_queue *rx = &qp->rx;
 	struct vring *vr = &rx->vr;
 	unsigned int avail;
 	u16 avail_idx;
@@ -399,9 +533,10 @@ static struct vring_desc *ivshm_net_rx_desc(struct net_device *ndev)
 	return &vr->desc[avail];
 }
 
-static void ivshm_net_rx_finish(struct ivshm_net *in, struct vring_desc *desc)
+static void ivshm_net_rx_finish(struct ivshm_net_qp *qp,
+				struct vring_desc *desc)
 {
-	struct ivshm_net_queue *rx = &in->rx;
+	struct ivshm_net_queue *rx = &qp->rx;
 	struct vring *vr = &rx->vr;
 	unsigned int desc_id = desc - vr->desc;
 	unsigned int used;
@@ -413,15 +548,289 @@ static void ivshm_net_rx_finish(struct ivshm_net *in, struct vring_desc *desc)
 	virt_store_release(&vr->used->idx, rx->last_used_idx);
 }
 
+/*
+ * Frames up to rx_copybreak are copied into a linear skb. Larger ones only
+ * get their headers copied into the linear part, the payload is copied into
+ * page fragments. This avoids high-order allocations for jumbo frames and
+ * keeps GRO working on the headers only.
+ */
+static struct sk_buff *ivshm_net_rx_skb(struct ivshm_net *in,
+					struct ivshm_net_qp *qp,
+					void *data, u32 len)
+{
+	struct napi_struct *napi = &qp->napi;
+	u32 hlen, chunk, off;
+	struct sk_buff *skb;
+	struct page *page;
+	void *frag;
+
+	if (len <= READ_ONCE(in->rx_copybreak)) {
+		skb = napi_alloc_skb(napi, len);
+		if (skb)
+			skb_put_data(skb, data, len);
+		return skb;
+	}
+
+	hlen = eth_get_headlen(napi->dev, data,
+			       min_t(u32, len, IVSHM_NET_RX_COPYBREAK));
+
+	skb = napi_alloc_skb(napi, hlen);
+	if (!skb)
+		return NULL;
+
+	skb_put_data(skb, data, hlen);
+
+	for (off = hlen; off < len; off += chunk) {
+		chunk = min_t(u32, len - off, PAGE_SIZE);
+
+		frag = skb_shinfo(skb)->nr_frags < MAX_SKB_FRAGS ?
+			napi_alloc_frag(chunk) : NULL;
+		if (!frag) {
+			dev_kfree_skb_any(skb);
+			return NULL;
+		}
+
+		memcpy(frag, data + off, chunk);
+
+		page = virt_to_head_page(frag);
+		skb_add_rx_frag(skb, skb_shinfo(skb)->nr_frags, page,
+				frag - page_address(page), chunk,
+				SKB_DATA_ALIGN(chunk));
+	}
+
+	qp->stats.rx_paged++;
+
+	return skb;
+}
+
+/* Claims a descriptor and ring space, the caller checked ivshm_net_tx_ok. */
+static void *ivshm_net_tx_get(struct ivshm_net_qp *qp, u32 len,
+			      unsigned int *desc_idx)
+{
+	struct ivshm_net_queue *tx = &qp->tx;
+	struct vring_desc *desc;
+	u32 head;
+
+	*desc_idx = tx->free_head;
+	desc = &tx->vr.desc[*desc_idx];
+	tx->free_head = desc->next;
+	tx->num_free--;
+
+	head = ivshm_net_tx_advance(tx, &tx->head, len);
+
+	return tx->data + head;
+}
+
+static void ivshm_net_tx_put(struct ivshm_net *in, struct ivshm_net_qp *qp,
+			     unsigned int desc_idx, void *buf, u32 len)
+{
+	struct ivshm_net_queue *tx = &qp->tx;
+	struct vring *vr = &tx->vr;
+	struct vring_desc *desc = &vr->desc[desc_idx];
+	unsigned int avail;
+
+	desc->addr = buf - in->shm[IVSHM_NET_SECTION_TX];
+	desc->len = len;
+	desc->flags = 0;
+
+	avail = tx->last_avail_idx++ & (vr->num - 1);
+	vr->avail->ring[avail] = desc_idx;
+	tx->num_added++;
+
+	virt_store_release(&vr->avail->idx, tx->last_avail_idx);
+}
+
+/*
+ * Copies an XDP frame into the tx ring of the given queue pair, the caller
+ * holds the lock of txq. The frame remains owned by the caller.
+ */
+static int ivshm_net_xdp_tx_frame(struct net_device *ndev,
+				  struct ivshm_net_qp *qp,
+				  struct netdev_queue *txq,
+				  struct xdp_frame *xdpf)
+{
+	struct ivshm_net *in = netdev_priv(ndev);
+	u32 hdr_len = in->vnet_hdr_len;
+	u32 len = hdr_len + xdpf->len;
+	unsigned int desc_idx;
+	void *buf;
+
+	if (len > in->tx_max_len)
+		return -EMSGSIZE;
+
+	if (!ivshm_net_tx_clean(ndev, qp))
+		return -ENOSPC;
+
+	buf = ivshm_net_tx_get(qp, len, &desc_idx);
+	memset(buf, 0, hdr_len);
+	memcpy(buf + hdr_len, xdpf->data, xdpf->len);
+	ivshm_net_tx_put(in, qp, desc_idx, buf, len);
+
+	if (!ivshm_net_tx_ok(ndev, qp)) {
+		ivshm_net_enable_tx_irq(qp);
+		netif_tx_stop_queue(txq);
+		qp->stats.tx_pause++;
+	}
+
+	return 0;
+}
+
+static int ivshm_net_xdp_xmit(struct net_device *ndev, int n,
+			      struct xdp_frame **frames, u32 flags)
+{
+	struct ivshm_net *in = netdev_priv(ndev);
+	unsigned int cpu = smp_processor_id();
+	struct ivshm_net_qp *qp = &in->qp[cpu % in->num_queues];
+	struct netdev_queue *txq = netdev_get_tx_queue(ndev, qp->index);
+	int drops = 0;
+	int i;
+
+	if (unlikely(flags & ~XDP_XMIT_FLAGS_MASK))
+		return -EINVAL;
+
+	if (!test_bit(IVSHM_NET_FLAG_RUN, &in->flags))
+		return -ENETDOWN;
+
+	__netif_tx_lock(txq, cpu);
+
+	/* Frames are copied into the ring, thus can be returned right away. */
+	for (i = 0; i < n; i++) {
+		if (ivshm_net_xdp_tx_frame(ndev, qp, txq, frames[i]))
+			drops++;
+		xdp_return_frame_rx_napi(frames[i]);
+	}
+
+	if (flags & XDP_XMIT_FLUSH) {
+		ivshm_net_notify_tx(in, qp, qp->tx.num_added);
+		qp->tx.num_added = 0;
+	}
+
+	__netif_tx_unlock(txq);
+
+	qp->stats.xdp_tx += n - drops;
+
+	return n - drops;
+}
+
+/*
+ * The shared memory has no struct pages, so the program runs on a copy of the
+ * frame in a fresh page. On XDP_PASS, this page becomes the skb.
+ */
+static struct sk_buff *ivshm_net_rx_xdp(struct ivshm_net_qp *qp,
+					struct bpf_prog *prog, void *data,
+					u32 len, unsigned int *xdp_done)
+{
+	struct net_device *ndev = qp->napi.dev;
+	struct netdev_queue *txq;
+	struct xdp_frame *xdpf;
+	struct xdp_buff xdp;
+	struct sk_buff *skb;
+	struct page *page;
+	int err;
+	u32 act;
+
+	if (len > IVSHM_NET_XDP_MAX_LEN)
+		goto drop;
+
+	page = dev_alloc_page();
+	if (!page)
+		goto drop;
+
+	xdp.data_hard_start = page_address(page);
+	xdp.data = xdp.data_hard_start + XDP_PACKET_HEADROOM;
+	xdp.data_end = xdp.data + len;
+	xdp_set_data_meta_invalid(&xdp);
+	xdp.rxq = &qp->xdp_rxq;
+	xdp.frame_sz = PAGE_SIZE;
+	memcpy(xdp.data, data, len);
+
+	act = bpf_prog_run_xdp(prog, &xdp);
+	switch (act) {
+	case XDP_PASS:
+		skb = build_skb(xdp.data_hard_start, PAGE_SIZE);
+		if (!skb)
+			break;
+		skb_reserve(skb, xdp.data - xdp.data_hard_start);
+		skb_put(skb, xdp.data_end - xdp.data);
+		return skb;
+	case XDP_TX:
+		xdpf = xdp_convert_buff_to_frame(&xdp);
+		if (unlikely(!xdpf)) {
+			trace_xdp_exception(ndev, prog, act);
+			break;
+		}
+
+		txq = netdev_get_tx_queue(ndev, qp->index);
+		__netif_tx_lock(txq, smp_processor_id());
+		err = ivshm_net_xdp_tx_frame(ndev, qp, txq, xdpf);
+		__netif_tx_unlock(txq);
+
+		xdp_return_frame_rx_napi(xdpf);
+		if (err) {
+			trace_xdp_exception(ndev, prog, act);
+			goto drop;
+		}
+		*xdp_done |= IVSHM_NET_XDP_TX;
+		qp->stats.xdp_tx++;
+		return NULL;
+	case XDP_REDIRECT:
+		if (xdp_do_redirect(ndev, &xdp, prog))
+			break;
+		*xdp_done |= IVSHM_NET_XDP_REDIR;
+		qp->stats.xdp_redirect++;
+		return NULL;
+	default:
+		bpf_warn_invalid_xdp_action(act);
+		fallthrough;
+	case XDP_ABORTED:
+		trace_xdp_exception(ndev, prog, act);
+		fallthrough;
+	case XDP_DROP:
+		break;
+	}
+
+	put_page(page);
+drop:
+	qp->stats.xdp_drop++;
+	return NULL;
+}
+
+static void ivshm_net_xdp_finish(struct net_device *ndev,
+				 struct ivshm_net_qp *qp,
+				 unsigned int xdp_done)
+{
+	struct ivshm_net *in = netdev_priv(ndev);
+	struct netdev_queue *txq;
+
+	if (xdp_done & IVSHM_NET_XDP_REDIR)
+		xdp_do_flush();
+
+	if (xdp_done & IVSHM_NET_XDP_TX) {
+		txq = netdev_get_tx_queue(ndev, qp->index);
+		__netif_tx_lock(txq, smp_processor_id());
+		ivshm_net_notify_tx(in, qp, qp->tx.num_added);
+		qp->tx.num_added = 0;
+		__netif_tx_unlock(txq);
+	}
+}
+
 static int ivshm_net_poll(struct napi_struct *napi, int budget)
 {
 	struct net_device *ndev = napi->dev;
-	struct ivshm_net *in = container_of(napi, struct ivshm_net, napi);
+	struct ivshm_net *in = netdev_priv(ndev);
+	struct ivshm_net_qp *qp = container_of(napi, struct ivshm_net_qp, napi);
+	u32 hdr_len = in->vnet_hdr_len;
+	struct virtio_net_hdr hdr;
+	unsigned int xdp_done = 0;
+	struct bpf_prog *prog;
 	int received = 0;
 
-	in->stats.napi_poll++;
+	qp->stats.napi_poll++;
+
+	rcu_read_lock();
+	prog = rcu_dereference(in->xdp_prog);
 
-	ivshm_net_tx_poll(ndev);
+	ivshm_net_tx_poll(ndev, qp);
 
 	while (received < budget) {
 		struct vring_desc *desc;
@@ -429,101 +838,136 @@ static int ivshm_net_poll(struct napi_struct *napi, int budget)
 		void *data;
 		u32 len;
 
-		desc = ivshm_net_rx_desc(ndev);
+		desc = ivshm_net_rx_desc(ndev, qp);
 		if (!desc)
 			break;
 
-		data = ivshm_net_desc_data(in, &in->rx, IVSHM_NET_SECTION_RX,
+		data = ivshm_net_desc_data(in, &qp->rx, IVSHM_NET_SECTION_RX,
 					   desc, &len);
-		if (!data) {
+		if (!data || len < hdr_len) {
 			netdev_err(ndev, "bad rx descriptor\n");
 			break;
 		}
 
-		skb = napi_alloc_skb(napi, len);
+		if (hdr_len) {
+			memcpy(&hdr, data, sizeof(hdr));
+			data += hdr_len;
+			len -= hdr_len;
+		}
+
+		if (prog)
+			skb = ivshm_net_rx_xdp(qp, prog, data, len, &xdp_done);
+		else
+			skb = ivshm_net_rx_skb(in, qp, data, len);
+
+		if (skb && hdr_len && virtio_net_hdr_to_skb(skb, &hdr, true)) {
+			netdev_err(ndev, "invalid offload header\n");
+			dev_kfree_skb_any(skb);
+			skb = NULL;
+			ndev->stats.rx_frame_errors++;
+		}
 
 		if (skb) {
-			memcpy(skb_put(skb, len), data, len);
 			skb->protocol = eth_type_trans(skb, ndev);
+			skb_record_rx_queue(skb, qp->index);
 			napi_gro_receive(napi, skb);
 		}
 
 		ndev->stats.rx_packets++;
 		ndev->stats.rx_bytes += len;
 
-		ivshm_net_rx_finish(in, desc);
+		ivshm_net_rx_finish(qp, desc);
 		received++;
 	}
 
+	rcu_read_unlock();
+
+	if (xdp_done)
+		ivshm_net_xdp_finish(ndev, qp, xdp_done);
+
 	if (received < budget) {
-		in->stats.napi_complete++;
+		qp->stats.napi_complete++;
 		napi_complete_done(napi, received);
-		ivshm_net_enable_rx_irq(in);
-		if (ivshm_net_rx_avail(in))
+		ivshm_net_enable_rx_irq(qp);
+		if (ivshm_net_rx_avail(qp))
 			napi_schedule(napi);
 	}
 
 	if (received)
-		ivshm_net_notify_rx(in, received);
+		ivshm_net_notify_rx(in, qp, received);
 
-	in->stats.rx_packets += received;
-	in->stats.napi_poll_n[received ? 1 + min(ilog2(received), 8) : 0]++;
+	qp->stats.rx_packets += received;
+	qp->stats.napi_poll_n[received ? 1 + min(ilog2(received), 8) : 0]++;
 
 	return received;
 }
 
+static u16 ivshm_net_select_queue(struct net_device *ndev, struct sk_buff *skb,
+				  struct net_device *sb_dev)
+{
+	/*
+	 * Spread flows over the queue pairs like RSS would: the peer receives
+	 * on the queue of the same index, which has its own vector and thus
+	 * its own CPU.
+	 */
+	return reciprocal_scale(skb_get_hash(skb), ndev->real_num_tx_queues);
+}
+
 static netdev_tx_t ivshm_net_xmit(struct sk_buff *skb, struct net_device *ndev)
 {
 	struct ivshm_net *in = netdev_priv(ndev);
-	struct ivshm_net_queue *tx = &in->tx;
+	u16 queue = skb_get_queue_mapping(skb);
+	struct netdev_queue *txq = netdev_get_tx_queue(ndev, queue);
+	struct ivshm_net_qp *qp = &in->qp[queue];
+	struct ivshm_net_queue *tx = &qp->tx;
 	bool xmit_more = netdev_xmit_more();
-	struct vring *vr = &tx->vr;
-	struct vring_desc *desc;
+	u32 hdr_len = in->vnet_hdr_len;
+	struct virtio_net_hdr hdr;
 	unsigned int desc_idx;
-	unsigned int avail;
-	u32 head;
 	void *buf;
 
-	if (!ivshm_net_tx_clean(ndev)) {
-		netif_stop_queue(ndev);
+	/* The peer may have been renegotiated without offloads meanwhile. */
+	if ((skb_is_gso(skb) && !(in->features & IVSHM_NET_F_GSO)) ||
+	    (hdr_len && virtio_net_hdr_from_skb(skb, &hdr, true, false, 0))) {
+		ndev->stats.tx_dropped++;
+		dev_kfree_skb_any(skb);
+		return NETDEV_TX_OK;
+	}
+
+	if (!ivshm_net_tx_clean(ndev, qp)) {
+		netif_tx_stop_queue(txq);
 
 		netdev_err(ndev, "BUG: tx ring full when queue awake!\n");
 		return NETDEV_TX_BUSY;
 	}
 
-	desc_idx = tx->free_head;
-	desc = &vr->desc[desc_idx];
-	tx->free_head = desc->next;
-	tx->num_free--;
+	buf = ivshm_net_tx_get(qp, hdr_len + skb->len, &desc_idx);
 
-	head = ivshm_net_tx_advance(tx, &tx->head, skb->len);
-
-	if (!ivshm_net_tx_ok(ndev)) {
-		ivshm_net_enable_tx_irq(in);
-		netif_stop_queue(ndev);
+	if (!ivshm_net_tx_ok(ndev, qp)) {
+		ivshm_net_enable_tx_irq(qp);
+		netif_tx_stop_queue(txq);
 		xmit_more = false;
-		in->stats.tx_pause++;
+		qp->stats.tx_pause++;
 	}
 
-	buf = tx->data + head;
-	skb_copy_and_csum_dev(skb, buf);
-
-	desc->addr = buf - in->shm[IVSHM_NET_SECTION_TX];
-	desc->len = skb->len;
-	desc->flags = 0;
-
-	avail = tx->last_avail_idx++ & (vr->num - 1);
-	vr->avail->ring[avail] = desc_idx;
-	tx->num_added++;
+	if (hdr_len) {
+		memcpy(buf, &hdr, hdr_len);
+		buf += hdr_len;
+	}
 
-	virt_store_release(&vr->avail->idx, tx->last_avail_idx);
+	/* A negotiated header carries the checksum hint of partial skbs. */
+	if (hdr_len && skb->ip_summed == CHECKSUM_PARTIAL)
+		skb_copy_bits(skb, 0, buf, skb->len);
+	else
+		skb_copy_and_csum_dev(skb, buf);
+	ivshm_net_tx_put(in, qp, desc_idx, buf - hdr_len, hdr_len + skb->len);
 
 	if (!xmit_more) {
-		ivshm_net_notify_tx(in, tx->num_added);
+		ivshm_net_notify_tx(in, qp, tx->num_added);
 		tx->num_added = 0;
 	}
 
-	in->stats.tx_packets++;
+	qp->stats.tx_packets++;
 	ndev->stats.tx_packets++;
 	ndev->stats.tx_bytes += skb->len;
 
@@ -542,6 +986,7 @@ static void ivshm_net_set_state(struct ivshm_net *in, u32 state)
 static void ivshm_net_run(struct net_device *ndev)
 {
 	struct ivshm_net *in = netdev_priv(ndev);
+	unsigned int q;
 
 	if (in->state < IVSHM_NET_STATE_READY)
 		return;
@@ -555,15 +1000,18 @@ static void ivshm_net_run(struct net_device *ndev)
 	if (test_and_set_bit(IVSHM_NET_FLAG_RUN, &in->flags))
 		return;
 
-	netif_start_queue(ndev);
-	napi_enable(&in->napi);
-	napi_schedule(&in->napi);
+	netif_tx_start_all_queues(ndev);
+	for (q = 0; q < in->num_queues; q++) {
+		napi_enable(&in->qp[q].napi);
+		napi_schedule(&in->qp[q].napi);
+	}
 	ivshm_net_set_state(in, IVSHM_NET_STATE_RUN);
 }
 
 static void ivshm_net_do_stop(struct net_device *ndev)
 {
 	struct ivshm_net *in = netdev_priv(ndev);
+	unsigned int q;
 
 	ivshm_net_set_state(in, IVSHM_NET_STATE_RESET);
 
@@ -571,14 +1019,15 @@ static void ivshm_net_do_stop(struct net_device *ndev)
 		return;
 
 	netif_carrier_off(ndev);
-	netif_stop_queue(ndev);
-	napi_disable(&in->napi);
+	netif_tx_stop_all_queues(ndev);
+	for (q = 0; q < in->num_queues; q++)
+		napi_disable(&in->qp[q].napi);
 }
 
 static void ivshm_net_state_change(struct work_struct *work)
 {
 	struct ivshm_net *in = container_of(work, struct ivshm_net, state_work);
-	struct net_device *ndev = in->napi.dev;
+	struct net_device *ndev = in->qp[0].napi.dev;
 	u32 peer_state = READ_ONCE(in->state_table[in->peer_id]);
 
 	mutex_lock(&in->state_lock);
@@ -596,8 +1045,10 @@ static void ivshm_net_state_change(struct work_struct *work)
 		 * Wait for the remote to leave READY/RUN before transitioning
 		 * to INIT.
 		 */
-		if (peer_state < IVSHM_NET_STATE_READY)
+		if (peer_state < IVSHM_NET_STATE_READY) {
+			ivshm_net_publish_features(ndev);
 			ivshm_net_set_state(in, IVSHM_NET_STATE_INIT);
+		}
 		break;
 
 	case IVSHM_NET_STATE_INIT:
@@ -606,12 +1057,14 @@ static void ivshm_net_state_change(struct work_struct *work)
 		 * initialization and moving to READY.
 		 */
 		if (peer_state > IVSHM_NET_STATE_RESET) {
+			ivshm_net_negotiate_features(ndev);
 			ivshm_net_init_queues(ndev);
 			ivshm_net_set_state(in, IVSHM_NET_STATE_READY);
 
 			mutex_unlock(&in->state_lock);
 
 			rtnl_lock();
+			netdev_update_features(ndev);
 			call_netdevice_notifiers(NETDEV_CHANGEADDR, ndev);
 			rtnl_unlock();
 
@@ -656,19 +1109,21 @@ static irqreturn_t ivshm_net_int_state(int irq, void *data)
 
 static irqreturn_t ivshm_net_int_tx_rx(int irq, void *data)
 {
-	struct ivshm_net *in = data;
+	struct ivshm_net_qp *qp = data;
 
-	in->stats.tx_rx_interrupts++;
+	qp->stats.tx_rx_interrupts++;
 
-	napi_schedule_irqoff(&in->napi);
+	napi_schedule_irqoff(&qp->napi);
 
 	return IRQ_HANDLED;
 }
 
 static irqreturn_t ivshm_net_intx(int irq, void *data)
 {
-	ivshm_net_int_state(irq, data);
-	ivshm_net_int_tx_rx(irq, data);
+	struct ivshm_net *in = data;
+
+	ivshm_net_int_state(irq, in);
+	ivshm_net_int_tx_rx(irq, &in->qp[0]);
 
 	return IRQ_HANDLED;
 }
@@ -702,22 +1157,79 @@ static int ivshm_net_stop(struct net_device *ndev)
 
 static int ivshm_net_change_mtu(struct net_device *ndev, int mtu)
 {
+	struct ivshm_net *in = netdev_priv(ndev);
+
 	if (netif_running(ndev)) {
 		netdev_err(ndev, "must be stopped to change its MTU\n");
 		return -EBUSY;
 	}
 
+	if (rtnl_dereference(in->xdp_prog) && mtu > IVSHM_NET_XDP_MAX_MTU) {
+		netdev_err(ndev, "MTU too large for XDP\n");
+		return -EINVAL;
+	}
+
 	ndev->mtu = mtu;
+	ivshm_net_update_tx_max_len(ndev);
+
+	return 0;
+}
+
+static netdev_features_t ivshm_net_fix_features(struct net_device *ndev,
+						netdev_features_t features)
+{
+	struct ivshm_net *in = netdev_priv(ndev);
+
+	if (!(READ_ONCE(in->features) & IVSHM_NET_F_GSO))
+		features &= ~NETIF_F_ALL_TSO;
+
+	return features;
+}
+
+static int ivshm_net_xdp_set(struct net_device *ndev, struct bpf_prog *prog,
+			     struct netlink_ext_ack *extack)
+{
+	struct ivshm_net *in = netdev_priv(ndev);
+	struct bpf_prog *old_prog;
+
+	if (prog && ndev->mtu > IVSHM_NET_XDP_MAX_MTU) {
+		NL_SET_ERR_MSG_MOD(extack, "MTU too large for XDP");
+		return -EINVAL;
+	}
+
+	if (prog && in->features) {
+		NL_SET_ERR_MSG_MOD(extack, "Offloads negotiated with the peer, "
+				   "disable rx-checksumming and reset the link "
+				   "first");
+		return -EOPNOTSUPP;
+	}
+
+	old_prog = rtnl_dereference(in->xdp_prog);
+	rcu_assign_pointer(in->xdp_prog, prog);
+	if (old_prog)
+		bpf_prog_put(old_prog);
 
 	return 0;
 }
 
+static int ivshm_net_bpf(struct net_device *ndev, struct netdev_bpf *bpf)
+{
+	switch (bpf->command) {
+	case XDP_SETUP_PROG:
+		return ivshm_net_xdp_set(ndev, bpf->prog, bpf->extack);
+	default:
+		return -EINVAL;
+	}
+}
+
 #ifdef CONFIG_NET_POLL_CONTROLLER
 static void ivshm_net_poll_controller(struct net_device *ndev)
 {
 	struct ivshm_net *in = netdev_priv(ndev);
+	unsigned int q;
 
-	napi_schedule(&in->napi);
+	for (q = 0; q < in->num_queues; q++)
+		napi_schedule(&in->qp[q].napi);
 }
 #endif
 
@@ -725,9 +1237,13 @@ static const struct net_device_ops ivshm_net_ops = {
 	.ndo_open		= ivshm_net_open,
 	.ndo_stop		= ivshm_net_stop,
 	.ndo_start_xmit		= ivshm_net_xmit,
+	.ndo_select_queue	= ivshm_net_select_queue,
 	.ndo_change_mtu		= ivshm_net_change_mtu,
+	.ndo_fix_features	= ivshm_net_fix_features,
 	.ndo_set_mac_address 	= eth_mac_addr,
 	.ndo_validate_addr	= eth_validate_addr,
+	.ndo_bpf		= ivshm_net_bpf,
+	.ndo_xdp_xmit		= ivshm_net_xdp_xmit,
 #ifdef CONFIG_NET_POLL_CONTROLLER
 	.ndo_poll_controller	= ivshm_net_poll_controller,
 #endif
@@ -742,6 +1258,10 @@ static const char ivshm_net_stats[][ETH_GSTRING_LEN] = {
 	"rx_notify",
 	"napi_poll",
 	"napi_complete",
+	"rx_paged",
+	"xdp_drop",
+	"xdp_tx",
+	"xdp_redirect",
 	"napi_poll_0",
 	"napi_poll_1",
 	"napi_poll_2",
@@ -774,36 +1294,53 @@ static void ivshm_net_get_ethtool_stats(struct net_device *ndev,
 					struct ethtool_stats *estats, u64 *st)
 {
 	struct ivshm_net *in = netdev_priv(ndev);
-	unsigned int n = 0;
-	unsigned int i;
-
-	st[n++] = in->stats.tx_rx_interrupts;
-	st[n++] = in->stats.tx_packets;
-	st[n++] = in->stats.tx_notify;
-	st[n++] = in->stats.tx_pause;
-	st[n++] = in->stats.rx_packets;
-	st[n++] = in->stats.rx_notify;
-	st[n++] = in->stats.napi_poll;
-	st[n++] = in->stats.napi_complete;
-
-	for (i = 0; i < ARRAY_SIZE(in->stats.napi_poll_n); i++)
-		st[n++] = in->stats.napi_poll_n[i];
-
-	memset(&in->stats, 0, sizeof(in->stats));
+	struct ivshm_net_stats *stats;
+	unsigned int n, i, q;
+
+	memset(st, 0, NUM_STATS * sizeof(*st));
+
+	/* Totals over all queue pairs */
+	for (q = 0; q < in->num_queues; q++) {
+		stats = &in->qp[q].stats;
+		n = 0;
+
+		st[n++] += stats->tx_rx_interrupts;
+		st[n++] += stats->tx_packets;
+		st[n++] += stats->tx_notify;
+		st[n++] += stats->tx_pause;
+		st[n++] += stats->rx_packets;
+		st[n++] += stats->rx_notify;
+		st[n++] += stats->napi_poll;
+		st[n++] += stats->napi_complete;
+		st[n++] += stats->rx_paged;
+		st[n++] += stats->xdp_drop;
+		st[n++] += stats->xdp_tx;
+		st[n++] += stats->xdp_redirect;
+
+		for (i = 0; i < ARRAY_SIZE(stats->napi_poll_n); i++)
+			st[n++] += stats->napi_poll_n[i];
+
+		memset(stats, 0, sizeof(*stats));
+	}
 }
 
-#define IVSHM_NET_REGS_LEN	(3 * sizeof(u32) + 6 * sizeof(u16))
+#define IVSHM_NET_REGS_LEN(queues)	\
+	(3 * sizeof(u32) + 6 * sizeof(u16) * (queues))
 
 static int ivshm_net_get_regs_len(struct net_device *ndev)
 {
-	return IVSHM_NET_REGS_LEN;
+	struct ivshm_net *in = netdev_priv(ndev);
+
+	return IVSHM_NET_REGS_LEN(in->num_queues);
 }
 
 static void ivshm_net_get_regs(struct net_device *ndev,
 			       struct ethtool_regs *regs, void *p)
 {
 	struct ivshm_net *in = netdev_priv(ndev);
+	struct ivshm_net_qp *qp;
 	u32 *reg32 = p;
+	unsigned int q;
 	u16 *reg16;
 
 	*reg32++ = in->state;
@@ -812,13 +1349,48 @@ static void ivshm_net_get_regs(struct net_device *ndev,
 
 	reg16 = (u16 *)reg32;
 
-	*reg16++ = in->tx.vr.avail ? in->tx.vr.avail->idx : 0;
-	*reg16++ = in->tx.vr.used ? in->tx.vr.used->idx : 0;
-	*reg16++ = in->tx.vr.avail ? vring_avail_event(&in->tx.vr) : 0;
+	for (q = 0; q < in->num_queues; q++) {
+		qp = &in->qp[q];
+
+		*reg16++ = qp->tx.vr.avail ? qp->tx.vr.avail->idx : 0;
+		*reg16++ = qp->tx.vr.used ? qp->tx.vr.used->idx : 0;
+		*reg16++ = qp->tx.vr.avail ?
+			vring_avail_event(&qp->tx.vr) : 0;
+
+		*reg16++ = qp->rx.vr.avail ? qp->rx.vr.avail->idx : 0;
+		*reg16++ = qp->rx.vr.used ? qp->rx.vr.used->idx : 0;
+		*reg16++ = qp->rx.vr.avail ?
+			vring_avail_event(&qp->rx.vr) : 0;
+	}
+}
+
+static int ivshm_net_get_tunable(struct net_device *ndev,
+				 const struct ethtool_tunable *tuna, void *data)
+{
+	struct ivshm_net *in = netdev_priv(ndev);
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		*(u32 *)data = in->rx_copybreak;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int ivshm_net_set_tunable(struct net_device *ndev,
+				 const struct ethtool_tunable *tuna,
+				 const void *data)
+{
+	struct ivshm_net *in = netdev_priv(ndev);
 
-	*reg16++ = in->rx.vr.avail ? in->rx.vr.avail->idx : 0;
-	*reg16++ = in->rx.vr.used ? in->rx.vr.used->idx : 0;
-	*reg16++ = in->rx.vr.avail ? vring_avail_event(&in->rx.vr) : 0;
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		WRITE_ONCE(in->rx_copybreak, *(u32 *)data);
+		return 0;
+	default:
+		return -EINVAL;
+	}
 }
 
 static const struct ethtool_ops ivshm_net_ethtool_ops = {
@@ -827,6 +1399,8 @@ static const struct ethtool_ops ivshm_net_ethtool_ops = {
 	.get_ethtool_stats	= ivshm_net_get_ethtool_stats,
 	.get_regs_len		= ivshm_net_get_regs_len,
 	.get_regs		= ivshm_net_get_regs,
+	.get_tunable		= ivshm_net_get_tunable,
+	.set_tunable		= ivshm_net_set_tunable,
 };
 
 static u64 get_config_qword(struct pci_dev *pdev, unsigned int pos)
@@ -844,13 +1418,17 @@ static int ivshm_net_probe(struct pci_dev *pdev,
 	phys_addr_t output_sections_addr, section_addr;
 	resource_size_t section_sz, output_section_sz;
 	void *state_table, *output_sections;
+	struct irq_affinity affd = { .pre_vectors = IVSHM_NET_MSIX_TX_RX };
+	unsigned int cap_pos, num_queues, q;
 	struct ivshm_regs __iomem *regs;
 	struct net_device *ndev;
+	struct ivshm_net_qp *qp;
 	struct ivshm_net *in;
-	unsigned int cap_pos;
 	char *device_name;
+	unsigned long remap_flags;
 	int vendor_cap;
 	u32 id, dword;
+	u8 priv_cntl;
 	int ret;
 
 	ret = pcim_enable_device(pdev);
@@ -924,11 +1502,28 @@ static int ivshm_net_probe(struct pci_dev *pdev,
 				     output_section_sz * 2, DRV_NAME))
 		return -EBUSY;
 
+	/*
+	 * The hypervisor maps non-cacheable sections Normal-NC at stage 2, use
+	 * the matching attributes so that both sides agree on the contents.
+	 */
+	pci_read_config_byte(pdev, vendor_cap + IVSHM_CFG_PRIV_CNTL, &priv_cntl);
+	remap_flags = priv_cntl & IVSHM_PRIV_CNTL_NONCACHED ?
+		MEMREMAP_WC : MEMREMAP_WB;
+
 	output_sections = devm_memremap(&pdev->dev, output_sections_addr,
-					output_section_sz * 2, MEMREMAP_WB);
+					output_section_sz * 2, remap_flags);
 	if (!output_sections)
 		return -ENOMEM;
 
+	/*
+	 * The remap uses PMD blocks for 2 MiB aligned sections, sparing the
+	 * data path TLB misses. See JAILHOUSE_SHMEM_NET_REGIONS_2M.
+	 */
+	if (output_section_sz >= PMD_SIZE &&
+	    !IS_ALIGNED(output_sections_addr | output_section_sz, PMD_SIZE))
+		dev_info(&pdev->dev, "output sections not 2 MiB aligned, "
+			 "mapped with small pages\n");
+
 	section_addr = output_sections_addr + output_section_sz * id;
 	dev_info(&pdev->dev, "TX memory at %pa, size %pa\n",
 		 &section_addr, &output_section_sz);
@@ -941,7 +1536,16 @@ static int ivshm_net_probe(struct pci_dev *pdev,
 	if (!device_name)
 		return -ENOMEM;
 
-	ndev = alloc_etherdev(sizeof(*in));
+	/*
+	 * One queue pair per MSI-X vector beyond the state vector. Both peers
+	 * are configured with the same number of vectors, thus agree on the
+	 * number of queues.
+	 */
+	ret = pci_msix_vec_count(pdev);
+	num_queues = ret > IVSHM_NET_MSIX_TX_RX ?
+		min(ret - IVSHM_NET_MSIX_TX_RX, IVSHM_NET_MAX_QUEUES) : 1;
+
+	ndev = alloc_etherdev_mqs(sizeof(*in), num_queues, num_queues);
 	if (!ndev)
 		return -ENOMEM;
 
@@ -962,6 +1566,8 @@ static int ivshm_net_probe(struct pci_dev *pdev,
 	in->peer_id = !id;
 	in->pdev = pdev;
 	in->last_peer_state = IVSHM_NET_STATE_UNKNOWN;
+	in->num_queues = num_queues;
+	in->rx_copybreak = IVSHM_NET_RX_COPYBREAK;
 
 	mutex_init(&in->state_lock);
 
@@ -981,22 +1587,48 @@ static int ivshm_net_probe(struct pci_dev *pdev,
 	ndev->mtu = min_t(u32, IVSHM_NET_MTU_DEF, in->qsize / 16);
 	ndev->min_mtu = ETH_MIN_MTU;
 	ndev->max_mtu = min_t(u32, ETH_MAX_MTU, in->qsize / 4);
-	ndev->hw_features = NETIF_F_HW_CSUM | NETIF_F_SG;
+	ndev->hw_features = NETIF_F_HW_CSUM | NETIF_F_SG | NETIF_F_RXCSUM |
+		NETIF_F_TSO | NETIF_F_TSO6 | NETIF_F_TSO_ECN;
+	/* TSO is masked until negotiated, see ivshm_net_fix_features */
 	ndev->features = ndev->hw_features;
+	netif_set_gso_max_size(ndev, min_t(u32, GSO_MAX_SIZE, in->qsize / 4));
+	ivshm_net_update_tx_max_len(ndev);
 
 	netif_carrier_off(ndev);
-	netif_napi_add(ndev, &in->napi, ivshm_net_poll, NAPI_POLL_WEIGHT);
+	for (q = 0; q < num_queues; q++) {
+		qp = &in->qp[q];
+		qp->index = q;
+		netif_napi_add(ndev, &qp->napi, ivshm_net_poll,
+			       NAPI_POLL_WEIGHT);
+	}
 
 	ret = register_netdev(ndev);
 	if (ret)
 		goto err_wq;
 
-	ret = pci_alloc_irq_vectors(pdev, 1, 2, PCI_IRQ_LEGACY | PCI_IRQ_MSIX);
+	for (q = 0; q < num_queues; q++) {
+		qp = &in->qp[q];
+		ret = xdp_rxq_info_reg(&qp->xdp_rxq, ndev, q);
+		if (ret)
+			goto err_xdp_rxq;
+		ret = xdp_rxq_info_reg_mem_model(&qp->xdp_rxq,
+						 MEM_TYPE_PAGE_SHARED, NULL);
+		if (ret) {
+			xdp_rxq_info_unreg(&qp->xdp_rxq);
+			goto err_xdp_rxq;
+		}
+	}
+
+	/* Spread the queue vectors over the CPUs, leaving the state vector */
+	ret = pci_alloc_irq_vectors_affinity(pdev, 1,
+					     IVSHM_NET_MSIX_TX_RX + num_queues,
+					     PCI_IRQ_LEGACY | PCI_IRQ_MSIX |
+					     PCI_IRQ_AFFINITY, &affd);
 	if (ret < 0)
 		goto err_alloc_irq;
 
 	if (pdev->msix_enabled) {
-		if (ret != 2) {
+		if (ret != IVSHM_NET_MSIX_TX_RX + num_queues) {
 			ret = -EBUSY;
 			goto err_request_irq;
 		}
@@ -1014,27 +1646,38 @@ static int ivshm_net_probe(struct pci_dev *pdev,
 		if (ret)
 			goto err_request_irq;
 
-		device_name = devm_kasprintf(&pdev->dev, GFP_KERNEL,
-					     "%s-tx-rx[%s]", DRV_NAME,
-					     dev_name(&pdev->dev));
-		if (!device_name) {
-			ret = -ENOMEM;
-			goto err_request_irq2;
+		for (q = 0; q < num_queues; q++) {
+			qp = &in->qp[q];
+			qp->tx_rx_vector = IVSHM_NET_MSIX_TX_RX + q;
+
+			device_name = devm_kasprintf(&pdev->dev, GFP_KERNEL,
+						     "%s-tx-rx%u[%s]", DRV_NAME,
+						     q, dev_name(&pdev->dev));
+			if (!device_name) {
+				ret = -ENOMEM;
+				goto err_request_irq2;
+			}
+
+			ret = request_irq(pci_irq_vector(pdev,
+							 qp->tx_rx_vector),
+					  ivshm_net_int_tx_rx, 0, device_name,
+					  qp);
+			if (ret)
+				goto err_request_irq2;
 		}
-
-		ret = request_irq(pci_irq_vector(pdev, IVSHM_NET_MSIX_TX_RX),
-				  ivshm_net_int_tx_rx, 0, device_name, in);
-		if (ret)
-			goto err_request_irq2;
-
-		in->tx_rx_vector = IVSHM_NET_MSIX_TX_RX;
 	} else {
+		if (num_queues > 1) {
+			dev_err(&pdev->dev, "multiple queues require MSI-X\n");
+			ret = -EBUSY;
+			goto err_request_irq;
+		}
+
 		ret = request_irq(pci_irq_vector(pdev, 0), ivshm_net_intx, 0,
 				  device_name, in);
 		if (ret)
 			goto err_request_irq;
 
-		in->tx_rx_vector = 0;
+		in->qp[0].tx_rx_vector = 0;
 	}
 
 	pci_set_master(pdev);
@@ -1048,10 +1691,17 @@ static int ivshm_net_probe(struct pci_dev *pdev,
 	return 0;
 
 err_request_irq2:
+	while (q-- > 0)
+		free_irq(pci_irq_vector(pdev, in->qp[q].tx_rx_vector),
+			 &in->qp[q]);
 	free_irq(pci_irq_vector(pdev, IVSHM_NET_MSIX_STATE), in);
 err_request_irq:
 	pci_free_irq_vectors(pdev);
 err_alloc_irq:
+	q = num_queues;
+err_xdp_rxq:
+	while (q-- > 0)
+		xdp_rxq_info_unreg(&in->qp[q].xdp_rxq);
 	unregister_netdev(ndev);
 err_wq:
 	destroy_workqueue(in->state_wq);
@@ -1065,19 +1715,27 @@ static void ivshm_net_remove(struct pci_dev *pdev)
 {
 	struct net_device *ndev = pci_get_drvdata(pdev);
 	struct ivshm_net *in = netdev_priv(ndev);
+	unsigned int q;
 
+	/* do not leave a stale feature block for a future peer */
+	WRITE_ONCE(ivshm_net_features_block(in, IVSHM_NET_SECTION_TX)->magic,
+		   0);
 	writel(IVSHM_NET_STATE_RESET, &in->ivshm_regs->state);
 	writel(0, &in->ivshm_regs->int_control);
 
 	if (pdev->msix_enabled) {
 		free_irq(pci_irq_vector(pdev, IVSHM_NET_MSIX_STATE), in);
-		free_irq(pci_irq_vector(pdev, IVSHM_NET_MSIX_TX_RX), in);
+		for (q = 0; q < in->num_queues; q++)
+			free_irq(pci_irq_vector(pdev, in->qp[q].tx_rx_vector),
+				 &in->qp[q]);
 	} else {
 		free_irq(pci_irq_vector(pdev, 0), in);
 	}
 	pci_free_irq_vectors(pdev);
 
 	unregister_netdev(ndev);
+	for (q = 0; q < in->num_queues; q++)
+		xdp_rxq_info_unreg(&in->qp[q].xdp_rxq);
 	cancel_work_sync(&in->state_work);
 	destroy_workqueue(in->state_wq);
 	free_netdev(ndev);
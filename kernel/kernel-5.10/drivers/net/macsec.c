@@ -573,6 +573,29 @@ static void macsec_encrypt_done(struct crypto_async_request *base, int err)
 	dev_put(dev);
 }
 
+/* Transforms are synchronous (see macsec_alloc_tfm), a request never
+ * outlives the macsec_encrypt()/macsec_decrypt() call that set it up. With
+ * BH disabled, each CPU can thus reuse one buffer instead of allocating a
+ * request per frame. Requests that do not fit fall back to kmalloc.
+ */
+#define MACSEC_PCPU_REQ_SIZE	2048
+
+struct macsec_req_buf {
+	u8 data[MACSEC_PCPU_REQ_SIZE];
+} __aligned(CRYPTO_MINALIGN);
+
+static struct macsec_req_buf __percpu *macsec_req_bufs;
+
+static void macsec_free_req(struct aead_request *req)
+{
+	if (req != (void *)this_cpu_ptr(macsec_req_bufs)) {
+		aead_request_free(req);
+		return;
+	}
+	memzero_explicit(req->__ctx,
+			 crypto_aead_reqsize(crypto_aead_reqtfm(req)));
+}
+
 static struct aead_request *macsec_alloc_req(struct crypto_aead *tfm,
 					     unsigned char **iv,
 					     struct scatterlist **sg,
@@ -590,7 +613,10 @@ static struct aead_request *macsec_alloc_req(struct crypto_aead *tfm,
 	sg_offset = size;
 	size += sizeof(struct scatterlist) * num_frags;
 
-	tmp = kmalloc(size, GFP_ATOMIC);
+	if (in_softirq() && size <= MACSEC_PCPU_REQ_SIZE)
+		tmp = this_cpu_ptr(macsec_req_bufs);
+	else
+		tmp = kmalloc(size, GFP_ATOMIC);
 	if (!tmp)
 		return NULL;
 
@@ -705,7 +731,7 @@ static struct sk_buff *macsec_encrypt(struct sk_buff *skb,
 	sg_init_table(sg, ret);
 	ret = skb_to_sgvec(skb, sg, 0, skb->len);
 	if (unlikely(ret < 0)) {
-		aead_request_free(req);
+		macsec_free_req(req);
 		macsec_txsa_put(tx_sa);
 		kfree_skb(skb);
 		return ERR_PTR(ret);
@@ -733,13 +759,13 @@ static struct sk_buff *macsec_encrypt(struct sk_buff *skb,
 	} else if (ret != 0) {
 		dev_put(skb->dev);
 		kfree_skb(skb);
-		aead_request_free(req);
+		macsec_free_req(req);
 		macsec_txsa_put(tx_sa);
 		return ERR_PTR(-EINVAL);
 	}
 
 	dev_put(skb->dev);
-	aead_request_free(req);
+	macsec_free_req(req);
 	macsec_txsa_put(tx_sa);
 
 	return skb;
@@ -947,7 +973,7 @@ static struct sk_buff *macsec_decrypt(struct sk_buff *skb,
 	sg_init_table(sg, ret);
 	ret = skb_to_sgvec(skb, sg, 0, skb->len);
 	if (unlikely(ret < 0)) {
-		aead_request_free(req);
+		macsec_free_req(req);
 		kfree_skb(skb);
 		return ERR_PTR(ret);
 	}
@@ -962,7 +988,7 @@ static struct sk_buff *macsec_decrypt(struct sk_buff *skb,
 		aead_request_set_ad(req, macsec_hdr_len(macsec_skb_cb(skb)->has_sci));
 		skb = skb_unshare(skb, GFP_ATOMIC);
 		if (!skb) {
-			aead_request_free(req);
+			macsec_free_req(req);
 			return ERR_PTR(-ENOMEM);
 		}
 	} else {
@@ -992,7 +1018,7 @@ static struct sk_buff *macsec_decrypt(struct sk_buff *skb,
 	}
 	dev_put(dev);
 
-	aead_request_free(req);
+	macsec_free_req(req);
 
 	return skb;
 }
@@ -1347,7 +1373,12 @@ static struct crypto_aead *macsec_alloc_tfm(char *key, int key_len, int icv_len)
 	struct crypto_aead *tfm;
 	int ret;
 
-	tfm = crypto_alloc_aead("gcm(aes)", 0, 0);
+	/* Only synchronous implementations: the ARMv8 Crypto Extensions and
+	 * NEON ones run on the CPU at close to line rate, while asynchronous
+	 * engines, such as a virtualized security engine reached over IVC,
+	 * add a round trip per frame and reorder completions.
+	 */
+	tfm = crypto_alloc_aead("gcm(aes)", 0, CRYPTO_ALG_ASYNC);
 
 	if (IS_ERR(tfm))
 		return tfm;
@@ -4381,9 +4412,13 @@ static int __init macsec_init(void)
 	int err;
 
 	pr_info("MACsec IEEE 802.1AE\n");
+	macsec_req_bufs = alloc_percpu(struct macsec_req_buf);
+	if (!macsec_req_bufs)
+		return -ENOMEM;
+
 	err = register_netdevice_notifier(&macsec_notifier);
 	if (err)
-		return err;
+		goto bufs;
 
 	err = rtnl_link_register(&macsec_link_ops);
 	if (err)
@@ -4399,6 +4434,8 @@ rtnl:
 	rtnl_link_unregister(&macsec_link_ops);
 notifier:
 	unregister_netdevice_notifier(&macsec_notifier);
+bufs:
+	free_percpu(macsec_req_bufs);
 	return err;
 }
 
@@ -4408,6 +4445,7 @@ static void __exit macsec_exit(void)
 	rtnl_link_unregister(&macsec_link_ops);
 	unregister_netdevice_notifier(&macsec_notifier);
 	rcu_barrier();
+	free_percpu(macsec_req_bufs);
 }
 
 module_init(macsec_init);
@@ -12,6 +12,7 @@
 
 #define IVSHM_CFG_PRIV_CNTL		0x03
 # define IVSHM_PRIV_CNTL_ONESHOT_INT	BIT(0)
+# define IVSHM_PRIV_CNTL_NONCACHED	BIT(2)
 #define IVSHM_CFG_STATE_TAB_SZ		0x04
 #define IVSHM_CFG_RW_SECTION_SZ		0x08
 #define IVSHM_CFG_OUTPUT_SECTION_SZ	0x10
@@ -79,6 +79,11 @@ struct tegra_hv_ivm_cookie {
 #define tegra_ivc_write_poke nv_tegra_ivc_write_poke
 #define tegra_ivc_write_get_next_frame nv_tegra_ivc_write_get_next_frame
 #define tegra_ivc_write_advance nv_tegra_ivc_write_advance
+#define tegra_ivc_read_get_frames nv_tegra_ivc_read_get_frames
+#define tegra_ivc_read_advance_frames nv_tegra_ivc_read_advance_frames
+#define tegra_ivc_write_get_frames nv_tegra_ivc_write_get_frames
+#define tegra_ivc_write_advance_frames nv_tegra_ivc_write_advance_frames
+#define tegra_ivc_set_reader_active nv_tegra_ivc_set_reader_active
 #define tegra_ivc_channel_reset nv_tegra_ivc_channel_reset
 #define tegra_ivc_channel_notified nv_tegra_ivc_channel_notified
 
@@ -95,6 +100,13 @@ int tegra_ivc_write_poke(struct ivc *ivc, const void *buf, size_t off,
 		size_t count);
 void *tegra_ivc_write_get_next_frame(struct ivc *ivc);
 int tegra_ivc_write_advance(struct ivc *ivc);
+int tegra_ivc_read_get_frames(struct ivc *ivc, void **frames,
+		uint32_t max_frames);
+int tegra_ivc_read_advance_frames(struct ivc *ivc, uint32_t count);
+int tegra_ivc_write_get_frames(struct ivc *ivc, void **frames,
+		uint32_t max_frames);
+int tegra_ivc_write_advance_frames(struct ivc *ivc, uint32_t count);
+void tegra_ivc_set_reader_active(struct ivc *ivc, bool active);
 int tegra_ivc_channel_notified(struct ivc *ivc);
 void tegra_ivc_channel_reset(struct ivc *ivc);
 
@@ -284,6 +296,59 @@ void *tegra_hv_ivc_write_get_next_frame(struct tegra_hv_ivc_cookie *ivck);
  */
 int tegra_hv_ivc_write_advance(struct tegra_hv_ivc_cookie *ivck);
 
+/**
+ * tegra_hv_ivc_read_get_frames - Peek at several received frames in place
+ * @ivck	IVC cookie of the queue
+ * @frames	Array receiving the frame pointers, in queue order
+ * @max_frames	Size of @frames
+ *
+ * Peek at up to @max_frames received frames without removing them from
+ * the queue.
+ *
+ * Returns the number of frames, or a negative error value if failed.
+ */
+int tegra_hv_ivc_read_get_frames(struct tegra_hv_ivc_cookie *ivck,
+		void **frames, uint32_t max_frames);
+
+/**
+ * tegra_hv_ivc_read_advance_frames - Advance the read queue by several frames
+ * @ivck	IVC cookie of the queue
+ * @count	Number of frames to release
+ *
+ * Release frames obtained from tegra_hv_ivc_read_get_frames() with a
+ * single counter update and notification.
+ *
+ * Returns 0, or a negative error value if failed.
+ */
+int tegra_hv_ivc_read_advance_frames(struct tegra_hv_ivc_cookie *ivck,
+		uint32_t count);
+
+/**
+ * tegra_hv_ivc_write_get_frames - Get several frames to transmit in place
+ * @ivck	IVC cookie of the queue
+ * @frames	Array receiving the frame pointers, in queue order
+ * @max_frames	Size of @frames
+ *
+ * Get access to up to @max_frames free transmit frames.
+ *
+ * Returns the number of frames, or a negative error value if failed.
+ */
+int tegra_hv_ivc_write_get_frames(struct tegra_hv_ivc_cookie *ivck,
+		void **frames, uint32_t max_frames);
+
+/**
+ * tegra_hv_ivc_write_advance_frames - Advance the write queue by several frames
+ * @ivck	IVC cookie of the queue
+ * @count	Number of frames to publish
+ *
+ * Publish frames filled through tegra_hv_ivc_write_get_frames() with a
+ * single counter update and notification.
+ *
+ * Returns 0, or a negative error value if failed.
+ */
+int tegra_hv_ivc_write_advance_frames(struct tegra_hv_ivc_cookie *ivck,
+		uint32_t count);
+
 /**
  * tegra_hv_mempool_reserve - reserve a mempool for use
  * @id		Id of the requested mempool.
@@ -436,6 +501,32 @@ static inline int tegra_hv_ivc_write_advance(struct tegra_hv_ivc_cookie *ivck)
 	return -ENODEV;
 }
 
+static inline int tegra_hv_ivc_read_get_frames(
+		struct tegra_hv_ivc_cookie *ivck, void **frames,
+		uint32_t max_frames)
+{
+	return -ENODEV;
+}
+
+static inline int tegra_hv_ivc_read_advance_frames(
+		struct tegra_hv_ivc_cookie *ivck, uint32_t count)
+{
+	return -ENODEV;
+}
+
+static inline int tegra_hv_ivc_write_get_frames(
+		struct tegra_hv_ivc_cookie *ivck, void **frames,
+		uint32_t max_frames)
+{
+	return -ENODEV;
+}
+
+static inline int tegra_hv_ivc_write_advance_frames(
+		struct tegra_hv_ivc_cookie *ivck, uint32_t count)
+{
+	return -ENODEV;
+}
+
 static inline struct tegra_hv_ivm_cookie *tegra_hv_mempool_reserve(unsigned id)
 {
 	return ERR_PTR(-ENODEV);
@@ -391,6 +391,14 @@ struct core_local {
 #endif /* L3L4_WILDCARD_FILTER */
 	/** TXFIFO size per queue */
 	nveu32_t tx_fifosz_perq;
+#ifndef OSI_STRIPPED_LIB
+	/** RSS hash key words programmed in HW */
+	nveu32_t hw_rss_key[OSI_RSS_HASH_KEY_SIZE / 4U];
+	/** RSS indirection table programmed in HW */
+	nveu32_t hw_rss_table[OSI_RSS_MAX_TABLE_SIZE];
+	/** OSI_ENABLE if hw_rss_key and hw_rss_table match the HW */
+	nveu32_t hw_rss_valid;
+#endif /* !OSI_STRIPPED_LIB */
 };
 
 /**
@@ -614,8 +614,9 @@ static nve32_t frp_delete(struct osi_core_priv_data *const osi_core,
 			  struct core_ops *ops_p,
 			  struct osi_core_frp_cmd *const cmd)
 {
+	struct osi_core_frp_data *data = OSI_NULL;
 	nve32_t ret;
-	nveu8_t i = 0U, pos = 0U, count = 0U;
+	nveu8_t i = 0U, pos = 0U, count = 0U, start = 0U;
 	nve32_t frp_id = cmd->frp_id;
 	nveu32_t frp_cnt = osi_core->frp_cnt;
 
@@ -651,6 +652,7 @@ static nve32_t frp_delete(struct osi_core_priv_data *const osi_core,
 		   (sizeof(struct osi_core_frp_entry) * count));
 
 	/* Move in FRP table entries by count */
+	start = pos;
 	for (i = (nveu8_t)(pos + count); i <= frp_cnt; i++) {
 		frp_entry_copy(&osi_core->frp_table[pos],
 			       &osi_core->frp_table[i]);
@@ -660,6 +662,15 @@ static nve32_t frp_delete(struct osi_core_priv_data *const osi_core,
 	/* Update the frp_cnt entry */
 	osi_core->frp_cnt = (frp_cnt - count);
 
+	/* Links to the moved entries follow them */
+	for (i = 0U; i < osi_core->frp_cnt; i++) {
+		data = &osi_core->frp_table[i].data;
+		if ((data->next_ins_ctrl == OSI_ENABLE) &&
+		    (data->ok_index >= ((nveu32_t)start + count))) {
+			data->ok_index = (nveu8_t)(data->ok_index - count);
+		}
+	}
+
 	/* Write FRP Table into HW */
 	ret = frp_hw_write(osi_core, ops_p);
 	if (ret < 0) {
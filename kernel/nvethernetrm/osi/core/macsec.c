@@ -695,7 +695,8 @@ static inline nveul64_t update_macsec_mmc_val(
  *
  * @note
  * Algorithm:
- *  - Reads and updates the macsec_mmc counters in osi_core
+ *  - Reads and updates the macsec_mmc counters in osi_core, the per SC
+ *    counters of the SCs without a valid AN are skipped
  *  - Refer to MACSEC column of <<******, (sequence diagram)>> for API details.
  *  - TraceID: ***********
  *
@@ -712,6 +713,10 @@ static inline nveul64_t update_macsec_mmc_val(
 static void macsec_read_mmc(struct osi_core_priv_data *const osi_core)
 {
 	struct osi_macsec_mmc_counters *mmc = &osi_core->macsec_mmc;
+	const struct osi_macsec_sc_info *tx_sc =
+		osi_core->macsec_lut_status[OSI_CTLR_SEL_TX].sc_info;
+	const struct osi_macsec_sc_info *rx_sc =
+		osi_core->macsec_lut_status[OSI_CTLR_SEL_RX].sc_info;
 	nveu16_t i;
 
 	mmc->tx_pkts_untaged =
@@ -735,10 +740,16 @@ static void macsec_read_mmc(struct osi_core_priv_data *const osi_core)
 	mmc->rx_octets_validated =
 		update_macsec_mmc_val(osi_core, MACSEC_RX_OCTETS_VLDTD_LO_0);
 
+	/* The per SC counters only move for the SCs in use */
 	for (i = 0; i <= OSI_SC_INDEX_MAX; i++) {
-		mmc->tx_pkts_protected[i] =
-			update_macsec_mmc_val(osi_core,
+		if (tx_sc[i].an_valid != OSI_NONE) {
+			mmc->tx_pkts_protected[i] =
+				update_macsec_mmc_val(osi_core,
 					MACSEC_TX_PKTS_PROTECTED_SCx_LO_0(i));
+		}
+		if (rx_sc[i].an_valid == OSI_NONE) {
+			continue;
+		}
 		mmc->rx_pkts_late[i] =
 			update_macsec_mmc_val(osi_core,
 					      MACSEC_RX_PKTS_LATE_SCx_LO_0(i));
@@ -982,6 +993,14 @@ static nve32_t macsec_kt_config(struct osi_core_priv_data *const osi_core,
 		goto err;
 	}
 
+	/* Wait for previous KT update to finish, the data registers are
+	 * shared by all entries.
+	 */
+	ret = poll_for_kt_update(osi_core);
+	if (ret < 0) {
+		goto err;
+	}
+
 	kt_config_reg = osi_readla(osi_core, base + MACSEC_GCM_KEYTABLE_CONFIG);
 	if (kt_config->table_config.ctlr_sel != OSI_NONE) {
 		kt_config_reg |= MACSEC_KT_CONFIG_CTLR_SEL;
@@ -1006,13 +1025,15 @@ static nve32_t macsec_kt_config(struct osi_core_priv_data *const osi_core,
 	kt_config_reg |= MACSEC_KT_CONFIG_UPDATE;
 	osi_writela(osi_core, kt_config_reg, base + MACSEC_GCM_KEYTABLE_CONFIG);
 
-	/* Wait for this KT update to finish */
-	ret = poll_for_kt_update(osi_core);
-	if (ret < 0) {
-		goto err;
-	}
-
+	/* A write completes while the next entry is prepared, and the next
+	 * access waits for it. Only a read has to wait for its data here.
+	 */
 	if (kt_config->table_config.rw == OSI_NONE) {
+		ret = poll_for_kt_update(osi_core);
+		if (ret < 0) {
+			goto err;
+		}
+
 		ret = kt_key_read(osi_core, kt_config);
 		if (ret < 0) {
 			goto err;
@@ -3074,13 +3095,15 @@ static nve32_t macsec_lut_config(struct osi_core_priv_data *const osi_core,
 	lut_config_reg |= MACSEC_LUT_CONFIG_UPDATE;
 	osi_writela(osi_core, lut_config_reg, base + MACSEC_LUT_CONFIG);
 
-	/* Wait for this LUT update to finish */
-	ret = poll_for_lut_update(osi_core);
-	if (ret < 0) {
-		goto exit;
-	}
-
+	/* A write completes while the next entry is prepared, and the next
+	 * update waits for it. Only a read has to wait for its data here.
+	 */
 	if (lut_config->table_config.rw == OSI_NONE) {
+		ret = poll_for_lut_update(osi_core);
+		if (ret < 0) {
+			goto exit;
+		}
+
 		ret = lut_data_read(osi_core, lut_config);
 		if (ret < 0) {
 			goto exit;
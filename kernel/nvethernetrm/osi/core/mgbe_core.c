@@ -1369,7 +1369,10 @@ static nve32_t mgbe_rss_write_reg(struct osi_core_priv_data *osi_core,
 /**
  * @brief mgbe_config_rss - Configure RSS
  *
- * Algorithm: Programes RSS hash table or RSS hash key.
+ * Algorithm: Programes RSS hash table or RSS hash key. Once the HW content
+ * is known, only the key words and table entries which changed since the
+ * last successful update are written. Any failed write makes the next
+ * update reprogram everything.
  *
  * @param[in] osi_core: OSI core private data.
  *
@@ -1380,7 +1383,9 @@ static nve32_t mgbe_rss_write_reg(struct osi_core_priv_data *osi_core,
  */
 static nve32_t mgbe_config_rss(struct osi_core_priv_data *osi_core)
 {
+	struct core_local *l_core = (struct core_local *)(void *)osi_core;
 	nveu8_t *addr = (nveu8_t *)osi_core->base;
+	nveu32_t valid = l_core->hw_rss_valid;
 	nveu32_t value = 0;
 	nveu32_t i = 0, j = 0;
 	nve32_t ret = 0;
@@ -1401,21 +1406,30 @@ static nve32_t mgbe_config_rss(struct osi_core_priv_data *osi_core)
 			 ((nveu32_t)osi_core->rss.key[i + 1U] << 8U) |
 			 ((nveu32_t)osi_core->rss.key[i + 2U] << 16U) |
 			 ((nveu32_t)osi_core->rss.key[i + 3U] << 24U));
-		ret = mgbe_rss_write_reg(osi_core, j, value, OSI_ENABLE);
-		if (ret < 0) {
-			return ret;
+		if ((valid != OSI_ENABLE) || (l_core->hw_rss_key[j] != value)) {
+			l_core->hw_rss_valid = OSI_DISABLE;
+			ret = mgbe_rss_write_reg(osi_core, j, value, OSI_ENABLE);
+			if (ret < 0) {
+				return ret;
+			}
+			l_core->hw_rss_key[j] = value;
 		}
 		j++;
 	}
 
 	/* Program Hash table */
 	for (i = 0; i < OSI_RSS_MAX_TABLE_SIZE; i++) {
-		ret = mgbe_rss_write_reg(osi_core, i, osi_core->rss.table[i],
-					 OSI_NONE);
-		if (ret < 0) {
-			return ret;
+		value = osi_core->rss.table[i];
+		if ((valid != OSI_ENABLE) || (l_core->hw_rss_table[i] != value)) {
+			l_core->hw_rss_valid = OSI_DISABLE;
+			ret = mgbe_rss_write_reg(osi_core, i, value, OSI_NONE);
+			if (ret < 0) {
+				return ret;
+			}
+			l_core->hw_rss_table[i] = value;
 		}
 	}
+	l_core->hw_rss_valid = OSI_ENABLE;
 
 	/* Enable RSS */
 	value = osi_readla(osi_core, addr + MGBE_MAC_RSS_CTRL);
@@ -1743,7 +1757,7 @@ static nve32_t mgbe_hsi_inject_err(struct osi_core_priv_data *const osi_core,
  */
 static nve32_t mgbe_configure_mac(struct osi_core_priv_data *osi_core)
 {
-	const struct core_local *l_core = (struct core_local *)(void *)osi_core;
+	struct core_local *l_core = (struct core_local *)(void *)osi_core;
 	/* 4176U is the minimum space required to support jumbo frames */
 	nveu32_t max_value = UINT_MAX - 4176U;
 	nveu32_t value = 0U;
@@ -1881,7 +1895,8 @@ static nve32_t mgbe_configure_mac(struct osi_core_priv_data *osi_core)
 	}
 	/* TODO: USP (user Priority) to RxQ Mapping */
 
-	/* RSS cofiguration */
+	/* RSS cofiguration, the MAC reset cleared the programmed entries */
+	l_core->hw_rss_valid = OSI_DISABLE;
 	mgbe_config_rss(osi_core);
 #endif /* !OSI_STRIPPED_LIB */
 
@@ -59,41 +59,6 @@ static inline nveu32_t get_vlan_filter_idx(
 	return vid_idx;
 }
 
-/**
- * @brief allow_all_vid_tags - Program MAC to pass all VID
- *
- * Algorithm: Enable HASH filtering and program the hash to 0xFFFF
- * if all VID's to pass. For not to pass all VID's disable HASH
- * filtering and program the HASH as zero.
- *
- * @param[in] base: MAC base address
- * @param[in] pass_all_vids: Flag to pass all VID's or not.
- *
- * @return 0 on success
- */
-static inline nve32_t allow_all_vid_tags(nveu8_t *base,
-				     nveu32_t pass_all_vids)
-{
-	nveu32_t vlan_tag_reg = 0;
-	nveu32_t hash_filter_reg = 0;
-
-	vlan_tag_reg = osi_readl(base + MAC_VLAN_TAG_CTRL);
-	hash_filter_reg = osi_readl(base + MAC_VLAN_HASH_FILTER);
-
-	if (pass_all_vids == OSI_ENABLE) {
-		vlan_tag_reg |= MAC_VLAN_TAG_CTRL_VHTM;
-		hash_filter_reg |= VLAN_HASH_ALLOW_ALL;
-	} else {
-		vlan_tag_reg &= ~MAC_VLAN_TAG_CTRL_VHTM;
-		hash_filter_reg &= (nveu32_t) ~VLAN_HASH_ALLOW_ALL;
-	}
-
-	osi_writel(vlan_tag_reg, base + MAC_VLAN_TAG_CTRL);
-	osi_writel(hash_filter_reg, base + MAC_VLAN_HASH_FILTER);
-
-	return 0;
-}
-
 /**
  * @brief is_vlan_id_enqueued - Checks passed VID already queued or not.
  *
@@ -210,6 +175,108 @@ static inline nve32_t poll_for_vlan_filter_reg_rw(
 	return 0;
 }
 
+/**
+ * @brief vlan_hash_bin - Get VLAN hash table bin of a VID
+ *
+ * Algorithm: Compute CRC-32 of the 12 bit VID, the MAC uses the upper
+ * 4 bits of the bit reversed ones complement of it as hash table index.
+ *
+ * @param[in] vlan_id: VLAN ID.
+ *
+ * @return hash table bin (0 - 15)
+ */
+static inline nveu32_t vlan_hash_bin(nveu16_t vlan_id)
+{
+	nveu32_t crc = 0xFFFFFFFFU;
+	nveu32_t data = vlan_id;
+	nveu32_t i;
+
+	for (i = 0U; i < VLAN_HASH_VID_BITS; i++) {
+		if (((crc ^ data) & 0x1U) != 0U) {
+			crc = (crc >> 1U) ^ VLAN_HASH_CRC_POLY;
+		} else {
+			crc >>= 1U;
+		}
+		data >>= 1U;
+	}
+
+	crc = ~crc;
+
+	return ((crc & 0x1U) << 3U) | ((crc & 0x2U) << 1U) |
+	       ((crc & 0x4U) >> 1U) | ((crc & 0x8U) >> 3U);
+}
+
+/**
+ * @brief program_vlan_hash - Program MAC VLAN hash filter
+ *
+ * Algorithm: VIDs which do not fit in the HW perfect filters are passed
+ * by the VLAN hash filter instead of passing all VLAN tags. Enable hash
+ * filtering for any bin set, disable it for an empty hash.
+ *
+ * @param[in] osi_core: OSI core private data.
+ * @param[in] hash: hash table bins to be set.
+ *
+ * @return 0 on success
+ * @return -1 on failure.
+ */
+static inline nve32_t program_vlan_hash(struct osi_core_priv_data *osi_core,
+					nveu32_t hash)
+{
+	nveu8_t *base = (nveu8_t *)osi_core->base;
+	nveu32_t vlan_tag_reg = 0;
+	nveu32_t hash_filter_reg = 0;
+
+	/* Tag control register is shared with the indirect filter access */
+	if (poll_for_vlan_filter_reg_rw(osi_core) < 0) {
+		return -1;
+	}
+
+	vlan_tag_reg = osi_readl(base + MAC_VLAN_TAG_CTRL);
+	hash_filter_reg = osi_readl(base + MAC_VLAN_HASH_FILTER);
+
+	if (hash != OSI_NONE) {
+		vlan_tag_reg |= (MAC_VLAN_TAG_CTRL_VHTM | MAC_VLAN_TAG_CTRL_ETV);
+	} else {
+		vlan_tag_reg &= ~(MAC_VLAN_TAG_CTRL_VHTM | MAC_VLAN_TAG_CTRL_ETV);
+	}
+	hash_filter_reg &= ~VLAN_HASH_MASK;
+	hash_filter_reg |= (hash & VLAN_HASH_MASK);
+
+	osi_writel(hash_filter_reg, base + MAC_VLAN_HASH_FILTER);
+	osi_writel(vlan_tag_reg, base + MAC_VLAN_TAG_CTRL);
+
+	return 0;
+}
+
+/**
+ * @brief update_vlan_hash - Rebuild VLAN hash from SW VID queue
+ *
+ * Algorithm: Bins can be shared by several VIDs, so after a VID leaves
+ * the SW queue the hash is rebuilt. Frames of the VIDs in the HW filters
+ * have to pass the hash as well, so their bins are set too while the SW
+ * queue is not empty.
+ *
+ * @param[in] osi_core: OSI core private data.
+ *
+ * @return 0 on success
+ * @return -1 on failure.
+ */
+static inline nve32_t update_vlan_hash(struct osi_core_priv_data *osi_core)
+{
+	nveu32_t hash = 0U;
+	nveu32_t i;
+
+	if (osi_core->vlan_filter_cnt > VLAN_HW_FILTER_FULL_IDX) {
+		for (i = 0U; i < osi_core->vlan_filter_cnt; i++) {
+			if (osi_core->vid[i] != VLAN_ID_INVALID) {
+				hash |= OSI_BIT(vlan_hash_bin(osi_core->vid[i]));
+			}
+		}
+	}
+
+	return program_vlan_hash(osi_core, hash);
+}
+
 /**
  * @brief update_vlan_filters - Update HW filter registers
  *
@@ -230,6 +297,16 @@ static inline nve32_t update_vlan_filters(struct osi_core_priv_data *osi_core,
 	nveu8_t *base = (nveu8_t *)osi_core->base;
 	nve32_t ret = 0;
 
+	/* Wait for the previous filter update only, so a series of updates
+	 * does not wait for each one right after issuing it.
+	 */
+	ret = poll_for_vlan_filter_reg_rw(osi_core);
+	if (ret < 0) {
+		OSI_CORE_ERR(osi_core->osd, OSI_LOG_ARG_HW_FAIL,
+			     "Failed to update VLAN filters\n", 0ULL);
+		return -1;
+	}
+
 	osi_writel(val, base + MAC_VLAN_TAG_DATA);
 
 	val = osi_readl(base + MAC_VLAN_TAG_CTRL);
@@ -239,13 +316,6 @@ static inline nve32_t update_vlan_filters(struct osi_core_priv_data *osi_core,
 	val |= MAC_VLAN_TAG_CTRL_OB;
 	osi_writel(val, base + MAC_VLAN_TAG_CTRL);
 
-	ret = poll_for_vlan_filter_reg_rw(osi_core);
-	if (ret < 0) {
-		OSI_CORE_ERR(osi_core->osd, OSI_LOG_ARG_HW_FAIL,
-			     "Failed to update VLAN filters\n", 0ULL);
-		return -1;
-	}
-
 	return 0;
 }
 
@@ -286,8 +356,18 @@ static inline nve32_t add_vlan_id(struct osi_core_priv_data *osi_core,
 		if (ret < 0)
 			return ret;
 
-		/* Since VLAN HW filters full - program to allow all packets */
-		return allow_all_vid_tags(osi_core->base, OSI_ENABLE);
+		/* Since VLAN HW filters full - pass the VID through hash,
+		 * only the first queued VID needs the full hash.
+		 */
+		if (osi_core->vlan_filter_cnt == (VLAN_HW_FILTER_FULL_IDX + 1U)) {
+			return update_vlan_hash(osi_core);
+		}
+
+		return program_vlan_hash(osi_core,
+				(osi_readl((nveu8_t *)osi_core->base +
+					   MAC_VLAN_HASH_FILTER) &
+				 VLAN_HASH_MASK) |
+				OSI_BIT(vlan_hash_bin(vlan_id)));
 	}
 
 	osi_core->vf_bitmap |= OSI_BIT(vid_idx);
@@ -317,8 +397,8 @@ static inline nve32_t add_vlan_id(struct osi_core_priv_data *osi_core,
  * @brief dequeue_vlan_id - Remove VLAN ID from VID array
  *
  * Algorithm: Do the left shift of array from index to
- * total filter count. Allow all VID tags after removal
- * VID if numbers of filter count is 32.
+ * total filter count. Rebuild VLAN hash after removal
+ * of the VID.
  *
  * @param[in]: osi_core: OSI core private data.
  * @param[in] idx: Index at which VLAN ID to be deleted.
@@ -343,11 +423,7 @@ static inline nve32_t dequeue_vlan_id(struct osi_core_priv_data *osi_core,
 	osi_core->vid[i] = VLAN_ID_INVALID;
 	osi_core->vlan_filter_cnt--;
 
-	if (osi_core->vlan_filter_cnt == VLAN_HW_MAX_NRVF) {
-		return allow_all_vid_tags(osi_core->base, OSI_DISABLE);
-	}
-
-	return 0;
+	return update_vlan_hash(osi_core);
 }
 
 /**
@@ -396,7 +472,7 @@ static inline nve32_t dequeue_vid_to_add_filter_reg(
 
 	osi_core->vid[i] = VLAN_ID_INVALID;
 
-	return 0;
+	return update_vlan_hash(osi_core);
 }
 
 /**
@@ -452,13 +528,6 @@ static inline nve32_t del_vlan_id(struct osi_core_priv_data *osi_core,
 		}
 	}
 
-	if (osi_core->vlan_filter_cnt == VLAN_HW_MAX_NRVF) {
-		ret = allow_all_vid_tags(osi_core->base, OSI_DISABLE);
-		if (ret < 0) {
-			return -1;
-		}
-	}
-
 	/* if SW queue is not empty dequeue from SW queue and update filter */
 	return dequeue_vid_to_add_filter_reg(osi_core, vid_idx);
 }
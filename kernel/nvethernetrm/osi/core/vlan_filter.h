@@ -41,6 +41,7 @@
 #define MAC_VLAN_TAG_CTRL_OFS_SHIFT	2U
 #define MAC_VLAN_TAG_CTRL_CT	OSI_BIT(1)
 #define MAC_VLAN_TAG_CTRL_OB	OSI_BIT(0)
+#define MAC_VLAN_TAG_CTRL_ETV	OSI_BIT(16)
 #define MAC_VLAN_TAG_CTRL_VHTM	OSI_BIT(25)
 #define MAC_VLAN_TAG_DATA_ETV	OSI_BIT(16)
 #define MAC_VLAN_TAG_DATA_VEN	OSI_BIT(17)
@@ -56,7 +57,9 @@
 #define VLAN_HW_FILTER_FULL_IDX	VLAN_HW_MAX_NRVF
 #define VLAN_VID_MASK		0xFFFFU
 #define VLAN_ID_INVALID		0xFFFFU
-#define VLAN_HASH_ALLOW_ALL	0xFFFFU
+#define VLAN_HASH_MASK		0xFFFFU
+#define VLAN_HASH_VID_BITS	12U
+#define VLAN_HASH_CRC_POLY	0xEDB88320U
 #define VLAN_ACTION_MASK	OSI_BIT(31)
 /** @} */
 
@@ -79,6 +79,8 @@ struct nvgpu_usermode_bufs_linux {
 		struct dma_buf *dmabuf;
 		struct dma_buf_attachment *attachment;
 		struct sg_table *sgt;
+		/* Page window into sgt when the buffer starts at an offset */
+		struct sg_table *window;
 	} gpfifo, userd;
 };
 
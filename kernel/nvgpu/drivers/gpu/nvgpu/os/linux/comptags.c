@@ -22,6 +22,7 @@
 #include <nvgpu/linux/vm.h>
 
 #include "dmabuf_priv.h"
+#include "os_linux.h"
 
 void gk20a_get_comptags(struct nvgpu_os_buffer *buf,
 			struct gk20a_comptags *comptags)
@@ -42,13 +43,42 @@ void gk20a_get_comptags(struct nvgpu_os_buffer *buf,
 	nvgpu_mutex_release(&priv->lock);
 }
 
-int gk20a_alloc_comptags(struct gk20a *g, struct nvgpu_os_buffer *buf,
-			 struct gk20a_comptag_allocator *allocator)
+/*
+ * Map-time allocations of small buffers may not dig into the reserved part
+ * of the pool: large render targets move the most bytes per frame and so
+ * gain the most from compression, and registered buffers asked for it.
+ */
+static bool gk20a_comptags_policy_denies(struct gk20a *g,
+					 struct nvgpu_os_buffer *buf,
+					 struct gk20a_comptag_allocator *allocator,
+					 u32 lines)
+{
+	struct nvgpu_comptag_stats *stats =
+		&nvgpu_os_linux_from_gk20a(g)->comptag_stats;
+	unsigned long reserve;
+	long in_use;
+
+	if (buf->dmabuf->size >= ((u64)stats->small_kb << 10))
+		return false;
+
+	reserve = (allocator->size * min_t(u32, stats->reserve_pct, 100U)) /
+			100UL;
+	in_use = atomic_long_read(&stats->lines_in_use);
+
+	return ((unsigned long)in_use + lines + reserve) > allocator->size;
+}
+
+static int gk20a_do_alloc_comptags(struct gk20a *g, struct nvgpu_os_buffer *buf,
+				   struct gk20a_comptag_allocator *allocator,
+				   bool reserve)
 {
+	struct nvgpu_comptag_stats *stats =
+		&nvgpu_os_linux_from_gk20a(g)->comptag_stats;
 	struct gk20a_dmabuf_priv *priv = NULL;
 	u64 ctag_granularity;
 	u32 offset = 0;
 	u32 lines = 0;
+	bool denied;
 	int err;
 
 	ctag_granularity = g->ops.fb.compression_page_size(g);
@@ -60,7 +90,23 @@ int gk20a_alloc_comptags(struct gk20a *g, struct nvgpu_os_buffer *buf,
 		return -EINVAL;
 	}
 
-	err = gk20a_comptaglines_alloc(allocator, &offset, lines);
+	denied = !reserve &&
+		gk20a_comptags_policy_denies(g, buf, allocator, lines);
+	if (denied) {
+		nvgpu_log_info(g, "comptags withheld for %zu byte buffer",
+			       buf->dmabuf->size);
+		atomic_inc(&stats->policy_denied);
+		err = -ENOSPC;
+	} else {
+		err = gk20a_comptaglines_alloc(allocator, &offset, lines);
+		if (err == 0) {
+			atomic_inc(reserve ? &stats->reserved : &stats->allocs);
+			atomic_long_add(lines, &stats->lines_in_use);
+		} else {
+			atomic_inc(&stats->fallbacks);
+		}
+	}
+
 	if (err != 0) {
 		/*
 		 * Note: we must prevent reallocation attempt in case the
@@ -68,7 +114,8 @@ int gk20a_alloc_comptags(struct gk20a *g, struct nvgpu_os_buffer *buf,
 		 * could cause corruption because interop endpoints have
 		 * conflicting compression states with the maps
 		 */
-		nvgpu_err(g, "Comptags allocation failed %d", err);
+		if (!denied)
+			nvgpu_err(g, "Comptags allocation failed %d", err);
 		lines = 0;
 	}
 
@@ -88,6 +135,23 @@ int gk20a_alloc_comptags(struct gk20a *g, struct nvgpu_os_buffer *buf,
 	return err;
 }
 
+int gk20a_alloc_comptags(struct gk20a *g, struct nvgpu_os_buffer *buf,
+			 struct gk20a_comptag_allocator *allocator)
+{
+	return gk20a_do_alloc_comptags(g, buf, allocator, false);
+}
+
+/*
+ * Allocation on behalf of a registered buffer. These are long lived and
+ * were explicitly asked to be compressible, so they may take lines from
+ * the part of the pool held back from small map-time buffers.
+ */
+int gk20a_reserve_comptags(struct gk20a *g, struct nvgpu_os_buffer *buf,
+			   struct gk20a_comptag_allocator *allocator)
+{
+	return gk20a_do_alloc_comptags(g, buf, allocator, true);
+}
+
 void gk20a_alloc_or_get_comptags(struct gk20a *g,
 				 struct nvgpu_os_buffer *buf,
 				 struct gk20a_comptag_allocator *allocator,
@@ -115,6 +179,9 @@ void gk20a_alloc_or_get_comptags(struct gk20a *g,
 	if (!priv->registered || priv->mutable_metadata) {
 		if (!priv->comptags.allocated) {
 			gk20a_alloc_comptags(g, buf, allocator);
+		} else if (priv->comptags.lines != 0) {
+			atomic_inc(&nvgpu_os_linux_from_gk20a(g)->
+				   comptag_stats.hits);
 		}
 	}
 
@@ -127,6 +127,36 @@ static const struct file_operations cbc_status_debug_fops = {
 	.release        = cbc_status_debug_release,
 };
 
+static int comptag_stats_debug_show(struct seq_file *s, void *unused)
+{
+	struct gk20a *g = s->private;
+	struct nvgpu_comptag_stats *stats =
+		&nvgpu_os_linux_from_gk20a(g)->comptag_stats;
+	unsigned long pool = (g->cbc != NULL) ? g->cbc->comp_tags.size : 0UL;
+
+	seq_printf(s, "hits:          %d\n", atomic_read(&stats->hits));
+	seq_printf(s, "allocs:        %d\n", atomic_read(&stats->allocs));
+	seq_printf(s, "reserved:      %d\n", atomic_read(&stats->reserved));
+	seq_printf(s, "fallbacks:     %d\n", atomic_read(&stats->fallbacks));
+	seq_printf(s, "policy_denied: %d\n",
+		   atomic_read(&stats->policy_denied));
+	seq_printf(s, "lines_in_use:  %ld / %lu\n",
+		   atomic_long_read(&stats->lines_in_use), pool);
+	return 0;
+}
+
+static int comptag_stats_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, comptag_stats_debug_show, inode->i_private);
+}
+
+static const struct file_operations comptag_stats_debug_fops = {
+	.open           = comptag_stats_debug_open,
+	.read           = seq_read,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
 static ssize_t cbc_ctrl_debug_write_cmd(struct file *f, const char __user *cmd, size_t len, loff_t *off)
 {
 	char cmd_buf[32];
@@ -483,6 +513,14 @@ int gr_gk20a_debugfs_init(struct gk20a *g)
 		l->debugfs, g, &cbc_ctrl_debug_fops);
 	if (!d)
 		return -ENOMEM;
+	d = debugfs_create_file("comptag_stats", S_IRUGO, l->debugfs, g,
+		&comptag_stats_debug_fops);
+	if (!d)
+		return -ENOMEM;
+	debugfs_create_u32("comptag_reserve_pct", S_IRUGO|S_IWUSR,
+			l->debugfs, &l->comptag_stats.reserve_pct);
+	debugfs_create_u32("comptag_small_kb", S_IRUGO|S_IWUSR,
+			l->debugfs, &l->comptag_stats.small_kb);
 #endif /* CONFIG_NVGPU_COMPRESSION */
 
 	if (!g->is_virtual) {
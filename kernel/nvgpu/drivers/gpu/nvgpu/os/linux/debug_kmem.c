@@ -88,12 +88,15 @@ static void print_hr_bytes(struct seq_file *s, const char *msg, u64 bytes)
  * print_histogram - Build a histogram of the memory usage.
  *
  * @tracker The tracking to pull data from.
+ * @stats   Stats summed over the tracker's shards.
  * @s       A seq_file to dump info into.
  */
 static void print_histogram(struct nvgpu_mem_alloc_tracker *tracker,
+			    struct nvgpu_mem_alloc_stats *stats,
 			    struct seq_file *s)
 {
 	int i;
+	u32 shard;
 	u64 pot_min, pot_max;
 	u64 nr_buckets;
 	unsigned int *buckets;
@@ -108,8 +111,8 @@ static void print_histogram(struct nvgpu_mem_alloc_tracker *tracker,
 	 * nearest power of two. Each histogram bucket is one power of two so
 	 * the histogram buckets are exponential.
 	 */
-	pot_min = (u64)rounddown_pow_of_two(tracker->min_alloc);
-	pot_max = (u64)roundup_pow_of_two(tracker->max_alloc);
+	pot_min = (u64)rounddown_pow_of_two(stats->min_alloc);
+	pot_max = (u64)roundup_pow_of_two(stats->max_alloc);
 
 	nr_buckets = __ffs(pot_max) - __ffs(pot_min);
 
@@ -124,32 +127,35 @@ static void print_histogram(struct nvgpu_mem_alloc_tracker *tracker,
 	 * should go in. Round the size down to the nearest power of two to
 	 * find the right bucket.
 	 */
-	nvgpu_rbtree_enum_start(0, &node, tracker->allocs);
-	while (node) {
-		int b;
-		u64 bucket_min;
-		struct nvgpu_mem_alloc *alloc =
-			nvgpu_mem_alloc_from_rbtree_node(node);
-
-		bucket_min = (u64)rounddown_pow_of_two(alloc->size);
-		if (bucket_min < tracker->min_alloc)
-			bucket_min = tracker->min_alloc;
-
-		b = __ffs(bucket_min) - __ffs(pot_min);
-
-		/*
-		 * Handle the one case were there's an alloc exactly as big as
-		 * the maximum bucket size of the largest bucket. Most of the
-		 * buckets have an inclusive minimum and exclusive maximum. But
-		 * the largest bucket needs to have an _inclusive_ maximum as
-		 * well.
-		 */
-		if (b == (int)nr_buckets)
-			b--;
-
-		buckets[b]++;
-
-		nvgpu_rbtree_enum_next(&node, node);
+	for (shard = 0; shard < NVGPU_KMEM_TRACKER_SHARDS; shard++) {
+		nvgpu_rbtree_enum_start(0, &node,
+					tracker->shards[shard].allocs);
+		while (node) {
+			int b;
+			u64 bucket_min;
+			struct nvgpu_mem_alloc *alloc =
+				nvgpu_mem_alloc_from_rbtree_node(node);
+
+			bucket_min = (u64)rounddown_pow_of_two(alloc->size);
+			if (bucket_min < stats->min_alloc)
+				bucket_min = stats->min_alloc;
+
+			b = __ffs(bucket_min) - __ffs(pot_min);
+
+			/*
+			 * Handle the one case were there's an alloc exactly as
+			 * big as the maximum bucket size of the largest
+			 * bucket. Most of the buckets have an inclusive
+			 * minimum and exclusive maximum. But the largest
+			 * bucket needs to have an _inclusive_ maximum as well.
+			 */
+			if (b == (int)nr_buckets)
+				b--;
+
+			buckets[b]++;
+
+			nvgpu_rbtree_enum_next(&node, node);
+		}
 	}
 
 	total_allocs = 0;
@@ -200,26 +206,30 @@ static void print_histogram(struct nvgpu_mem_alloc_tracker *tracker,
 void nvgpu_kmem_print_stats(struct nvgpu_mem_alloc_tracker *tracker,
 			    struct seq_file *s)
 {
+	struct nvgpu_mem_alloc_stats stats;
+
 	nvgpu_lock_tracker(tracker);
 
+	nvgpu_tracker_stats(tracker, &stats);
+
 	__pstat(s, "Mem tracker: %s\n\n", tracker->name);
 
 	__pstat(s, "Basic Stats:\n");
 	__pstat(s,        "  Number of allocs        %lld\n",
-		tracker->nr_allocs);
+		stats.nr_allocs);
 	__pstat(s,        "  Number of frees         %lld\n",
-		tracker->nr_frees);
-	print_hr_bytes(s, "  Smallest alloc          ", tracker->min_alloc);
-	print_hr_bytes(s, "  Largest alloc           ", tracker->max_alloc);
-	print_hr_bytes(s, "  Bytes allocated         ", tracker->bytes_alloced);
-	print_hr_bytes(s, "  Bytes freed             ", tracker->bytes_freed);
+		stats.nr_frees);
+	print_hr_bytes(s, "  Smallest alloc          ", stats.min_alloc);
+	print_hr_bytes(s, "  Largest alloc           ", stats.max_alloc);
+	print_hr_bytes(s, "  Bytes allocated         ", stats.bytes_alloced);
+	print_hr_bytes(s, "  Bytes freed             ", stats.bytes_freed);
 	print_hr_bytes(s, "  Bytes allocated (real)  ",
-		       tracker->bytes_alloced_real);
+		       stats.bytes_alloced_real);
 	print_hr_bytes(s, "  Bytes freed (real)      ",
-		       tracker->bytes_freed_real);
+		       stats.bytes_freed_real);
 	__pstat(s, "\n");
 
-	print_histogram(tracker, s);
+	print_histogram(tracker, &stats, s);
 
 	nvgpu_unlock_tracker(tracker);
 }
@@ -250,15 +260,18 @@ static int __kmem_traces_dump_tracker(struct gk20a *g,
 				      struct seq_file *s)
 {
 	struct nvgpu_rbtree_node *node;
+	u32 i;
 
-	nvgpu_rbtree_enum_start(0, &node, tracker->allocs);
-	while (node) {
-		struct nvgpu_mem_alloc *alloc =
-			nvgpu_mem_alloc_from_rbtree_node(node);
+	for (i = 0; i < NVGPU_KMEM_TRACKER_SHARDS; i++) {
+		nvgpu_rbtree_enum_start(0, &node, tracker->shards[i].allocs);
+		while (node) {
+			struct nvgpu_mem_alloc *alloc =
+				nvgpu_mem_alloc_from_rbtree_node(node);
 
-		kmem_print_mem_alloc(g, alloc, s);
+			kmem_print_mem_alloc(g, alloc, s);
 
-		nvgpu_rbtree_enum_next(&node, node);
+			nvgpu_rbtree_enum_next(&node, node);
+		}
 	}
 
 	return 0;
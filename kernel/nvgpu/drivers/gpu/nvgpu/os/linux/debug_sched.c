@@ -17,6 +17,7 @@
 #include "debug_sched.h"
 #include "os_linux.h"
 #include <nvgpu/nvgpu_init.h>
+#include <nvgpu/tsg.h>
 
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
@@ -73,10 +74,95 @@ static const struct file_operations gk20a_sched_debugfs_fops = {
 	.release	= single_release,
 };
 
+#ifdef CONFIG_NVGPU_FECS_TRACE
+/*
+ * Resolve a context back to its TSG through the owning process; only
+ * reported when the process has a single open TSG.
+ */
+static int gk20a_sched_stats_tsgid(struct gk20a *g, u64 pid)
+{
+	struct nvgpu_sched_ctrl *sched = &g->sched_ctrl;
+	struct nvgpu_fifo *f = &g->fifo;
+	struct nvgpu_tsg *tsg;
+	unsigned int tsgid;
+	int found = -1;
+
+	for (tsgid = 0; tsgid < f->num_channels; tsgid++) {
+		if (!NVGPU_SCHED_ISSET(tsgid, sched->active_tsg_bitmap))
+			continue;
+
+		tsg = nvgpu_tsg_get_from_id(g, tsgid);
+		if ((u64)tsg->tgid != pid)
+			continue;
+
+		if (found >= 0)
+			return -1;
+		found = (int)tsgid;
+	}
+
+	return found;
+}
+
+static int gk20a_sched_tsg_stats_show(struct seq_file *s, void *unused)
+{
+	struct gk20a *g = s->private;
+	struct nvgpu_os_linux *l = nvgpu_os_linux_from_gk20a(g);
+	struct nvgpu_sched_ctrl *sched = &g->sched_ctrl;
+	struct gk20a_sched_ctx_stats *stats;
+	u32 i;
+
+	if (!l->sched_ctx_stats)
+		return -ENODEV;
+
+	seq_puts(s, "context_id pid tsgid busy_ns ctxsw preempt "
+			"preempt_ns_avg preempt_ns_max\n");
+
+	nvgpu_mutex_acquire(&sched->status_lock);
+	nvgpu_mutex_acquire(&l->sched_ctx_stats_lock);
+
+	for (i = 0; i < g->fifo.num_channels; i++) {
+		stats = &l->sched_ctx_stats[i];
+		if (stats->context_id == 0U)
+			continue;
+
+		seq_printf(s, "%08x %llu %d %llu %llu %llu %llu %llu\n",
+			   stats->context_id, stats->pid,
+			   gk20a_sched_stats_tsgid(g, stats->pid),
+			   stats->busy_ns, stats->ctxsw_count,
+			   stats->preempt_count,
+			   stats->preempt_count ?
+				div64_u64(stats->preempt_ns_total,
+					  stats->preempt_count) : 0ULL,
+			   stats->preempt_ns_max);
+	}
+
+	nvgpu_mutex_release(&l->sched_ctx_stats_lock);
+	nvgpu_mutex_release(&sched->status_lock);
+
+	return 0;
+}
+
+static int gk20a_sched_tsg_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, gk20a_sched_tsg_stats_show, inode->i_private);
+}
+
+static const struct file_operations gk20a_sched_tsg_stats_fops = {
+	.open		= gk20a_sched_tsg_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 void gk20a_sched_debugfs_init(struct gk20a *g)
 {
 	struct nvgpu_os_linux *l = nvgpu_os_linux_from_gk20a(g);
 
 	debugfs_create_file("sched_ctrl", S_IRUGO, l->debugfs,
 			g, &gk20a_sched_debugfs_fops);
+#ifdef CONFIG_NVGPU_FECS_TRACE
+	debugfs_create_file("sched_tsg_stats", S_IRUGO, l->debugfs,
+			g, &gk20a_sched_tsg_stats_fops);
+#endif
 }
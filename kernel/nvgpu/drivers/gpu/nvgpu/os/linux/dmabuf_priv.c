@@ -224,6 +224,8 @@ void gk20a_mm_delete_priv(struct gk20a_dmabuf_priv *priv)
 		gk20a_comptaglines_free(priv->comptag_allocator,
 				priv->comptags.offset,
 				priv->comptags.lines);
+		atomic_long_sub(priv->comptags.lines,
+			&nvgpu_os_linux_from_gk20a(g)->comptag_stats.lines_in_use);
 	}
 
 	/* Free buffer states */
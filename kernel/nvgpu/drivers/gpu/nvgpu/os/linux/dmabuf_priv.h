@@ -125,6 +125,14 @@ int gk20a_dmabuf_get_state(struct dma_buf *dmabuf, struct gk20a *g,
 void gk20a_dma_buf_priv_list_clear(struct nvgpu_os_linux *l);
 struct gk20a_dmabuf_priv *gk20a_dma_buf_get_drvdata(
 		struct dma_buf *dmabuf, struct device *device);
+
+/* Share of the comptag pool kept back from small map-time allocations */
+#define NVGPU_COMPTAG_DEFAULT_RESERVE_PCT	25U
+/* Buffers below this size do not get comptags from the reserve */
+#define NVGPU_COMPTAG_DEFAULT_SMALL_KB		1024U
+
+int gk20a_reserve_comptags(struct gk20a *g, struct nvgpu_os_buffer *buf,
+			   struct gk20a_comptag_allocator *allocator);
 #endif
 
 void *gk20a_dmabuf_vmap(struct dma_buf *dmabuf);
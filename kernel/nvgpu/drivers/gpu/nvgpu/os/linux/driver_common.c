@@ -45,6 +45,7 @@
 #include "sysfs.h"
 #include "ioctl.h"
 #include "scale.h"
+#include "dmabuf_priv.h"
 
 #define EMC3D_DEFAULT_RATIO 750
 
@@ -174,6 +175,11 @@ static void nvgpu_init_max_comptag(struct gk20a *g)
 	nvgpu_log_info(g, "total ram pages : %lu", totalram_pages);
 #endif
 	g->max_comptag_mem = totalram_size_in_mb;
+
+	nvgpu_os_linux_from_gk20a(g)->comptag_stats.reserve_pct =
+		NVGPU_COMPTAG_DEFAULT_RESERVE_PCT;
+	nvgpu_os_linux_from_gk20a(g)->comptag_stats.small_kb =
+		NVGPU_COMPTAG_DEFAULT_SMALL_KB;
 #endif
 }
 
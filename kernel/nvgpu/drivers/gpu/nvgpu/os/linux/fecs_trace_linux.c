@@ -43,6 +43,10 @@ struct gk20a_ctxsw_dev {
 	struct nvgpu_ctxsw_ring_header *hdr;
 	struct nvgpu_gpu_ctxsw_trace_entry *ents;
 	struct nvgpu_gpu_ctxsw_trace_filter filter;
+	/* only keep entries of this process when non-zero */
+	u64 filter_pid;
+	/* pending entries needed before readers are woken up */
+	u32 wake_threshold;
 	bool write_enabled;
 	struct nvgpu_cond readout_wq;
 	size_t size;
@@ -73,6 +77,21 @@ static inline int ring_len(struct nvgpu_ctxsw_ring_header *hdr)
 	return (hdr->write_idx - hdr->read_idx) % hdr->num_ents;
 }
 
+/*
+ * Readers of a pending ring below the wake threshold are left asleep; the
+ * records stay visible through the mmap and are reported on a later batch.
+ */
+static bool gk20a_ctxsw_dev_readable(struct gk20a_ctxsw_dev *dev)
+{
+	struct nvgpu_ctxsw_ring_header *hdr = dev->hdr;
+
+	if (hdr == NULL || ring_is_empty(hdr))
+		return false;
+
+	return (u32)ring_len(hdr) >= dev->wake_threshold ||
+		ring_len(hdr) >= (int)(hdr->num_ents / 2U);
+}
+
 static void nvgpu_set_ctxsw_trace_entry(
 	struct nvgpu_ctxsw_trace_entry *entry_dst,
 	struct nvgpu_gpu_ctxsw_trace_entry *entry_src)
@@ -469,14 +488,13 @@ unsigned int gk20a_ctxsw_dev_poll(struct file *filp, poll_table *wait)
 {
 	struct gk20a_ctxsw_dev *dev = filp->private_data;
 	struct gk20a *g = dev->g;
-	struct nvgpu_ctxsw_ring_header *hdr = dev->hdr;
 	unsigned int mask = 0;
 
 	nvgpu_log(g, gpu_dbg_fn|gpu_dbg_ctxsw, " ");
 
 	nvgpu_mutex_acquire(&dev->write_lock);
 	poll_wait(filp, &dev->readout_wq.wq, wait);
-	if (!ring_is_empty(hdr))
+	if (gk20a_ctxsw_dev_readable(dev))
 		mask |= POLLIN | POLLRDNORM;
 	nvgpu_mutex_release(&dev->write_lock);
 
@@ -563,6 +581,8 @@ static int gk20a_ctxsw_init_devs(struct gk20a *g)
 		dev->g = g;
 		dev->hdr = NULL;
 		dev->write_enabled = false;
+		dev->filter_pid = 0;
+		dev->wake_threshold = 1;
 		nvgpu_cond_init(&dev->readout_wq);
 		nvgpu_mutex_init(&dev->write_lock);
 		nvgpu_atomic_set(&dev->vma_ref, 0);
@@ -645,6 +665,9 @@ int nvgpu_gr_fecs_trace_write_entry(struct gk20a *g,
 	if (unlikely(entry->vmid >= GK20A_CTXSW_TRACE_NUM_DEVS))
 		return -ENODEV;
 
+	/* Per-TSG time accounting sees every entry, filtered or not */
+	gk20a_sched_ctrl_ctxsw_event(g, entry);
+
 	dev = &g->ctxsw_trace->devs[entry->vmid];
 	hdr = dev->hdr;
 
@@ -688,6 +711,11 @@ int nvgpu_gr_fecs_trace_write_entry(struct gk20a *g,
 		goto filter;
 	}
 
+	if (dev->filter_pid != 0ULL && entry->pid != dev->filter_pid) {
+		reason = "pid filtered out";
+		goto filter;
+	}
+
 	nvgpu_log(g, gpu_dbg_ctxsw,
 		"seqno=%d context_id=%08x pid=%lld tag=%x timestamp=%llx",
 		entry->seqno, entry->context_id, entry->pid,
@@ -729,12 +757,59 @@ done:
 void nvgpu_gr_fecs_trace_wake_up(struct gk20a *g, int vmid)
 {
 	struct gk20a_ctxsw_dev *dev;
+	bool wake;
 
 	if (!g->ctxsw_trace)
 		return;
 
 	dev = &g->ctxsw_trace->devs[vmid];
-	nvgpu_cond_signal_interruptible(&dev->readout_wq);
+
+	nvgpu_mutex_acquire(&dev->write_lock);
+	wake = gk20a_ctxsw_dev_readable(dev);
+	nvgpu_mutex_release(&dev->write_lock);
+
+	if (wake)
+		nvgpu_cond_signal_interruptible(&dev->readout_wq);
+}
+
+int nvgpu_gr_fecs_trace_set_pid_filter(struct gk20a *g, u64 pid)
+{
+	struct gk20a_ctxsw_dev *dev;
+
+	if (!g->ctxsw_trace)
+		return -ENODEV;
+
+	dev = &g->ctxsw_trace->devs[0];
+	nvgpu_mutex_acquire(&dev->write_lock);
+	dev->filter_pid = pid;
+	nvgpu_mutex_release(&dev->write_lock);
+
+	return 0;
+}
+
+u64 nvgpu_gr_fecs_trace_get_pid_filter(struct gk20a *g)
+{
+	return g->ctxsw_trace ? g->ctxsw_trace->devs[0].filter_pid : 0ULL;
+}
+
+int nvgpu_gr_fecs_trace_set_wake_threshold(struct gk20a *g, u32 entries)
+{
+	struct gk20a_ctxsw_dev *dev;
+
+	if (!g->ctxsw_trace)
+		return -ENODEV;
+
+	dev = &g->ctxsw_trace->devs[0];
+	nvgpu_mutex_acquire(&dev->write_lock);
+	dev->wake_threshold = entries;
+	nvgpu_mutex_release(&dev->write_lock);
+
+	return 0;
+}
+
+u32 nvgpu_gr_fecs_trace_get_wake_threshold(struct gk20a *g)
+{
+	return g->ctxsw_trace ? g->ctxsw_trace->devs[0].wake_threshold : 0U;
 }
 
 void nvgpu_gr_fecs_trace_add_tsg_reset(struct gk20a *g, struct nvgpu_tsg *tsg)
@@ -44,4 +44,9 @@ ssize_t gk20a_ctxsw_dev_read(struct file *filp, char __user *buf,
 unsigned int gk20a_ctxsw_dev_poll(struct file *filp,
 				  struct poll_table_struct *pts);
 
+int nvgpu_gr_fecs_trace_set_pid_filter(struct gk20a *g, u64 pid);
+u64 nvgpu_gr_fecs_trace_get_pid_filter(struct gk20a *g);
+int nvgpu_gr_fecs_trace_set_wake_threshold(struct gk20a *g, u32 entries);
+u32 nvgpu_gr_fecs_trace_get_wake_threshold(struct gk20a *g);
+
 #endif /*NVGPU_FECS_TRACE_LINUX_H */
@@ -38,6 +38,7 @@
 #include "os_linux.h"
 #include "fecs_trace_linux.h"
 #include "platform_gk20a.h"
+#include "tstamp_ring.h"
 
 const struct file_operations gk20a_power_node_ops = {
 	.owner = THIS_MODULE,
@@ -162,6 +163,13 @@ static const struct file_operations gk20a_sched_ops = {
 	.read = gk20a_sched_dev_read,
 };
 
+static const struct file_operations gk20a_tstamp_ops = {
+	.owner = THIS_MODULE,
+	.release = gk20a_tstamp_dev_release,
+	.open = gk20a_tstamp_dev_open,
+	.mmap = gk20a_tstamp_dev_mmap,
+};
+
 static const struct file_operations nvgpu_nvs_ops = {
 	.owner          = THIS_MODULE,
 	.release        = nvgpu_nvs_dev_release,
@@ -199,6 +207,7 @@ static const struct nvgpu_dev_node dev_node_list[] = {
 	{"sched",	&gk20a_sched_ops,	false,	false	},
 	{"nvsched",	&nvgpu_nvs_ops,		false,	false	},
 	{"tsg",		&gk20a_tsg_ops,		false,	false	},
+	{"tstamp",	&gk20a_tstamp_ops,	false,	false	},
 };
 
 static char *nvgpu_devnode(const char *cdev_name)
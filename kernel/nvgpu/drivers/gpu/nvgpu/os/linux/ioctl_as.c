@@ -216,6 +216,14 @@ static int gk20a_as_ioctl_map_buffer_batch(
 			&batch);
 		if (err)
 			break;
+
+		/* hand out the GPU VA of non-fixed maps as MAP_BUFFER_EX does */
+		if (!(map_args.flags & NVGPU_AS_MAP_BUFFER_FLAGS_FIXED_OFFSET) &&
+		    put_user(map_args.offset, &user_map_args[i].offset)) {
+			nvgpu_vm_unmap(as_share->vm, map_args.offset, &batch);
+			err = -EFAULT;
+			break;
+		}
 	}
 
 	nvgpu_vm_mapping_batch_finish(as_share->vm, &batch);
@@ -60,6 +60,7 @@
 #include "channel.h"
 #include "os_linux.h"
 #include "dmabuf_priv.h"
+#include "tstamp_ring.h"
 
 /* the minimal size of client buffer */
 #define CSS_MIN_CLIENT_SNAPSHOT_SIZE				\
@@ -879,6 +880,7 @@ static int gk20a_ioctl_channel_submit_gpfifo(
 
 	nvgpu_swprofile_begin_sample(kickoff_profiler);
 	nvgpu_swprofile_snapshot(kickoff_profiler, PROF_KICKOFF_IOCTL_ENTRY);
+	nvgpu_tstamp_record(g, NVGPU_TSTAMP_SUBMIT_ENTRY, ch->chid, 0);
 
 	if (nvgpu_channel_check_unserviceable(ch)) {
 		return -ETIMEDOUT;
@@ -941,6 +943,8 @@ static int gk20a_ioctl_channel_submit_gpfifo(
 	}
 
 	nvgpu_swprofile_snapshot(kickoff_profiler, PROF_KICKOFF_IOCTL_EXIT);
+	nvgpu_tstamp_record(g, NVGPU_TSTAMP_SUBMIT_EXIT, ch->chid,
+			    fence_out.syncpt_value);
 
 clean_up:
 	return ret;
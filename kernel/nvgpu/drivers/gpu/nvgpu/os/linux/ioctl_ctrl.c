@@ -2083,7 +2083,7 @@ static int nvgpu_handle_comptags_control(struct gk20a *g,
 	os_buf.dmabuf = dmabuf;
 	os_buf.dev = dev_from_gk20a(g);
 
-	err = gk20a_alloc_comptags(g, &os_buf, &g->cbc->comp_tags);
+	err = gk20a_reserve_comptags(g, &os_buf, &g->cbc->comp_tags);
 	if (err != 0) {
 		if (comptags_alloc_control ==
 				NVGPU_GPU_COMPTAGS_ALLOC_REQUIRED) {
@@ -20,6 +20,7 @@
 #include <linux/seq_file.h>
 #include <linux/vmalloc.h>
 #include <linux/stacktrace.h>
+#include <linux/hash.h>
 
 #include <nvgpu/lock.h>
 #include <nvgpu/kmem.h>
@@ -170,12 +171,51 @@ void nvgpu_vfree_impl(struct gk20a *g, void *addr)
 
 void nvgpu_lock_tracker(struct nvgpu_mem_alloc_tracker *tracker)
 {
-	nvgpu_mutex_acquire(&tracker->lock);
+	percpu_down_write(&tracker->rw);
 }
 
 void nvgpu_unlock_tracker(struct nvgpu_mem_alloc_tracker *tracker)
 {
-	nvgpu_mutex_release(&tracker->lock);
+	percpu_up_write(&tracker->rw);
+}
+
+void nvgpu_tracker_stats(struct nvgpu_mem_alloc_tracker *tracker,
+			 struct nvgpu_mem_alloc_stats *stats)
+{
+	struct nvgpu_mem_alloc_shard *shard;
+	u32 i;
+
+	(void) memset(stats, 0, sizeof(*stats));
+	stats->min_alloc = ULONG_MAX;
+
+	for (i = 0; i < NVGPU_KMEM_TRACKER_SHARDS; i++) {
+		shard = &tracker->shards[i];
+
+		stats->bytes_alloced += shard->bytes_alloced;
+		stats->bytes_freed += shard->bytes_freed;
+		stats->bytes_alloced_real += shard->bytes_alloced_real;
+		stats->bytes_freed_real += shard->bytes_freed_real;
+		stats->nr_allocs += shard->nr_allocs;
+		stats->nr_frees += shard->nr_frees;
+		stats->min_alloc = min(stats->min_alloc, shard->min_alloc);
+		stats->max_alloc = max(stats->max_alloc, shard->max_alloc);
+	}
+}
+
+static struct nvgpu_mem_alloc_shard *nvgpu_tracker_shard(
+	struct nvgpu_mem_alloc_tracker *tracker, u64 addr)
+{
+	return &tracker->shards[hash_64(addr >> L1_CACHE_SHIFT,
+					NVGPU_KMEM_TRACKER_SHARD_BITS)];
+}
+
+static void nvgpu_free_alloc_info(struct nvgpu_mem_alloc_tracker *tracker,
+				  struct nvgpu_mem_alloc *alloc)
+{
+	if (alloc->cached)
+		nvgpu_kmem_cache_free(tracker->allocs_cache, alloc);
+	else
+		kfree(alloc);
 }
 
 void kmem_print_mem_alloc(struct gk20a *g,
@@ -198,29 +238,29 @@ void kmem_print_mem_alloc(struct gk20a *g,
 #endif
 }
 
-static int nvgpu_add_alloc(struct nvgpu_mem_alloc_tracker *tracker,
+static int nvgpu_add_alloc(struct nvgpu_mem_alloc_shard *shard,
 			   struct nvgpu_mem_alloc *alloc)
 {
 	alloc->allocs_entry.key_start = alloc->addr;
 	alloc->allocs_entry.key_end = alloc->addr + alloc->size;
 
-	nvgpu_rbtree_insert(&alloc->allocs_entry, &tracker->allocs);
+	nvgpu_rbtree_insert(&alloc->allocs_entry, &shard->allocs);
 	return 0;
 }
 
 static struct nvgpu_mem_alloc *nvgpu_rem_alloc(
-	struct nvgpu_mem_alloc_tracker *tracker, u64 alloc_addr)
+	struct nvgpu_mem_alloc_shard *shard, u64 alloc_addr)
 {
 	struct nvgpu_mem_alloc *alloc;
 	struct nvgpu_rbtree_node *node = NULL;
 
-	nvgpu_rbtree_search(alloc_addr, &node, tracker->allocs);
+	nvgpu_rbtree_search(alloc_addr, &node, shard->allocs);
 	if (!node)
 		return NULL;
 
 	alloc = nvgpu_mem_alloc_from_rbtree_node(node);
 
-	nvgpu_rbtree_unlink(node, &tracker->allocs);
+	nvgpu_rbtree_unlink(node, &shard->allocs);
 
 	return alloc;
 }
@@ -231,11 +271,24 @@ static int __nvgpu_save_kmem_alloc(struct nvgpu_mem_alloc_tracker *tracker,
 {
 	int ret;
 	struct nvgpu_mem_alloc *alloc;
+	struct nvgpu_mem_alloc_shard *shard;
 #ifdef NVGPU_SAVE_KALLOC_STACK_TRACES
 	struct stack_trace stack_trace;
 #endif
 
-	alloc = kzalloc(sizeof(*alloc), GFP_KERNEL);
+	/*
+	 * The cache itself is created through the tracked allocator, so the
+	 * first few allocs of a tracker still come from kzalloc().
+	 */
+	if (tracker->allocs_cache) {
+		alloc = nvgpu_kmem_cache_alloc(tracker->allocs_cache);
+		if (alloc) {
+			(void) memset(alloc, 0, sizeof(*alloc));
+			alloc->cached = true;
+		}
+	} else {
+		alloc = kzalloc(sizeof(*alloc), GFP_KERNEL);
+	}
 	if (!alloc)
 		return -ENOMEM;
 
@@ -265,25 +318,29 @@ static int __nvgpu_save_kmem_alloc(struct nvgpu_mem_alloc_tracker *tracker,
 	alloc->stack_length = stack_trace.nr_entries;
 #endif
 
-	nvgpu_lock_tracker(tracker);
-	tracker->bytes_alloced += size;
-	tracker->bytes_alloced_real += real_size;
-	tracker->nr_allocs++;
+	shard = nvgpu_tracker_shard(tracker, addr);
+
+	percpu_down_read(&tracker->rw);
+	nvgpu_spinlock_acquire(&shard->lock);
+	shard->bytes_alloced += size;
+	shard->bytes_alloced_real += real_size;
+	shard->nr_allocs++;
 
 	/* Keep track of this for building a histogram later on. */
-	if (tracker->max_alloc < size)
-		tracker->max_alloc = size;
-	if (tracker->min_alloc > size)
-		tracker->min_alloc = size;
+	if (shard->max_alloc < size)
+		shard->max_alloc = size;
+	if (shard->min_alloc > size)
+		shard->min_alloc = size;
+
+	ret = nvgpu_add_alloc(shard, alloc);
+	nvgpu_spinlock_release(&shard->lock);
+	percpu_up_read(&tracker->rw);
 
-	ret = nvgpu_add_alloc(tracker, alloc);
 	if (ret) {
 		WARN(1, "Duplicate alloc??? 0x%llx\n", addr);
-		kfree(alloc);
-		nvgpu_unlock_tracker(tracker);
+		nvgpu_free_alloc_info(tracker, alloc);
 		return ret;
 	}
-	nvgpu_unlock_tracker(tracker);
 
 	return 0;
 }
@@ -291,23 +348,29 @@ static int __nvgpu_save_kmem_alloc(struct nvgpu_mem_alloc_tracker *tracker,
 static int __nvgpu_free_kmem_alloc(struct nvgpu_mem_alloc_tracker *tracker,
 				   u64 addr)
 {
+	struct nvgpu_mem_alloc_shard *shard = nvgpu_tracker_shard(tracker, addr);
 	struct nvgpu_mem_alloc *alloc;
 
-	nvgpu_lock_tracker(tracker);
-	alloc = nvgpu_rem_alloc(tracker, addr);
+	percpu_down_read(&tracker->rw);
+	nvgpu_spinlock_acquire(&shard->lock);
+	alloc = nvgpu_rem_alloc(shard, addr);
 	if (!alloc) {
-		nvgpu_unlock_tracker(tracker);
+		nvgpu_spinlock_release(&shard->lock);
+		percpu_up_read(&tracker->rw);
 		nvgpu_do_assert_print(g,
 			"Possible double-free detected: 0x%llx!", addr);
 		return -EINVAL;
 	}
 
-	(void) memset((void *)alloc->addr, 0, alloc->size);
+	shard->nr_frees++;
+	shard->bytes_freed += alloc->size;
+	shard->bytes_freed_real += alloc->real_size;
+	nvgpu_spinlock_release(&shard->lock);
+	percpu_up_read(&tracker->rw);
 
-	tracker->nr_frees++;
-	tracker->bytes_freed += alloc->size;
-	tracker->bytes_freed_real += alloc->real_size;
-	nvgpu_unlock_tracker(tracker);
+	/* Only this caller can reach the alloc once it is out of the tree */
+	(void) memset((void *)alloc->addr, 0, alloc->size);
+	nvgpu_free_alloc_info(tracker, alloc);
 
 	return 0;
 }
@@ -440,17 +503,20 @@ static int __do_check_for_outstanding_allocs(
 {
 	struct nvgpu_rbtree_node *node;
 	int count = 0;
+	u32 i;
 
-	nvgpu_rbtree_enum_start(0, &node, tracker->allocs);
-	while (node) {
-		struct nvgpu_mem_alloc *alloc =
-			nvgpu_mem_alloc_from_rbtree_node(node);
+	for (i = 0; i < NVGPU_KMEM_TRACKER_SHARDS; i++) {
+		nvgpu_rbtree_enum_start(0, &node, tracker->shards[i].allocs);
+		while (node) {
+			struct nvgpu_mem_alloc *alloc =
+				nvgpu_mem_alloc_from_rbtree_node(node);
 
-		if (!silent)
-			kmem_print_mem_alloc(g, alloc, NULL);
+			if (!silent)
+				kmem_print_mem_alloc(g, alloc, NULL);
 
-		count++;
-		nvgpu_rbtree_enum_next(&node, node);
+			count++;
+			nvgpu_rbtree_enum_next(&node, node);
+		}
 	}
 
 	return count;
@@ -479,20 +545,26 @@ static int check_for_outstanding_allocs(struct gk20a *g, bool silent)
 static void do_nvgpu_kmem_cleanup(struct nvgpu_mem_alloc_tracker *tracker,
 				  void (*force_free_func)(const void *))
 {
+	struct nvgpu_mem_alloc_shard *shard;
 	struct nvgpu_rbtree_node *node;
+	u32 i;
 
-	nvgpu_rbtree_enum_start(0, &node, tracker->allocs);
-	while (node) {
-		struct nvgpu_mem_alloc *alloc =
-			nvgpu_mem_alloc_from_rbtree_node(node);
+	for (i = 0; i < NVGPU_KMEM_TRACKER_SHARDS; i++) {
+		shard = &tracker->shards[i];
 
-		if (force_free_func)
-			force_free_func((void *)alloc->addr);
+		nvgpu_rbtree_enum_start(0, &node, shard->allocs);
+		while (node) {
+			struct nvgpu_mem_alloc *alloc =
+				nvgpu_mem_alloc_from_rbtree_node(node);
 
-		nvgpu_rbtree_unlink(node, &tracker->allocs);
-		kfree(alloc);
+			if (force_free_func)
+				force_free_func((void *)alloc->addr);
+
+			nvgpu_rbtree_unlink(node, &shard->allocs);
+			nvgpu_free_alloc_info(tracker, alloc);
 
-		nvgpu_rbtree_enum_start(0, &node, tracker->allocs);
+			nvgpu_rbtree_enum_start(0, &node, shard->allocs);
+		}
 	}
 }
 
@@ -549,6 +621,22 @@ void nvgpu_kmem_fini(struct gk20a *g, int flags)
 	}
 }
 
+static int nvgpu_kmem_tracker_init(struct nvgpu_mem_alloc_tracker *tracker,
+				   const char *name, unsigned long min_alloc)
+{
+	u32 i;
+
+	tracker->name = name;
+
+	for (i = 0; i < NVGPU_KMEM_TRACKER_SHARDS; i++) {
+		nvgpu_spinlock_init(&tracker->shards[i].lock);
+		tracker->shards[i].allocs = NULL;
+		tracker->shards[i].min_alloc = min_alloc;
+	}
+
+	return percpu_init_rwsem(&tracker->rw);
+}
+
 int nvgpu_kmem_init(struct gk20a *g)
 {
 	int err;
@@ -561,17 +649,17 @@ int nvgpu_kmem_init(struct gk20a *g)
 		goto fail;
 	}
 
-	g->vmallocs->name = "vmalloc";
-	g->kmallocs->name = "kmalloc";
-
-	g->vmallocs->allocs = NULL;
-	g->kmallocs->allocs = NULL;
-
-	nvgpu_mutex_init(&g->vmallocs->lock);
-	nvgpu_mutex_init(&g->kmallocs->lock);
+	err = nvgpu_kmem_tracker_init(g->vmallocs, "vmalloc",
+				      NVGPU_CPU_PAGE_SIZE);
+	if (err)
+		goto fail;
 
-	g->vmallocs->min_alloc = NVGPU_CPU_PAGE_SIZE;
-	g->kmallocs->min_alloc = KMALLOC_MIN_SIZE;
+	err = nvgpu_kmem_tracker_init(g->kmallocs, "kmalloc",
+				      KMALLOC_MIN_SIZE);
+	if (err) {
+		percpu_free_rwsem(&g->vmallocs->rw);
+		goto fail;
+	}
 
 	/*
 	 * This needs to go after all the other initialization since they use
@@ -588,6 +676,8 @@ int nvgpu_kmem_init(struct gk20a *g)
 			nvgpu_kmem_cache_destroy(g->vmallocs->allocs_cache);
 		if (g->kmallocs->allocs_cache)
 			nvgpu_kmem_cache_destroy(g->kmallocs->allocs_cache);
+		percpu_free_rwsem(&g->vmallocs->rw);
+		percpu_free_rwsem(&g->kmallocs->rw);
 		goto fail;
 	}
 
@@ -17,6 +17,9 @@
 #ifndef __KMEM_PRIV_H__
 #define __KMEM_PRIV_H__
 
+#include <linux/cache.h>
+#include <linux/percpu-rwsem.h>
+
 #include <nvgpu/rbtree.h>
 #include <nvgpu/lock.h>
 
@@ -64,6 +67,9 @@ struct nvgpu_mem_alloc {
 	unsigned long size;
 	unsigned long real_size;
 
+	/* Allocated from owner->allocs_cache rather than kzalloc() */
+	bool cached;
+
 	struct nvgpu_rbtree_node allocs_entry;
 };
 
@@ -74,15 +80,45 @@ nvgpu_mem_alloc_from_rbtree_node(struct nvgpu_rbtree_node *node)
 	((uintptr_t)node - offsetof(struct nvgpu_mem_alloc, allocs_entry));
 };
 
+#define NVGPU_KMEM_TRACKER_SHARD_BITS		4
+#define NVGPU_KMEM_TRACKER_SHARDS		(1U << NVGPU_KMEM_TRACKER_SHARD_BITS)
+
+/*
+ * One slice of a tracker. An alloc's shard is picked from its address so the
+ * free, which may run on any CPU, finds it again.
+ */
+struct nvgpu_mem_alloc_shard {
+	struct nvgpu_spinlock lock;
+	struct nvgpu_rbtree_node *allocs;
+
+	u64 bytes_alloced;
+	u64 bytes_freed;
+	u64 bytes_alloced_real;
+	u64 bytes_freed_real;
+	u64 nr_allocs;
+	u64 nr_frees;
+
+	unsigned long min_alloc;
+	unsigned long max_alloc;
+} ____cacheline_aligned_in_smp;
+
 /*
  * Linux specific tracking of vmalloc, kmalloc, etc.
+ *
+ * Allocs and frees take @rw for read, which is a per-CPU operation, and then
+ * only the lock of their shard. nvgpu_lock_tracker() takes @rw for write to
+ * get a stable view of all shards for dumping.
  */
 struct nvgpu_mem_alloc_tracker {
 	const char *name;
 	struct nvgpu_kmem_cache *allocs_cache;
-	struct nvgpu_rbtree_node *allocs;
-	struct nvgpu_mutex lock;
+	struct percpu_rw_semaphore rw;
+
+	struct nvgpu_mem_alloc_shard shards[NVGPU_KMEM_TRACKER_SHARDS];
+};
 
+/* Summed over all shards; call with the tracker locked. */
+struct nvgpu_mem_alloc_stats {
 	u64 bytes_alloced;
 	u64 bytes_freed;
 	u64 bytes_alloced_real;
@@ -96,6 +132,8 @@ struct nvgpu_mem_alloc_tracker {
 
 void nvgpu_lock_tracker(struct nvgpu_mem_alloc_tracker *tracker);
 void nvgpu_unlock_tracker(struct nvgpu_mem_alloc_tracker *tracker);
+void nvgpu_tracker_stats(struct nvgpu_mem_alloc_tracker *tracker,
+			 struct nvgpu_mem_alloc_stats *stats);
 
 void kmem_print_mem_alloc(struct gk20a *g,
 			 struct nvgpu_mem_alloc *alloc,
@@ -22,6 +22,7 @@
 #include <nvgpu/gk20a.h>
 #include <nvgpu/channel.h>
 #include <nvgpu/dma.h>
+#include <nvgpu/kmem.h>
 #include <nvgpu/fence.h>
 #include <nvgpu/grmgr.h>
 
@@ -31,12 +32,14 @@
  * direct dma_buf usage this can be removed.
  */
 #include <nvgpu/linux/vm.h>
+#include <nvgpu/linux/dma.h>
 
 #include "channel.h"
 #include "ioctl_channel.h"
 #include "ioctl.h"
 #include "os_linux.h"
 #include "dmabuf_priv.h"
+#include "tstamp_ring.h"
 
 #include <nvgpu/hw/gk20a/hw_pbdma_gk20a.h>
 
@@ -246,6 +249,8 @@ static void nvgpu_channel_work_completion_signal(struct nvgpu_channel *ch)
 {
 	struct nvgpu_channel_linux *priv = ch->os_priv;
 
+	nvgpu_tstamp_record(ch->g, NVGPU_TSTAMP_JOB_COMPLETE, ch->chid, 0);
+
 	if (priv->completion_cb.fn)
 		schedule_work(&priv->completion_cb.work);
 }
@@ -368,6 +373,8 @@ static void nvgpu_channel_signal_os_fence_framework(struct nvgpu_channel *ch,
 
 	fence_framework = &priv->fence_framework;
 
+	nvgpu_tstamp_record(ch->g, NVGPU_TSTAMP_FENCE_SIGNAL, ch->chid, 0);
+
 #if defined(CONFIG_NVGPU_SYNCFD_ANDROID)
 	gk20a_sync_timeline_signal(fence_framework->timeline);
 #elif defined(CONFIG_NVGPU_SYNCFD_STABLE)
@@ -431,12 +438,85 @@ static int nvgpu_channel_copy_user_gpfifo(struct nvgpu_gpfifo_entry *dest,
 	return n == 0 ? 0 : -EFAULT;
 }
 
+/*
+ * Build an SG table covering the pages of a pinned dmabuf from a page aligned
+ * offset to its end, so that GPFIFO and USERD can live in one buffer that the
+ * process maps once. The IOVA is only carried over when the buffer is mapped
+ * contiguously through the IOMMU; otherwise the physical pages are used.
+ */
+static int nvgpu_usermode_buf_window(struct gk20a *g, struct sg_table *sgt,
+		u64 offset, u64 size, struct sg_table **window)
+{
+	struct scatterlist *sg;
+	struct page **pages;
+	u64 nr_pages = size >> PAGE_SHIFT;
+	u64 skip = offset >> PAGE_SHIFT;
+	u64 n = 0;
+	dma_addr_t iova = 0;
+	unsigned int i;
+	int err;
+
+	pages = nvgpu_big_zalloc(g, nr_pages * sizeof(*pages));
+	if (pages == NULL) {
+		return -ENOMEM;
+	}
+
+	for_each_sg(sgt->sgl, sg, sgt->orig_nents, i) {
+		u64 sg_pages = sg->length >> PAGE_SHIFT;
+		u64 j;
+
+		if (sg_page(sg) == NULL || sg->offset != 0U) {
+			err = -EINVAL;
+			goto free_pages;
+		}
+
+		for (j = 0; j < sg_pages && n < nr_pages; j++) {
+			if (skip != 0U) {
+				skip--;
+				continue;
+			}
+			pages[n++] = nth_page(sg_page(sg), j);
+		}
+	}
+
+	if (n != nr_pages) {
+		err = -EINVAL;
+		goto free_pages;
+	}
+
+	if (nvgpu_iommuable(g) && sg_dma_address(sgt->sgl) != 0) {
+		iova = sg_dma_address(sgt->sgl) + offset;
+	}
+
+	err = nvgpu_get_sgtable_from_pages(g, window, pages, iova, size);
+
+free_pages:
+	nvgpu_big_free(g, pages);
+	return err;
+}
+
+static void nvgpu_usermode_buf_put(struct gk20a *g,
+		struct nvgpu_usermode_buf_linux *buf)
+{
+	struct device *dev = dev_from_gk20a(g);
+
+	if (buf->window != NULL) {
+		nvgpu_free_sgtable(g, &buf->window);
+	}
+
+	nvgpu_mm_unpin(dev, buf->dmabuf, buf->attachment, buf->sgt);
+	dma_buf_put(buf->dmabuf);
+	buf->dmabuf = NULL;
+}
+
 int nvgpu_usermode_buf_from_dmabuf(struct gk20a *g, int dmabuf_fd,
-		struct nvgpu_mem *mem, struct nvgpu_usermode_buf_linux *buf)
+		u64 offset, struct nvgpu_mem *mem,
+		struct nvgpu_usermode_buf_linux *buf)
 {
 	struct device *dev = dev_from_gk20a(g);
 	struct dma_buf *dmabuf;
 	struct sg_table *sgt;
+	struct sg_table *window = NULL;
 	struct dma_buf_attachment *attachment;
 	int err;
 
@@ -450,6 +530,11 @@ int nvgpu_usermode_buf_from_dmabuf(struct gk20a *g, int dmabuf_fd,
 		goto put_dmabuf;
 	}
 
+	if (!PAGE_ALIGNED(offset) || offset >= dmabuf->size) {
+		err = -EINVAL;
+		goto put_dmabuf;
+	}
+
 	sgt = nvgpu_mm_pin(dev, dmabuf, &attachment, DMA_TO_DEVICE);
 	if (IS_ERR(sgt)) {
 		nvgpu_err(g, "Failed to pin dma_buf!");
@@ -457,9 +542,21 @@ int nvgpu_usermode_buf_from_dmabuf(struct gk20a *g, int dmabuf_fd,
 		goto put_dmabuf;
 	}
 
+	if (offset != 0U) {
+		err = nvgpu_usermode_buf_window(g, sgt, offset,
+				dmabuf->size - offset, &window);
+		if (err != 0) {
+			nvgpu_err(g, "Failed to map dma_buf at offset 0x%llx",
+				  offset);
+			nvgpu_mm_unpin(dev, dmabuf, attachment, sgt);
+			goto put_dmabuf;
+		}
+	}
+
 	buf->dmabuf = dmabuf;
 	buf->attachment = attachment;
 	buf->sgt = sgt;
+	buf->window = window;
 
 	/*
 	 * This mem is unmapped and freed in a common path; for Linux, we'll
@@ -469,11 +566,11 @@ int nvgpu_usermode_buf_from_dmabuf(struct gk20a *g, int dmabuf_fd,
 	mem->mem_flags  = NVGPU_MEM_FLAG_FOREIGN_SGT;
 	mem->aperture   = APERTURE_SYSMEM;
 	mem->skip_wmb   = 0;
-	mem->size       = dmabuf->size;
+	mem->size       = dmabuf->size - offset;
 
 	mem->priv.flags = 0;
 	mem->priv.pages = NULL;
-	mem->priv.sgt   = sgt;
+	mem->priv.sgt   = window != NULL ? window : sgt;
 
 	return 0;
 put_dmabuf:
@@ -485,22 +582,13 @@ void nvgpu_os_channel_free_usermode_buffers(struct nvgpu_channel *c)
 {
 	struct nvgpu_channel_linux *priv = c->os_priv;
 	struct gk20a *g = c->g;
-	struct device *dev = dev_from_gk20a(g);
 
 	if (priv->usermode.gpfifo.dmabuf != NULL) {
-		nvgpu_mm_unpin(dev, priv->usermode.gpfifo.dmabuf,
-			       priv->usermode.gpfifo.attachment,
-			       priv->usermode.gpfifo.sgt);
-		dma_buf_put(priv->usermode.gpfifo.dmabuf);
-		priv->usermode.gpfifo.dmabuf = NULL;
+		nvgpu_usermode_buf_put(g, &priv->usermode.gpfifo);
 	}
 
 	if (priv->usermode.userd.dmabuf != NULL) {
-		nvgpu_mm_unpin(dev, priv->usermode.userd.dmabuf,
-		       priv->usermode.userd.attachment,
-		       priv->usermode.userd.sgt);
-		dma_buf_put(priv->usermode.userd.dmabuf);
-		priv->usermode.userd.dmabuf = NULL;
+		nvgpu_usermode_buf_put(g, &priv->usermode.userd);
 	}
 }
 
@@ -509,7 +597,6 @@ static int nvgpu_channel_alloc_usermode_buffers(struct nvgpu_channel *c,
 {
 	struct nvgpu_channel_linux *priv = c->os_priv;
 	struct gk20a *g = c->g;
-	struct device *dev = dev_from_gk20a(g);
 	size_t gpfifo_size;
 	int err;
 
@@ -517,13 +604,12 @@ static int nvgpu_channel_alloc_usermode_buffers(struct nvgpu_channel *c,
 		return -EINVAL;
 	}
 
-	if (args->gpfifo_dmabuf_offset != 0 ||
-			args->userd_dmabuf_offset != 0) {
-		/* TODO - not yet supported */
-		return -EINVAL;
-	}
-
+	/*
+	 * GPFIFO and USERD may share one dmabuf at distinct page aligned
+	 * offsets; the buffers themselves are validated when pinned.
+	 */
 	err = nvgpu_usermode_buf_from_dmabuf(g, args->gpfifo_dmabuf_fd,
+			args->gpfifo_dmabuf_offset,
 			&c->usermode_gpfifo, &priv->usermode.gpfifo);
 	if (err < 0) {
 		return err;
@@ -548,6 +634,7 @@ static int nvgpu_channel_alloc_usermode_buffers(struct nvgpu_channel *c,
 	}
 
 	err = nvgpu_usermode_buf_from_dmabuf(g, args->userd_dmabuf_fd,
+			args->userd_dmabuf_offset,
 			&c->usermode_userd, &priv->usermode.userd);
 	if (err < 0) {
 		goto unmap_free_gpfifo;
@@ -559,11 +646,7 @@ static int nvgpu_channel_alloc_usermode_buffers(struct nvgpu_channel *c,
 unmap_free_gpfifo:
 	nvgpu_dma_unmap_free(c->vm, &c->usermode_gpfifo);
 free_gpfifo:
-	nvgpu_mm_unpin(dev, priv->usermode.gpfifo.dmabuf,
-		       priv->usermode.gpfifo.attachment,
-		       priv->usermode.gpfifo.sgt);
-	dma_buf_put(priv->usermode.gpfifo.dmabuf);
-	priv->usermode.gpfifo.dmabuf = NULL;
+	nvgpu_usermode_buf_put(g, &priv->usermode.gpfifo);
 	return err;
 }
 
@@ -93,6 +93,7 @@
 #include "debug_ce.h"
 #include "debug_pmgr.h"
 #include "dmabuf_priv.h"
+#include "tstamp_ring.h"
 
 #ifdef CONFIG_NVGPU_GSP_SCHEDULER
 #include "nvgpu/gsp.h"
@@ -998,7 +999,10 @@ u64 nvgpu_resource_addr(struct platform_device *dev, int i)
 static irqreturn_t gk20a_intr_isr_stall(int irq, void *dev_id)
 {
 	struct gk20a *g = dev_id;
-	u32 err = nvgpu_cic_mon_intr_stall_isr(g);
+	u32 err;
+
+	nvgpu_tstamp_record(g, NVGPU_TSTAMP_STALL_ISR, (u32)irq, 0);
+	err = nvgpu_cic_mon_intr_stall_isr(g);
 
 	return err == NVGPU_CIC_INTR_HANDLE ? IRQ_WAKE_THREAD : IRQ_NONE;
 }
@@ -1014,7 +1018,10 @@ static irqreturn_t gk20a_intr_thread_isr_stall(int irq, void *dev_id)
 static irqreturn_t gk20a_intr_isr_nonstall(int irq, void *dev_id)
 {
 	struct gk20a *g = dev_id;
-	u32 err = nvgpu_cic_mon_intr_nonstall_isr(g);
+	u32 err;
+
+	nvgpu_tstamp_record(g, NVGPU_TSTAMP_NONSTALL_ISR, (u32)irq, 0);
+	err = nvgpu_cic_mon_intr_nonstall_isr(g);
 
 	return err == NVGPU_CIC_INTR_HANDLE ? IRQ_WAKE_THREAD : IRQ_NONE;
 }
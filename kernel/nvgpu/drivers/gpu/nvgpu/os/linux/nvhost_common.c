@@ -38,6 +38,7 @@ void nvgpu_free_nvhost_dev(struct gk20a *g)
 		sg_free_table(mem->priv.sgt);
 		nvgpu_kfree(g, mem->priv.sgt);
 	}
+	nvgpu_kfree(g, g->nvhost->cb_pool);
 	nvgpu_kfree(g, g->nvhost);
 }
 
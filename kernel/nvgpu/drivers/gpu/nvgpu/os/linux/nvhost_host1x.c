@@ -36,6 +36,64 @@
 #define TEGRA234_SYNCPT_SHIM_BASE 0x60000000
 #define TEGRA234_SYNCPT_SHIM_SIZE 0x04000000
 
+/* syncpt notifier callbacks in flight without allocating on submit */
+#define NVGPU_HOST1X_CB_POOL_SIZE 512U
+
+struct nvgpu_host1x_cb {
+	struct dma_fence_cb cb;
+	struct work_struct work;
+	struct llist_node node;
+	/* owning pool, NULL if allocated when the pool ran dry */
+	struct nvgpu_nvhost_dev *pool;
+	void (*notifier)(void *, int);
+	void *notifier_data;
+};
+
+static void nvgpu_host1x_cb_pool_init(struct gk20a *g,
+				      struct nvgpu_nvhost_dev *nvhost_dev)
+{
+	u32 i;
+
+	spin_lock_init(&nvhost_dev->cb_lock);
+	init_llist_head(&nvhost_dev->cb_free);
+
+	nvhost_dev->cb_pool = nvgpu_kzalloc(g,
+			sizeof(*nvhost_dev->cb_pool) * NVGPU_HOST1X_CB_POOL_SIZE);
+	if (nvhost_dev->cb_pool == NULL) {
+		nvgpu_warn(g, "no syncpt notifier pool, allocating on submit");
+		return;
+	}
+
+	for (i = 0U; i < NVGPU_HOST1X_CB_POOL_SIZE; i++) {
+		nvhost_dev->cb_pool[i].pool = nvhost_dev;
+		llist_add(&nvhost_dev->cb_pool[i].node, &nvhost_dev->cb_free);
+	}
+}
+
+static struct nvgpu_host1x_cb *nvgpu_host1x_cb_get(
+		struct nvgpu_nvhost_dev *nvhost_dev)
+{
+	struct llist_node *node;
+
+	/* recycling is lock free, concurrent takers are serialized */
+	spin_lock(&nvhost_dev->cb_lock);
+	node = llist_del_first(&nvhost_dev->cb_free);
+	spin_unlock(&nvhost_dev->cb_lock);
+
+	if (node != NULL)
+		return llist_entry(node, struct nvgpu_host1x_cb, node);
+
+	return kzalloc(sizeof(struct nvgpu_host1x_cb), GFP_KERNEL);
+}
+
+static void nvgpu_host1x_cb_put(struct nvgpu_host1x_cb *host1x_cb)
+{
+	if (host1x_cb->pool != NULL)
+		llist_add(&host1x_cb->node, &host1x_cb->pool->cb_free);
+	else
+		kfree_rcu(host1x_cb);
+}
+
 static const struct of_device_id host1x_match[] = {
 	{ .compatible = "nvidia,tegra186-host1x", },
 	{ .compatible = "nvidia,tegra194-host1x", },
@@ -66,6 +124,7 @@ int nvgpu_get_nvhost_dev(struct gk20a *g)
 		return -ENOMEM;
 
 	g->nvhost->host1x_pdev = host1x_pdev;
+	nvgpu_host1x_cb_pool_init(g, g->nvhost);
 
 	return 0;
 }
@@ -122,19 +181,12 @@ bool nvgpu_nvhost_syncpt_is_expired_ext(struct nvgpu_nvhost_dev *nvhost_dev,
 	return true;
 }
 
-struct nvgpu_host1x_cb {
-	struct dma_fence_cb cb;
-	struct work_struct work;
-	void (*notifier)(void *, int);
-	void *notifier_data;
-};
-
 static void nvgpu_host1x_work_func(struct work_struct *work)
 {
 	struct nvgpu_host1x_cb *host1x_cb = container_of(work, struct nvgpu_host1x_cb, work);
 
 	host1x_cb->notifier(host1x_cb->notifier_data, 0);
-	kfree_rcu(host1x_cb);
+	nvgpu_host1x_cb_put(host1x_cb);
 }
 
 static void nvgpu_host1x_cb_func(struct dma_fence *f, struct dma_fence_cb *cb)
@@ -171,9 +223,11 @@ int nvgpu_nvhost_intr_register_notifier(struct nvgpu_nvhost_dev *nvhost_dev,
 		return PTR_ERR(fence);
 	}
 
-	cb = kzalloc(sizeof(*cb), GFP_KERNEL);
-	if (!cb)
+	cb = nvgpu_host1x_cb_get(nvhost_dev);
+	if (!cb) {
+		dma_fence_put(fence);
 		return -ENOMEM;
+	}
 
 	cb->notifier = notifier;
 	cb->notifier_data = notifier_data;
@@ -183,7 +237,7 @@ int nvgpu_nvhost_intr_register_notifier(struct nvgpu_nvhost_dev *nvhost_dev,
 	err = dma_fence_add_callback(fence, &cb->cb, nvgpu_host1x_cb_func);
 	if (err < 0) {
 		dma_fence_put(fence);
-		kfree(cb);
+		nvgpu_host1x_cb_put(cb);
 	}
 
 	return err;
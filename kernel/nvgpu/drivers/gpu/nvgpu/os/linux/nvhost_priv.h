@@ -17,11 +17,19 @@
 #ifndef __NVGPU_NVHOST_PRIV_H__
 #define __NVGPU_NVHOST_PRIV_H__
 
+#include <linux/llist.h>
+#include <linux/spinlock.h>
+
 #include <nvgpu/os_fence_syncpts.h>
 
 struct nvhost_fence;
+struct nvgpu_host1x_cb;
 struct nvgpu_nvhost_dev {
 	struct platform_device *host1x_pdev;
+	/* preallocated syncpt notifier callbacks, host1x backend only */
+	struct nvgpu_host1x_cb *cb_pool;
+	struct llist_head cb_free;
+	spinlock_t cb_lock;
 };
 
 int nvgpu_nvhost_fence_install(struct nvhost_fence *f, int fd);
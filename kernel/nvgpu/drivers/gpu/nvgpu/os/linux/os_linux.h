@@ -27,6 +27,26 @@
 #include "cde.h"
 #include "sched.h"
 
+#ifdef CONFIG_NVGPU_COMPRESSION
+/*
+ * Comptag allocation counters and the placement policy knobs, see
+ * comptags.c. Lines held by map-time allocations of buffers smaller than
+ * small_kb are capped so that reserve_pct of the comptag pool is left for
+ * large surfaces and registered buffers.
+ */
+struct nvgpu_comptag_stats {
+	atomic_t hits;
+	atomic_t allocs;
+	atomic_t fallbacks;
+	atomic_t policy_denied;
+	atomic_t reserved;
+	atomic_long_t lines_in_use;
+
+	u32 reserve_pct;
+	u32 small_kb;
+};
+#endif
+
 struct nvgpu_os_linux_ops {
 	struct {
 		void (*get_program_numbers)(struct gk20a *g,
@@ -96,6 +116,20 @@ struct nvgpu_os_linux {
 
 	struct devfreq *devfreq;
 
+#ifdef CONFIG_NVGPU_COMPRESSION
+	struct nvgpu_comptag_stats comptag_stats;
+#endif
+
+	/* per-CPU event timestamp rings, see tstamp_ring.h */
+	void __rcu *tstamp_rings;
+	u32 tstamp_users;
+
+#ifdef CONFIG_NVGPU_FECS_TRACE
+	/* one slot per possible TSG, see gk20a_sched_ctrl_ctxsw_event() */
+	struct gk20a_sched_ctx_stats *sched_ctx_stats;
+	struct nvgpu_mutex sched_ctx_stats_lock;
+#endif
+
 	struct device_dma_parameters dma_parms;
 
 	atomic_t nonstall_ops;
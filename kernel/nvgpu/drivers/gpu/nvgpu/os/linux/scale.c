@@ -224,6 +224,90 @@ static int gk20a_scale_make_freq_table(struct gk20a_scale_profile *profile)
 	return 0;
 }
 
+/*
+ * gk20a_scale_deadline_freq(profile)
+ *
+ * Return the frequency requested by a live deadline hint, or 0 when no hint
+ * is active or the last one has expired.
+ */
+
+static unsigned long gk20a_scale_deadline_freq(
+				struct gk20a_scale_profile *profile)
+{
+	unsigned long freq = READ_ONCE(profile->deadline_freq);
+
+	if (freq == 0UL)
+		return 0UL;
+
+	if (time_after(jiffies, READ_ONCE(profile->deadline_expires)))
+		return 0UL;
+
+	return freq;
+}
+
+/*
+ * gk20a_scale_set_deadline_hint(dev, job_us, deadline_us)
+ *
+ * Record that the next job is expected to take job_us at the maximum GPU
+ * clock and must complete within deadline_us. While the hint is refreshed,
+ * the clock is set to the lowest table frequency that still meets the
+ * deadline instead of following the busy-cycle average. A zero deadline
+ * clears the hint.
+ */
+
+int gk20a_scale_set_deadline_hint(struct device *dev, u32 job_us,
+				  u32 deadline_us)
+{
+	struct gk20a *g = get_gk20a(dev);
+	struct nvgpu_os_linux *l = nvgpu_os_linux_from_gk20a(g);
+	struct gk20a_scale_profile *profile = g->scale_profile;
+	struct devfreq *devfreq = l->devfreq;
+	unsigned long *freq_table;
+	unsigned long fmax, needed, freq;
+	int i, max_state;
+
+	if (!profile || !devfreq)
+		return -ENODEV;
+
+	profile->deadline_job_us = job_us;
+	profile->deadline_us = deadline_us;
+
+	if (deadline_us == 0U || job_us == 0U) {
+		WRITE_ONCE(profile->deadline_freq, 0UL);
+		goto update;
+	}
+
+	freq_table = profile->devfreq_profile.freq_table;
+	max_state = profile->devfreq_profile.max_state;
+	fmax = freq_table[max_state - 1];
+
+	if (job_us >= deadline_us) {
+		freq = fmax;
+	} else {
+		needed = (unsigned long)div_u64((u64)fmax * job_us,
+						deadline_us);
+		freq = fmax;
+		for (i = 0; i < max_state; i++) {
+			if (freq_table[i] >= needed) {
+				freq = freq_table[i];
+				break;
+			}
+		}
+	}
+
+	WRITE_ONCE(profile->deadline_expires, jiffies +
+		msecs_to_jiffies(GK20A_SCALE_DEADLINE_HINT_TIMEOUT_MS));
+	WRITE_ONCE(profile->deadline_freq, freq);
+
+update:
+	/* Apply the hint now rather than at the next polling interval */
+	mutex_lock(&devfreq->lock);
+	update_devfreq(devfreq);
+	mutex_unlock(&devfreq->lock);
+
+	return 0;
+}
+
 /*
  * gk20a_scale_target(dev, *freq, flags)
  *
@@ -243,6 +327,7 @@ static int gk20a_scale_target(struct device *dev, unsigned long *freq,
 	unsigned long local_freq = *freq;
 	unsigned long rounded_rate = 0;
 	unsigned long min_freq = 0, max_freq = 0;
+	unsigned long deadline_freq;
 
 	if (nvgpu_clk_arb_has_active_req(g)) {
 		rounded_rate = g->last_freq;
@@ -279,6 +364,14 @@ static int gk20a_scale_target(struct device *dev, unsigned long *freq,
 	if (min_freq > max_freq)
 		min_freq = max_freq;
 
+	/*
+	 * A live deadline hint replaces the load based request: run at the
+	 * lowest frequency that still meets the job deadline.
+	 */
+	deadline_freq = gk20a_scale_deadline_freq(profile);
+	if (deadline_freq != 0UL)
+		local_freq = deadline_freq;
+
 	/* Clip requested frequency */
 	if (local_freq < min_freq)
 		local_freq = min_freq;
@@ -36,8 +36,16 @@ struct gk20a_scale_profile {
 	unsigned long			qos_max_freq;
 	void				*private_data;
 	struct nvgpu_mutex		lock;
+	/* Lowest frequency meeting the last job deadline hint */
+	unsigned long			deadline_freq;
+	unsigned long			deadline_expires;
+	u32				deadline_job_us;
+	u32				deadline_us;
 };
 
+/* A deadline hint stops steering the clock if not refreshed within this */
+#define GK20A_SCALE_DEADLINE_HINT_TIMEOUT_MS	500U
+
 /* Initialization and de-initialization for module */
 void gk20a_scale_init(struct device *);
 void gk20a_scale_exit(struct device *);
@@ -54,6 +62,9 @@ void gk20a_scale_notify_idle(struct device *);
 void gk20a_scale_suspend(struct device *);
 void gk20a_scale_resume(struct device *);
 
+int gk20a_scale_set_deadline_hint(struct device *dev, u32 job_us,
+				  u32 deadline_us);
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
 int gk20a_scale_qos_min_notify(struct notifier_block *nb,
 			  unsigned long n, void *p);
@@ -71,6 +82,11 @@ static inline void gk20a_scale_notify_busy(struct device *dev) {}
 static inline void gk20a_scale_notify_idle(struct device *dev) {}
 static inline void gk20a_scale_suspend(struct device *dev) {}
 static inline void gk20a_scale_resume(struct device *dev) {}
+static inline int gk20a_scale_set_deadline_hint(struct device *dev,
+						u32 job_us, u32 deadline_us)
+{
+	return -ENOSYS;
+}
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
 static inline int gk20a_scale_qos_min_notify(struct notifier_block *nb,
@@ -26,6 +26,7 @@
 #include <nvgpu/gk20a.h>
 #include <nvgpu/string.h>
 #include <nvgpu/gr/ctx.h>
+#include <nvgpu/gr/fecs_trace.h>
 #include <nvgpu/nvgpu_init.h>
 
 #include "platform_gk20a.h"
@@ -589,10 +590,101 @@ void gk20a_sched_ctrl_tsg_removed(struct gk20a *g, struct nvgpu_tsg *tsg)
 	nvgpu_mutex_release(&sched->status_lock);
 }
 
+#ifdef CONFIG_NVGPU_FECS_TRACE
+/*
+ * Find the stats slot of a context, claiming a free one or recycling the
+ * least recently active one on first sight.
+ */
+static struct gk20a_sched_ctx_stats *gk20a_sched_ctx_stats_get(
+		struct gk20a *g, u32 context_id, u64 pid)
+{
+	struct nvgpu_os_linux *l = nvgpu_os_linux_from_gk20a(g);
+	struct gk20a_sched_ctx_stats *stats = l->sched_ctx_stats;
+	struct gk20a_sched_ctx_stats *victim = &stats[0];
+	u32 i;
+
+	for (i = 0; i < g->fifo.num_channels; i++) {
+		if (stats[i].context_id == context_id &&
+				stats[i].pid == pid)
+			return &stats[i];
+
+		if (stats[i].last_ts < victim->last_ts)
+			victim = &stats[i];
+	}
+
+	(void) memset(victim, 0, sizeof(*victim));
+	victim->context_id = context_id;
+	victim->pid = pid;
+
+	return victim;
+}
+
+/*
+ * Account a context switch trace entry to its context:
+ * - CONTEXT_START opens a residency and counts a context switch in,
+ * - CTXSW_REQ_BY_HOST marks the start of a preemption request,
+ * - SAVE_END closes the residency and the preemption latency window.
+ */
+void gk20a_sched_ctrl_ctxsw_event(struct gk20a *g,
+		const struct nvgpu_gpu_ctxsw_trace_entry *entry)
+{
+	struct nvgpu_os_linux *l = nvgpu_os_linux_from_gk20a(g);
+	struct gk20a_sched_ctx_stats *s;
+	u64 ts = entry->timestamp;
+	u64 lat;
+
+	if (l->sched_ctx_stats == NULL || entry->context_id == 0U)
+		return;
+
+	switch (entry->tag) {
+	case NVGPU_GPU_CTXSW_TAG_CONTEXT_START:
+	case NVGPU_GPU_CTXSW_TAG_CTXSW_REQ_BY_HOST:
+	case NVGPU_GPU_CTXSW_TAG_SAVE_END:
+		break;
+	default:
+		return;
+	}
+
+	nvgpu_mutex_acquire(&l->sched_ctx_stats_lock);
+
+	s = gk20a_sched_ctx_stats_get(g, entry->context_id, entry->pid);
+	s->last_ts = ts;
+
+	switch (entry->tag) {
+	case NVGPU_GPU_CTXSW_TAG_CONTEXT_START:
+		s->resident_since = ts;
+		s->ctxsw_count++;
+		break;
+	case NVGPU_GPU_CTXSW_TAG_CTXSW_REQ_BY_HOST:
+		if (s->preempt_req == 0ULL)
+			s->preempt_req = ts;
+		break;
+	case NVGPU_GPU_CTXSW_TAG_SAVE_END:
+		if (s->resident_since != 0ULL && ts > s->resident_since)
+			s->busy_ns += ts - s->resident_since;
+		s->resident_since = 0;
+
+		if (s->preempt_req != 0ULL && ts > s->preempt_req) {
+			lat = ts - s->preempt_req;
+			s->preempt_count++;
+			s->preempt_ns_total += lat;
+			s->preempt_ns_max = max(s->preempt_ns_max, lat);
+		}
+		s->preempt_req = 0;
+		break;
+	}
+
+	nvgpu_mutex_release(&l->sched_ctx_stats_lock);
+}
+#endif
+
 int gk20a_sched_ctrl_init(struct gk20a *g)
 {
 	struct nvgpu_sched_ctrl *sched = &g->sched_ctrl;
 	struct nvgpu_fifo *f = &g->fifo;
+#ifdef CONFIG_NVGPU_FECS_TRACE
+	struct nvgpu_os_linux *l = nvgpu_os_linux_from_gk20a(g);
+#endif
 	int err;
 
 	if (sched->sw_ready)
@@ -620,6 +712,16 @@ int gk20a_sched_ctrl_init(struct gk20a *g)
 		goto free_recent;
 	}
 
+#ifdef CONFIG_NVGPU_FECS_TRACE
+	l->sched_ctx_stats = nvgpu_kzalloc(g, f->num_channels *
+				sizeof(*l->sched_ctx_stats));
+	if (!l->sched_ctx_stats) {
+		err = -ENOMEM;
+		goto free_ref;
+	}
+	nvgpu_mutex_init(&l->sched_ctx_stats_lock);
+#endif
+
 	nvgpu_cond_init(&sched->readout_wq);
 
 	nvgpu_mutex_init(&sched->status_lock);
@@ -630,6 +732,10 @@ int gk20a_sched_ctrl_init(struct gk20a *g)
 
 	return 0;
 
+#ifdef CONFIG_NVGPU_FECS_TRACE
+free_ref:
+	nvgpu_kfree(g, sched->ref_tsg_bitmap);
+#endif
 free_recent:
 	nvgpu_kfree(g, sched->recent_tsg_bitmap);
 free_active:
@@ -641,6 +747,15 @@ free_active:
 void gk20a_sched_ctrl_cleanup(struct gk20a *g)
 {
 	struct nvgpu_sched_ctrl *sched = &g->sched_ctrl;
+#ifdef CONFIG_NVGPU_FECS_TRACE
+	struct nvgpu_os_linux *l = nvgpu_os_linux_from_gk20a(g);
+
+	if (l->sched_ctx_stats) {
+		nvgpu_kfree(g, l->sched_ctx_stats);
+		l->sched_ctx_stats = NULL;
+		nvgpu_mutex_destroy(&l->sched_ctx_stats_lock);
+	}
+#endif
 
 	nvgpu_kfree(g, sched->active_tsg_bitmap);
 	nvgpu_kfree(g, sched->recent_tsg_bitmap);
@@ -20,6 +20,26 @@ struct gk20a;
 struct gpu_ops;
 struct nvgpu_tsg;
 struct poll_table_struct;
+struct nvgpu_gpu_ctxsw_trace_entry;
+
+/*
+ * GPU time accounting for one graphics context, i.e. one TSG, built from the
+ * FECS context switch trace. Times are ptimer timestamps in ns.
+ */
+struct gk20a_sched_ctx_stats {
+	u32 context_id;
+	u64 pid;
+	u64 busy_ns;
+	u64 ctxsw_count;
+	u64 preempt_count;
+	u64 preempt_ns_total;
+	u64 preempt_ns_max;
+	/* CONTEXT_START of the current residency, 0 when switched out */
+	u64 resident_since;
+	/* CTXSW_REQ_BY_HOST of a pending switch out, 0 when none */
+	u64 preempt_req;
+	u64 last_ts;
+};
 
 int gk20a_sched_dev_release(struct inode *inode, struct file *filp);
 int gk20a_sched_dev_open(struct inode *inode, struct file *filp);
@@ -30,6 +50,8 @@ unsigned int gk20a_sched_dev_poll(struct file *, struct poll_table_struct *);
 void gk20a_sched_ctrl_tsg_added(struct gk20a *, struct nvgpu_tsg *);
 void gk20a_sched_ctrl_tsg_removed(struct gk20a *, struct nvgpu_tsg *);
 int gk20a_sched_ctrl_init(struct gk20a *);
+void gk20a_sched_ctrl_ctxsw_event(struct gk20a *g,
+		const struct nvgpu_gpu_ctxsw_trace_entry *entry);
 
 void gk20a_sched_ctrl_cleanup(struct gk20a *g);
 
@@ -43,6 +43,8 @@
 #include "os_linux.h"
 #include "sysfs.h"
 #include "platform_gk20a.h"
+#include "scale.h"
+#include "fecs_trace_linux.h"
 
 #ifdef CONFIG_NVGPU_MIG
 #include <nvgpu/enabled.h>
@@ -812,6 +814,108 @@ static ssize_t fmax_at_vmin_safe_read(struct device *dev,
 
 static DEVICE_ATTR(fmax_at_vmin_safe, S_IRUGO, fmax_at_vmin_safe_read, NULL);
 
+#ifdef CONFIG_GK20A_DEVFREQ
+/*
+ * "<job_us> <deadline_us>": expected job duration at the maximum GPU clock and
+ * the time it must complete in. Writing "0 0" hands control back to devfreq.
+ */
+static ssize_t deadline_hint_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	u32 job_us = 0, deadline_us = 0;
+	int err;
+
+	if (sscanf(buf, "%u %u", &job_us, &deadline_us) != 2)
+		return -EINVAL;
+
+	err = gk20a_scale_set_deadline_hint(dev, job_us, deadline_us);
+	if (err)
+		return err;
+
+	return count;
+}
+
+static ssize_t deadline_hint_read(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct gk20a *g = get_gk20a(dev);
+	struct gk20a_scale_profile *profile = g->scale_profile;
+
+	if (!profile)
+		return -ENODEV;
+
+	return snprintf(buf, NVGPU_CPU_PAGE_SIZE, "%u %u %lu\n",
+			profile->deadline_job_us, profile->deadline_us,
+			profile->deadline_freq);
+}
+
+static DEVICE_ATTR(deadline_hint, ROOTRW, deadline_hint_read,
+		   deadline_hint_store);
+#endif
+
+#ifdef CONFIG_NVGPU_FECS_TRACE
+/* Keep only ctxsw trace records of this process; 0 traces every process */
+static ssize_t ctxsw_trace_pid_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct gk20a *g = get_gk20a(dev);
+	u64 val = 0;
+	int err;
+
+	if (kstrtoull(buf, 10, &val) < 0)
+		return -EINVAL;
+
+	err = nvgpu_gr_fecs_trace_set_pid_filter(g, val);
+	if (err)
+		return err;
+
+	return count;
+}
+
+static ssize_t ctxsw_trace_pid_read(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct gk20a *g = get_gk20a(dev);
+
+	return snprintf(buf, NVGPU_CPU_PAGE_SIZE, "%llu\n",
+			nvgpu_gr_fecs_trace_get_pid_filter(g));
+}
+
+static DEVICE_ATTR(ctxsw_trace_pid, ROOTRW, ctxsw_trace_pid_read,
+		   ctxsw_trace_pid_store);
+
+/* Pending ctxsw trace records needed before poll() reports the ring readable */
+static ssize_t ctxsw_trace_wake_threshold_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct gk20a *g = get_gk20a(dev);
+	u32 val = 0;
+	int err;
+
+	if (kstrtou32(buf, 10, &val) < 0)
+		return -EINVAL;
+
+	err = nvgpu_gr_fecs_trace_set_wake_threshold(g, val);
+	if (err)
+		return err;
+
+	return count;
+}
+
+static ssize_t ctxsw_trace_wake_threshold_read(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct gk20a *g = get_gk20a(dev);
+
+	return snprintf(buf, NVGPU_CPU_PAGE_SIZE, "%u\n",
+			nvgpu_gr_fecs_trace_get_wake_threshold(g));
+}
+
+static DEVICE_ATTR(ctxsw_trace_wake_threshold, ROOTRW,
+		   ctxsw_trace_wake_threshold_read,
+		   ctxsw_trace_wake_threshold_store);
+#endif
+
 #ifdef CONFIG_PM
 static ssize_t force_idle_store(struct device *dev,
 	struct device_attribute *attr, const char *buf, size_t count)
@@ -1370,6 +1474,13 @@ void nvgpu_remove_sysfs(struct device *dev)
 	device_remove_file(dev, &dev_attr_ldiv_slowdown_factor);
 
 	device_remove_file(dev, &dev_attr_fmax_at_vmin_safe);
+#ifdef CONFIG_GK20A_DEVFREQ
+	device_remove_file(dev, &dev_attr_deadline_hint);
+#endif
+#ifdef CONFIG_NVGPU_FECS_TRACE
+	device_remove_file(dev, &dev_attr_ctxsw_trace_pid);
+	device_remove_file(dev, &dev_attr_ctxsw_trace_wake_threshold);
+#endif
 
 	device_remove_file(dev, &dev_attr_counters);
 	device_remove_file(dev, &dev_attr_counters_reset);
@@ -1441,6 +1552,13 @@ int nvgpu_create_sysfs(struct device *dev)
 	error |= device_create_file(dev, &dev_attr_ldiv_slowdown_factor);
 
 	error |= device_create_file(dev, &dev_attr_fmax_at_vmin_safe);
+#ifdef CONFIG_GK20A_DEVFREQ
+	error |= device_create_file(dev, &dev_attr_deadline_hint);
+#endif
+#ifdef CONFIG_NVGPU_FECS_TRACE
+	error |= device_create_file(dev, &dev_attr_ctxsw_trace_pid);
+	error |= device_create_file(dev, &dev_attr_ctxsw_trace_wake_threshold);
+#endif
 
 	error |= device_create_file(dev, &dev_attr_counters);
 	error |= device_create_file(dev, &dev_attr_counters_reset);
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/rcupdate.h>
+#include <linux/irqflags.h>
+#include <linux/smp.h>
+
+#include <nvgpu/log.h>
+#include <nvgpu/lock.h>
+#include <nvgpu/barrier.h>
+#include <nvgpu/gk20a.h>
+#include <nvgpu/nvgpu_init.h>
+
+#include "ioctl.h"
+#include "os_linux.h"
+#include "tstamp_ring.h"
+
+DEFINE_STATIC_KEY_FALSE(nvgpu_tstamp_armed);
+
+/* Serializes open/release of the rings across all GPUs */
+static DEFINE_MUTEX(nvgpu_tstamp_lock);
+
+static struct nvgpu_tstamp_ring_hdr *nvgpu_tstamp_ring(void *buf,
+						       unsigned int cpu)
+{
+	return (struct nvgpu_tstamp_ring_hdr *)
+		((u8 *)buf + (size_t)cpu * NVGPU_TSTAMP_RING_SIZE);
+}
+
+/*
+ * Writers run with interrupts off so the stall/nonstall ISRs cannot
+ * interleave with a thread on the same CPU; that also makes the section an
+ * RCU reader, which is what release relies on before freeing the rings.
+ */
+void __nvgpu_tstamp_record(struct gk20a *g, u32 event, u32 id, u64 data)
+{
+	struct nvgpu_os_linux *l = nvgpu_os_linux_from_gk20a(g);
+	struct nvgpu_tstamp_ring_hdr *hdr;
+	struct nvgpu_tstamp_record *rec;
+	unsigned long flags;
+	void *buf;
+	u64 seq;
+
+	local_irq_save(flags);
+
+	buf = rcu_dereference_sched(l->tstamp_rings);
+	if (buf == NULL)
+		goto out;
+
+	hdr = nvgpu_tstamp_ring(buf, smp_processor_id());
+	seq = hdr->seq;
+	rec = (struct nvgpu_tstamp_record *)(hdr + 1) +
+		(seq % hdr->num_records);
+
+	rec->timestamp = ktime_get_ns();
+	rec->event = event;
+	rec->id = id;
+	rec->data = data;
+
+	/* publish the record before the sequence that covers it */
+	nvgpu_smp_wmb();
+	WRITE_ONCE(hdr->seq, seq + 1ULL);
+
+out:
+	local_irq_restore(flags);
+}
+
+static void *nvgpu_tstamp_alloc_rings(void)
+{
+	struct nvgpu_tstamp_ring_hdr *hdr;
+	unsigned int cpu;
+	void *buf;
+
+	buf = vmalloc_user((size_t)nr_cpu_ids * NVGPU_TSTAMP_RING_SIZE);
+	if (buf == NULL)
+		return NULL;
+
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++) {
+		hdr = nvgpu_tstamp_ring(buf, cpu);
+		hdr->magic = NVGPU_TSTAMP_RING_MAGIC;
+		hdr->cpu = cpu;
+		hdr->num_records = (NVGPU_TSTAMP_RING_SIZE - sizeof(*hdr)) /
+			sizeof(struct nvgpu_tstamp_record);
+	}
+
+	return buf;
+}
+
+int gk20a_tstamp_dev_open(struct inode *inode, struct file *filp)
+{
+	struct nvgpu_os_linux *l;
+	struct nvgpu_cdev *cdev;
+	struct gk20a *g;
+	void *buf;
+	int err = 0;
+
+	cdev = container_of(inode->i_cdev, struct nvgpu_cdev, cdev);
+	g = nvgpu_get_gk20a_from_cdev(cdev);
+
+	g = nvgpu_get(g);
+	if (!g)
+		return -ENODEV;
+	l = nvgpu_os_linux_from_gk20a(g);
+
+	mutex_lock(&nvgpu_tstamp_lock);
+
+	if (l->tstamp_users == 0U) {
+		buf = nvgpu_tstamp_alloc_rings();
+		if (buf == NULL) {
+			err = -ENOMEM;
+			goto unlock;
+		}
+		rcu_assign_pointer(l->tstamp_rings, buf);
+	}
+
+	l->tstamp_users++;
+	static_branch_inc(&nvgpu_tstamp_armed);
+	filp->private_data = g;
+
+	nvgpu_log_info(g, "tstamp rings armed, users=%u", l->tstamp_users);
+
+unlock:
+	mutex_unlock(&nvgpu_tstamp_lock);
+	if (err)
+		nvgpu_put(g);
+	return err;
+}
+
+int gk20a_tstamp_dev_release(struct inode *inode, struct file *filp)
+{
+	struct gk20a *g = filp->private_data;
+	struct nvgpu_os_linux *l = nvgpu_os_linux_from_gk20a(g);
+	void *buf;
+
+	mutex_lock(&nvgpu_tstamp_lock);
+
+	static_branch_dec(&nvgpu_tstamp_armed);
+	if (--l->tstamp_users == 0U) {
+		buf = rcu_dereference_protected(l->tstamp_rings,
+				lockdep_is_held(&nvgpu_tstamp_lock));
+		RCU_INIT_POINTER(l->tstamp_rings, NULL);
+		/* wait out writers still holding the old rings */
+		synchronize_rcu();
+		vfree(buf);
+	}
+
+	mutex_unlock(&nvgpu_tstamp_lock);
+
+	nvgpu_put(g);
+	return 0;
+}
+
+int gk20a_tstamp_dev_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct gk20a *g = filp->private_data;
+	struct nvgpu_os_linux *l = nvgpu_os_linux_from_gk20a(g);
+	size_t size = (size_t)nr_cpu_ids * NVGPU_TSTAMP_RING_SIZE;
+	void *buf;
+
+	if ((vma->vm_flags & VM_WRITE) != 0UL)
+		return -EPERM;
+
+	if (vma->vm_pgoff != 0UL || vma->vm_end - vma->vm_start > size)
+		return -EINVAL;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	/* the rings live until this file is released, which the vma pins */
+	buf = rcu_dereference_protected(l->tstamp_rings, true);
+
+	return remap_vmalloc_range(vma, buf, 0);
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NVGPU_OS_LINUX_TSTAMP_RING_H
+#define NVGPU_OS_LINUX_TSTAMP_RING_H
+
+#include <linux/jump_label.h>
+
+#include <nvgpu/types.h>
+
+struct gk20a;
+struct inode;
+struct file;
+struct vm_area_struct;
+
+/*
+ * Layout of the "tstamp" device mmap: one NVGPU_TSTAMP_RING_SIZE ring per
+ * possible CPU, ring n at offset n * NVGPU_TSTAMP_RING_SIZE. Each ring is a
+ * header followed by num_records records; record seq lives in slot
+ * seq % num_records. A reader samples hdr->seq, copies the records it wants and
+ * samples hdr->seq again: records older than seq - num_records were
+ * overwritten while copying.
+ */
+#define NVGPU_TSTAMP_RING_MAGIC		0x50545354U /* "TSTP" */
+#define NVGPU_TSTAMP_RING_SIZE		(64U * 1024U)
+
+enum nvgpu_tstamp_event {
+	NVGPU_TSTAMP_SUBMIT_ENTRY = 1,
+	NVGPU_TSTAMP_SUBMIT_EXIT,
+	NVGPU_TSTAMP_STALL_ISR,
+	NVGPU_TSTAMP_NONSTALL_ISR,
+	NVGPU_TSTAMP_JOB_COMPLETE,
+	NVGPU_TSTAMP_FENCE_SIGNAL,
+};
+
+struct nvgpu_tstamp_record {
+	/* CLOCK_MONOTONIC, ns */
+	u64 timestamp;
+	/* enum nvgpu_tstamp_event */
+	u32 event;
+	/* channel id for channel events, irq number for interrupts */
+	u32 id;
+	/* event specific, e.g. the post fence threshold on submit exit */
+	u64 data;
+	u64 reserved;
+};
+
+struct nvgpu_tstamp_ring_hdr {
+	u32 magic;
+	u32 num_records;
+	u32 cpu;
+	u32 reserved;
+	/* number of records written so far */
+	u64 seq;
+	u64 pad[5];
+};
+
+DECLARE_STATIC_KEY_FALSE(nvgpu_tstamp_armed);
+
+void __nvgpu_tstamp_record(struct gk20a *g, u32 event, u32 id, u64 data);
+
+/*
+ * Costs a patched-out branch unless someone has the tstamp device open.
+ */
+static inline void nvgpu_tstamp_record(struct gk20a *g, u32 event, u32 id,
+				       u64 data)
+{
+	if (static_branch_unlikely(&nvgpu_tstamp_armed))
+		__nvgpu_tstamp_record(g, event, id, data);
+}
+
+int gk20a_tstamp_dev_open(struct inode *inode, struct file *filp);
+int gk20a_tstamp_dev_release(struct inode *inode, struct file *filp);
+int gk20a_tstamp_dev_mmap(struct file *filp, struct vm_area_struct *vma);
+
+#endif /* NVGPU_OS_LINUX_TSTAMP_RING_H */
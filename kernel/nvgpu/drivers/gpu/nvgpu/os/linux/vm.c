@@ -22,6 +22,7 @@
 #include <nvgpu/log.h>
 #include<nvgpu/log2.h>
 #include <nvgpu/lock.h>
+#include <nvgpu/kref.h>
 #include <nvgpu/rbtree.h>
 #include <nvgpu/vm_area.h>
 #include <nvgpu/nvgpu_mem.h>
@@ -171,15 +172,14 @@ u64 nvgpu_os_buf_get_size(struct nvgpu_os_buffer *os_buf)
 }
 
 /*
- * vm->update_gmmu_lock must be held. This checks to see if we already have
- * mapped the passed buffer into this VM. If so, just return the existing
- * mapping address.
+ * vm->update_gmmu_lock must be held. Looks up an existing mapping of the
+ * dmabuf with the same kind and flags, without touching its pin state.
  */
-struct nvgpu_mapped_buf *nvgpu_vm_find_mapping(struct vm_gk20a *vm,
-					       struct nvgpu_os_buffer *os_buf,
-					       u64 map_addr,
-					       u32 flags,
-					       s16 kind)
+static struct nvgpu_mapped_buf *nvgpu_vm_lookup_mapping(struct vm_gk20a *vm,
+							struct dma_buf *dmabuf,
+							u64 map_addr,
+							u32 flags,
+							s16 kind)
 {
 	struct gk20a *g = gk20a_from_vm(vm);
 	struct nvgpu_mapped_buf *mapped_buffer = NULL;
@@ -189,14 +189,12 @@ struct nvgpu_mapped_buf *nvgpu_vm_find_mapping(struct vm_gk20a *vm,
 		if (!mapped_buffer)
 			return NULL;
 
-		if (mapped_buffer->os_priv.dmabuf != os_buf->dmabuf ||
+		if (mapped_buffer->os_priv.dmabuf != dmabuf ||
 		    mapped_buffer->kind != kind)
 			return NULL;
 	} else {
 		mapped_buffer =
-			nvgpu_vm_find_mapped_buf_reverse(vm,
-							 os_buf->dmabuf,
-							 kind);
+			nvgpu_vm_find_mapped_buf_reverse(vm, dmabuf, kind);
 		if (!mapped_buffer)
 			return NULL;
 	}
@@ -210,13 +208,34 @@ struct nvgpu_mapped_buf *nvgpu_vm_find_mapping(struct vm_gk20a *vm,
 		  "pgsz=%-3dKb as=%-2d "
 		  "flags=0x%x apt=%s (reused)",
 		  u64_hi32(mapped_buffer->addr), u64_lo32(mapped_buffer->addr),
-		  os_buf->dmabuf->size,
+		  dmabuf->size,
 		  (u64)sg_dma_address(mapped_buffer->os_priv.sgt->sgl),
 		  (u64)sg_phys(mapped_buffer->os_priv.sgt->sgl),
 		  vm->gmmu_page_sizes[mapped_buffer->pgsz_idx] >> 10,
 		  vm_aspace_id(vm),
 		  mapped_buffer->flags,
-		  nvgpu_aperture_str(gk20a_dmabuf_aperture(g, os_buf->dmabuf)));
+		  nvgpu_aperture_str(gk20a_dmabuf_aperture(g, dmabuf)));
+
+	return mapped_buffer;
+}
+
+/*
+ * vm->update_gmmu_lock must be held. This checks to see if we already have
+ * mapped the passed buffer into this VM. If so, just return the existing
+ * mapping address.
+ */
+struct nvgpu_mapped_buf *nvgpu_vm_find_mapping(struct vm_gk20a *vm,
+					       struct nvgpu_os_buffer *os_buf,
+					       u64 map_addr,
+					       u32 flags,
+					       s16 kind)
+{
+	struct nvgpu_mapped_buf *mapped_buffer;
+
+	mapped_buffer = nvgpu_vm_lookup_mapping(vm, os_buf->dmabuf, map_addr,
+						flags, kind);
+	if (!mapped_buffer)
+		return NULL;
 
 	/*
 	 * If we find the mapping here then that means we have mapped it already
@@ -284,6 +303,7 @@ int nvgpu_vm_map_linux(struct vm_gk20a *vm,
 	struct nvgpu_sgt *nvgpu_sgt = NULL;
 	struct nvgpu_mapped_buf *mapped_buffer = NULL;
 	struct dma_buf_attachment *attachment;
+	s16 map_key_kind;
 	int err = 0;
 
 	nvgpu_log(g, gpu_dbg_map, "dmabuf file mode: 0x%x mapping flags: 0x%x",
@@ -297,6 +317,31 @@ int nvgpu_vm_map_linux(struct vm_gk20a *vm,
 		return err;
 	}
 
+	/*
+	 * Reuse an existing mapping before the dmabuf gets pinned, so that a
+	 * re-map of the same buffer costs only a reference. Same key as the
+	 * map cache in nvgpu_vm_map(). The mapping holds its own dmabuf
+	 * reference, the one of this map call is dropped.
+	 */
+	if (!vm->userspace_managed) {
+		if (compr_kind != NVGPU_KIND_INVALID)
+			map_key_kind = compr_kind;
+		else
+			map_key_kind = incompr_kind;
+
+		nvgpu_mutex_acquire(&vm->update_gmmu_lock);
+		mapped_buffer = nvgpu_vm_lookup_mapping(vm, dmabuf, map_addr,
+							flags, map_key_kind);
+		if (mapped_buffer) {
+			nvgpu_ref_get(&mapped_buffer->ref);
+			nvgpu_mutex_release(&vm->update_gmmu_lock);
+			dma_buf_put(dmabuf);
+			*gpu_va = mapped_buffer->addr;
+			return 0;
+		}
+		nvgpu_mutex_release(&vm->update_gmmu_lock);
+	}
+
 	sgt = nvgpu_mm_pin(dev, dmabuf, &attachment,
 			   (buffer_rw_mode == gk20a_mem_flag_read_only) ||
 			   (map_access_requested == NVGPU_VM_MAP_ACCESS_READ_ONLY) ?
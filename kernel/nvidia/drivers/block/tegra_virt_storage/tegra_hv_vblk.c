@@ -69,6 +69,9 @@ static struct vsc_request *vblk_get_req(struct vblk_dev *vblkdev)
 		req->vs_req.req_id = bit;
 		set_bit(bit, vblkdev->pending_reqs);
 		vblkdev->inflight_reqs++;
+	} else {
+		/* vblk_put_req() restarts the queue */
+		vblkdev->req_starved = true;
 	}
 
 exit:
@@ -104,6 +107,7 @@ static struct vsc_request *vblk_get_req_by_sr_num(struct vblk_dev *vblkdev,
 static void vblk_put_req(struct vsc_request *req)
 {
 	struct vblk_dev *vblkdev;
+	bool restart = false;
 
 	vblkdev = req->vblkdev;
 	if (vblkdev == NULL) {
@@ -141,9 +145,17 @@ static void vblk_put_req(struct vsc_request *req)
 			(vblkdev->queue_state == VBLK_QUEUE_SUSPENDED)) {
 			complete(&vblkdev->req_queue_empty);
 		}
+
+		restart = vblkdev->req_starved;
+		vblkdev->req_starved = false;
 	}
 exit:
 	mutex_unlock(&vblkdev->req_lock);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+	if (restart)
+		blk_mq_run_hw_queues(vblkdev->queue, true);
+#endif
 }
 
 static int vblk_send_config_cmd(struct vblk_dev *vblkdev)
@@ -444,54 +456,69 @@ static bool bio_req_sanity_check(struct vblk_dev *vblkdev,
 }
 
 /**
- * submit_bio_req: Fetch a bio request and submit it to
- * server for processing.
+ * vblk_queue_frame: Hand a request to the server. With blk-mq the frame is
+ * only staged, vblk_commit_frames() publishes the whole batch with a single
+ * notification.
  */
-static bool submit_bio_req(struct vblk_dev *vblkdev)
+static int vblk_queue_frame(struct vblk_dev *vblkdev,
+		const struct vs_request *vs_req)
 {
-	struct vsc_request *vsc_req = NULL;
-	struct request *bio_req = NULL;
-	struct vs_request *vs_req;
-	struct bio_vec bvec;
-	size_t size;
-	size_t total_size = 0;
-	void *buffer;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
-	struct req_entry *entry = NULL;
-#endif
-	size_t sz;
-	uint32_t sg_cnt;
-	dma_addr_t  sg_dma_addr = 0;
+	int count;
 
-	/* Check if ivc queue is full */
-	if (!tegra_hv_ivc_can_write(vblkdev->ivck))
-		goto bio_exit;
+	count = tegra_hv_ivc_write_get_frames(vblkdev->ivck,
+			vblkdev->tx_frames, vblkdev->tx_batched + 1);
+	if (count < 0)
+		return count;
+	if (count <= vblkdev->tx_batched)
+		return -ENOMEM;
 
-	if (vblkdev->queue == NULL)
-		goto bio_exit;
+	memcpy(vblkdev->tx_frames[vblkdev->tx_batched], vs_req,
+			sizeof(struct vs_request));
+	vblkdev->tx_batched++;
+#else
+	if (!tegra_hv_ivc_write(vblkdev->ivck, vs_req,
+				sizeof(struct vs_request)))
+		return -EIO;
+#endif
 
-	vsc_req = vblk_get_req(vblkdev);
-	if (vsc_req == NULL)
-		goto bio_exit;
+	return 0;
+}
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
-	spin_lock(&vblkdev->queue_lock);
-	if(!list_empty(&vblkdev->req_list)) {
-		entry = list_first_entry(&vblkdev->req_list, struct req_entry,
-						list_entry);
-		list_del(&entry->list_entry);
-		bio_req = entry->req;
-		kfree(entry);
-	}
-	spin_unlock(&vblkdev->queue_lock);
-#else
-	spin_lock(vblkdev->queue->queue_lock);
-	bio_req = blk_fetch_request(vblkdev->queue);
-	spin_unlock(vblkdev->queue->queue_lock);
+/**
+ * vblk_commit_frames: Publish the frames staged by vblk_queue_frame().
+ * Called with ivc_lock held.
+ */
+static void vblk_commit_frames(struct vblk_dev *vblkdev)
+{
+	if (vblkdev->tx_batched == 0)
+		return;
+
+	if (tegra_hv_ivc_write_advance_frames(vblkdev->ivck,
+				vblkdev->tx_batched))
+		dev_err(vblkdev->device, "IVC write of %u requests failed!\n",
+			vblkdev->tx_batched);
+
+	vblkdev->tx_batched = 0;
+}
 #endif
 
-	if (bio_req == NULL)
-		goto bio_exit;
+/**
+ * vblk_submit_rq: Build the vsc request for a block request and queue it
+ * to the server. Called with ivc_lock held.
+ */
+static void vblk_submit_rq(struct vblk_dev *vblkdev,
+		struct vsc_request *vsc_req, struct request *bio_req)
+{
+	struct vs_request *vs_req;
+	struct bio_vec bvec;
+	size_t size;
+	size_t total_size = 0;
+	void *buffer;
+	size_t sz;
+	uint32_t sg_cnt;
+	dma_addr_t  sg_dma_addr = 0;
 
 	if ((vblkdev->config.blk_config.use_vm_address) &&
 		((req_op(bio_req) == REQ_OP_READ) ||
@@ -616,33 +643,77 @@ static bool submit_bio_req(struct vblk_dev *vblkdev)
 		}
 	}
 
-	if (!tegra_hv_ivc_write(vblkdev->ivck, vs_req,
-				sizeof(struct vs_request))) {
+	if (vblk_queue_frame(vblkdev, vs_req)) {
 		dev_err(vblkdev->device,
 			"Request Id %d IVC write failed!\n",
 				vsc_req->id);
 		goto bio_exit;
 	}
 
-	return true;
+	return;
 
 bio_exit:
-	if (vsc_req != NULL) {
+	vblk_put_req(vsc_req);
+	req_error_handler(vblkdev, bio_req);
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 9, 0)
+/**
+ * submit_bio_req: Fetch a bio request and submit it to
+ * server for processing.
+ */
+static bool submit_bio_req(struct vblk_dev *vblkdev)
+{
+	struct vsc_request *vsc_req;
+	struct request *bio_req;
+
+	/* Check if ivc queue is full */
+	if (!tegra_hv_ivc_can_write(vblkdev->ivck))
+		return false;
+
+	if (vblkdev->queue == NULL)
+		return false;
+
+	vsc_req = vblk_get_req(vblkdev);
+	if (vsc_req == NULL)
+		return false;
+
+	spin_lock(vblkdev->queue->queue_lock);
+	bio_req = blk_fetch_request(vblkdev->queue);
+	spin_unlock(vblkdev->queue->queue_lock);
+
+	if (bio_req == NULL) {
 		vblk_put_req(vsc_req);
+		return false;
 	}
 
-	if (bio_req != NULL) {
-		req_error_handler(vblkdev, bio_req);
-		return true;
-	}
+	vblk_submit_rq(vblkdev, vsc_req, bio_req);
 
-	return false;
+	return true;
 }
+#endif
 
 static void vblk_request_work(struct work_struct *ws)
 {
 	struct vblk_dev *vblkdev =
 		container_of(ws, struct vblk_dev, work);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+	int ret;
+
+	mutex_lock(&vblkdev->ivc_lock);
+	ret = tegra_hv_ivc_channel_notified(vblkdev->ivck);
+	mutex_unlock(&vblkdev->ivc_lock);
+	if (ret != 0)
+		return;
+
+	/*
+	 * Submission happens inline in vblk_request(), only completions are
+	 * left for the worker. The rx side of the channel is not shared with
+	 * the submitters, so this runs without ivc_lock.
+	 */
+	while (complete_bio_req(vblkdev))
+		;
+#else
 	bool req_submitted, req_completed;
 
 	/* Taking ivc lock before performing IVC read/write */
@@ -660,6 +731,7 @@ static void vblk_request_work(struct work_struct *ws)
 		req_submitted = submit_bio_req(vblkdev);
 	}
 	mutex_unlock(&vblkdev->ivc_lock);
+#endif
 }
 
 /* The simple form of the request function. */
@@ -667,32 +739,36 @@ static void vblk_request_work(struct work_struct *ws)
 static blk_status_t vblk_request(struct blk_mq_hw_ctx *hctx,
 			const struct blk_mq_queue_data *bd)
 {
-	struct req_entry *entry;
 	struct request *req = bd->rq;
 	struct vblk_dev *vblkdev = hctx->queue->queuedata;
+	struct vsc_request *vsc_req;
 
-	blk_mq_start_request(req);
+	/*
+	 * The tag set is sized to max_requests, so a slot is only missing
+	 * while a completed request has not been released yet.
+	 */
+	vsc_req = vblk_get_req(vblkdev);
+	if (vsc_req == NULL)
+		return BLK_STS_DEV_RESOURCE;
 
-	/* malloc for req list entry */
-	entry = kmalloc(sizeof(struct req_entry), GFP_ATOMIC);
-	if (entry == NULL) {
-		dev_err(vblkdev->device, "Failed to allocate memory\n");
-		return BLK_STS_IOERR;
-	}
+	blk_mq_start_request(req);
 
-	/* Initialise the entry */
-	entry->req = req;
-	INIT_LIST_HEAD(&entry->list_entry);
+	mutex_lock(&vblkdev->ivc_lock);
+	vblk_submit_rq(vblkdev, vsc_req, req);
+	if (bd->last)
+		vblk_commit_frames(vblkdev);
+	mutex_unlock(&vblkdev->ivc_lock);
 
-	/* Insert the req to list */
-	spin_lock(&vblkdev->queue_lock);
-	list_add_tail(&entry->list_entry, &vblkdev->req_list);
-	spin_unlock(&vblkdev->queue_lock);
+	return BLK_STS_OK;
+}
 
-	/* Now invoke the queue to handle data inserted in queue */
-	queue_work_on(WORK_CPU_UNBOUND, vblkdev->wq, &vblkdev->work);
+static void vblk_commit_rqs(struct blk_mq_hw_ctx *hctx)
+{
+	struct vblk_dev *vblkdev = hctx->queue->queuedata;
 
-	return BLK_STS_OK;
+	mutex_lock(&vblkdev->ivc_lock);
+	vblk_commit_frames(vblkdev);
+	mutex_unlock(&vblkdev->ivc_lock);
 }
 #else
 static void vblk_request(struct request_queue *q)
@@ -841,6 +917,7 @@ static const struct device_attribute dev_attr_speed_mode_ro =
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
 static const struct blk_mq_ops vblk_mq_ops = {
 	.queue_rq	= vblk_request,
+	.commit_rqs	= vblk_commit_rqs,
 };
 #endif
 /* Set up virtual device. */
@@ -860,28 +937,6 @@ static void setup_device(struct vblk_dev *vblkdev)
 	mutex_init(&vblkdev->ioctl_lock);
 	mutex_init(&vblkdev->ivc_lock);
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
-	vblkdev->queue = blk_mq_init_sq_queue(&vblkdev->tag_set, &vblk_mq_ops, 16,
-						BLK_MQ_F_SHOULD_MERGE);
-#else
-	vblkdev->queue = blk_init_queue(vblk_request, &vblkdev->queue_lock);
-#endif
-	if (vblkdev->queue == NULL) {
-		dev_err(vblkdev->device, "failed to init blk queue\n");
-		return;
-	}
-
-	vblkdev->queue->queuedata = vblkdev;
-
-	blk_queue_logical_block_size(vblkdev->queue,
-		vblkdev->config.blk_config.hardblk_size);
-	blk_queue_physical_block_size(vblkdev->queue,
-		vblkdev->config.blk_config.hardblk_size);
-
-	if (vblkdev->config.blk_config.req_ops_supported & VS_BLK_FLUSH_OP_F) {
-		blk_queue_write_cache(vblkdev->queue, true, false);
-	}
-
 	if (vblkdev->config.blk_config.max_read_blks_per_io !=
 		vblkdev->config.blk_config.max_write_blks_per_io) {
 		dev_err(vblkdev->device,
@@ -975,6 +1030,35 @@ static void setup_device(struct vblk_dev *vblkdev)
 	mutex_init(&vblkdev->req_lock);
 
 	vblkdev->max_requests = max_requests;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+	/*
+	 * One tag per request slot, submitted inline from queue_rq. The
+	 * protocol runs over a single IVC channel, so there is one hw queue.
+	 */
+	vblkdev->queue = blk_mq_init_sq_queue(&vblkdev->tag_set, &vblk_mq_ops,
+			max_requests, BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_BLOCKING);
+	if (IS_ERR(vblkdev->queue))
+		vblkdev->queue = NULL;
+#else
+	vblkdev->queue = blk_init_queue(vblk_request, &vblkdev->queue_lock);
+#endif
+	if (vblkdev->queue == NULL) {
+		dev_err(vblkdev->device, "failed to init blk queue\n");
+		return;
+	}
+
+	vblkdev->queue->queuedata = vblkdev;
+
+	blk_queue_logical_block_size(vblkdev->queue,
+		vblkdev->config.blk_config.hardblk_size);
+	blk_queue_physical_block_size(vblkdev->queue,
+		vblkdev->config.blk_config.hardblk_size);
+
+	if (vblkdev->config.blk_config.req_ops_supported & VS_BLK_FLUSH_OP_F) {
+		blk_queue_write_cache(vblkdev->queue, true, false);
+	}
+
 	blk_queue_max_hw_sectors(vblkdev->queue, max_io_bytes / SECTOR_SIZE);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
 	blk_queue_flag_set(QUEUE_FLAG_NONROT, vblkdev->queue);
@@ -1107,12 +1191,20 @@ static irqreturn_t ivc_irq_handler(int irq, void *data)
 static int tegra_hv_vblk_probe(struct platform_device *pdev)
 {
 	static struct device_node *vblk_node;
+	struct device_node *jh_node;
 	struct vblk_dev *vblkdev;
 	struct device *dev = &pdev->dev;
 	int ret;
 	struct tegra_hv_ivm_cookie *ivmk;
 
-	if (!is_tegra_hypervisor_mode()) {
+	/*
+	 * Under Jailhouse the queues come from tegra_hv_jailhouse and the
+	 * server is tegra_hv_vblk_server in the root cell.
+	 */
+	jh_node = of_find_compatible_node(NULL, NULL,
+			"nvidia,tegra-hv-jailhouse");
+	of_node_put(jh_node);
+	if (!is_tegra_hypervisor_mode() && (jh_node == NULL)) {
 		dev_err(dev, "Hypervisor is not present\n");
 		return -ENODEV;
 	}
@@ -1158,6 +1250,11 @@ static int tegra_hv_vblk_probe(struct platform_device *pdev)
 
 	vblkdev->ivck = tegra_hv_ivc_reserve(NULL, vblkdev->ivc_id, NULL);
 	if (IS_ERR_OR_NULL(vblkdev->ivck)) {
+		/* the Jailhouse backend may not have probed yet */
+		if (PTR_ERR(vblkdev->ivck) == -EPROBE_DEFER) {
+			ret = -EPROBE_DEFER;
+			goto fail;
+		}
 		dev_err(dev, "Failed to reserve IVC channel %d\n",
 			vblkdev->ivc_id);
 		vblkdev->ivck = NULL;
@@ -1167,6 +1264,10 @@ static int tegra_hv_vblk_probe(struct platform_device *pdev)
 
 	ivmk = tegra_hv_mempool_reserve(vblkdev->ivm_id);
 	if (IS_ERR_OR_NULL(ivmk)) {
+		if (PTR_ERR(ivmk) == -EPROBE_DEFER) {
+			ret = -EPROBE_DEFER;
+			goto free_ivc;
+		}
 		dev_err(dev, "Failed to reserve IVM channel %d\n",
 			vblkdev->ivm_id);
 		ivmk = NULL;
@@ -1200,10 +1301,6 @@ static int tegra_hv_vblk_probe(struct platform_device *pdev)
 
 	INIT_WORK(&vblkdev->init, vblk_init_device);
 	INIT_WORK(&vblkdev->work, vblk_request_work);
-#if LINUX_VERSION_CODE > KERNEL_VERSION(4, 15, 0)
-	/* creating and initializing the an internal request list */
-	INIT_LIST_HEAD(&vblkdev->req_list);
-#endif
 
 	if (devm_request_irq(vblkdev->device, vblkdev->ivck->irq,
 		ivc_irq_handler, 0, "vblk", vblkdev)) {
@@ -0,0 +1,621 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Virtual storage back end for the tegra_hv_vblk front end.
+ *
+ * Under the NVIDIA hypervisor the vs_request protocol is served by the
+ * storage server partition. Under Jailhouse there is no such partition, so
+ * the root cell serves it instead, over a tegra_hv queue and mempool that
+ * tegra_hv_jailhouse.c set up on an ivshmem link:
+ *
+ *	vblk-server@0 {
+ *		compatible = "nvidia,tegra-hv-storage-server";
+ *		ivc = <&tegra_hv 4>;		(IVC queue id)
+ *		mempool = <4>;			(mempool id)
+ *		nvidia,backing-dev = "/dev/mmcblk0p42";
+ *		nvidia,read-only;
+ *	};
+ *
+ * The inmate describes the same queue and mempool with the usual
+ * "nvidia,tegra-hv-storage" node. The backing device may be anything
+ * name_to_dev_t() understands, e.g. "PARTUUID=...".
+ *
+ * With CONFIG_ZONE_DEVICE the mempool is given struct pages and bios are
+ * built straight on each request slot's window, so the storage controller
+ * DMAs into the shared region and the server touches no data. This needs
+ * the mempool to be outside System RAM, aligned for memremap_pages(), and
+ * mapped in the SMMU context of the root cell's storage controller, which
+ * Jailhouse does for every memory region of the root cell. Otherwise each
+ * slot owns bounce pages that are copied to and from its window.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/io.h>
+#include <linux/interrupt.h>
+#include <linux/workqueue.h>
+#include <linux/mutex.h>
+#include <linux/platform_device.h>
+#include <linux/of.h>
+#include <linux/mount.h>
+#include <linux/memremap.h>
+#include <linux/blkdev.h>
+#include <linux/bio.h>
+#include <linux/tegra-ivc.h>
+#include <tegra_virt_storage_spec.h>
+
+#define DRV_NAME "tegra_hv_vblk_server"
+
+/* Must match MAX_VSC_REQS of the front end */
+#define VBLK_SRV_MAX_SLOTS	32
+
+struct vblk_srv;
+
+struct vblk_srv_slot {
+	struct vblk_srv *srv;
+	struct work_struct work;
+	struct vs_request req;
+	struct page **pages;
+	void *window;
+	uint32_t epoch;
+	bool busy;
+};
+
+struct vblk_srv {
+	struct device *device;
+	struct tegra_hv_ivc_cookie *ivck;
+	struct tegra_hv_ivm_cookie *ivmk;
+	uint32_t ivc_id;
+	uint32_t ivm_id;
+	void *shared_buffer;
+	/* bios are built on the mempool itself, see vblk_srv_map_mempool() */
+	bool direct;
+#ifdef CONFIG_ZONE_DEVICE
+	struct dev_pagemap pgmap;
+#endif
+
+	struct block_device *bdev;
+	bool read_only;
+	uint32_t blk_size;
+	uint64_t num_blks;
+	uint32_t max_io_blks;
+	uint32_t max_io_bytes;
+	unsigned int nr_pages;
+
+	struct workqueue_struct *wq;
+	struct work_struct rx_work;
+	/* serialises IVC access, the slot states and the epoch */
+	struct mutex ivc_lock;
+	uint32_t epoch;
+
+	unsigned int nr_slots;
+	struct vblk_srv_slot slots[VBLK_SRV_MAX_SLOTS];
+};
+
+static void vblk_srv_copy(struct vblk_srv_slot *slot, size_t len, bool in)
+{
+	unsigned int i;
+	size_t chunk;
+
+	for (i = 0; len != 0; i++) {
+		chunk = min_t(size_t, len, PAGE_SIZE);
+		if (in)
+			memcpy(page_address(slot->pages[i]),
+				slot->window + i * PAGE_SIZE, chunk);
+		else
+			memcpy(slot->window + i * PAGE_SIZE,
+				page_address(slot->pages[i]), chunk);
+		len -= chunk;
+	}
+}
+
+static int vblk_srv_rw(struct vblk_srv_slot *slot, unsigned int op,
+		sector_t sector, size_t len)
+{
+	struct vblk_srv *srv = slot->srv;
+	struct bio *bio;
+	unsigned int i;
+	size_t chunk;
+	int ret;
+
+	bio = bio_alloc(GFP_KERNEL, DIV_ROUND_UP(len, PAGE_SIZE));
+	if (bio == NULL)
+		return -ENOMEM;
+
+	bio_set_dev(bio, srv->bdev);
+	bio->bi_iter.bi_sector = sector;
+	bio->bi_opf = op;
+
+	for (i = 0; len != 0; i++) {
+		chunk = min_t(size_t, len, PAGE_SIZE);
+		if (bio_add_page(bio, slot->pages[i], chunk, 0) != chunk) {
+			bio_put(bio);
+			return -EIO;
+		}
+		len -= chunk;
+	}
+
+	ret = submit_bio_wait(bio);
+	bio_put(bio);
+
+	return ret;
+}
+
+static int vblk_srv_do_io(struct vblk_srv_slot *slot)
+{
+	struct vblk_srv *srv = slot->srv;
+	struct vs_blk_request *blk_req = &slot->req.blkdev_req.blk_req;
+	sector_t sector;
+	size_t len;
+	int ret;
+
+	if (slot->req.blkdev_req.req_op == VS_BLK_FLUSH)
+		return blkdev_issue_flush(srv->bdev, GFP_KERNEL);
+
+	if ((blk_req->num_blks == 0) ||
+	    (blk_req->blk_offset >= srv->num_blks) ||
+	    (blk_req->num_blks > srv->num_blks - blk_req->blk_offset))
+		return -EINVAL;
+
+	sector = blk_req->blk_offset * (srv->blk_size >> SECTOR_SHIFT);
+
+	switch (slot->req.blkdev_req.req_op) {
+	case VS_BLK_DISCARD:
+	case VS_BLK_SECURE_ERASE:
+		if (srv->read_only)
+			return -EROFS;
+		return blkdev_issue_discard(srv->bdev, sector,
+			blk_req->num_blks * (srv->blk_size >> SECTOR_SHIFT),
+			GFP_KERNEL,
+			slot->req.blkdev_req.req_op == VS_BLK_SECURE_ERASE ?
+				BLKDEV_DISCARD_SECURE : 0);
+	case VS_BLK_READ:
+	case VS_BLK_WRITE:
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	len = (size_t)blk_req->num_blks * srv->blk_size;
+	if ((blk_req->num_blks > srv->max_io_blks) ||
+	    (blk_req->data_offset != slot->window - srv->shared_buffer))
+		return -EINVAL;
+
+	if (slot->req.blkdev_req.req_op == VS_BLK_READ) {
+		ret = vblk_srv_rw(slot, REQ_OP_READ, sector, len);
+		if ((ret == 0) && !srv->direct)
+			vblk_srv_copy(slot, len, false);
+	} else {
+		if (srv->read_only)
+			return -EROFS;
+		if (!srv->direct)
+			vblk_srv_copy(slot, len, true);
+		ret = vblk_srv_rw(slot, REQ_OP_WRITE, sector, len);
+	}
+
+	return ret;
+}
+
+/* Called with ivc_lock held */
+static void vblk_srv_respond(struct vblk_srv *srv, struct vs_request *resp)
+{
+	if (tegra_hv_ivc_write(srv->ivck, resp, sizeof(*resp)) !=
+			sizeof(*resp))
+		dev_err(srv->device, "response %u lost, ivc write failed\n",
+			resp->req_id);
+}
+
+static void vblk_srv_slot_work(struct work_struct *ws)
+{
+	struct vblk_srv_slot *slot =
+		container_of(ws, struct vblk_srv_slot, work);
+	struct vblk_srv *srv = slot->srv;
+	struct vs_request resp;
+	int ret;
+
+	ret = vblk_srv_do_io(slot);
+	if (ret != 0)
+		dev_err(srv->device, "request %u op %u failed: %d\n",
+			slot->req.req_id, slot->req.blkdev_req.req_op, ret);
+
+	memset(&resp, 0, sizeof(resp));
+	resp.type = VS_DATA_REQ;
+	resp.req_id = slot->req.req_id;
+	resp.status = 0;
+	resp.blkdev_resp.blk_resp.status = ret;
+	resp.blkdev_resp.blk_resp.num_blks =
+		(ret == 0) ? slot->req.blkdev_req.blk_req.num_blks : 0;
+
+	mutex_lock(&srv->ivc_lock);
+	/* Requests of a front end that has since reset are dropped */
+	if (slot->epoch == srv->epoch)
+		vblk_srv_respond(srv, &resp);
+	slot->busy = false;
+	mutex_unlock(&srv->ivc_lock);
+}
+
+static void vblk_srv_configinfo(struct vblk_srv *srv)
+{
+	struct vs_request resp;
+	typeof(resp.config_info.blk_config) *cfg =
+		&resp.config_info.blk_config;
+
+	memset(&resp, 0, sizeof(resp));
+	resp.type = VS_CONFIGINFO_REQ;
+	resp.status = 0;
+	resp.config_info.type = VS_BLK_DEV;
+	resp.config_info.storage_type = VSC_STORAGE_LUN0;
+
+	cfg->hardblk_size = srv->blk_size;
+	cfg->num_blks = srv->num_blks;
+	cfg->use_vm_address = 0;
+	cfg->max_read_blks_per_io = srv->max_io_blks;
+	cfg->max_write_blks_per_io = srv->max_io_blks;
+	cfg->req_ops_supported = VS_BLK_READ_OP_F | VS_BLK_FLUSH_OP_F;
+	if (!srv->read_only) {
+		cfg->req_ops_supported |= VS_BLK_WRITE_OP_F;
+		if (blk_queue_discard(bdev_get_queue(srv->bdev))) {
+			cfg->req_ops_supported |= VS_BLK_DISCARD_OP_F;
+			cfg->max_erase_blks_per_io = srv->max_io_blks;
+		}
+		if (blk_queue_secure_erase(bdev_get_queue(srv->bdev)))
+			cfg->req_ops_supported |= VS_BLK_SECURE_ERASE_OP_F;
+	}
+
+	/*
+	 * The front end sends this right after resetting the channel, so
+	 * whatever is still in flight belongs to its previous life.
+	 */
+	srv->epoch++;
+	vblk_srv_respond(srv, &resp);
+}
+
+static void vblk_srv_rx_work(struct work_struct *ws)
+{
+	struct vblk_srv *srv = container_of(ws, struct vblk_srv, rx_work);
+	struct vblk_srv_slot *slot;
+	struct vs_request req;
+
+	mutex_lock(&srv->ivc_lock);
+	if (tegra_hv_ivc_channel_notified(srv->ivck) != 0)
+		goto out;
+
+	while (tegra_hv_ivc_can_read(srv->ivck)) {
+		if (tegra_hv_ivc_read(srv->ivck, &req, sizeof(req)) !=
+				sizeof(req)) {
+			dev_err(srv->device, "ivc read failed\n");
+			break;
+		}
+
+		if (req.type == VS_CONFIGINFO_REQ) {
+			vblk_srv_configinfo(srv);
+			continue;
+		}
+
+		if ((req.type != VS_DATA_REQ) ||
+		    (req.req_id >= srv->nr_slots) ||
+		    srv->slots[req.req_id].busy) {
+			dev_err(srv->device, "bad request type %u id %u\n",
+				req.type, req.req_id);
+			memset(&req.blkdev_resp, 0, sizeof(req.blkdev_resp));
+			req.status = -EINVAL;
+			vblk_srv_respond(srv, &req);
+			continue;
+		}
+
+		slot = &srv->slots[req.req_id];
+		slot->req = req;
+		slot->epoch = srv->epoch;
+		slot->busy = true;
+		queue_work(srv->wq, &slot->work);
+	}
+
+out:
+	mutex_unlock(&srv->ivc_lock);
+}
+
+static irqreturn_t vblk_srv_irq_handler(int irq, void *data)
+{
+	struct vblk_srv *srv = data;
+
+	queue_work(srv->wq, &srv->rx_work);
+
+	return IRQ_HANDLED;
+}
+
+/*
+ * Size the I/O window so that the front end, which carves the mempool into
+ * mempool size / max I/O request slots, never has more slots than there are
+ * IVC frames.
+ */
+static int vblk_srv_setup_slots(struct vblk_srv *srv)
+{
+	unsigned int nr_slots, i, j;
+	uint64_t size = srv->ivmk->size;
+
+	nr_slots = min_t(unsigned int, srv->ivck->nframes, VBLK_SRV_MAX_SLOTS);
+	if ((nr_slots == 0) || (size < srv->blk_size))
+		return -EINVAL;
+
+	srv->max_io_blks = DIV_ROUND_UP_ULL(size,
+			(uint64_t)nr_slots * srv->blk_size);
+	srv->max_io_blks = min_t(uint32_t, srv->max_io_blks,
+			(BIO_MAX_PAGES * PAGE_SIZE) / srv->blk_size);
+	srv->max_io_blks = min_t(uint32_t, srv->max_io_blks,
+			div_u64(size, srv->blk_size));
+	/* direct windows must start on a page boundary */
+	if (srv->direct && (srv->blk_size < PAGE_SIZE)) {
+		unsigned int per_page = PAGE_SIZE / srv->blk_size;
+
+		srv->max_io_blks = rounddown(srv->max_io_blks, per_page);
+		if (srv->max_io_blks == 0)
+			return -EINVAL;
+	}
+	srv->max_io_bytes = srv->max_io_blks * srv->blk_size;
+
+	srv->nr_slots = min_t(uint64_t, div_u64(size, srv->max_io_bytes),
+			VBLK_SRV_MAX_SLOTS);
+	if (srv->nr_slots > srv->ivck->nframes) {
+		dev_err(srv->device, "mempool too large for %d ivc frames\n",
+			srv->ivck->nframes);
+		return -EINVAL;
+	}
+
+	srv->nr_pages = DIV_ROUND_UP(srv->max_io_bytes, PAGE_SIZE);
+	for (i = 0; i < srv->nr_slots; i++) {
+		struct vblk_srv_slot *slot = &srv->slots[i];
+
+		slot->srv = srv;
+		slot->window = srv->shared_buffer + i * srv->max_io_bytes;
+		INIT_WORK(&slot->work, vblk_srv_slot_work);
+
+		slot->pages = devm_kcalloc(srv->device, srv->nr_pages,
+				sizeof(*slot->pages), GFP_KERNEL);
+		if (slot->pages == NULL)
+			return -ENOMEM;
+
+		for (j = 0; j < srv->nr_pages; j++) {
+			if (srv->direct)
+				slot->pages[j] = virt_to_page(slot->window +
+						j * PAGE_SIZE);
+			else
+				slot->pages[j] = alloc_page(GFP_KERNEL);
+			if (slot->pages[j] == NULL)
+				return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+static void vblk_srv_free_slots(struct vblk_srv *srv)
+{
+	unsigned int i, j;
+
+	if (srv->direct)
+		return;
+
+	for (i = 0; i < srv->nr_slots; i++) {
+		if (srv->slots[i].pages == NULL)
+			continue;
+		for (j = 0; j < srv->nr_pages; j++)
+			if (srv->slots[i].pages[j])
+				__free_page(srv->slots[i].pages[j]);
+	}
+}
+
+/*
+ * Prefer giving the mempool struct pages, so that bios can point into it,
+ * and fall back to a plain mapping plus bounce pages.
+ */
+static int vblk_srv_map_mempool(struct vblk_srv *srv)
+{
+#ifdef CONFIG_ZONE_DEVICE
+	void *addr;
+
+	srv->pgmap.type = MEMORY_DEVICE_GENERIC;
+	srv->pgmap.range.start = srv->ivmk->ipa;
+	srv->pgmap.range.end = srv->ivmk->ipa + srv->ivmk->size - 1;
+	srv->pgmap.nr_range = 1;
+
+	addr = devm_memremap_pages(srv->device, &srv->pgmap);
+	if (!IS_ERR(addr)) {
+		srv->shared_buffer = addr;
+		srv->direct = true;
+		return 0;
+	}
+	dev_info(srv->device, "mempool %d without struct pages (%ld), "
+		"bouncing\n", srv->ivm_id, PTR_ERR(addr));
+#endif
+
+	srv->shared_buffer = devm_memremap(srv->device, srv->ivmk->ipa,
+			srv->ivmk->size, MEMREMAP_WB);
+	if (IS_ERR_OR_NULL(srv->shared_buffer))
+		return -ENOMEM;
+
+	return 0;
+}
+
+static int tegra_hv_vblk_server_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct device_node *np = dev->of_node;
+	struct vblk_srv *srv;
+	const char *path;
+	fmode_t mode;
+	dev_t devt;
+	int ret;
+
+	if (np == NULL) {
+		dev_err(dev, "No of_node data\n");
+		return -ENODEV;
+	}
+
+	srv = devm_kzalloc(dev, sizeof(*srv), GFP_KERNEL);
+	if (srv == NULL)
+		return -ENOMEM;
+
+	platform_set_drvdata(pdev, srv);
+	srv->device = dev;
+	mutex_init(&srv->ivc_lock);
+
+	if (of_property_read_u32_index(np, "ivc", 1, &srv->ivc_id)) {
+		dev_err(dev, "Failed to read ivc property\n");
+		return -ENODEV;
+	}
+	if (of_property_read_u32_index(np, "mempool", 0, &srv->ivm_id)) {
+		dev_err(dev, "Failed to read mempool property\n");
+		return -ENODEV;
+	}
+	if (of_property_read_string(np, "nvidia,backing-dev", &path)) {
+		dev_err(dev, "Failed to read nvidia,backing-dev property\n");
+		return -ENODEV;
+	}
+	srv->read_only = of_property_read_bool(np, "nvidia,read-only");
+
+	/* Partitions show up when their controller probes, retry then */
+	devt = name_to_dev_t(path);
+	if (devt == 0)
+		return -EPROBE_DEFER;
+
+	mode = FMODE_READ | FMODE_EXCL;
+	if (!srv->read_only)
+		mode |= FMODE_WRITE;
+	srv->bdev = blkdev_get_by_dev(devt, mode, srv);
+	if (IS_ERR(srv->bdev)) {
+		dev_err(dev, "Failed to open %s: %ld\n", path,
+			PTR_ERR(srv->bdev));
+		return PTR_ERR(srv->bdev);
+	}
+
+	srv->blk_size = bdev_logical_block_size(srv->bdev);
+	srv->num_blks = div_u64(i_size_read(srv->bdev->bd_inode),
+			srv->blk_size);
+
+	srv->ivck = tegra_hv_ivc_reserve(NULL, srv->ivc_id, NULL);
+	if (IS_ERR_OR_NULL(srv->ivck)) {
+		ret = IS_ERR(srv->ivck) ? PTR_ERR(srv->ivck) : -ENODEV;
+		if (ret != -EPROBE_DEFER)
+			dev_err(dev, "Failed to reserve IVC channel %d\n",
+				srv->ivc_id);
+		goto put_bdev;
+	}
+
+	if (srv->ivck->frame_size < sizeof(struct vs_request)) {
+		dev_err(dev, "IVC frame size %d too small\n",
+			srv->ivck->frame_size);
+		ret = -EINVAL;
+		goto free_ivc;
+	}
+
+	srv->ivmk = tegra_hv_mempool_reserve(srv->ivm_id);
+	if (IS_ERR_OR_NULL(srv->ivmk)) {
+		ret = IS_ERR(srv->ivmk) ? PTR_ERR(srv->ivmk) : -ENODEV;
+		if (ret != -EPROBE_DEFER)
+			dev_err(dev, "Failed to reserve IVM channel %d\n",
+				srv->ivm_id);
+		goto free_ivc;
+	}
+
+	ret = vblk_srv_map_mempool(srv);
+	if (ret != 0) {
+		dev_err(dev, "Failed to map mempool area %d\n", srv->ivm_id);
+		goto free_mempool;
+	}
+
+	ret = vblk_srv_setup_slots(srv);
+	if (ret != 0) {
+		dev_err(dev, "Failed to set up request slots: %d\n", ret);
+		goto free_slots;
+	}
+
+	srv->wq = alloc_workqueue("vblk_srv_wq%d", WQ_UNBOUND | WQ_MEM_RECLAIM,
+			srv->nr_slots + 1, srv->ivc_id);
+	if (srv->wq == NULL) {
+		dev_err(dev, "Failed to allocate workqueue\n");
+		ret = -ENOMEM;
+		goto free_slots;
+	}
+	INIT_WORK(&srv->rx_work, vblk_srv_rx_work);
+
+	if (devm_request_irq(dev, srv->ivck->irq, vblk_srv_irq_handler, 0,
+			"vblk-server", srv)) {
+		dev_err(dev, "Failed to request irq %d\n", srv->ivck->irq);
+		ret = -EINVAL;
+		goto free_wq;
+	}
+
+	tegra_hv_ivc_channel_reset(srv->ivck);
+
+	dev_info(dev, "serving %s on ivc #%u: %llu blocks of %u bytes, "
+		"%u slots of %u blocks%s%s\n", path, srv->ivc_id,
+		srv->num_blks, srv->blk_size, srv->nr_slots, srv->max_io_blks,
+		srv->direct ? ", zero-copy" : "",
+		srv->read_only ? ", read-only" : "");
+
+	return 0;
+
+free_wq:
+	destroy_workqueue(srv->wq);
+free_slots:
+	vblk_srv_free_slots(srv);
+free_mempool:
+	tegra_hv_mempool_unreserve(srv->ivmk);
+free_ivc:
+	tegra_hv_ivc_unreserve(srv->ivck);
+put_bdev:
+	blkdev_put(srv->bdev, mode);
+
+	return ret;
+}
+
+static int tegra_hv_vblk_server_remove(struct platform_device *pdev)
+{
+	struct vblk_srv *srv = platform_get_drvdata(pdev);
+	fmode_t mode = FMODE_READ | FMODE_EXCL;
+
+	if (!srv->read_only)
+		mode |= FMODE_WRITE;
+
+	devm_free_irq(srv->device, srv->ivck->irq, srv);
+	destroy_workqueue(srv->wq);
+	vblk_srv_free_slots(srv);
+	tegra_hv_mempool_unreserve(srv->ivmk);
+	tegra_hv_ivc_unreserve(srv->ivck);
+	blkdev_put(srv->bdev, mode);
+
+	return 0;
+}
+
+#ifdef CONFIG_OF
+static struct of_device_id tegra_hv_vblk_server_match[] = {
+	{ .compatible = "nvidia,tegra-hv-storage-server", },
+	{},
+};
+MODULE_DEVICE_TABLE(of, tegra_hv_vblk_server_match);
+#endif /* CONFIG_OF */
+
+static struct platform_driver tegra_hv_vblk_server_driver = {
+	.probe	= tegra_hv_vblk_server_probe,
+	.remove	= tegra_hv_vblk_server_remove,
+	.driver	= {
+		.name = DRV_NAME,
+		.owner = THIS_MODULE,
+		.of_match_table = of_match_ptr(tegra_hv_vblk_server_match),
+	},
+};
+module_platform_driver(tegra_hv_vblk_server_driver);
+
+MODULE_DESCRIPTION("Virtual storage server over Tegra HV IVC channel");
+MODULE_LICENSE("GPL");
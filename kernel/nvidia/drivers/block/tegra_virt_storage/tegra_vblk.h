@@ -50,13 +50,6 @@ struct vblk_ioctl_req {
 	int32_t status;
 };
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,9,0)
-struct req_entry {
-	struct list_head list_entry;
-	struct request *req;
-};
-#endif
-
 struct vsc_request {
 	struct vs_request vs_req;
 	struct request *req;
@@ -91,7 +84,8 @@ struct vblk_dev {
 	struct gendisk *gd;              /* The gendisk structure */
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5,9,0)
 	struct blk_mq_tag_set tag_set;
-	struct list_head req_list;	/* List containing req */
+	void *tx_frames[MAX_VSC_REQS];	/* Frames of the pending batch */
+	uint32_t tx_batched;		/* Staged, not yet published */
 #endif
 	uint32_t ivc_id;
 	uint32_t ivm_id;
@@ -110,6 +104,7 @@ struct vblk_dev {
 	DECLARE_BITMAP(pending_reqs, MAX_VSC_REQS);
 	uint32_t inflight_reqs;
 	uint32_t max_requests;
+	bool req_starved;		/* queue_rq ran out of requests */
 	struct mutex req_lock;
 	struct mutex ivc_lock;
 	enum vblk_queue_state queue_state;
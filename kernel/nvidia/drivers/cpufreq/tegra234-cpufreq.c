@@ -16,13 +16,18 @@
 #include <linux/cpufreq.h>
 #include <linux/delay.h>
 #include <linux/interconnect.h>
+#include <linux/interrupt.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
 #include <linux/debugfs.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_platform.h>
+#include <linux/perf_event.h>
 #include <linux/platform_device.h>
+#include <linux/sched/isolation.h>
 #include <linux/slab.h>
+#include <linux/tegra-ivc.h>
 #include <linux/platform/tegra/mc_utils.h>
 #include <linux/version.h>
 #include <soc/tegra/bpmp.h>
@@ -41,6 +46,15 @@
 #define CLUSTER_ACTMON_BASE(cl)		(0x30000 + (cl * 0x10000) + 0x9000)
 #define CORE_ACTMON_REG(core)		(core * 8)
 #define NDIV_MASK			0x1FF
+/* core clk counter wraps after ~2.1 sec at 2 GHz */
+#define MAX_SAMPLE_MS			1000
+#define SAMPLE_WINDOW_MAX_MS		1500
+/* memory traffic of a cpu, counted in overflows of its BUS_ACCESS event */
+#define ARMV8_PMU_BUS_ACCESS		0x19
+#define BUS_EV_PERIOD			(1 << 16)
+#define BUS_ACCESS_BYTES		64 /* one cache line per access */
+/* EMC bandwidth changes below 1/8 of the current floor are ignored */
+#define EMC_BW_HYST_SHIFT		3
 
 /* cpufreq transisition latency */
 #define TEGRA_CPUFREQ_TRANSITION_LATENCY (300 * 1000) /* unit in nanoseconds */
@@ -55,6 +69,27 @@ enum cluster {
 	MAX_CLUSTERS,
 };
 
+struct tegra234_cpufreq_cell;
+
+/*
+ * NDIV requests and EMC demand of a cluster, protected by arb_lock
+ * Without an owner cell the cluster follows the root governor. The owner
+ * cell may put a floor under it or pin it, a pin overrides the root
+ * governor and the floor. EMC bandwidth (KB/s) is measured on the root
+ * cpus of the cluster and reported by its owner cell.
+ */
+struct tegra234_cluster_arb {
+	struct tegra234_cpufreq_cell *owner;
+	u32 root_ndiv;
+	u32 floor_ndiv;
+	u32 pin_ndiv;
+	u32 cur_ndiv;
+	bool emc_meas_valid;
+	unsigned long emc_meas_kbps;
+	unsigned long emc_cell_kbps;
+	unsigned long emc_kbps;
+};
+
 struct tegra234_cpufreq_data {
 	void __iomem *regs;
 	size_t num_clusters;
@@ -62,9 +97,38 @@ struct tegra234_cpufreq_data {
 	struct cpufreq_frequency_table **tables;
 	struct cpumask *cl_cpu_mask;
 	struct mrq_cpu_ndiv_limits_response *ndiv_limits;
+	struct tegra234_cluster_arb *arb;
 	bool bypass_icc;
 };
 
+/*
+ * Frequency requests of a Jailhouse cell over an IVC queue
+ * The clusters a cell owns mirror the cpus given to it in its Jailhouse
+ * cell config. Each request is answered with the same message, status
+ * holds the result and rate_khz the resulting cluster freq.
+ * SET_MEM_BW passes the memory bandwidth the cell needs in KB/s in
+ * rate_khz, from its memguard budget for instance.
+ */
+#define CELL_MSG_SET_FLOOR		1
+#define CELL_MSG_PIN			2
+#define CELL_MSG_RELEASE		3
+#define CELL_MSG_GET_RATE		4
+#define CELL_MSG_SET_MEM_BW		5
+
+struct tegra234_cell_msg {
+	uint32_t msg_id;
+	uint32_t cl;
+	uint32_t rate_khz;
+	int32_t status;
+};
+
+struct tegra234_cpufreq_cell {
+	struct device *dev;
+	struct tegra_hv_ivc_cookie *ivck;
+	struct work_struct rx_work;
+	unsigned long clusters;
+};
+
 struct tegra_cpu_ctr {
 	u32 cpu;
 	u32 delay;
@@ -77,6 +141,22 @@ struct read_counters_work {
 	struct tegra_cpu_ctr c;
 };
 
+/* counters of a cpu as seen by the background sampler */
+struct tegra_cpu_sample {
+	void __iomem *actmon_reg;
+	u32 last_coreclk_cnt;
+	u32 last_refclk_cnt;
+	u64 last_ns;
+	/* freq over the last sample period and when it was computed */
+	unsigned int khz;
+	u64 khz_ns;
+	/* BUS_ACCESS counter, overflows are counted on the cpu itself */
+	enum cluster cl;
+	struct perf_event *bus_ev;
+	u64 bus_periods;
+	u64 last_bus_periods;
+};
+
 struct mpidr {
 	uint32_t cl;
 	uint32_t cpu;
@@ -84,8 +164,34 @@ struct mpidr {
 
 static struct workqueue_struct *read_counters_wq;
 
+static DEFINE_PER_CPU(struct tegra_cpu_sample, cpu_samples);
+
+static unsigned int sample_ms = 100;
+module_param(sample_ms, uint, 0444);
+MODULE_PARM_DESC(sample_ms,
+		 "Period of the background cpu freq sampler in ms, 0 for sampling on each query");
+
+static bool emc_demand = true;
+module_param(emc_demand, bool, 0444);
+MODULE_PARM_DESC(emc_demand,
+		 "Drive the EMC floor of a cluster by its measured memory traffic, cpu_emc_map is the fallback");
+
+static unsigned int emc_headroom_pct = 25;
+module_param(emc_headroom_pct, uint, 0644);
+MODULE_PARM_DESC(emc_headroom_pct,
+		 "EMC bandwidth above the measured memory traffic in percent");
+
+static bool bus_counters;
+
+static void tegra_sample_counters(struct work_struct *work);
+static DECLARE_DELAYED_WORK(sample_work, tegra_sample_counters);
+static void tegra234_set_emc_demand(const unsigned long *kbps,
+				    const bool *valid);
+
 static struct cpu_emc_mapping *cpu_emc_map_ptr;
 
+static DEFINE_MUTEX(arb_lock);
+
 static void get_mpidr_id(void *id)
 {
 	u64 mpidr = read_cpuid_mpidr() & MPIDR_HWID_BITMASK;
@@ -137,6 +243,96 @@ static void tegra_read_counters(struct work_struct *work)
 	c->coreclk_cnt = lower_32_bits(val);
 }
 
+static inline u32 tegra_ctr_delta(u32 cnt, u32 last_cnt)
+{
+	if (cnt < last_cnt)
+		return cnt + (MAX_CNT - last_cnt);
+
+	return cnt - last_cnt;
+}
+
+/* Returns freq in KHz over the window of the counters, 0 if cpu is idle */
+static unsigned int tegra_cpu_ctr_to_khz(const struct tegra_cpu_ctr *c)
+{
+	u32 delta_refcnt;
+	u32 delta_ccnt;
+	u32 rate_mhz;
+
+	delta_ccnt = tegra_ctr_delta(c->coreclk_cnt, c->last_coreclk_cnt);
+	if (!delta_ccnt)
+		return 0;
+
+	/* ref clock is 32 bits */
+	delta_refcnt = tegra_ctr_delta(c->refclk_cnt, c->last_refclk_cnt);
+	if (!delta_refcnt) {
+		pr_debug("cpufreq: %d is idle, delta_refcnt: 0\n", c->cpu);
+		return 0;
+	}
+	rate_mhz = ((unsigned long)(delta_ccnt * REF_CLK_MHZ)) / delta_refcnt;
+
+	return (rate_mhz * KHZ); /* in KHz */
+}
+
+/*
+ * Background sampler
+ * Runs on an unbound workqueue, so housekeeping cpus only, and reads the
+ * ACTMON counters of all online cpus through MMIO. The freq of a cpu is
+ * computed against the previous sample, no delay and no work is put on
+ * the cpu itself. A sample older than SAMPLE_WINDOW_MAX_MS (cpu just
+ * onlined, resume) only becomes the new baseline.
+ */
+static void tegra_sample_counters(struct work_struct *work)
+{
+	unsigned long kbps[MAX_CLUSTERS] = { 0 };
+	bool valid[MAX_CLUSTERS] = { false };
+	struct tegra_cpu_sample *s;
+	struct tegra_cpu_ctr c;
+	u64 val, now, periods;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		s = per_cpu_ptr(&cpu_samples, cpu);
+
+		val = readq(s->actmon_reg);
+		now = ktime_get_ns();
+		periods = READ_ONCE(s->bus_periods);
+
+		c.cpu = cpu;
+		c.refclk_cnt = upper_32_bits(val);
+		c.coreclk_cnt = lower_32_bits(val);
+		c.last_refclk_cnt = s->last_refclk_cnt;
+		c.last_coreclk_cnt = s->last_coreclk_cnt;
+
+		if (s->last_ns &&
+		    now - s->last_ns < SAMPLE_WINDOW_MAX_MS * NSEC_PER_MSEC) {
+			WRITE_ONCE(s->khz, tegra_cpu_ctr_to_khz(&c));
+			WRITE_ONCE(s->khz_ns, now);
+
+			if (s->bus_ev) {
+				/* bytes * 10^6 / ns = KB/s */
+				kbps[s->cl] += div64_u64((periods -
+							  s->last_bus_periods) *
+							 BUS_EV_PERIOD *
+							 BUS_ACCESS_BYTES *
+							 (NSEC_PER_SEC / 1000),
+							 now - s->last_ns);
+				valid[s->cl] = true;
+			}
+		}
+
+		s->last_refclk_cnt = c.refclk_cnt;
+		s->last_coreclk_cnt = c.coreclk_cnt;
+		s->last_ns = now;
+		s->last_bus_periods = periods;
+	}
+
+	if (bus_counters)
+		tegra234_set_emc_demand(kbps, valid);
+
+	queue_delayed_work(system_unbound_wq, &sample_work,
+			   msecs_to_jiffies(sample_ms));
+}
+
 /*
  * Return instantaneous cpu speed
  * Instantaneous freq is calculated as -
@@ -161,10 +357,6 @@ static void tegra_read_counters(struct work_struct *work)
 static unsigned int tegra234_get_speed_common(u32 cpu, u32 delay)
 {
 	struct read_counters_work read_counters_work;
-	struct tegra_cpu_ctr c;
-	u32 delta_refcnt;
-	u32 delta_ccnt;
-	u32 rate_mhz;
 
 	/*
 	 * udelay() is required to reconstruct cpu frequency over an
@@ -177,31 +369,26 @@ static unsigned int tegra234_get_speed_common(u32 cpu, u32 delay)
 	INIT_WORK_ONSTACK(&read_counters_work.work, tegra_read_counters);
 	queue_work_on(cpu, read_counters_wq, &read_counters_work.work);
 	flush_work(&read_counters_work.work);
-	c = read_counters_work.c;
-
-	if (c.coreclk_cnt < c.last_coreclk_cnt)
-		delta_ccnt = c.coreclk_cnt + (MAX_CNT - c.last_coreclk_cnt);
-	else
-		delta_ccnt = c.coreclk_cnt - c.last_coreclk_cnt;
-	if (!delta_ccnt)
-		return 0;
 
-	/* ref clock is 32 bits */
-	if (c.refclk_cnt < c.last_refclk_cnt)
-		delta_refcnt = c.refclk_cnt + (MAX_CNT - c.last_refclk_cnt);
-	else
-		delta_refcnt = c.refclk_cnt - c.last_refclk_cnt;
-	if (!delta_refcnt) {
-		pr_debug("cpufreq: %d is idle, delta_refcnt: 0\n", cpu);
-		return 0;
-	}
-	rate_mhz = ((unsigned long)(delta_ccnt * REF_CLK_MHZ)) / delta_refcnt;
-
-	return (rate_mhz * KHZ); /* in KHz */
+	return tegra_cpu_ctr_to_khz(&read_counters_work.c);
 }
 
+/*
+ * Return the freq cached by the background sampler, sample on the cpu
+ * only if the sampler is off or has no recent sample of the cpu.
+ */
 static unsigned int tegra234_get_speed(u32 cpu)
 {
+	struct tegra_cpu_sample *s = per_cpu_ptr(&cpu_samples, cpu);
+	u64 khz_ns;
+
+	if (sample_ms) {
+		khz_ns = READ_ONCE(s->khz_ns);
+		if (khz_ns && ktime_get_ns() - khz_ns <
+		    2ULL * sample_ms * NSEC_PER_MSEC)
+			return READ_ONCE(s->khz);
+	}
+
 	return tegra234_get_speed_common(cpu, US_DELAY);
 }
 
@@ -234,53 +421,204 @@ static int tegra234_cpufreq_init(struct cpufreq_policy *policy)
 	return 0;
 }
 
+/*
+ * MPIDR is taken from the logical map, so no IPI is sent to the cpu and
+ * cores offline in this cell (given to a Jailhouse cell) can be set too.
+ */
 static void set_cpu_ndiv(int cpu, void __iomem *freq_base, unsigned int ndiv)
 {
-	struct mpidr id;
+	u64 mpidr = cpu_logical_map(cpu);
 	void __iomem *scratch_freq_core_reg;
 	uint32_t mpidr_id;
 
-	smp_call_function_single(cpu, get_mpidr_id, &id, true);
-	mpidr_id = (id.cl * MAX_CORES_PER_CLUSTER) + id.cpu;
+	mpidr_id = (MPIDR_AFFINITY_LEVEL(mpidr, 2) * MAX_CORES_PER_CLUSTER) +
+		   MPIDR_AFFINITY_LEVEL(mpidr, 1);
 	scratch_freq_core_reg = SCRATCH_FREQ_CORE_REG(mpidr_id) + freq_base;
 	writel(ndiv, scratch_freq_core_reg);
 }
 
-/* Set emc clock by referring cpu_to_emc freq mapping */
-static void set_cpufreq_to_emcfreq(enum cluster cl, uint32_t cluster_freq)
+/*
+ * Set the EMC floor of a cluster
+ * The memory traffic measured on the root cpus of the cluster and the
+ * bandwidth reported by its owner cell drive the floor, with headroom.
+ * The cpu_to_emc freq mapping of the cluster freq is the fallback when
+ * neither is known.
+ * Called with arb_lock held.
+ */
+static void tegra234_update_emc(struct tegra234_cpufreq_data *data,
+				enum cluster cl)
 {
-	struct tegra234_cpufreq_data *data = cpufreq_get_driver_data();
+	struct tegra234_cluster_arb *arb = &data->arb[cl];
 	unsigned long emc_freq_khz;
 	unsigned long emc_freq_kbps;
+	uint32_t cluster_freq;
 
 	if (!data->icc_handle[cl] || data->bypass_icc)
 		return;
 
-	emc_freq_khz = tegra_cpu_to_emc_freq(cluster_freq, cpu_emc_map_ptr);
+	if (arb->emc_meas_valid || arb->emc_cell_kbps) {
+		emc_freq_kbps = max(arb->emc_meas_kbps, arb->emc_cell_kbps);
+		emc_freq_kbps += emc_freq_kbps * emc_headroom_pct / 100;
+
+		/* keep BPMP requests down for small traffic changes */
+		if (max(emc_freq_kbps, arb->emc_kbps) -
+		    min(emc_freq_kbps, arb->emc_kbps) <
+		    (arb->emc_kbps >> EMC_BW_HYST_SHIFT))
+			return;
+		pr_debug("cluster %d, emc bw(KB/s): %lu measured: %lu cell: %lu\n",
+			 cl, emc_freq_kbps, arb->emc_meas_kbps,
+			 arb->emc_cell_kbps);
+	} else if (cpu_emc_map_ptr) {
+		cluster_freq = map_ndiv_to_freq(&data->ndiv_limits[cl],
+						arb->cur_ndiv);
+		emc_freq_khz = tegra_cpu_to_emc_freq(cluster_freq,
+						     cpu_emc_map_ptr);
+		emc_freq_kbps = emc_freq_to_bw(emc_freq_khz);
+		pr_debug("cluster %d, emc freq(KHz): %lu cluster_freq(KHz): %u\n",
+			 cl, emc_freq_khz, cluster_freq);
+	} else {
+		return;
+	}
 
-	emc_freq_kbps = emc_freq_to_bw(emc_freq_khz);
+	if (emc_freq_kbps == arb->emc_kbps)
+		return;
 
+	arb->emc_kbps = emc_freq_kbps;
 	icc_set_bw(data->icc_handle[cl], 0, emc_freq_kbps);
-	pr_debug("cluster %d, emc freq(KHz): %lu cluster_freq(KHz): %u\n",
-		 cl, emc_freq_khz, cluster_freq);
 }
 
-static int tegra234_cpufreq_set_target(struct cpufreq_policy *policy,
-				       unsigned int index)
+/* Hand the memory traffic measured by the sampler to the clusters */
+static void tegra234_set_emc_demand(const unsigned long *kbps,
+				    const bool *valid)
 {
-	struct cpufreq_frequency_table *tbl = policy->freq_table + index;
-	void __iomem *freq_base = policy->driver_data + SCRATCH_FREQ_CORE_BASE;
-	unsigned int ndiv = tbl->driver_data;
-	struct mpidr id;
+	struct tegra234_cpufreq_data *data = cpufreq_get_driver_data();
+	enum cluster cl;
+
+	mutex_lock(&arb_lock);
+	LOOP_FOR_EACH_CLUSTER(cl) {
+		if (!data->tables[cl])
+			continue;
+
+		data->arb[cl].emc_meas_valid = valid[cl];
+		data->arb[cl].emc_meas_kbps = kbps[cl];
+		tegra234_update_emc(data, cl);
+	}
+	mutex_unlock(&arb_lock);
+}
+
+static void tegra_bus_ev_overflow(struct perf_event *event,
+				  struct perf_sample_data *sample_data,
+				  struct pt_regs *regs)
+{
+	struct tegra_cpu_sample *s = event->overflow_handler_context;
+
+	WRITE_ONCE(s->bus_periods, s->bus_periods + 1);
+}
+
+/*
+ * Count memory traffic on the online housekeeping cpus
+ * Isolated cpus get no counter, their overflow interrupts would disturb
+ * them. Clusters without counter fall back to cpu_emc_map. The sampler
+ * reads the overflow counts from memory, without IPIs.
+ */
+static void tegra_bus_counters_init(void)
+{
+	struct perf_event_attr attr = {
+		.type = PERF_TYPE_RAW,
+		.size = sizeof(struct perf_event_attr),
+		.config = ARMV8_PMU_BUS_ACCESS,
+		.sample_period = BUS_EV_PERIOD,
+		.pinned = 1,
+	};
+	struct tegra_cpu_sample *s;
+	struct perf_event *ev;
+	int cpu;
+
+	cpus_read_lock();
+	for_each_online_cpu(cpu) {
+		if (!housekeeping_cpu(cpu, HK_FLAG_DOMAIN) ||
+		    !housekeeping_cpu(cpu, HK_FLAG_TICK))
+			continue;
+
+		s = per_cpu_ptr(&cpu_samples, cpu);
+		ev = perf_event_create_kernel_counter(&attr, cpu, NULL,
+						      tegra_bus_ev_overflow, s);
+		if (IS_ERR(ev)) {
+			pr_debug("cpufreq: no BUS_ACCESS counter on cpu %d: %ld\n",
+				 cpu, PTR_ERR(ev));
+			continue;
+		}
+
+		s->bus_ev = ev;
+		bus_counters = true;
+	}
+	cpus_read_unlock();
+}
+
+static void tegra_bus_counters_exit(void)
+{
+	struct tegra_cpu_sample *s;
 	int cpu;
 
-	for_each_cpu_and(cpu, policy->cpus, cpu_online_mask)
-		set_cpu_ndiv(cpu, freq_base, ndiv);
+	for_each_possible_cpu(cpu) {
+		s = per_cpu_ptr(&cpu_samples, cpu);
+		if (!s->bus_ev)
+			continue;
 
-	if (cpu_emc_map_ptr) {
-		smp_call_function_single(policy->cpu, get_mpidr_id, &id, true);
-		set_cpufreq_to_emcfreq(id.cl, tbl->frequency);
+		perf_event_release_kernel(s->bus_ev);
+		s->bus_ev = NULL;
 	}
+	bus_counters = false;
+}
+
+/*
+ * Program the NDIV resulting from the requests of a cluster
+ * Only the online cpus of a cluster without owner cell are written, as
+ * the root governor drives them alone. All cores of an owned cluster are
+ * written, including the ones running the cell.
+ * Called with arb_lock held.
+ */
+static void tegra234_apply_cluster_ndiv(struct tegra234_cpufreq_data *data,
+					enum cluster cl)
+{
+	struct tegra234_cluster_arb *arb = &data->arb[cl];
+	void __iomem *freq_base = data->regs + SCRATCH_FREQ_CORE_BASE;
+	unsigned int ndiv;
+	int cpu;
+
+	if (arb->pin_ndiv) {
+		ndiv = arb->pin_ndiv;
+	} else if (arb->owner &&
+		   !cpumask_intersects(&data->cl_cpu_mask[cl], cpu_online_mask)) {
+		/* no governor of this cell runs on the cluster */
+		ndiv = arb->floor_ndiv ? arb->floor_ndiv : arb->root_ndiv;
+	} else {
+		ndiv = max(arb->root_ndiv, arb->floor_ndiv);
+	}
+
+	if (arb->owner) {
+		for_each_cpu(cpu, &data->cl_cpu_mask[cl])
+			set_cpu_ndiv(cpu, freq_base, ndiv);
+	} else {
+		for_each_cpu_and(cpu, &data->cl_cpu_mask[cl], cpu_online_mask)
+			set_cpu_ndiv(cpu, freq_base, ndiv);
+	}
+	arb->cur_ndiv = ndiv;
+
+	tegra234_update_emc(data, cl);
+}
+
+static int tegra234_cpufreq_set_target(struct cpufreq_policy *policy,
+				       unsigned int index)
+{
+	struct tegra234_cpufreq_data *data = cpufreq_get_driver_data();
+	struct cpufreq_frequency_table *tbl = policy->freq_table + index;
+	enum cluster cl = MPIDR_AFFINITY_LEVEL(cpu_logical_map(policy->cpu), 2);
+
+	mutex_lock(&arb_lock);
+	data->arb[cl].root_ndiv = tbl->driver_data;
+	tegra234_apply_cluster_ndiv(data, cl);
+	mutex_unlock(&arb_lock);
 
 	return 0;
 }
@@ -301,6 +639,8 @@ static void tegra234_cpufreq_free_resources(void)
 	struct tegra234_cpufreq_data *data = cpufreq_get_driver_data();
 	enum cluster cl;
 
+	cancel_delayed_work_sync(&sample_work);
+	tegra_bus_counters_exit();
 	destroy_workqueue(read_counters_wq);
 
 	LOOP_FOR_EACH_CLUSTER(cl) {
@@ -383,6 +723,252 @@ init_freq_table(struct platform_device *pdev, struct tegra_bpmp *bpmp,
 	return freq_table;
 }
 
+static u32 rate_to_ndiv(struct cpufreq_frequency_table *table, u32 rate_khz)
+{
+	struct cpufreq_frequency_table *pos;
+	u32 ndiv = 0;
+
+	/* lowest table freq not below the rate, the highest otherwise */
+	cpufreq_for_each_valid_entry(pos, table) {
+		ndiv = pos->driver_data;
+		if (pos->frequency >= rate_khz)
+			break;
+	}
+
+	return ndiv;
+}
+
+static void tegra234_cell_handle_msg(struct tegra234_cpufreq_cell *cell,
+				     struct tegra234_cell_msg *msg)
+{
+	struct tegra234_cpufreq_data *data = cpufreq_get_driver_data();
+	struct tegra234_cluster_arb *arb;
+	enum cluster cl = msg->cl;
+
+	if (cl >= data->num_clusters || !test_bit(cl, &cell->clusters)) {
+		dev_dbg(cell->dev, "request for cluster %u not owned\n",
+			msg->cl);
+		msg->status = -EPERM;
+		msg->rate_khz = 0;
+		return;
+	}
+
+	mutex_lock(&arb_lock);
+	arb = &data->arb[cl];
+	msg->status = 0;
+
+	switch (msg->msg_id) {
+	case CELL_MSG_SET_FLOOR:
+		arb->floor_ndiv = msg->rate_khz ?
+			rate_to_ndiv(data->tables[cl], msg->rate_khz) : 0;
+		break;
+	case CELL_MSG_PIN:
+		arb->pin_ndiv = rate_to_ndiv(data->tables[cl], msg->rate_khz);
+		break;
+	case CELL_MSG_RELEASE:
+		arb->floor_ndiv = 0;
+		arb->pin_ndiv = 0;
+		arb->emc_cell_kbps = 0;
+		break;
+	case CELL_MSG_SET_MEM_BW:
+		arb->emc_cell_kbps = msg->rate_khz;
+		tegra234_update_emc(data, cl);
+		break;
+	case CELL_MSG_GET_RATE:
+		break;
+	default:
+		msg->status = -EINVAL;
+		break;
+	}
+
+	if (!msg->status && msg->msg_id != CELL_MSG_GET_RATE &&
+	    msg->msg_id != CELL_MSG_SET_MEM_BW)
+		tegra234_apply_cluster_ndiv(data, cl);
+
+	msg->rate_khz = map_ndiv_to_freq(&data->ndiv_limits[cl], arb->cur_ndiv);
+	mutex_unlock(&arb_lock);
+}
+
+static void tegra234_cell_rx_work(struct work_struct *work)
+{
+	struct tegra234_cpufreq_cell *cell =
+		container_of(work, struct tegra234_cpufreq_cell, rx_work);
+	struct tegra234_cell_msg msg;
+
+	/* wait for the channel reset handshake with the cell */
+	if (tegra_hv_ivc_channel_notified(cell->ivck) != 0)
+		return;
+
+	while (tegra_hv_ivc_can_read(cell->ivck)) {
+		if (tegra_hv_ivc_read(cell->ivck, &msg, sizeof(msg)) !=
+		    sizeof(msg)) {
+			dev_err(cell->dev, "ivc read failed\n");
+			break;
+		}
+
+		tegra234_cell_handle_msg(cell, &msg);
+
+		if (!tegra_hv_ivc_can_write(cell->ivck)) {
+			dev_warn_ratelimited(cell->dev,
+					     "ivc queue full, reply dropped\n");
+			continue;
+		}
+		tegra_hv_ivc_write(cell->ivck, &msg, sizeof(msg));
+	}
+}
+
+static irqreturn_t tegra234_cell_ivc_isr(int irq, void *dev_id)
+{
+	struct tegra234_cpufreq_cell *cell = dev_id;
+
+	/* keep the request handling off the cpus given to cells */
+	queue_work(system_unbound_wq, &cell->rx_work);
+
+	return IRQ_HANDLED;
+}
+
+static int tegra234_cpufreq_cell_probe(struct platform_device *pdev)
+{
+	struct tegra234_cpufreq_data *data = cpufreq_get_driver_data();
+	struct device_node *dn = pdev->dev.of_node;
+	struct tegra234_cpufreq_cell *cell;
+	struct device_node *hv_dn;
+	u32 clusters[MAX_CLUSTERS];
+	u32 queue;
+	int n, i, cl, err;
+
+	if (!data)
+		return -EPROBE_DEFER;
+
+	cell = devm_kzalloc(&pdev->dev, sizeof(*cell), GFP_KERNEL);
+	if (!cell)
+		return -ENOMEM;
+
+	cell->dev = &pdev->dev;
+	INIT_WORK(&cell->rx_work, tegra234_cell_rx_work);
+
+	n = of_property_count_u32_elems(dn, "nvidia,clusters");
+	if (n <= 0 || n > MAX_CLUSTERS)
+		return -EINVAL;
+
+	err = of_property_read_u32_array(dn, "nvidia,clusters", clusters, n);
+	if (err)
+		return err;
+
+	for (i = 0; i < n; i++) {
+		if (clusters[i] >= data->num_clusters ||
+		    !data->tables[clusters[i]]) {
+			dev_err(&pdev->dev, "invalid cluster %u\n",
+				clusters[i]);
+			return -EINVAL;
+		}
+		set_bit(clusters[i], &cell->clusters);
+	}
+
+	hv_dn = of_parse_phandle(dn, "ivc_queue", 0);
+	if (!hv_dn) {
+		dev_err(&pdev->dev, "failed to parse phandle of ivc prop\n");
+		return -EINVAL;
+	}
+
+	err = of_property_read_u32_index(dn, "ivc_queue", 1, &queue);
+	if (err) {
+		dev_err(&pdev->dev, "failed to read IVC property ID\n");
+		of_node_put(hv_dn);
+		return -EINVAL;
+	}
+
+	/* -EPROBE_DEFER until the ivshmem backend provides the queues */
+	cell->ivck = tegra_hv_ivc_reserve(hv_dn, queue, NULL);
+	of_node_put(hv_dn);
+	if (IS_ERR_OR_NULL(cell->ivck))
+		return cell->ivck ? PTR_ERR(cell->ivck) : -EINVAL;
+
+	if (cell->ivck->frame_size < sizeof(struct tegra234_cell_msg)) {
+		dev_err(&pdev->dev, "ivc frame size %d too small\n",
+			cell->ivck->frame_size);
+		err = -EINVAL;
+		goto err_unreserve;
+	}
+
+	mutex_lock(&arb_lock);
+	for_each_set_bit(cl, &cell->clusters, MAX_CLUSTERS) {
+		if (data->arb[cl].owner) {
+			mutex_unlock(&arb_lock);
+			dev_err(&pdev->dev, "cluster %d owned by another cell\n",
+				cl);
+			err = -EBUSY;
+			goto err_unreserve;
+		}
+	}
+	for_each_set_bit(cl, &cell->clusters, MAX_CLUSTERS)
+		data->arb[cl].owner = cell;
+	mutex_unlock(&arb_lock);
+
+	platform_set_drvdata(pdev, cell);
+
+	err = request_irq(cell->ivck->irq, tegra234_cell_ivc_isr, 0,
+			  dev_name(&pdev->dev), cell);
+	if (err)
+		goto err_release;
+
+	/* set ivc channel to invalid state */
+	tegra_hv_ivc_channel_reset(cell->ivck);
+
+	dev_info(&pdev->dev, "cell owns clusters %*pbl\n", MAX_CLUSTERS,
+		 &cell->clusters);
+
+	return 0;
+
+err_release:
+	mutex_lock(&arb_lock);
+	for_each_set_bit(cl, &cell->clusters, MAX_CLUSTERS)
+		data->arb[cl].owner = NULL;
+	mutex_unlock(&arb_lock);
+err_unreserve:
+	tegra_hv_ivc_unreserve(cell->ivck);
+	return err;
+}
+
+static int tegra234_cpufreq_cell_remove(struct platform_device *pdev)
+{
+	struct tegra234_cpufreq_cell *cell = platform_get_drvdata(pdev);
+	struct tegra234_cpufreq_data *data = cpufreq_get_driver_data();
+	int cl;
+
+	free_irq(cell->ivck->irq, cell);
+	cancel_work_sync(&cell->rx_work);
+
+	/* hand the clusters back to the root governor */
+	mutex_lock(&arb_lock);
+	for_each_set_bit(cl, &cell->clusters, MAX_CLUSTERS) {
+		data->arb[cl].owner = NULL;
+		data->arb[cl].floor_ndiv = 0;
+		data->arb[cl].pin_ndiv = 0;
+		data->arb[cl].emc_cell_kbps = 0;
+		tegra234_apply_cluster_ndiv(data, cl);
+	}
+	mutex_unlock(&arb_lock);
+
+	tegra_hv_ivc_unreserve(cell->ivck);
+
+	return 0;
+}
+
+static const struct of_device_id tegra234_cpufreq_cell_of_match[] = {
+	{ .compatible = "nvidia,t234-cpufreq-cell", },
+	{ /* sentinel */ }
+};
+
+static struct platform_driver tegra234_cpufreq_cell_driver = {
+	.driver = {
+		.name = "tegra234-cpufreq-cell",
+		.of_match_table = tegra234_cpufreq_cell_of_match,
+	},
+	.probe = tegra234_cpufreq_cell_probe,
+	.remove = tegra234_cpufreq_cell_remove,
+};
+
 #ifdef CONFIG_DEBUG_FS
 static struct dentry *tegra_cpufreq_debugfs_root;
 
@@ -414,7 +1000,7 @@ static int tegra234_cpufreq_probe(struct platform_device *pdev)
 	struct tegra_bpmp *bpmp;
 	struct resource *res;
 	struct device_node *dn;
-	int err, i, cpu, cl;
+	int err, i, cpu, cl, core;
 	const int icc_id_array[MAX_CLUSTERS] = {
 		TEGRA_ICC_CPU_CLUSTER0,
 		TEGRA_ICC_CPU_CLUSTER1,
@@ -465,6 +1051,13 @@ static int tegra234_cpufreq_probe(struct platform_device *pdev)
 		goto err_free_map_ptr;
 	}
 
+	data->arb = devm_kcalloc(&pdev->dev, data->num_clusters,
+				 sizeof(*data->arb), GFP_KERNEL);
+	if (!data->arb) {
+		err = -ENOMEM;
+		goto err_free_map_ptr;
+	}
+
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	data->regs = devm_ioremap_resource(&pdev->dev, res);
 	if (IS_ERR(data->regs)) {
@@ -474,12 +1067,32 @@ static int tegra234_cpufreq_probe(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, data);
 
-	/* set cluster cpu mask */
+	/* set cluster cpu mask and the ACTMON counters of each cpu */
 	for_each_possible_cpu(cpu) {
 		cl = MPIDR_AFFINITY_LEVEL(cpu_logical_map(cpu), 2);
 		cpumask_set_cpu(cpu, &(data->cl_cpu_mask[cl]));
+		core = MPIDR_AFFINITY_LEVEL(cpu_logical_map(cpu), 1);
+		per_cpu(cpu_samples, cpu).cl = cl;
+		per_cpu(cpu_samples, cpu).actmon_reg = data->regs +
+			CLUSTER_ACTMON_BASE(cl) + CORE_ACTMON_REG(core);
 	}
 
+	/* boot NDIV of each cluster until a governor or a cell changes it */
+	LOOP_FOR_EACH_CLUSTER(cl) {
+		cpu = cpumask_first(&data->cl_cpu_mask[cl]);
+		if (cpu >= nr_cpu_ids)
+			continue;
+		core = (cl * MAX_CORES_PER_CLUSTER) +
+		       MPIDR_AFFINITY_LEVEL(cpu_logical_map(cpu), 1);
+		data->arb[cl].root_ndiv = readl(data->regs +
+						SCRATCH_FREQ_CORE_BASE +
+						SCRATCH_FREQ_CORE_REG(core)) &
+					  NDIV_MASK;
+		data->arb[cl].cur_ndiv = data->arb[cl].root_ndiv;
+	}
+
+	sample_ms = min(sample_ms, (unsigned int)MAX_SAMPLE_MS);
+
 	read_counters_wq = alloc_workqueue("read_counters_wq", __WQ_LEGACY, 1);
 	if (!read_counters_wq) {
 		dev_err(&pdev->dev, "fail to create_workqueue\n");
@@ -514,8 +1127,18 @@ static int tegra234_cpufreq_probe(struct platform_device *pdev)
 	tegra234_cpufreq_driver.driver_data = data;
 
 	err = cpufreq_register_driver(&tegra234_cpufreq_driver);
-	if (!err)
+	if (!err) {
+		if (sample_ms) {
+			if (emc_demand)
+				tegra_bus_counters_init();
+			queue_delayed_work(system_unbound_wq, &sample_work, 0);
+		}
+		/* cells get their queues once Jailhouse is enabled */
+		if (of_platform_populate(dn, tegra234_cpufreq_cell_of_match,
+					 NULL, &pdev->dev))
+			dev_warn(&pdev->dev, "failed to add cell nodes\n");
 		goto put_bpmp;
+	}
 
 err_free_res:
 	tegra234_cpufreq_free_resources();
@@ -529,6 +1152,7 @@ put_bpmp:
 
 static int tegra234_cpufreq_remove(struct platform_device *pdev)
 {
+	of_platform_depopulate(&pdev->dev);
 #ifdef CONFIG_DEBUG_FS
 	tegra_cpufreq_debug_exit();
 #endif
@@ -575,7 +1199,25 @@ static struct platform_driver tegra234_ccplex_driver = {
 	.probe = tegra234_cpufreq_probe,
 	.remove = tegra234_cpufreq_remove,
 };
-module_platform_driver(tegra234_ccplex_driver);
+
+static struct platform_driver * const tegra234_cpufreq_drivers[] = {
+	&tegra234_ccplex_driver,
+	&tegra234_cpufreq_cell_driver,
+};
+
+static int __init tegra234_cpufreq_module_init(void)
+{
+	return platform_register_drivers(tegra234_cpufreq_drivers,
+					 ARRAY_SIZE(tegra234_cpufreq_drivers));
+}
+module_init(tegra234_cpufreq_module_init);
+
+static void __exit tegra234_cpufreq_module_exit(void)
+{
+	platform_unregister_drivers(tegra234_cpufreq_drivers,
+				    ARRAY_SIZE(tegra234_cpufreq_drivers));
+}
+module_exit(tegra234_cpufreq_module_exit);
 
 MODULE_AUTHOR("Sanjay Chandrashekara <sanjayc@nvidia.com>");
 MODULE_DESCRIPTION("NVIDIA Tegra234 cpufreq driver");
@@ -14,15 +14,23 @@
 
 #define pr_fmt(fmt)	"nvscic2c-pcie: iova-mgr: " fmt
 
+#include <linux/bitops.h>
 #include <linux/errno.h>
 #include <linux/mutex.h>
 #include <linux/printk.h>
+#include <linux/rbtree.h>
 #include <linux/slab.h>
 #include <linux/types.h>
 
 #include "common.h"
 #include "iova-mngr.h"
 
+/*
+ * Free blocks are kept in power-of-two size classes: class n holds the
+ * free blocks of size [2^n, 2^(n+1)).
+ */
+#define IOVA_SIZE_CLASSES	(BITS_PER_LONG)
+
 /*
  * INTERNAL DataStructure that define a single IOVA block/chunk
  * in a pool of IOVA region managed by IOVA manager.
@@ -30,12 +38,15 @@
  * IOVA manager chunks entire IOVA space into these blocks/chunks.
  *
  * The chunk/block is also a node for linking to previous and next
- * nodes of a circular doubly linked list - free or reserved.
+ * nodes of a circular doubly linked list - free size class or reserved.
  */
 struct block_t {
 	/* for management of this chunk in either avail or reserve lists.*/
 	struct list_head node;
 
+	/* free blocks only: node in the address ordered free tree.*/
+	struct rb_node rb;
+
 	/* block address.*/
 	u64 address;
 
@@ -47,10 +58,14 @@ struct block_t {
  * INTERNAL datastructure for IOVA space manager.
  *
  * IOVA space manager would fragment and manage the IOVA region
- * using two circular doubly linked lists - reserved list and
- * free list. These lists contain blocks/chunks reserved
- * or free for use by clients (callers) from the overall
- * IOVA region the IOVA manager was configured with.
+ * using a circular doubly linked reserved list and, for the free
+ * blocks, one list per size class plus a tree ordered by address. These
+ * contain blocks/chunks reserved or free for use by clients (callers)
+ * from the overall IOVA region the IOVA manager was configured with.
+ *
+ * Reserve looks in the size class of the request first, then takes the
+ * head of the next non-empty larger class. Release finds its neighbours
+ * in the free tree for coalescing. Neither walks all the free blocks.
  */
 struct mngr_ctx_t {
 	/*
@@ -61,12 +76,22 @@ struct mngr_ctx_t {
 	char name[NAME_MAX];
 
 	/*
-	 * Circular doubly linked list of blocks indicating
-	 * available/free IOVA space(s). When IOVA manager is
-	 * initialised all of the IOVA space is marked as available
-	 * to begin with.
+	 * Circular doubly linked lists of blocks indicating
+	 * available/free IOVA space(s), one per size class, with
+	 * free_class_map having bit n set when class n is non-empty.
+	 * When IOVA manager is initialised all of the IOVA space is
+	 * marked as available to begin with.
 	 */
-	struct list_head *free_list;
+	struct list_head free_classes[IOVA_SIZE_CLASSES];
+	unsigned long free_class_map;
+
+	/* the same free blocks, ordered by address for coalescing.*/
+	struct rb_root free_tree;
+
+	/* fragmentation statistics.*/
+	size_t free_size;
+	u32 nr_free_blocks;
+	u32 nr_reserved_blocks;
 
 	/*
 	 * Book-keeping of the user IOVA blocks in a circular double
@@ -81,6 +106,84 @@ struct mngr_ctx_t {
 	u64 base_address;
 };
 
+static inline u32
+size_class(size_t size)
+{
+	return fls64(size) - 1;
+}
+
+/* add a block to the free tree and to its size class.*/
+static void
+free_block_insert(struct mngr_ctx_t *ctx, struct block_t *block)
+{
+	struct rb_node **link = &ctx->free_tree.rb_node, *parent = NULL;
+	struct block_t *curr = NULL;
+	u32 class = size_class(block->size);
+
+	while (*link) {
+		parent = *link;
+		curr = rb_entry(parent, struct block_t, rb);
+		if (block->address < curr->address)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&block->rb, parent, link);
+	rb_insert_color(&block->rb, &ctx->free_tree);
+
+	list_add_tail(&block->node, &ctx->free_classes[class]);
+	__set_bit(class, &ctx->free_class_map);
+
+	ctx->free_size += block->size;
+	ctx->nr_free_blocks++;
+}
+
+/* remove a block from the free tree and from its size class.*/
+static void
+free_block_remove(struct mngr_ctx_t *ctx, struct block_t *block)
+{
+	u32 class = size_class(block->size);
+
+	rb_erase(&block->rb, &ctx->free_tree);
+	RB_CLEAR_NODE(&block->rb);
+
+	list_del_init(&block->node);
+	if (list_empty(&ctx->free_classes[class]))
+		__clear_bit(class, &ctx->free_class_map);
+
+	ctx->free_size -= block->size;
+	ctx->nr_free_blocks--;
+}
+
+/* find a free block of at least size bytes, NULL when none.*/
+static struct block_t *
+free_block_find(struct mngr_ctx_t *ctx, size_t size)
+{
+	struct block_t *curr = NULL, *best = NULL;
+	u32 class = size_class(size);
+
+	/* the size class of the request: best fit of the blocks large enough.*/
+	list_for_each_entry(curr, &ctx->free_classes[class], node) {
+		if (curr->size >= size) {
+			if (!best)
+				best = curr;
+			else if (curr->size < best->size)
+				best = curr;
+		}
+	}
+	if (best)
+		return best;
+
+	/* any block of a larger class is large enough.*/
+	class = find_next_bit(&ctx->free_class_map, IOVA_SIZE_CLASSES,
+			      class + 1);
+	if (class >= IOVA_SIZE_CLASSES)
+		return NULL;
+
+	return list_first_entry(&ctx->free_classes[class], struct block_t,
+				node);
+}
+
 /*
  * Reserves a block from the free IOVA regions. Once reserved, the block
  * is marked reserved and appended in the reserved list (no ordering
@@ -92,7 +195,7 @@ iova_mngr_block_reserve(void *mngr_handle, size_t size,
 			void **block_handle)
 {
 	struct mngr_ctx_t *ctx = (struct mngr_ctx_t *)(mngr_handle);
-	struct block_t *reserve = NULL, *curr = NULL, *best = NULL;
+	struct block_t *reserve = NULL, *best = NULL;
 	int ret = 0;
 
 	if (WARN_ON(!ctx || *block_handle || !size))
@@ -101,22 +204,15 @@ iova_mngr_block_reserve(void *mngr_handle, size_t size,
 	mutex_lock(&ctx->lock);
 
 	/* if there are no free blocks to reserve. */
-	if (list_empty(ctx->free_list)) {
+	if (!ctx->nr_free_blocks) {
 		ret = -ENOMEM;
 		pr_err("(%s): No memory available to reserve block of size:(%lu)\n",
 		       ctx->name, size);
 		goto err;
 	}
 
-	/* find the best of all free bocks to reserve.*/
-	list_for_each_entry(curr, ctx->free_list, node) {
-		if (curr->size >= size) {
-			if (!best)
-				best = curr;
-			else if (curr->size < best->size)
-				best = curr;
-		}
-	}
+	/* find the best of the free bocks to reserve.*/
+	best = free_block_find(ctx, size);
 
 	/* if there isn't any free block of requested size. */
 	if (!best) {
@@ -129,7 +225,7 @@ iova_mngr_block_reserve(void *mngr_handle, size_t size,
 
 		/* perfect fit.*/
 		if (best->size == size) {
-			list_del(&best->node);
+			free_block_remove(ctx, best);
 			list_add_tail(&best->node, ctx->reserved_list);
 			found = best;
 		} else {
@@ -141,11 +237,14 @@ iova_mngr_block_reserve(void *mngr_handle, size_t size,
 			}
 			reserve->address = best->address;
 			reserve->size = size;
+			free_block_remove(ctx, best);
 			best->address += size;
 			best->size -= size;
+			free_block_insert(ctx, best);
 			list_add_tail(&reserve->node, ctx->reserved_list);
 			found = reserve;
 		}
+		ctx->nr_reserved_blocks++;
 		*block_handle = (void *)(found);
 
 		if (address)
@@ -167,8 +266,8 @@ iova_mngr_block_release(void *mngr_handle, void **block_handle)
 {
 	struct mngr_ctx_t *ctx = (struct mngr_ctx_t *)(mngr_handle);
 	struct block_t *release = (struct block_t *)(*block_handle);
-	struct block_t *curr = NULL, *prev = NULL;
-	bool done = false;
+	struct block_t *curr = NULL, *prev = NULL, *next = NULL;
+	struct rb_node *rb = NULL;
 	int ret = 0;
 
 	if (!ctx || !release)
@@ -176,83 +275,82 @@ iova_mngr_block_release(void *mngr_handle, void **block_handle)
 
 	mutex_lock(&ctx->lock);
 
-	list_for_each_entry(curr, ctx->free_list, node) {
+	list_del_init(&release->node);
+	ctx->nr_reserved_blocks--;
+
+	/* immediate free neighbours of the block released, by address.*/
+	rb = ctx->free_tree.rb_node;
+	while (rb) {
+		curr = rb_entry(rb, struct block_t, rb);
 		if (release->address < curr->address) {
-			/* if the immediate next node is available for merge.*/
-			if (curr->address == release->address + release->size) {
-				curr->address = release->address;
-				curr->size += release->size;
-				list_del(&release->node);
-				kfree(release);
-				/*
-				 * if the immediate previous node is also
-				 * available for merge.
-				 */
-				if ((prev) &&
-				    ((prev->address + prev->size)
-				      == curr->address)) {
-					prev->size += curr->size;
-					list_del(&curr->node);
-					kfree(curr);
-				}
-			} else if ((prev) &&
-				   ((prev->address + prev->size)
-				    == release->address)) {
-				/*
-				 * if only the immediate prev node is available
-				 */
-				prev->size += release->size;
-				list_del(&release->node);
-				kfree(release);
-			} else {
-				/*
-				 * cannot be merged with either the immediate
-				 * prev or the immediate next node. Add it in the
-				 * free list before the current node.
-				 */
-				list_del(&release->node);
-				list_add_tail(&release->node, &curr->node);
-			}
-			done = true;
-			break;
+			next = curr;
+			rb = rb->rb_left;
+		} else {
+			prev = curr;
+			rb = rb->rb_right;
 		}
-		prev = curr;
 	}
 
-	/*
-	 * Even if after traversing each entry in list, we could not
-	 * add the block to be released back in free list, because:
-	 */
-	if (!done) {
-		if (!list_empty(ctx->free_list)) {
-			/*
-			 * The block to be freed has the highest order
-			 * address of all the existing blocks in free list.
-			 */
-			struct block_t *last =
-			list_last_entry(ctx->free_list, struct block_t, node);
-			if ((last->address + last->size) == release->address) {
-				/* can be merged with last node of list.*/
-				last->size += release->size;
-				list_del(&release->node);
-				kfree(release);
-			} else {
-				/* cannot be merged, add as the last node.*/
-				list_del(&release->node);
-				list_add_tail(&release->node, ctx->free_list);
-			}
-		} else {
-			/* free list was empty.*/
-			list_del(&release->node);
-			list_add_tail(&release->node, ctx->free_list);
-		}
+	/* if the immediate previous node is available for merge.*/
+	if ((prev) && ((prev->address + prev->size) == release->address)) {
+		free_block_remove(ctx, prev);
+		prev->size += release->size;
+		kfree(release);
+		release = prev;
 	}
+
+	/* if the immediate next node is (also) available for merge.*/
+	if ((next) && ((release->address + release->size) == next->address)) {
+		free_block_remove(ctx, next);
+		release->size += next->size;
+		kfree(next);
+	}
+
+	free_block_insert(ctx, release);
 	*block_handle = NULL;
 
 	mutex_unlock(&ctx->lock);
 	return ret;
 }
 
+static size_t
+largest_free_block(struct mngr_ctx_t *ctx)
+{
+	struct block_t *block = NULL;
+	size_t largest = 0;
+	u32 class = 0;
+
+	if (!ctx->free_class_map)
+		return 0;
+
+	class = __fls(ctx->free_class_map);
+	list_for_each_entry(block, &ctx->free_classes[class], node)
+		largest = max(largest, block->size);
+
+	return largest;
+}
+
+/*
+ * Snapshot of the free space fragmentation of the IOVA space manager.
+ */
+int
+iova_mngr_get_stats(void *mngr_handle, struct iova_mngr_stats *stats)
+{
+	struct mngr_ctx_t *ctx = (struct mngr_ctx_t *)(mngr_handle);
+
+	if (WARN_ON(!ctx || !stats))
+		return -EINVAL;
+
+	mutex_lock(&ctx->lock);
+	stats->free_size = ctx->free_size;
+	stats->largest_free_block = largest_free_block(ctx);
+	stats->nr_free_blocks = ctx->nr_free_blocks;
+	stats->nr_reserved_blocks = ctx->nr_reserved_blocks;
+	mutex_unlock(&ctx->lock);
+
+	return 0;
+}
+
 /*
  * iova_mngr_print
  *
@@ -266,6 +364,7 @@ iova_mngr_print(void *mngr_handle)
 {
 	struct mngr_ctx_t *ctx = (struct mngr_ctx_t *)(mngr_handle);
 	struct block_t *block = NULL;
+	struct rb_node *rb = NULL;
 
 	if (ctx) {
 		mutex_lock(&ctx->lock);
@@ -275,10 +374,14 @@ iova_mngr_print(void *mngr_handle)
 				 ctx->name, &block->address, block->size);
 		}
 		pr_debug("(%s): Free\n", ctx->name);
-		list_for_each_entry(block, ctx->free_list, node) {
+		for (rb = rb_first(&ctx->free_tree); rb; rb = rb_next(rb)) {
+			block = rb_entry(rb, struct block_t, rb);
 			pr_debug("\t\t (%s): address = 0x%pa[p], size = 0x%lx\n",
 				 ctx->name, &block->address, block->size);
 		}
+		pr_debug("(%s): free = 0x%lx in %u blocks, largest = 0x%lx, reserved blocks = %u\n",
+			 ctx->name, ctx->free_size, ctx->nr_free_blocks,
+			 largest_free_block(ctx), ctx->nr_reserved_blocks);
 		mutex_unlock(&ctx->lock);
 	}
 }
@@ -294,6 +397,7 @@ int
 iova_mngr_init(char *name, u64 base_address, size_t size, void **mngr_handle)
 {
 	int ret = 0;
+	u32 i = 0;
 	struct block_t *block = NULL;
 	struct mngr_ctx_t *ctx = NULL;
 
@@ -307,12 +411,6 @@ iova_mngr_init(char *name, u64 base_address, size_t size, void **mngr_handle)
 		goto err;
 	}
 
-	ctx->free_list = kzalloc(sizeof(*ctx->free_list), GFP_KERNEL);
-	if (WARN_ON(!ctx->free_list)) {
-		ret = -ENOMEM;
-		goto err;
-	}
-
 	ctx->reserved_list = kzalloc(sizeof(*ctx->reserved_list), GFP_KERNEL);
 	if (WARN_ON(!ctx->reserved_list)) {
 		ret = -ENOMEM;
@@ -326,7 +424,9 @@ iova_mngr_init(char *name, u64 base_address, size_t size, void **mngr_handle)
 	}
 	strcpy(ctx->name, name);
 	INIT_LIST_HEAD(ctx->reserved_list);
-	INIT_LIST_HEAD(ctx->free_list);
+	for (i = 0; i < IOVA_SIZE_CLASSES; i++)
+		INIT_LIST_HEAD(&ctx->free_classes[i]);
+	ctx->free_tree = RB_ROOT;
 	mutex_init(&ctx->lock);
 	ctx->base_address = base_address;
 
@@ -338,7 +438,7 @@ iova_mngr_init(char *name, u64 base_address, size_t size, void **mngr_handle)
 	}
 	block->address = base_address;
 	block->size = size;
-	list_add(&block->node, ctx->free_list);
+	free_block_insert(ctx, block);
 
 	*mngr_handle = ctx;
 	return ret;
@@ -356,7 +456,7 @@ err:
 void
 iova_mngr_deinit(void **mngr_handle)
 {
-	struct block_t *block = NULL;
+	struct block_t *block = NULL, *tmp = NULL;
 	struct list_head *curr = NULL, *next = NULL;
 	struct mngr_ctx_t *ctx = (struct mngr_ctx_t *)(*mngr_handle);
 
@@ -374,15 +474,12 @@ iova_mngr_deinit(void **mngr_handle)
 		}
 
 		/* ideally, just one whole free block should remain as free.*/
-		list_for_each_safe(curr, next, ctx->free_list) {
-			block = list_entry(curr, struct block_t, node);
-			list_del(&block->node);
+		rbtree_postorder_for_each_entry_safe(block, tmp,
+						     &ctx->free_tree, rb)
 			kfree(block);
-		}
 
 		mutex_destroy(&ctx->lock);
 		kfree(ctx->reserved_list);
-		kfree(ctx->free_list);
 		kfree(ctx);
 		*mngr_handle = NULL;
 	}
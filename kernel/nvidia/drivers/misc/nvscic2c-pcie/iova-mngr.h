@@ -38,6 +38,24 @@ iova_mngr_block_reserve(void *mngr_handle, size_t size,
 int
 iova_mngr_block_release(void *mngr_handle, void **block_handle);
 
+/* free space fragmentation statistics of an IOVA space manager.*/
+struct iova_mngr_stats {
+	/* total free IOVA space, in bytes.*/
+	size_t free_size;
+	/* largest single free block: the largest reserve that can succeed.*/
+	size_t largest_free_block;
+	u32 nr_free_blocks;
+	u32 nr_reserved_blocks;
+};
+
+/*
+ * iova_mngr_get_stats
+ *
+ * Snapshot of the free space fragmentation of the IOVA space manager.
+ */
+int
+iova_mngr_get_stats(void *mngr_handle, struct iova_mngr_stats *stats);
+
 /*
  * iova_mngr_print
  *
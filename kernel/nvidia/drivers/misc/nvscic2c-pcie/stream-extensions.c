@@ -15,18 +15,23 @@
 #define pr_fmt(fmt)	"nvscic2c-pcie: stream-ext: " fmt
 
 #include <linux/anon_inodes.h>
+#include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/errno.h>
 #include <linux/of_platform.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
 #include <linux/of.h>
 #include <linux/nvhost.h>
 #include <linux/nvhost_t194.h>
 #include <linux/platform_device.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/syscalls.h>
 #include <linux/tegra-pcie-edma.h>
+#include <linux/workqueue.h>
 
 #include <uapi/misc/nvscic2c-pcie-ioctl.h>
 
@@ -38,6 +43,21 @@
 #include "stream-extensions.h"
 #include "vmap.h"
 
+/*
+ * submit-copy with at least these many bytes of flush ranges are split
+ * across all the eDMA WR channels. Smaller ones stay on one channel, where
+ * the per-channel setup does not eat into the gain.
+ */
+#define EDMA_STRIPE_MIN_SZ	(SZ_1M)
+
+/*
+ * submit-copy completion latency histogram: bucket 0 is < 1us, bucket n
+ * is [2^(n-1), 2^n) us, the last one open-ended.
+ */
+#define COMPLETION_HIST_BUCKETS	(16)
+/* upper bound for the poll_budget_us debugfs knob.*/
+#define MAX_POLL_BUDGET_US	(1000)
+
 /* forward declaration.*/
 struct stream_ext_ctx_t;
 struct stream_ext_obj;
@@ -98,10 +118,28 @@ struct copy_request {
 	/*
 	 * space for num_edma_desc considering worst-case allocation:
 	 * (max_flush_ranges + max_post_fences), assuming submit-copy could have
-	 * all the post-fences for remote signalling by eDMA.
+	 * all the post-fences for remote signalling by eDMA. Plus one for each
+	 * flush range split at a stripe boundary: (DMA_WR_CHNL_NUM - 1).
 	 */
 	struct tegra_pcie_edma_desc *edma_desc;
 
+	/*
+	 * the flush-range descriptors are submitted as num_stripes eDMA jobs,
+	 * one per WR channel, stripe i being stripe_nents[i] descriptors
+	 * starting at edma_desc[stripe_start[i]]. With more than one stripe,
+	 * the eDMAed remote post-fences (num_fence_desc at fence_desc_start)
+	 * can only be written once all the stripes are done, which
+	 * stripes_pending tracks; fence_work then submits them.
+	 */
+	u64 num_stripes;
+	u64 stripe_start[DMA_WR_CHNL_NUM];
+	u64 stripe_nents[DMA_WR_CHNL_NUM];
+	u64 fence_desc_start;
+	u64 num_fence_desc;
+	atomic_t stripes_pending;
+	edma_xfer_status_t stripe_status;
+	struct work_struct fence_work;
+
 	/*
 	 * actual number of local_post-fences per the submit-copy request.
 	 * Shall include (num_local_post_fences).
@@ -109,6 +147,7 @@ struct copy_request {
 	u64 num_local_post_fences;
 	u64 num_remote_post_fences;
 	u64 num_remote_buf_objs;
+	u64 num_local_buf_objs;
 	/*
 	 * space for num_local_post_fences considering worst-case allocation:
 	 * max_post_fences, assuming submit-copy could have all post-fences for
@@ -127,12 +166,25 @@ struct copy_request {
 	 * transfers.
 	 */
 	struct stream_ext_obj **remote_buf_objs;
+	/*
+	 * space for num_local_buf_objs, the source objects of the flush
+	 * ranges, same worst-case allocation as remote_buf_objs.
+	 */
+	struct stream_ext_obj **local_buf_objs;
 
 	/* X86 uses semaphores for fences and it needs to be written with NvSciStream
 	 * provided value
 	 */
 	u64 *remote_post_fence_values;
 	enum peer_cpu_t peer_cpu;
+
+	/*
+	 * per-context sequence number of this submit-copy, published in
+	 * completed_seq once its post-fences are signalled.
+	 */
+	u64 seq;
+	u64 completed_seq;
+	ktime_t submit_ts;
 };
 
 struct stream_ext_obj {
@@ -210,10 +262,30 @@ struct stream_ext_ctx_t {
 	struct mutex free_lock;
 	atomic_t transfer_count;
 	wait_queue_head_t transfer_waitq;
+
+	/* submit-copy sequence numbers, guarded by the endpoint fops_lock.*/
+	u64 submit_seq;
+
+	/*
+	 * polled completion: when non-zero, submit-copy spins for up to these
+	 * many us for the eDMA completion before returning. 0 (default)
+	 * leaves the completion to the eDMA interrupt alone.
+	 */
+	u32 poll_budget_us;
+	atomic_t poll_hits;
+	atomic_t poll_misses;
+	atomic_t completion_hist[COMPLETION_HIST_BUCKETS];
+	struct dentry *debugfs_dir;
 };
 
+/* debugfs root shared by the stream extensions of all the endpoints.*/
+static struct dentry *debugfs_root;
+static u32 debugfs_root_users;
+static DEFINE_MUTEX(debugfs_root_lock);
+
 static int
-cache_copy_request_handles(struct copy_req_params *params,
+cache_copy_request_handles(struct stream_ext_ctx_t *ctx,
+			   struct copy_req_params *params,
 			   struct copy_request *cr);
 static int
 release_copy_request_handles(struct copy_request *cr);
@@ -225,12 +297,13 @@ static void
 signal_remote_post_fences(struct copy_request *cr);
 
 static int
-prepare_edma_desc(enum drv_mode_t drv_mode, struct copy_req_params *params,
-		  struct tegra_pcie_edma_desc *desc, u64 *num_desc, enum peer_cpu_t);
+prepare_edma_desc(enum drv_mode_t drv_mode, struct copy_request *cr);
 
 static edma_xfer_status_t
-schedule_edma_xfer(void *edma_h, void *priv, u64 num_desc,
-		   struct tegra_pcie_edma_desc *desc);
+schedule_edma_xfer(void *edma_h, void *priv, u32 channel, u64 num_desc,
+		   struct tegra_pcie_edma_desc *desc, edma_complete_t *complete);
+static int
+schedule_edma_stripes(struct copy_request *cr);
 static void
 callback_edma_xfer(void *priv, edma_xfer_status_t status,
 		   struct tegra_pcie_edma_desc *desc);
@@ -238,6 +311,9 @@ static int
 validate_handle(struct stream_ext_ctx_t *ctx, s32 handle,
 		enum nvscic2c_pcie_obj_type type);
 static int
+check_stream_obj(struct stream_ext_ctx_t *ctx, struct file *filep,
+		 enum nvscic2c_pcie_obj_type type);
+static int
 allocate_handle(struct stream_ext_ctx_t *ctx,
 		enum nvscic2c_pcie_obj_type type,
 		void *ioctl_args);
@@ -257,10 +333,6 @@ allocate_copy_req_params(struct stream_ext_ctx_t *ctx,
 static void
 free_copy_req_params(struct copy_req_params *params);
 
-static int
-validate_copy_req_params(struct stream_ext_ctx_t *ctx,
-			 struct copy_req_params *params);
-
 static int
 fops_mmap(struct file *filep, struct vm_area_struct *vma)
 {
@@ -511,12 +583,43 @@ ioctl_map_obj(struct stream_ext_ctx_t *ctx,
 	return ret;
 }
 
+/*
+ * spin for the completion of the submit-copy with sequence number seq for
+ * up to poll_budget_us. The completion itself is still delivered by the
+ * eDMA library; spinning returns to the caller with the local post-fences
+ * already signalled instead of having it block on them. cr is not owned
+ * here and may have been reclaimed, which is fine: completed_seq of a
+ * reclaimed copy request only ever moves forward.
+ */
+static void
+poll_copy_completion(struct stream_ext_ctx_t *ctx, struct copy_request *cr,
+		     u64 seq)
+{
+	u32 budget_us = min_t(u32, READ_ONCE(ctx->poll_budget_us),
+			      MAX_POLL_BUDGET_US);
+	ktime_t deadline;
+
+	if (!budget_us)
+		return;
+
+	deadline = ktime_add_us(ktime_get(), budget_us);
+	while ((s64)(smp_load_acquire(&cr->completed_seq) - seq) < 0) {
+		if (!ktime_before(ktime_get(), deadline) || need_resched()) {
+			atomic_inc(&ctx->poll_misses);
+			return;
+		}
+		cpu_relax();
+	}
+	atomic_inc(&ctx->poll_hits);
+}
+
 /* implement NVSCIC2C_PCIE_IOCTL_SUBMIT_COPY_REQUEST ioctl call. */
 static int
 ioctl_submit_copy_request(struct stream_ext_ctx_t *ctx,
 				struct nvscic2c_pcie_submit_copy_args *args)
 {
 	int ret = 0;
+	u64 seq = 0;
 	struct copy_request *cr = NULL;
 	edma_xfer_status_t edma_status = EDMA_XFER_FAIL_INVAL_INPUTS;
 	enum nvscic2c_pcie_link link = NVSCIC2C_PCIE_LINK_DOWN;
@@ -530,11 +633,6 @@ ioctl_submit_copy_request(struct stream_ext_ctx_t *ctx,
 	if (ret)
 		return ret;
 
-	/* validate the user-supplied handles in flush_range and post-fence.*/
-	ret = validate_copy_req_params(ctx, &ctx->cr_params);
-	if (ret)
-		return ret;
-
 	/* get one copy-request from the free list.*/
 	mutex_lock(&ctx->free_lock);
 	if (list_empty(&ctx->free_list)) {
@@ -556,24 +654,39 @@ ioctl_submit_copy_request(struct stream_ext_ctx_t *ctx,
 	 * reference, thereby, when during in-progress eDMA, free() is received
 	 * for the same set of handles, the handles would be marked for deletion
 	 * but doesn't actually get deleted.
+	 *
+	 * The user-supplied handles are validated while being cached, so each
+	 * of them is looked up once per submit-copy.
 	 */
-	ret = cache_copy_request_handles(&ctx->cr_params, cr);
-	if (ret)
+	ret = cache_copy_request_handles(ctx, &ctx->cr_params, cr);
+	if (ret) {
+		release_copy_request_handles(cr);
 		goto reclaim_cr;
+	}
 
 	cr->peer_cpu = pci_client_get_peer_cpu(ctx->pci_client_h);
 	/* generate eDMA descriptors from flush_ranges, remote_post_fences.*/
-	ret = prepare_edma_desc(ctx->drv_mode, &ctx->cr_params, cr->edma_desc,
-				&cr->num_edma_desc, cr->peer_cpu);
+	ret = prepare_edma_desc(ctx->drv_mode, cr);
 	if (ret) {
 		release_copy_request_handles(cr);
 		goto reclaim_cr;
 	}
 
 	/* schedule asynchronous eDMA.*/
+	seq = ++ctx->submit_seq;
+	cr->seq = seq;
+	cr->submit_ts = ktime_get();
 	atomic_inc(&ctx->transfer_count);
-	edma_status = schedule_edma_xfer(ctx->edma_h, (void *)cr,
-					cr->num_edma_desc, cr->edma_desc);
+	if (cr->num_stripes > 1) {
+		ret = schedule_edma_stripes(cr);
+		if (ret == 0)
+			poll_copy_completion(ctx, cr, seq);
+		return ret;
+	}
+
+	edma_status = schedule_edma_xfer(ctx->edma_h, (void *)cr, 0,
+					cr->num_edma_desc, cr->edma_desc,
+					callback_edma_xfer);
 	if (edma_status != EDMA_XFER_SUCCESS) {
 		ret = -EIO;
 		atomic_dec(&ctx->transfer_count);
@@ -581,6 +694,7 @@ ioctl_submit_copy_request(struct stream_ext_ctx_t *ctx,
 		goto reclaim_cr;
 	}
 
+	poll_copy_completion(ctx, cr, seq);
 	return ret;
 
 reclaim_cr:
@@ -702,6 +816,57 @@ stream_extension_ioctl(void *stream_ext_h, unsigned int cmd, void *args)
 	return ret;
 }
 
+static int
+completion_latency_show(struct seq_file *s, void *data)
+{
+	u32 i = 0;
+	struct stream_ext_ctx_t *ctx = s->private;
+
+	seq_printf(s, "%10s: %d\n", "<1us",
+		   atomic_read(&ctx->completion_hist[0]));
+	for (i = 1; i < COMPLETION_HIST_BUCKETS - 1; i++)
+		seq_printf(s, "%4u-%-5uus: %d\n", 1U << (i - 1), 1U << i,
+			   atomic_read(&ctx->completion_hist[i]));
+	seq_printf(s, ">=%-8uus: %d\n", 1U << (i - 1),
+		   atomic_read(&ctx->completion_hist[i]));
+	seq_printf(s, "poll_hits: %d\npoll_misses: %d\n",
+		   atomic_read(&ctx->poll_hits),
+		   atomic_read(&ctx->poll_misses));
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(completion_latency);
+
+static void
+stream_ext_debugfs_init(struct stream_ext_ctx_t *ctx)
+{
+	mutex_lock(&debugfs_root_lock);
+	if (!debugfs_root)
+		debugfs_root = debugfs_create_dir("nvscic2c-pcie", NULL);
+	debugfs_root_users++;
+	mutex_unlock(&debugfs_root_lock);
+
+	ctx->debugfs_dir = debugfs_create_dir(ctx->ep_name, debugfs_root);
+	debugfs_create_u32("poll_budget_us", 0644, ctx->debugfs_dir,
+			   &ctx->poll_budget_us);
+	debugfs_create_file("completion_latency", 0444, ctx->debugfs_dir,
+			    ctx, &completion_latency_fops);
+}
+
+static void
+stream_ext_debugfs_deinit(struct stream_ext_ctx_t *ctx)
+{
+	debugfs_remove_recursive(ctx->debugfs_dir);
+	ctx->debugfs_dir = NULL;
+
+	mutex_lock(&debugfs_root_lock);
+	if (--debugfs_root_users == 0) {
+		debugfs_remove_recursive(debugfs_root);
+		debugfs_root = NULL;
+	}
+	mutex_unlock(&debugfs_root_lock);
+}
+
 int
 stream_extension_init(struct stream_ext_params *params, void **stream_ext_h)
 {
@@ -731,6 +896,8 @@ stream_extension_init(struct stream_ext_params *params, void **stream_ext_h)
 	atomic_set(&ctx->transfer_count, 0);
 	init_waitqueue_head(&ctx->transfer_waitq);
 
+	stream_ext_debugfs_init(ctx);
+
 	*stream_ext_h = (void *)ctx;
 
 	return 0;
@@ -748,6 +915,8 @@ stream_extension_deinit(void **stream_ext_h)
 	if (!ctx)
 		return;
 
+	stream_ext_debugfs_deinit(ctx);
+
 	/* wait for any on-going eDMA/copy(ies). */
 	ret = wait_event_interruptible_timeout
 			(ctx->transfer_waitq,
@@ -877,8 +1046,8 @@ allocate_handle(struct stream_ext_ctx_t *ctx, enum nvscic2c_pcie_obj_type type,
 }
 
 static edma_xfer_status_t
-schedule_edma_xfer(void *edma_h, void *priv, u64 num_desc,
-		   struct tegra_pcie_edma_desc *desc)
+schedule_edma_xfer(void *edma_h, void *priv, u32 channel, u64 num_desc,
+		   struct tegra_pcie_edma_desc *desc, edma_complete_t *complete)
 {
 	struct tegra_pcie_edma_xfer_info info = {0};
 
@@ -886,21 +1055,107 @@ schedule_edma_xfer(void *edma_h, void *priv, u64 num_desc,
 		return -EINVAL;
 
 	info.type = EDMA_XFER_WRITE;
-	info.channel_num = 0; // no use-case to use all WR channels yet.
+	info.channel_num = channel;
 	info.desc = desc;
 	info.nents = num_desc;
-	info.complete = callback_edma_xfer;
+	info.complete = complete;
 	info.priv = priv;
 
 	return tegra_pcie_edma_submit_xfer(edma_h, &info);
 }
 
+/* all stripes done: write the remote post-fences, on channel 0.*/
+static void
+edma_fence_work(struct work_struct *work)
+{
+	struct copy_request *cr =
+		container_of(work, struct copy_request, fence_work);
+	edma_xfer_status_t edma_status = EDMA_XFER_SUCCESS;
+
+	edma_status = schedule_edma_xfer(cr->ctx->edma_h, (void *)cr, 0,
+					 cr->num_fence_desc,
+					 &cr->edma_desc[cr->fence_desc_start],
+					 callback_edma_xfer);
+	if (edma_status != EDMA_XFER_SUCCESS)
+		callback_edma_xfer((void *)cr, edma_status, NULL);
+}
+
+/* account one finished (or never submitted) stripe of a copy request.*/
+static void
+complete_edma_stripe(struct copy_request *cr, edma_xfer_status_t status)
+{
+	if (status != EDMA_XFER_SUCCESS)
+		WRITE_ONCE(cr->stripe_status, status);
+
+	if (!atomic_dec_and_test(&cr->stripes_pending))
+		return;
+
+	status = READ_ONCE(cr->stripe_status);
+	if (status == EDMA_XFER_SUCCESS && cr->num_fence_desc) {
+		/* may be in eDMA completion context, submit from process.*/
+		schedule_work(&cr->fence_work);
+		return;
+	}
+
+	callback_edma_xfer((void *)cr, status, NULL);
+}
+
+static void
+callback_edma_stripe(void *priv, edma_xfer_status_t status,
+		     struct tegra_pcie_edma_desc *desc)
+{
+	complete_edma_stripe((struct copy_request *)priv, status);
+}
+
+/*
+ * submit each stripe on its own WR channel. Once the first stripe is in
+ * flight, clean-up always goes through the combined completion.
+ */
+static int
+schedule_edma_stripes(struct copy_request *cr)
+{
+	u32 i = 0;
+	u64 num_stripes = cr->num_stripes;
+	edma_xfer_status_t edma_status = EDMA_XFER_SUCCESS;
+	struct stream_ext_ctx_t *ctx = cr->ctx;
+
+	cr->stripe_status = EDMA_XFER_SUCCESS;
+	atomic_set(&cr->stripes_pending, num_stripes);
+	for (i = 0; i < num_stripes; i++) {
+		edma_status = schedule_edma_xfer(ctx->edma_h, (void *)cr, i,
+					 cr->stripe_nents[i],
+					 &cr->edma_desc[cr->stripe_start[i]],
+					 callback_edma_stripe);
+		if (edma_status != EDMA_XFER_SUCCESS)
+			break;
+	}
+	if (i == num_stripes)
+		return 0;
+
+	if (i == 0) {
+		atomic_dec(&ctx->transfer_count);
+		release_copy_request_handles(cr);
+		mutex_lock(&ctx->free_lock);
+		list_add_tail(&cr->node, &ctx->free_list);
+		mutex_unlock(&ctx->free_lock);
+		return -EIO;
+	}
+
+	/* the stripes not submitted, fail them; cr may be reclaimed after.*/
+	for (; i < num_stripes; i++)
+		complete_edma_stripe(cr, edma_status);
+
+	return -EIO;
+}
+
 /* Callback with each async eDMA submit xfer.*/
 static void
 callback_edma_xfer(void *priv, edma_xfer_status_t status,
 			struct tegra_pcie_edma_desc *desc)
 {
 	struct copy_request *cr = (struct copy_request *)priv;
+	struct stream_ext_ctx_t *ctx = cr->ctx;
+	s64 latency_us = 0;
 
 	/* increment num_local_fences.*/
 	if (status == EDMA_XFER_SUCCESS) {
@@ -910,8 +1165,16 @@ callback_edma_xfer(void *priv, edma_xfer_status_t status,
 
 		/* Signal local fences for Tegra*/
 		signal_local_post_fences(cr);
+
+		latency_us = ktime_us_delta(ktime_get(), cr->submit_ts);
+		atomic_inc(&ctx->completion_hist[latency_us > 0 ?
+			   min_t(u32, fls64(latency_us),
+				 COMPLETION_HIST_BUCKETS - 1) : 0]);
 	}
 
+	/* for poll_copy_completion(), after the fences are signalled.*/
+	smp_store_release(&cr->completed_seq, cr->seq);
+
 	/* releases the references of the cubmit-copy handles.*/
 	release_copy_request_handles(cr);
 
@@ -920,68 +1183,103 @@ callback_edma_xfer(void *priv, edma_xfer_status_t status,
 	list_add_tail(&cr->node, &cr->ctx->free_list);
 	mutex_unlock(&cr->ctx->free_lock);
 
-	atomic_dec(&cr->ctx->transfer_count);
-	wake_up_interruptible_all(&cr->ctx->transfer_waitq);
+	/* only deinit waits here, and only for all transfers to drain.*/
+	if (atomic_dec_and_test(&ctx->transfer_count))
+		wake_up_interruptible_all(&ctx->transfer_waitq);
 }
 
+/*
+ * built from the objects referenced in cache_copy_request_handles().
+ *
+ * When the flush ranges add up to EDMA_STRIPE_MIN_SZ or more, they are cut
+ * into one stripe of about (total / DMA_WR_CHNL_NUM) bytes per WR channel,
+ * a flush range crossing a stripe boundary being split in two descriptors.
+ */
 static int
-prepare_edma_desc(enum drv_mode_t drv_mode, struct copy_req_params *params,
-		struct tegra_pcie_edma_desc *desc, u64 *num_desc, enum peer_cpu_t peer_cpu)
+prepare_edma_desc(enum drv_mode_t drv_mode, struct copy_request *cr)
 {
 	u32 i = 0;
-	int ret = 0;
 	u32 iter = 0;
-	s32 handle = -1;
-	struct file *filep = NULL;
+	struct tegra_pcie_edma_desc *desc = cr->edma_desc;
 	struct stream_ext_obj *stream_obj = NULL;
 	struct nvscic2c_pcie_flush_range *flush_range = NULL;
 	phys_addr_t dummy_addr = 0x0;
-
-	*num_desc = 0;
-	for (i = 0; i < params->num_flush_ranges; i++) {
-		flush_range = &params->flush_ranges[i];
-
-		filep = fget(flush_range->src_handle);
-		stream_obj = filep->private_data;
-		desc[iter].src = (stream_obj->vmap.iova + flush_range->offset);
+	dma_addr_t src = 0x0, dst = 0x0;
+	u64 total_sz = 0, stripe_sz = U64_MAX, stripe_fill = 0;
+	u64 remaining = 0, chunk = 0;
+
+	for (i = 0; i < cr->num_local_buf_objs; i++)
+		total_sz += cr->ctx->cr_params.flush_ranges[i].size;
+	if (total_sz >= EDMA_STRIPE_MIN_SZ)
+		stripe_sz = ALIGN(DIV_ROUND_UP_ULL(total_sz, DMA_WR_CHNL_NUM),
+				  SZ_4K);
+
+	cr->num_edma_desc = 0;
+	cr->num_stripes = 1;
+	cr->stripe_start[0] = 0;
+	for (i = 0; i < cr->num_local_buf_objs; i++) {
+		flush_range = &cr->ctx->cr_params.flush_ranges[i];
+
+		stream_obj = cr->local_buf_objs[i];
+		src = (stream_obj->vmap.iova + flush_range->offset);
 		dummy_addr = stream_obj->vmap.iova;
-		fput(filep);
 
-		filep = fget(flush_range->dst_handle);
-		stream_obj = filep->private_data;
+		stream_obj = cr->remote_buf_objs[i];
 		if (drv_mode == DRV_MODE_EPC)
-			desc[iter].dst = stream_obj->aper;
+			dst = stream_obj->aper;
 		else
-			desc[iter].dst = stream_obj->vmap.iova;
-		desc[iter].dst += flush_range->offset;
-		fput(filep);
+			dst = stream_obj->vmap.iova;
+		dst += flush_range->offset;
+
+		remaining = flush_range->size;
+		while (remaining) {
+			chunk = min(remaining, stripe_sz - stripe_fill);
+			desc[iter].src = src;
+			desc[iter].dst = dst;
+			desc[iter].sz = chunk;
+			iter++;
 
-		desc[iter].sz = flush_range->size;
-		iter++;
+			src += chunk;
+			dst += chunk;
+			remaining -= chunk;
+			stripe_fill += chunk;
+			if (stripe_fill == stripe_sz &&
+			    (remaining || (i + 1) < cr->num_local_buf_objs)) {
+				cr->stripe_nents[cr->num_stripes - 1] =
+					iter - cr->stripe_start[cr->num_stripes - 1];
+				cr->stripe_start[cr->num_stripes] = iter;
+				cr->num_stripes++;
+				stripe_fill = 0;
+			}
+		}
 	}
+	cr->fence_desc_start = iter;
 	/* With Orin as remote end, the remote fence signaling is done using DMA
 	 * With X86 as remote end, the remote fence signaling is done using CPU
 	 */
-	if (peer_cpu == NVCPU_ORIN) {
-		for (i = 0; i < params->num_remote_post_fences; i++) {
-			handle = params->remote_post_fences[i];
+	if (cr->peer_cpu == NVCPU_ORIN) {
+		for (i = 0; i < cr->num_remote_post_fences; i++) {
 			desc[iter].src = dummy_addr;
 
-			filep = fget(handle);
-			stream_obj = filep->private_data;
+			stream_obj = cr->remote_post_fences[i];
 			if (drv_mode == DRV_MODE_EPC)
 				desc[iter].dst = stream_obj->aper;
 			else
 				desc[iter].dst = stream_obj->vmap.iova;
 
-			fput(filep);
-
 			desc[iter].sz = 4;
 			iter++;
 		}
 	}
-	*num_desc += iter;
-	return ret;
+	cr->num_fence_desc = iter - cr->fence_desc_start;
+	cr->num_edma_desc = iter;
+
+	/* one stripe: the fences follow the flush ranges on the same channel.*/
+	cr->stripe_nents[cr->num_stripes - 1] =
+		((cr->num_stripes == 1) ? iter : cr->fence_desc_start) -
+		cr->stripe_start[cr->num_stripes - 1];
+
+	return 0;
 }
 
 /* this is post eDMA path, must be done with references still taken.*/
@@ -1033,210 +1331,168 @@ release_copy_request_handles(struct copy_request *cr)
 	return 0;
 }
 
+/*
+ * validate one user-supplied handle of a submit-copy and take a reference
+ * on its object. The object is returned only if its type, and for import
+ * objects the import type, matches; the reference is dropped by
+ * release_copy_request_handles().
+ */
+static struct stream_ext_obj *
+get_copy_request_obj(struct stream_ext_ctx_t *ctx, s32 handle,
+		     enum nvscic2c_pcie_obj_type type, u32 import_type)
+{
+	struct stream_ext_obj *stream_obj = NULL;
+	struct file *filep = fget(handle);
+
+	if (!filep)
+		return NULL;
+
+	if (check_stream_obj(ctx, filep, type) == 0) {
+		stream_obj = filep->private_data;
+		if (type == NVSCIC2C_PCIE_OBJ_TYPE_IMPORT &&
+		    stream_obj->import_type != import_type)
+			stream_obj = NULL;
+		else
+			kref_get(&stream_obj->refcount);
+	}
+	fput(filep);
+
+	return stream_obj;
+}
+
+static int
+check_flush_range(struct nvscic2c_pcie_flush_range *flush_range,
+		  struct stream_ext_obj *stream_obj)
+{
+	if ((flush_range->offset + flush_range->size) > stream_obj->vmap.size)
+		return -EINVAL;
+
+	return 0;
+}
+
+/*
+ * On error, the objects referenced so far are accounted in num_handles and
+ * must be released by the caller.
+ */
 static int
-cache_copy_request_handles(struct copy_req_params *params,
+cache_copy_request_handles(struct stream_ext_ctx_t *ctx,
+			   struct copy_req_params *params,
 			   struct copy_request *cr)
 {
 	u32 i = 0;
-	s32 handle = -1;
-	struct file *filep = NULL;
 	struct stream_ext_obj *stream_obj = NULL;
+	struct nvscic2c_pcie_flush_range *flush_range = NULL;
 
 	cr->num_handles = 0;
 	cr->num_local_post_fences = 0;
 	cr->num_remote_post_fences = 0;
 	cr->num_remote_buf_objs = 0;
+	cr->num_local_buf_objs = 0;
 	for (i = 0; i < params->num_local_post_fences; i++) {
-		handle = params->local_post_fences[i];
-		filep = fget(handle);
-		stream_obj = filep->private_data;
-		kref_get(&stream_obj->refcount);
+		stream_obj = get_copy_request_obj(ctx,
+					params->local_post_fences[i],
+					NVSCIC2C_PCIE_OBJ_TYPE_LOCAL_SYNC, 0);
+		if (!stream_obj)
+			return -EINVAL;
 		cr->handles[cr->num_handles] = stream_obj;
 		cr->num_handles++;
 		/* collect all local post fences separately for nvhost incr.*/
 		cr->local_post_fences[cr->num_local_post_fences] = stream_obj;
 		cr->num_local_post_fences++;
-		fput(filep);
 	}
 	for (i = 0; i < params->num_remote_post_fences; i++) {
-		handle = params->remote_post_fences[i];
-		filep = fget(handle);
-		stream_obj = filep->private_data;
-		kref_get(&stream_obj->refcount);
+		stream_obj = get_copy_request_obj(ctx,
+					params->remote_post_fences[i],
+					NVSCIC2C_PCIE_OBJ_TYPE_IMPORT,
+					STREAM_OBJ_TYPE_SYNC);
+		if (!stream_obj)
+			return -EINVAL;
 		cr->handles[cr->num_handles] = stream_obj;
 		cr->num_handles++;
 		cr->remote_post_fence_values[i] =  params->remote_post_fence_values[i];
 		cr->remote_post_fences[cr->num_remote_post_fences] = stream_obj;
 		cr->num_remote_post_fences++;
-		fput(filep);
 	}
 	for (i = 0; i < params->num_flush_ranges; i++) {
-		handle = params->flush_ranges[i].src_handle;
-		filep = fget(handle);
-		stream_obj = filep->private_data;
-		kref_get(&stream_obj->refcount);
+		flush_range = &params->flush_ranges[i];
+
+		if (flush_range->size <= 0)
+			return -EINVAL;
+
+		if (flush_range->size & 0x3)
+			return -EINVAL;
+
+		if (flush_range->offset & 0x3)
+			return -EINVAL;
+
+		stream_obj = get_copy_request_obj(ctx, flush_range->src_handle,
+					NVSCIC2C_PCIE_OBJ_TYPE_SOURCE_MEM, 0);
+		if (!stream_obj)
+			return -EINVAL;
 		cr->handles[cr->num_handles] = stream_obj;
 		cr->num_handles++;
-		fput(filep);
+		if (check_flush_range(flush_range, stream_obj))
+			return -EINVAL;
+		cr->local_buf_objs[cr->num_local_buf_objs] = stream_obj;
+		cr->num_local_buf_objs++;
 
-		handle = params->flush_ranges[i].dst_handle;
-		filep = fget(handle);
-		stream_obj = filep->private_data;
-		kref_get(&stream_obj->refcount);
+		stream_obj = get_copy_request_obj(ctx, flush_range->dst_handle,
+					NVSCIC2C_PCIE_OBJ_TYPE_IMPORT,
+					STREAM_OBJ_TYPE_MEM);
+		if (!stream_obj)
+			return -EINVAL;
 		cr->handles[cr->num_handles] = stream_obj;
 		cr->num_handles++;
-
+		if (check_flush_range(flush_range, stream_obj))
+			return -EINVAL;
 		cr->remote_buf_objs[cr->num_remote_buf_objs] = stream_obj;
 		cr->num_remote_buf_objs++;
-		fput(filep);
 	}
 
 	return 0;
 }
 
 static int
-validate_handle(struct stream_ext_ctx_t *ctx, s32 handle,
-		enum nvscic2c_pcie_obj_type type)
+check_stream_obj(struct stream_ext_ctx_t *ctx, struct file *filep,
+		 enum nvscic2c_pcie_obj_type type)
 {
-	int ret = -EINVAL;
 	struct stream_ext_obj *stream_obj = NULL;
-	struct file *filep = fget(handle);
-
-	if (!filep)
-		goto exit;
 
 	if (filep->f_op != &fops_default)
-		goto err;
+		return -EINVAL;
 
 	stream_obj = filep->private_data;
 	if (!stream_obj)
-		goto err;
+		return -EINVAL;
 
 	if (stream_obj->marked_for_del)
-		goto err;
+		return -EINVAL;
 
 	if (stream_obj->soc_id != ctx->local_node.soc_id ||
 		stream_obj->cntrlr_id != ctx->local_node.cntrlr_id ||
 		stream_obj->ep_id != ctx->ep_id)
-		goto err;
+		return -EINVAL;
 
 	if (stream_obj->type != type)
-		goto err;
-
-	/* okay.*/
-	ret = 0;
-err:
-	fput(filep);
-exit:
-	return ret;
-}
-
-static int
-validate_import_handle(struct stream_ext_ctx_t *ctx, s32 handle,
-			u32 import_type)
-{
-	int ret = 0;
-	struct stream_ext_obj *stream_obj = NULL;
-	struct file *filep = NULL;
-
-	ret = validate_handle(ctx, handle, NVSCIC2C_PCIE_OBJ_TYPE_IMPORT);
-	if (ret)
-		return ret;
-
-	filep = fget(handle);
-	stream_obj = filep->private_data;
-	if (stream_obj->import_type != import_type) {
-		fput(filep);
 		return -EINVAL;
-	}
-	fput(filep);
 
-	return ret;
+	/* okay.*/
+	return 0;
 }
 
 static int
-validate_flush_range(struct stream_ext_ctx_t *ctx,
-		     struct nvscic2c_pcie_flush_range *flush_range)
+validate_handle(struct stream_ext_ctx_t *ctx, s32 handle,
+		enum nvscic2c_pcie_obj_type type)
 {
-	int ret = 0;
-	struct file *filep = NULL;
-	struct stream_ext_obj *stream_obj = NULL;
-
-	if (flush_range->size <= 0)
-		return -EINVAL;
-
-	if (flush_range->size & 0x3)
-		return -EINVAL;
-
-	if (flush_range->offset & 0x3)
-		return -EINVAL;
-
-	ret = validate_handle(ctx, flush_range->src_handle,
-					NVSCIC2C_PCIE_OBJ_TYPE_SOURCE_MEM);
-	if (ret)
-		return ret;
+	int ret = -EINVAL;
+	struct file *filep = fget(handle);
 
-	ret = validate_import_handle(ctx, flush_range->dst_handle,
-					STREAM_OBJ_TYPE_MEM);
-	if (ret)
+	if (!filep)
 		return ret;
 
-	filep = fget(flush_range->src_handle);
-	stream_obj = filep->private_data;
-	if ((flush_range->offset + flush_range->size) > stream_obj->vmap.size) {
-		fput(filep);
-		return -EINVAL;
-	}
+	ret = check_stream_obj(ctx, filep, type);
 	fput(filep);
 
-	filep = fget(flush_range->dst_handle);
-	stream_obj = filep->private_data;
-	if ((flush_range->offset + flush_range->size) > stream_obj->vmap.size) {
-		fput(filep);
-		return -EINVAL;
-	}
-	fput(filep);
-
-	return 0;
-}
-
-static int
-validate_copy_req_params(struct stream_ext_ctx_t *ctx,
-				struct copy_req_params *params)
-{
-	u32 i = 0;
-	int ret = 0;
-
-	/* for each local post-fence.*/
-	for (i = 0; i < params->num_local_post_fences; i++) {
-		s32 handle = 0;
-
-		handle = params->local_post_fences[i];
-		ret = validate_handle(ctx, handle,
-					NVSCIC2C_PCIE_OBJ_TYPE_LOCAL_SYNC);
-		if (ret)
-			return ret;
-	}
-	/* for each remote post-fence.*/
-	for (i = 0; i < params->num_remote_post_fences; i++) {
-		s32 handle = 0;
-
-		handle = params->remote_post_fences[i];
-		ret = validate_import_handle(ctx, handle, STREAM_OBJ_TYPE_SYNC);
-		if (ret)
-			return ret;
-	}
-
-	/* for each flush-range.*/
-	for (i = 0; i < params->num_flush_ranges; i++) {
-		struct nvscic2c_pcie_flush_range *flush_range = NULL;
-
-		flush_range = &params->flush_ranges[i];
-		ret = validate_flush_range(ctx, flush_range);
-		if (ret)
-			return ret;
-	}
-
 	return ret;
 }
 
@@ -1301,6 +1557,7 @@ free_copy_request(struct copy_request **copy_request)
 	kfree(cr->local_post_fences);
 	kfree(cr->remote_post_fences);
 	kfree(cr->remote_buf_objs);
+	kfree(cr->local_buf_objs);
 	kfree(cr->remote_post_fence_values);
 	kfree(cr->edma_desc);
 	kfree(cr->handles);
@@ -1324,6 +1581,7 @@ allocate_copy_request(struct stream_ext_ctx_t *ctx,
 		goto err;
 	}
 	cr->ctx = ctx;
+	INIT_WORK(&cr->fence_work, edma_fence_work);
 
 	/* flush range has two handles: src, dst + all possible post_fences.*/
 	cr->handles = kzalloc((sizeof(*cr->handles) *
@@ -1341,7 +1599,8 @@ allocate_copy_request(struct stream_ext_ctx_t *ctx,
 	 */
 	cr->edma_desc = kzalloc((sizeof(*cr->edma_desc) *
 				(ctx->cr_limits.max_flush_ranges +
-				ctx->cr_limits.max_post_fences)),
+				ctx->cr_limits.max_post_fences +
+				(DMA_WR_CHNL_NUM - 1))),
 				GFP_KERNEL);
 	if (WARN_ON(!cr->edma_desc)) {
 		ret = -ENOMEM;
@@ -1372,6 +1631,14 @@ allocate_copy_request(struct stream_ext_ctx_t *ctx,
 		goto err;
 	}
 
+	cr->local_buf_objs = kzalloc((sizeof(*cr->local_buf_objs) *
+					ctx->cr_limits.max_flush_ranges),
+					GFP_KERNEL);
+	if (WARN_ON(!cr->local_buf_objs)) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
 	cr->remote_post_fence_values =
 				kzalloc((sizeof(*cr->remote_post_fence_values) *
 				ctx->cr_limits.max_post_fences),
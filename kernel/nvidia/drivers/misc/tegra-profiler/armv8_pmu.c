@@ -855,7 +855,7 @@ static struct quadd_event_source pmu_armv8_int = {
 static int quadd_armv8_pmu_init_for_cpu(struct quadd_ctx *ctx, int cpuid)
 {
 	int idx, err = 0;
-	u32 pmcr, idcode = 0, reg_midr, pmuver;
+	u32 pmcr, idcode = 0, reg_midr, pmuver, nr_cnt;
 	u64 aa64_dfr;
 	u8 implementer;
 	struct cpuinfo_arm64 *local_cpu_data = &per_cpu(cpu_data, cpuid);
@@ -905,6 +905,18 @@ static int quadd_armv8_pmu_init_for_cpu(struct quadd_ctx *ctx, int cpuid)
 		idcode = (pmcr >> QUADD_ARMV8_PMCR_IDCODE_SHIFT) &
 			QUADD_ARMV8_PMCR_IDCODE_MASK;
 
+		/*
+		 * Under a hypervisor PMCR_EL0.N reads as MDCR_EL2.HPMN: the
+		 * counters above it are reserved for EL2 (e.g. Jailhouse
+		 * memguard and inmate sampling) and must not be programmed.
+		 */
+		nr_cnt = (pmcr >> QUADD_ARMV8_PMCR_N_SHIFT) &
+			QUADD_ARMV8_PMCR_N_MASK;
+		local_pmu_ctx->counters_mask &= (1U << nr_cnt) - 1;
+		if (local_pmu_ctx->counters_mask !=
+		    QUADD_ARMV8_COUNTERS_MASK_PMUV3)
+			pr_info("[%d] event counters: %u\n", cpuid, nr_cnt);
+
 		pr_debug("imp: %#x, idcode: %#x\n", implementer, idcode);
 	}
 
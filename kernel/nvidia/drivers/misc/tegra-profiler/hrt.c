@@ -42,6 +42,7 @@
 #include "comm.h"
 #include "mmap.h"
 #include "ma.h"
+#include "hyp.h"
 #include "power_clk.h"
 #include "tegra.h"
 
@@ -1080,6 +1081,7 @@ int quadd_hrt_start(void)
 
 	get_initial_samples(ctx);
 	quadd_ma_start(&hrt);
+	quadd_hyp_start(&hrt);
 
 	/* Enable the sampling only after quadd_get_mmaps() */
 	smp_wmb();
@@ -1097,6 +1099,7 @@ void quadd_hrt_stop(void)
 		(long long)atomic64_read(&hrt.skipped_samples));
 
 	quadd_ma_stop(&hrt);
+	quadd_hyp_stop(&hrt);
 
 	atomic_set(&hrt.active, 0);
 	atomic_set(&hrt.mmap_active, 0);
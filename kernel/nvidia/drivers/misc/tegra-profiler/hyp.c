@@ -0,0 +1,291 @@
+/*
+ * drivers/misc/tegra-profiler/hyp.c
+ *
+ * Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ */
+
+/*
+ * Samples and DSU counts of the Jailhouse hypervisor.
+ *
+ * The hypervisor samples the non-root cells with the PMU counters it keeps
+ * above MDCR_EL2.HPMN and logs them into per-CPU rings. While profiling, the
+ * rings are drained periodically and the samples are merged into the quadd
+ * stream as QUADD_RECORD_TYPE_SAMPLE records of pseudo processes, one per
+ * cell (pid/tgid QUADD_HYP_PID_BASE + cell id).
+ *
+ * The hypervisor also keeps the topmost DSU counters of each cluster for
+ * memguard and publishes their counts, which the DSU source reports as
+ * read-only events.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/module.h>
+#include <linux/timer.h>
+#include <linux/math64.h>
+#include <linux/bitmap.h>
+#include <linux/version.h>
+#include <clocksource/arm_arch_timer.h>
+
+#include <asm/arch_timer.h>
+
+#include <linux/tegra_profiler.h>
+
+#include "hyp.h"
+#include "quadd.h"
+#include "hrt.h"
+
+/* Layout of struct perf_sample, see jailhouse/include/jailhouse/perf.h */
+struct quadd_hyp_sample {
+	u64 timestamp;
+	u64 pc;
+	u32 cell_id;
+	u32 flags;
+};
+
+#define QUADD_HYP_SAMPLE_USER		(1 << 0)
+#define QUADD_HYP_SAMPLE_AARCH32	(1 << 1)
+
+/* PERF_CPUS of the hypervisor */
+#define QUADD_HYP_CPUS			12
+
+/* Pseudo pids of the cells, out of the range of pid_max */
+#define QUADD_HYP_PID_BASE		0x80000000U
+#define QUADD_HYP_MAX_CELLS		64
+
+#define QUADD_HYP_POLL_MSEC		10
+#define QUADD_HYP_BATCH			32
+
+struct perf_sample;
+struct jailhouse_dsu_stats;
+
+/* Exported by the Jailhouse driver, resolved at start if it is loaded */
+int jailhouse_perf_read(unsigned int cpu, unsigned int *pos,
+			struct perf_sample *samples, unsigned int max);
+int jailhouse_dsu_read(unsigned int cluster,
+		       struct jailhouse_dsu_stats *stats);
+
+static struct quadd_hyp_ctx {
+	typeof(&jailhouse_perf_read) perf_read;
+	typeof(&jailhouse_dsu_read) dsu_read;
+
+	struct quadd_hrt_ctx *hrt_ctx;
+	struct timer_list timer;
+
+	unsigned int pos[QUADD_HYP_CPUS];
+	u64 start_cnt;
+	u32 cnt_rate;
+
+	DECLARE_BITMAP(cells_named, QUADD_HYP_MAX_CELLS);
+} hyp_ctx;
+
+static void put_cell_comm(u32 pid, u32 cell_id, u64 time)
+{
+	char name[TASK_COMM_LEN];
+	struct quadd_iovec vec;
+	struct quadd_record_data record;
+	struct quadd_comm_data *s = &record.comm;
+
+	memset(name, 0, sizeof(name));
+	snprintf(name, sizeof(name), "jailhouse-cell%u", cell_id);
+
+	record.record_type = QUADD_RECORD_TYPE_COMM;
+
+	s->time = time;
+	s->flags = 0;
+	s->pid = pid;
+	s->tgid = pid;
+
+	vec.base = name;
+	vec.len = ALIGN(strlen(name) + 1, sizeof(u64));
+
+	s->length = (u16)vec.len;
+
+	quadd_put_sample(&record, &vec, 1);
+}
+
+static void put_hyp_sample(int cpu_id, const struct quadd_hyp_sample *hs,
+			   u64 now, u64 now_cnt)
+{
+	u32 extra_data = 0, ts_delta = 0;
+	struct quadd_iovec vec[2];
+	struct quadd_record_data record;
+	struct quadd_sample_data *s = &record.sample;
+	struct quadd_ctx *ctx = hyp_ctx.hrt_ctx->quadd_ctx;
+	bool user_mode = hs->flags & QUADD_HYP_SAMPLE_USER;
+	u32 pid = QUADD_HYP_PID_BASE + hs->cell_id;
+
+	if ((user_mode && ctx->exclude_user) ||
+	    (!user_mode && ctx->exclude_kernel))
+		return;
+
+	/* CNTPCT to the time base of quadd_get_time() */
+	s->time = now - mul_u64_u32_div(now_cnt - hs->timestamp,
+					NSEC_PER_SEC, hyp_ctx.cnt_rate);
+
+	if (hs->cell_id < QUADD_HYP_MAX_CELLS &&
+	    !test_and_set_bit(hs->cell_id, hyp_ctx.cells_named))
+		put_cell_comm(pid, hs->cell_id, s->time);
+
+	record.record_type = QUADD_RECORD_TYPE_SAMPLE;
+
+	s->flags = 0;
+	if (user_mode)
+		s->flags |= QUADD_SAMPLE_FLAG_USER_MODE;
+
+	/* Same policy as for the samples of the root cell */
+	if (!user_mode && !ctx->collect_kernel_ips)
+		s->ip = 0;
+	else
+		s->ip = hs->pc;
+
+	s->cpu_id = cpu_id;
+	s->pid = pid;
+	s->tgid = pid;
+	s->callchain_nr = 0;
+	/* the hypervisor event is not one of the events of the header */
+	s->events_flags = 0;
+
+	vec[0].base = &extra_data;
+	vec[0].len = sizeof(extra_data);
+
+	vec[1].base = &ts_delta;
+	vec[1].len = sizeof(ts_delta);
+
+	quadd_put_sample(&record, vec, ARRAY_SIZE(vec));
+}
+
+static void drain_rings(void)
+{
+	int cpu, i, n;
+	u64 now, now_cnt;
+	struct quadd_hyp_sample samples[QUADD_HYP_BATCH];
+
+	now = quadd_get_time();
+	now_cnt = arch_timer_read_counter();
+
+	for (cpu = 0; cpu < QUADD_HYP_CPUS; cpu++) {
+		do {
+			n = hyp_ctx.perf_read(cpu, &hyp_ctx.pos[cpu],
+					      (struct perf_sample *)samples,
+					      ARRAY_SIZE(samples));
+			for (i = 0; i < n; i++) {
+				/* the root cell is sampled by quadd itself */
+				if (samples[i].cell_id == 0 ||
+				    (s64)(samples[i].timestamp -
+					  hyp_ctx.start_cnt) < 0)
+					continue;
+
+				put_hyp_sample(cpu, &samples[i], now, now_cnt);
+			}
+		} while (n == ARRAY_SIZE(samples));
+	}
+}
+
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(4, 14, 0))
+static void timer_interrupt(struct timer_list *t)
+#else
+static void timer_interrupt(unsigned long data)
+#endif
+{
+	if (!atomic_read(&hyp_ctx.hrt_ctx->active))
+		return;
+
+	drain_rings();
+	mod_timer(&hyp_ctx.timer,
+		  jiffies + msecs_to_jiffies(QUADD_HYP_POLL_MSEC));
+}
+
+void quadd_hyp_start(struct quadd_hrt_ctx *hrt_ctx)
+{
+	struct timer_list *timer = &hyp_ctx.timer;
+
+	/* the DSU counts are events, not samples: not subject to exclude_hv */
+	hyp_ctx.dsu_read = symbol_get(jailhouse_dsu_read);
+
+	if (hrt_ctx->quadd_ctx->exclude_hv)
+		return;
+
+	hyp_ctx.perf_read = symbol_get(jailhouse_perf_read);
+	if (!hyp_ctx.perf_read)
+		return;
+
+	hyp_ctx.hrt_ctx = hrt_ctx;
+	hyp_ctx.cnt_rate = arch_timer_get_rate();
+	hyp_ctx.start_cnt = arch_timer_read_counter();
+	memset(hyp_ctx.pos, 0, sizeof(hyp_ctx.pos));
+	bitmap_zero(hyp_ctx.cells_named, QUADD_HYP_MAX_CELLS);
+
+	/* the rings are there only while the hypervisor is enabled */
+	if (hyp_ctx.perf_read(0, &hyp_ctx.pos[0], NULL, 0) < 0) {
+		symbol_put(jailhouse_perf_read);
+		hyp_ctx.perf_read = NULL;
+		return;
+	}
+
+	pr_info("QuadD hypervisor samples are merged, interval: %u msec\n",
+		QUADD_HYP_POLL_MSEC);
+
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(4, 14, 0))
+	timer_setup(timer, timer_interrupt, 0);
+#else
+	setup_timer(timer, timer_interrupt, 0);
+#endif
+	mod_timer(timer, jiffies + msecs_to_jiffies(QUADD_HYP_POLL_MSEC));
+}
+
+void quadd_hyp_stop(struct quadd_hrt_ctx *hrt_ctx)
+{
+	if (hyp_ctx.dsu_read) {
+		symbol_put(jailhouse_dsu_read);
+		hyp_ctx.dsu_read = NULL;
+	}
+
+	if (!hyp_ctx.perf_read)
+		return;
+
+	del_timer_sync(&hyp_ctx.timer);
+
+	/* pick up what was sampled since the last tick */
+	drain_rings();
+
+	symbol_put(jailhouse_perf_read);
+	hyp_ctx.perf_read = NULL;
+}
+
+/*
+ * DSU partition of @cluster, for the event setup. Process context, also
+ * works while the profiler is stopped.
+ */
+int quadd_hyp_dsu_get(unsigned int cluster, struct quadd_hyp_dsu_stats *stats)
+{
+	int err;
+	typeof(&jailhouse_dsu_read) dsu_read = symbol_get(jailhouse_dsu_read);
+
+	if (!dsu_read)
+		return -ENODEV;
+
+	err = dsu_read(cluster, (struct jailhouse_dsu_stats *)stats);
+	symbol_put(jailhouse_dsu_read);
+
+	return err;
+}
+
+/* Same as quadd_hyp_dsu_get() while profiling, from any context */
+int quadd_hyp_dsu_read(unsigned int cluster, struct quadd_hyp_dsu_stats *stats)
+{
+	if (!hyp_ctx.dsu_read)
+		return -ENODEV;
+
+	return hyp_ctx.dsu_read(cluster, (struct jailhouse_dsu_stats *)stats);
+}
@@ -0,0 +1,62 @@
+/*
+ * drivers/misc/tegra-profiler/hyp.h
+ *
+ * Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ */
+
+#ifndef __QUADD_HYP_H
+#define __QUADD_HYP_H
+
+#include <linux/types.h>
+#include <linux/errno.h>
+
+struct quadd_hrt_ctx;
+
+/* DSU counters kept by the hypervisor, JAILHOUSE_DSU_HYP_COUNTERS */
+#define QUADD_HYP_DSU_COUNTERS	1
+
+/* Layout of struct jailhouse_dsu_stats, see jailhouse/cpu_stats.h */
+struct quadd_hyp_dsu_stats {
+	u32 seq;
+	u32 num_cnt;
+	/* the counters from this one on belong to the hypervisor */
+	u32 first_hyp_cnt;
+	u32 event_type[QUADD_HYP_DSU_COUNTERS];
+	u64 count[QUADD_HYP_DSU_COUNTERS];
+};
+
+#ifdef CONFIG_ARM64
+void quadd_hyp_start(struct quadd_hrt_ctx *hrt_ctx);
+void quadd_hyp_stop(struct quadd_hrt_ctx *hrt_ctx);
+
+int quadd_hyp_dsu_get(unsigned int cluster, struct quadd_hyp_dsu_stats *stats);
+int quadd_hyp_dsu_read(unsigned int cluster,
+		       struct quadd_hyp_dsu_stats *stats);
+#else
+static inline void quadd_hyp_start(struct quadd_hrt_ctx *hrt_ctx) { }
+static inline void quadd_hyp_stop(struct quadd_hrt_ctx *hrt_ctx) { }
+
+static inline int
+quadd_hyp_dsu_get(unsigned int cluster, struct quadd_hyp_dsu_stats *stats)
+{
+	return -ENODEV;
+}
+
+static inline int
+quadd_hyp_dsu_read(unsigned int cluster, struct quadd_hyp_dsu_stats *stats)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif	/* __QUADD_HYP_H */
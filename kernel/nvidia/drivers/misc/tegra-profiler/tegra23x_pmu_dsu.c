@@ -35,6 +35,7 @@
 
 #include "tegra23x_pmu_dsu.h"
 #include "quadd.h"
+#include "hyp.h"
 
 
 #define CPU_CYCLES		0x11
@@ -51,6 +52,12 @@
 
 #define DSU_MAX_EVENTS		64
 
+/*
+ * Read-only events: the counts of the DSU counters kept by the hypervisor,
+ * DSU_EVENT_HYP_BASE + index of the counter.
+ */
+#define DSU_EVENT_HYP_BASE	0xf0
+
 #define CLUSTERPMCR_E			BIT(0)
 #define CLUSTERPMCR_P			BIT(1)
 #define CLUSTERPMCR_C			BIT(2)
@@ -76,6 +83,12 @@ struct cntr_info {
 	size_t out_idx;
 };
 
+struct hyp_cntr_info {
+	u64 prev_val;
+	u32 id_raw;
+	size_t out_idx;
+};
+
 struct dsu_unit {
 	unsigned int id;
 	cpumask_t associated_cpus;
@@ -83,11 +96,17 @@ struct dsu_unit {
 	bool is_used;
 	bool is_available;
 
+	/* counters of the DSU, and the ones left to us by the hypervisor */
+	unsigned long nr_pmu_cntrs;
 	unsigned long nr_cntrs;
+	unsigned long nr_hyp_cntrs;
 
 	struct cntr_info cntrs[DSU_MAX_CLUSTER_CNTRS];
 	DECLARE_BITMAP(used_cntrs, DSU_MAX_CLUSTER_CNTRS);
 
+	struct hyp_cntr_info hyp_cntrs[QUADD_HYP_DSU_COUNTERS];
+	DECLARE_BITMAP(used_hyp_cntrs, QUADD_HYP_DSU_COUNTERS);
+
 	DECLARE_BITMAP(pmceid_bitmap, DSU_MAX_EVENTS);
 };
 
@@ -135,6 +154,8 @@ static void tegra23x_pmu_dsu_disable(void)
 
 	memset(unit->cntrs, 0, sizeof(unit->cntrs));
 	bitmap_zero(unit->used_cntrs, DSU_MAX_CLUSTER_CNTRS);
+	memset(unit->hyp_cntrs, 0, sizeof(unit->hyp_cntrs));
+	bitmap_zero(unit->used_hyp_cntrs, QUADD_HYP_DSU_COUNTERS);
 	unit->is_used = false;
 }
 
@@ -142,6 +163,7 @@ static void tegra23x_pmu_dsu_start(void)
 {
 	struct dsu_unit *unit;
 	struct cntr_info *cntr;
+	struct quadd_hyp_dsu_stats stats;
 	unsigned long idx = 0, nr_cntrs;
 	struct dsu_cpu_context *cpu_ctx = this_cpu_ptr(ctx.cpu_ctx);
 
@@ -164,6 +186,15 @@ static void tegra23x_pmu_dsu_start(void)
 		}
 		idx++;
 	}
+
+	if (bitmap_empty(unit->used_hyp_cntrs, QUADD_HYP_DSU_COUNTERS))
+		return;
+
+	if (quadd_hyp_dsu_read(unit->id, &stats) < 0)
+		memset(&stats, 0, sizeof(stats));
+
+	for_each_set_bit(idx, unit->used_hyp_cntrs, QUADD_HYP_DSU_COUNTERS)
+		unit->hyp_cntrs[idx].prev_val = stats.count[idx];
 }
 
 static void tegra23x_pmu_dsu_stop(void)
@@ -190,7 +221,10 @@ static int
 tegra23x_pmu_dsu_read(struct quadd_event_data *events, int max)
 {
 	struct cntr_info *cntr;
+	struct hyp_cntr_info *hyp_cntr;
 	struct dsu_unit *unit;
+	struct quadd_hyp_dsu_stats stats;
+	bool is_hyp_valid;
 	u64 val, prev_val, delta, max_count;
 	struct quadd_event_data *curr, *end;
 	unsigned long idx = 0, nr_cntrs;
@@ -241,6 +275,36 @@ tegra23x_pmu_dsu_read(struct quadd_event_data *events, int max)
 		idx++;
 	}
 
+	if (bitmap_empty(unit->used_hyp_cntrs, QUADD_HYP_DSU_COUNTERS))
+		return curr - events;
+
+	/* published at the memguard period boundaries of the cluster */
+	is_hyp_valid = quadd_hyp_dsu_read(unit->id, &stats) == 0;
+
+	for_each_set_bit(idx, unit->used_hyp_cntrs, QUADD_HYP_DSU_COUNTERS) {
+		if (curr >= end)
+			break;
+
+		hyp_cntr = &unit->hyp_cntrs[idx];
+		prev_val = hyp_cntr->prev_val;
+		val = is_hyp_valid ? stats.count[idx] : prev_val;
+
+		curr->event_source = QUADD_EVENT_SOURCE_T23X_UNCORE_PMU_DSU;
+		curr->max_count = U64_MAX;
+
+		curr->event.type = QUADD_EVENT_TYPE_RAW_T23X_UNCORE_DSU;
+		curr->event.id = hyp_cntr->id_raw;
+
+		curr->out_idx = hyp_cntr->out_idx;
+
+		curr->val = val;
+		curr->prev_val = prev_val;
+		curr->delta = val - prev_val;
+
+		hyp_cntr->prev_val = val;
+		curr++;
+	}
+
 	return curr - events;
 }
 
@@ -257,11 +321,53 @@ static void clean_units(void)
 		if (unit->is_available) {
 			memset(unit->cntrs, 0, sizeof(unit->cntrs));
 			bitmap_zero(unit->used_cntrs, DSU_MAX_CLUSTER_CNTRS);
+			memset(unit->hyp_cntrs, 0, sizeof(unit->hyp_cntrs));
+			bitmap_zero(unit->used_hyp_cntrs,
+				    QUADD_HYP_DSU_COUNTERS);
 			unit->is_used = false;
 		}
 	}
 }
 
+/*
+ * The DSU has no hardware partitioning: under Jailhouse, leave the topmost
+ * counters to the hypervisor and offer their counts instead.
+ */
+static void get_partition(struct dsu_unit *unit)
+{
+	struct quadd_hyp_dsu_stats stats;
+
+	unit->nr_cntrs = unit->nr_pmu_cntrs;
+	unit->nr_hyp_cntrs = 0;
+
+	if (quadd_hyp_dsu_get(unit->id, &stats) < 0)
+		return;
+
+	unit->nr_cntrs = min_t(unsigned long, unit->nr_cntrs,
+			       stats.first_hyp_cnt);
+	if (stats.num_cnt > stats.first_hyp_cnt)
+		unit->nr_hyp_cntrs = min_t(unsigned long,
+					   stats.num_cnt - stats.first_hyp_cnt,
+					   QUADD_HYP_DSU_COUNTERS);
+}
+
+static int add_hyp_event(struct dsu_unit *unit, u32 event_raw, u32 idx)
+{
+	if (idx >= unit->nr_hyp_cntrs)
+		return -ENOENT;
+
+	if (test_and_set_bit(idx, unit->used_hyp_cntrs))
+		return -EBUSY;
+
+	unit->hyp_cntrs[idx].id_raw = event_raw;
+	unit->hyp_cntrs[idx].prev_val = 0;
+
+	set_bit(unit->id, ctx.used_units);
+	unit->is_used = true;
+
+	return 0;
+}
+
 static int add_event(const struct quadd_event *event)
 {
 	struct dsu_unit *unit;
@@ -281,6 +387,10 @@ static int add_event(const struct quadd_event *event)
 	if (!unit->is_available)
 		return -ENOENT;
 
+	if (event_hw >= DSU_EVENT_HYP_BASE)
+		return add_hyp_event(unit, event_raw,
+				     event_hw - DSU_EVENT_HYP_BASE);
+
 	nr_cntrs = unit->nr_cntrs;
 
 	idx = find_first_zero_bit(unit->used_cntrs, nr_cntrs);
@@ -322,6 +432,11 @@ static void fill_output_indexes(size_t base_idx)
 
 			unit->cntrs[cntr_id++].out_idx = out_idx++;
 		}
+
+		for_each_set_bit(cntr_id, unit->used_hyp_cntrs,
+				 QUADD_HYP_DSU_COUNTERS)
+			unit->hyp_cntrs[cntr_id].out_idx = out_idx++;
+
 		unit_id++;
 	}
 }
@@ -334,6 +449,11 @@ tegra23x_pmu_dsu_set_events(int cpuid, const struct quadd_event *events,
 
 	clean_units();
 
+	for (i = 0; i < DSU_MAX_CLUSTERS; i++) {
+		if (ctx.units[i].is_available)
+			get_partition(&ctx.units[i]);
+	}
+
 	for (i = 0; i < size; i++) {
 		const struct quadd_event *event = &events[i];
 
@@ -357,6 +477,8 @@ supported_events(int cpuid, struct quadd_event *events,
 {
 	struct dsu_unit *unit = &ctx.units[0];
 
+	get_partition(unit);
+
 	*raw_event_mask = 0x0fff;
 	*nr_cntrs = unit->nr_cntrs;
 
@@ -392,6 +514,16 @@ current_events(int cpuid, struct quadd_event *events, int max)
 			curr->id = unit->cntrs[cntr_id++].id_raw;
 			curr++;
 		}
+
+		for_each_set_bit(cntr_id, unit->used_hyp_cntrs,
+				 QUADD_HYP_DSU_COUNTERS) {
+			if (curr >= end)
+				break;
+
+			curr->type = QUADD_EVENT_TYPE_RAW_T23X_UNCORE_DSU;
+			curr->id = unit->hyp_cntrs[cntr_id].id_raw;
+			curr++;
+		}
 		unit_id++;
 	}
 
@@ -488,10 +620,13 @@ static bool dsu_get_clusters_info(void)
 		unit->is_used = false;
 		unit->is_available = is_cluster_available(i);
 
+		unit->nr_pmu_cntrs = nr_cntrs;
 		unit->nr_cntrs = nr_cntrs;
+		unit->nr_hyp_cntrs = 0;
 
 		bitmap_copy(unit->pmceid_bitmap, pmceid_bitmap, DSU_MAX_EVENTS);
 		bitmap_zero(unit->used_cntrs, DSU_MAX_CLUSTER_CNTRS);
+		bitmap_zero(unit->used_hyp_cntrs, QUADD_HYP_DSU_COUNTERS);
 
 		dsu_get_associated_cpus(i, &unit->associated_cpus);
 
@@ -38,8 +38,54 @@
 #define ETHER_CONFIG_FRP_CMD		51
 /** To configure L2 Filter (Only with Ethernet virtualization) */
 #define ETHER_L2_ADDR			61
+/** To bind a dma-buf as Rx buffers of a DMA channel and reap them */
+#define ETHER_CONFIG_RX_DMABUF		62
 /** @} */
 
+/**
+ * @addtogroup ETHER_CONFIG_RX_DMABUF operations
+ * @{
+ */
+/** Carve the dma-buf into Rx buffers of the channel */
+#define ETHER_RX_DMABUF_BIND		0U
+/** Give the channel its page pool buffers back */
+#define ETHER_RX_DMABUF_UNBIND		1U
+/** Read completed Rx buffers */
+#define ETHER_RX_DMABUF_REAP		2U
+/** Hand reaped Rx buffers back to the channel */
+#define ETHER_RX_DMABUF_RETURN		3U
+/** @} */
+
+/**
+ * @brief Rx buffer of a dma-buf bound channel holding a received frame
+ */
+struct ether_rx_dmabuf_cpl {
+	/** Index of the slot, the frame starts at slot * slot_size */
+	nveu32_t slot;
+	/** Length of the frame */
+	nveu32_t len;
+};
+
+/**
+ * @brief Input for ETHER_CONFIG_RX_DMABUF
+ */
+struct ether_rx_dmabuf_req {
+	/** One of ETHER_RX_DMABUF_* operations */
+	nveu32_t op;
+	/** Rx DMA channel */
+	nveu32_t chan;
+	/** dma-buf fd, ETHER_RX_DMABUF_BIND only */
+	nve32_t fd;
+	/** Size of a slot, at least the Rx buffer length and a multiple of
+	 * 64 bytes, ETHER_RX_DMABUF_BIND only */
+	nveu32_t slot_size;
+	/** In: size of the entries array, out: entries reaped/returned */
+	nveu32_t count;
+	/** User pointer to a struct ether_rx_dmabuf_cpl array to reap into,
+	 * or a nveu32_t array of slots to return */
+	nveu64_t entries;
+};
+
 /**
  * @brief Structure for L2 filters input
  */
@@ -21,90 +21,82 @@
 #endif
 #include "ether_linux.h"
 
-int ether_get_tx_ts(struct ether_priv_data *pdata)
+bool ether_tx_ts_slot_done(struct ether_priv_data *pdata, unsigned int idx)
 {
-	struct list_head *head_node, *temp_head_node;
+	struct ether_tx_ts_slot *slot = &pdata->tx_ts_slot[idx];
 	struct skb_shared_hwtstamps shhwtstamp;
 	struct osi_ioctl ioctl_data = {};
 	unsigned long long nsec = 0x0;
-	struct ether_tx_ts_skb_list *pnode;
-	int ret = -1;
-	unsigned long flags;
-	bool pending = false;
-
-	if (!atomic_inc_and_test(&pdata->tx_ts_ref_cnt)) {
-		/* Tx time stamp consumption already going on either from workq or func */
-		return 0;
-	}
-
-	if (list_empty(&pdata->tx_ts_skb_head)) {
-		atomic_set(&pdata->tx_ts_ref_cnt, -1);
-		return 0;
-	}
-
-	list_for_each_safe(head_node, temp_head_node,
-			   &pdata->tx_ts_skb_head) {
-		pnode = list_entry(head_node,
-				   struct ether_tx_ts_skb_list,
-				   list_head);
-		memset(&shhwtstamp, 0,
-		       sizeof(struct skb_shared_hwtstamps));
+	struct sk_buff *skb;
+	bool stale;
 
-		ioctl_data.cmd = OSI_CMD_GET_TX_TS;
-		ioctl_data.tx_ts.pkt_id = pnode->pktid;
-		ret = osi_handle_ioctl(pdata->osi_core, &ioctl_data);
-		if (ret == 0) {
-			/* get time stamp form ethernet server */
-			dev_dbg(pdata->dev, "%s() pktid = %x, skb = %p\n",
-				__func__, pnode->pktid, pnode->skb);
+	stale = time_after(jiffies, slot->pkt_jiffies +
+			   msecs_to_jiffies(ETHER_SECTOMSEC));
 
-			if ((ioctl_data.tx_ts.nsec & OSI_MAC_TCR_TXTSSMIS) ==
-			    OSI_MAC_TCR_TXTSSMIS) {
-				dev_warn(pdata->dev,
-					 "No valid time for skb, removed\n");
-				goto update_skb;
-			}
+	ioctl_data.cmd = OSI_CMD_GET_TX_TS;
+	ioctl_data.tx_ts.pkt_id = slot->pktid;
+	if (osi_handle_ioctl(pdata->osi_core, &ioctl_data) != 0) {
+		if (!stale)
+			return false;
 
-			nsec = ioctl_data.tx_ts.sec * ETHER_ONESEC_NENOSEC +
-			       ioctl_data.tx_ts.nsec;
-
-			/* pass tstamp to stack */
-			shhwtstamp.hwtstamp = ns_to_ktime(nsec);
-			if (pnode->skb != NULL) {
-				skb_tstamp_tx(pnode->skb, &shhwtstamp);
-			}
+		dev_dbg(pdata->dev, "%s() skb %p deleting for pktid = %x\n",
+			__func__, slot->skb, slot->pktid);
+		ioctl_data.tx_ts.nsec = OSI_MAC_TCR_TXTSSMIS;
+	}
 
-update_skb:
-			if (pnode->skb != NULL) {
-				dev_consume_skb_any(pnode->skb);
-			}
+	/* ISR, completion and work may race for the slot, first one to
+	 * clear the ready bit owns it.
+	 */
+	if (!test_and_clear_bit(idx, pdata->tx_ts_ready))
+		return true;
+
+	skb = slot->skb;
+	slot->skb = NULL;
+
+	if ((ioctl_data.tx_ts.nsec & OSI_MAC_TCR_TXTSSMIS) !=
+	    OSI_MAC_TCR_TXTSSMIS) {
+		dev_dbg(pdata->dev, "%s() pktid = %x, skb = %p\n",
+			__func__, slot->pktid, skb);
+		nsec = ioctl_data.tx_ts.sec * ETHER_ONESEC_NENOSEC +
+		       ioctl_data.tx_ts.nsec;
+		memset(&shhwtstamp, 0, sizeof(struct skb_shared_hwtstamps));
+		/* pass tstamp to stack */
+		shhwtstamp.hwtstamp = ns_to_ktime(nsec);
+		skb_tstamp_tx(skb, &shhwtstamp);
+	} else if (!stale) {
+		dev_warn(pdata->dev, "No valid time for skb, removed\n");
+	}
+
+	dev_consume_skb_any(skb);
+	smp_mb__before_atomic();
+	clear_bit(idx, pdata->tx_ts_busy);
+
+	return true;
+}
 
-			raw_spin_lock_irqsave(&pdata->txts_lock, flags);
-			list_del(head_node);
-			pnode->in_use = OSI_DISABLE;
-			raw_spin_unlock_irqrestore(&pdata->txts_lock, flags);
+int ether_get_tx_ts(struct ether_priv_data *pdata)
+{
+	bool pending = false;
+	unsigned int idx;
 
-		} else {
-			dev_dbg(pdata->dev, "Unable to retrieve TS from OSI\n");
+	for_each_set_bit(idx, pdata->tx_ts_ready, ETHER_MAX_PENDING_SKB_CNT) {
+		if (!ether_tx_ts_slot_done(pdata, idx))
 			pending = true;
-		}
 	}
 
-	if (pending)
-		ret = -EAGAIN;
-
-	atomic_set(&pdata->tx_ts_ref_cnt, -1);
-	return ret;
+	return pending ? -EAGAIN : 0;
 }
 
 /**
  * @brief Gets timestamp and update skb
  *
  * Algorithm:
- * - Parse through tx_ts_skb_head.
+ * - Fallback for the timestamps which were neither there at Tx completion
+ *   nor picked up in the common ISR.
+ * - Parse through ready tx_ts_slot entries.
  * - Issue osi_handle_ioctl(OSI_CMD_GET_TX_TS) to read timestamp.
  * - Update skb with timestamp and give to network stack
- * - Free skb and node.
+ * - Free skb and slot.
  *
  * @param[in] work: Work to handle SKB list update
  */
@@ -214,11 +206,49 @@ static irqreturn_t ether_common_isr_thread(int irq, void *data)
 }
 #endif
 
+/**
+ * @brief Period of the MMC counter reads at the current link speed.
+ *
+ * Algorithm: The counters only have to be read before a 32 bit register can
+ * wrap. MGBE splits its octet counters in low and high registers, so its
+ * fastest 32 bit registers count minimum sized frames, while the octet
+ * counters of EQOS are 32 bit wide. Half of the wrap time at line rate is
+ * used, bounded by ETHER_STATS_TIMER and stats_timer. Without a known
+ * speed the shortest period is used. ethtool reads the counters on
+ * demand in addition.
+ *
+ * @param[in] pdata: OSD private data
+ *
+ * @retval period in msec.
+ */
+static unsigned int ether_stats_period(struct ether_priv_data *pdata)
+{
+	int speed = pdata->speed;
+	u64 rate, msec;
+
+	if (speed <= 0)
+		return min(pdata->stats_timer, ETHER_STATS_TIMER);
+
+	/* register increments per second at line rate, speed is in Mbps */
+	rate = (u64)speed * 1000000ULL;
+	if (pdata->osi_core->mac == OSI_MAC_HW_MGBE)
+		rate = div_u64(rate, ETHER_MIN_FRAME_WIRE_BITS);
+	else
+		rate = div_u64(rate, BITS_PER_BYTE);
+
+	msec = div64_u64((u64)U32_MAX * (MSEC_PER_SEC / 2U), rate);
+	msec = max_t(u64, msec, ETHER_STATS_TIMER);
+
+	/* stats_timer is at most ETHER_STATS_TIMER_MAX */
+	return (unsigned int)min_t(u64, msec, pdata->stats_timer);
+}
+
 /**
  * @brief Work Queue function to call osi_read_mmc() periodically.
  *
  * Algorithm: call osi_read_mmc in periodic manner to avoid possibility of
- * overrun of 32 bit MMC hw registers.
+ * overrun of 32 bit MMC hw registers. The work is unbound, so it follows
+ * the workqueue cpumask and stays away from isolated cores.
  *
  * @param[in] work: work structure
  *
@@ -239,8 +269,8 @@ static inline void ether_stats_work_func(struct work_struct *work)
 		dev_err(pdata->dev, "failed to read MMC counters %s\n",
 			__func__);
 	}
-	schedule_delayed_work(&pdata->ether_stats_work,
-			      msecs_to_jiffies(pdata->stats_timer));
+	queue_delayed_work(system_unbound_wq, &pdata->ether_stats_work,
+			   msecs_to_jiffies(ether_stats_period(pdata)));
 }
 
 #ifdef HSI_SUPPORT
@@ -309,8 +339,9 @@ static inline void ether_hsi_work_func(struct work_struct *work)
  * @brief Start delayed workqueue.
  *
  * Algorithm: Start workqueue to read RMON HW counters periodically.
- * Workqueue will get schedule in every ETHER_STATS_TIMER sec.
- * Workqueue will be scheduled only if HW supports RMON HW counters.
+ * Workqueue will get schedule as often as the link speed requires, see
+ * ether_stats_period(). Workqueue will be scheduled only if HW supports
+ * RMON HW counters.
  *
  * @param[in] pdata:OSD private data
  *
@@ -322,8 +353,8 @@ static inline void ether_stats_work_queue_start(struct ether_priv_data *pdata)
 
 	if (pdata->hw_feat.mmc_sel == OSI_ENABLE &&
 	    osi_core->use_virtualization == OSI_DISABLE) {
-		schedule_delayed_work(&pdata->ether_stats_work,
-				      msecs_to_jiffies(pdata->stats_timer));
+		queue_delayed_work(system_unbound_wq, &pdata->ether_stats_work,
+				   msecs_to_jiffies(ether_stats_period(pdata)));
 	}
 }
 
@@ -1181,6 +1212,51 @@ static int ether_phy_init(struct net_device *dev)
 	return 0;
 }
 
+/**
+ * @brief Run a NAPI scheduled from a remote CPU.
+ *
+ * @param[in] info: NAPI instance, already marked as scheduled.
+ */
+static void ether_napi_csd_func(void *info)
+{
+	/* called from the IPI, interrupts are disabled */
+	__napi_schedule_irqoff((struct napi_struct *)info);
+}
+
+/**
+ * @brief Schedule a NAPI of a channel on the CPU of the channel.
+ *
+ * Algorithm: A VM IRQ serves several channels but fires on one CPU only.
+ * Threaded NAPIs run on the CPU of their kthread anyway, so only the
+ * softirq NAPI of a channel which is bound to another CPU is handed over
+ * to that CPU. Binding all channels of a VM IRQ to one CPU, which is also
+ * used as the affinity hint of the IRQ, avoids the IPI altogether.
+ *
+ * @param[in] pdata: OSD private data.
+ * @param[in] chan: DMA channel number.
+ * @param[in] napi: NAPI instance on which napi_schedule_prep() succeeded.
+ * @param[in] csd: Cross call data of the NAPI.
+ *
+ * @note Called from hard IRQ context.
+ */
+static inline void ether_napi_schedule_on(struct ether_priv_data *pdata,
+					  unsigned int chan,
+					  struct napi_struct *napi,
+					  call_single_data_t *csd)
+{
+	int cpu = READ_ONCE(pdata->napi_cpu[chan]);
+
+#ifdef ETHER_NAPI_THREADED
+	if (napi->thread != NULL)
+		cpu = -1;
+#endif
+	if (cpu >= 0 && cpu != smp_processor_id() &&
+	    smp_call_function_single_async(cpu, csd) == 0)
+		return;
+
+	__napi_schedule_irqoff(napi);
+}
+
 /**
  * @brief ether_vm_isr - VM based ISR routine.
  *
@@ -1218,7 +1294,11 @@ static irqreturn_t ether_vm_isr(int irq, void *data)
 	struct ether_tx_napi *tx_napi = NULL;
 	unsigned int dma_status;
 
-	/* TODO: locking required since this is shared register b/w VM IRQ's */
+	/* The global status is shared by all VM IRQs, each of them owns the
+	 * bits of its channels only. The interrupt enable registers are also
+	 * written by the channel ISRs and polls, so serialize with them.
+	 */
+	raw_spin_lock(&pdata->rlock);
 	dma_status = osi_get_global_dma_status(osi_dma);
 	dma_status &= vm_irq->chan_mask;
 
@@ -1237,11 +1317,12 @@ static irqreturn_t ether_vm_isr(int irq, void *data)
 			osi_handle_dma_intr(osi_dma, chan,
 					    OSI_DMA_CH_RX_INTR,
 					    OSI_DMA_INTR_DISABLE);
+			ETHER_CHAN_STAT_INC(pdata, chan, rx_irq_n);
 
-			if (likely(napi_schedule_prep(&rx_napi->napi))) {
-				/* TODO: Schedule NAPI on different CPU core */
-				__napi_schedule_irqoff(&rx_napi->napi);
-			}
+			if (likely(napi_schedule_prep(&rx_napi->napi)))
+				ether_napi_schedule_on(pdata, chan,
+						       &rx_napi->napi,
+						       &rx_napi->napi_csd);
 		} else {
 			tx_napi = pdata->tx_napi[chan];
 
@@ -1249,14 +1330,15 @@ static irqreturn_t ether_vm_isr(int irq, void *data)
 					    OSI_DMA_CH_TX_INTR,
 					    OSI_DMA_INTR_DISABLE);
 
-			if (likely(napi_schedule_prep(&tx_napi->napi))) {
-				/* TODO: Schedule NAPI on different CPU core */
-				__napi_schedule_irqoff(&tx_napi->napi);
-			}
+			if (likely(napi_schedule_prep(&tx_napi->napi)))
+				ether_napi_schedule_on(pdata, chan,
+						       &tx_napi->napi,
+						       &tx_napi->napi_csd);
 		}
 
 		dma_status &= ~BIT(temp);
 	}
+	raw_spin_unlock(&pdata->rlock);
 
 	return IRQ_HANDLED;
 }
@@ -1342,6 +1424,7 @@ static irqreturn_t ether_rx_chan_isr(int irq, void *data)
 	val = pdata->xstats.rx_normal_irq_n[chan];
 	pdata->xstats.rx_normal_irq_n[chan] =
 		osi_update_stats_counter(val, 1U);
+	ETHER_CHAN_STAT_INC(pdata, chan, rx_irq_n);
 
 	if (likely(napi_schedule_prep(&rx_napi->napi))) {
 		__napi_schedule_irqoff(&rx_napi->napi);
@@ -1379,6 +1462,10 @@ static irqreturn_t ether_common_isr(int irq, void *data)
 		dev_err(pdata->dev,
 			"%s() failure in handling ISR\n", __func__);
 	}
+
+	/* MAC Tx timestamps got queued by OSI, complete waiting skbs */
+	if (!bitmap_empty(pdata->tx_ts_ready, ETHER_MAX_PENDING_SKB_CNT))
+		ether_get_tx_ts(pdata);
 #ifdef HSI_SUPPORT
 	if (pdata->osi_core->hsi.enabled == OSI_ENABLE &&
 	    pdata->osi_core->hsi.report_err == OSI_ENABLE)
@@ -1417,6 +1504,7 @@ static void ether_free_irqs(struct ether_priv_data *pdata)
 	    pdata->osi_core->mac == OSI_MAC_HW_MGBE) {
 		for (i = 0; i < pdata->osi_core->num_vm_irqs; i++) {
 			if (pdata->rx_irq_alloc_mask & (OSI_ENABLE << i)) {
+				irq_set_affinity_hint(pdata->vm_irqs[i], NULL);
 				devm_free_irq(pdata->dev, pdata->vm_irqs[i],
 					      &pdata->vm_irq_data[i]);
 			}
@@ -1531,6 +1619,36 @@ static int ether_init_ivc(struct ether_priv_data *pdata)
 	return 0;
 }
 
+/**
+ * @brief Set the affinity hint of a VM IRQ.
+ *
+ * Algorithm: Hints the CPU of the first channel of the VM IRQ which is
+ * bound by nvidia,napi-cpus, so that its NAPIs are scheduled locally.
+ *
+ * @param[in] pdata: OSD private data.
+ * @param[in] vm: VM IRQ index.
+ */
+static void ether_set_vm_irq_affinity(struct ether_priv_data *pdata,
+				      unsigned int vm)
+{
+	struct ether_vm_irq_data *vm_irq = &pdata->vm_irq_data[vm];
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	unsigned int i, chan;
+	int cpu;
+
+	for (i = 0; i < osi_dma->num_dma_chans; i++) {
+		chan = osi_dma->dma_chans[i];
+		cpu = pdata->napi_cpu[chan];
+		if ((vm_irq->chan_mask & ETHER_VM_IRQ_RX_CHAN_MASK(chan)) &&
+		    cpu >= 0 && cpu_online(cpu)) {
+			cpumask_copy(&vm_irq->cpu_mask, cpumask_of(cpu));
+			irq_set_affinity_hint(pdata->vm_irqs[vm],
+					      &vm_irq->cpu_mask);
+			return;
+		}
+	}
+}
+
 /**
  * @brief Register IRQs
  *
@@ -1602,6 +1720,7 @@ static int ether_request_irqs(struct ether_priv_data *pdata)
 			}
 
 			pdata->rx_irq_alloc_mask |= (OSI_ENABLE << i);
+			ether_set_vm_irq_affinity(pdata, i);
 		}
 	} else {
 		for (i = 0; i < osi_dma->num_dma_chans; i++) {
@@ -1673,9 +1792,132 @@ static void ether_napi_disable(struct ether_priv_data *pdata)
 		napi_disable(&pdata->tx_napi[chan]->napi);
 		napi_synchronize(&pdata->rx_napi[chan]->napi);
 		napi_disable(&pdata->rx_napi[chan]->napi);
+#ifdef ETHER_DIM
+		/* no poll re-arms the holdoff or queues DIM work anymore */
+		hrtimer_cancel(&pdata->rx_napi[chan]->rx_usecs_timer);
+		cancel_work_sync(&pdata->rx_napi[chan]->dim.work);
+		cancel_work_sync(&pdata->tx_napi[chan]->dim.work);
+#endif
+	}
+}
+
+#ifdef ETHER_DIM
+/**
+ * @brief Apply the Rx moderation profile selected by DIM.
+ *
+ * @param[in] work: DIM work of the Rx channel.
+ */
+static void ether_rx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct ether_rx_napi *rx_napi = container_of(dim, struct ether_rx_napi,
+						     dim);
+	struct dim_cq_moder moder;
+
+	moder = net_dim_get_rx_moderation(dim->mode, dim->profile_ix);
+	WRITE_ONCE(rx_napi->rx_usecs, moder.usec);
+	dim->state = DIM_START_MEASURE;
+}
+
+/**
+ * @brief Apply the Tx moderation profile selected by DIM.
+ *
+ * Algorithm: The profile sets the tx_usecs SW timer of the channel. The
+ * tx_frames threshold is programmed into the descriptors by OSI and stays
+ * the same for all channels.
+ *
+ * @param[in] work: DIM work of the Tx channel.
+ */
+static void ether_tx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct ether_tx_napi *tx_napi = container_of(dim, struct ether_tx_napi,
+						     dim);
+	struct dim_cq_moder moder;
+
+	moder = net_dim_get_tx_moderation(dim->mode, dim->profile_ix);
+	WRITE_ONCE(tx_napi->tx_usecs,
+		   clamp_t(unsigned int, moder.usec, OSI_MIN_TX_COALESCE_USEC,
+			   OSI_MAX_TX_COALESCE_USEC));
+	dim->state = DIM_START_MEASURE;
+}
+#endif
+
+/**
+ * @brief Reset the interrupt moderation state of a channel.
+ *
+ * Algorithm: Starts from the ethtool/DT tx_usecs and, with adaptive
+ * moderation, from the default DIM profiles.
+ *
+ * @param[in] pdata: OSD private data structure.
+ * @param[in] chan: DMA channel number.
+ *
+ * @note NAPI of the channel must be disabled.
+ */
+static void ether_dim_init(struct ether_priv_data *pdata, unsigned int chan)
+{
+	struct ether_tx_napi *tx_napi = pdata->tx_napi[chan];
+#ifdef ETHER_DIM
+	struct ether_rx_napi *rx_napi = pdata->rx_napi[chan];
+
+	memset(&rx_napi->dim, 0, sizeof(struct dim));
+	INIT_WORK(&rx_napi->dim.work, ether_rx_dim_work);
+	rx_napi->dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+	rx_napi->dim_packets = 0;
+	rx_napi->dim_bytes = 0;
+	rx_napi->dim_events = 0;
+	rx_napi->rx_usecs = 0U;
+	if (pdata->use_adaptive_rx == OSI_ENABLE)
+		rx_napi->rx_usecs =
+			net_dim_get_def_rx_moderation(rx_napi->dim.mode).usec;
+
+	memset(&tx_napi->dim, 0, sizeof(struct dim));
+	INIT_WORK(&tx_napi->dim.work, ether_tx_dim_work);
+	tx_napi->dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+	tx_napi->dim_packets = 0;
+	tx_napi->dim_bytes = 0;
+	tx_napi->dim_events = 0;
+#endif
+	tx_napi->tx_usecs = pdata->osi_dma->tx_usecs;
+}
+
+bool ether_is_rx_steer_chan(struct ether_priv_data *pdata,
+			    unsigned int chan)
+{
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	unsigned int i;
+
+	for (i = 0; i < osi_dma->num_dma_chans; i++) {
+		if (osi_dma->dma_chans[i] == chan)
+			return true;
+	}
+
+	for (i = 0; i < pdata->num_cell_chans; i++) {
+		if (pdata->cell_chans[i] == chan)
+			return true;
 	}
+
+	return false;
 }
 
+#ifdef ETHER_NAPI_THREADED
+void ether_napi_set_affinity(struct ether_priv_data *pdata,
+			     unsigned int chan)
+{
+	int cpu = pdata->napi_cpu[chan];
+	const struct cpumask *mask;
+	struct task_struct *thread;
+
+	mask = (cpu < 0) ? cpu_possible_mask : cpumask_of(cpu);
+	thread = pdata->tx_napi[chan]->napi.thread;
+	if (thread != NULL)
+		set_cpus_allowed_ptr(thread, mask);
+	thread = pdata->rx_napi[chan]->napi.thread;
+	if (thread != NULL)
+		set_cpus_allowed_ptr(thread, mask);
+}
+#endif
+
 /**
  * @brief Enable NAPI.
  *
@@ -1694,8 +1936,15 @@ static void ether_napi_enable(struct ether_priv_data *pdata)
 	for (i = 0; i < osi_dma->num_dma_chans; i++) {
 		chan = osi_dma->dma_chans[i];
 
+		ether_dim_init(pdata, chan);
+		/* packets queued before are not completed anymore */
+		netdev_tx_reset_queue(netdev_get_tx_queue(pdata->ndev, i));
 		napi_enable(&pdata->tx_napi[chan]->napi);
 		napi_enable(&pdata->rx_napi[chan]->napi);
+#ifdef ETHER_NAPI_THREADED
+		/* the kthreads are recreated if threaded NAPI was toggled */
+		ether_napi_set_affinity(pdata, chan);
+#endif
 	}
 }
 
@@ -1723,6 +1972,12 @@ static void ether_free_rx_skbs(struct osi_rx_swcx *rx_swcx,
 		if (prx_swcx->buf_virt_addr != NULL) {
 			if (resv_buf_virt_addr != prx_swcx->buf_virt_addr) {
 #ifdef ETHER_PAGE_POOL
+#ifdef ETHER_RX_DMABUF
+				if (ether_rx_buf_is_dmabuf(prx_swcx->buf_virt_addr))
+					ether_rx_dmabuf_put(ether_rx_buf_to_slot(
+						prx_swcx->buf_virt_addr));
+				else
+#endif
 				if (chan != OSI_INVALID_CHAN_NUM)
 					page_pool_put_full_page(pdata->page_pool[chan],
 								prx_swcx->buf_virt_addr,
@@ -1777,6 +2032,11 @@ static void free_rx_dma_resources(struct osi_dma_priv_data *osi_dma,
 			osi_dma->rx_ring[i] = NULL;
 			rx_ring = NULL;
 		}
+#ifdef ETHER_XDP
+		if (chan != OSI_INVALID_CHAN_NUM &&
+		    xdp_rxq_info_is_reg(&pdata->xdp_rxq[chan]))
+			xdp_rxq_info_unreg(&pdata->xdp_rxq[chan]);
+#endif
 #ifdef ETHER_PAGE_POOL
 		if (chan != OSI_INVALID_CHAN_NUM && pdata->page_pool[chan]) {
 			page_pool_destroy(pdata->page_pool[chan]);
@@ -1881,14 +2141,13 @@ static int ether_allocate_rx_buffers(struct ether_priv_data *pdata,
 
 #ifdef ETHER_PAGE_POOL
 		if (chan != OSI_INVALID_CHAN_NUM) {
-			page = page_pool_dev_alloc_pages(pdata->page_pool[chan]);
+			page = ether_rx_alloc_buf(pdata, chan, &dma_addr);
 			if (!page) {
 				dev_err(pdata->dev,
 					"failed to allocate page pool buffer");
 				return -ENOMEM;
 			}
 
-			dma_addr = page_pool_get_dma_addr(page);
 			rx_swcx->buf_virt_addr = page;
 		}
 #else
@@ -1933,15 +2192,36 @@ static int ether_page_pool_create_per_chan(struct ether_priv_data *pdata,
 	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
 	struct page_pool_params pp_params = { 0 };
 	unsigned int num_pages, pool_size = 1024;
+	unsigned int buf_size;
 	int ret = 0;
 
-	pp_params.flags = PP_FLAG_DMA_MAP;
+	/* Pages stay mapped while recycled, only the area written by the
+	 * DMA is synced back to the device.
+	 */
+	pp_params.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV;
 	pp_params.pool_size = pool_size;
-	num_pages = DIV_ROUND_UP(osi_dma->rx_buf_len, PAGE_SIZE);
+	buf_size = SKB_DATA_ALIGN(ETHER_RX_HEADROOM + osi_dma->rx_buf_len +
+				  ETHER_RX_TAILROOM);
+	num_pages = DIV_ROUND_UP(buf_size, PAGE_SIZE);
 	pp_params.order = ilog2(roundup_pow_of_two(num_pages));
 	pp_params.nid = dev_to_node(pdata->dev);
 	pp_params.dev = pdata->dev;
-	pp_params.dma_dir = DMA_FROM_DEVICE;
+	pp_params.dma_dir = ETHER_RX_DMA_DIR;
+	pp_params.offset = ETHER_RX_HEADROOM;
+	pp_params.max_len = osi_dma->rx_buf_len;
+	pdata->rx_buf_truesize = PAGE_SIZE << pp_params.order;
+#ifdef ETHER_RX_FRAGS
+	/* Payload frags of standard frames only pin their part of a page.
+	 * The page is synced as a whole once its last buffer is recycled.
+	 */
+	if (buf_size <= (PAGE_SIZE / 2U)) {
+#ifdef PP_FLAG_PAGE_FRAG
+		pp_params.flags |= PP_FLAG_PAGE_FRAG;
+#endif
+		pp_params.max_len = PAGE_SIZE - ETHER_RX_HEADROOM;
+		pdata->rx_buf_truesize = buf_size;
+	}
+#endif
 
 	pdata->page_pool[chan] = page_pool_create(&pp_params);
 	if (IS_ERR(pdata->page_pool[chan])) {
@@ -1954,6 +2234,40 @@ static int ether_page_pool_create_per_chan(struct ether_priv_data *pdata,
 }
 #endif
 
+#ifdef ETHER_XDP
+/**
+ * @brief Register the XDP Rx queue info of a channel
+ *
+ * Algorithm: Registers the Rx queue with the XDP core and its page pool as
+ * the memory model, so that frames return their pages to the pool.
+ *
+ * @param[in] pdata: OSD private data.
+ * @param[in] qinx: Rx queue index of the channel.
+ * @param[in] chan: Rx DMA channel number.
+ *
+ * @retval 0 on success
+ * @retval "negative value" on failure.
+ */
+static int ether_xdp_rxq_reg(struct ether_priv_data *pdata,
+			     unsigned int qinx, unsigned int chan)
+{
+	struct xdp_rxq_info *rxq = &pdata->xdp_rxq[chan];
+	int ret;
+
+	ret = xdp_rxq_info_reg(rxq, pdata->ndev, qinx,
+			       pdata->rx_napi[chan]->napi.napi_id);
+	if (ret < 0)
+		return ret;
+
+	ret = xdp_rxq_info_reg_mem_model(rxq, MEM_TYPE_PAGE_POOL,
+					 pdata->page_pool[chan]);
+	if (ret < 0)
+		xdp_rxq_info_unreg(rxq);
+
+	return ret;
+}
+#endif
+
 /**
  * @brief Allocate Receive DMA channel ring resources.
  *
@@ -1999,6 +2313,12 @@ static int ether_allocate_rx_dma_resources(struct osi_dma_priv_data *osi_dma,
 			if (ret < 0) {
 				goto exit;
 			}
+#ifdef ETHER_XDP
+			ret = ether_xdp_rxq_reg(pdata, i, chan);
+			if (ret < 0) {
+				goto exit;
+			}
+#endif
 		}
 	}
 
@@ -2272,6 +2592,253 @@ error_alloc:
 	return ret;
 }
 
+int ether_restart_dma(struct ether_priv_data *pdata,
+		      unsigned int tx_ring_sz, unsigned int rx_ring_sz)
+{
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	unsigned int old_tx_ring_sz = osi_dma->tx_ring_sz;
+	unsigned int old_rx_ring_sz = osi_dma->rx_ring_sz;
+	struct net_device *ndev = pdata->ndev;
+	unsigned int i, chan;
+	int ret;
+
+	/* turn off sources of data into dev */
+	netif_tx_disable(ndev);
+
+	for (i = 0; i < osi_dma->num_dma_chans; i++) {
+		chan = osi_dma->dma_chans[i];
+		if (atomic_read(&pdata->tx_napi[chan]->tx_usecs_timer_armed)
+		    == OSI_ENABLE) {
+			hrtimer_cancel(&pdata->tx_napi[chan]->tx_usecs_timer);
+			atomic_set(&pdata->tx_napi[chan]->tx_usecs_timer_armed,
+				   OSI_DISABLE);
+		}
+	}
+
+	osi_hw_dma_deinit(osi_dma);
+	ether_napi_disable(pdata);
+
+#ifdef ETHER_NVGRO
+	for (i = 0; i < osi_dma->num_dma_chans; i++) {
+		chan = osi_dma->dma_chans[i];
+		ether_nvgro_purge(pdata->rx_napi[chan], true);
+	}
+#endif
+
+	free_dma_resources(pdata);
+
+	osi_dma->tx_ring_sz = tx_ring_sz;
+	osi_dma->rx_ring_sz = rx_ring_sz;
+	ret = ether_allocate_dma_resources(pdata);
+	if (ret < 0) {
+		dev_err(pdata->dev,
+			"failed to allocate rings of %u/%u, restoring %u/%u\n",
+			tx_ring_sz, rx_ring_sz, old_tx_ring_sz,
+			old_rx_ring_sz);
+		osi_dma->tx_ring_sz = old_tx_ring_sz;
+		osi_dma->rx_ring_sz = old_rx_ring_sz;
+		if (ether_allocate_dma_resources(pdata) < 0) {
+			dev_err(pdata->dev, "failed to restore DMA rings\n");
+			return ret;
+		}
+	}
+
+	if (osi_hw_dma_init(osi_dma) < 0) {
+		dev_err(pdata->dev, "%s: failed to initialize MAC HW DMA\n",
+			__func__);
+		free_dma_resources(pdata);
+		return -EIO;
+	}
+
+	ether_napi_enable(pdata);
+	netif_tx_start_all_queues(ndev);
+
+	return ret;
+}
+
+#ifdef ETHER_RX_DMABUF
+/**
+ * @brief Release a dma-buf of a DMA channel
+ *
+ * @param[in] rxd: dma-buf, none of its slots may be in a Rx ring.
+ */
+static void ether_rx_dmabuf_release(struct ether_rx_dmabuf *rxd)
+{
+	if (rxd->sgt)
+		dma_buf_unmap_attachment(rxd->attach, rxd->sgt,
+					 DMA_FROM_DEVICE);
+	if (rxd->attach)
+		dma_buf_detach(rxd->dmabuf, rxd->attach);
+	if (rxd->dmabuf)
+		dma_buf_put(rxd->dmabuf);
+
+	kvfree(rxd->cpl);
+	kvfree(rxd->free);
+	kvfree(rxd->slots);
+	kfree(rxd);
+}
+
+/**
+ * @brief Carve a mapped dma-buf into slots
+ *
+ * Algorithm: Slot i starts at i * slot_size in the dma-buf. Slots lying
+ * across two DMA segments are left out of the free slots.
+ *
+ * @param[in] rxd: dma-buf with its DMA mapping.
+ */
+static void ether_rx_dmabuf_carve(struct ether_rx_dmabuf *rxd)
+{
+	unsigned long long seg_start = 0ULL, seg_end, off;
+	struct scatterlist *sg;
+	unsigned int i, j = 0U;
+
+	for (i = 0U; i < rxd->nr_slots; i++) {
+		rxd->slots[i].rxd = rxd;
+		rxd->slots[i].idx = i;
+	}
+
+	for_each_sgtable_dma_sg(rxd->sgt, sg, i) {
+		seg_end = seg_start + sg_dma_len(sg);
+		for (; j < rxd->nr_slots; j++) {
+			off = (unsigned long long)j * rxd->slot_size;
+			if (off + rxd->slot_size > seg_end)
+				break;
+			if (off < seg_start)
+				continue;
+
+			rxd->slots[j].addr = sg_dma_address(sg) +
+					     (off - seg_start);
+			rxd->free[rxd->nr_free++] = j;
+		}
+		seg_start = seg_end;
+	}
+}
+
+int ether_rx_dmabuf_bind(struct ether_priv_data *pdata, unsigned int chan,
+			 int fd, unsigned int slot_size)
+{
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	struct ether_rx_dmabuf *rxd;
+	unsigned int i;
+	int ret;
+
+	if (!netif_running(pdata->ndev))
+		return -ENETDOWN;
+
+	for (i = 0U; i < osi_dma->num_dma_chans; i++) {
+		if (osi_dma->dma_chans[i] == chan)
+			break;
+	}
+	if (i == osi_dma->num_dma_chans)
+		return -EINVAL;
+
+	if (pdata->rx_dmabuf[chan])
+		return -EBUSY;
+
+	if ((slot_size < osi_dma->rx_buf_len) ||
+	    !IS_ALIGNED(slot_size, ETHER_RX_DMABUF_ALIGN)) {
+		dev_err(pdata->dev, "invalid dma-buf slot size %u\n",
+			slot_size);
+		return -EINVAL;
+	}
+
+	rxd = kzalloc(sizeof(*rxd), GFP_KERNEL);
+	if (!rxd)
+		return -ENOMEM;
+
+	spin_lock_init(&rxd->lock);
+	rxd->slot_size = slot_size;
+
+	rxd->dmabuf = dma_buf_get(fd);
+	if (IS_ERR(rxd->dmabuf)) {
+		ret = PTR_ERR(rxd->dmabuf);
+		rxd->dmabuf = NULL;
+		goto err;
+	}
+
+	rxd->attach = dma_buf_attach(rxd->dmabuf, pdata->dev);
+	if (IS_ERR(rxd->attach)) {
+		ret = PTR_ERR(rxd->attach);
+		rxd->attach = NULL;
+		goto err;
+	}
+
+	rxd->sgt = dma_buf_map_attachment(rxd->attach, DMA_FROM_DEVICE);
+	if (IS_ERR(rxd->sgt)) {
+		ret = PTR_ERR(rxd->sgt);
+		rxd->sgt = NULL;
+		goto err;
+	}
+
+	rxd->nr_slots = min_t(size_t, rxd->dmabuf->size / slot_size, UINT_MAX);
+	rxd->slots = kvcalloc(rxd->nr_slots, sizeof(*rxd->slots), GFP_KERNEL);
+	rxd->free = kvcalloc(rxd->nr_slots, sizeof(*rxd->free), GFP_KERNEL);
+	rxd->cpl = kvcalloc(rxd->nr_slots, sizeof(*rxd->cpl), GFP_KERNEL);
+	if (!rxd->slots || !rxd->free || !rxd->cpl) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	ether_rx_dmabuf_carve(rxd);
+	/* a full ring must leave slots for the application to hold */
+	if (rxd->nr_free <= osi_dma->rx_ring_sz) {
+		dev_err(pdata->dev,
+			"dma-buf holds %u Rx buffers, Rx ring needs %u\n",
+			rxd->nr_free, osi_dma->rx_ring_sz);
+		ret = -EINVAL;
+		goto err;
+	}
+
+	WRITE_ONCE(pdata->rx_dmabuf[chan], rxd);
+	ret = ether_restart_dma(pdata, osi_dma->tx_ring_sz,
+				osi_dma->rx_ring_sz);
+	if (ret < 0) {
+		/* take the slots out of the rings before releasing them */
+		WRITE_ONCE(pdata->rx_dmabuf[chan], NULL);
+		ether_restart_dma(pdata, osi_dma->tx_ring_sz,
+				  osi_dma->rx_ring_sz);
+		goto err;
+	}
+
+	return 0;
+
+err:
+	ether_rx_dmabuf_release(rxd);
+
+	return ret;
+}
+
+int ether_rx_dmabuf_unbind(struct ether_priv_data *pdata, unsigned int chan)
+{
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	struct ether_rx_dmabuf *rxd = pdata->rx_dmabuf[chan];
+	int ret;
+
+	if (!rxd)
+		return -ENOENT;
+
+	WRITE_ONCE(pdata->rx_dmabuf[chan], NULL);
+	ret = ether_restart_dma(pdata, osi_dma->tx_ring_sz,
+				osi_dma->rx_ring_sz);
+	ether_rx_dmabuf_release(rxd);
+
+	return ret;
+}
+
+void ether_rx_dmabuf_unbind_all(struct ether_priv_data *pdata)
+{
+	unsigned int chan;
+
+	for (chan = 0U; chan < OSI_MGBE_MAX_NUM_CHANS; chan++) {
+		if (!pdata->rx_dmabuf[chan])
+			continue;
+
+		ether_rx_dmabuf_release(pdata->rx_dmabuf[chan]);
+		pdata->rx_dmabuf[chan] = NULL;
+	}
+}
+#endif
+
 /**
  * @brief Initialize default EEE LPI configurations
  *
@@ -2667,12 +3234,12 @@ static int ether_open(struct net_device *dev)
 	/* start network queues */
 	netif_tx_start_all_queues(pdata->ndev);
 
-	pdata->stats_timer = ETHER_STATS_TIMER;
+	pdata->stats_timer = ETHER_STATS_TIMER_MAX;
 #ifdef HSI_SUPPORT
 	/* Override stats_timer to getting MCC error stats as per
 	 * hsi.err_time_threshold configuration
 	 */
-	if (osi_core->hsi.err_time_threshold < ETHER_STATS_TIMER)
+	if (osi_core->hsi.err_time_threshold < ETHER_STATS_TIMER_MAX)
 		pdata->stats_timer = osi_core->hsi.err_time_threshold;
 #endif
 	ether_stats_work_queue_start(pdata);
@@ -2819,27 +3386,20 @@ static inline void ether_delete_l2_filter(struct ether_priv_data *pdata)
  */
 static inline void ether_flush_tx_ts_skb_list(struct ether_priv_data *pdata)
 {
-	struct ether_tx_ts_skb_list *pnode;
-	struct list_head *head_node, *temp_head_node;
-	unsigned long flags;
+	unsigned int idx;
 
 	/* stop workqueue */
 	cancel_delayed_work_sync(&pdata->tx_ts_work);
 
-	raw_spin_lock_irqsave(&pdata->txts_lock, flags);
-	/* Delete nodes from list and rest static memory for reuse */
-	if (!list_empty(&pdata->tx_ts_skb_head)) {
-		list_for_each_safe(head_node, temp_head_node,
-				   &pdata->tx_ts_skb_head) {
-			pnode = list_entry(head_node,
-					   struct ether_tx_ts_skb_list,
-					   list_head);
-			dev_kfree_skb(pnode->skb);
-			list_del(head_node);
-			pnode->in_use = OSI_DISABLE;
-		}
+	/* Release the pending slots for reuse */
+	for_each_set_bit(idx, pdata->tx_ts_ready, ETHER_MAX_PENDING_SKB_CNT) {
+		if (!test_and_clear_bit(idx, pdata->tx_ts_ready))
+			continue;
+
+		dev_kfree_skb_any(pdata->tx_ts_slot[idx].skb);
+		pdata->tx_ts_slot[idx].skb = NULL;
+		clear_bit(idx, pdata->tx_ts_busy);
 	}
-	raw_spin_unlock_irqrestore(&pdata->txts_lock, flags);
 }
 
 /**
@@ -2864,7 +3424,6 @@ static int ether_close(struct net_device *ndev)
 
 #ifdef ETHER_NVGRO
 	del_timer_sync(&pdata->nvgro_timer);
-	/* TODO: purge the queues */
 #endif
 
 	/* Unregister broadcasting MAC timestamp to clients */
@@ -2930,8 +3489,19 @@ static int ether_close(struct net_device *ndev)
 
 	ether_napi_disable(pdata);
 
+#ifdef ETHER_NVGRO
+	for (i = 0; i < pdata->osi_dma->num_dma_chans; i++) {
+		chan = pdata->osi_dma->dma_chans[i];
+		atomic_set(&pdata->rx_napi[chan]->nvgro_purge, OSI_DISABLE);
+		ether_nvgro_purge(pdata->rx_napi[chan], true);
+	}
+#endif
+
 	/* free DMA resources after DMA stop */
 	free_dma_resources(pdata);
+#ifdef ETHER_RX_DMABUF
+	ether_rx_dmabuf_unbind_all(pdata);
+#endif
 
 	/* PTP de-init */
 	ether_ptp_remove(pdata);
@@ -3277,6 +3847,10 @@ desc_not_free:
 	ret = 0;
 
 dma_map_failed:
+	if (ret < 0) {
+		ETHER_CHAN_STAT_INC(pdata, pdata->osi_dma->dma_chans[
+				    skb_get_queue_mapping(skb)], dma_map_err_n);
+	}
 	/* Failed to fill current desc. Rollback previous desc's */
 	ether_tx_swcx_rollback(pdata, tx_ring, cur_tx_idx, cnt);
 	return ret;
@@ -3286,9 +3860,11 @@ dma_map_failed:
  * @brief Select queue based on user priority
  *
  * Algorithm:
- * 1) Select the correct queue index based which has priority of queue
- * same as skb->priority
- * 2) default select queue array index 0
+ * 1) Select the queues which have priority of queue same as skb->priority,
+ * or the queues with the priority of queue array index 0 if there are none.
+ * 2) Spread the packets over these queues: a socket keeps its queue while
+ * it has packets in flight and otherwise uses the queue of the sending CPU,
+ * other packets are spread by flow hash.
  *
  * @param[in] dev: Network device pointer
  * @param[in] skb: sk_buff pointer, buffer data to send
@@ -3308,9 +3884,12 @@ static unsigned short ether_select_queue(struct net_device *dev,
 {
 	struct ether_priv_data *pdata = netdev_priv(dev);
 	struct osi_core_priv_data *osi_core = pdata->osi_core;
+	unsigned short txqs[OSI_MGBE_MAX_NUM_QUEUES];
 	unsigned short txqueue_select = 0;
-	unsigned int i, mtlq;
+	unsigned int i, mtlq, num_txqs = 0;
 	unsigned int priority = skb->priority;
+	struct sock *sk = skb->sk;
+	int sk_queue;
 
 	if (skb_vlan_tag_present(skb)) {
 		priority = skb_vlan_tag_get_prio(skb);
@@ -3319,14 +3898,69 @@ static unsigned short ether_select_queue(struct net_device *dev,
 	for (i = 0; i < osi_core->num_mtl_queues; i++) {
 		mtlq = osi_core->mtl_queues[i];
 		if (pdata->txq_prio[mtlq] == priority) {
-			txqueue_select = (unsigned short)i;
-			break;
+			txqs[num_txqs++] = (unsigned short)i;
+		}
+	}
+
+	if (num_txqs == 0U) {
+		priority = pdata->txq_prio[osi_core->mtl_queues[0]];
+		for (i = 0; i < osi_core->num_mtl_queues; i++) {
+			mtlq = osi_core->mtl_queues[i];
+			if (pdata->txq_prio[mtlq] == priority) {
+				txqs[num_txqs++] = (unsigned short)i;
+			}
+		}
+	}
+
+	if (num_txqs == 1U) {
+		return txqs[0];
+	}
+
+	if (sk != NULL) {
+		/* moving a flow with packets in flight would reorder it */
+		sk_queue = sk_tx_queue_get(sk);
+		if (!skb->ooo_okay && sk_queue >= 0) {
+			for (i = 0; i < num_txqs; i++) {
+				if (txqs[i] == (unsigned short)sk_queue) {
+					return txqs[i];
+				}
+			}
+		}
+
+		txqueue_select = txqs[raw_smp_processor_id() % num_txqs];
+		if (sk_fullsock(sk) && rcu_access_pointer(sk->sk_dst_cache)) {
+			sk_tx_queue_set(sk, txqueue_select);
 		}
+	} else {
+		txqueue_select = txqs[reciprocal_scale(skb_get_hash(skb),
+						       num_txqs)];
 	}
 
 	return txqueue_select;
 }
 
+/**
+ * @brief Arm the Tx completion SW timer of a channel if not armed yet.
+ *
+ * @param[in] pdata: OSD private data.
+ * @param[in] chan: Tx DMA channel number.
+ */
+static inline void ether_tx_usecs_arm(struct ether_priv_data *pdata,
+				      unsigned int chan)
+{
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+
+	if (osi_dma->use_tx_usecs == OSI_ENABLE &&
+	    atomic_read(&pdata->tx_napi[chan]->tx_usecs_timer_armed) ==
+			OSI_DISABLE) {
+		atomic_set(&pdata->tx_napi[chan]->tx_usecs_timer_armed,
+			   OSI_ENABLE);
+		hrtimer_start(&pdata->tx_napi[chan]->tx_usecs_timer,
+			      READ_ONCE(pdata->tx_napi[chan]->tx_usecs) *
+			      NSEC_PER_USEC, HRTIMER_MODE_REL);
+	}
+}
+
 /**
  * @brief Network layer hook for data transmission.
  *
@@ -3359,6 +3993,7 @@ static int ether_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 	if (count <= 0) {
 		if (count == 0) {
 			netif_stop_subqueue(ndev, qinx);
+			ETHER_CHAN_STAT_INC(pdata, chan, tx_ring_full_n);
 			netdev_err(ndev, "Tx ring[%d] is full\n", chan);
 			return NETDEV_TX_BUSY;
 		}
@@ -3376,24 +4011,243 @@ static int ether_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 		return NETDEV_TX_OK;
 	}
 #endif
+	netdev_tx_sent_queue(netdev_get_tx_queue(ndev, qinx), skb->len);
 
 	if (ether_avail_txdesc_cnt(osi_dma, tx_ring) <= ETHER_TX_DESC_THRESHOLD) {
 		netif_stop_subqueue(ndev, qinx);
+		ETHER_CHAN_STAT_INC(pdata, chan, tx_ring_full_n);
 		netdev_dbg(ndev, "Tx ring[%d] insufficient desc.\n", chan);
 	}
 
-	if (osi_dma->use_tx_usecs == OSI_ENABLE &&
-	    atomic_read(&pdata->tx_napi[chan]->tx_usecs_timer_armed) ==
-			OSI_DISABLE) {
-		atomic_set(&pdata->tx_napi[chan]->tx_usecs_timer_armed,
-			   OSI_ENABLE);
-		hrtimer_start(&pdata->tx_napi[chan]->tx_usecs_timer,
-			      osi_dma->tx_usecs * NSEC_PER_USEC,
-			      HRTIMER_MODE_REL);
-	}
+	ether_tx_usecs_arm(pdata, chan);
 	return NETDEV_TX_OK;
 }
 
+#ifdef ETHER_XDP
+/**
+ * @brief Queue an XDP frame on a Tx ring.
+ *
+ * Algorithm:
+ * 1) Map the frame, or sync it if it is a page of the Rx page pool.
+ * 2) Fill a single descriptor and invoke OSI for data transmission.
+ *
+ * @param[in] pdata: OSD private data.
+ * @param[in] qinx: Tx queue index, its netdev queue lock is held.
+ * @param[in] xdpf: Frame to send.
+ * @param[in] pool_page: True if the frame is in an Rx page pool page.
+ *
+ * @retval 0 on success
+ * @retval "negative value" if the frame was not queued.
+ */
+static int ether_xdp_xmit_frame(struct ether_priv_data *pdata,
+				unsigned int qinx, struct xdp_frame *xdpf,
+				bool pool_page)
+{
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	unsigned int chan = osi_dma->dma_chans[qinx];
+	struct osi_tx_ring *tx_ring = osi_dma->tx_ring[chan];
+	struct osi_tx_pkt_cx *tx_pkt_cx = &tx_ring->tx_pkt_cx;
+	struct osi_tx_swcx *tx_swcx = tx_ring->tx_swcx + tx_ring->cur_tx_idx;
+	unsigned long tags = ETHER_XDP_TX_FRAME;
+	struct page *page;
+	dma_addr_t dma_addr;
+
+	/* keep room for the stack, which stops the queue on the threshold */
+	if (unlikely(tx_swcx->len ||
+		     ether_avail_txdesc_cnt(osi_dma, tx_ring) <=
+		     ETHER_TX_DESC_THRESHOLD ||
+		     xdpf->len > ETHER_TX_MAX_BUFF_SIZE))
+		return -EBUSY;
+
+	if (pool_page) {
+		page = virt_to_head_page(xdpf->data);
+		dma_addr = page_pool_get_dma_addr(page) +
+			   (xdpf->data - page_address(page));
+		dma_sync_single_for_device(pdata->dev, dma_addr, xdpf->len,
+					   ETHER_RX_DMA_DIR);
+		tags |= ETHER_XDP_TX_POOL;
+	} else {
+		dma_addr = dma_map_single(pdata->dev, xdpf->data, xdpf->len,
+					  DMA_TO_DEVICE);
+		if (unlikely(dma_mapping_error(pdata->dev, dma_addr))) {
+			ETHER_CHAN_STAT_INC(pdata, chan, dma_map_err_n);
+			return -ENOMEM;
+		}
+	}
+
+	memset(tx_pkt_cx, 0, sizeof(*tx_pkt_cx));
+	tx_pkt_cx->flags = OSI_PKT_CX_LEN;
+	tx_pkt_cx->payload_len = xdpf->len;
+	tx_pkt_cx->desc_cnt = 1;
+
+	tx_swcx->buf_phy_addr = dma_addr;
+	tx_swcx->len = xdpf->len;
+	tx_swcx->flags &= ~OSI_PKT_CX_PAGED_BUF;
+	tx_swcx->buf_virt_addr = (void *)((unsigned long)xdpf | tags);
+
+	if (unlikely(osi_hw_transmit(osi_dma, chan) < 0)) {
+		if (!pool_page)
+			dma_unmap_single(pdata->dev, dma_addr, xdpf->len,
+					 DMA_TO_DEVICE);
+		tx_swcx->buf_virt_addr = NULL;
+		tx_swcx->buf_phy_addr = 0;
+		tx_swcx->len = 0;
+		return -EIO;
+	}
+
+	ether_tx_usecs_arm(pdata, chan);
+	return 0;
+}
+
+int ether_xdp_tx(struct ether_priv_data *pdata, struct xdp_frame *xdpf)
+{
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	unsigned int cpu = smp_processor_id();
+	unsigned int qinx = cpu % osi_dma->num_dma_chans;
+	unsigned int chan = osi_dma->dma_chans[qinx];
+	struct netdev_queue *txq = netdev_get_tx_queue(pdata->ndev, qinx);
+	unsigned long val;
+	int ret;
+
+	__netif_tx_lock(txq, cpu);
+	ret = ether_xdp_xmit_frame(pdata, qinx, xdpf, true);
+	__netif_tx_unlock(txq);
+
+	if (unlikely(ret < 0)) {
+		val = pdata->xstats.xdp_xmit_err_n[chan];
+		pdata->xstats.xdp_xmit_err_n[chan] =
+			osi_update_stats_counter(val, 1UL);
+	}
+
+	return ret;
+}
+
+void ether_xdp_tx_complete(struct ether_priv_data *pdata,
+			   const struct osi_tx_swcx *swcx)
+{
+	unsigned long tags = (unsigned long)swcx->buf_virt_addr;
+	struct xdp_frame *xdpf = (struct xdp_frame *)(tags &
+						      ~ETHER_XDP_TX_TAGS);
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	struct net_device *ndev = pdata->ndev;
+	struct netdev_queue *txq;
+	unsigned int qinx, chan;
+
+	if ((tags & ETHER_XDP_TX_POOL) == 0UL)
+		dma_unmap_single(pdata->dev, swcx->buf_phy_addr, swcx->len,
+				 DMA_TO_DEVICE);
+	xdp_return_frame(xdpf);
+	ndev->stats.tx_packets++;
+
+	/*
+	 * The frame carries no queue mapping, wake any queue the stack found
+	 * full while XDP used the descriptors.
+	 */
+	for (qinx = 0; qinx < osi_dma->num_dma_chans; qinx++) {
+		chan = osi_dma->dma_chans[qinx];
+		txq = netdev_get_tx_queue(ndev, qinx);
+		if (netif_tx_queue_stopped(txq) &&
+		    (ether_avail_txdesc_cnt(osi_dma, osi_dma->tx_ring[chan]) >
+		     ETHER_TX_DESC_THRESHOLD))
+			netif_tx_wake_queue(txq);
+	}
+}
+
+/**
+ * @brief Network layer hook for XDP frames redirected to the interface.
+ *
+ * Algorithm: Queues the frames on the Tx queue of the current CPU.
+ *
+ * @param[in] ndev: Net device structure.
+ * @param[in] n: Number of frames.
+ * @param[in] frames: Frames to send.
+ * @param[in] flags: XDP_XMIT_* flags.
+ *
+ * @retval "number of frames queued" on success, the caller frees the others
+ * @retval "negative value" on failure.
+ */
+static int ether_xdp_xmit(struct net_device *ndev, int n,
+			  struct xdp_frame **frames, u32 flags)
+{
+	struct ether_priv_data *pdata = netdev_priv(ndev);
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	unsigned int cpu = smp_processor_id();
+	unsigned int qinx = cpu % osi_dma->num_dma_chans;
+	unsigned int chan = osi_dma->dma_chans[qinx];
+	struct netdev_queue *txq;
+	unsigned long val;
+	int i;
+
+	if (unlikely(!netif_running(ndev) || !netif_carrier_ok(ndev)))
+		return -ENETDOWN;
+
+	if (unlikely(flags & ~XDP_XMIT_FLAGS_MASK))
+		return -EINVAL;
+
+	txq = netdev_get_tx_queue(ndev, qinx);
+	__netif_tx_lock(txq, cpu);
+	for (i = 0; i < n; i++) {
+		if (ether_xdp_xmit_frame(pdata, qinx, frames[i], false) < 0)
+			break;
+	}
+	__netif_tx_unlock(txq);
+
+	val = pdata->xstats.xdp_xmit_n[chan];
+	pdata->xstats.xdp_xmit_n[chan] = osi_update_stats_counter(val, i);
+	if (i < n) {
+		val = pdata->xstats.xdp_xmit_err_n[chan];
+		pdata->xstats.xdp_xmit_err_n[chan] =
+			osi_update_stats_counter(val, n - i);
+	}
+
+	return i;
+}
+
+/**
+ * @brief Attach or detach the XDP program of the interface.
+ *
+ * Algorithm: Swaps the program, the Rx path picks it up with the next
+ * packet. The buffers always reserve the XDP headroom, so the rings are
+ * not reallocated.
+ *
+ * @param[in] ndev: Net device structure.
+ * @param[in] bpf: XDP_SETUP_PROG command.
+ *
+ * @retval 0 on success
+ * @retval "negative value" on failure.
+ */
+static int ether_xdp_setup(struct net_device *ndev, struct netdev_bpf *bpf)
+{
+	struct ether_priv_data *pdata = netdev_priv(ndev);
+	struct bpf_prog *old_prog;
+
+	old_prog = xchg(&pdata->xdp_prog, bpf->prog);
+	if (old_prog)
+		bpf_prog_put(old_prog);
+
+	return 0;
+}
+
+/**
+ * @brief Network layer hook for BPF commands.
+ *
+ * @param[in] ndev: Net device structure.
+ * @param[in] bpf: BPF command.
+ *
+ * @retval 0 on success
+ * @retval "negative value" on failure.
+ */
+static int ether_bpf(struct net_device *ndev, struct netdev_bpf *bpf)
+{
+	switch (bpf->command) {
+	case XDP_SETUP_PROG:
+		return ether_xdp_setup(ndev, bpf);
+	default:
+		return -EINVAL;
+	}
+}
+#endif /* ETHER_XDP */
+
 /**
  * @brief Function to configure the multicast address in device.
  *
@@ -4159,6 +5013,8 @@ static int ether_setup_tc(struct net_device *ndev, enum tc_setup_type type,
 		return ether_tc_setup_taprio(pdata, type_data);
 	case TC_SETUP_QDISC_CBS:
 		return ether_tc_setup_cbs(pdata, type_data);
+	case TC_SETUP_BLOCK:
+		return ether_tc_setup_block(pdata, type_data);
 	default:
 		return -EOPNOTSUPP;
 	}
@@ -4185,6 +5041,10 @@ static const struct net_device_ops ether_netdev_ops = {
 #if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE)
 	.ndo_setup_tc = ether_setup_tc,
 #endif
+#ifdef ETHER_XDP
+	.ndo_bpf = ether_bpf,
+	.ndo_xdp_xmit = ether_xdp_xmit,
+#endif
 };
 
 /**
@@ -4208,13 +5068,47 @@ static int ether_napi_poll_rx(struct napi_struct *napi, int budget)
 	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
 	unsigned int chan = rx_napi->chan;
 	unsigned int more_data_avail;
+#ifdef ETHER_DIM
+	struct dim_sample dim_sample = {};
+	unsigned int rx_usecs;
+#endif
 	unsigned long flags;
 	int received = 0;
 
+#ifdef ETHER_NVGRO
+	if (atomic_xchg(&rx_napi->nvgro_purge, OSI_DISABLE) == OSI_ENABLE)
+		ether_nvgro_purge(rx_napi, false);
+#endif
 	received = osi_process_rx_completions(osi_dma, chan, budget,
 					      &more_data_avail);
-	if (received < budget) {
-		napi_complete(napi);
+	ETHER_CHAN_STAT_ADD(pdata, chan, rx_pkt_n, received);
+	if (received >= budget)
+		ETHER_CHAN_STAT_INC(pdata, chan, rx_budget_hit_n);
+#ifdef ETHER_XDP
+	if (rx_napi->xdp_redirect) {
+		rx_napi->xdp_redirect = false;
+		xdp_do_flush();
+	}
+#endif
+	if (received < budget && napi_complete_done(napi, received)) {
+#ifdef ETHER_DIM
+		if (pdata->use_adaptive_rx == OSI_ENABLE) {
+			dim_update_sample(rx_napi->dim_events++,
+					  rx_napi->dim_packets,
+					  rx_napi->dim_bytes, &dim_sample);
+			net_dim(&rx_napi->dim, dim_sample);
+			/* keep the Rx interrupt off while packets come in,
+			 * the holdoff timer polls the channel again
+			 */
+			rx_usecs = READ_ONCE(rx_napi->rx_usecs);
+			if (received > 0 && rx_usecs > 0U) {
+				hrtimer_start(&rx_napi->rx_usecs_timer,
+					      rx_usecs * NSEC_PER_USEC,
+					      HRTIMER_MODE_REL);
+				return received;
+			}
+		}
+#endif
 		raw_spin_lock_irqsave(&pdata->rlock, flags);
 		osi_handle_dma_intr(osi_dma, chan,
 				    OSI_DMA_CH_RX_INTR,
@@ -4225,6 +5119,19 @@ static int ether_napi_poll_rx(struct napi_struct *napi, int budget)
 	return received;
 }
 
+#ifdef ETHER_DIM
+static enum hrtimer_restart ether_rx_usecs_hrtimer(struct hrtimer *data)
+{
+	struct ether_rx_napi *rx_napi = container_of(data, struct ether_rx_napi,
+						     rx_usecs_timer);
+
+	if (likely(napi_schedule_prep(&rx_napi->napi)))
+		__napi_schedule_irqoff(&rx_napi->napi);
+
+	return HRTIMER_NORESTART;
+}
+#endif
+
 /**
  * @brief NAPI poll handler for transmission.
  *
@@ -4245,10 +5152,23 @@ static int ether_napi_poll_tx(struct napi_struct *napi, int budget)
 	struct ether_priv_data *pdata = tx_napi->pdata;
 	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
 	unsigned int chan = tx_napi->chan;
+#ifdef ETHER_DIM
+	struct dim_sample dim_sample = {};
+#endif
 	unsigned long flags;
 	int processed;
 
 	processed = osi_process_tx_completions(osi_dma, chan, budget);
+	if (processed >= budget)
+		ETHER_CHAN_STAT_INC(pdata, chan, tx_budget_hit_n);
+	if (tx_napi->bql_pkts > 0U) {
+		netdev_tx_completed_queue(netdev_get_tx_queue(pdata->ndev,
+							      tx_napi->qinx),
+					  tx_napi->bql_pkts,
+					  tx_napi->bql_bytes);
+		tx_napi->bql_pkts = 0U;
+		tx_napi->bql_bytes = 0U;
+	}
 
 	/* re-arm the timer if tx ring is not empty */
 	if (!osi_txring_empty(osi_dma, chan) &&
@@ -4256,12 +5176,19 @@ static int ether_napi_poll_tx(struct napi_struct *napi, int budget)
 	    atomic_read(&tx_napi->tx_usecs_timer_armed) == OSI_DISABLE) {
 		atomic_set(&tx_napi->tx_usecs_timer_armed, OSI_ENABLE);
 		hrtimer_start(&tx_napi->tx_usecs_timer,
-			      osi_dma->tx_usecs * NSEC_PER_USEC,
+			      READ_ONCE(tx_napi->tx_usecs) * NSEC_PER_USEC,
 			      HRTIMER_MODE_REL);
 	}
 
-	if (processed < budget) {
-		napi_complete(napi);
+	if (processed < budget && napi_complete_done(napi, processed)) {
+#ifdef ETHER_DIM
+		if (pdata->use_adaptive_tx == OSI_ENABLE) {
+			dim_update_sample(tx_napi->dim_events++,
+					  tx_napi->dim_packets,
+					  tx_napi->dim_bytes, &dim_sample);
+			net_dim(&tx_napi->dim, dim_sample);
+		}
+#endif
 		raw_spin_lock_irqsave(&pdata->rlock, flags);
 		osi_handle_dma_intr(osi_dma, chan,
 				    OSI_DMA_CH_TX_INTR,
@@ -4309,6 +5236,10 @@ static int ether_alloc_napi(struct ether_priv_data *pdata)
 	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
 	struct net_device *ndev = pdata->ndev;
 	struct device *dev = pdata->dev;
+#ifdef ETHER_NVGRO
+	struct ether_nvgro_flow *flow;
+	unsigned int j;
+#endif
 	unsigned int chan;
 	unsigned int i;
 
@@ -4325,8 +5256,13 @@ static int ether_alloc_napi(struct ether_priv_data *pdata)
 
 		pdata->tx_napi[chan]->pdata = pdata;
 		pdata->tx_napi[chan]->chan = chan;
-		netif_napi_add(ndev, &pdata->tx_napi[chan]->napi,
-			       ether_napi_poll_tx, 64);
+		pdata->tx_napi[chan]->qinx = i;
+		pdata->tx_napi[chan]->napi_csd.func = ether_napi_csd_func;
+		pdata->tx_napi[chan]->napi_csd.info =
+			&pdata->tx_napi[chan]->napi;
+		/* only the Rx NAPIs are busy polled by sockets */
+		netif_tx_napi_add(ndev, &pdata->tx_napi[chan]->napi,
+				  ether_napi_poll_tx, 64);
 
 		pdata->rx_napi[chan] = devm_kzalloc(dev,
 						sizeof(struct ether_rx_napi),
@@ -4338,6 +5274,16 @@ static int ether_alloc_napi(struct ether_priv_data *pdata)
 
 		pdata->rx_napi[chan]->pdata = pdata;
 		pdata->rx_napi[chan]->chan = chan;
+		pdata->rx_napi[chan]->napi_csd.func = ether_napi_csd_func;
+		pdata->rx_napi[chan]->napi_csd.info =
+			&pdata->rx_napi[chan]->napi;
+#ifdef ETHER_NVGRO
+		for (j = 0; j < NVGRO_NUM_FLOWS; j++) {
+			flow = &pdata->rx_napi[chan]->nvgro_flow[j];
+			__skb_queue_head_init(&flow->mq);
+			__skb_queue_head_init(&flow->fq);
+		}
+#endif
 		netif_napi_add(ndev, &pdata->rx_napi[chan]->napi,
 			       ether_napi_poll_rx, 64);
 	}
@@ -5530,10 +6476,12 @@ static int ether_parse_dt(struct ether_priv_data *pdata)
 	unsigned int tmp_value[OSI_MGBE_MAX_NUM_QUEUES];
 	struct device_node *np = dev->of_node;
 	int ret = -EINVAL;
-	unsigned int i, mtlq, chan, bitmap;
+	unsigned int i, j, mtlq, chan, bitmap;
 	unsigned int dt_pad_calibration_enable;
 	unsigned int dt_pad_auto_cal_pu_offset;
 	unsigned int dt_pad_auto_cal_pd_offset;
+	struct device_node *shm_np;
+	struct resource shm_res;
 	/* This variable is for DT entry which should not fail bootup */
 	int ret_val = 0;
 
@@ -5902,6 +6850,67 @@ static int ether_parse_dt(struct ether_priv_data *pdata)
 		return -EINVAL;
 	}
 
+	/* DMA channels which are driven by other Jailhouse cells. We never
+	 * initialize them, the core only steers frames to them.
+	 */
+	ret = of_property_count_u32_elems(np, "nvidia,cell-dma-chans");
+	if (ret > 0) {
+		if (ret > (int)(OSI_MGBE_MAX_NUM_CHANS -
+				osi_dma->num_dma_chans)) {
+			dev_err(dev, "too many cell DMA channels\n");
+			return -EINVAL;
+		}
+		pdata->num_cell_chans = (unsigned int)ret;
+		ret = of_property_read_u32_array(np, "nvidia,cell-dma-chans",
+						 pdata->cell_chans,
+						 pdata->num_cell_chans);
+		if (ret < 0)
+			return ret;
+
+		for (i = 0; i < pdata->num_cell_chans; i++) {
+			if (pdata->cell_chans[i] >= OSI_MGBE_MAX_NUM_CHANS) {
+				dev_err(dev, "invalid cell DMA channel %u\n",
+					pdata->cell_chans[i]);
+				return -EINVAL;
+			}
+			for (j = 0; j < osi_dma->num_dma_chans; j++) {
+				if (osi_dma->dma_chans[j] ==
+				    pdata->cell_chans[i]) {
+					dev_err(dev,
+						"cell DMA channel %u is ours\n",
+						pdata->cell_chans[i]);
+					return -EINVAL;
+				}
+			}
+		}
+
+		ret = of_property_read_u64_array(np, "nvidia,cell-dma-window",
+						 pdata->cell_dma_window, 2);
+		if (ret < 0) {
+			pdata->cell_dma_window[0] = 0;
+			pdata->cell_dma_window[1] = 0;
+		}
+	}
+
+	/* CPUs of the NAPIs of the channels */
+	for (i = 0; i < osi_dma->num_dma_chans; i++) {
+		pdata->napi_cpu[osi_dma->dma_chans[i]] = -1;
+	}
+	ret = of_property_read_u32_array(np, "nvidia,napi-cpus", tmp_value,
+					 osi_dma->num_dma_chans);
+	if (ret == 0) {
+		for (i = 0; i < osi_dma->num_dma_chans; i++) {
+			if (tmp_value[i] >= nr_cpu_ids ||
+			    !cpu_possible(tmp_value[i])) {
+				dev_err(dev, "invalid napi-cpus entry %u\n",
+					tmp_value[i]);
+				continue;
+			}
+			pdata->napi_cpu[osi_dma->dma_chans[i]] =
+				(int)tmp_value[i];
+		}
+	}
+
 	if (osi_core->mac == OSI_MAC_HW_MGBE) {
 		ret = of_property_read_u32(np, "nvidia,uphy-gbe-mode",
 					   &osi_core->uphy_gbe_mode);
@@ -6040,6 +7049,25 @@ static int ether_parse_dt(struct ether_priv_data *pdata)
 		}
 	}
 
+	/* Optional shared memory (ivshmem) to publish PTP time to cells */
+	shm_np = of_parse_phandle(np, "nvidia,ptp-shm", 0);
+	if (shm_np != NULL) {
+		ret_val = of_address_to_resource(shm_np, 0, &shm_res);
+		of_node_put(shm_np);
+		if (ret_val == 0 &&
+		    resource_size(&shm_res) >= sizeof(struct ether_ptp_shm)) {
+			pdata->ptp_shm = devm_memremap(dev, shm_res.start,
+						       resource_size(&shm_res),
+						       MEMREMAP_WB);
+			if (IS_ERR(pdata->ptp_shm)) {
+				dev_warn(dev, "failed to map PTP shared memory\n");
+				pdata->ptp_shm = NULL;
+			}
+		} else {
+			dev_warn(dev, "invalid PTP shared memory region\n");
+		}
+	}
+
 	/* Set MAC to MAC time sync role */
 	ret_val = of_property_read_u32(np, "nvidia,ptp_m2m_role",
 				       &osi_core->m2m_role);
@@ -6199,6 +7227,66 @@ static int ether_set_dma_mask(struct ether_priv_data *pdata)
 	return ret;
 }
 
+/**
+ * @brief Map the DMA window of the other cells.
+ *
+ * Algorithm: All DMA channels of the MAC issue their accesses with the
+ * stream ID of the root, so the descriptors and buffers of the cells which
+ * own the channels in nvidia,cell-dma-chans are reached through our IOMMU
+ * domain. Identity map the window given in nvidia,cell-dma-window so that
+ * the cells can program physical addresses. The window has to be kept out
+ * of the IOVA range of the DMA API, e.g. by a reserved-memory region.
+ *
+ * @param[in] pdata: OS dependent private data structure.
+ *
+ * @retval 0 on success
+ * @retval "negative value" on failure.
+ */
+static int ether_map_cell_dma(struct ether_priv_data *pdata)
+{
+	struct iommu_domain *domain = iommu_get_domain_for_dev(pdata->dev);
+	u64 base = pdata->cell_dma_window[0];
+	u64 size = pdata->cell_dma_window[1];
+	int ret;
+
+	if (domain == NULL || size == 0ULL)
+		return 0;
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0))
+	ret = iommu_map(domain, base, base, size,
+			IOMMU_READ | IOMMU_WRITE, GFP_KERNEL);
+#else
+	ret = iommu_map(domain, base, base, size,
+			IOMMU_READ | IOMMU_WRITE);
+#endif
+	if (ret < 0) {
+		dev_err(pdata->dev, "failed to map cell DMA window\n");
+		pdata->cell_dma_window[1] = 0;
+		return ret;
+	}
+
+	dev_info(pdata->dev, "cell DMA window 0x%llx+0x%llx\n", base, size);
+
+	return 0;
+}
+
+/**
+ * @brief Unmap the DMA window of the other cells.
+ *
+ * @param[in] pdata: OS dependent private data structure.
+ */
+static void ether_unmap_cell_dma(struct ether_priv_data *pdata)
+{
+	struct iommu_domain *domain = iommu_get_domain_for_dev(pdata->dev);
+
+	if (domain == NULL || pdata->cell_dma_window[1] == 0ULL)
+		return;
+
+	iommu_unmap(domain, pdata->cell_dma_window[0],
+		    pdata->cell_dma_window[1]);
+	pdata->cell_dma_window[1] = 0;
+}
+
 /**
  * @brief Set the network device feature flags
  *
@@ -6256,6 +7344,14 @@ static void ether_set_ndev_features(struct net_device *ndev,
 		features |= NETIF_F_RXHASH;
 	}
 
+	/* Flow steering through FRP by ethtool -N and tc-flower */
+	if (pdata->hw_feat.frp_sel) {
+		features |= NETIF_F_NTUPLE;
+#if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE)
+		features |= NETIF_F_HW_TC;
+#endif
+	}
+
 	/* Features available in HW */
 	ndev->hw_features = features;
 	/* Features that can be changed by user */
@@ -6475,6 +7571,10 @@ static int ether_probe(struct platform_device *pdev)
 		goto err_dma_mask;
 	}
 
+	ret = ether_map_cell_dma(pdata);
+	if (ret < 0)
+		goto err_dma_mask;
+
 	if (pdata->hw_feat.fpe_sel) {
 		ret = ether_parse_residual_queue(pdata, "nvidia,residual-queue",
 						 &osi_core->residual_queue);
@@ -6505,6 +7605,14 @@ static int ether_probe(struct platform_device *pdev)
 		goto err_dma_mask;
 	}
 
+	pdata->pcpu_stats = devm_alloc_percpu(&pdev->dev,
+					      struct ether_pcpu_stats);
+	if (pdata->pcpu_stats == NULL) {
+		dev_err(&pdev->dev, "failed to allocate channel stats\n");
+		ret = -ENOMEM;
+		goto err_dma_mask;
+	}
+
 	/* Setup the tx_usecs timer */
 	for (i = 0; i < osi_dma->num_dma_chans; i++) {
 		chan = osi_dma->dma_chans[i];
@@ -6514,6 +7622,12 @@ static int ether_probe(struct platform_device *pdev)
 			     CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 		pdata->tx_napi[chan]->tx_usecs_timer.function =
 			ether_tx_usecs_hrtimer;
+#ifdef ETHER_DIM
+		hrtimer_init(&pdata->rx_napi[chan]->rx_usecs_timer,
+			     CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		pdata->rx_napi[chan]->rx_usecs_timer.function =
+			ether_rx_usecs_hrtimer;
+#endif
 	}
 
 	ret = register_netdev(ndev);
@@ -6522,6 +7636,16 @@ static int ether_probe(struct platform_device *pdev)
 		goto err_netdev;
 	}
 
+#ifdef ETHER_NAPI_THREADED
+	if (of_property_read_bool(pdev->dev.of_node, "nvidia,threaded-napi")) {
+		rtnl_lock();
+		ret = dev_set_threaded(ndev, true);
+		rtnl_unlock();
+		if (ret < 0)
+			dev_err(&pdev->dev, "failed to enable threaded NAPI\n");
+	}
+#endif
+
 #ifdef MACSEC_SUPPORT
 	ret = macsec_probe(pdata);
 	if (ret < 0) {
@@ -6549,7 +7673,6 @@ static int ether_probe(struct platform_device *pdev)
 
 
 	raw_spin_lock_init(&pdata->rlock);
-	raw_spin_lock_init(&pdata->txts_lock);
 	init_filter_values(pdata);
 
 	if (osi_core->mac == OSI_MAC_HW_MGBE)
@@ -6574,20 +7697,15 @@ static int ether_probe(struct platform_device *pdev)
 	/* Initialization of set speed workqueue */
 	INIT_DELAYED_WORK(&pdata->set_speed_work, set_speed_work_func);
 	osi_core->hw_feature = &pdata->hw_feat;
-	INIT_LIST_HEAD(&pdata->tx_ts_skb_head);
 	INIT_DELAYED_WORK(&pdata->tx_ts_work, ether_get_tx_ts_work);
 	pdata->rx_m_enabled = false;
 	pdata->rx_pcs_m_enabled = false;
-	atomic_set(&pdata->tx_ts_ref_cnt, -1);
 	atomic_set(&pdata->set_speed_ref_cnt, OSI_DISABLE);
 	tasklet_setup(&pdata->lane_restart_task,
 		      ether_restart_lane_bringup_task);
 #ifdef ETHER_NVGRO
-	__skb_queue_head_init(&pdata->mq);
-	__skb_queue_head_init(&pdata->fq);
 	pdata->pkt_age_msec = NVGRO_AGE_THRESHOLD;
 	pdata->nvgro_timer_intrvl = NVGRO_PURGE_TIMER_THRESHOLD;
-	pdata->nvgro_dropped = 0;
 	timer_setup(&pdata->nvgro_timer, ether_nvgro_purge_timer, 0);
 #endif
 
@@ -6604,6 +7722,7 @@ err_macsec:
 	unregister_netdev(ndev);
 err_netdev:
 err_dma_mask:
+	ether_unmap_cell_dma(pdata);
 	ether_disable_clks(pdata);
 	ether_put_clks(pdata);
 	if (gpio_is_valid(pdata->phy_reset)) {
@@ -6642,6 +7761,8 @@ static int ether_remove(struct platform_device *pdev)
 	/* remove nvethernet sysfs group under /sys/devices/<ether_device>/ */
 	ether_sysfs_unregister(pdata);
 
+	ether_unmap_cell_dma(pdata);
+
 	ether_put_clks(pdata);
 
 	/* Assert MAC RST gpio */
@@ -42,11 +42,14 @@
 #include <linux/tcp.h>
 #include <linux/udp.h>
 #include <linux/of.h>
+#include <linux/of_address.h>
+#include <linux/io.h>
 #include <linux/ktime.h>
 #include <linux/hrtimer.h>
 #include <linux/version.h>
 #include <linux/list.h>
 #include <net/pkt_sched.h>
+#include <net/pkt_cls.h>
 #include <linux/tegra-ivc.h>
 #if (KERNEL_VERSION(5, 4, 0) > LINUX_VERSION_CODE)
 #include <soc/tegra/chip-id.h>
@@ -57,8 +60,39 @@
 #if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE)
 #include <net/page_pool.h>
 #define ETHER_PAGE_POOL
+/* Rx pages handed to the stack as skb frags return to their page pool */
+#if (KERNEL_VERSION(5, 15, 0) <= LINUX_VERSION_CODE)
+#define ETHER_RX_FRAGS
 #endif
 #endif
+#endif
+/* XDP runs on the page pool Rx buffers */
+#if defined(ETHER_PAGE_POOL) && IS_ENABLED(CONFIG_BPF_SYSCALL) && \
+	(KERNEL_VERSION(5, 15, 0) <= LINUX_VERSION_CODE)
+#include <linux/bpf.h>
+#include <linux/bpf_trace.h>
+#include <net/xdp.h>
+#define ETHER_XDP
+#endif
+/* Rx DMA channels can take their buffers from a device dma-buf */
+#if defined(ETHER_PAGE_POOL) && IS_ENABLED(CONFIG_DMA_SHARED_BUFFER)
+#include <linux/dma-buf.h>
+#define ETHER_RX_DMABUF
+#endif
+/* NAPI instances can run in kthreads bound to a CPU */
+#if (KERNEL_VERSION(5, 12, 0) <= LINUX_VERSION_CODE)
+#define ETHER_NAPI_THREADED
+#endif
+/* Adaptive interrupt moderation of the DMA channels */
+#if IS_ENABLED(CONFIG_DIMLIB) && \
+	(KERNEL_VERSION(5, 5, 0) <= LINUX_VERSION_CODE)
+#include <linux/dim.h>
+#define ETHER_DIM
+#endif
+/* taprio offload commands with schedule stats, ethtool MAC merge stats */
+#if (KERNEL_VERSION(6, 4, 0) <= LINUX_VERSION_CODE)
+#define ETHER_TSN_STATS
+#endif
 #include <osi_core.h>
 #include <osi_dma.h>
 #include <mmc.h>
@@ -71,6 +105,7 @@
 #include <net/inet_common.h>
 #include <uapi/linux/ip.h>
 #include <net/udp.h>
+#include <linux/jhash.h>
 #endif /* ETHER_NVGRO */
 
 /**
@@ -130,6 +165,35 @@
  */
 #define ETHER_SECTOMSEC			1000U
 
+/**
+ * @brief PTP time publish period to shared memory in milisecond.
+ */
+#define ETHER_PTP_SHM_PERIOD_MS		100U
+
+/**
+ * @brief Magic marking the published PTP time in shared memory as valid.
+ */
+#define ETHER_PTP_SHM_MAGIC		0x50545053U
+
+/**
+ * @brief PTP time for other cells, layout of the shared memory region.
+ *
+ * Reader retries while seq is odd or changed across the read, then
+ * PTP time = ptp_ns + (((CNTVCT - cntvct) * rate) >> 32).
+ */
+struct ether_ptp_shm {
+	/** ETHER_PTP_SHM_MAGIC when valid, 0 when MAC is down */
+	u32 magic;
+	/** Sequence count, odd while the writer updates */
+	u32 seq;
+	/** MAC PTP time in nano seconds at cntvct */
+	u64 ptp_ns;
+	/** System counter value captured along with ptp_ns */
+	u64 cntvct;
+	/** Nano seconds per counter tick in 32.32 fixed point */
+	u64 rate;
+};
+
 /**
  * @brief Ethernet clk rates
  */
@@ -222,8 +286,8 @@
 /* NVGRO packets purge threshold in msec */
 #define NVGRO_AGE_THRESHOLD		500
 #define NVGRO_PURGE_TIMER_THRESHOLD	5000
-#define NVGRO_RX_RUNNING		OSI_BIT(0)
-#define NVGRO_PURGE_TIMER_RUNNING	OSI_BIT(1)
+/* NVGRO flows reassembled per Rx channel, power of two */
+#define NVGRO_NUM_FLOWS			8U
 #endif
 
 /**
@@ -265,6 +329,98 @@ static inline bool valid_tx_len(unsigned int length)
 #define ETHER_TX_DESC_THRESHOLD	(MAX_SKB_FRAGS + ETHER_TX_MAX_SPLIT + 2)
 
 #define ETHER_TX_MAX_FRAME(x)	((x) / ETHER_TX_DESC_THRESHOLD)
+
+/**
+ * @addtogroup Ethernet Rx page pool buffer layout
+ *
+ * @brief With XDP, the DMA writes the packet after XDP_PACKET_HEADROOM and
+ * leaves room for the skb_shared_info of a frame redirected to a CPU map.
+ * The pages are then also mapped towards the device for XDP_TX.
+ * @{
+ */
+#ifdef ETHER_XDP
+#define ETHER_RX_HEADROOM	XDP_PACKET_HEADROOM
+#define ETHER_RX_TAILROOM	SKB_DATA_ALIGN(sizeof(struct skb_shared_info))
+#define ETHER_RX_DMA_DIR	DMA_BIDIRECTIONAL
+#else
+#define ETHER_RX_HEADROOM	0U
+#define ETHER_RX_TAILROOM	0U
+#define ETHER_RX_DMA_DIR	DMA_FROM_DEVICE
+#endif
+/** Packets up to this length are copied, headers of longer ones */
+#define ETHER_RX_HDR_LEN	256U
+/** @} */
+
+#ifdef ETHER_RX_DMABUF
+/** Low bit of a Rx buf_virt_addr holding a dma-buf slot instead of a page */
+#define ETHER_RX_DMABUF_SLOT	0x1UL
+/** Alignment of dma-buf slots */
+#define ETHER_RX_DMABUF_ALIGN	64U
+
+struct ether_rx_dmabuf;
+
+/**
+ * @brief Rx buffer carved out of a bound dma-buf
+ */
+struct ether_rx_dmabuf_slot {
+	/** dma-buf the slot belongs to */
+	struct ether_rx_dmabuf *rxd;
+	/** DMA address of the slot */
+	dma_addr_t addr;
+	/** Index of the slot in the dma-buf */
+	unsigned int idx;
+	/** Slot is reaped and not returned yet */
+	bool user;
+};
+
+/**
+ * @brief dma-buf bound as Rx buffers of a DMA channel
+ *
+ * Received frames stay in the dma-buf, the application reaps their slots
+ * and returns them once consumed. Slots whose DMA range is not contiguous
+ * are never used.
+ */
+struct ether_rx_dmabuf {
+	/** Imported dma-buf */
+	struct dma_buf *dmabuf;
+	/** Attachment of the MAC to the dma-buf */
+	struct dma_buf_attachment *attach;
+	/** DMA mapping of the attachment */
+	struct sg_table *sgt;
+	/** Size of a slot */
+	unsigned int slot_size;
+	/** Number of slots in the dma-buf */
+	unsigned int nr_slots;
+	/** Slots of the dma-buf */
+	struct ether_rx_dmabuf_slot *slots;
+	/** Protects the free slots and the completions */
+	spinlock_t lock;
+	/** Stack of free slot indices */
+	unsigned int *free;
+	/** Number of free slots */
+	unsigned int nr_free;
+	/** Ring of completions, one per slot at most */
+	struct ether_rx_dmabuf_cpl *cpl;
+	/** Oldest completion not reaped */
+	unsigned int cpl_head;
+	/** Number of completions not reaped */
+	unsigned int cpl_cnt;
+};
+#endif
+
+#ifdef ETHER_XDP
+/**
+ * @addtogroup Ethernet XDP Tx software context tags
+ *
+ * @brief Low bits of a Tx buf_virt_addr holding a struct xdp_frame instead
+ * of an skb. Frames of XDP_TX stay mapped by the Rx page pool.
+ * @{
+ */
+#define ETHER_XDP_TX_FRAME	0x1UL
+#define ETHER_XDP_TX_POOL	0x2UL
+#define ETHER_XDP_TX_TAGS	(ETHER_XDP_TX_FRAME | ETHER_XDP_TX_POOL)
+/** @} */
+#endif
 /**
  *@brief Returns count of available transmit descriptors
  *
@@ -291,6 +447,18 @@ static inline int ether_avail_txdesc_cnt(struct osi_dma_priv_data *osi_dma,
  */
 #define ETHER_STATS_TIMER		3000U
 
+/**
+ * @brief Longest period of the work queue reading the HW counters, used
+ * when the counters cannot wrap earlier at the current link speed.
+ */
+#define ETHER_STATS_TIMER_MAX		60000U
+
+/**
+ * @brief Size of a minimum sized frame on the wire in bits, including the
+ * preamble and the inter packet gap.
+ */
+#define ETHER_MIN_FRAME_WIRE_BITS	672U
+
 /**
  * @brief Timer to trigger Work queue periodically which read TX timestamp
  * for PTP packets. Timer is in milisecond.
@@ -310,11 +478,41 @@ struct ether_tx_napi {
 	struct ether_priv_data *pdata;
 	/** NAPI instance associated with transmit channel */
 	struct napi_struct napi;
+	/** Schedules the NAPI on the CPU of the channel from a VM IRQ */
+	call_single_data_t napi_csd;
 	/** SW timer associated with transmit channel */
 	struct hrtimer tx_usecs_timer;
 	/** SW timer flag associated with transmit channel */
 	atomic_t tx_usecs_timer_armed;
+	/** tx_usecs of the SW timer, adapted by DIM if enabled */
+	unsigned int tx_usecs;
+	/** Netdev Tx queue index of the channel */
+	unsigned int qinx;
+	/** Packets and bytes completed by the current poll, for BQL */
+	unsigned int bql_pkts;
+	unsigned int bql_bytes;
+#ifdef ETHER_DIM
+	/** Adaptive moderation state and samples, NAPI context only */
+	struct dim dim;
+	u64 dim_packets;
+	u64 dim_bytes;
+	u16 dim_events;
+#endif
+};
+
+#ifdef ETHER_NVGRO
+/**
+ * @brief NVGRO reassembly queues of the flows hashed to one bucket
+ */
+struct ether_nvgro_flow {
+	/** Master queue */
+	struct sk_buff_head mq;
+	/** Final queue */
+	struct sk_buff_head fq;
+	/** expected IP ID */
+	u16 expected_ip_id;
 };
+#endif
 
 /**
  *@brief DMA Receive Channel NAPI
@@ -326,6 +524,31 @@ struct ether_rx_napi {
 	struct ether_priv_data *pdata;
 	/** NAPI instance associated with transmit channel */
 	struct napi_struct napi;
+	/** Schedules the NAPI on the CPU of the channel from a VM IRQ */
+	call_single_data_t napi_csd;
+#ifdef ETHER_XDP
+	/** XDP_REDIRECT queued frames to flush at the end of the poll */
+	bool xdp_redirect;
+#endif
+#ifdef ETHER_NVGRO
+	/** NVGRO queues, only accessed from the NAPI context */
+	struct ether_nvgro_flow nvgro_flow[NVGRO_NUM_FLOWS];
+	/** Set by the purge timer, aged packets are purged by the next poll */
+	atomic_t nvgro_purge;
+	/** NVGRO packet dropped count of the channel */
+	u64 nvgro_dropped;
+#endif
+#ifdef ETHER_DIM
+	/** Adaptive moderation state and samples, NAPI context only */
+	struct dim dim;
+	u64 dim_packets;
+	u64 dim_bytes;
+	u16 dim_events;
+	/** Holdoff of the Rx interrupt after a poll, from the DIM profile */
+	unsigned int rx_usecs;
+	/** Timer polling the channel at the end of the holdoff */
+	struct hrtimer rx_usecs_timer;
+#endif
 };
 
 /**
@@ -336,6 +559,8 @@ struct ether_vm_irq_data {
 	unsigned int chan_mask;
 	/** OSD private data */
 	struct ether_priv_data *pdata;
+	/** Affinity hint of the IRQ, the CPU of its first bound channel */
+	cpumask_t cpu_mask;
 };
 
 /**
@@ -361,13 +586,10 @@ struct ether_mac_addr {
 };
 
 /**
- * @brief tx timestamp pending skb list node structure
+ * @brief tx timestamp pending skb slot. Owned through the tx_ts_busy
+ * bitmap, handed to the consumers through tx_ts_ready.
  */
-struct ether_tx_ts_skb_list {
-	/** Link list node head */
-	struct list_head list_head;
-	/** if node is in use */
-	unsigned int in_use;
+struct ether_tx_ts_slot {
 	/** skb pointer */
 	struct sk_buff *skb;
 	/** packet id to identify timestamp */
@@ -392,6 +614,117 @@ struct ether_xtra_stat_counters {
 	nveu64_t link_connect_count;
 	/** link disconnect count */
 	nveu64_t link_disconnect_count;
+#ifdef ETHER_XDP
+	/** Rx per channel packets dropped by XDP */
+	nveu64_t xdp_drop_n[OSI_MGBE_MAX_NUM_QUEUES];
+	/** Rx per channel packets sent back by XDP_TX */
+	nveu64_t xdp_tx_n[OSI_MGBE_MAX_NUM_QUEUES];
+	/** Rx per channel packets redirected by XDP */
+	nveu64_t xdp_redirect_n[OSI_MGBE_MAX_NUM_QUEUES];
+	/** Tx per channel frames queued by ndo_xdp_xmit */
+	nveu64_t xdp_xmit_n[OSI_MGBE_MAX_NUM_QUEUES];
+	/** Tx per channel XDP frames dropped for lack of descriptors */
+	nveu64_t xdp_xmit_err_n[OSI_MGBE_MAX_NUM_QUEUES];
+#endif
+};
+
+/**
+ * @brief Hot path counters of a DMA channel, kept per CPU. ethtool -S
+ * reports the sums over all CPUs.
+ */
+struct ether_chan_stats {
+	/** Rx NAPI polls which used up the budget */
+	u64 rx_budget_hit_n;
+	/** Tx NAPI polls which used up the budget */
+	u64 tx_budget_hit_n;
+	/** Rx interrupts and the packets received, for packets per IRQ */
+	u64 rx_irq_n;
+	u64 rx_pkt_n;
+	/** Rx buffers the refill could not allocate */
+	u64 rx_refill_err_n;
+	/** Page pool pages taken for Rx buffers */
+	u64 rx_page_alloc_n;
+	/** Pages given back to the pool by the driver, the packet was copied
+	 * or dropped */
+	u64 rx_page_recycle_n;
+	/** DMA mapping failures of Rx buffers and Tx packets */
+	u64 dma_map_err_n;
+	/** Packets merged by NVGRO and the merged packets handed to GRO */
+	u64 nvgro_merge_n;
+	u64 nvgro_flush_n;
+	/** Tx queue stops on a full ring */
+	u64 tx_ring_full_n;
+};
+
+/**
+ * @brief Per CPU counters of all DMA channels
+ */
+struct ether_pcpu_stats {
+	struct ether_chan_stats chan[OSI_MGBE_MAX_NUM_CHANS];
+};
+
+/**
+ * @addtogroup Per CPU channel counters
+ *
+ * @brief Updates a counter of a channel on the current CPU.
+ * @{
+ */
+#define ETHER_CHAN_STAT_ADD(pdata, ch, stat, n) \
+	this_cpu_add((pdata)->pcpu_stats->chan[(ch)].stat, (n))
+#define ETHER_CHAN_STAT_INC(pdata, ch, stat) \
+	ETHER_CHAN_STAT_ADD(pdata, ch, stat, 1U)
+/** @} */
+
+/**
+ * @addtogroup Ethernet FRP flow steering rules
+ *
+ * @brief Rules of ethtool -N and tc-flower, each a chain of FRP commands
+ * with one match field per command, an L2 address, IPv4 address or L4
+ * port. The FRP IDs of the rules start at ETHER_FRP_ID_BASE, clear of the
+ * IDs used through ETHER_CONFIG_FRP_CMD.
+ * @{
+ */
+#define ETHER_FRP_MAX_RULES	32U
+#define ETHER_FRP_MAX_FIELDS	6U
+#define ETHER_FRP_ID_BASE	0x10000
+#define ETHER_FRP_ID(loc, i)	(ETHER_FRP_ID_BASE + \
+				 (int)((loc) * ETHER_FRP_MAX_FIELDS + (i)))
+/** Offset of the IPv4 protocol field in the frame */
+#define ETHER_FRP_IP4_PROTO_OFFSET	23U
+/** @} */
+
+/**
+ * @brief One match field of a flow steering rule
+ */
+struct ether_frp_field {
+	/** OSI_FRP_MATCH_* type */
+	unsigned char match_type;
+	/** Frame offset of the data for OSI_FRP_MATCH_NORMAL */
+	unsigned char offset;
+	/** Length of match data */
+	unsigned char len;
+	/** Match data in frame byte order */
+	unsigned char match[OSI_FRP_MATCH_DATA_MAX];
+};
+
+/**
+ * @brief Flow steering rule programmed into the FRP
+ */
+struct ether_frp_rule {
+	/** Rule is programmed in HW */
+	bool used;
+	/** tc-flower cookie of the rule, 0 for ethtool rules */
+	unsigned long cookie;
+	/** ethtool spec of the rule, reported back by ETHTOOL_GRXCLSRULE */
+	struct ethtool_rx_flow_spec fs;
+	/** Number of fields, all of them have to match */
+	unsigned int num_fields;
+	/** Match fields in FRP order */
+	struct ether_frp_field field[ETHER_FRP_MAX_FIELDS];
+	/** Drop matching frames instead of routing them */
+	bool drop;
+	/** DMA channel receiving matching frames */
+	unsigned int chan;
 };
 
 /**
@@ -507,6 +840,23 @@ struct ether_priv_data {
 	unsigned int vlan_hash_filtering;
 	/** L2 filter mode */
 	unsigned int l2_filtering_mode;
+	/** CPU the NAPIs of each channel run on, -1 if not bound. Binds the
+	 * NAPI kthreads, or the softirq if the VM IRQ of the channel fires
+	 * on another CPU.
+	 */
+	int napi_cpu[OSI_MGBE_MAX_NUM_CHANS];
+	/** DMA channels owned by other Jailhouse cells, FRP steering only */
+	unsigned int cell_chans[OSI_MGBE_MAX_NUM_CHANS];
+	/** Number of DMA channels owned by other cells */
+	unsigned int num_cell_chans;
+	/** DMA window of the cells, identity mapped in the IOMMU domain */
+	u64 cell_dma_window[2];
+#ifdef ETHER_DIM
+	/** Adaptive Rx and Tx interrupt moderation, OSI_ENABLE or
+	 * OSI_DISABLE */
+	unsigned int use_adaptive_rx;
+	unsigned int use_adaptive_tx;
+#endif
 	/** PTP clock operations structure */
 	struct ptp_clock_info ptp_clock_ops;
 	/** PTP system clock */
@@ -521,6 +871,12 @@ struct ether_priv_data {
 	unsigned int max_platform_mtu;
 	/** Spin lock for PTP registers */
 	raw_spinlock_t ptp_lock;
+	/** Shared memory to publish PTP time for other cells, from DT */
+	struct ether_ptp_shm *ptp_shm;
+	/** Work to publish PTP time into ptp_shm periodically */
+	struct delayed_work ptp_shm_work;
+	/** MAC time got stepped, rate is not derived across the step */
+	bool ptp_shm_resync;
 	/** Clocks enable check */
 	bool clks_enable;
 	/** Promiscuous mode support, configuration in DT */
@@ -544,7 +900,22 @@ struct ether_priv_data {
 #ifdef ETHER_PAGE_POOL
 	/** Pointer to page pool */
 	struct page_pool *page_pool[OSI_MGBE_MAX_NUM_CHANS];
+	/** Size of a Rx buffer in its pool page, less than the page when
+	 * buffers share a page */
+	unsigned int rx_buf_truesize;
+#endif
+#ifdef ETHER_XDP
+	/** XDP program attached to the interface, NULL if none */
+	struct bpf_prog *xdp_prog;
+	/** XDP Rx queue info per DMA channel, backed by its page pool */
+	struct xdp_rxq_info xdp_rxq[OSI_MGBE_MAX_NUM_CHANS];
 #endif
+#ifdef ETHER_RX_DMABUF
+	/** dma-buf bound as Rx buffers per DMA channel, NULL if none */
+	struct ether_rx_dmabuf *rx_dmabuf[OSI_MGBE_MAX_NUM_CHANS];
+#endif
+	/** Flow steering rules by location, protected by RTNL */
+	struct ether_frp_rule frp_rules[ETHER_FRP_MAX_RULES];
 #ifdef CONFIG_DEBUG_FS
 	/** Debug fs directory pointer */
 	struct dentry *dbgfs_dir;
@@ -561,12 +932,14 @@ struct ether_priv_data {
 #endif /* MACSEC_SUPPORT */
 	/** local L2 filter address list head pointer */
 	struct ether_mac_addr mac_addr[ETHER_ADDR_REG_CNT_128];
-	/** skb tx timestamp update work queue */
+	/** skb tx timestamp update work queue, fallback for the ISR */
 	struct delayed_work tx_ts_work;
-	/** local skb list head */
-	struct list_head tx_ts_skb_head;
-	/** pre allocated memory for ether_tx_ts_skb_list list */
-	struct ether_tx_ts_skb_list tx_ts_skb[ETHER_MAX_PENDING_SKB_CNT];
+	/** pending skbs waiting for a MAC Tx timestamp */
+	struct ether_tx_ts_slot tx_ts_slot[ETHER_MAX_PENDING_SKB_CNT];
+	/** slots claimed by the Tx completion path */
+	DECLARE_BITMAP(tx_ts_busy, ETHER_MAX_PENDING_SKB_CNT);
+	/** slots filled and waiting for the timestamp */
+	DECLARE_BITMAP(tx_ts_ready, ETHER_MAX_PENDING_SKB_CNT);
 	/** Atomic variable to hold the current pad calibration status */
 	atomic_t padcal_in_progress;
 	/** eqos dev pinctrl handle */
@@ -580,24 +953,12 @@ struct ether_priv_data {
 	/** PHY reset duration delay */
 	int phy_reset_duration;
 #ifdef ETHER_NVGRO
-	/** Master queue */
-	struct sk_buff_head mq;
-	/** Master queue */
-	struct sk_buff_head fq;
-	/** expected IP ID */
-	u16 expected_ip_id;
 	/** Timer for purginging the packets in FQ and MQ based on threshold */
 	struct timer_list nvgro_timer;
-	/** Rx processing state for NVGRO */
-	atomic_t rx_state;
-	/** Purge timer state for NVGRO */
-	atomic_t timer_state;
 	/** NVGRO packet age threshold in milseconds */
 	u32 pkt_age_msec;
 	/** NVGRO purge timer interval */
 	u32 nvgro_timer_intrvl;
-	/** NVGRO packet dropped count */
-	u64 nvgro_dropped;
 #endif
 	/** Platform MDIO address */
 	unsigned int mdio_addr;
@@ -609,7 +970,7 @@ struct ether_priv_data {
 	bool rx_m_enabled;
 	/** Flag to represent rx_pcs_m clk enabled or not */
 	bool rx_pcs_m_enabled;
-	/* Timer value in msec for ether_stats_work thread */
+	/* Longest period in msec of the ether_stats_work thread */
 	unsigned int stats_timer;
 #ifdef HSI_SUPPORT
 	/** Delayed work queue for error reporting */
@@ -617,10 +978,6 @@ struct ether_priv_data {
 	/** HSI lock */
 	struct mutex hsi_lock;
 #endif
-	/** Protect critical section of TX TS SKB list */
-	raw_spinlock_t txts_lock;
-	/** Ref count for ether_get_tx_ts_func */
-	atomic_t tx_ts_ref_cnt;
 	/** Ref count for set_speed_work_func */
 	atomic_t set_speed_ref_cnt;
 	/** flag to enable logs using ethtool */
@@ -631,8 +988,204 @@ struct ether_priv_data {
 	struct tasklet_struct lane_restart_task;
 	/** xtra sw error counters */
 	struct ether_xtra_stat_counters xstats;
+	/** Per CPU hot path counters of the channels */
+	struct ether_pcpu_stats __percpu *pcpu_stats;
 };
 
+#ifdef ETHER_PAGE_POOL
+/**
+ * @brief Check if the Rx buffers of a page pool share their pages
+ *
+ * @param[in] pdata: OSD private data structure.
+ * @param[in] pool: Rx page pool of a channel.
+ *
+ * @retval true if a pool page holds several Rx buffers
+ */
+static inline bool ether_rx_buf_is_frag(struct ether_priv_data *pdata,
+					struct page_pool *pool)
+{
+	return pdata->rx_buf_truesize < (PAGE_SIZE << pool->p.order);
+}
+
+#ifdef ETHER_RX_DMABUF
+/**
+ * @brief Check if a Rx buf_virt_addr holds a dma-buf slot
+ *
+ * @param[in] buf: Rx buffer of a Rx ring software context.
+ *
+ * @retval true for a dma-buf slot, false for a page
+ */
+static inline bool ether_rx_buf_is_dmabuf(const void *buf)
+{
+	return ((unsigned long)buf & ETHER_RX_DMABUF_SLOT) != 0UL;
+}
+
+/**
+ * @brief Get the dma-buf slot of a Rx buf_virt_addr
+ *
+ * @param[in] buf: Rx buffer of a Rx ring software context.
+ *
+ * @retval dma-buf slot
+ */
+static inline struct ether_rx_dmabuf_slot *ether_rx_buf_to_slot(void *buf)
+{
+	return (struct ether_rx_dmabuf_slot *)((unsigned long)buf &
+					       ~ETHER_RX_DMABUF_SLOT);
+}
+
+/**
+ * @brief Take a free slot of a bound dma-buf
+ *
+ * @param[in] rxd: dma-buf bound to the channel.
+ * @param[out] dma_addr: DMA address the packet gets written to.
+ *
+ * @retval tagged slot on success
+ * @retval NULL if all slots are in use
+ */
+static inline void *ether_rx_dmabuf_alloc(struct ether_rx_dmabuf *rxd,
+					  dma_addr_t *dma_addr)
+{
+	struct ether_rx_dmabuf_slot *slot = NULL;
+
+	spin_lock_bh(&rxd->lock);
+	if (rxd->nr_free > 0U)
+		slot = &rxd->slots[rxd->free[--rxd->nr_free]];
+	spin_unlock_bh(&rxd->lock);
+
+	if (!slot)
+		return NULL;
+
+	*dma_addr = slot->addr;
+
+	return (void *)((unsigned long)slot | ETHER_RX_DMABUF_SLOT);
+}
+
+/**
+ * @brief Give a slot back to the free slots of its dma-buf
+ *
+ * @param[in] slot: dma-buf slot.
+ */
+static inline void ether_rx_dmabuf_put(struct ether_rx_dmabuf_slot *slot)
+{
+	struct ether_rx_dmabuf *rxd = slot->rxd;
+
+	spin_lock_bh(&rxd->lock);
+	rxd->free[rxd->nr_free++] = slot->idx;
+	spin_unlock_bh(&rxd->lock);
+}
+#endif
+
+/**
+ * @brief Allocate a Rx buffer of a channel
+ *
+ * Algorithm: Takes a slot of the dma-buf bound to the channel if any,
+ * a page pool buffer otherwise.
+ *
+ * @param[in] pdata: OSD private data structure.
+ * @param[in] chan: Rx DMA channel number.
+ * @param[out] dma_addr: DMA address the packet gets written to.
+ *
+ * @retval page holding the buffer or tagged dma-buf slot on success
+ * @retval NULL on failure
+ */
+static inline void *ether_rx_alloc_buf(struct ether_priv_data *pdata,
+				       unsigned int chan,
+				       dma_addr_t *dma_addr)
+{
+	struct page_pool *pool = pdata->page_pool[chan];
+	unsigned int offset = 0U;
+	struct page *page;
+#ifdef ETHER_RX_DMABUF
+	struct ether_rx_dmabuf *rxd = READ_ONCE(pdata->rx_dmabuf[chan]);
+
+	if (rxd)
+		return ether_rx_dmabuf_alloc(rxd, dma_addr);
+#endif
+
+#ifdef ETHER_RX_FRAGS
+	if (ether_rx_buf_is_frag(pdata, pool))
+		page = page_pool_dev_alloc_frag(pool, &offset,
+						pdata->rx_buf_truesize);
+	else
+#endif
+		page = page_pool_dev_alloc_pages(pool);
+
+	if (page)
+		*dma_addr = page_pool_get_dma_addr(page) + offset +
+			    ETHER_RX_HEADROOM;
+
+	return page;
+}
+#endif
+
+/**
+ * @brief Restart the DMA with new ring sizes
+ *
+ * Algorithm: Stops the DMA of all channels, reallocates the Tx and Rx
+ * rings and restarts the DMA. MAC, PHY, IRQs and filters are kept, so
+ * the link stays up. Falls back to the old sizes if the new rings can
+ * not be allocated.
+ *
+ * @param[in] pdata: OSD private data structure.
+ * @param[in] tx_ring_sz: Tx ring size.
+ * @param[in] rx_ring_sz: Rx ring size.
+ *
+ * @note Interface needs to be up, called with rtnl held.
+ *
+ * @retval 0 on success
+ * @retval "negative value" on failure.
+ */
+int ether_restart_dma(struct ether_priv_data *pdata,
+		      unsigned int tx_ring_sz, unsigned int rx_ring_sz);
+
+#ifdef ETHER_RX_DMABUF
+/**
+ * @brief Bind a dma-buf as Rx buffers of a DMA channel
+ *
+ * Algorithm: Attaches and maps the dma-buf, carves it into slots of
+ * slot_size and restarts the DMA so that the Rx ring of the channel gets
+ * refilled from the slots.
+ *
+ * @param[in] pdata: OSD private data structure.
+ * @param[in] chan: Rx DMA channel number.
+ * @param[in] fd: dma-buf file descriptor.
+ * @param[in] slot_size: Size of a slot.
+ *
+ * @note Interface needs to be up, called with rtnl held.
+ *
+ * @retval 0 on success
+ * @retval "negative value" on failure.
+ */
+int ether_rx_dmabuf_bind(struct ether_priv_data *pdata, unsigned int chan,
+			 int fd, unsigned int slot_size);
+
+/**
+ * @brief Unbind the dma-buf of a DMA channel
+ *
+ * Algorithm: Restarts the DMA so that the Rx ring of the channel gets
+ * refilled from its page pool, then releases the dma-buf. Slots still
+ * held by the application are dropped with it.
+ *
+ * @param[in] pdata: OSD private data structure.
+ * @param[in] chan: Rx DMA channel number.
+ *
+ * @note Called with rtnl held.
+ *
+ * @retval 0 on success
+ * @retval "negative value" on failure.
+ */
+int ether_rx_dmabuf_unbind(struct ether_priv_data *pdata, unsigned int chan);
+
+/**
+ * @brief Release the dma-bufs of all DMA channels
+ *
+ * @param[in] pdata: OSD private data structure.
+ *
+ * @note Rx rings need to be freed.
+ */
+void ether_rx_dmabuf_unbind_all(struct ether_priv_data *pdata);
+#endif
+
 /**
  * @brief Set ethtool operations
  *
@@ -769,6 +1322,54 @@ int osd_ivc_send_cmd(void *priv, ivc_msg_common_t *ivc_buf,
 
 void ether_set_rx_mode(struct net_device *dev);
 
+/**
+ * @brief Add a match field to a flow steering rule
+ *
+ * @param[in] rule: Rule being built.
+ * @param[in] match_type: OSI_FRP_MATCH_* type of the field.
+ * @param[in] offset: Frame offset for OSI_FRP_MATCH_NORMAL, else ignored.
+ * @param[in] data: Match data in frame byte order.
+ * @param[in] len: Length of data.
+ *
+ * @note ETHER_FRP_MAX_FIELDS covers every field the parsers can add.
+ */
+void ether_frp_rule_add_field(struct ether_frp_rule *rule,
+			      unsigned char match_type, unsigned char offset,
+			      const void *data, unsigned char len);
+
+/**
+ * @brief Program a flow steering rule into the FRP
+ *
+ * Algorithm: Adds one FRP command per field. All but the last one bypass
+ * the parser first, then they are linked to the next field in order, so
+ * that frames matching a part of the rule keep the default path while it
+ * is set up. A rule already at loc is replaced.
+ *
+ * @param[in] pdata: Pointer to private data structure.
+ * @param[in] loc: Rule location.
+ * @param[in] rule: Rule to program, copied to pdata->frp_rules.
+ *
+ * @note MAC interface should be up. Called under RTNL.
+ *
+ * @retval 0 on success
+ * @retval "negative value" on Failure
+ */
+int ether_frp_rule_add(struct ether_priv_data *pdata, unsigned int loc,
+		       const struct ether_frp_rule *rule);
+
+/**
+ * @brief Remove a flow steering rule from the FRP
+ *
+ * @param[in] pdata: Pointer to private data structure.
+ * @param[in] loc: Rule location.
+ *
+ * @note Called under RTNL.
+ *
+ * @retval 0 on success
+ * @retval "negative value" on Failure
+ */
+int ether_frp_rule_del(struct ether_priv_data *pdata, unsigned int loc);
+
 #if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE)
 /**
  * @brief Function to configure traffic class
@@ -804,6 +1405,24 @@ int ether_tc_setup_taprio(struct ether_priv_data *pdata,
 int ether_tc_setup_cbs(struct ether_priv_data *pdata,
 		       struct tc_cbs_qopt_offload *qopt);
 
+/**
+ * @brief Function to offload tc-flower filters
+ *
+ * Algorithm: Binds the ingress block and translates flower filters with
+ * skip_sw into FRP flow steering rules. Frames are routed to the DMA
+ * channel given by hw_tc, or dropped.
+ *
+ * @param[in] pdata: Pointer to private data structure.
+ * @param[in] f: Pointer to flow block offload data.
+ *
+ * @note MAC interface should be up.
+ *
+ * @retval 0 on success
+ * @retval "negative value" on Failure
+ */
+int ether_tc_setup_block(struct ether_priv_data *pdata,
+			 struct flow_block_offload *f);
+
 #endif
 
 /**
@@ -817,8 +1436,78 @@ int ether_tc_setup_cbs(struct ether_priv_data *pdata,
  * @retval EAGAIN on Failure
  */
 int ether_get_tx_ts(struct ether_priv_data *pdata);
+
+/**
+ * @brief Complete a pending Tx timestamp slot
+ *
+ * Algorithm: Fetch the timestamp of the slot packet id from OSI and pass
+ * it to the stack, or drop the skb once it waited for a second.
+ *
+ * @param[in] pdata: Pointer to private data structure.
+ * @param[in] idx: Slot index.
+ *
+ * @retval true when the slot got released
+ * @retval false when the timestamp is not there yet
+ */
+bool ether_tx_ts_slot_done(struct ether_priv_data *pdata, unsigned int idx);
 void ether_restart_lane_bringup_task(struct tasklet_struct *t);
+/**
+ * @brief Check whether received frames may be steered to a DMA channel.
+ *
+ * @param[in] pdata: OSD private data.
+ * @param[in] chan: DMA channel number.
+ *
+ * @retval true if the channel is one of ours or owned by another cell
+ * @retval false otherwise
+ */
+bool ether_is_rx_steer_chan(struct ether_priv_data *pdata,
+			    unsigned int chan);
+#ifdef ETHER_NAPI_THREADED
+/**
+ * @brief Bind the NAPI kthreads of a channel to its configured CPU.
+ *
+ * @param[in] pdata: OSD private data.
+ * @param[in] chan: DMA channel number.
+ *
+ * @note Called with RTNL held. Does nothing for unthreaded NAPI.
+ */
+void ether_napi_set_affinity(struct ether_priv_data *pdata,
+			     unsigned int chan);
+#endif
 #ifdef ETHER_NVGRO
 void ether_nvgro_purge_timer(struct timer_list *t);
+
+/**
+ * @brief ether_nvgro_purge - Purge the NVGRO queues of a Rx channel.
+ *
+ * @param[in] rx_napi: Rx NAPI of the channel.
+ * @param[in] all: Purge all packets instead of the aged ones only.
+ *
+ * @note Called from the NAPI context of the channel, or with it disabled.
+ */
+void ether_nvgro_purge(struct ether_rx_napi *rx_napi, bool all);
 #endif /* ETHER_NVGRO */
+#ifdef ETHER_XDP
+/**
+ * @brief Sends back a frame of the Rx page pool for XDP_TX.
+ *
+ * @param[in] pdata: Pointer to private data structure.
+ * @param[in] xdpf: Frame converted from the Rx XDP buffer.
+ *
+ * @note Called from the Rx NAPI context.
+ *
+ * @retval 0 on success
+ * @retval "negative value" if the frame was not queued.
+ */
+int ether_xdp_tx(struct ether_priv_data *pdata, struct xdp_frame *xdpf);
+
+/**
+ * @brief Releases an XDP frame whose transmission completed.
+ *
+ * @param[in] pdata: Pointer to private data structure.
+ * @param[in] swcx: Tx software context tagged with ETHER_XDP_TX_FRAME.
+ */
+void ether_xdp_tx_complete(struct ether_priv_data *pdata,
+			   const struct osi_tx_swcx *swcx);
+#endif /* ETHER_XDP */
 #endif /* ETHER_LINUX_H */
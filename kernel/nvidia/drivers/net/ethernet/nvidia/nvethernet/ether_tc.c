@@ -16,12 +16,178 @@
 
 #include "ether_linux.h"
 
+void ether_frp_rule_add_field(struct ether_frp_rule *rule,
+			      unsigned char match_type, unsigned char offset,
+			      const void *data, unsigned char len)
+{
+	struct ether_frp_field *field;
+
+	if (WARN_ON_ONCE((rule->num_fields >= ETHER_FRP_MAX_FIELDS) ||
+			 (len > OSI_FRP_MATCH_DATA_MAX)))
+		return;
+
+	field = &rule->field[rule->num_fields++];
+	field->match_type = match_type;
+	field->offset = offset;
+	field->len = len;
+	memcpy(field->match, data, len);
+}
+
+/**
+ * @brief Issue the FRP command of a rule field
+ *
+ * @param[in] pdata: Pointer to private data structure.
+ * @param[in] loc: Rule location.
+ * @param[in] rule: Rule of the field.
+ * @param[in] i: Field index.
+ * @param[in] cmd: OSI_FRP_CMD_* command.
+ * @param[in] mode: OSI_FRP_MODE_* filter mode.
+ *
+ * @retval 0 on success
+ * @retval -EIO on Failure
+ */
+static int ether_frp_field_cmd(struct ether_priv_data *pdata, unsigned int loc,
+			       const struct ether_frp_rule *rule,
+			       unsigned int i, unsigned int cmd,
+			       unsigned char mode)
+{
+	const struct ether_frp_field *field = &rule->field[i];
+	struct osi_ioctl ioctl_data = {};
+	struct osi_core_frp_cmd *frp_cmd = &ioctl_data.frp_cmd;
+
+	frp_cmd->cmd = cmd;
+	frp_cmd->frp_id = ETHER_FRP_ID(loc, i);
+	if (cmd != OSI_FRP_CMD_DEL) {
+		memcpy(frp_cmd->match, field->match, field->len);
+		frp_cmd->match_length = field->len;
+		frp_cmd->match_type = field->match_type;
+		frp_cmd->offset = field->offset;
+		frp_cmd->filter_mode = mode;
+		frp_cmd->next_frp_id = ETHER_FRP_ID(loc, i + 1U);
+		frp_cmd->dma_sel = rule->drop ? 0U : OSI_BIT(rule->chan);
+	}
+
+	ioctl_data.cmd = OSI_CMD_CONFIG_FRP;
+	if (osi_handle_ioctl(pdata->osi_core, &ioctl_data) < 0)
+		return -EIO;
+
+	return 0;
+}
+
+int ether_frp_rule_add(struct ether_priv_data *pdata, unsigned int loc,
+		       const struct ether_frp_rule *rule)
+{
+	unsigned char last_mode = rule->drop ? OSI_FRP_MODE_DROP :
+					       OSI_FRP_MODE_ROUTE;
+	unsigned int n = rule->num_fields;
+	unsigned int i, added;
+	int ret;
+
+	if (pdata->hw_feat.frp_sel == OSI_DISABLE)
+		return -EOPNOTSUPP;
+
+	if ((loc >= ETHER_FRP_MAX_RULES) || (n == 0U))
+		return -EINVAL;
+
+	if (pdata->frp_rules[loc].used) {
+		ret = ether_frp_rule_del(pdata, loc);
+		if (ret < 0)
+			return ret;
+	}
+
+	for (added = 0; added < n; added++) {
+		ret = ether_frp_field_cmd(pdata, loc, rule, added,
+					  OSI_FRP_CMD_ADD,
+					  (added + 1U < n) ?
+					  OSI_FRP_MODE_BYPASS : last_mode);
+		if (ret < 0)
+			goto err;
+	}
+
+	for (i = 0; i + 1U < n; i++) {
+		ret = ether_frp_field_cmd(pdata, loc, rule, i,
+					  OSI_FRP_CMD_UPDATE,
+					  OSI_FRP_MODE_LINK);
+		if (ret < 0)
+			goto err;
+	}
+
+	pdata->frp_rules[loc] = *rule;
+	pdata->frp_rules[loc].used = true;
+
+	return 0;
+
+err:
+	for (i = 0; i < added; i++)
+		ether_frp_field_cmd(pdata, loc, rule, i, OSI_FRP_CMD_DEL, 0);
+
+	dev_err(pdata->dev, "failed to program FRP rule %u\n", loc);
+	return ret;
+}
+
+int ether_frp_rule_del(struct ether_priv_data *pdata, unsigned int loc)
+{
+	struct ether_frp_rule *rule;
+	unsigned int i;
+	int ret = 0;
+
+	if (loc >= ETHER_FRP_MAX_RULES)
+		return -EINVAL;
+
+	rule = &pdata->frp_rules[loc];
+	if (!rule->used)
+		return -ENOENT;
+
+	/* The first field goes first, nothing links to it */
+	for (i = 0; i < rule->num_fields; i++) {
+		if (ether_frp_field_cmd(pdata, loc, rule, i,
+					OSI_FRP_CMD_DEL, 0) < 0)
+			ret = -EIO;
+	}
+
+	memset(rule, 0, sizeof(*rule));
+
+	return ret;
+}
+
 #if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE)
+#ifdef ETHER_TSN_STATS
+/**
+ * @brief Fill taprio schedule stats of a traffic class
+ *
+ * Algorithm: Frames which do not fit in the gate window (HLBF) are
+ * reported as window drops, a queue starved by the schedule (HLBS) as
+ * overrun. Counters of all classes are summed up for tc < 0.
+ *
+ * @param[in] pdata: Pointer to private data structure.
+ * @param[in] tc: Traffic class, negative for all of them.
+ * @param[out] stats: taprio stats.
+ */
+static void ether_tc_taprio_stats(struct ether_priv_data *pdata, int tc,
+				  struct tc_taprio_qopt_stats *stats)
+{
+	struct osi_core_priv_data *osi_core = pdata->osi_core;
+	int i;
+
+	for (i = 0; i < OSI_MAX_TC_NUM; i++) {
+		if ((tc >= 0) && (i != tc))
+			continue;
+
+		stats->window_drops += osi_core->stats.hlbf_q[i];
+		stats->tx_overruns += osi_core->stats.hlbs_q[i];
+	}
+}
+#endif /* ETHER_TSN_STATS */
+
 int ether_tc_setup_taprio(struct ether_priv_data *pdata,
 			  struct tc_taprio_qopt_offload *qopt)
 {
 	struct osi_core_priv_data *osi_core = pdata->osi_core;
 	unsigned int fpe_required = OSI_DISABLE;
+	/* Queues open in entries holding preemptible traffic are express */
+	unsigned int hold_gates = 0x0U;
+	unsigned int all_gates = 0x0U;
+	bool enable;
 	struct osi_ioctl fpe_ioctl_data = {};
 	struct osi_ioctl est_ioctl_data = {};
 	unsigned long cycle_time = 0x0U;
@@ -35,13 +201,38 @@ int ether_tc_setup_taprio(struct ether_priv_data *pdata,
 	unsigned int wid = 24U;
 	struct timespec64 time;
 	unsigned long ctr;
-	int i, ret = 0;
+	int i, ret = 0, err;
 
 	if (qopt == NULL) {
 		netdev_err(pdata->ndev, "invalid input argument\n");
 		return -EINVAL;
 	}
 
+#ifdef ETHER_TSN_STATS
+	switch (qopt->cmd) {
+	case TAPRIO_CMD_REPLACE:
+		enable = true;
+		break;
+	case TAPRIO_CMD_DESTROY:
+		enable = false;
+		break;
+	case TAPRIO_CMD_STATS:
+		ether_tc_taprio_stats(pdata, -1, &qopt->stats);
+		return 0;
+	case TAPRIO_CMD_QUEUE_STATS:
+		if ((qopt->queue_stats.queue < 0) ||
+		    (qopt->queue_stats.queue >= OSI_MAX_TC_NUM))
+			return -EINVAL;
+		ether_tc_taprio_stats(pdata, qopt->queue_stats.queue,
+				      &qopt->queue_stats.stats);
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+#else
+	enable = qopt->enable;
+#endif /* ETHER_TSN_STATS */
+
 	if ((osi_core->hw_feature != OSI_NULL) &&
 	    (pdata->hw_feat.est_sel == OSI_DISABLE)) {
 		netdev_err(pdata->ndev, "EST not supported in HW\n");
@@ -49,6 +240,12 @@ int ether_tc_setup_taprio(struct ether_priv_data *pdata,
 		goto done;
 	}
 
+	/* This code is to disable TSN, User space is asking to disable
+	 */
+	if (!enable) {
+		goto disable;
+	}
+
 	if (qopt->num_entries >= OSI_GCL_SIZE_256) {
 		netdev_err(pdata->ndev, "invalid number of GCL entries\n");
 		ret = -ERANGE;
@@ -70,14 +267,8 @@ int ether_tc_setup_taprio(struct ether_priv_data *pdata,
 	memset(&est_ioctl_data.est, 0x0, sizeof(struct osi_est_config));
 	memset(&est_ioctl_data.fpe, 0x0, sizeof(struct osi_fpe_config));
 
-	/* This code is to disable TSN, User space is asking to disable
-	 */
-	if (!qopt->enable) {
-		goto disable;
-	}
-
 	est_ioctl_data.est.llr = qopt->num_entries;
-	est_ioctl_data.est.en_dis = qopt->enable;
+	est_ioctl_data.est.en_dis = enable;
 
 	for (i = 0U; i < est_ioctl_data.est.llr; i++) {
 		cycle_time = qopt->entries[i].interval;
@@ -93,6 +284,7 @@ int ether_tc_setup_taprio(struct ether_priv_data *pdata,
 			}
 			break;
 		case TC_TAPRIO_CMD_SET_AND_HOLD:
+			hold_gates |= gates;
 			gates |= OSI_BIT(0);
 			fpe_required = OSI_ENABLE;
 			break;
@@ -106,6 +298,7 @@ int ether_tc_setup_taprio(struct ether_priv_data *pdata,
 			goto done;
 		}
 
+		all_gates |= gates;
 		est_ioctl_data.est.gcl[i] = cycle_time | (gates << wid);
 		if (est_ioctl_data.est.gcl[i] > wid_val) {
 			netdev_err(pdata->ndev, "invalid GCL creation\n");
@@ -135,7 +328,15 @@ int ether_tc_setup_taprio(struct ether_priv_data *pdata,
 
 	if (fpe_required == OSI_ENABLE) {
 		fpe_ioctl_data.fpe.rq = osi_core->residual_queue;
-		fpe_ioctl_data.fpe.tx_queue_preemption_enable = 0x1;
+		/* Bit 0 of the gates carries hold/release, queue 0 stays
+		 * preemptible. Other queues are preemptible when they are
+		 * never open while preemptible traffic is held.
+		 */
+		fpe_ioctl_data.fpe.tx_queue_preemption_enable =
+			((all_gates & ~hold_gates) | OSI_BIT(0)) &
+			GENMASK(osi_core->num_mtl_queues - 1U, 0);
+		netdev_dbg(pdata->ndev, "preemptible queues 0x%x\n",
+			   fpe_ioctl_data.fpe.tx_queue_preemption_enable);
 		fpe_ioctl_data.cmd = OSI_CMD_CONFIG_FPE;
 		ret = osi_handle_ioctl(osi_core, &fpe_ioctl_data);
 		if (ret < 0) {
@@ -160,12 +361,17 @@ int ether_tc_setup_taprio(struct ether_priv_data *pdata,
 disable:
 	est_ioctl_data.est.en_dis = false;
 	est_ioctl_data.cmd = OSI_CMD_CONFIG_EST;
-	ret = osi_handle_ioctl(osi_core, &est_ioctl_data);
-	if ((ret >= 0) && (fpe_required == OSI_ENABLE)) {
+	err = osi_handle_ioctl(osi_core, &est_ioctl_data);
+	/* FPE was turned on by an earlier schedule if not by this one */
+	if ((err >= 0) && pdata->hw_feat.fpe_sel) {
+		fpe_ioctl_data.fpe.rq = osi_core->residual_queue;
 		fpe_ioctl_data.fpe.tx_queue_preemption_enable = 0x0;
 		fpe_ioctl_data.cmd = OSI_CMD_CONFIG_FPE;
-		ret = osi_handle_ioctl(osi_core, &fpe_ioctl_data);
+		err = osi_handle_ioctl(osi_core, &fpe_ioctl_data);
 	}
+	/* Keep the error which got us here */
+	if (ret >= 0)
+		ret = err;
 
 done:
 	return ret;
@@ -253,4 +459,265 @@ int ether_tc_setup_cbs(struct ether_priv_data *pdata,
 
 	return osi_handle_ioctl(osi_core, &ioctl_data);
 }
+
+/**
+ * @brief Translate a flower match into a flow steering rule
+ *
+ * @param[in] pdata: Pointer to private data structure.
+ * @param[in] cls: Flower classifier offload data.
+ * @param[out] rule: Rule built from the match.
+ *
+ * @retval 0 on success
+ * @retval "negative value" if the match cannot be offloaded.
+ */
+static int ether_tc_flower_parse(struct ether_priv_data *pdata,
+				 struct flow_cls_offload *cls,
+				 struct ether_frp_rule *rule)
+{
+	struct flow_rule *frule = flow_cls_offload_flow_rule(cls);
+	struct netlink_ext_ack *extack = cls->common.extack;
+	struct flow_dissector *dissector = frule->match.dissector;
+	unsigned char sport_type = OSI_FRP_MATCH_L4_S_UPORT;
+	unsigned char dport_type = OSI_FRP_MATCH_L4_D_UPORT;
+	unsigned char ip_proto = 0;
+
+	if (dissector->used_keys &
+	    ~(BIT(FLOW_DISSECTOR_KEY_CONTROL) |
+	      BIT(FLOW_DISSECTOR_KEY_BASIC) |
+	      BIT(FLOW_DISSECTOR_KEY_ETH_ADDRS) |
+	      BIT(FLOW_DISSECTOR_KEY_IPV4_ADDRS) |
+	      BIT(FLOW_DISSECTOR_KEY_PORTS))) {
+		NL_SET_ERR_MSG_MOD(extack, "Unsupported flower key");
+		return -EOPNOTSUPP;
+	}
+
+	if (flow_rule_match_key(frule, FLOW_DISSECTOR_KEY_BASIC)) {
+		struct flow_match_basic match;
+
+		flow_rule_match_basic(frule, &match);
+		if (match.mask->n_proto &&
+		    (match.key->n_proto != htons(ETH_P_IP))) {
+			NL_SET_ERR_MSG_MOD(extack, "Only IPv4 is supported");
+			return -EOPNOTSUPP;
+		}
+
+		if (match.mask->ip_proto) {
+			if (match.key->ip_proto == IPPROTO_TCP) {
+				sport_type = OSI_FRP_MATCH_L4_S_TPORT;
+				dport_type = OSI_FRP_MATCH_L4_D_TPORT;
+			} else if (match.key->ip_proto != IPPROTO_UDP) {
+				NL_SET_ERR_MSG_MOD(extack,
+						   "Only TCP and UDP are supported");
+				return -EOPNOTSUPP;
+			}
+			ip_proto = match.key->ip_proto;
+		}
+	}
+
+	if (flow_rule_match_key(frule, FLOW_DISSECTOR_KEY_ETH_ADDRS)) {
+		struct flow_match_eth_addrs match;
+
+		flow_rule_match_eth_addrs(frule, &match);
+		if ((!is_zero_ether_addr(match.mask->dst) &&
+		     !is_broadcast_ether_addr(match.mask->dst)) ||
+		    (!is_zero_ether_addr(match.mask->src) &&
+		     !is_broadcast_ether_addr(match.mask->src)))
+			goto err_mask;
+
+		if (!is_zero_ether_addr(match.mask->dst))
+			ether_frp_rule_add_field(rule, OSI_FRP_MATCH_L2_DA, 0,
+						 match.key->dst, ETH_ALEN);
+		if (!is_zero_ether_addr(match.mask->src))
+			ether_frp_rule_add_field(rule, OSI_FRP_MATCH_L2_SA, 0,
+						 match.key->src, ETH_ALEN);
+	}
+
+	if (flow_rule_match_key(frule, FLOW_DISSECTOR_KEY_IPV4_ADDRS)) {
+		struct flow_match_ipv4_addrs match;
+
+		flow_rule_match_ipv4_addrs(frule, &match);
+		if ((match.mask->src && (match.mask->src != htonl(~0U))) ||
+		    (match.mask->dst && (match.mask->dst != htonl(~0U))))
+			goto err_mask;
+
+		if (match.mask->src)
+			ether_frp_rule_add_field(rule, OSI_FRP_MATCH_L3_SIP, 0,
+						 &match.key->src, 4U);
+		if (match.mask->dst)
+			ether_frp_rule_add_field(rule, OSI_FRP_MATCH_L3_DIP, 0,
+						 &match.key->dst, 4U);
+	}
+
+	if (flow_rule_match_key(frule, FLOW_DISSECTOR_KEY_PORTS)) {
+		struct flow_match_ports match;
+
+		flow_rule_match_ports(frule, &match);
+		if (!ip_proto) {
+			NL_SET_ERR_MSG_MOD(extack, "Ports need ip_proto");
+			return -EOPNOTSUPP;
+		}
+
+		if ((match.mask->src && (match.mask->src != htons(~0U))) ||
+		    (match.mask->dst && (match.mask->dst != htons(~0U))))
+			goto err_mask;
+
+		if (match.mask->src)
+			ether_frp_rule_add_field(rule, sport_type, 0,
+						 &match.key->src, 2U);
+		if (match.mask->dst)
+			ether_frp_rule_add_field(rule, dport_type, 0,
+						 &match.key->dst, 2U);
+	}
+
+	/* A protocol without ports matches the IPv4 protocol field */
+	if (ip_proto && (rule->num_fields == 0U))
+		ether_frp_rule_add_field(rule, OSI_FRP_MATCH_NORMAL,
+					 ETHER_FRP_IP4_PROTO_OFFSET,
+					 &ip_proto, 1U);
+
+	if (rule->num_fields == 0U) {
+		NL_SET_ERR_MSG_MOD(extack, "Match is empty");
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+
+err_mask:
+	NL_SET_ERR_MSG_MOD(extack, "Only full masks are supported");
+	return -EOPNOTSUPP;
+}
+
+/**
+ * @brief Offload a flower filter into a free FRP rule location
+ *
+ * @param[in] pdata: Pointer to private data structure.
+ * @param[in] cls: Flower classifier offload data.
+ *
+ * @retval 0 on success
+ * @retval "negative value" on Failure
+ */
+static int ether_tc_flower_replace(struct ether_priv_data *pdata,
+				   struct flow_cls_offload *cls)
+{
+	struct flow_rule *frule = flow_cls_offload_flow_rule(cls);
+	struct netlink_ext_ack *extack = cls->common.extack;
+	struct ether_frp_rule rule = {};
+	const struct flow_action_entry *act;
+	unsigned int loc = ETHER_FRP_MAX_RULES;
+	unsigned int i;
+	int ret;
+
+	ret = ether_tc_flower_parse(pdata, cls, &rule);
+	if (ret < 0)
+		return ret;
+
+	if (frule->action.num_entries > 1U) {
+		NL_SET_ERR_MSG_MOD(extack, "Only one action is supported");
+		return -EOPNOTSUPP;
+	}
+
+	if (frule->action.num_entries == 1U) {
+		act = &frule->action.entries[0];
+		if (act->id != FLOW_ACTION_DROP) {
+			NL_SET_ERR_MSG_MOD(extack, "Only drop or hw_tc");
+			return -EOPNOTSUPP;
+		}
+		rule.drop = true;
+	} else {
+		/* hw_tc selects the DMA channel */
+		rule.chan = TC_H_MIN(cls->classid) - TC_H_MIN_PRIORITY;
+		if (!ether_is_rx_steer_chan(pdata, rule.chan)) {
+			NL_SET_ERR_MSG_MOD(extack, "hw_tc is no DMA channel");
+			return -EINVAL;
+		}
+	}
+
+	/* Flower rules fill the locations from the top, a replaced filter
+	 * keeps its location.
+	 */
+	for (i = ETHER_FRP_MAX_RULES; i > 0U; i--) {
+		if (pdata->frp_rules[i - 1U].cookie == cls->cookie) {
+			loc = i - 1U;
+			break;
+		}
+
+		if ((loc == ETHER_FRP_MAX_RULES) &&
+		    !pdata->frp_rules[i - 1U].used)
+			loc = i - 1U;
+	}
+
+	if (loc == ETHER_FRP_MAX_RULES) {
+		NL_SET_ERR_MSG_MOD(extack, "No free FRP rule");
+		return -ENOSPC;
+	}
+
+	rule.cookie = cls->cookie;
+	return ether_frp_rule_add(pdata, loc, &rule);
+}
+
+/**
+ * @brief Remove an offloaded flower filter
+ *
+ * @param[in] pdata: Pointer to private data structure.
+ * @param[in] cls: Flower classifier offload data.
+ *
+ * @retval 0 on success
+ * @retval "negative value" on Failure
+ */
+static int ether_tc_flower_destroy(struct ether_priv_data *pdata,
+				   struct flow_cls_offload *cls)
+{
+	unsigned int i;
+
+	for (i = 0; i < ETHER_FRP_MAX_RULES; i++) {
+		if (pdata->frp_rules[i].used &&
+		    (pdata->frp_rules[i].cookie == cls->cookie))
+			return ether_frp_rule_del(pdata, i);
+	}
+
+	return -ENOENT;
+}
+
+/**
+ * @brief Flow block callback of the ingress block
+ *
+ * @param[in] type: TC setup type.
+ * @param[in] type_data: Classifier offload data.
+ * @param[in] cb_priv: Pointer to private data structure.
+ *
+ * @retval 0 on success
+ * @retval "negative value" on Failure
+ */
+static int ether_tc_block_cb(enum tc_setup_type type, void *type_data,
+			     void *cb_priv)
+{
+	struct ether_priv_data *pdata = cb_priv;
+	struct flow_cls_offload *cls = type_data;
+
+	if ((type != TC_SETUP_CLSFLOWER) ||
+	    !tc_cls_can_offload_and_chain0(pdata->ndev, &cls->common))
+		return -EOPNOTSUPP;
+
+	switch (cls->command) {
+	case FLOW_CLS_REPLACE:
+		return ether_tc_flower_replace(pdata, cls);
+	case FLOW_CLS_DESTROY:
+		return ether_tc_flower_destroy(pdata, cls);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static LIST_HEAD(ether_tc_block_cb_list);
+
+int ether_tc_setup_block(struct ether_priv_data *pdata,
+			 struct flow_block_offload *f)
+{
+	if (pdata->hw_feat.frp_sel == OSI_DISABLE)
+		return -EOPNOTSUPP;
+
+	return flow_block_cb_setup_simple(f, &ether_tc_block_cb_list,
+					  ether_tc_block_cb, pdata, pdata,
+					  true);
+}
 #endif
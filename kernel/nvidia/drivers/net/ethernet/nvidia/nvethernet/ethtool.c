@@ -231,6 +231,58 @@ static const struct ether_stats ether_gstrings_stats[] = {
 	ETHER_EXTRA_STAT(rx_normal_irq_n[9]),
 	ETHER_EXTRA_STAT(link_disconnect_count),
 	ETHER_EXTRA_STAT(link_connect_count),
+#ifdef ETHER_XDP
+	ETHER_EXTRA_STAT(xdp_drop_n[0]),
+	ETHER_EXTRA_STAT(xdp_drop_n[1]),
+	ETHER_EXTRA_STAT(xdp_drop_n[2]),
+	ETHER_EXTRA_STAT(xdp_drop_n[3]),
+	ETHER_EXTRA_STAT(xdp_drop_n[4]),
+	ETHER_EXTRA_STAT(xdp_drop_n[5]),
+	ETHER_EXTRA_STAT(xdp_drop_n[6]),
+	ETHER_EXTRA_STAT(xdp_drop_n[7]),
+	ETHER_EXTRA_STAT(xdp_drop_n[8]),
+	ETHER_EXTRA_STAT(xdp_drop_n[9]),
+	ETHER_EXTRA_STAT(xdp_tx_n[0]),
+	ETHER_EXTRA_STAT(xdp_tx_n[1]),
+	ETHER_EXTRA_STAT(xdp_tx_n[2]),
+	ETHER_EXTRA_STAT(xdp_tx_n[3]),
+	ETHER_EXTRA_STAT(xdp_tx_n[4]),
+	ETHER_EXTRA_STAT(xdp_tx_n[5]),
+	ETHER_EXTRA_STAT(xdp_tx_n[6]),
+	ETHER_EXTRA_STAT(xdp_tx_n[7]),
+	ETHER_EXTRA_STAT(xdp_tx_n[8]),
+	ETHER_EXTRA_STAT(xdp_tx_n[9]),
+	ETHER_EXTRA_STAT(xdp_redirect_n[0]),
+	ETHER_EXTRA_STAT(xdp_redirect_n[1]),
+	ETHER_EXTRA_STAT(xdp_redirect_n[2]),
+	ETHER_EXTRA_STAT(xdp_redirect_n[3]),
+	ETHER_EXTRA_STAT(xdp_redirect_n[4]),
+	ETHER_EXTRA_STAT(xdp_redirect_n[5]),
+	ETHER_EXTRA_STAT(xdp_redirect_n[6]),
+	ETHER_EXTRA_STAT(xdp_redirect_n[7]),
+	ETHER_EXTRA_STAT(xdp_redirect_n[8]),
+	ETHER_EXTRA_STAT(xdp_redirect_n[9]),
+	ETHER_EXTRA_STAT(xdp_xmit_n[0]),
+	ETHER_EXTRA_STAT(xdp_xmit_n[1]),
+	ETHER_EXTRA_STAT(xdp_xmit_n[2]),
+	ETHER_EXTRA_STAT(xdp_xmit_n[3]),
+	ETHER_EXTRA_STAT(xdp_xmit_n[4]),
+	ETHER_EXTRA_STAT(xdp_xmit_n[5]),
+	ETHER_EXTRA_STAT(xdp_xmit_n[6]),
+	ETHER_EXTRA_STAT(xdp_xmit_n[7]),
+	ETHER_EXTRA_STAT(xdp_xmit_n[8]),
+	ETHER_EXTRA_STAT(xdp_xmit_n[9]),
+	ETHER_EXTRA_STAT(xdp_xmit_err_n[0]),
+	ETHER_EXTRA_STAT(xdp_xmit_err_n[1]),
+	ETHER_EXTRA_STAT(xdp_xmit_err_n[2]),
+	ETHER_EXTRA_STAT(xdp_xmit_err_n[3]),
+	ETHER_EXTRA_STAT(xdp_xmit_err_n[4]),
+	ETHER_EXTRA_STAT(xdp_xmit_err_n[5]),
+	ETHER_EXTRA_STAT(xdp_xmit_err_n[6]),
+	ETHER_EXTRA_STAT(xdp_xmit_err_n[7]),
+	ETHER_EXTRA_STAT(xdp_xmit_err_n[8]),
+	ETHER_EXTRA_STAT(xdp_xmit_err_n[9]),
+#endif
 };
 
 /**
@@ -238,6 +290,72 @@ static const struct ether_stats ether_gstrings_stats[] = {
  */
 #define ETHER_EXTRA_STAT_LEN OSI_ARRAY_SIZE(ether_gstrings_stats)
 
+/**
+ * @brief Name of per channel hot path stat, reported as chan<N>_<name>
+ * with length not more than ETH_GSTRING_LEN
+ */
+#if KERNEL_VERSION(5, 5, 0) > LINUX_VERSION_CODE
+#define ETHER_CHAN_STAT(c) \
+{ #c, FIELD_SIZEOF(struct ether_chan_stats, c), \
+	offsetof(struct ether_chan_stats, c)}
+#else
+#define ETHER_CHAN_STAT(c) \
+{ #c, sizeof_field(struct ether_chan_stats, c), \
+	offsetof(struct ether_chan_stats, c)}
+#endif
+
+/**
+ * @brief Per channel hot path statistics, all u64
+ */
+static const struct ether_stats ether_chan_stats[] = {
+	ETHER_CHAN_STAT(rx_budget_hit_n),
+	ETHER_CHAN_STAT(tx_budget_hit_n),
+	ETHER_CHAN_STAT(rx_irq_n),
+	ETHER_CHAN_STAT(rx_pkt_n),
+	ETHER_CHAN_STAT(rx_refill_err_n),
+	ETHER_CHAN_STAT(rx_page_alloc_n),
+	ETHER_CHAN_STAT(rx_page_recycle_n),
+	ETHER_CHAN_STAT(dma_map_err_n),
+	ETHER_CHAN_STAT(nvgro_merge_n),
+	ETHER_CHAN_STAT(nvgro_flush_n),
+	ETHER_CHAN_STAT(tx_ring_full_n),
+};
+
+/**
+ * @brief Per channel statistics array length, plus rx_pkt_per_irq which is
+ * derived from rx_pkt_n and rx_irq_n
+ */
+#define ETHER_CHAN_STAT_LEN OSI_ARRAY_SIZE(ether_chan_stats)
+#define ETHER_CHAN_STAT_ALL_LEN(osi_dma) \
+	((int)(osi_dma)->num_dma_chans * (ETHER_CHAN_STAT_LEN + 1))
+
+/**
+ * @brief Sums the per CPU hot path counters of a channel.
+ *
+ * @param[in] pdata: OSD private data.
+ * @param[in] chan: DMA channel number.
+ * @param[out] sum: Counters of the channel.
+ */
+static void ether_get_chan_stats(struct ether_priv_data *pdata,
+				 unsigned int chan,
+				 struct ether_chan_stats *sum)
+{
+	const char *st;
+	unsigned int cpu;
+	size_t off;
+	int i;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		st = (const char *)&per_cpu_ptr(pdata->pcpu_stats,
+						cpu)->chan[chan];
+		for (i = 0; i < ETHER_CHAN_STAT_LEN; i++) {
+			off = ether_chan_stats[i].stat_offset;
+			*(u64 *)((char *)sum + off) += *(const u64 *)(st + off);
+		}
+	}
+}
+
 /**
  * @brief HW MAC Management counters
  * 	  Structure variable name MUST up to MAX length of ETH_GSTRING_LEN
@@ -548,7 +666,9 @@ static void ether_get_ethtool_stats(struct net_device *dev,
 	struct ether_priv_data *pdata = netdev_priv(dev);
 	struct osi_core_priv_data *osi_core = pdata->osi_core;
 	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	struct ether_chan_stats chan_stats;
 	struct osi_ioctl ioctl_data = {};
+	unsigned int k;
 	int i, j = 0;
 	int ret;
 
@@ -623,6 +743,20 @@ static void ether_get_ethtool_stats(struct net_device *dev,
 			data[j++] = (ether_frpstrings_stats[i].sizeof_stat ==
 				     sizeof(u64)) ? (*(u64 *)p) : (*(u32 *)p);
 		}
+
+		for (k = 0; k < osi_dma->num_dma_chans; k++) {
+			ether_get_chan_stats(pdata, osi_dma->dma_chans[k],
+					     &chan_stats);
+			for (i = 0; i < ETHER_CHAN_STAT_LEN; i++) {
+				char *p = (char *)&chan_stats +
+					  ether_chan_stats[i].stat_offset;
+
+				data[j++] = *(u64 *)p;
+			}
+			data[j++] = (chan_stats.rx_irq_n == 0U) ? 0U :
+				    div64_u64(chan_stats.rx_pkt_n,
+					      chan_stats.rx_irq_n);
+		}
 	}
 }
 
@@ -678,6 +812,11 @@ static int ether_get_sset_count(struct net_device *dev, int sset)
 				len += ETHER_FRP_STAT_LEN;
 			}
 		}
+		if (INT_MAX - ETHER_CHAN_STAT_ALL_LEN(pdata->osi_dma) < len) {
+			/* do nothing */
+		} else {
+			len += ETHER_CHAN_STAT_ALL_LEN(pdata->osi_dma);
+		}
 	} else if (sset == ETH_SS_TEST) {
 		len = ether_selftest_get_count(pdata);
 	} else {
@@ -702,6 +841,8 @@ static int ether_get_sset_count(struct net_device *dev, int sset)
 static void ether_get_strings(struct net_device *dev, u32 stringset, u8 *data)
 {
 	struct ether_priv_data *pdata = netdev_priv(dev);
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	unsigned int k, chan;
 	u8 *p = data;
 	u8 *str;
 	int i;
@@ -760,6 +901,18 @@ static void ether_get_strings(struct net_device *dev, u32 stringset, u8 *data)
 				}
 				p += ETH_GSTRING_LEN;
 			}
+			for (k = 0; k < osi_dma->num_dma_chans; k++) {
+				chan = osi_dma->dma_chans[k];
+				for (i = 0; i < ETHER_CHAN_STAT_LEN; i++) {
+					snprintf((char *)p, ETH_GSTRING_LEN,
+						 "chan%u_%s", chan,
+						 ether_chan_stats[i].stat_string);
+					p += ETH_GSTRING_LEN;
+				}
+				snprintf((char *)p, ETH_GSTRING_LEN,
+					 "chan%u_rx_pkt_per_irq", chan);
+				p += ETH_GSTRING_LEN;
+			}
 		}
 	} else if (stringset == (u32)ETH_SS_TEST) {
 		ether_selftest_get_strings(pdata, p);
@@ -943,7 +1096,8 @@ static int ether_get_ts_info(struct net_device *ndev,
  * Algorithm: This function is invoked by kernel when user request to set
  * interrupt coalescing parameters. This driver maintains same coalescing
  * parameters for all the channels, hence same changes will be applied to
- * all the channels.
+ * all the channels. With adaptive-rx/tx, DIM tunes the moderation of each
+ * channel from its own traffic.
  *
  * @param[in] dev: Net device data.
  * @param[in] ec: pointer to ethtool_coalesce structure
@@ -968,7 +1122,9 @@ static int ether_set_coalesce(struct net_device *dev,
 	/* Check for not supported parameters  */
 	if ((ec->rx_coalesce_usecs_irq) ||
 	    (ec->rx_max_coalesced_frames_irq) || (ec->tx_coalesce_usecs_irq) ||
+#ifndef ETHER_DIM
 	    (ec->use_adaptive_rx_coalesce) || (ec->use_adaptive_tx_coalesce) ||
+#endif
 	    (ec->pkt_rate_low) || (ec->rx_coalesce_usecs_low) ||
 	    (ec->rx_max_coalesced_frames_low) || (ec->tx_coalesce_usecs_high) ||
 	    (ec->tx_max_coalesced_frames_low) || (ec->pkt_rate_high) ||
@@ -1059,12 +1215,26 @@ static int ether_set_coalesce(struct net_device *dev,
 			   " along with rx-usecs\n");
 		return -EINVAL;
 	}
+#ifdef ETHER_DIM
+	if (ec->use_adaptive_tx_coalesce &&
+	    osi_dma->use_tx_usecs == OSI_DISABLE) {
+		netdev_err(dev, "invalid settings : adaptive-tx must be enabled"
+			   " along with tx-usecs\n");
+		return -EINVAL;
+	}
+#endif
 	netdev_err(dev, "RX COALESCING USECS is %s\n", osi_dma->use_riwt ?
 		   "ENABLED" : "DISABLED");
 
 	netdev_err(dev, "RX COALESCING FRAMES is %s\n", osi_dma->use_rx_frames ?
 		   "ENABLED" : "DISABLED");
 
+#ifdef ETHER_DIM
+	pdata->use_adaptive_rx = ec->use_adaptive_rx_coalesce ?
+				 OSI_ENABLE : OSI_DISABLE;
+	pdata->use_adaptive_tx = ec->use_adaptive_tx_coalesce ?
+				 OSI_ENABLE : OSI_DISABLE;
+#endif
 	osi_dma->rx_riwt = ec->rx_coalesce_usecs;
 	osi_dma->rx_frames = ec->rx_max_coalesced_frames;
 	osi_dma->tx_usecs = ec->tx_coalesce_usecs;
@@ -1098,6 +1268,10 @@ static int ether_get_coalesce(struct net_device *dev,
 	ec->rx_max_coalesced_frames = osi_dma->rx_frames;
 	ec->tx_coalesce_usecs = osi_dma->tx_usecs;
 	ec->tx_max_coalesced_frames = osi_dma->tx_frames;
+#ifdef ETHER_DIM
+	ec->use_adaptive_rx_coalesce = (pdata->use_adaptive_rx == OSI_ENABLE);
+	ec->use_adaptive_tx_coalesce = (pdata->use_adaptive_tx == OSI_ENABLE);
+#endif
 
 	return 0;
 }
@@ -1409,9 +1583,10 @@ static void ether_get_wol(struct net_device *ndev, struct ethtool_wolinfo *wol)
  *
  * param[in] ndev: Pointer to net device structure.
  * param[in] rxnfc: Pointer to rxflow data
- * param[in] rule_locs: TBD
+ * param[in] rule_locs: Locations of the rules for ETHTOOL_GRXCLSRLALL
  *
- * @note MAC and PHY need to be initialized.
+ * @note MAC and PHY need to be initialized. Rules offloaded by tc-flower
+ * are not reported.
  *
  * @retval 0 on success
  * @retval negative on failure
@@ -1422,18 +1597,227 @@ static int ether_get_rxnfc(struct net_device *ndev,
 {
 	struct ether_priv_data *pdata = netdev_priv(ndev);
 	struct osi_core_priv_data *osi_core = pdata->osi_core;
+	struct ether_frp_rule *rule;
+	unsigned int i, cnt = 0;
 
 	switch (rxnfc->cmd) {
 	case ETHTOOL_GRXRINGS:
 		rxnfc->data = osi_core->num_mtl_queues;
 		break;
+	case ETHTOOL_GRXCLSRLCNT:
+		for (i = 0; i < ETHER_FRP_MAX_RULES; i++) {
+			rule = &pdata->frp_rules[i];
+			if (rule->used && (rule->cookie == 0UL))
+				cnt++;
+		}
+		rxnfc->rule_cnt = cnt;
+		rxnfc->data = ETHER_FRP_MAX_RULES;
+		break;
+	case ETHTOOL_GRXCLSRULE:
+		if (rxnfc->fs.location >= ETHER_FRP_MAX_RULES)
+			return -EINVAL;
+
+		rule = &pdata->frp_rules[rxnfc->fs.location];
+		if (!rule->used || (rule->cookie != 0UL))
+			return -ENOENT;
+
+		rxnfc->fs = rule->fs;
+		break;
+	case ETHTOOL_GRXCLSRLALL:
+		for (i = 0; i < ETHER_FRP_MAX_RULES; i++) {
+			rule = &pdata->frp_rules[i];
+			if (!rule->used || (rule->cookie != 0UL))
+				continue;
+
+			if (cnt == rxnfc->rule_cnt)
+				return -EMSGSIZE;
+
+			rule_locs[cnt++] = i;
+		}
+		rxnfc->rule_cnt = cnt;
+		rxnfc->data = ETHER_FRP_MAX_RULES;
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Check an ethtool field mask to be either empty or full
+ *
+ * param[in] mask: Field mask.
+ * param[in] len: Length of the field.
+ *
+ * @retval true if the field can be matched by FRP
+ */
+static bool ether_rxnfc_mask_valid(const void *mask, size_t len)
+{
+	return !memchr_inv(mask, 0, len) || !memchr_inv(mask, 0xff, len);
+}
+
+/**
+ * @brief Translate an ethtool flow spec into a flow steering rule
+ *
+ * param[in] pdata: OSD private data.
+ * param[in] fs: ethtool flow spec.
+ * param[out] rule: Rule built from the spec.
+ *
+ * @retval 0 on success
+ * @retval negative on failure
+ */
+static int ether_rxnfc_parse(struct ether_priv_data *pdata,
+			     const struct ethtool_rx_flow_spec *fs,
+			     struct ether_frp_rule *rule)
+{
+	const struct ethtool_tcpip4_spec *l4, *l4_mask;
+	const struct ethtool_usrip4_spec *ip, *ip_mask;
+	const struct ethhdr *eth, *eth_mask;
+	unsigned char sport = OSI_FRP_MATCH_L4_S_UPORT;
+	unsigned char dport = OSI_FRP_MATCH_L4_D_UPORT;
+	unsigned char proto = IPPROTO_UDP;
+
+	switch (fs->flow_type) {
+	case TCP_V4_FLOW:
+		sport = OSI_FRP_MATCH_L4_S_TPORT;
+		dport = OSI_FRP_MATCH_L4_D_TPORT;
+		proto = IPPROTO_TCP;
+		/* fall through */
+	case UDP_V4_FLOW:
+		l4 = &fs->h_u.tcp_ip4_spec;
+		l4_mask = &fs->m_u.tcp_ip4_spec;
+		if (l4_mask->tos ||
+		    !ether_rxnfc_mask_valid(&l4_mask->ip4src, 4) ||
+		    !ether_rxnfc_mask_valid(&l4_mask->ip4dst, 4) ||
+		    !ether_rxnfc_mask_valid(&l4_mask->psrc, 2) ||
+		    !ether_rxnfc_mask_valid(&l4_mask->pdst, 2))
+			return -EINVAL;
+
+		if (l4_mask->ip4src)
+			ether_frp_rule_add_field(rule, OSI_FRP_MATCH_L3_SIP, 0,
+						 &l4->ip4src, 4U);
+		if (l4_mask->ip4dst)
+			ether_frp_rule_add_field(rule, OSI_FRP_MATCH_L3_DIP, 0,
+						 &l4->ip4dst, 4U);
+		if (l4_mask->psrc)
+			ether_frp_rule_add_field(rule, sport, 0, &l4->psrc, 2U);
+		if (l4_mask->pdst)
+			ether_frp_rule_add_field(rule, dport, 0, &l4->pdst, 2U);
+		/* Without ports only the IPv4 protocol field tells TCP/UDP */
+		if (!l4_mask->psrc && !l4_mask->pdst)
+			ether_frp_rule_add_field(rule, OSI_FRP_MATCH_NORMAL,
+						 ETHER_FRP_IP4_PROTO_OFFSET,
+						 &proto, 1U);
+		break;
+	case IP_USER_FLOW:
+		ip = &fs->h_u.usr_ip4_spec;
+		ip_mask = &fs->m_u.usr_ip4_spec;
+		if ((ip->ip_ver != ETH_RX_NFC_IP4) || ip_mask->l4_4_bytes ||
+		    ip_mask->tos ||
+		    (ip_mask->proto && (ip_mask->proto != 0xffU)) ||
+		    !ether_rxnfc_mask_valid(&ip_mask->ip4src, 4) ||
+		    !ether_rxnfc_mask_valid(&ip_mask->ip4dst, 4))
+			return -EINVAL;
+
+		if (ip_mask->ip4src)
+			ether_frp_rule_add_field(rule, OSI_FRP_MATCH_L3_SIP, 0,
+						 &ip->ip4src, 4U);
+		if (ip_mask->ip4dst)
+			ether_frp_rule_add_field(rule, OSI_FRP_MATCH_L3_DIP, 0,
+						 &ip->ip4dst, 4U);
+		if (ip_mask->proto)
+			ether_frp_rule_add_field(rule, OSI_FRP_MATCH_NORMAL,
+						 ETHER_FRP_IP4_PROTO_OFFSET,
+						 &ip->proto, 1U);
+		break;
+	case ETHER_FLOW:
+		eth = &fs->h_u.ether_spec;
+		eth_mask = &fs->m_u.ether_spec;
+		if (eth_mask->h_proto ||
+		    !ether_rxnfc_mask_valid(eth_mask->h_dest, ETH_ALEN) ||
+		    !ether_rxnfc_mask_valid(eth_mask->h_source, ETH_ALEN))
+			return -EINVAL;
+
+		if (!is_zero_ether_addr(eth_mask->h_dest))
+			ether_frp_rule_add_field(rule, OSI_FRP_MATCH_L2_DA, 0,
+						 eth->h_dest, ETH_ALEN);
+		if (!is_zero_ether_addr(eth_mask->h_source))
+			ether_frp_rule_add_field(rule, OSI_FRP_MATCH_L2_SA, 0,
+						 eth->h_source, ETH_ALEN);
+		break;
 	default:
+		/* FLOW_EXT, FLOW_MAC_EXT and FLOW_RSS are not supported */
 		return -EOPNOTSUPP;
 	}
 
+	if (rule->num_fields == 0U)
+		return -EINVAL;
+
+	if (fs->ring_cookie == RX_CLS_FLOW_DISC) {
+		rule->drop = true;
+	} else {
+		if (ethtool_get_flow_spec_ring_vf(fs->ring_cookie) != 0ULL)
+			return -EINVAL;
+
+		rule->chan = ethtool_get_flow_spec_ring(fs->ring_cookie);
+		if (!ether_is_rx_steer_chan(pdata, rule->chan))
+			return -EINVAL;
+	}
+
+	rule->fs = *fs;
+
 	return 0;
 }
 
+/**
+ * @brief Set RX flow classification rules
+ *
+ * Algorithm: Inserts or deletes ntuple rules, which are programmed as
+ * FRP flow steering rules.
+ *
+ * param[in] ndev: Pointer to net device structure.
+ * param[in] rxnfc: Pointer to rxflow data
+ *
+ * @note MAC and PHY need to be initialized.
+ *
+ * @retval 0 on success
+ * @retval negative on failure
+ */
+static int ether_set_rxnfc(struct net_device *ndev,
+			   struct ethtool_rxnfc *rxnfc)
+{
+	struct ether_priv_data *pdata = netdev_priv(ndev);
+	struct ether_frp_rule rule = {};
+	unsigned int loc = rxnfc->fs.location;
+	int ret;
+
+	if (!netif_running(ndev)) {
+		netdev_err(pdata->ndev, "interface must be up\n");
+		return -ENODEV;
+	}
+
+	if (loc >= ETHER_FRP_MAX_RULES)
+		return -EINVAL;
+
+	/* Locations of tc-flower rules are not for ethtool */
+	if (pdata->frp_rules[loc].used && (pdata->frp_rules[loc].cookie != 0UL))
+		return -EBUSY;
+
+	switch (rxnfc->cmd) {
+	case ETHTOOL_SRXCLSRLINS:
+		ret = ether_rxnfc_parse(pdata, &rxnfc->fs, &rule);
+		if (ret < 0)
+			return ret;
+
+		return ether_frp_rule_add(pdata, loc, &rule);
+	case ETHTOOL_SRXCLSRLDEL:
+		return ether_frp_rule_del(pdata, loc);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
 /**
  * @brief Get the size of the RX flow hash key
  *
@@ -1508,6 +1892,10 @@ static int ether_get_rxfh(struct net_device *ndev, u32 *indir, u8 *key,
  * param[in] key: Pointer to Hash key
  * param[hfunc] hfunc: Hash function
  *
+ * @note While the interface is down the settings are only stored, they are
+ * programmed with the MAC when it comes up. OSI updates only the changed
+ * key words and table entries in HW.
+ *
  * @retval 0 on success
  * @retval -1 on failure.
  */
@@ -1519,15 +1907,15 @@ static int ether_set_rxfh(struct net_device *ndev, const u32 *indir,
 	struct osi_ioctl ioctl_data = {};
 	int i;
 
-	if (!netif_running(ndev)) {
-		netdev_err(pdata->ndev, "interface must be up\n");
-		return -ENODEV;
-	}
-
 	if ((hfunc != ETH_RSS_HASH_NO_CHANGE) && (hfunc != ETH_RSS_HASH_TOP))
 		return -EOPNOTSUPP;
 
 	if (indir) {
+		for (i = 0; i < ARRAY_SIZE(osi_core->rss.table); i++) {
+			if (indir[i] >= osi_core->num_mtl_queues)
+				return -EINVAL;
+		}
+
 		for (i = 0; i < ARRAY_SIZE(osi_core->rss.table); i++)
 			osi_core->rss.table[i] = indir[i];
 	}
@@ -1535,6 +1923,9 @@ static int ether_set_rxfh(struct net_device *ndev, const u32 *indir,
 	if (key)
 		memcpy(osi_core->rss.key, key, sizeof(osi_core->rss.key));
 
+	if (!netif_running(ndev))
+		return 0;
+
 	ioctl_data.cmd = OSI_CMD_CONFIG_RSS;
 	return osi_handle_ioctl(pdata->osi_core, &ioctl_data);
 
@@ -1572,24 +1963,51 @@ static int ether_set_ringparam(struct net_device *ndev,
 	    !is_power_of_2(ring->tx_pending))
 		return -EINVAL;
 
-	/* Stop the network device */
-	if (netif_running(ndev) &&
-	    ndev->netdev_ops &&
-	    ndev->netdev_ops->ndo_stop)
-		ndev->netdev_ops->ndo_stop(ndev);
+	/* frame coalescing must still fit into the new rings */
+	if (((osi_dma->use_tx_frames == OSI_ENABLE) &&
+	     (osi_dma->tx_frames > ETHER_TX_MAX_FRAME(ring->tx_pending))) ||
+	    ((osi_dma->use_rx_frames == OSI_ENABLE) &&
+	     (osi_dma->rx_frames > ring->rx_pending))) {
+		netdev_err(ndev, "coalesce frames %u/%u exceed the rings\n",
+			   osi_dma->tx_frames, osi_dma->rx_frames);
+		return -EINVAL;
+	}
 
-	osi_dma->rx_ring_sz = ring->rx_pending;
-	osi_dma->tx_ring_sz = ring->tx_pending;
+	if ((ring->rx_pending == osi_dma->rx_ring_sz) &&
+	    (ring->tx_pending == osi_dma->tx_ring_sz))
+		return 0;
 
-	/* Start the network device */
-	if (netif_running(ndev) &&
-	    ndev->netdev_ops &&
-	    ndev->netdev_ops->ndo_open)
-		ret = ndev->netdev_ops->ndo_open(ndev);
+	if (!netif_running(ndev)) {
+		osi_dma->rx_ring_sz = ring->rx_pending;
+		osi_dma->tx_ring_sz = ring->tx_pending;
+		return 0;
+	}
+
+	/* Only the DMA is restarted, link and MAC configuration stay */
+	ret = ether_restart_dma(pdata, ring->tx_pending, ring->rx_pending);
 
 	return ret;
 }
 
+/**
+ * @brief Get the DMA channels of the interface
+ *
+ * Algorithm: Channels are combined Tx/Rx pairs, given by DT. Their
+ * number can not be changed at runtime since the channels and their
+ * MTL queues and priorities are partitioned between the cells.
+ *
+ * @param[in] ndev: Pointer to net device structure.
+ * @param[out] ch: ethtool channels.
+ */
+static void ether_get_channels(struct net_device *ndev,
+			       struct ethtool_channels *ch)
+{
+	struct ether_priv_data *pdata = netdev_priv(ndev);
+
+	ch->max_combined = pdata->osi_dma->num_dma_chans;
+	ch->combined_count = pdata->osi_dma->num_dma_chans;
+}
+
 static unsigned int ether_get_msglevel(struct net_device *ndev)
 {
 	struct ether_priv_data *pdata = netdev_priv(ndev);
@@ -1604,6 +2022,40 @@ static void ether_set_msglevel(struct net_device *ndev, u32 level)
 	pdata->msg_enable = level;
 }
 
+#ifdef ETHER_TSN_STATS
+/**
+ * @brief Get frame preemption (MAC merge) statistics
+ *
+ * @param[in] ndev: Pointer to net device structure.
+ * @param[out] stats: MAC merge stats.
+ *
+ * @note MAC and PHY need to be initialized.
+ */
+static void ether_get_mm_stats(struct net_device *ndev,
+			       struct ethtool_mm_stats *stats)
+{
+	struct ether_priv_data *pdata = netdev_priv(ndev);
+	struct osi_core_priv_data *osi_core = pdata->osi_core;
+	struct osi_mmc_counters *mmc = &osi_core->mmc;
+	struct osi_ioctl ioctl_data = {};
+
+	if (!netif_running(ndev) || (pdata->hw_feat.mmc_sel != 1U) ||
+	    (pdata->hw_feat.fpe_sel == 0U))
+		return;
+
+	ioctl_data.cmd = OSI_CMD_READ_MMC;
+	if (osi_handle_ioctl(osi_core, &ioctl_data) < 0)
+		return;
+
+	stats->MACMergeFrameAssErrorCount = mmc->mmc_rx_packet_reass_err_cnt;
+	stats->MACMergeFrameSmdErrorCount = mmc->mmc_rx_packet_smd_err_cnt;
+	stats->MACMergeFrameAssOkCount = mmc->mmc_rx_packet_asm_ok_cnt;
+	stats->MACMergeFragCountRx = mmc->mmc_rx_fpe_fragment_cnt;
+	stats->MACMergeFragCountTx = mmc->mmc_tx_fpe_frag_cnt;
+	stats->MACMergeHoldCount = mmc->mmc_tx_fpe_hold_req_cnt;
+}
+#endif /* ETHER_TSN_STATS */
+
 /**
  * @brief Set of ethtool operations
  */
@@ -1620,6 +2072,9 @@ static const struct ethtool_ops ether_ethtool_ops = {
 	.get_coalesce = ether_get_coalesce,
 #if KERNEL_VERSION(5, 5, 0) <= LINUX_VERSION_CODE
 	.supported_coalesce_params = (ETHTOOL_COALESCE_USECS |
+#ifdef ETHER_DIM
+		ETHTOOL_COALESCE_USE_ADAPTIVE |
+#endif
 		ETHTOOL_COALESCE_MAX_FRAMES),
 #endif
 	.set_coalesce = ether_set_coalesce,
@@ -1629,14 +2084,19 @@ static const struct ethtool_ops ether_ethtool_ops = {
 	.set_eee = ether_set_eee,
 	.self_test = ether_selftest_run,
 	.get_rxnfc = ether_get_rxnfc,
+	.set_rxnfc = ether_set_rxnfc,
 	.get_rxfh_key_size = ether_get_rxfh_key_size,
 	.get_rxfh_indir_size = ether_get_rxfh_indir_size,
 	.get_rxfh = ether_get_rxfh,
 	.set_rxfh = ether_set_rxfh,
 	.get_ringparam = ether_get_ringparam,
 	.set_ringparam = ether_set_ringparam,
+	.get_channels = ether_get_channels,
 	.get_msglevel = ether_get_msglevel,
 	.set_msglevel = ether_set_msglevel,
+#ifdef ETHER_TSN_STATS
+	.get_mm_stats = ether_get_mm_stats,
+#endif
 };
 
 void ether_set_ethtool_ops(struct net_device *ndev)
@@ -610,6 +610,182 @@ static int ether_config_l2_filters(struct net_device *dev,
 	return osi_handle_ioctl(osi_core, &ioctl_data);
 }
 
+#ifdef ETHER_RX_DMABUF
+/** Entries copied from/to user space at once */
+#define ETHER_RX_DMABUF_BATCH	32U
+
+/**
+ * @brief Reap the completed Rx buffers of a dma-buf bound channel
+ *
+ * Algorithm: Moves up to req->count completions to user space, their slots
+ * stay with the application until returned.
+ *
+ * @param[in] rxd: dma-buf bound to the channel.
+ * @param[in,out] req: Request, count gets the number of reaped entries.
+ *
+ * @retval 0 on Success
+ * @retval "negative value" on Failure
+ */
+static int ether_rx_dmabuf_reap(struct ether_rx_dmabuf *rxd,
+				struct ether_rx_dmabuf_req *req)
+{
+	struct ether_rx_dmabuf_cpl __user *ucpl = u64_to_user_ptr(req->entries);
+	struct ether_rx_dmabuf_cpl cpl[ETHER_RX_DMABUF_BATCH];
+	unsigned int done = 0U, n, i;
+
+	while (done < req->count) {
+		n = min(req->count - done, ETHER_RX_DMABUF_BATCH);
+
+		spin_lock_bh(&rxd->lock);
+		n = min(n, rxd->cpl_cnt);
+		for (i = 0U; i < n; i++) {
+			cpl[i] = rxd->cpl[rxd->cpl_head];
+			rxd->slots[cpl[i].slot].user = true;
+			rxd->cpl_head = (rxd->cpl_head + 1U) % rxd->nr_slots;
+		}
+		rxd->cpl_cnt -= n;
+		spin_unlock_bh(&rxd->lock);
+
+		if (n == 0U)
+			break;
+
+		if (copy_to_user(ucpl + done, cpl, n * sizeof(cpl[0])) != 0U)
+			return -EFAULT;
+
+		done += n;
+	}
+
+	req->count = done;
+
+	return 0;
+}
+
+/**
+ * @brief Return reaped Rx buffers to a dma-buf bound channel
+ *
+ * Algorithm: Gives the slots back to the free slots the Rx ring gets
+ * refilled from. Stops at the first slot not held by the application.
+ *
+ * @param[in] rxd: dma-buf bound to the channel.
+ * @param[in,out] req: Request, count gets the number of returned entries.
+ *
+ * @retval 0 on Success
+ * @retval "negative value" on Failure
+ */
+static int ether_rx_dmabuf_return(struct ether_rx_dmabuf *rxd,
+				  struct ether_rx_dmabuf_req *req)
+{
+	nveu32_t __user *uslot = u64_to_user_ptr(req->entries);
+	nveu32_t slots[ETHER_RX_DMABUF_BATCH];
+	unsigned int done = 0U, n, i;
+	int ret = 0;
+
+	while (done < req->count) {
+		n = min(req->count - done, ETHER_RX_DMABUF_BATCH);
+		if (copy_from_user(slots, uslot + done,
+				   n * sizeof(slots[0])) != 0U) {
+			ret = -EFAULT;
+			break;
+		}
+
+		spin_lock_bh(&rxd->lock);
+		for (i = 0U; i < n; i++) {
+			if ((slots[i] >= rxd->nr_slots) ||
+			    !rxd->slots[slots[i]].user)
+				break;
+
+			rxd->slots[slots[i]].user = false;
+			rxd->free[rxd->nr_free++] = slots[i];
+		}
+		spin_unlock_bh(&rxd->lock);
+
+		done += i;
+		if (i < n) {
+			ret = -EINVAL;
+			break;
+		}
+	}
+
+	req->count = done;
+
+	return ret;
+}
+
+/**
+ * @brief This function is invoked by ioctl function when user issues an ioctl
+ * command to bind a dma-buf as Rx buffers of a DMA channel.
+ *
+ * Algorithm:
+ * 1) Bind or unbind the dma-buf of the channel.
+ * 2) Reap the slots of received packets or return consumed slots.
+ *
+ * Packets are steered to the channel with the FRP/ntuple rules.
+ *
+ * @param[in] ndev: Pointer to net device structure.
+ * @param[in] ifdata: pointer to IOCTL specific structure.
+ *
+ * @note Bind needs the interface to be up.
+ *
+ * @retval 0 on Success
+ * @retval "negative value" on Failure
+ */
+static int ether_config_rx_dmabuf(struct net_device *ndev,
+				  struct ether_exported_ifr_data *ifdata)
+{
+	struct ether_priv_data *pdata = netdev_priv(ndev);
+	struct ether_rx_dmabuf_req req;
+	struct ether_rx_dmabuf *rxd;
+	int ret;
+
+	if (ifdata->ptr == NULL) {
+		dev_err(pdata->dev, "%s: Invalid data for priv ioctl %d\n",
+			__func__, ifdata->ifcmd);
+		return -EINVAL;
+	}
+
+	if (copy_from_user(&req, (void __user *)ifdata->ptr,
+			   sizeof(req)) != 0U) {
+		dev_err(pdata->dev, "%s copy from user failed\n", __func__);
+		return -EFAULT;
+	}
+
+	if (req.chan >= OSI_MGBE_MAX_NUM_CHANS)
+		return -EINVAL;
+
+	switch (req.op) {
+	case ETHER_RX_DMABUF_BIND:
+		ret = ether_rx_dmabuf_bind(pdata, req.chan, req.fd,
+					   req.slot_size);
+		break;
+	case ETHER_RX_DMABUF_UNBIND:
+		ret = ether_rx_dmabuf_unbind(pdata, req.chan);
+		break;
+	case ETHER_RX_DMABUF_REAP:
+	case ETHER_RX_DMABUF_RETURN:
+		rxd = pdata->rx_dmabuf[req.chan];
+		if (!rxd) {
+			ret = -ENOENT;
+			break;
+		}
+
+		if (req.op == ETHER_RX_DMABUF_REAP)
+			ret = ether_rx_dmabuf_reap(rxd, &req);
+		else
+			ret = ether_rx_dmabuf_return(rxd, &req);
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+
+	if (copy_to_user((void __user *)ifdata->ptr, &req,
+			 sizeof(req)) != 0U)
+		return -EFAULT;
+
+	return ret;
+}
+#endif
+
 /**
  * @brief This function is invoked by ioctl functio when user issues an ioctl
  * command to configure VALN filtering.
@@ -1096,6 +1272,7 @@ int ether_handle_priv_ioctl(struct net_device *ndev,
 	case ETHER_CONFIG_ARP_OFFLOAD:
 	case ETHER_CONFIG_LOOPBACK_MODE:
 	case ETHER_PAD_CALIBRATION:
+	case ETHER_CONFIG_RX_DMABUF:
 		if (!capable(CAP_NET_ADMIN)) {
 			ret = -EPERM;
 			dev_info(pdata->dev,
@@ -1233,6 +1410,12 @@ int ether_handle_priv_ioctl(struct net_device *ndev,
 		ret = ether_config_l2_filters(ndev, &ifdata);
 		break;
 
+#ifdef ETHER_RX_DMABUF
+	case ETHER_CONFIG_RX_DMABUF:
+		ret = ether_config_rx_dmabuf(ndev, &ifdata);
+		break;
+#endif
+
 	default:
 		break;
 	}
@@ -1330,6 +1330,16 @@ static int macsec_init(struct sk_buff *skb, struct genl_info *info)
 		goto exit;
 	}
 	mutex_lock(&macsec_pdata->lock);
+#ifdef ETHER_MACSEC_OFFLOAD
+	/* Controller is in use by an offloaded SecY */
+	if (macsec_pdata->offload_secy != NULL) {
+		ret = -EBUSY;
+		mutex_unlock(&macsec_pdata->lock);
+		dev_err(dev, "%s: MACsec offloaded by kernel stack\n",
+			__func__);
+		goto exit;
+	}
+#endif /* ETHER_MACSEC_OFFLOAD */
 	/* only one supplicant is allowed per VF */
 	if (macsec_pdata->next_supp_idx >= MAX_SUPPLICANTS_ALLOWED) {
 		ret = -EPROTO;
@@ -1490,6 +1500,596 @@ static const struct genl_ops nv_macsec_genl_ops[] = {
 	},
 };
 
+#ifdef ETHER_MACSEC_OFFLOAD
+static inline struct macsec_priv_data *
+macsec_ctx_to_pdata(struct macsec_context *ctx)
+{
+	struct ether_priv_data *pdata = netdev_priv(ctx->netdev);
+
+	return pdata->macsec_pdata;
+}
+
+/**
+ * @brief macsec_offload_sa_valid - Check if an SA is programmed in HW
+ *
+ * @param[in] osi_core: OSI core private data structure.
+ * @param[in] sci: SCI of the SC.
+ * @param[in] an: association number of the SA.
+ * @param[in] ctlr: OSI_CTLR_SEL_TX or OSI_CTLR_SEL_RX.
+ *
+ * @retval true if the SA has a key table entry
+ * @retval false otherwise
+ */
+static bool macsec_offload_sa_valid(struct osi_core_priv_data *osi_core,
+				    const unsigned char *sci, unsigned char an,
+				    unsigned short ctlr)
+{
+	struct osi_macsec_sc_info *sc_info =
+		osi_core->macsec_lut_status[ctlr].sc_info;
+	int i;
+
+	for (i = 0; i < OSI_MAX_NUM_SC; i++) {
+		if ((sc_info[i].an_valid & OSI_BIT(an)) &&
+		    !memcmp(sc_info[i].sci, sci, sizeof(sc_info[i].sci)))
+			return true;
+	}
+
+	return false;
+}
+
+static int macsec_offload_config(struct macsec_priv_data *macsec_pdata,
+				 struct osi_macsec_sc_info *sc_info,
+				 unsigned int enable, unsigned short ctlr)
+{
+	struct ether_priv_data *pdata = macsec_pdata->ether_pdata;
+	unsigned int *an_map = (ctlr == OSI_CTLR_SEL_TX) ?
+			       &macsec_pdata->macsec_tx_an_map :
+			       &macsec_pdata->macsec_rx_an_map;
+	unsigned short kt_idx;
+	int ret;
+
+	mutex_lock(&macsec_pdata->lock);
+	ret = osi_macsec_config(pdata->osi_core, sc_info, enable, ctlr,
+				&kt_idx);
+	mutex_unlock(&macsec_pdata->lock);
+	if (ret < 0) {
+		dev_err(pdata->dev, "%s: failed to %s %s SA %u\n", __func__,
+			(enable == OSI_ENABLE) ? "enable" : "disable",
+			(ctlr == OSI_CTLR_SEL_TX) ? "Tx" : "Rx",
+			sc_info->curr_an);
+		return -EIO;
+	}
+
+	if (enable == OSI_DISABLE)
+		*an_map &= ~((1U) << (sc_info->curr_an & 0xFU));
+	else if (sc_info->flags == OSI_ENABLE_SA)
+		*an_map |= ((1U) << (sc_info->curr_an & 0xFU));
+
+	return 0;
+}
+
+/**
+ * @brief macsec_offload_add_sa - Program a new SA from the MACsec stack
+ *
+ * @note
+ * Algorithm:
+ *  - Create the SA with the SAK and HKey, and enable it if requested.
+ *    The SAK copy on stack is cleared once it is in the key table.
+ *
+ * @param[in] ctx: MACsec offload context.
+ * @param[in] sci: SCI of the SC the SA belongs to.
+ * @param[in] next_pn: PN of the first frame.
+ * @param[in] enable: enable the SA after creating it.
+ * @param[in] ctlr: OSI_CTLR_SEL_TX or OSI_CTLR_SEL_RX.
+ *
+ * @retval 0 on success
+ * @retval negative value on failure
+ */
+static int macsec_offload_add_sa(struct macsec_context *ctx, sci_t sci,
+				 unsigned int next_pn, bool enable,
+				 unsigned short ctlr)
+{
+	struct macsec_priv_data *macsec_pdata = macsec_ctx_to_pdata(ctx);
+	struct osi_macsec_sc_info sc_info = {0};
+	int ret;
+
+	memcpy(sc_info.sci, &sci, sizeof(sc_info.sci));
+	sc_info.curr_an = ctx->sa.assoc_num;
+	sc_info.next_pn = next_pn;
+	sc_info.lowest_pn = next_pn;
+	sc_info.pn_window = macsec_pdata->pn_window;
+	memcpy(sc_info.sak, ctx->sa.key, ctx->secy->key_len);
+
+	ret = hkey_generation(sc_info.sak, sc_info.hkey);
+	if (ret != 0) {
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	sc_info.flags = OSI_CREATE_SA;
+	ret = macsec_offload_config(macsec_pdata, &sc_info, OSI_ENABLE, ctlr);
+	if (ret < 0 || !enable)
+		goto exit;
+
+	sc_info.flags = OSI_ENABLE_SA;
+	ret = macsec_offload_config(macsec_pdata, &sc_info, OSI_ENABLE, ctlr);
+exit:
+	memzero_explicit(sc_info.sak, sizeof(sc_info.sak));
+	memzero_explicit(sc_info.hkey, sizeof(sc_info.hkey));
+	return ret;
+}
+
+/**
+ * @brief macsec_offload_upd_sa - Enable or disable an existing SA
+ *
+ * @note
+ * Algorithm:
+ *  - Disabling an SA releases its key table entry, the stack does not
+ *    hand the SAK again on update so such an SA can not be re-activated.
+ *
+ * @param[in] ctx: MACsec offload context.
+ * @param[in] sci: SCI of the SC the SA belongs to.
+ * @param[in] an: association number of the SA.
+ * @param[in] next_pn: PN used when the SA is enabled.
+ * @param[in] enable: enable or disable the SA.
+ * @param[in] ctlr: OSI_CTLR_SEL_TX or OSI_CTLR_SEL_RX.
+ *
+ * @retval 0 on success
+ * @retval negative value on failure
+ */
+static int macsec_offload_upd_sa(struct macsec_context *ctx, sci_t sci,
+				 unsigned char an, unsigned int next_pn,
+				 bool enable, unsigned short ctlr)
+{
+	struct macsec_priv_data *macsec_pdata = macsec_ctx_to_pdata(ctx);
+	struct osi_core_priv_data *osi_core =
+		macsec_pdata->ether_pdata->osi_core;
+	struct osi_macsec_sc_info sc_info = {0};
+
+	memcpy(sc_info.sci, &sci, sizeof(sc_info.sci));
+	if (!macsec_offload_sa_valid(osi_core, sc_info.sci, an, ctlr))
+		return enable ? -EOPNOTSUPP : 0;
+
+	sc_info.curr_an = an;
+	sc_info.next_pn = next_pn;
+	sc_info.lowest_pn = next_pn;
+	sc_info.pn_window = macsec_pdata->pn_window;
+	if (enable)
+		sc_info.flags = OSI_ENABLE_SA;
+
+	return macsec_offload_config(macsec_pdata, &sc_info,
+				     enable ? OSI_ENABLE : OSI_DISABLE, ctlr);
+}
+
+/**
+ * @brief macsec_offload_secy_config - Apply SecY settings to the controller
+ *
+ * @param[in] macsec_pdata: MACsec private data.
+ * @param[in] secy: offloaded SecY.
+ *
+ * @retval 0 on success
+ * @retval negative value on failure
+ */
+static int macsec_offload_secy_config(struct macsec_priv_data *macsec_pdata,
+				      struct macsec_secy *secy)
+{
+	struct ether_priv_data *pdata = macsec_pdata->ether_pdata;
+	unsigned int en = OSI_DISABLE;
+	int ret;
+
+	ret = osi_macsec_cipher_config(pdata->osi_core,
+				       OSI_MACSEC_CIPHER_AES128);
+	if (ret < 0) {
+		dev_err(pdata->dev, "Failed to set macsec cipher\n");
+		return -EIO;
+	}
+	macsec_pdata->cipher = OSI_MACSEC_CIPHER_AES128;
+
+	/* Without replay protection use the maximum PN window, same as
+	 * NV_MACSEC_CMD_SET_REPLAY_PROT does.
+	 */
+	if (secy->replay_protect)
+		macsec_pdata->pn_window = secy->replay_window;
+	else
+		macsec_pdata->pn_window = OSI_PN_MAX_DEFAULT;
+	macsec_pdata->protect_frames = secy->protect_frames;
+
+	/* Controller follows the state of the MACsec netdev */
+	if (netif_running(secy->netdev)) {
+		en = OSI_MACSEC_RX_EN;
+		if (secy->protect_frames)
+			en |= OSI_MACSEC_TX_EN;
+	}
+
+	if (macsec_pdata->enabled != en) {
+		ret = osi_macsec_en(pdata->osi_core, en);
+		if (ret < 0) {
+			dev_err(pdata->dev, "%s: Failed to enable macsec Tx/Rx, %d\n",
+				__func__, ret);
+			return -EIO;
+		}
+		macsec_pdata->enabled = en;
+	}
+
+	return 0;
+}
+
+static int macsec_mdo_dev_open(struct macsec_context *ctx)
+{
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	return macsec_offload_secy_config(macsec_ctx_to_pdata(ctx), ctx->secy);
+}
+
+static int macsec_mdo_dev_stop(struct macsec_context *ctx)
+{
+	struct macsec_priv_data *macsec_pdata = macsec_ctx_to_pdata(ctx);
+	int ret;
+
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	ret = osi_macsec_en(macsec_pdata->ether_pdata->osi_core, OSI_DISABLE);
+	if (ret < 0)
+		return -EIO;
+	macsec_pdata->enabled = OSI_DISABLE;
+
+	return 0;
+}
+
+static int macsec_mdo_add_secy(struct macsec_context *ctx)
+{
+	struct macsec_priv_data *macsec_pdata = macsec_ctx_to_pdata(ctx);
+	struct ether_priv_data *pdata = macsec_pdata->ether_pdata;
+	struct macsec_secy *secy = ctx->secy;
+	int ret;
+
+	/* Key table holds 128 bit SAK and HKey, no XPN salt */
+	if (secy->xpn || secy->key_len != OSI_KEY_LEN_128 ||
+	    secy->icv_len != MACSEC_STD_ICV_LEN)
+		return -EOPNOTSUPP;
+
+	if (!netif_running(pdata->ndev))
+		return -ENETDOWN;
+
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	/* The controller is owned either by the supplicant over genl or by
+	 * the MACsec stack.
+	 */
+	mutex_lock(&macsec_pdata->lock);
+	if (macsec_pdata->next_supp_idx != 0U ||
+	    macsec_pdata->offload_secy != NULL) {
+		mutex_unlock(&macsec_pdata->lock);
+		return -EBUSY;
+	}
+	macsec_pdata->offload_secy = secy;
+	mutex_unlock(&macsec_pdata->lock);
+
+	ret = macsec_open(macsec_pdata, NULL);
+	if (ret < 0)
+		goto err_open;
+	macsec_pdata->macsec_rx_an_map = 0U;
+	macsec_pdata->macsec_tx_an_map = 0U;
+	atomic_inc(&macsec_pdata->ref_count);
+
+	ret = macsec_offload_secy_config(macsec_pdata, secy);
+	if (ret < 0)
+		goto err_config;
+
+	return 0;
+
+err_config:
+	macsec_close(macsec_pdata);
+	atomic_dec(&macsec_pdata->ref_count);
+err_open:
+	mutex_lock(&macsec_pdata->lock);
+	macsec_pdata->offload_secy = NULL;
+	mutex_unlock(&macsec_pdata->lock);
+	return ret;
+}
+
+static int macsec_mdo_upd_secy(struct macsec_context *ctx)
+{
+	struct macsec_priv_data *macsec_pdata = macsec_ctx_to_pdata(ctx);
+	struct macsec_secy *secy = ctx->secy;
+	struct macsec_tx_sa *tx_sa;
+	int ret;
+
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	ret = macsec_offload_secy_config(macsec_pdata, secy);
+	if (ret < 0)
+		return ret;
+
+	/* Encoding SA may have moved to another AN */
+	tx_sa = rtnl_dereference(secy->tx_sc.sa[secy->tx_sc.encoding_sa]);
+	if (!tx_sa || !tx_sa->active ||
+	    (macsec_pdata->macsec_tx_an_map &
+	     ((1U) << secy->tx_sc.encoding_sa)))
+		return 0;
+
+	return macsec_offload_upd_sa(ctx, secy->sci, secy->tx_sc.encoding_sa,
+				     tx_sa->next_pn_halves.lower, true,
+				     OSI_CTLR_SEL_TX);
+}
+
+static int macsec_mdo_del_secy(struct macsec_context *ctx)
+{
+	struct macsec_priv_data *macsec_pdata = macsec_ctx_to_pdata(ctx);
+	int ret;
+
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	/* Deinit clears all the SC/SA tables as well */
+	ret = macsec_close(macsec_pdata);
+	if (atomic_read(&macsec_pdata->ref_count) > 0)
+		atomic_dec(&macsec_pdata->ref_count);
+
+	mutex_lock(&macsec_pdata->lock);
+	macsec_pdata->offload_secy = NULL;
+	mutex_unlock(&macsec_pdata->lock);
+
+	return (ret < 0) ? -EIO : 0;
+}
+
+static int macsec_mdo_add_rxsc(struct macsec_context *ctx)
+{
+	/* SC is created in HW along with its first SA */
+	return 0;
+}
+
+static int macsec_mdo_upd_rxsc(struct macsec_context *ctx)
+{
+	return 0;
+}
+
+static int macsec_mdo_del_rxsc(struct macsec_context *ctx)
+{
+	unsigned char an;
+	int ret;
+
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	/* Stack frees the SAs of the SC without deleting them one by one */
+	for (an = 0; an < MACSEC_NUM_AN; an++) {
+		ret = macsec_offload_upd_sa(ctx, ctx->rx_sc->sci, an, 0, false,
+					    OSI_CTLR_SEL_RX);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int macsec_mdo_add_rxsa(struct macsec_context *ctx)
+{
+	struct macsec_rx_sa *rx_sa = ctx->sa.rx_sa;
+
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	return macsec_offload_add_sa(ctx, rx_sa->sc->sci,
+				     rx_sa->next_pn_halves.lower,
+				     rx_sa->active, OSI_CTLR_SEL_RX);
+}
+
+static int macsec_mdo_upd_rxsa(struct macsec_context *ctx)
+{
+	struct macsec_rx_sa *rx_sa = ctx->sa.rx_sa;
+
+	if (ctx->sa.update_pn)
+		return -EOPNOTSUPP;
+
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	return macsec_offload_upd_sa(ctx, rx_sa->sc->sci, ctx->sa.assoc_num,
+				     rx_sa->next_pn_halves.lower,
+				     rx_sa->active, OSI_CTLR_SEL_RX);
+}
+
+static int macsec_mdo_del_rxsa(struct macsec_context *ctx)
+{
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	return macsec_offload_upd_sa(ctx, ctx->sa.rx_sa->sc->sci,
+				     ctx->sa.assoc_num, 0, false,
+				     OSI_CTLR_SEL_RX);
+}
+
+static int macsec_mdo_add_txsa(struct macsec_context *ctx)
+{
+	struct macsec_secy *secy = ctx->secy;
+	struct macsec_tx_sa *tx_sa = ctx->sa.tx_sa;
+
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	return macsec_offload_add_sa(ctx, secy->sci,
+				     tx_sa->next_pn_halves.lower,
+				     tx_sa->active &&
+				     ctx->sa.assoc_num == secy->tx_sc.encoding_sa,
+				     OSI_CTLR_SEL_TX);
+}
+
+static int macsec_mdo_upd_txsa(struct macsec_context *ctx)
+{
+	struct macsec_secy *secy = ctx->secy;
+	struct macsec_tx_sa *tx_sa = ctx->sa.tx_sa;
+
+	if (ctx->sa.update_pn)
+		return -EOPNOTSUPP;
+
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	/* A non encoding SA stays created until it becomes encoding SA */
+	if (tx_sa->active && ctx->sa.assoc_num != secy->tx_sc.encoding_sa)
+		return 0;
+
+	return macsec_offload_upd_sa(ctx, secy->sci, ctx->sa.assoc_num,
+				     tx_sa->next_pn_halves.lower,
+				     tx_sa->active, OSI_CTLR_SEL_TX);
+}
+
+static int macsec_mdo_del_txsa(struct macsec_context *ctx)
+{
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	return macsec_offload_upd_sa(ctx, ctx->secy->sci, ctx->sa.assoc_num,
+				     0, false, OSI_CTLR_SEL_TX);
+}
+
+static int macsec_mdo_get_dev_stats(struct macsec_context *ctx)
+{
+	struct macsec_priv_data *macsec_pdata = macsec_ctx_to_pdata(ctx);
+	struct osi_core_priv_data *osi_core =
+		macsec_pdata->ether_pdata->osi_core;
+	struct osi_macsec_mmc_counters *mmc = &osi_core->macsec_mmc;
+	struct macsec_dev_stats *stats = ctx->stats.dev_stats;
+
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	mutex_lock(&macsec_pdata->lock);
+	osi_macsec_read_mmc(osi_core);
+	stats->OutPktsUntagged = mmc->tx_pkts_untaged;
+	stats->InPktsUntagged = mmc->rx_pkts_untagged;
+	stats->OutPktsTooLong = mmc->tx_pkts_too_long;
+	stats->InPktsNoTag = mmc->rx_pkts_no_tag;
+	stats->InPktsBadTag = mmc->rx_pkts_bad_tag;
+	stats->InPktsUnknownSCI = mmc->rx_pkts_no_sa;
+	stats->InPktsNoSCI = mmc->rx_pkts_no_sa_err;
+	stats->InPktsOverrun = mmc->rx_pkts_overrun;
+	mutex_unlock(&macsec_pdata->lock);
+
+	return 0;
+}
+
+static int macsec_mdo_get_tx_sc_stats(struct macsec_context *ctx)
+{
+	struct macsec_priv_data *macsec_pdata = macsec_ctx_to_pdata(ctx);
+	struct osi_core_priv_data *osi_core =
+		macsec_pdata->ether_pdata->osi_core;
+	struct osi_macsec_mmc_counters *mmc = &osi_core->macsec_mmc;
+	struct macsec_tx_sc_stats *stats = ctx->stats.tx_sc_stats;
+	unsigned char sci[OSI_SCI_LEN];
+	unsigned int key_index = 0;
+	unsigned int sc;
+
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	memcpy(sci, &ctx->secy->sci, sizeof(sci));
+	mutex_lock(&macsec_pdata->lock);
+	if (osi_macsec_get_sc_lut_key_index(osi_core, sci, &key_index,
+					    OSI_CTLR_SEL_TX) < 0) {
+		mutex_unlock(&macsec_pdata->lock);
+		return -ENOENT;
+	}
+	sc = key_index / OSI_MAX_NUM_SA;
+
+	osi_macsec_read_mmc(osi_core);
+	if (ctx->secy->tx_sc.encrypt) {
+		stats->OutPktsEncrypted = mmc->tx_pkts_protected[sc];
+		stats->OutOctetsEncrypted = mmc->tx_octets_protected;
+	} else {
+		stats->OutPktsProtected = mmc->tx_pkts_protected[sc];
+		stats->OutOctetsProtected = mmc->tx_octets_protected;
+	}
+	mutex_unlock(&macsec_pdata->lock);
+
+	return 0;
+}
+
+static int macsec_mdo_get_rx_sc_stats(struct macsec_context *ctx)
+{
+	struct macsec_priv_data *macsec_pdata = macsec_ctx_to_pdata(ctx);
+	struct osi_core_priv_data *osi_core =
+		macsec_pdata->ether_pdata->osi_core;
+	struct osi_macsec_mmc_counters *mmc = &osi_core->macsec_mmc;
+	struct macsec_rx_sc_stats *stats = ctx->stats.rx_sc_stats;
+	unsigned char sci[OSI_SCI_LEN];
+	unsigned int key_index = 0;
+	unsigned int sc;
+
+#ifdef ETHER_MACSEC_PREPARE
+	if (ctx->prepare)
+		return 0;
+#endif
+	memcpy(sci, &ctx->rx_sc->sci, sizeof(sci));
+	mutex_lock(&macsec_pdata->lock);
+	if (osi_macsec_get_sc_lut_key_index(osi_core, sci, &key_index,
+					    OSI_CTLR_SEL_RX) < 0) {
+		mutex_unlock(&macsec_pdata->lock);
+		return -ENOENT;
+	}
+	sc = key_index / OSI_MAX_NUM_SA;
+
+	osi_macsec_read_mmc(osi_core);
+	stats->InOctetsValidated = mmc->rx_octets_validated;
+	stats->InPktsUnchecked = mmc->rx_pkts_unchecked[sc];
+	stats->InPktsDelayed = mmc->rx_pkts_delayed[sc];
+	stats->InPktsOK = mmc->rx_pkts_ok[sc];
+	stats->InPktsInvalid = mmc->in_pkts_invalid[sc];
+	stats->InPktsLate = mmc->rx_pkts_late[sc];
+	stats->InPktsNotValid = mmc->rx_pkts_not_valid[sc];
+	mutex_unlock(&macsec_pdata->lock);
+
+	return 0;
+}
+
+static int macsec_mdo_get_sa_stats(struct macsec_context *ctx)
+{
+	/* HW counts per SC only, SA stats are left at zero */
+	return 0;
+}
+
+static const struct macsec_ops ether_macsec_ops = {
+	.mdo_dev_open = macsec_mdo_dev_open,
+	.mdo_dev_stop = macsec_mdo_dev_stop,
+	.mdo_add_secy = macsec_mdo_add_secy,
+	.mdo_upd_secy = macsec_mdo_upd_secy,
+	.mdo_del_secy = macsec_mdo_del_secy,
+	.mdo_add_rxsc = macsec_mdo_add_rxsc,
+	.mdo_upd_rxsc = macsec_mdo_upd_rxsc,
+	.mdo_del_rxsc = macsec_mdo_del_rxsc,
+	.mdo_add_rxsa = macsec_mdo_add_rxsa,
+	.mdo_upd_rxsa = macsec_mdo_upd_rxsa,
+	.mdo_del_rxsa = macsec_mdo_del_rxsa,
+	.mdo_add_txsa = macsec_mdo_add_txsa,
+	.mdo_upd_txsa = macsec_mdo_upd_txsa,
+	.mdo_del_txsa = macsec_mdo_del_txsa,
+	.mdo_get_dev_stats = macsec_mdo_get_dev_stats,
+	.mdo_get_tx_sc_stats = macsec_mdo_get_tx_sc_stats,
+	.mdo_get_tx_sa_stats = macsec_mdo_get_sa_stats,
+	.mdo_get_rx_sc_stats = macsec_mdo_get_rx_sc_stats,
+	.mdo_get_rx_sa_stats = macsec_mdo_get_sa_stats,
+};
+#endif /* ETHER_MACSEC_OFFLOAD */
+
 void macsec_remove(struct ether_priv_data *pdata)
 {
 	struct macsec_priv_data *macsec_pdata = NULL;
@@ -1499,6 +2099,15 @@ void macsec_remove(struct ether_priv_data *pdata)
 	PRINT_ENTRY();
 	macsec_pdata = pdata->macsec_pdata;
 	if (macsec_pdata) {
+#ifdef ETHER_MACSEC_OFFLOAD
+		/* No more offload calls once macsec_pdata is gone */
+		rtnl_lock();
+		pdata->ndev->macsec_ops = NULL;
+		pdata->ndev->hw_features &= ~NETIF_F_HW_MACSEC;
+		pdata->ndev->features &= ~NETIF_F_HW_MACSEC;
+		netdev_features_change(pdata->ndev);
+		rtnl_unlock();
+#endif /* ETHER_MACSEC_OFFLOAD */
 		mutex_lock(&macsec_pdata->lock);
 		/* Delete if any supplicant active heartbeat timer */
 		supplicant = macsec_pdata->supplicant;
@@ -1651,6 +2260,18 @@ int macsec_probe(struct ether_priv_data *pdata)
 			macsec_pdata->is_nv_macsec_fam_registered = OSI_ENABLE;
 	}
 
+#ifdef ETHER_MACSEC_OFFLOAD
+	/* Let the kernel MACsec driver offload a SecY, netdev is already
+	 * registered at this point.
+	 */
+	rtnl_lock();
+	pdata->ndev->macsec_ops = &ether_macsec_ops;
+	pdata->ndev->hw_features |= NETIF_F_HW_MACSEC;
+	pdata->ndev->features |= NETIF_F_HW_MACSEC;
+	netdev_features_change(pdata->ndev);
+	rtnl_unlock();
+#endif /* ETHER_MACSEC_OFFLOAD */
+
 	PRINT_EXIT();
 	return ret;
 genl_err:
@@ -60,6 +60,20 @@
 #define MACSEC_SIZE 0x10000U
 #endif
 
+/**
+ * @brief Kernel MACsec offload through macsec_ops. The stack hands over the
+ * SAK in clear, so it is only possible when the driver programs the key
+ * table itself.
+ */
+#if defined(MACSEC_KEY_PROGRAM) && IS_ENABLED(CONFIG_MACSEC)
+#define ETHER_MACSEC_OFFLOAD
+#include <net/macsec.h>
+/* Offload ops are called twice, with prepare set and then to commit */
+#if (KERNEL_VERSION(6, 2, 0) > LINUX_VERSION_CODE)
+#define ETHER_MACSEC_PREPARE
+#endif
+#endif /* MACSEC_KEY_PROGRAM && CONFIG_MACSEC */
+
 #define KEY2STR(a) (a)[0], (a)[1], (a)[2], (a)[3], (a)[4], (a)[5],\
 		   (a)[6], (a)[7], (a)[8], (a)[9], (a)[10], (a)[11],\
 		   (a)[12], (a)[13], (a)[14], (a)[15]
@@ -276,6 +290,10 @@ struct macsec_priv_data {
 	unsigned int macsec_tx_an_map;
 	/** Macsec RX currently enabled AN */
 	unsigned int macsec_rx_an_map;
+#ifdef ETHER_MACSEC_OFFLOAD
+	/** SecY offloaded by the kernel MACsec driver, NULL if none */
+	struct macsec_secy *offload_secy;
+#endif /* ETHER_MACSEC_OFFLOAD */
 };
 
 int macsec_probe(struct ether_priv_data *pdata);
@@ -17,81 +17,51 @@
 #include "ether_linux.h"
 
 /**
- * @brief ether_get_free_tx_ts_node - get free node for pending SKB
+ * @brief ether_add_tx_ts_slot - park SKB waiting for MAC Tx timestamp
  *
  * Algorithm:
- *  - Find index of statically allocayted free memory for pending SKB
+ *  - Probe the slot array from pktid and claim the first free slot.
+ *  - Publish the slot to the timestamp consumers through ready bit.
  *
  * @param[in] pdata: OSD private data structure.
+ * @param[in] skb: SKB waiting for timestamp.
+ * @param[in] pktid: Packet ID of the SKB.
  *
- * @retval index number
+ * @retval slot index on success
+ * @retval ETHER_MAX_PENDING_SKB_CNT if no slot is free, skb is consumed
  */
-static inline unsigned int ether_get_free_tx_ts_node(struct ether_priv_data *pdata)
+static inline unsigned int ether_add_tx_ts_slot(struct ether_priv_data *pdata,
+						struct sk_buff *skb,
+						unsigned int pktid)
 {
-	unsigned int i;
+	struct ether_tx_ts_slot *slot;
+	unsigned int idx, i;
 
 	for (i = 0; i < ETHER_MAX_PENDING_SKB_CNT; i++) {
-		if (pdata->tx_ts_skb[i].in_use == OSI_NONE) {
+		idx = (pktid + i) % ETHER_MAX_PENDING_SKB_CNT;
+		if (!test_and_set_bit(idx, pdata->tx_ts_busy))
 			break;
-		}
 	}
 
-	return i;
-}
-
-static inline void add_skb_node(struct ether_priv_data *pdata, struct sk_buff *skb,
-				unsigned int pktid) {
-	struct list_head *head_node, *temp_head_node;
-	struct ether_tx_ts_skb_list *pnode = NULL;
-	unsigned int idx;
-	unsigned long flags;
-	unsigned long now_jiffies = jiffies;
-
-	if (list_empty(&pdata->tx_ts_skb_head)) {
-		goto empty;
-	}
-
-	raw_spin_lock_irqsave(&pdata->txts_lock, flags);
-	list_for_each_safe(head_node, temp_head_node,
-			   &pdata->tx_ts_skb_head) {
-		pnode = list_entry(head_node,
-				   struct ether_tx_ts_skb_list,
-				   list_head);
-
-		if ((jiffies_to_msecs(now_jiffies) - jiffies_to_msecs(pnode->pkt_jiffies))
-		     >= ETHER_SECTOMSEC) {
-			dev_dbg(pdata->dev, "%s() skb %p deleting for pktid = %x time=%lu\n",
-				__func__, pnode->skb, pnode->pktid, pnode->pkt_jiffies);
-			if (pnode->skb != NULL) {
-				dev_consume_skb_any(pnode->skb);
-			}
-			list_del(head_node);
-			pnode->in_use = OSI_DISABLE;
-		}
-	}
-	raw_spin_unlock_irqrestore(&pdata->txts_lock, flags);
-empty:
-	raw_spin_lock_irqsave(&pdata->txts_lock, flags);
-	idx = ether_get_free_tx_ts_node(pdata);
-	if (idx == ETHER_MAX_PENDING_SKB_CNT) {
+	if (i == ETHER_MAX_PENDING_SKB_CNT) {
 		dev_dbg(pdata->dev,
 			"No free node to store pending SKB\n");
 		dev_consume_skb_any(skb);
-		raw_spin_unlock_irqrestore(&pdata->txts_lock, flags);
-		return;
+		return ETHER_MAX_PENDING_SKB_CNT;
 	}
 
-	pdata->tx_ts_skb[idx].in_use = OSI_ENABLE;
-	pnode = &pdata->tx_ts_skb[idx];
-	pnode->skb = skb;
-	pnode->pktid = pktid;
-	pnode->pkt_jiffies = now_jiffies;
+	slot = &pdata->tx_ts_slot[idx];
+	slot->skb = skb;
+	slot->pktid = pktid;
+	slot->pkt_jiffies = jiffies;
 
 	dev_dbg(pdata->dev, "%s() SKB %p added for pktid = %x time=%lu\n",
-		__func__, skb, pktid, pnode->pkt_jiffies);
-	list_add_tail(&pnode->list_head,
-		      &pdata->tx_ts_skb_head);
-	raw_spin_unlock_irqrestore(&pdata->txts_lock, flags);
+		__func__, skb, pktid, slot->pkt_jiffies);
+	/* slot content must be visible before it is marked ready */
+	smp_mb__before_atomic();
+	set_bit(idx, pdata->tx_ts_ready);
+
+	return idx;
 }
 
 /**
@@ -212,8 +182,8 @@ static inline int ether_alloc_skb(struct ether_priv_data *pdata,
 {
 #ifndef ETHER_PAGE_POOL
 	struct sk_buff *skb = NULL;
-	dma_addr_t dma_addr;
 #endif
+	dma_addr_t dma_addr;
 	unsigned long val;
 
 	if (((rx_swcx->flags & OSI_RX_SWCX_REUSE) == OSI_RX_SWCX_REUSE) &&
@@ -237,19 +207,22 @@ static inline int ether_alloc_skb(struct ether_priv_data *pdata,
 		val = pdata->xstats.re_alloc_rxbuf_failed[chan];
 		pdata->xstats.re_alloc_rxbuf_failed[chan] =
 			osi_update_stats_counter(val, 1UL);
+		ETHER_CHAN_STAT_INC(pdata, chan, rx_refill_err_n);
 		return 0;
 	}
 
 	dma_addr = dma_map_single(pdata->dev, skb->data, dma_rx_buf_len,
 				  DMA_FROM_DEVICE);
 	if (unlikely(dma_mapping_error(pdata->dev, dma_addr) != 0)) {
+		ETHER_CHAN_STAT_INC(pdata, chan, rx_refill_err_n);
+		ETHER_CHAN_STAT_INC(pdata, chan, dma_map_err_n);
 		dev_err(pdata->dev, "RX skb dma map failed\n");
 		dev_kfree_skb_any(skb);
 		return -ENOMEM;
 	}
 
 #else
-	rx_swcx->buf_virt_addr = page_pool_dev_alloc_pages(pdata->page_pool[chan]);
+	rx_swcx->buf_virt_addr = ether_rx_alloc_buf(pdata, chan, &dma_addr);
 	if (!rx_swcx->buf_virt_addr) {
 		dev_err(pdata->dev,
 			"page pool allocation failed using resv_buf\n");
@@ -259,10 +232,12 @@ static inline int ether_alloc_skb(struct ether_priv_data *pdata,
 		val = pdata->xstats.re_alloc_rxbuf_failed[chan];
 		pdata->xstats.re_alloc_rxbuf_failed[chan] =
 			osi_update_stats_counter(val, 1UL);
+		ETHER_CHAN_STAT_INC(pdata, chan, rx_refill_err_n);
 		return 0;
 	}
+	ETHER_CHAN_STAT_INC(pdata, chan, rx_page_alloc_n);
 
-	rx_swcx->buf_phy_addr = page_pool_get_dma_addr(rx_swcx->buf_virt_addr);
+	rx_swcx->buf_phy_addr = dma_addr;
 #endif
 #ifndef ETHER_PAGE_POOL
 	rx_swcx->buf_virt_addr = skb;
@@ -343,6 +318,7 @@ static void osd_realloc_buf(void *priv, struct osi_rx_ring *rx_ring,
 static inline void ether_gro_merge_complete(struct sk_buff_head *nvgro_q,
 					    struct napi_struct *napi)
 {
+	struct ether_rx_napi *rx_napi;
 	struct list_head h;
 	struct sk_buff *f_skb, *p, *pp;
 
@@ -382,27 +358,33 @@ static inline void ether_gro_merge_complete(struct sk_buff_head *nvgro_q,
 	}
 
 	skb_list_del_init(f_skb);
+	rx_napi = container_of(napi, struct ether_rx_napi, napi);
+	ETHER_CHAN_STAT_ADD(rx_napi->pdata, rx_napi->chan, nvgro_merge_n,
+			    NAPI_GRO_CB(f_skb)->count);
+	ETHER_CHAN_STAT_INC(rx_napi->pdata, rx_napi->chan, nvgro_flush_n);
 	napi_gro_complete(napi, f_skb);
 }
 
 /**
  * @brief ether_update_fq_with_fs - Populates final queue with TTL = 1 packet
  *
- * @param[in] pdata: Ethernet driver private data
+ * @param[in] rx_napi: Rx NAPI of the channel.
+ * @param[in] flow: NVGRO queues of the packet flow.
  * @param[in] skb: Socket buffer.
  */
-static inline void ether_update_fq_with_fs(struct ether_priv_data *pdata,
+static inline void ether_update_fq_with_fs(struct ether_rx_napi *rx_napi,
+					   struct ether_nvgro_flow *flow,
 					   struct sk_buff *skb)
 {
-	if (!skb_queue_empty(&pdata->fq)) {
-		pdata->nvgro_dropped += pdata->fq.qlen;
-		__skb_queue_purge(&pdata->fq);
+	if (!skb_queue_empty(&flow->fq)) {
+		rx_napi->nvgro_dropped += flow->fq.qlen;
+		__skb_queue_purge(&flow->fq);
 	}
 
 	/* queue skb to fq which has TTL = 1 */
-	__skb_queue_tail(&pdata->fq, skb);
+	__skb_queue_tail(&flow->fq, skb);
 
-	pdata->expected_ip_id = NAPI_GRO_CB(skb)->flush_id + 1;
+	flow->expected_ip_id = NAPI_GRO_CB(skb)->flush_id + 1;
 }
 
 /**
@@ -467,85 +449,140 @@ static inline void ether_gro(struct sk_buff_head *fq, struct sk_buff_head *mq,
 /**
  * @brief ether_purge_q - Purge master queue based on packet age.
  *
- * @param[in] pdata: Ethernet private data.
+ * @param[in] rx_napi: Rx NAPI of the channel.
+ * @param[in] mq: NVGRO packet out of order queue.
+ * @param[in] age: Age threshold in jiffies.
  */
-static inline void ether_purge_q(struct ether_priv_data *pdata)
+static inline void ether_purge_q(struct ether_rx_napi *rx_napi,
+				 struct sk_buff_head *mq, unsigned long age)
 {
 	struct sk_buff *p, *pp;
 
-	skb_queue_walk_safe(&pdata->mq, p, pp) {
-		if ((jiffies - NAPI_GRO_CB(p)->age) >
-		    msecs_to_jiffies(pdata->pkt_age_msec)) {
-			__skb_unlink(p, &pdata->mq);
+	skb_queue_walk_safe(mq, p, pp) {
+		if ((jiffies - NAPI_GRO_CB(p)->age) > age) {
+			__skb_unlink(p, mq);
 			dev_consume_skb_any(p);
-			pdata->nvgro_dropped++;
+			rx_napi->nvgro_dropped++;
 		} else {
 			return;
 		}
 	}
 }
 
+void ether_nvgro_purge(struct ether_rx_napi *rx_napi, bool all)
+{
+	unsigned long age = msecs_to_jiffies(rx_napi->pdata->pkt_age_msec);
+	struct ether_nvgro_flow *flow;
+	struct sk_buff *f_skb;
+	unsigned int i;
+
+	for (i = 0; i < NVGRO_NUM_FLOWS; i++) {
+		flow = &rx_napi->nvgro_flow[i];
+
+		if (all) {
+			rx_napi->nvgro_dropped += flow->mq.qlen +
+						  flow->fq.qlen;
+			__skb_queue_purge(&flow->mq);
+			__skb_queue_purge(&flow->fq);
+			continue;
+		}
+
+		ether_purge_q(rx_napi, &flow->mq, age);
+
+		f_skb = skb_peek(&flow->fq);
+		if (f_skb && (jiffies - NAPI_GRO_CB(f_skb)->age) > age) {
+			rx_napi->nvgro_dropped += flow->fq.qlen;
+			__skb_queue_purge(&flow->fq);
+		}
+	}
+}
+
 /**
  * @brief ether_nvgro_purge_timer - NVGRO purge timer handler.
  *
+ * Algorithm: Flags the purge to the Rx NAPI of every channel, which runs
+ * it before its next Rx processing. The queues are therefore owned by the
+ * NAPI context and need no locking against the timer.
+ *
  * @param[in] t: Pointer to the timer.
  */
 void ether_nvgro_purge_timer(struct timer_list *t)
 {
 	struct ether_priv_data *pdata = from_timer(pdata, t, nvgro_timer);
-	struct sk_buff *f_skb;
-
-	if (atomic_read(&pdata->rx_state) == OSI_ENABLE)
-		return;
-
-	atomic_set(&pdata->timer_state, OSI_ENABLE);
-
-	ether_purge_q(pdata);
-
-	f_skb = skb_peek(&pdata->fq);
-	if (!f_skb)
-		goto exit;
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	struct ether_rx_napi *rx_napi;
+	unsigned int i;
 
-	if ((jiffies - NAPI_GRO_CB(f_skb)->age) >
-	    msecs_to_jiffies(pdata->pkt_age_msec)) {
-		pdata->nvgro_dropped += pdata->fq.qlen;
-		__skb_queue_purge(&pdata->fq);
+	for (i = 0; i < osi_dma->num_dma_chans; i++) {
+		rx_napi = pdata->rx_napi[osi_dma->dma_chans[i]];
+		atomic_set(&rx_napi->nvgro_purge, OSI_ENABLE);
+		napi_schedule(&rx_napi->napi);
 	}
 
-exit:
-	atomic_set(&pdata->timer_state, OSI_DISABLE);
-
 	mod_timer(&pdata->nvgro_timer,
 		  jiffies + msecs_to_jiffies(pdata->nvgro_timer_intrvl));
 }
 
+/**
+ * @brief ether_nvgro_get_flow - Get the NVGRO queues of a UDP flow.
+ *
+ * @param[in] rx_napi: Rx NAPI of the channel.
+ * @param[in] iph: IPv4 header of the packet.
+ * @param[in] uh: UDP header of the packet.
+ *
+ * @retval NVGRO queues of the hash bucket of the flow.
+ */
+static inline struct ether_nvgro_flow *
+ether_nvgro_get_flow(struct ether_rx_napi *rx_napi, const struct iphdr *iph,
+		     const struct udphdr *uh)
+{
+	u32 hash = jhash_3words((__force u32)iph->saddr,
+				(__force u32)iph->daddr,
+				((__force u32)uh->source << 16) |
+				(__force u32)uh->dest, 0);
+
+	return &rx_napi->nvgro_flow[hash & (NVGRO_NUM_FLOWS - 1U)];
+}
+
 /**
  * @brief ether_do_nvgro - Perform NVGRO processing.
  *
+ * Algorithm: Reassembles the packets of a UDP flow in the queues of the
+ * flow's hash bucket on the Rx channel. Packets of one flow arrive on one
+ * channel, so the NAPI contexts of the channels share no state.
+ *
  * @param[in] pdata: Ethernet private data.
- * @param[in] napi: Ethernet driver NAPI instance.
+ * @param[in] rx_napi: Rx NAPI of the channel.
  * @param[in] skb: socket buffer
  *
  * @retval true on Success
  * @retval false on failure.
  */
 static bool ether_do_nvgro(struct ether_priv_data *pdata,
-			   struct napi_struct *napi,
+			   struct ether_rx_napi *rx_napi,
 			   struct sk_buff *skb)
 {
-	struct udphdr *uh = (struct udphdr *)(skb->data + sizeof(struct iphdr));
-	struct iphdr *iph = (struct iphdr *)skb->data;
-	struct sk_buff_head *mq = &pdata->mq;
+	struct napi_struct *napi = &rx_napi->napi;
 	struct ethhdr *ethh = eth_hdr(skb);
+	struct ether_nvgro_flow *flow;
+	struct sk_buff_head *mq;
 	struct sock *sk = NULL;
+	struct udphdr *uh;
+	struct iphdr *iph;
 
 	if (ethh->h_proto != htons(ETH_P_IP))
 		return false;
 
+	/* headers of page pool packets may end before the UDP header */
+	if (!pskb_may_pull(skb, sizeof(struct iphdr) + sizeof(struct udphdr)))
+		return false;
+
+	iph = (struct iphdr *)skb->data;
+	uh = (struct udphdr *)(skb->data + sizeof(struct iphdr));
+
 	if (iph->protocol != IPPROTO_UDP)
 		return false;
 
-	/* TODO: Hash based based queues selection */
 	/* Socket look up with IPv4/UDP source/destination */
 	sk = __udp4_lib_lookup(dev_net(skb->dev), iph->saddr, uh->source,
 			       iph->daddr, uh->dest, inet_iif(skb),
@@ -562,25 +599,22 @@ static bool ether_do_nvgro(struct ether_priv_data *pdata,
 	NAPI_GRO_CB(skb)->free = (iph->ttl & (BIT(6) | BIT(7))) >> 6;
 	NAPI_GRO_CB(skb)->age = jiffies;
 
-	while (atomic_read(&pdata->timer_state) == OSI_ENABLE) {
-		/* busyloop */
-	};
-
-	atomic_set(&pdata->rx_state, OSI_ENABLE);
+	flow = ether_nvgro_get_flow(rx_napi, iph, uh);
+	mq = &flow->mq;
 
 	if (NAPI_GRO_CB(skb)->free == 1) {
 		/* Update final queue with first segment */
-		ether_update_fq_with_fs(pdata, skb);
-		goto exit;
+		ether_update_fq_with_fs(rx_napi, flow, skb);
+		return true;
 	} else {
-		if (pdata->expected_ip_id == NAPI_GRO_CB(skb)->flush_id) {
-			__skb_queue_tail(&pdata->fq, skb);
-			pdata->expected_ip_id = NAPI_GRO_CB(skb)->flush_id + 1;
+		if (flow->expected_ip_id == NAPI_GRO_CB(skb)->flush_id) {
+			__skb_queue_tail(&flow->fq, skb);
+			flow->expected_ip_id = NAPI_GRO_CB(skb)->flush_id + 1;
 
 			if (NAPI_GRO_CB(skb)->free == 2)
-				ether_gro_merge_complete(&pdata->fq, napi);
+				ether_gro_merge_complete(&flow->fq, napi);
 
-			goto exit;
+			return true;
 		}
 	}
 
@@ -589,16 +623,193 @@ static bool ether_do_nvgro(struct ether_priv_data *pdata,
 
 	/* Queue the packets until last segment received */
 	if (NAPI_GRO_CB(skb)->free != 2)
-		goto exit;
+		return true;
 
-	ether_gro(&pdata->fq, &pdata->mq, napi);
+	ether_gro(&flow->fq, mq, napi);
 
-exit:
-	atomic_set(&pdata->rx_state, OSI_DISABLE);
 	return true;
 }
 #endif
 
+#ifdef ETHER_PAGE_POOL
+/**
+ * @brief Build the skb of a packet received in a page pool buffer.
+ *
+ * Algorithm: Copies short packets and recycles the page right away. Of
+ * longer packets only the headers are copied into the small NAPI skb, the
+ * payload is attached as a page fragment of the Rx buffer truesize which
+ * returns to the pool when the skb is freed. Without skb recycling support
+ * the whole packet is copied.
+ *
+ * @param[in] pdata: OSD private data structure.
+ * @param[in] chan: DMA Rx channel number.
+ * @param[in] page: Page pool buffer holding the packet.
+ * @param[in] offset: Offset of the packet in the page.
+ * @param[in] len: Length of the packet.
+ * @param[in] dma_len: Length written by the DMA, synced on recycling.
+ *
+ * @retval skb on success
+ * @retval NULL if no skb could be allocated, the page is recycled.
+ */
+static struct sk_buff *ether_rx_build_skb(struct ether_priv_data *pdata,
+					  unsigned int chan, struct page *page,
+					  unsigned int offset, unsigned int len,
+					  unsigned int dma_len)
+{
+	struct page_pool *pool = pdata->page_pool[chan];
+	void *data = page_address(page) + offset;
+	unsigned int hlen = len;
+	struct sk_buff *skb;
+
+#ifdef ETHER_RX_FRAGS
+	if (len > ETHER_RX_HDR_LEN)
+		hlen = eth_get_headlen(pdata->ndev, data, ETHER_RX_HDR_LEN);
+	/* the last buffer recycled syncs all buffers of a shared page */
+	if (ether_rx_buf_is_frag(pdata, pool))
+		dma_len = pool->p.max_len;
+#endif
+	skb = napi_alloc_skb(&pdata->rx_napi[chan]->napi, hlen);
+	if (unlikely(!skb)) {
+		page_pool_put_page(pool, page, dma_len, true);
+		ETHER_CHAN_STAT_INC(pdata, chan, rx_page_recycle_n);
+		return NULL;
+	}
+
+	skb_put_data(skb, data, hlen);
+	if (hlen == len) {
+		page_pool_put_page(pool, page, dma_len, true);
+		ETHER_CHAN_STAT_INC(pdata, chan, rx_page_recycle_n);
+		return skb;
+	}
+
+#ifdef ETHER_RX_FRAGS
+	skb_add_rx_frag(skb, 0, page, offset + hlen, len - hlen,
+			pdata->rx_buf_truesize);
+	skb_mark_for_recycle(skb);
+#endif
+	return skb;
+}
+#endif
+
+#ifdef ETHER_XDP
+/**
+ * @brief Run the XDP program of the interface on a received packet.
+ *
+ * Algorithm: Runs the program on the page pool buffer and carries out its
+ * verdict. Only packets passed to the stack remain with the caller.
+ *
+ * @param[in] pdata: OSD private data structure.
+ * @param[in] chan: DMA Rx channel number.
+ * @param[in] page: Page pool buffer holding the packet.
+ * @param[in, out] offset: Offset of the packet in the page.
+ * @param[in, out] len: Length of the packet.
+ *
+ * @retval true if XDP consumed the page
+ * @retval false to pass the packet at the updated offset and len to the stack
+ */
+static bool ether_xdp_rx(struct ether_priv_data *pdata, unsigned int chan,
+			 struct page *page, unsigned int *offset,
+			 unsigned int *len)
+{
+	struct bpf_prog *prog = READ_ONCE(pdata->xdp_prog);
+	struct page_pool *pool = pdata->page_pool[chan];
+	/* frame starts at the Rx buffer, which may share the page */
+	unsigned int buf_offset = *offset - ETHER_RX_HEADROOM;
+	struct xdp_frame *xdpf;
+	struct xdp_buff xdp;
+	unsigned long val;
+	u32 act;
+
+	if (!prog)
+		return false;
+
+	xdp_init_buff(&xdp, pdata->rx_buf_truesize, &pdata->xdp_rxq[chan]);
+	xdp_prepare_buff(&xdp, page_address(page) + buf_offset,
+			 ETHER_RX_HEADROOM, *len, false);
+
+	act = bpf_prog_run_xdp(prog, &xdp);
+	switch (act) {
+	case XDP_PASS:
+		*offset = xdp.data - page_address(page);
+		*len = xdp.data_end - xdp.data;
+		return false;
+	case XDP_TX:
+		xdpf = xdp_convert_buff_to_frame(&xdp);
+		if (unlikely(!xdpf || ether_xdp_tx(pdata, xdpf) < 0))
+			break;
+		val = pdata->xstats.xdp_tx_n[chan];
+		pdata->xstats.xdp_tx_n[chan] =
+			osi_update_stats_counter(val, 1UL);
+		return true;
+	case XDP_REDIRECT:
+		if (unlikely(xdp_do_redirect(pdata->ndev, &xdp, prog) < 0))
+			break;
+		pdata->rx_napi[chan]->xdp_redirect = true;
+		val = pdata->xstats.xdp_redirect_n[chan];
+		pdata->xstats.xdp_redirect_n[chan] =
+			osi_update_stats_counter(val, 1UL);
+		return true;
+	case XDP_DROP:
+		goto drop;
+	default:
+#if (KERNEL_VERSION(5, 17, 0) <= LINUX_VERSION_CODE)
+		bpf_warn_invalid_xdp_action(pdata->ndev, prog, act);
+#else
+		bpf_warn_invalid_xdp_action(act);
+#endif
+		fallthrough;
+	case XDP_ABORTED:
+		break;
+	}
+
+	trace_xdp_exception(pdata->ndev, prog, act);
+drop:
+	val = pdata->xstats.xdp_drop_n[chan];
+	pdata->xstats.xdp_drop_n[chan] = osi_update_stats_counter(val, 1UL);
+	page_pool_recycle_direct(pool, page);
+	ETHER_CHAN_STAT_INC(pdata, chan, rx_page_recycle_n);
+	return true;
+}
+#endif
+
+#ifdef ETHER_RX_DMABUF
+/**
+ * @brief Complete a packet received in a dma-buf slot
+ *
+ * Algorithm: Queues the slot of a valid packet for the application to
+ * reap, gives the slot of a bad one back to the free slots. The payload
+ * stays in the dma-buf and never reaches the network stack.
+ *
+ * @param[in] pdata: OSD private data structure.
+ * @param[in] rx_pkt_cx: Received packet context.
+ * @param[in] slot: dma-buf slot holding the packet.
+ */
+static void ether_rx_dmabuf_receive(struct ether_priv_data *pdata,
+				    const struct osi_rx_pkt_cx *rx_pkt_cx,
+				    struct ether_rx_dmabuf_slot *slot)
+{
+	struct ether_rx_dmabuf *rxd = slot->rxd;
+	unsigned int tail;
+
+	if (unlikely((rx_pkt_cx->flags & OSI_PKT_CX_VALID) !=
+		     OSI_PKT_CX_VALID)) {
+		pdata->ndev->stats.rx_errors++;
+		ether_rx_dmabuf_put(slot);
+		return;
+	}
+
+	/* never full, a slot is completed once until it is returned */
+	spin_lock(&rxd->lock);
+	tail = (rxd->cpl_head + rxd->cpl_cnt) % rxd->nr_slots;
+	rxd->cpl[tail].slot = slot->idx;
+	rxd->cpl[tail].len = rx_pkt_cx->pkt_len;
+	rxd->cpl_cnt++;
+	spin_unlock(&rxd->lock);
+
+	pdata->ndev->stats.rx_bytes += rx_pkt_cx->pkt_len;
+}
+#endif
+
 /**
  * @brief Handover received packet to network stack.
  *
@@ -627,6 +838,8 @@ static void osd_receive_packet(void *priv, struct osi_rx_ring *rx_ring,
 	struct ether_rx_napi *rx_napi = pdata->rx_napi[chan];
 #ifdef ETHER_PAGE_POOL
 	struct page *page = (struct page *)rx_swcx->buf_virt_addr;
+	unsigned int pkt_offset;
+	unsigned int pkt_len = rx_pkt_cx->pkt_len;
 	struct sk_buff *skb = NULL;
 #else
 	struct sk_buff *skb = (struct sk_buff *)rx_swcx->buf_virt_addr;
@@ -639,28 +852,37 @@ static void osd_receive_packet(void *priv, struct osi_rx_ring *rx_ring,
 
 #ifndef ETHER_PAGE_POOL
 	dma_unmap_single(pdata->dev, dma_addr, dma_buf_len, DMA_FROM_DEVICE);
+#endif
+#ifdef ETHER_RX_DMABUF
+	if (ether_rx_buf_is_dmabuf(rx_swcx->buf_virt_addr)) {
+		ether_rx_dmabuf_receive(pdata, rx_pkt_cx,
+					ether_rx_buf_to_slot(rx_swcx->buf_virt_addr));
+		goto done;
+	}
 #endif
 	/* Process only the Valid packets */
 	if (likely((rx_pkt_cx->flags & OSI_PKT_CX_VALID) ==
 		   OSI_PKT_CX_VALID)) {
 #ifdef ETHER_PAGE_POOL
-		skb = netdev_alloc_skb_ip_align(pdata->ndev,
-						rx_pkt_cx->pkt_len);
+		dma_sync_single_for_cpu(pdata->dev, dma_addr, pkt_len,
+					ETHER_RX_DMA_DIR);
+		/* buffer may not start at the page when pages are shared */
+		pkt_offset = dma_addr - page_pool_get_dma_addr(page);
+#ifdef ETHER_XDP
+		if (ether_xdp_rx(pdata, chan, page, &pkt_offset, &pkt_len)) {
+			ndev->stats.rx_bytes += pkt_len;
+			goto done;
+		}
+#endif
+		skb = ether_rx_build_skb(pdata, chan, page, pkt_offset,
+					 pkt_len, rx_pkt_cx->pkt_len);
 		if (unlikely(!skb)) {
 			pdata->ndev->stats.rx_dropped++;
 			dev_err(pdata->dev,
 				"%s(): Error in allocating the skb\n",
 			        __func__);
-			page_pool_recycle_direct(pdata->page_pool[chan], page);
 			return;
 		}
-
-		dma_sync_single_for_cpu(pdata->dev, dma_addr,
-					rx_pkt_cx->pkt_len, DMA_FROM_DEVICE);
-		skb_copy_to_linear_data(skb, page_address(page),
-					rx_pkt_cx->pkt_len);
-		skb_put(skb, rx_pkt_cx->pkt_len);
-		page_pool_recycle_direct(pdata->page_pool[chan], page);
 #else
 		skb_put(skb, rx_pkt_cx->pkt_len);
 #endif
@@ -693,12 +915,14 @@ static void osd_receive_packet(void *priv, struct osi_rx_ring *rx_ring,
 		}
 
 		skb_record_rx_queue(skb, chan);
+		/* lets the socket busy poll this channel */
+		skb_mark_napi_id(skb, &rx_napi->napi);
 		skb->dev = ndev;
 		skb->protocol = eth_type_trans(skb, ndev);
 		ndev->stats.rx_bytes += skb->len;
 #ifdef ETHER_NVGRO
 		if ((ndev->features & NETIF_F_GRO) &&
-		    ether_do_nvgro(pdata, &rx_napi->napi, skb))
+		    ether_do_nvgro(pdata, rx_napi, skb))
 			goto done;
 #endif
 		if (likely(ndev->features & NETIF_F_GRO)) {
@@ -713,14 +937,19 @@ static void osd_receive_packet(void *priv, struct osi_rx_ring *rx_ring,
 		ndev->stats.rx_errors++;
 #ifdef ETHER_PAGE_POOL
 		page_pool_recycle_direct(pdata->page_pool[chan], page);
+		ETHER_CHAN_STAT_INC(pdata, chan, rx_page_recycle_n);
 #endif
 		dev_kfree_skb_any(skb);
 	}
 
-#ifdef ETHER_NVGRO
+#if defined(ETHER_NVGRO) || defined(ETHER_XDP) || defined(ETHER_RX_DMABUF)
 done:
 #endif
 	ndev->stats.rx_packets++;
+#ifdef ETHER_DIM
+	rx_napi->dim_packets++;
+	rx_napi->dim_bytes += rx_pkt_cx->pkt_len;
+#endif
 	rx_swcx->buf_virt_addr = NULL;
 	rx_swcx->buf_phy_addr = 0;
 	/* mark packet is processed */
@@ -763,6 +992,13 @@ static void osd_transmit_complete(void *priv, const struct osi_tx_swcx *swcx,
 
 	ndev->stats.tx_bytes += len;
 
+#ifdef ETHER_XDP
+	if (((unsigned long)swcx->buf_virt_addr & ETHER_XDP_TX_FRAME) != 0UL) {
+		ether_xdp_tx_complete(pdata, swcx);
+		return;
+	}
+#endif
+
 	if ((txdone_pkt_cx->flags & OSI_TXDONE_CX_TS) == OSI_TXDONE_CX_TS) {
 		memset(&shhwtstamp, 0, sizeof(struct skb_shared_hwtstamps));
 		shhwtstamp.hwtstamp = ns_to_ktime(txdone_pkt_cx->ns);
@@ -798,11 +1034,23 @@ static void osd_transmit_complete(void *priv, const struct osi_tx_swcx *swcx,
 		}
 
 		ndev->stats.tx_packets++;
+		pdata->tx_napi[chan]->bql_pkts++;
+		pdata->tx_napi[chan]->bql_bytes += skb->len;
+#ifdef ETHER_DIM
+		pdata->tx_napi[chan]->dim_packets++;
+		pdata->tx_napi[chan]->dim_bytes += skb->len;
+#endif
 		if ((txdone_pkt_cx->flags & OSI_TXDONE_CX_TS_DELAYED) ==
 		    OSI_TXDONE_CX_TS_DELAYED) {
-			add_skb_node(pdata, skb, txdone_pkt_cx->pktid);
-			/* Consume the timestamp immediately if already available */
-			if (ether_get_tx_ts(pdata) < 0)
+			unsigned int idx;
+
+			idx = ether_add_tx_ts_slot(pdata, skb,
+						   txdone_pkt_cx->pktid);
+			/* Consume the timestamp immediately if already
+			 * available, else MAC TS interrupt or work picks it.
+			 */
+			if ((idx < ETHER_MAX_PENDING_SKB_CNT) &&
+			    !ether_tx_ts_slot_done(pdata, idx))
 				schedule_delayed_work(&pdata->tx_ts_work,
 						      msecs_to_jiffies(ETHER_TS_MS_TIMER));
 
@@ -15,6 +15,7 @@
  */
 
 #include <linux/version.h>
+#include <clocksource/arm_arch_timer.h>
 #include "ether_linux.h"
 
 /**
@@ -95,6 +96,112 @@ static inline int ether_get_hw_time(struct net_device *dev,
 
 #endif
 
+/**
+ * @brief Publish PTP time tuple to shared memory
+ *
+ * Algorithm: Seqlock style update, seq is odd while the tuple is
+ * written so that readers in other cells can retry without locking.
+ *
+ * @param[in] shm: Shared memory region.
+ * @param[in] magic: ETHER_PTP_SHM_MAGIC or 0 to invalidate.
+ * @param[in] ptp_ns: MAC time in nano seconds.
+ * @param[in] cntvct: System counter captured with ptp_ns.
+ * @param[in] rate: Nano seconds per counter tick in 32.32 fixed point.
+ */
+static void ether_ptp_shm_publish(struct ether_ptp_shm *shm, u32 magic,
+				  u64 ptp_ns, u64 cntvct, u64 rate)
+{
+	u32 seq = READ_ONCE(shm->seq);
+
+	WRITE_ONCE(shm->seq, seq + 1U);
+	smp_wmb();
+	WRITE_ONCE(shm->ptp_ns, ptp_ns);
+	WRITE_ONCE(shm->cntvct, cntvct);
+	WRITE_ONCE(shm->rate, rate);
+	WRITE_ONCE(shm->magic, magic);
+	smp_wmb();
+	WRITE_ONCE(shm->seq, seq + 2U);
+}
+
+/**
+ * @brief Work to publish PTP time to other cells
+ *
+ * Algorithm:
+ * - Capture MAC time and TSC atomically in HW (OSI_CMD_CAP_TSC_PTP).
+ * - Derive the rate from the previous capture, unless MAC time got
+ *   stepped in between, in which case the previous rate is kept.
+ * - Publish the tuple and rearm the work.
+ *
+ * @param[in] work: Work structure.
+ */
+static void ether_ptp_shm_work(struct work_struct *work)
+{
+	struct delayed_work *dwork = to_delayed_work(work);
+	struct ether_priv_data *pdata = container_of(dwork,
+					struct ether_priv_data, ptp_shm_work);
+	struct ether_ptp_shm *shm = pdata->ptp_shm;
+	struct osi_ioctl ioctl_data = {};
+	u64 ptp_ns, cntvct, rate, dptp, dcnt;
+	unsigned long flags;
+	bool resync;
+	int ret;
+
+	raw_spin_lock_irqsave(&pdata->ptp_lock, flags);
+	ioctl_data.cmd = OSI_CMD_CAP_TSC_PTP;
+	ret = osi_handle_ioctl(pdata->osi_core, &ioctl_data);
+	resync = pdata->ptp_shm_resync;
+	pdata->ptp_shm_resync = false;
+	raw_spin_unlock_irqrestore(&pdata->ptp_lock, flags);
+	if (ret != 0) {
+		dev_dbg(pdata->dev, "%s: Failed to capture TSC and PTP %d\n",
+			__func__, ret);
+		goto reschedule;
+	}
+
+	ptp_ns = ioctl_data.ptp_tsc.ptp_low_bits +
+		 ((u64)ioctl_data.ptp_tsc.ptp_high_bits * OSI_NSEC_PER_SEC);
+	cntvct = ((u64)ioctl_data.ptp_tsc.tsc_high_bits << TSC_HIGH_SHIFT) |
+		 ioctl_data.ptp_tsc.tsc_low_bits;
+
+	if (READ_ONCE(shm->magic) != ETHER_PTP_SHM_MAGIC) {
+		/* nominal rate until there are two captures to compare */
+		rate = div64_u64((u64)OSI_NSEC_PER_SEC << 32,
+				 arch_timer_get_rate());
+	} else {
+		rate = READ_ONCE(shm->rate);
+		dptp = ptp_ns - READ_ONCE(shm->ptp_ns);
+		dcnt = cntvct - READ_ONCE(shm->cntvct);
+		if (!resync && (ptp_ns > READ_ONCE(shm->ptp_ns)) &&
+		    (dcnt != 0ULL) && (dptp < BIT_ULL(32)))
+			rate = div64_u64(dptp << 32, dcnt);
+	}
+
+	ether_ptp_shm_publish(shm, ETHER_PTP_SHM_MAGIC, ptp_ns, cntvct, rate);
+
+reschedule:
+	schedule_delayed_work(&pdata->ptp_shm_work,
+			      msecs_to_jiffies(ETHER_PTP_SHM_PERIOD_MS));
+}
+
+/**
+ * @brief Republish PTP time after MAC clock got adjusted
+ *
+ * @param[in] pdata: OSD private data structure.
+ * @param[in] step: MAC time got stepped.
+ *
+ * @note Called with ptp_lock held.
+ */
+static inline void ether_ptp_shm_kick(struct ether_priv_data *pdata,
+				      bool step)
+{
+	if (pdata->ptp_shm == NULL)
+		return;
+
+	if (step)
+		pdata->ptp_shm_resync = true;
+	mod_delayed_work(system_wq, &pdata->ptp_shm_work, 0);
+}
+
 /**
  * @brief Adjust MAC hardware time
  *
@@ -126,6 +233,8 @@ static int ether_adjust_time(struct ptp_clock_info *ptp, s64 nsec_delta)
 		dev_err(pdata->dev,
 			"%s:failed to adjust time with reason %d\n",
 			__func__, ret);
+	} else {
+		ether_ptp_shm_kick(pdata, true);
 	}
 
 	raw_spin_unlock_irqrestore(&pdata->ptp_lock, flags);
@@ -164,6 +273,8 @@ static int ether_adjust_freq(struct ptp_clock_info *ptp, s32 ppb)
 		dev_err(pdata->dev,
 			"%s:failed to adjust frequency with reason code %d\n",
 			__func__, ret);
+	} else {
+		ether_ptp_shm_kick(pdata, false);
 	}
 
 	raw_spin_unlock_irqrestore(&pdata->ptp_lock, flags);
@@ -243,6 +354,8 @@ static int ether_set_time(struct ptp_clock_info *ptp,
 		dev_err(pdata->dev,
 			"%s:failed to set system time with reason %d\n",
 			__func__, ret);
+	} else {
+		ether_ptp_shm_kick(pdata, true);
 	}
 
 	raw_spin_unlock_irqrestore(&pdata->ptp_lock, flags);
@@ -321,6 +434,8 @@ int ether_ptp_init(struct ether_priv_data *pdata)
 	}
 
 	raw_spin_lock_init(&pdata->ptp_lock);
+	INIT_DELAYED_WORK(&pdata->ptp_shm_work, ether_ptp_shm_work);
+	pdata->ptp_shm_resync = false;
 
 	pdata->ptp_clock_ops = ether_ptp_clock_ops;
 	pdata->ptp_clock = ptp_clock_register(&pdata->ptp_clock_ops,
@@ -333,6 +448,9 @@ int ether_ptp_init(struct ether_priv_data *pdata)
 
 	/* By default enable nano second accuracy */
 	pdata->osi_core->ptp_config.one_nsec_accuracy = OSI_ENABLE;
+	if (pdata->ptp_shm != NULL) {
+		schedule_delayed_work(&pdata->ptp_shm_work, 0);
+	}
 	if ((pdata->osi_core->m2m_role == OSI_PTP_M2M_PRIMARY) ||
 	    (pdata->osi_core->m2m_role == OSI_PTP_M2M_SECONDARY)) {
 		return ether_early_ptp_init(pdata);
@@ -345,6 +463,12 @@ void ether_ptp_remove(struct ether_priv_data *pdata)
 {
 	if (pdata->ptp_clock) {
 		ptp_clock_unregister(pdata->ptp_clock);
+		if (pdata->ptp_shm != NULL) {
+			cancel_delayed_work_sync(&pdata->ptp_shm_work);
+			/* MAC time is not maintained anymore */
+			ether_ptp_shm_publish(pdata->ptp_shm, 0U, 0ULL, 0ULL,
+					      0ULL);
+		}
 	}
 }
 
@@ -2647,9 +2647,14 @@ static ssize_t ether_nvgro_stats_show(struct device *dev,
 {
 	struct net_device *ndev = (struct net_device *)dev_get_drvdata(dev);
 	struct ether_priv_data *pdata = netdev_priv(ndev);
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	u64 dropped = 0;
+	unsigned int i;
 
-	return scnprintf(buf, PAGE_SIZE, "dropped = %llu\n",
-			 pdata->nvgro_dropped);
+	for (i = 0; i < osi_dma->num_dma_chans; i++)
+		dropped += pdata->rx_napi[osi_dma->dma_chans[i]]->nvgro_dropped;
+
+	return scnprintf(buf, PAGE_SIZE, "dropped = %llu\n", dropped);
 }
 
 /**
@@ -2672,21 +2677,27 @@ static ssize_t ether_nvgro_dump_show(struct device *dev,
 {
 	struct net_device *ndev = (struct net_device *)dev_get_drvdata(dev);
 	struct ether_priv_data *pdata = netdev_priv(ndev);
-	struct sk_buff *p, *pp;
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	struct ether_rx_napi *rx_napi;
+	struct ether_nvgro_flow *flow;
+	unsigned int i, j;
 	char *start = buf;
 
-	buf += scnprintf(buf, PAGE_SIZE, "MQ: ");
-	skb_queue_walk_safe(&pdata->mq, p, pp) {
-		buf += scnprintf(buf, PAGE_SIZE, "skb %p TTL %d IPID %u\n",
-				 p, NAPI_GRO_CB(p)->free,
-				 NAPI_GRO_CB(p)->flush_id);
-	}
+	/* Only the queue lengths, the skbs are freed from NAPI context */
+	for (i = 0; i < osi_dma->num_dma_chans; i++) {
+		rx_napi = pdata->rx_napi[osi_dma->dma_chans[i]];
+		for (j = 0; j < NVGRO_NUM_FLOWS; j++) {
+			flow = &rx_napi->nvgro_flow[j];
+			if (skb_queue_empty(&flow->mq) &&
+			    skb_queue_empty(&flow->fq))
+				continue;
 
-	buf += scnprintf(buf, PAGE_SIZE, "FQ: ");
-	skb_queue_walk_safe(&pdata->fq, p, pp) {
-		buf += scnprintf(buf, PAGE_SIZE, "skb %p TTL %d IPID %u\n",
-				 p, NAPI_GRO_CB(p)->free,
-				 NAPI_GRO_CB(p)->flush_id);
+			buf += scnprintf(buf, PAGE_SIZE - (buf - start),
+					 "chan %u flow %u: MQ %u FQ %u\n",
+					 osi_dma->dma_chans[i], j,
+					 skb_queue_len(&flow->mq),
+					 skb_queue_len(&flow->fq));
+		}
 	}
 
 	return (buf - start);
@@ -2700,6 +2711,89 @@ static DEVICE_ATTR(nvgro_dump, 0644,
 		   ether_nvgro_dump_show, NULL);
 #endif
 
+/**
+ * @brief Shows the CPUs of the NAPIs of the DMA channels.
+ *
+ * @param[in] dev: Device data.
+ * @param[in] attr: Device attribute
+ * @param[in] buf: Buffer to store the channel CPUs, -1 if not bound
+ */
+static ssize_t ether_napi_cpus_show(struct device *dev,
+				    struct device_attribute *attr,
+				    char *buf)
+{
+	struct net_device *ndev = (struct net_device *)dev_get_drvdata(dev);
+	struct ether_priv_data *pdata = netdev_priv(ndev);
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	unsigned int i, chan;
+	char *start = buf;
+
+	for (i = 0; i < osi_dma->num_dma_chans; i++) {
+		chan = osi_dma->dma_chans[i];
+		buf += scnprintf(buf, PAGE_SIZE - (buf - start),
+				 "chan %u: %d\n", chan, pdata->napi_cpu[chan]);
+	}
+
+	return (buf - start);
+}
+
+/**
+ * @brief Binds the NAPIs of a DMA channel to a CPU.
+ *
+ * Algorithm: Input is "<chan> <cpu>", cpu -1 unbinds the channel. Moves
+ * the NAPI kthreads, see /sys/class/net/<iface>/threaded, or otherwise
+ * the NAPI softirq scheduled by the VM IRQ. The affinity hints of the VM
+ * IRQs are updated on the next open.
+ *
+ * @param[in] dev: Device data.
+ * @param[in] attr: Device attribute
+ * @param[in] buf: Buffer which contains the channel and CPU
+ * @param[in] size: size of buffer
+ *
+ * @return size of buffer.
+ */
+static ssize_t ether_napi_cpus_store(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t size)
+{
+	struct net_device *ndev = (struct net_device *)dev_get_drvdata(dev);
+	struct ether_priv_data *pdata = netdev_priv(ndev);
+	struct osi_dma_priv_data *osi_dma = pdata->osi_dma;
+	unsigned int i, chan;
+	int cpu;
+
+	if (sscanf(buf, "%u %d", &chan, &cpu) != 2 || cpu < -1 ||
+	    (cpu >= 0 && (cpu >= nr_cpu_ids || !cpu_possible(cpu)))) {
+		dev_err(pdata->dev, "Invalid napi cpus input\n");
+		return -EINVAL;
+	}
+
+	for (i = 0; i < osi_dma->num_dma_chans; i++) {
+		if (osi_dma->dma_chans[i] == chan)
+			break;
+	}
+	if (i == osi_dma->num_dma_chans) {
+		dev_err(pdata->dev, "Invalid DMA channel %u\n", chan);
+		return -EINVAL;
+	}
+
+	rtnl_lock();
+	WRITE_ONCE(pdata->napi_cpu[chan], cpu);
+#ifdef ETHER_NAPI_THREADED
+	ether_napi_set_affinity(pdata, chan);
+#endif
+	rtnl_unlock();
+
+	return size;
+}
+
+/**
+ * @brief Sysfs attribute for the CPUs of the NAPIs
+ *
+ */
+static DEVICE_ATTR(napi_cpus, 0644,
+		   ether_napi_cpus_show, ether_napi_cpus_store);
+
 /**
  * @brief Attributes for nvethernet sysfs
  */
@@ -2744,6 +2838,7 @@ static struct attribute *ether_sysfs_attrs[] = {
 #ifdef HSI_SUPPORT
 	&dev_attr_hsi_enable.attr,
 #endif
+	&dev_attr_napi_cpus.attr,
 	NULL
 };
 
@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2022, NVIDIA Corporation.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Registration cache for nvidia_p2p_get_pages().
+ *
+ * Pinning the same GPU buffer for every third-party DMA costs a pin and a
+ * page walk each time. Entries here keep the page table (and the DMA
+ * mappings made through the cache) of a (process, vaddr, size) range alive
+ * after the last user is done, so that the next get of the same range is a
+ * lookup. An entry goes away when:
+ *  - the cache is over max_entries and the entry is the least recently
+ *    used of the unreferenced ones, or
+ *  - nvidia-p2p calls the free_callback because the pages are being freed
+ *    (munmap, process exit). The users still holding the entry are then
+ *    told through their invalidate callback, and must stop DMA to it.
+ *
+ * nvidia_p2p_get_pages()/nvidia_p2p_put_pages() take the mmap lock, which
+ * the free_callback may run under, so they are never called with
+ * cache_lock held.
+ */
+
+#define pr_fmt(fmt) "nvidia-p2p-cache: " fmt
+
+#include <linux/debugfs.h>
+#include <linux/hashtable.h>
+#include <linux/kref.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/nv-p2p.h>
+
+#define NVIDIA_P2P_CACHE_HASH_BITS	6
+
+static unsigned int max_entries = 64;
+module_param(max_entries, uint, 0644);
+MODULE_PARM_DESC(max_entries,
+	"Number of registrations kept cached once unreferenced (0 disables)");
+
+/* a cached DMA mapping of an entry, one per (device, direction).*/
+struct nvidia_p2p_cache_map {
+	struct list_head node;
+	struct nvidia_p2p_dma_mapping *map;
+};
+
+/* one cached registration.*/
+struct nvidia_p2p_cache_entry {
+	struct hlist_node hnode;
+	/* on lru_list while not referenced, valid and cached.*/
+	struct list_head lru;
+
+	struct mm_struct *mm;
+	u64 vaddr;
+	u64 size;
+	struct nvidia_p2p_page_table *page_table;
+	struct list_head maps;
+	struct list_head refs;
+
+	/* one for the cache while hashed, one per nvidia_p2p_cache_ref.*/
+	struct kref kref;
+	/* in cache_hash, holding the cache's reference.*/
+	bool hashed;
+	/* pages freed through free_callback.*/
+	bool invalid;
+};
+
+struct nvidia_p2p_cache_ref {
+	struct list_head node;
+	struct nvidia_p2p_cache_entry *entry;
+	void (*invalidate_cb)(void *data);
+	void *data;
+};
+
+static DEFINE_HASHTABLE(cache_hash, NVIDIA_P2P_CACHE_HASH_BITS);
+static LIST_HEAD(lru_list);
+static unsigned int nr_cached;
+static DEFINE_MUTEX(cache_lock);
+
+static u64 stat_hits;
+static u64 stat_misses;
+static u64 stat_evictions;
+static u64 stat_invalidations;
+static struct dentry *debugfs_dir;
+
+static u64 cache_key(struct mm_struct *mm, u64 vaddr)
+{
+	return (u64)(uintptr_t)mm ^ vaddr;
+}
+
+/* must be called with cache_lock held.*/
+static struct nvidia_p2p_cache_entry *cache_lookup(struct mm_struct *mm,
+		u64 vaddr, u64 size)
+{
+	struct nvidia_p2p_cache_entry *entry;
+
+	hash_for_each_possible(cache_hash, entry, hnode, cache_key(mm, vaddr)) {
+		if (entry->mm == mm && entry->vaddr == vaddr &&
+				entry->size >= size)
+			return entry;
+	}
+
+	return NULL;
+}
+
+/*
+ * Last reference gone. Invalidated entries had their pages and mappings
+ * freed from the free_callback, the others are released here.
+ */
+static void cache_entry_release(struct kref *kref)
+{
+	struct nvidia_p2p_cache_entry *entry =
+		container_of(kref, struct nvidia_p2p_cache_entry, kref);
+	struct nvidia_p2p_cache_map *cmap, *tmp;
+
+	list_for_each_entry_safe(cmap, tmp, &entry->maps, node) {
+		if (!entry->invalid)
+			nvidia_p2p_dma_unmap_pages(cmap->map);
+		list_del(&cmap->node);
+		kfree(cmap);
+	}
+
+	if (!entry->invalid)
+		nvidia_p2p_put_pages(entry->page_table);
+
+	kfree(entry);
+}
+
+/*
+ * Drop unreferenced entries until the cache fits in max_entries.
+ * Returns the entries removed on the caller's list, to be released
+ * without cache_lock.
+ */
+static void cache_trim(struct list_head *victims)
+{
+	struct nvidia_p2p_cache_entry *entry;
+
+	while (nr_cached > READ_ONCE(max_entries) && !list_empty(&lru_list)) {
+		entry = list_first_entry(&lru_list,
+				struct nvidia_p2p_cache_entry, lru);
+		list_move_tail(&entry->lru, victims);
+		hash_del(&entry->hnode);
+		entry->hashed = false;
+		nr_cached--;
+		stat_evictions++;
+	}
+}
+
+static void cache_release_victims(struct list_head *victims)
+{
+	struct nvidia_p2p_cache_entry *entry, *tmp;
+
+	list_for_each_entry_safe(entry, tmp, victims, lru) {
+		list_del_init(&entry->lru);
+		kref_put(&entry->kref, cache_entry_release);
+	}
+}
+
+/* nvidia-p2p free_callback: the pages are going away underneath.*/
+static void cache_free_callback(void *data)
+{
+	struct nvidia_p2p_cache_entry *entry = data;
+	struct nvidia_p2p_cache_map *cmap;
+	struct nvidia_p2p_cache_ref *ref;
+	bool hashed;
+
+	mutex_lock(&cache_lock);
+	entry->invalid = true;
+	stat_invalidations++;
+	hashed = entry->hashed;
+	if (hashed) {
+		hash_del(&entry->hnode);
+		entry->hashed = false;
+		list_del_init(&entry->lru);
+		nr_cached--;
+	}
+
+	list_for_each_entry(ref, &entry->refs, node) {
+		if (ref->invalidate_cb)
+			ref->invalidate_cb(ref->data);
+	}
+
+	list_for_each_entry(cmap, &entry->maps, node)
+		nvidia_p2p_free_dma_mapping(cmap->map);
+	nvidia_p2p_free_page_table(entry->page_table);
+	mutex_unlock(&cache_lock);
+
+	/* the cache's own reference; users drop theirs in cache_put.*/
+	if (hashed)
+		kref_put(&entry->kref, cache_entry_release);
+}
+
+/*
+ * Get the pages of [vaddr, vaddr + size) of the current process, from the
+ * cache or through nvidia_p2p_get_pages(). invalidate_cb(data) is called
+ * if the pages are freed while the reference is held; the caller must then
+ * stop DMA to them and drop the reference. The returned page table may
+ * cover more than size bytes, starting at vaddr.
+ */
+int nvidia_p2p_cache_get(u64 vaddr, u64 size,
+		void (*invalidate_cb)(void *data), void *data,
+		struct nvidia_p2p_cache_ref **ref_out,
+		struct nvidia_p2p_page_table **page_table)
+{
+	struct nvidia_p2p_cache_entry *entry, *dup = NULL;
+	struct nvidia_p2p_cache_ref *ref;
+	struct mm_struct *mm = current->mm;
+	LIST_HEAD(victims);
+	int ret;
+
+	if (!ref_out || !page_table || !size || !mm)
+		return -EINVAL;
+
+	ref = kzalloc(sizeof(*ref), GFP_KERNEL);
+	if (!ref)
+		return -ENOMEM;
+	ref->invalidate_cb = invalidate_cb;
+	ref->data = data;
+
+	mutex_lock(&cache_lock);
+	entry = cache_lookup(mm, vaddr, size);
+	if (entry) {
+		stat_hits++;
+		goto take_ref;
+	}
+	stat_misses++;
+	mutex_unlock(&cache_lock);
+
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry) {
+		kfree(ref);
+		return -ENOMEM;
+	}
+	entry->mm = mm;
+	entry->vaddr = vaddr;
+	entry->size = size;
+	INIT_LIST_HEAD(&entry->lru);
+	INIT_LIST_HEAD(&entry->maps);
+	INIT_LIST_HEAD(&entry->refs);
+	kref_init(&entry->kref);
+
+	ret = nvidia_p2p_get_pages(vaddr, size, &entry->page_table,
+			cache_free_callback, entry);
+	if (ret) {
+		kfree(entry);
+		kfree(ref);
+		return ret;
+	}
+
+	mutex_lock(&cache_lock);
+	/* someone else registered the same range meanwhile: use theirs.*/
+	dup = cache_lookup(mm, vaddr, size);
+	if (dup) {
+		swap(entry, dup);
+		goto take_ref;
+	}
+	hash_add(cache_hash, &entry->hnode, cache_key(mm, vaddr));
+	entry->hashed = true;
+	nr_cached++;
+
+take_ref:
+	/* a referenced entry is not an eviction candidate.*/
+	list_del_init(&entry->lru);
+	kref_get(&entry->kref);
+	ref->entry = entry;
+	list_add_tail(&ref->node, &entry->refs);
+	*page_table = entry->page_table;
+	*ref_out = ref;
+	cache_trim(&victims);
+	mutex_unlock(&cache_lock);
+
+	cache_release_victims(&victims);
+	if (dup) {
+		nvidia_p2p_put_pages(dup->page_table);
+		kfree(dup);
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(nvidia_p2p_cache_get);
+
+/*
+ * Drop a reference taken by nvidia_p2p_cache_get(). The registration stays
+ * cached unless it was invalidated or the cache is full.
+ */
+int nvidia_p2p_cache_put(struct nvidia_p2p_cache_ref *ref)
+{
+	struct nvidia_p2p_cache_entry *entry;
+	LIST_HEAD(victims);
+
+	if (!ref)
+		return -EINVAL;
+
+	entry = ref->entry;
+
+	mutex_lock(&cache_lock);
+	list_del(&ref->node);
+	if (!entry->invalid && list_empty(&entry->refs))
+		list_add_tail(&entry->lru, &lru_list);
+	cache_trim(&victims);
+	mutex_unlock(&cache_lock);
+
+	kref_put(&entry->kref, cache_entry_release);
+	cache_release_victims(&victims);
+	kfree(ref);
+
+	return 0;
+}
+EXPORT_SYMBOL(nvidia_p2p_cache_put);
+
+/*
+ * DMA map the pages of a cached registration for dev. The mapping is owned
+ * by the cache and reused by later calls for the same device and direction;
+ * it stays valid while the reference is held and not invalidated.
+ */
+int nvidia_p2p_cache_dma_map_pages(struct device *dev,
+		struct nvidia_p2p_cache_ref *ref,
+		enum dma_data_direction direction,
+		struct nvidia_p2p_dma_mapping **map)
+{
+	struct nvidia_p2p_cache_entry *entry;
+	struct nvidia_p2p_cache_map *cmap;
+	int ret = 0;
+
+	if (!dev || !ref || !map)
+		return -EINVAL;
+
+	entry = ref->entry;
+
+	mutex_lock(&cache_lock);
+	if (entry->invalid) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	list_for_each_entry(cmap, &entry->maps, node) {
+		if (cmap->map->dev == dev && cmap->map->direction == direction) {
+			*map = cmap->map;
+			goto out;
+		}
+	}
+
+	cmap = kzalloc(sizeof(*cmap), GFP_KERNEL);
+	if (!cmap) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = nvidia_p2p_dma_map_pages(dev, entry->page_table, &cmap->map,
+			direction);
+	if (ret) {
+		kfree(cmap);
+		goto out;
+	}
+	list_add_tail(&cmap->node, &entry->maps);
+	*map = cmap->map;
+out:
+	mutex_unlock(&cache_lock);
+	return ret;
+}
+EXPORT_SYMBOL(nvidia_p2p_cache_dma_map_pages);
+
+static int cache_stats_show(struct seq_file *s, void *unused)
+{
+	mutex_lock(&cache_lock);
+	seq_printf(s, "cached: %u\n", nr_cached);
+	seq_printf(s, "hits: %llu\n", stat_hits);
+	seq_printf(s, "misses: %llu\n", stat_misses);
+	seq_printf(s, "evictions: %llu\n", stat_evictions);
+	seq_printf(s, "invalidations: %llu\n", stat_invalidations);
+	mutex_unlock(&cache_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(cache_stats);
+
+static int __init nvidia_p2p_cache_init(void)
+{
+	debugfs_dir = debugfs_create_dir("nvidia-p2p-cache", NULL);
+	debugfs_create_file("stats", 0444, debugfs_dir, NULL,
+			&cache_stats_fops);
+
+	return 0;
+}
+module_init(nvidia_p2p_cache_init);
+
+/* users are gone (they hold a module reference), drop what is cached.*/
+static void __exit nvidia_p2p_cache_exit(void)
+{
+	LIST_HEAD(victims);
+
+	debugfs_remove_recursive(debugfs_dir);
+
+	mutex_lock(&cache_lock);
+	WRITE_ONCE(max_entries, 0);
+	cache_trim(&victims);
+	mutex_unlock(&cache_lock);
+
+	cache_release_victims(&victims);
+}
+module_exit(nvidia_p2p_cache_exit);
+
+MODULE_DESCRIPTION("Registration cache for NVIDIA Tegra P2P");
+MODULE_LICENSE("GPL v2");
@@ -14,6 +14,10 @@
 #include <linux/module.h>
 #include <linux/of_device.h>
 #include <linux/reset.h>
+#ifdef CONFIG_PERF_EVENTS
+#include <linux/hrtimer.h>
+#include <linux/perf_event.h>
+#endif
 #if IS_ENABLED(CONFIG_INTERCONNECT)
 #include <linux/interconnect.h>
 #include <dt-bindings/interconnect/tegra_icc_id.h>
@@ -218,6 +222,11 @@ static u32 get_raw_cnt(void __iomem *base)
 	return __raw_readl(base + ACTMON_DEV_COUNT);
 }
 
+static u32 get_cum_cnt(void __iomem *base)
+{
+	return __raw_readl(base + ACTMON_DEV_CUMULATIVE_COUNT);
+}
+
 static void enb_dev_wm(u32 *val)
 {
 	*val |= (ACTMON_DEV_INTR_UP_WMARK_ENB |
@@ -653,6 +662,289 @@ static int tegra_actmon_suspend(struct platform_device *pdev, struct pm_message
 	return ret;
 }
 
+#ifdef CONFIG_PERF_EVENTS
+/*
+ * Uncore PMU on top of the cumulative activity counters: each actmon device
+ * (mc_all, mc_cpu, ... as described in DT) is the client filter of the
+ * hardware, and one perf event counts the activity seen by one device,
+ *
+ *	perf stat -a -e tegra_cactmon/mc_all/ -e tegra_cactmon/device=1/
+ *
+ * The counters are free running and only 32 bit wide, they are folded into
+ * the events by a timer well before they can wrap.
+ */
+#define CACTMON_PMU_POLL_MS		500
+#define CACTMON_PMU_CONFIG_DEV(c)	((c) & 0xff)
+
+struct cactmon_pmu {
+	struct pmu pmu;
+	struct actmon_drv_data *actmon;
+	struct list_head active;
+	struct hrtimer timer;
+	unsigned int cpu;
+	struct attribute_group events_group;
+};
+
+static struct cactmon_pmu *cactmon_pmu;
+
+#define to_cactmon_pmu(p)	container_of(p, struct cactmon_pmu, pmu)
+
+static u32 cactmon_pmu_read_counter(struct cactmon_pmu *cpmu,
+				    struct perf_event *event)
+{
+	struct actmon_dev *adev = &cpmu->actmon->devices[event->hw.idx];
+
+	return get_cum_cnt(offs(adev->reg_offs));
+}
+
+static void cactmon_pmu_event_update(struct perf_event *event)
+{
+	struct cactmon_pmu *cpmu = to_cactmon_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	u64 prev, now;
+
+	do {
+		prev = local64_read(&hwc->prev_count);
+		now = cactmon_pmu_read_counter(cpmu, event);
+	} while (local64_cmpxchg(&hwc->prev_count, prev, now) != prev);
+
+	local64_add((now - prev) & U32_MAX, &event->count);
+}
+
+static enum hrtimer_restart cactmon_pmu_poll(struct hrtimer *timer)
+{
+	struct cactmon_pmu *cpmu = container_of(timer, struct cactmon_pmu,
+						timer);
+	struct perf_event *event;
+
+	list_for_each_entry(event, &cpmu->active, active_entry)
+		cactmon_pmu_event_update(event);
+
+	hrtimer_forward_now(timer, ms_to_ktime(CACTMON_PMU_POLL_MS));
+	return HRTIMER_RESTART;
+}
+
+static int cactmon_pmu_event_init(struct perf_event *event)
+{
+	struct cactmon_pmu *cpmu = to_cactmon_pmu(event->pmu);
+	u64 dev = CACTMON_PMU_CONFIG_DEV(event->attr.config);
+
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	/* counting only, system wide */
+	if (is_sampling_event(event) || event->attach_state & PERF_ATTACH_TASK)
+		return -EOPNOTSUPP;
+	if (event->cpu < 0)
+		return -EINVAL;
+
+	if (event->attr.config & ~0xffULL || dev >= MAX_DEVICES ||
+	    cpmu->actmon->devices[dev].state != ACTMON_ON)
+		return -EINVAL;
+
+	event->cpu = cpmu->cpu;
+	event->hw.idx = dev;
+
+	return 0;
+}
+
+static void cactmon_pmu_event_start(struct perf_event *event, int flags)
+{
+	struct cactmon_pmu *cpmu = to_cactmon_pmu(event->pmu);
+
+	local64_set(&event->hw.prev_count,
+		    cactmon_pmu_read_counter(cpmu, event));
+	event->hw.state = 0;
+}
+
+static void cactmon_pmu_event_stop(struct perf_event *event, int flags)
+{
+	if (event->hw.state & PERF_HES_STOPPED)
+		return;
+
+	cactmon_pmu_event_update(event);
+	event->hw.state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+}
+
+static int cactmon_pmu_event_add(struct perf_event *event, int flags)
+{
+	struct cactmon_pmu *cpmu = to_cactmon_pmu(event->pmu);
+
+	/* any number of events can share a free running counter */
+	event->hw.state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+	if (list_empty(&cpmu->active))
+		hrtimer_start(&cpmu->timer, ms_to_ktime(CACTMON_PMU_POLL_MS),
+			      HRTIMER_MODE_REL_PINNED);
+	list_add_tail(&event->active_entry, &cpmu->active);
+
+	if (flags & PERF_EF_START)
+		cactmon_pmu_event_start(event, flags);
+
+	return 0;
+}
+
+static void cactmon_pmu_event_del(struct perf_event *event, int flags)
+{
+	struct cactmon_pmu *cpmu = to_cactmon_pmu(event->pmu);
+
+	cactmon_pmu_event_stop(event, PERF_EF_UPDATE);
+	list_del(&event->active_entry);
+	if (list_empty(&cpmu->active))
+		hrtimer_cancel(&cpmu->timer);
+}
+
+static void cactmon_pmu_event_read(struct perf_event *event)
+{
+	cactmon_pmu_event_update(event);
+}
+
+static ssize_t cactmon_pmu_event_show(struct device *dev,
+		struct device_attribute *attr, char *page)
+{
+	struct perf_pmu_events_attr *pmu_attr;
+
+	pmu_attr = container_of(attr, struct perf_pmu_events_attr, attr);
+	return sprintf(page, "device=%llu\n", pmu_attr->id);
+}
+
+static ssize_t cactmon_pmu_cpumask_show(struct device *dev,
+		struct device_attribute *attr, char *page)
+{
+	return cpumap_print_to_pagebuf(true, page,
+				       cpumask_of(cactmon_pmu->cpu));
+}
+
+static DEVICE_ATTR(cpumask, 0444, cactmon_pmu_cpumask_show, NULL);
+
+static struct attribute *cactmon_pmu_cpumask_attrs[] = {
+	&dev_attr_cpumask.attr,
+	NULL,
+};
+
+static struct attribute_group cactmon_pmu_cpumask_group = {
+	.attrs = cactmon_pmu_cpumask_attrs,
+};
+
+PMU_FORMAT_ATTR(device, "config:0-7");
+
+static struct attribute *cactmon_pmu_formats[] = {
+	&format_attr_device.attr,
+	NULL,
+};
+
+static struct attribute_group cactmon_pmu_format_group = {
+	.name = "format",
+	.attrs = cactmon_pmu_formats,
+};
+
+static const struct attribute_group *cactmon_pmu_attr_grps[] = {
+	&cactmon_pmu_format_group,
+	&cactmon_pmu_cpumask_group,
+	NULL,	/* events */
+	NULL,
+};
+
+/* One named event per actmon device that is on */
+static int cactmon_pmu_init_events(struct cactmon_pmu *cpmu,
+				   struct device *mon_dev)
+{
+	struct perf_pmu_events_attr *ev;
+	struct attribute **attrs;
+	int i, n = 0;
+
+	attrs = devm_kcalloc(mon_dev, MAX_DEVICES + 1, sizeof(*attrs),
+			     GFP_KERNEL);
+	ev = devm_kcalloc(mon_dev, MAX_DEVICES, sizeof(*ev), GFP_KERNEL);
+	if (!attrs || !ev)
+		return -ENOMEM;
+
+	for (i = 0; i < MAX_DEVICES; i++) {
+		struct actmon_dev *adev = &cpmu->actmon->devices[i];
+
+		if (adev->state != ACTMON_ON || !adev->dev_name)
+			continue;
+
+		sysfs_attr_init(&ev[n].attr.attr);
+		ev[n].attr.attr.name = adev->dev_name;
+		ev[n].attr.attr.mode = 0444;
+		ev[n].attr.show = cactmon_pmu_event_show;
+		ev[n].id = i;
+		attrs[n] = &ev[n].attr.attr;
+		n++;
+	}
+
+	cpmu->events_group.name = "events";
+	cpmu->events_group.attrs = attrs;
+	cactmon_pmu_attr_grps[2] = &cpmu->events_group;
+
+	return 0;
+}
+
+static int cactmon_pmu_register(struct platform_device *pdev)
+{
+	struct actmon_drv_data *actmon = platform_get_drvdata(pdev);
+	struct device *mon_dev = &pdev->dev;
+	struct cactmon_pmu *cpmu;
+	int ret;
+
+	cpmu = devm_kzalloc(mon_dev, sizeof(*cpmu), GFP_KERNEL);
+	if (!cpmu)
+		return -ENOMEM;
+
+	cpmu->actmon = actmon;
+	/* boot CPU, which stays with Linux when cells take the others */
+	cpmu->cpu = 0;
+	INIT_LIST_HEAD(&cpmu->active);
+	hrtimer_init(&cpmu->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cpmu->timer.function = cactmon_pmu_poll;
+
+	ret = cactmon_pmu_init_events(cpmu, mon_dev);
+	if (ret)
+		return ret;
+
+	cpmu->pmu = (struct pmu) {
+		.module		= THIS_MODULE,
+		.task_ctx_nr	= perf_invalid_context,
+		.event_init	= cactmon_pmu_event_init,
+		.add		= cactmon_pmu_event_add,
+		.del		= cactmon_pmu_event_del,
+		.start		= cactmon_pmu_event_start,
+		.stop		= cactmon_pmu_event_stop,
+		.read		= cactmon_pmu_event_read,
+		.attr_groups	= cactmon_pmu_attr_grps,
+		.capabilities	= PERF_PMU_CAP_NO_EXCLUDE,
+	};
+
+	cactmon_pmu = cpmu;
+	ret = perf_pmu_register(&cpmu->pmu, "tegra_cactmon", -1);
+	if (ret) {
+		dev_err(mon_dev, "Error %d registering cactmon PMU\n", ret);
+		cactmon_pmu = NULL;
+		return ret;
+	}
+
+	return 0;
+}
+
+static void cactmon_pmu_unregister(void)
+{
+	if (!cactmon_pmu)
+		return;
+
+	perf_pmu_unregister(&cactmon_pmu->pmu);
+	cactmon_pmu = NULL;
+}
+#else
+static inline int cactmon_pmu_register(struct platform_device *pdev)
+{
+	return 0;
+}
+
+static inline void cactmon_pmu_unregister(void)
+{
+}
+#endif /* CONFIG_PERF_EVENTS */
+
 static int __init tegra_actmon_probe(struct platform_device *pdev)
 {
 	int ret = 0;
@@ -669,12 +961,25 @@ static int __init tegra_actmon_probe(struct platform_device *pdev)
 	platform_set_drvdata(pdev, actmon);
 	actmon->pdev = pdev;
 	ret = tegra_actmon_register(actmon);
-	return ret;
+	if (ret)
+		return ret;
+
+	/* DVFS works without the telemetry */
+	if (cactmon_pmu_register(pdev))
+		dev_warn(&pdev->dev, "cactmon PMU not available\n");
+
+	return 0;
+}
+
+static int tegra_cactmon_remove(struct platform_device *pdev)
+{
+	cactmon_pmu_unregister();
+	return tegra_actmon_remove(pdev);
 }
 
 static struct platform_driver tegra19x_actmon_driver __refdata = {
 	.probe		= tegra_actmon_probe,
-	.remove		= tegra_actmon_remove,
+	.remove		= tegra_cactmon_remove,
 	.resume		= tegra_actmon_resume,
 	.suspend	= tegra_actmon_suspend,
 	.driver	= {
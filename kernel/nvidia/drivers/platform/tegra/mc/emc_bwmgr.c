@@ -23,6 +23,7 @@
 #include <linux/debugfs.h>
 #include <linux/thermal.h>
 #include <linux/version.h>
+#include <linux/workqueue.h>
 #if KERNEL_VERSION(4, 15, 0) > LINUX_VERSION_CODE
 #include <soc/tegra/chip-id.h>
 #include <soc/tegra/tegra_bpmp.h>
@@ -83,6 +84,20 @@ static struct {
 	bool status;
 	struct bwmgr_ops *ops;
 	bool override;
+	/* running aggregates of the client votes */
+	unsigned long bw_sum;
+	unsigned long iso_bw_nvdis_sum;
+	unsigned long iso_bw_vi_sum;
+	unsigned long iso_bw_other_sum;
+	u64 iso_client_flags;
+	unsigned long non_iso_cap;
+	unsigned long iso_cap;
+	unsigned long floor;
+	/* the client holding a cap or the floor relaxed it */
+	bool limits_dirty;
+	/* coalesced clock update of relaxing votes */
+	struct delayed_work apply_work;
+	unsigned long last_apply;
 } bwmgr;
 
 static struct dram_refresh_alrt {
@@ -92,6 +107,8 @@ static struct dram_refresh_alrt {
 } *galert_data;
 
 static bool clk_update_disabled;
+/* min time between two clock updates of relaxing votes, 0 for none */
+static u32 bwmgr_apply_delay_ms = 5;
 
 static struct {
 	unsigned long bw;
@@ -211,15 +228,121 @@ static inline bool bwmgr_unlock(void)
 	return true;
 }
 
+/* call with bwmgr lock held, iso bw sum the client adds to */
+static unsigned long *bwmgr_iso_bw_sum(struct tegra_bwmgr_client *handle)
+{
+	int i = handle - bwmgr.bwmgr_client;
+
+	if ((i == TEGRA_BWMGR_CLIENT_DISP0) ||
+			(i == TEGRA_BWMGR_CLIENT_DISP1) ||
+			(i == TEGRA_BWMGR_CLIENT_DISP2))
+		return &bwmgr.iso_bw_nvdis_sum;
+	else if (i == TEGRA_BWMGR_CLIENT_CAMERA)
+		return &bwmgr.iso_bw_vi_sum;
+
+	return &bwmgr.iso_bw_other_sum;
+}
+
+/* call with bwmgr lock held except during init */
+static void bwmgr_recalc_limits(void)
+{
+	int i;
+
+	bwmgr.non_iso_cap = bwmgr.emc_max_rate;
+	bwmgr.iso_cap = bwmgr.emc_max_rate;
+	bwmgr.floor = 0;
+
+	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++) {
+		bwmgr.non_iso_cap = min(bwmgr.non_iso_cap,
+					bwmgr.bwmgr_client[i].cap);
+		bwmgr.iso_cap = min(bwmgr.iso_cap,
+				    bwmgr.bwmgr_client[i].iso_cap);
+		bwmgr.floor = max(bwmgr.floor, bwmgr.bwmgr_client[i].floor);
+	}
+
+	bwmgr.limits_dirty = false;
+}
+
+/*
+ * call with bwmgr lock held except during init
+ * Updates a vote of the client and the aggregates by the delta. A cap or
+ * floor relaxed by the client holding it only marks the limits dirty,
+ * they are recomputed with the next clock update.
+ * Returns true if the vote tightens the EMC constraints: more ISO bw,
+ * a higher floor or a lower cap.
+ */
+static bool bwmgr_set_vote(struct tegra_bwmgr_client *handle,
+		unsigned long val, enum tegra_bwmgr_request_type req)
+{
+	int i = handle - bwmgr.bwmgr_client;
+	unsigned long *iso_sum;
+	bool tighten = false;
+
+	switch (req) {
+	case TEGRA_BWMGR_SET_EMC_FLOOR:
+		if (val > bwmgr.floor) {
+			bwmgr.floor = val;
+			tighten = true;
+		} else if (handle->floor == bwmgr.floor) {
+			bwmgr.limits_dirty = true;
+		}
+		handle->floor = val;
+		break;
+
+	case TEGRA_BWMGR_SET_EMC_CAP:
+		if (val < bwmgr.non_iso_cap) {
+			bwmgr.non_iso_cap = val;
+			tighten = true;
+		} else if (handle->cap == bwmgr.non_iso_cap) {
+			bwmgr.limits_dirty = true;
+		}
+		handle->cap = val;
+		break;
+
+	case TEGRA_BWMGR_SET_EMC_ISO_CAP:
+		if (val < bwmgr.iso_cap) {
+			bwmgr.iso_cap = val;
+			tighten = true;
+		} else if (handle->iso_cap == bwmgr.iso_cap) {
+			bwmgr.limits_dirty = true;
+		}
+		handle->iso_cap = val;
+		break;
+
+	case TEGRA_BWMGR_SET_EMC_SHARED_BW:
+		bwmgr.bw_sum = bwmgr.bw_sum - handle->bw + val;
+		handle->bw = val;
+		break;
+
+	case TEGRA_BWMGR_SET_EMC_SHARED_BW_ISO:
+		iso_sum = bwmgr_iso_bw_sum(handle);
+		*iso_sum = *iso_sum - handle->iso_bw + val;
+		tighten = val > handle->iso_bw;
+		handle->iso_bw = val;
+
+		if (val > 0)
+			bwmgr.iso_client_flags |= BIT_ULL(i);
+		else
+			bwmgr.iso_client_flags &= ~BIT_ULL(i);
+		break;
+
+	default:
+		break;
+	}
+
+	return tighten;
+}
+
 /* call with bwmgr lock held except during init*/
 static void purge_client(struct tegra_bwmgr_client *handle)
 {
-	handle->bw = 0;
-	handle->iso_bw = 0;
+	bwmgr_set_vote(handle, 0, TEGRA_BWMGR_SET_EMC_SHARED_BW);
+	bwmgr_set_vote(handle, 0, TEGRA_BWMGR_SET_EMC_SHARED_BW_ISO);
 	handle->cap = bwmgr.emc_max_rate;
 	handle->iso_cap = bwmgr.emc_max_rate;
 	handle->floor = 0;
 	handle->refcount = 0;
+	bwmgr.limits_dirty = true;
 }
 
 static unsigned long tegra_bwmgr_apply_efficiency(
@@ -236,18 +359,17 @@ static unsigned long tegra_bwmgr_apply_efficiency(
 /* call with bwmgr lock held */
 static int bwmgr_update_clk(void)
 {
-	int i;
-	unsigned long bw = 0;
-	unsigned long iso_bw = 0; // iso_bw_guarantee
-	unsigned long iso_bw_nvdis = 0; //DISP0 + DISP1 + DISP2
-	unsigned long iso_bw_vi = 0; //CAMERA
-	unsigned long iso_bw_other_clients = 0; //Other ISO clients
-	unsigned long non_iso_cap = bwmgr.emc_max_rate;
-	unsigned long iso_cap = bwmgr.emc_max_rate;
+	unsigned long bw;
+	unsigned long iso_bw; // iso_bw_guarantee
+	unsigned long iso_bw_nvdis; //DISP0 + DISP1 + DISP2
+	unsigned long iso_bw_vi; //CAMERA
+	unsigned long iso_bw_other_clients; //Other ISO clients
+	unsigned long non_iso_cap;
+	unsigned long iso_cap;
 	unsigned long clk_cap = bwmgr.emc_max_rate;
-	unsigned long floor = 0;
+	unsigned long floor;
 	unsigned long iso_bw_min;
-	u64 iso_client_flags = 0;
+	u64 iso_client_flags;
 	int ret = 0;
 
 	/* sizeof(iso_client_flags) */
@@ -261,38 +383,21 @@ static int bwmgr_update_clk(void)
 	if (bwmgr.override)
 		return 0;
 
-	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++) {
-		bw += bwmgr.bwmgr_client[i].bw;
-		bw = min(bw, bwmgr.emc_max_rate);
-
-		if (bwmgr.bwmgr_client[i].iso_bw > 0) {
-			iso_client_flags |= BIT(i);
-
-			if ((i == TEGRA_BWMGR_CLIENT_DISP0) ||
-					(i == TEGRA_BWMGR_CLIENT_DISP1) ||
-					(i == TEGRA_BWMGR_CLIENT_DISP2)) {
-				iso_bw_nvdis += bwmgr.bwmgr_client[i].iso_bw;
-				iso_bw_nvdis = min(iso_bw_nvdis,
-							bwmgr.emc_max_rate);
-			} else if (i == TEGRA_BWMGR_CLIENT_CAMERA) {
-				iso_bw_vi += bwmgr.bwmgr_client[i].iso_bw;
-				iso_bw_vi = min(iso_bw_vi, bwmgr.emc_max_rate);
-			} else {
-				iso_bw_other_clients +=
-						bwmgr.bwmgr_client[i].iso_bw;
-				iso_bw_other_clients = min(iso_bw_other_clients,
-							bwmgr.emc_max_rate);
-			}
-
-			iso_bw = iso_bw_nvdis + iso_bw_vi +
-						iso_bw_other_clients;
-			iso_bw = min(iso_bw, bwmgr.emc_max_rate);
-		}
+	bwmgr.last_apply = jiffies;
 
-		non_iso_cap = min(non_iso_cap, bwmgr.bwmgr_client[i].cap);
-		iso_cap = min(iso_cap, bwmgr.bwmgr_client[i].iso_cap);
-		floor = max(floor, bwmgr.bwmgr_client[i].floor);
-	}
+	if (bwmgr.limits_dirty)
+		bwmgr_recalc_limits();
+
+	bw = min(bwmgr.bw_sum, bwmgr.emc_max_rate);
+	iso_bw_nvdis = min(bwmgr.iso_bw_nvdis_sum, bwmgr.emc_max_rate);
+	iso_bw_vi = min(bwmgr.iso_bw_vi_sum, bwmgr.emc_max_rate);
+	iso_bw_other_clients = min(bwmgr.iso_bw_other_sum, bwmgr.emc_max_rate);
+	iso_bw = min(iso_bw_nvdis + iso_bw_vi + iso_bw_other_clients,
+		     bwmgr.emc_max_rate);
+	iso_client_flags = bwmgr.iso_client_flags;
+	non_iso_cap = bwmgr.non_iso_cap;
+	iso_cap = bwmgr.iso_cap;
+	floor = bwmgr.floor;
 
 	ret = clk_set_max_rate(bwmgr.emc_clk, ULONG_MAX);
 	if (ret) {
@@ -336,6 +441,33 @@ static int bwmgr_update_clk(void)
 	return ret;
 }
 
+static void bwmgr_apply_work(struct work_struct *work)
+{
+	if (!bwmgr_lock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return;
+	}
+
+	if (!clk_update_disabled)
+		bwmgr_update_clk();
+
+	bwmgr_unlock();
+}
+
+/*
+ * call with bwmgr lock held
+ * Coalesces the clock updates of a burst of relaxing votes, at most one
+ * per bwmgr_apply_delay_ms.
+ */
+static void bwmgr_schedule_update(void)
+{
+	unsigned long next = bwmgr.last_apply +
+			     msecs_to_jiffies(bwmgr_apply_delay_ms);
+
+	queue_delayed_work(system_power_efficient_wq, &bwmgr.apply_work,
+			   time_after(next, jiffies) ? next - jiffies : 0);
+}
+
 struct tegra_bwmgr_client *tegra_bwmgr_register(
 		enum tegra_bwmgr_client_id client)
 {
@@ -466,6 +598,7 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 {
 	int ret = 0;
 	bool update_clk = false;
+	bool tighten = false;
 
 	IS_BWMGR_SUPPORTED(bwmgr_disable, -ENOTSUPP);
 
@@ -511,7 +644,7 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 	switch (req) {
 	case TEGRA_BWMGR_SET_EMC_FLOOR:
 		if (handle->floor != val) {
-			handle->floor = val;
+			tighten = bwmgr_set_vote(handle, val, req);
 			update_clk = true;
 		}
 		break;
@@ -521,7 +654,7 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 			val = bwmgr.emc_max_rate;
 
 		if (handle->cap != val) {
-			handle->cap = val;
+			tighten = bwmgr_set_vote(handle, val, req);
 			update_clk = true;
 		}
 		break;
@@ -531,21 +664,21 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 			val = bwmgr.emc_max_rate;
 
 		if (handle->iso_cap != val) {
-			handle->iso_cap = val;
+			tighten = bwmgr_set_vote(handle, val, req);
 			update_clk = true;
 		}
 		break;
 
 	case TEGRA_BWMGR_SET_EMC_SHARED_BW:
 		if (handle->bw != val) {
-			handle->bw = val;
+			bwmgr_set_vote(handle, val, req);
 			update_clk = true;
 		}
 		break;
 
 	case TEGRA_BWMGR_SET_EMC_SHARED_BW_ISO:
 		if (handle->iso_bw != val) {
-			handle->iso_bw = val;
+			tighten = bwmgr_set_vote(handle, val, req);
 			update_clk = true;
 		}
 		break;
@@ -561,8 +694,18 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 		return -EINVAL;
 	}
 
-	if (update_clk && !clk_update_disabled)
-		ret = bwmgr_update_clk();
+	/*
+	 * ISO bw, floors and caps must hold when the call returns, other
+	 * votes only need to be applied eventually.
+	 */
+	if (update_clk && !clk_update_disabled) {
+		if (tighten || !bwmgr_apply_delay_ms) {
+			cancel_delayed_work(&bwmgr.apply_work);
+			ret = bwmgr_update_clk();
+		} else {
+			bwmgr_schedule_update();
+		}
+	}
 
 	if (!bwmgr_unlock()) {
 		pr_err("bwmgr: %s failed for client %s\n",
@@ -870,6 +1013,7 @@ int __init bwmgr_init(void)
 #endif
 
 	mutex_init(&bwmgr.lock);
+	INIT_DELAYED_WORK(&bwmgr.apply_work, bwmgr_apply_work);
 
 	if (tegra_get_chip_id() == TEGRA210)
 		bwmgr.ops = bwmgr_eff_init_t21x();
@@ -965,6 +1109,7 @@ bpmp_skip:
 
 	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++)
 		purge_client(bwmgr.bwmgr_client + i);
+	bwmgr_recalc_limits();
 
 	bwmgr_debugfs_init();
 
@@ -989,6 +1134,8 @@ void __exit bwmgr_exit(void)
 	if (bwmgr_disable)
 		return;
 
+	cancel_delayed_work_sync(&bwmgr.apply_work);
+
 	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++)
 		purge_client(bwmgr.bwmgr_client + i);
 
@@ -1277,6 +1424,8 @@ static void bwmgr_debugfs_init(void)
 		debugfs_create_bool(
 			"clk_update_disabled", S_IRWXU, debugfs_dir,
 			&clk_update_disabled);
+		debugfs_create_u32("apply_delay_ms", S_IRUSR | S_IWUSR,
+			debugfs_dir, &bwmgr_apply_delay_ms);
 		debugfs_create_u64("emc_min_rate", S_IRUSR, debugfs_dir,
 			(u64 *) &bwmgr.emc_min_rate);
 		debugfs_create_u64("emc_max_rate", S_IRUSR, debugfs_dir,
@@ -31,6 +31,10 @@
 #include <linux/kref.h>
 #include <linux/sched.h>
 #include <linux/version.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
 #if KERNEL_VERSION(4, 15, 0) > LINUX_VERSION_CODE
 #include <soc/tegra/chip-id.h>
 #else
@@ -40,6 +44,7 @@
 #include <asm/current.h>
 
 #include <linux/platform/tegra/isomgr.h>
+#include <linux/platform/tegra/isomgr_group.h>
 
 #include <linux/platform/tegra/emc_bwmgr.h>
 #ifdef CONFIG_COMMON_CLK
@@ -123,6 +128,39 @@ struct isomgr isomgr = {
 	.avail_bw = CONFIG_TEGRA_ISOMGR_POOL_KB_PER_SEC,
 };
 
+/* Time spent on admission decisions, updated with isomgr lock held */
+struct isomgr_stat {
+	u64 calls;
+	u64 rejected;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+static struct {
+	struct isomgr_stat reserve;
+	struct isomgr_stat realize;
+	struct isomgr_stat group;
+} isomgr_stats;
+
+/* One request of a group, with the MC lookups done up front */
+struct isomgr_group_entry {
+	struct isomgr_client *cp;
+	u32 bw;
+	u32 lt;
+	u32 mf;
+	u32 lto;
+	/* reservation to restore if the group is not admitted */
+	u32 old_bw;
+	u32 old_lt;
+	u32 old_mf;
+	u32 old_lto;
+};
+
+struct tegra_isomgr_template {
+	unsigned int count;
+	struct isomgr_group_entry entries[];
+};
+
 /* get minimum MC frequency for client that can support this BW and LT */
 static inline u32 mc_min_freq(u32 ubw, u32 ult) /* in KB/sec and usec */
 {
@@ -178,6 +216,17 @@ static inline bool isomgr_unlock(void)
 	return true;
 }
 
+static void isomgr_stat_add(struct isomgr_stat *stat, u64 start, bool ok)
+{
+	u64 ns = ktime_get_ns() - start;
+
+	stat->calls++;
+	if (!ok)
+		stat->rejected++;
+	stat->total_ns += ns;
+	stat->max_ns = max(stat->max_ns, ns);
+}
+
 /* call with isomgr_lock held. */
 static void update_mc_clock(void)
 {
@@ -492,11 +541,61 @@ void tegra_isomgr_unregister(tegra_isomgr_handle handle)
 }
 EXPORT_SYMBOL(tegra_isomgr_unregister);
 
+/*
+ * call with isomgr lock held and a reference on the client.
+ * Reserves ubw at the looked up min freq mf and dvfs latency lto.
+ * returns lto, 0 if the reservation is not admitted.
+ */
+static u32 isomgr_admit(struct isomgr_client *cp, u32 ubw, u32 ult,
+			u32 mf, u32 lto)
+{
+	s32 bw = ubw;
+	int client = cp - &isomgr_clients[0];
+	u64 start = ktime_get_ns();
+	u32 dvfs_latency = 0;
+
+	if (unlikely(cp->realize))
+		goto out;
+
+	if (unlikely(!cp->renegotiate && bw > cp->dedi_bw))
+		goto out;
+
+	if (isomgr.ops->isomgr_plat_reserve &&
+	    !isomgr.ops->isomgr_plat_reserve(cp, bw,
+				(enum tegra_iso_client)client))
+		goto out;
+
+	cp->lti = ult;		/* remember client spec'd LT (usec) */
+	cp->lto = lto;		/* remember MC calculated LT (usec) */
+	cp->rsvd_mf = mf;	/* remember associated min freq */
+	cp->rsvd_bw = bw;
+	dvfs_latency = lto;
+out:
+	isomgr_stat_add(&isomgr_stats.reserve, start, dvfs_latency);
+	return dvfs_latency;
+}
+
+/*
+ * call with isomgr lock held and a reference on the client.
+ * The caller updates the MC clock once the reservation is realized.
+ */
+static bool isomgr_commit(struct isomgr_client *cp)
+{
+	u64 start = ktime_get_ns();
+	bool ret = true;
+
+	if (isomgr.ops->isomgr_plat_realize)
+		ret = isomgr.ops->isomgr_plat_realize(cp);
+	if (ret)
+		cp->realize = false;
+
+	isomgr_stat_add(&isomgr_stats.realize, start, ret);
+	return ret;
+}
+
 static u32 __tegra_isomgr_reserve(tegra_isomgr_handle handle,
 			 u32 ubw, u32 ult)
 {
-	s32 bw = ubw;
-	bool ret = 0;
 	u32 mf, dvfs_latency = 0;
 	struct isomgr_client *cp = (struct isomgr_client *) handle;
 	int client = cp - &isomgr_clients[0];
@@ -523,29 +622,11 @@ static u32 __tegra_isomgr_reserve(tegra_isomgr_handle handle,
 
 	trace_tegra_isomgr_reserve(handle, ubw, ult, cname[client], "enter");
 
-	if (unlikely(cp->realize))
-		goto out;
-
-	if (unlikely(!cp->renegotiate && bw > cp->dedi_bw))
-		goto out;
-
-	if (isomgr.ops->isomgr_plat_reserve) {
-		ret = isomgr.ops->isomgr_plat_reserve(cp, bw,
-				(enum tegra_iso_client)client);
-		if (!ret)
-			goto out;
-	}
-
 	/* Look up MC's min freq that could satisfy requested BW and LT */
 	mf = mc_min_freq(ubw, ult);
-	/* Look up MC's dvfs latency at min freq */
-	dvfs_latency = mc_dvfs_latency(mf);
+	/* Look up MC's dvfs latency at min freq and admit the request */
+	dvfs_latency = isomgr_admit(cp, ubw, ult, mf, mc_dvfs_latency(mf));
 
-	cp->lti = ult;		/* remember client spec'd LT (usec) */
-	cp->lto = dvfs_latency;	/* remember MC calculated LT (usec) */
-	cp->rsvd_mf = mf;	/* remember associated min freq */
-	cp->rsvd_bw = bw;
-out:
 	kref_put(&cp->kref, unregister_iso_client);
 	if (!isomgr_unlock()) {
 		pr_err("isomgr: %s failed for %s\n",
@@ -593,7 +674,6 @@ EXPORT_SYMBOL(tegra_isomgr_reserve);
 static u32 __tegra_isomgr_realize(tegra_isomgr_handle handle)
 {
 	u32 dvfs_latency = 0;
-	bool ret = 0;
 	struct isomgr_client *cp = (struct isomgr_client *) handle;
 	int client = cp - &isomgr_clients[0];
 
@@ -619,14 +699,10 @@ static u32 __tegra_isomgr_realize(tegra_isomgr_handle handle)
 
 	trace_tegra_isomgr_realize(handle, cname[client], "enter");
 
-	if (isomgr.ops->isomgr_plat_realize) {
-		ret = isomgr.ops->isomgr_plat_realize(cp);
-		if (!ret)
-			goto out;
-	}
+	if (!isomgr_commit(cp))
+		goto out;
 
 	dvfs_latency = (u32)cp->lto;
-	cp->realize = false;
 	update_mc_clock();
 
 out:
@@ -670,6 +746,240 @@ u32 tegra_isomgr_realize(tegra_isomgr_handle handle)
 }
 EXPORT_SYMBOL(tegra_isomgr_realize);
 
+/*
+ * Validate the requests of a group and do the MC lookups.
+ * No client may appear twice, so a group has at most
+ * TEGRA_ISO_CLIENT_COUNT entries.
+ */
+static int isomgr_group_prepare(struct isomgr_group_entry *entries,
+				const struct tegra_isomgr_req *reqs,
+				unsigned int count)
+{
+	bool seen[TEGRA_ISO_CLIENT_COUNT] = { false };
+	struct isomgr_client *cp;
+	unsigned int i;
+	int client;
+
+	if (unlikely(!reqs || !count || count > TEGRA_ISO_CLIENT_COUNT))
+		return -EINVAL;
+
+	for (i = 0; i < count; i++) {
+		cp = (struct isomgr_client *)reqs[i].handle;
+		client = cp - &isomgr_clients[0];
+
+		if (unlikely(IS_ERR_OR_NULL(cp) || !is_client_valid(client) ||
+			     cp->magic != ISOMGR_MAGIC)) {
+			pr_err("bad handle %p\n", reqs[i].handle);
+			return -EINVAL;
+		}
+		if (unlikely(seen[client])) {
+			pr_err("%s requested twice\n", cname[client]);
+			return -EINVAL;
+		}
+		if (unlikely(!cp->renegotiate && reqs[i].bw > cp->dedi_bw)) {
+			pr_err("%s: %uKB above dedicated bw\n",
+				cname[client], reqs[i].bw);
+			return -EINVAL;
+		}
+		seen[client] = true;
+
+		entries[i].cp = cp;
+		entries[i].bw = reqs[i].bw;
+		entries[i].lt = reqs[i].lt;
+		entries[i].mf = mc_min_freq(reqs[i].bw, reqs[i].lt);
+		entries[i].lto = mc_dvfs_latency(entries[i].mf);
+	}
+
+	return 0;
+}
+
+/*
+ * Reserve and realize the requests of a group under one lock hold, with
+ * one MC clock update. Nothing is reserved if any request is rejected.
+ */
+static int isomgr_group_apply(struct isomgr_group_entry *entries,
+			      unsigned int count)
+{
+	struct isomgr_group_entry *e;
+	bool update = false;
+	unsigned int i, refs;
+	u64 start;
+	int ret = 0;
+
+	if (!isomgr_lock()) {
+		pr_err("isomgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	start = ktime_get_ns();
+
+	for (refs = 0; refs < count; refs++) {
+		if (unlikely(!OBJ_REF_INC_NOT_ZERO(
+				&entries[refs].cp->kref.refcount))) {
+			ret = -EINVAL;
+			goto put;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		e = &entries[i];
+		e->old_bw = e->cp->rsvd_bw;
+		e->old_lt = e->cp->lti;
+		e->old_mf = e->cp->rsvd_mf;
+		e->old_lto = e->cp->lto;
+
+		if (e->cp->rsvd_bw == e->bw && e->cp->lti == e->lt)
+			continue;
+		if (!isomgr_admit(e->cp, e->bw, e->lt, e->mf, e->lto)) {
+			ret = -EBUSY;
+			break;
+		}
+	}
+
+	if (ret) {
+		while (i--) {
+			e = &entries[i];
+			e->cp->rsvd_bw = e->old_bw;
+			e->cp->lti = e->old_lt;
+			e->cp->rsvd_mf = e->old_mf;
+			e->cp->lto = e->old_lto;
+		}
+		goto put;
+	}
+
+	/* a failed realize leaves the clients before it realized */
+	for (i = 0; i < count; i++) {
+		e = &entries[i];
+		if (e->cp->rsvd_bw == e->cp->real_bw &&
+		    e->cp->rsvd_mf == e->cp->real_mf)
+			continue;
+		if (!isomgr_commit(e->cp)) {
+			ret = -EBUSY;
+			break;
+		}
+		update = true;
+	}
+
+	if (update)
+		update_mc_clock();
+
+put:
+	while (refs--)
+		kref_put(&entries[refs].cp->kref, unregister_iso_client);
+
+	isomgr_stat_add(&isomgr_stats.group, start, !ret);
+	if (!isomgr_unlock()) {
+		pr_err("isomgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	return ret;
+}
+
+/**
+ * tegra_isomgr_reserve_realize - reserve and realize bw of a group of
+ * ISO clients, e.g. the sensors of a camera pipeline.
+ *
+ * @reqs	bw (KBps) and tolerated latency (usec) of each client.
+ * @count	number of requests, no client may appear twice.
+ *
+ * The group is admitted as a whole: either every reservation is made, or
+ * none and the previous ones stay in place.
+ *
+ * @retval	0 on success.
+ * @retval	-EINVAL invalid arguments passed.
+ * @retval	-EBUSY the group could not be admitted or realized.
+ */
+int tegra_isomgr_reserve_realize(const struct tegra_isomgr_req *reqs,
+				 unsigned int count)
+{
+	struct isomgr_group_entry entries[TEGRA_ISO_CLIENT_COUNT];
+	int ret;
+
+	IS_ISOMGR_SUPPORTED(isomgr_disable, -ENOTSUPP);
+
+	if (test_mode)
+		return 0;
+
+	ret = isomgr_group_prepare(entries, reqs, count);
+	if (ret)
+		return ret;
+	return isomgr_group_apply(entries, count);
+}
+EXPORT_SYMBOL(tegra_isomgr_reserve_realize);
+
+/**
+ * tegra_isomgr_template_create - validate a group of requests once.
+ *
+ * @reqs	bw (KBps) and tolerated latency (usec) of each client.
+ * @count	number of requests, no client may appear twice.
+ *
+ * The handles and the dedicated bw limits are checked and the MC lookups
+ * done here, so tegra_isomgr_template_apply() only runs the admission
+ * check. The template is valid as long as its clients stay registered.
+ *
+ * @return	template on success, ERR_PTR on failure.
+ */
+struct tegra_isomgr_template *tegra_isomgr_template_create(
+				const struct tegra_isomgr_req *reqs,
+				unsigned int count)
+{
+	struct tegra_isomgr_template *tmpl;
+	int ret;
+
+	IS_ISOMGR_SUPPORTED(isomgr_disable, ERR_PTR(-ENOTSUPP));
+
+	if (unlikely(!reqs || !count || count > TEGRA_ISO_CLIENT_COUNT))
+		return ERR_PTR(-EINVAL);
+
+	tmpl = kzalloc(struct_size(tmpl, entries, count), GFP_KERNEL);
+	if (!tmpl)
+		return ERR_PTR(-ENOMEM);
+	tmpl->count = count;
+
+	if (test_mode)
+		return tmpl;
+
+	ret = isomgr_group_prepare(tmpl->entries, reqs, count);
+	if (ret) {
+		kfree(tmpl);
+		return ERR_PTR(ret);
+	}
+	return tmpl;
+}
+EXPORT_SYMBOL(tegra_isomgr_template_create);
+
+/**
+ * tegra_isomgr_template_apply - reserve and realize a template's group.
+ *
+ * @tmpl	template from tegra_isomgr_template_create().
+ *
+ * Same as tegra_isomgr_reserve_realize() for the requests of the template.
+ */
+int tegra_isomgr_template_apply(struct tegra_isomgr_template *tmpl)
+{
+	IS_ISOMGR_SUPPORTED(isomgr_disable, -ENOTSUPP);
+
+	if (IS_ERR_OR_NULL(tmpl))
+		return -EINVAL;
+	if (test_mode)
+		return 0;
+	return isomgr_group_apply(tmpl->entries, tmpl->count);
+}
+EXPORT_SYMBOL(tegra_isomgr_template_apply);
+
+/**
+ * tegra_isomgr_template_destroy - free a template.
+ *
+ * @tmpl	template from tegra_isomgr_template_create().
+ *
+ * The reservations made with the template are left in place.
+ */
+void tegra_isomgr_template_destroy(struct tegra_isomgr_template *tmpl)
+{
+	if (!IS_ERR_OR_NULL(tmpl))
+		kfree(tmpl);
+}
+EXPORT_SYMBOL(tegra_isomgr_template_destroy);
+
 static int __tegra_isomgr_set_margin(enum tegra_iso_client client,
 					u32 bw, bool wait)
 {
@@ -1019,6 +1329,79 @@ static void isomgr_create_sysfs(void)
 static inline void isomgr_create_sysfs(void) {};
 #endif /* CONFIG_TEGRA_ISOMGR_SYSFS */
 
+#ifdef CONFIG_DEBUG_FS
+static void isomgr_stat_show(struct seq_file *s, const char *name,
+			     const struct isomgr_stat *stat)
+{
+	seq_printf(s, "%10s%12llu%12llu%12llu%12llu\n", name,
+		   stat->calls, stat->rejected,
+		   stat->calls ? div64_u64(stat->total_ns, stat->calls) : 0,
+		   stat->max_ns);
+}
+
+static int isomgr_stats_show(struct seq_file *s, void *data)
+{
+	if (!isomgr_lock()) {
+		pr_err("isomgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	seq_printf(s, "%10s%12s%12s%12s%12s\n", "Decision",
+		   "Calls", "Rejected", "Avg(ns)", "Max(ns)");
+	isomgr_stat_show(s, "reserve", &isomgr_stats.reserve);
+	isomgr_stat_show(s, "realize", &isomgr_stats.realize);
+	isomgr_stat_show(s, "group", &isomgr_stats.group);
+	if (!isomgr_unlock()) {
+		pr_err("isomgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int isomgr_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, isomgr_stats_show, inode->i_private);
+}
+
+/* any write clears the statistics */
+static ssize_t isomgr_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	if (!isomgr_lock()) {
+		pr_err("isomgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	memset(&isomgr_stats, 0, sizeof(isomgr_stats));
+	if (!isomgr_unlock()) {
+		pr_err("isomgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	return count;
+}
+
+static const struct file_operations fops_isomgr_stats = {
+	.open = isomgr_stats_open,
+	.read = seq_read,
+	.write = isomgr_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void isomgr_debugfs_init(void)
+{
+	struct dentry *debugfs_dir;
+
+	debugfs_dir = debugfs_create_dir("isomgr", NULL);
+	if (IS_ERR_OR_NULL(debugfs_dir)) {
+		pr_err("isomgr: failed to create debugfs dir\n");
+		return;
+	}
+	debugfs_create_file("admission_stats", S_IRUSR | S_IWUSR,
+			    debugfs_dir, NULL, &fops_isomgr_stats);
+}
+#else
+static inline void isomgr_debugfs_init(void) {};
+#endif /* CONFIG_DEBUG_FS */
+
 int __init isomgr_init(void)
 {
 	int i;
@@ -1087,6 +1470,7 @@ int __init isomgr_init(void)
 	}
 
 	isomgr_create_sysfs();
+	isomgr_debugfs_init();
 	is_isomgr_up = true;
 	return 0;
 }
@@ -105,8 +105,16 @@ struct ivc_channel_header {
 		uint8_t w_align[IVC_ALIGN];
 	};
 	union {
-		/* fields owned by the receiving end */
-		uint32_t r_count;
+		struct {
+			/* fields owned by the receiving end */
+			uint32_t r_count;
+			/*
+			 * Non-zero while the receiver is polling the queue,
+			 * see tegra_ivc_set_reader_active(). Always zero for
+			 * receivers that predate it.
+			 */
+			uint32_t r_active;
+		};
 		uint8_t r_align[IVC_ALIGN];
 	};
 };
@@ -198,6 +206,23 @@ static inline void ivc_advance_rx(struct ivc *ivc)
 		ivc->r_pos++;
 }
 
+/* batched counterparts of the above, used by the *_frames() interfaces */
+static inline void ivc_advance_tx_by(struct ivc *ivc, uint32_t count)
+{
+	WRITE_ONCE(ivc->tx_channel->w_count,
+		(READ_ONCE(ivc->tx_channel->w_count) + count));
+
+	ivc->w_pos = (ivc->w_pos + count) % ivc->nframes;
+}
+
+static inline void ivc_advance_rx_by(struct ivc *ivc, uint32_t count)
+{
+	WRITE_ONCE(ivc->rx_channel->r_count,
+		(READ_ONCE(ivc->rx_channel->r_count) + count));
+
+	ivc->r_pos = (ivc->r_pos + count) % ivc->nframes;
+}
+
 static inline int ivc_check_read(struct ivc *ivc)
 {
 	/*
@@ -460,6 +485,102 @@ int tegra_ivc_read_advance(struct ivc *ivc)
 }
 EXPORT_SYMBOL(tegra_ivc_read_advance);
 
+/*
+ * Directly peek at up to max_frames received frames. The frame pointers
+ * are stored in frames[] in queue order and stay valid until the frames
+ * are released with tegra_ivc_read_advance_frames().
+ *
+ * Returns the number of frames peeked, or a negative error code.
+ */
+int tegra_ivc_read_get_frames(struct ivc *ivc, void **frames,
+		uint32_t max_frames)
+{
+	uint32_t count, pos, i;
+	int result;
+
+	result = ivc_check_read(ivc);
+	if (result)
+		return result;
+
+	/*
+	 * Pick up everything the peer has published so far with a single
+	 * invalidation, rather than one per frame.
+	 */
+	ivc_invalidate_counter(ivc, ivc->rx_handle +
+		offsetof(struct ivc_channel_header, w_count));
+	if (ivc_channel_empty(ivc, ivc->rx_channel))
+		return -ENOMEM;
+
+	/* the peer may move w_count under us, so never trust more than nframes */
+	count = min3(ivc_channel_avail_count(ivc, ivc->rx_channel),
+			ivc->nframes, max_frames);
+
+	/*
+	 * Order observation of w_pos potentially indicating new data before
+	 * data read.
+	 */
+	ivc_rmb();
+
+	pos = ivc->r_pos;
+	for (i = 0; i < count; i++) {
+		ivc_invalidate_frame(ivc, ivc->rx_handle, pos, 0,
+				ivc->frame_size);
+		frames[i] = ivc_frame_pointer(ivc, ivc->rx_channel, pos);
+		pos = (pos == ivc->nframes - 1) ? 0 : pos + 1;
+	}
+
+	return (int)count;
+}
+EXPORT_SYMBOL(tegra_ivc_read_get_frames);
+
+/*
+ * Release count frames obtained from tegra_ivc_read_get_frames() with a
+ * single counter update, barrier and notification decision.
+ */
+int tegra_ivc_read_advance_frames(struct ivc *ivc, uint32_t count)
+{
+	int result;
+
+	if (count == 0)
+		return 0;
+
+	/*
+	 * No read barriers or synchronization here, see
+	 * tegra_ivc_read_advance(). Releasing more frames than were pending
+	 * is a programming error.
+	 */
+	result = ivc_check_read(ivc);
+	if (result)
+		return result;
+
+	if (count > ivc_channel_avail_count(ivc, ivc->rx_channel))
+		return -EINVAL;
+
+	ivc_advance_rx_by(ivc, count);
+	ivc_flush_counter(ivc, ivc->rx_handle +
+			offsetof(struct ivc_channel_header, r_count));
+
+	/*
+	 * Ensure our write to r_pos occurs before our read from w_pos.
+	 */
+	ivc_mb();
+
+	/*
+	 * Notify only if the queue was full before this batch. The available
+	 * count can only asynchronously increase, so the worst possible
+	 * side-effect will be a spurious notification.
+	 */
+	ivc_invalidate_counter(ivc, ivc->rx_handle +
+		offsetof(struct ivc_channel_header, w_count));
+
+	if (ivc_channel_avail_count(ivc, ivc->rx_channel) + count >=
+			ivc->nframes)
+		ivc->notify(ivc);
+
+	return 0;
+}
+EXPORT_SYMBOL(tegra_ivc_read_advance_frames);
+
 static int ivc_write_frame(struct ivc *ivc, const void *buf,
 		const void __user *user_buf, size_t size)
 {
@@ -510,14 +631,16 @@ static int ivc_write_frame(struct ivc *ivc, const void *buf,
 	ivc_mb();
 
 	/*
-	 * Notify only upon transition from empty to non-empty.
+	 * Notify only upon transition from empty to non-empty, and only if
+	 * the receiver is not polling the queue already.
 	 * The available count can only asynchronously decrease, so the
 	 * worst possible side-effect will be a spurious notification.
 	 */
 	ivc_invalidate_counter(ivc, ivc->tx_handle +
 		offsetof(struct ivc_channel_header, r_count));
 
-	if (ivc_channel_avail_count(ivc, ivc->tx_channel) == 1)
+	if (ivc_channel_avail_count(ivc, ivc->tx_channel) == 1 &&
+			!READ_ONCE(ivc->tx_channel->r_active))
 		ivc->notify(ivc);
 
 	return (int)size;
@@ -592,20 +715,136 @@ int tegra_ivc_write_advance(struct ivc *ivc)
 	ivc_mb();
 
 	/*
-	 * Notify only upon transition from empty to non-empty.
+	 * Notify only upon transition from empty to non-empty, and only if
+	 * the receiver is not polling the queue already.
 	 * The available count can only asynchronously decrease, so the
 	 * worst possible side-effect will be a spurious notification.
 	 */
 	ivc_invalidate_counter(ivc, ivc->tx_handle +
 		offsetof(struct ivc_channel_header, r_count));
 
-	if (ivc_channel_avail_count(ivc, ivc->tx_channel) == 1)
+	if (ivc_channel_avail_count(ivc, ivc->tx_channel) == 1 &&
+			!READ_ONCE(ivc->tx_channel->r_active))
 		ivc->notify(ivc);
 
 	return 0;
 }
 EXPORT_SYMBOL(tegra_ivc_write_advance);
 
+/*
+ * Directly poke at up to max_frames frames to be transmitted. The frames
+ * are handed to the peer with tegra_ivc_write_advance_frames().
+ *
+ * Returns the number of frames available, or a negative error code.
+ */
+int tegra_ivc_write_get_frames(struct ivc *ivc, void **frames,
+		uint32_t max_frames)
+{
+	uint32_t count, pos, i;
+	int result;
+
+	result = ivc_check_write(ivc);
+	if (result)
+		return result;
+
+	/* see how much room the peer has made with a single invalidation */
+	ivc_invalidate_counter(ivc, ivc->tx_handle +
+		offsetof(struct ivc_channel_header, r_count));
+	if (ivc_channel_full(ivc, ivc->tx_channel))
+		return -ENOMEM;
+
+	count = min(ivc->nframes -
+			ivc_channel_avail_count(ivc, ivc->tx_channel),
+			max_frames);
+
+	pos = ivc->w_pos;
+	for (i = 0; i < count; i++) {
+		frames[i] = ivc_frame_pointer(ivc, ivc->tx_channel, pos);
+		pos = (pos == ivc->nframes - 1) ? 0 : pos + 1;
+	}
+
+	return (int)count;
+}
+EXPORT_SYMBOL(tegra_ivc_write_get_frames);
+
+/*
+ * Publish count frames filled through tegra_ivc_write_get_frames() with a
+ * single write barrier, counter update and notification decision.
+ */
+int tegra_ivc_write_advance_frames(struct ivc *ivc, uint32_t count)
+{
+	uint32_t pos, i;
+	int result;
+
+	if (count == 0)
+		return 0;
+
+	result = ivc_check_write(ivc);
+	if (result)
+		return result;
+
+	if (count > ivc->nframes -
+			ivc_channel_avail_count(ivc, ivc->tx_channel))
+		return -EINVAL;
+
+	pos = ivc->w_pos;
+	for (i = 0; i < count; i++) {
+		ivc_flush_frame(ivc, ivc->tx_handle, pos, 0, ivc->frame_size);
+		pos = (pos == ivc->nframes - 1) ? 0 : pos + 1;
+	}
+
+	/*
+	 * Order any possible stores to the frames before update of w_pos.
+	 */
+	ivc_wmb();
+
+	ivc_advance_tx_by(ivc, count);
+	ivc_flush_counter(ivc, ivc->tx_handle +
+			offsetof(struct ivc_channel_header, w_count));
+
+	/*
+	 * Ensure our write to w_pos occurs before our read from r_pos.
+	 */
+	ivc_mb();
+
+	/*
+	 * Notify only if the queue was empty before this batch and the
+	 * receiver is not polling it. The available count can only
+	 * asynchronously decrease, so the worst possible side-effect will be
+	 * a spurious notification.
+	 */
+	ivc_invalidate_counter(ivc, ivc->tx_handle +
+		offsetof(struct ivc_channel_header, r_count));
+
+	if (ivc_channel_avail_count(ivc, ivc->tx_channel) <= count &&
+			!READ_ONCE(ivc->tx_channel->r_active))
+		ivc->notify(ivc);
+
+	return 0;
+}
+EXPORT_SYMBOL(tegra_ivc_write_advance_frames);
+
+/*
+ * Tell the transmitter that we are polling the rx queue, so it can skip the
+ * empty to non-empty notification. After clearing the flag the caller must
+ * check the queue once more: frames written while it was set came without
+ * a notification.
+ */
+void tegra_ivc_set_reader_active(struct ivc *ivc, bool active)
+{
+	WRITE_ONCE(ivc->rx_channel->r_active, active ? 1U : 0U);
+	ivc_flush_counter(ivc, ivc->rx_handle +
+			offsetof(struct ivc_channel_header, r_count));
+
+	/*
+	 * Order the flag update against the following read of w_count; pairs
+	 * with the barrier between the w_count update and the r_active read
+	 * on the transmit side.
+	 */
+	ivc_mb();
+}
+EXPORT_SYMBOL(tegra_ivc_set_reader_active);
+
 void tegra_ivc_channel_reset(struct ivc *ivc)
 {
 	ivc->tx_channel->state = ivc_state_sync;
@@ -256,6 +256,8 @@ void nvhost_debug_init(struct nvhost_master *master)
 
 	debugfs_create_u32("trace_cmdbuf", S_IRUGO|S_IWUSR, de,
 			&nvhost_debug_trace_cmdbuf);
+	debugfs_create_u32("cdma_kick_delay_us", S_IRUGO|S_IWUSR, de,
+			&nvhost_cdma_kick_delay_us);
 
 	if (nvhost_get_chip_ops()->debug.debug_init)
 		nvhost_get_chip_ops()->debug.debug_init(de);
@@ -272,6 +274,8 @@ void nvhost_debug_init(struct nvhost_master *master)
 #endif
 	debugfs_create_u32("timeout_default_ms", S_IRUGO|S_IWUSR, de,
 			&pdata->nvhost_timeout_default);
+	debugfs_create_u32("syncpt_spin_wait_us", S_IRUGO|S_IWUSR, de,
+			&master->syncpt.spin_wait_us);
 	debugfs_create_u32("trace_actmon", S_IRUGO|S_IWUSR, de,
 			&nvhost_debug_trace_actmon);
 }
@@ -502,6 +502,42 @@ out:
 	cdma_op().timeout_teardown_end(cdma, get_restart);
 }
 
+u32 nvhost_cdma_kick_delay_us = NVHOST_CDMA_KICK_DELAY_US;
+
+/*
+ * Must be called with the channel submitlock and a read lock on cdma->lock
+ * held, so that a half-pushed job is never exposed to the hardware.
+ */
+static void cdma_kick_locked(struct nvhost_cdma *cdma)
+{
+	cdma->kick_pending = 0;
+	cdma_op().kick(cdma);
+}
+
+static void cdma_kick_work(struct work_struct *work)
+{
+	struct nvhost_cdma *cdma =
+		container_of(work, struct nvhost_cdma, kick_work);
+	struct nvhost_channel *ch = cdma_to_channel(cdma);
+
+	mutex_lock(&ch->submitlock);
+	down_read(&cdma->lock);
+	if (cdma->kick_pending)
+		cdma_kick_locked(cdma);
+	up_read(&cdma->lock);
+	mutex_unlock(&ch->submitlock);
+}
+
+static enum hrtimer_restart cdma_kick_timer(struct hrtimer *timer)
+{
+	struct nvhost_cdma *cdma =
+		container_of(timer, struct nvhost_cdma, kick_timer);
+
+	queue_work(system_highpri_wq, &cdma->kick_work);
+
+	return HRTIMER_NORESTART;
+}
+
 /**
  * Create a cdma
  */
@@ -518,6 +554,11 @@ int nvhost_cdma_init(struct platform_device *pdev,
 
 	INIT_LIST_HEAD(&cdma->sync_queue);
 
+	hrtimer_init(&cdma->kick_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cdma->kick_timer.function = cdma_kick_timer;
+	INIT_WORK(&cdma->kick_work, cdma_kick_work);
+	cdma->kick_pending = 0;
+
 	cdma->event = CDMA_EVENT_NONE;
 	cdma->running = false;
 	cdma->torndown = false;
@@ -537,6 +578,8 @@ void nvhost_cdma_deinit(struct nvhost_cdma *cdma)
 	struct push_buffer *pb = &cdma->push_buffer;
 
 	WARN_ON(cdma->running);
+	hrtimer_cancel(&cdma->kick_timer);
+	cancel_work_sync(&cdma->kick_work);
 	nvhost_push_buffer_destroy(pb);
 	cdma_op().timeout_destroy(cdma);
 }
@@ -633,6 +676,10 @@ void nvhost_cdma_push_gather(struct nvhost_cdma *cdma,
  * Kick off DMA, add job to the sync queue, and a number of slots to be freed
  * from the pushbuffer. The handles for a submit must all be pinned at the same
  * time, but they can be unpinned in smaller chunks.
+ *
+ * If the channel is still executing earlier jobs, the kick may be deferred
+ * for up to nvhost_cdma_kick_delay_us so that back-to-back small jobs are
+ * started by a single DMAPUT update.
  */
 void nvhost_cdma_end(struct nvhost_cdma *cdma,
 		struct nvhost_job *job)
@@ -648,7 +695,14 @@ void nvhost_cdma_end(struct nvhost_cdma *cdma,
 			cdma->slots_used,
 			cdma->first_get);
 
-	cdma_op().kick(cdma);
+	if (was_idle || !nvhost_cdma_kick_delay_us ||
+	    ++cdma->kick_pending >= NVHOST_CDMA_KICK_BATCH)
+		cdma_kick_locked(cdma);
+	else if (cdma->kick_pending == 1)
+		hrtimer_start(&cdma->kick_timer,
+			      ns_to_ktime((u64)nvhost_cdma_kick_delay_us *
+					  NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
 
 	/* start timer on idle -> active transitions */
 	if (was_idle)
@@ -23,6 +23,8 @@
 
 #include <linux/sched.h>
 #include <linux/semaphore.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
 
 #include <linux/nvhost.h>
 #include <linux/list.h>
@@ -44,6 +46,15 @@ struct mem_handle;
      * and replaces the original timed out contexts GATHER slots */
 #define SYNCPT_INCR_BUFFER_SIZE_WORDS   (4096 / sizeof(u32))
 
+/*
+ * While a channel is busy, jobs pushed within this many microseconds share
+ * one DMAPUT write. A channel going idle -> active is always kicked at once.
+ */
+#define NVHOST_CDMA_KICK_DELAY_US	20
+
+/* Deferred jobs after which the channel is kicked regardless of the delay */
+#define NVHOST_CDMA_KICK_BATCH		8
+
 /*
  * cdma
  *
@@ -128,7 +139,7 @@ enum cdma_event {
  *
  * We use this lock to serialize all submits on a channel/CDMA
  * This lock also protects interleaving of CDMA commands in case a channel is
- * shared between multiple users
+ * shared between multiple users, and nvhost_cdma->kick_pending
  */
 
 struct nvhost_cdma {
@@ -146,10 +157,15 @@ struct nvhost_cdma {
 	struct list_head sync_queue;	/* job queue */
 	struct buffer_timeout timeout;	/* channel's timeout state/wq */
 	struct platform_device *pdev;	/* pointer to host1x device */
+	struct hrtimer kick_timer;	/* deadline of a deferred kick */
+	struct work_struct kick_work;	/* performs the deferred kick */
+	unsigned int kick_pending;	/* jobs pushed but not kicked yet */
 	bool running;
 	bool torndown;
 };
 
+extern u32 nvhost_cdma_kick_delay_us;
+
 #define cdma_to_channel(cdma) container_of(cdma, struct nvhost_channel, cdma)
 #define cdma_to_dev(cdma) nvhost_get_host(cdma->pdev)
 #define pb_to_cdma(pb) container_of(pb, struct nvhost_cdma, push_buffer)
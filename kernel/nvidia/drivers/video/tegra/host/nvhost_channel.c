@@ -67,6 +67,7 @@ int nvhost_alloc_channels(struct nvhost_master *host)
 		/* initialize data structures */
 		nvhost_set_chanops(ch);
 		mutex_init(&ch->submitlock);
+		spin_lock_init(&ch->job_cache_lock);
 		ch->chid = nvhost_channel_get_id_from_index(host, index);
 
 		/* initialize channel cdma */
@@ -329,10 +330,17 @@ EXPORT_SYMBOL(nvhost_channel_map);
 /* Free channel memory and list */
 int nvhost_channel_list_free(struct nvhost_master *host)
 {
-	int i;
+	int i, j;
 
-	for (i = 0; i < nvhost_channel_nb_channels(host); i++)
-		kfree(host->chlist[i]);
+	for (i = 0; i < nvhost_channel_nb_channels(host); i++) {
+		struct nvhost_channel *ch = host->chlist[i];
+
+		if (!ch)
+			continue;
+		for (j = 0; j < ch->job_cache_count; j++)
+			kfree(ch->job_cache[j]);
+		kfree(ch);
+	}
 
 	dev_info(&host->dev->dev, "channel list free'd\n");
 
@@ -30,6 +30,10 @@
 #define NVHOST_MAX_HANDLES		1280
 #define NVHOST_MAX_POWERGATE_IDS	2
 
+/* Freed jobs up to this size are kept per channel for reuse */
+#define NVHOST_JOB_CACHE_OBJ_SIZE	(PAGE_SIZE * 2)
+#define NVHOST_JOB_CACHE_DEPTH		16
+
 struct nvhost_master;
 struct platform_device;
 struct nvhost_channel;
@@ -57,6 +61,10 @@ struct nvhost_channel {
 	struct nvhost_vm *vm;
 	/* owner identifier */
 	void *identifier;
+	/* recycled job allocations */
+	spinlock_t job_cache_lock;
+	unsigned int job_cache_count;
+	void *job_cache[NVHOST_JOB_CACHE_DEPTH];
 };
 
 #define channel_op(ch)		(ch->ops)
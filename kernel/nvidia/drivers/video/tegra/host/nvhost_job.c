@@ -97,6 +97,32 @@ static void init_fields(struct nvhost_job *job,
 	job->gather_addr_phys = &job->addr_phys[num_relocs];
 }
 
+static void *job_cache_get(struct nvhost_channel *ch)
+{
+	void *mem = NULL;
+
+	spin_lock(&ch->job_cache_lock);
+	if (ch->job_cache_count)
+		mem = ch->job_cache[--ch->job_cache_count];
+	spin_unlock(&ch->job_cache_lock);
+
+	return mem;
+}
+
+static bool job_cache_put(struct nvhost_channel *ch, void *mem)
+{
+	bool cached = false;
+
+	spin_lock(&ch->job_cache_lock);
+	if (ch->job_cache_count < NVHOST_JOB_CACHE_DEPTH) {
+		ch->job_cache[ch->job_cache_count++] = mem;
+		cached = true;
+	}
+	spin_unlock(&ch->job_cache_lock);
+
+	return cached;
+}
+
 struct nvhost_job *nvhost_job_alloc(struct nvhost_channel *ch,
 		int num_cmdbufs, int num_relocs, int num_waitchks,
 		int num_syncpts)
@@ -110,11 +136,18 @@ struct nvhost_job *nvhost_job_alloc(struct nvhost_channel *ch,
 		nvhost_err(&pdata->pdev->dev, "empty job requested");
 		return NULL;
 	}
-	if (size <= PAGE_SIZE * 2) {
-		job = kzalloc(size, GFP_KERNEL);
-		if (!job) {
+	if (size <= NVHOST_JOB_CACHE_OBJ_SIZE) {
+		/*
+		 * Small jobs always use a full cache object so that the
+		 * memory can be recycled through the channel's job cache.
+		 */
+		job = job_cache_get(ch);
+		if (!job)
+			job = kmalloc(NVHOST_JOB_CACHE_OBJ_SIZE, GFP_KERNEL);
+		if (job)
+			memset(job, 0, size);
+		else
 			job = vzalloc(size);
-		}
 	} else {
 		nvhost_warn(&pdata->pdev->dev,
 			"job is very large (%lu), expect performance loss\n",
@@ -179,10 +212,10 @@ static void job_free(struct kref *ref)
 
 	if (job->error_notifier_ref)
 		dma_buf_put(job->error_notifier_ref);
-	if (!is_vmalloc_addr(job))
-		kfree(job);
-	else
+	if (is_vmalloc_addr(job))
 		vfree(job);
+	else if (!job_cache_put(ch, job))
+		kfree(job);
 }
 
 void nvhost_job_put(struct nvhost_job *job)
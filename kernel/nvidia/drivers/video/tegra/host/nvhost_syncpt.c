@@ -25,6 +25,7 @@
 #include <linux/stat.h>
 #include <linux/export.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include <linux/nospec.h>
 #include <trace/events/nvhost.h>
 #include <linux/version.h>
@@ -296,6 +297,30 @@ int nvhost_syncpt_wait_timeout(struct nvhost_syncpt *sp, u32 id,
 		goto done;
 	}
 
+	/*
+	 * Most waits in a capture/encode pipeline are short. Poll the
+	 * syncpoint for a few microseconds before paying for a threshold
+	 * interrupt and a context switch.
+	 */
+	if (sp->spin_wait_us) {
+		u64 spin_end = ktime_get_ns() +
+			(u64)sp->spin_wait_us * NSEC_PER_USEC;
+
+		do {
+			if (syncpt_update_min_is_expired(sp, id, thresh)) {
+				if (value)
+					*value = nvhost_syncpt_read_min(sp, id);
+				if (ts)
+					nvhost_ktime_get_ts(ts);
+				err = 0;
+				goto done;
+			}
+			cpu_relax();
+		} while (ktime_get_ns() < spin_end);
+
+		val = nvhost_syncpt_read_min(sp, id);
+	}
+
 	old_val = val;
 
 	/* Set up a threshold interrupt waiter */
@@ -1079,6 +1104,8 @@ int nvhost_syncpt_init(struct platform_device *dev,
 	int nb_pts = nvhost_syncpt_nb_hw_pts(sp);
 	int err = 0;
 
+	sp->spin_wait_us = SYNCPT_SPIN_WAIT_US;
+
 	/* Allocate structs for min, max and base values */
 	sp->assigned = kzalloc(sizeof(bool) * nb_pts, GFP_KERNEL);
 	sp->client_managed = kzalloc(sizeof(bool) * nb_pts, GFP_KERNEL);
@@ -72,6 +72,7 @@ struct nvhost_syncpt {
 #if IS_ENABLED(CONFIG_TEGRA_GRHOST_SYNC) && IS_ENABLED(CONFIG_SYNC_FILE)
 	u64 syncpt_context_base;
 #endif
+	u32 spin_wait_us;
 };
 
 int nvhost_syncpt_init(struct platform_device *, struct nvhost_syncpt *);
@@ -80,6 +81,7 @@ void nvhost_syncpt_deinit(struct nvhost_syncpt *);
 #define syncpt_to_dev(sp) container_of(sp, struct nvhost_master, syncpt)
 #define SYNCPT_CHECK_PERIOD (6 * HZ)
 #define SYNCPT_POLL_PERIOD 1 /* msecs */
+#define SYNCPT_SPIN_WAIT_US 20 /* default busy-poll before sleeping */
 #define MAX_STUCK_CHECK_COUNT 15
 
 /**
@@ -7,6 +7,8 @@
 #include <linux/nvhost_t194.h>
 #include <linux/dma-buf.h>
 #include <linux/dma-mapping.h>
+#include <linux/mm.h>
+#include <linux/version.h>
 #include <uapi/linux/nvhost_ioctl.h>
 
 #include "host1x/host1x.h"
@@ -99,9 +101,42 @@ static void nvhost_syncpt_unmap_dmabuf(struct dma_buf_attachment *attachment,
 	kfree(sgt);
 }
 
+/*
+ * Map the shim into a process so that it can poll syncpoint values without
+ * an ioctl. The CPU only ever gets a read-only view: increments still go
+ * through host1x.
+ */
+static int nvhost_syncpt_mmap_dmabuf(struct dma_buf *dmabuf,
+				     struct vm_area_struct *vma)
+{
+	struct nvhost_syncpt_dmabuf_data *data = dmabuf->priv;
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	if (!PAGE_ALIGNED(data->shim_pa) ||
+	    size + (vma->vm_pgoff << PAGE_SHIFT) > PAGE_ALIGN(data->size))
+		return -EINVAL;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+	vm_flags_clear(vma, VM_MAYWRITE);
+	vm_flags_set(vma, VM_IO | VM_DONTEXPAND | VM_DONTDUMP);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_IO | VM_DONTEXPAND | VM_DONTDUMP;
+#endif
+	vma->vm_page_prot = pgprot_device(vma->vm_page_prot);
+
+	return io_remap_pfn_range(vma, vma->vm_start,
+				  PHYS_PFN(data->shim_pa) + vma->vm_pgoff,
+				  size, vma->vm_page_prot);
+}
+
 static const struct dma_buf_ops syncpoint_dmabuf_ops = {
 	.map_dma_buf = nvhost_syncpt_map_dmabuf,
 	.unmap_dma_buf = nvhost_syncpt_unmap_dmabuf,
+	.mmap = nvhost_syncpt_mmap_dmabuf,
 	.release = nvhost_syncpt_dmabuf_release,
 };
 
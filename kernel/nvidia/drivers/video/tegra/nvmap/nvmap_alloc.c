@@ -41,6 +41,7 @@ bool nvmap_convert_iovmm_to_carveout;
 
 u32 nvmap_max_handle_count;
 u64 nvmap_big_page_allocs;
+u64 nvmap_huge_page_allocs;
 u64 nvmap_total_page_allocs;
 
 /* handles may be arbitrarily large (16+MiB), and any handle allocated from
@@ -87,6 +88,11 @@ static struct page *nvmap_alloc_pages_exact(gfp_t gfp, size_t size)
 	return page;
 }
 
+#ifdef CONFIG_ARM64_4K_PAGES
+/* A PMD worth of pages, mapped with a single SMMU/GMMU entry */
+#define NVMAP_HUGE_PAGE_SIZE	SZ_2M
+#endif /* CONFIG_ARM64_4K_PAGES */
+
 static uint s_nr_colors = 1;
 module_param_named(nr_colors, s_nr_colors, uint, 0644);
 
@@ -523,10 +529,35 @@ static int handle_page_alloc(struct nvmap_client *client,
 
 	} else {
 #ifdef CONFIG_ARM64_4K_PAGES
+		/*
+		 * Huge pages first: the pool only keeps big pages, and a 2M
+		 * chunk saves the SMMU and GMMU walks of 32 big ones. Like the
+		 * big pages below, do not reclaim for them.
+		 */
+		while (nr_page - page_index >=
+				(NVMAP_HUGE_PAGE_SIZE >> PAGE_SHIFT)) {
+			gfp_t gfp_no_reclaim = (gfp | __GFP_NOMEMALLOC | __GFP_NOWARN) &
+						~__GFP_RECLAIM;
+			struct page *page;
+			int idx;
+
+			page = nvmap_alloc_pages_exact(gfp_no_reclaim,
+					NVMAP_HUGE_PAGE_SIZE);
+			if (!page)
+				break;
+
+			for (idx = 0; idx < (NVMAP_HUGE_PAGE_SIZE >> PAGE_SHIFT); idx++)
+				pages[page_index + idx] = nth_page(page, idx);
+			nvmap_clean_cache(&pages[page_index],
+					NVMAP_HUGE_PAGE_SIZE >> PAGE_SHIFT);
+			page_index += NVMAP_HUGE_PAGE_SIZE >> PAGE_SHIFT;
+		}
+		nvmap_huge_page_allocs += page_index;
+
 #ifdef NVMAP_CONFIG_PAGE_POOLS
 		/* Get as many big pages from the pool as possible. */
-		page_index = nvmap_page_pool_alloc_lots_bp(&nvmap_dev->pool, pages,
-								 nr_page);
+		page_index += nvmap_page_pool_alloc_lots_bp(&nvmap_dev->pool,
+				&pages[page_index], nr_page - page_index);
 		pages_per_big_pg = nvmap_dev->pool.pages_per_big_pg;
 #endif
 		/* Try to allocate big pages from page allocator */
@@ -17,7 +17,9 @@
 
 #include <linux/io.h>
 #include <linux/debugfs.h>
+#include <linux/ktime.h>
 #include <linux/of.h>
+#include <linux/nvmap_t19x.h>
 #include <linux/version.h>
 #if KERNEL_VERSION(4, 15, 0) > LINUX_VERSION_CODE
 #include <soc/tegra/chip-id.h>
@@ -36,6 +38,11 @@ __weak struct arm64_ftr_reg arm64_ftr_reg_ctrel0;
 
 static struct static_key nvmap_disable_vaddr_for_cache_maint;
 
+/*
+ * Largest block mapped at once when maintaining memory that is not in the
+ * kernel linear map (no-map carveouts).
+ */
+#define NVMAP_CACHE_MAINT_CHUNK	SZ_2M
 
 /*
  * FIXME:
@@ -121,9 +128,18 @@ per_page_cache_maint:
 		page = nvmap_to_page(h->pgalloc.pages[start >> PAGE_SHIFT]);
 		next = min(((start + PAGE_SIZE) & PAGE_MASK), end);
 		off = start & ~PAGE_MASK;
-		size = next - start;
 		paddr = page_to_phys(page) + off;
 
+		/* Issue one range op over physically contiguous pages */
+		while (next < end) {
+			page = nvmap_to_page(
+				h->pgalloc.pages[next >> PAGE_SHIFT]);
+			if (page_to_phys(page) != paddr + (next - start))
+				break;
+			next = min(next + PAGE_SIZE, end);
+		}
+		size = next - start;
+
 		ret = nvmap_cache_maint_phys_range(op, paddr, paddr + size,
 				inner, outer);
 		WARN_ON(ret != 0);
@@ -152,13 +168,35 @@ int nvmap_cache_maint_phys_range(unsigned int op, phys_addr_t pstart,
 
 	loop = pstart;
 	while (loop < pend) {
-		phys_addr_t next = (loop + PAGE_SIZE) & PAGE_MASK;
+		phys_addr_t next = min(ALIGN(loop + 1, NVMAP_CACHE_MAINT_CHUNK),
+				       pend);
+		bool linear = pfn_valid(PFN_DOWN(loop));
+		phys_addr_t map_start, p;
+		size_t map_size;
 		void *base;
-		next = min(next, pend);
+
+		/* Keep linearly mapped and unmapped pages in separate ops */
+		for (p = (loop & PAGE_MASK) + PAGE_SIZE; p < next;
+		     p += PAGE_SIZE) {
+			if (pfn_valid(PFN_DOWN(p)) != linear) {
+				next = p;
+				break;
+			}
+		}
+
+		if (linear) {
+			inner_cache_maint(op, phys_to_virt(loop), next - loop);
+			loop = next;
+			continue;
+		}
+
+		map_start = loop & PAGE_MASK;
+		map_size = PAGE_ALIGN(next) - map_start;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 0, 0)
-		io_addr = ioremap_prot(loop, PAGE_SIZE, pgprot_val(PAGE_KERNEL));
+		io_addr = ioremap_prot(map_start, map_size,
+				       pgprot_val(PAGE_KERNEL));
 #else
-		io_addr = __ioremap(loop, PAGE_SIZE, PG_PROT_KERNEL);
+		io_addr = __ioremap(map_start, map_size, PG_PROT_KERNEL);
 #endif
 		if (io_addr == NULL)
 			return -ENOMEM;
@@ -235,6 +273,7 @@ int __nvmap_do_cache_maint(struct nvmap_client *client,
 			unsigned int op, bool clean_only_dirty)
 {
 	int err;
+	u64 t;
 	struct cache_maint_op cache_op;
 
 	h = nvmap_handle_get(h);
@@ -271,12 +310,50 @@ int __nvmap_do_cache_maint(struct nvmap_client *client,
 	cache_op.clean_only_dirty = clean_only_dirty;
 
 	nvmap_stats_inc(NS_CFLUSH_RQ, end - start);
+
+	/*
+	 * Until a device that is not I/O coherent maps the handle, the SCF
+	 * keeps the CPU and device views in sync. Record that maintenance
+	 * was skipped so the first non-coherent map can catch up. Pairs with
+	 * the barrier in nvmap_handle_nc_map().
+	 */
+	if (nvmap_version_t19x) {
+		WRITE_ONCE(h->maint_deferred, true);
+		smp_mb();
+		if (!READ_ONCE(h->nc_mapped)) {
+			nvmap_stats_inc(NS_CFLUSH_SKIP,
+					cache_op.end - cache_op.start);
+			err = 0;
+			goto out;
+		}
+	}
+
+	t = ktime_get_ns();
 	err = do_cache_maint(&cache_op);
+	nvmap_stats_inc(NS_CFLUSH_NS, ktime_get_ns() - t);
+out:
 	nvmap_kmaps_dec(h);
 	nvmap_handle_put(h);
 	return err;
 }
 
+/*
+ * Called before @h is mapped by a device that is not I/O coherent. The
+ * first such map performs the maintenance deferred so far on the whole
+ * handle.
+ */
+void nvmap_handle_nc_map(struct nvmap_handle *h)
+{
+	if (READ_ONCE(h->nc_mapped))
+		return;
+
+	WRITE_ONCE(h->nc_mapped, true);
+	smp_mb();
+	if (xchg(&h->maint_deferred, false))
+		__nvmap_do_cache_maint(h->owner, h, 0, h->size,
+				       NVMAP_CACHE_OP_WB_INV, false);
+}
+
 int __nvmap_cache_maint(struct nvmap_client *client,
 			       struct nvmap_cache_op_64 *op)
 {
@@ -333,9 +410,9 @@ out:
  * this is done by replacing offsets[i] = 0, sizes[i] = handles[i]->size.
  * So, the input arrays sizes, offsets  are not guaranteed to be read-only
  *
- * This will optimze the op if it can.
- * In the case that all the handles together are larger than the inner cache
- * maint threshold it is possible to just do an entire inner cache flush.
+ * Each region is maintained by VA/PA range. A whole-cache set/way flush is
+ * never used: it is not coherent with other cores and would also evict the
+ * lines of the cells running next to Linux.
  *
  * NOTE: this omits outer cache operations which is fine for ARM64
  */
@@ -345,7 +422,6 @@ static int __nvmap_do_cache_maint_list(struct nvmap_handle **handles,
 {
 	u32 i;
 	u64 total = 0;
-	u64 thresh = ~0;
 
 	WARN(!IS_ENABLED(CONFIG_ARM64),
 		"cache list operation may not function properly");
@@ -369,43 +445,22 @@ static int __nvmap_do_cache_maint_list(struct nvmap_handle **handles,
 	if (!total)
 		return 0;
 
-	/* Full flush in the case the passed list is bigger than our
-	 * threshold. */
-	if (total >= thresh) {
-		for (i = 0; i < nr_ops; i++) {
-			if (handles[i]->userflags &
-			    NVMAP_HANDLE_CACHE_SYNC) {
-				nvmap_handle_mkclean(handles[i], 0,
-						     handles[i]->size);
-				nvmap_zap_handle(handles[i], 0,
-						 handles[i]->size);
-			}
-		}
-
-		nvmap_stats_inc(NS_CFLUSH_RQ, total);
-		nvmap_stats_inc(NS_CFLUSH_DONE, thresh);
-		trace_nvmap_cache_flush(total,
-					nvmap_stats_read(NS_ALLOC),
-					nvmap_stats_read(NS_CFLUSH_RQ),
-					nvmap_stats_read(NS_CFLUSH_DONE));
-	} else {
-		for (i = 0; i < nr_ops; i++) {
-			u32 *offs_32 = (u32 *)offsets, *sizes_32 = (u32 *)sizes;
-			u64 size = is_32 ? sizes_32[i] : sizes[i];
-			u64 offset = is_32 ? offs_32[i] : offsets[i];
-			int err;
-
-			size = size ?: handles[i]->size;
-			offset = offset ?: 0;
-			err = __nvmap_do_cache_maint(handles[i]->owner,
-						     handles[i], offset,
-						     offset + size,
-						     op, false);
-			if (err) {
-				pr_err("cache maint per handle failed [%d]\n",
-						err);
-				return err;
-			}
+	for (i = 0; i < nr_ops; i++) {
+		u32 *offs_32 = (u32 *)offsets, *sizes_32 = (u32 *)sizes;
+		u64 size = is_32 ? sizes_32[i] : sizes[i];
+		u64 offset = is_32 ? offs_32[i] : offsets[i];
+		int err;
+
+		size = size ?: handles[i]->size;
+		offset = offset ?: 0;
+		err = __nvmap_do_cache_maint(handles[i]->owner,
+					     handles[i], offset,
+					     offset + size,
+					     op, false);
+		if (err) {
+			pr_err("cache maint per handle failed [%d]\n",
+					err);
+			return err;
 		}
 	}
 
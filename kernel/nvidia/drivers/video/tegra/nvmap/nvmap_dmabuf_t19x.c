@@ -59,8 +59,10 @@ struct sg_table *nvmap_dmabuf_map_dma_buf(
 					  nvmap_handle_t19x_free);
 	}
 
-	if (!of_dma_is_coherent(attach->dev->of_node))
+	if (!of_dma_is_coherent(attach->dev->of_node)) {
+		nvmap_handle_nc_map(handle);
 		atomic_inc(&handle_t19x->nc_pin);
+	}
 
 dmabuf_map:
 	sg_table = _nvmap_dmabuf_map_dma_buf(attach, dir);
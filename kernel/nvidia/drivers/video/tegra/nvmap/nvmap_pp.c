@@ -27,6 +27,7 @@
 #include <linux/freezer.h>
 #include <linux/highmem.h>
 #include <linux/version.h>
+#include <linux/percpu.h>
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
 #include <linux/sched/clock.h>
@@ -40,6 +41,23 @@
 #define NVMAP_TEST_PAGE_POOL_SHRINKER     1
 #define PENDING_PAGES_SIZE                (SZ_1M / PAGE_SIZE)
 
+/*
+ * Per-CPU magazines of zeroed pages sit in front of the page list, so that
+ * small allocations are served without pool->lock. A magazine is topped up
+ * to NVMAP_PP_MAG_BATCH pages whenever an allocation takes the pool lock
+ * anyway, and emptied last by the shrinker.
+ */
+#define NVMAP_PP_MAG_SIZE                 64
+#define NVMAP_PP_MAG_BATCH                (NVMAP_PP_MAG_SIZE / 2)
+
+struct nvmap_pp_magazine {
+	spinlock_t lock;
+	u32 count;
+	struct page *pages[NVMAP_PP_MAG_SIZE];
+};
+
+static DEFINE_PER_CPU(struct nvmap_pp_magazine, nvmap_pp_mags);
+
 static bool enable_pp = 1;
 static u32 pool_size;
 
@@ -209,6 +227,90 @@ static void nvmap_pgcount(struct page *page, bool incr)
 }
 #endif /* NVMAP_CONFIG_PAGE_POOL_DEBUG */
 
+/*
+ * Take up to nr zeroed pages from the local magazine. Migrating to another
+ * CPU in between is harmless, the magazine lock covers it.
+ */
+static u32 nvmap_pp_mag_alloc(struct nvmap_page_pool *pool,
+			      struct page **pages, u32 nr)
+{
+	struct nvmap_pp_magazine *mag = raw_cpu_ptr(&nvmap_pp_mags);
+	u32 ind = 0;
+
+	spin_lock(&mag->lock);
+	while (ind < nr && mag->count) {
+		pages[ind] = mag->pages[--mag->count];
+#ifdef NVMAP_CONFIG_PAGE_POOL_DEBUG
+		nvmap_pgcount(pages[ind], false);
+		BUG_ON(page_count(pages[ind]) != 1);
+#endif /* NVMAP_CONFIG_PAGE_POOL_DEBUG */
+		ind++;
+	}
+	spin_unlock(&mag->lock);
+
+	atomic_sub(ind, &pool->mag_count);
+
+	return ind;
+}
+
+/*
+ * Move zeroed pages from the page list into the local magazine.
+ *
+ * You must lock the page pool before using this.
+ */
+static void nvmap_pp_mag_refill_locked(struct nvmap_page_pool *pool)
+{
+	struct nvmap_pp_magazine *mag = raw_cpu_ptr(&nvmap_pp_mags);
+	struct page *page;
+	u32 filled = 0;
+
+	spin_lock(&mag->lock);
+	while (mag->count < NVMAP_PP_MAG_BATCH) {
+		page = get_page_list_page(pool);
+		if (!page)
+			break;
+		mag->pages[mag->count++] = page;
+		filled++;
+	}
+	spin_unlock(&mag->lock);
+
+	atomic_add(filled, &pool->mag_count);
+}
+
+/*
+ * Free up to nr_pages pages held in the magazines and return how many are
+ * left to free.
+ *
+ * You must lock the page pool before using this.
+ */
+static ulong nvmap_pp_mag_free_locked(struct nvmap_page_pool *pool,
+				      ulong nr_pages)
+{
+	struct nvmap_pp_magazine *mag;
+	u32 freed;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		if (!nr_pages)
+			break;
+
+		mag = per_cpu_ptr(&nvmap_pp_mags, cpu);
+		freed = 0;
+
+		spin_lock(&mag->lock);
+		while (nr_pages && mag->count) {
+			__free_page(mag->pages[--mag->count]);
+			nr_pages--;
+			freed++;
+		}
+		spin_unlock(&mag->lock);
+
+		atomic_sub(freed, &pool->mag_count);
+	}
+
+	return nr_pages;
+}
+
 /*
  * Free the passed number of pages from the page pool. This happens regardless
  * of whether the page pools are enabled. This lets one disable the page pools
@@ -252,6 +354,8 @@ static ulong nvmap_page_pool_free_pages_locked(struct nvmap_page_pool *pool,
 				continue;
 			}
 #endif /* CONFIG_ARM64_4K_PAGES */
+			/* the magazines hold the hottest pages, free them last */
+			nr_pages = nvmap_pp_mag_free_locked(pool, nr_pages);
 			break;
 		}
 
@@ -286,13 +390,17 @@ static ulong nvmap_page_pool_free_pages_locked(struct nvmap_page_pool *pool,
 int nvmap_page_pool_alloc_lots(struct nvmap_page_pool *pool,
 				struct page **pages, u32 nr)
 {
-	u32 ind = 0;
+	u32 ind;
 	u32 non_zero_idx;
 	u32 non_zero_cnt = 0;
 
 	if (!enable_pp || !nr)
 		return 0;
 
+	ind = nvmap_pp_mag_alloc(pool, pages, nr);
+	if (ind == nr)
+		goto out;
+
 	rt_mutex_lock(&pool->lock);
 
 	while (ind < nr) {
@@ -317,12 +425,15 @@ int nvmap_page_pool_alloc_lots(struct nvmap_page_pool *pool,
 #endif /* NVMAP_CONFIG_PAGE_POOL_DEBUG */
 	}
 
+	nvmap_pp_mag_refill_locked(pool);
+
 	rt_mutex_unlock(&pool->lock);
 
 	/* Zero non-zeroed pages, if any */
 	if (non_zero_cnt)
 		nvmap_pp_zero_pages(&pages[non_zero_idx], non_zero_cnt);
 
+out:
 	pp_alloc_add(pool, ind);
 	pp_hit_add(pool, ind);
 	pp_miss_add(pool, nr - ind);
@@ -443,12 +554,15 @@ int nvmap_page_pool_fill_lots(struct nvmap_page_pool *pool,
 	int ret = 0;
 	int i;
 	u32 save_to_zero;
+	u32 used;
 
 	rt_mutex_lock(&pool->lock);
 
 	save_to_zero = pool->to_zero;
 
-	ret = min(nr, pool->max - pool->count - pool->to_zero - pool->under_zero);
+	used = pool->count + pool->to_zero + pool->under_zero +
+		atomic_read(&pool->mag_count);
+	ret = used < pool->max ? min(nr, pool->max - used) : 0;
 
 	for (i = 0; i < ret; i++) {
 		/* If page has additonal referecnces, Don't add it into
@@ -483,7 +597,8 @@ ulong nvmap_page_pool_get_unused_pages(void)
 	if (!nvmap_dev)
 		return 0;
 
-	total = nvmap_dev->pool.count + nvmap_dev->pool.to_zero;
+	total = nvmap_dev->pool.count + nvmap_dev->pool.to_zero +
+		atomic_read(&nvmap_dev->pool.mag_count);
 
 	return total;
 }
@@ -498,7 +613,8 @@ int nvmap_page_pool_clear(void)
 
 	rt_mutex_lock(&pool->lock);
 
-	(void)nvmap_page_pool_free_pages_locked(pool, pool->count + pool->to_zero);
+	(void)nvmap_page_pool_free_pages_locked(pool, pool->count + pool->to_zero +
+						atomic_read(&pool->mag_count));
 
 	/* For some reason, if an error occured... */
 	if (!list_empty(&pool->page_list) || !list_empty(&pool->zero_list)) {
@@ -684,6 +800,9 @@ int nvmap_page_pool_debugfs_init(struct dentry *nvmap_root)
 	debugfs_create_u64("total_big_page_allocs",
 			   S_IRUGO, pp_root,
 			   &nvmap_big_page_allocs);
+	debugfs_create_u64("total_huge_page_allocs",
+			   S_IRUGO, pp_root,
+			   &nvmap_huge_page_allocs);
 #endif /* CONFIG_ARM64_4K_PAGES */
 	debugfs_create_u64("total_page_allocs",
 			   S_IRUGO, pp_root,
@@ -711,9 +830,12 @@ int nvmap_page_pool_init(struct nvmap_device *dev)
 {
 	struct sysinfo info;
 	struct nvmap_page_pool *pool = &dev->pool;
+	int cpu;
 
 	memset(pool, 0x0, sizeof(*pool));
 	rt_mutex_init(&pool->lock);
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(&nvmap_pp_mags, cpu)->lock);
 	INIT_LIST_HEAD(&pool->page_list);
 	INIT_LIST_HEAD(&pool->zero_list);
 #ifdef CONFIG_ARM64_4K_PAGES
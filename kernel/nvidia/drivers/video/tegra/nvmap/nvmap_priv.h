@@ -149,6 +149,7 @@ void _nvmap_handle_free(struct nvmap_handle *h);
 /* holds max number of handles allocted per process at any time */
 extern u32 nvmap_max_handle_count;
 extern u64 nvmap_big_page_allocs;
+extern u64 nvmap_huge_page_allocs;
 extern u64 nvmap_total_page_allocs;
 
 extern bool nvmap_convert_iovmm_to_carveout;
@@ -263,6 +264,8 @@ struct nvmap_handle {
 	 * read-only.
 	 */
 	bool is_ro;
+	bool nc_mapped;		/* mapped by a non I/O coherent device */
+	bool maint_deferred;	/* CPU cache maintenance was skipped */
 };
 
 struct nvmap_handle_info {
@@ -307,6 +310,7 @@ struct nvmap_page_pool {
 	u32 max;        /* Max no. of pages in all lists. */
 	u32 to_zero;    /* Number of pages on the zero list */
 	u32 under_zero; /* Number of pages getting zeroed */
+	atomic_t mag_count; /* Zeroed pages held in the per-CPU magazines */
 #ifdef CONFIG_ARM64_4K_PAGES
 	u32 big_pg_sz;  /* big page size supported(64k, etc.) */
 	u32 big_page_count;   /* Number of zeroed big pages avaialble */
@@ -606,6 +610,7 @@ int __nvmap_map(struct nvmap_handle *h, struct vm_area_struct *vma);
 int __nvmap_do_cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
 			   unsigned long start, unsigned long end,
 			   unsigned int op, bool clean_only_dirty);
+void nvmap_handle_nc_map(struct nvmap_handle *h);
 struct nvmap_client *__nvmap_create_client(struct nvmap_device *dev,
 					   const char *name);
 int __nvmap_dmabuf_fd(struct nvmap_client *client,
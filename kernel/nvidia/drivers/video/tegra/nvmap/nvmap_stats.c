@@ -76,6 +76,8 @@ void nvmap_stats_init(struct dentry *nvmap_debug_root)
 		CREATE_DF(ucflush_done, nvmap_stats.stats[NS_UCFLUSH_DONE]);
 		CREATE_DF(kcflush_rq, nvmap_stats.stats[NS_KCFLUSH_RQ]);
 		CREATE_DF(kcflush_done, nvmap_stats.stats[NS_KCFLUSH_DONE]);
+		CREATE_DF(cflush_skip, nvmap_stats.stats[NS_CFLUSH_SKIP]);
+		CREATE_DF(cflush_ns, nvmap_stats.stats[NS_CFLUSH_NS]);
 		CREATE_DF(total_memory, nvmap_stats.stats[NS_TOTAL]);
 
 		debugfs_create_file("collect", S_IRUGO | S_IWUSR,
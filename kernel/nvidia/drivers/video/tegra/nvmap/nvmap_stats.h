@@ -27,6 +27,8 @@ enum nvmap_stats_t {
 	NS_UCFLUSH_DONE,
 	NS_KCFLUSH_RQ,
 	NS_KCFLUSH_DONE,
+	NS_CFLUSH_SKIP,
+	NS_CFLUSH_NS,
 	NS_TOTAL,
 	NS_NUM,
 };
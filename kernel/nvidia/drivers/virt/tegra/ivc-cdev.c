@@ -20,6 +20,8 @@
 #include <linux/device.h>
 #include <linux/slab.h>
 #include <linux/sched.h>
+#include <linux/sched/signal.h>
+#include <linux/ktime.h>
 
 #include <uapi/linux/tegra-ivc-dev.h>
 #include "tegra_hv.h"
@@ -47,6 +49,11 @@ struct ivc_dev {
 	struct mutex		file_lock;
 	/* Bool to store whether we received any ivc interrupt */
 	bool			ivc_intr_rcvd;
+	/*
+	 * How long poll() busy-checks the rx queue before sleeping, 0 to
+	 * sleep right away. The peer skips doorbells for data while we spin.
+	 */
+	unsigned int		poll_spin_us;
 };
 
 static dev_t ivc_dev;
@@ -154,6 +161,37 @@ static ssize_t ivc_dev_write(struct file *filp, const char __user *buf,
 	return -EPERM;
 }
 
+/*
+ * Spin for up to poll_spin_us waiting for data or an interrupt before the
+ * caller goes to sleep. Returns true if the caller should look at the queue.
+ */
+static bool ivc_dev_poll_spin(struct ivc_dev *ivcd, struct ivc *ivc)
+{
+	unsigned int spin_us = READ_ONCE(ivcd->poll_spin_us);
+	ktime_t deadline;
+	bool ready = false;
+
+	if (spin_us == 0)
+		return false;
+
+	deadline = ktime_add_us(ktime_get(), spin_us);
+	tegra_ivc_set_reader_active(ivc, true);
+
+	do {
+		if (tegra_ivc_can_read(ivc) || READ_ONCE(ivcd->ivc_intr_rcvd)) {
+			ready = true;
+			break;
+		}
+		cpu_relax();
+	} while (ktime_before(ktime_get(), deadline) && !need_resched() &&
+			!signal_pending(current));
+
+	tegra_ivc_set_reader_active(ivc, false);
+
+	/* frames that arrived while the flag was set were not notified */
+	return ready || tegra_ivc_can_read(ivc);
+}
+
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5, 10, 0)
 static unsigned int ivc_dev_poll(struct file *filp, poll_table *wait)
 #else
@@ -182,6 +220,10 @@ static __poll_t ivc_dev_poll(struct file *filp, poll_table *wait)
 	mutex_unlock(&ivcd->file_lock);
 	/* no exceptions */
 
+	if (mask == 0 && wait != NULL && wait->_qproc != NULL &&
+			ivc_dev_poll_spin(ivcd, ivc))
+		mask |= POLLIN | POLLRDNORM;
+
 	return mask;
 }
 
@@ -391,11 +433,34 @@ static ssize_t peer_show(struct device *dev,
 			? ivc->qd->peers[1] : ivc->qd->peers[0]);
 }
 
+static ssize_t poll_spin_us_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct ivc_dev *ivc = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", READ_ONCE(ivc->poll_spin_us));
+}
+
+static ssize_t poll_spin_us_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ivc_dev *ivc = dev_get_drvdata(dev);
+	unsigned int val;
+
+	if (kstrtouint(buf, 10, &val) != 0 || val > USEC_PER_MSEC)
+		return -EINVAL;
+
+	WRITE_ONCE(ivc->poll_spin_us, val);
+
+	return count;
+}
+
 static DEVICE_ATTR_RO(id);
 static DEVICE_ATTR_RO(frame_size);
 static DEVICE_ATTR_RO(nframes);
 static DEVICE_ATTR_RO(reserved);
 static DEVICE_ATTR_RO(peer);
+static DEVICE_ATTR_RW(poll_spin_us);
 
 static struct attribute *ivc_attrs[] = {
 	&dev_attr_id.attr,
@@ -403,6 +468,7 @@ static struct attribute *ivc_attrs[] = {
 	&dev_attr_nframes.attr,
 	&dev_attr_peer.attr,
 	&dev_attr_reserved.attr,
+	&dev_attr_poll_spin_us.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(ivc);
@@ -412,7 +478,7 @@ static uint32_t max_qid;
 static struct ivc_dev *ivc_dev_array;
 static struct class *ivc_class;
 
-static int __init add_ivc(int i)
+static int add_ivc(int i)
 {
 	const struct tegra_hv_queue_data *qd = &ivc_info_queue_array(info)[i];
 	struct ivc_dev *ivc = &ivc_dev_array[i];
@@ -451,7 +517,7 @@ static int __init add_ivc(int i)
 	return 0;
 }
 
-static int __init setup_ivc(void)
+static int setup_ivc(void)
 {
 	uint32_t i;
 	int result;
@@ -498,7 +564,7 @@ static int __init setup_ivc(void)
 	return 0;
 }
 
-static void __init cleanup_ivc(void)
+static void cleanup_ivc(void)
 {
 	uint32_t i;
 
@@ -526,19 +592,40 @@ static void __init cleanup_ivc(void)
 	}
 }
 
-static int __init ivc_init(void)
+/*
+ * Called from the initcall and again by tegra_hv_register_backend(), as a
+ * backend may only provide its queues after the initcalls have run.
+ */
+int ivc_cdev_setup(void)
 {
+	static DEFINE_MUTEX(setup_lock);
 	int result;
 
+	mutex_lock(&setup_lock);
+
+	if (ivc_dev_array) {
+		result = 0;
+		goto out;
+	}
+
 	info = tegra_hv_get_ivc_info();
-	if (IS_ERR(info))
-		return -ENODEV;
+	if (IS_ERR(info)) {
+		result = -ENODEV;
+		goto out;
+	}
 
 	result = setup_ivc();
 	if (result != 0)
 		cleanup_ivc();
 
+out:
+	mutex_unlock(&setup_lock);
 	return result;
 }
 
+static int __init ivc_init(void)
+{
+	return ivc_cdev_setup();
+}
+
 module_init(ivc_init);
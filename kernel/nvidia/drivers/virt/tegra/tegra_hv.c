@@ -107,6 +107,9 @@ struct tegra_hv_data {
 	struct class *hv_class;
 
 	struct device_node *dev;
+
+	/* non-NULL when the queues are not provided by the NVIDIA hypervisor */
+	const struct tegra_hv_backend *backend;
 };
 
 /*
@@ -136,6 +139,11 @@ static struct ivc_notify_info ivc_notify;
 static void ivc_raise_irq(struct ivc *ivc_channel)
 {
 	struct hv_ivc *ivc = container_of(ivc_channel, struct hv_ivc, ivc);
+
+	if (ivc->hvd->backend) {
+		ivc->hvd->backend->raise_irq(ivc->qd);
+		return;
+	}
 #ifdef SUPPORTS_TRAP_MSI_NOTIFICATION
 	if (WARN_ON(!ivc->cookie.notify_va))
 		return;
@@ -282,7 +290,10 @@ static int tegra_hv_add_ivc(struct tegra_hv_data *hvd,
 		return -EINVAL;
 	}
 
-	ivc->irq = of_irq_get(hvd->dev, index);
+	if (hvd->backend)
+		ivc->irq = hvd->backend->queue_irq(qd);
+	else
+		ivc->irq = of_irq_get(hvd->dev, index);
 	if (ivc->irq < 0) {
 		ERR("Unable to get irq for ivc%u\n", qd->id);
 		return ivc->irq;
@@ -295,7 +306,9 @@ static int tegra_hv_add_ivc(struct tegra_hv_data *hvd,
 	}
 
 #ifdef SUPPORTS_TRAP_MSI_NOTIFICATION
-	if (qd->msi_ipa != 0U) {
+	if (hvd->backend) {
+		/* notifications go through backend->raise_irq() */
+	} else if (qd->msi_ipa != 0U) {
 		if (WARN_ON(ivc_notify.msi_region_size == 0UL))
 			return -EINVAL;
 		if (WARN_ON(!(qd->msi_ipa >= ivc_notify.msi_region_base_ipa &&
@@ -360,7 +373,7 @@ static void tegra_hv_ivc_cleanup(struct tegra_hv_data *hvd)
 	hvd->ivc_devs = NULL;
 }
 
-static void __init tegra_hv_cleanup(struct tegra_hv_data *hvd)
+static void tegra_hv_cleanup(struct tegra_hv_data *hvd)
 {
 	/*
 	 * Destroying IVC channels in use is not supported. Once it's possible
@@ -385,10 +398,12 @@ static void __init tegra_hv_cleanup(struct tegra_hv_data *hvd)
 
 		kfree(hvd->guest_ivc_info);
 		hvd->guest_ivc_info = NULL;
+	}
 
+	/* a backend owns the info page it registered */
+	if (hvd->info && !hvd->backend)
 		iounmap((void __iomem *)hvd->info);
-		hvd->info = NULL;
-	}
+	hvd->info = NULL;
 
 	if (hvd->hv_class) {
 		class_destroy(hvd->hv_class);
@@ -406,13 +421,31 @@ static ssize_t vmid_show(struct class *class,
 }
 static CLASS_ATTR_RO(vmid);
 
+static int tegra_hv_setup_class(struct tegra_hv_data *hvd)
+{
+	int ret;
+
+	hvd->hv_class = class_create(THIS_MODULE, "tegra_hv");
+	if (IS_ERR(hvd->hv_class)) {
+		ERR("class_create() failed\n");
+		return PTR_ERR(hvd->hv_class);
+	}
+
+	ret = class_create_file(hvd->hv_class, &class_attr_vmid);
+	if (ret != 0) {
+		ERR("failed to create vmid file: %d\n", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+static int tegra_hv_setup_queues(struct tegra_hv_data *hvd);
+
 static int __init tegra_hv_setup(struct tegra_hv_data *hvd)
 {
-	const int intr_property_size = 3;
 	uint64_t info_page;
-	uint32_t i;
 	int ret;
-	uint32_t *interrupts_arr;
 
 	hvd->dev = of_find_compatible_node(NULL, NULL, "nvidia,tegra-hv");
 	if (!hvd->dev) {
@@ -426,17 +459,9 @@ static int __init tegra_hv_setup(struct tegra_hv_data *hvd)
 		return -ENODEV;
 	}
 
-	hvd->hv_class = class_create(THIS_MODULE, "tegra_hv");
-	if (IS_ERR(hvd->hv_class)) {
-		ERR("class_create() failed\n");
-		return PTR_ERR(hvd->hv_class);
-	}
-
-	ret = class_create_file(hvd->hv_class, &class_attr_vmid);
-	if (ret != 0) {
-		ERR("failed to create vmid file: %d\n", ret);
+	ret = tegra_hv_setup_class(hvd);
+	if (ret != 0)
 		return ret;
-	}
 
 	ret = hyp_read_ivc_info(&info_page);
 	if (ret != 0) {
@@ -503,6 +528,20 @@ static int __init tegra_hv_setup(struct tegra_hv_data *hvd)
 	}
 #endif
 
+	return tegra_hv_setup_queues(hvd);
+}
+
+/*
+ * Map the shared areas and instantiate the queues and mempools described by
+ * hvd->info, whichever provider it came from.
+ */
+static int tegra_hv_setup_queues(struct tegra_hv_data *hvd)
+{
+	const int intr_property_size = 3;
+	uint32_t i;
+	int ret;
+	uint32_t *interrupts_arr;
+
 	hvd->guest_ivc_info = kzalloc(hvd->info->nr_areas *
 			sizeof(*hvd->guest_ivc_info), GFP_KERNEL);
 	if (hvd->guest_ivc_info == NULL) {
@@ -524,6 +563,22 @@ static int __init tegra_hv_setup(struct tegra_hv_data *hvd)
 		hvd->guest_ivc_info[i].length = hvd->info->areas[i].size;
 	}
 
+	/*
+	 * Determine the largest queue id in order to allocate a queue id-
+	 * indexed array and device nodes. Backends hand out queue interrupts
+	 * themselves, so only the hypervisor node gets an interrupts property.
+	 */
+	hvd->max_qid = 0;
+	for (i = 0; i < hvd->info->nr_queues; i++) {
+		const struct tegra_hv_queue_data *qd =
+				&ivc_info_queue_array(hvd->info)[i];
+		if (qd->id > hvd->max_qid)
+			hvd->max_qid = qd->id;
+	}
+
+	if (hvd->backend)
+		goto add_queues;
+
 	/* Do not free this, of_add_property does not copy the structure */
 	interrupts_arr = kmalloc(hvd->info->nr_queues * sizeof(uint32_t)
 			* intr_property_size, GFP_KERNEL);
@@ -532,16 +587,10 @@ static int __init tegra_hv_setup(struct tegra_hv_data *hvd)
 		return -ENOMEM;
 	}
 
-	/*
-	 * Determine the largest queue id in order to allocate a queue id-
-	 * indexed array and device nodes, and create interrupts property
-	 */
-	hvd->max_qid = 0;
+	/* create interrupts property */
 	for (i = 0; i < hvd->info->nr_queues; i++) {
 		const struct tegra_hv_queue_data *qd =
 				&ivc_info_queue_array(hvd->info)[i];
-		if (qd->id > hvd->max_qid)
-			hvd->max_qid = qd->id;
 		/* 0 => SPI */
 		interrupts_arr[(i * intr_property_size)] = (__force uint32_t)cpu_to_be32(0);
 		interrupts_arr[(i * intr_property_size) + 1] =
@@ -560,6 +609,7 @@ static int __init tegra_hv_setup(struct tegra_hv_data *hvd)
 		return -EACCES;
 	}
 
+add_queues:
 	hvd->ivc_devs = kzalloc((hvd->max_qid + 1) * sizeof(*hvd->ivc_devs),
 			GFP_KERNEL);
 	if (hvd->ivc_devs == NULL) {
@@ -642,6 +692,73 @@ static int __init tegra_hv_init(void)
 	return 0;
 }
 
+/*
+ * Install queues and mempools that are not provided by the NVIDIA hypervisor,
+ * e.g. by tegra_hv_jailhouse.c. @info must stay valid for the lifetime of the
+ * system, since the tegra_hv APIs hand out pointers into it.
+ */
+int tegra_hv_register_backend(const struct ivc_info_page *info, int guestid,
+		const struct tegra_hv_backend *backend)
+{
+	static DEFINE_MUTEX(backend_lock);
+	struct tegra_hv_data *hvd;
+	int ret;
+
+	mutex_lock(&backend_lock);
+
+	if (tegra_hv_data) {
+		ERR("IVC queues already provided\n");
+		ret = -EBUSY;
+		goto out;
+	}
+
+	hvd = kzalloc(sizeof(*hvd), GFP_KERNEL);
+	if (!hvd) {
+		ERR("failed to allocate hvd\n");
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	hvd->info = info;
+	hvd->guestid = guestid;
+	hvd->backend = backend;
+
+	ret = tegra_hv_setup_class(hvd);
+	if (ret == 0)
+		ret = tegra_hv_setup_queues(hvd);
+	if (ret != 0) {
+		tegra_hv_cleanup(hvd);
+		kfree(hvd);
+		goto out;
+	}
+
+	/* see tegra_hv_init() */
+	smp_wmb();
+
+	tegra_hv_data = hvd;
+	INFO("initialized from backend\n");
+
+out:
+	mutex_unlock(&backend_lock);
+
+	if (ret != 0)
+		return ret;
+
+	/*
+	 * The character device front ends may well have run their initcalls
+	 * before the backend came up, bring them up now.
+	 */
+	ret = ivc_cdev_setup();
+	if (ret != 0)
+		ERR("ivc cdev setup failed: %d\n", ret);
+
+	ret = userspace_ivc_mempool_setup();
+	if (ret != 0)
+		ERR("ivc mempool setup failed: %d\n", ret);
+
+	return 0;
+}
+
 static int ivc_dump(struct hv_ivc *ivc)
 {
 	INFO("IVC#%d: IRQ=%d(%d) nframes=%d frame_size=%d offset=%d\n",
@@ -712,13 +829,7 @@ void tegra_hv_ivc_notify(struct tegra_hv_ivc_cookie *ivck)
 		return;
 
 	ivc = cookie_to_ivc_dev(ivck);
-#ifdef SUPPORTS_TRAP_MSI_NOTIFICATION
-	if (WARN_ON(!ivc->cookie.notify_va))
-		return;
-	*ivc->cookie.notify_va = ivc->qd->raise_irq;
-#else
-	hyp_raise_irq(ivc->qd->raise_irq, ivc->other_guestid);
-#endif
+	ivc_raise_irq(&ivc->ivc);
 }
 EXPORT_SYMBOL(tegra_hv_ivc_notify);
 
@@ -870,6 +981,42 @@ int tegra_hv_ivc_read_advance(struct tegra_hv_ivc_cookie *ivck)
 }
 EXPORT_SYMBOL(tegra_hv_ivc_read_advance);
 
+int tegra_hv_ivc_read_get_frames(struct tegra_hv_ivc_cookie *ivck,
+		void **frames, uint32_t max_frames)
+{
+	struct ivc *ivc = &cookie_to_ivc_dev(ivck)->ivc;
+
+	return tegra_ivc_read_get_frames(ivc, frames, max_frames);
+}
+EXPORT_SYMBOL(tegra_hv_ivc_read_get_frames);
+
+int tegra_hv_ivc_read_advance_frames(struct tegra_hv_ivc_cookie *ivck,
+		uint32_t count)
+{
+	struct ivc *ivc = &cookie_to_ivc_dev(ivck)->ivc;
+
+	return tegra_ivc_read_advance_frames(ivc, count);
+}
+EXPORT_SYMBOL(tegra_hv_ivc_read_advance_frames);
+
+int tegra_hv_ivc_write_get_frames(struct tegra_hv_ivc_cookie *ivck,
+		void **frames, uint32_t max_frames)
+{
+	struct ivc *ivc = &cookie_to_ivc_dev(ivck)->ivc;
+
+	return tegra_ivc_write_get_frames(ivc, frames, max_frames);
+}
+EXPORT_SYMBOL(tegra_hv_ivc_write_get_frames);
+
+int tegra_hv_ivc_write_advance_frames(struct tegra_hv_ivc_cookie *ivck,
+		uint32_t count)
+{
+	struct ivc *ivc = &cookie_to_ivc_dev(ivck)->ivc;
+
+	return tegra_ivc_write_advance_frames(ivc, count);
+}
+EXPORT_SYMBOL(tegra_hv_ivc_write_advance_frames);
+
 struct ivc *tegra_hv_ivc_convert_cookie(struct tegra_hv_ivc_cookie *ivck)
 {
 	return &cookie_to_ivc_dev(ivck)->ivc;
@@ -22,4 +22,19 @@
 const struct ivc_info_page *tegra_hv_get_ivc_info(void);
 int tegra_hv_get_vmid(void);
 
+/* Provider of IVC queues other than the NVIDIA hypervisor */
+struct tegra_hv_backend {
+	/* Linux irq raised when the peer notifies queue @qd */
+	int (*queue_irq)(const struct tegra_hv_queue_data *qd);
+	/* notify the peer of queue @qd */
+	void (*raise_irq)(const struct tegra_hv_queue_data *qd);
+};
+
+int tegra_hv_register_backend(const struct ivc_info_page *info, int guestid,
+		const struct tegra_hv_backend *backend);
+
+/* front ends that may be brought up after their initcalls have run */
+int ivc_cdev_setup(void);
+int userspace_ivc_mempool_setup(void);
+
 #endif /* __TEGRA_HV_H__ */
@@ -0,0 +1,538 @@
+/*
+ * Tegra HV IVC queues and mempools on top of Jailhouse ivshmem
+ *
+ * Copyright (C) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This file is licensed under the terms of the GNU General Public License
+ * version 2.  This program is licensed "as is" without any warranty of any
+ * kind, whether express or implied.
+ *
+ * Under Jailhouse there is no NVIDIA hypervisor to hand out the IVC info
+ * page. Instead each cell describes its links in the device tree:
+ *
+ *	tegra-hv-jailhouse {
+ *		compatible = "nvidia,tegra-hv-jailhouse";
+ *		nvidia,guest-id = <0>;
+ *
+ *		link@8 {
+ *			reg = <0x8>;		(ivshmem PCI bus/devfn)
+ *			nvidia,peer-guest-id = <1>;
+ *
+ *			queue@0 {
+ *				reg = <0>;	(IVC queue id)
+ *				nvidia,offset = <0x0>;
+ *				nvidia,frame-count = <16>;
+ *				nvidia,frame-size = <128>;
+ *				nvidia,vector = <1>;
+ *			};
+ *
+ *			mempool@0 {
+ *				reg = <0>;	(mempool id)
+ *				nvidia,offset = <0x10000>;
+ *				nvidia,size = <0x100000>;
+ *			};
+ *		};
+ *	};
+ *
+ * The queues and mempools of a link live in the read/write section of its
+ * ivshmem device, at the same offsets on both ends. Each queue is signalled
+ * through its own MSI-X vector with the ivshmem doorbell. Once every link
+ * has probed, the resulting info page is handed to tegra_hv, so tegra_ivc
+ * users, ivc-cdev and the mempool devices work unchanged.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/io.h>
+#include <linux/of.h>
+#include <linux/pci.h>
+#include <linux/ivshmem.h>
+
+#include <linux/tegra-ivc.h>
+#include <linux/tegra-ivc-instance.h>
+
+#include "tegra_hv.h"
+
+#define DRV_NAME "tegra_hv_jailhouse"
+
+#define ERR(...) pr_err("tegra_hv_jailhouse: " __VA_ARGS__)
+#define INFO(...) pr_info("tegra_hv_jailhouse: " __VA_ARGS__)
+
+/* ivshmem protocol carrying Tegra IVC queues in the read/write section */
+#define IVSHM_PROTO_TEGRA_IVC		0x4000
+
+struct hv_jh_link {
+	struct device_node *np;
+	struct pci_dev *pdev;
+	struct ivshm_regs __iomem *regs;
+	uint32_t peer_id;
+
+	phys_addr_t rw_pa;
+	resource_size_t rw_size;
+};
+
+struct hv_jh_queue {
+	uint32_t id;
+	struct hv_jh_link *link;
+	uint32_t vector;
+};
+
+struct hv_jh_data {
+	struct device_node *np;
+	int guestid;
+
+	struct hv_jh_link *links;
+	uint32_t nr_links;
+	uint32_t nr_probed;
+
+	struct hv_jh_queue *queues;
+	uint32_t nr_queues;
+	uint32_t nr_mempools;
+
+	struct ivc_info_page *info;
+	bool registered;
+};
+
+static struct hv_jh_data hv_jh;
+static DEFINE_MUTEX(hv_jh_lock);
+
+static struct hv_jh_queue *hv_jh_queue_by_id(uint32_t id)
+{
+	uint32_t i;
+
+	for (i = 0; i < hv_jh.nr_queues; i++) {
+		if (hv_jh.queues[i].id == id)
+			return &hv_jh.queues[i];
+	}
+
+	return NULL;
+}
+
+static int hv_jh_queue_irq(const struct tegra_hv_queue_data *qd)
+{
+	struct hv_jh_queue *q = hv_jh_queue_by_id(qd->id);
+
+	if (!q)
+		return -ENODEV;
+
+	return pci_irq_vector(q->link->pdev, q->vector);
+}
+
+static void hv_jh_raise_irq(const struct tegra_hv_queue_data *qd)
+{
+	struct hv_jh_link *link = hv_jh_queue_by_id(qd->id)->link;
+
+	/* raise_irq carries the vector, see hv_jh_build_info() */
+	writel(qd->raise_irq | (link->peer_id << 16), &link->regs->doorbell);
+}
+
+static const struct tegra_hv_backend hv_jh_backend = {
+	.queue_irq = hv_jh_queue_irq,
+	.raise_irq = hv_jh_raise_irq,
+};
+
+static struct hv_jh_link *hv_jh_link_by_pdev(struct pci_dev *pdev)
+{
+	uint32_t i;
+
+	for (i = 0; i < hv_jh.nr_links; i++) {
+		uint32_t bdf;
+
+		if (of_property_read_u32(hv_jh.links[i].np, "reg", &bdf))
+			continue;
+		if (bdf == pci_dev_id(pdev))
+			return &hv_jh.links[i];
+	}
+
+	return NULL;
+}
+
+static int hv_jh_parse(void)
+{
+	struct device_node *np, *child, *sub;
+	uint32_t i = 0;
+
+	np = of_find_compatible_node(NULL, NULL, "nvidia,tegra-hv-jailhouse");
+	if (!np)
+		return -ENODEV;
+
+	if (of_property_read_u32(np, "nvidia,guest-id", &hv_jh.guestid)) {
+		ERR("missing nvidia,guest-id\n");
+		of_node_put(np);
+		return -EINVAL;
+	}
+
+	hv_jh.np = np;
+	hv_jh.nr_links = of_get_available_child_count(np);
+	if (hv_jh.nr_links == 0)
+		return -ENODEV;
+
+	hv_jh.links = kcalloc(hv_jh.nr_links, sizeof(*hv_jh.links),
+			GFP_KERNEL);
+	if (!hv_jh.links)
+		return -ENOMEM;
+
+	for_each_available_child_of_node(np, child) {
+		hv_jh.links[i++].np = of_node_get(child);
+
+		for_each_available_child_of_node(child, sub) {
+			if (of_node_name_eq(sub, "queue"))
+				hv_jh.nr_queues++;
+			else if (of_node_name_eq(sub, "mempool"))
+				hv_jh.nr_mempools++;
+		}
+	}
+
+	hv_jh.queues = kcalloc(hv_jh.nr_queues, sizeof(*hv_jh.queues),
+			GFP_KERNEL);
+	if (!hv_jh.queues)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static int hv_jh_read_region(struct device_node *np, const char *name,
+		struct hv_jh_link *link, uint32_t size, uint32_t *offset)
+{
+	if (of_property_read_u32(np, name, offset)) {
+		ERR("%pOF: missing %s\n", np, name);
+		return -EINVAL;
+	}
+
+	if ((uint64_t)*offset + size > link->rw_size) {
+		ERR("%pOF: %x+%x outside the %pa R/W section\n", np,
+				*offset, size, &link->rw_size);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* Lay out an info page the way the NVIDIA hypervisor would provide it. */
+static int hv_jh_build_info(void)
+{
+	struct tegra_hv_queue_data *qd;
+	struct ivc_mempool *mpd;
+	struct device_node *sub;
+	uint32_t i, q = 0, m = 0;
+	size_t len;
+	int ret;
+
+	hv_jh.info = kzalloc(IVC_INFO_PAGE_SIZE, GFP_KERNEL);
+	if (!hv_jh.info)
+		return -ENOMEM;
+
+	hv_jh.info->nr_areas = hv_jh.nr_links;
+	hv_jh.info->nr_queues = hv_jh.nr_queues;
+	hv_jh.info->nr_mempools = hv_jh.nr_mempools;
+
+	len = (uintptr_t)&ivc_info_mempool_array(hv_jh.info)[hv_jh.nr_mempools] -
+		(uintptr_t)hv_jh.info;
+	if (len > IVC_INFO_PAGE_SIZE) {
+		ERR("%u links, %u queues and %u mempools do not fit\n",
+				hv_jh.nr_links, hv_jh.nr_queues,
+				hv_jh.nr_mempools);
+		return -E2BIG;
+	}
+
+	qd = ivc_info_queue_array(hv_jh.info);
+	mpd = ivc_info_mempool_array(hv_jh.info);
+
+	for (i = 0; i < hv_jh.nr_links; i++) {
+		struct hv_jh_link *link = &hv_jh.links[i];
+		uint32_t peer;
+
+		if (of_property_read_u32(link->np, "nvidia,peer-guest-id",
+					&peer)) {
+			ERR("%pOF: missing nvidia,peer-guest-id\n", link->np);
+			return -EINVAL;
+		}
+
+		hv_jh.info->areas[i].guest = peer;
+		hv_jh.info->areas[i].pa = link->rw_pa;
+		hv_jh.info->areas[i].size = link->rw_size;
+
+		for_each_available_child_of_node(link->np, sub) {
+			uint32_t id, offset, nframes, frame_size, vector, size;
+
+			if (of_property_read_u32(sub, "reg", &id)) {
+				ERR("%pOF: missing reg\n", sub);
+				ret = -EINVAL;
+				goto put;
+			}
+
+			if (of_node_name_eq(sub, "mempool")) {
+				if (of_property_read_u32(sub, "nvidia,size",
+							&size)) {
+					ERR("%pOF: missing nvidia,size\n", sub);
+					ret = -EINVAL;
+					goto put;
+				}
+				ret = hv_jh_read_region(sub, "nvidia,offset",
+						link, size, &offset);
+				if (ret)
+					goto put;
+
+				mpd[m].id = id;
+				mpd[m].pa = link->rw_pa + offset;
+				mpd[m].size = size;
+				mpd[m].peer_vmid = peer;
+				m++;
+				continue;
+			}
+
+			if (!of_node_name_eq(sub, "queue"))
+				continue;
+
+			if (of_property_read_u32(sub, "nvidia,frame-count",
+						&nframes) ||
+			    of_property_read_u32(sub, "nvidia,frame-size",
+						&frame_size) ||
+			    of_property_read_u32(sub, "nvidia,vector",
+						&vector)) {
+				ERR("%pOF: incomplete queue\n", sub);
+				ret = -EINVAL;
+				goto put;
+			}
+
+			size = tegra_ivc_total_queue_size(nframes * frame_size);
+			/* one ring per direction, see tegra_hv_add_ivc() */
+			ret = hv_jh_read_region(sub, "nvidia,offset", link,
+					size * 2, &offset);
+			if (ret)
+				goto put;
+
+			if (vector >= pci_msix_vec_count(link->pdev)) {
+				ERR("%pOF: vector %u not provided by %s\n",
+						sub, vector,
+						pci_name(link->pdev));
+				ret = -EINVAL;
+				goto put;
+			}
+
+			qd[q].id = id;
+			qd[q].peers[0] = hv_jh.guestid;
+			qd[q].peers[1] = peer;
+			qd[q].offset = offset;
+			qd[q].size = size;
+			qd[q].nframes = nframes;
+			qd[q].frame_size = frame_size;
+			qd[q].raise_irq = vector;
+
+			hv_jh.queues[q].id = id;
+			hv_jh.queues[q].link = link;
+			hv_jh.queues[q].vector = vector;
+			q++;
+		}
+	}
+
+	return 0;
+
+put:
+	of_node_put(sub);
+	return ret;
+}
+
+static int hv_jh_publish(void)
+{
+	int ret;
+
+	ret = hv_jh_build_info();
+	if (ret == 0)
+		ret = tegra_hv_register_backend(hv_jh.info, hv_jh.guestid,
+				&hv_jh_backend);
+	if (ret != 0) {
+		ERR("failed to provide IVC queues: %d\n", ret);
+		kfree(hv_jh.info);
+		hv_jh.info = NULL;
+		return ret;
+	}
+
+	hv_jh.registered = true;
+	INFO("%u queues, %u mempools over %u links\n", hv_jh.nr_queues,
+			hv_jh.nr_mempools, hv_jh.nr_links);
+
+	return 0;
+}
+
+static u64 hv_jh_config_qword(struct pci_dev *pdev, unsigned int pos)
+{
+	u32 lo, hi;
+
+	pci_read_config_dword(pdev, pos, &lo);
+	pci_read_config_dword(pdev, pos + 4, &hi);
+	return lo | ((u64)hi << 32);
+}
+
+static int hv_jh_probe(struct pci_dev *pdev, const struct pci_device_id *id)
+{
+	struct hv_jh_link *link;
+	phys_addr_t shmem_pa;
+	int vendor_cap, nvec;
+	u32 state_tab_sz;
+	int ret;
+
+	mutex_lock(&hv_jh_lock);
+
+	link = hv_jh_link_by_pdev(pdev);
+	if (!link) {
+		dev_info(&pdev->dev, "not described by %pOF\n", hv_jh.np);
+		ret = -ENODEV;
+		goto out;
+	}
+
+	if (hv_jh.registered) {
+		/* the queues of a link cannot come back once published */
+		dev_err(&pdev->dev, "link reappeared after registration\n");
+		ret = -EBUSY;
+		goto out;
+	}
+
+	ret = pci_enable_device(pdev);
+	if (ret) {
+		dev_err(&pdev->dev, "pci_enable_device: %d\n", ret);
+		goto out;
+	}
+
+	ret = pci_request_region(pdev, 0, DRV_NAME);
+	if (ret)
+		goto disable;
+
+	link->regs = pci_iomap(pdev, 0, 0);
+	if (!link->regs) {
+		ret = -ENOMEM;
+		goto release;
+	}
+
+	if (readl(&link->regs->max_peers) != 2) {
+		dev_err(&pdev->dev, "only 2 peers supported\n");
+		ret = -EINVAL;
+		goto unmap;
+	}
+	link->peer_id = !readl(&link->regs->id);
+
+	vendor_cap = pci_find_capability(pdev, PCI_CAP_ID_VNDR);
+	if (vendor_cap <= 0) {
+		dev_err(&pdev->dev, "missing vendor capability\n");
+		ret = -EINVAL;
+		goto unmap;
+	}
+
+	if (pci_resource_len(pdev, 2) > 0)
+		shmem_pa = pci_resource_start(pdev, 2);
+	else
+		shmem_pa = hv_jh_config_qword(pdev,
+				vendor_cap + IVSHM_CFG_ADDRESS);
+
+	pci_read_config_dword(pdev, vendor_cap + IVSHM_CFG_STATE_TAB_SZ,
+			&state_tab_sz);
+	link->rw_pa = shmem_pa + state_tab_sz;
+	link->rw_size = hv_jh_config_qword(pdev,
+			vendor_cap + IVSHM_CFG_RW_SECTION_SZ);
+	if (link->rw_size == 0) {
+		dev_err(&pdev->dev, "missing R/W section\n");
+		ret = -EINVAL;
+		goto unmap;
+	}
+
+	nvec = pci_msix_vec_count(pdev);
+	if (nvec <= 0) {
+		dev_err(&pdev->dev, "MSI-X is required\n");
+		ret = -EINVAL;
+		goto unmap;
+	}
+
+	ret = pci_alloc_irq_vectors(pdev, nvec, nvec, PCI_IRQ_MSIX);
+	if (ret < 0)
+		goto unmap;
+
+	pci_set_master(pdev);
+	writel(IVSHM_INT_ENABLE, &link->regs->int_control);
+
+	link->pdev = pdev;
+	dev_info(&pdev->dev, "R/W section at %pa, size %pa, %d vectors\n",
+			&link->rw_pa, &link->rw_size, nvec);
+
+	if (++hv_jh.nr_probed == hv_jh.nr_links)
+		hv_jh_publish();
+
+	ret = 0;
+	goto out;
+
+unmap:
+	pci_iounmap(pdev, link->regs);
+	link->regs = NULL;
+release:
+	pci_release_region(pdev, 0);
+disable:
+	pci_disable_device(pdev);
+out:
+	mutex_unlock(&hv_jh_lock);
+	return ret;
+}
+
+static void hv_jh_remove(struct pci_dev *pdev)
+{
+	struct hv_jh_link *link;
+
+	mutex_lock(&hv_jh_lock);
+
+	link = hv_jh_link_by_pdev(pdev);
+	if (!link || link->pdev != pdev)
+		goto out;
+
+	/*
+	 * Destroying IVC channels in use is not supported by tegra_hv, so the
+	 * mapping and vectors of a published link have to stay around.
+	 */
+	if (hv_jh.registered) {
+		dev_err(&pdev->dev, "IVC queues still in use\n");
+		goto out;
+	}
+
+	writel(0, &link->regs->int_control);
+	pci_free_irq_vectors(pdev);
+	pci_iounmap(pdev, link->regs);
+	link->regs = NULL;
+	link->pdev = NULL;
+	pci_release_region(pdev, 0);
+	pci_disable_device(pdev);
+	hv_jh.nr_probed--;
+
+out:
+	mutex_unlock(&hv_jh_lock);
+}
+
+static const struct pci_device_id hv_jh_id_table[] = {
+	{ PCI_DEVICE(PCI_VENDOR_ID_SIEMENS, PCI_DEVICE_ID_IVSHMEM),
+	  (PCI_CLASS_OTHERS << 16) | IVSHM_PROTO_TEGRA_IVC, 0xffffff },
+	{ 0 }
+};
+MODULE_DEVICE_TABLE(pci, hv_jh_id_table);
+
+static struct pci_driver hv_jh_driver = {
+	.name		= DRV_NAME,
+	.id_table	= hv_jh_id_table,
+	.probe		= hv_jh_probe,
+	.remove		= hv_jh_remove,
+};
+
+static int __init tegra_hv_jailhouse_init(void)
+{
+	int ret;
+
+	/* the NVIDIA hypervisor provides the queues itself */
+	if (is_tegra_hypervisor_mode())
+		return -ENODEV;
+
+	ret = hv_jh_parse();
+	if (ret != 0)
+		return ret;
+
+	return pci_register_driver(&hv_jh_driver);
+}
+device_initcall(tegra_hv_jailhouse_init);
+
+MODULE_LICENSE("GPL");
@@ -0,0 +1,786 @@
+/*
+ * Clock, reset and power domain proxy between Jailhouse cells
+ *
+ * Copyright (C) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This file is licensed under the terms of the GNU General Public License
+ * version 2.  This program is licensed "as is" without any warranty of any
+ * kind, whether express or implied.
+ *
+ * A device passed through to a non-root cell (GPU, DLA) keeps its MMIO,
+ * interrupts and SMMU stream IDs in the cell config, but its clocks, resets
+ * and power domain are owned by BPMP, which only the root cell talks to.
+ * This driver forwards them over a tegra_hv IVC queue.
+ *
+ * In the root cell, the server node lists the real resources:
+ *
+ *	gpu-pm-proxy {
+ *		compatible = "nvidia,tegra-hv-pm-proxy-server";
+ *		ivc_queue = <&tegra_hv 4>;
+ *		clocks = <&bpmp TEGRA234_CLK_GPUSYS>, ...;
+ *		resets = <&bpmp TEGRA234_RESET_GPU>;
+ *		power-domains = <&bpmp TEGRA234_POWER_DOMAIN_GPU>;
+ *	};
+ *
+ * In the cell, the client node provides them again, indexed in the order
+ * of the server's clocks and resets properties:
+ *
+ *	gpu_proxy: gpu-pm-proxy {
+ *		compatible = "nvidia,tegra-hv-pm-proxy";
+ *		ivc_queue = <&tegra_hv 4>;
+ *		#clock-cells = <1>;
+ *		#reset-cells = <1>;
+ *		#power-domain-cells = <0>;
+ *		nvidia,num-clocks = <4>;
+ *		nvidia,num-resets = <1>;
+ *	};
+ *
+ * and the device uses clocks = <&gpu_proxy 0>, ..., resets = <&gpu_proxy 0>
+ * and power-domains = <&gpu_proxy>, so its driver is unchanged. Requests
+ * are synchronous; the server answers each one with its status.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/interrupt.h>
+#include <linux/workqueue.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/pm_runtime.h>
+#include <linux/pm_domain.h>
+#include <linux/clk.h>
+#include <linux/clk-provider.h>
+#include <linux/reset.h>
+#include <linux/reset-controller.h>
+
+#include <linux/tegra-ivc.h>
+
+#define DRV_NAME "tegra_hv_pm_proxy"
+
+#define PM_PROXY_CLK_PREPARE		1
+#define PM_PROXY_CLK_UNPREPARE		2
+#define PM_PROXY_CLK_SET_RATE		3
+#define PM_PROXY_CLK_GET_RATE		4
+#define PM_PROXY_CLK_ROUND_RATE		5
+#define PM_PROXY_RST_ASSERT		6
+#define PM_PROXY_RST_DEASSERT		7
+#define PM_PROXY_RST_RESET		8
+#define PM_PROXY_PD_ON			9
+#define PM_PROXY_PD_OFF			10
+
+/* Upper bound for BPMP to handle a request, plus the root cell latency */
+#define PM_PROXY_TIMEOUT		msecs_to_jiffies(1000)
+
+#define PM_PROXY_MAX_CLKS		16
+#define PM_PROXY_MAX_RESETS		16
+
+struct tegra_hv_pm_proxy_msg {
+	uint32_t cmd;
+	uint32_t id;
+	uint64_t rate;
+	int32_t status;
+	uint32_t seq;
+};
+
+static struct tegra_hv_ivc_cookie *pm_proxy_reserve(struct device *dev)
+{
+	struct device_node *dn = dev->of_node;
+	struct tegra_hv_ivc_cookie *ivck;
+	struct device_node *hv_dn;
+	u32 queue;
+	int err;
+
+	hv_dn = of_parse_phandle(dn, "ivc_queue", 0);
+	if (!hv_dn) {
+		dev_err(dev, "failed to parse phandle of ivc prop\n");
+		return ERR_PTR(-EINVAL);
+	}
+
+	err = of_property_read_u32_index(dn, "ivc_queue", 1, &queue);
+	if (err) {
+		dev_err(dev, "failed to read IVC property ID\n");
+		of_node_put(hv_dn);
+		return ERR_PTR(-EINVAL);
+	}
+
+	/* -EPROBE_DEFER until the ivshmem backend provides the queues */
+	ivck = tegra_hv_ivc_reserve(hv_dn, queue, NULL);
+	of_node_put(hv_dn);
+	if (IS_ERR_OR_NULL(ivck))
+		return ivck ? ivck : ERR_PTR(-EINVAL);
+
+	if (ivck->frame_size < sizeof(struct tegra_hv_pm_proxy_msg)) {
+		dev_err(dev, "ivc frame size %d too small\n", ivck->frame_size);
+		tegra_hv_ivc_unreserve(ivck);
+		return ERR_PTR(-EINVAL);
+	}
+
+	return ivck;
+}
+
+/*
+ * Server, in the root cell
+ */
+
+struct pm_proxy_server {
+	struct device *dev;
+	struct tegra_hv_ivc_cookie *ivck;
+	struct work_struct rx_work;
+	struct mutex lock;
+	unsigned int num_clks;
+	struct clk *clks[PM_PROXY_MAX_CLKS];
+	bool prepared[PM_PROXY_MAX_CLKS];
+	unsigned int num_resets;
+	struct reset_control *resets[PM_PROXY_MAX_RESETS];
+	bool powered;
+};
+
+static int pm_proxy_server_handle(struct pm_proxy_server *srv,
+				  struct tegra_hv_pm_proxy_msg *msg)
+{
+	bool is_clk = msg->cmd <= PM_PROXY_CLK_ROUND_RATE;
+	bool is_rst = !is_clk && msg->cmd <= PM_PROXY_RST_RESET;
+	struct clk *clk = NULL;
+	long rate;
+	int err;
+
+	if (is_clk) {
+		if (msg->id >= srv->num_clks)
+			return -EINVAL;
+		clk = srv->clks[msg->id];
+	} else if (is_rst && msg->id >= srv->num_resets) {
+		return -EINVAL;
+	}
+
+	switch (msg->cmd) {
+	case PM_PROXY_CLK_PREPARE:
+		if (srv->prepared[msg->id])
+			return 0;
+		err = clk_prepare_enable(clk);
+		if (!err)
+			srv->prepared[msg->id] = true;
+		return err;
+	case PM_PROXY_CLK_UNPREPARE:
+		if (srv->prepared[msg->id]) {
+			clk_disable_unprepare(clk);
+			srv->prepared[msg->id] = false;
+		}
+		return 0;
+	case PM_PROXY_CLK_SET_RATE:
+		err = clk_set_rate(clk, msg->rate);
+		msg->rate = clk_get_rate(clk);
+		return err;
+	case PM_PROXY_CLK_GET_RATE:
+		msg->rate = clk_get_rate(clk);
+		return 0;
+	case PM_PROXY_CLK_ROUND_RATE:
+		rate = clk_round_rate(clk, msg->rate);
+		if (rate < 0)
+			return rate;
+		msg->rate = rate;
+		return 0;
+	case PM_PROXY_RST_ASSERT:
+		return reset_control_assert(srv->resets[msg->id]);
+	case PM_PROXY_RST_DEASSERT:
+		return reset_control_deassert(srv->resets[msg->id]);
+	case PM_PROXY_RST_RESET:
+		return reset_control_reset(srv->resets[msg->id]);
+	case PM_PROXY_PD_ON:
+		if (srv->powered)
+			return 0;
+		err = pm_runtime_get_sync(srv->dev);
+		if (err < 0) {
+			pm_runtime_put_noidle(srv->dev);
+			return err;
+		}
+		srv->powered = true;
+		return 0;
+	case PM_PROXY_PD_OFF:
+		if (srv->powered) {
+			pm_runtime_put_sync(srv->dev);
+			srv->powered = false;
+		}
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static void pm_proxy_server_rx_work(struct work_struct *work)
+{
+	struct pm_proxy_server *srv =
+		container_of(work, struct pm_proxy_server, rx_work);
+	struct tegra_hv_pm_proxy_msg msg;
+
+	/* wait for the channel reset handshake with the cell */
+	if (tegra_hv_ivc_channel_notified(srv->ivck) != 0)
+		return;
+
+	while (tegra_hv_ivc_can_read(srv->ivck)) {
+		if (tegra_hv_ivc_read(srv->ivck, &msg, sizeof(msg)) !=
+		    sizeof(msg)) {
+			dev_err(srv->dev, "ivc read failed\n");
+			break;
+		}
+
+		mutex_lock(&srv->lock);
+		msg.status = pm_proxy_server_handle(srv, &msg);
+		mutex_unlock(&srv->lock);
+
+		if (!tegra_hv_ivc_can_write(srv->ivck)) {
+			dev_warn_ratelimited(srv->dev,
+					     "ivc queue full, reply dropped\n");
+			continue;
+		}
+		tegra_hv_ivc_write(srv->ivck, &msg, sizeof(msg));
+	}
+}
+
+static irqreturn_t pm_proxy_server_isr(int irq, void *dev_id)
+{
+	struct pm_proxy_server *srv = dev_id;
+
+	/* keep the request handling off the cpus given to cells */
+	queue_work(system_unbound_wq, &srv->rx_work);
+
+	return IRQ_HANDLED;
+}
+
+/* Drop everything the cell still holds */
+static void pm_proxy_server_release(struct pm_proxy_server *srv)
+{
+	unsigned int i;
+
+	mutex_lock(&srv->lock);
+	for (i = 0; i < srv->num_clks; i++) {
+		if (srv->prepared[i])
+			clk_disable_unprepare(srv->clks[i]);
+		srv->prepared[i] = false;
+	}
+	if (srv->powered)
+		pm_runtime_put_sync(srv->dev);
+	srv->powered = false;
+	mutex_unlock(&srv->lock);
+}
+
+static void pm_proxy_server_put(struct pm_proxy_server *srv)
+{
+	unsigned int i;
+
+	for (i = 0; i < srv->num_clks; i++)
+		clk_put(srv->clks[i]);
+	for (i = 0; i < srv->num_resets; i++)
+		reset_control_put(srv->resets[i]);
+}
+
+static int pm_proxy_server_probe(struct platform_device *pdev)
+{
+	struct device_node *dn = pdev->dev.of_node;
+	struct pm_proxy_server *srv;
+	int n, err;
+
+	srv = devm_kzalloc(&pdev->dev, sizeof(*srv), GFP_KERNEL);
+	if (!srv)
+		return -ENOMEM;
+
+	srv->dev = &pdev->dev;
+	mutex_init(&srv->lock);
+	INIT_WORK(&srv->rx_work, pm_proxy_server_rx_work);
+
+	n = of_count_phandle_with_args(dn, "clocks", "#clock-cells");
+	if (n > PM_PROXY_MAX_CLKS) {
+		dev_err(&pdev->dev, "%d clocks, at most %d supported\n", n,
+			PM_PROXY_MAX_CLKS);
+		return -EINVAL;
+	}
+	for (; n > 0 && srv->num_clks < n; srv->num_clks++) {
+		struct clk *clk = of_clk_get(dn, srv->num_clks);
+
+		if (IS_ERR(clk)) {
+			err = PTR_ERR(clk);
+			goto err_put;
+		}
+		srv->clks[srv->num_clks] = clk;
+	}
+
+	n = of_count_phandle_with_args(dn, "resets", "#reset-cells");
+	if (n > PM_PROXY_MAX_RESETS) {
+		dev_err(&pdev->dev, "%d resets, at most %d supported\n", n,
+			PM_PROXY_MAX_RESETS);
+		err = -EINVAL;
+		goto err_put;
+	}
+	for (; n > 0 && srv->num_resets < n; srv->num_resets++) {
+		struct reset_control *rst =
+			of_reset_control_get_exclusive_by_index(dn,
+							srv->num_resets);
+
+		if (IS_ERR(rst)) {
+			err = PTR_ERR(rst);
+			goto err_put;
+		}
+		srv->resets[srv->num_resets] = rst;
+	}
+
+	srv->ivck = pm_proxy_reserve(&pdev->dev);
+	if (IS_ERR(srv->ivck)) {
+		err = PTR_ERR(srv->ivck);
+		goto err_put;
+	}
+
+	/* the power domain, if any, follows this device */
+	pm_runtime_enable(&pdev->dev);
+
+	platform_set_drvdata(pdev, srv);
+
+	err = request_irq(srv->ivck->irq, pm_proxy_server_isr, 0,
+			  dev_name(&pdev->dev), srv);
+	if (err)
+		goto err_unreserve;
+
+	/* set ivc channel to invalid state */
+	tegra_hv_ivc_channel_reset(srv->ivck);
+
+	dev_info(&pdev->dev, "serving %u clocks, %u resets\n", srv->num_clks,
+		 srv->num_resets);
+
+	return 0;
+
+err_unreserve:
+	pm_runtime_disable(&pdev->dev);
+	tegra_hv_ivc_unreserve(srv->ivck);
+err_put:
+	pm_proxy_server_put(srv);
+	return err;
+}
+
+static int pm_proxy_server_remove(struct platform_device *pdev)
+{
+	struct pm_proxy_server *srv = platform_get_drvdata(pdev);
+
+	free_irq(srv->ivck->irq, srv);
+	cancel_work_sync(&srv->rx_work);
+	pm_proxy_server_release(srv);
+	pm_runtime_disable(&pdev->dev);
+	tegra_hv_ivc_unreserve(srv->ivck);
+	pm_proxy_server_put(srv);
+
+	return 0;
+}
+
+/*
+ * Client, in the cell owning the device
+ */
+
+struct pm_proxy_client;
+
+struct pm_proxy_clk {
+	struct clk_hw hw;
+	struct pm_proxy_client *client;
+	u32 id;
+};
+
+#define to_pm_proxy_clk(_hw) container_of(_hw, struct pm_proxy_clk, hw)
+
+struct pm_proxy_client {
+	struct device *dev;
+	struct tegra_hv_ivc_cookie *ivck;
+	struct mutex lock;
+	wait_queue_head_t wq;
+	u32 seq;
+	unsigned int num_clks;
+	struct pm_proxy_clk *clks;
+	struct reset_controller_dev rcdev;
+	struct generic_pm_domain genpd;
+	bool has_genpd;
+};
+
+/* Consume replies until the one for seq shows up */
+static bool pm_proxy_client_reply(struct pm_proxy_client *client,
+				  struct tegra_hv_pm_proxy_msg *msg, u32 seq)
+{
+	while (tegra_hv_ivc_can_read(client->ivck)) {
+		if (tegra_hv_ivc_read(client->ivck, msg, sizeof(*msg)) !=
+		    sizeof(*msg))
+			return false;
+		if (msg->seq == seq)
+			return true;
+	}
+
+	return false;
+}
+
+static int pm_proxy_call(struct pm_proxy_client *client, u32 cmd, u32 id,
+			 u64 *rate)
+{
+	struct tegra_hv_pm_proxy_msg msg = {
+		.cmd = cmd,
+		.id = id,
+		.rate = rate ? *rate : 0,
+	};
+	long left;
+	int err;
+
+	mutex_lock(&client->lock);
+
+	left = wait_event_timeout(client->wq,
+			tegra_hv_ivc_channel_notified(client->ivck) == 0,
+			PM_PROXY_TIMEOUT);
+	if (!left) {
+		err = -ETIMEDOUT;
+		goto out;
+	}
+
+	msg.seq = ++client->seq;
+	if (tegra_hv_ivc_write(client->ivck, &msg, sizeof(msg)) !=
+	    sizeof(msg)) {
+		err = -EIO;
+		goto out;
+	}
+
+	left = wait_event_timeout(client->wq,
+			pm_proxy_client_reply(client, &msg, client->seq),
+			PM_PROXY_TIMEOUT);
+	if (!left) {
+		dev_err_ratelimited(client->dev, "request %u/%u timed out\n",
+				    cmd, id);
+		err = -ETIMEDOUT;
+		goto out;
+	}
+
+	err = msg.status;
+	if (rate)
+		*rate = msg.rate;
+out:
+	mutex_unlock(&client->lock);
+	return err;
+}
+
+static irqreturn_t pm_proxy_client_isr(int irq, void *dev_id)
+{
+	struct pm_proxy_client *client = dev_id;
+
+	wake_up(&client->wq);
+
+	return IRQ_HANDLED;
+}
+
+/* Requests sleep, so the clock is gated in prepare/unprepare */
+static int pm_proxy_clk_prepare(struct clk_hw *hw)
+{
+	struct pm_proxy_clk *c = to_pm_proxy_clk(hw);
+
+	return pm_proxy_call(c->client, PM_PROXY_CLK_PREPARE, c->id, NULL);
+}
+
+static void pm_proxy_clk_unprepare(struct clk_hw *hw)
+{
+	struct pm_proxy_clk *c = to_pm_proxy_clk(hw);
+
+	pm_proxy_call(c->client, PM_PROXY_CLK_UNPREPARE, c->id, NULL);
+}
+
+static unsigned long pm_proxy_clk_recalc_rate(struct clk_hw *hw,
+					      unsigned long parent_rate)
+{
+	struct pm_proxy_clk *c = to_pm_proxy_clk(hw);
+	u64 rate = 0;
+
+	if (pm_proxy_call(c->client, PM_PROXY_CLK_GET_RATE, c->id, &rate))
+		return 0;
+
+	return rate;
+}
+
+static long pm_proxy_clk_round_rate(struct clk_hw *hw, unsigned long rate,
+				    unsigned long *parent_rate)
+{
+	struct pm_proxy_clk *c = to_pm_proxy_clk(hw);
+	u64 r = rate;
+	int err;
+
+	err = pm_proxy_call(c->client, PM_PROXY_CLK_ROUND_RATE, c->id, &r);
+	if (err)
+		return err;
+
+	return r;
+}
+
+static int pm_proxy_clk_set_rate(struct clk_hw *hw, unsigned long rate,
+				 unsigned long parent_rate)
+{
+	struct pm_proxy_clk *c = to_pm_proxy_clk(hw);
+	u64 r = rate;
+
+	return pm_proxy_call(c->client, PM_PROXY_CLK_SET_RATE, c->id, &r);
+}
+
+static const struct clk_ops pm_proxy_clk_ops = {
+	.prepare = pm_proxy_clk_prepare,
+	.unprepare = pm_proxy_clk_unprepare,
+	.recalc_rate = pm_proxy_clk_recalc_rate,
+	.round_rate = pm_proxy_clk_round_rate,
+	.set_rate = pm_proxy_clk_set_rate,
+};
+
+static struct clk_hw *pm_proxy_clk_get(struct of_phandle_args *spec,
+				       void *data)
+{
+	struct pm_proxy_client *client = data;
+	unsigned int idx = spec->args[0];
+
+	if (idx >= client->num_clks)
+		return ERR_PTR(-EINVAL);
+
+	return &client->clks[idx].hw;
+}
+
+static int pm_proxy_rst_assert(struct reset_controller_dev *rcdev,
+			       unsigned long id)
+{
+	struct pm_proxy_client *client =
+		container_of(rcdev, struct pm_proxy_client, rcdev);
+
+	return pm_proxy_call(client, PM_PROXY_RST_ASSERT, id, NULL);
+}
+
+static int pm_proxy_rst_deassert(struct reset_controller_dev *rcdev,
+				 unsigned long id)
+{
+	struct pm_proxy_client *client =
+		container_of(rcdev, struct pm_proxy_client, rcdev);
+
+	return pm_proxy_call(client, PM_PROXY_RST_DEASSERT, id, NULL);
+}
+
+static int pm_proxy_rst_reset(struct reset_controller_dev *rcdev,
+			      unsigned long id)
+{
+	struct pm_proxy_client *client =
+		container_of(rcdev, struct pm_proxy_client, rcdev);
+
+	return pm_proxy_call(client, PM_PROXY_RST_RESET, id, NULL);
+}
+
+static const struct reset_control_ops pm_proxy_rst_ops = {
+	.assert = pm_proxy_rst_assert,
+	.deassert = pm_proxy_rst_deassert,
+	.reset = pm_proxy_rst_reset,
+};
+
+static int pm_proxy_pd_power_on(struct generic_pm_domain *genpd)
+{
+	struct pm_proxy_client *client =
+		container_of(genpd, struct pm_proxy_client, genpd);
+
+	return pm_proxy_call(client, PM_PROXY_PD_ON, 0, NULL);
+}
+
+static int pm_proxy_pd_power_off(struct generic_pm_domain *genpd)
+{
+	struct pm_proxy_client *client =
+		container_of(genpd, struct pm_proxy_client, genpd);
+
+	return pm_proxy_call(client, PM_PROXY_PD_OFF, 0, NULL);
+}
+
+static int pm_proxy_client_register_clks(struct pm_proxy_client *client,
+					 u32 num_clks)
+{
+	struct device *dev = client->dev;
+	struct device_node *dn = dev->of_node;
+	unsigned int i;
+	int err;
+
+	client->clks = devm_kcalloc(dev, num_clks, sizeof(*client->clks),
+				    GFP_KERNEL);
+	if (!client->clks)
+		return -ENOMEM;
+
+	for (i = 0; i < num_clks; i++) {
+		struct pm_proxy_clk *c = &client->clks[i];
+		struct clk_init_data init = { };
+		const char *name;
+
+		if (of_property_read_string_index(dn, "clock-output-names", i,
+						  &name))
+			name = devm_kasprintf(dev, GFP_KERNEL, "%pOFn-%u", dn,
+					      i);
+		if (!name)
+			return -ENOMEM;
+
+		init.name = name;
+		init.ops = &pm_proxy_clk_ops;
+		/* the root cell may change the rate behind our back */
+		init.flags = CLK_GET_RATE_NOCACHE;
+
+		c->client = client;
+		c->id = i;
+		c->hw.init = &init;
+
+		err = devm_clk_hw_register(dev, &c->hw);
+		if (err)
+			return err;
+	}
+	client->num_clks = num_clks;
+
+	return of_clk_add_hw_provider(dn, pm_proxy_clk_get, client);
+}
+
+static int pm_proxy_client_probe(struct platform_device *pdev)
+{
+	struct device_node *dn = pdev->dev.of_node;
+	struct pm_proxy_client *client;
+	u32 num_clks = 0, num_resets = 0;
+	int err;
+
+	client = devm_kzalloc(&pdev->dev, sizeof(*client), GFP_KERNEL);
+	if (!client)
+		return -ENOMEM;
+
+	client->dev = &pdev->dev;
+	mutex_init(&client->lock);
+	init_waitqueue_head(&client->wq);
+
+	of_property_read_u32(dn, "nvidia,num-clocks", &num_clks);
+	of_property_read_u32(dn, "nvidia,num-resets", &num_resets);
+	if (num_clks > PM_PROXY_MAX_CLKS || num_resets > PM_PROXY_MAX_RESETS)
+		return -EINVAL;
+
+	client->ivck = pm_proxy_reserve(&pdev->dev);
+	if (IS_ERR(client->ivck))
+		return PTR_ERR(client->ivck);
+
+	platform_set_drvdata(pdev, client);
+
+	err = request_irq(client->ivck->irq, pm_proxy_client_isr, 0,
+			  dev_name(&pdev->dev), client);
+	if (err)
+		goto err_unreserve;
+
+	/* set ivc channel to invalid state */
+	tegra_hv_ivc_channel_reset(client->ivck);
+
+	if (num_clks) {
+		err = pm_proxy_client_register_clks(client, num_clks);
+		if (err)
+			goto err_free_irq;
+	}
+
+	if (num_resets) {
+		client->rcdev.ops = &pm_proxy_rst_ops;
+		client->rcdev.owner = THIS_MODULE;
+		client->rcdev.of_node = dn;
+		client->rcdev.nr_resets = num_resets;
+		err = devm_reset_controller_register(&pdev->dev, &client->rcdev);
+		if (err)
+			goto err_del_clk;
+	}
+
+	if (of_find_property(dn, "#power-domain-cells", NULL)) {
+		client->genpd.name = dev_name(&pdev->dev);
+		client->genpd.power_on = pm_proxy_pd_power_on;
+		client->genpd.power_off = pm_proxy_pd_power_off;
+		err = pm_genpd_init(&client->genpd, NULL, true);
+		if (err)
+			goto err_del_clk;
+
+		err = of_genpd_add_provider_simple(dn, &client->genpd);
+		if (err) {
+			pm_genpd_remove(&client->genpd);
+			goto err_del_clk;
+		}
+		client->has_genpd = true;
+	}
+
+	dev_info(&pdev->dev, "proxying %u clocks, %u resets%s\n", num_clks,
+		 num_resets, client->has_genpd ? ", power domain" : "");
+
+	return 0;
+
+err_del_clk:
+	if (num_clks)
+		of_clk_del_provider(dn);
+err_free_irq:
+	free_irq(client->ivck->irq, client);
+err_unreserve:
+	tegra_hv_ivc_unreserve(client->ivck);
+	return err;
+}
+
+static int pm_proxy_client_remove(struct platform_device *pdev)
+{
+	struct pm_proxy_client *client = platform_get_drvdata(pdev);
+
+	if (client->has_genpd) {
+		of_genpd_del_provider(pdev->dev.of_node);
+		pm_genpd_remove(&client->genpd);
+	}
+	if (client->num_clks)
+		of_clk_del_provider(pdev->dev.of_node);
+	free_irq(client->ivck->irq, client);
+	tegra_hv_ivc_unreserve(client->ivck);
+
+	return 0;
+}
+
+static const struct of_device_id pm_proxy_server_of_match[] = {
+	{ .compatible = "nvidia,tegra-hv-pm-proxy-server", },
+	{ /* sentinel */ }
+};
+MODULE_DEVICE_TABLE(of, pm_proxy_server_of_match);
+
+static struct platform_driver pm_proxy_server_driver = {
+	.driver = {
+		.name = DRV_NAME "_server",
+		.of_match_table = pm_proxy_server_of_match,
+	},
+	.probe = pm_proxy_server_probe,
+	.remove = pm_proxy_server_remove,
+};
+
+static const struct of_device_id pm_proxy_client_of_match[] = {
+	{ .compatible = "nvidia,tegra-hv-pm-proxy", },
+	{ /* sentinel */ }
+};
+MODULE_DEVICE_TABLE(of, pm_proxy_client_of_match);
+
+static struct platform_driver pm_proxy_client_driver = {
+	.driver = {
+		.name = DRV_NAME,
+		.of_match_table = pm_proxy_client_of_match,
+		/* consumers hold clocks and resets, do not unbind */
+		.suppress_bind_attrs = true,
+	},
+	.probe = pm_proxy_client_probe,
+	.remove = pm_proxy_client_remove,
+};
+
+static int __init tegra_hv_pm_proxy_init(void)
+{
+	int err;
+
+	err = platform_driver_register(&pm_proxy_server_driver);
+	if (err)
+		return err;
+
+	err = platform_driver_register(&pm_proxy_client_driver);
+	if (err)
+		platform_driver_unregister(&pm_proxy_server_driver);
+
+	return err;
+}
+module_init(tegra_hv_pm_proxy_init);
+
+static void __exit tegra_hv_pm_proxy_exit(void)
+{
+	platform_driver_unregister(&pm_proxy_client_driver);
+	platform_driver_unregister(&pm_proxy_server_driver);
+}
+module_exit(tegra_hv_pm_proxy_exit);
+
+MODULE_DESCRIPTION("Tegra clock, reset and power domain proxy for Jailhouse cells");
+MODULE_LICENSE("GPL");
@@ -26,6 +26,10 @@
 #include <linux/fs.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/huge_mm.h>
+#include <linux/pfn_t.h>
 #include <linux/version.h>
 #if KERNEL_VERSION(4, 15, 0) > LINUX_VERSION_CODE
 #include <soc/tegra/chip-id.h>
@@ -45,6 +49,19 @@
 
 #include "tegra_hv.h"
 
+/* memory attributes a mempool can be mapped to userspace with */
+enum ivc_mempool_map_type {
+	IVC_MEMPOOL_MAP_CACHED = 0,
+	IVC_MEMPOOL_MAP_WC,
+	IVC_MEMPOOL_MAP_UNCACHED,
+};
+
+static const char * const ivc_mempool_map_type_names[] = {
+	[IVC_MEMPOOL_MAP_CACHED]	= "cached",
+	[IVC_MEMPOOL_MAP_WC]		= "wc",
+	[IVC_MEMPOOL_MAP_UNCACHED]	= "uncached",
+};
+
 /* userspace ivc mempool device */
 struct ivc_mempool_dev {
 	int			minor;
@@ -55,6 +72,8 @@ struct ivc_mempool_dev {
 	/* config data for this mempool */
 	const struct ivc_mempool *mempoolcfg;
 	struct tegra_hv_ivm_cookie *mpool_cookie;
+	/* attributes used by the next mmap(), see mmap_type sysfs node */
+	enum ivc_mempool_map_type map_type;
 };
 
 /* maximum ivc mempool id from all ivc mempools assigned to this guest */
@@ -100,13 +119,43 @@ static ssize_t peer_show(struct device *dev,
 	return snprintf(buf, PAGE_SIZE, "%d\n",
 			mempooldev->mempoolcfg->peer_vmid);
 }
+/*
+ * memory attributes for userspace mappings: cached, wc or uncached. Only
+ * affects mappings created after the change.
+ */
+static ssize_t mmap_type_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct ivc_mempool_dev *mempooldev = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%s\n",
+			ivc_mempool_map_type_names[READ_ONCE(
+				mempooldev->map_type)]);
+}
+
+static ssize_t mmap_type_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ivc_mempool_dev *mempooldev = dev_get_drvdata(dev);
+	int type;
+
+	type = sysfs_match_string(ivc_mempool_map_type_names, buf);
+	if (type < 0)
+		return type;
+
+	WRITE_ONCE(mempooldev->map_type, type);
+
+	return count;
+}
 static DEVICE_ATTR_RO(id);
 static DEVICE_ATTR_RO(size);
 static DEVICE_ATTR_RO(peer);
+static DEVICE_ATTR_RW(mmap_type);
 static struct attribute *ivc_mempool_attrs[] = {
 	&dev_attr_id.attr,
 	&dev_attr_size.attr,
 	&dev_attr_peer.attr,
+	&dev_attr_mmap_type.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(ivc_mempool);
@@ -182,6 +231,96 @@ static ssize_t ivc_mempool_write(struct file *filp,
 	return -ENOTSUPP;
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * Large pools are mapped on demand so that PMD aligned parts of the pool
+ * can use 2 MiB entries. Anything the PMD path cannot cover is mapped with
+ * regular pages from ivc_mempool_vm_fault().
+ */
+static bool ivc_mempool_can_map_huge(const struct ivc_mempool *mempoolcfg)
+{
+	return IS_ALIGNED(mempoolcfg->pa, PMD_SIZE) &&
+		(mempoolcfg->size >= PMD_SIZE);
+}
+
+static vm_fault_t ivc_mempool_vm_fault(struct vm_fault *vmf)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	const struct ivc_mempool *mempoolcfg = vma->vm_private_data;
+	unsigned long pfn;
+
+	pfn = (mempoolcfg->pa >> PAGE_SHIFT) +
+		((vmf->address - vma->vm_start) >> PAGE_SHIFT);
+
+	return vmf_insert_pfn(vma, vmf->address, pfn);
+}
+
+static vm_fault_t ivc_mempool_vm_huge_fault(struct vm_fault *vmf,
+		enum page_entry_size pe_size)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	const struct ivc_mempool *mempoolcfg = vma->vm_private_data;
+	unsigned long haddr = vmf->address & PMD_MASK;
+	unsigned long pfn;
+
+	if (pe_size != PE_SIZE_PMD)
+		return VM_FAULT_FALLBACK;
+
+	if ((haddr < vma->vm_start) || ((haddr + PMD_SIZE) > vma->vm_end))
+		return VM_FAULT_FALLBACK;
+
+	pfn = (mempoolcfg->pa >> PAGE_SHIFT) +
+		((haddr - vma->vm_start) >> PAGE_SHIFT);
+	if (!IS_ALIGNED(pfn, PMD_SIZE >> PAGE_SHIFT))
+		return VM_FAULT_FALLBACK;
+
+	return vmf_insert_pfn_pmd(vmf, __pfn_to_pfn_t(pfn, PFN_DEV),
+			(vmf->flags & FAULT_FLAG_WRITE) != 0);
+}
+
+static const struct vm_operations_struct ivc_mempool_vm_ops = {
+	.fault		= ivc_mempool_vm_fault,
+	.huge_fault	= ivc_mempool_vm_huge_fault,
+};
+
+/* 2 MiB align the user address so that the pool can use PMD entries */
+static unsigned long ivc_mempool_get_unmapped_area(struct file *filp,
+		unsigned long addr, unsigned long len, unsigned long pgoff,
+		unsigned long flags)
+{
+	struct ivc_mempool_dev *mempooldev = filp->private_data;
+	unsigned long ret;
+
+	if ((flags & MAP_FIXED) || (pgoff != 0) || (len < PMD_SIZE) ||
+			(mempooldev == NULL) ||
+			!ivc_mempool_can_map_huge(mempooldev->mempoolcfg) ||
+			(len > (TASK_SIZE - PMD_SIZE)))
+		return current->mm->get_unmapped_area(filp, addr, len, pgoff,
+				flags);
+
+	ret = current->mm->get_unmapped_area(filp, 0, len + PMD_SIZE, pgoff,
+			flags);
+	if (IS_ERR_VALUE(ret))
+		return current->mm->get_unmapped_area(filp, addr, len, pgoff,
+				flags);
+
+	return round_up(ret, PMD_SIZE);
+}
+#endif
+
+static pgprot_t ivc_mempool_pgprot(enum ivc_mempool_map_type type,
+		pgprot_t prot)
+{
+	switch (type) {
+	case IVC_MEMPOOL_MAP_WC:
+		return pgprot_writecombine(prot);
+	case IVC_MEMPOOL_MAP_UNCACHED:
+		return pgprot_noncached(prot);
+	default:
+		return prot;
+	}
+}
+
 static int ivc_mempool_mmap(struct file *filp, struct vm_area_struct *vma)
 {
 	struct ivc_mempool_dev *mempooldev = filp->private_data;
@@ -199,6 +338,26 @@ static int ivc_mempool_mmap(struct file *filp, struct vm_area_struct *vma)
 	if (((vma->vm_pgoff == 0) &&
 		(map_region_sz == mempooldev->mempoolcfg->size))) {
 
+		vma->vm_page_prot = ivc_mempool_pgprot(
+				READ_ONCE(mempooldev->map_type),
+				vma->vm_page_prot);
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+		/*
+		 * PMD entries for PFN maps cannot be COWed, so keep private
+		 * mappings on the remap_pfn_range() path.
+		 */
+		if ((vma->vm_flags & VM_SHARED) &&
+			ivc_mempool_can_map_huge(mempooldev->mempoolcfg)) {
+			vma->vm_flags |= VM_PFNMAP | VM_IO | VM_DONTEXPAND |
+				VM_DONTDUMP | VM_HUGEPAGE;
+			vma->vm_private_data =
+				(void *)mempooldev->mempoolcfg;
+			vma->vm_ops = &ivc_mempool_vm_ops;
+			return 0;
+		}
+#endif
+
 		mpool_ipa_pfn =
 			(mempooldev->mempoolcfg->pa >> PAGE_SHIFT);
 
@@ -257,10 +416,13 @@ static const struct file_operations ivc_mempool_fops = {
 	.write		= ivc_mempool_write,
 	.unlocked_ioctl	= ivc_mempool_dev_ioctl,
 	.mmap		= ivc_mempool_mmap,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	.get_unmapped_area = ivc_mempool_get_unmapped_area,
+#endif
 };
 
 
-static int __init add_ivc_mempool_dev(struct ivc_mempool_dev *mempooldev,
+static int add_ivc_mempool_dev(struct ivc_mempool_dev *mempooldev,
 		const struct ivc_mempool *mempoolcfg)
 {
 	int ret;
@@ -300,7 +462,7 @@ static int __init add_ivc_mempool_dev(struct ivc_mempool_dev *mempooldev,
 	return 0;
 }
 
-static int __init setup_ivc_mempool(void)
+static int setup_ivc_mempool(void)
 {
 	const struct ivc_mempool *ivc_info_mpool_array;
 	const struct ivc_mempool *mempoolcfg;
@@ -357,7 +519,7 @@ static int __init setup_ivc_mempool(void)
 	return 0;
 }
 
-static void __init cleanup_ivc_mempool(void)
+static void cleanup_ivc_mempool(void)
 {
 	uint32_t i;
 
@@ -386,26 +548,43 @@ static void __init cleanup_ivc_mempool(void)
 	}
 }
 
-static int __init userspace_ivc_mempool_init(void)
+/* see ivc_cdev_setup() */
+int userspace_ivc_mempool_setup(void)
 {
+	static DEFINE_MUTEX(setup_lock);
 	int result;
 
-	if (is_tegra_hypervisor_mode() == false) {
-		pr_info("user_ivc_mempool: hypervisor not present\n");
-		return -ENODEV;
+	mutex_lock(&setup_lock);
+
+	if (ivc_mempool_dev_array) {
+		result = 0;
+		goto out;
 	}
 
 	/* get ivc configuration data for this  guest */
 	guest_ivc_info = tegra_hv_get_ivc_info();
 	if (IS_ERR(guest_ivc_info)) {
 		pr_err("user_ivc_mempool: ### failed hyp get ivc info\n");
-		return -ENODEV;
+		result = -ENODEV;
+		goto out;
 	}
 
 	result = setup_ivc_mempool();
 	if (result != 0)
 		cleanup_ivc_mempool();
 
+out:
+	mutex_unlock(&setup_lock);
 	return result;
 }
+
+static int __init userspace_ivc_mempool_init(void)
+{
+	if (is_tegra_hypervisor_mode() == false) {
+		pr_info("user_ivc_mempool: hypervisor not present\n");
+		return -ENODEV;
+	}
+
+	return userspace_ivc_mempool_setup();
+}
 module_init(userspace_ivc_mempool_init);
@@ -200,4 +200,77 @@ int nvidia_p2p_dma_unmap_pages(struct nvidia_p2p_dma_mapping *map);
  */
 int nvidia_p2p_free_dma_mapping(struct nvidia_p2p_dma_mapping *dma_mapping);
 
+struct nvidia_p2p_cache_ref;
+
+/*
+ * @brief
+ *   Cached nvidia_p2p_get_pages(): return the pages of a GPU virtual
+ *   address range of the current process, reusing a previous registration
+ *   of the same range when there is one.
+ *
+ * @param[in]     vaddr
+ *   A GPU Virtual Address
+ * @param[in]     size
+ *   The size of the requested mapping.
+ *   Size must be a multiple of Page size.
+ * @param[in]     invalidate_cb
+ *   Function invoked if the pages are freed implicitly while the
+ *   reference is held. The caller must stop DMA to the pages and drop
+ *   the reference with nvidia_p2p_cache_put(). May be NULL.
+ * @param[in]     data
+ *   Opaque pointer passed to invalidate_cb.
+ * @param[out]    **ref
+ *   The reference to pass to nvidia_p2p_cache_put().
+ * @param[out]    **page_table
+ *   The page table, owned by the cache. It starts at vaddr and may be
+ *   larger than size.
+ *
+ * @return
+ *    0           upon successful completion.
+ *    Negative number if any error
+ */
+int nvidia_p2p_cache_get(u64 vaddr, u64 size,
+		void (*invalidate_cb)(void *data), void *data,
+		struct nvidia_p2p_cache_ref **ref,
+		struct nvidia_p2p_page_table **page_table);
+
+/*
+ * @brief
+ *   Drop a reference taken with nvidia_p2p_cache_get(). The registration
+ *   stays cached for the next get of the same range.
+ *
+ * @param[in]    *ref
+ *   A reference returned by nvidia_p2p_cache_get()
+ *
+ * @return
+ *    0           upon successful completion.
+ *    Negative number if any error
+ */
+int nvidia_p2p_cache_put(struct nvidia_p2p_cache_ref *ref);
+
+/*
+ * @brief
+ *   Cached nvidia_p2p_dma_map_pages() of the pages of a reference. The
+ *   mapping is owned by the cache and shared by the users of the same
+ *   range, device and direction.
+ *
+ * @param[in]	*dev
+ *   The peer device that needs to DMA to/from the mapping.
+ * @param[in]	*ref
+ *   A reference returned by nvidia_p2p_cache_get()
+ * @param[in]    direction
+ *   DMA direction
+ * @param[out]	**map
+ *   The DMA mapping, valid while the reference is held.
+ *
+ * @return
+ *    0           upon successful completion.
+ *   -EFAULT      if the pages were invalidated.
+ *    Negative number if any other error
+ */
+int nvidia_p2p_cache_dma_map_pages(struct device *dev,
+		struct nvidia_p2p_cache_ref *ref,
+		enum dma_data_direction direction,
+		struct nvidia_p2p_dma_mapping **map);
+
 #endif
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef _INCLUDE_MACH_ISOMGR_GROUP_H
+#define _INCLUDE_MACH_ISOMGR_GROUP_H
+
+#include <linux/platform/tegra/isomgr.h>
+
+/* ISO bw request of one client of a group */
+struct tegra_isomgr_req {
+	tegra_isomgr_handle handle;
+	u32 bw;		/* KB/sec */
+	u32 lt;		/* tolerated latency, usec */
+};
+
+/* Pre-validated group of requests, see tegra_isomgr_template_create() */
+struct tegra_isomgr_template;
+
+#if defined(CONFIG_TEGRA_ISOMGR)
+int tegra_isomgr_reserve_realize(const struct tegra_isomgr_req *reqs,
+				 unsigned int count);
+struct tegra_isomgr_template *tegra_isomgr_template_create(
+				const struct tegra_isomgr_req *reqs,
+				unsigned int count);
+int tegra_isomgr_template_apply(struct tegra_isomgr_template *tmpl);
+void tegra_isomgr_template_destroy(struct tegra_isomgr_template *tmpl);
+#else
+static inline int tegra_isomgr_reserve_realize(
+				const struct tegra_isomgr_req *reqs,
+				unsigned int count)
+{
+	return 0;
+}
+
+static inline struct tegra_isomgr_template *tegra_isomgr_template_create(
+				const struct tegra_isomgr_req *reqs,
+				unsigned int count)
+{
+	return NULL;
+}
+
+static inline int tegra_isomgr_template_apply(
+				struct tegra_isomgr_template *tmpl)
+{
+	return 0;
+}
+
+static inline void tegra_isomgr_template_destroy(
+				struct tegra_isomgr_template *tmpl)
+{
+}
+#endif
+
+#endif /* _INCLUDE_MACH_ISOMGR_GROUP_H */